@@ -30,8 +30,11 @@
 #include <unistd.h>
 #include <zlib.h>
 
+#include <algorithm>
+#include <deque>
 #include <fstream>
 #include <memory>
+#include <thread>
 
 #include <binder/IBinder.h>
 #include <binder/IServiceManager.h>
@@ -50,6 +53,7 @@
 #include <android-base/macros.h>
 #include <android-base/properties.h>
 #include <android-base/stringprintf.h>
+#include <android-base/unique_fd.h>
 
 using namespace android;
 using pdx::default_transport::ServiceUtility;
@@ -277,10 +281,12 @@ static const char* g_categoriesFile = nullptr;
 static const char* g_kernelTraceFuncs = nullptr;
 static const char* g_debugAppCmdLine = "";
 static const char* g_outputFile = nullptr;
+static bool g_rawTrace = false;
 
 /* Global state */
 static bool g_tracePdx = false;
 static bool g_traceAborted = false;
+static volatile sig_atomic_t g_snapshotRequested = false;
 static bool g_categoryEnables[arraysize(k_categories)] = {};
 static std::string g_traceFolder;
 static sp<IAtraceDevice> g_atraceHal;
@@ -335,6 +341,9 @@ static const char* k_traceStreamPath =
 static const char* k_traceMarkerPath =
     "trace_marker";
 
+static const char* k_perCpuRawTracePath =
+    "per_cpu/cpu%d/trace_pipe_raw";
+
 // Check whether a file exists.
 static bool fileExists(const char* filename) {
     return access((g_traceFolder + filename).c_str(), F_OK) != -1;
@@ -920,93 +929,100 @@ static void streamTrace()
     }
 }
 
-// Read the current kernel trace and write it to stdout.
-static void dumpTrace(int outFd)
+// Compress the trace read from traceFD with zlib, and write it to outFd.
+static void deflateTrace(int traceFD, int outFd)
 {
-    ALOGI("Dumping trace");
-    int traceFD = open((g_traceFolder + k_tracePath).c_str(), O_RDWR);
-    if (traceFD == -1) {
-        fprintf(stderr, "error opening %s: %s (%d)\n", k_tracePath,
-                strerror(errno), errno);
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+
+    int result = deflateInit(&zs, Z_DEFAULT_COMPRESSION);
+    if (result != Z_OK) {
+        fprintf(stderr, "error initializing zlib: %d\n", result);
         return;
     }
 
-    if (g_compress) {
-        z_stream zs;
-        memset(&zs, 0, sizeof(zs));
-
-        int result = deflateInit(&zs, Z_DEFAULT_COMPRESSION);
-        if (result != Z_OK) {
-            fprintf(stderr, "error initializing zlib: %d\n", result);
-            close(traceFD);
-            return;
-        }
-
-        constexpr size_t bufSize = 64*1024;
-        std::unique_ptr<uint8_t> in(new uint8_t[bufSize]);
-        std::unique_ptr<uint8_t> out(new uint8_t[bufSize]);
-        if (!in || !out) {
-            fprintf(stderr, "couldn't allocate buffers\n");
-            close(traceFD);
-            return;
-        }
-
-        int flush = Z_NO_FLUSH;
+    constexpr size_t bufSize = 64*1024;
+    std::unique_ptr<uint8_t> in(new uint8_t[bufSize]);
+    std::unique_ptr<uint8_t> out(new uint8_t[bufSize]);
+    if (!in || !out) {
+        fprintf(stderr, "couldn't allocate buffers\n");
+        return;
+    }
 
-        zs.next_out = reinterpret_cast<Bytef*>(out.get());
-        zs.avail_out = bufSize;
+    int flush = Z_NO_FLUSH;
 
-        do {
+    zs.next_out = reinterpret_cast<Bytef*>(out.get());
+    zs.avail_out = bufSize;
 
-            if (zs.avail_in == 0) {
-                // More input is needed.
-                result = read(traceFD, in.get(), bufSize);
-                if (result < 0) {
-                    fprintf(stderr, "error reading trace: %s (%d)\n",
-                            strerror(errno), errno);
-                    result = Z_STREAM_END;
-                    break;
-                } else if (result == 0) {
-                    flush = Z_FINISH;
-                } else {
-                    zs.next_in = reinterpret_cast<Bytef*>(in.get());
-                    zs.avail_in = result;
-                }
-            }
+    do {
 
-            if (zs.avail_out == 0) {
-                // Need to write the output.
-                result = write(outFd, out.get(), bufSize);
-                if ((size_t)result < bufSize) {
-                    fprintf(stderr, "error writing deflated trace: %s (%d)\n",
-                            strerror(errno), errno);
-                    result = Z_STREAM_END; // skip deflate error message
-                    zs.avail_out = bufSize; // skip the final write
-                    break;
-                }
-                zs.next_out = reinterpret_cast<Bytef*>(out.get());
-                zs.avail_out = bufSize;
+        if (zs.avail_in == 0) {
+            // More input is needed.
+            result = read(traceFD, in.get(), bufSize);
+            if (result < 0 && errno == EAGAIN) {
+                // A non-blocking trace pipe was drained.
+                flush = Z_FINISH;
+            } else if (result < 0) {
+                fprintf(stderr, "error reading trace: %s (%d)\n",
+                        strerror(errno), errno);
+                result = Z_STREAM_END;
+                break;
+            } else if (result == 0) {
+                flush = Z_FINISH;
+            } else {
+                zs.next_in = reinterpret_cast<Bytef*>(in.get());
+                zs.avail_in = result;
             }
-
-        } while ((result = deflate(&zs, flush)) == Z_OK);
-
-        if (result != Z_STREAM_END) {
-            fprintf(stderr, "error deflating trace: %s\n", zs.msg);
         }
 
-        if (zs.avail_out < bufSize) {
-            size_t bytes = bufSize - zs.avail_out;
-            result = write(outFd, out.get(), bytes);
-            if ((size_t)result < bytes) {
+        if (zs.avail_out == 0) {
+            // Need to write the output.
+            result = write(outFd, out.get(), bufSize);
+            if ((size_t)result < bufSize) {
                 fprintf(stderr, "error writing deflated trace: %s (%d)\n",
                         strerror(errno), errno);
+                result = Z_STREAM_END; // skip deflate error message
+                zs.avail_out = bufSize; // skip the final write
+                break;
             }
+            zs.next_out = reinterpret_cast<Bytef*>(out.get());
+            zs.avail_out = bufSize;
         }
 
-        result = deflateEnd(&zs);
-        if (result != Z_OK) {
-            fprintf(stderr, "error cleaning up zlib: %d\n", result);
+    } while ((result = deflate(&zs, flush)) == Z_OK);
+
+    if (result != Z_STREAM_END) {
+        fprintf(stderr, "error deflating trace: %s\n", zs.msg);
+    }
+
+    if (zs.avail_out < bufSize) {
+        size_t bytes = bufSize - zs.avail_out;
+        result = write(outFd, out.get(), bytes);
+        if ((size_t)result < bytes) {
+            fprintf(stderr, "error writing deflated trace: %s (%d)\n",
+                    strerror(errno), errno);
         }
+    }
+
+    result = deflateEnd(&zs);
+    if (result != Z_OK) {
+        fprintf(stderr, "error cleaning up zlib: %d\n", result);
+    }
+}
+
+// Read the current kernel trace and write it to stdout.
+static void dumpTrace(int outFd)
+{
+    ALOGI("Dumping trace");
+    int traceFD = open((g_traceFolder + k_tracePath).c_str(), O_RDWR);
+    if (traceFD == -1) {
+        fprintf(stderr, "error opening %s: %s (%d)\n", k_tracePath,
+                strerror(errno), errno);
+        return;
+    }
+
+    if (g_compress) {
+        deflateTrace(traceFD, outFd);
     } else {
         char buf[4096];
         ssize_t rc;
@@ -1024,6 +1040,146 @@ static void dumpTrace(int outFd)
     close(traceFD);
 }
 
+// Move the raw pages of the per-CPU trace buffer read from traceFD to outFd,
+// through a pipe, so that the kernel doesn't copy them through userspace.
+static void spliceTrace(int traceFD, int outFd)
+{
+    constexpr size_t chunkSize = 64*1024;
+    int pipeFds[2];
+    if (pipe2(pipeFds, O_CLOEXEC) == -1) {
+        fprintf(stderr, "error creating pipe: %s (%d)\n", strerror(errno), errno);
+        return;
+    }
+    android::base::unique_fd pipeIn(pipeFds[1]);
+    android::base::unique_fd pipeOut(pipeFds[0]);
+
+    while (true) {
+        ssize_t bytesIn = splice(traceFD, nullptr, pipeIn.get(), nullptr, chunkSize,
+                                 SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (bytesIn == 0 || (bytesIn == -1 && errno == EAGAIN)) {
+            // The buffer was drained.
+            break;
+        } else if (bytesIn == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fprintf(stderr, "error reading raw trace: %s (%d)\n", strerror(errno), errno);
+            break;
+        }
+        while (bytesIn > 0) {
+            ssize_t bytesOut = TEMP_FAILURE_RETRY(splice(pipeOut.get(), nullptr, outFd, nullptr,
+                                                         bytesIn, SPLICE_F_MOVE));
+            if (bytesOut <= 0) {
+                fprintf(stderr, "error writing raw trace: %s (%d)\n", strerror(errno), errno);
+                return;
+            }
+            bytesIn -= bytesOut;
+        }
+    }
+}
+
+// Path of the raw trace file of a CPU written by dumpRawTrace.
+static std::string getRawTracePath(const std::string& outPrefix, int cpu)
+{
+    return android::base::StringPrintf("%s.cpu%d%s", outPrefix.c_str(), cpu,
+                                       g_compress ? ".z" : "");
+}
+
+// Dump the raw trace buffer of each CPU to its own outPrefix.cpuN file, on one
+// thread per CPU. The files hold the binary ring buffer pages, to be parsed
+// with the event formats of the device's tracing folder.
+static void dumpRawTrace(const std::string& outPrefix)
+{
+    std::vector<std::thread> threads;
+    const int cpuCount = sysconf(_SC_NPROCESSORS_CONF);
+    for (int cpu = 0; cpu < cpuCount; cpu++) {
+        threads.emplace_back([cpu, outPrefix]() {
+            std::string tracePath = android::base::StringPrintf(k_perCpuRawTracePath, cpu);
+            android::base::unique_fd traceFD(open((g_traceFolder + tracePath).c_str(),
+                                                  O_RDONLY | O_NONBLOCK | O_CLOEXEC));
+            if (traceFD == -1) {
+                fprintf(stderr, "error opening %s: %s (%d)\n", tracePath.c_str(),
+                        strerror(errno), errno);
+                return;
+            }
+            std::string outPath = getRawTracePath(outPrefix, cpu);
+            android::base::unique_fd outFd(open(outPath.c_str(),
+                                                O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644));
+            if (outFd == -1) {
+                fprintf(stderr, "error opening %s: %s (%d)\n", outPath.c_str(),
+                        strerror(errno), errno);
+                return;
+            }
+            if (g_compress) {
+                deflateTrace(traceFD.get(), outFd.get());
+            } else {
+                spliceTrace(traceFD.get(), outFd.get());
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+static void handleSnapshotSignal(int /*signo*/)
+{
+    g_snapshotRequested = true;
+}
+
+// Keep draining the raw trace buffers into a ring of one second segments in
+// folder, which holds the last g_traceDurationSeconds of the trace. On
+// SIGUSR1, the segments of the ring are linked as a snapshot, which the ring
+// doesn't delete.
+static void recordFlight(const char* folder)
+{
+    struct sigaction sa;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = 0;
+    sa.sa_handler = handleSnapshotSignal;
+    sigaction(SIGUSR1, &sa, nullptr);
+
+    const int cpuCount = sysconf(_SC_NPROCESSORS_CONF);
+    const size_t maxSegments = std::max(g_traceDurationSeconds, 1);
+    std::deque<std::string> segments;
+    for (uint64_t sequence = 0; !g_traceAborted; sequence++) {
+        struct timespec timeLeft = {1, 0};
+        do {
+            if (g_traceAborted || g_snapshotRequested) {
+                break;
+            }
+        } while (nanosleep(&timeLeft, &timeLeft) == -1 && errno == EINTR);
+
+        std::string segment = android::base::StringPrintf("segment-%" PRIu64, sequence);
+        dumpRawTrace(std::string(folder) + "/" + segment);
+        segments.push_back(segment);
+        while (segments.size() > maxSegments) {
+            for (int cpu = 0; cpu < cpuCount; cpu++) {
+                unlink(getRawTracePath(std::string(folder) + "/" + segments.front(), cpu).c_str());
+            }
+            segments.pop_front();
+        }
+
+        if (g_snapshotRequested) {
+            g_snapshotRequested = false;
+            std::string snapshot = android::base::StringPrintf("%s/snapshot-%lld-", folder,
+                                                               (long long)time(nullptr));
+            for (const auto& segment : segments) {
+                for (int cpu = 0; cpu < cpuCount; cpu++) {
+                    std::string path = getRawTracePath(std::string(folder) + "/" + segment, cpu);
+                    std::string snapshotPath = getRawTracePath(snapshot + segment, cpu);
+                    if (link(path.c_str(), snapshotPath.c_str()) == -1 && errno != ENOENT) {
+                        fprintf(stderr, "error linking %s: %s (%d)\n", snapshotPath.c_str(),
+                                strerror(errno), errno);
+                    }
+                }
+            }
+            printf("saved snapshot %s\n", snapshot.c_str());
+            fflush(stdout);
+        }
+    }
+}
+
 static void handleSignal(int /*signo*/)
 {
     if (!g_nohup) {
@@ -1084,6 +1240,13 @@ static void showHelp(const char *cmd)
                     "                  list the available tracing categories\n"
                     " -o filename      write the trace to the specified file instead\n"
                     "                    of stdout.\n"
+                    "  --raw           dump the binary trace buffer of each CPU to its own\n"
+                    "                    file, named after the -o filename, on a thread per\n"
+                    "                    CPU; with -z, each file is compressed on its thread\n"
+                    "  --flight_recorder folder\n"
+                    "                  trace into a circular buffer, drained every second\n"
+                    "                    into raw files in folder which keep the last N\n"
+                    "                    seconds of -t; SIGUSR1 saves them as a snapshot\n"
             );
 }
 
@@ -1191,6 +1354,7 @@ int main(int argc, char **argv)
     bool traceDump = true;
     bool traceStream = false;
     bool onlyUserspace = false;
+    const char* flightRecorderFolder = nullptr;
 
     if (argc == 2 && 0 == strcmp(argv[1], "--help")) {
         showHelp(argv[0]);
@@ -1214,6 +1378,8 @@ int main(int argc, char **argv)
             {"only_userspace",    no_argument, nullptr,  0 },
             {"list_categories",   no_argument, nullptr,  0 },
             {"stream",            no_argument, nullptr,  0 },
+            {"raw",               no_argument, nullptr,  0 },
+            {"flight_recorder",   required_argument, nullptr,  0 },
             {nullptr,                       0, nullptr,  0 }
         };
 
@@ -1289,6 +1455,12 @@ int main(int argc, char **argv)
                 } else if (!strcmp(long_options[option_index].name, "stream")) {
                     traceStream = true;
                     traceDump = false;
+                } else if (!strcmp(long_options[option_index].name, "raw")) {
+                    g_rawTrace = true;
+                } else if (!strcmp(long_options[option_index].name, "flight_recorder")) {
+                    flightRecorderFolder = optarg;
+                    traceDump = false;
+                    g_traceOverwrite = true;
                 } else if (!strcmp(long_options[option_index].name, "list_categories")) {
                     listSupportedCategories();
                     exit(0);
@@ -1311,6 +1483,11 @@ int main(int argc, char **argv)
         }
     }
 
+    if (g_rawTrace && !g_outputFile) {
+        fprintf(stderr, "--raw can only be used with -o\n");
+        exit(1);
+    }
+
     registerSigHandler();
 
     if (g_initialSleepSecs > 0) {
@@ -1331,7 +1508,7 @@ int main(int argc, char **argv)
 
     if (ok && traceStart) {
 
-        if (!traceStream && !onlyUserspace) {
+        if (!traceStream && !flightRecorderFolder && !onlyUserspace) {
             printf("capturing trace...");
             fflush(stdout);
         }
@@ -1345,7 +1522,7 @@ int main(int argc, char **argv)
             ok = clearTrace();
 
         writeClockSyncMarker();
-        if (ok && !async && !traceStream) {
+        if (ok && !async && !traceStream && !flightRecorderFolder) {
             // Sleep to allow the trace to be captured.
             struct timespec timeLeft;
             timeLeft.tv_sec = g_traceDurationSeconds;
@@ -1359,6 +1536,8 @@ int main(int argc, char **argv)
 
         if (traceStream) {
             streamTrace();
+        } else if (ok && flightRecorderFolder) {
+            recordFlight(flightRecorderFolder);
         }
     }
 
@@ -1371,10 +1550,13 @@ int main(int argc, char **argv)
             printf(" done\n");
             fflush(stdout);
             int outFd = STDOUT_FILENO;
-            if (g_outputFile) {
+            if (g_outputFile && !g_rawTrace) {
                 outFd = open(g_outputFile, O_WRONLY | O_CREAT | O_TRUNC, 0644);
             }
-            if (outFd == -1) {
+            if (g_rawTrace) {
+                ALOGI("Dumping raw trace");
+                dumpRawTrace(g_outputFile);
+            } else if (outFd == -1) {
                 printf("Failed to open '%s', err=%d", g_outputFile, errno);
             } else {
                 dprintf(outFd, "TRACE:\n");
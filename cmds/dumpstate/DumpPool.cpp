@@ -34,7 +34,7 @@ namespace dumpstate {
 const std::string DumpPool::PREFIX_TMPFILE_NAME = "dump-tmp.";
 
 DumpPool::DumpPool(const std::string& tmp_root) : tmp_root_(tmp_root), shutdown_(false),
-        log_duration_(true) {
+        log_duration_(true), next_sequence_(0) {
     assert(!tmp_root.empty());
     deleteTempFiles(tmp_root_);
 }
@@ -65,7 +65,10 @@ void DumpPool::shutdown() {
         return;
     }
     futures_map_.clear();
-    while (!tasks_.empty()) tasks_.pop();
+    tasks_.clear();
+    blocked_tasks_.clear();
+    dependents_.clear();
+    unfinished_tasks_.clear();
 
     shutdown_ = true;
     condition_variable_.notify_all();
@@ -175,6 +178,29 @@ void DumpPool::setThreadName(const pthread_t thread, int id) {
     pthread_setname_np(thread, name.data());
 }
 
+void DumpPool::pushReadyTask(QueuedTask&& queued_task) {
+    auto key = std::make_pair(-queued_task.priority, queued_task.sequence);
+    tasks_.emplace(key, std::move(queued_task));
+}
+
+void DumpPool::finishTask(const std::string& task_name) {
+    unfinished_tasks_.erase(task_name);
+    auto dependents = dependents_.find(task_name);
+    if (dependents == dependents_.end()) {
+        return;
+    }
+    for (const auto& dependent : dependents->second) {
+        auto blocked = blocked_tasks_.find(dependent);
+        if (blocked == blocked_tasks_.end() || --blocked->second.pending_dependencies > 0) {
+            continue;
+        }
+        pushReadyTask(std::move(blocked->second));
+        blocked_tasks_.erase(blocked);
+    }
+    dependents_.erase(dependents);
+    condition_variable_.notify_all();
+}
+
 void DumpPool::loop() {
     std::unique_lock lock(lock_);
     while (!shutdown_) {
@@ -182,11 +208,14 @@ void DumpPool::loop() {
             condition_variable_.wait(lock);
             continue;
         } else {
-            std::packaged_task<std::string()> task = std::move(tasks_.front());
-            tasks_.pop();
+            auto first = tasks_.begin();
+            std::string task_name = first->second.name;
+            std::packaged_task<std::string()> task = std::move(first->second.task);
+            tasks_.erase(first);
             lock.unlock();
             std::invoke(task);
             lock.lock();
+            finishTask(task_name);
         }
     }
 }
@@ -19,8 +19,9 @@
 
 #include <future>
 #include <map>
-#include <queue>
+#include <set>
 #include <string>
+#include <vector>
 
 #include <android-base/file.h>
 #include <android-base/macros.h>
@@ -51,11 +52,28 @@ class DumpPoolTest;
  * DumpFoo is a callable function included a out_fd parameter. Using the
  * enqueueTaskWithFd method in DumpPool to enqueue the task to the pool. The
  * std::placeholders::_1 is a placeholder for DumpPool to pass a fd argument.
+ *
+ * Tasks start in the order they were enqueued, unless they are enqueued with
+ * TaskOptions: a task then waits for the tasks it depends on to finish, and
+ * starts before the ready tasks of lower priority. The results are still
+ * dumped in the order of the waitForTask calls.
  */
 class DumpPool {
   friend class android::os::dumpstate::DumpPoolTest;
 
   public:
+    /*
+     * Scheduling options of a task.
+     *
+     * |priority| Ready tasks of higher priority start first, the default is 0.
+     * |dependencies| Names of the tasks which have to finish before the task
+     * starts. Tasks which were not enqueued, or already finished, are ignored.
+     */
+    struct TaskOptions {
+        int priority = 0;
+        std::vector<std::string> dependencies;
+    };
+
     /*
      * Creates a thread pool.
      *
@@ -117,6 +135,20 @@ class DumpPool {
         }
     }
 
+    /*
+     * Same as enqueueTaskWithFd, but the task is scheduled with the given
+     * |options|. The tasks it depends on have to be enqueued first.
+     */
+    template<class F, class... Args> void enqueueTaskWithFdAndOptions(
+            const std::string& task_name, const TaskOptions& options, F&& f, Args&&... args) {
+        std::function<void(int)> func = std::bind(std::forward<F>(f),
+                std::forward<Args>(args)...);
+        futures_map_[task_name] = post(task_name, func, options);
+        if (threads_.empty()) {
+            start();
+        }
+    }
+
     /*
      * Waits until the task is finished. Dumps the task results to the STDOUT_FILENO.
      */
@@ -147,20 +179,44 @@ class DumpPool {
 
     template<class T> void invokeTask(T dump_func, const std::string& duration_title, int out_fd);
 
-    template<class T> Future post(const std::string& task_name, T dump_func) {
-        Task packaged_task([=]() {
+    /* A task waiting in the queue, or for its dependencies. */
+    typedef struct {
+      std::string name;
+      int priority;
+      uint64_t sequence;
+      size_t pending_dependencies;
+      Task task;
+    } QueuedTask;
+
+    template<class T> Future post(const std::string& task_name, T dump_func,
+            const TaskOptions& options = TaskOptions()) {
+        Task packaged_task([=, dump_func = std::move(dump_func)]() {
             std::unique_ptr<TmpFile> tmp_file_ptr = createTempFile();
             if (!tmp_file_ptr) {
                 return std::string("");
             }
+            // The file is only read back by this process, through the page cache, so it
+            // isn't synced: with many small tasks, the syncs would cost more than the dumps.
             invokeTask(dump_func, task_name, tmp_file_ptr->fd.get());
-            fsync(tmp_file_ptr->fd.get());
             return std::string(tmp_file_ptr->path);
         });
         std::unique_lock lock(lock_);
         auto future = packaged_task.get_future().share();
-        tasks_.push(std::move(packaged_task));
-        condition_variable_.notify_one();
+        QueuedTask queued_task = {task_name, options.priority, next_sequence_++, 0,
+                std::move(packaged_task)};
+        for (const auto& dependency : options.dependencies) {
+            if (unfinished_tasks_.count(dependency)) {
+                dependents_[dependency].push_back(task_name);
+                queued_task.pending_dependencies++;
+            }
+        }
+        unfinished_tasks_.insert(task_name);
+        if (queued_task.pending_dependencies > 0) {
+            blocked_tasks_[task_name] = std::move(queued_task);
+        } else {
+            pushReadyTask(std::move(queued_task));
+            condition_variable_.notify_one();
+        }
         return future;
     }
 
@@ -173,6 +229,9 @@ class DumpPool {
     void deleteTempFiles(const std::string& folder);
     void setThreadName(const pthread_t thread, int id);
     void loop();
+    // Both called with lock_ held.
+    void pushReadyTask(QueuedTask&& queued_task);
+    void finishTask(const std::string& task_name);
 
     /*
      * For test purpose only. Enables or disables logging duration of the task.
@@ -193,7 +252,15 @@ class DumpPool {
     std::condition_variable condition_variable_;
 
     std::vector<std::thread> threads_;
-    std::queue<Task> tasks_;
+    // Ready tasks, ordered by decreasing priority, then by enqueueing order.
+    std::map<std::pair<int, uint64_t>, QueuedTask> tasks_;
+    // Tasks waiting for their dependencies, by name.
+    std::map<std::string, QueuedTask> blocked_tasks_;
+    // Names of the tasks depending on the task of the key.
+    std::map<std::string, std::vector<std::string>> dependents_;
+    // Names of the tasks enqueued, which did not finish yet.
+    std::set<std::string> unfinished_tasks_;
+    uint64_t next_sequence_;
     std::map<std::string, Future> futures_map_;
 
     DISALLOW_COPY_AND_ASSIGN(DumpPool);
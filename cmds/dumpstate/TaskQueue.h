@@ -47,10 +47,11 @@ class TaskQueue {
      */
     template<class F, class... Args> void add(F&& f, Args&&... args) {
         auto func = std::bind(std::forward<F>(f), std::forward<Args>(args)...);
-        std::unique_lock lock(lock_);
-        tasks_.emplace([=](bool cancelled) {
+        Task task([func = std::move(func)](bool cancelled) mutable {
             std::invoke(func, cancelled);
         });
+        std::unique_lock lock(lock_);
+        tasks_.push(std::move(task));
     }
 
     /*
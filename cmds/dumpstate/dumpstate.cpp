@@ -354,6 +354,8 @@ static const std::string ZIP_ROOT_DIR = "FS";
 
 static const std::string kProtoPath = "proto/";
 static const std::string kProtoExt = ".proto";
+// Number of services dumping their proto at the same time.
+static const int MAX_PARALLEL_PROTO_DUMPS = 4;
 static const std::string kDumpstateBoardFiles[] = {
     "dumpstate_board.txt",
     "dumpstate_board.bin"
@@ -818,6 +820,25 @@ static const std::set<std::string> PROBLEMATIC_FILE_EXTENSIONS = {
       ".shb", ".sys", ".vb",  ".vbe", ".vbs", ".vxd", ".wsc", ".wsf", ".wsh"
 };
 
+// List of file extensions of formats that are already compressed, which are stored in the zip file
+// as they are: deflating them again costs the most CPU time of all entries and saves nothing.
+static const std::set<std::string> COMPRESSED_FILE_EXTENSIONS = {
+      ".7z", ".apk", ".br", ".bz2", ".gz", ".jpeg", ".jpg", ".lz4", ".mp4", ".png", ".webp",
+      ".xz", ".zip", ".zst"
+};
+
+static size_t get_zip_entry_flags(const std::string& entry_name) {
+    size_t idx = entry_name.rfind('.');
+    if (idx != std::string::npos) {
+        std::string extension = entry_name.substr(idx);
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        if (COMPRESSED_FILE_EXTENSIONS.count(extension) != 0) {
+            return 0;
+        }
+    }
+    return ZipWriter::kCompress;
+}
+
 status_t Dumpstate::AddZipEntryFromFd(const std::string& entry_name, int fd,
                                       std::chrono::milliseconds timeout = 0ms) {
     if (!IsZipping()) {
@@ -840,13 +861,17 @@ status_t Dumpstate::AddZipEntryFromFd(const std::string& entry_name, int fd,
 
     // Logging statement  below is useful to time how long each entry takes, but it's too verbose.
     // MYLOGD("Adding zip entry %s\n", entry_name.c_str());
-    int32_t err = zip_writer_->StartEntryWithTime(valid_name.c_str(), ZipWriter::kCompress,
+    int32_t err = zip_writer_->StartEntryWithTime(valid_name.c_str(),
+                                                  get_zip_entry_flags(valid_name),
                                                   get_mtime(fd, ds.now_));
     if (err != 0) {
         MYLOGE("zip_writer_->StartEntryWithTime(%s): %s\n", valid_name.c_str(),
                ZipWriter::ErrorCodeString(err));
         return UNKNOWN_ERROR;
     }
+    // Like the zip entry, the streamed entry is ended with whatever was read on errors.
+    StreamEntryStart(valid_name);
+    auto stream_guard = android::base::make_scope_guard([this] { StreamEntryData(nullptr, 0); });
     bool finished_entry = false;
     auto finish_entry = [this, &finished_entry] {
         if (!finished_entry) {
@@ -896,6 +921,7 @@ status_t Dumpstate::AddZipEntryFromFd(const std::string& entry_name, int fd,
             MYLOGE("zip_writer_->WriteBytes(): %s\n", ZipWriter::ErrorCodeString(err));
             return UNKNOWN_ERROR;
         }
+        StreamEntryData(buffer.data(), bytes_read);
     }
 
     err = zip_writer_->FinishEntry();
@@ -961,9 +987,31 @@ bool Dumpstate::AddTextZipEntry(const std::string& entry_name, const std::string
         return false;
     }
 
+    StreamEntryStart(entry_name);
+    StreamEntryData(content.c_str(), content.length());
+    StreamEntryData(nullptr, 0);
     return true;
 }
 
+void Dumpstate::StreamEntryStart(const std::string& entry_name) {
+    if (!options_->stream_entries_to_socket || control_socket_fd_ == -1) {
+        return;
+    }
+    if (!android::base::WriteStringToFd("ENTRY:" + entry_name + "\n", control_socket_fd_)) {
+        MYLOGE("Failed to stream entry %s: %s\n", entry_name.c_str(), strerror(errno));
+    }
+}
+
+void Dumpstate::StreamEntryData(const void* data, size_t size) {
+    if (!options_->stream_entries_to_socket || control_socket_fd_ == -1) {
+        return;
+    }
+    if (!android::base::WriteStringToFd(StringPrintf("DATA:%zu\n", size), control_socket_fd_) ||
+        !android::base::WriteFully(control_socket_fd_, data, size)) {
+        MYLOGE("Failed to stream entry data: %s\n", strerror(errno));
+    }
+}
+
 static void DoKmsg() {
     struct stat st;
     if (!stat(PSTORE_LAST_KMSG, &st)) {
@@ -1298,32 +1346,41 @@ static Dumpstate::RunStatus RunDumpsysProto(const std::string& title, int priori
 
     auto start = std::chrono::steady_clock::now();
     Vector<String16> services = dumpsys.listServices(priority, /* supports_proto = */ true);
-    for (const String16& service : services) {
-        RETURN_IF_USER_DENIED_CONSENT();
-        std::string path(kProtoPath);
-        path.append(String8(service).c_str());
-        if (priority == IServiceManager::DUMP_FLAG_PRIORITY_CRITICAL) {
-            path.append("_CRITICAL");
-        } else if (priority == IServiceManager::DUMP_FLAG_PRIORITY_HIGH) {
-            path.append("_HIGH");
-        }
-        path.append(kProtoExt);
-        status_t status = dumpsys.startDumpThread(Dumpsys::Type::DUMP, service, args);
-        if (status == OK) {
-            status = ds.AddZipEntryFromFd(path, dumpsys.getDumpFd(), service_timeout);
-            bool dumpTerminated = (status == OK);
-            dumpsys.stopDumpThread(dumpTerminated);
+    RETURN_IF_USER_DENIED_CONSENT();
+    // Proto dumps don't go through the text output, so the services are dumped in parallel,
+    // each into its own buffer, and the buffers are added to the zip file in order.
+    bool consent_denied = false;
+    dumpsys.dumpServicesToBuffers(Dumpsys::Type::DUMP, services, args, service_timeout,
+                                  /* asProto = */ true, MAX_PARALLEL_PROTO_DUMPS,
+                                  [&](size_t i, Dumpsys::BufferedDump& dump) {
+        if (ds.IsUserConsentDenied()) {
+            consent_denied = true;
+            return false;
+        }
+        if (dump.startStatus == OK) {
+            std::string path(kProtoPath);
+            path.append(String8(services[i]).c_str());
+            if (priority == IServiceManager::DUMP_FLAG_PRIORITY_CRITICAL) {
+                path.append("_CRITICAL");
+            } else if (priority == IServiceManager::DUMP_FLAG_PRIORITY_HIGH) {
+                path.append("_HIGH");
+            }
+            path.append(kProtoExt);
+            ds.AddZipEntryFromFd(path, dump.buffer.get(), service_timeout);
         }
-        ZipWriter::FileEntry file_entry;
-        ds.zip_writer_->GetLastEntry(&file_entry);
 
         auto elapsed_duration = std::chrono::duration_cast<std::chrono::milliseconds>(
             std::chrono::steady_clock::now() - start);
         if (elapsed_duration > timeout) {
             MYLOGE("*** command '%s' timed out after %llums\n", title.c_str(),
                    elapsed_duration.count());
-            break;
+            return false;
         }
+        return true;
+    });
+    if (consent_denied) {
+        MYLOGE("Returning early as user denied consent to share bugreport with calling app.");
+        return Dumpstate::RunStatus::USER_CONSENT_DENIED;
     }
     return Dumpstate::RunStatus::OK;
 }
@@ -2338,7 +2395,7 @@ void Dumpstate::DumpstateBoard(int out_fd) {
 static void ShowUsage() {
     fprintf(stderr,
             "usage: dumpstate [-h] [-b soundfile] [-e soundfile] [-o directory] [-p] "
-            "[-s] [-S] [-q] [-P] [-R] [-L] [-V version]\n"
+            "[-s] [-S] [-c] [-q] [-P] [-R] [-L] [-V version]\n"
             "  -h: display this help message\n"
             "  -b: play sound file instead of vibrate, at beginning of job\n"
             "  -e: play sound file instead of vibrate, at end of job\n"
@@ -2346,6 +2403,7 @@ static void ShowUsage() {
             "  -p: capture screenshot to filename.png\n"
             "  -s: write zipped file to control socket (for init)\n"
             "  -S: write file location to control socket (for init)\n"
+            "  -c: write each zip entry to control socket once added (for init)\n"
             "  -q: disable vibrate\n"
             "  -P: send broadcast when started and do progress updates\n"
             "  -R: take bugreport in remote mode (shouldn't be used with -P)\n"
@@ -2515,7 +2573,8 @@ static void FinalizeFile() {
 
     if (ds.options_->stream_to_socket) {
         android::os::CopyFileToFd(ds.path_, ds.control_socket_fd_);
-    } else if (ds.options_->progress_updates_to_socket) {
+    } else if (ds.options_->progress_updates_to_socket ||
+               ds.options_->stream_entries_to_socket) {
         if (do_text_file) {
             dprintf(ds.control_socket_fd_,
                     "FAIL:could not create zip file, check %s "
@@ -2593,12 +2652,12 @@ static void SetOptionsFromMode(Dumpstate::BugreportMode mode, Dumpstate::DumpOpt
 
 static void LogDumpOptions(const Dumpstate::DumpOptions& options) {
     MYLOGI(
-        "do_vibrate: %d stream_to_socket: %d progress_updates_to_socket: %d do_screenshot: %d "
-        "is_remote_mode: %d show_header_only: %d telephony_only: %d "
+        "do_vibrate: %d stream_to_socket: %d progress_updates_to_socket: %d "
+        "stream_entries_to_socket: %d do_screenshot: %d is_remote_mode: %d show_header_only: %d telephony_only: %d "
         "wifi_only: %d do_progress_updates: %d fd: %d bugreport_mode: %s dumpstate_hal_mode: %s "
         "limited_only: %d args: %s\n",
         options.do_vibrate, options.stream_to_socket, options.progress_updates_to_socket,
-        options.do_screenshot, options.is_remote_mode, options.show_header_only,
+        options.stream_entries_to_socket, options.do_screenshot, options.is_remote_mode, options.show_header_only,
         options.telephony_only, options.wifi_only,
         options.do_progress_updates, options.bugreport_fd.get(), options.bugreport_mode.c_str(),
         toString(options.dumpstate_hal_mode).c_str(), options.limited_only, options.args.c_str());
@@ -2618,12 +2677,13 @@ void Dumpstate::DumpOptions::Initialize(BugreportMode bugreport_mode,
 Dumpstate::RunStatus Dumpstate::DumpOptions::Initialize(int argc, char* argv[]) {
     RunStatus status = RunStatus::OK;
     int c;
-    while ((c = getopt(argc, argv, "dho:svqzpLPBRSV:w")) != -1) {
+    while ((c = getopt(argc, argv, "cdho:svqzpLPBRSV:w")) != -1) {
         switch (c) {
             // clang-format off
             case 'o': out_dir = optarg;              break;
             case 's': stream_to_socket = true;       break;
             case 'S': progress_updates_to_socket = true;    break;
+            case 'c': stream_entries_to_socket = true;      break;
             case 'v': show_header_only = true;       break;
             case 'q': do_vibrate = false;            break;
             case 'p': do_screenshot = true;          break;
@@ -2674,6 +2734,13 @@ bool Dumpstate::DumpOptions::ValidateOptions() const {
     if (is_remote_mode && (do_progress_updates || stream_to_socket)) {
         return false;
     }
+
+    // The streamed entries would be interleaved with the other uses of the socket.
+    if (stream_entries_to_socket &&
+        (bugreport_fd.get() != -1 || stream_to_socket || progress_updates_to_socket ||
+         do_progress_updates)) {
+        return false;
+    }
     return true;
 }
 
@@ -2821,7 +2888,8 @@ Dumpstate::RunStatus Dumpstate::RunInternal(int32_t calling_uid,
 
     // If we are going to use a socket, do it as early as possible
     // to avoid timeouts from bugreport.
-    if (options_->stream_to_socket || options_->progress_updates_to_socket) {
+    if (options_->stream_to_socket || options_->progress_updates_to_socket ||
+        options_->stream_entries_to_socket) {
         MYLOGD("Opening control socket\n");
         control_socket_fd_ = open_socket_fn_("dumpstate");
         if (control_socket_fd_ == -1) {
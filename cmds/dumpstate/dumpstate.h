@@ -293,6 +293,18 @@ class Dumpstate {
      */
     void AddDir(const std::string& dir, bool recursive);
 
+    /*
+     * Starts the frames of a zip entry on the control socket, if the zip entries are streamed.
+     * See "Streamed entries" in bugreport-format.md.
+     */
+    void StreamEntryStart(const std::string& entry_name);
+
+    /*
+     * Writes |size| bytes of the current zip entry to the control socket, if the zip entries
+     * are streamed. A |size| of 0 ends the entry.
+     */
+    void StreamEntryData(const void* data, size_t size);
+
     /*
      * Takes a screenshot and save it to the given `path`.
      *
@@ -395,6 +407,8 @@ class Dumpstate {
         bool stream_to_socket = false;
         // Writes generation progress updates to a socket.
         bool progress_updates_to_socket = false;
+        // Writes each zip entry to a socket as soon as it's added to the bugreport.
+        bool stream_entries_to_socket = false;
         bool do_screenshot = false;
         bool is_screenshot_copied = false;
         bool is_remote_mode = false;
@@ -31,6 +31,7 @@
 #include <signal.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <mutex>
 #include <thread>
 
 #include <android-base/file.h>
@@ -486,6 +487,18 @@ TEST_F(DumpOptionsTest, ValidateOptionsSocketUsage2) {
     EXPECT_TRUE(options_.ValidateOptions());
 }
 
+TEST_F(DumpOptionsTest, ValidateOptionsSocketUsage3) {
+    options_.stream_entries_to_socket = true;
+    EXPECT_TRUE(options_.ValidateOptions());
+
+    options_.stream_to_socket = true;
+    EXPECT_FALSE(options_.ValidateOptions());
+
+    options_.stream_to_socket = false;
+    options_.progress_updates_to_socket = true;
+    EXPECT_FALSE(options_.ValidateOptions());
+}
+
 TEST_F(DumpOptionsTest, ValidateOptionsRemoteMode) {
     options_.do_progress_updates = true;
     options_.is_remote_mode = true;
@@ -1762,6 +1775,40 @@ TEST_F(DumpPoolTest, EnqueueTask_withDurationLog) {
     EXPECT_THAT(getTempFileCounts(kTestDataPath), Eq(0));
 }
 
+TEST_F(DumpPoolTest, EnqueueTaskWithFdAndOptions) {
+    std::mutex lock;
+    std::string order;
+    auto dump_func = [&](const std::string& name, int out_fd) {
+        std::lock_guard<std::mutex> guard(lock);
+        order += name;
+        dprintf(out_fd, "%s", name.c_str());
+    };
+    setLogDuration(/* log_duration = */false);
+    dump_pool_->start(/* thread_counts = */1);
+    dump_pool_->enqueueTaskWithFdAndOptions(/* task_name = */"1", {2, {}},
+            dump_func, "1", std::placeholders::_1);
+    dump_pool_->enqueueTaskWithFdAndOptions(/* task_name = */"2", {0, {"1", "unknown"}},
+            dump_func, "2", std::placeholders::_1);
+    dump_pool_->enqueueTaskWithFd(/* task_name = */"3", dump_func, "3", std::placeholders::_1);
+    dump_pool_->enqueueTaskWithFdAndOptions(/* task_name = */"4", {1, {}},
+            dump_func, "4", std::placeholders::_1);
+
+    dump_pool_->waitForTask("1", "", out_fd_.get());
+    dump_pool_->waitForTask("2", "", out_fd_.get());
+    dump_pool_->waitForTask("3", "", out_fd_.get());
+    dump_pool_->waitForTask("4", "", out_fd_.get());
+    dump_pool_->shutdown();
+
+    // Task 4 overtakes tasks 2 and 3, and task 2 waits for task 1 but keeps its
+    // place ahead of task 3. The results are dumped in the order they are
+    // waited for.
+    EXPECT_THAT(order, StrEq("1423"));
+    std::string result;
+    ReadFileToString(out_path_, &result);
+    EXPECT_THAT(result, StrEq("1\n2\n3\n4\n"));
+    EXPECT_THAT(getTempFileCounts(kTestDataPath), Eq(0));
+}
+
 TEST_F(DumpPoolTest, Shutdown_withoutCrash) {
     bool run_1 = false;
     auto dump_func_1 = [&]() {
@@ -15,9 +15,14 @@
  */
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <functional>
 #include <iomanip>
+#include <mutex>
 #include <thread>
+#include <vector>
 
 #include <android-base/file.h>
 #include <android-base/stringprintf.h>
@@ -37,6 +42,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/poll.h>
 #include <sys/socket.h>
 #include <sys/time.h>
@@ -62,13 +68,14 @@ static void usage() {
             "usage: dumpsys\n"
             "         To dump all services.\n"
             "or:\n"
-            "       dumpsys [-t TIMEOUT] [--priority LEVEL] [--pid] [--thread] [--help | -l | "
-            "--skip SERVICES "
-            "| SERVICE [ARGS]]\n"
+            "       dumpsys [-t TIMEOUT] [--priority LEVEL] [--pid] [--thread] [--binder-stats] "
+            "[--parallel N] [--help | -l | --skip SERVICES | SERVICE [ARGS]]\n"
             "         --help: shows this help\n"
             "         -l: only list services, do not dump them\n"
             "         -t TIMEOUT_SEC: TIMEOUT to use in seconds instead of default 10 seconds\n"
             "         -T TIMEOUT_MS: TIMEOUT to use in milliseconds instead of default 10 seconds\n"
+            "         --parallel N: dump up to N services at the same time. The dumps are\n"
+            "               still written in order, and their durations summarized on stderr\n"
             "         --pid: dump PID instead of usual dump\n"
             "         --proto: filter services that support dumping data in proto format. Dumps\n"
             "               will be in proto format.\n"
@@ -77,6 +84,8 @@ static void usage() {
             "         --skip SERVICES: dumps all services but SERVICES (comma-separated list)\n"
             "         --stability: dump binder stability information instead of usual dump\n"
             "         --thread: dump thread usage instead of usual dump\n"
+            "         --binder-stats: dump binder transaction latency of the server instead of\n"
+            "               usual dump. With ARGS enable, disable or reset, changes them first\n"
             "         SERVICE [ARGS]: dumps only service SERVICE, optionally passing ARGS to it\n");
 }
 
@@ -130,7 +139,10 @@ int Dumpsys::main(int argc, char* const argv[]) {
     Type type = Type::DUMP;
     int timeoutArgMs = 10000;
     int priorityFlags = IServiceManager::DUMP_FLAG_PRIORITY_ALL;
-    static struct option longOptions[] = {{"help", no_argument, 0, 0},
+    int maxParallelDumps = 1;
+    static struct option longOptions[] = {{"binder-stats", no_argument, 0, 0},
+                                          {"help", no_argument, 0, 0},
+                                          {"parallel", required_argument, 0, 0},
                                           {"pid", no_argument, 0, 0},
                                           {"priority", required_argument, 0, 0},
                                           {"proto", no_argument, 0, 0},
@@ -168,12 +180,21 @@ int Dumpsys::main(int argc, char* const argv[]) {
                     usage();
                     return -1;
                 }
+            } else if (!strcmp(longOptions[optionIndex].name, "parallel")) {
+                char* endptr;
+                maxParallelDumps = strtol(optarg, &endptr, 10);
+                if (*endptr != '\0' || maxParallelDumps <= 0) {
+                    fprintf(stderr, "Error: invalid number of parallel dumps: '%s'\n", optarg);
+                    return -1;
+                }
             } else if (!strcmp(longOptions[optionIndex].name, "pid")) {
                 type = Type::PID;
             } else if (!strcmp(longOptions[optionIndex].name, "stability")) {
                 type = Type::STABILITY;
             } else if (!strcmp(longOptions[optionIndex].name, "thread")) {
                 type = Type::THREAD;
+            } else if (!strcmp(longOptions[optionIndex].name, "binder-stats")) {
+                type = Type::BINDER_STATS;
             }
             break;
 
@@ -259,6 +280,19 @@ int Dumpsys::main(int argc, char* const argv[]) {
         return 0;
     }
 
+    if (maxParallelDumps > 1 && N > 1) {
+        Vector<String16> dumpedServices;
+        for (const auto& serviceName : services) {
+            if (!IsSkipped(skippedServices, serviceName)) {
+                dumpedServices.add(serviceName);
+            }
+        }
+        dumpServicesInParallel(type, dumpedServices, args, priorityFlags,
+                               std::chrono::milliseconds(timeoutArgMs), asProto,
+                               maxParallelDumps);
+        return 0;
+    }
+
     for (size_t i = 0; i < N; i++) {
         const String16& serviceName = services[i];
         if (IsSkipped(skippedServices, serviceName)) continue;
@@ -292,6 +326,133 @@ int Dumpsys::main(int argc, char* const argv[]) {
     return 0;
 }
 
+void Dumpsys::dumpServicesToBuffers(Type type, const Vector<String16>& services,
+                                    const Vector<String16>& args,
+                                    std::chrono::milliseconds timeout, bool asProto,
+                                    int maxThreads,
+                                    const std::function<bool(size_t, BufferedDump&)>& onDump) {
+    const size_t N = services.size();
+    std::vector<BufferedDump> dumps(N);
+    std::vector<bool> done(N, false);
+    std::mutex lock;
+    std::condition_variable doneCondition;
+    std::atomic<size_t> nextService(0);
+    std::atomic<bool> stopped(false);
+
+    // Each thread dumps one service at a time, through its own Dumpsys since the dump thread
+    // and its pipe are members.
+    auto dumpServices = [&]() {
+        Dumpsys dumpsys(sm_);
+        for (size_t i = nextService++; i < N && !stopped; i = nextService++) {
+            BufferedDump& dump = dumps[i];
+            dump.buffer.reset(memfd_create("dumpsys", MFD_CLOEXEC));
+            if (dump.buffer == -1) {
+                std::cerr << "Failed to create buffer to dump service info for " << services[i]
+                          << ": " << strerror(errno) << std::endl;
+                dump.startStatus = -errno;
+            } else {
+                dump.startStatus = dumpsys.startDumpThread(type, services[i], args);
+            }
+            if (dump.startStatus == OK) {
+                dump.status = dumpsys.writeDump(dump.buffer.get(), services[i], timeout, asProto,
+                                                dump.elapsedDuration, dump.bytesWritten);
+                dumpsys.stopDumpThread(dump.status == OK);
+                if (lseek(dump.buffer.get(), 0, SEEK_SET) != 0) {
+                    dump.status = -errno;
+                }
+            }
+            std::lock_guard<std::mutex> guard(lock);
+            done[i] = true;
+            doneCondition.notify_all();
+        }
+    };
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < std::min(static_cast<size_t>(maxThreads), N); i++) {
+        threads.emplace_back(dumpServices);
+    }
+
+    for (size_t i = 0; i < N; i++) {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            doneCondition.wait(guard, [&done, i]() { return done[i]; });
+        }
+        bool keepGoing = onDump(i, dumps[i]);
+        dumps[i].buffer.reset();
+        if (!keepGoing) {
+            stopped = true;
+            break;
+        }
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+static bool copyBufferToFd(int bufferFd, int fd) {
+    char buf[65536];
+    while (true) {
+        ssize_t rc = TEMP_FAILURE_RETRY(read(bufferFd, buf, sizeof(buf)));
+        if (rc <= 0) {
+            return rc == 0;
+        }
+        if (!WriteFully(fd, buf, rc)) {
+            return false;
+        }
+    }
+}
+
+void Dumpsys::dumpServicesInParallel(Type type, const Vector<String16>& services,
+                                     const Vector<String16>& args, int priorityFlags,
+                                     std::chrono::milliseconds timeout, bool asProto,
+                                     int maxThreads) {
+    struct DumpDuration {
+        size_t index;
+        std::chrono::duration<double> elapsedDuration;
+        size_t bytesWritten;
+        bool timedOut;
+    };
+    std::vector<DumpDuration> durations;
+    auto start = std::chrono::steady_clock::now();
+
+    dumpServicesToBuffers(type, services, args, timeout, asProto, maxThreads,
+                          [&](size_t i, BufferedDump& dump) {
+        if (dump.startStatus != OK) {
+            return true;
+        }
+        writeDumpHeader(STDOUT_FILENO, services[i], priorityFlags);
+        if (!copyBufferToFd(dump.buffer.get(), STDOUT_FILENO)) {
+            std::cerr << "Failed to write dump of service " << services[i] << ": "
+                      << strerror(errno) << std::endl;
+        }
+        if (dump.status == TIMED_OUT) {
+            std::cout << std::endl
+                 << "*** SERVICE '" << services[i] << "' DUMP TIMEOUT (" << timeout.count()
+                 << "ms) EXPIRED ***" << std::endl
+                 << std::endl;
+        }
+        writeDumpFooter(STDOUT_FILENO, services[i], dump.elapsedDuration);
+        durations.push_back(
+                {i, dump.elapsedDuration, dump.bytesWritten, dump.status == TIMED_OUT});
+        return true;
+    });
+
+    std::chrono::duration<double> elapsedDuration = std::chrono::steady_clock::now() - start;
+    std::sort(durations.begin(), durations.end(),
+              [](const DumpDuration& lhs, const DumpDuration& rhs) {
+                  return lhs.elapsedDuration > rhs.elapsedDuration;
+              });
+    std::string summary = StringPrintf("Dumped %zu services on %zu threads in %.3fs:\n",
+                                       durations.size(),
+                                       std::min(static_cast<size_t>(maxThreads), services.size()),
+                                       elapsedDuration.count());
+    for (const auto& duration : durations) {
+        StringAppendF(&summary, "  %.3fs %zu bytes %s%s\n", duration.elapsedDuration.count(),
+                      duration.bytesWritten, String8(services[duration.index]).c_str(),
+                      duration.timedOut ? " (timed out)" : "");
+    }
+    WriteStringToFd(summary, STDERR_FILENO);
+}
+
 Vector<String16> Dumpsys::listServices(int priorityFilterFlags, bool filterByProto) const {
     Vector<String16> services = sm_->listServices(priorityFilterFlags);
     services.sort(sort_func);
@@ -362,6 +523,28 @@ static status_t dumpThreadsToFd(const sp<IBinder>& service, const unique_fd& fd)
     return OK;
 }
 
+static status_t dumpBinderStatsToFd(const sp<IBinder>& service, const Vector<String16>& args,
+                                    const unique_fd& fd) {
+    int32_t command = IBinder::BINDER_STATS_DUMP;
+    if (!args.empty()) {
+        if (args[0] == String16("enable")) {
+            command = IBinder::BINDER_STATS_ENABLE;
+        } else if (args[0] == String16("disable")) {
+            command = IBinder::BINDER_STATS_DISABLE;
+        } else if (args[0] == String16("reset")) {
+            command = IBinder::BINDER_STATS_RESET;
+        }
+    }
+
+    std::string stats;
+    status_t status = service->getBinderStats(command, &stats);
+    if (status != OK) {
+        return status;
+    }
+    WriteStringToFd(stats, fd.get());
+    return OK;
+}
+
 status_t Dumpsys::startDumpThread(Type type, const String16& serviceName,
                                   const Vector<String16>& args) {
     sp<IBinder> service = sm_->checkService(serviceName);
@@ -398,6 +581,9 @@ status_t Dumpsys::startDumpThread(Type type, const String16& serviceName,
         case Type::THREAD:
             err = dumpThreadsToFd(service, remote_end);
             break;
+        case Type::BINDER_STATS:
+            err = dumpBinderStatsToFd(service, args, remote_end);
+            break;
         default:
             std::cerr << "Unknown dump type" << static_cast<int>(type) << std::endl;
             return;
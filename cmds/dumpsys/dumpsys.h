@@ -17,6 +17,8 @@
 #ifndef FRAMEWORK_NATIVE_CMD_DUMPSYS_H_
 #define FRAMEWORK_NATIVE_CMD_DUMPSYS_H_
 
+#include <chrono>
+#include <functional>
 #include <thread>
 
 #include <android-base/unique_fd.h>
@@ -56,6 +58,7 @@ class Dumpsys {
         PID,       // dump pid of server only
         STABILITY, // dump stability information of server
         THREAD,    // dump thread usage of server only
+        BINDER_STATS, // dump (or enable, disable, reset) transaction latency stats of server
     };
 
     /**
@@ -115,6 +118,32 @@ class Dumpsys {
      */
     void stopDumpThread(bool dumpComplete);
 
+    /**
+     * Dump of a service written by {@code dumpServicesToBuffers}.
+     */
+    struct BufferedDump {
+        // Buffer holding the dump, positioned at its start.
+        android::base::unique_fd buffer;
+        // Status of creating the buffer and starting the dump thread. Nothing else is set
+        // unless it's {@code OK}.
+        status_t startStatus = OK;
+        // Status of {@code writeDump}.
+        status_t status = OK;
+        std::chrono::duration<double> elapsedDuration{0};
+        size_t bytesWritten = 0;
+    };
+
+    /**
+     * Dumps services on up to {@code maxThreads} threads, each into its own buffer. Calls
+     * {@code onDump} on this thread with the index of each service in {@code services}, in
+     * order, as soon as its dump is done. If {@code onDump} returns {@code false}, the
+     * services left aren't dumped.
+     */
+    void dumpServicesToBuffers(Type type, const Vector<String16>& services,
+                               const Vector<String16>& args, std::chrono::milliseconds timeout,
+                               bool asProto, int maxThreads,
+                               const std::function<bool(size_t, BufferedDump&)>& onDump);
+
     /**
      * Returns file descriptor of the pipe used to dump service data. This assumes
      * {@code startDumpThread} was called successfully.
@@ -124,6 +153,16 @@ class Dumpsys {
     }
 
   private:
+    /**
+     * Dumps services on up to {@code maxThreads} threads, each into its own buffer, and writes
+     * the dumps to stdout in the order of {@code services}, with the same sections as a
+     * sequential dump. The duration of each dump is summarized on stderr.
+     */
+    void dumpServicesInParallel(Type type, const Vector<String16>& services,
+                                const Vector<String16>& args, int priorityFlags,
+                                std::chrono::milliseconds timeout, bool asProto,
+                                int maxThreads);
+
     android::IServiceManager* sm_;
     std::thread activeThread_;
     mutable android::base::unique_fd redirectFd_;
@@ -447,6 +447,24 @@ TEST_F(DumpsysTest, DumpMultipleServices) {
     AssertDumped("running3", "dump3");
 }
 
+// Tests 'dumpsys --parallel 2' with a slow service, whose dump should stay in order
+TEST_F(DumpsysTest, DumpMultipleServicesInParallel) {
+    ExpectListServices({"running1", "stopped2", "running3", "running4"});
+    ExpectDumpAndHang("running1", 1, "dump1");
+    ExpectCheckService("stopped2", false);
+    ExpectDump("running3", "dump3");
+    ExpectDump("running4", "dump4");
+
+    CallMain({"--parallel", "2"});
+
+    AssertRunningServices({"running1", "running3", "running4"});
+    AssertOutputFormat("(.|\n)*DUMP OF SERVICE running1:\ndump1(.|\n)*"
+                       "DUMP OF SERVICE running3:\ndump3(.|\n)*"
+                       "DUMP OF SERVICE running4:\ndump4(.|\n)*");
+    AssertDumped("running1", "dump1");
+    AssertStopped("stopped2");
+}
+
 // Tests 'dumpsys --skip skipped3 skipped5', which should skip these services
 TEST_F(DumpsysTest, DumpWithSkip) {
     ExpectListServices({"running1", "stopped2", "skipped3", "running4", "skipped5"});
@@ -627,6 +645,25 @@ TEST_F(DumpsysTest, ListServiceWithThread) {
     AssertOutputFormat(format);
 }
 
+// Tests 'dumpsys --binder-stats service_name'
+TEST_F(DumpsysTest, ListServiceWithBinderStats) {
+    ExpectCheckService("Locksmith");
+
+    CallMain({"--binder-stats", "Locksmith"});
+
+    AssertOutputContains("Binder stats (disabled)");
+}
+
+// Tests 'dumpsys --binder-stats service_name enable'
+TEST_F(DumpsysTest, EnableBinderStats) {
+    ExpectCheckService("Locksmith");
+
+    CallMain({"--binder-stats", "Locksmith", "enable"});
+    AssertOutputContains("Binder stats (enabled)");
+
+    CallMain({"--binder-stats", "Locksmith", "disable"});
+}
+
 TEST_F(DumpsysTest, GetBytesWritten) {
     const char* serviceName = "service2";
     const char* dumpContents = "dump1";
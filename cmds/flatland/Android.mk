@@ -6,6 +6,7 @@ LOCAL_SRC_FILES:=   \
     Composers.cpp   \
     GLHelper.cpp    \
     Renderers.cpp   \
+    SurfaceFlingerBenchmark.cpp \
     Main.cpp        \
 
 LOCAL_CFLAGS := -Wall -Werror
@@ -23,6 +24,7 @@ LOCAL_MODULE_STEM_32 := flatland
 LOCAL_MODULE_STEM_64 := flatland64
 LOCAL_SHARED_LIBRARIES := \
     libEGL      \
+    libbinder   \
     libGLESv2   \
     libcutils   \
     libgui      \
@@ -68,4 +68,17 @@ public:
 
 Renderer* staticGradient();
 
+// A scene composed by SurfaceFlinger rather than by flatland itself.
+struct SfBenchmarkDesc {
+    size_t numLayers;
+    uint32_t numFrames;
+    int blurRadius;
+    float cornerRadius;
+    float shadowRadius;
+};
+
+// Posts new buffers to the layers of the scene every frame, and prints the
+// composition costs recorded by SurfaceFlinger's TimeStats.
+bool runSurfaceFlingerBenchmark(const SfBenchmarkDesc& desc);
+
 } // namespace android
@@ -37,6 +37,8 @@ using namespace ::android;
 static uint32_t g_SleepBetweenSamplesMs = 0;
 static bool     g_PresentToWindow       = false;
 static size_t   g_BenchmarkNameLen      = 0;
+static bool     g_SurfaceFlinger        = false;
+static SfBenchmarkDesc g_SfBenchmark    = { 4, 300, 0, 0.0f, 0.0f };
 
 struct BenchmarkDesc {
     // The name of the test.
@@ -723,6 +725,13 @@ static void showHelp(const char *cmd) {
     fprintf(stderr, "options include:\n"
                     "  -s N            sleep for N ms between samples\n"
                     "  -d              display the test frame to a window\n"
+                    "  --sf            benchmark SurfaceFlinger composition of a scene\n"
+                    "                  set up by the following options\n"
+                    "  --layers N      number of layers of the --sf scene (default 4)\n"
+                    "  --frames N      number of frames to measure with --sf (default 300)\n"
+                    "  --blur R        background blur radius of the --sf layers\n"
+                    "  --corner R      corner radius of the --sf layers\n"
+                    "  --shadow R      shadow radius of the --sf layers\n"
                     "  --help          print this helpful message and exit\n"
             );
 }
@@ -738,6 +747,12 @@ int main(int argc, char** argv) {
         int option_index = 0;
         static struct option long_options[] = {
             {"help",     no_argument, 0,  0 },
+            {"sf",       no_argument,       0, 'S' },
+            {"layers",   required_argument, 0, 'L' },
+            {"frames",   required_argument, 0, 'F' },
+            {"blur",     required_argument, 0, 'B' },
+            {"corner",   required_argument, 0, 'C' },
+            {"shadow",   required_argument, 0, 'W' },
             {     0,               0, 0,  0 }
         };
 
@@ -757,6 +772,30 @@ int main(int argc, char** argv) {
                 g_SleepBetweenSamplesMs = atoi(optarg);
             break;
 
+            case 'S':
+                g_SurfaceFlinger = true;
+            break;
+
+            case 'L':
+                g_SfBenchmark.numLayers = atoi(optarg);
+            break;
+
+            case 'F':
+                g_SfBenchmark.numFrames = atoi(optarg);
+            break;
+
+            case 'B':
+                g_SfBenchmark.blurRadius = atoi(optarg);
+            break;
+
+            case 'C':
+                g_SfBenchmark.cornerRadius = atof(optarg);
+            break;
+
+            case 'W':
+                g_SfBenchmark.shadowRadius = atof(optarg);
+            break;
+
             case 0:
                 if (strcmp(long_options[option_index].name, "help")) {
                     showHelp(argv[0]);
@@ -778,6 +817,14 @@ int main(int argc, char** argv) {
     }
     printf("\n");
 
+    if (g_SurfaceFlinger) {
+        if (!runSurfaceFlingerBenchmark(g_SfBenchmark)) {
+            fprintf(stderr, "exiting due to error.\n");
+            return 1;
+        }
+        return 0;
+    }
+
     if (!runTests()) {
         fprintf(stderr, "exiting due to error.\n");
         return 1;
@@ -0,0 +1,309 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define ATRACE_TAG ATRACE_TAG_ALWAYS
+
+#include <binder/IServiceManager.h>
+#include <gui/SurfaceComposerClient.h>
+#include <gui/SurfaceControl.h>
+#include <ui/DisplayConfig.h>
+#include <ui/GraphicBuffer.h>
+#include <utils/Trace.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "Flatland.h"
+
+namespace android {
+
+// Prefix of the names of the benchmark layers, used to find their TimeStats.
+static const char kLayerNamePrefix[] = "FlatlandSF";
+
+struct SfLayer {
+    sp<SurfaceControl> surfaceControl;
+    // Buffers posted in turn, so that every frame latches a new one.
+    sp<GraphicBuffer> buffers[2];
+};
+
+// Runs "dumpsys SurfaceFlinger --timestats <args>" and returns its output in
+// result.
+static bool timeStats(const char* args, std::string* result) {
+    sp<IBinder> sf = defaultServiceManager()->checkService(String16("SurfaceFlinger"));
+    if (sf == nullptr) {
+        fprintf(stderr, "SurfaceFlinger service not found.\n");
+        return false;
+    }
+
+    Vector<String16> dumpArgs;
+    dumpArgs.add(String16("--timestats"));
+    char argsCopy[64];
+    strlcpy(argsCopy, args, sizeof(argsCopy));
+    char* save = nullptr;
+    for (char* arg = strtok_r(argsCopy, " ", &save); arg != nullptr;
+            arg = strtok_r(nullptr, " ", &save)) {
+        dumpArgs.add(String16(arg));
+    }
+
+    int fd = memfd_create("flatland_timestats", MFD_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "memfd_create error: %s\n", strerror(errno));
+        return false;
+    }
+    status_t err = sf->dump(fd, dumpArgs);
+    if (err != NO_ERROR) {
+        fprintf(stderr, "SurfaceFlinger TimeStats dump error: %#x\n", err);
+        close(fd);
+        return false;
+    }
+
+    result->clear();
+    char buf[4096];
+    ssize_t n;
+    lseek(fd, 0, SEEK_SET);
+    while ((n = read(fd, buf, sizeof(buf))) > 0) {
+        result->append(buf, n);
+    }
+    close(fd);
+    return true;
+}
+
+// Returns the value of the first "name = value" line of text found between
+// begin and end, or -1 if there is none.
+static double findValue(const std::string& text, const char* name,
+        size_t begin = 0, size_t end = std::string::npos) {
+    std::string key = std::string("\n") + name + " = ";
+    size_t pos = text.find(key, begin);
+    if (pos == std::string::npos || pos >= end) {
+        return -1.0;
+    }
+    return strtod(text.c_str() + pos + key.size(), nullptr);
+}
+
+// Adds the samples of the "name" histogram found between begin and end, whose
+// buckets are printed as "<ms>ms=<count>", to totalMs and count.
+static void addHistogram(const std::string& text, const char* name,
+        size_t begin, size_t end, double* totalMs, int64_t* count) {
+    std::string key = std::string(name) + " histogram is as below:\n";
+    size_t pos = text.find(key, begin);
+    if (pos == std::string::npos || pos >= end) {
+        return;
+    }
+
+    const char* p = text.c_str() + pos + key.size();
+    while (*p != '\0' && *p != '\n') {
+        char* next;
+        long bucketMs = strtol(p, &next, 10);
+        if (strncmp(next, "ms=", 3) != 0) {
+            break;
+        }
+        long bucketCount = strtol(next + 3, &next, 10);
+        *totalMs += double(bucketMs) * bucketCount;
+        *count += bucketCount;
+        p = next;
+        while (*p == ' ') {
+            p++;
+        }
+    }
+}
+
+static bool setUpLayer(const sp<SurfaceComposerClient>& client,
+        const SfBenchmarkDesc& desc, size_t index, const Rect& frame,
+        SfLayer* layer) {
+    String8 name = String8::format("%s%zu", kLayerNamePrefix, index);
+    layer->surfaceControl = client->createSurface(name, frame.getWidth(),
+            frame.getHeight(), PIXEL_FORMAT_RGBA_8888,
+            ISurfaceComposerClient::eFXSurfaceBufferState);
+    if (layer->surfaceControl == nullptr || !layer->surfaceControl->isValid()) {
+        fprintf(stderr, "Failed to create SurfaceControl.\n");
+        return false;
+    }
+
+    // Fill each layer with a translucent color of its own, so that the
+    // layers below stay visible and have to be blended.
+    const uint32_t colors[] = { 0xc0e0a040, 0xc040e0a0, 0xc0a040e0 };
+    for (size_t i = 0; i < NELEMS(layer->buffers); i++) {
+        sp<GraphicBuffer> buffer = new GraphicBuffer(frame.getWidth(),
+                frame.getHeight(), PIXEL_FORMAT_RGBA_8888, 1,
+                GraphicBuffer::USAGE_SW_WRITE_OFTEN |
+                GraphicBuffer::USAGE_HW_TEXTURE |
+                GraphicBuffer::USAGE_HW_COMPOSER,
+                "FlatlandSF");
+        if (buffer->initCheck() != NO_ERROR) {
+            fprintf(stderr, "GraphicBuffer allocation error: %#x\n",
+                    buffer->initCheck());
+            return false;
+        }
+
+        uint32_t* pixels = nullptr;
+        status_t err = buffer->lock(GraphicBuffer::USAGE_SW_WRITE_OFTEN,
+                reinterpret_cast<void**>(&pixels));
+        if (err != NO_ERROR) {
+            fprintf(stderr, "GraphicBuffer::lock error: %#x\n", err);
+            return false;
+        }
+        const uint32_t color = colors[(index + i) % NELEMS(colors)];
+        for (uint32_t y = 0; y < buffer->getHeight(); y++) {
+            uint32_t* row = pixels + y * buffer->getStride();
+            for (uint32_t x = 0; x < buffer->getWidth(); x++) {
+                row[x] = color;
+            }
+        }
+        buffer->unlock();
+        layer->buffers[i] = buffer;
+    }
+
+    SurfaceComposerClient::Transaction t;
+    t.setLayer(layer->surfaceControl, 0x7FFFFF00 + int32_t(index))
+            .setFrame(layer->surfaceControl, frame)
+            .setBuffer(layer->surfaceControl, layer->buffers[0])
+            .show(layer->surfaceControl);
+    if (desc.blurRadius > 0) {
+        t.setBackgroundBlurRadius(layer->surfaceControl, desc.blurRadius);
+    }
+    if (desc.cornerRadius > 0.0f) {
+        t.setCornerRadius(layer->surfaceControl, desc.cornerRadius);
+    }
+    if (desc.shadowRadius > 0.0f) {
+        t.setShadowRadius(layer->surfaceControl, desc.shadowRadius);
+    }
+    t.apply(true);
+
+    return true;
+}
+
+// Posts a new buffer to every layer, and waits for SurfaceFlinger to apply
+// them, so that each frame is composed once.
+static void doSfFrame(SfLayer* layers, size_t numLayers, uint32_t frame) {
+    ATRACE_CALL();
+
+    SurfaceComposerClient::Transaction t;
+    for (size_t i = 0; i < numLayers; i++) {
+        t.setBuffer(layers[i].surfaceControl,
+                layers[i].buffers[frame % NELEMS(layers[i].buffers)]);
+    }
+    t.apply(true);
+}
+
+bool runSurfaceFlingerBenchmark(const SfBenchmarkDesc& desc) {
+    ATRACE_CALL();
+
+    if (desc.numLayers == 0 || desc.numLayers > MAX_NUM_LAYERS) {
+        fprintf(stderr, "The number of layers must be between 1 and %d.\n",
+                MAX_NUM_LAYERS);
+        return false;
+    }
+
+    sp<SurfaceComposerClient> client = new SurfaceComposerClient;
+    status_t err = client->initCheck();
+    if (err != NO_ERROR) {
+        fprintf(stderr, "SurfaceComposerClient::initCheck error: %#x\n", err);
+        return false;
+    }
+
+    const sp<IBinder> dpy = SurfaceComposerClient::getInternalDisplayToken();
+    if (dpy == nullptr) {
+        fprintf(stderr, "SurfaceComposer::getInternalDisplayToken failed.\n");
+        return false;
+    }
+    DisplayConfig config;
+    err = SurfaceComposerClient::getActiveDisplayConfig(dpy, &config);
+    if (err != NO_ERROR) {
+        fprintf(stderr, "SurfaceComposer::getActiveDisplayConfig failed: %#x\n", err);
+        return false;
+    }
+
+    // Cascade the layers across the display, each covering 3/4 of it.
+    const int32_t dw = config.resolution.getWidth();
+    const int32_t dh = config.resolution.getHeight();
+    const int32_t w = dw * 3 / 4;
+    const int32_t h = dh * 3 / 4;
+    SfLayer layers[MAX_NUM_LAYERS];
+    const int32_t steps = desc.numLayers > 1 ? int32_t(desc.numLayers - 1) : 1;
+    for (size_t i = 0; i < desc.numLayers; i++) {
+        const int32_t x = (dw - w) * int32_t(i) / steps;
+        const int32_t y = (dh - h) * int32_t(i) / steps;
+        if (!setUpLayer(client, desc, i, Rect(x, y, x + w, y + h), &layers[i])) {
+            return false;
+        }
+    }
+
+    // Only the frames following the warm-up ones are accounted.
+    const uint32_t warmUpFrames = 30;
+    std::string stats;
+    for (uint32_t i = 0; i < warmUpFrames; i++) {
+        doSfFrame(layers, desc.numLayers, i);
+    }
+    if (!timeStats("-clear -enable", &stats)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < desc.numFrames; i++) {
+        doSfFrame(layers, desc.numLayers, i);
+    }
+    // Let the last frames be presented.
+    usleep(100 * 1000);
+    if (!timeStats("-dump", &stats)) {
+        return false;
+    }
+
+    // The global stats come first, followed by a section per layer starting
+    // with its uid.
+    size_t layersBegin = stats.find("\nuid = ");
+    double totalFrames = findValue(stats, "totalFrames", 0, layersBegin);
+    double missedFrames = findValue(stats, "missedFrames", 0, layersBegin);
+    double clientFrames = findValue(stats, "clientCompositionFrames", 0, layersBegin);
+    double frameDurationMs = findValue(stats, "averageFrameDuration", 0, layersBegin);
+    double renderEngineMs = findValue(stats, "averageRenderEngineTiming", 0, layersBegin);
+    if (totalFrames <= 0) {
+        fprintf(stderr, "No frames recorded by TimeStats.\n");
+        return false;
+    }
+
+    double postToPresentMs = 0.0;
+    int64_t postToPresentCount = 0;
+    const std::string layerName = std::string("\nlayerName = ") + kLayerNamePrefix;
+    for (size_t pos = stats.find(layerName); pos != std::string::npos;
+            pos = stats.find(layerName, pos + 1)) {
+        size_t end = stats.find("\nuid = ", pos);
+        addHistogram(stats, "post2present", pos, end, &postToPresentMs,
+                &postToPresentCount);
+    }
+
+    printf(" %zu layers | blur %d | corner radius %.1f | shadow %.1f\n",
+            desc.numLayers, desc.blurRadius, desc.cornerRadius, desc.shadowRadius);
+    printf("   Frames                   %6.0f\n", totalFrames);
+    printf("   Missed frames            %6.0f\n", missedFrames);
+    printf("   Client composition (%%)   %6.1f\n", 100.0 * clientFrames / totalFrames);
+    printf("   SF frame duration (ms)   %6.3f\n", frameDurationMs);
+    printf("   RenderEngine (ms)        %6.3f\n", renderEngineMs);
+    if (postToPresentCount > 0) {
+        printf("   Post to present (ms)     %6.3f\n",
+                postToPresentMs / double(postToPresentCount));
+    } else {
+        printf("   Post to present (ms)        n/a\n");
+    }
+    fflush(stdout);
+
+    return true;
+}
+
+} // namespace android
@@ -19,6 +19,7 @@
 #include "CacheTracker.h"
 
 #include <fts.h>
+#include <string.h>
 #include <sys/xattr.h>
 #include <utils/Trace.h>
 
@@ -161,13 +162,22 @@ void CacheTracker::loadItemsFrom(const std::string& path) {
     fts_close(fts);
 }
 
+std::vector<std::string> CacheTracker::getCachePaths() {
+    std::vector<std::string> cachePaths;
+    for (const auto& path : mDataPaths) {
+        cachePaths.push_back(read_path_inode(path, "cache", kXattrInodeCache));
+        cachePaths.push_back(read_path_inode(path, "code_cache", kXattrInodeCodeCache));
+    }
+    return cachePaths;
+}
+
 void CacheTracker::loadItems() {
     items.clear();
+    mItemsLoadedTime = std::chrono::steady_clock::now();
 
     ATRACE_BEGIN("loadItems");
-    for (const auto& path : mDataPaths) {
-        loadItemsFrom(read_path_inode(path, "cache", kXattrInodeCache));
-        loadItemsFrom(read_path_inode(path, "code_cache", kXattrInodeCodeCache));
+    for (const auto& path : getCachePaths()) {
+        loadItemsFrom(path);
     }
     ATRACE_END();
 
@@ -196,6 +206,72 @@ void CacheTracker::ensureItems() {
     }
 }
 
+/**
+ * Like ensureItems(), but reuses the items of the given index when it was
+ * saved for the same cache directories less than maxAge ago, and none of them
+ * has had entries added, removed or renamed since.
+ */
+void CacheTracker::ensureItems(const ItemIndex& index,
+        std::chrono::steady_clock::duration maxAge) {
+    if (mItemsLoaded) {
+        return;
+    } else {
+        if (!restoreItems(index, maxAge)) {
+            loadItems();
+        }
+        mItemsLoaded = true;
+    }
+}
+
+bool CacheTracker::restoreItems(const ItemIndex& index,
+        std::chrono::steady_clock::duration maxAge) {
+    if (std::chrono::steady_clock::now() - index.loadedTime > maxAge) {
+        return false;
+    }
+    if (index.cachePaths != getCachePaths()) {
+        return false;
+    }
+    for (size_t i = 0; i < index.cachePaths.size(); i++) {
+        struct stat s;
+        const struct stat& saved = index.cacheStats[i];
+        if (lstat(index.cachePaths[i].c_str(), &s) != 0 || s.st_ino != saved.st_ino
+                || s.st_mtim.tv_sec != saved.st_mtim.tv_sec
+                || s.st_mtim.tv_nsec != saved.st_mtim.tv_nsec) {
+            return false;
+        }
+    }
+
+    // Items are copied rather than moved, since a no-op free only pretends to
+    // purge the ones it pops.
+    ATRACE_BEGIN("restoreItems");
+    items = index.items;
+    mItemsLoadedTime = index.loadedTime;
+    ATRACE_END();
+    return true;
+}
+
+/**
+ * Saves the items which haven't been purged into the given index. The cache
+ * directories are stamped after purging, so that the next tracker can tell
+ * whether anything else changed them since. Changes deeper in the trees don't
+ * show in those stamps, which is why the index keeps the time the items were
+ * first walked and is only trusted for a while.
+ */
+void CacheTracker::saveItems(ItemIndex* index) {
+    index->loadedTime = mItemsLoadedTime;
+    index->cachePaths = getCachePaths();
+    index->cacheStats.clear();
+    for (const auto& path : index->cachePaths) {
+        struct stat s;
+        if (lstat(path.c_str(), &s) != 0) {
+            // Stamp that will never match, so the index is rebuilt next time
+            memset(&s, 0, sizeof(s));
+        }
+        index->cacheStats.push_back(s);
+    }
+    index->items = items;
+}
+
 int CacheTracker::getCacheRatio() {
     if (cacheQuota == 0) {
         return 0;
@@ -17,9 +17,11 @@
 #ifndef ANDROID_INSTALLD_CACHE_TRACKER_H
 #define ANDROID_INSTALLD_CACHE_TRACKER_H
 
+#include <chrono>
 #include <memory>
 #include <string>
 #include <queue>
+#include <vector>
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -39,17 +41,34 @@ namespace installd {
  */
 class CacheTracker {
 public:
+    /**
+     * Items kept from an earlier load for the same UID, so that they can be
+     * purged by a later call without walking the cache directories again.
+     * Only valid while those directories themselves have not changed.
+     */
+    struct ItemIndex {
+        std::chrono::steady_clock::time_point loadedTime;
+        std::vector<std::string> cachePaths;
+        std::vector<struct stat> cacheStats;
+        std::vector<std::shared_ptr<CacheItem>> items;
+    };
+
     CacheTracker(userid_t userId, appid_t appId, const std::string& uuid);
     ~CacheTracker();
 
     std::string toString();
 
+    uid_t getUid() const { return multiuser_get_uid(mUserId, mAppId); }
+    bool itemsLoaded() const { return mItemsLoaded; }
+
     void addDataPath(const std::string& dataPath);
 
     void loadStats();
     void loadItems();
 
     void ensureItems();
+    void ensureItems(const ItemIndex& index, std::chrono::steady_clock::duration maxAge);
+    void saveItems(ItemIndex* index);
 
     int getCacheRatio();
 
@@ -62,6 +81,7 @@ private:
     userid_t mUserId;
     appid_t mAppId;
     bool mItemsLoaded;
+    std::chrono::steady_clock::time_point mItemsLoadedTime;
     const std::string& mUuid;
 
     std::vector<std::string> mDataPaths;
@@ -69,6 +89,9 @@ private:
     bool loadQuotaStats();
     void loadItemsFrom(const std::string& path);
 
+    std::vector<std::string> getCachePaths();
+    bool restoreItems(const ItemIndex& index, std::chrono::steady_clock::duration maxAge);
+
     DISALLOW_COPY_AND_ASSIGN(CacheTracker);
 };
 
@@ -19,12 +19,16 @@
 #define ATRACE_TAG ATRACE_TAG_PACKAGE_MANAGER
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <errno.h>
 #include <fstream>
 #include <fts.h>
 #include <functional>
 #include <inttypes.h>
+#include <optional>
 #include <regex>
+#include <shared_mutex>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/capability.h>
@@ -38,6 +42,7 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <sys/xattr.h>
+#include <thread>
 #include <unistd.h>
 
 #include <android-base/file.h>
@@ -114,6 +119,9 @@ static constexpr const char* kAppDataIsolationEnabledProperty = "persist.zygote.
 static constexpr const char* kMntSdcardfs = "/mnt/runtime/default/";
 static constexpr const char* kMntFuse = "/mnt/pass_through/0/";
 
+// How long cache items walked by freeCache may be reused by later calls
+static constexpr std::chrono::seconds kCacheItemIndexMaxAge(60);
+
 static std::atomic<bool> sAppDataIsolationEnabled(false);
 
 namespace {
@@ -264,6 +272,63 @@ binder::Status checkArgumentPath(const std::optional<std::string>& path) {
     }                                                       \
 }
 
+enum class LockMode { NONE, SHARED, EXCLUSIVE };
+
+// How the current thread holds InstalldNativeService::mLock
+thread_local LockMode sLockMode = LockMode::NONE;
+
+/**
+ * Locks mLock for the scope of a call, unless the calling thread already holds
+ * it from an outer call. Calls that only need it shared may be nested in calls
+ * holding it exclusively, but not the other way round.
+ */
+class ScopedGlobalLock {
+public:
+    ScopedGlobalLock(std::shared_mutex& lock, LockMode mode) : mLock(lock), mOuter(sLockMode) {
+        if (mOuter == LockMode::NONE) {
+            if (mode == LockMode::EXCLUSIVE) {
+                mLock.lock();
+            } else {
+                mLock.lock_shared();
+            }
+            sLockMode = mode;
+        } else {
+            CHECK(mode != LockMode::EXCLUSIVE || mOuter == LockMode::EXCLUSIVE)
+                    << "Exclusive installd lock nested in a shared one";
+        }
+    }
+
+    ~ScopedGlobalLock() {
+        if (mOuter == LockMode::NONE) {
+            if (sLockMode == LockMode::EXCLUSIVE) {
+                mLock.unlock();
+            } else {
+                mLock.unlock_shared();
+            }
+            sLockMode = LockMode::NONE;
+        }
+    }
+
+private:
+    std::shared_mutex& mLock;
+    const LockMode mOuter;
+
+    DISALLOW_COPY_AND_ASSIGN(ScopedGlobalLock);
+};
+
+// For calls that touch the data of several packages, users or volumes
+#define LOCK_GLOBAL()                                       \
+    ScopedGlobalLock globalLock(mLock, LockMode::EXCLUSIVE)
+
+// For calls that only read shared state, or touch paths no other call shares
+#define LOCK_GLOBAL_SHARED()                                \
+    ScopedGlobalLock globalLock(mLock, LockMode::SHARED)
+
+// For calls on a single package, which may run along calls on other packages
+#define LOCK_PACKAGE(packageName)                           \
+    LOCK_GLOBAL_SHARED();                                   \
+    std::lock_guard<std::recursive_mutex> packageLock(getPackageLock((packageName)))
+
 }  // namespace
 
 status_t InstalldNativeService::start() {
@@ -280,6 +345,10 @@ status_t InstalldNativeService::start() {
     return android::OK;
 }
 
+std::recursive_mutex& InstalldNativeService::getPackageLock(const std::string& packageName) {
+    return mPackageLocks[std::hash<std::string>()(packageName) % mPackageLocks.size()];
+}
+
 status_t InstalldNativeService::dump(int fd, const Vector<String16> & /* args */) {
     auto out = std::fstream(StringPrintf("/proc/self/fd/%d", fd));
     const binder::Status dump_permission = checkPermission(kDump);
@@ -287,7 +356,7 @@ status_t InstalldNativeService::dump(int fd, const Vector<String16> & /* args */
         out << dump_permission.toString8() << endl;
         return PERMISSION_DENIED;
     }
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_GLOBAL_SHARED();
 
     out << "installd is happy!" << endl;
 
@@ -424,6 +493,9 @@ static bool prepare_app_profile_dir(const std::string& packageName, int32_t appI
     return true;
 }
 
+// The most packages createAppDataBatched() creates the data of at once
+static constexpr size_t kMaxCreateAppDataThreads = 4;
+
 binder::Status InstalldNativeService::createAppDataBatched(
         const std::optional<std::vector<std::optional<std::string>>>& uuids,
         const std::optional<std::vector<std::optional<std::string>>>& packageNames,
@@ -431,20 +503,43 @@ binder::Status InstalldNativeService::createAppDataBatched(
         const std::vector<std::string>& seInfos, const std::vector<int32_t>& targetSdkVersions,
         int64_t* _aidl_return) {
     ENFORCE_UID(AID_SYSTEM);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    // NOTE: No lock is taken here: each createAppData() call below takes the
+    // lock of its package, from whichever thread runs it.
 
     ATRACE_BEGIN("createAppDataBatched");
-    binder::Status ret;
-    for (size_t i = 0; i < uuids->size(); i++) {
-        std::optional<std::string> packageName = packageNames->at(i);
-        if (!packageName) {
+    // Entries are for different packages, so they are created concurrently,
+    // and reported in order as if they had been created one after the other.
+    const size_t count = uuids->size();
+    std::vector<binder::Status> results(count);
+    std::vector<int64_t> inodes(count, -1);
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        size_t i;
+        while ((i = next++) < count) {
+            std::optional<std::string> packageName = packageNames->at(i);
+            if (packageName) {
+                results[i] = createAppData(uuids->at(i), *packageName, userId, flags, appIds[i],
+                        seInfos[i], targetSdkVersions[i], &inodes[i]);
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < std::min(kMaxCreateAppDataThreads, count); i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (!packageNames->at(i)) {
             continue;
         }
-        ret = createAppData(uuids->at(i), *packageName, userId, flags, appIds[i],
-                seInfos[i], targetSdkVersions[i], _aidl_return);
-        if (!ret.isOk()) {
+        if (_aidl_return != nullptr) *_aidl_return = inodes[i];
+        if (!results[i].isOk()) {
             ATRACE_END();
-            return ret;
+            return results[i];
         }
     }
     ATRACE_END();
@@ -457,7 +552,7 @@ binder::Status InstalldNativeService::createAppData(const std::optional<std::str
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_UUID(uuid);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_PACKAGE(packageName);
 
     const char* uuid_ = uuid ? uuid->c_str() : nullptr;
     const char* pkgname = packageName.c_str();
@@ -537,7 +632,7 @@ binder::Status InstalldNativeService::migrateAppData(const std::optional<std::st
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_UUID(uuid);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_PACKAGE(packageName);
 
     const char* uuid_ = uuid ? uuid->c_str() : nullptr;
     const char* pkgname = packageName.c_str();
@@ -581,7 +676,7 @@ binder::Status InstalldNativeService::clearAppProfiles(const std::string& packag
         const std::string& profileName) {
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_PACKAGE(packageName);
 
     binder::Status res = ok();
     if (!clear_primary_reference_profile(packageName, profileName)) {
@@ -598,7 +693,7 @@ binder::Status InstalldNativeService::clearAppData(const std::optional<std::stri
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_UUID(uuid);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_PACKAGE(packageName);
 
     const char* uuid_ = uuid ? uuid->c_str() : nullptr;
     const char* pkgname = packageName.c_str();
@@ -698,7 +793,7 @@ static int destroy_app_current_profiles(const std::string& pkgname, userid_t use
 binder::Status InstalldNativeService::destroyAppProfiles(const std::string& packageName) {
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_PACKAGE(packageName);
 
     binder::Status res = ok();
     std::vector<userid_t> users = get_known_users(/*volume_uuid*/ nullptr);
@@ -718,7 +813,7 @@ binder::Status InstalldNativeService::destroyAppData(const std::optional<std::st
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_UUID(uuid);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_PACKAGE(packageName);
 
     const char* uuid_ = uuid ? uuid->c_str() : nullptr;
     const char* pkgname = packageName.c_str();
@@ -785,104 +880,173 @@ static gid_t get_cache_gid(uid_t uid) {
     return (gid != -1) ? gid : uid;
 }
 
+// The most app directories fixupAppData() walks at once
+static constexpr size_t kMaxFixupThreads = 4;
+
+/**
+ * Fixes up the GIDs of everything inside a single app data directory, and
+ * returns the number of inodes it checked.
+ */
+static int64_t fixup_app_dir(const std::string& path, int32_t flags) {
+    int64_t inodes = 0;
+    FTS* fts;
+    FTSENT* p;
+    char *argv[] = { (char*) path.c_str(), nullptr };
+    if (!(fts = fts_open(argv, FTS_PHYSICAL | FTS_NOCHDIR | FTS_XDEV, nullptr))) {
+        PLOG(ERROR) << "Failed to fts_open " << path;
+        return 0;
+    }
+    while ((p = fts_read(fts)) != nullptr) {
+        if (p->fts_info != FTS_DP) {
+            inodes++;
+        }
+        if (p->fts_info == FTS_D && p->fts_level == 0) {
+            // Track down inodes of cache directories
+            uint64_t raw = 0;
+            ino_t inode_cache = 0;
+            ino_t inode_code_cache = 0;
+            if (getxattr(p->fts_path, kXattrInodeCache, &raw, sizeof(raw)) == sizeof(raw)) {
+                inode_cache = raw;
+            }
+            if (getxattr(p->fts_path, kXattrInodeCodeCache, &raw, sizeof(raw)) == sizeof(raw)) {
+                inode_code_cache = raw;
+            }
+
+            // Figure out expected GID of each child
+            FTSENT* child = fts_children(fts, 0);
+            while (child != nullptr) {
+                if ((child->fts_statp->st_ino == inode_cache)
+                        || (child->fts_statp->st_ino == inode_code_cache)
+                        || !strcmp(child->fts_name, "cache")
+                        || !strcmp(child->fts_name, "code_cache")) {
+                    child->fts_number = get_cache_gid(p->fts_statp->st_uid);
+                } else {
+                    child->fts_number = p->fts_statp->st_uid;
+                }
+                child = child->fts_link;
+            }
+        } else if (p->fts_level >= 1) {
+            if (p->fts_level > 1) {
+                // Inherit GID from parent once we're deeper into tree
+                p->fts_number = p->fts_parent->fts_number;
+            }
+
+            uid_t uid = p->fts_parent->fts_statp->st_uid;
+            gid_t cache_gid = get_cache_gid(uid);
+            gid_t expected = p->fts_number;
+            gid_t actual = p->fts_statp->st_gid;
+            if (actual == expected) {
+#if FIXUP_DEBUG
+                LOG(DEBUG) << "Ignoring " << p->fts_path << " with expected GID " << expected;
+#endif
+                if (!(flags & FLAG_FORCE)) {
+                    fts_set(fts, p, FTS_SKIP);
+                }
+            } else if ((actual == uid) || (actual == cache_gid)) {
+                // Only consider fixing up when current GID belongs to app
+                if (p->fts_info != FTS_D) {
+                    LOG(INFO) << "Fixing " << p->fts_path << " with unexpected GID " << actual
+                            << " instead of " << expected;
+                }
+                switch (p->fts_info) {
+                case FTS_DP:
+                    // If we're moving towards cache GID, we need to set S_ISGID
+                    if (expected == cache_gid) {
+                        if (chmod(p->fts_path, 02771) != 0) {
+                            PLOG(WARNING) << "Failed to chmod " << p->fts_path;
+                        }
+                    }
+                    [[fallthrough]]; // also set GID
+                case FTS_F:
+                    if (chown(p->fts_path, -1, expected) != 0) {
+                        PLOG(WARNING) << "Failed to chown " << p->fts_path;
+                    }
+                    break;
+                case FTS_SL:
+                case FTS_SLNONE:
+                    if (lchown(p->fts_path, -1, expected) != 0) {
+                        PLOG(WARNING) << "Failed to chown " << p->fts_path;
+                    }
+                    break;
+                }
+            } else {
+                // Ignore all other GID transitions, since they're kinda shady
+                LOG(WARNING) << "Ignoring " << p->fts_path << " with unexpected GID " << actual
+                        << " instead of " << expected;
+                if (!(flags & FLAG_FORCE)) {
+                    fts_set(fts, p, FTS_SKIP);
+                }
+            }
+        }
+    }
+    fts_close(fts);
+    return inodes;
+}
+
 binder::Status InstalldNativeService::fixupAppData(const std::optional<std::string>& uuid,
         int32_t flags) {
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_UUID(uuid);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_GLOBAL();
 
     const char* uuid_ = uuid ? uuid->c_str() : nullptr;
     for (auto user : get_known_users(uuid_)) {
         ATRACE_BEGIN("fixup user");
-        FTS* fts;
-        FTSENT* p;
-        auto ce_path = create_data_user_ce_path(uuid_, user);
-        auto de_path = create_data_user_de_path(uuid_, user);
-        char *argv[] = { (char*) ce_path.c_str(), (char*) de_path.c_str(), nullptr };
-        if (!(fts = fts_open(argv, FTS_PHYSICAL | FTS_NOCHDIR | FTS_XDEV, nullptr))) {
-            return error("Failed to fts_open");
-        }
-        while ((p = fts_read(fts)) != nullptr) {
-            if (p->fts_info == FTS_D && p->fts_level == 1) {
-                // Track down inodes of cache directories
-                uint64_t raw = 0;
-                ino_t inode_cache = 0;
-                ino_t inode_code_cache = 0;
-                if (getxattr(p->fts_path, kXattrInodeCache, &raw, sizeof(raw)) == sizeof(raw)) {
-                    inode_cache = raw;
-                }
-                if (getxattr(p->fts_path, kXattrInodeCodeCache, &raw, sizeof(raw)) == sizeof(raw)) {
-                    inode_code_cache = raw;
-                }
-
-                // Figure out expected GID of each child
-                FTSENT* child = fts_children(fts, 0);
-                while (child != nullptr) {
-                    if ((child->fts_statp->st_ino == inode_cache)
-                            || (child->fts_statp->st_ino == inode_code_cache)
-                            || !strcmp(child->fts_name, "cache")
-                            || !strcmp(child->fts_name, "code_cache")) {
-                        child->fts_number = get_cache_gid(p->fts_statp->st_uid);
-                    } else {
-                        child->fts_number = p->fts_statp->st_uid;
-                    }
-                    child = child->fts_link;
+        auto start = std::chrono::steady_clock::now();
+
+        // Each app directory is walked on its own, so that several can be
+        // walked at once
+        std::vector<std::string> app_dirs;
+        for (const auto& user_path : { create_data_user_ce_path(uuid_, user),
+                create_data_user_de_path(uuid_, user) }) {
+            struct stat user_stat;
+            DIR* dir = opendir(user_path.c_str());
+            if (dir == nullptr) {
+                PLOG(WARNING) << "Failed to opendir " << user_path;
+                continue;
+            }
+            if (fstat(dirfd(dir), &user_stat) != 0) {
+                PLOG(WARNING) << "Failed to stat " << user_path;
+                closedir(dir);
+                continue;
+            }
+            struct dirent* de;
+            while ((de = readdir(dir)) != nullptr) {
+                struct stat s;
+                if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, "..")) {
+                    continue;
                 }
-            } else if (p->fts_level >= 2) {
-                if (p->fts_level > 2) {
-                    // Inherit GID from parent once we're deeper into tree
-                    p->fts_number = p->fts_parent->fts_number;
+                if (fstatat(dirfd(dir), de->d_name, &s, AT_SYMLINK_NOFOLLOW) == 0
+                        && S_ISDIR(s.st_mode) && s.st_dev == user_stat.st_dev) {
+                    app_dirs.push_back(user_path + "/" + de->d_name);
                 }
+            }
+            closedir(dir);
+        }
 
-                uid_t uid = p->fts_parent->fts_statp->st_uid;
-                gid_t cache_gid = get_cache_gid(uid);
-                gid_t expected = p->fts_number;
-                gid_t actual = p->fts_statp->st_gid;
-                if (actual == expected) {
-#if FIXUP_DEBUG
-                    LOG(DEBUG) << "Ignoring " << p->fts_path << " with expected GID " << expected;
-#endif
-                    if (!(flags & FLAG_FORCE)) {
-                        fts_set(fts, p, FTS_SKIP);
-                    }
-                } else if ((actual == uid) || (actual == cache_gid)) {
-                    // Only consider fixing up when current GID belongs to app
-                    if (p->fts_info != FTS_D) {
-                        LOG(INFO) << "Fixing " << p->fts_path << " with unexpected GID " << actual
-                                << " instead of " << expected;
-                    }
-                    switch (p->fts_info) {
-                    case FTS_DP:
-                        // If we're moving towards cache GID, we need to set S_ISGID
-                        if (expected == cache_gid) {
-                            if (chmod(p->fts_path, 02771) != 0) {
-                                PLOG(WARNING) << "Failed to chmod " << p->fts_path;
-                            }
-                        }
-                        [[fallthrough]]; // also set GID
-                    case FTS_F:
-                        if (chown(p->fts_path, -1, expected) != 0) {
-                            PLOG(WARNING) << "Failed to chown " << p->fts_path;
-                        }
-                        break;
-                    case FTS_SL:
-                    case FTS_SLNONE:
-                        if (lchown(p->fts_path, -1, expected) != 0) {
-                            PLOG(WARNING) << "Failed to chown " << p->fts_path;
-                        }
-                        break;
-                    }
-                } else {
-                    // Ignore all other GID transitions, since they're kinda shady
-                    LOG(WARNING) << "Ignoring " << p->fts_path << " with unexpected GID " << actual
-                            << " instead of " << expected;
-                    if (!(flags & FLAG_FORCE)) {
-                        fts_set(fts, p, FTS_SKIP);
-                    }
-                }
+        std::atomic<size_t> next(0);
+        std::atomic<int64_t> inodes(0);
+        auto worker = [&]() {
+            size_t i;
+            while ((i = next++) < app_dirs.size()) {
+                inodes += fixup_app_dir(app_dirs[i], flags);
             }
+        };
+        std::vector<std::thread> threads;
+        size_t jobs = std::min(kMaxFixupThreads, app_dirs.size());
+        for (size_t i = 1; i < jobs; i++) {
+            threads.emplace_back(worker);
         }
-        fts_close(fts);
+        worker();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start).count();
+        LOG(INFO) << "Checked " << inodes << " inodes in " << app_dirs.size()
+                << " app directories of user " << user << " in " << elapsed << "ms ("
+                << (inodes * 1000 / std::max<int64_t>(elapsed, 1)) << " inodes/s)";
         ATRACE_END();
     }
     return ok();
@@ -904,6 +1068,32 @@ static int32_t copy_directory_recursive(const char* from, const char* to) {
     return logwrap_fork_execvp(ARRAY_SIZE(argv), argv, nullptr, false, LOG_ALOG, false, nullptr);
 }
 
+/**
+ * Copies from into the directory to, like copy_directory_recursive(), but
+ * clones the files instead when the file system supports it, so that the
+ * snapshot shares blocks with the data until either is written.
+ */
+static int32_t snapshot_directory(const std::string& from, const std::string& to) {
+    auto start = std::chrono::steady_clock::now();
+    auto snapshot = to + "/" + android::base::Basename(from);
+    const char* mode = "Cloned";
+    int32_t rc = clone_directory(from, snapshot);
+    if (rc != 0) {
+        if (rc != -EOPNOTSUPP && rc != -EXDEV && rc != -EINVAL) {
+            LOG(WARNING) << "Failed to clone " << from << ": " << strerror(-rc);
+        }
+        delete_dir_contents_and_dir(snapshot, true /* ignore_if_missing */);
+        mode = "Copied";
+        rc = copy_directory_recursive(from.c_str(), to.c_str());
+    }
+    if (rc == 0) {
+        LOG(INFO) << mode << " " << from << " to " << to << " in "
+                << std::chrono::duration_cast<std::chrono::milliseconds>(
+                        std::chrono::steady_clock::now() - start).count() << "ms";
+    }
+    return rc;
+}
+
 binder::Status InstalldNativeService::snapshotAppData(
         const std::optional<std::string>& volumeUuid,
         const std::string& packageName, int32_t user, int32_t snapshotId,
@@ -911,7 +1101,7 @@ binder::Status InstalldNativeService::snapshotAppData(
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_UUID_IS_TEST_OR_NULL(volumeUuid);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_PACKAGE(packageName);
 
     const char* volume_uuid = volumeUuid ? volumeUuid->c_str() : nullptr;
     const char* package_name = packageName.c_str();
@@ -963,7 +1153,7 @@ binder::Status InstalldNativeService::snapshotAppData(
 
         // Check if we have data to copy.
         if (access(from.c_str(), F_OK) == 0) {
-          rc = copy_directory_recursive(from.c_str(), to.c_str());
+          rc = snapshot_directory(from, to);
         }
         if (rc != 0) {
             res = error(rc, "Failed copying " + from + " to " + to);
@@ -1013,7 +1203,7 @@ binder::Status InstalldNativeService::snapshotAppData(
             return error(rc, "Failed clearing existing snapshot " + rollback_package_path);
         }
 
-        rc = copy_directory_recursive(from.c_str(), to.c_str());
+        rc = snapshot_directory(from, to);
         if (rc != 0) {
             res = error(rc, "Failed copying " + from + " to " + to);
             clear_ce_on_exit = true;
@@ -1041,7 +1231,7 @@ binder::Status InstalldNativeService::restoreAppDataSnapshot(
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_UUID_IS_TEST_OR_NULL(volumeUuid);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_PACKAGE(packageName);
 
     const char* volume_uuid = volumeUuid ? volumeUuid->c_str() : nullptr;
     const char* package_name = packageName.c_str();
@@ -1113,7 +1303,7 @@ binder::Status InstalldNativeService::destroyAppDataSnapshot(
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_UUID_IS_TEST_OR_NULL(volumeUuid);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_PACKAGE(packageName);
 
     const char* volume_uuid = volumeUuid ? volumeUuid->c_str() : nullptr;
     const char* package_name = packageName.c_str();
@@ -1144,7 +1334,7 @@ binder::Status InstalldNativeService::destroyCeSnapshotsNotSpecified(
         const std::vector<int32_t>& retainSnapshotIds) {
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_UUID_IS_TEST_OR_NULL(volumeUuid);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_GLOBAL();
 
     const char* volume_uuid = volumeUuid ? volumeUuid->c_str() : nullptr;
 
@@ -1185,7 +1375,7 @@ binder::Status InstalldNativeService::moveCompleteApp(const std::optional<std::s
     CHECK_ARGUMENT_UUID(fromUuid);
     CHECK_ARGUMENT_UUID(toUuid);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_PACKAGE(packageName);
 
     const char* from_uuid = fromUuid ? fromUuid->c_str() : nullptr;
     const char* to_uuid = toUuid ? toUuid->c_str() : nullptr;
@@ -1289,7 +1479,7 @@ binder::Status InstalldNativeService::createUserData(const std::optional<std::st
         int32_t userId, int32_t userSerial ATTRIBUTE_UNUSED, int32_t flags) {
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_UUID(uuid);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_GLOBAL();
 
     const char* uuid_ = uuid ? uuid->c_str() : nullptr;
     if (flags & FLAG_STORAGE_DE) {
@@ -1307,7 +1497,7 @@ binder::Status InstalldNativeService::destroyUserData(const std::optional<std::s
         int32_t userId, int32_t flags) {
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_UUID(uuid);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_GLOBAL();
 
     const char* uuid_ = uuid ? uuid->c_str() : nullptr;
     binder::Status res = ok();
@@ -1344,7 +1534,7 @@ binder::Status InstalldNativeService::freeCache(const std::optional<std::string>
         int64_t targetFreeBytes, int64_t cacheReservedBytes, int32_t flags) {
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_UUID(uuid);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_GLOBAL();
 
     auto uuidString = uuid.value_or("");
     const char* uuid_ = uuid ? uuid->c_str() : nullptr;
@@ -1432,7 +1622,16 @@ binder::Status InstalldNativeService::freeCache(const std::optional<std::string>
         ATRACE_END();
 
         // 3. Bounce across the queue, freeing items from whichever tracker is
-        // the most over their assigned quota
+        // the most over their assigned quota. Items walked by earlier calls
+        // are reused while their cache directories are unchanged.
+        auto& itemIndex = mCacheItemIndex[uuidString];
+        for (auto it = itemIndex.begin(); it != itemIndex.end();) {
+            if (trackers.find(it->first) == trackers.end()) {
+                it = itemIndex.erase(it);
+            } else {
+                ++it;
+            }
+        }
         ATRACE_BEGIN("bounce");
         std::shared_ptr<CacheTracker> active;
         while (active || !queue.empty()) {
@@ -1461,7 +1660,7 @@ binder::Status InstalldNativeService::freeCache(const std::optional<std::string>
                     queue.push(active);
                 }
                 active = queue.top(); queue.pop();
-                active->ensureItems();
+                active->ensureItems(itemIndex[active->getUid()], kCacheItemIndexMaxAge);
                 continue;
             }
 
@@ -1496,6 +1695,15 @@ binder::Status InstalldNativeService::freeCache(const std::optional<std::string>
         }
         ATRACE_END();
 
+        // 4. Keep the items left for the next call
+        if (!noop) {
+            for (const auto& it : trackers) {
+                if (it.second->itemsLoaded()) {
+                    it.second->saveItems(&itemIndex[it.first]);
+                }
+            }
+        }
+
     } else {
         return error("Legacy cache logic no longer supported");
     }
@@ -1513,7 +1721,7 @@ binder::Status InstalldNativeService::rmdex(const std::string& codePath,
         const std::string& instructionSet) {
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_PATH(codePath);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_GLOBAL();
 
     char dex_path[PKG_PATH_MAX];
 
@@ -2232,7 +2440,7 @@ binder::Status InstalldNativeService::getAppCrates(
         CHECK_ARGUMENT_PACKAGE_NAME(packageName);
     }
 #ifdef ENABLE_STORAGE_CRATES
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_GLOBAL_SHARED();
 
     auto retVector = std::vector<std::optional<CrateMetadata>>();
     const char* uuid_ = uuid ? uuid->c_str() : nullptr;
@@ -2278,7 +2486,7 @@ binder::Status InstalldNativeService::getUserCrates(
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_UUID(uuid);
 #ifdef ENABLE_STORAGE_CRATES
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_GLOBAL();
 
     const char* uuid_ = uuid ? uuid->c_str() : nullptr;
     auto retVector = std::vector<std::optional<CrateMetadata>>();
@@ -2335,7 +2543,7 @@ binder::Status InstalldNativeService::dumpProfiles(int32_t uid, const std::strin
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
     CHECK_ARGUMENT_PATH(codePath);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_PACKAGE(packageName);
 
     *_aidl_return = dump_profiles(uid, packageName, profileName, codePath);
     return ok();
@@ -2347,7 +2555,7 @@ binder::Status InstalldNativeService::copySystemProfile(const std::string& syste
         bool* _aidl_return) {
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_PACKAGE(packageName);
     *_aidl_return = copy_system_profile(systemProfile, packageUid, packageName, profileName);
     return ok();
 }
@@ -2357,7 +2565,7 @@ binder::Status InstalldNativeService::mergeProfiles(int32_t uid, const std::stri
         const std::string& profileName, bool* _aidl_return) {
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_PACKAGE(packageName);
 
     *_aidl_return = analyze_primary_profiles(uid, packageName, profileName);
     return ok();
@@ -2368,7 +2576,7 @@ binder::Status InstalldNativeService::createProfileSnapshot(int32_t appId,
         const std::string& classpath, bool* _aidl_return) {
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_PACKAGE(packageName);
 
     *_aidl_return = create_profile_snapshot(appId, packageName, profileName, classpath);
     return ok();
@@ -2378,7 +2586,7 @@ binder::Status InstalldNativeService::destroyProfileSnapshot(const std::string&
         const std::string& profileName) {
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_PACKAGE(packageName);
 
     std::string snapshot = create_snapshot_profile_path(packageName, profileName);
     if ((unlink(snapshot.c_str()) != 0) && (errno != ENOENT)) {
@@ -2408,7 +2616,7 @@ binder::Status InstalldNativeService::dexopt(const std::string& apkPath, int32_t
     }
     CHECK_ARGUMENT_PATH(outputPath);
     CHECK_ARGUMENT_PATH(dexMetadataPath);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_PACKAGE(packageName.value_or("*"));
 
     const char* oat_dir = getCStr(outputPath);
     const char* instruction_set = instructionSet.c_str();
@@ -2433,6 +2641,77 @@ binder::Status InstalldNativeService::dexopt(const std::string& apkPath, int32_t
     return res ? error(res, error_msg) : ok();
 }
 
+binder::Status InstalldNativeService::dexoptBatch(
+        const std::vector<android::os::DexoptRequest>& requests, int32_t maxConcurrency,
+        const sp<android::os::IDexoptBatchCallback>& callback) {
+    ENFORCE_UID(AID_SYSTEM);
+    for (const auto& request : requests) {
+        CHECK_ARGUMENT_UUID(request.uuid);
+        CHECK_ARGUMENT_PATH(request.apkPath);
+        if (request.packageName && *request.packageName != "*") {
+            CHECK_ARGUMENT_PACKAGE_NAME(*request.packageName);
+        }
+        CHECK_ARGUMENT_PATH(request.outputPath);
+        CHECK_ARGUMENT_PATH(request.dexMetadataPath);
+    }
+    if (callback == nullptr) {
+        return error("No callback for dexopt batch");
+    }
+    // NOTE: The global lock is held shared for the whole batch on behalf of
+    // the threads below, which each take the lock of the package they dexopt.
+    LOCK_GLOBAL_SHARED();
+
+    std::vector<const char*> oat_dirs;
+    for (const auto& request : requests) {
+        const char* oat_dir = getCStr(request.outputPath);
+        if (oat_dir != nullptr && !createOatDir(oat_dir, request.instructionSet).isOk()) {
+            // Can't create oat dir - let dexopt use cache dir.
+            oat_dir = nullptr;
+        }
+        oat_dirs.push_back(oat_dir);
+    }
+
+    // Each dex2oat already uses the threads dalvik.vm.dex2oat-threads allows,
+    // so the caller sizes the batch concurrency by its I/O and thermal budget,
+    // and it is never more than the CPUs that can run them.
+    size_t jobs = std::max(1, maxConcurrency);
+    jobs = std::min(jobs, static_cast<size_t>(std::max(1u, std::thread::hardware_concurrency())));
+    jobs = std::min(jobs, requests.size());
+
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        size_t i;
+        while ((i = next++) < requests.size()) {
+            const auto& request = requests[i];
+            std::lock_guard<std::recursive_mutex> packageLock(
+                    getPackageLock(request.packageName.value_or("*")));
+            std::string error_msg;
+            int res = android::installd::dexopt(request.apkPath.c_str(), request.uid,
+                    getCStr(request.packageName, "*"), request.instructionSet.c_str(),
+                    request.dexoptNeeded, oat_dirs[i], request.dexFlags,
+                    request.compilerFilter.c_str(), getCStr(request.uuid),
+                    getCStr(request.sharedLibraries), getCStr(request.seInfo), request.downgrade,
+                    request.targetSdkVersion, getCStr(request.profileName),
+                    getCStr(request.dexMetadataPath), getCStr(request.compilationReason),
+                    &error_msg);
+            if (res != 0) {
+                LOG(ERROR) << "Failed to dexopt " << request.apkPath << ": " << error_msg;
+            }
+            callback->onDexoptResult(i, res,
+                    res ? std::make_optional(error_msg) : std::nullopt);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < jobs; i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return ok();
+}
+
 binder::Status InstalldNativeService::compileLayouts(const std::string& apkPath,
                                                      const std::string& packageName,
                                                      const std ::string& outDexFile, int uid,
@@ -2451,7 +2730,7 @@ binder::Status InstalldNativeService::linkNativeLibraryDirectory(
     CHECK_ARGUMENT_UUID(uuid);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
     CHECK_ARGUMENT_PATH(nativeLibPath32);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_PACKAGE(packageName);
 
     const char* uuid_ = uuid ? uuid->c_str() : nullptr;
     const char* pkgname = packageName.c_str();
@@ -2542,7 +2821,7 @@ binder::Status InstalldNativeService::restoreconAppData(const std::optional<std:
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_UUID(uuid);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_PACKAGE(packageName);
 
     binder::Status res = ok();
 
@@ -2572,7 +2851,7 @@ binder::Status InstalldNativeService::createOatDir(const std::string& oatDir,
         const std::string& instructionSet) {
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_PATH(oatDir);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_GLOBAL_SHARED();
 
     const char* oat_dir = oatDir.c_str();
     const char* instruction_set = instructionSet.c_str();
@@ -2597,7 +2876,7 @@ binder::Status InstalldNativeService::createOatDir(const std::string& oatDir,
 binder::Status InstalldNativeService::rmPackageDir(const std::string& packageDir) {
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_PATH(packageDir);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_GLOBAL();
 
     if (validate_apk_path(packageDir.c_str())) {
         return error("Invalid path " + packageDir);
@@ -2613,7 +2892,7 @@ binder::Status InstalldNativeService::linkFile(const std::string& relativePath,
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_PATH(fromBase);
     CHECK_ARGUMENT_PATH(toBase);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_GLOBAL();
 
     const char* relative_path = relativePath.c_str();
     const char* from_base = fromBase.c_str();
@@ -2643,7 +2922,7 @@ binder::Status InstalldNativeService::moveAb(const std::string& apkPath,
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_PATH(apkPath);
     CHECK_ARGUMENT_PATH(outputPath);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_GLOBAL();
 
     const char* apk_path = apkPath.c_str();
     const char* instruction_set = instructionSet.c_str();
@@ -2658,7 +2937,7 @@ binder::Status InstalldNativeService::deleteOdex(const std::string& apkPath,
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_PATH(apkPath);
     CHECK_ARGUMENT_PATH(outputPath);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_GLOBAL();
 
     const char* apk_path = apkPath.c_str();
     const char* instruction_set = instructionSet.c_str();
@@ -2691,7 +2970,7 @@ binder::Status InstalldNativeService::installApkVerity(const std::string& filePa
         android::base::unique_fd verityInputAshmem, int32_t contentSize) {
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_PATH(filePath);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_GLOBAL();
 
     if (!android::base::GetBoolProperty(kPropApkVerityMode, false)) {
         return ok();
@@ -2773,7 +3052,7 @@ binder::Status InstalldNativeService::assertFsverityRootHashMatches(const std::s
         const std::vector<uint8_t>& expectedHash) {
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_PATH(filePath);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_GLOBAL();
 
     if (!android::base::GetBoolProperty(kPropApkVerityMode, false)) {
         return ok();
@@ -2812,7 +3091,7 @@ binder::Status InstalldNativeService::reconcileSecondaryDexFile(
     CHECK_ARGUMENT_UUID(volumeUuid);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
     CHECK_ARGUMENT_PATH(dexPath);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_PACKAGE(packageName);
 
     bool result = android::installd::reconcile_secondary_dex_file(
             dexPath, packageName, uid, isas, volumeUuid, storage_flag, _aidl_return);
@@ -2893,7 +3172,7 @@ binder::Status InstalldNativeService::tryMountDataMirror(
     const char* uuid_ = uuid->c_str();
 
     std::string mirrorVolCePath(StringPrintf("%s/%s", kDataMirrorCePath, uuid_));
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_GLOBAL();
     if (fs_prepare_dir(mirrorVolCePath.c_str(), 0711, AID_SYSTEM, AID_SYSTEM) != 0) {
         return error("Failed to create CE mirror");
     }
@@ -2963,7 +3242,7 @@ binder::Status InstalldNativeService::onPrivateVolumeRemoved(
     std::string mirrorDeVolPath(StringPrintf("%s/%s", kDataMirrorDePath, uuid_));
 
     // Unmount CE storage
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_GLOBAL();
     if (TEMP_FAILURE_RETRY(umount(mirrorCeVolPath.c_str())) != 0) {
         if (errno != ENOENT) {
             res = error(StringPrintf("Failed to umount %s %s", mirrorCeVolPath.c_str(),
@@ -3012,7 +3291,7 @@ binder::Status InstalldNativeService::prepareAppProfile(const std::string& packa
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
     CHECK_ARGUMENT_PATH(codePath);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_PACKAGE(packageName);
 
     *_aidl_return = prepare_app_profile(packageName, userId, appId, profileName, codePath,
         dexMetadata);
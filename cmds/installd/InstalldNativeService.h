@@ -21,6 +21,9 @@
 #include <inttypes.h>
 #include <unistd.h>
 
+#include <array>
+#include <mutex>
+#include <shared_mutex>
 #include <vector>
 #include <unordered_map>
 
@@ -29,6 +32,7 @@
 #include <cutils/multiuser.h>
 
 #include "android/os/BnInstalld.h"
+#include "CacheTracker.h"
 #include "installd_constants.h"
 
 namespace android {
@@ -115,6 +119,8 @@ public:
             int32_t targetSdkVersion, const std::optional<std::string>& profileName,
             const std::optional<std::string>& dexMetadataPath,
             const std::optional<std::string>& compilationReason);
+    binder::Status dexoptBatch(const std::vector<android::os::DexoptRequest>& requests,
+            int32_t maxConcurrency, const sp<android::os::IDexoptBatchCallback>& callback);
 
     binder::Status compileLayouts(const std::string& apkPath, const std::string& packageName,
                                   const std::string& outDexFile, int uid, bool* _aidl_return);
@@ -173,7 +179,11 @@ public:
     binder::Status migrateLegacyObbData();
 
 private:
-    std::recursive_mutex mLock;
+    // Held exclusively by calls that touch the data of several packages, and
+    // shared by calls on a single package, which also hold its package lock.
+    std::shared_mutex mLock;
+    // Package locks, striped by package name
+    std::array<std::recursive_mutex, 64> mPackageLocks;
 
     std::recursive_mutex mMountsLock;
     std::recursive_mutex mQuotasLock;
@@ -184,7 +194,12 @@ private:
     /* Map from UID to cache quota size */
     std::unordered_map<uid_t, int64_t> mCacheQuotas;
 
+    /* Map from volume UUID and UID to cache items kept between freeCache calls */
+    std::unordered_map<std::string,
+            std::unordered_map<uid_t, CacheTracker::ItemIndex>> mCacheItemIndex;
+
     std::string findDataMediaPath(const std::optional<std::string>& uuid, userid_t userid);
+    std::recursive_mutex& getPackageLock(const std::string& packageName);
 };
 
 }  // namespace installd
@@ -21,6 +21,8 @@
 #include <string.h>
 #include <sys/capability.h>
 #include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/types.h>
@@ -29,6 +31,8 @@
 #include <unistd.h>
 
 #include <iomanip>
+#include <map>
+#include <mutex>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
@@ -64,6 +68,7 @@ using android::base::GetBoolProperty;
 using android::base::GetProperty;
 using android::base::ReadFdToString;
 using android::base::ReadFully;
+using android::base::Socketpair;
 using android::base::StringPrintf;
 using android::base::WriteFully;
 using android::base::unique_fd;
@@ -2024,6 +2029,83 @@ bool reconcile_secondary_dex_file(const std::string& dex_path,
     }
 }
 
+// Identifies a version of a secondary dex file: any write to the file changes its ctime.
+struct SecondaryDexFileStat {
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+    struct timespec ctime;
+
+    bool operator==(const SecondaryDexFileStat& other) const {
+        return memcmp(this, &other, sizeof(*this)) == 0;
+    }
+};
+
+static bool get_secondary_dex_file_stat(int fd, SecondaryDexFileStat* file_stat) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        return false;
+    }
+    // Cleared so that the padding compares and transfers as well.
+    memset(file_stat, 0, sizeof(*file_stat));
+    file_stat->dev = st.st_dev;
+    file_stat->ino = st.st_ino;
+    file_stat->size = st.st_size;
+    file_stat->mtime = st.st_mtim;
+    file_stat->ctime = st.st_ctim;
+    return true;
+}
+
+// Hashes of the secondary dex files hashed recently, so that the package manager's periodic
+// reconciliation doesn't read files that haven't changed again. Keyed by inode, and only valid
+// for the file version they were computed for.
+static constexpr size_t kMaxSecondaryDexHashes = 1024;
+static std::mutex sSecondaryDexHashesLock;
+static std::map<std::pair<dev_t, ino_t>,
+        std::pair<SecondaryDexFileStat, std::vector<uint8_t>>> sSecondaryDexHashes;
+
+static bool find_secondary_dex_hash(const SecondaryDexFileStat& file_stat,
+        std::vector<uint8_t>* hash) {
+    std::lock_guard<std::mutex> lock(sSecondaryDexHashesLock);
+    auto it = sSecondaryDexHashes.find(std::make_pair(file_stat.dev, file_stat.ino));
+    if (it == sSecondaryDexHashes.end() || !(it->second.first == file_stat)) {
+        return false;
+    }
+    *hash = it->second.second;
+    return true;
+}
+
+static void save_secondary_dex_hash(const SecondaryDexFileStat& file_stat,
+        const std::vector<uint8_t>& hash) {
+    std::lock_guard<std::mutex> lock(sSecondaryDexHashesLock);
+    if (sSecondaryDexHashes.size() >= kMaxSecondaryDexHashes) {
+        sSecondaryDexHashes.clear();
+    }
+    sSecondaryDexHashes[std::make_pair(file_stat.dev, file_stat.ino)] =
+            std::make_pair(file_stat, hash);
+}
+
+// Hashes the given file through windows mapped one after the other, which saves copying the data
+// and lets the kernel read ahead.
+static bool hash_file(int fd, off_t size, uint8_t* hash) {
+    static constexpr off_t kWindowSize = 8 * 1024 * 1024;
+    SHA256_CTX ctx;
+    SHA256_Init(&ctx);
+    for (off_t offset = 0; offset < size; offset += kWindowSize) {
+        size_t length = std::min(kWindowSize, size - offset);
+        void* data = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, offset);
+        if (data == MAP_FAILED) {
+            return false;
+        }
+        madvise(data, length, MADV_SEQUENTIAL);
+        SHA256_Update(&ctx, data, length);
+        munmap(data, length);
+    }
+    SHA256_Final(hash, &ctx);
+    return true;
+}
+
 // Compute and return the hash (SHA-256) of the secondary dex file at dex_path.
 // Returns true if all parameters are valid and the hash successfully computed and stored in
 // out_secondary_dex_hash.
@@ -2043,10 +2125,11 @@ bool hash_secondary_dex_file(const std::string& dex_path, const std::string& pkg
         return false;
     }
 
-    // Pipe to get the hash result back from our child process.
-    unique_fd pipe_read, pipe_write;
-    if (!Pipe(&pipe_read, &pipe_write)) {
-        PLOG(ERROR) << "Failed to create pipe";
+    // Socket to exchange the file's stat and its hash with our child process. The parent sends
+    // with MSG_NOSIGNAL, so a child that died early doesn't take installd down with SIGPIPE.
+    unique_fd parent_socket, child_socket;
+    if (!Socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, &parent_socket, &child_socket)) {
+        PLOG(ERROR) << "Failed to create socket pair";
         return false;
     }
 
@@ -2056,7 +2139,7 @@ bool hash_secondary_dex_file(const std::string& dex_path, const std::string& pkg
     if (pid == 0) {
         // child -- drop privileges before continuing
         drop_capabilities(uid);
-        pipe_read.reset();
+        parent_socket.reset();
 
         if (!validate_secondary_dex_path(pkgname, dex_path, volume_uuid_cstr, uid, storage_flag)) {
             async_safe_format_log(ANDROID_LOG_ERROR, LOG_TAG,
@@ -2076,26 +2159,29 @@ bool hash_secondary_dex_file(const std::string& dex_path, const std::string& pkg
             _exit(DexoptReturnCodes::kHashOpenPath);
         }
 
-        SHA256_CTX ctx;
-        SHA256_Init(&ctx);
-
-        std::vector<uint8_t> buffer(65536);
-        while (true) {
-            ssize_t bytes_read = TEMP_FAILURE_RETRY(read(fd, buffer.data(), buffer.size()));
-            if (bytes_read == 0) {
-                break;
-            } else if (bytes_read == -1) {
-                async_safe_format_log(ANDROID_LOG_ERROR, LOG_TAG,
-                        "Failed to read secondary dex %s: %d", dex_path.c_str(), errno);
-                _exit(DexoptReturnCodes::kHashReadDex);
-            }
-
-            SHA256_Update(&ctx, buffer.data(), bytes_read);
+        // Let the parent look for a hash of this very version of the file first.
+        SecondaryDexFileStat file_stat;
+        if (!get_secondary_dex_file_stat(fd, &file_stat)) {
+            async_safe_format_log(ANDROID_LOG_ERROR, LOG_TAG,
+                    "Failed to stat secondary dex %s: %d", dex_path.c_str(), errno);
+            _exit(DexoptReturnCodes::kHashReadDex);
+        }
+        char hash_needed = 0;
+        if (!WriteFully(child_socket, &file_stat, sizeof(file_stat))
+                || !ReadFully(child_socket, &hash_needed, sizeof(hash_needed))) {
+            _exit(DexoptReturnCodes::kHashWrite);
+        }
+        if (!hash_needed) {
+            _exit(0);
         }
 
         std::array<uint8_t, SHA256_DIGEST_LENGTH> hash;
-        SHA256_Final(hash.data(), &ctx);
-        if (!WriteFully(pipe_write, hash.data(), hash.size())) {
+        if (!hash_file(fd, file_stat.size, hash.data())) {
+            async_safe_format_log(ANDROID_LOG_ERROR, LOG_TAG,
+                    "Failed to read secondary dex %s: %d", dex_path.c_str(), errno);
+            _exit(DexoptReturnCodes::kHashReadDex);
+        }
+        if (!WriteFully(child_socket, hash.data(), hash.size())) {
             _exit(DexoptReturnCodes::kHashWrite);
         }
 
@@ -2103,13 +2189,33 @@ bool hash_secondary_dex_file(const std::string& dex_path, const std::string& pkg
     }
 
     // parent
-    pipe_write.reset();
+    child_socket.reset();
+
+    SecondaryDexFileStat file_stat;
+    if (!ReadFully(parent_socket, &file_stat, sizeof(file_stat))) {
+        // The file doesn't exist, isn't accessible to the app, or the child failed.
+        return wait_child(pid) == 0;
+    }
 
-    out_secondary_dex_hash->resize(SHA256_DIGEST_LENGTH);
-    if (!ReadFully(pipe_read, out_secondary_dex_hash->data(), out_secondary_dex_hash->size())) {
+    char hash_needed = !find_secondary_dex_hash(file_stat, out_secondary_dex_hash);
+    if (TEMP_FAILURE_RETRY(send(parent_socket, &hash_needed, sizeof(hash_needed),
+            MSG_NOSIGNAL)) != sizeof(hash_needed)) {
         out_secondary_dex_hash->clear();
+    } else if (hash_needed) {
+        out_secondary_dex_hash->resize(SHA256_DIGEST_LENGTH);
+        if (!ReadFully(parent_socket, out_secondary_dex_hash->data(),
+                out_secondary_dex_hash->size())) {
+            out_secondary_dex_hash->clear();
+        }
+    }
+    if (wait_child(pid) != 0) {
+        out_secondary_dex_hash->clear();
+        return false;
+    }
+    if (hash_needed && !out_secondary_dex_hash->empty()) {
+        save_secondary_dex_hash(file_stat, *out_secondary_dex_hash);
     }
-    return wait_child(pid) == 0;
+    return true;
 }
 
 // Helper for move_ab, so that we can have common failure-case cleanup.
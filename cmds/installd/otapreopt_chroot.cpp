@@ -16,19 +16,26 @@
 
 #include <fcntl.h>
 #include <linux/unistd.h>
+#include <string.h>
 #include <sys/mount.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
+#include <unistd.h>
 
+#include <algorithm>
 #include <array>
 #include <fstream>
+#include <iostream>
+#include <set>
 #include <sstream>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/macros.h>
+#include <android-base/parseint.h>
 #include <android-base/scopeguard.h>
 #include <android-base/stringprintf.h>
+#include <android-base/strings.h>
 #include <android-base/unique_fd.h>
 #include <libdm/dm.h>
 #include <selinux/android.h>
@@ -113,8 +120,87 @@ static void TryExtraMount(const char* name, const char* slot, const char* target
     UNUSED(mount_result);
 }
 
+// Starts otapreopt in its own process, without waiting for it.
+static pid_t StartOtapreopt(const std::vector<std::string>& cmd) {
+    std::vector<char*> args;
+    for (const std::string& arg : cmd) {
+        args.push_back(const_cast<char*>(arg.c_str()));
+    }
+    args.push_back(nullptr);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        // No allocation allowed between fork and exec.
+
+        // Change process groups, so we don't get reaped by ProcessManager.
+        setpgid(0, 0);
+
+        execv(args[0], &args[0]);
+
+        PLOG(ERROR) << "Failed to execv(" << cmd[0] << ")";
+        // _exit to avoid atexit handlers in child.
+        _exit(1);
+    }
+    if (pid == -1) {
+        PLOG(ERROR) << "Failed to fork for otapreopt";
+    }
+    return pid;
+}
+
+// Runs otapreopt for each line of dexopt parameters read from stdin, with up to the given
+// number of them running at once. The chroot is only set up once for all of them.
+static int RunOtapreoptStream(const char* target_slot, size_t jobs) {
+    std::set<pid_t> children;
+    size_t failures = 0;
+    auto wait_child = [&]() {
+        int status;
+        pid_t pid = TEMP_FAILURE_RETRY(waitpid(-1, &status, 0));
+        if (pid == -1) {
+            PLOG(ERROR) << "Failed to wait for otapreopt";
+            children.clear();
+        } else if (children.erase(pid) != 0
+                && (!WIFEXITED(status) || WEXITSTATUS(status) != 0)) {
+            LOG(ERROR) << "otapreopt " << pid << " failed with status " << status;
+            failures++;
+        }
+    };
+
+    std::string line;
+    size_t packages = 0;
+    while (std::getline(std::cin, line)) {
+        std::vector<std::string> cmd = { "/system/bin/otapreopt", target_slot };
+        for (const std::string& arg : android::base::Split(line, " ")) {
+            if (!arg.empty()) {
+                cmd.push_back(arg);
+            }
+        }
+        if (cmd.size() == 2) {
+            continue;
+        }
+        while (children.size() >= jobs) {
+            wait_child();
+        }
+        pid_t pid = StartOtapreopt(cmd);
+        if (pid == -1) {
+            failures++;
+        } else {
+            children.insert(pid);
+        }
+        packages++;
+    }
+    while (!children.empty()) {
+        wait_child();
+    }
+
+    LOG(INFO) << "Ran otapreopt for " << packages << " packages with up to " << jobs
+              << " at once, " << failures << " failed";
+    return failures == 0 ? 0 : 213;
+}
+
 // Entry for otapreopt_chroot. Expected parameters are:
 //   [cmd] [status-fd] [target-slot] "dexopt" [dexopt-params]
+// or, to set up the chroot once and run otapreopt for each line of dexopt-params on stdin:
+//   [cmd] [status-fd] [target-slot] "--stream" [jobs]
 // The file descriptor denoted by status-fd will be closed. The rest of the parameters will
 // be passed on to otapreopt in the chroot.
 static int otapreopt_chroot(const int argc, char **arg) {
@@ -124,10 +210,20 @@ static int otapreopt_chroot(const int argc, char **arg) {
         PLOG(ERROR) << "Not enough arguments.";
         exit(208);
     }
+    const bool stream = argc >= 4 && strcmp(arg[3], "--stream") == 0;
+    // By default, run as many otapreopt as half the CPUs, since each dex2oat is multithreaded.
+    size_t jobs = std::max(1L, sysconf(_SC_NPROCESSORS_ONLN) / 2);
+    if (stream && argc >= 5 && !android::base::ParseUint(arg[4], &jobs, size_t(64))) {
+        LOG(ERROR) << "Invalid number of jobs: " << arg[4];
+        exit(208);
+    }
+    jobs = std::max(jobs, size_t(1));
     // Close all file descriptors. They are coming from the caller, we do not want to pass them
     // on across our fork/exec into a different domain.
-    // 1) Default descriptors.
-    CloseDescriptor(STDIN_FILENO);
+    // 1) Default descriptors. When streaming, stdin carries the dexopt parameters.
+    if (!stream) {
+        CloseDescriptor(STDIN_FILENO);
+    }
     CloseDescriptor(STDOUT_FILENO);
     CloseDescriptor(STDERR_FILENO);
     // 2) The status channel.
@@ -314,6 +410,13 @@ static int otapreopt_chroot(const int argc, char **arg) {
     }
 
     // Now go on and run otapreopt.
+    if (stream) {
+        int result = RunOtapreoptStream(arg[2], jobs);
+        if (result != 0) {
+            exit(result);
+        }
+        return 0;
+    }
 
     // Incoming:  cmd + status-fd + target-slot + cmd...      | Incoming | = argc
     // Outgoing:  cmd             + target-slot + cmd...      | Outgoing | = argc - 1
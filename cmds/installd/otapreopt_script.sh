@@ -58,23 +58,24 @@ PREPARE=$(cmd otadexopt prepare)
 PROGRESS=$(cmd otadexopt progress)
 print -u${STATUS_FD} "global_progress $PROGRESS"
 
+# Stream the parameters of each package to a single otapreopt_chroot, which sets up the
+# chroot once and runs several otapreopt at a time.
 i=0
 while ((i<MAXIMUM_PACKAGES)) ; do
   DEXOPT_PARAMS=$(cmd otadexopt next)
 
-  /system/bin/otapreopt_chroot $STATUS_FD $TARGET_SLOT_SUFFIX $DEXOPT_PARAMS >&- 2>&-
+  echo "$DEXOPT_PARAMS"
 
   PROGRESS=$(cmd otadexopt progress)
   print -u${STATUS_FD} "global_progress $PROGRESS"
 
   DONE=$(cmd otadexopt done)
   if [ "$DONE" = "OTA incomplete." ] ; then
-    sleep 1
     i=$((i+1))
     continue
   fi
   break
-done
+done | /system/bin/otapreopt_chroot $STATUS_FD $TARGET_SLOT_SUFFIX --stream >&- 2>&-
 
 DONE=$(cmd otadexopt done)
 if [ "$DONE" = "OTA incomplete." ] ; then
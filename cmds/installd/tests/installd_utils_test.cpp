@@ -16,9 +16,13 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/scopeguard.h>
+#include <android-base/stringprintf.h>
 #include <gtest/gtest.h>
 
 #include "InstalldNativeService.h"
@@ -42,6 +46,10 @@
 
 #define TEST_PROFILE_DIR "/data/misc/profiles"
 
+using android::base::ReadFileToString;
+using android::base::StringPrintf;
+using android::base::WriteStringToFile;
+
 namespace android {
 namespace installd {
 
@@ -638,5 +646,87 @@ TEST_F(UtilsTest, TestCreateDirIfNeeded) {
     ASSERT_NE(0, create_dir_if_needed("/data/local/tmp/user/0/bar/baz", 0700));
 }
 
+TEST_F(UtilsTest, TestCalculateTreeSize) {
+    system("mkdir -p /data/local/tmp/user/0");
+
+    auto deleter = [&]() {
+        delete_dir_contents_and_dir("/data/local/tmp/user/0", true /* ignore_if_missing */);
+    };
+    auto scope_guard = android::base::make_scope_guard(deleter);
+
+    // Enough directories for several threads to measure the tree at once.
+    int64_t expected = 0;
+    struct stat st;
+    ASSERT_EQ(0, mkdir("/data/local/tmp/user/0/tree", 0700));
+    ASSERT_EQ(0, stat("/data/local/tmp/user/0/tree", &st));
+    expected += st.st_blocks * 512;
+    for (int i = 0; i < 16; i++) {
+        std::string dir = StringPrintf("/data/local/tmp/user/0/tree/%d", i);
+        ASSERT_EQ(0, mkdir(dir.c_str(), 0700));
+        for (int j = 0; j < 4; j++) {
+            std::string subdir = StringPrintf("%s/%d", dir.c_str(), j);
+            ASSERT_EQ(0, mkdir(subdir.c_str(), 0700));
+            ASSERT_TRUE(WriteStringToFile(std::string(8192, 'x'), subdir + "/file"));
+            ASSERT_EQ(0, stat(subdir.c_str(), &st));
+            expected += st.st_blocks * 512;
+            ASSERT_EQ(0, stat((subdir + "/file").c_str(), &st));
+            expected += st.st_blocks * 512;
+        }
+        ASSERT_EQ(0, stat(dir.c_str(), &st));
+        expected += st.st_blocks * 512;
+    }
+
+    // Symbolic links are measured but not followed.
+    ASSERT_EQ(0, symlink("/data/local/tmp/user/0/tree/0",
+            "/data/local/tmp/user/0/tree/link"));
+    ASSERT_EQ(0, lstat("/data/local/tmp/user/0/tree/link", &st));
+    expected += st.st_blocks * 512;
+
+    int64_t size = 0;
+    ASSERT_EQ(0, calculate_tree_size("/data/local/tmp/user/0/tree", &size));
+    EXPECT_EQ(expected, size);
+
+    // The size is added to the one given.
+    ASSERT_EQ(0, calculate_tree_size("/data/local/tmp/user/0/tree", &size));
+    EXPECT_EQ(2 * expected, size);
+
+    size = 0;
+    EXPECT_EQ(-1, calculate_tree_size("/data/local/tmp/user/0/missing", &size));
+    EXPECT_EQ(0, size);
+}
+
+TEST_F(UtilsTest, TestCloneDirectory) {
+    system("mkdir -p /data/local/tmp/user/0/from/dir");
+
+    auto deleter = [&]() {
+        delete_dir_contents_and_dir("/data/local/tmp/user/0", true /* ignore_if_missing */);
+    };
+    auto scope_guard = android::base::make_scope_guard(deleter);
+
+    ASSERT_TRUE(WriteStringToFile("contents", "/data/local/tmp/user/0/from/dir/file"));
+    ASSERT_EQ(0, chmod("/data/local/tmp/user/0/from/dir/file", 0640));
+    ASSERT_EQ(0, symlink("dir/file", "/data/local/tmp/user/0/from/link"));
+
+    int rc = clone_directory("/data/local/tmp/user/0/from", "/data/local/tmp/user/0/to");
+    if (rc == -EOPNOTSUPP || rc == -EXDEV || rc == -EINVAL) {
+        GTEST_SKIP() << "File system can't clone files";
+    }
+    ASSERT_EQ(0, rc);
+
+    std::string contents;
+    ASSERT_TRUE(ReadFileToString("/data/local/tmp/user/0/to/dir/file", &contents));
+    EXPECT_EQ("contents", contents);
+    struct stat st;
+    ASSERT_EQ(0, stat("/data/local/tmp/user/0/to/dir/file", &st));
+    EXPECT_EQ(0640, st.st_mode & ALLPERMS);
+    std::string target;
+    ASSERT_TRUE(android::base::Readlink("/data/local/tmp/user/0/to/link", &target));
+    EXPECT_EQ("dir/file", target);
+
+    // Cloning never writes into an existing directory.
+    EXPECT_EQ(-EEXIST, clone_directory("/data/local/tmp/user/0/from",
+            "/data/local/tmp/user/0/to"));
+}
+
 }  // namespace installd
 }  // namespace android
@@ -131,6 +131,8 @@ int rm_package_dir(const std::string& package_dir);
 
 int copy_dir_files(const char *srcname, const char *dstname, uid_t owner, gid_t group);
 
+int clone_directory(const std::string& from, const std::string& to);
+
 int64_t data_disk_free(const std::string& data_path);
 
 int get_path_inode(const std::string& path, ino_t *inode);
@@ -19,6 +19,7 @@
 #include <getopt.h>
 
 #include <algorithm>
+#include <atomic>
 #include <fstream>
 #include <functional>
 #include <iomanip>
@@ -26,6 +27,7 @@
 #include <map>
 #include <regex>
 #include <sstream>
+#include <thread>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
@@ -209,13 +211,20 @@ bool ListCommand::getPidInfo(
 }
 
 const BinderPidInfo* ListCommand::getPidInfoCached(pid_t serverPid) {
-    auto pair = mCachedPidInfos.insert({serverPid, BinderPidInfo{}});
-    if (pair.second /* did insertion take place? */) {
-        if (!getPidInfo(serverPid, &pair.first->second)) {
-            return nullptr;
+    CachedPidInfo* cached;
+    {
+        std::lock_guard<std::mutex> lock(mCachedPidInfosLock);
+        auto& slot = mCachedPidInfos[serverPid];
+        if (slot == nullptr) {
+            slot = std::make_unique<CachedPidInfo>();
         }
+        cached = slot.get();
     }
-    return &pair.first->second;
+    // Parsing the binder logs of a process is slow, so other PIDs aren't blocked meanwhile.
+    std::call_once(cached->once, [&] {
+        cached->valid = getPidInfo(serverPid, &cached->info);
+    });
+    return cached->valid ? &cached->info : nullptr;
 }
 
 bool ListCommand::shouldFetchHalType(const HalType &type) const {
@@ -437,6 +446,28 @@ std::string ListCommand::INIT_VINTF_NOTES{
     "       until they are updated.\n"
 };
 
+// Most of the time fetching an entry is spent waiting for a server or reading binder logs, so
+// entries are fetched on a few threads.
+static constexpr size_t kMaxFetchThreads = 4;
+
+// Calls func(i) for i in [0, count) on up to kMaxFetchThreads threads, including this one.
+static void forEachInParallel(size_t count, const std::function<void(size_t)>& func) {
+    std::atomic<size_t> next{0};
+    auto work = [&] {
+        for (size_t i = next++; i < count; i = next++) {
+            func(i);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < std::min(kMaxFetchThreads, count); ++i) {
+        threads.emplace_back(work);
+    }
+    work();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
 static vintf::Arch fromBaseArchitecture(::android::hidl::base::V1_0::DebugInfo::Architecture a) {
     switch (a) {
         case ::android::hidl::base::V1_0::DebugInfo::Architecture::IS_64BIT:
@@ -467,13 +498,27 @@ void ListCommand::dumpTable(const NullableOStream<std::ostream>& out) const {
         // on the "mServicesTable".
         std::function<std::string(const std::string&)> emitDebugInfo = nullptr;
         if (mEmitDebugInfo && &table == &mServicesTable) {
-            emitDebugInfo = [this](const auto& iName) {
+            // Each debug call waits for its service, so they are all made in parallel first.
+            std::vector<std::string> names;
+            for (const TableEntry& entry : table) {
+                names.push_back(entry.interfaceName);
+            }
+            std::vector<std::string> debugInfos(names.size());
+            forEachInParallel(names.size(), [&](size_t i) {
                 std::stringstream ss;
-                auto pair = splitFirst(iName, '/');
+                auto pair = splitFirst(names[i], '/');
                 mLshal.emitDebugInfo(pair.first, pair.second, {},
                                      ParentDebugInfoLevel::FQNAME_ONLY, ss,
                                      NullableOStream<std::ostream>(nullptr));
-                return ss.str();
+                debugInfos[i] = ss.str();
+            });
+            std::map<std::string, std::string> debugInfoByName;
+            for (size_t i = 0; i < names.size(); ++i) {
+                debugInfoByName.emplace(names[i], std::move(debugInfos[i]));
+            }
+            emitDebugInfo = [debugInfoByName = std::move(debugInfoByName)](const auto& iName) {
+                auto it = debugInfoByName.find(iName);
+                return it != debugInfoByName.end() ? it->second : std::string();
             };
         }
         table.createTextTable(mNeat, emitDebugInfo).dump(out.buf());
@@ -585,18 +630,23 @@ Status ListCommand::fetchBinderized(const sp<IServiceManager> &manager) {
         return DUMP_BINDERIZED_ERROR;
     }
 
-    Status status = OK;
     std::map<std::string, TableEntry> allTableEntries;
+    std::vector<TableEntry*> entries;
     for (const auto &fqInstanceName : fqInstanceNames) {
         // create entry and default assign all fields.
         TableEntry& entry = allTableEntries[fqInstanceName];
         entry.interfaceName = fqInstanceName;
         entry.transport = mode;
         entry.serviceStatus = ServiceStatus::NON_RESPONSIVE;
-
-        status |= fetchBinderizedEntry(manager, &entry);
+        entries.push_back(&entry);
     }
 
+    // Every call made for an entry has its own timeout, so a hung server only holds one thread.
+    std::atomic<Status> status{OK};
+    forEachInParallel(entries.size(), [&](size_t i) {
+        status |= fetchBinderizedEntry(manager, entries[i]);
+    });
+
     for (auto& pair : allTableEntries) {
         putEntry(HalType::BINDERIZED_SERVICES, std::move(pair.second));
     }
@@ -607,6 +657,7 @@ Status ListCommand::fetchBinderizedEntry(const sp<IServiceManager> &manager,
                                          TableEntry *entry) {
     Status status = OK;
     const auto handleError = [&](Status additionalError, const std::string& msg) {
+        std::lock_guard<std::mutex> lock(mErrLock);
         err() << "Warning: Skipping \"" << entry->interfaceName << "\": " << msg << std::endl;
         status |= DUMP_BINDERIZED_ERROR | additionalError;
     };
@@ -20,6 +20,8 @@
 #include <stdint.h>
 
 #include <fstream>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -106,7 +108,8 @@ protected:
     // /dev/binderfs/binder_logs or /d/binder.
     // It is a virtual member function so that it can be mocked.
     virtual bool getPidInfo(pid_t serverPid, BinderPidInfo *info) const;
-    // Retrieve from mCachedPidInfos and call getPidInfo if necessary.
+    // Retrieve from mCachedPidInfos and call getPidInfo if necessary. Thread-safe; getPidInfo
+    // is called once per PID.
     const BinderPidInfo* getPidInfoCached(pid_t serverPid);
 
     void dumpTable(const NullableOStream<std::ostream>& out) const;
@@ -185,8 +188,17 @@ protected:
     // If an entry exist and not empty, it contains the cached content of /proc/{pid}/cmdline.
     std::map<pid_t, std::string> mCmdlines;
 
-    // Cache for getPidInfo.
-    std::map<pid_t, BinderPidInfo> mCachedPidInfos;
+    // Cache for getPidInfo. The entries are filled in outside of the lock, once.
+    struct CachedPidInfo {
+        std::once_flag once;
+        bool valid = false;
+        BinderPidInfo info;
+    };
+    std::mutex mCachedPidInfosLock;
+    std::map<pid_t, std::unique_ptr<CachedPidInfo>> mCachedPidInfos;
+
+    // Serializes the messages of the entries fetched in parallel.
+    std::mutex mErrLock;
 
     // Cache for getPartition.
     std::map<pid_t, Partition> mPartitions;
@@ -0,0 +1,307 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+ /*
+  * working_set samples the working set of running processes. It marks the
+  * pages mapped by the processes idle through /sys/kernel/mm/page_idle/bitmap,
+  * waits, and then reports for every mapping how many of its resident bytes
+  * were accessed meanwhile (hot) and how many were not (cold).
+  *
+  * The physical pages of each process are found through /proc/PID/pagemap,
+  * which, like the idle page bitmap, requires root. The processes are read on
+  * several threads, and no page is touched, so the processes sampled are not
+  * slowed down the way a showmap run slows them down.
+  *
+  * usage: working_set [-d SECONDS] [-t THREADS] [PID...]
+  */
+
+#define LOG_TAG "working_set"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <android-base/file.h>
+#include <android-base/parseint.h>
+#include <android-base/stringprintf.h>
+#include <android-base/strings.h>
+#include <android-base/unique_fd.h>
+#include <log/log.h>
+
+namespace {
+
+constexpr const char* kPageIdleBitmapPath = "/sys/kernel/mm/page_idle/bitmap";
+constexpr uint64_t kPagemapPresent = 1ULL << 63;
+constexpr uint64_t kPagemapPfnMask = (1ULL << 55) - 1;
+
+struct Mapping {
+    std::string name;
+    uint64_t start;
+    uint64_t end;
+    // Page frames of the resident pages of the mapping.
+    std::vector<uint64_t> pfns;
+    uint64_t hotPages = 0;
+    uint64_t coldPages = 0;
+};
+
+struct Process {
+    pid_t pid;
+    std::string cmdline;
+    std::vector<Mapping> mappings;
+};
+
+// Reads the mappings of a process, and the page frames of their resident pages.
+bool read_process(Process* process) {
+    std::string maps;
+    if (!::android::base::ReadFileToString(
+                ::android::base::StringPrintf("/proc/%d/maps", process->pid), &maps)) {
+        return false;
+    }
+    ::android::base::unique_fd pagemap(TEMP_FAILURE_RETRY(open(
+            ::android::base::StringPrintf("/proc/%d/pagemap", process->pid).c_str(),
+            O_RDONLY | O_CLOEXEC)));
+    if (pagemap == -1) {
+        return false;
+    }
+    ::android::base::ReadFileToString(
+            ::android::base::StringPrintf("/proc/%d/cmdline", process->pid), &process->cmdline);
+    process->cmdline = process->cmdline.c_str();
+
+    const uint64_t pageSize = getpagesize();
+    std::vector<uint64_t> entries;
+    for (const std::string& line : ::android::base::Split(maps, "\n")) {
+        Mapping mapping;
+        int nameOffset = 0;
+        if (sscanf(line.c_str(), "%" SCNx64 "-%" SCNx64 " %*s %*s %*s %*s %n", &mapping.start,
+                   &mapping.end, &nameOffset) < 2) {
+            continue;
+        }
+        mapping.name = line.substr(nameOffset);
+        // Reads the pagemap entries of the whole mapping at once.
+        const uint64_t pages = (mapping.end - mapping.start) / pageSize;
+        entries.resize(pages);
+        const off64_t offset = mapping.start / pageSize * sizeof(uint64_t);
+        if (!::android::base::ReadFullyAtOffset(pagemap, entries.data(),
+                                               pages * sizeof(uint64_t), offset)) {
+            continue;
+        }
+        for (uint64_t entry : entries) {
+            if ((entry & kPagemapPresent) && (entry & kPagemapPfnMask) != 0) {
+                mapping.pfns.push_back(entry & kPagemapPfnMask);
+            }
+        }
+        if (!mapping.pfns.empty()) {
+            process->mappings.push_back(std::move(mapping));
+        }
+    }
+    return true;
+}
+
+// Calls func(i) for i in [0, count) on |threads| threads.
+template <typename Func>
+void for_each_in_parallel(size_t count, size_t threads, Func func) {
+    std::atomic<size_t> next(0);
+    auto work = [&] {
+        for (size_t i = next++; i < count; i = next++) {
+            func(i);
+        }
+    };
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < std::min(threads, count); i++) {
+        workers.emplace_back(work);
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+// Marks the given page frames idle. Each bit of the bitmap is a page frame, and
+// writing a 1 marks it idle.
+bool mark_idle(int bitmap, const std::vector<uint64_t>& pfns) {
+    std::vector<uint64_t> words;
+    for (uint64_t pfn : pfns) {
+        words.push_back(pfn / 64);
+    }
+    std::sort(words.begin(), words.end());
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+
+    // Writing whole words marks the other page frames of the words idle too, which
+    // only costs them an accessed bit they didn't need to lose.
+    const uint64_t allIdle = ~0ULL;
+    for (uint64_t word : words) {
+        if (!::android::base::WriteFullyAtOffset(bitmap, &allIdle, sizeof(allIdle),
+                                                 word * sizeof(uint64_t))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Counts the hot and cold pages of the mappings of |process|. The resident pages
+// of a mapping are mostly contiguous, so the last bitmap word read is reused.
+void count_idle(int bitmap, Process* process) {
+    uint64_t wordIndex = std::numeric_limits<uint64_t>::max();
+    uint64_t word = 0;
+    for (Mapping& mapping : process->mappings) {
+        for (uint64_t pfn : mapping.pfns) {
+            if (pfn / 64 != wordIndex) {
+                if (!::android::base::ReadFullyAtOffset(bitmap, &word, sizeof(word),
+                                                        pfn / 64 * sizeof(uint64_t))) {
+                    wordIndex = std::numeric_limits<uint64_t>::max();
+                    continue;
+                }
+                wordIndex = pfn / 64;
+            }
+            if (word & (1ULL << (pfn % 64))) {
+                mapping.coldPages++;
+            } else {
+                mapping.hotPages++;
+            }
+        }
+        mapping.pfns.clear();
+    }
+}
+
+std::vector<pid_t> list_pids() {
+    std::vector<pid_t> pids;
+    DIR* dirp = opendir("/proc");
+    if (dirp == nullptr) {
+        return pids;
+    }
+    struct dirent* entry;
+    while ((entry = readdir(dirp)) != nullptr) {
+        pid_t pid;
+        if (entry->d_type == DT_DIR && ::android::base::ParseInt(entry->d_name, &pid, 1)) {
+            pids.push_back(pid);
+        }
+    }
+    closedir(dirp);
+    return pids;
+}
+
+void usage() {
+    fprintf(stderr,
+            "usage: working_set [-d SECONDS] [-t THREADS] [PID...]\n"
+            "  -d: time to wait for the processes to access their pages [default 10]\n"
+            "  -t: number of threads reading the processes [default: number of CPUs]\n"
+            "  PID: processes to sample [default: all]\n");
+}
+}
+
+// Samples the working set of processes, and prints the hot and cold resident
+// kilobytes of each of their mappings.
+int main(int argc, char** argv) {
+    unsigned int delaySeconds = 10;
+    size_t threads = std::max(1U, std::thread::hardware_concurrency());
+    int opt;
+    while ((opt = getopt(argc, argv, "d:t:h")) != -1) {
+        switch (opt) {
+            case 'd':
+                if (!::android::base::ParseUint(optarg, &delaySeconds)) {
+                    usage();
+                    return 1;
+                }
+                break;
+            case 't':
+                if (!::android::base::ParseUint(optarg, &threads,
+                                                std::numeric_limits<size_t>::max()) ||
+                    threads == 0) {
+                    usage();
+                    return 1;
+                }
+                break;
+            default:
+                usage();
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    std::vector<pid_t> pids;
+    for (int i = optind; i < argc; i++) {
+        pid_t pid;
+        if (!::android::base::ParseInt(argv[i], &pid, 1)) {
+            usage();
+            return 1;
+        }
+        pids.push_back(pid);
+    }
+    if (pids.empty()) {
+        pids = list_pids();
+    }
+
+    ::android::base::unique_fd bitmap(
+            TEMP_FAILURE_RETRY(open(kPageIdleBitmapPath, O_RDWR | O_CLOEXEC)));
+    if (bitmap == -1) {
+        ALOGE("unable to open %s", kPageIdleBitmapPath);
+        fprintf(stderr, "unable to open %s: %s\n", kPageIdleBitmapPath, strerror(errno));
+        return 1;
+    }
+
+    std::vector<Process> processes(pids.size());
+    std::vector<bool> valid(pids.size());
+    for_each_in_parallel(pids.size(), threads, [&](size_t i) {
+        processes[i].pid = pids[i];
+        valid[i] = read_process(&processes[i]) && mark_idle(bitmap, [&] {
+            std::vector<uint64_t> pfns;
+            for (const Mapping& mapping : processes[i].mappings) {
+                pfns.insert(pfns.end(), mapping.pfns.begin(), mapping.pfns.end());
+            }
+            return pfns;
+        }());
+    });
+
+    sleep(delaySeconds);
+
+    for_each_in_parallel(pids.size(), threads, [&](size_t i) {
+        if (valid[i]) {
+            count_idle(bitmap, &processes[i]);
+        }
+    });
+
+    const uint64_t pageKb = getpagesize() / 1024;
+    printf("%8s %10s %10s  %s\n", "PID", "HOT_KB", "COLD_KB", "NAME");
+    for (size_t i = 0; i < processes.size(); i++) {
+        if (!valid[i]) {
+            continue;
+        }
+        const Process& process = processes[i];
+        uint64_t hotPages = 0;
+        uint64_t coldPages = 0;
+        for (const Mapping& mapping : process.mappings) {
+            hotPages += mapping.hotPages;
+            coldPages += mapping.coldPages;
+        }
+        printf("%8d %10" PRIu64 " %10" PRIu64 "  %s\n", process.pid, hotPages * pageKb,
+               coldPages * pageKb, process.cmdline.c_str());
+        for (const Mapping& mapping : process.mappings) {
+            printf("%8s %10" PRIu64 " %10" PRIu64 "    %s\n", "", mapping.hotPages * pageKb,
+                   mapping.coldPages * pageKb, mapping.name.c_str());
+        }
+    }
+    return 0;
+}
@@ -24,7 +24,13 @@
 #include <binder/Stability.h>
 #include <cutils/android_filesystem_config.h>
 #include <cutils/multiuser.h>
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <set>
 #include <thread>
+#include <unordered_map>
 
 #ifndef VENDORSERVICEMANAGER
 #include <vintf/VintfObject.h>
@@ -78,47 +84,114 @@ struct AidlName {
     }
 };
 
+// Index of the AIDL instances declared in the VINTF manifests, so that the
+// queries made for nearly every service lookup at boot do not walk the
+// manifests each time. It is rebuilt whenever libvintf hands out different
+// manifests (e.g. after they are re-read on APEX activation).
+class VintfIndex {
+public:
+    struct Instance {
+        // the manifest which declares this instance first
+        const char* description;
+        std::optional<std::string> updatableViaApex;
+    };
+
+    // 'name' is package.IFoo/instance
+    std::optional<Instance> find(const std::string& name) {
+        std::lock_guard<std::mutex> _l(mLock);
+        update();
+        auto it = mInstances.find(name);
+        if (it == mInstances.end()) return std::nullopt;
+        return it->second;
+    }
+
+    // 'interface' is package.IFoo
+    std::vector<std::string> getInstances(const std::string& interface) {
+        std::lock_guard<std::mutex> _l(mLock);
+        update();
+        auto it = mInterfaces.find(interface);
+        if (it == mInterfaces.end()) return {};
+        return it->second;
+    }
+
+private:
+    void update() {
+        std::vector<ManifestWithDescription> manifests;
+        (void)forEachManifest([&](const ManifestWithDescription& mwd) {
+            manifests.push_back(mwd);
+            return false; // continue
+        });
+        if (std::equal(manifests.begin(), manifests.end(), mManifests.begin(), mManifests.end(),
+                       [](const auto& a, const auto& b) { return a.manifest == b.manifest; })) {
+            return;
+        }
+
+        mManifests = std::move(manifests);
+        mInstances.clear();
+        mInterfaces.clear();
+
+        for (const ManifestWithDescription& mwd : mManifests) {
+            // Same precedence as querying the manifests one after the other:
+            // the first version of an instance in a manifest counts, and a
+            // later manifest overrides updatableViaApex.
+            std::set<std::string> seen;
+            std::map<std::string, std::set<std::string>> interfaces;
+            mwd.manifest->forEachInstance([&](const auto& manifestInstance) {
+                if (manifestInstance.format() != vintf::HalFormat::AIDL) return true;
+                std::string interface =
+                        manifestInstance.package() + "." + manifestInstance.interface();
+                std::string name = interface + "/" + manifestInstance.instance();
+                interfaces[interface].insert(manifestInstance.instance());
+                if (!seen.insert(name).second) return true;
+
+                auto it = mInstances.try_emplace(std::move(name), Instance{mwd.description, {}})
+                                  .first;
+                it->second.updatableViaApex = manifestInstance.updatableViaApex();
+                return true; // continue
+            });
+            for (auto& [interface, instances] : interfaces) {
+                std::vector<std::string>& all = mInterfaces[interface];
+                all.insert(all.end(), instances.begin(), instances.end());
+            }
+        }
+    }
+
+    std::mutex mLock;
+    // what the index was built from, in forEachManifest order
+    std::vector<ManifestWithDescription> mManifests;
+    std::unordered_map<std::string, Instance> mInstances;
+    std::unordered_map<std::string, std::vector<std::string>> mInterfaces;
+};
+
+static VintfIndex& getVintfIndex() {
+    static VintfIndex* index = new VintfIndex();
+    return *index;
+}
+
 static bool isVintfDeclared(const std::string& name) {
     AidlName aname;
     if (!AidlName::fill(name, &aname)) return false;
 
-    bool found = forEachManifest([&](const ManifestWithDescription& mwd) {
-        if (mwd.manifest->hasAidlInstance(aname.package, aname.iface, aname.instance)) {
-            LOG(INFO) << "Found " << name << " in " << mwd.description << " VINTF manifest.";
-            return true; // break
-        }
-        return false;  // continue
-    });
-
-    if (!found) {
-        // Although it is tested, explicitly rebuilding qualified name, in case it
-        // becomes something unexpected.
-        LOG(ERROR) << "Could not find " << aname.package << "." << aname.iface << "/"
-                   << aname.instance << " in the VINTF manifest.";
+    std::optional<VintfIndex::Instance> instance = getVintfIndex().find(name);
+    if (instance) {
+        LOG(INFO) << "Found " << name << " in " << instance->description << " VINTF manifest.";
+        return true;
     }
 
-    return found;
+    // Although it is tested, explicitly rebuilding qualified name, in case it
+    // becomes something unexpected.
+    LOG(ERROR) << "Could not find " << aname.package << "." << aname.iface << "/"
+               << aname.instance << " in the VINTF manifest.";
+    return false;
 }
 
 static std::optional<std::string> getVintfUpdatableApex(const std::string& name) {
     AidlName aname;
     if (!AidlName::fill(name, &aname)) return std::nullopt;
 
-    std::optional<std::string> updatableViaApex;
-
-    forEachManifest([&](const ManifestWithDescription& mwd) {
-        mwd.manifest->forEachInstance([&](const auto& manifestInstance) {
-            if (manifestInstance.format() != vintf::HalFormat::AIDL) return true;
-            if (manifestInstance.package() != aname.package) return true;
-            if (manifestInstance.interface() != aname.iface) return true;
-            if (manifestInstance.instance() != aname.instance) return true;
-            updatableViaApex = manifestInstance.updatableViaApex();
-            return false; // break (libvintf uses opposite convention)
-        });
-        return false; // continue
-    });
-
-    return updatableViaApex;
+    std::optional<VintfIndex::Instance> instance = getVintfIndex().find(name);
+    if (!instance) return std::nullopt;
+    return instance->updatableViaApex;
 }
 
 static std::vector<std::string> getVintfInstances(const std::string& interface) {
@@ -127,17 +200,8 @@ static std::vector<std::string> getVintfInstances(const std::string& interface)
         LOG(ERROR) << "VINTF interfaces require names in Java package format (e.g. some.package.foo.IFoo) but got: " << interface;
         return {};
     }
-    const std::string package = interface.substr(0, lastDot);
-    const std::string iface = interface.substr(lastDot+1);
-
-    std::vector<std::string> ret;
-    (void)forEachManifest([&](const ManifestWithDescription& mwd) {
-        auto instances = mwd.manifest->getAidlInstances(package, iface);
-        ret.insert(ret.end(), instances.begin(), instances.end());
-        return false;  // continue
-    });
 
-    return ret;
+    return getVintfIndex().getInstances(interface);
 }
 
 static bool meetsDeclarationRequirements(const sp<IBinder>& binder, const std::string& name) {
@@ -181,20 +245,38 @@ ServiceManager::~ServiceManager() {
 }
 
 Status ServiceManager::getService(const std::string& name, sp<IBinder>* outBinder) {
-    *outBinder = tryGetService(name, true);
+    *outBinder = tryGetService(mAccess->getCallingContext(), name, true);
     // returns ok regardless of result for legacy reasons
     return Status::ok();
 }
 
 Status ServiceManager::checkService(const std::string& name, sp<IBinder>* outBinder) {
-    *outBinder = tryGetService(name, false);
+    *outBinder = tryGetService(mAccess->getCallingContext(), name, false);
     // returns ok regardless of result for legacy reasons
     return Status::ok();
 }
 
-sp<IBinder> ServiceManager::tryGetService(const std::string& name, bool startIfNotFound) {
+Status ServiceManager::checkServices(const std::vector<std::string>& names,
+                                     std::vector<ServiceLookup>* outReturn) {
+    // resolved once, since it costs a getpidcon for every call
     auto ctx = mAccess->getCallingContext();
 
+    outReturn->reserve(names.size());
+    for (const std::string& name : names) {
+        ServiceLookup lookup;
+        lookup.service = tryGetService(ctx, name, false, &lookup.allowed);
+        lookup.isLazyService = mNameToClientCallback.count(name) > 0;
+        outReturn->push_back(std::move(lookup));
+    }
+
+    return Status::ok();
+}
+
+sp<IBinder> ServiceManager::tryGetService(const Access::CallingContext& ctx,
+                                          const std::string& name, bool startIfNotFound,
+                                          bool* outAllowed) {
+    if (outAllowed != nullptr) *outAllowed = false;
+
     sp<IBinder> out;
     Service* service = nullptr;
     if (auto it = mNameToService.find(name); it != mNameToService.end()) {
@@ -215,6 +297,8 @@ sp<IBinder> ServiceManager::tryGetService(const std::string& name, bool startIfN
         return nullptr;
     }
 
+    if (outAllowed != nullptr) *outAllowed = true;
+
     if (!out && startIfNotFound) {
         tryStartService(name);
     }
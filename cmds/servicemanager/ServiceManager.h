@@ -27,6 +27,7 @@ namespace android {
 using os::IClientCallback;
 using os::IServiceCallback;
 using os::ServiceDebugInfo;
+using os::ServiceLookup;
 
 class ServiceManager : public os::BnServiceManager, public IBinder::DeathRecipient {
 public:
@@ -36,6 +37,8 @@ public:
     // getService will try to start any services it cannot find
     binder::Status getService(const std::string& name, sp<IBinder>* outBinder) override;
     binder::Status checkService(const std::string& name, sp<IBinder>* outBinder) override;
+    binder::Status checkServices(const std::vector<std::string>& names,
+                                 std::vector<ServiceLookup>* outReturn) override;
     binder::Status addService(const std::string& name, const sp<IBinder>& binder,
                               bool allowIsolated, int32_t dumpPriority) override;
     binder::Status listServices(int32_t dumpPriority, std::vector<std::string>* outList) override;
@@ -87,7 +90,9 @@ private:
     // this updates the iterator to the next location
     void removeClientCallback(const wp<IBinder>& who, ClientCallbackMap::iterator* it);
 
-    sp<IBinder> tryGetService(const std::string& name, bool startIfNotFound);
+    // outAllowed, if set, is whether the caller passed the isolation and SELinux checks
+    sp<IBinder> tryGetService(const Access::CallingContext& ctx, const std::string& name,
+                              bool startIfNotFound, bool* outAllowed = nullptr);
 
     ServiceMap mNameToService;
     ServiceCallbackMap mNameToRegistrationCallback;
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <android-base/logging.h>
+#include <benchmark/benchmark.h>
+#include <vintf/VintfObject.h>
+
+#include "Access.h"
+#include "ServiceManager.h"
+
+using android::Access;
+using android::ServiceManager;
+using android::sp;
+
+// Allows everything, like the permissive service manager of test_sm.cpp.
+class PermissiveAccess : public Access {
+public:
+    CallingContext getCallingContext() override { return CallingContext{}; }
+    bool canAdd(const CallingContext&, const std::string&) override { return true; }
+    bool canFind(const CallingContext&, const std::string&) override { return true; }
+    bool canList(const CallingContext&) override { return true; }
+};
+
+static sp<ServiceManager> getPermissiveServiceManager() {
+    return sp<ServiceManager>::make(std::make_unique<PermissiveAccess>());
+}
+
+// Any AIDL instance declared on this device, as package.IFoo/instance.
+static std::optional<std::string> getDeclaredName() {
+    std::optional<std::string> name;
+    auto manifest = android::vintf::VintfObject::GetDeviceHalManifest();
+    if (manifest == nullptr) return name;
+    manifest->forEachInstance([&](const auto& instance) {
+        if (instance.format() != android::vintf::HalFormat::AIDL) return true;
+        name = instance.package() + "." + instance.interface() + "/" + instance.instance();
+        return false; // break
+    });
+    return name;
+}
+
+static void BM_isDeclared(benchmark::State& state) {
+    auto sm = getPermissiveServiceManager();
+    std::optional<std::string> name = getDeclaredName();
+    if (!name) {
+        state.SkipWithError("No AIDL instance declared in the device manifest");
+        return;
+    }
+
+    for (auto _ : state) {
+        bool declared = false;
+        CHECK(sm->isDeclared(*name, &declared).isOk());
+        CHECK(declared);
+    }
+}
+BENCHMARK(BM_isDeclared);
+
+static void BM_isDeclaredNotFound(benchmark::State& state) {
+    auto sm = getPermissiveServiceManager();
+    const std::string name = "android.does.not.exist.IFoo/default";
+
+    for (auto _ : state) {
+        bool declared = true;
+        CHECK(sm->isDeclared(name, &declared).isOk());
+        CHECK(!declared);
+    }
+}
+BENCHMARK(BM_isDeclaredNotFound);
+
+static void BM_updatableViaApex(benchmark::State& state) {
+    auto sm = getPermissiveServiceManager();
+    std::optional<std::string> name = getDeclaredName();
+    if (!name) {
+        state.SkipWithError("No AIDL instance declared in the device manifest");
+        return;
+    }
+
+    for (auto _ : state) {
+        std::optional<std::string> apex;
+        CHECK(sm->updatableViaApex(*name, &apex).isOk());
+        benchmark::DoNotOptimize(apex);
+    }
+}
+BENCHMARK(BM_updatableViaApex);
+
+static void BM_getDeclaredInstances(benchmark::State& state) {
+    auto sm = getPermissiveServiceManager();
+    std::optional<std::string> name = getDeclaredName();
+    if (!name) {
+        state.SkipWithError("No AIDL instance declared in the device manifest");
+        return;
+    }
+    const std::string interface = name->substr(0, name->find('/'));
+
+    for (auto _ : state) {
+        std::vector<std::string> instances;
+        CHECK(sm->getDeclaredInstances(interface, &instances).isOk());
+        CHECK(!instances.empty());
+    }
+}
+BENCHMARK(BM_getDeclaredInstances);
+
+int main(int argc, char** argv) {
+    // isDeclared logs every lookup, which would dominate the measurement
+    android::base::SetMinimumLogSeverity(android::base::FATAL);
+
+    ::benchmark::Initialize(&argc, argv);
+    if (::benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+    ::benchmark::RunSpecifiedBenchmarks();
+}
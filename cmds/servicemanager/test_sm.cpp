@@ -33,6 +33,7 @@ using android::ServiceManager;
 using android::binder::Status;
 using android::os::BnServiceCallback;
 using android::os::IServiceManager;
+using android::os::ServiceLookup;
 using testing::_;
 using testing::ElementsAre;
 using testing::NiceMock;
@@ -255,6 +256,42 @@ TEST(GetService, NotAllowedFromIsolated) {
     EXPECT_EQ(nullptr, out.get());
 }
 
+TEST(CheckServices, PerNamePermissions) {
+    std::unique_ptr<MockAccess> access = std::make_unique<NiceMock<MockAccess>>();
+
+    // one per addService, and only one for the whole batch
+    EXPECT_CALL(*access, getCallingContext())
+        .Times(3)
+        .WillRepeatedly(Return(Access::CallingContext{}));
+    EXPECT_CALL(*access, canAdd(_, _)).WillRepeatedly(Return(true));
+    EXPECT_CALL(*access, canFind(_, "foo")).WillOnce(Return(true));
+    EXPECT_CALL(*access, canFind(_, "bar")).WillOnce(Return(false));
+    EXPECT_CALL(*access, canFind(_, "baz")).WillOnce(Return(true));
+
+    sp<ServiceManager> sm = sp<NiceMock<MockServiceManager>>::make(std::move(access));
+
+    sp<IBinder> foo = getBinder();
+    EXPECT_TRUE(sm->addService("foo", foo, false /*allowIsolated*/,
+        IServiceManager::DUMP_FLAG_PRIORITY_DEFAULT).isOk());
+    EXPECT_TRUE(sm->addService("bar", getBinder(), false /*allowIsolated*/,
+        IServiceManager::DUMP_FLAG_PRIORITY_DEFAULT).isOk());
+
+    std::vector<ServiceLookup> out;
+    EXPECT_TRUE(sm->checkServices({"foo", "bar", "baz"}, &out).isOk());
+    ASSERT_EQ(3u, out.size());
+
+    EXPECT_EQ(foo, out[0].service);
+    EXPECT_TRUE(out[0].allowed);
+    EXPECT_FALSE(out[0].isLazyService);
+
+    EXPECT_EQ(nullptr, out[1].service);
+    EXPECT_FALSE(out[1].allowed);
+
+    // allowed, but not registered
+    EXPECT_EQ(nullptr, out[2].service);
+    EXPECT_TRUE(out[2].allowed);
+}
+
 TEST(ListServices, NoPermissions) {
     std::unique_ptr<MockAccess> access = std::make_unique<NiceMock<MockAccess>>();
 
@@ -19,12 +19,41 @@
 
 #include <android/native_window.h>
 #include <gui/Surface.h>
+#include <system/window.h>
+#include <ui/GraphicBuffer.h>
+
+#include <algorithm>
 
 using namespace android;
 
-BufferQueueScheduler::BufferQueueScheduler(
-        const sp<SurfaceControl>& surfaceControl, const HSV& color, int id)
-      : mSurfaceControl(surfaceControl), mColor(color), mSurfaceId(id), mContinueScheduling(true) {}
+namespace {
+
+void fillPixels(uint8_t* img, int width, int height, int stride, const RGB& color) {
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            uint8_t* pixel = img + (4 * (y * stride + x));
+            pixel[0] = color.r;
+            pixel[1] = color.g;
+            pixel[2] = color.b;
+            pixel[3] = LAYER_ALPHA;
+        }
+    }
+}
+
+}  // namespace
+
+bool FrameRecord::isPending() const {
+    return latchTime == NATIVE_WINDOW_TIMESTAMP_PENDING ||
+            presentTime == NATIVE_WINDOW_TIMESTAMP_PENDING;
+}
+
+BufferQueueScheduler::BufferQueueScheduler(const sp<SurfaceControl>& surfaceControl,
+        const HSV& color, int id, bool performanceMode)
+      : mSurfaceControl(surfaceControl),
+        mColor(color),
+        mSurfaceId(id),
+        mPerformanceMode(performanceMode),
+        mContinueScheduling(true) {}
 
 void BufferQueueScheduler::startScheduling() {
     ALOGV("Starting Scheduler for %d Layer", mSurfaceId);
@@ -43,7 +72,11 @@ void BufferQueueScheduler::startScheduling() {
             lock.unlock();
 
             bufferUpdate(event.dimensions);
-            fillSurface(event.event);
+            if (mPerformanceMode) {
+                postBuffer(event);
+            } else {
+                fillSurface(event.event);
+            }
             mColor.modulate();
             lock.lock();
             mBufferEvents.pop();
@@ -72,9 +105,41 @@ void BufferQueueScheduler::setSurfaceControl(
     mCondition.notify_one();
 }
 
+std::vector<FrameRecord> BufferQueueScheduler::collectFrames() {
+    std::lock_guard<std::mutex> lock(mFramesMutex);
+    updateFrameTimestampsLocked();
+    return mFrames;
+}
+
+void BufferQueueScheduler::preallocateBuffers(const sp<SurfaceControl>& surfaceControl,
+        const Dimensions& dimensions) {
+    sp<Surface> s = surfaceControl->getSurface();
+    ANativeWindow* window = s.get();
+
+    status_t status = native_window_api_connect(window, NATIVE_WINDOW_API_CPU);
+    if (status != NO_ERROR) {
+        ALOGE("preallocateBuffers: failed to connect to surface, (%d)", status);
+        return;
+    }
+
+    // The buffers are only written by the CPU the first time they are dequeued
+    native_window_set_usage(window, GRALLOC_USAGE_SW_WRITE_RARELY);
+    native_window_enable_frame_timestamps(window, true);
+    s->setBuffersDimensions(dimensions.width, dimensions.height);
+    s->allocateBuffers();
+}
+
 void BufferQueueScheduler::bufferUpdate(const Dimensions& dimensions) {
     sp<Surface> s = mSurfaceControl->getSurface();
     s->setBuffersDimensions(dimensions.width, dimensions.height);
+
+    if (mPerformanceMode && (dimensions.width != mDimensions.width ||
+                                    dimensions.height != mDimensions.height)) {
+        // Only allocates the buffers which are missing, or of the previous dimensions
+        s->allocateBuffers();
+        mDimensions = dimensions;
+        mFilledBuffers.clear();
+    }
 }
 
 void BufferQueueScheduler::fillSurface(const std::shared_ptr<Event>& event) {
@@ -88,18 +153,8 @@ void BufferQueueScheduler::fillSurface(const std::shared_ptr<Event>& event) {
         return;
     }
 
-    auto color = mColor.getRGB();
-
-    auto img = reinterpret_cast<uint8_t*>(outBuffer.bits);
-    for (int y = 0; y < outBuffer.height; y++) {
-        for (int x = 0; x < outBuffer.width; x++) {
-            uint8_t* pixel = img + (4 * (y * outBuffer.stride + x));
-            pixel[0] = color.r;
-            pixel[1] = color.g;
-            pixel[2] = color.b;
-            pixel[3] = LAYER_ALPHA;
-        }
-    }
+    fillPixels(reinterpret_cast<uint8_t*>(outBuffer.bits), outBuffer.width, outBuffer.height,
+            outBuffer.stride, mColor.getRGB());
 
     event->readyToExecute();
 
@@ -107,3 +162,77 @@ void BufferQueueScheduler::fillSurface(const std::shared_ptr<Event>& event) {
 
     ALOGE_IF(status != NO_ERROR, "fillSurface: failed to unlock and post buffer, (%d)", status);
 }
+
+void BufferQueueScheduler::postBuffer(const BufferEvent& event) {
+    sp<Surface> s = mSurfaceControl->getSurface();
+    ANativeWindow* window = s.get();
+
+    ANativeWindowBuffer* buffer = nullptr;
+    status_t status = native_window_dequeue_buffer_and_wait(window, &buffer);
+    if (status != NO_ERROR) {
+        ALOGE("postBuffer: failed to dequeue buffer, (%d)", status);
+        // The main loop still waits for the event
+        event.event->readyToExecute();
+        return;
+    }
+
+    sp<GraphicBuffer> graphicBuffer = GraphicBuffer::from(buffer);
+    if (std::find(mFilledBuffers.begin(), mFilledBuffers.end(), graphicBuffer->getId()) ==
+            mFilledBuffers.end()) {
+        void* bits = nullptr;
+        status = graphicBuffer->lock(GraphicBuffer::USAGE_SW_WRITE_RARELY, &bits);
+        if (status == NO_ERROR) {
+            fillPixels(reinterpret_cast<uint8_t*>(bits), graphicBuffer->getWidth(),
+                    graphicBuffer->getHeight(), graphicBuffer->getStride(), mColor.getRGB());
+            graphicBuffer->unlock();
+            mFilledBuffers.push_back(graphicBuffer->getId());
+        } else {
+            ALOGE("postBuffer: failed to lock buffer, (%d)", status);
+        }
+    }
+
+    FrameRecord frame;
+    frame.frameNumber = s->getNextFrameNumber();
+    frame.targetTime = event.targetTime;
+    frame.latchTime = NATIVE_WINDOW_TIMESTAMP_PENDING;
+    frame.presentTime = NATIVE_WINDOW_TIMESTAMP_PENDING;
+
+    event.event->readyToExecute();
+
+    status = window->queueBuffer(window, buffer, -1);
+    frame.queueTime = systemTime();
+    if (status != NO_ERROR) {
+        ALOGE("postBuffer: failed to queue buffer, (%d)", status);
+        frame.latchTime = NATIVE_WINDOW_TIMESTAMP_INVALID;
+        frame.presentTime = NATIVE_WINDOW_TIMESTAMP_INVALID;
+    }
+
+    std::lock_guard<std::mutex> lock(mFramesMutex);
+    mFrames.push_back(frame);
+    // Frames drop out of the history of the surface, so their timestamps are fetched as they come
+    updateFrameTimestampsLocked();
+}
+
+void BufferQueueScheduler::updateFrameTimestampsLocked() {
+    sp<Surface> s = mSurfaceControl->getSurface();
+
+    for (size_t i = mFirstPendingFrame; i < mFrames.size(); i++) {
+        FrameRecord& frame = mFrames[i];
+        if (!frame.isPending()) {
+            continue;
+        }
+
+        status_t status = s->getFrameTimestamps(frame.frameNumber, nullptr, nullptr,
+                &frame.latchTime, nullptr, nullptr, nullptr, &frame.presentTime, nullptr,
+                nullptr);
+        if (status != NO_ERROR) {
+            // The frame is no longer in the history, or its timestamps are not supported
+            frame.latchTime = NATIVE_WINDOW_TIMESTAMP_INVALID;
+            frame.presentTime = NATIVE_WINDOW_TIMESTAMP_INVALID;
+        }
+    }
+
+    while (mFirstPendingFrame < mFrames.size() && !mFrames[mFirstPendingFrame].isPending()) {
+        mFirstPendingFrame++;
+    }
+}
@@ -23,12 +23,14 @@
 #include <gui/SurfaceControl.h>
 
 #include <utils/StrongPointer.h>
+#include <utils/Timers.h>
 
 #include <atomic>
 #include <condition_variable>
 #include <mutex>
 #include <queue>
 #include <utility>
+#include <vector>
 
 namespace android {
 
@@ -44,15 +46,32 @@ struct Dimensions {
 
 struct BufferEvent {
     BufferEvent() = default;
-    BufferEvent(std::shared_ptr<Event> e, Dimensions d) : event(e), dimensions(d) {}
+    BufferEvent(std::shared_ptr<Event> e, Dimensions d, nsecs_t t = -1)
+          : event(e), dimensions(d), targetTime(t) {}
 
     std::shared_ptr<Event> event;
     Dimensions dimensions;
+    // When the main loop is due to signal the event, in performance mode
+    nsecs_t targetTime = -1;
+};
+
+// The timing of a buffer posted in performance mode. The times other than the target time are
+// NATIVE_WINDOW_TIMESTAMP_PENDING until known, or NATIVE_WINDOW_TIMESTAMP_INVALID if they never
+// will be, e.g. if the frame was dropped.
+struct FrameRecord {
+    uint64_t frameNumber = 0;
+    nsecs_t targetTime = -1;
+    nsecs_t queueTime = -1;
+    nsecs_t latchTime = -1;
+    nsecs_t presentTime = -1;
+
+    bool isPending() const;
 };
 
 class BufferQueueScheduler {
   public:
-    BufferQueueScheduler(const sp<SurfaceControl>& surfaceControl, const HSV& color, int id);
+    BufferQueueScheduler(const sp<SurfaceControl>& surfaceControl, const HSV& color, int id,
+            bool performanceMode = false);
 
     void startScheduling();
     void addEvent(const BufferEvent&);
@@ -60,6 +79,14 @@ class BufferQueueScheduler {
 
     void setSurfaceControl(const sp<SurfaceControl>& surfaceControl, const HSV& color);
 
+    // Fetches the pending timestamps of the posted frames, and returns the posted frames
+    std::vector<FrameRecord> collectFrames();
+
+    // Connects the surface for performance mode and allocates its buffers up front, so that
+    // replaying its buffer updates does not wait for allocations or CPU writes.
+    static void preallocateBuffers(const sp<SurfaceControl>& surfaceControl,
+            const Dimensions& dimensions);
+
   private:
     void bufferUpdate(const Dimensions& dimensions);
 
@@ -67,12 +94,27 @@ class BufferQueueScheduler {
     // then unlock and post the buffer.
     void fillSurface(const std::shared_ptr<Event>& event);
 
+    // Dequeue a buffer, filling it only the first time it is dequeued, block until the event
+    // is signaled by the main loop, then queue the buffer and record its timing.
+    void postBuffer(const BufferEvent& event);
+
+    void updateFrameTimestampsLocked();
+
     sp<SurfaceControl> mSurfaceControl;
     HSV mColor;
     const int mSurfaceId;
+    const bool mPerformanceMode;
 
     bool mContinueScheduling;
 
+    Dimensions mDimensions;
+    std::vector<uint64_t> mFilledBuffers;
+
+    std::mutex mFramesMutex;
+    std::vector<FrameRecord> mFrames;
+    // The first frame in mFrames which still has pending timestamps
+    size_t mFirstPendingFrame = 0;
+
     std::queue<BufferEvent> mBufferEvents;
     std::mutex mMutex;
     std::condition_variable mCondition;
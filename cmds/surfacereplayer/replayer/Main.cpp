@@ -51,6 +51,9 @@ void printHelpMenu() {
 
     std::cout << "  -l  Indefinitely loop the replayer\n";
 
+    std::cout << "  -p  Performance mode: preallocate buffers, replay on a precise timeline and "
+                 "report frame statistics (cannot be combined with -m or -s)\n";
+
     std::cout << "  -h  Display help menu\n";
 
     std::cout << std::endl;
@@ -63,9 +66,10 @@ int main(int argc, char** argv) {
     bool pauseBeginning = false;
     int numThreads = DEFAULT_THREADS;
     long stopHere = -1;
+    bool performanceMode = false;
 
     int opt = 0;
-    while ((opt = getopt(argc, argv, "mt:s:nlh?")) != -1) {
+    while ((opt = getopt(argc, argv, "mt:s:nlph?")) != -1) {
         switch (opt) {
             case 'm':
                 pauseBeginning = true;
@@ -82,6 +86,9 @@ int main(int argc, char** argv) {
             case 'l':
                 loop = true;
                 break;
+            case 'p':
+                performanceMode = true;
+                break;
             case 'h':
             case '?':
                 printHelpMenu();
@@ -93,6 +100,13 @@ int main(int argc, char** argv) {
         }
     }
 
+    if (performanceMode && (pauseBeginning || stopHere >= 0)) {
+        std::cerr << "Performance mode cannot be combined with manual replay...exiting"
+                  << std::endl;
+        printHelpMenu();
+        exit(0);
+    }
+
     char** input = argv + optind;
     if (input[0] == nullptr) {
         std::cerr << "No trace file provided...exiting" << std::endl;
@@ -102,7 +116,7 @@ int main(int argc, char** argv) {
 
     status_t status = NO_ERROR;
     do {
-        android::Replayer r(filename, pauseBeginning, numThreads, wait, stopHere);
+        android::Replayer r(filename, pauseBeginning, numThreads, wait, stopHere, performanceMode);
         status = r.replay();
     } while(loop);
 
@@ -19,6 +19,7 @@
 #include "Replayer.h"
 
 #include <android/native_window.h>
+#include <system/window.h>
 
 #include <android-base/file.h>
 
@@ -28,17 +29,20 @@
 #include <gui/Surface.h>
 #include <private/gui/ComposerService.h>
 
+#include <ui/DisplayConfig.h>
 #include <ui/DisplayInfo.h>
 #include <utils/Log.h>
 #include <utils/String8.h>
 #include <utils/Trace.h>
 
+#include <algorithm>
 #include <chrono>
 #include <cmath>
 #include <condition_variable>
 #include <cstdlib>
 #include <fstream>
 #include <functional>
+#include <iomanip>
 #include <iostream>
 #include <mutex>
 #include <sstream>
@@ -51,14 +55,15 @@ using namespace android;
 std::atomic_bool Replayer::sReplayingManually(false);
 
 Replayer::Replayer(const std::string& filename, bool replayManually, int numThreads, bool wait,
-        nsecs_t stopHere)
+        nsecs_t stopHere, bool performanceMode)
       : mTrace(),
         mLoaded(false),
         mIncrementIndex(0),
         mCurrentTime(0),
         mNumThreads(numThreads),
         mWaitForTimeStamps(wait),
-        mStopTimeStamp(stopHere) {
+        mStopTimeStamp(stopHere),
+        mPerformanceMode(performanceMode) {
     srand(RAND_COLOR_SEED);
 
     std::string input;
@@ -82,14 +87,16 @@ Replayer::Replayer(const std::string& filename, bool replayManually, int numThre
     }
 }
 
-Replayer::Replayer(const Trace& t, bool replayManually, int numThreads, bool wait, nsecs_t stopHere)
+Replayer::Replayer(const Trace& t, bool replayManually, int numThreads, bool wait, nsecs_t stopHere,
+        bool performanceMode)
       : mTrace(t),
         mLoaded(true),
         mIncrementIndex(0),
         mCurrentTime(0),
         mNumThreads(numThreads),
         mWaitForTimeStamps(wait),
-        mStopTimeStamp(stopHere) {
+        mStopTimeStamp(stopHere),
+        mPerformanceMode(performanceMode) {
     srand(RAND_COLOR_SEED);
     mCurrentTime = mTrace.increment(0).time_stamp();
 
@@ -114,6 +121,7 @@ status_t Replayer::replay() {
 
     SurfaceComposerClient::enableVSyncInjections(true);
 
+    mReplayStartTime = systemTime(SYSTEM_TIME_MONOTONIC);
     initReplay();
 
     ALOGV("Starting actual Replay!");
@@ -128,7 +136,11 @@ status_t Replayer::replay() {
         waitForConsoleCommmand();
 
         if (mWaitForTimeStamps) {
-            waitUntilTimestamp(mCurrentIncrement.time_stamp());
+            if (mPerformanceMode) {
+                waitUntilTargetTime(getTargetTime(mIncrementIndex));
+            } else {
+                waitUntilTimestamp(mCurrentIncrement.time_stamp());
+            }
         }
 
         auto event = mPendingIncrements.front();
@@ -153,12 +165,26 @@ status_t Replayer::replay() {
         mCurrentTime = mCurrentIncrement.time_stamp();
     }
 
+    // SurfaceFlinger needs its own vsyncs again to present the last frames
     SurfaceComposerClient::enableVSyncInjections(false);
 
+    if (mPerformanceMode) {
+        reportFrameStatistics();
+    }
+
     return status;
 }
 
 status_t Replayer::initReplay() {
+    if (mPerformanceMode) {
+        for (const auto& increment : mTrace.increment()) {
+            if (increment.increment_case() == Increment::kBufferUpdate) {
+                const auto& update = increment.buffer_update();
+                mInitialDimensions.emplace(update.id(), Dimensions(update.w(), update.h()));
+            }
+        }
+    }
+
     for (int i = 0; i < mNumThreads && i < mTrace.increment_size(); i++) {
         status_t status = dispatchEvent(i);
 
@@ -291,12 +317,13 @@ status_t Replayer::dispatchEvent(int index) {
             std::lock_guard<std::mutex> lock2(mBufferQueueSchedulerLock);
 
             Dimensions dimensions(increment.buffer_update().w(), increment.buffer_update().h());
-            BufferEvent bufferEvent(event, dimensions);
+            BufferEvent bufferEvent(event, dimensions,
+                    mPerformanceMode ? getTargetTime(index) : -1);
 
             auto layerId = increment.buffer_update().id();
             if (mBufferQueueSchedulers.count(layerId) == 0) {
                 mBufferQueueSchedulers[layerId] = std::make_shared<BufferQueueScheduler>(
-                        mLayers[layerId], mColors[layerId], layerId);
+                        mLayers[layerId], mColors[layerId], layerId, mPerformanceMode);
                 mBufferQueueSchedulers[layerId]->addEvent(bufferEvent);
 
                 std::thread(&BufferQueueScheduler::startScheduling,
@@ -630,6 +657,11 @@ status_t Replayer::createSurfaceControl(
         return BAD_VALUE;
     }
 
+    // The buffers must be allocated before the layer is handed to its BufferQueueScheduler
+    if (mPerformanceMode && mInitialDimensions.count(create.id()) != 0) {
+        BufferQueueScheduler::preallocateBuffers(surfaceControl, mInitialDimensions[create.id()]);
+    }
+
     std::lock_guard<std::mutex> lock1(mLayerLock);
     auto& layer = mLayers[create.id()];
     layer = surfaceControl;
@@ -692,6 +724,111 @@ void Replayer::waitUntilTimestamp(int64_t timestamp) {
     std::this_thread::sleep_for(std::chrono::nanoseconds(timestamp - mCurrentTime));
 }
 
+nsecs_t Replayer::getTargetTime(int index) {
+    return mReplayStartTime + mTrace.increment(index).time_stamp() -
+            mTrace.increment(0).time_stamp();
+}
+
+void Replayer::waitUntilTargetTime(nsecs_t targetTime) {
+    nsecs_t remaining = targetTime - systemTime(SYSTEM_TIME_MONOTONIC);
+    if (remaining > BUSY_WAIT_THRESHOLD) {
+        std::this_thread::sleep_for(std::chrono::nanoseconds(remaining - BUSY_WAIT_THRESHOLD));
+    }
+
+    // Waking up from a sleep is late by up to the threshold, so the rest of the wait spins
+    while (systemTime(SYSTEM_TIME_MONOTONIC) < targetTime) {
+    }
+}
+
+static double toMilliseconds(nsecs_t time) {
+    return static_cast<double>(time) / 1e6;
+}
+
+static std::string describeDistribution(std::vector<nsecs_t>& times) {
+    if (times.empty()) {
+        return "n/a";
+    }
+
+    std::sort(times.begin(), times.end());
+    auto percentile = [&](size_t p) { return toMilliseconds(times[(times.size() - 1) * p / 100]); };
+
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(3) << "p50=" << percentile(50)
+        << "ms p90=" << percentile(90) << "ms p99=" << percentile(99)
+        << "ms max=" << toMilliseconds(times.back()) << "ms";
+    return out.str();
+}
+
+void Replayer::reportFrameStatistics() {
+    std::vector<std::vector<FrameRecord>> layerFrames;
+    const nsecs_t deadline = systemTime(SYSTEM_TIME_MONOTONIC) + FRAME_TIMESTAMPS_TIMEOUT;
+    while (true) {
+        bool pending = false;
+        layerFrames.clear();
+        {
+            std::lock_guard<std::mutex> lock(mBufferQueueSchedulerLock);
+            for (const auto& [id, scheduler] : mBufferQueueSchedulers) {
+                layerFrames.push_back(scheduler->collectFrames());
+                const auto& frames = layerFrames.back();
+                pending |= std::any_of(frames.begin(), frames.end(),
+                        [](const FrameRecord& frame) { return frame.isPending(); });
+            }
+        }
+
+        if (!pending || systemTime(SYSTEM_TIME_MONOTONIC) >= deadline) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(16));
+    }
+
+    nsecs_t vsyncPeriod = s2ns(1) / 60;
+    DisplayConfig config;
+    const auto display = SurfaceComposerClient::getInternalDisplayToken();
+    if (display != nullptr &&
+        SurfaceComposerClient::getActiveDisplayConfig(display, &config) == NO_ERROR &&
+        config.refreshRate > 0) {
+        vsyncPeriod = static_cast<nsecs_t>(1e9f / config.refreshRate);
+    }
+
+    size_t posted = 0;
+    size_t presented = 0;
+    size_t janky = 0;
+    std::vector<nsecs_t> scheduleErrors;
+    std::vector<nsecs_t> latencies;
+    for (const auto& frames : layerFrames) {
+        const FrameRecord* previous = nullptr;
+        for (const auto& frame : frames) {
+            posted++;
+            scheduleErrors.push_back(frame.queueTime - frame.targetTime);
+
+            // Frames still pending after the timeout are counted as dropped
+            if (frame.presentTime < 0) {
+                continue;
+            }
+            presented++;
+            latencies.push_back(frame.presentTime - frame.queueTime);
+
+            // A frame is janky if it was presented later, relative to the previous frame of its
+            // layer, than the trace asked for by more than half a vsync
+            if (previous != nullptr &&
+                (frame.presentTime - previous->presentTime) -
+                                (frame.targetTime - previous->targetTime) >
+                        vsyncPeriod / 2) {
+                janky++;
+            }
+            previous = &frame;
+        }
+    }
+
+    std::cout << "Frame statistics:\n";
+    std::cout << "  Frames posted: " << posted << "\n";
+    std::cout << "  Frames presented: " << presented << " (" << posted - presented
+              << " dropped)\n";
+    std::cout << "  Janky frames: " << janky << "\n";
+    std::cout << "  Queue time error: " << describeDistribution(scheduleErrors) << "\n";
+    std::cout << "  Queue to present latency: " << describeDistribution(latencies) << std::endl;
+}
+
 void Replayer::waitUntilDeferredTransactionLayerExists(
         const DeferredTransactionChange& dtc, std::unique_lock<std::mutex>& lock) {
     if (mLayers.count(dtc.layer_id()) == 0 || mLayers[dtc.layer_id()] == nullptr) {
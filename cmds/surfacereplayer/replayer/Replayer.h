@@ -46,6 +46,11 @@ const auto DEFAULT_PATH = "/data/local/tmp/SurfaceTrace.dat";
 const auto RAND_COLOR_SEED = 700;
 const auto DEFAULT_THREADS = 3;
 
+// In performance mode, the replayer sleeps until this close to an increment's time, then spins
+const nsecs_t BUSY_WAIT_THRESHOLD = 200000;  // 200us
+// How long to wait for the timestamps of the last frames once the trace has been replayed
+const nsecs_t FRAME_TIMESTAMPS_TIMEOUT = 1000000000;  // 1s
+
 typedef int32_t layer_id;
 typedef int32_t display_id;
 
@@ -55,9 +60,10 @@ typedef google::protobuf::RepeatedPtrField<DisplayChange> DisplayChanges;
 class Replayer {
   public:
     Replayer(const std::string& filename, bool replayManually = false,
-            int numThreads = DEFAULT_THREADS, bool wait = true, nsecs_t stopHere = -1);
+            int numThreads = DEFAULT_THREADS, bool wait = true, nsecs_t stopHere = -1,
+            bool performanceMode = false);
     Replayer(const Trace& trace, bool replayManually = false, int numThreads = DEFAULT_THREADS,
-            bool wait = true, nsecs_t stopHere = -1);
+            bool wait = true, nsecs_t stopHere = -1, bool performanceMode = false);
 
     status_t replay();
 
@@ -133,6 +139,11 @@ class Replayer {
             display_id id, const ProjectionChange& pc);
 
     void waitUntilTimestamp(int64_t timestamp);
+    // Performance mode: the time at which an increment is replayed, on the monotonic timeline
+    // which starts with the replay
+    nsecs_t getTargetTime(int index);
+    void waitUntilTargetTime(nsecs_t targetTime);
+    void reportFrameStatistics();
     void waitUntilDeferredTransactionLayerExists(
             const DeferredTransactionChange& dtc, std::unique_lock<std::mutex>& lock);
     status_t loadSurfaceComposerClient();
@@ -152,6 +163,11 @@ class Replayer {
     bool mWaitForTimeStamps;
     nsecs_t mStopTimeStamp;
     bool mHasStopped;
+    bool mPerformanceMode;
+    nsecs_t mReplayStartTime = 0;
+
+    // The dimensions of the first buffer update of each layer, for preallocation
+    std::unordered_map<layer_id, Dimensions> mInitialDimensions;
 
     std::mutex mLayerLock;
     std::condition_variable mLayerCond;
@@ -25,6 +25,25 @@ __BEGIN_DECLS
 int64_t stat_size(struct stat *s);
 int64_t calculate_dir_size(int dfd);
 
+/*
+ * Cache of the directory listings read by calculate_dir_size_parallel(),
+ * keyed by directory inode and change time. Entries are still stat'ed on
+ * every call, as writes to a file don't change the times of its directory,
+ * but the listings of unchanged directories aren't read again.
+ * A cache may be shared by concurrent calls.
+ */
+struct dir_size_cache;
+
+struct dir_size_cache *dir_size_cache_create(void);
+void dir_size_cache_destroy(struct dir_size_cache *cache);
+
+/*
+ * Like calculate_dir_size(), but walking the tree with up to max_threads
+ * threads, or one per cpu if max_threads is 0. cache may be NULL.
+ */
+int64_t calculate_dir_size_parallel(int dfd, int max_threads,
+                                    struct dir_size_cache *cache);
+
 __END_DECLS
 
 #endif /* __LIBDISKUSAGE_DIRSIZE_H */
@@ -37,6 +37,16 @@ public:
 
     virtual void setInputWindows(const std::vector<InputWindowInfo>& inputHandles,
             const sp<ISetInputWindowsListener>& setInputWindowsListener) = 0;
+    /*
+     * Same as setInputWindows, but only sends the windows which changed since the previous
+     * update. windowIds lists the ids of all the input windows, in the same order as
+     * setInputWindows; the windows which are not listed are removed. changedWindows holds the
+     * windows which were added or changed. Each update must use the generation of the previous
+     * one plus one, where setInputWindows counts as generation 0.
+     */
+    virtual void updateInputWindows(uint64_t generation, const std::vector<int32_t>& windowIds,
+            const std::vector<InputWindowInfo>& changedWindows,
+            const sp<ISetInputWindowsListener>& setInputWindowsListener) = 0;
     virtual void registerInputChannel(const sp<InputChannel>& channel) = 0;
     virtual void unregisterInputChannel(const sp<InputChannel>& channel) = 0;
 };
@@ -50,7 +60,8 @@ public:
     enum {
         SET_INPUT_WINDOWS_TRANSACTION = IBinder::FIRST_CALL_TRANSACTION,
         REGISTER_INPUT_CHANNEL_TRANSACTION,
-        UNREGISTER_INPUT_CHANNEL_TRANSACTION
+        UNREGISTER_INPUT_CHANNEL_TRANSACTION,
+        UPDATE_INPUT_WINDOWS_TRANSACTION
     };
 
     virtual status_t onTransact(uint32_t code, const Parcel& data,
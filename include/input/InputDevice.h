@@ -175,6 +175,17 @@ extern std::string getInputDeviceConfigurationFilePathByDeviceIdentifier(
 extern std::string getInputDeviceConfigurationFilePathByName(
         const std::string& name, InputDeviceConfigurationFileType type);
 
+/*
+ * Gets the path of the precompiled binary form of a key layout or key character map file,
+ * if one is available and it is not older than the text file at the given path.
+ *
+ * The compiled file is generated at build time next to the text file, with the ".bin"
+ * extension appended to its name.
+ *
+ * Returns an empty string if not found.
+ */
+extern std::string getCompiledInputDeviceConfigurationFilePath(const std::string& path);
+
 enum ReservedInputDeviceId : int32_t {
     // Device id of a special "virtual" keyboard that is always present.
     VIRTUAL_KEYBOARD_ID = -1,
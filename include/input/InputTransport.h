@@ -29,7 +29,11 @@
  * The InputConsumer is used by the application to receive events from the input dispatcher.
  */
 
+#include <deque>
+#include <memory>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include <android-base/chrono_utils.h>
 
@@ -65,8 +69,12 @@ struct InputMessage {
         MOTION,
         FINISHED,
         FOCUS,
+        FINISHED_BATCH,
     };
 
+    // Maximum number of finished signals carried by a single FINISHED_BATCH message.
+    static constexpr uint32_t MAX_FINISHED_BATCH_SIZE = 32;
+
     struct Header {
         Type type; // 4 bytes
         // We don't need this field in order to align the body below but we
@@ -153,6 +161,7 @@ struct InputMessage {
         struct Finished {
             uint32_t seq;
             uint32_t handled; // actually a bool, but we must maintain 8-byte alignment
+            nsecs_t consumeTime; // The time when the consumer read the message, or 0
 
             inline size_t size() const { return sizeof(Finished); }
         } finished;
@@ -167,6 +176,18 @@ struct InputMessage {
 
             inline size_t size() const { return sizeof(Focus); }
         } focus;
+
+        struct FinishedBatch {
+            uint32_t count;
+            uint32_t empty1;
+            // Only the first "count" entries are sent, so this must be the last field.
+            Finished entries[MAX_FINISHED_BATCH_SIZE];
+
+            inline size_t size() const {
+                return sizeof(FinishedBatch) - sizeof(Finished) * MAX_FINISHED_BATCH_SIZE +
+                        sizeof(Finished) * count;
+            }
+        } finishedBatch;
     } __attribute__((aligned(8))) body;
 
     bool isValid(size_t actualSize) const;
@@ -195,13 +216,32 @@ public:
      * The two returned input channels are equivalent, and are labeled as "server" and "client"
      * for convenience. The two input channels share the same token.
      *
+     * The channels exchange messages through shared memory if the ro.input.shared_memory_channels
+     * system property is set, see below.
+     *
      * Return OK on success.
      */
     static status_t openInputChannelPair(const std::string& name,
             sp<InputChannel>& outServerChannel, sp<InputChannel>& outClientChannel);
 
+    /**
+     * Create a pair of input channels, optionally exchanging messages through shared memory.
+     *
+     * With useSharedMemory, each direction of the channel has a ring buffer in shared memory
+     * that messages are written to, and the socket is only used as a doorbell when a ring goes
+     * from empty to non-empty. This saves a send and a recv syscall per message when events
+     * arrive faster than they are consumed, at the cost of about 64KB of memory per channel.
+     * The fd can be polled, and sendMessage and receiveMessage behave the same either way.
+     *
+     * Return OK on success.
+     */
+    static status_t openInputChannelPair(const std::string& name,
+                                         sp<InputChannel>& outServerChannel,
+                                         sp<InputChannel>& outClientChannel, bool useSharedMemory);
+
     inline std::string getName() const { return mName; }
     inline int getFd() const { return mFd.get(); }
+    inline bool usesSharedMemory() const { return mSharedMemory != nullptr; }
 
     /* Send a message to the other endpoint.
      *
@@ -249,11 +289,40 @@ public:
     sp<IBinder> getConnectionToken() const;
 
 private:
-    InputChannel(const std::string& name, android::base::unique_fd fd, sp<IBinder> token);
+    struct SharedMemory;
+
+    static sp<InputChannel> create(const std::string& name, android::base::unique_fd fd,
+                                   sp<IBinder> token, std::shared_ptr<SharedMemory> sharedMemory,
+                                   bool isServer);
+    InputChannel(const std::string& name, android::base::unique_fd fd, sp<IBinder> token,
+                 std::shared_ptr<SharedMemory> sharedMemory, bool isServer);
+
+    status_t sendSharedMessage(const InputMessage* msg, size_t msgLength);
+    status_t receiveSharedMessage(InputMessage* msg);
+    status_t receiveDoorbells();
+
     std::string mName;
     android::base::unique_fd mFd;
 
     sp<IBinder> mToken;
+
+    // The rings that messages are exchanged through, or null if they are sent on the socket.
+    std::shared_ptr<SharedMemory> mSharedMemory;
+    // Whether this is the server end of the channel, which sends on the first ring and receives
+    // on the second one.
+    bool mIsServer;
+};
+
+/*
+ * The reply of the consumer to a dispatched event: its sequence number, and whether the
+ * consumer handled it.
+ */
+struct InputFinishedSignal {
+    uint32_t seq;
+    bool handled;
+    // The time when the consumer read the event from the channel, or 0 if unknown. It is filled
+    // in by InputConsumer, and reported to the publisher.
+    nsecs_t consumeTime = 0;
 };
 
 /*
@@ -324,9 +393,22 @@ public:
      */
     status_t receiveFinishedSignal(uint32_t* outSeq, bool* outHandled);
 
+    /* Receives the next message from the consumer, which may carry the finished signals of
+     * several messages, and appends the signals to outSignals.
+     *
+     * Returns OK on success.
+     * Returns WOULD_BLOCK if there is no signal present.
+     * Returns DEAD_OBJECT if the channel's peer has been closed.
+     * Other errors probably indicate that the channel is broken.
+     */
+    status_t receiveFinishedSignals(std::vector<InputFinishedSignal>* outSignals);
+
 private:
 
     sp<InputChannel> mChannel;
+
+    // Signals of the last received batch that receiveFinishedSignal has not returned yet.
+    std::deque<InputFinishedSignal> mPendingFinishedSignals;
 };
 
 /*
@@ -379,6 +461,16 @@ public:
      */
     status_t sendFinishedSignal(uint32_t seq, bool handled);
 
+    /* Sends the finished signals of several messages, e.g. all those consumed in one
+     * iteration of the event loop, in as few messages to the publisher as possible.
+     *
+     * Returns OK on success.
+     * Returns BAD_VALUE if any seq is 0.
+     * Other errors probably indicate that the channel is broken. Signals that were not sent
+     * can be sent again.
+     */
+    status_t sendFinishedSignals(const std::vector<InputFinishedSignal>& signals);
+
     /* Returns true if there is a deferred event waiting.
      *
      * Should be called after calling consume() to determine whether the consumer
@@ -528,6 +620,10 @@ private:
     };
     Vector<SeqChain> mSeqChains;
 
+    // The time when each message that has not been finished yet was read from the channel, by
+    // sequence number.
+    std::unordered_map<uint32_t, nsecs_t> mConsumeTimes;
+
     status_t consumeBatch(InputEventFactoryInterface* factory,
             nsecs_t frameTime, uint32_t* outSeq, InputEvent** outEvent);
     status_t consumeSamples(InputEventFactoryInterface* factory,
@@ -540,7 +636,13 @@ private:
     ssize_t findBatch(int32_t deviceId, int32_t source) const;
     ssize_t findTouchState(int32_t deviceId, int32_t source) const;
 
-    status_t sendUnchainedFinishedSignal(uint32_t seq, bool handled);
+    void popSeqChain(uint32_t seq, bool handled, std::vector<InputFinishedSignal>* outSignals);
+    status_t sendUnchainedFinishedSignals(const std::vector<InputFinishedSignal>& signals,
+                                          size_t* outSentCount);
+    nsecs_t getConsumeTime(uint32_t seq) const;
+
+    // Returns the sequence number of a message that carries an event, or 0.
+    static uint32_t getEventSeq(const InputMessage& msg);
 
     static void rewriteMessage(TouchState& state, InputMessage& msg);
     static void initializeKeyEvent(KeyEvent* event, const InputMessage* msg);
@@ -188,6 +188,9 @@ struct InputWindowInfo {
 
     bool overlaps(const InputWindowInfo* other) const;
 
+    bool operator==(const InputWindowInfo& other) const;
+    bool operator!=(const InputWindowInfo& other) const { return !(*this == other); }
+
     status_t write(Parcel& output) const;
     static InputWindowInfo read(const Parcel& from);
 };
@@ -73,9 +73,13 @@ public:
         int32_t metaState;
     };
 
-    /* Loads a key character map from a file. */
+    /* Loads a key character map from a file, or from its compiled form if one is available. */
     static status_t load(const std::string& filename, Format format, sp<KeyCharacterMap>* outMap);
 
+    /* Loads a key character map from a file written by writeCompiled. */
+    static status_t loadCompiled(const std::string& filename, Format format,
+            sp<KeyCharacterMap>* outMap);
+
     /* Loads a key character map from its string contents. */
     static status_t loadContents(const std::string& filename,
             const char* contents, Format format, sp<KeyCharacterMap>* outMap);
@@ -134,6 +138,9 @@ public:
     void tryRemapKey(int32_t scanCode, int32_t metaState,
             int32_t* outKeyCode, int32_t* outMetaState) const;
 
+    /* Writes the compiled binary form of the map, which loads without parsing. */
+    status_t writeCompiled(int fd) const;
+
 #ifdef __ANDROID__
     /* Reads a key map from a parcel. */
     static sp<KeyCharacterMap> readFromParcel(Parcel* parcel);
@@ -62,8 +62,15 @@ struct AxisInfo {
  */
 class KeyLayoutMap : public RefBase {
 public:
+    /* Loads a key layout map from a file, or from its compiled form if one is available. */
     static status_t load(const std::string& filename, sp<KeyLayoutMap>* outMap);
 
+    /* Loads a key layout map from a file written by writeCompiled. */
+    static status_t loadCompiled(const std::string& filename, sp<KeyLayoutMap>* outMap);
+
+    /* Writes the compiled binary form of the map, which loads without parsing. */
+    status_t writeCompiled(int fd) const;
+
     status_t mapKey(int32_t scanCode, int32_t usageCode,
             int32_t* outKeyCode, uint32_t* outFlags) const;
     status_t findScanCodesForKey(int32_t keyCode, std::vector<int32_t>* outScanCodes) const;
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LIBINPUT_MOTION_PREDICTOR_H
+#define _LIBINPUT_MOTION_PREDICTOR_H
+
+#include <input/Input.h>
+#include <utils/Timers.h>
+
+#include <array>
+
+namespace android {
+
+/*
+ * Predicts where the pointers of a gesture will be at a time in the near future, typically the
+ * expected present time of the frame being drawn, so that drawing apps can render ahead of the
+ * input and hide a frame of display latency.
+ *
+ * The predictor remembers the last few samples of each pointer across the events of a gesture,
+ * so it works for events with or without historical samples. Predicting is O(pointers) and does
+ * not allocate.
+ */
+class MotionPredictor {
+public:
+    // The furthest in the future that positions are predicted, beyond which the predictions
+    // are too unreliable to be useful.
+    static constexpr nsecs_t MAX_PREDICTION_TIME = 32 * 1000000LL;
+
+    struct Prediction {
+        int32_t id;
+        float x, y;
+        // Between 0, when the prediction is no better than the last known position, and 1.
+        float confidence;
+    };
+
+    MotionPredictor();
+
+    // Forgets all pointers, e.g. when the app stops consuming a gesture.
+    void clear();
+
+    // Adds the samples of event and predicts the position of each of its pointers at
+    // targetTime, which is clamped to at most MAX_PREDICTION_TIME after the event.
+    // Writes up to MAX_POINTERS predictions to outPredictions and returns their number. Returns
+    // 0 when the gesture ends, as there is nothing left to predict.
+    size_t predict(const MotionEvent& event, nsecs_t targetTime, Prediction* outPredictions);
+
+private:
+    // The number of recent samples kept for each pointer.
+    static constexpr size_t HISTORY_SIZE = 3;
+
+    struct Sample {
+        nsecs_t time;
+        float x, y;
+    };
+
+    struct PointerHistory {
+        // The recent samples, oldest first.
+        std::array<Sample, HISTORY_SIZE> samples;
+        size_t count;
+
+        void clear() { count = 0; }
+        void add(const Sample& sample);
+    };
+
+    void addSamples(const MotionEvent& event, size_t pointerIndex);
+    Prediction predictPointer(int32_t id, nsecs_t eventTime, nsecs_t targetTime) const;
+
+    std::array<PointerHistory, MAX_POINTER_ID + 1> mPointers;
+};
+
+} // namespace android
+
+#endif // _LIBINPUT_MOTION_PREDICTOR_H
@@ -19,6 +19,7 @@
 
 #include <stdint.h>
 #include <sys/time.h>
+#include <memory>
 #include <vector>
 
 namespace android {
@@ -27,6 +28,7 @@ namespace android {
  * Represents data from a single scan of the touchscreen device.
  * Similar in concept to a video frame, but the touch strength is used as
  * the values instead.
+ * Copies of a frame share its data, which is only copied when a copy is rotated.
  */
 class TouchVideoFrame {
 public:
@@ -64,7 +66,7 @@ public:
 private:
     uint32_t mHeight;
     uint32_t mWidth;
-    std::vector<int16_t> mData;
+    std::shared_ptr<const std::vector<int16_t>> mData;
     struct timeval mTimestamp;
 
     /**
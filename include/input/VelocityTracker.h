@@ -191,6 +191,57 @@ private:
 };
 
 
+/*
+ * Velocity tracker algorithm that computes the same unweighted 2nd order least-squares fit
+ * as LeastSquaresVelocityTrackerStrategy, but keeps running sums of the samples of each
+ * pointer so that an estimate is computed in constant time instead of revisiting its history.
+ */
+class IncrementalLeastSquaresVelocityTrackerStrategy : public VelocityTrackerStrategy {
+public:
+    IncrementalLeastSquaresVelocityTrackerStrategy();
+    virtual ~IncrementalLeastSquaresVelocityTrackerStrategy();
+
+    virtual void clear();
+    virtual void clearPointers(BitSet32 idBits);
+    virtual void addMovement(nsecs_t eventTime, BitSet32 idBits,
+            const VelocityTracker::Position* positions);
+    virtual bool getEstimator(uint32_t id, VelocityTracker::Estimator* outEstimator) const;
+
+private:
+    // Sample horizon and number of samples to keep, as in LeastSquaresVelocityTrackerStrategy.
+    static constexpr nsecs_t HORIZON = 100 * 1000000; // 100 ms
+    static constexpr size_t HISTORY_SIZE = 20;
+
+    struct Sample {
+        nsecs_t eventTime;
+        float x, y;
+    };
+
+    // The samples of a pointer, oldest first, and the sums over those samples of t^k, x*t^k
+    // and y*t^k, where t is the time in seconds since timeBase.
+    struct State {
+        Sample samples[HISTORY_SIZE];
+        size_t oldest;
+        size_t count;
+        nsecs_t timeBase;
+        double sumT[5];
+        double sumX[3];
+        double sumY[3];
+
+        inline const Sample& getNewest() const {
+            return samples[(oldest + count - 1) % HISTORY_SIZE];
+        }
+    };
+
+    BitSet32 mPointerIdBits;
+    State mPointerState[MAX_POINTER_ID + 1];
+
+    static void accumulate(State& state, const Sample& sample, double sign);
+    // Moves the time base to the newest sample and recomputes the sums from the samples.
+    static void rebase(State& state);
+};
+
+
 /*
  * Velocity tracker algorithm that uses an IIR filter.
  */
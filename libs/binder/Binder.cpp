@@ -33,7 +33,10 @@
 #include <inttypes.h>
 #include <linux/sched.h>
 #include <stdio.h>
+#include <unistd.h>
 
+#include "BinderFlightRecorder.h"
+#include "BinderStats.h"
 #include "RpcState.h"
 
 namespace android {
@@ -54,6 +57,50 @@ constexpr const bool kEnableRpcDevServers = true;
 constexpr const bool kEnableRpcDevServers = false;
 #endif
 
+// Only root, shell and this process itself may control or read these stats
+// or the transaction history, since they leak which interfaces the process is
+// used through.
+static bool isDebugCallerAllowed(const char* what) {
+    uid_t uid = IPCThreadState::self()->getCallingUid();
+    if (uid != AID_ROOT && uid != AID_SHELL && uid != getuid()) {
+        ALOGE("%s: not allowed for client %" PRIu32, what, uid);
+        return false;
+    }
+    return true;
+}
+
+static status_t handleBinderStats(const Parcel& data, Parcel* reply) {
+    if (!isDebugCallerAllowed(__PRETTY_FUNCTION__)) return PERMISSION_DENIED;
+
+    int32_t command;
+    if (status_t status = data.readInt32(&command); status != OK) return status;
+    switch (command) {
+        case IBinder::BINDER_STATS_DUMP:
+            break;
+        case IBinder::BINDER_STATS_ENABLE:
+            BinderStats::setEnabled(true);
+            break;
+        case IBinder::BINDER_STATS_DISABLE:
+            BinderStats::setEnabled(false);
+            break;
+        case IBinder::BINDER_STATS_RESET:
+            BinderStats::reset();
+            break;
+        default:
+            return BAD_VALUE;
+    }
+
+    if (reply == nullptr) return OK;
+    return reply->writeUtf8AsUtf16(BinderStats::dump());
+}
+
+static status_t handleTransactionHistory(Parcel* reply) {
+    if (!isDebugCallerAllowed(__PRETTY_FUNCTION__)) return PERMISSION_DENIED;
+
+    if (reply == nullptr) return OK;
+    return reply->writeUtf8AsUtf16(BinderFlightRecorder::dump());
+}
+
 // ---------------------------------------------------------------------------
 
 IBinder::IBinder()
@@ -151,6 +198,24 @@ status_t IBinder::getDebugPid(pid_t* out) {
     return OK;
 }
 
+status_t IBinder::getBinderStats(int32_t command, std::string* outDump) {
+    Parcel data;
+    Parcel reply;
+    status_t status = data.writeInt32(command);
+    if (status != OK) return status;
+    status = transact(BINDER_STATS_TRANSACTION, data, &reply);
+    if (status != OK) return status;
+    return reply.readUtf8FromUtf16(outDump);
+}
+
+status_t IBinder::getTransactionHistory(std::string* outDump) {
+    Parcel data;
+    Parcel reply;
+    status_t status = transact(TRANSACTION_HISTORY_TRANSACTION, data, &reply);
+    if (status != OK) return status;
+    return reply.readUtf8FromUtf16(outDump);
+}
+
 status_t IBinder::setRpcClientDebug(android::base::unique_fd socketFd,
                                     const sp<IBinder>& keepAliveBinder) {
     if constexpr (!kEnableRpcDevServers) {
@@ -277,6 +342,14 @@ status_t BBinder::transact(
             err = setRpcClientDebug(data);
             break;
         }
+        case BINDER_STATS_TRANSACTION: {
+            err = handleBinderStats(data, reply);
+            break;
+        }
+        case TRANSACTION_HISTORY_TRANSACTION: {
+            err = handleTransactionHistory(reply);
+            break;
+        }
         default:
             err = onTransact(code, data, reply, flags);
             break;
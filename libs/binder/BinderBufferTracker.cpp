@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define LOG_TAG "BinderBufferTracker"
+
+#include "BinderBufferTracker.h"
+
+#include <log/log.h>
+#include <utils/String8.h>
+#include <utils/Timers.h>
+
+#include <inttypes.h>
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+namespace android {
+
+namespace {
+
+// How many holders are logged when crossing the threshold
+constexpr size_t kLoggedHolders = 5;
+
+struct Buffer {
+    size_t size;
+    nsecs_t receivedTime;
+    // for transactions, the local interface (and handle is -1); for replies,
+    // the remote handle
+    String16 descriptor;
+    int32_t handle;
+    uint32_t code;
+};
+
+struct Tracker {
+    std::mutex lock;
+    std::unordered_map<const void*, Buffer> buffers;
+    size_t outstandingBytes = 0;
+    size_t highWaterBytes = 0;
+    size_t warningThreshold = 0;
+    // set once the threshold was crossed, until usage drops below half of it
+    bool warned = false;
+};
+
+Tracker& tracker() {
+    static Tracker* t = new Tracker();
+    return *t;
+}
+
+std::string describeHolders(const Tracker& t, nsecs_t now) {
+    struct Holder {
+        size_t bytes = 0;
+        size_t count = 0;
+        nsecs_t oldest = 0;
+    };
+    std::map<std::tuple<String16, int32_t, uint32_t>, Holder> holders;
+    for (const auto& [data, buffer] : t.buffers) {
+        Holder& h = holders[std::make_tuple(buffer.descriptor, buffer.handle, buffer.code)];
+        h.bytes += buffer.size;
+        h.count++;
+        h.oldest = std::max(h.oldest, now - buffer.receivedTime);
+    }
+
+    std::vector<std::pair<std::tuple<String16, int32_t, uint32_t>, Holder>> sorted(holders.begin(),
+                                                                                  holders.end());
+    std::sort(sorted.begin(), sorted.end(),
+              [](const auto& a, const auto& b) { return a.second.bytes > b.second.bytes; });
+    if (sorted.size() > kLoggedHolders) sorted.resize(kLoggedHolders);
+
+    std::string out;
+    for (const auto& [key, h] : sorted) {
+        const auto& [descriptor, handle, code] = key;
+        char line[256];
+        if (handle < 0) {
+            snprintf(line, sizeof(line), "\n  %s code %u", String8(descriptor).c_str(), code);
+        } else {
+            snprintf(line, sizeof(line), "\n  reply from handle %d code %u", handle, code);
+        }
+        out += line;
+        snprintf(line, sizeof(line), ": %zu bytes in %zu buffers, oldest %" PRId64 "ms", h.bytes,
+                 h.count, static_cast<int64_t>(ns2ms(h.oldest)));
+        out += line;
+    }
+    return out;
+}
+
+void track(const void* data, Buffer&& buffer) {
+    Tracker& t = tracker();
+    const nsecs_t now = buffer.receivedTime;
+    size_t outstandingBytes;
+    std::string holders;
+    {
+        std::lock_guard<std::mutex> _l(t.lock);
+        const size_t size = buffer.size;
+        if (!t.buffers.emplace(data, std::move(buffer)).second) {
+            ALOGW("Binder buffer %p received twice without being freed", data);
+            return;
+        }
+        t.outstandingBytes += size;
+        t.highWaterBytes = std::max(t.highWaterBytes, t.outstandingBytes);
+
+        if (t.warningThreshold == 0 || t.warned || t.outstandingBytes < t.warningThreshold) {
+            return;
+        }
+        t.warned = true;
+        outstandingBytes = t.outstandingBytes;
+        holders = describeHolders(t, now);
+    }
+    ALOGW("%zu bytes of the binder buffer are held by this process, which may cause binder "
+          "transactions to it to fail. Biggest holders:%s",
+          outstandingBytes, holders.c_str());
+}
+
+} // namespace
+
+void BinderBufferTracker::trackTransaction(const void* data, size_t size,
+                                           const String16& descriptor, uint32_t code) {
+    track(data,
+          Buffer{.size = size,
+                 .receivedTime = systemTime(SYSTEM_TIME_MONOTONIC),
+                 .descriptor = descriptor,
+                 .handle = -1,
+                 .code = code});
+}
+
+void BinderBufferTracker::trackReply(const void* data, size_t size, int32_t handle,
+                                     uint32_t code) {
+    track(data,
+          Buffer{.size = size,
+                 .receivedTime = systemTime(SYSTEM_TIME_MONOTONIC),
+                 .descriptor = String16(),
+                 .handle = handle,
+                 .code = code});
+}
+
+void BinderBufferTracker::untrack(const void* data) {
+    Tracker& t = tracker();
+    std::lock_guard<std::mutex> _l(t.lock);
+    auto it = t.buffers.find(data);
+    if (it == t.buffers.end()) return;
+    t.outstandingBytes -= it->second.size;
+    t.buffers.erase(it);
+    if (t.warned && t.outstandingBytes < t.warningThreshold / 2) t.warned = false;
+}
+
+void BinderBufferTracker::setWarningThreshold(size_t bytes) {
+    Tracker& t = tracker();
+    std::lock_guard<std::mutex> _l(t.lock);
+    t.warningThreshold = bytes;
+    t.warned = false;
+}
+
+ProcessState::BufferStats BinderBufferTracker::getStats() {
+    Tracker& t = tracker();
+    std::lock_guard<std::mutex> _l(t.lock);
+    return ProcessState::BufferStats{
+            .outstandingBytes = t.outstandingBytes,
+            .outstandingBuffers = t.buffers.size(),
+            .highWaterBytes = t.highWaterBytes,
+    };
+}
+
+} // namespace android
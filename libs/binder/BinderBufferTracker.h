@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <binder/ProcessState.h>
+#include <utils/String16.h>
+
+namespace android {
+
+// Accounts for the buffers which the kernel allocated in this process'
+// binder mmap for received transactions and replies, until they are freed
+// with BC_FREE_BUFFER. When they are not freed (e.g. a reply Parcel which is
+// kept around), the mmap fills up and further transactions to this process
+// fail, so once usage crosses a threshold the biggest holders are logged.
+class BinderBufferTracker {
+public:
+    // A transaction received for a local binder with 'descriptor'
+    static void trackTransaction(const void* data, size_t size, const String16& descriptor,
+                                 uint32_t code);
+    // A reply to a transaction sent to 'handle'
+    static void trackReply(const void* data, size_t size, int32_t handle, uint32_t code);
+    // data isn't necessarily tracked
+    static void untrack(const void* data);
+
+    // 0 disables the warning
+    static void setWarningThreshold(size_t bytes);
+    static ProcessState::BufferStats getStats();
+};
+
+} // namespace android
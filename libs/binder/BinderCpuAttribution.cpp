@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define LOG_TAG "BinderCpuAttribution"
+
+#include "BinderCpuAttribution.h"
+
+#include <log/log.h>
+
+#include <unistd.h>
+
+#include <map>
+#include <mutex>
+#include <utility>
+
+namespace android {
+
+std::atomic<ProcessState::CpuAttributionFn> BinderCpuAttribution::gTagThread = nullptr;
+
+namespace {
+
+std::mutex gKeysLock;
+// Keys are allocated in order of first use and never reused, so that they
+// keep their meaning for the lifetime of the process.
+std::map<std::pair<String16, uint32_t>, uint16_t>* gKeys = nullptr;
+
+uint16_t findOrAllocateKey(const String16& descriptor, uint32_t code) {
+    std::lock_guard<std::mutex> _l(gKeysLock);
+    if (gKeys == nullptr) gKeys = new std::map<std::pair<String16, uint32_t>, uint16_t>();
+
+    auto it = gKeys->find(std::make_pair(descriptor, code));
+    if (it != gKeys->end()) return it->second;
+
+    if (gKeys->size() + 1 >= ProcessState::kCpuAttributionOtherKey) {
+        return ProcessState::kCpuAttributionOtherKey;
+    }
+    uint16_t key = static_cast<uint16_t>(gKeys->size() + 1);
+    gKeys->emplace(std::make_pair(descriptor, code), key);
+    return key;
+}
+
+} // namespace
+
+void BinderCpuAttribution::setTagThread(ProcessState::CpuAttributionFn tagThread) {
+    gTagThread.store(tagThread, std::memory_order_relaxed);
+}
+
+void BinderCpuAttribution::onTransaction(const String16& descriptor, uint32_t code,
+                                         uint16_t* threadKey) {
+    restore(findOrAllocateKey(descriptor, code), threadKey);
+}
+
+void BinderCpuAttribution::restore(uint16_t key, uint16_t* threadKey) {
+    if (key == *threadKey) return;
+    ProcessState::CpuAttributionFn tagThread = gTagThread.load(std::memory_order_relaxed);
+    if (tagThread == nullptr) return;
+
+    if (tagThread(gettid(), key)) {
+        *threadKey = key;
+    } else {
+        // e.g. no BPF support, so keep trying would only cost syscalls
+        ALOGW("Could not tag binder thread with CPU attribution key %u, disabling", key);
+        setTagThread(nullptr);
+    }
+}
+
+std::vector<ProcessState::CpuAttributionKey> BinderCpuAttribution::getKeys() {
+    std::vector<ProcessState::CpuAttributionKey> keys;
+    std::lock_guard<std::mutex> _l(gKeysLock);
+    if (gKeys == nullptr) return keys;
+
+    keys.reserve(gKeys->size());
+    for (const auto& [id, key] : *gKeys) {
+        keys.push_back({.key = key, .descriptor = id.first, .code = id.second});
+    }
+    return keys;
+}
+
+} // namespace android
@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <binder/ProcessState.h>
+#include <utils/String16.h>
+
+#include <atomic>
+#include <vector>
+
+namespace android {
+
+// Tags binder threads with an aggregation key per (interface, code) of the
+// transaction they execute, see ProcessState::setCpuAttribution. When
+// disabled, the cost is a relaxed atomic load per transaction.
+class BinderCpuAttribution {
+public:
+    static bool isEnabled() { return gTagThread.load(std::memory_order_relaxed) != nullptr; }
+    static void setTagThread(ProcessState::CpuAttributionFn tagThread);
+
+    // Tags the calling thread with the key of (descriptor, code), unless
+    // *threadKey shows it already is. *threadKey is updated on success.
+    static void onTransaction(const String16& descriptor, uint32_t code, uint16_t* threadKey);
+    // Tags the calling thread with 'key' again, e.g. after a nested
+    // transaction, unless *threadKey shows it already is.
+    static void restore(uint16_t key, uint16_t* threadKey);
+
+    static std::vector<ProcessState::CpuAttributionKey> getKeys();
+
+private:
+    static std::atomic<ProcessState::CpuAttributionFn> gTagThread;
+};
+
+} // namespace android
@@ -0,0 +1,252 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define LOG_TAG "BinderFlightRecorder"
+
+#include "BinderFlightRecorder.h"
+
+#include <android-base/stringprintf.h>
+#include <binder/IBinder.h>
+#include <utils/String8.h>
+#include <utils/Timers.h>
+
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+namespace android {
+
+using base::StringAppendF;
+
+namespace {
+
+// Descriptors are interned by hash, so that records only store 8 bytes and
+// names are only converted once. The table is never resized, descriptors
+// which don't fit show up as unknown.
+constexpr size_t kNumDescriptors = 128;
+constexpr size_t kMaxProbes = 16;
+constexpr size_t kMaxNameLength = 96;
+
+struct Descriptor {
+    // 0 when the slot is free
+    std::atomic<uint64_t> hash;
+    // set once 'name' is written by the thread which claimed 'hash'
+    std::atomic<bool> ready;
+    char name[kMaxNameLength];
+};
+
+Descriptor gDescriptors[kNumDescriptors];
+
+// Protects the list of recorders, so that they aren't destroyed while dumped.
+std::mutex gRecordersLock;
+std::vector<const BinderFlightRecorder*>* gRecorders = nullptr;
+
+uint64_t internDescriptor(const String16& descriptor) {
+    // FNV-1a
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    const char16_t* chars = descriptor.string();
+    for (size_t i = 0; i < descriptor.size(); i++) {
+        hash ^= chars[i];
+        hash *= 0x100000001b3ULL;
+    }
+    if (hash == 0) hash = 1;
+
+    for (size_t probe = 0; probe < kMaxProbes; probe++) {
+        Descriptor& entry = gDescriptors[(hash + probe) % kNumDescriptors];
+        uint64_t current = entry.hash.load(std::memory_order_acquire);
+        if (current == hash) return hash;
+        if (current != 0) continue;
+
+        if (entry.hash.compare_exchange_strong(current, hash, std::memory_order_acq_rel)) {
+            String8 name(descriptor);
+            strlcpy(entry.name, name.size() > 0 ? name.c_str() : "<no descriptor>",
+                    sizeof(entry.name));
+            entry.ready.store(true, std::memory_order_release);
+            return hash;
+        }
+        if (current == hash) return hash;
+    }
+    return hash;
+}
+
+const char* descriptorName(uint64_t hash) {
+    for (size_t probe = 0; probe < kMaxProbes; probe++) {
+        const Descriptor& entry = gDescriptors[(hash + probe) % kNumDescriptors];
+        uint64_t current = entry.hash.load(std::memory_order_acquire);
+        if (current == 0) break;
+        if (current == hash) {
+            return entry.ready.load(std::memory_order_acquire) ? entry.name : "<unknown>";
+        }
+    }
+    return "<unknown>";
+}
+
+// Snapshot of a record, see BinderFlightRecorder::Record
+struct Snapshot {
+    bool server;
+    uint64_t token;
+    int64_t startNs;
+    int64_t durationNs;
+    uint32_t code;
+    uint32_t flags;
+    uint32_t dataSize;
+    int32_t result;
+    int32_t peer;
+    uint64_t descriptor;
+};
+
+} // namespace
+
+BinderFlightRecorder::BinderFlightRecorder() : mTid(gettid()), mNext(0), mRecords() {
+    std::lock_guard<std::mutex> _l(gRecordersLock);
+    if (gRecorders == nullptr) gRecorders = new std::vector<const BinderFlightRecorder*>();
+    gRecorders->push_back(this);
+}
+
+BinderFlightRecorder::~BinderFlightRecorder() {
+    std::lock_guard<std::mutex> _l(gRecordersLock);
+    gRecorders->erase(std::find(gRecorders->begin(), gRecorders->end(), this));
+}
+
+uint64_t BinderFlightRecorder::beginClient(int32_t handle, uint32_t code, uint32_t flags,
+                                           size_t dataSize) {
+    uint64_t token = mNext.load(std::memory_order_relaxed);
+    Record& record = mRecords[token % kNumRecords];
+
+    uint32_t seq = record.seq.load(std::memory_order_relaxed);
+    record.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    record.server.store(false, std::memory_order_relaxed);
+    record.token.store(token, std::memory_order_relaxed);
+    record.startNs.store(systemTime(SYSTEM_TIME_MONOTONIC), std::memory_order_relaxed);
+    record.durationNs.store(-1, std::memory_order_relaxed);
+    record.code.store(code, std::memory_order_relaxed);
+    record.flags.store(flags, std::memory_order_relaxed);
+    record.dataSize.store(static_cast<uint32_t>(dataSize), std::memory_order_relaxed);
+    record.result.store(OK, std::memory_order_relaxed);
+    record.peer.store(handle, std::memory_order_relaxed);
+    record.descriptor.store(0, std::memory_order_relaxed);
+    record.seq.store(seq + 2, std::memory_order_release);
+
+    mNext.store(token + 1, std::memory_order_release);
+    return token;
+}
+
+uint64_t BinderFlightRecorder::beginServer(const String16& descriptor, uint32_t code,
+                                           uint32_t flags, size_t dataSize, pid_t callingPid) {
+    uint64_t hash = internDescriptor(descriptor);
+    uint64_t token = mNext.load(std::memory_order_relaxed);
+    Record& record = mRecords[token % kNumRecords];
+
+    uint32_t seq = record.seq.load(std::memory_order_relaxed);
+    record.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    record.server.store(true, std::memory_order_relaxed);
+    record.token.store(token, std::memory_order_relaxed);
+    record.startNs.store(systemTime(SYSTEM_TIME_MONOTONIC), std::memory_order_relaxed);
+    record.durationNs.store(-1, std::memory_order_relaxed);
+    record.code.store(code, std::memory_order_relaxed);
+    record.flags.store(flags, std::memory_order_relaxed);
+    record.dataSize.store(static_cast<uint32_t>(dataSize), std::memory_order_relaxed);
+    record.result.store(OK, std::memory_order_relaxed);
+    record.peer.store(callingPid, std::memory_order_relaxed);
+    record.descriptor.store(hash, std::memory_order_relaxed);
+    record.seq.store(seq + 2, std::memory_order_release);
+
+    mNext.store(token + 1, std::memory_order_release);
+    return token;
+}
+
+void BinderFlightRecorder::end(uint64_t token, status_t result) {
+    Record& record = mRecords[token % kNumRecords];
+    // overwritten by more than kNumRecords nested transactions
+    if (record.token.load(std::memory_order_relaxed) != token) return;
+
+    int64_t duration = systemTime(SYSTEM_TIME_MONOTONIC) -
+            record.startNs.load(std::memory_order_relaxed);
+    uint32_t seq = record.seq.load(std::memory_order_relaxed);
+    record.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    record.durationNs.store(duration, std::memory_order_relaxed);
+    record.result.store(result, std::memory_order_relaxed);
+    record.seq.store(seq + 2, std::memory_order_release);
+}
+
+void BinderFlightRecorder::dumpLocked(std::string* out, int64_t now) const {
+    uint64_t next = mNext.load(std::memory_order_acquire);
+    if (next == 0) return;
+
+    StringAppendF(out, "  thread %d:\n", mTid);
+    uint64_t oldest = next > kNumRecords ? next - kNumRecords : 0;
+    for (uint64_t token = next; token-- > oldest;) {
+        const Record& record = mRecords[token % kNumRecords];
+        Snapshot s;
+        bool consistent = false;
+        // the owning thread only holds the lock for a few stores, so this
+        // only retries for records which are being overwritten
+        for (int attempt = 0; attempt < 4 && !consistent; attempt++) {
+            uint32_t seq = record.seq.load(std::memory_order_acquire);
+            if (seq & 1) continue;
+            s.server = record.server.load(std::memory_order_relaxed);
+            s.token = record.token.load(std::memory_order_relaxed);
+            s.startNs = record.startNs.load(std::memory_order_relaxed);
+            s.durationNs = record.durationNs.load(std::memory_order_relaxed);
+            s.code = record.code.load(std::memory_order_relaxed);
+            s.flags = record.flags.load(std::memory_order_relaxed);
+            s.dataSize = record.dataSize.load(std::memory_order_relaxed);
+            s.result = record.result.load(std::memory_order_relaxed);
+            s.peer = record.peer.load(std::memory_order_relaxed);
+            s.descriptor = record.descriptor.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            consistent = record.seq.load(std::memory_order_relaxed) == seq;
+        }
+        // newer transactions already took the slot
+        if (!consistent || s.token != token) break;
+
+        if (s.server) {
+            StringAppendF(out, "    server %s code %" PRIu32 " from pid %" PRId32,
+                          descriptorName(s.descriptor), s.code, s.peer);
+        } else {
+            StringAppendF(out, "    client handle %" PRId32 " code %" PRIu32, s.peer, s.code);
+        }
+        StringAppendF(out, "%s, %" PRIu32 " bytes, started %" PRId64 "us ago, ",
+                      (s.flags & IBinder::FLAG_ONEWAY) ? " oneway" : "", s.dataSize,
+                      (now - s.startNs) / 1000);
+        if (s.durationNs < 0) {
+            *out += "in flight\n";
+        } else {
+            StringAppendF(out, "took %" PRId64 "us, result %s\n", s.durationNs / 1000,
+                          statusToString(s.result).c_str());
+        }
+    }
+}
+
+std::string BinderFlightRecorder::dump() {
+    std::string out = "Binder transaction history (newest first):\n";
+    int64_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+
+    std::lock_guard<std::mutex> _l(gRecordersLock);
+    if (gRecorders == nullptr) return out;
+    for (const BinderFlightRecorder* recorder : *gRecorders) {
+        recorder->dumpLocked(&out, now);
+    }
+    return out;
+}
+
+} // namespace android
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <utils/Errors.h>
+#include <utils/String16.h>
+
+#include <sys/types.h>
+
+#include <atomic>
+#include <string>
+
+namespace android {
+
+// Always-on history of the last transactions sent and served by one thread,
+// including the ones still in flight. Each IPCThreadState owns one. Only the
+// owning thread writes to it, without locks, so dump() may run concurrently
+// from any thread.
+class BinderFlightRecorder {
+public:
+    BinderFlightRecorder();
+    ~BinderFlightRecorder();
+
+    // These return a token for end(). Client entries are keyed by handle
+    // because the descriptor of the remote object isn't known without
+    // another transaction.
+    uint64_t beginClient(int32_t handle, uint32_t code, uint32_t flags, size_t dataSize);
+    uint64_t beginServer(const String16& descriptor, uint32_t code, uint32_t flags,
+                         size_t dataSize, pid_t callingPid);
+    void end(uint64_t token, status_t result);
+
+    // Human readable dump of the history of all threads of this process.
+    static std::string dump();
+
+private:
+    static constexpr size_t kNumRecords = 32;
+
+    // Fields are relaxed atomics protected by 'seq' (a seqlock): it is odd
+    // while the owning thread writes the record.
+    struct Record {
+        std::atomic<uint32_t> seq;
+        std::atomic<bool> server;
+        std::atomic<uint64_t> token;
+        std::atomic<int64_t> startNs;
+        std::atomic<int64_t> durationNs; // -1 while in flight
+        std::atomic<uint32_t> code;
+        std::atomic<uint32_t> flags;
+        std::atomic<uint32_t> dataSize;
+        std::atomic<int32_t> result;
+        // handle for client records, caller for server records
+        std::atomic<int32_t> peer;
+        std::atomic<uint64_t> descriptor; // see internDescriptor()
+    };
+
+    void dumpLocked(std::string* out, int64_t now) const;
+
+    const pid_t mTid;
+    // number of records started so far, also the token of the next one
+    std::atomic<uint64_t> mNext;
+    Record mRecords[kNumRecords];
+};
+
+} // namespace android
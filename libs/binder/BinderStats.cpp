@@ -0,0 +1,220 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "BinderStats"
+
+#include "BinderStats.h"
+
+#include <android-base/stringprintf.h>
+#include <utils/String8.h>
+
+#include <inttypes.h>
+#include <string.h>
+
+#include <algorithm>
+#include <mutex>
+
+namespace android {
+
+using base::StringAppendF;
+
+std::atomic<bool> BinderStats::gEnabled = false;
+
+namespace {
+
+constexpr size_t kNumEntries = 256;
+// how far a key is searched for before giving up (the table is never resized)
+constexpr size_t kMaxProbes = 16;
+// bucket 0 is < 1us, bucket i is [2^(i-1), 2^i) us, and the last bucket is
+// open ended (>= ~4s)
+constexpr size_t kNumBuckets = 24;
+constexpr size_t kMaxNameLength = 96;
+
+struct Entry {
+    // 0 when the slot is free, otherwise hash of the fields below
+    std::atomic<uint64_t> key;
+    // set once the fields below are written by the thread which claimed 'key'
+    std::atomic<bool> ready;
+    bool server;
+    uint32_t code;
+    int32_t handle;
+    char name[kMaxNameLength];
+
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> totalNs;
+    std::atomic<uint64_t> maxNs;
+    std::atomic<uint64_t> buckets[kNumBuckets];
+};
+
+// Allocated once when first enabled, and never freed, so that recording
+// threads don't need to synchronize with enabling or disabling. Relies on
+// value initialization ('new Table()') to zero everything.
+struct Table {
+    Entry entries[kNumEntries];
+    std::atomic<uint64_t> dropped;
+};
+
+std::atomic<Table*> gTable = nullptr;
+std::mutex gTableAllocLock;
+
+uint64_t hashBytes(uint64_t hash, const void* data, size_t size) {
+    // FNV-1a
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+uint64_t makeKey(bool server, uint32_t code, const void* id, size_t idSize) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    hash = hashBytes(hash, &server, sizeof(server));
+    hash = hashBytes(hash, &code, sizeof(code));
+    hash = hashBytes(hash, id, idSize);
+    return hash == 0 ? 1 : hash;
+}
+
+template <typename Init>
+Entry* findOrClaim(Table* table, uint64_t key, const Init& init) {
+    for (size_t probe = 0; probe < kMaxProbes; probe++) {
+        Entry& entry = table->entries[(key + probe) % kNumEntries];
+        uint64_t current = entry.key.load(std::memory_order_acquire);
+        if (current == key) return &entry;
+        if (current != 0) continue;
+
+        if (entry.key.compare_exchange_strong(current, key, std::memory_order_acq_rel)) {
+            init(&entry);
+            entry.ready.store(true, std::memory_order_release);
+            return &entry;
+        }
+        // someone else claimed this slot first, maybe for the same key
+        if (current == key) return &entry;
+    }
+    table->dropped.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+}
+
+void addSample(Entry* entry, nsecs_t duration) {
+    uint64_t ns = duration < 0 ? 0 : static_cast<uint64_t>(duration);
+    entry->count.fetch_add(1, std::memory_order_relaxed);
+    entry->totalNs.fetch_add(ns, std::memory_order_relaxed);
+
+    uint64_t max = entry->maxNs.load(std::memory_order_relaxed);
+    while (ns > max &&
+           !entry->maxNs.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {
+    }
+
+    uint64_t us = ns / 1000;
+    size_t bucket = us == 0 ? 0 : std::min<size_t>(kNumBuckets - 1, 64 - __builtin_clzll(us));
+    entry->buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+} // namespace
+
+void BinderStats::setEnabled(bool enabled) {
+    if (enabled && gTable.load(std::memory_order_acquire) == nullptr) {
+        std::lock_guard<std::mutex> _l(gTableAllocLock);
+        if (gTable.load(std::memory_order_relaxed) == nullptr) {
+            gTable.store(new Table(), std::memory_order_release);
+        }
+    }
+    gEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+void BinderStats::recordClient(int32_t handle, uint32_t code, nsecs_t duration) {
+    Table* table = gTable.load(std::memory_order_acquire);
+    if (table == nullptr) return;
+
+    uint64_t key = makeKey(false /*server*/, code, &handle, sizeof(handle));
+    Entry* entry = findOrClaim(table, key, [&](Entry* e) {
+        e->server = false;
+        e->code = code;
+        e->handle = handle;
+    });
+    if (entry != nullptr) addSample(entry, duration);
+}
+
+void BinderStats::recordServer(const String16& descriptor, uint32_t code, nsecs_t duration) {
+    Table* table = gTable.load(std::memory_order_acquire);
+    if (table == nullptr) return;
+
+    uint64_t key = makeKey(true /*server*/, code, descriptor.string(),
+                           descriptor.size() * sizeof(char16_t));
+    Entry* entry = findOrClaim(table, key, [&](Entry* e) {
+        e->server = true;
+        e->code = code;
+        e->handle = -1;
+        String8 name(descriptor);
+        strlcpy(e->name, name.size() > 0 ? name.c_str() : "<no descriptor>", sizeof(e->name));
+    });
+    if (entry != nullptr) addSample(entry, duration);
+}
+
+std::string BinderStats::dump() {
+    std::string out;
+    StringAppendF(&out, "Binder stats (%s):\n", isEnabled() ? "enabled" : "disabled");
+
+    Table* table = gTable.load(std::memory_order_acquire);
+    if (table == nullptr) return out;
+
+    for (const Entry& entry : table->entries) {
+        if (!entry.ready.load(std::memory_order_acquire)) continue;
+        uint64_t count = entry.count.load(std::memory_order_relaxed);
+        if (count == 0) continue;
+
+        if (entry.server) {
+            StringAppendF(&out, "  server %s code %" PRIu32, entry.name, entry.code);
+        } else {
+            StringAppendF(&out, "  client handle %" PRId32 " code %" PRIu32, entry.handle,
+                          entry.code);
+        }
+        StringAppendF(&out, ": count %" PRIu64 " avg %" PRIu64 "us max %" PRIu64 "us\n   ",
+                      count, entry.totalNs.load(std::memory_order_relaxed) / count / 1000,
+                      entry.maxNs.load(std::memory_order_relaxed) / 1000);
+        for (size_t i = 0; i < kNumBuckets; i++) {
+            uint64_t samples = entry.buckets[i].load(std::memory_order_relaxed);
+            if (samples == 0) continue;
+            if (i == 0) {
+                StringAppendF(&out, " <1us:%" PRIu64, samples);
+            } else {
+                StringAppendF(&out, " %s%" PRIu64 "us:%" PRIu64,
+                              i == kNumBuckets - 1 ? ">=" : "", uint64_t{1} << (i - 1), samples);
+            }
+        }
+        out += "\n";
+    }
+
+    if (uint64_t dropped = table->dropped.load(std::memory_order_relaxed); dropped > 0) {
+        StringAppendF(&out, "  %" PRIu64 " samples dropped (table full)\n", dropped);
+    }
+    return out;
+}
+
+void BinderStats::reset() {
+    Table* table = gTable.load(std::memory_order_acquire);
+    if (table == nullptr) return;
+
+    for (Entry& entry : table->entries) {
+        entry.count.store(0, std::memory_order_relaxed);
+        entry.totalNs.store(0, std::memory_order_relaxed);
+        entry.maxNs.store(0, std::memory_order_relaxed);
+        for (auto& bucket : entry.buckets) bucket.store(0, std::memory_order_relaxed);
+    }
+    table->dropped.store(0, std::memory_order_relaxed);
+}
+
+} // namespace android
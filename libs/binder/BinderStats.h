@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <utils/String16.h>
+#include <utils/Timers.h>
+
+#include <atomic>
+#include <string>
+
+namespace android {
+
+// Process-wide latency histograms of binder transactions, keyed by
+// (interface, code). Recording is lock-free and only happens while enabled
+// (see ProcessState::setBinderStatsEnabled), so the cost when disabled is a
+// relaxed atomic load per transaction.
+class BinderStats {
+public:
+    static bool isEnabled() { return gEnabled.load(std::memory_order_relaxed); }
+    static void setEnabled(bool enabled);
+
+    // Round trip of a transaction sent to 'handle'. The descriptor of the
+    // remote object isn't known without another transaction, so client
+    // entries are keyed by handle.
+    static void recordClient(int32_t handle, uint32_t code, nsecs_t duration);
+    // Execution of a transaction on a local binder
+    static void recordServer(const String16& descriptor, uint32_t code, nsecs_t duration);
+
+    // Human readable dump of all entries with at least one sample.
+    static std::string dump();
+
+    // Clears all samples, e.g. to measure a specific interval. Entries which
+    // were already seen keep their slots.
+    static void reset();
+
+private:
+    static std::atomic<bool> gEnabled;
+};
+
+} // namespace android
@@ -32,6 +32,8 @@
 #include <atomic>
 #include <errno.h>
 #include <inttypes.h>
+#include <limits.h>
+#include <poll.h>
 #include <pthread.h>
 #include <sched.h>
 #include <signal.h>
@@ -40,6 +42,10 @@
 #include <sys/resource.h>
 #include <unistd.h>
 
+#include "BinderBufferTracker.h"
+#include "BinderCpuAttribution.h"
+#include "BinderFlightRecorder.h"
+#include "BinderStats.h"
 #include "Static.h"
 #include "binder_module.h"
 
@@ -559,6 +565,11 @@ status_t IPCThreadState::getAndExecuteCommand()
         }
 
         pthread_mutex_lock(&mProcess->mThreadCountLock);
+        size_t busyThreads = mProcess->mExecutingThreadsCount;
+        if (busyThreads >= mProcess->mOccupancy.size()) {
+            mProcess->mOccupancy.resize(busyThreads + 1);
+        }
+        mProcess->mOccupancy[busyThreads]++;
         mProcess->mExecutingThreadsCount++;
         if (mProcess->mExecutingThreadsCount >= mProcess->mMaxThreads &&
                 mProcess->mStarvationStartTimeMs == 0) {
@@ -647,12 +658,24 @@ void IPCThreadState::joinThreadPool(bool isMain)
 
     mOut.writeInt32(isMain ? BC_ENTER_LOOPER : BC_REGISTER_LOOPER);
 
+    if (!isMain) {
+        pthread_mutex_lock(&mProcess->mThreadCountLock);
+        mProcess->mSpawnedThreads++;
+        pthread_mutex_unlock(&mProcess->mThreadCountLock);
+    }
+
     mIsLooper = true;
+    bool idle = false;
     status_t result;
     do {
         processPendingDerefs();
-        // now get the next command to be processed, waiting if necessary
-        result = getAndExecuteCommand();
+        if (!isMain && waitForWorkOrIdleTimeout() == TIMED_OUT) {
+            idle = true;
+            result = TIMED_OUT;
+        } else {
+            // now get the next command to be processed, waiting if necessary
+            result = getAndExecuteCommand();
+        }
 
         if (result < NO_ERROR && result != TIMED_OUT && result != -ECONNREFUSED && result != -EBADF) {
             LOG_ALWAYS_FATAL("getAndExecuteCommand(fd=%d) returned unexpected error %d, aborting",
@@ -672,6 +695,32 @@ void IPCThreadState::joinThreadPool(bool isMain)
     mOut.writeInt32(BC_EXIT_LOOPER);
     mIsLooper = false;
     talkWithDriver(false);
+
+    if (!isMain) {
+        pthread_mutex_lock(&mProcess->mThreadCountLock);
+        mProcess->mSpawnedThreads--;
+        pthread_mutex_unlock(&mProcess->mThreadCountLock);
+        if (idle) mProcess->retireIdleThread();
+    }
+}
+
+status_t IPCThreadState::waitForWorkOrIdleTimeout()
+{
+    int64_t timeoutMs = mProcess->mIdleTimeoutMs.load(std::memory_order_relaxed);
+    if (timeoutMs <= 0) return NO_ERROR;
+
+    // Commands which were already read must be processed first, and pending
+    // writes (e.g. BC_REGISTER_LOOPER or a reply) must not wait for the timeout.
+    if (mIn.dataPosition() < mIn.dataSize()) return NO_ERROR;
+    if (mOut.dataSize() > 0) {
+        if (talkWithDriver(false) < NO_ERROR) return NO_ERROR;
+    }
+
+    pollfd pfd{.fd = mProcess->mDriverFD, .events = POLLIN, .revents = 0};
+    int pollTimeoutMs = timeoutMs > INT_MAX ? INT_MAX : static_cast<int>(timeoutMs);
+    int ret = TEMP_FAILURE_RETRY(poll(&pfd, 1, pollTimeoutMs));
+    // On errors, let getAndExecuteCommand() report them.
+    return ret == 0 ? TIMED_OUT : NO_ERROR;
 }
 
 status_t IPCThreadState::setupPolling(int* fd)
@@ -728,9 +777,14 @@ status_t IPCThreadState::transact(int32_t handle,
 
     LOG_ONEWAY(">>>> SEND from pid %d uid %d %s", getpid(), getuid(),
         (flags & TF_ONE_WAY) == 0 ? "READ REPLY" : "ONE WAY");
+
+    const nsecs_t statsStart = BinderStats::isEnabled() ? systemTime(SYSTEM_TIME_MONOTONIC) : 0;
+    const uint64_t record = mFlightRecorder->beginClient(handle, code, flags, data.ipcDataSize());
+
     err = writeTransactionData(BC_TRANSACTION, flags, handle, code, data, nullptr);
 
     if (err != NO_ERROR) {
+        mFlightRecorder->end(record, err);
         if (reply) reply->setError(err);
         return (mLastError = err);
     }
@@ -753,12 +807,19 @@ status_t IPCThreadState::transact(int32_t handle,
             ALOGI(">>>>>> CALLING transaction %d", code);
         }
         #endif
+        // restored after, since waitForResponse may execute nested transactions
+        const int32_t origReplyHandle = mReplyHandle;
+        const uint32_t origReplyCode = mReplyCode;
+        mReplyHandle = handle;
+        mReplyCode = code;
         if (reply) {
             err = waitForResponse(reply);
         } else {
             Parcel fakeReply;
             err = waitForResponse(&fakeReply);
         }
+        mReplyHandle = origReplyHandle;
+        mReplyCode = origReplyCode;
         #if 0
         if (code == 4) { // relayout
             ALOGI("<<<<<< RETURNING transaction 4");
@@ -778,6 +839,11 @@ status_t IPCThreadState::transact(int32_t handle,
         err = waitForResponse(nullptr, nullptr);
     }
 
+    mFlightRecorder->end(record, err);
+    if (statsStart != 0) {
+        BinderStats::recordClient(handle, code, systemTime(SYSTEM_TIME_MONOTONIC) - statsStart);
+    }
+
     return err;
 }
 
@@ -879,7 +945,11 @@ IPCThreadState::IPCThreadState()
         mIsFlushing(false),
         mStrictModePolicy(0),
         mLastTransactionBinderFlags(0),
-        mCallRestriction(mProcess->mCallRestriction) {
+        mCallRestriction(mProcess->mCallRestriction),
+        mCpuAttributionKey(0),
+        mReplyHandle(-1),
+        mReplyCode(0),
+        mFlightRecorder(std::make_unique<BinderFlightRecorder>()) {
     pthread_setspecific(gTLS, this);
     clearCaller();
     mIn.setDataCapacity(256);
@@ -958,6 +1028,9 @@ status_t IPCThreadState::waitForResponse(Parcel *reply, status_t *acquireResult)
 
                 if (reply) {
                     if ((tr.flags & TF_STATUS_CODE) == 0) {
+                        BinderBufferTracker::trackReply(
+                                reinterpret_cast<const void*>(tr.data.ptr.buffer),
+                                tr.data_size + tr.offsets_size, mReplyHandle, mReplyCode);
                         reply->ipcSetDataReference(
                             reinterpret_cast<const uint8_t*>(tr.data.ptr.buffer),
                             tr.data_size,
@@ -1263,6 +1336,7 @@ status_t IPCThreadState::executeCommand(int32_t cmd)
             const int32_t origTransactionBinderFlags = mLastTransactionBinderFlags;
             const int32_t origWorkSource = mWorkSource;
             const bool origPropagateWorkSet = mPropagateWorkSource;
+            const uint16_t origCpuAttributionKey = mCpuAttributionKey;
             // Calling work source will be set by Parcel#enforceInterface. Parcel#enforceInterface
             // is only guaranteed to be called for AIDL-generated stubs so we reset the work source
             // here to never propagate it.
@@ -1290,20 +1364,57 @@ status_t IPCThreadState::executeCommand(int32_t cmd)
                     << ", offsets addr="
                     << reinterpret_cast<const size_t*>(tr.data.ptr.offsets) << endl;
             }
+            const nsecs_t statsStart =
+                    BinderStats::isEnabled() ? systemTime(SYSTEM_TIME_MONOTONIC) : 0;
             if (tr.target.ptr) {
                 // We only have a weak reference on the target object, so we must first try to
                 // safely acquire a strong reference before doing anything else with it.
                 if (reinterpret_cast<RefBase::weakref_type*>(
                         tr.target.ptr)->attemptIncStrong(this)) {
-                    error = reinterpret_cast<BBinder*>(tr.cookie)->transact(tr.code, buffer,
-                            &reply, tr.flags);
-                    reinterpret_cast<BBinder*>(tr.cookie)->decStrong(this);
+                    BBinder* target = reinterpret_cast<BBinder*>(tr.cookie);
+                    BinderBufferTracker::trackTransaction(
+                            reinterpret_cast<const void*>(tr.data.ptr.buffer),
+                            tr.data_size + tr.offsets_size, target->getInterfaceDescriptor(),
+                            tr.code);
+                    if (BinderCpuAttribution::isEnabled()) {
+                        BinderCpuAttribution::onTransaction(target->getInterfaceDescriptor(),
+                                                            tr.code, &mCpuAttributionKey);
+                    }
+                    const uint64_t record =
+                            mFlightRecorder->beginServer(target->getInterfaceDescriptor(),
+                                                         tr.code, tr.flags, tr.data_size,
+                                                         mCallingPid);
+                    error = target->transact(tr.code, buffer, &reply, tr.flags);
+                    mFlightRecorder->end(record, error);
+                    if (statsStart != 0) {
+                        BinderStats::recordServer(target->getInterfaceDescriptor(), tr.code,
+                                                  systemTime(SYSTEM_TIME_MONOTONIC) - statsStart);
+                    }
+                    target->decStrong(this);
                 } else {
                     error = UNKNOWN_TRANSACTION;
                 }
 
             } else {
+                BinderBufferTracker::trackTransaction(
+                        reinterpret_cast<const void*>(tr.data.ptr.buffer),
+                        tr.data_size + tr.offsets_size,
+                        the_context_object->getInterfaceDescriptor(), tr.code);
+                if (BinderCpuAttribution::isEnabled()) {
+                    BinderCpuAttribution::onTransaction(the_context_object
+                                                                ->getInterfaceDescriptor(),
+                                                        tr.code, &mCpuAttributionKey);
+                }
+                const uint64_t record =
+                        mFlightRecorder->beginServer(the_context_object->getInterfaceDescriptor(),
+                                                     tr.code, tr.flags, tr.data_size, mCallingPid);
                 error = the_context_object->transact(tr.code, buffer, &reply, tr.flags);
+                mFlightRecorder->end(record, error);
+                if (statsStart != 0) {
+                    BinderStats::recordServer(the_context_object->getInterfaceDescriptor(),
+                                              tr.code,
+                                              systemTime(SYSTEM_TIME_MONOTONIC) - statsStart);
+                }
             }
 
             //ALOGI("<<<< TRANSACT from pid %d restore pid %d sid %s uid %d\n",
@@ -1336,6 +1447,13 @@ status_t IPCThreadState::executeCommand(int32_t cmd)
                 LOG_ONEWAY("NOT sending reply to %d!", mCallingPid);
             }
 
+            // A nested transaction retags the thread, so give the rest of the
+            // outer transaction back its key. Top-level transactions keep
+            // theirs to save a syscall per transaction.
+            if (origServingStackPointer != nullptr) {
+                BinderCpuAttribution::restore(origCpuAttributionKey, &mCpuAttributionKey);
+            }
+
             mServingStackPointer = origServingStackPointer;
             mCallingPid = origPid;
             mCallingSid = origSid;
@@ -1458,6 +1576,7 @@ void IPCThreadState::freeBuffer(Parcel* parcel, const uint8_t* data,
     }
     ALOG_ASSERT(data != NULL, "Called with NULL data");
     if (parcel != nullptr) parcel->closeFileDescriptors();
+    BinderBufferTracker::untrack(data);
     IPCThreadState* state = self();
     state->mOut.writeInt32(BC_FREE_BUFFER);
     state->mOut.writePointer((uintptr_t)data);
@@ -21,6 +21,9 @@
 #include <inttypes.h>
 #include <unistd.h>
 
+#include <map>
+#include <thread>
+
 #include <android/os/BnServiceCallback.h>
 #include <android/os/IServiceManager.h>
 #include <binder/IPCThreadState.h>
@@ -61,6 +64,87 @@ const String16& IServiceManager::getInterfaceDescriptor() const {
 IServiceManager::IServiceManager() {}
 IServiceManager::~IServiceManager() {}
 
+Vector<sp<IBinder>> IServiceManager::checkServices(const Vector<String16>& names) const {
+    Vector<sp<IBinder>> res;
+    res.setCapacity(names.size());
+    for (const String16& name : names) {
+        res.push(checkService(name));
+    }
+    return res;
+}
+
+void IServiceManager::waitForServiceAsync(const String16& name, ServiceCallback callback) {
+    // implementations without notifications can only block another thread
+    std::thread([self = sp<IServiceManager>::fromExisting(this), name,
+                 callback = std::move(callback)] { callback(self->waitForService(name)); })
+            .detach();
+}
+
+// Services which were found through the service manager, so that looking up
+// the same service again (e.g. from different libraries during startup) doesn't
+// cost another call. An entry is dropped when its service dies or when another
+// binder is registered under its name. Both notifications need binder threads,
+// so nothing is cached in processes without a thread pool. Lazy services are
+// never cached, since holding on to them would keep them running.
+class ServiceCache : public os::BnServiceCallback, public IBinder::DeathRecipient {
+public:
+    explicit ServiceCache(const sp<AidlServiceManager>& sm) : mServiceManager(sm) {}
+
+    sp<IBinder> get(const std::string& name) {
+        std::lock_guard<std::mutex> _l(mLock);
+        auto it = mNameToService.find(name);
+        return it == mNameToService.end() ? nullptr : it->second;
+    }
+
+    void put(const std::string& name, const sp<IBinder>& binder) {
+        if (binder == nullptr || binder->remoteBinder() == nullptr) return;
+        if (ProcessState::self()->getThreadPoolMaxThreadCount() == 0) return;
+
+        if (binder->linkToDeath(sp<ServiceCache>::fromExisting(this)) != OK) return;
+
+        bool registered;
+        {
+            std::lock_guard<std::mutex> _l(mLock);
+            auto [it, inserted] = mNameToService.try_emplace(name, binder);
+            if (!inserted) it->second = binder;
+            registered = !inserted;
+        }
+        if (registered) return;
+
+        if (Status status = mServiceManager->registerForNotifications(
+                    name, sp<ServiceCache>::fromExisting(this));
+            !status.isOk()) {
+            ALOGW("Failed to registerForNotifications for caching %s: %s", name.c_str(),
+                  status.toString8().c_str());
+            std::lock_guard<std::mutex> _l(mLock);
+            mNameToService.erase(name);
+        }
+    }
+
+    Status onRegistration(const std::string& name, const sp<IBinder>& binder) override {
+        // also called right after registering, with the binder which is already cached
+        std::lock_guard<std::mutex> _l(mLock);
+        if (auto it = mNameToService.find(name); it != mNameToService.end() && it->second != binder) {
+            it->second = nullptr;
+        }
+        return Status::ok();
+    }
+
+    void binderDied(const wp<IBinder>& who) override {
+        std::lock_guard<std::mutex> _l(mLock);
+        for (auto& [name, binder] : mNameToService) {
+            if (binder.get() == who.unsafe_get()) binder = nullptr;
+        }
+    }
+
+private:
+    sp<AidlServiceManager> mServiceManager;
+
+    std::mutex mLock;
+    // Entries are kept (with a null binder) once registered for notifications.
+    std::map<std::string, sp<IBinder>> mNameToService;
+};
+
 // From the old libbinder IServiceManager interface to IServiceManager.
 class ServiceManagerShim : public IServiceManager
 {
@@ -69,10 +153,12 @@ public:
 
     sp<IBinder> getService(const String16& name) const override;
     sp<IBinder> checkService(const String16& name) const override;
+    Vector<sp<IBinder>> checkServices(const Vector<String16>& names) const override;
     status_t addService(const String16& name, const sp<IBinder>& service,
                         bool allowIsolated, int dumpsysPriority) override;
     Vector<String16> listServices(int dumpsysPriority) override;
     sp<IBinder> waitForService(const String16& name16) override;
+    void waitForServiceAsync(const String16& name16, ServiceCallback callback) override;
     bool isDeclared(const String16& name) override;
     Vector<String16> getDeclaredInstances(const String16& interface) override;
     std::optional<String16> updatableViaApex(const String16& name) override;
@@ -86,6 +172,7 @@ public:
     }
 private:
     sp<AidlServiceManager> mTheRealServiceManager;
+    sp<ServiceCache> mCache;
 };
 
 [[clang::no_destroy]] static std::once_flag gSmOnce;
@@ -205,7 +292,7 @@ bool checkPermission(const String16& permission, pid_t pid, uid_t uid)
 // ----------------------------------------------------------------------
 
 ServiceManagerShim::ServiceManagerShim(const sp<AidlServiceManager>& impl)
- : mTheRealServiceManager(impl)
+ : mTheRealServiceManager(impl), mCache(sp<ServiceCache>::make(impl))
 {}
 
 // This implementation could be simplified and made more efficient by delegating
@@ -258,11 +345,50 @@ sp<IBinder> ServiceManagerShim::getService(const String16& name) const
 
 sp<IBinder> ServiceManagerShim::checkService(const String16& name) const
 {
-    sp<IBinder> ret;
-    if (!mTheRealServiceManager->checkService(String8(name).c_str(), &ret).isOk()) {
-        return nullptr;
+    Vector<String16> names;
+    names.push(name);
+    return checkServices(names)[0];
+}
+
+Vector<sp<IBinder>> ServiceManagerShim::checkServices(const Vector<String16>& names) const
+{
+    Vector<sp<IBinder>> res;
+    res.insertAt(0, names.size());
+
+    std::vector<std::string> missing;
+    std::vector<size_t> missingIndex;
+    for (size_t i = 0; i < names.size(); i++) {
+        std::string name = String8(names[i]).c_str();
+        if (sp<IBinder> cached = mCache->get(name); cached != nullptr) {
+            res.editItemAt(i) = cached;
+        } else {
+            missing.push_back(std::move(name));
+            missingIndex.push_back(i);
+        }
+    }
+    if (missing.empty()) return res;
+
+    std::vector<os::ServiceLookup> lookups;
+    if (Status status = mTheRealServiceManager->checkServices(missing, &lookups);
+        !status.isOk() || lookups.size() != missing.size()) {
+        // e.g. an older service manager, look up one by one
+        for (size_t i = 0; i < missing.size(); i++) {
+            sp<IBinder> ret;
+            if (mTheRealServiceManager->checkService(missing[i], &ret).isOk()) {
+                res.editItemAt(missingIndex[i]) = ret;
+            }
+        }
+        return res;
+    }
+
+    for (size_t i = 0; i < missing.size(); i++) {
+        const os::ServiceLookup& lookup = lookups[i];
+        if (lookup.service != nullptr && lookup.allowed && !lookup.isLazyService) {
+            mCache->put(missing[i], lookup.service);
+        }
+        res.editItemAt(missingIndex[i]) = lookup.service;
     }
-    return ret;
+    return res;
 }
 
 status_t ServiceManagerShim::addService(const String16& name, const sp<IBinder>& service,
@@ -318,6 +444,8 @@ sp<IBinder> ServiceManagerShim::waitForService(const String16& name16)
 
     const std::string name = String8(name16).c_str();
 
+    if (sp<IBinder> cached = mCache->get(name); cached != nullptr) return cached;
+
     sp<IBinder> out;
     if (Status status = mTheRealServiceManager->getService(name, &out); !status.isOk()) {
         ALOGW("Failed to getService in waitForService for %s: %s", name.c_str(),
@@ -372,6 +500,78 @@ sp<IBinder> ServiceManagerShim::waitForService(const String16& name16)
     }
 }
 
+void ServiceManagerShim::waitForServiceAsync(const String16& name16, ServiceCallback callback) {
+    // Calls back at most once, and stops the notifications it was
+    // registered for from there.
+    class AsyncWaiter : public android::os::BnServiceCallback {
+    public:
+        AsyncWaiter(const sp<AidlServiceManager>& sm, ServiceCallback&& callback)
+              : mServiceManager(sm), mCallback(std::move(callback)) {}
+
+        Status onRegistration(const std::string& name, const sp<IBinder>& binder) override {
+            if (!finish(binder)) return Status::ok();
+            // IServiceCallback is oneway, so this can't deadlock with the
+            // service manager
+            mServiceManager->unregisterForNotifications(name,
+                                                        sp<AsyncWaiter>::fromExisting(this));
+            // Flushing here helps ensure the service's ref count remains accurate
+            IPCThreadState::self()->flushCommands();
+            return Status::ok();
+        }
+
+        bool finish(const sp<IBinder>& binder) {
+            ServiceCallback callback;
+            {
+                std::lock_guard<std::mutex> _l(mMutex);
+                if (mCallback == nullptr) return false;
+                callback = std::move(mCallback);
+                mCallback = nullptr;
+            }
+            callback(binder);
+            return true;
+        }
+
+    private:
+        sp<AidlServiceManager> mServiceManager;
+        std::mutex mMutex;
+        ServiceCallback mCallback;
+    };
+
+    const std::string name = String8(name16).c_str();
+
+    if (sp<IBinder> cached = mCache->get(name); cached != nullptr) {
+        callback(cached);
+        return;
+    }
+
+    sp<IBinder> out;
+    if (Status status = mTheRealServiceManager->getService(name, &out); !status.isOk()) {
+        ALOGW("Failed to getService in waitForServiceAsync for %s: %s", name.c_str(),
+              status.toString8().c_str());
+        callback(nullptr);
+        return;
+    }
+    if (out != nullptr) {
+        callback(out);
+        return;
+    }
+
+    if (ProcessState::self()->getThreadPoolMaxThreadCount() == 0) {
+        ALOGW("waitForServiceAsync for %s without binder threads will never complete",
+              name.c_str());
+    }
+
+    // If the service is registered in the meantime, the service manager
+    // notifies right away.
+    sp<AsyncWaiter> waiter = sp<AsyncWaiter>::make(mTheRealServiceManager, std::move(callback));
+    if (Status status = mTheRealServiceManager->registerForNotifications(name, waiter);
+        !status.isOk()) {
+        ALOGW("Failed to registerForNotifications in waitForServiceAsync for %s: %s",
+              name.c_str(), status.toString8().c_str());
+        waiter->finish(nullptr);
+    }
+}
+
 bool ServiceManagerShim::isDeclared(const String16& name) {
     bool declared;
     if (Status status = mTheRealServiceManager->isDeclared(String8(name).c_str(), &declared);
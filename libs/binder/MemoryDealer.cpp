@@ -38,6 +38,13 @@
 #include <sys/mman.h>
 #include <sys/file.h>
 
+#include <atomic>
+#include <memory>
+
+#ifdef __GLIBC__
+extern "C" pid_t gettid();
+#endif
+
 namespace android {
 // ----------------------------------------------------------------------------
 
@@ -122,10 +129,11 @@ private:
 
 class SimpleBestFitAllocator
 {
+public:
     enum {
         PAGE_ALIGNED = 0x00000001
     };
-public:
+
     explicit SimpleBestFitAllocator(size_t size);
     ~SimpleBestFitAllocator();
 
@@ -163,6 +171,64 @@ private:
 
 // ----------------------------------------------------------------------------
 
+/*
+ * Serves small allocations out of slabs of kSlabSize bytes, each split into
+ * blocks of a single size class. Slabs are carved out of the best fit
+ * allocator under a lock, which is rare, but blocks are claimed and released
+ * with atomic operations on the bitmap of their slab, so concurrent small
+ * allocations neither serialize on a lock nor walk the free list.
+ */
+class SizeClassAllocator
+{
+public:
+    explicit SizeClassAllocator(SimpleBestFitAllocator* backing);
+
+    // NO_MEMORY if 'size' has no size class or no block is available
+    ssize_t     allocate(size_t size);
+    // false if 'offset' isn't in a slab
+    bool        deallocate(size_t offset);
+    // gives slabs without allocations back to the best fit allocator
+    void        releaseFreeSlabs();
+    void        dump(String8& res) const;
+
+    static constexpr size_t kSlabSize = 16 * 1024;
+    static constexpr size_t kMinBlockSize = 32; // SimpleBestFitAllocator::kMemoryAlign
+    static constexpr int kNumSizeClasses = 7;   // 32 bytes to 2KB
+    static constexpr size_t kMaxBlockSize = kMinBlockSize << (kNumSizeClasses - 1);
+
+private:
+    static constexpr size_t kBitmapWords = kSlabSize / kMinBlockSize / 64;
+    static constexpr int kUnused = -1;
+
+    struct Slab {
+        std::atomic<int> sizeClass;
+        std::atomic<size_t> start;
+        // a set bit is an allocated block, or is past the last block
+        std::atomic<uint64_t> bitmap[kBitmapWords];
+    };
+
+    static int      sizeClassFor(size_t size);
+    static size_t   blockSize(int sizeClass) { return kMinBlockSize << sizeClass; }
+    static uint64_t emptyBitmapWord(int sizeClass, size_t word);
+
+    ssize_t claimBlock(int sizeClass, size_t firstSlab);
+    ssize_t claimBlock(Slab& slab, int sizeClass);
+    ssize_t createSlab(int sizeClass);
+    void    setSlabPages(size_t start, int32_t value);
+
+    SimpleBestFitAllocator* const   mBacking;
+    // granularity of mGranuleToSlab, slabs are aligned to it
+    const size_t                    mGranule;
+    const size_t                    mNumSlabs;
+    std::unique_ptr<Slab[]>         mSlabs;
+    // index + 1 of the slab covering each granule of the heap, or 0
+    std::unique_ptr<std::atomic<int32_t>[]> mGranuleToSlab;
+    // serializes creating and releasing slabs
+    mutable Mutex                   mLock;
+};
+
+// ----------------------------------------------------------------------------
+
 Allocation::Allocation(
         const sp<MemoryDealer>& dealer,
         const sp<IMemoryHeap>& heap, ssize_t offset, size_t size)
@@ -228,18 +294,37 @@ Allocation::~Allocation()
 // ----------------------------------------------------------------------------
 
 MemoryDealer::MemoryDealer(size_t size, const char* name, uint32_t flags)
+      : MemoryDealer(size, name, flags, AllocationPolicy::BEST_FIT) {}
+
+MemoryDealer::MemoryDealer(size_t size, const char* name, uint32_t flags,
+                           AllocationPolicy policy)
       : mHeap(sp<MemoryHeapBase>::make(size, flags, name)),
-        mAllocator(new SimpleBestFitAllocator(size)) {}
+        mAllocator(new SimpleBestFitAllocator(size)),
+        mSizeClasses(policy == AllocationPolicy::SIZE_CLASSES
+                             ? new SizeClassAllocator(mAllocator)
+                             : nullptr) {}
 
 MemoryDealer::~MemoryDealer()
 {
+    delete mSizeClasses;
     delete mAllocator;
 }
 
 sp<IMemory> MemoryDealer::allocate(size_t size)
 {
     sp<IMemory> memory;
-    const ssize_t offset = allocator()->allocate(size);
+    ssize_t offset = NO_MEMORY;
+    if (mSizeClasses != nullptr) {
+        offset = mSizeClasses->allocate(size);
+    }
+    if (offset < 0) {
+        offset = allocator()->allocate(size);
+    }
+    if (offset < 0 && mSizeClasses != nullptr) {
+        // the memory may be held by slabs which no longer have allocations
+        mSizeClasses->releaseFreeSlabs();
+        offset = allocator()->allocate(size);
+    }
     if (offset >= 0) {
         memory = sp<Allocation>::make(sp<MemoryDealer>::fromExisting(this), heap(), offset, size);
     }
@@ -248,12 +333,20 @@ sp<IMemory> MemoryDealer::allocate(size_t size)
 
 void MemoryDealer::deallocate(size_t offset)
 {
+    if (mSizeClasses != nullptr && mSizeClasses->deallocate(offset)) {
+        return;
+    }
     allocator()->deallocate(offset);
 }
 
 void MemoryDealer::dump(const char* what) const
 {
     allocator()->dump(what);
+    if (mSizeClasses != nullptr) {
+        String8 result;
+        mSizeClasses->dump(result);
+        ALOGD("%s", result.string());
+    }
 }
 
 const sp<IMemoryHeap>& MemoryDealer::heap() const {
@@ -270,6 +363,12 @@ size_t MemoryDealer::getAllocationAlignment()
     return SimpleBestFitAllocator::getAllocationAlignment();
 }
 
+// static
+size_t MemoryDealer::getMaxSizeClassAllocation()
+{
+    return SizeClassAllocator::kMaxBlockSize;
+}
+
 // ----------------------------------------------------------------------------
 
 // align all the memory blocks on a cache-line boundary
@@ -479,4 +578,202 @@ void SimpleBestFitAllocator::dump_l(String8& result,
 }
 
 
+// ----------------------------------------------------------------------------
+
+SizeClassAllocator::SizeClassAllocator(SimpleBestFitAllocator* backing)
+    : mBacking(backing),
+      mGranule(size_t(getpagesize()) < kSlabSize ? size_t(getpagesize()) : kSlabSize),
+      mNumSlabs(backing->size() / kSlabSize),
+      mSlabs(new Slab[mNumSlabs]),
+      mGranuleToSlab(new std::atomic<int32_t>[backing->size() / mGranule])
+{
+    for (size_t i = 0; i < mNumSlabs; i++) {
+        mSlabs[i].sizeClass.store(kUnused, std::memory_order_relaxed);
+        mSlabs[i].start.store(0, std::memory_order_relaxed);
+        for (size_t w = 0; w < kBitmapWords; w++) {
+            mSlabs[i].bitmap[w].store(~uint64_t(0), std::memory_order_relaxed);
+        }
+    }
+    for (size_t i = 0; i < backing->size() / mGranule; i++) {
+        mGranuleToSlab[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+int SizeClassAllocator::sizeClassFor(size_t size)
+{
+    if (size == 0 || size > kMaxBlockSize) return -1;
+    int sizeClass = 0;
+    while (blockSize(sizeClass) < size) sizeClass++;
+    return sizeClass;
+}
+
+uint64_t SizeClassAllocator::emptyBitmapWord(int sizeClass, size_t word)
+{
+    const size_t blocks = kSlabSize / blockSize(sizeClass);
+    const size_t firstBlock = word * 64;
+    if (blocks >= firstBlock + 64) return 0;
+    if (blocks <= firstBlock) return ~uint64_t(0);
+    return ~uint64_t(0) << (blocks - firstBlock);
+}
+
+ssize_t SizeClassAllocator::allocate(size_t size)
+{
+    const int sizeClass = sizeClassFor(size);
+    if (sizeClass < 0 || mNumSlabs == 0) return NO_MEMORY;
+
+    // threads start looking at different slabs, so that they mostly don't
+    // contend for the same bitmap words
+    ssize_t offset = claimBlock(sizeClass, static_cast<size_t>(gettid()) % mNumSlabs);
+    if (offset >= 0) return offset;
+    return createSlab(sizeClass);
+}
+
+ssize_t SizeClassAllocator::claimBlock(int sizeClass, size_t firstSlab)
+{
+    for (size_t n = 0; n < mNumSlabs; n++) {
+        Slab& slab = mSlabs[(firstSlab + n) % mNumSlabs];
+        if (slab.sizeClass.load(std::memory_order_acquire) != sizeClass) continue;
+
+        ssize_t offset = claimBlock(slab, sizeClass);
+        if (offset >= 0) return offset;
+    }
+    return NO_MEMORY;
+}
+
+ssize_t SizeClassAllocator::claimBlock(Slab& slab, int sizeClass)
+{
+    for (size_t w = 0; w < kBitmapWords; w++) {
+        uint64_t word = slab.bitmap[w].load(std::memory_order_relaxed);
+        while (word != ~uint64_t(0)) {
+            const uint64_t bit = ~word & (word + 1); // lowest clear bit
+            word = slab.bitmap[w].fetch_or(bit, std::memory_order_acq_rel);
+            if (word & bit) continue; // another thread got it first
+
+            // The slab may have been released and reused for another size
+            // class since we checked. Blocks are only ever claimed after
+            // sizeClass and start are set, so this is the current one.
+            if (slab.sizeClass.load(std::memory_order_relaxed) != sizeClass) {
+                slab.bitmap[w].fetch_and(~bit, std::memory_order_release);
+                return NO_MEMORY;
+            }
+            const size_t block = w * 64 + __builtin_ctzll(bit);
+            return slab.start.load(std::memory_order_relaxed) + block * blockSize(sizeClass);
+        }
+    }
+    return NO_MEMORY;
+}
+
+ssize_t SizeClassAllocator::createSlab(int sizeClass)
+{
+    Mutex::Autolock _l(mLock);
+
+    // another thread may have created one while we were waiting
+    ssize_t offset = claimBlock(sizeClass, 0);
+    if (offset >= 0) return offset;
+
+    size_t index = 0;
+    while (index < mNumSlabs &&
+           mSlabs[index].sizeClass.load(std::memory_order_relaxed) != kUnused) {
+        index++;
+    }
+    if (index == mNumSlabs) return NO_MEMORY;
+
+    const ssize_t start = mBacking->allocate(kSlabSize, SimpleBestFitAllocator::PAGE_ALIGNED);
+    if (start < 0) return NO_MEMORY;
+
+    Slab& slab = mSlabs[index];
+    setSlabPages(start, static_cast<int32_t>(index + 1));
+    slab.start.store(start, std::memory_order_relaxed);
+    slab.sizeClass.store(sizeClass, std::memory_order_relaxed);
+    // publishes the slab, keeping the first block for the caller
+    for (size_t w = 0; w < kBitmapWords; w++) {
+        slab.bitmap[w].store(emptyBitmapWord(sizeClass, w) | (w == 0 ? 1 : 0),
+                             std::memory_order_release);
+    }
+    return start;
+}
+
+bool SizeClassAllocator::deallocate(size_t offset)
+{
+    if (mNumSlabs == 0 || offset >= mBacking->size()) return false;
+
+    const int32_t index = mGranuleToSlab[offset / mGranule].load(std::memory_order_acquire) - 1;
+    if (index < 0) return false;
+
+    Slab& slab = mSlabs[index];
+    const int sizeClass = slab.sizeClass.load(std::memory_order_relaxed);
+    const size_t relativeOffset = offset - slab.start.load(std::memory_order_relaxed);
+    if (relativeOffset % blockSize(sizeClass) != 0) {
+        // like SimpleBestFitAllocator, ignore offsets which weren't allocated
+        ALOGE("offset 0x%08zX is not the start of a block", offset);
+        return true;
+    }
+    const size_t block = relativeOffset / blockSize(sizeClass);
+    const uint64_t bit = uint64_t(1) << (block % 64);
+    const uint64_t word = slab.bitmap[block / 64].fetch_and(~bit, std::memory_order_release);
+    LOG_FATAL_IF(!(word & bit), "block at offset 0x%08zX already freed", offset);
+    return true;
+}
+
+void SizeClassAllocator::releaseFreeSlabs()
+{
+    Mutex::Autolock _l(mLock);
+
+    for (size_t i = 0; i < mNumSlabs; i++) {
+        Slab& slab = mSlabs[i];
+        const int sizeClass = slab.sizeClass.load(std::memory_order_relaxed);
+        if (sizeClass == kUnused) continue;
+
+        // claim every block, so that nobody can allocate from it anymore
+        size_t w = 0;
+        for (; w < kBitmapWords; w++) {
+            uint64_t expected = emptyBitmapWord(sizeClass, w);
+            if (!slab.bitmap[w].compare_exchange_strong(expected, ~uint64_t(0),
+                                                        std::memory_order_acq_rel)) {
+                break;
+            }
+        }
+        if (w < kBitmapWords) {
+            // still in use, nothing could be allocated from the words we took
+            while (w-- > 0) {
+                slab.bitmap[w].store(emptyBitmapWord(sizeClass, w), std::memory_order_release);
+            }
+            continue;
+        }
+
+        slab.sizeClass.store(kUnused, std::memory_order_relaxed);
+        const size_t start = slab.start.load(std::memory_order_relaxed);
+        setSlabPages(start, 0);
+        mBacking->deallocate(start);
+    }
+}
+
+void SizeClassAllocator::setSlabPages(size_t start, int32_t value)
+{
+    for (size_t offset = start; offset < start + kSlabSize; offset += mGranule) {
+        mGranuleToSlab[offset / mGranule].store(value, std::memory_order_release);
+    }
+}
+
+void SizeClassAllocator::dump(String8& result) const
+{
+    Mutex::Autolock _l(mLock);
+
+    result.appendFormat("  size classes (%zu slabs of %zu bytes)\n", mNumSlabs, kSlabSize);
+    for (size_t i = 0; i < mNumSlabs; i++) {
+        const Slab& slab = mSlabs[i];
+        const int sizeClass = slab.sizeClass.load(std::memory_order_relaxed);
+        if (sizeClass == kUnused) continue;
+
+        size_t used = 0;
+        for (size_t w = 0; w < kBitmapWords; w++) {
+            uint64_t word = slab.bitmap[w].load(std::memory_order_relaxed);
+            used += __builtin_popcountll(word & ~emptyBitmapWord(sizeClass, w));
+        }
+        result.appendFormat("  %3zu: 0x%08zX | %4zu bytes | %zu/%zu used\n", i,
+                            slab.start.load(std::memory_order_relaxed), blockSize(sizeClass),
+                            used, kSlabSize / blockSize(sizeClass));
+    }
+}
+
 } // namespace android
@@ -2258,7 +2258,11 @@ void Parcel::freeDataNoInit()
     } else {
         LOG_ALLOC("Parcel %p: freeing allocated data", this);
         releaseObjects();
-        if (mData) {
+        if (isInlineData()) {
+            if (mDeallocZero) {
+                zeroMemory(mData, mDataSize);
+            }
+        } else if (mData) {
             LOG_ALLOC("Parcel %p: freeing with %zu capacity", this, mDataCapacity);
             gParcelGlobalAllocSize -= mDataCapacity;
             gParcelGlobalAllocCount--;
@@ -2302,6 +2306,24 @@ static uint8_t* reallocZeroFree(uint8_t* data, size_t oldCapacity, size_t newCap
     return newData;
 }
 
+uint8_t* Parcel::moveInlineDataToHeap(size_t desired)
+{
+    uint8_t* data = (uint8_t*)malloc(desired);
+    if (!data) {
+        return nullptr;
+    }
+
+    memcpy(data, mInlineData, std::min(mDataSize, desired));
+    if (mDeallocZero) {
+        zeroMemory(mInlineData, kInlineDataCapacity);
+    }
+
+    LOG_ALLOC("Parcel %p: moving inline data to %zu capacity", this, desired);
+    gParcelGlobalAllocSize += desired;
+    gParcelGlobalAllocCount++;
+    return data;
+}
+
 status_t Parcel::restartWrite(size_t desired)
 {
     if (desired > INT32_MAX) {
@@ -2315,27 +2337,52 @@ status_t Parcel::restartWrite(size_t desired)
         return continueWrite(desired);
     }
 
-    uint8_t* data = reallocZeroFree(mData, mDataCapacity, desired, mDeallocZero);
-    if (!data && desired > mDataCapacity) {
-        mError = NO_MEMORY;
-        return NO_MEMORY;
-    }
-
-    releaseObjects();
+    if (isInlineData() || (mData == nullptr && desired <= kInlineDataCapacity)) {
+        // nothing is kept, so this only allocates if it no longer fits inline
+        uint8_t* data = mInlineData;
+        if (desired > kInlineDataCapacity) {
+            data = (uint8_t*)malloc(desired);
+            if (!data) {
+                mError = NO_MEMORY;
+                return NO_MEMORY;
+            }
+        }
 
-    if (data || desired == 0) {
-        LOG_ALLOC("Parcel %p: restart from %zu to %zu capacity", this, mDataCapacity, desired);
-        if (mDataCapacity > desired) {
-            gParcelGlobalAllocSize -= (mDataCapacity - desired);
-        } else {
-            gParcelGlobalAllocSize += (desired - mDataCapacity);
+        releaseObjects();
+        if (mData && mDeallocZero) {
+            zeroMemory(mData, mDataSize);
         }
 
-        if (!mData) {
+        if (data != mInlineData) {
+            LOG_ALLOC("Parcel %p: restart from inline to %zu capacity", this, desired);
+            gParcelGlobalAllocSize += desired;
             gParcelGlobalAllocCount++;
         }
         mData = data;
-        mDataCapacity = desired;
+        mDataCapacity = data == mInlineData ? kInlineDataCapacity : desired;
+    } else {
+        uint8_t* data = reallocZeroFree(mData, mDataCapacity, desired, mDeallocZero);
+        if (!data && desired > mDataCapacity) {
+            mError = NO_MEMORY;
+            return NO_MEMORY;
+        }
+
+        releaseObjects();
+
+        if (data || desired == 0) {
+            LOG_ALLOC("Parcel %p: restart from %zu to %zu capacity", this, mDataCapacity, desired);
+            if (mDataCapacity > desired) {
+                gParcelGlobalAllocSize -= (mDataCapacity - desired);
+            } else {
+                gParcelGlobalAllocSize += (desired - mDataCapacity);
+            }
+
+            if (!mData) {
+                gParcelGlobalAllocCount++;
+            }
+            mData = data;
+            mDataCapacity = desired;
+        }
     }
 
     mDataSize = mDataPos = 0;
@@ -2386,7 +2433,8 @@ status_t Parcel::continueWrite(size_t desired)
 
         // If there is a different owner, we need to take
         // posession.
-        uint8_t* data = (uint8_t*)malloc(desired);
+        const bool inlineData = desired <= kInlineDataCapacity;
+        uint8_t* data = inlineData ? mInlineData : (uint8_t*)malloc(desired);
         if (!data) {
             mError = NO_MEMORY;
             return NO_MEMORY;
@@ -2396,7 +2444,7 @@ status_t Parcel::continueWrite(size_t desired)
         if (objectsSize) {
             objects = (binder_size_t*)calloc(objectsSize, sizeof(binder_size_t));
             if (!objects) {
-                free(data);
+                if (!inlineData) free(data);
 
                 mError = NO_MEMORY;
                 return NO_MEMORY;
@@ -2420,15 +2468,17 @@ status_t Parcel::continueWrite(size_t desired)
         mOwner(this, mData, mDataSize, mObjects, mObjectsSize);
         mOwner = nullptr;
 
-        LOG_ALLOC("Parcel %p: taking ownership of %zu capacity", this, desired);
-        gParcelGlobalAllocSize += desired;
-        gParcelGlobalAllocCount++;
+        if (!inlineData) {
+            LOG_ALLOC("Parcel %p: taking ownership of %zu capacity", this, desired);
+            gParcelGlobalAllocSize += desired;
+            gParcelGlobalAllocCount++;
+        }
 
         mData = data;
         mObjects = objects;
         mDataSize = (mDataSize < desired) ? mDataSize : desired;
         ALOGV("continueWrite Setting data size of %p to %zu", this, mDataSize);
-        mDataCapacity = desired;
+        mDataCapacity = inlineData ? kInlineDataCapacity : desired;
         mObjectsSize = mObjectsCapacity = objectsSize;
         mNextObjectHint = 0;
         mObjectsSorted = false;
@@ -2465,7 +2515,15 @@ status_t Parcel::continueWrite(size_t desired)
         }
 
         // We own the data, so we can just do a realloc().
-        if (desired > mDataCapacity) {
+        if (desired > mDataCapacity && isInlineData()) {
+            uint8_t* data = moveInlineDataToHeap(desired);
+            if (!data) {
+                mError = NO_MEMORY;
+                return NO_MEMORY;
+            }
+            mData = data;
+            mDataCapacity = desired;
+        } else if (desired > mDataCapacity) {
             uint8_t* data = reallocZeroFree(mData, mDataCapacity, desired, mDeallocZero);
             if (data) {
                 LOG_ALLOC("Parcel %p: continue from %zu to %zu capacity", this, mDataCapacity,
@@ -2491,7 +2549,8 @@ status_t Parcel::continueWrite(size_t desired)
 
     } else {
         // This is the first data.  Easy!
-        uint8_t* data = (uint8_t*)malloc(desired);
+        const bool inlineData = desired <= kInlineDataCapacity;
+        uint8_t* data = inlineData ? mInlineData : (uint8_t*)malloc(desired);
         if (!data) {
             mError = NO_MEMORY;
             return NO_MEMORY;
@@ -2502,15 +2561,17 @@ status_t Parcel::continueWrite(size_t desired)
             ALOGE("continueWrite: %zu/%p/%zu/%zu", mDataCapacity, mObjects, mObjectsCapacity, desired);
         }
 
-        LOG_ALLOC("Parcel %p: allocating with %zu capacity", this, desired);
-        gParcelGlobalAllocSize += desired;
-        gParcelGlobalAllocCount++;
+        if (!inlineData) {
+            LOG_ALLOC("Parcel %p: allocating with %zu capacity", this, desired);
+            gParcelGlobalAllocSize += desired;
+            gParcelGlobalAllocCount++;
+        }
 
         mData = data;
         mDataSize = mDataPos = 0;
         ALOGV("continueWrite Setting data size of %p to %zu", this, mDataSize);
         ALOGV("continueWrite Setting data pos of %p to %zu", this, mDataPos);
-        mDataCapacity = desired;
+        mDataCapacity = inlineData ? kInlineDataCapacity : desired;
     }
 
     return NO_ERROR;
@@ -18,7 +18,9 @@
 
 #include <binder/PersistableBundle.h>
 
+#include <algorithm>
 #include <limits>
+#include <type_traits>
 
 #include <binder/IBinder.h>
 #include <binder/Parcel.h>
@@ -46,7 +48,6 @@ using android::binder::VAL_DOUBLEARRAY;
 using android::binder::VAL_STRINGARRAY;
 using android::binder::VAL_PERSISTABLEBUNDLE;
 
-using std::map;
 using std::set;
 using std::vector;
 
@@ -56,26 +57,6 @@ enum {
     BUNDLE_MAGIC_NATIVE = 0x4C444E44,
 };
 
-namespace {
-template <typename T>
-bool getValue(const android::String16& key, T* out, const map<android::String16, T>& map) {
-    const auto& it = map.find(key);
-    if (it == map.end()) return false;
-    *out = it->second;
-    return true;
-}
-
-template <typename T>
-set<android::String16> getKeys(const map<android::String16, T>& map) {
-    if (map.empty()) return set<android::String16>();
-    set<android::String16> keys;
-    for (const auto& key_value_pair : map) {
-        keys.emplace(key_value_pair.first);
-    }
-    return keys;
-}
-}  // namespace
-
 namespace android {
 
 namespace os {
@@ -89,15 +70,6 @@ namespace os {
          }                                                               \
     }
 
-#define RETURN_IF_ENTRY_ERASED(map, key)                                 \
-    {                                                                    \
-        size_t num_erased = (map).erase(key);                            \
-        if (num_erased) {                                                \
-            ALOGE("Failed at %s:%d (%s)", __FILE__, __LINE__, __func__); \
-            return num_erased;                                           \
-         }                                                               \
-    }
-
 status_t PersistableBundle::writeToParcel(Parcel* parcel) const {
     /*
      * Keep implementation in sync with writeToParcelInner() in
@@ -149,174 +121,200 @@ bool PersistableBundle::empty() const {
 }
 
 size_t PersistableBundle::size() const {
-    return (mBoolMap.size() +
-            mIntMap.size() +
-            mLongMap.size() +
-            mDoubleMap.size() +
-            mStringMap.size() +
-            mBoolVectorMap.size() +
-            mIntVectorMap.size() +
-            mLongVectorMap.size() +
-            mDoubleVectorMap.size() +
-            mStringVectorMap.size() +
-            mPersistableBundleMap.size());
+    return mEntries.size();
+}
+
+const PersistableBundle::Entry* PersistableBundle::find(const String16& key) const {
+    auto it = std::lower_bound(mEntries.begin(), mEntries.end(), key,
+                               [](const Entry& entry, const String16& key) {
+                                   return entry.key < key;
+                               });
+    if (it == mEntries.end() || it->key != key) return nullptr;
+    return &*it;
 }
 
 size_t PersistableBundle::erase(const String16& key) {
-    RETURN_IF_ENTRY_ERASED(mBoolMap, key);
-    RETURN_IF_ENTRY_ERASED(mIntMap, key);
-    RETURN_IF_ENTRY_ERASED(mLongMap, key);
-    RETURN_IF_ENTRY_ERASED(mDoubleMap, key);
-    RETURN_IF_ENTRY_ERASED(mStringMap, key);
-    RETURN_IF_ENTRY_ERASED(mBoolVectorMap, key);
-    RETURN_IF_ENTRY_ERASED(mIntVectorMap, key);
-    RETURN_IF_ENTRY_ERASED(mLongVectorMap, key);
-    RETURN_IF_ENTRY_ERASED(mDoubleVectorMap, key);
-    RETURN_IF_ENTRY_ERASED(mStringVectorMap, key);
-    return mPersistableBundleMap.erase(key);
+    const Entry* entry = find(key);
+    if (entry == nullptr) return 0;
+    mEntries.erase(mEntries.begin() + (entry - mEntries.data()));
+    return 1;
+}
+
+template <typename T>
+void PersistableBundle::putValue(const String16& key, T value) {
+    auto it = std::lower_bound(mEntries.begin(), mEntries.end(), key,
+                               [](const Entry& entry, const String16& key) {
+                                   return entry.key < key;
+                               });
+    if (it != mEntries.end() && it->key == key) {
+        it->value.template emplace<T>(std::move(value));
+    } else {
+        mEntries.insert(it, Entry{key, Value(std::in_place_type<T>, std::move(value))});
+    }
+}
+
+template <typename T>
+bool PersistableBundle::getValue(const String16& key, T* out) const {
+    const Entry* entry = find(key);
+    if (entry == nullptr) return false;
+    const T* value = std::get_if<T>(&entry->value);
+    if (value == nullptr) return false;
+    *out = *value;
+    return true;
+}
+
+template <typename T>
+set<String16> PersistableBundle::getKeys() const {
+    set<String16> keys;
+    for (const Entry& entry : mEntries) {
+        // already sorted
+        if (std::holds_alternative<T>(entry.value)) keys.emplace_hint(keys.end(), entry.key);
+    }
+    return keys;
+}
+
+bool PersistableBundle::Entry::operator==(const Entry& other) const {
+    if (key != other.key || value.index() != other.value.index()) return false;
+    if (const auto* bundle = std::get_if<std::shared_ptr<const PersistableBundle>>(&value)) {
+        return **bundle == *std::get<std::shared_ptr<const PersistableBundle>>(other.value);
+    }
+    return value == other.value;
 }
 
 void PersistableBundle::putBoolean(const String16& key, bool value) {
-    erase(key);
-    mBoolMap[key] = value;
+    putValue<bool>(key, value);
 }
 
 void PersistableBundle::putInt(const String16& key, int32_t value) {
-    erase(key);
-    mIntMap[key] = value;
+    putValue<int32_t>(key, value);
 }
 
 void PersistableBundle::putLong(const String16& key, int64_t value) {
-    erase(key);
-    mLongMap[key] = value;
+    putValue<int64_t>(key, value);
 }
 
 void PersistableBundle::putDouble(const String16& key, double value) {
-    erase(key);
-    mDoubleMap[key] = value;
+    putValue<double>(key, value);
 }
 
 void PersistableBundle::putString(const String16& key, const String16& value) {
-    erase(key);
-    mStringMap[key] = value;
+    putValue<String16>(key, value);
 }
 
 void PersistableBundle::putBooleanVector(const String16& key, const vector<bool>& value) {
-    erase(key);
-    mBoolVectorMap[key] = value;
+    putValue<vector<bool>>(key, value);
 }
 
 void PersistableBundle::putIntVector(const String16& key, const vector<int32_t>& value) {
-    erase(key);
-    mIntVectorMap[key] = value;
+    putValue<vector<int32_t>>(key, value);
 }
 
 void PersistableBundle::putLongVector(const String16& key, const vector<int64_t>& value) {
-    erase(key);
-    mLongVectorMap[key] = value;
+    putValue<vector<int64_t>>(key, value);
 }
 
 void PersistableBundle::putDoubleVector(const String16& key, const vector<double>& value) {
-    erase(key);
-    mDoubleVectorMap[key] = value;
+    putValue<vector<double>>(key, value);
 }
 
 void PersistableBundle::putStringVector(const String16& key, const vector<String16>& value) {
-    erase(key);
-    mStringVectorMap[key] = value;
+    putValue<vector<String16>>(key, value);
 }
 
 void PersistableBundle::putPersistableBundle(const String16& key, const PersistableBundle& value) {
-    erase(key);
-    mPersistableBundleMap[key] = value;
+    putValue<std::shared_ptr<const PersistableBundle>>(
+            key, std::make_shared<const PersistableBundle>(value));
 }
 
 bool PersistableBundle::getBoolean(const String16& key, bool* out) const {
-    return getValue(key, out, mBoolMap);
+    return getValue(key, out);
 }
 
 bool PersistableBundle::getInt(const String16& key, int32_t* out) const {
-    return getValue(key, out, mIntMap);
+    return getValue(key, out);
 }
 
 bool PersistableBundle::getLong(const String16& key, int64_t* out) const {
-    return getValue(key, out, mLongMap);
+    return getValue(key, out);
 }
 
 bool PersistableBundle::getDouble(const String16& key, double* out) const {
-    return getValue(key, out, mDoubleMap);
+    return getValue(key, out);
 }
 
 bool PersistableBundle::getString(const String16& key, String16* out) const {
-    return getValue(key, out, mStringMap);
+    return getValue(key, out);
 }
 
 bool PersistableBundle::getBooleanVector(const String16& key, vector<bool>* out) const {
-    return getValue(key, out, mBoolVectorMap);
+    return getValue(key, out);
 }
 
 bool PersistableBundle::getIntVector(const String16& key, vector<int32_t>* out) const {
-    return getValue(key, out, mIntVectorMap);
+    return getValue(key, out);
 }
 
 bool PersistableBundle::getLongVector(const String16& key, vector<int64_t>* out) const {
-    return getValue(key, out, mLongVectorMap);
+    return getValue(key, out);
 }
 
 bool PersistableBundle::getDoubleVector(const String16& key, vector<double>* out) const {
-    return getValue(key, out, mDoubleVectorMap);
+    return getValue(key, out);
 }
 
 bool PersistableBundle::getStringVector(const String16& key, vector<String16>* out) const {
-    return getValue(key, out, mStringVectorMap);
+    return getValue(key, out);
 }
 
 bool PersistableBundle::getPersistableBundle(const String16& key, PersistableBundle* out) const {
-    return getValue(key, out, mPersistableBundleMap);
+    std::shared_ptr<const PersistableBundle> bundle;
+    if (!getValue(key, &bundle)) return false;
+    *out = *bundle;
+    return true;
 }
 
 set<String16> PersistableBundle::getBooleanKeys() const {
-    return getKeys(mBoolMap);
+    return getKeys<bool>();
 }
 
 set<String16> PersistableBundle::getIntKeys() const {
-    return getKeys(mIntMap);
+    return getKeys<int32_t>();
 }
 
 set<String16> PersistableBundle::getLongKeys() const {
-    return getKeys(mLongMap);
+    return getKeys<int64_t>();
 }
 
 set<String16> PersistableBundle::getDoubleKeys() const {
-    return getKeys(mDoubleMap);
+    return getKeys<double>();
 }
 
 set<String16> PersistableBundle::getStringKeys() const {
-    return getKeys(mStringMap);
+    return getKeys<String16>();
 }
 
 set<String16> PersistableBundle::getBooleanVectorKeys() const {
-    return getKeys(mBoolVectorMap);
+    return getKeys<vector<bool>>();
 }
 
 set<String16> PersistableBundle::getIntVectorKeys() const {
-    return getKeys(mIntVectorMap);
+    return getKeys<vector<int32_t>>();
 }
 
 set<String16> PersistableBundle::getLongVectorKeys() const {
-    return getKeys(mLongVectorMap);
+    return getKeys<vector<int64_t>>();
 }
 
 set<String16> PersistableBundle::getDoubleVectorKeys() const {
-    return getKeys(mDoubleVectorMap);
+    return getKeys<vector<double>>();
 }
 
 set<String16> PersistableBundle::getStringVectorKeys() const {
-    return getKeys(mStringVectorMap);
+    return getKeys<vector<String16>>();
 }
 
 set<String16> PersistableBundle::getPersistableBundleKeys() const {
-    return getKeys(mPersistableBundleMap);
+    return getKeys<std::shared_ptr<const PersistableBundle>>();
 }
 
 status_t PersistableBundle::writeToParcelInner(Parcel* parcel) const {
@@ -334,60 +332,54 @@ status_t PersistableBundle::writeToParcelInner(Parcel* parcel) const {
     }
     RETURN_IF_FAILED(parcel->writeInt32(static_cast<int32_t>(num_entries)));
 
-    for (const auto& key_val_pair : mBoolMap) {
-        RETURN_IF_FAILED(parcel->writeString16(key_val_pair.first));
-        RETURN_IF_FAILED(parcel->writeInt32(VAL_BOOLEAN));
-        RETURN_IF_FAILED(parcel->writeBool(key_val_pair.second));
-    }
-    for (const auto& key_val_pair : mIntMap) {
-        RETURN_IF_FAILED(parcel->writeString16(key_val_pair.first));
-        RETURN_IF_FAILED(parcel->writeInt32(VAL_INTEGER));
-        RETURN_IF_FAILED(parcel->writeInt32(key_val_pair.second));
-    }
-    for (const auto& key_val_pair : mLongMap) {
-        RETURN_IF_FAILED(parcel->writeString16(key_val_pair.first));
-        RETURN_IF_FAILED(parcel->writeInt32(VAL_LONG));
-        RETURN_IF_FAILED(parcel->writeInt64(key_val_pair.second));
-    }
-    for (const auto& key_val_pair : mDoubleMap) {
-        RETURN_IF_FAILED(parcel->writeString16(key_val_pair.first));
-        RETURN_IF_FAILED(parcel->writeInt32(VAL_DOUBLE));
-        RETURN_IF_FAILED(parcel->writeDouble(key_val_pair.second));
-    }
-    for (const auto& key_val_pair : mStringMap) {
-        RETURN_IF_FAILED(parcel->writeString16(key_val_pair.first));
-        RETURN_IF_FAILED(parcel->writeInt32(VAL_STRING));
-        RETURN_IF_FAILED(parcel->writeString16(key_val_pair.second));
-    }
-    for (const auto& key_val_pair : mBoolVectorMap) {
-        RETURN_IF_FAILED(parcel->writeString16(key_val_pair.first));
-        RETURN_IF_FAILED(parcel->writeInt32(VAL_BOOLEANARRAY));
-        RETURN_IF_FAILED(parcel->writeBoolVector(key_val_pair.second));
-    }
-    for (const auto& key_val_pair : mIntVectorMap) {
-        RETURN_IF_FAILED(parcel->writeString16(key_val_pair.first));
-        RETURN_IF_FAILED(parcel->writeInt32(VAL_INTARRAY));
-        RETURN_IF_FAILED(parcel->writeInt32Vector(key_val_pair.second));
-    }
-    for (const auto& key_val_pair : mLongVectorMap) {
-        RETURN_IF_FAILED(parcel->writeString16(key_val_pair.first));
-        RETURN_IF_FAILED(parcel->writeInt32(VAL_LONGARRAY));
-        RETURN_IF_FAILED(parcel->writeInt64Vector(key_val_pair.second));
-    }
-    for (const auto& key_val_pair : mDoubleVectorMap) {
-        RETURN_IF_FAILED(parcel->writeString16(key_val_pair.first));
-        RETURN_IF_FAILED(parcel->writeInt32(VAL_DOUBLEARRAY));
-        RETURN_IF_FAILED(parcel->writeDoubleVector(key_val_pair.second));
-    }
-    for (const auto& key_val_pair : mStringVectorMap) {
-        RETURN_IF_FAILED(parcel->writeString16(key_val_pair.first));
-        RETURN_IF_FAILED(parcel->writeInt32(VAL_STRINGARRAY));
-        RETURN_IF_FAILED(parcel->writeString16Vector(key_val_pair.second));
-    }
-    for (const auto& key_val_pair : mPersistableBundleMap) {
-        RETURN_IF_FAILED(parcel->writeString16(key_val_pair.first));
-        RETURN_IF_FAILED(parcel->writeInt32(VAL_PERSISTABLEBUNDLE));
-        RETURN_IF_FAILED(key_val_pair.second.writeToParcel(parcel));
+    // Grouped by type, like the separate maps per type this used to have, so
+    // that the output doesn't change.
+    for (size_t type = 0; type < std::variant_size_v<Value>; type++) {
+        for (const Entry& entry : mEntries) {
+            if (entry.value.index() != type) continue;
+
+            RETURN_IF_FAILED(parcel->writeString16(entry.key));
+            RETURN_IF_FAILED(std::visit(
+                    [&](const auto& value) -> status_t {
+                        using T = std::decay_t<decltype(value)>;
+                        if constexpr (std::is_same_v<T, bool>) {
+                            RETURN_IF_FAILED(parcel->writeInt32(VAL_BOOLEAN));
+                            return parcel->writeBool(value);
+                        } else if constexpr (std::is_same_v<T, int32_t>) {
+                            RETURN_IF_FAILED(parcel->writeInt32(VAL_INTEGER));
+                            return parcel->writeInt32(value);
+                        } else if constexpr (std::is_same_v<T, int64_t>) {
+                            RETURN_IF_FAILED(parcel->writeInt32(VAL_LONG));
+                            return parcel->writeInt64(value);
+                        } else if constexpr (std::is_same_v<T, double>) {
+                            RETURN_IF_FAILED(parcel->writeInt32(VAL_DOUBLE));
+                            return parcel->writeDouble(value);
+                        } else if constexpr (std::is_same_v<T, String16>) {
+                            RETURN_IF_FAILED(parcel->writeInt32(VAL_STRING));
+                            return parcel->writeString16(value);
+                        } else if constexpr (std::is_same_v<T, vector<bool>>) {
+                            RETURN_IF_FAILED(parcel->writeInt32(VAL_BOOLEANARRAY));
+                            return parcel->writeBoolVector(value);
+                        } else if constexpr (std::is_same_v<T, vector<int32_t>>) {
+                            RETURN_IF_FAILED(parcel->writeInt32(VAL_INTARRAY));
+                            return parcel->writeInt32Vector(value);
+                        } else if constexpr (std::is_same_v<T, vector<int64_t>>) {
+                            RETURN_IF_FAILED(parcel->writeInt32(VAL_LONGARRAY));
+                            return parcel->writeInt64Vector(value);
+                        } else if constexpr (std::is_same_v<T, vector<double>>) {
+                            RETURN_IF_FAILED(parcel->writeInt32(VAL_DOUBLEARRAY));
+                            return parcel->writeDoubleVector(value);
+                        } else if constexpr (std::is_same_v<T, vector<String16>>) {
+                            RETURN_IF_FAILED(parcel->writeInt32(VAL_STRINGARRAY));
+                            return parcel->writeString16Vector(value);
+                        } else {
+                            static_assert(std::is_same_v<T, std::shared_ptr<const PersistableBundle>>);
+                            RETURN_IF_FAILED(parcel->writeInt32(VAL_PERSISTABLEBUNDLE));
+                            return value->writeToParcel(parcel);
+                        }
+                    },
+                    entry.value));
+        }
     }
     return NO_ERROR;
 }
@@ -419,59 +411,64 @@ status_t PersistableBundle::readFromParcelInner(const Parcel* parcel, size_t len
     int32_t num_entries;
     RETURN_IF_FAILED(parcel->readInt32(&num_entries));
 
+    // every entry takes at least 8 bytes, for the key and the type
+    if (num_entries > 0) {
+        mEntries.reserve(mEntries.size() +
+                         std::min<size_t>(num_entries, parcel->dataAvail() / 8));
+    }
+
     for (; num_entries > 0; --num_entries) {
-        String16 key;
+        Entry entry;
         int32_t value_type;
-        RETURN_IF_FAILED(parcel->readString16(&key));
+        RETURN_IF_FAILED(parcel->readString16(&entry.key));
         RETURN_IF_FAILED(parcel->readInt32(&value_type));
 
-        /*
-         * We assume that both the C++ and Java APIs ensure that all keys in a PersistableBundle
-         * are unique.
-         */
         switch (value_type) {
             case VAL_STRING: {
-                RETURN_IF_FAILED(parcel->readString16(&mStringMap[key]));
+                RETURN_IF_FAILED(parcel->readString16(&entry.value.emplace<String16>()));
                 break;
             }
             case VAL_INTEGER: {
-                RETURN_IF_FAILED(parcel->readInt32(&mIntMap[key]));
+                RETURN_IF_FAILED(parcel->readInt32(&entry.value.emplace<int32_t>()));
                 break;
             }
             case VAL_LONG: {
-                RETURN_IF_FAILED(parcel->readInt64(&mLongMap[key]));
+                RETURN_IF_FAILED(parcel->readInt64(&entry.value.emplace<int64_t>()));
                 break;
             }
             case VAL_DOUBLE: {
-                RETURN_IF_FAILED(parcel->readDouble(&mDoubleMap[key]));
+                RETURN_IF_FAILED(parcel->readDouble(&entry.value.emplace<double>()));
                 break;
             }
             case VAL_BOOLEAN: {
-                RETURN_IF_FAILED(parcel->readBool(&mBoolMap[key]));
+                RETURN_IF_FAILED(parcel->readBool(&entry.value.emplace<bool>()));
                 break;
             }
             case VAL_STRINGARRAY: {
-                RETURN_IF_FAILED(parcel->readString16Vector(&mStringVectorMap[key]));
+                RETURN_IF_FAILED(
+                        parcel->readString16Vector(&entry.value.emplace<vector<String16>>()));
                 break;
             }
             case VAL_INTARRAY: {
-                RETURN_IF_FAILED(parcel->readInt32Vector(&mIntVectorMap[key]));
+                RETURN_IF_FAILED(parcel->readInt32Vector(&entry.value.emplace<vector<int32_t>>()));
                 break;
             }
             case VAL_LONGARRAY: {
-                RETURN_IF_FAILED(parcel->readInt64Vector(&mLongVectorMap[key]));
+                RETURN_IF_FAILED(parcel->readInt64Vector(&entry.value.emplace<vector<int64_t>>()));
                 break;
             }
             case VAL_BOOLEANARRAY: {
-                RETURN_IF_FAILED(parcel->readBoolVector(&mBoolVectorMap[key]));
+                RETURN_IF_FAILED(parcel->readBoolVector(&entry.value.emplace<vector<bool>>()));
                 break;
             }
             case VAL_PERSISTABLEBUNDLE: {
-                RETURN_IF_FAILED(mPersistableBundleMap[key].readFromParcel(parcel));
+                auto bundle = std::make_shared<PersistableBundle>();
+                RETURN_IF_FAILED(bundle->readFromParcel(parcel));
+                entry.value = std::shared_ptr<const PersistableBundle>(std::move(bundle));
                 break;
             }
             case VAL_DOUBLEARRAY: {
-                RETURN_IF_FAILED(parcel->readDoubleVector(&mDoubleVectorMap[key]));
+                RETURN_IF_FAILED(parcel->readDoubleVector(&entry.value.emplace<vector<double>>()));
                 break;
             }
             default: {
@@ -480,6 +477,26 @@ status_t PersistableBundle::readFromParcelInner(const Parcel* parcel, size_t len
                 break;
             }
         }
+        mEntries.push_back(std::move(entry));
+    }
+
+    /*
+     * The Java implementation writes keys in the order of their hashes, and
+     * keys may already be present. Sort, letting the last value read for a
+     * key win.
+     */
+    auto unordered = [](const Entry& lhs, const Entry& rhs) { return !(lhs.key < rhs.key); };
+    if (std::adjacent_find(mEntries.begin(), mEntries.end(), unordered) != mEntries.end()) {
+        std::stable_sort(mEntries.begin(), mEntries.end(), [](const Entry& lhs, const Entry& rhs) {
+            return lhs.key < rhs.key;
+        });
+        auto out = mEntries.begin();
+        for (auto it = mEntries.begin(); it != mEntries.end(); ++out) {
+            auto last = it;
+            while (++it != mEntries.end() && it->key == last->key) last = it;
+            if (out != last) *out = std::move(*last);
+        }
+        mEntries.erase(out, mEntries.end());
     }
 
     return NO_ERROR;
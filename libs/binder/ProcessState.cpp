@@ -27,6 +27,9 @@
 #include <utils/String8.h>
 #include <utils/threads.h>
 
+#include "BinderBufferTracker.h"
+#include "BinderCpuAttribution.h"
+#include "BinderStats.h"
 #include "Static.h"
 #include "binder_module.h"
 
@@ -350,15 +353,46 @@ status_t ProcessState::setThreadPoolMaxThreadCount(size_t maxThreads) {
     LOG_ALWAYS_FATAL_IF(mThreadPoolStarted && maxThreads < mMaxThreads,
            "Binder threadpool cannot be shrunk after starting");
     status_t result = NO_ERROR;
-    if (ioctl(mDriverFD, BINDER_SET_MAX_THREADS, &maxThreads) != -1) {
+    pthread_mutex_lock(&mThreadCountLock);
+    // The kernel counts retired threads as started, see retireIdleThread().
+    size_t kernelMaxThreads = maxThreads + mRetiredThreads;
+    if (ioctl(mDriverFD, BINDER_SET_MAX_THREADS, &kernelMaxThreads) != -1) {
         mMaxThreads = maxThreads;
     } else {
         result = -errno;
         ALOGE("Binder ioctl to set max threads failed: %s", strerror(-result));
     }
+    pthread_mutex_unlock(&mThreadCountLock);
     return result;
 }
 
+void ProcessState::setThreadPoolIdleTimeout(int64_t timeoutMs) {
+    mIdleTimeoutMs.store(timeoutMs < 0 ? 0 : timeoutMs, std::memory_order_relaxed);
+}
+
+ProcessState::ThreadPoolStats ProcessState::getThreadPoolStats() {
+    ThreadPoolStats stats;
+    pthread_mutex_lock(&mThreadCountLock);
+    stats.spawnedThreads = mSpawnedThreads;
+    stats.retiredThreads = mRetiredThreads;
+    stats.occupancy = mOccupancy;
+    pthread_mutex_unlock(&mThreadCountLock);
+    return stats;
+}
+
+void ProcessState::retireIdleThread() {
+    pthread_mutex_lock(&mThreadCountLock);
+    mRetiredThreads++;
+    // The driver never decrements its count of started threads, even on
+    // BC_EXIT_LOOPER, so raise its limit to let it request a new thread
+    // in place of this one when load comes back.
+    size_t kernelMaxThreads = mMaxThreads + mRetiredThreads;
+    if (ioctl(mDriverFD, BINDER_SET_MAX_THREADS, &kernelMaxThreads) == -1) {
+        ALOGE("Binder ioctl to set max threads failed: %s", strerror(errno));
+    }
+    pthread_mutex_unlock(&mThreadCountLock);
+}
+
 size_t ProcessState::getThreadPoolMaxThreadCount() const {
     // may actually be one more than this, if join is called
     if (mThreadPoolStarted) return mMaxThreads;
@@ -376,6 +410,26 @@ status_t ProcessState::enableOnewaySpamDetection(bool enable) {
     return NO_ERROR;
 }
 
+void ProcessState::setBinderStatsEnabled(bool enable) {
+    BinderStats::setEnabled(enable);
+}
+
+void ProcessState::setCpuAttribution(CpuAttributionFn tagThread) {
+    BinderCpuAttribution::setTagThread(tagThread);
+}
+
+std::vector<ProcessState::CpuAttributionKey> ProcessState::getCpuAttributionKeys() {
+    return BinderCpuAttribution::getKeys();
+}
+
+ProcessState::BufferStats ProcessState::getBufferStats() {
+    return BinderBufferTracker::getStats();
+}
+
+void ProcessState::setBufferWarningThreshold(size_t bytes) {
+    BinderBufferTracker::setWarningThreshold(bytes);
+}
+
 void ProcessState::giveThreadPoolName() {
     androidSetThreadName( makeBinderThreadName().string() );
 }
@@ -427,6 +481,9 @@ ProcessState::ProcessState(const char *driver)
     , mWaitingForThreads(0)
     , mMaxThreads(DEFAULT_MAX_BINDER_THREADS)
     , mStarvationStartTimeMs(0)
+    , mSpawnedThreads(0)
+    , mRetiredThreads(0)
+    , mIdleTimeoutMs(0)
     , mThreadPoolStarted(false)
     , mThreadPoolSeq(1)
     , mCallRestriction(CallRestriction::NONE)
@@ -446,6 +503,10 @@ ProcessState::ProcessState(const char *driver)
             close(mDriverFD);
             mDriverFD = -1;
             mDriverName.clear();
+        } else {
+            // By then, there is no space left for oneway transactions, which
+            // the kernel limits to half of the buffer.
+            BinderBufferTracker::setWarningThreshold(BINDER_VM_SIZE / 2);
         }
     }
 
@@ -16,6 +16,8 @@
 
 #define LOG_TAG "RpcServer"
 
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 
@@ -109,6 +111,15 @@ size_t RpcServer::getMaxThreads() {
     return mMaxThreads;
 }
 
+void RpcServer::setPollingThreads(size_t threads) {
+    LOG_ALWAYS_FATAL_IF(mJoinThreadRunning, "Cannot set polling threads while running");
+    mPollingThreads = threads;
+}
+
+size_t RpcServer::getPollingThreads() {
+    return mPollingThreads;
+}
+
 void RpcServer::setRootObject(const sp<IBinder>& binder) {
     std::lock_guard<std::mutex> _l(mLock);
     mRootObjectWeak = mRootObject = binder;
@@ -151,6 +162,10 @@ void RpcServer::join() {
         LOG_ALWAYS_FATAL_IF(mShutdownTrigger == nullptr, "Cannot create join signaler");
     }
 
+    if (mPollingThreads > 0) {
+        LOG_ALWAYS_FATAL_IF(!startPolling(), "Cannot start polling threads");
+    }
+
     status_t status;
     while ((status = mShutdownTrigger->triggerablePollRead(mServer)) == OK) {
         unique_fd clientFd(TEMP_FAILURE_RETRY(
@@ -172,6 +187,10 @@ void RpcServer::join() {
     }
     LOG_RPC_DETAIL("RpcServer::join exiting with %s", statusToString(status).c_str());
 
+    if (mPollingThreads > 0) {
+        stopPolling();
+    }
+
     {
         std::lock_guard<std::mutex> _l(mLock);
         mJoinThreadRunning = false;
@@ -250,6 +269,18 @@ void RpcServer::establishConnection(sp<RpcServer>&& server, base::unique_fd clie
     }
     bool reverse = header.options & RPC_CONNECTION_OPTION_REVERSE;
 
+    bool shmem = false;
+    if (idValid && (header.options & RPC_CONNECTION_OPTION_SHMEM)) {
+        sockaddr_storage addr;
+        socklen_t addrLen = sizeof(addr);
+        if (0 == getsockname(clientFd.get(), reinterpret_cast<sockaddr*>(&addr), &addrLen) &&
+            addr.ss_family == AF_UNIX) {
+            shmem = true;
+        } else {
+            ALOGW("Client requested shmem, but it is only supported over unix domain sockets");
+        }
+    }
+
     std::thread thisThread;
     sp<RpcSession> session;
     {
@@ -292,6 +323,7 @@ void RpcServer::establishConnection(sp<RpcServer>&& server, base::unique_fd clie
 
             session = RpcSession::make();
             session->setMaxThreads(server->mMaxThreads);
+            session->mShmemReceive = shmem;
             if (!session->setForServer(server,
                                        sp<RpcServer::EventListener>::fromExisting(
                                                static_cast<RpcServer::EventListener*>(
@@ -318,18 +350,291 @@ void RpcServer::establishConnection(sp<RpcServer>&& server, base::unique_fd clie
             return;
         }
 
-        detachGuard.Disable();
-        session->preJoinThreadOwnership(std::move(thisThread));
+        if (server->mPollingThreads == 0) {
+            detachGuard.Disable();
+            session->preJoinThreadOwnership(std::move(thisThread));
+        }
     }
 
     auto setupResult = session->preJoinSetup(std::move(clientFd));
 
+    if (server->mPollingThreads > 0) {
+        server->addPolledConnection(std::move(session), std::move(setupResult));
+        return;
+    }
+
     // avoid strong cycle
     server = nullptr;
 
     RpcSession::join(std::move(session), std::move(setupResult));
 }
 
+bool RpcServer::startPolling() {
+    std::lock_guard<std::mutex> _l(mPollLock);
+    LOG_ALWAYS_FATAL_IF(mPolling, "Already polling");
+
+    mEpoll.reset(epoll_create1(EPOLL_CLOEXEC));
+    if (!mEpoll.ok()) {
+        ALOGE("Could not create epoll fd: %s", strerror(errno));
+        return false;
+    }
+    mPollStop.reset(eventfd(0, EFD_CLOEXEC));
+    if (!mPollStop.ok()) {
+        ALOGE("Could not create eventfd: %s", strerror(errno));
+        return false;
+    }
+    epoll_event event{.events = EPOLLIN, .data = {.u64 = 0}};
+    if (0 != epoll_ctl(mEpoll.get(), EPOLL_CTL_ADD, mPollStop.get(), &event)) {
+        ALOGE("Could not add eventfd to epoll: %s", strerror(errno));
+        return false;
+    }
+
+    mPolling = true;
+    for (size_t i = 0; i < mPollingThreads; i++) {
+        mPollThreads.push_back(std::thread(&RpcServer::pollLoop, this));
+    }
+    return true;
+}
+
+void RpcServer::stopPolling() {
+    std::unique_lock<std::mutex> _l(mPollLock);
+
+    // shutdown triggers every session, and polling threads drop the
+    // connections of triggered sessions
+    while (!mPolled.empty()) {
+        if (std::cv_status::timeout == mPollCv.wait_for(_l, std::chrono::seconds(1))) {
+            ALOGE("Waiting for RpcServer polling threads to drop connections (1s w/o progress). "
+                  "Connections: %zu",
+                  mPolled.size());
+        }
+    }
+    mPolling = false;
+
+    uint64_t one = 1;
+    LOG_ALWAYS_FATAL_IF(sizeof(one) != TEMP_FAILURE_RETRY(write(mPollStop.get(), &one, sizeof(one))),
+                        "Could not stop polling threads: %s", strerror(errno));
+
+    std::vector<std::thread> threads = std::move(mPollThreads);
+    _l.unlock();
+    for (auto& thread : threads) thread.join();
+    _l.lock();
+
+    mPollStop.reset();
+    mEpoll.reset();
+}
+
+void RpcServer::pollLoop() {
+    while (true) {
+        // one at a time, so that ready connections are spread over threads
+        epoll_event event;
+        int ret = TEMP_FAILURE_RETRY(epoll_wait(mEpoll.get(), &event, 1, -1));
+        if (ret < 0) {
+            ALOGE("epoll_wait failed, polling thread exiting: %s", strerror(errno));
+            return;
+        }
+        if (ret == 0) continue;
+
+        if (event.data.u64 == 0) {
+            LOG_RPC_DETAIL("Polling thread exiting");
+            return;
+        }
+        processPollEvent(event.data.u64);
+    }
+}
+
+RpcServer::PolledConnection RpcServer::forgetPolledLocked(
+        std::map<uint64_t, PolledConnection>::iterator it) {
+    PolledConnection polled = std::move(it->second);
+    mPolled.erase(it);
+    mPollCv.notify_all();
+
+    base::borrowed_fd fd = polled.connection != nullptr ? polled.connection->fd
+                                                        : polled.session->mShutdownTrigger->pollFd();
+    // for busy connections, the connection is disarmed but still registered
+    if (0 != epoll_ctl(mEpoll.get(), EPOLL_CTL_DEL, fd.get(), nullptr)) {
+        ALOGE("Could not remove fd %d from epoll: %s", fd.get(), strerror(errno));
+    }
+
+    auto session = mPolledSessions.find(polled.session.get());
+    LOG_ALWAYS_FATAL_IF(session == mPolledSessions.end(), "Polled session unknown");
+    if (polled.connection == nullptr) {
+        session->second.triggerKey = 0;
+    } else {
+        session->second.numConnections--;
+    }
+
+    if (session->second.numConnections == 0) {
+        // also stop waiting on the trigger of a session which has no
+        // connections left
+        if (session->second.triggerKey != 0) {
+            (void)epoll_ctl(mEpoll.get(), EPOLL_CTL_DEL,
+                            polled.session->mShutdownTrigger->pollFd().get(), nullptr);
+            mPolled.erase(session->second.triggerKey);
+        }
+        mPolledSessions.erase(session);
+    }
+
+    return polled;
+}
+
+void RpcServer::processPollEvent(uint64_t key) {
+    PolledConnection polled;
+    std::vector<PolledConnection> ended;
+    {
+        std::lock_guard<std::mutex> _l(mPollLock);
+        auto it = mPolled.find(key);
+        // already dropped by another thread
+        if (it == mPolled.end()) return;
+
+        if (it->second.connection == nullptr) {
+            // The session is shutting down. Busy connections are dropped when
+            // their thread finishes a command.
+            sp<RpcSession> session = it->second.session;
+            (void)forgetPolledLocked(it);
+            for (auto jt = mPolled.begin(); jt != mPolled.end();) {
+                if (jt->second.session == session && jt->second.connection != nullptr &&
+                    !jt->second.busy) {
+                    ended.push_back(forgetPolledLocked(jt++));
+                } else {
+                    jt++;
+                }
+            }
+        } else {
+            it->second.busy = true;
+            polled = it->second;
+        }
+    }
+
+    for (const auto& end : ended) {
+        endPolledConnection(end.session, end.connection);
+    }
+    if (polled.connection == nullptr) return;
+
+    {
+        std::lock_guard<std::mutex> _l(polled.session->mMutex);
+        polled.connection->exclusiveTid = gettid();
+    }
+    status_t status = polled.session->state()->getAndExecuteCommand(polled.connection,
+                                                                    polled.session,
+                                                                    RpcState::CommandType::ANY);
+    {
+        std::lock_guard<std::mutex> _l(polled.session->mMutex);
+        polled.connection->exclusiveTid = std::nullopt;
+    }
+
+    bool keep = status == OK && !polled.session->mShutdownTrigger->isTriggered();
+    if (!keep) {
+        LOG_RPC_DETAIL("Polled binder connection closing w/ status %s",
+                       statusToString(status).c_str());
+    }
+
+    {
+        std::lock_guard<std::mutex> _l(mPollLock);
+        auto it = mPolled.find(key);
+        LOG_ALWAYS_FATAL_IF(it == mPolled.end(), "Busy connection dropped");
+
+        if (keep) {
+            it->second.busy = false;
+            epoll_event event{.events = EPOLLIN | EPOLLONESHOT, .data = {.u64 = key}};
+            if (0 != epoll_ctl(mEpoll.get(), EPOLL_CTL_MOD, polled.connection->fd.get(), &event)) {
+                ALOGE("Could not re-arm fd %d in epoll: %s", polled.connection->fd.get(),
+                      strerror(errno));
+                keep = false;
+            }
+        }
+        if (!keep) {
+            (void)forgetPolledLocked(it);
+        }
+    }
+
+    if (!keep) {
+        endPolledConnection(polled.session, polled.connection);
+    }
+}
+
+void RpcServer::addPolledConnection(sp<RpcSession>&& session,
+                                    RpcSession::PreJoinSetupResult&& setupResult) {
+    sp<RpcSession::RpcConnection>& connection = setupResult.connection;
+
+    if (setupResult.status != OK) {
+        ALOGE("Connection failed to init, closing with status %s",
+              statusToString(setupResult.status).c_str());
+        endPolledConnection(session, connection);
+        return;
+    }
+
+    // owned by whichever polling thread processes a command next
+    {
+        std::lock_guard<std::mutex> _l(session->mMutex);
+        connection->exclusiveTid = std::nullopt;
+    }
+
+    {
+        std::lock_guard<std::mutex> _l(mPollLock);
+        if (mPolling) {
+            auto [polledSession, inserted] = mPolledSessions.insert({session.get(), {}});
+            if (inserted) {
+                uint64_t triggerKey = mNextPollKey++;
+                epoll_event event{.events = EPOLLIN, .data = {.u64 = triggerKey}};
+                if (0 ==
+                    epoll_ctl(mEpoll.get(), EPOLL_CTL_ADD,
+                              session->mShutdownTrigger->pollFd().get(), &event)) {
+                    polledSession->second.triggerKey = triggerKey;
+                    mPolled[triggerKey] = PolledConnection{.session = session};
+                } else {
+                    ALOGE("Could not add session trigger to epoll: %s", strerror(errno));
+                }
+            }
+
+            // sessions are only polled with their trigger
+            if (polledSession->second.triggerKey != 0) {
+                uint64_t key = mNextPollKey++;
+                mPolled[key] = PolledConnection{.session = session, .connection = connection};
+                polledSession->second.numConnections++;
+
+                epoll_event event{.events = EPOLLIN | EPOLLONESHOT, .data = {.u64 = key}};
+                if (0 == epoll_ctl(mEpoll.get(), EPOLL_CTL_ADD, connection->fd.get(), &event)) {
+                    return;
+                }
+                ALOGE("Could not add connection fd %d to epoll: %s", connection->fd.get(),
+                      strerror(errno));
+
+                // forgetPolledLocked can't remove the fd, it was never added
+                mPolled.erase(key);
+                polledSession->second.numConnections--;
+            }
+
+            if (polledSession->second.numConnections == 0) {
+                if (uint64_t triggerKey = polledSession->second.triggerKey; triggerKey != 0) {
+                    (void)epoll_ctl(mEpoll.get(), EPOLL_CTL_DEL,
+                                    session->mShutdownTrigger->pollFd().get(), nullptr);
+                    mPolled.erase(triggerKey);
+                }
+                mPolledSessions.erase(polledSession);
+            }
+        } else {
+            ALOGE("RpcServer is no longer polling, dropping connection");
+        }
+    }
+
+    endPolledConnection(session, connection);
+}
+
+void RpcServer::endPolledConnection(const sp<RpcSession>& session,
+                                    const sp<RpcSession::RpcConnection>& connection) {
+    LOG_ALWAYS_FATAL_IF(!session->removeIncomingConnection(connection),
+                        "bad state: connection object guaranteed to be in list");
+
+    sp<RpcSession::EventListener> listener;
+    {
+        std::lock_guard<std::mutex> _l(session->mMutex);
+        listener = session->mEventListener.promote();
+    }
+    if (listener != nullptr) {
+        listener->onSessionIncomingThreadEnded();
+    }
+}
+
 bool RpcServer::setupSocketServer(const RpcSocketAddress& addr) {
     LOG_RPC_DETAIL("Setting up socket server %s", addr.toString().c_str());
     LOG_ALWAYS_FATAL_IF(hasServer(), "Each RpcServer can only have one server.");
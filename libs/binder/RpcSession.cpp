@@ -20,8 +20,10 @@
 
 #include <inttypes.h>
 #include <poll.h>
+#include <sys/socket.h>
 #include <unistd.h>
 
+#include <chrono>
 #include <string_view>
 
 #include <android-base/macros.h>
@@ -73,6 +75,19 @@ size_t RpcSession::getMaxThreads() {
     return mMaxThreads;
 }
 
+void RpcSession::setOnewayBatching(bool enabled) {
+    mOnewayBatching = enabled;
+}
+
+void RpcSession::setShmemThreshold(size_t bytes) {
+    std::lock_guard<std::mutex> _l(mMutex);
+    LOG_ALWAYS_FATAL_IF(!mOutgoingConnections.empty() || !mIncomingConnections.empty(),
+                        "Must set shmem threshold before setting up connections, but has %zu "
+                        "client(s) and %zu server(s)",
+                        mOutgoingConnections.size(), mIncomingConnections.size());
+    mShmemThreshold = bytes;
+}
+
 bool RpcSession::setupUnixDomainClient(const char* path) {
     return setupSocketClient(UnixSocketAddress(path));
 }
@@ -119,6 +134,15 @@ status_t RpcSession::getRemoteMaxThreads(size_t* maxThreads) {
     return state()->getMaxThreads(connection.get(), sp<RpcSession>::fromExisting(this), maxThreads);
 }
 
+RpcSession::ConnectionStats RpcSession::getConnectionStats() {
+    std::lock_guard<std::mutex> _l(mMutex);
+    ConnectionStats stats = mConnectionStats;
+    stats.outgoingConnections = mOutgoingConnections.size();
+    stats.maxOutgoingConnections = std::max(mMaxOutgoingConnections, mOutgoingConnections.size());
+    stats.waitingThreads = mWaitingThreads;
+    return stats;
+}
+
 bool RpcSession::shutdownAndWait(bool wait) {
     std::unique_lock<std::mutex> _l(mMutex);
     LOG_ALWAYS_FATAL_IF(mShutdownTrigger == nullptr, "Shutdown trigger not installed");
@@ -139,6 +163,11 @@ bool RpcSession::shutdownAndWait(bool wait) {
 
 status_t RpcSession::transact(const sp<IBinder>& binder, uint32_t code, const Parcel& data,
                               Parcel* reply, uint32_t flags) {
+    if ((flags & IBinder::FLAG_ONEWAY) && mOnewayBatching) {
+        return state()->transactOnewayBatched(binder, code, data,
+                                              sp<RpcSession>::fromExisting(this), flags);
+    }
+
     ExclusiveConnection connection;
     status_t status =
             ExclusiveConnection::find(sp<RpcSession>::fromExisting(this),
@@ -194,22 +223,57 @@ status_t RpcSession::FdTrigger::triggerablePollRead(base::borrowed_fd fd) {
 }
 
 status_t RpcSession::FdTrigger::interruptableReadFully(base::borrowed_fd fd, void* data,
-                                                       size_t size) {
+                                                       size_t size,
+                                                       std::atomic<size_t>* syscallCount,
+                                                       base::unique_fd* fdOut) {
     uint8_t* buffer = reinterpret_cast<uint8_t*>(data);
     uint8_t* end = buffer + size;
 
-    status_t status;
-    while ((status = triggerablePollRead(fd)) == OK) {
-        ssize_t readSize = TEMP_FAILURE_RETRY(recv(fd.get(), buffer, end - buffer, MSG_NOSIGNAL));
+    auto countSyscall = [&]() {
+        if (syscallCount != nullptr) syscallCount->fetch_add(1, std::memory_order_relaxed);
+    };
+
+    while (true) {
+        countSyscall();
+        if (status_t status = triggerablePollRead(fd); status != OK) return status;
+
+        countSyscall();
+        iovec iov{buffer, static_cast<size_t>(end - buffer)};
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+        msghdr msg{
+                .msg_iov = &iov,
+                .msg_iovlen = 1,
+                .msg_control = fdOut != nullptr ? control : nullptr,
+                .msg_controllen = fdOut != nullptr ? sizeof(control) : 0,
+        };
+        ssize_t readSize =
+                TEMP_FAILURE_RETRY(recvmsg(fd.get(), &msg, MSG_NOSIGNAL | MSG_CMSG_CLOEXEC));
         if (readSize == 0) return DEAD_OBJECT; // EOF
 
         if (readSize < 0) {
             return -errno;
         }
+
+        if (fdOut != nullptr) {
+            for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+                 cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+                if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) continue;
+                size_t numFds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                for (size_t i = 0; i < numFds; i++) {
+                    int received;
+                    memcpy(&received, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+                    base::unique_fd owned(received);
+                    if (!fdOut->ok()) *fdOut = std::move(owned);
+                }
+            }
+            if (msg.msg_flags & MSG_CTRUNC) {
+                ALOGE("Too many fds attached to RPC data, closing extra fds");
+            }
+        }
+
         buffer += readSize;
         if (buffer == end) return OK;
     }
-    return status;
 }
 
 status_t RpcSession::readId() {
@@ -232,6 +296,22 @@ status_t RpcSession::readId() {
     return OK;
 }
 
+status_t RpcSession::negotiateShmem() {
+    ExclusiveConnection connection;
+    status_t status = ExclusiveConnection::find(sp<RpcSession>::fromExisting(this),
+                                                ConnectionUse::CLIENT, &connection);
+    if (status != OK) return status;
+
+    bool accepted = false;
+    status = state()->negotiateShmem(connection.get(), sp<RpcSession>::fromExisting(this),
+                                     mShmemThreshold, &accepted);
+    if (status != OK) return status;
+
+    if (accepted) mShmemSendThreshold = mShmemThreshold;
+    LOG_RPC_DETAIL("RpcSession %p shmem accepted: %d", this, accepted);
+    return OK;
+}
+
 void RpcSession::WaitForShutdownListener::onSessionLockedAllIncomingThreadsEnded(
         const sp<RpcSession>& session) {
     (void)session;
@@ -326,12 +406,13 @@ bool RpcSession::setupSocketClient(const RpcSocketAddress& addr) {
         LOG_ALWAYS_FATAL_IF(mOutgoingConnections.size() != 0,
                             "Must only setup session once, but already has %zu clients",
                             mOutgoingConnections.size());
+
+        // fds can only be passed over unix domain sockets
+        mShmemReceive = mShmemThreshold > 0 && addr.addr()->sa_family == AF_UNIX;
     }
 
     if (!setupOneSocketConnection(addr, RpcAddress::zero(), false /*reverse*/)) return false;
 
-    // TODO(b/189955605): we should add additional sessions dynamically
-    // instead of all at once.
     // TODO(b/186470974): first risk of blocking
     size_t numThreadsAvailable;
     if (status_t status = getRemoteMaxThreads(&numThreadsAvailable); status != OK) {
@@ -346,10 +427,20 @@ bool RpcSession::setupSocketClient(const RpcSocketAddress& addr) {
         return false;
     }
 
-    // we've already setup one client
-    for (size_t i = 0; i + 1 < numThreadsAvailable; i++) {
-        // TODO(b/189955605): shutdown existing connections?
-        if (!setupOneSocketConnection(addr, mId.value(), false /*reverse*/)) return false;
+    if (mShmemReceive) {
+        if (status_t status = negotiateShmem(); status != OK) {
+            ALOGE("Could not negotiate shmem after initial session to %s: %s",
+                  addr.toString().c_str(), statusToString(status).c_str());
+            return false;
+        }
+    }
+
+    // We've already setup one client. Others are opened by
+    // ExclusiveConnection::find when all of them are busy.
+    {
+        std::lock_guard<std::mutex> _l(mMutex);
+        mAddress = std::make_unique<StoredSocketAddress>(addr);
+        mMaxOutgoingConnections = numThreadsAvailable;
     }
 
     // TODO(b/189955605): we should add additional sessions dynamically
@@ -394,6 +485,7 @@ bool RpcSession::setupOneSocketConnection(const RpcSocketAddress& addr, const Rp
         memcpy(&header.sessionId, &id.viewRawEmbedded(), sizeof(RpcWireAddress));
 
         if (reverse) header.options |= RPC_CONNECTION_OPTION_REVERSE;
+        if (mShmemReceive) header.options |= RPC_CONNECTION_OPTION_SHMEM;
 
         if (sizeof(header) != TEMP_FAILURE_RETRY(write(serverFd.get(), &header, sizeof(header)))) {
             int savedErrno = errno;
@@ -524,6 +616,9 @@ status_t RpcSession::ExclusiveConnection::find(const sp<RpcSession>& session, Co
     pid_t tid = gettid();
     std::unique_lock<std::mutex> _l(session->mMutex);
 
+    std::optional<std::chrono::steady_clock::time_point> waitStart;
+    bool waited = false;
+
     session->mWaitingThreads++;
     while (true) {
         sp<RpcConnection> exclusive;
@@ -532,8 +627,7 @@ status_t RpcSession::ExclusiveConnection::find(const sp<RpcSession>& session, Co
         // CHECK FOR DEDICATED CLIENT SOCKET
         //
         // A server/looper should always use a dedicated connection if available
-        findConnection(tid, &exclusive, &available, session->mOutgoingConnections,
-                       session->mOutgoingConnectionsOffset);
+        findConnection(tid, &exclusive, &available, session->mOutgoingConnections);
 
         // WARNING: this assumes a server cannot request its client to send
         // a transaction, as mIncomingConnections is excluded below.
@@ -543,19 +637,15 @@ status_t RpcSession::ExclusiveConnection::find(const sp<RpcSession>& session, Co
         // asynchronous command is sent on the first client connection. Then, if
         // we naively send a synchronous command to that same connection, the
         // thread on the far side might be busy processing the asynchronous
-        // command. So, we move to considering the second available thread
-        // for subsequent calls.
-        if (use == ConnectionUse::CLIENT_ASYNC && (exclusive != nullptr || available != nullptr)) {
-            session->mOutgoingConnectionsOffset = (session->mOutgoingConnectionsOffset + 1) %
-                    session->mOutgoingConnections.size();
-        }
+        // command. Taking the least recently used connection means subsequent
+        // calls consider the other connections first.
 
         // USE SERVING SOCKET (e.g. nested transaction)
         if (use != ConnectionUse::CLIENT_ASYNC) {
             sp<RpcConnection> exclusiveIncoming;
             // server connections are always assigned to a thread
             findConnection(tid, &exclusiveIncoming, nullptr /*available*/,
-                           session->mIncomingConnections, 0 /* index hint */);
+                           session->mIncomingConnections);
 
             // asynchronous calls cannot be nested, we currently allow ref count
             // calls to be nested (so that you can use this without having extra
@@ -581,6 +671,7 @@ status_t RpcSession::ExclusiveConnection::find(const sp<RpcSession>& session, Co
         } else if (available != nullptr) {
             connection->mConnection = available;
             connection->mConnection->exclusiveTid = tid;
+            connection->mConnection->lastUse = ++session->mConnectionUses;
             break;
         }
 
@@ -589,32 +680,66 @@ status_t RpcSession::ExclusiveConnection::find(const sp<RpcSession>& session, Co
                   "any non-nested (e.g. oneway or on another thread) calls. Use: %d. Server "
                   "connections: %zu",
                   static_cast<int>(use), session->mIncomingConnections.size());
+            session->mWaitingThreads--;
             return WOULD_BLOCK;
         }
 
+        if (!waitStart.has_value()) waitStart = std::chrono::steady_clock::now();
+
+        // All connections are busy, but the server has threads for more.
+        if (session->mAddress != nullptr && session->mId.has_value() &&
+            session->mOutgoingConnections.size() + session->mConnectingOutgoing <
+                    session->mMaxOutgoingConnections) {
+            session->mConnectingOutgoing++;
+            _l.unlock();
+            bool added = session->setupOneSocketConnection(*session->mAddress,
+                                                           session->mId.value(),
+                                                           false /*reverse*/);
+            _l.lock();
+            session->mConnectingOutgoing--;
+            if (!added) {
+                ALOGW("Could not add connection to %s, continuing with %zu connection(s)",
+                      session->mAddress->toString().c_str(), session->mOutgoingConnections.size());
+                session->mMaxOutgoingConnections = session->mOutgoingConnections.size();
+            }
+            // Another thread might take the new connection first. Either way,
+            // look again.
+            continue;
+        }
+
         LOG_RPC_DETAIL("No available connections (have %zu clients and %zu servers). Waiting...",
                        session->mOutgoingConnections.size(), session->mIncomingConnections.size());
+        waited = true;
         session->mAvailableConnectionCv.wait(_l);
     }
     session->mWaitingThreads--;
 
+    if (!connection->mReentrant) {
+        ConnectionStats& stats = session->mConnectionStats;
+        stats.acquisitions++;
+        if (waited) stats.waits++;
+        if (waitStart.has_value()) {
+            uint64_t waitNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                      std::chrono::steady_clock::now() - *waitStart)
+                                      .count();
+            stats.totalWaitNs += waitNs;
+            stats.maxWaitNs = std::max(stats.maxWaitNs, waitNs);
+        }
+    }
+
     return OK;
 }
 
 void RpcSession::ExclusiveConnection::findConnection(pid_t tid, sp<RpcConnection>* exclusive,
                                                      sp<RpcConnection>* available,
-                                                     std::vector<sp<RpcConnection>>& sockets,
-                                                     size_t socketsIndexHint) {
-    LOG_ALWAYS_FATAL_IF(sockets.size() > 0 && socketsIndexHint >= sockets.size(),
-                        "Bad index %zu >= %zu", socketsIndexHint, sockets.size());
-
+                                                     std::vector<sp<RpcConnection>>& sockets) {
     if (*exclusive != nullptr) return; // consistent with break below
 
-    for (size_t i = 0; i < sockets.size(); i++) {
-        sp<RpcConnection>& socket = sockets[(i + socketsIndexHint) % sockets.size()];
-
-        // take first available connection (intuition = caching)
-        if (available && *available == nullptr && socket->exclusiveTid == std::nullopt) {
+    for (sp<RpcConnection>& socket : sockets) {
+        // take the least recently used available connection, to spread load
+        // over the threads of the other side
+        if (available && socket->exclusiveTid == std::nullopt &&
+            (*available == nullptr || socket->lastUse < (*available)->lastUse)) {
             *available = socket;
             continue;
         }
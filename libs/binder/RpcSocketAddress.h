@@ -113,4 +113,23 @@ private:
     unsigned int mPort;
 };
 
+// Copy of another address, e.g. to connect to it again later. The addresses
+// above may point to memory owned by the caller.
+class StoredSocketAddress : public RpcSocketAddress {
+public:
+    explicit StoredSocketAddress(const RpcSocketAddress& other)
+          : mAddr(), mSize(other.addrSize()), mName(other.toString()) {
+        LOG_ALWAYS_FATAL_IF(mSize > sizeof(mAddr), "Socket address is too long: %zu", mSize);
+        memcpy(&mAddr, other.addr(), mSize);
+    }
+    std::string toString() const override { return mName; }
+    const sockaddr* addr() const override { return reinterpret_cast<const sockaddr*>(&mAddr); }
+    size_t addrSize() const override { return mSize; }
+
+private:
+    sockaddr_storage mAddr;
+    size_t mSize;
+    std::string mName;
+};
+
 } // namespace android
@@ -18,6 +18,7 @@
 
 #include "RpcState.h"
 
+#include <android-base/macros.h>
 #include <android-base/scopeguard.h>
 #include <binder/BpBinder.h>
 #include <binder/IPCThreadState.h>
@@ -26,7 +27,13 @@
 #include "Debug.h"
 #include "RpcWireFormat.h"
 
+#include <fcntl.h>
 #include <inttypes.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace android {
 
@@ -165,10 +172,19 @@ size_t RpcState::countBinders() {
 }
 
 void RpcState::dump() {
+    // mOnewayQueue.mutex must not be taken after mNodeMutex
+    OnewayQueueStats stats = getOnewayQueueStats();
+    ALOGE("ONEWAY QUEUE OF RpcState %p: depth: %zu max depth: %zu transactions: %zu writes: %zu",
+          this, stats.depth, stats.maxDepth, stats.transactions, stats.writes);
+
     std::lock_guard<std::mutex> _l(mNodeMutex);
     dumpLocked();
 }
 
+size_t RpcState::countSyscalls() {
+    return mSyscallCount.load(std::memory_order_relaxed);
+}
+
 void RpcState::clear() {
     std::unique_lock<std::mutex> _l(mNodeMutex);
 
@@ -229,11 +245,12 @@ void RpcState::dumpLocked() {
               node.binder.unsafe_get(), node.timesSent, node.timesRecd, address.toString().c_str(),
               desc);
     }
+    mCommandDataPool.dump();
     ALOGE("END DUMP OF RpcState");
 }
 
 
-RpcState::CommandData::CommandData(size_t size) : mSize(size) {
+RpcState::CommandData::CommandData(RpcState* state, size_t size) : mSize(size) {
     // The maximum size for regular binder is 1MB for all concurrent
     // transactions. A very small proportion of transactions are even
     // larger than a page, but we need to avoid allocating too much
@@ -251,30 +268,209 @@ RpcState::CommandData::CommandData(size_t size) : mSize(size) {
         ALOGW("Transaction requested too much data allocation %zu", size);
         return;
     }
-    mData.reset(new (std::nothrow) uint8_t[size]);
+
+    size_t capacity;
+    uint8_t* buffer = state->mCommandDataPool.take(size, &capacity);
+    if (buffer == nullptr) return;
+    mData = std::unique_ptr<uint8_t[], Deleter>(buffer,
+                                                Deleter{
+                                                        .pool = &state->mCommandDataPool,
+                                                        .capacity = capacity,
+                                                });
+}
+
+RpcState::CommandData::CommandData(void* mapping, size_t mappingSize, uint8_t* data, size_t size)
+      : mData(data, Deleter{.mapping = mapping, .mappingSize = mappingSize}), mSize(size) {}
+
+uint8_t* RpcState::CommandData::release() {
+    if (mData != nullptr && mData.get_deleter().pool != nullptr) {
+        mData.get_deleter().pool->onReleased(mData.get_deleter().capacity);
+    }
+    return mData.release();
+}
+
+void RpcState::CommandData::Deleter::operator()(uint8_t* buffer) const {
+    if (mapping != nullptr) {
+        if (0 != munmap(mapping, mappingSize)) {
+            ALOGE("Failed to unmap shmem body: %s", strerror(errno));
+        }
+        return;
+    }
+    pool->give(buffer, capacity);
+}
+
+size_t RpcState::CommandDataPool::classFor(size_t size) {
+    if (size > capacityFor(kNumClasses - 1)) return kNumClasses;
+    size_t sizeClass = 0;
+    while (capacityFor(sizeClass) < size) sizeClass++;
+    return sizeClass;
+}
+
+uint8_t* RpcState::CommandDataPool::take(size_t size, size_t* capacityOut) {
+    size_t sizeClass = classFor(size);
+
+    std::unique_lock<std::mutex> _l(mMutex);
+    mTakes++;
+
+    if (sizeClass == kNumClasses) {
+        mUnpooled++;
+        _l.unlock();
+        *capacityOut = size;
+        return new (std::nothrow) uint8_t[size];
+    }
+
+    SizeClass& c = mClasses[sizeClass];
+    c.outstanding++;
+    c.peakOutstanding = std::max(c.peakOutstanding, c.outstanding);
+    if (++mWindowTakes >= kWindow) endWindowLocked();
+
+    *capacityOut = capacityFor(sizeClass);
+
+    if (!c.free.empty()) {
+        mHits++;
+        uint8_t* buffer = c.free.back().release();
+        c.free.pop_back();
+        return buffer;
+    }
+
+    _l.unlock();
+    uint8_t* buffer = new (std::nothrow) uint8_t[*capacityOut];
+    if (buffer == nullptr) {
+        _l.lock();
+        c.outstanding--;
+    }
+    return buffer;
+}
+
+void RpcState::CommandDataPool::give(uint8_t* buffer, size_t capacity) {
+    std::unique_ptr<uint8_t[]> toFree(buffer);
+
+    size_t sizeClass = classFor(capacity);
+    if (sizeClass == kNumClasses) return;
+    LOG_ALWAYS_FATAL_IF(capacity != capacityFor(sizeClass), "Bad pooled capacity %zu", capacity);
+
+    std::lock_guard<std::mutex> _l(mMutex);
+    SizeClass& c = mClasses[sizeClass];
+    LOG_ALWAYS_FATAL_IF(c.outstanding == 0, "Returning unknown buffer of capacity %zu", capacity);
+    c.outstanding--;
+
+    if (c.free.size() < c.retainLimit) {
+        c.free.push_back(std::move(toFree));
+    } else {
+        mTrimmed++;
+    }
+}
+
+void RpcState::CommandDataPool::onReleased(size_t capacity) {
+    size_t sizeClass = classFor(capacity);
+    std::lock_guard<std::mutex> _l(mMutex);
+    mReleased++;
+    if (sizeClass == kNumClasses) return;
+
+    SizeClass& c = mClasses[sizeClass];
+    LOG_ALWAYS_FATAL_IF(c.outstanding == 0, "Releasing unknown buffer of capacity %zu", capacity);
+    c.outstanding--;
+}
+
+void RpcState::CommandDataPool::endWindowLocked() {
+    for (SizeClass& c : mClasses) {
+        c.retainLimit = std::min(kMaxRetainedPerClass, c.peakOutstanding);
+        while (c.free.size() > c.retainLimit) {
+            c.free.pop_back();
+            mTrimmed++;
+        }
+        c.peakOutstanding = c.outstanding;
+    }
+    mWindowTakes = 0;
+}
+
+void RpcState::CommandDataPool::dump() {
+    std::lock_guard<std::mutex> _l(mMutex);
+
+    size_t pooledBytes = 0;
+    for (size_t i = 0; i < kNumClasses; i++) {
+        pooledBytes += mClasses[i].free.size() * capacityFor(i);
+    }
+    ALOGE("COMMAND DATA POOL: takes: %zu hits: %zu unpooled: %zu trimmed: %zu released: %zu "
+          "pooled bytes: %zu",
+          mTakes, mHits, mUnpooled, mTrimmed, mReleased, pooledBytes);
+    for (size_t i = 0; i < kNumClasses; i++) {
+        const SizeClass& c = mClasses[i];
+        if (c.free.empty() && c.outstanding == 0) continue;
+        ALOGE("- SIZE CLASS %zu: free: %zu outstanding: %zu retain limit: %zu", capacityFor(i),
+              c.free.size(), c.outstanding, c.retainLimit);
+    }
 }
 
 status_t RpcState::rpcSend(const sp<RpcSession::RpcConnection>& connection,
-                           const sp<RpcSession>& session, const char* what, const void* data,
-                           size_t size) {
-    LOG_RPC_DETAIL("Sending %s on fd %d: %s", what, connection->fd.get(),
-                   hexString(data, size).c_str());
+                           const sp<RpcSession>& session, const char* what, iovec* iovs,
+                           size_t niovs, int fdToSend) {
+    size_t size = 0;
+    for (size_t i = 0; i < niovs; i++) {
+        LOG_RPC_DETAIL("Sending %s (part %zu) on fd %d: %s", what, i, connection->fd.get(),
+                       hexString(iovs[i].iov_base, iovs[i].iov_len).c_str());
+
+        if (__builtin_add_overflow(size, iovs[i].iov_len, &size) ||
+            size > std::numeric_limits<ssize_t>::max()) {
+            ALOGE("Cannot send %s at size %zu (too big)", what, size);
+            (void)session->shutdownAndWait(false);
+            return BAD_VALUE;
+        }
+    }
 
-    if (size > std::numeric_limits<ssize_t>::max()) {
-        ALOGE("Cannot send %s at size %zu (too big)", what, size);
+    if (niovs > IOV_MAX) {
+        ALOGE("Cannot send %s in %zu parts (too many)", what, niovs);
         (void)session->shutdownAndWait(false);
         return BAD_VALUE;
     }
 
-    ssize_t sent = TEMP_FAILURE_RETRY(send(connection->fd.get(), data, size, MSG_NOSIGNAL));
+    // Stream sockets may accept only part of a message (e.g. for large
+    // payloads or if interrupted), so resume where the last call stopped
+    // instead of treating it as an error.
+    size_t sentTotal = 0;
+    while (sentTotal < size) {
+        msghdr msg{
+                .msg_iov = iovs,
+                .msg_iovlen = niovs,
+        };
+
+        // the fd goes along w/ the first byte sent only
+        alignas(cmsghdr) char cmsgBuf[CMSG_SPACE(sizeof(int))];
+        if (fdToSend >= 0 && sentTotal == 0) {
+            msg.msg_control = cmsgBuf;
+            msg.msg_controllen = sizeof(cmsgBuf);
+            cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+            cmsg->cmsg_level = SOL_SOCKET;
+            cmsg->cmsg_type = SCM_RIGHTS;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+            memcpy(CMSG_DATA(cmsg), &fdToSend, sizeof(int));
+        }
 
-    if (sent < 0 || sent != static_cast<ssize_t>(size)) {
-        int savedErrno = errno;
-        LOG_RPC_DETAIL("Failed to send %s (sent %zd of %zu bytes) on fd %d, error: %s", what, sent,
-                       size, connection->fd.get(), strerror(savedErrno));
+        mSyscallCount.fetch_add(1, std::memory_order_relaxed);
+        ssize_t sent = TEMP_FAILURE_RETRY(sendmsg(connection->fd.get(), &msg, MSG_NOSIGNAL));
 
-        (void)session->shutdownAndWait(false);
-        return -savedErrno;
+        if (sent <= 0) {
+            int savedErrno = sent < 0 ? errno : EPIPE;
+            LOG_RPC_DETAIL("Failed to send %s (sent %zu of %zu bytes) on fd %d, error: %s", what,
+                           sentTotal, size, connection->fd.get(), strerror(savedErrno));
+
+            (void)session->shutdownAndWait(false);
+            return -savedErrno;
+        }
+
+        sentTotal += sent;
+
+        // skip over everything that has been fully sent
+        size_t remaining = sent;
+        while (niovs > 0 && remaining >= iovs->iov_len) {
+            remaining -= iovs->iov_len;
+            iovs++;
+            niovs--;
+        }
+        if (niovs > 0) {
+            iovs->iov_base = reinterpret_cast<uint8_t*>(iovs->iov_base) + remaining;
+            iovs->iov_len -= remaining;
+        }
     }
 
     return OK;
@@ -282,19 +478,45 @@ status_t RpcState::rpcSend(const sp<RpcSession::RpcConnection>& connection,
 
 status_t RpcState::rpcRec(const sp<RpcSession::RpcConnection>& connection,
                           const sp<RpcSession>& session, const char* what, void* data,
-                          size_t size) {
+                          size_t size, bool expectPending, base::unique_fd* fdOut) {
     if (size > std::numeric_limits<ssize_t>::max()) {
         ALOGE("Cannot rec %s at size %zu (too big)", what, size);
         (void)session->shutdownAndWait(false);
         return BAD_VALUE;
     }
 
-    if (status_t status =
-                session->mShutdownTrigger->interruptableReadFully(connection->fd.get(), data, size);
-        status != OK) {
-        LOG_RPC_DETAIL("Failed to read %s (%zu bytes) on fd %d, error: %s", what, size,
-                       connection->fd.get(), statusToString(status).c_str());
-        return status;
+    uint8_t* buffer = reinterpret_cast<uint8_t*>(data);
+    size_t readSoFar = 0;
+    if (expectPending && fdOut == nullptr && size > 0 &&
+        !session->mShutdownTrigger->isTriggered()) {
+        mSyscallCount.fetch_add(1, std::memory_order_relaxed);
+        ssize_t readSize = TEMP_FAILURE_RETRY(
+                recv(connection->fd.get(), buffer, size, MSG_NOSIGNAL | MSG_DONTWAIT));
+        if (readSize == 0) {
+            LOG_RPC_DETAIL("Failed to read %s (%zu bytes) on fd %d, EOF", what, size,
+                           connection->fd.get());
+            return DEAD_OBJECT;
+        }
+        if (readSize < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            int savedErrno = errno;
+            LOG_RPC_DETAIL("Failed to read %s (%zu bytes) on fd %d, error: %s", what, size,
+                           connection->fd.get(), strerror(savedErrno));
+            return -savedErrno;
+        }
+        if (readSize > 0) readSoFar = readSize;
+    }
+
+    if (readSoFar < size) {
+        if (status_t status = session->mShutdownTrigger
+                                      ->interruptableReadFully(connection->fd.get(),
+                                                               buffer + readSoFar,
+                                                               size - readSoFar, &mSyscallCount,
+                                                               fdOut);
+            status != OK) {
+            LOG_RPC_DETAIL("Failed to read %s (%zu bytes) on fd %d, error: %s", what, size,
+                           connection->fd.get(), statusToString(status).c_str());
+            return status;
+        }
     }
 
     LOG_RPC_DETAIL("Received %s on fd %d: %s", what, connection->fd.get(),
@@ -302,12 +524,172 @@ status_t RpcState::rpcRec(const sp<RpcSession::RpcConnection>& connection,
     return OK;
 }
 
+status_t RpcState::rpcRecHeader(const sp<RpcSession::RpcConnection>& connection,
+                                const sp<RpcSession>& session, RpcWireHeader* command,
+                                base::unique_fd* shmemFdOut) {
+    // only sessions which negotiated shmem are expecting fds, so anything else
+    // still uses a plain read
+    return rpcRec(connection, session, "command header", command, sizeof(*command),
+                  false /*expectPending*/, session->mShmemReceive ? shmemFdOut : nullptr);
+}
+
+status_t RpcState::rpcSendCommand(const sp<RpcSession::RpcConnection>& connection,
+                                  const sp<RpcSession>& session, const char* what,
+                                  uint32_t command, iovec* body, size_t nbody) {
+    constexpr size_t kMaxBodyParts = 3;
+    LOG_ALWAYS_FATAL_IF(nbody > kMaxBodyParts, "Too many body parts %zu", nbody);
+
+    size_t bodySize = 0;
+    for (size_t i = 0; i < nbody; i++) bodySize += body[i].iov_len;
+    LOG_ALWAYS_FATAL_IF(bodySize > std::numeric_limits<int32_t>::max(), "Body too large %zu",
+                        bodySize);
+
+    size_t threshold = session->mShmemSendThreshold.load(std::memory_order_relaxed);
+    if (threshold == 0 || bodySize < threshold) {
+        RpcWireHeader header{
+                .command = command,
+                .bodySize = static_cast<uint32_t>(bodySize),
+        };
+        iovec iovs[1 + kMaxBodyParts];
+        iovs[0] = {&header, sizeof(header)};
+        for (size_t i = 0; i < nbody; i++) iovs[1 + i] = body[i];
+        return rpcSend(connection, session, what, iovs, 1 + nbody);
+    }
+
+    uint32_t shmemCommand;
+    switch (command) {
+        case RPC_COMMAND_TRANSACT:
+            shmemCommand = RPC_COMMAND_TRANSACT_SHMEM;
+            break;
+        case RPC_COMMAND_REPLY:
+            shmemCommand = RPC_COMMAND_REPLY_SHMEM;
+            break;
+        default:
+            LOG_ALWAYS_FATAL("No shmem variant of command %" PRIu32, command);
+    }
+
+    base::unique_fd fd(memfd_create("binder rpc body", MFD_CLOEXEC | MFD_ALLOW_SEALING));
+    if (fd == -1) {
+        int savedErrno = errno;
+        ALOGE("Could not create memfd for %s: %s", what, strerror(savedErrno));
+        return -savedErrno;
+    }
+    for (size_t i = 0; i < nbody; i++) {
+        const uint8_t* part = reinterpret_cast<const uint8_t*>(body[i].iov_base);
+        size_t written = 0;
+        while (written < body[i].iov_len) {
+            ssize_t ret = TEMP_FAILURE_RETRY(
+                    write(fd.get(), part + written, body[i].iov_len - written));
+            if (ret < 0) {
+                int savedErrno = errno;
+                ALOGE("Could not write %s to memfd: %s", what, strerror(savedErrno));
+                return -savedErrno;
+            }
+            written += ret;
+        }
+    }
+    // the receiver maps this directly, so it must not be able to change
+    // under it
+    if (0 != fcntl(fd.get(), F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL)) {
+        int savedErrno = errno;
+        ALOGE("Could not seal memfd for %s: %s", what, strerror(savedErrno));
+        return -savedErrno;
+    }
+
+    RpcWireHeader header{
+            .command = shmemCommand,
+            .bodySize = sizeof(RpcWireShmemBody),
+    };
+    RpcWireShmemBody shmemBody{
+            .offset = 0,
+            .size = bodySize,
+    };
+    iovec iovs[]{
+            {&header, sizeof(header)},
+            {&shmemBody, sizeof(shmemBody)},
+    };
+    return rpcSend(connection, session, what, iovs, arraysize(iovs), fd.get());
+}
+
+status_t RpcState::readShmemBody(const sp<RpcSession::RpcConnection>& connection,
+                                 const sp<RpcSession>& session, const RpcWireHeader& command,
+                                 base::unique_fd shmemFd, std::optional<CommandData>* dataOut) {
+    if (!session->mShmemReceive) {
+        ALOGE("Received shmem command %" PRIu32 " on session which didn't negotiate it",
+              command.command);
+        (void)session->shutdownAndWait(false);
+        return BAD_VALUE;
+    }
+    if (command.bodySize != sizeof(RpcWireShmemBody)) {
+        ALOGE("Expecting %zu but got %" PRIu32 " bytes for RpcWireShmemBody. Terminating!",
+              sizeof(RpcWireShmemBody), command.bodySize);
+        (void)session->shutdownAndWait(false);
+        return BAD_VALUE;
+    }
+
+    RpcWireShmemBody body;
+    if (status_t status = rpcRec(connection, session, "shmem body", &body, sizeof(body),
+                                 true /*expectPending*/);
+        status != OK)
+        return status;
+
+    if (!shmemFd.ok()) {
+        ALOGE("Shmem command %" PRIu32 " without an fd. Terminating!", command.command);
+        (void)session->shutdownAndWait(false);
+        return BAD_VALUE;
+    }
+
+    // Without these, the sender could modify or truncate the data while we
+    // are reading it (truncation would fault).
+    constexpr int kRequiredSeals = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE;
+    int seals = fcntl(shmemFd.get(), F_GET_SEALS);
+    struct stat st;
+    if (seals == -1 || (seals & kRequiredSeals) != kRequiredSeals ||
+        0 != fstat(shmemFd.get(), &st)) {
+        ALOGE("Shmem fd for command %" PRIu32 " is not sealed. Terminating!", command.command);
+        (void)session->shutdownAndWait(false);
+        return BAD_VALUE;
+    }
+
+    uint64_t end;
+    if (body.size > std::numeric_limits<int32_t>::max() ||
+        __builtin_add_overflow(body.offset, body.size, &end) ||
+        end > static_cast<uint64_t>(st.st_size)) {
+        ALOGE("Shmem body at %" PRIu64 " of size %" PRIu64 " doesn't fit in %" PRId64
+              " bytes. Terminating!",
+              body.offset, body.size, static_cast<int64_t>(st.st_size));
+        (void)session->shutdownAndWait(false);
+        return BAD_VALUE;
+    }
+
+    if (body.size == 0) {
+        dataOut->emplace(this, 0);
+        return OK;
+    }
+
+    uint64_t pageSize = getpagesize();
+    uint64_t mapOffset = body.offset - body.offset % pageSize;
+    size_t mapSize = end - mapOffset;
+    void* mapping =
+            mmap(nullptr, mapSize, PROT_READ, MAP_PRIVATE, shmemFd.get(), mapOffset);
+    if (mapping == MAP_FAILED) {
+        int savedErrno = errno;
+        ALOGE("Could not map shmem body of size %zu: %s", mapSize, strerror(savedErrno));
+        return -savedErrno;
+    }
+
+    dataOut->emplace(mapping, mapSize,
+                     reinterpret_cast<uint8_t*>(mapping) + (body.offset - mapOffset), body.size);
+    return OK;
+}
+
 status_t RpcState::sendConnectionInit(const sp<RpcSession::RpcConnection>& connection,
                                       const sp<RpcSession>& session) {
     RpcOutgoingConnectionInit init{
             .msg = RPC_CONNECTION_INIT_OKAY,
     };
-    return rpcSend(connection, session, "connection init", &init, sizeof(init));
+    iovec iov{&init, sizeof(init)};
+    return rpcSend(connection, session, "connection init", &iov, 1);
 }
 
 status_t RpcState::readConnectionInit(const sp<RpcSession::RpcConnection>& connection,
@@ -385,9 +767,31 @@ status_t RpcState::getSessionId(const sp<RpcSession::RpcConnection>& connection,
     return sessionIdOut->readFromParcel(reply);
 }
 
-status_t RpcState::transact(const sp<RpcSession::RpcConnection>& connection,
-                            const sp<IBinder>& binder, uint32_t code, const Parcel& data,
-                            const sp<RpcSession>& session, Parcel* reply, uint32_t flags) {
+status_t RpcState::negotiateShmem(const sp<RpcSession::RpcConnection>& connection,
+                                  const sp<RpcSession>& session, size_t threshold,
+                                  bool* acceptedOut) {
+    Parcel data;
+    data.markForRpc(session);
+    if (status_t status = data.writeUint64(threshold); status != OK) return status;
+    Parcel reply;
+
+    status_t status =
+            transactAddress(connection, RpcAddress::zero(), RPC_SPECIAL_TRANSACT_NEGOTIATE_SHMEM,
+                            data, session, &reply, 0);
+    if (status == UNKNOWN_TRANSACTION) {
+        // the other side doesn't know about shmem
+        *acceptedOut = false;
+        return OK;
+    }
+    if (status != OK) {
+        ALOGE("Error negotiating shmem: %s", statusToString(status).c_str());
+        return status;
+    }
+
+    return reply.readBool(acceptedOut);
+}
+
+status_t RpcState::validateOutgoingParcel(const Parcel& data) {
     if (!data.isForRpc()) {
         ALOGE("Refusing to send RPC with parcel not crafted for RPC");
         return BAD_TYPE;
@@ -398,6 +802,31 @@ status_t RpcState::transact(const sp<RpcSession::RpcConnection>& connection,
         return BAD_TYPE;
     }
 
+    return OK;
+}
+
+status_t RpcState::takeAsyncNumber(const sp<RpcSession>& session, const RpcAddress& address,
+                                   uint64_t* asyncNumberOut) {
+    std::unique_lock<std::mutex> _l(mNodeMutex);
+    if (mTerminated) return DEAD_OBJECT; // avoid fatal only, otherwise races
+    auto it = mNodeForAddress.find(address);
+    LOG_ALWAYS_FATAL_IF(it == mNodeForAddress.end(), "Sending transact on unknown address %s",
+                        address.toString().c_str());
+
+    *asyncNumberOut = it->second.asyncNumber;
+    if (!nodeProgressAsyncNumber(&it->second)) {
+        _l.unlock();
+        (void)session->shutdownAndWait(false);
+        return DEAD_OBJECT;
+    }
+    return OK;
+}
+
+status_t RpcState::transact(const sp<RpcSession::RpcConnection>& connection,
+                            const sp<IBinder>& binder, uint32_t code, const Parcel& data,
+                            const sp<RpcSession>& session, Parcel* reply, uint32_t flags) {
+    if (status_t status = validateOutgoingParcel(data); status != OK) return status;
+
     RpcAddress address = RpcAddress::zero();
     if (status_t status = onBinderLeaving(session, binder, &address); status != OK) return status;
 
@@ -413,19 +842,15 @@ status_t RpcState::transactAddress(const sp<RpcSession::RpcConnection>& connecti
     uint64_t asyncNumber = 0;
 
     if (!address.isZero()) {
-        std::unique_lock<std::mutex> _l(mNodeMutex);
-        if (mTerminated) return DEAD_OBJECT; // avoid fatal only, otherwise races
-        auto it = mNodeForAddress.find(address);
-        LOG_ALWAYS_FATAL_IF(it == mNodeForAddress.end(), "Sending transact on unknown address %s",
-                            address.toString().c_str());
-
         if (flags & IBinder::FLAG_ONEWAY) {
-            asyncNumber = it->second.asyncNumber;
-            if (!nodeProgressAsyncNumber(&it->second)) {
-                _l.unlock();
-                (void)session->shutdownAndWait(false);
-                return DEAD_OBJECT;
-            }
+            if (status_t status = takeAsyncNumber(session, address, &asyncNumber); status != OK)
+                return status;
+        } else {
+            std::lock_guard<std::mutex> _l(mNodeMutex);
+            if (mTerminated) return DEAD_OBJECT; // avoid fatal only, otherwise races
+            LOG_ALWAYS_FATAL_IF(mNodeForAddress.find(address) == mNodeForAddress.end(),
+                                "Sending transact on unknown address %s",
+                                address.toString().c_str());
         }
     }
 
@@ -434,30 +859,18 @@ status_t RpcState::transactAddress(const sp<RpcSession::RpcConnection>& connecti
                                 data.dataSize(),
                         "Too much data %zu", data.dataSize());
 
-    RpcWireHeader command{
-            .command = RPC_COMMAND_TRANSACT,
-            .bodySize = static_cast<uint32_t>(sizeof(RpcWireTransaction) + data.dataSize()),
-    };
     RpcWireTransaction transaction{
             .address = address.viewRawEmbedded(),
             .code = code,
             .flags = flags,
             .asyncNumber = asyncNumber,
     };
-    CommandData transactionData(sizeof(RpcWireHeader) + sizeof(RpcWireTransaction) +
-                                data.dataSize());
-    if (!transactionData.valid()) {
-        return NO_MEMORY;
-    }
-
-    memcpy(transactionData.data() + 0, &command, sizeof(RpcWireHeader));
-    memcpy(transactionData.data() + sizeof(RpcWireHeader), &transaction,
-           sizeof(RpcWireTransaction));
-    memcpy(transactionData.data() + sizeof(RpcWireHeader) + sizeof(RpcWireTransaction), data.data(),
-           data.dataSize());
-
-    if (status_t status = rpcSend(connection, session, "transaction", transactionData.data(),
-                                  transactionData.size());
+    iovec body[]{
+            {&transaction, sizeof(RpcWireTransaction)},
+            {const_cast<uint8_t*>(data.data()), data.dataSize()},
+    };
+    if (status_t status = rpcSendCommand(connection, session, "transaction", RPC_COMMAND_TRANSACT,
+                                         body, arraysize(body));
         status != OK)
         // TODO(b/167966510): need to undo onBinderLeaving - we know the
         // refcount isn't successfully transferred.
@@ -477,6 +890,134 @@ status_t RpcState::transactAddress(const sp<RpcSession::RpcConnection>& connecti
     return waitForReply(connection, session, reply);
 }
 
+status_t RpcState::transactOnewayBatched(const sp<IBinder>& binder, uint32_t code,
+                                         const Parcel& data, const sp<RpcSession>& session,
+                                         uint32_t flags) {
+    LOG_ALWAYS_FATAL_IF(!(flags & IBinder::FLAG_ONEWAY), "Batching requires oneway transaction");
+
+    if (status_t status = validateOutgoingParcel(data); status != OK) return status;
+
+    {
+        // Otherwise, the queue could never be flushed. Fail the same way the
+        // unbatched path does.
+        std::lock_guard<std::mutex> _l(session->mMutex);
+        if (session->mOutgoingConnections.empty()) {
+            ALOGE("Session has no client connections, can't send batched oneway transaction.");
+            return WOULD_BLOCK;
+        }
+    }
+
+    RpcAddress address = RpcAddress::zero();
+    if (status_t status = onBinderLeaving(session, binder, &address); status != OK) return status;
+
+    LOG_ALWAYS_FATAL_IF(std::numeric_limits<int32_t>::max() - sizeof(RpcWireHeader) -
+                                        sizeof(RpcWireTransaction) <
+                                data.dataSize(),
+                        "Too much data %zu", data.dataSize());
+
+    std::unique_lock<std::mutex> _l(mOnewayQueue.mutex);
+    mOnewayQueue.cv.wait(_l, [&] {
+        return mOnewayQueue.pending.size() < OnewayQueue::kMaxBytes ||
+                session->mShutdownTrigger->isTriggered();
+    });
+
+    // Taking the async number while holding the queue lock keeps the queue
+    // in asyncNumber order, so the other side doesn't need to reorder these.
+    uint64_t asyncNumber = 0;
+    if (!address.isZero()) {
+        if (status_t status = takeAsyncNumber(session, address, &asyncNumber); status != OK)
+            return status;
+    }
+
+    RpcWireHeader command{
+            .command = RPC_COMMAND_TRANSACT,
+            .bodySize = static_cast<uint32_t>(sizeof(RpcWireTransaction) + data.dataSize()),
+    };
+    RpcWireTransaction transaction{
+            .address = address.viewRawEmbedded(),
+            .code = code,
+            .flags = flags,
+            .asyncNumber = asyncNumber,
+    };
+
+    std::vector<uint8_t>& pending = mOnewayQueue.pending;
+    const uint8_t* commandBytes = reinterpret_cast<const uint8_t*>(&command);
+    const uint8_t* transactionBytes = reinterpret_cast<const uint8_t*>(&transaction);
+    pending.insert(pending.end(), commandBytes, commandBytes + sizeof(command));
+    pending.insert(pending.end(), transactionBytes, transactionBytes + sizeof(transaction));
+    pending.insert(pending.end(), data.data(), data.data() + data.dataSize());
+
+    OnewayQueueStats& stats = mOnewayQueue.stats;
+    stats.depth++;
+    stats.maxDepth = std::max(stats.maxDepth, stats.depth);
+
+    // another thread will pick this up
+    if (mOnewayQueue.flushing) return OK;
+
+    mOnewayQueue.flushing = true;
+    status_t status = OK;
+    while (!pending.empty()) {
+        std::vector<uint8_t> batch = std::move(mOnewayQueue.spare);
+        batch.swap(pending);
+        size_t count = stats.depth;
+        stats.depth = 0;
+        _l.unlock();
+        mOnewayQueue.cv.notify_all();
+
+        status = flushOnewayQueue(session, &batch);
+
+        _l.lock();
+        stats.transactions += count;
+        stats.writes++;
+        batch.clear();
+        mOnewayQueue.spare = std::move(batch);
+
+        if (status != OK) {
+            // session is shut down, so these would never be sent
+            pending.clear();
+            stats.depth = 0;
+            break;
+        }
+    }
+    mOnewayQueue.flushing = false;
+    _l.unlock();
+    mOnewayQueue.cv.notify_all();
+
+    return status;
+}
+
+status_t RpcState::flushOnewayQueue(const sp<RpcSession>& session, std::vector<uint8_t>* batch) {
+    RpcSession::ExclusiveConnection connection;
+    if (status_t status = RpcSession::ExclusiveConnection::find(session,
+                                                                RpcSession::ConnectionUse::
+                                                                        CLIENT_ASYNC,
+                                                                &connection);
+        status != OK) {
+        (void)session->shutdownAndWait(false);
+        return status;
+    }
+
+    LOG_RPC_DETAIL("Flushing batched oneway transactions (%zu bytes) on fd %d", batch->size(),
+                   connection.get()->fd.get());
+
+    iovec iov{batch->data(), batch->size()};
+    // TODO(b/167966510): need to undo onBinderLeaving - we know the
+    // refcount isn't successfully transferred.
+    if (status_t status =
+                rpcSend(connection.get(), session, "batched oneway transactions", &iov, 1);
+        status != OK)
+        return status;
+
+    // Do not wait on result, but process refcounts which may have built up
+    // while sending (see transactAddress).
+    return drainCommands(connection.get(), session, CommandType::CONTROL_ONLY);
+}
+
+RpcState::OnewayQueueStats RpcState::getOnewayQueueStats() {
+    std::lock_guard<std::mutex> _l(mOnewayQueue.mutex);
+    return mOnewayQueue.stats;
+}
+
 static void cleanup_reply_data(Parcel* p, const uint8_t* data, size_t dataSize,
                                const binder_size_t* objects, size_t objectsCount) {
     (void)p;
@@ -486,41 +1027,69 @@ static void cleanup_reply_data(Parcel* p, const uint8_t* data, size_t dataSize,
     LOG_ALWAYS_FATAL_IF(objectsCount, 0);
 }
 
+static void cleanup_shmem_reply_data(Parcel* p, const uint8_t* data, size_t dataSize,
+                                     const binder_size_t* objects, size_t objectsCount) {
+    (void)p;
+    // see RpcState::readShmemBody, the mapping starts in the same page as the
+    // reply
+    uintptr_t start = reinterpret_cast<uintptr_t>(data) - offsetof(RpcWireReply, data);
+    uintptr_t base = start - start % getpagesize();
+    if (0 != munmap(reinterpret_cast<void*>(base),
+                    (start - base) + offsetof(RpcWireReply, data) + dataSize)) {
+        ALOGE("Failed to unmap shmem reply: %s", strerror(errno));
+    }
+    LOG_ALWAYS_FATAL_IF(objects != nullptr);
+    LOG_ALWAYS_FATAL_IF(objectsCount, 0);
+}
+
 status_t RpcState::waitForReply(const sp<RpcSession::RpcConnection>& connection,
                                 const sp<RpcSession>& session, Parcel* reply) {
     RpcWireHeader command;
+    base::unique_fd shmemFd;
     while (true) {
-        if (status_t status =
-                    rpcRec(connection, session, "command header", &command, sizeof(command));
+        if (status_t status = rpcRecHeader(connection, session, &command, &shmemFd);
             status != OK)
             return status;
 
-        if (command.command == RPC_COMMAND_REPLY) break;
+        if (command.command == RPC_COMMAND_REPLY || command.command == RPC_COMMAND_REPLY_SHMEM)
+            break;
 
-        if (status_t status = processCommand(connection, session, command, CommandType::ANY);
+        if (status_t status = processCommand(connection, session, command, CommandType::ANY,
+                                             std::move(shmemFd));
             status != OK)
             return status;
     }
 
-    CommandData data(command.bodySize);
-    if (!data.valid()) return NO_MEMORY;
+    std::optional<CommandData> data;
+    if (command.command == RPC_COMMAND_REPLY_SHMEM) {
+        if (status_t status =
+                    readShmemBody(connection, session, command, std::move(shmemFd), &data);
+            status != OK)
+            return status;
+    } else {
+        data.emplace(this, command.bodySize);
+        if (!data->valid()) return NO_MEMORY;
 
-    if (status_t status = rpcRec(connection, session, "reply body", data.data(), command.bodySize);
-        status != OK)
-        return status;
+        if (status_t status = rpcRec(connection, session, "reply body", data->data(),
+                                     data->size(), true /*expectPending*/);
+            status != OK)
+            return status;
+    }
 
-    if (command.bodySize < sizeof(RpcWireReply)) {
-        ALOGE("Expecting %zu but got %" PRId32 " bytes for RpcWireReply. Terminating!",
-              sizeof(RpcWireReply), command.bodySize);
+    if (data->size() < sizeof(RpcWireReply)) {
+        ALOGE("Expecting %zu but got %zu bytes for RpcWireReply. Terminating!",
+              sizeof(RpcWireReply), data->size());
         (void)session->shutdownAndWait(false);
         return BAD_VALUE;
     }
-    RpcWireReply* rpcReply = reinterpret_cast<RpcWireReply*>(data.data());
+    RpcWireReply* rpcReply = reinterpret_cast<RpcWireReply*>(data->data());
     if (rpcReply->status != OK) return rpcReply->status;
 
-    data.release();
-    reply->ipcSetDataReference(rpcReply->data, command.bodySize - offsetof(RpcWireReply, data),
-                               nullptr, 0, cleanup_reply_data);
+    bool isMapping = data->isMapping();
+    size_t dataSize = data->size() - offsetof(RpcWireReply, data);
+    data->release();
+    reply->ipcSetDataReference(rpcReply->data, dataSize, nullptr, 0,
+                               isMapping ? cleanup_shmem_reply_data : cleanup_reply_data);
 
     reply->markForRpc(session);
 
@@ -547,14 +1116,11 @@ status_t RpcState::sendDecStrong(const sp<RpcSession::RpcConnection>& connection
             .command = RPC_COMMAND_DEC_STRONG,
             .bodySize = sizeof(RpcWireAddress),
     };
-    if (status_t status = rpcSend(connection, session, "dec ref header", &cmd, sizeof(cmd));
-        status != OK)
-        return status;
-    if (status_t status = rpcSend(connection, session, "dec ref body", &addr.viewRawEmbedded(),
-                                  sizeof(RpcWireAddress));
-        status != OK)
-        return status;
-    return OK;
+    iovec iovs[]{
+            {&cmd, sizeof(cmd)},
+            {const_cast<RpcWireAddress*>(&addr.viewRawEmbedded()), sizeof(RpcWireAddress)},
+    };
+    return rpcSend(connection, session, "dec ref", iovs, arraysize(iovs));
 }
 
 status_t RpcState::getAndExecuteCommand(const sp<RpcSession::RpcConnection>& connection,
@@ -562,27 +1128,30 @@ status_t RpcState::getAndExecuteCommand(const sp<RpcSession::RpcConnection>& con
     LOG_RPC_DETAIL("getAndExecuteCommand on fd %d", connection->fd.get());
 
     RpcWireHeader command;
-    if (status_t status = rpcRec(connection, session, "command header", &command, sizeof(command));
-        status != OK)
+    base::unique_fd shmemFd;
+    if (status_t status = rpcRecHeader(connection, session, &command, &shmemFd); status != OK)
         return status;
 
-    return processCommand(connection, session, command, type);
+    return processCommand(connection, session, command, type, std::move(shmemFd));
 }
 
 status_t RpcState::drainCommands(const sp<RpcSession::RpcConnection>& connection,
                                  const sp<RpcSession>& session, CommandType type) {
     uint8_t buf;
-    while (0 < TEMP_FAILURE_RETRY(
-                       recv(connection->fd.get(), &buf, sizeof(buf), MSG_PEEK | MSG_DONTWAIT))) {
+    while (true) {
+        mSyscallCount.fetch_add(1, std::memory_order_relaxed);
+        if (0 >= TEMP_FAILURE_RETRY(
+                         recv(connection->fd.get(), &buf, sizeof(buf), MSG_PEEK | MSG_DONTWAIT))) {
+            return OK;
+        }
         status_t status = getAndExecuteCommand(connection, session, type);
         if (status != OK) return status;
     }
-    return OK;
 }
 
 status_t RpcState::processCommand(const sp<RpcSession::RpcConnection>& connection,
                                   const sp<RpcSession>& session, const RpcWireHeader& command,
-                                  CommandType type) {
+                                  CommandType type, base::unique_fd shmemFd) {
     IPCThreadState* kernelBinderState = IPCThreadState::selfOrNull();
     IPCThreadState::SpGuard spGuard{
             .address = __builtin_frame_address(0),
@@ -600,8 +1169,9 @@ status_t RpcState::processCommand(const sp<RpcSession::RpcConnection>& connectio
 
     switch (command.command) {
         case RPC_COMMAND_TRANSACT:
+        case RPC_COMMAND_TRANSACT_SHMEM:
             if (type != CommandType::ANY) return BAD_TYPE;
-            return processTransact(connection, session, command);
+            return processTransact(connection, session, command, std::move(shmemFd));
         case RPC_COMMAND_DEC_STRONG:
             return processDecStrong(connection, session, command);
     }
@@ -616,15 +1186,24 @@ status_t RpcState::processCommand(const sp<RpcSession::RpcConnection>& connectio
     return DEAD_OBJECT;
 }
 status_t RpcState::processTransact(const sp<RpcSession::RpcConnection>& connection,
-                                   const sp<RpcSession>& session, const RpcWireHeader& command) {
+                                   const sp<RpcSession>& session, const RpcWireHeader& command,
+                                   base::unique_fd shmemFd) {
+    if (command.command == RPC_COMMAND_TRANSACT_SHMEM) {
+        std::optional<CommandData> transactionData;
+        if (status_t status = readShmemBody(connection, session, command, std::move(shmemFd),
+                                            &transactionData);
+            status != OK)
+            return status;
+        return processTransactInternal(connection, session, std::move(*transactionData));
+    }
     LOG_ALWAYS_FATAL_IF(command.command != RPC_COMMAND_TRANSACT, "command: %d", command.command);
 
-    CommandData transactionData(command.bodySize);
+    CommandData transactionData(this, command.bodySize);
     if (!transactionData.valid()) {
         return NO_MEMORY;
     }
     if (status_t status = rpcRec(connection, session, "transaction body", transactionData.data(),
-                                 transactionData.size());
+                                 transactionData.size(), true /*expectPending*/);
         status != OK)
         return status;
 
@@ -767,6 +1346,15 @@ processTransactInternalTailCall:
                     replyStatus = session->mId.value().writeToParcel(&reply);
                     break;
                 }
+                case RPC_SPECIAL_TRANSACT_NEGOTIATE_SHMEM: {
+                    uint64_t threshold;
+                    replyStatus = data.readUint64(&threshold);
+                    if (replyStatus != OK) break;
+                    bool accepted = session->mShmemReceive && threshold > 0;
+                    if (accepted) session->mShmemSendThreshold = threshold;
+                    replyStatus = reply.writeBool(accepted);
+                    break;
+                }
                 default: {
                     sp<RpcServer> server = session->server();
                     if (server) {
@@ -843,36 +1431,28 @@ processTransactInternalTailCall:
                                 reply.dataSize(),
                         "Too much data for reply %zu", reply.dataSize());
 
-    RpcWireHeader cmdReply{
-            .command = RPC_COMMAND_REPLY,
-            .bodySize = static_cast<uint32_t>(sizeof(RpcWireReply) + reply.dataSize()),
-    };
     RpcWireReply rpcReply{
             .status = replyStatus,
     };
 
-    CommandData replyData(sizeof(RpcWireHeader) + sizeof(RpcWireReply) + reply.dataSize());
-    if (!replyData.valid()) {
-        return NO_MEMORY;
-    }
-    memcpy(replyData.data() + 0, &cmdReply, sizeof(RpcWireHeader));
-    memcpy(replyData.data() + sizeof(RpcWireHeader), &rpcReply, sizeof(RpcWireReply));
-    memcpy(replyData.data() + sizeof(RpcWireHeader) + sizeof(RpcWireReply), reply.data(),
-           reply.dataSize());
-
-    return rpcSend(connection, session, "reply", replyData.data(), replyData.size());
+    iovec body[]{
+            {&rpcReply, sizeof(RpcWireReply)},
+            {const_cast<uint8_t*>(reply.data()), reply.dataSize()},
+    };
+    return rpcSendCommand(connection, session, "reply", RPC_COMMAND_REPLY, body, arraysize(body));
 }
 
 status_t RpcState::processDecStrong(const sp<RpcSession::RpcConnection>& connection,
                                     const sp<RpcSession>& session, const RpcWireHeader& command) {
     LOG_ALWAYS_FATAL_IF(command.command != RPC_COMMAND_DEC_STRONG, "command: %d", command.command);
 
-    CommandData commandData(command.bodySize);
+    CommandData commandData(this, command.bodySize);
     if (!commandData.valid()) {
         return NO_MEMORY;
     }
     if (status_t status =
-                rpcRec(connection, session, "dec ref body", commandData.data(), commandData.size());
+                rpcRec(connection, session, "dec ref body", commandData.data(), commandData.size(),
+                       true /*expectPending*/);
         status != OK)
         return status;
 
@@ -20,9 +20,15 @@
 #include <binder/Parcel.h>
 #include <binder/RpcSession.h>
 
+#include <atomic>
+#include <condition_variable>
 #include <map>
+#include <mutex>
 #include <optional>
 #include <queue>
+#include <vector>
+
+#include <sys/uio.h>
 
 namespace android {
 
@@ -63,6 +69,8 @@ public:
                            const sp<RpcSession>& session, size_t* maxThreadsOut);
     status_t getSessionId(const sp<RpcSession::RpcConnection>& connection,
                           const sp<RpcSession>& session, RpcAddress* sessionIdOut);
+    status_t negotiateShmem(const sp<RpcSession::RpcConnection>& connection,
+                            const sp<RpcSession>& session, size_t threshold, bool* acceptedOut);
 
     [[nodiscard]] status_t transact(const sp<RpcSession::RpcConnection>& connection,
                                     const sp<IBinder>& address, uint32_t code, const Parcel& data,
@@ -74,6 +82,28 @@ public:
     [[nodiscard]] status_t sendDecStrong(const sp<RpcSession::RpcConnection>& connection,
                                          const sp<RpcSession>& session, const RpcAddress& address);
 
+    /**
+     * Queues a oneway transaction, see RpcSession::setOnewayBatching. If no
+     * other thread is flushing the queue, this thread finds a connection and
+     * writes out the queue (including transactions other threads add in the
+     * meantime) before returning.
+     */
+    [[nodiscard]] status_t transactOnewayBatched(const sp<IBinder>& address, uint32_t code,
+                                                 const Parcel& data, const sp<RpcSession>& session,
+                                                 uint32_t flags);
+
+    struct OnewayQueueStats {
+        // transactions currently queued
+        size_t depth = 0;
+        // highest number of transactions queued at once
+        size_t maxDepth = 0;
+        // total number of transactions written from the queue
+        size_t transactions = 0;
+        // number of writes used to send those transactions
+        size_t writes = 0;
+    };
+    OnewayQueueStats getOnewayQueueStats();
+
     enum class CommandType {
         ANY,
         CONTROL_ONLY,
@@ -101,6 +131,12 @@ public:
     size_t countBinders();
     void dump();
 
+    /**
+     * Number of socket syscalls (send, recv and poll) made on behalf of this
+     * state. Used by benchmarks to measure the per-transaction wire overhead.
+     */
+    size_t countSyscalls();
+
     /**
      * Called when reading or writing data to a session fails to clean up
      * data associated with the session in order to cleanup binders.
@@ -122,35 +158,130 @@ public:
 private:
     void dumpLocked();
 
+    [[nodiscard]] status_t validateOutgoingParcel(const Parcel& data);
+    // Reserves the next async number for the binder at 'address'
+    [[nodiscard]] status_t takeAsyncNumber(const sp<RpcSession>& session,
+                                           const RpcAddress& address, uint64_t* asyncNumberOut);
+    [[nodiscard]] status_t flushOnewayQueue(const sp<RpcSession>& session,
+                                            std::vector<uint8_t>* batch);
+
+    // Per-session cache of buffers for CommandData, split into power of two
+    // size classes. The number of buffers retained for each class follows the
+    // peak number of buffers of that class used at once over the recent
+    // transactions, so memory held for bursty or rare sizes is given back.
+    class CommandDataPool {
+    public:
+        // Buffers are always allocated with new[], so one which is released
+        // from a CommandData may be freed with delete[]. Returns nullptr on
+        // allocation failure.
+        uint8_t* take(size_t size, size_t* capacityOut);
+        void give(uint8_t* buffer, size_t capacity);
+        void onReleased(size_t capacity);
+        void dump();
+
+    private:
+        static constexpr size_t kMinClassShift = 6;  // 64 bytes
+        static constexpr size_t kMaxClassShift = 16; // 64 KiB
+        static constexpr size_t kNumClasses = kMaxClassShift - kMinClassShift + 1;
+        static constexpr size_t kMaxRetainedPerClass = 8;
+        static constexpr size_t kWindow = 256;
+
+        // returns kNumClasses if this size shouldn't be pooled
+        static size_t classFor(size_t size);
+        static size_t capacityFor(size_t sizeClass) {
+            return size_t{1} << (sizeClass + kMinClassShift);
+        }
+        void endWindowLocked();
+
+        struct SizeClass {
+            std::vector<std::unique_ptr<uint8_t[]>> free;
+            size_t outstanding = 0;
+            size_t peakOutstanding = 0; // in the current window
+            size_t retainLimit = kMaxRetainedPerClass;
+        };
+
+        std::mutex mMutex;
+        SizeClass mClasses[kNumClasses];
+        size_t mWindowTakes = 0;
+
+        size_t mTakes = 0;
+        size_t mHits = 0;
+        size_t mUnpooled = 0;
+        size_t mTrimmed = 0;
+        size_t mReleased = 0;
+    };
+
     // Alternative to std::vector<uint8_t> that doesn't abort on allocation failure and caps
-    // large allocations to avoid being requested from allocating too much data.
+    // large allocations to avoid being requested from allocating too much data. Buffers are
+    // drawn from, and returned to, the CommandDataPool of the RpcState.
     struct CommandData {
-        explicit CommandData(size_t size);
+        CommandData(RpcState* state, size_t size);
+        // Takes ownership of a memory mapping of 'mappingSize' bytes at
+        // 'mapping', which contains 'size' bytes of data at 'data'. This has no
+        // allocation limit, since the memory is provided by the other side.
+        CommandData(void* mapping, size_t mappingSize, uint8_t* data, size_t size);
         bool valid() { return mSize == 0 || mData != nullptr; }
         size_t size() { return mSize; }
         uint8_t* data() { return mData.get(); }
-        uint8_t* release() { return mData.release(); }
+        bool isMapping() { return mData.get_deleter().mapping != nullptr; }
+        // Data from a pooled buffer must be freed w/ delete[], and data from a
+        // mapping w/ munmap.
+        uint8_t* release();
 
     private:
-        std::unique_ptr<uint8_t[]> mData;
+        struct Deleter {
+            CommandDataPool* pool = nullptr;
+            size_t capacity = 0;
+            // set instead of 'pool' for a memory mapping
+            void* mapping = nullptr;
+            size_t mappingSize = 0;
+            void operator()(uint8_t* buffer) const;
+        };
+
+        std::unique_ptr<uint8_t[], Deleter> mData;
         size_t mSize;
     };
 
+    // Sends all of the buffers described by 'iovs' in as few syscalls as
+    // possible (normally one). 'iovs' may be modified. If 'fdToSend' is set,
+    // it is attached to the start of the data with SCM_RIGHTS.
     [[nodiscard]] status_t rpcSend(const sp<RpcSession::RpcConnection>& connection,
-                                   const sp<RpcSession>& session, const char* what,
-                                   const void* data, size_t size);
+                                   const sp<RpcSession>& session, const char* what, iovec* iovs,
+                                   size_t niovs, int fdToSend = -1);
+    // If 'expectPending', the data is likely already on the socket (e.g. a
+    // body following its header), so a non-blocking read is tried before
+    // polling. If 'fdOut' is set, it receives an fd attached to the data.
     [[nodiscard]] status_t rpcRec(const sp<RpcSession::RpcConnection>& connection,
                                   const sp<RpcSession>& session, const char* what, void* data,
-                                  size_t size);
+                                  size_t size, bool expectPending = false,
+                                  base::unique_fd* fdOut = nullptr);
+    // Reads a command header, and the shmem fd possibly attached to it.
+    [[nodiscard]] status_t rpcRecHeader(const sp<RpcSession::RpcConnection>& connection,
+                                        const sp<RpcSession>& session, RpcWireHeader* command,
+                                        base::unique_fd* shmemFdOut);
+    // Sends a header for 'command' followed by a body made of 'body'. If the
+    // session supports it and the body is large, it is sent in shared memory
+    // instead.
+    [[nodiscard]] status_t rpcSendCommand(const sp<RpcSession::RpcConnection>& connection,
+                                          const sp<RpcSession>& session, const char* what,
+                                          uint32_t command, iovec* body, size_t nbody);
+    // For RPC_COMMAND_*_SHMEM, reads RpcWireShmemBody and maps the body it
+    // describes.
+    [[nodiscard]] status_t readShmemBody(const sp<RpcSession::RpcConnection>& connection,
+                                         const sp<RpcSession>& session,
+                                         const RpcWireHeader& command, base::unique_fd shmemFd,
+                                         std::optional<CommandData>* dataOut);
 
     [[nodiscard]] status_t waitForReply(const sp<RpcSession::RpcConnection>& connection,
                                         const sp<RpcSession>& session, Parcel* reply);
     [[nodiscard]] status_t processCommand(const sp<RpcSession::RpcConnection>& connection,
                                           const sp<RpcSession>& session,
-                                          const RpcWireHeader& command, CommandType type);
+                                          const RpcWireHeader& command, CommandType type,
+                                          base::unique_fd shmemFd);
     [[nodiscard]] status_t processTransact(const sp<RpcSession::RpcConnection>& connection,
                                            const sp<RpcSession>& session,
-                                           const RpcWireHeader& command);
+                                           const RpcWireHeader& command,
+                                           base::unique_fd shmemFd);
     [[nodiscard]] status_t processTransactInternal(const sp<RpcSession::RpcConnection>& connection,
                                                    const sp<RpcSession>& session,
                                                    CommandData transactionData);
@@ -215,6 +346,26 @@ private:
     // false - session shutdown, halt
     [[nodiscard]] bool nodeProgressAsyncNumber(BinderNode* node);
 
+    std::atomic<size_t> mSyscallCount = 0;
+
+    struct OnewayQueue {
+        // once this much is queued, callers wait for it to be written
+        static constexpr size_t kMaxBytes = 1024 * 1024;
+
+        std::mutex mutex; // for all below, taken before mNodeMutex
+        std::condition_variable cv;
+        // fully serialized commands, ready to be written
+        std::vector<uint8_t> pending;
+        // reused for the next batch, to avoid reallocating
+        std::vector<uint8_t> spare;
+        bool flushing = false;
+        OnewayQueueStats stats;
+    };
+    OnewayQueue mOnewayQueue;
+
+    // must outlive any CommandData, including those in mNodeForAddress
+    CommandDataPool mCommandDataPool;
+
     std::mutex mNodeMutex;
     bool mTerminated = false;
     // binders known by both sides of a session
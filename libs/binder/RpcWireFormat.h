@@ -22,6 +22,12 @@ namespace android {
 
 enum : uint8_t {
     RPC_CONNECTION_OPTION_REVERSE = 0x1,
+    /**
+     * The client can receive RPC_COMMAND_*_SHMEM commands, and the server
+     * should expect fds attached to commands on this session (see
+     * RPC_SPECIAL_TRANSACT_NEGOTIATE_SHMEM). Only for unix domain sockets.
+     */
+    RPC_CONNECTION_OPTION_SHMEM = 0x2,
 };
 
 constexpr uint64_t RPC_WIRE_ADDRESS_OPTION_CREATED = 1 << 0; // distinguish from '0' address
@@ -71,6 +77,17 @@ enum : uint32_t {
      * want to create a 'Parcel' object for every decref)
      */
     RPC_COMMAND_DEC_STRONG,
+    /**
+     * follows is RpcWireShmemBody, which describes where the body of a
+     * RPC_COMMAND_TRANSACT (RpcWireTransaction) is found in a sealed memfd,
+     * which is attached to this header with SCM_RIGHTS.
+     */
+    RPC_COMMAND_TRANSACT_SHMEM,
+    /**
+     * same as RPC_COMMAND_TRANSACT_SHMEM, for the body of a RPC_COMMAND_REPLY
+     * (RpcWireReply)
+     */
+    RPC_COMMAND_REPLY_SHMEM,
 };
 
 /**
@@ -83,6 +100,12 @@ enum : uint32_t {
     RPC_SPECIAL_TRANSACT_GET_ROOT = 0,
     RPC_SPECIAL_TRANSACT_GET_MAX_THREADS = 1,
     RPC_SPECIAL_TRANSACT_GET_SESSION_ID = 2,
+    /**
+     * Sent by clients which set RPC_CONNECTION_OPTION_SHMEM, w/ uint64_t
+     * threshold (in bytes) above which either side should send command bodies
+     * through shared memory. Reply is a bool, whether the server accepted.
+     */
+    RPC_SPECIAL_TRANSACT_NEGOTIATE_SHMEM = 3,
 };
 
 // serialization is like:
@@ -112,6 +135,11 @@ struct RpcWireReply {
     uint8_t data[0];
 };
 
+struct RpcWireShmemBody {
+    uint64_t offset; // into the attached memfd
+    uint64_t size;   // of the body
+};
+
 #pragma clang diagnostic pop
 
 } // namespace android
@@ -22,6 +22,8 @@
 #include <utils/String16.h>
 #include <utils/Vector.h>
 
+#include <string>
+
 // linux/binder.h defines this, but we don't want to include it here in order to
 // avoid exporting the kernel headers
 #ifndef B_PACK_CHARS
@@ -61,6 +63,13 @@ public:
         EXTENSION_TRANSACTION = B_PACK_CHARS('_', 'E', 'X', 'T'),
         DEBUG_PID_TRANSACTION = B_PACK_CHARS('_', 'P', 'I', 'D'),
         SET_RPC_CLIENT_TRANSACTION = B_PACK_CHARS('_', 'R', 'P', 'C'),
+        // Takes one of the BINDER_STATS_* commands below, and replies with a
+        // dump of the transaction latency stats of the hosting process as a
+        // UTF-16 string.
+        BINDER_STATS_TRANSACTION = B_PACK_CHARS('_', 'S', 'T', 'S'),
+        // Replies with a dump of the last transactions sent and served by
+        // each thread of the hosting process, as a UTF-16 string.
+        TRANSACTION_HISTORY_TRANSACTION = B_PACK_CHARS('_', 'H', 'S', 'T'),
 
         // See android.os.IBinder.TWEET_TRANSACTION
         // Most importantly, messages can be anything not exceeding 130 UTF-8
@@ -71,6 +80,12 @@ public:
         // Improve binder self-esteem.
         LIKE_TRANSACTION = B_PACK_CHARS('_', 'L', 'I', 'K'),
 
+        // Commands for BINDER_STATS_TRANSACTION
+        BINDER_STATS_DUMP = 0,
+        BINDER_STATS_ENABLE = 1,
+        BINDER_STATS_DISABLE = 2,
+        BINDER_STATS_RESET = 3,
+
         // Corresponds to TF_ONE_WAY -- an asynchronous call.
         FLAG_ONEWAY = 0x00000001,
 
@@ -153,6 +168,21 @@ public:
      */
     status_t                getDebugPid(pid_t* outPid);
 
+    /**
+     * Sends one of the BINDER_STATS_* commands to the process hosting this
+     * binder, and returns the resulting dump of its transaction latency
+     * stats, for debugging. Only allowed for root, shell, or the hosting
+     * process itself.
+     */
+    status_t                getBinderStats(int32_t command, std::string* outDump);
+
+    /**
+     * Dump of the last transactions sent and served by each thread of the
+     * process hosting this binder, including those still in flight, for
+     * debugging. Only allowed for root, shell, or the hosting process itself.
+     */
+    status_t                getTransactionHistory(std::string* outDump);
+
     /**
      * Set the RPC client fd to this binder service, for debugging. This is only available on
      * debuggable builds.
@@ -21,6 +21,8 @@
 #include <binder/ProcessState.h>
 #include <utils/Vector.h>
 
+#include <memory>
+
 #if defined(_WIN32)
 typedef  int  uid_t;
 #endif
@@ -28,6 +30,8 @@ typedef  int  uid_t;
 // ---------------------------------------------------------------------------
 namespace android {
 
+class BinderFlightRecorder;
+
 class IPCThreadState
 {
 public:
@@ -209,6 +213,9 @@ private:
             status_t            getAndExecuteCommand();
             status_t            executeCommand(int32_t command);
             void                processPendingDerefs();
+            // Waits for incoming work for up to the idle timeout of the
+            // process. Returns TIMED_OUT if the thread should leave the pool.
+            status_t            waitForWorkOrIdleTimeout();
             void                processPostWriteDerefs();
 
             void                clearCaller();
@@ -241,6 +248,12 @@ private:
             int32_t             mStrictModePolicy;
             int32_t             mLastTransactionBinderFlags;
             CallRestriction     mCallRestriction;
+            // Key this thread is tagged with, see ProcessState::setCpuAttribution.
+            uint16_t            mCpuAttributionKey;
+            // Target of the transaction waiting for a reply, for BinderBufferTracker
+            int32_t             mReplyHandle;
+            uint32_t            mReplyCode;
+            std::unique_ptr<BinderFlightRecorder> mFlightRecorder;
 };
 
 } // namespace android
@@ -20,6 +20,9 @@
 #include <utils/Vector.h>
 #include <utils/String16.h>
 
+#include <functional>
+#include <future>
+#include <memory>
 #include <optional>
 
 namespace android {
@@ -68,6 +71,12 @@ public:
      */
     virtual sp<IBinder>         checkService( const String16& name) const = 0;
 
+    /**
+     * Same as checkService for each of 'names', but in one call to the
+     * service manager. Results are in the same order as 'names'.
+     */
+    virtual Vector<sp<IBinder>> checkServices(const Vector<String16>& names) const;
+
     /**
      * Register a service.
      */
@@ -89,6 +98,16 @@ public:
      */
     virtual sp<IBinder> waitForService(const String16& name) = 0;
 
+    /**
+     * Like waitForService, but without blocking the calling thread, so that
+     * one thread can wait for many services at once. 'callback' is called
+     * exactly once: right away if the service is already registered, and
+     * otherwise on a binder thread when it is registered. It gets nullptr
+     * only for permission problem or fatal error. Requires a thread pool.
+     */
+    using ServiceCallback = std::function<void(const sp<IBinder>& service)>;
+    virtual void waitForServiceAsync(const String16& name, ServiceCallback callback);
+
     /**
      * Check if a service is declared (e.g. VINTF manifest).
      *
@@ -125,6 +144,20 @@ sp<INTERFACE> waitForService(const String16& name) {
     return interface_cast<INTERFACE>(sm->waitForService(name));
 }
 
+/**
+ * Future version of IServiceManager::waitForServiceAsync, e.g. to start
+ * waiting for several services and only then get() each of them.
+ */
+template <typename INTERFACE>
+std::future<sp<INTERFACE>> waitForServiceAsync(const String16& name) {
+    auto promise = std::make_shared<std::promise<sp<INTERFACE>>>();
+    std::future<sp<INTERFACE>> future = promise->get_future();
+    defaultServiceManager()->waitForServiceAsync(name, [promise](const sp<IBinder>& service) {
+        promise->set_value(interface_cast<INTERFACE>(service));
+    });
+    return future;
+}
+
 template<typename INTERFACE>
 sp<INTERFACE> waitForDeclaredService(const String16& name) {
     const sp<IServiceManager> sm = defaultServiceManager();
@@ -26,14 +26,26 @@ namespace android {
 // ----------------------------------------------------------------------------
 
 class SimpleBestFitAllocator;
+class SizeClassAllocator;
 
 // ----------------------------------------------------------------------------
 
 class MemoryDealer : public RefBase
 {
 public:
+    enum class AllocationPolicy {
+        // Best fit over the whole heap, under a single lock.
+        BEST_FIT,
+        // Small allocations (see getMaxSizeClassAllocation()) are carved out
+        // of slabs of equally sized blocks, which are claimed without locking.
+        // Larger ones, and small ones when no slab can be created, are served
+        // like with BEST_FIT.
+        SIZE_CLASSES,
+    };
+
     explicit MemoryDealer(size_t size, const char* name = nullptr,
             uint32_t flags = 0 /* or bits such as MemoryHeapBase::READ_ONLY */ );
+    MemoryDealer(size_t size, const char* name, uint32_t flags, AllocationPolicy policy);
 
     virtual sp<IMemory> allocate(size_t size);
     virtual void        deallocate(size_t offset);
@@ -42,6 +54,9 @@ public:
     // allocations are aligned to some value. return that value so clients can account for it.
     static size_t      getAllocationAlignment();
 
+    // largest allocation served from a size class with AllocationPolicy::SIZE_CLASSES
+    static size_t      getMaxSizeClassAllocation();
+
     sp<IMemoryHeap> getMemoryHeap() const { return heap(); }
 
 protected:
@@ -53,6 +68,7 @@ private:
 
     sp<IMemoryHeap>             mHeap;
     SimpleBestFitAllocator*     mAllocator;
+    SizeClassAllocator*         mSizeClasses; // only with AllocationPolicy::SIZE_CLASSES
 };
 
 
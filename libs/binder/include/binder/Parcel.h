@@ -551,6 +551,8 @@ private:
     uintptr_t           readPointer() const;
     void                freeDataNoInit();
     void                initState();
+    bool                isInlineData() const { return mData == mInlineData; }
+    uint8_t*            moveInlineDataToHeap(size_t desired);
     void                scanForFds() const;
     status_t            validateReadData(size_t len) const;
 
@@ -902,7 +904,7 @@ private:
         using T = first_template_type_t<CT>;  // The T in CT == C<T, ...>
         if (c.size() >  std::numeric_limits<int32_t>::max()) return BAD_VALUE;
         const auto size = static_cast<int32_t>(c.size());
-        writeData(size);
+        if (status_t status = writeData(size); status != OK) return status;
         if constexpr (is_pointer_equivalent_array_v<T>) {
             constexpr size_t limit = std::numeric_limits<size_t>::max() / sizeof(T);
             if (c.size() > limit) return BAD_VALUE;
@@ -1140,6 +1142,12 @@ private:
 
     sp<RpcSession> mSession;
 
+    // Most parcels are only a few words (pings, getters, status replies), so
+    // these are written here instead of on the heap. Once the data outgrows
+    // this, it moves to the heap and stays there until freeData().
+    static constexpr size_t kInlineDataCapacity = 256;
+    alignas(binder_size_t) uint8_t mInlineData[kInlineDataCapacity];
+
     class Blob {
     public:
         Blob();
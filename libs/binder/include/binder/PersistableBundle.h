@@ -16,8 +16,9 @@
 
 #pragma once
 
-#include <map>
+#include <memory>
 #include <set>
+#include <variant>
 #include <vector>
 
 #include <binder/Parcelable.h>
@@ -93,14 +94,7 @@ public:
     std::set<String16> getPersistableBundleKeys() const;
 
     friend bool operator==(const PersistableBundle& lhs, const PersistableBundle& rhs) {
-        return (lhs.mBoolMap == rhs.mBoolMap && lhs.mIntMap == rhs.mIntMap &&
-                lhs.mLongMap == rhs.mLongMap && lhs.mDoubleMap == rhs.mDoubleMap &&
-                lhs.mStringMap == rhs.mStringMap && lhs.mBoolVectorMap == rhs.mBoolVectorMap &&
-                lhs.mIntVectorMap == rhs.mIntVectorMap &&
-                lhs.mLongVectorMap == rhs.mLongVectorMap &&
-                lhs.mDoubleVectorMap == rhs.mDoubleVectorMap &&
-                lhs.mStringVectorMap == rhs.mStringVectorMap &&
-                lhs.mPersistableBundleMap == rhs.mPersistableBundleMap);
+        return lhs.mEntries == rhs.mEntries;
     }
 
     friend bool operator!=(const PersistableBundle& lhs, const PersistableBundle& rhs) {
@@ -108,20 +102,32 @@ public:
     }
 
 private:
+    // Alternatives are in the order in which writeToParcel() writes the types.
+    // Nested bundles are never modified once stored, so copies share them.
+    using Value = std::variant<bool, int32_t, int64_t, double, String16, std::vector<bool>,
+                               std::vector<int32_t>, std::vector<int64_t>, std::vector<double>,
+                               std::vector<String16>, std::shared_ptr<const PersistableBundle>>;
+
+    struct Entry {
+        String16 key;
+        Value value;
+
+        bool operator==(const Entry& other) const;
+    };
+
     status_t writeToParcelInner(Parcel* parcel) const;
     status_t readFromParcelInner(const Parcel* parcel, size_t length);
 
-    std::map<String16, bool> mBoolMap;
-    std::map<String16, int32_t> mIntMap;
-    std::map<String16, int64_t> mLongMap;
-    std::map<String16, double> mDoubleMap;
-    std::map<String16, String16> mStringMap;
-    std::map<String16, std::vector<bool>> mBoolVectorMap;
-    std::map<String16, std::vector<int32_t>> mIntVectorMap;
-    std::map<String16, std::vector<int64_t>> mLongVectorMap;
-    std::map<String16, std::vector<double>> mDoubleVectorMap;
-    std::map<String16, std::vector<String16>> mStringVectorMap;
-    std::map<String16, PersistableBundle> mPersistableBundleMap;
+    const Entry* find(const String16& key) const;
+    template <typename T>
+    void putValue(const String16& key, T value);
+    template <typename T>
+    bool getValue(const String16& key, T* out) const;
+    template <typename T>
+    std::set<String16> getKeys() const;
+
+    // Sorted by key. A key has one value, of any type.
+    std::vector<Entry> mEntries;
 };
 
 }  // namespace os
@@ -25,6 +25,9 @@
 
 #include <pthread.h>
 
+#include <atomic>
+#include <vector>
+
 // ---------------------------------------------------------------------------
 namespace android {
 
@@ -58,6 +61,10 @@ public:
 
     status_t setThreadPoolMaxThreadCount(size_t maxThreads);
     status_t enableOnewaySpamDetection(bool enable);
+    // Records latency histograms of binder transactions sent and served by
+    // this process, by interface and code. Also controllable at runtime
+    // with IBinder::BINDER_STATS_TRANSACTION (e.g. dumpsys --binder-stats).
+    void setBinderStatsEnabled(bool enable);
     void giveThreadPoolName();
 
     String8 getDriverName();
@@ -91,6 +98,67 @@ public:
      */
     size_t getThreadPoolMaxThreadCount() const;
 
+    /**
+     * Lets threads started at the request of the kernel leave the thread pool
+     * after being idle for 'timeoutMs', so the pool shrinks again after a
+     * burst of work. The kernel may start new threads later, up to the max
+     * thread count. The main thread never retires. 0 (the default) keeps
+     * threads forever.
+     */
+    void setThreadPoolIdleTimeout(int64_t timeoutMs);
+
+    struct ThreadPoolStats {
+        // Threads started at the request of the kernel which are still running.
+        size_t spawnedThreads = 0;
+        // Threads which left the thread pool after being idle.
+        size_t retiredThreads = 0;
+        // occupancy[i] is how many commands started executing while i other
+        // binder threads were already executing commands.
+        std::vector<uint64_t> occupancy;
+    };
+    ThreadPoolStats getThreadPoolStats();
+
+    /**
+     * Tags binder threads with a key per (interface descriptor, code) of the
+     * transaction they are executing, so that the CPU time they use can be
+     * attributed to it. 'tagThread' has the signature of
+     * android::bpf::startAggregatingTaskCpuTimes (libtimeinstate), which the
+     * caller must also set up with startTrackingProcessCpuTimes. Threads are
+     * only retagged when the key changes, so time between transactions is
+     * attributed to the last one executed. nullptr (the default) disables
+     * this; it is also disabled if 'tagThread' fails.
+     */
+    using CpuAttributionFn = bool (*)(pid_t tid, uint16_t aggregationKey);
+    void setCpuAttribution(CpuAttributionFn tagThread);
+
+    // Used once all other keys are allocated.
+    static constexpr uint16_t kCpuAttributionOtherKey = 0xFFFF;
+    struct CpuAttributionKey {
+        uint16_t key;
+        String16 descriptor;
+        uint32_t code;
+    };
+    // The keys allocated so far, to interpret the aggregated CPU times.
+    std::vector<CpuAttributionKey> getCpuAttributionKeys();
+
+    // Buffers the kernel allocated in this process' binder mmap for received
+    // transactions and replies, which were not freed yet.
+    struct BufferStats {
+        size_t outstandingBytes = 0;
+        size_t outstandingBuffers = 0;
+        // maximum of outstandingBytes so far
+        size_t highWaterBytes = 0;
+    };
+    BufferStats getBufferStats();
+    /**
+     * When outstanding buffers exceed 'bytes', the interfaces holding the
+     * most buffer space are logged, so that a leak (e.g. reply Parcels kept
+     * alive) can be found before transactions to this process start to fail
+     * for lack of space. Logged again once usage dropped below half of
+     * 'bytes'. Defaults to half of the mmap; 0 disables the warning.
+     */
+    void setBufferWarningThreshold(size_t bytes);
+
 private:
     static sp<ProcessState> init(const char* defaultDriver, bool requireDefault);
 
@@ -111,6 +179,9 @@ private:
 
     handle_entry* lookupHandleLocked(int32_t handle);
 
+    // Called by a pooled thread leaving the pool after being idle.
+    void retireIdleThread();
+
     String8 mDriverName;
     int mDriverFD;
     void* mVMStart;
@@ -127,6 +198,14 @@ private:
     size_t mMaxThreads;
     // Time when thread pool was emptied
     int64_t mStarvationStartTimeMs;
+    // Number of running threads started by BR_SPAWN_LOOPER
+    size_t mSpawnedThreads;
+    // Number of threads which left the pool because of mIdleTimeoutMs
+    size_t mRetiredThreads;
+    // See ThreadPoolStats::occupancy
+    std::vector<uint64_t> mOccupancy;
+
+    std::atomic<int64_t> mIdleTimeoutMs;
 
     mutable Mutex mLock; // protects everything below.
 
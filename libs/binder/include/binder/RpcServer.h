@@ -104,6 +104,23 @@ public:
     void setMaxThreads(size_t threads);
     size_t getMaxThreads();
 
+    /**
+     * By default, each incoming connection is served by a dedicated thread.
+     * If this is set to a non-zero value, incoming connections of all sessions
+     * are instead multiplexed with epoll onto a fixed pool of this many
+     * threads, and a thread is only taken up while a command is being
+     * processed. This is useful when there are many mostly idle sessions.
+     *
+     * A thread is busy for the duration of a transaction (including nested
+     * transactions), so this should be at least the number of transactions
+     * expected to run concurrently. The max threads of each session still
+     * controls how many connections clients open.
+     *
+     * Must be called before join().
+     */
+    void setPollingThreads(size_t threads);
+    size_t getPollingThreads();
+
     /**
      * The root object can be retrieved by any client, without any
      * authentication. TODO(b/183988761)
@@ -162,10 +179,44 @@ private:
     static void establishConnection(sp<RpcServer>&& server, base::unique_fd clientFd);
     bool setupSocketServer(const RpcSocketAddress& address);
 
+    // for setPollingThreads
+    struct PolledConnection {
+        sp<RpcSession> session;
+        // nullptr for the entry waiting on the session shutdown trigger
+        sp<RpcSession::RpcConnection> connection;
+        // being processed by a polling thread, and so not armed in epoll
+        bool busy = false;
+    };
+    struct PolledSession {
+        uint64_t triggerKey = 0;
+        size_t numConnections = 0;
+    };
+    bool startPolling();
+    void stopPolling();
+    void pollLoop();
+    void processPollEvent(uint64_t key);
+    void addPolledConnection(sp<RpcSession>&& session,
+                             RpcSession::PreJoinSetupResult&& setupResult);
+    PolledConnection forgetPolledLocked(std::map<uint64_t, PolledConnection>::iterator it);
+    static void endPolledConnection(const sp<RpcSession>& session,
+                                    const sp<RpcSession::RpcConnection>& connection);
+
     bool mAgreedExperimental = false;
     size_t mMaxThreads = 1;
+    size_t mPollingThreads = 0;
     base::unique_fd mServer; // socket we are accepting sessions on
 
+    // Only used w/ mPollingThreads. Never held when calling into a session.
+    std::mutex mPollLock; // for below
+    std::condition_variable mPollCv; // notified when mPolled shrinks
+    bool mPolling = false;
+    base::unique_fd mEpoll;
+    base::unique_fd mPollStop; // eventfd, readable once polling threads should exit
+    uint64_t mNextPollKey = 1; // 0 is mPollStop
+    std::map<uint64_t, PolledConnection> mPolled;
+    std::map<RpcSession*, PolledSession> mPolledSessions;
+    std::vector<std::thread> mPollThreads;
+
     std::mutex mLock; // for below
     std::unique_ptr<std::thread> mJoinThread;
     bool mJoinThreadRunning = false;
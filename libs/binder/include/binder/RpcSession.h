@@ -21,6 +21,7 @@
 #include <utils/Errors.h>
 #include <utils/RefBase.h>
 
+#include <atomic>
 #include <map>
 #include <optional>
 #include <thread>
@@ -59,6 +60,35 @@ public:
     void setMaxThreads(size_t threads);
     size_t getMaxThreads();
 
+    /**
+     * When enabled, oneway transactions are appended to a per-session queue
+     * instead of each waiting for exclusive use of a connection. One thread at
+     * a time writes out everything queued so far in a single write, so bursts
+     * of oneway calls (possibly from many threads) are coalesced and callers
+     * only block when the queue is full. The order of oneway calls to each
+     * binder is preserved.
+     *
+     * Since queued transactions may be written by another thread, a failure
+     * to send them shuts down the session, but is not reported to the thread
+     * making the call.
+     *
+     * By default, this is false. This may be changed at any time.
+     */
+    void setOnewayBatching(bool enabled);
+
+    /**
+     * For sessions over unix domain sockets, transactions and replies whose
+     * body is at least this many bytes are sent through a sealed memfd instead
+     * of being copied through the socket. This also avoids the limit on the
+     * size of incoming transactions. Both sides must support this, otherwise
+     * everything is sent through the socket.
+     *
+     * By default, this is 0 (disabled). This must be called before setting up
+     * this session as a client. Server sessions use the value requested by
+     * the client.
+     */
+    void setShmemThreshold(size_t bytes);
+
     /**
      * This should be called once per thread, matching 'join' in the remote
      * process.
@@ -96,6 +126,28 @@ public:
      */
     status_t getRemoteMaxThreads(size_t* maxThreads);
 
+    struct ConnectionStats {
+        // Outgoing connections currently open, and how many are allowed. Client
+        // sessions start with one, and open more on demand up to the number of
+        // threads of the server.
+        size_t outgoingConnections = 0;
+        size_t maxOutgoingConnections = 0;
+        // Threads currently waiting for a connection.
+        size_t waitingThreads = 0;
+        // Times a connection was taken for an outgoing command, and how many
+        // of those had to wait for another thread to release one.
+        uint64_t acquisitions = 0;
+        uint64_t waits = 0;
+        // Time spent waiting for or opening connections.
+        uint64_t totalWaitNs = 0;
+        uint64_t maxWaitNs = 0;
+    };
+    /**
+     * Statistics about outgoing connections, to tell whether the session is
+     * starved for connections.
+     */
+    ConnectionStats getConnectionStats();
+
     /**
      * Shuts down the service.
      *
@@ -149,6 +201,12 @@ private:
          */
         bool isTriggered();
 
+        /**
+         * Fd which gets POLLHUP once this is triggered, e.g. to wait for it with
+         * epoll. Owned by this object.
+         */
+        base::borrowed_fd pollFd() { return mRead; }
+
         /**
          * Poll for a read event.
          *
@@ -161,11 +219,17 @@ private:
         /**
          * Read, but allow the read to be interrupted by this trigger.
          *
+         * If 'syscallCount' is set, it is incremented for every syscall this
+         * makes. If 'fdOut' is set, it receives the first fd attached to the
+         * data with SCM_RIGHTS (others are closed).
+         *
          * Return:
          *   true - read succeeded at 'size'
          *   false - interrupted (failure or trigger)
          */
-        status_t interruptableReadFully(base::borrowed_fd fd, void* data, size_t size);
+        status_t interruptableReadFully(base::borrowed_fd fd, void* data, size_t size,
+                                        std::atomic<size_t>* syscallCount = nullptr,
+                                        base::unique_fd* fdOut = nullptr);
 
     private:
         base::unique_fd mWrite;
@@ -197,9 +261,14 @@ private:
         std::optional<pid_t> exclusiveTid;
 
         bool allowNested = false;
+
+        // value of mConnectionUses when this was last taken for an outgoing
+        // command, so that the least recently used connection is picked
+        uint64_t lastUse = 0;
     };
 
     status_t readId();
+    status_t negotiateShmem();
 
     // A thread joining a server must always call these functions in order, and
     // cleanup is only programmed once into join. These are in separate
@@ -248,8 +317,7 @@ private:
     private:
         static void findConnection(pid_t tid, sp<RpcConnection>* exclusive,
                                    sp<RpcConnection>* available,
-                                   std::vector<sp<RpcConnection>>& sockets,
-                                   size_t socketsIndexHint);
+                                   std::vector<sp<RpcConnection>>& sockets);
 
         sp<RpcSession> mSession; // avoid deallocation
         sp<RpcConnection> mConnection;
@@ -288,10 +356,27 @@ private:
 
     size_t mMaxThreads = 0;
 
+    std::atomic<bool> mOnewayBatching = false;
+
+    // requested by setShmemThreshold
+    size_t mShmemThreshold = 0;
+    // whether the other side may attach fds to commands, set before any
+    // connection is made
+    bool mShmemReceive = false;
+    // if non-zero, the other side accepted fds, and bodies at least this large
+    // are sent through shared memory
+    std::atomic<size_t> mShmemSendThreshold = 0;
+
     std::condition_variable mAvailableConnectionCv; // for mWaitingThreads
     size_t mWaitingThreads = 0;
-    // hint index into clients, ++ when sending an async transaction
-    size_t mOutgoingConnectionsOffset = 0;
+    // for client sessions, where more outgoing connections are opened on
+    // demand, up to mMaxOutgoingConnections
+    std::unique_ptr<RpcSocketAddress> mAddress;
+    size_t mMaxOutgoingConnections = 0;
+    // outgoing connections being opened by threads which found none available
+    size_t mConnectingOutgoing = 0;
+    uint64_t mConnectionUses = 0;
+    ConnectionStats mConnectionStats;
     std::vector<sp<RpcConnection>> mOutgoingConnections;
     std::vector<sp<RpcConnection>> mIncomingConnections;
     std::map<std::thread::id, std::thread> mThreads;
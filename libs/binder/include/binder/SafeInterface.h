@@ -447,7 +447,19 @@ protected:
     template <typename Method>
     status_t callLocal(const Parcel& data, Parcel* reply, Method method) {
         CHECK_INTERFACE(this, data, reply);
+        return callLocalUnchecked(data, reply, method);
+    }
 
+    template <typename Method>
+    status_t callLocalAsync(const Parcel& data, Parcel* reply, Method method) {
+        // reply is not actually used by CHECK_INTERFACE
+        CHECK_INTERFACE(this, data, reply);
+        return callLocalAsyncUnchecked(data, reply, method);
+    }
+
+    // Same as callLocal, but the interface token was already checked
+    template <typename Method>
+    status_t callLocalUnchecked(const Parcel& data, Parcel* reply, Method method) {
         // Since we need to both pass inputs into the call as well as retrieve outputs, we create a
         // "raw" tuple, where the inputs are interleaved with actual, non-pointer versions of the
         // outputs. When we ultimately call into the method, we will pass the addresses of the
@@ -485,11 +497,9 @@ protected:
         return NO_ERROR;
     }
 
+    // Same as callLocalAsync, but the interface token was already checked
     template <typename Method>
-    status_t callLocalAsync(const Parcel& data, Parcel* /*reply*/, Method method) {
-        // reply is not actually used by CHECK_INTERFACE
-        CHECK_INTERFACE(this, data, reply);
-
+    status_t callLocalAsyncUnchecked(const Parcel& data, Parcel* /*reply*/, Method method) {
         // Since we need to both pass inputs into the call as well as retrieve outputs, we create a
         // "raw" tuple, where the inputs are interleaved with actual, non-pointer versions of the
         // outputs. When we ultimately call into the method, we will pass the addresses of the
@@ -513,6 +523,85 @@ protected:
         return NO_ERROR;
     }
 
+    // Transaction handler of a DispatchTable. The interface token has already been checked.
+    using Handler = status_t (*)(SafeBnInterface* self, const Parcel& data, Parcel* reply);
+
+    // Handlers which do the same as callLocal and callLocalAsync. For overloaded methods, the
+    // signature must be given as with callLocal, e.g. dispatchLocal<Signature, &I::method>.
+    template <auto kMethod>
+    static status_t dispatchLocal(SafeBnInterface* self, const Parcel& data, Parcel* reply) {
+        return self->callLocalUnchecked(data, reply, kMethod);
+    }
+    template <typename Method, Method kMethod>
+    static status_t dispatchLocal(SafeBnInterface* self, const Parcel& data, Parcel* reply) {
+        return self->callLocalUnchecked(data, reply, kMethod);
+    }
+    template <auto kMethod>
+    static status_t dispatchLocalAsync(SafeBnInterface* self, const Parcel& data, Parcel* reply) {
+        return self->callLocalAsyncUnchecked(data, reply, kMethod);
+    }
+    template <typename Method, Method kMethod>
+    static status_t dispatchLocalAsync(SafeBnInterface* self, const Parcel& data, Parcel* reply) {
+        return self->callLocalAsyncUnchecked(data, reply, kMethod);
+    }
+
+    template <typename Tag>
+    struct DispatchEntry {
+        Tag tag;
+        Handler handler;
+    };
+
+    // Handlers indexed by transaction code, for onTransact implementations which would otherwise
+    // switch over every code. Tags must be the consecutive codes starting at
+    // IBinder::FIRST_CALL_TRANSACTION, which is checked at compile time when the table is
+    // constexpr.
+    template <typename Tag, size_t N>
+    class DispatchTable {
+    public:
+        constexpr explicit DispatchTable(const DispatchEntry<Tag> (&entries)[N]) : mHandlers{} {
+            for (const DispatchEntry<Tag>& entry : entries) {
+                uint32_t index = static_cast<uint32_t>(entry.tag) - IBinder::FIRST_CALL_TRANSACTION;
+                LOG_ALWAYS_FATAL_IF(index >= N || mHandlers[index] != nullptr,
+                                    "Transaction codes must be unique and consecutive");
+                mHandlers[index] = entry.handler;
+            }
+        }
+
+        static constexpr size_t size() { return N; }
+
+        // nullptr for codes which aren't in the table
+        Handler find(uint32_t code) const {
+            // codes below FIRST_CALL_TRANSACTION wrap around
+            uint32_t index = code - IBinder::FIRST_CALL_TRANSACTION;
+            return index < N ? mHandlers[index] : nullptr;
+        }
+
+    private:
+        Handler mHandlers[N];
+    };
+
+    template <typename Tag, size_t N>
+    static constexpr DispatchTable<Tag, N> makeDispatchTable(
+            const DispatchEntry<Tag> (&entries)[N]) {
+        return DispatchTable<Tag, N>(entries);
+    }
+
+    // Looks up the handler of 'code' in constant time. Other codes go to BBinder::onTransact. The
+    // interface token is compared with Interface::descriptor directly, without looking up the
+    // descriptor through getInterfaceDescriptor().
+    template <typename Tag, size_t N>
+    status_t dispatch(const DispatchTable<Tag, N>& table, uint32_t code, const Parcel& data,
+                      Parcel* reply, uint32_t flags) {
+        Handler handler = table.find(code);
+        if (handler == nullptr) {
+            return BBinder::onTransact(code, data, reply, flags);
+        }
+        if (!data.enforceInterface(Interface::descriptor)) {
+            return PERMISSION_DENIED;
+        }
+        return handler(this, data, reply);
+    }
+
 private:
     const char* const mLogTag;
 
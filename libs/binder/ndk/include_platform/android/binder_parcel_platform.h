@@ -31,6 +31,19 @@ __BEGIN_DECLS
  */
 bool AParcel_getAllowFds(const AParcel*);
 
+/**
+ * Gets the next 'size' bytes of the parcel without copying them, and moves the data position
+ * after them (padded to 4 bytes, like all data in a parcel). The data may only be 4 byte
+ * aligned, and is valid until the parcel is modified or deleted.
+ *
+ * \param parcel The parcel to read from.
+ * \param size The number of bytes to get.
+ * \param outData Set to the start of the data.
+ *
+ * \return STATUS_OK, or STATUS_NOT_ENOUGH_DATA if the parcel has less than 'size' bytes left.
+ */
+binder_status_t AParcel_readInplace(const AParcel* parcel, size_t size, const void** outData);
+
 #endif
 
 /**
@@ -0,0 +1,279 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#if !defined(__ANDROID_APEX__) && !defined(__ANDROID_VNDK__)
+
+#include <android/binder_parcel_platform.h>
+#include <android/binder_status.h>
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string_view>
+#include <vector>
+
+namespace ndk {
+
+/**
+ * Read-only view of the fields of a parcel, for readers which only need a few fields of a large
+ * parcelable. scan() and scanParcelable() go over the fields once, in order, and record where
+ * each of them is. Scalars are read during the scan. Strings and arrays are not copied: their
+ * getters point into the parcel's buffer, so they are only valid as long as the parcel isn't
+ * modified or deleted.
+ */
+class ParcelView {
+   public:
+    // How a field is laid out in the parcel.
+    enum class Field {
+        INT32,        // int, float, boolean, char, byte, and enums backed by int/byte
+        INT64,        // long, double, and enums backed by long
+        STRING,       // String, including @nullable
+        BYTE_ARRAY,   // byte[], including @nullable
+        INT32_ARRAY,  // int[], float[], boolean[], char[], including @nullable
+        INT64_ARRAY,  // long[], double[], including @nullable
+        PARCELABLE,   // a parcelable, including @nullable. Read it at position().
+    };
+
+    // Elements of an array in the parcel. They might not be aligned for T.
+    template <typename T>
+    struct Array {
+        const void* data = nullptr;
+        int32_t size = 0;
+
+        T operator[](int32_t i) const {
+            T value;
+            memcpy(&value, static_cast<const uint8_t*>(data) + i * sizeof(T), sizeof(T));
+            return value;
+        }
+    };
+
+    explicit ParcelView(const AParcel* parcel) : mParcel(parcel) {}
+
+    /**
+     * Scans a parcelable as written by AIDL generated code, from the current position. Fields
+     * after the end of the parcelable, because it was written by an older version, are not
+     * present. Unknown fields at its end, from a newer version, are skipped. On success, the
+     * position is after the parcelable.
+     */
+    binder_status_t scanParcelable(const std::vector<Field>& fields) {
+        mEntries.clear();
+        const int32_t start = AParcel_getDataPosition(mParcel);
+        int32_t parcelableSize;
+        if (binder_status_t status = AParcel_readInt32(mParcel, &parcelableSize);
+            status != STATUS_OK) {
+            return status;
+        }
+        if (parcelableSize < 4 || parcelableSize > std::numeric_limits<int32_t>::max() - start) {
+            return STATUS_BAD_VALUE;
+        }
+        const int32_t end = start + parcelableSize;
+        if (end > AParcel_getDataSize(mParcel)) return STATUS_NOT_ENOUGH_DATA;
+
+        mEntries.reserve(fields.size());
+        for (Field field : fields) {
+            if (AParcel_getDataPosition(mParcel) >= end) {
+                Entry missing;
+                missing.type = field;
+                missing.present = false;
+                mEntries.push_back(missing);
+                continue;
+            }
+            if (binder_status_t status = scanField(field); status != STATUS_OK) return status;
+        }
+        return AParcel_setDataPosition(mParcel, end);
+    }
+
+    /**
+     * Scans 'fields' from the current position. On success, the position is after the last one.
+     */
+    binder_status_t scan(const std::vector<Field>& fields) {
+        mEntries.clear();
+        mEntries.reserve(fields.size());
+        for (Field field : fields) {
+            if (binder_status_t status = scanField(field); status != STATUS_OK) return status;
+        }
+        return STATUS_OK;
+    }
+
+    size_t size() const { return mEntries.size(); }
+
+    // Whether the field was in the parcel. Getters leave their output alone for missing fields.
+    bool isPresent(size_t field) const { return field < mEntries.size() && mEntries[field].present; }
+    // Whether a nullable string, array or parcelable is null.
+    bool isNull(size_t field) const { return isPresent(field) && mEntries[field].isNull; }
+    // Where the field starts in the parcel, or -1
+    int32_t position(size_t field) const {
+        return isPresent(field) ? mEntries[field].position : -1;
+    }
+
+    binder_status_t get(size_t field, int32_t* out) const {
+        const Entry* entry;
+        if (binder_status_t status = find(field, Field::INT32, &entry); status != STATUS_OK) {
+            return status;
+        }
+        if (entry != nullptr) *out = entry->int32Value;
+        return STATUS_OK;
+    }
+
+    binder_status_t get(size_t field, int64_t* out) const {
+        const Entry* entry;
+        if (binder_status_t status = find(field, Field::INT64, &entry); status != STATUS_OK) {
+            return status;
+        }
+        if (entry != nullptr) *out = entry->int64Value;
+        return STATUS_OK;
+    }
+
+    // STATUS_UNEXPECTED_NULL for null strings
+    binder_status_t get(size_t field, std::u16string_view* out) const {
+        const Entry* entry;
+        if (binder_status_t status = find(field, Field::STRING, &entry); status != STATUS_OK) {
+            return status;
+        }
+        if (entry == nullptr) return STATUS_OK;
+        if (entry->isNull) return STATUS_UNEXPECTED_NULL;
+        *out = std::u16string_view(static_cast<const char16_t*>(entry->data), entry->length);
+        return STATUS_OK;
+    }
+
+    // T must match the size of the elements of the field. STATUS_UNEXPECTED_NULL for null arrays.
+    template <typename T>
+    binder_status_t get(size_t field, Array<T>* out) const {
+        static_assert(sizeof(T) == 1 || sizeof(T) == 4 || sizeof(T) == 8);
+        constexpr Field type = sizeof(T) == 1   ? Field::BYTE_ARRAY
+                               : sizeof(T) == 4 ? Field::INT32_ARRAY
+                                                : Field::INT64_ARRAY;
+        const Entry* entry;
+        if (binder_status_t status = find(field, type, &entry); status != STATUS_OK) {
+            return status;
+        }
+        if (entry == nullptr) return STATUS_OK;
+        if (entry->isNull) return STATUS_UNEXPECTED_NULL;
+        out->data = entry->data;
+        out->size = entry->length;
+        return STATUS_OK;
+    }
+
+   private:
+    struct Entry {
+        Field type = Field::INT32;
+        bool present = true;
+        bool isNull = false;
+        int32_t position = -1;
+        union {
+            int32_t int32Value;
+            int64_t int64Value;
+            const void* data = nullptr;
+        };
+        int32_t length = 0;  // of strings and arrays, in elements
+    };
+
+    // Sets 'entry' to null if the field is missing
+    binder_status_t find(size_t field, Field type, const Entry** entry) const {
+        if (field >= mEntries.size() || mEntries[field].type != type) return STATUS_BAD_VALUE;
+        *entry = mEntries[field].present ? &mEntries[field] : nullptr;
+        return STATUS_OK;
+    }
+
+    binder_status_t readLength(Entry* entry) {
+        if (binder_status_t status = AParcel_readInt32(mParcel, &entry->length);
+            status != STATUS_OK) {
+            return status;
+        }
+        if (entry->length < -1) return STATUS_BAD_VALUE;
+        entry->isNull = entry->length == -1;
+        return STATUS_OK;
+    }
+
+    binder_status_t readElements(Entry* entry, size_t elementSize) {
+        if (binder_status_t status = readLength(entry); status != STATUS_OK) return status;
+        if (entry->isNull) return STATUS_OK;
+        if (static_cast<size_t>(entry->length) > std::numeric_limits<int32_t>::max() / elementSize) {
+            return STATUS_BAD_VALUE;
+        }
+        return AParcel_readInplace(mParcel, entry->length * elementSize, &entry->data);
+    }
+
+    binder_status_t scanField(Field type) {
+        Entry entry;
+        entry.type = type;
+        entry.position = AParcel_getDataPosition(mParcel);
+        binder_status_t status = STATUS_OK;
+        switch (type) {
+            case Field::INT32:
+                status = AParcel_readInt32(mParcel, &entry.int32Value);
+                break;
+            case Field::INT64:
+                status = AParcel_readInt64(mParcel, &entry.int64Value);
+                break;
+            case Field::STRING:
+                // UTF-16, with a terminating 0 which isn't included in the length
+                status = readLength(&entry);
+                if (status != STATUS_OK || entry.isNull) break;
+                if (entry.length >= std::numeric_limits<int32_t>::max() / 2) {
+                    status = STATUS_BAD_VALUE;
+                    break;
+                }
+                status = AParcel_readInplace(mParcel, (entry.length + 1) * sizeof(char16_t),
+                                             &entry.data);
+                if (status == STATUS_OK &&
+                    static_cast<const char16_t*>(entry.data)[entry.length] != u'\0') {
+                    status = STATUS_BAD_VALUE;
+                }
+                break;
+            case Field::BYTE_ARRAY:
+                status = readElements(&entry, 1);
+                break;
+            case Field::INT32_ARRAY:
+                status = readElements(&entry, 4);
+                break;
+            case Field::INT64_ARRAY:
+                status = readElements(&entry, 8);
+                break;
+            case Field::PARCELABLE: {
+                int32_t nonNull;
+                status = AParcel_readInt32(mParcel, &nonNull);
+                if (status != STATUS_OK) break;
+                entry.isNull = nonNull == 0;
+                if (entry.isNull) break;
+                // skipped with its size header, which includes the header itself
+                const int32_t start = AParcel_getDataPosition(mParcel);
+                int32_t parcelableSize;
+                status = AParcel_readInt32(mParcel, &parcelableSize);
+                if (status != STATUS_OK) break;
+                if (parcelableSize < 4 ||
+                    parcelableSize > std::numeric_limits<int32_t>::max() - start ||
+                    start + parcelableSize > AParcel_getDataSize(mParcel)) {
+                    status = STATUS_BAD_VALUE;
+                    break;
+                }
+                status = AParcel_setDataPosition(mParcel, start + parcelableSize);
+                break;
+            }
+        }
+        if (status == STATUS_OK) mEntries.push_back(entry);
+        return status;
+    }
+
+    const AParcel* mParcel;
+    std::vector<Entry> mEntries;
+};
+
+}  // namespace ndk
+
+#endif
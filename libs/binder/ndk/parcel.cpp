@@ -22,6 +22,7 @@
 #include "status_internal.h"
 
 #include <limits>
+#include <type_traits>
 
 #include <android-base/logging.h>
 #include <android-base/unique_fd.h>
@@ -105,14 +106,14 @@ binder_status_t WriteArray<char16_t>(AParcel* parcel, const char16_t* array, int
     if (length <= 0) return STATUS_OK;
 
     int32_t size = 0;
-    if (__builtin_smul_overflow(sizeof(char16_t), length, &size)) return STATUS_NO_MEMORY;
+    if (__builtin_smul_overflow(sizeof(int32_t), length, &size)) return STATUS_NO_MEMORY;
 
-    Parcel* rawParcel = parcel->get();
+    // reserve space for the whole array at once, rather than growing per element
+    int32_t* const data = static_cast<int32_t*>(parcel->get()->writeInplace(size));
+    if (data == nullptr) return STATUS_NO_MEMORY;
 
     for (int32_t i = 0; i < length; i++) {
-        status = rawParcel->writeChar(array[i]);
-
-        if (status != STATUS_OK) return PruneStatusT(status);
+        data[i] = static_cast<int32_t>(array[i]);
     }
 
     return STATUS_OK;
@@ -163,40 +164,50 @@ binder_status_t ReadArray<char16_t>(const AParcel* parcel, void* arrayData,
     if (array == nullptr) return STATUS_NO_MEMORY;
 
     int32_t size = 0;
-    if (__builtin_smul_overflow(sizeof(char16_t), length, &size)) return STATUS_NO_MEMORY;
+    if (__builtin_smul_overflow(sizeof(int32_t), length, &size)) return STATUS_NO_MEMORY;
 
-    for (int32_t i = 0; i < length; i++) {
-        status_t status = rawParcel->readChar(array + i);
+    const int32_t* const data = static_cast<const int32_t*>(rawParcel->readInplace(size));
+    if (data == nullptr) return STATUS_NO_MEMORY;
 
-        if (status != STATUS_OK) return PruneStatusT(status);
+    for (int32_t i = 0; i < length; i++) {
+        array[i] = static_cast<char16_t>(data[i]);
     }
 
     return STATUS_OK;
 }
 
+// Each element is converted to an int32_t (not packed), as in Parcel::writeBool. Only the
+// elements themselves go through the getter, space in the parcel is reserved once.
 template <typename T>
 binder_status_t WriteArray(AParcel* parcel, const void* arrayData, int32_t length,
-                           ArrayGetter<T> getter, status_t (Parcel::*write)(T)) {
+                           ArrayGetter<T> getter) {
+    static_assert(std::is_same_v<T, bool>, "only bool arrays need a getter");
+
     // we have no clue if arrayData represents a null object or not, we can only infer from length
     bool arrayIsNull = length < 0;
     binder_status_t status = WriteAndValidateArraySize(parcel, arrayIsNull, length);
     if (status != STATUS_OK) return status;
     if (length <= 0) return STATUS_OK;
 
-    Parcel* rawParcel = parcel->get();
+    int32_t size = 0;
+    if (__builtin_smul_overflow(sizeof(int32_t), length, &size)) return STATUS_NO_MEMORY;
 
-    for (int32_t i = 0; i < length; i++) {
-        status = (rawParcel->*write)(getter(arrayData, i));
+    int32_t* const data = static_cast<int32_t*>(parcel->get()->writeInplace(size));
+    if (data == nullptr) return STATUS_NO_MEMORY;
 
-        if (status != STATUS_OK) return PruneStatusT(status);
+    for (int32_t i = 0; i < length; i++) {
+        data[i] = getter(arrayData, i) ? 1 : 0;
     }
 
     return STATUS_OK;
 }
 
+// Each element is read from an int32_t (not packed), as in Parcel::readBool.
 template <typename T>
 binder_status_t ReadArray(const AParcel* parcel, void* arrayData, ArrayAllocator<T> allocator,
-                          ArraySetter<T> setter, status_t (Parcel::*read)(T*) const) {
+                          ArraySetter<T> setter) {
+    static_assert(std::is_same_v<T, bool>, "only bool arrays need a setter");
+
     const Parcel* rawParcel = parcel->get();
 
     int32_t length;
@@ -208,12 +219,14 @@ binder_status_t ReadArray(const AParcel* parcel, void* arrayData, ArrayAllocator
 
     if (length <= 0) return STATUS_OK;
 
-    for (int32_t i = 0; i < length; i++) {
-        T readTarget;
-        status_t status = (rawParcel->*read)(&readTarget);
-        if (status != STATUS_OK) return PruneStatusT(status);
+    int32_t size = 0;
+    if (__builtin_smul_overflow(sizeof(int32_t), length, &size)) return STATUS_NO_MEMORY;
+
+    const int32_t* const data = static_cast<const int32_t*>(rawParcel->readInplace(size));
+    if (data == nullptr) return STATUS_NO_MEMORY;
 
-        setter(arrayData, i, readTarget);
+    for (int32_t i = 0; i < length; i++) {
+        setter(arrayData, i, data[i] != 0);
     }
 
     return STATUS_OK;
@@ -240,6 +253,15 @@ void AParcel_markSensitive(const AParcel* parcel) {
     return parcel->get()->markSensitive();
 }
 
+binder_status_t AParcel_readInplace(const AParcel* parcel, size_t size, const void** outData) {
+    const void* data = parcel->get()->readInplace(size);
+    if (data == nullptr) {
+        return STATUS_NOT_ENOUGH_DATA;
+    }
+    *outData = data;
+    return STATUS_OK;
+}
+
 binder_status_t AParcel_writeStrongBinder(AParcel* parcel, AIBinder* binder) {
     sp<IBinder> writeBinder = binder != nullptr ? binder->getBinder() : nullptr;
     return parcel->get()->writeStrongBinder(writeBinder);
@@ -594,7 +616,7 @@ binder_status_t AParcel_writeDoubleArray(AParcel* parcel, const double* arrayDat
 
 binder_status_t AParcel_writeBoolArray(AParcel* parcel, const void* arrayData, int32_t length,
                                        AParcel_boolArrayGetter getter) {
-    return WriteArray<bool>(parcel, arrayData, length, getter, &Parcel::writeBool);
+    return WriteArray<bool>(parcel, arrayData, length, getter);
 }
 
 binder_status_t AParcel_writeCharArray(AParcel* parcel, const char16_t* arrayData, int32_t length) {
@@ -638,7 +660,7 @@ binder_status_t AParcel_readDoubleArray(const AParcel* parcel, void* arrayData,
 binder_status_t AParcel_readBoolArray(const AParcel* parcel, void* arrayData,
                                       AParcel_boolArrayAllocator allocator,
                                       AParcel_boolArraySetter setter) {
-    return ReadArray<bool>(parcel, arrayData, allocator, setter, &Parcel::readBool);
+    return ReadArray<bool>(parcel, arrayData, allocator, setter);
 }
 
 binder_status_t AParcel_readCharArray(const AParcel* parcel, void* arrayData,
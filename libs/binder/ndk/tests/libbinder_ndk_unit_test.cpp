@@ -22,6 +22,7 @@
 #include <android/binder_ibinder_platform.h>
 #include <android/binder_libbinder.h>
 #include <android/binder_manager.h>
+#include <android/binder_parcel_view.h>
 #include <android/binder_process.h>
 #include <gtest/gtest.h>
 #include <iface/iface.h>
@@ -647,6 +648,92 @@ TEST(NdkBinder, GetClassInterfaceDescriptor) {
     ASSERT_STREQ(IFoo::kIFooDescriptor, AIBinder_Class_getDescriptor(IFoo::kClass));
 }
 
+// Writes a parcelable the way generated code does, with the given number of fields
+static void writeViewParcelable(AParcel* parcel, int fieldCount) {
+    const int32_t start = AParcel_getDataPosition(parcel);
+    ASSERT_EQ(STATUS_OK, AParcel_writeInt32(parcel, 0));
+    const int32_t ints[] = {1, 2, 3};
+    if (fieldCount > 0) ASSERT_EQ(STATUS_OK, AParcel_writeInt32(parcel, 42));
+    if (fieldCount > 1) ASSERT_EQ(STATUS_OK, AParcel_writeString(parcel, "hello", 5));
+    if (fieldCount > 2) ASSERT_EQ(STATUS_OK, AParcel_writeInt32Array(parcel, ints, 3));
+    if (fieldCount > 3) ASSERT_EQ(STATUS_OK, AParcel_writeInt32Array(parcel, nullptr, -1));
+    if (fieldCount > 4) {
+        // a nested parcelable with a single long
+        ASSERT_EQ(STATUS_OK, AParcel_writeInt32(parcel, 1));
+        ASSERT_EQ(STATUS_OK, AParcel_writeInt32(parcel, 12));
+        ASSERT_EQ(STATUS_OK, AParcel_writeInt64(parcel, 7));
+    }
+    if (fieldCount > 5) ASSERT_EQ(STATUS_OK, AParcel_writeInt64(parcel, -1));
+    if (fieldCount > 6) ASSERT_EQ(STATUS_OK, AParcel_writeInt32(parcel, 1234));
+    const int32_t end = AParcel_getDataPosition(parcel);
+    ASSERT_EQ(STATUS_OK, AParcel_setDataPosition(parcel, start));
+    ASSERT_EQ(STATUS_OK, AParcel_writeInt32(parcel, end - start));
+    ASSERT_EQ(STATUS_OK, AParcel_setDataPosition(parcel, end));
+}
+
+TEST(NdkBinder, ParcelView) {
+    using Field = ndk::ParcelView::Field;
+    const std::vector<Field> fields = {Field::INT32,       Field::STRING,     Field::INT32_ARRAY,
+                                       Field::INT32_ARRAY, Field::PARCELABLE, Field::INT64};
+
+    // same version, then an older one, then a newer one, then a trailing int
+    AParcel* parcel = AParcel_create();
+    writeViewParcelable(parcel, 6);
+    writeViewParcelable(parcel, 2);
+    writeViewParcelable(parcel, 7);
+    ASSERT_EQ(STATUS_OK, AParcel_writeInt32(parcel, 99));
+    ASSERT_EQ(STATUS_OK, AParcel_setDataPosition(parcel, 0));
+
+    ndk::ParcelView view(parcel);
+    ASSERT_EQ(STATUS_OK, view.scanParcelable(fields));
+    ASSERT_EQ(fields.size(), view.size());
+
+    int32_t i32 = 0;
+    EXPECT_EQ(STATUS_OK, view.get(0, &i32));
+    EXPECT_EQ(42, i32);
+    std::u16string_view str;
+    EXPECT_EQ(STATUS_OK, view.get(1, &str));
+    EXPECT_EQ(u"hello", str);
+    ndk::ParcelView::Array<int32_t> ints;
+    EXPECT_EQ(STATUS_OK, view.get(2, &ints));
+    ASSERT_EQ(3, ints.size);
+    EXPECT_EQ(3, ints[2]);
+    EXPECT_TRUE(view.isNull(3));
+    EXPECT_EQ(STATUS_UNEXPECTED_NULL, view.get(3, &ints));
+    EXPECT_FALSE(view.isNull(4));
+    int64_t i64 = 0;
+    EXPECT_EQ(STATUS_OK, view.get(5, &i64));
+    EXPECT_EQ(-1, i64);
+    // wrong type or index
+    EXPECT_EQ(STATUS_BAD_VALUE, view.get(5, &i32));
+    EXPECT_EQ(STATUS_BAD_VALUE, view.get(6, &i32));
+
+    // the nested parcelable is read where it was recorded
+    const int32_t next = AParcel_getDataPosition(parcel);
+    ASSERT_EQ(STATUS_OK, AParcel_setDataPosition(parcel, view.position(4) + 4));
+    ndk::ParcelView nested(parcel);
+    ASSERT_EQ(STATUS_OK, nested.scanParcelable({Field::INT64}));
+    EXPECT_EQ(STATUS_OK, nested.get(0, &i64));
+    EXPECT_EQ(7, i64);
+    ASSERT_EQ(STATUS_OK, AParcel_setDataPosition(parcel, next));
+
+    ASSERT_EQ(STATUS_OK, view.scanParcelable(fields));
+    EXPECT_TRUE(view.isPresent(1));
+    EXPECT_FALSE(view.isPresent(2));
+    i64 = 5;
+    EXPECT_EQ(STATUS_OK, view.get(5, &i64));
+    EXPECT_EQ(5, i64);
+
+    ASSERT_EQ(STATUS_OK, view.scanParcelable(fields));
+    EXPECT_TRUE(view.isPresent(5));
+    ASSERT_EQ(STATUS_OK, view.scan({Field::INT32}));
+    EXPECT_EQ(STATUS_OK, view.get(0, &i32));
+    EXPECT_EQ(99, i32);
+    EXPECT_EQ(AParcel_getDataSize(parcel), AParcel_getDataPosition(parcel));
+
+    AParcel_delete(parcel);
+}
+
 int main(int argc, char* argv[]) {
     ::testing::InitGoogleTest(&argc, argv);
 
@@ -147,6 +147,33 @@ TEST(BinderAllocation, ParcelOnStack) {
     imaginary_use = p.data();
 }
 
+TEST(BinderAllocation, SmallParcelWrites) {
+    Parcel p;
+    {
+        const auto m = ScopeDisallowMalloc();
+        for (int32_t i = 0; i < 32; i++) {
+            EXPECT_EQ(android::OK, p.writeInt32(i));
+        }
+        p.setDataPosition(0);
+        for (int32_t i = 0; i < 32; i++) {
+            EXPECT_EQ(i, p.readInt32());
+        }
+    }
+
+    // growing past the inline buffer moves the data to the heap
+    std::vector<uint8_t> big(1024);
+    size_t mallocs = 0;
+    {
+        const auto on_malloc = OnMalloc([&](size_t) { mallocs++; });
+        EXPECT_EQ(android::OK, p.write(big.data(), big.size()));
+    }
+    EXPECT_EQ(mallocs, 1);
+    p.setDataPosition(0);
+    for (int32_t i = 0; i < 32; i++) {
+        EXPECT_EQ(i, p.readInt32());
+    }
+}
+
 TEST(BinderAllocation, GetServiceManager) {
     defaultServiceManager(); // first call may alloc
     const auto m = ScopeDisallowMalloc();
@@ -164,15 +191,9 @@ TEST(BinderAllocation, SmallTransaction) {
     String16 empty_descriptor = String16("");
     sp<IServiceManager> manager = defaultServiceManager();
 
-    size_t mallocs = 0;
-    const auto on_malloc = OnMalloc([&](size_t bytes) {
-        mallocs++;
-        // Parcel should allocate a small amount by default
-        EXPECT_EQ(bytes, 128);
-    });
+    // small parcels are written inline, so this doesn't allocate
+    const auto m = ScopeDisallowMalloc();
     manager->checkService(empty_descriptor);
-
-    EXPECT_EQ(mallocs, 1);
 }
 
 int main(int argc, char** argv) {
@@ -22,6 +22,7 @@
 
 #include <chrono>
 #include <fstream>
+#include <future>
 #include <thread>
 
 #include <gmock/gmock.h>
@@ -57,6 +58,8 @@ using namespace std::chrono_literals;
 using android::base::testing::HasValue;
 using android::base::testing::Ok;
 using testing::ExplainMatchResult;
+using testing::HasSubstr;
+using testing::MatchesRegex;
 using testing::Not;
 using testing::WithParamInterface;
 
@@ -463,6 +466,44 @@ TEST_F(BinderLibTest, NopTransactionClear) {
                 StatusEq(NO_ERROR));
 }
 
+TEST_F(BinderLibTest, BinderStats) {
+    std::string stats;
+    EXPECT_THAT(m_server->getBinderStats(IBinder::BINDER_STATS_RESET, &stats), StatusEq(OK));
+    EXPECT_THAT(m_server->getBinderStats(IBinder::BINDER_STATS_ENABLE, &stats), StatusEq(OK));
+
+    Parcel data, reply;
+    EXPECT_THAT(m_server->transact(BINDER_LIB_TEST_NOP_TRANSACTION, data, &reply),
+                StatusEq(NO_ERROR));
+
+    EXPECT_THAT(m_server->getBinderStats(IBinder::BINDER_STATS_DISABLE, &stats), StatusEq(OK));
+    EXPECT_THAT(stats, HasSubstr("Binder stats (disabled)"));
+    EXPECT_THAT(stats,
+                HasSubstr("code " + std::to_string(BINDER_LIB_TEST_NOP_TRANSACTION) +
+                          ": count 1 "));
+}
+
+TEST_F(BinderLibTest, TransactionHistory) {
+    Parcel data, reply;
+    EXPECT_THAT(m_server->transact(BINDER_LIB_TEST_NOP_TRANSACTION, data, &reply),
+                StatusEq(NO_ERROR));
+
+    std::string history;
+    EXPECT_THAT(m_server->getTransactionHistory(&history), StatusEq(OK));
+    EXPECT_THAT(history,
+                HasSubstr("code " + std::to_string(BINDER_LIB_TEST_NOP_TRANSACTION) +
+                          " from pid " + std::to_string(getpid()) + ", "));
+    // the history request itself is still in flight while it is dumped
+    EXPECT_THAT(history, HasSubstr("in flight"));
+
+    // and the client side of the same transaction is recorded here
+    sp<IBinder> local = sp<BBinder>::make();
+    EXPECT_THAT(local->getTransactionHistory(&history), StatusEq(OK));
+    EXPECT_THAT(history,
+                MatchesRegex(".*client handle [0-9]+ code " +
+                             std::to_string(BINDER_LIB_TEST_NOP_TRANSACTION) +
+                             ", [0-9]+ bytes, started [0-9]+us ago, took [0-9]+us.*"));
+}
+
 TEST_F(BinderLibTest, Freeze) {
     Parcel data, reply, replypid;
     std::ifstream freezer_file("/sys/fs/cgroup/freezer/cgroup.freeze");
@@ -638,6 +679,116 @@ TEST_F(BinderLibTest, CallBack)
     EXPECT_THAT(callBack->getResult(), StatusEq(NO_ERROR));
 }
 
+TEST_F(BinderLibTest, ThreadPoolStatsCountCallBack)
+{
+    auto countCommands = [] {
+        uint64_t count = 0;
+        for (uint64_t c : ProcessState::self()->getThreadPoolStats().occupancy) count += c;
+        return count;
+    };
+    uint64_t before = countCommands();
+
+    Parcel data, reply;
+    sp<BinderLibTestCallBack> callBack = new BinderLibTestCallBack();
+    data.writeStrongBinder(callBack);
+    EXPECT_THAT(m_server->transact(BINDER_LIB_TEST_NOP_CALL_BACK, data, &reply, TF_ONE_WAY),
+                StatusEq(NO_ERROR));
+    EXPECT_THAT(callBack->waitEvent(5), StatusEq(NO_ERROR));
+
+    // the callback was executed by a thread of this process' pool
+    EXPECT_GT(countCommands(), before);
+    EXPECT_EQ(0u, ProcessState::self()->getThreadPoolStats().retiredThreads);
+}
+
+static std::atomic<pid_t> gCpuAttributionTid = 0;
+static std::atomic<uint16_t> gCpuAttributionKey = 0;
+
+TEST_F(BinderLibTest, CpuAttributionTagsCallBackThread) {
+    ProcessState::self()->setCpuAttribution([](pid_t tid, uint16_t key) {
+        gCpuAttributionTid = tid;
+        gCpuAttributionKey = key;
+        return true;
+    });
+
+    Parcel data, reply;
+    sp<BinderLibTestCallBack> callBack = new BinderLibTestCallBack();
+    data.writeStrongBinder(callBack);
+    EXPECT_THAT(m_server->transact(BINDER_LIB_TEST_NOP_CALL_BACK, data, &reply, TF_ONE_WAY),
+                StatusEq(NO_ERROR));
+    EXPECT_THAT(callBack->waitEvent(5), StatusEq(NO_ERROR));
+    ProcessState::self()->setCpuAttribution(nullptr);
+
+    // the thread of this process' pool which ran the callback was tagged
+    EXPECT_NE(0, gCpuAttributionTid.load());
+    uint16_t key = gCpuAttributionKey.load();
+    ASSERT_NE(0, key);
+
+    bool found = false;
+    for (const auto& k : ProcessState::self()->getCpuAttributionKeys()) {
+        if (k.key != key) continue;
+        found = true;
+        EXPECT_EQ(String16(), k.descriptor);
+        EXPECT_EQ(static_cast<uint32_t>(BINDER_LIB_TEST_CALL_BACK), k.code);
+    }
+    EXPECT_TRUE(found);
+}
+
+TEST_F(BinderLibTest, CheckServices) {
+    Vector<String16> names;
+    names.push(binderLibTestServiceName);
+    names.push(String16("test.binderLib.does.not.exist"));
+
+    Vector<sp<IBinder>> services = defaultServiceManager()->checkServices(names);
+    ASSERT_EQ(2u, services.size());
+    EXPECT_EQ(m_server, services[0]);
+    EXPECT_EQ(nullptr, services[1]);
+
+    // served from the cache the second time, with the same result
+    EXPECT_EQ(m_server, defaultServiceManager()->checkService(binderLibTestServiceName));
+}
+
+TEST_F(BinderLibTest, BufferStatsCountHeldReplies) {
+    ProcessState::BufferStats before = ProcessState::self()->getBufferStats();
+    {
+        std::vector<Parcel> replies(3);
+        for (Parcel& reply : replies) {
+            Parcel data;
+            EXPECT_THAT(m_server->transact(BINDER_LIB_TEST_NOP_TRANSACTION, data, &reply),
+                        StatusEq(NO_ERROR));
+        }
+        ProcessState::BufferStats held = ProcessState::self()->getBufferStats();
+        EXPECT_GE(held.outstandingBuffers, before.outstandingBuffers + replies.size());
+        EXPECT_GE(held.highWaterBytes, held.outstandingBytes);
+    }
+    IPCThreadState::self()->flushCommands();
+    EXPECT_LE(ProcessState::self()->getBufferStats().outstandingBuffers,
+              before.outstandingBuffers);
+}
+
+TEST_F(BinderLibTest, WaitForServiceAsync) {
+    sp<IServiceManager> sm = defaultServiceManager();
+
+    std::promise<sp<IBinder>> registered;
+    sm->waitForServiceAsync(binderLibTestServiceName,
+                            [&](const sp<IBinder>& service) { registered.set_value(service); });
+    // already registered, so called back right away
+    EXPECT_EQ(m_server, registered.get_future().get());
+
+    const String16 name = String16("test.binderLib.waitForServiceAsync.") +
+            String16(binderserversuffix);
+    auto promise = std::make_shared<std::promise<sp<IBinder>>>();
+    std::future<sp<IBinder>> future = promise->get_future();
+    sm->waitForServiceAsync(name, [promise](const sp<IBinder>& service) {
+        promise->set_value(service);
+    });
+    EXPECT_EQ(std::future_status::timeout, future.wait_for(100ms));
+
+    sp<IBinder> binder = sp<BBinder>::make();
+    EXPECT_THAT(sm->addService(name, binder), StatusEq(OK));
+    ASSERT_EQ(std::future_status::ready, future.wait_for(5s));
+    EXPECT_EQ(binder, future.get());
+}
+
 TEST_F(BinderLibTest, BinderCallContextGuard) {
     sp<IBinder> binder = addServer();
     Parcel data, reply;
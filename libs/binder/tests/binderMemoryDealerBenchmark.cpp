@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <binder/MemoryDealer.h>
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+// Usage: atest binderMemoryDealerBenchmark
+
+using android::IMemory;
+using android::MemoryDealer;
+using android::sp;
+
+static constexpr size_t kHeapSize = 4 * 1024 * 1024;
+static constexpr size_t kChunksPerIteration = 32;
+
+static sp<MemoryDealer> getDealer(MemoryDealer::AllocationPolicy policy) {
+    // shared by all threads of a benchmark, like a media heap shared by clients
+    static sp<MemoryDealer> bestFit =
+            sp<MemoryDealer>::make(kHeapSize, "bestfit", 0,
+                                   MemoryDealer::AllocationPolicy::BEST_FIT);
+    static sp<MemoryDealer> sizeClasses =
+            sp<MemoryDealer>::make(kHeapSize, "sizeclasses", 0,
+                                   MemoryDealer::AllocationPolicy::SIZE_CLASSES);
+    return policy == MemoryDealer::AllocationPolicy::BEST_FIT ? bestFit : sizeClasses;
+}
+
+static void BM_AllocateSmall(benchmark::State& state, MemoryDealer::AllocationPolicy policy) {
+    sp<MemoryDealer> dealer = getDealer(policy);
+    std::vector<sp<IMemory>> chunks;
+    chunks.reserve(kChunksPerIteration);
+
+    // keep some long lived allocations around, so that the free list isn't trivial
+    std::vector<sp<IMemory>> background;
+    for (size_t i = 0; i < 64; i++) background.push_back(dealer->allocate(64 + (i % 8) * 96));
+
+    for (auto _ : state) {
+        for (size_t i = 0; i < kChunksPerIteration; i++) {
+            sp<IMemory> chunk = dealer->allocate(32 << (i % 6));
+            if (chunk == nullptr) {
+                state.SkipWithError("Out of memory");
+                return;
+            }
+            chunks.push_back(std::move(chunk));
+        }
+        chunks.clear();
+    }
+    state.SetItemsProcessed(state.iterations() * kChunksPerIteration);
+}
+
+BENCHMARK_CAPTURE(BM_AllocateSmall, BestFit, MemoryDealer::AllocationPolicy::BEST_FIT)
+        ->ThreadRange(1, 8)
+        ->UseRealTime();
+BENCHMARK_CAPTURE(BM_AllocateSmall, SizeClasses, MemoryDealer::AllocationPolicy::SIZE_CLASSES)
+        ->ThreadRange(1, 8)
+        ->UseRealTime();
+
+BENCHMARK_MAIN();
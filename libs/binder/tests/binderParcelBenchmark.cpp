@@ -15,6 +15,7 @@
  */
 
 #include <binder/Parcel.h>
+#include <binder/PersistableBundle.h>
 #include <benchmark/benchmark.h>
 
 // Usage: atest binderParcelBenchmark
@@ -163,6 +164,63 @@ static void BM_Int64Vector(benchmark::State& state) {
     BM_ParcelVector<int64_t>(state);
 }
 
+/*
+  A new Parcel written with a few words, as for a ping or getter. Small
+  parcels use the inline buffer, so 'heapParcels' should be 0 until the data
+  no longer fits in it.
+*/
+static void BM_SmallParcel(benchmark::State& state) {
+    const size_t words = state.range(0);
+    size_t heapParcels = 0;
+
+    while (state.KeepRunning()) {
+        android::Parcel p;
+        for (size_t i = 0; i < words; i++) {
+            p.writeInt32(i);
+        }
+        heapParcels += android::Parcel::getGlobalAllocCount();
+
+        benchmark::DoNotOptimize(p.data());
+        benchmark::ClobberMemory();
+    }
+    state.counters["heapParcels"] =
+            benchmark::Counter(heapParcels, benchmark::Counter::kAvgIterations);
+}
+
+/*
+  A PersistableBundle with 'keys' entries of mixed types, written to a Parcel
+  and read back into a new bundle, as when passing configuration around.
+*/
+static void BM_PersistableBundle(benchmark::State& state) {
+    const size_t keys = state.range(0);
+
+    android::os::PersistableBundle bundle;
+    for (size_t i = 0; i < keys; i++) {
+        android::String16 key(("config.key." + std::to_string(i)).c_str());
+        switch (i % 4) {
+            case 0: bundle.putInt(key, i); break;
+            case 1: bundle.putBoolean(key, i % 2); break;
+            case 2: bundle.putString(key, android::String16("some value")); break;
+            case 3: bundle.putLongVector(key, {1, 2, 3, 4}); break;
+        }
+    }
+
+    android::Parcel p;
+    while (state.KeepRunning()) {
+        p.setDataPosition(0);
+        bundle.writeToParcel(&p);
+
+        p.setDataPosition(0);
+        android::os::PersistableBundle out;
+        out.readFromParcel(&p);
+
+        benchmark::DoNotOptimize(out.size());
+        benchmark::ClobberMemory();
+    }
+}
+
+BENCHMARK(BM_SmallParcel)->Apply(VectorArgs);
+BENCHMARK(BM_PersistableBundle)->Arg(4)->Arg(12)->Arg(48);
 BENCHMARK(BM_BoolVector)->Apply(VectorArgs);
 BENCHMARK(BM_ByteVector)->Apply(VectorArgs);
 BENCHMARK(BM_CharVector)->Apply(VectorArgs);
@@ -26,6 +26,8 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include "../RpcState.h" // for syscall counts
+
 using android::BBinder;
 using android::IBinder;
 using android::interface_cast;
@@ -48,7 +50,24 @@ class MyBinderRpcBenchmark : public BnBinderRpcBenchmark {
 
 static sp<RpcSession> gSession = RpcSession::make();
 
+// Reports the number of client-side socket syscalls made per iteration.
+class SyscallCounter {
+public:
+    explicit SyscallCounter(benchmark::State& state)
+          : mState(state), mStart(gSession->state()->countSyscalls()) {}
+    ~SyscallCounter() {
+        mState.counters["syscalls/txn"] =
+                benchmark::Counter(gSession->state()->countSyscalls() - mStart,
+                                   benchmark::Counter::kAvgIterations);
+    }
+
+private:
+    benchmark::State& mState;
+    size_t mStart;
+};
+
 void BM_getRootObject(benchmark::State& state) {
+    SyscallCounter counter(state);
     while (state.KeepRunning()) {
         CHECK(gSession->getRootObject() != nullptr);
     }
@@ -59,6 +78,7 @@ void BM_pingTransaction(benchmark::State& state) {
     sp<IBinder> binder = gSession->getRootObject();
     CHECK(binder != nullptr);
 
+    SyscallCounter counter(state);
     while (state.KeepRunning()) {
         CHECK_EQ(OK, binder->pingBinder());
     }
@@ -86,6 +106,7 @@ void BM_repeatString(benchmark::State& state) {
     std::string str = std::string(getpagesize() * 2, 'a');
     CHECK_EQ(str.size(), getpagesize() * 2);
 
+    SyscallCounter counter(state);
     while (state.KeepRunning()) {
         std::string out;
         Status ret = iface->repeatString(str, &out);
@@ -100,6 +121,7 @@ void BM_repeatBinder(benchmark::State& state) {
     sp<IBinderRpcBenchmark> iface = interface_cast<IBinderRpcBenchmark>(binder);
     CHECK(iface != nullptr);
 
+    SyscallCounter counter(state);
     while (state.KeepRunning()) {
         // force creation of a new address
         sp<IBinder> binder = sp<BBinder>::make();
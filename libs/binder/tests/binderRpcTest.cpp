@@ -393,7 +393,8 @@ public:
     // threads.
     ProcessSession createRpcTestSocketServerProcess(
             size_t numThreads, size_t numSessions, size_t numReverseConnections,
-            const std::function<void(const sp<RpcServer>&)>& configure) {
+            const std::function<void(const sp<RpcServer>&)>& configure,
+            size_t shmemThreshold = 0) {
         CHECK_GE(numSessions, 1) << "Must have at least one session to a server";
 
         SocketType socketType = GetParam();
@@ -448,6 +449,7 @@ public:
         for (size_t i = 0; i < numSessions; i++) {
             sp<RpcSession> session = RpcSession::make();
             session->setMaxThreads(numReverseConnections);
+            session->setShmemThreshold(shmemThreshold);
 
             switch (socketType) {
                 case SocketType::UNIX:
@@ -471,7 +473,8 @@ public:
 
     BinderRpcTestProcessSession createRpcTestSocketServerProcess(size_t numThreads,
                                                                  size_t numSessions = 1,
-                                                                 size_t numReverseConnections = 0) {
+                                                                 size_t numReverseConnections = 0,
+                                                                 size_t numPollingThreads = 0) {
         BinderRpcTestProcessSession ret{
                 .proc = createRpcTestSocketServerProcess(numThreads, numSessions,
                                                          numReverseConnections,
@@ -479,6 +482,8 @@ public:
                                                              sp<MyBinderRpcTest> service =
                                                                      new MyBinderRpcTest;
                                                              server->setRootObject(service);
+                                                             server->setPollingThreads(
+                                                                     numPollingThreads);
                                                              service->server = server;
                                                          }),
         };
@@ -558,6 +563,26 @@ TEST_P(BinderRpc, SendAndGetResultBackBig) {
     EXPECT_EQ(single + single, doubled);
 }
 
+TEST_P(BinderRpc, SendAndGetResultBackShmem) {
+    if (GetParam() != SocketType::UNIX) GTEST_SKIP() << "shmem requires unix domain sockets";
+
+    auto proc = createRpcTestSocketServerProcess(
+            1 /*threads*/, 1 /*sessions*/, 0 /*reverse*/,
+            [](const sp<RpcServer>& server) { server->setRootObject(new MyBinderRpcTest); },
+            4096 /*shmemThreshold*/);
+    sp<IBinderRpcTest> iface = interface_cast<IBinderRpcTest>(proc.sessions.at(0).root);
+
+    // larger than any inline transaction allowed
+    std::string single = std::string(200 * 1000, 'a');
+    std::string doubled;
+    EXPECT_OK(iface->doubleString(single, &doubled));
+    EXPECT_EQ(single + single, doubled);
+
+    // small transactions still go inline
+    EXPECT_OK(iface->doubleString("cool ", &doubled));
+    EXPECT_EQ("cool cool ", doubled);
+}
+
 TEST_P(BinderRpc, CallMeBack) {
     auto proc = createRpcTestSocketServerProcess(1);
 
@@ -853,6 +878,34 @@ TEST_P(BinderRpc, ThreadPoolOverSaturated) {
     EXPECT_LE(epochMsAfter, epochMsBefore + 3 * kSleepMs);
 }
 
+TEST_P(BinderRpc, ConnectionsOpenedOnDemand) {
+    constexpr size_t kNumThreads = 10;
+    constexpr size_t kNumCalls = kNumThreads + 3;
+    constexpr size_t kSleepMs = 200;
+
+    auto proc = createRpcTestSocketServerProcess(kNumThreads);
+    sp<RpcSession> session = proc.proc.sessions.at(0).session;
+
+    RpcSession::ConnectionStats stats = session->getConnectionStats();
+    EXPECT_EQ(1, stats.outgoingConnections);
+    EXPECT_EQ(kNumThreads, stats.maxOutgoingConnections);
+    EXPECT_EQ(0, stats.waits);
+
+    std::vector<std::thread> ts;
+    for (size_t i = 0; i < kNumCalls; i++) {
+        ts.push_back(std::thread([&] { EXPECT_OK(proc.rootIface->sleepMs(kSleepMs)); }));
+    }
+    for (auto& t : ts) t.join();
+
+    stats = session->getConnectionStats();
+    EXPECT_EQ(kNumThreads, stats.outgoingConnections);
+    EXPECT_EQ(0, stats.waitingThreads);
+    // the extra calls had to wait for one of the others to finish
+    EXPECT_GE(stats.waits, kNumCalls - kNumThreads);
+    EXPECT_GE(stats.maxWaitNs, kSleepMs * 1000000 / 2);
+    EXPECT_GE(stats.totalWaitNs, stats.maxWaitNs);
+}
+
 TEST_P(BinderRpc, ThreadingStressTest) {
     constexpr size_t kNumClientThreads = 10;
     constexpr size_t kNumServerThreads = 10;
@@ -874,6 +927,54 @@ TEST_P(BinderRpc, ThreadingStressTest) {
     for (auto& t : threads) t.join();
 }
 
+TEST_P(BinderRpc, PollingThreadsStressTest) {
+    constexpr size_t kNumClientThreads = 10;
+    constexpr size_t kNumServerThreads = 10;
+    constexpr size_t kNumPollingThreads = 2;
+    constexpr size_t kNumCalls = 100;
+
+    auto proc = createRpcTestSocketServerProcess(kNumServerThreads, 1 /*sessions*/,
+                                                 0 /*reverse connections*/, kNumPollingThreads);
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < kNumClientThreads; i++) {
+        threads.push_back(std::thread([&] {
+            for (size_t j = 0; j < kNumCalls; j++) {
+                sp<IBinder> out;
+                EXPECT_OK(proc.rootIface->repeatBinder(proc.rootBinder, &out));
+                EXPECT_EQ(proc.rootBinder, out);
+            }
+        }));
+    }
+
+    for (auto& t : threads) t.join();
+}
+
+TEST_P(BinderRpc, PollingThreadsManySessions) {
+    constexpr size_t kNumSessions = 10;
+
+    auto proc = createRpcTestSocketServerProcess(1 /*threads*/, kNumSessions,
+                                                 0 /*reverse connections*/,
+                                                 1 /*polling threads*/);
+
+    for (const auto& session : proc.proc.sessions) {
+        EXPECT_EQ(OK, session.root->pingBinder());
+    }
+}
+
+TEST_P(BinderRpc, PollingThreadsNestedTransactions) {
+    auto proc = createRpcTestSocketServerProcess(1 /*threads*/, 1 /*sessions*/,
+                                                 0 /*reverse connections*/,
+                                                 1 /*polling threads*/);
+
+    auto nastyNester = sp<MyBinderRpcTest>::make();
+    EXPECT_OK(proc.rootIface->nestMe(nastyNester, 10));
+
+    wp<IBinder> weak = nastyNester;
+    nastyNester = nullptr;
+    EXPECT_EQ(nullptr, weak.promote());
+}
+
 TEST_P(BinderRpc, OnewayStressTest) {
     constexpr size_t kNumClientThreads = 10;
     constexpr size_t kNumServerThreads = 10;
@@ -896,6 +997,38 @@ TEST_P(BinderRpc, OnewayStressTest) {
     for (auto& t : threads) t.join();
 }
 
+TEST_P(BinderRpc, OnewayBatchingStressTest) {
+    constexpr size_t kNumClientThreads = 10;
+    constexpr size_t kNumServerThreads = 10;
+    constexpr size_t kNumCalls = 500;
+
+    auto proc = createRpcTestSocketServerProcess(kNumServerThreads);
+    sp<RpcSession> session = proc.proc.sessions.at(0).session;
+    session->setOnewayBatching(true);
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < kNumClientThreads; i++) {
+        threads.push_back(std::thread([&] {
+            for (size_t j = 0; j < kNumCalls; j++) {
+                EXPECT_OK(proc.rootIface->sendString("a"));
+            }
+
+            // check threads are not stuck
+            EXPECT_OK(proc.rootIface->sleepMs(250));
+        }));
+    }
+
+    for (auto& t : threads) t.join();
+
+    RpcState::OnewayQueueStats stats = session->state()->getOnewayQueueStats();
+    EXPECT_EQ(0, stats.depth);
+    EXPECT_EQ(kNumClientThreads * kNumCalls, stats.transactions);
+    EXPECT_LE(stats.writes, stats.transactions);
+    EXPECT_GE(stats.maxDepth, 1);
+
+    session->setOnewayBatching(false);
+}
+
 TEST_P(BinderRpc, OnewayCallDoesNotWait) {
     constexpr size_t kReallyLongTimeMs = 100;
     constexpr size_t kSleepMs = kReallyLongTimeMs * 5;
@@ -498,92 +498,55 @@ public:
 
     // BnInterface
     status_t onTransact(uint32_t code, const Parcel& data, Parcel* reply,
-                        uint32_t /*flags*/) override {
+                        uint32_t flags) override {
         EXPECT_GE(code, IBinder::FIRST_CALL_TRANSACTION);
         EXPECT_LT(code, static_cast<uint32_t>(Tag::Last));
-        ISafeInterfaceTest::Tag tag = static_cast<ISafeInterfaceTest::Tag>(code);
-        switch (tag) {
-            case ISafeInterfaceTest::Tag::SetDeathToken: {
-                return callLocal(data, reply, &ISafeInterfaceTest::setDeathToken);
-            }
-            case ISafeInterfaceTest::Tag::ReturnsNoMemory: {
-                return callLocal(data, reply, &ISafeInterfaceTest::returnsNoMemory);
-            }
-            case ISafeInterfaceTest::Tag::LogicalNot: {
-                return callLocal(data, reply, &ISafeInterfaceTest::logicalNot);
-            }
-            case ISafeInterfaceTest::Tag::ModifyEnum: {
-                return callLocal(data, reply, &ISafeInterfaceTest::modifyEnum);
-            }
-            case ISafeInterfaceTest::Tag::IncrementFlattenable: {
-                using Signature = status_t (ISafeInterfaceTest::*)(const TestFlattenable& a,
-                                                                   TestFlattenable* aPlusOne) const;
-                return callLocal<Signature>(data, reply, &ISafeInterfaceTest::increment);
-            }
-            case ISafeInterfaceTest::Tag::IncrementLightFlattenable: {
-                using Signature =
-                        status_t (ISafeInterfaceTest::*)(const TestLightFlattenable& a,
-                                                         TestLightFlattenable* aPlusOne) const;
-                return callLocal<Signature>(data, reply, &ISafeInterfaceTest::increment);
-            }
-            case ISafeInterfaceTest::Tag::IncrementLightRefBaseFlattenable: {
-                using Signature =
-                        status_t (ISafeInterfaceTest::*)(const sp<TestLightRefBaseFlattenable>&,
-                                                         sp<TestLightRefBaseFlattenable>*) const;
-                return callLocal<Signature>(data, reply, &ISafeInterfaceTest::increment);
-            }
-            case ISafeInterfaceTest::Tag::IncrementNativeHandle: {
-                using Signature = status_t (ISafeInterfaceTest::*)(const sp<NativeHandle>&,
-                                                                   sp<NativeHandle>*) const;
-                return callLocal<Signature>(data, reply, &ISafeInterfaceTest::increment);
-            }
-            case ISafeInterfaceTest::Tag::IncrementNoCopyNoMove: {
-                using Signature = status_t (ISafeInterfaceTest::*)(const NoCopyNoMove& a,
-                                                                   NoCopyNoMove* aPlusOne) const;
-                return callLocal<Signature>(data, reply, &ISafeInterfaceTest::increment);
-            }
-            case ISafeInterfaceTest::Tag::IncrementParcelableVector: {
-                using Signature =
-                        status_t (ISafeInterfaceTest::*)(const std::vector<TestParcelable>&,
-                                                         std::vector<TestParcelable>*) const;
-                return callLocal<Signature>(data, reply, &ISafeInterfaceTest::increment);
-            }
-            case ISafeInterfaceTest::Tag::DoubleString: {
-                return callLocal(data, reply, &ISafeInterfaceTest::doubleString);
-            }
-            case ISafeInterfaceTest::Tag::CallMeBack: {
-                return callLocalAsync(data, reply, &ISafeInterfaceTest::callMeBack);
-            }
-            case ISafeInterfaceTest::Tag::IncrementInt32: {
-                using Signature = status_t (ISafeInterfaceTest::*)(int32_t, int32_t*) const;
-                return callLocal<Signature>(data, reply, &ISafeInterfaceTest::increment);
-            }
-            case ISafeInterfaceTest::Tag::IncrementUint32: {
-                using Signature = status_t (ISafeInterfaceTest::*)(uint32_t, uint32_t*) const;
-                return callLocal<Signature>(data, reply, &ISafeInterfaceTest::increment);
-            }
-            case ISafeInterfaceTest::Tag::IncrementInt64: {
-                using Signature = status_t (ISafeInterfaceTest::*)(int64_t, int64_t*) const;
-                return callLocal<Signature>(data, reply, &ISafeInterfaceTest::increment);
-            }
-            case ISafeInterfaceTest::Tag::IncrementUint64: {
-                using Signature = status_t (ISafeInterfaceTest::*)(uint64_t, uint64_t*) const;
-                return callLocal<Signature>(data, reply, &ISafeInterfaceTest::increment);
-            }
-            case ISafeInterfaceTest::Tag::IncrementFloat: {
-                using Signature = status_t (ISafeInterfaceTest::*)(float, float*) const;
-                return callLocal<Signature>(data, reply, &ISafeInterfaceTest::increment);
-            }
-            case ISafeInterfaceTest::Tag::IncrementTwo: {
-                using Signature = status_t (ISafeInterfaceTest::*)(int32_t, int32_t*, int32_t,
-                                                                   int32_t*) const;
-                return callLocal<Signature>(data, reply, &ISafeInterfaceTest::increment);
-            }
-            case ISafeInterfaceTest::Tag::Last:
-                // Should not be possible because of the asserts at the beginning of the method
-                [&]() { FAIL(); }();
-                return UNKNOWN_ERROR;
-        }
+        using I = ISafeInterfaceTest;
+        using IncrementFlattenable =
+                status_t (I::*)(const TestFlattenable& a, TestFlattenable* aPlusOne) const;
+        using IncrementLightFlattenable =
+                status_t (I::*)(const TestLightFlattenable& a, TestLightFlattenable* aPlusOne) const;
+        using IncrementLightRefBaseFlattenable =
+                status_t (I::*)(const sp<TestLightRefBaseFlattenable>&,
+                                sp<TestLightRefBaseFlattenable>*) const;
+        using IncrementNativeHandle =
+                status_t (I::*)(const sp<NativeHandle>&, sp<NativeHandle>*) const;
+        using IncrementNoCopyNoMove =
+                status_t (I::*)(const NoCopyNoMove& a, NoCopyNoMove* aPlusOne) const;
+        using IncrementParcelableVector = status_t (I::*)(const std::vector<TestParcelable>&,
+                                                          std::vector<TestParcelable>*) const;
+        using IncrementInt32 = status_t (I::*)(int32_t, int32_t*) const;
+        using IncrementUint32 = status_t (I::*)(uint32_t, uint32_t*) const;
+        using IncrementInt64 = status_t (I::*)(int64_t, int64_t*) const;
+        using IncrementUint64 = status_t (I::*)(uint64_t, uint64_t*) const;
+        using IncrementFloat = status_t (I::*)(float, float*) const;
+        using IncrementTwo = status_t (I::*)(int32_t, int32_t*, int32_t, int32_t*) const;
+        static constexpr auto kDispatchTable = makeDispatchTable<Tag>({
+                {Tag::SetDeathToken, &dispatchLocal<&I::setDeathToken>},
+                {Tag::ReturnsNoMemory, &dispatchLocal<&I::returnsNoMemory>},
+                {Tag::LogicalNot, &dispatchLocal<&I::logicalNot>},
+                {Tag::ModifyEnum, &dispatchLocal<&I::modifyEnum>},
+                {Tag::IncrementFlattenable, &dispatchLocal<IncrementFlattenable, &I::increment>},
+                {Tag::IncrementLightFlattenable,
+                 &dispatchLocal<IncrementLightFlattenable, &I::increment>},
+                {Tag::IncrementLightRefBaseFlattenable,
+                 &dispatchLocal<IncrementLightRefBaseFlattenable, &I::increment>},
+                {Tag::IncrementNativeHandle, &dispatchLocal<IncrementNativeHandle, &I::increment>},
+                {Tag::IncrementNoCopyNoMove, &dispatchLocal<IncrementNoCopyNoMove, &I::increment>},
+                {Tag::IncrementParcelableVector,
+                 &dispatchLocal<IncrementParcelableVector, &I::increment>},
+                {Tag::DoubleString, &dispatchLocal<&I::doubleString>},
+                {Tag::CallMeBack, &dispatchLocalAsync<&I::callMeBack>},
+                {Tag::IncrementInt32, &dispatchLocal<IncrementInt32, &I::increment>},
+                {Tag::IncrementUint32, &dispatchLocal<IncrementUint32, &I::increment>},
+                {Tag::IncrementInt64, &dispatchLocal<IncrementInt64, &I::increment>},
+                {Tag::IncrementUint64, &dispatchLocal<IncrementUint64, &I::increment>},
+                {Tag::IncrementFloat, &dispatchLocal<IncrementFloat, &I::increment>},
+                {Tag::IncrementTwo, &dispatchLocal<IncrementTwo, &I::increment>},
+        });
+        static_assert(kDispatchTable.size() ==
+                      static_cast<uint32_t>(Tag::Last) - IBinder::FIRST_CALL_TRANSACTION);
+        return dispatch(kDispatchTable, code, data, reply, flags);
     }
 
 private:
@@ -36,7 +36,10 @@ extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
     size_t dSize = fdp.ConsumeIntegralInRange<size_t>(0, kMaxDealerSize);
     std::string name = fdp.ConsumeRandomLengthString(fdp.remaining_bytes());
     uint32_t flags = fdp.ConsumeIntegral<uint32_t>();
-    sp<MemoryDealer> dealer = new MemoryDealer(dSize, name.c_str(), flags);
+    MemoryDealer::AllocationPolicy policy = fdp.ConsumeBool()
+            ? MemoryDealer::AllocationPolicy::SIZE_CLASSES
+            : MemoryDealer::AllocationPolicy::BEST_FIT;
+    sp<MemoryDealer> dealer = new MemoryDealer(dSize, name.c_str(), flags, policy);
 
     // This is used to track offsets that have been freed already to avoid an expected fatal log.
     std::unordered_set<size_t> free_list;
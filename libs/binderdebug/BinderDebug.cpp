@@ -116,4 +116,9 @@ status_t getBinderPidInfo(BinderDebugContext context, pid_t pid, BinderPidInfo*
     return ret;
 }
 
+status_t getBinderTransactionHistory(const sp<IBinder>& binder, std::string* history) {
+    if (binder == nullptr) return BAD_VALUE;
+    return binder->getTransactionHistory(history);
+}
+
 } // namespace  android
@@ -15,7 +15,10 @@
  */
 #pragma once
 
+#include <binder/IBinder.h>
+
 #include <map>
+#include <string>
 #include <vector>
 
 namespace android {
@@ -34,4 +37,10 @@ enum class BinderDebugContext {
 
 status_t getBinderPidInfo(BinderDebugContext context, pid_t pid, BinderPidInfo* pidInfo);
 
+/**
+ * Last transactions sent and served by each thread of the process hosting 'binder', including
+ * those still in flight. See IBinder::getTransactionHistory.
+ */
+status_t getBinderTransactionHistory(const sp<IBinder>& binder, std::string* history);
+
 } // namespace  android
@@ -60,6 +60,16 @@ TEST(BinderDebugTests, BinderThreads) {
     EXPECT_GE(pidInfo.threadCount, 1);
 }
 
+TEST(BinderDebugTests, TransactionHistory) {
+    sp<IBinder> binder = defaultServiceManager()->checkService(String16("binderdebug"));
+    ASSERT_NE(binder, nullptr);
+    std::string history;
+    ASSERT_EQ(getBinderTransactionHistory(binder, &history), OK);
+    // from the client process in main()
+    EXPECT_NE(history.find("server android.binderdebug.test.IControl code 1 "), std::string::npos)
+            << history;
+}
+
 extern "C" {
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
@@ -22,8 +22,13 @@
 #include <dirent.h>
 #include <errno.h>
 #include <inttypes.h>
+#include <sys/syscall.h>
 #include <sys/sysinfo.h>
+#include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
+#include <functional>
 #include <mutex>
 #include <numeric>
 #include <optional>
@@ -61,6 +66,14 @@ static unique_fd gTisMapFd;
 static unique_fd gConcurrentMapFd;
 static unique_fd gUidLastUpdateMapFd;
 static unique_fd gPidTisMapFd;
+static std::atomic<bool> gBatchLookupSupported = true;
+
+// Aggregation keys from this one up are reserved for the threads tracked individually by
+// startTrackingThreadCpuTimes().
+static constexpr uint16_t kFirstThreadAggregationKey = 0x8000;
+static std::mutex gThreadAggregationKeysMutex;
+static std::unordered_map<pid_t, uint16_t> gThreadAggregationKeys;
+static uint16_t gNextThreadAggregationKey = kFirstThreadAggregationKey;
 
 static std::optional<std::vector<uint32_t>> readNumbersFromFile(const std::string &path) {
     std::string data;
@@ -324,10 +337,111 @@ std::optional<std::vector<std::vector<uint64_t>>> getUidCpuFreqTimes(uint32_t ui
     return out;
 }
 
-static std::optional<bool> uidUpdatedSince(uint32_t uid, uint64_t lastUpdate,
-                                           uint64_t *newLastUpdate) {
-    uint64_t uidLastUpdate;
-    if (findMapEntry(gUidLastUpdateMapFd, &uid, &uidLastUpdate)) return {};
+template <typename Key, typename Val>
+using MapEntryCallback = std::function<bool(const Key &key, const Val *vals)>;
+
+// Read the entries of a map in batches of keys with BPF_MAP_LOOKUP_BATCH, passing each key and its
+// valsPerKey values (one per possible cpu for per-cpu maps) to cb, which returns false to abort.
+// Keys rejected by filter are skipped. Return 0 on success, EOPNOTSUPP if the kernel does not
+// support batch lookups for the map, in which case cb has not been called, or an errno otherwise.
+template <typename Key, typename Val>
+static int lookupMapEntriesBatched(const unique_fd &mapFd, uint32_t valsPerKey,
+                                   const std::function<bool(const Key &)> &filter,
+                                   const MapEntryCallback<Key, Val> &cb) {
+    static_assert(sizeof(Val) % 8 == 0, "per-cpu values are 8 byte aligned by the kernel");
+    // Errno of commands the kernel doesn't implement, which isn't exported to userspace.
+    constexpr int ENOTSUPP = 524;
+
+    uint32_t batchSize = 64;
+    std::vector<Key> keys(batchSize);
+    std::vector<Val> vals(batchSize * valsPerKey);
+    // Hash maps use the index of the next bucket as the batch position, other maps the next key.
+    uint8_t position[std::max(sizeof(Key), sizeof(uint32_t))];
+    bool first = true;
+    while (true) {
+        bpf_attr attr = {};
+        attr.batch.in_batch = first ? 0 : ptr_to_u64(position);
+        attr.batch.out_batch = ptr_to_u64(position);
+        attr.batch.keys = ptr_to_u64(keys.data());
+        attr.batch.values = ptr_to_u64(vals.data());
+        attr.batch.count = batchSize;
+        attr.batch.map_fd = mapFd.get();
+        const int err = syscall(__NR_bpf, BPF_MAP_LOOKUP_BATCH, &attr, sizeof(attr)) ? errno : 0;
+
+        // A hash bucket holding more keys than the batch size doesn't fit in any batch.
+        if (err == ENOSPC && attr.batch.count == 0) {
+            batchSize *= 2;
+            keys.resize(batchSize);
+            vals.resize(batchSize * valsPerKey);
+            continue;
+        }
+        if (err && err != ENOENT) {
+            if (first && (err == EINVAL || err == EOPNOTSUPP || err == ENOTSUPP)) {
+                return EOPNOTSUPP;
+            }
+            return err;
+        }
+
+        for (uint32_t i = 0; i < attr.batch.count; ++i) {
+            if (filter && !filter(keys[i])) continue;
+            if (!cb(keys[i], &vals[i * valsPerKey])) return ECANCELED;
+        }
+        // ENOENT marks the last batch.
+        if (err == ENOENT) return 0;
+        first = false;
+    }
+}
+
+// Like lookupMapEntriesBatched(), but reading the entries key by key, and only looking up the
+// values of the keys accepted by filter.
+template <typename Key, typename Val>
+static int lookupMapEntries(const unique_fd &mapFd, uint32_t valsPerKey,
+                            const std::function<bool(const Key &)> &filter,
+                            const MapEntryCallback<Key, Val> &cb) {
+    Key key, prevKey;
+    if (getFirstMapKey(mapFd, &key)) return errno == ENOENT ? 0 : errno;
+
+    std::vector<Val> vals(valsPerKey);
+    do {
+        if (filter && !filter(key)) continue;
+        if (findMapEntry(mapFd, &key, vals.data())) return errno;
+        if (!cb(key, vals.data())) return ECANCELED;
+    } while (prevKey = key, !getNextMapKey(mapFd, &prevKey, &key));
+    return errno == ENOENT ? 0 : errno;
+}
+
+// Pass the entries of a map to cb, reading them in batches when the kernel supports it. Return
+// false on error or if cb returned false.
+template <typename Key, typename Val>
+static bool forEachMapEntry(const unique_fd &mapFd, uint32_t valsPerKey,
+                            const std::function<bool(const Key &)> &filter,
+                            const MapEntryCallback<Key, Val> &cb) {
+    if (gBatchLookupSupported) {
+        int err = lookupMapEntriesBatched<Key, Val>(mapFd, valsPerKey, filter, cb);
+        if (err != EOPNOTSUPP) return err == 0;
+        gBatchLookupSupported = false;
+    }
+    return lookupMapEntries<Key, Val>(mapFd, valsPerKey, filter, cb) == 0;
+}
+
+// Retrieve the time of the last update of each uid, which is used to skip the uids that have not
+// run since a previous read.
+static std::optional<std::unordered_map<uint32_t, uint64_t>> getUidLastUpdates() {
+    std::unordered_map<uint32_t, uint64_t> lastUpdates;
+    auto addEntry = [&lastUpdates](const uint32_t &uid, const uint64_t *lastUpdate) {
+        lastUpdates.emplace(uid, *lastUpdate);
+        return true;
+    };
+    if (!forEachMapEntry<uint32_t, uint64_t>(gUidLastUpdateMapFd, 1, nullptr, addEntry)) return {};
+    return lastUpdates;
+}
+
+static bool uidUpdatedSince(const std::unordered_map<uint32_t, uint64_t> &uidLastUpdates,
+                            uint32_t uid, uint64_t lastUpdate, uint64_t *newLastUpdate) {
+    auto it = uidLastUpdates.find(uid);
+    // The uid started running after the update times were read.
+    if (it == uidLastUpdates.end()) return true;
+    uint64_t uidLastUpdate = it->second;
     // Updates that occurred during the previous read may have been missed. To mitigate
     // this, don't ignore entries updated up to 1s before *lastUpdate
     constexpr uint64_t NSEC_PER_SEC = 1000000000;
@@ -336,6 +450,19 @@ static std::optional<bool> uidUpdatedSince(uint32_t uid, uint64_t lastUpdate,
     return true;
 }
 
+// Return a filter accepting the uids updated since *lastUpdate, or none if lastUpdate is null.
+// Fails if the update times can't be read.
+static std::optional<std::function<bool(const time_key_t &)>> getUpdatedUidFilter(
+        uint64_t *lastUpdate, uint64_t *newLastUpdate) {
+    if (!lastUpdate) return std::function<bool(const time_key_t &)>();
+    auto uidLastUpdates = getUidLastUpdates();
+    if (!uidLastUpdates) return {};
+    return [uidLastUpdates = std::move(*uidLastUpdates), lastUpdate = *lastUpdate,
+            newLastUpdate](const time_key_t &key) {
+        return uidUpdatedSince(uidLastUpdates, key.uid, lastUpdate, newLastUpdate);
+    };
+}
+
 // Retrieve the times in ns that each uid spent running at each CPU freq.
 // Return contains no value on error, otherwise it contains a map from uids to vectors of vectors
 // using the format:
@@ -353,25 +480,16 @@ getUidsCpuFreqTimes() {
 std::optional<std::unordered_map<uint32_t, std::vector<std::vector<uint64_t>>>>
 getUidsUpdatedCpuFreqTimes(uint64_t *lastUpdate) {
     if (!gInitialized && !initGlobals()) return {};
-    time_key_t key, prevKey;
     std::unordered_map<uint32_t, std::vector<std::vector<uint64_t>>> map;
-    if (getFirstMapKey(gTisMapFd, &key)) {
-        if (errno == ENOENT) return map;
-        return std::nullopt;
-    }
 
     std::vector<std::vector<uint64_t>> mapFormat;
     for (const auto &freqList : gPolicyFreqs) mapFormat.emplace_back(freqList.size(), 0);
 
     uint64_t newLastUpdate = lastUpdate ? *lastUpdate : 0;
-    std::vector<tis_val_t> vals(gNCpus);
-    do {
-        if (lastUpdate) {
-            auto uidUpdated = uidUpdatedSince(key.uid, *lastUpdate, &newLastUpdate);
-            if (!uidUpdated.has_value()) return {};
-            if (!*uidUpdated) continue;
-        }
-        if (findMapEntry(gTisMapFd, &key, vals.data())) return {};
+    auto filter = getUpdatedUidFilter(lastUpdate, &newLastUpdate);
+    if (!filter) return {};
+
+    auto addEntry = [&](const time_key_t &key, const tis_val_t *vals) {
         if (map.find(key.uid) == map.end()) map.emplace(key.uid, mapFormat);
 
         auto offset = key.bucket * FREQS_PER_ENTRY;
@@ -385,9 +503,9 @@ getUidsUpdatedCpuFreqTimes(uint64_t *lastUpdate) {
                 std::transform(begin, end, std::begin(vals[cpu].ar), begin, std::plus<uint64_t>());
             }
         }
-        prevKey = key;
-    } while (prevKey = key, !getNextMapKey(gTisMapFd, &prevKey, &key));
-    if (errno != ENOENT) return {};
+        return true;
+    };
+    if (!forEachMapEntry<time_key_t, tis_val_t>(gTisMapFd, gNCpus, *filter, addEntry)) return {};
     if (lastUpdate && newLastUpdate > *lastUpdate) *lastUpdate = newLastUpdate;
     return map;
 }
@@ -463,28 +581,24 @@ std::optional<std::unordered_map<uint32_t, concurrent_time_t>> getUidsConcurrent
 std::optional<std::unordered_map<uint32_t, concurrent_time_t>> getUidsUpdatedConcurrentTimes(
         uint64_t *lastUpdate) {
     if (!gInitialized && !initGlobals()) return {};
-    time_key_t key, prevKey;
     std::unordered_map<uint32_t, concurrent_time_t> ret;
-    if (getFirstMapKey(gConcurrentMapFd, &key)) {
-        if (errno == ENOENT) return ret;
-        return {};
-    }
 
     concurrent_time_t retFormat = {.active = std::vector<uint64_t>(gNCpus, 0)};
     for (const auto &cpuList : gPolicyCpus) retFormat.policy.emplace_back(cpuList.size(), 0);
 
-    std::vector<concurrent_val_t> vals(gNCpus);
     std::vector<uint64_t>::iterator activeBegin, activeEnd, policyBegin, policyEnd;
 
     uint64_t newLastUpdate = lastUpdate ? *lastUpdate : 0;
-    do {
-        if (key.bucket > (gNCpus - 1) / CPUS_PER_ENTRY) return {};
-        if (lastUpdate) {
-            auto uidUpdated = uidUpdatedSince(key.uid, *lastUpdate, &newLastUpdate);
-            if (!uidUpdated.has_value()) return {};
-            if (!*uidUpdated) continue;
-        }
-        if (findMapEntry(gConcurrentMapFd, &key, vals.data())) return {};
+    auto updatedUidFilter = getUpdatedUidFilter(lastUpdate, &newLastUpdate);
+    if (!updatedUidFilter) return {};
+    const uint32_t maxBucket = (gNCpus - 1) / CPUS_PER_ENTRY;
+    // Let invalid buckets through to fail the read, whether their uid was updated or not.
+    auto filter = [&](const time_key_t &key) {
+        return key.bucket > maxBucket || !*updatedUidFilter || (*updatedUidFilter)(key);
+    };
+
+    auto addEntry = [&](const time_key_t &key, const concurrent_val_t *vals) {
+        if (key.bucket > maxBucket) return false;
         if (ret.find(key.uid) == ret.end()) ret.emplace(key.uid, retFormat);
 
         auto offset = key.bucket * CPUS_PER_ENTRY;
@@ -509,8 +623,12 @@ std::optional<std::unordered_map<uint32_t, concurrent_time_t>> getUidsUpdatedCon
                                std::plus<uint64_t>());
             }
         }
-    } while (prevKey = key, !getNextMapKey(gConcurrentMapFd, &prevKey, &key));
-    if (errno != ENOENT) return {};
+        return true;
+    };
+    if (!forEachMapEntry<time_key_t, concurrent_val_t>(gConcurrentMapFd, gNCpus, filter,
+                                                       addEntry)) {
+        return {};
+    }
     for (const auto &[key, value] : ret) {
         if (!verifyConcurrentTimes(value)) {
             auto val = getUidConcurrentTimes(key, false);
@@ -656,5 +774,99 @@ getAggregatedTaskCpuFreqTimes(pid_t tgid, const std::vector<uint16_t> &aggregati
     return map;
 }
 
+// Marks the specified threads of a process already tracked with startTrackingProcessCpuTimes for
+// individual CPU time-in-state tracking, each under an aggregation key of its own taken from a range
+// reserved for this purpose. Keys are handed out in turn and only reused once the range wraps
+// around, so that the times of a thread don't include those of threads tracked before it.
+// Returns true on success, false otherwise.
+bool startTrackingThreadCpuTimes(const std::vector<pid_t> &tids) {
+    if (!gInitialized && !initGlobals()) return false;
+
+    unique_fd taskAggregationMapFd(
+            mapRetrieveWO(BPF_FS_PATH "map_time_in_state_pid_task_aggregation_map"));
+    if (taskAggregationMapFd < 0) return false;
+
+    std::lock_guard<std::mutex> guard(gThreadAggregationKeysMutex);
+    for (pid_t tid : tids) {
+        auto it = gThreadAggregationKeys.find(tid);
+        if (it == gThreadAggregationKeys.end()) {
+            uint16_t aggregationKey = gNextThreadAggregationKey++;
+            if (gNextThreadAggregationKey == 0) {
+                gNextThreadAggregationKey = kFirstThreadAggregationKey;
+            }
+            it = gThreadAggregationKeys.emplace(tid, aggregationKey).first;
+        }
+        if (writeToMapEntry(taskAggregationMapFd, &tid, &it->second, BPF_ANY)) return false;
+    }
+    return true;
+}
+
+// Stops the individual tracking of the specified threads, whose CPU time is aggregated under the
+// default aggregation key of their process again.
+// Returns true on success, false otherwise.
+bool stopTrackingThreadCpuTimes(const std::vector<pid_t> &tids) {
+    if (!gInitialized && !initGlobals()) return false;
+
+    unique_fd taskAggregationMapFd(
+            mapRetrieveWO(BPF_FS_PATH "map_time_in_state_pid_task_aggregation_map"));
+    if (taskAggregationMapFd < 0) return false;
+
+    std::lock_guard<std::mutex> guard(gThreadAggregationKeysMutex);
+    for (pid_t tid : tids) {
+        if (gThreadAggregationKeys.erase(tid) == 0) continue;
+        if (deleteMapEntry(taskAggregationMapFd, &tid) && errno != ENOENT) return false;
+    }
+    return true;
+}
+
+// Retrieves the times in ns that each of the specified threads of process tgid spent running at
+// each CPU freq since startTrackingThreadCpuTimes was called for it, reading all of them at once.
+// Return contains no value on error, otherwise it contains a map from the tids being tracked to
+// vectors of vectors in the format returned by getAggregatedTaskCpuFreqTimes.
+std::optional<std::unordered_map<pid_t, std::vector<std::vector<uint64_t>>>>
+getThreadCpuFreqTimes(pid_t tgid, const std::vector<pid_t> &tids) {
+    if (!gInitialized && !initGlobals()) return {};
+
+    std::vector<std::vector<uint64_t>> mapFormat;
+    for (const auto &freqList : gPolicyFreqs) mapFormat.emplace_back(freqList.size(), 0);
+
+    std::unordered_map<uint16_t, pid_t> keyTids;
+    std::unordered_map<pid_t, std::vector<std::vector<uint64_t>>> map;
+    {
+        std::lock_guard<std::mutex> guard(gThreadAggregationKeysMutex);
+        for (pid_t tid : tids) {
+            auto it = gThreadAggregationKeys.find(tid);
+            if (it == gThreadAggregationKeys.end()) continue;
+            keyTids.emplace(it->second, tid);
+            map.emplace(tid, mapFormat);
+        }
+    }
+    if (map.empty()) return map;
+
+    auto filter = [&](const aggregated_task_tis_key_t &key) {
+        return key.tgid == static_cast<uint32_t>(tgid) && keyTids.count(key.aggregation_key);
+    };
+    auto addEntry = [&](const aggregated_task_tis_key_t &key, const tis_val_t *vals) {
+        auto &times = map[keyTids[key.aggregation_key]];
+        uint32_t offset = key.bucket * FREQS_PER_ENTRY;
+        uint32_t nextOffset = offset + FREQS_PER_ENTRY;
+        for (uint32_t j = 0; j < gNPolicies; ++j) {
+            if (offset >= gPolicyFreqs[j].size()) continue;
+            auto begin = times[j].begin() + offset;
+            auto end = nextOffset < gPolicyFreqs[j].size() ? begin + FREQS_PER_ENTRY
+                                                           : times[j].end();
+            for (const auto &cpu : gPolicyCpus[j]) {
+                std::transform(begin, end, std::begin(vals[cpu].ar), begin, std::plus<uint64_t>());
+            }
+        }
+        return true;
+    };
+    if (!forEachMapEntry<aggregated_task_tis_key_t, tis_val_t>(gPidTisMapFd, gNCpus, filter,
+                                                                addEntry)) {
+        return {};
+    }
+    return map;
+}
+
 } // namespace bpf
 } // namespace android
@@ -48,5 +48,10 @@ bool startAggregatingTaskCpuTimes(pid_t pid, uint16_t aggregationKey);
 std::optional<std::unordered_map<uint16_t, std::vector<std::vector<uint64_t>>>>
 getAggregatedTaskCpuFreqTimes(pid_t pid, const std::vector<uint16_t> &aggregationKeys);
 
+bool startTrackingThreadCpuTimes(const std::vector<pid_t> &tids);
+bool stopTrackingThreadCpuTimes(const std::vector<pid_t> &tids);
+std::optional<std::unordered_map<pid_t, std::vector<std::vector<uint64_t>>>>
+getThreadCpuFreqTimes(pid_t tgid, const std::vector<pid_t> &tids);
+
 } // namespace bpf
 } // namespace android
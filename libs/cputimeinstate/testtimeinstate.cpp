@@ -21,6 +21,8 @@
 
 #include <pthread.h>
 #include <semaphore.h>
+#include <chrono>
+#include <functional>
 #include <numeric>
 #include <unordered_map>
 #include <vector>
@@ -481,6 +483,33 @@ TEST(TimeInStateTest, AllUidTimesConsistent) {
     }
 }
 
+// Measures the average time taken by a read of all uid times, reporting it as a test property.
+static void BenchmarkRead(const char *name, const std::function<bool()> &read) {
+    constexpr int kIterations = 20;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kIterations; ++i) ASSERT_TRUE(read());
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    auto usPerRead =
+            std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count() / kIterations;
+    printf("%s: %lld us\n", name, static_cast<long long>(usPerRead));
+    ::testing::Test::RecordProperty(name, std::to_string(usPerRead));
+}
+
+TEST(TimeInStateTest, AllUidTimesReadLatency) {
+    BenchmarkRead("getUidsCpuFreqTimes", [] { return getUidsCpuFreqTimes().has_value(); });
+    BenchmarkRead("getUidsConcurrentTimes", [] { return getUidsConcurrentTimes().has_value(); });
+
+    // Incremental reads following a full read, as done when polling.
+    uint64_t lastUpdate = 0;
+    ASSERT_TRUE(getUidsUpdatedCpuFreqTimes(&lastUpdate).has_value());
+    BenchmarkRead("getUidsUpdatedCpuFreqTimes",
+                  [&] { return getUidsUpdatedCpuFreqTimes(&lastUpdate).has_value(); });
+    lastUpdate = 0;
+    ASSERT_TRUE(getUidsUpdatedConcurrentTimes(&lastUpdate).has_value());
+    BenchmarkRead("getUidsUpdatedConcurrentTimes",
+                  [&] { return getUidsUpdatedConcurrentTimes(&lastUpdate).has_value(); });
+}
+
 TEST(TimeInStateTest, RemoveUid) {
     uint32_t uid = 0;
     {
@@ -638,5 +667,54 @@ TEST(TimeInStateTest, GetAggregatedTaskCpuFreqTimes) {
     }
 }
 
+TEST(TimeInStateTest, GetThreadCpuFreqTimes) {
+    uint64_t startTimeNs = timeNanos();
+
+    sem_init(&pingsem, 0, 1);
+    sem_init(&pongsem, 0, 0);
+
+    pthread_t thread;
+    ASSERT_EQ(pthread_create(&thread, NULL, &testThread, NULL), 0);
+
+    // Yield the remainder of this timeslice to the newly created thread, see
+    // GetAggregatedTaskCpuFreqTimes.
+    sem_wait(&pongsem);
+    sem_post(&pingsem);
+
+    pid_t tgid = getpid();
+    startTrackingProcessCpuTimes(tgid);
+
+    std::vector<pid_t> tids = {gettid(), pthread_gettid_np(thread)};
+    ASSERT_TRUE(startTrackingThreadCpuTimes(tids));
+
+    for (int i = 0; i < 9; i++) {
+        sem_wait(&pongsem);
+        useCpu();
+        sem_post(&pingsem);
+    }
+
+    pthread_join(thread, NULL);
+
+    auto times = getThreadCpuFreqTimes(tgid, tids);
+    ASSERT_TRUE(times.has_value());
+    ASSERT_EQ(times->size(), tids.size());
+
+    uint64_t testDurationNs = timeNanos() - startTimeNs;
+    for (pid_t tid : tids) {
+        ASSERT_NE(times->find(tid), times->end());
+        uint64_t totalCpuTime = 0;
+        for (const auto &policyTimes : (*times)[tid]) {
+            totalCpuTime = std::accumulate(policyTimes.begin(), policyTimes.end(), totalCpuTime);
+        }
+        ASSERT_GT(totalCpuTime, 0ul);
+        ASSERT_LE(totalCpuTime, testDurationNs);
+    }
+
+    ASSERT_TRUE(stopTrackingThreadCpuTimes(tids));
+    times = getThreadCpuFreqTimes(tgid, tids);
+    ASSERT_TRUE(times.has_value());
+    ASSERT_TRUE(times->empty());
+}
+
 } // namespace bpf
 } // namespace android
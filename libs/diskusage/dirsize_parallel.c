@@ -0,0 +1,394 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define _GNU_SOURCE
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <diskusage/dirsize.h>
+
+#define MAX_THREADS 8
+/* Directories found beyond this many waiting ones are walked by their finder. */
+#define MAX_QUEUED_DIRS 256
+#define DENTS_BUF_SIZE 32768
+#define CACHE_BUCKETS 4096
+#define CACHE_MAX_BYTES (8 * 1024 * 1024)
+
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+/* Identity and change time of a directory, used as cache key. */
+struct dir_id {
+    uint32_t dev_major;
+    uint32_t dev_minor;
+    uint64_t ino;
+    int64_t ctime_sec;
+    uint32_t ctime_nsec;
+};
+
+/* Entries of a directory, each stored as its d_type followed by its name. */
+struct listing {
+    char *data;
+    size_t len;
+    size_t cap;
+};
+
+struct cache_entry {
+    struct cache_entry *next;
+    struct dir_id id;
+    size_t len;
+    char data[];
+};
+
+struct dir_size_cache {
+    pthread_mutex_t lock;
+    size_t size_bytes;
+    struct cache_entry *buckets[CACHE_BUCKETS];
+};
+
+struct work {
+    int dfd;
+    int has_id;
+    struct dir_id id;
+};
+
+struct walk {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    struct work queue[MAX_QUEUED_DIRS];
+    size_t queued;
+    int busy;
+    int64_t size;
+    struct dir_size_cache *cache;
+};
+
+struct dir_size_cache *dir_size_cache_create(void)
+{
+    struct dir_size_cache *cache = calloc(1, sizeof(*cache));
+    if (cache != NULL) {
+        pthread_mutex_init(&cache->lock, NULL);
+    }
+    return cache;
+}
+
+void dir_size_cache_destroy(struct dir_size_cache *cache)
+{
+    size_t i;
+
+    if (cache == NULL)
+        return;
+    for (i = 0; i < CACHE_BUCKETS; i++) {
+        struct cache_entry *entry = cache->buckets[i];
+        while (entry != NULL) {
+            struct cache_entry *next = entry->next;
+            free(entry);
+            entry = next;
+        }
+    }
+    pthread_mutex_destroy(&cache->lock);
+    free(cache);
+}
+
+static int same_dir(const struct dir_id *a, const struct dir_id *b)
+{
+    return a->dev_major == b->dev_major && a->dev_minor == b->dev_minor &&
+            a->ino == b->ino;
+}
+
+static struct cache_entry **cache_bucket(struct dir_size_cache *cache,
+                                         const struct dir_id *id)
+{
+    uint64_t hash = id->ino ^ id->dev_minor ^ ((uint64_t) id->dev_major << 20);
+    return &cache->buckets[hash % CACHE_BUCKETS];
+}
+
+static int cache_get(struct dir_size_cache *cache, const struct dir_id *id,
+                     struct listing *listing)
+{
+    struct cache_entry *entry;
+    int found = 0;
+
+    pthread_mutex_lock(&cache->lock);
+    for (entry = *cache_bucket(cache, id); entry != NULL; entry = entry->next) {
+        if (!same_dir(&entry->id, id))
+            continue;
+        if (entry->id.ctime_sec == id->ctime_sec &&
+                entry->id.ctime_nsec == id->ctime_nsec) {
+            listing->data = malloc(entry->len);
+            if (listing->data != NULL) {
+                memcpy(listing->data, entry->data, entry->len);
+                listing->len = listing->cap = entry->len;
+                found = 1;
+            }
+        }
+        break;
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return found;
+}
+
+/* Stores the listing of a directory, replacing any older one. */
+static void cache_put(struct dir_size_cache *cache, const struct dir_id *id,
+                      const struct listing *listing)
+{
+    struct cache_entry **link;
+    struct cache_entry *entry;
+
+    pthread_mutex_lock(&cache->lock);
+    for (link = cache_bucket(cache, id); *link != NULL; link = &(*link)->next) {
+        if (same_dir(&(*link)->id, id)) {
+            entry = *link;
+            *link = entry->next;
+            cache->size_bytes -= sizeof(*entry) + entry->len;
+            free(entry);
+            break;
+        }
+    }
+
+    if (cache->size_bytes + sizeof(*entry) + listing->len <= CACHE_MAX_BYTES) {
+        entry = malloc(sizeof(*entry) + listing->len);
+        if (entry != NULL) {
+            entry->id = *id;
+            entry->len = listing->len;
+            memcpy(entry->data, listing->data, listing->len);
+            link = cache_bucket(cache, id);
+            entry->next = *link;
+            *link = entry;
+            cache->size_bytes += sizeof(*entry) + entry->len;
+        }
+    }
+    pthread_mutex_unlock(&cache->lock);
+}
+
+static int listing_append(struct listing *listing, unsigned char type,
+                          const char *name)
+{
+    size_t len = strlen(name) + 2;
+
+    if (listing->len + len > listing->cap) {
+        size_t cap = listing->cap ? listing->cap * 2 : 4096;
+        char *data;
+        while (cap < listing->len + len)
+            cap *= 2;
+        data = realloc(listing->data, cap);
+        if (data == NULL)
+            return -1;
+        listing->data = data;
+        listing->cap = cap;
+    }
+    listing->data[listing->len] = type;
+    memcpy(&listing->data[listing->len + 1], name, len - 1);
+    listing->len += len;
+    return 0;
+}
+
+static int read_listing(int dfd, struct listing *listing)
+{
+    char *buf = malloc(DENTS_BUF_SIZE);
+    long n;
+    int ret = -1;
+
+    if (buf == NULL)
+        return -1;
+
+    while ((n = syscall(SYS_getdents64, dfd, buf, DENTS_BUF_SIZE)) > 0) {
+        long pos;
+        for (pos = 0; pos < n;) {
+            struct linux_dirent64 *de = (struct linux_dirent64 *) (buf + pos);
+            const char *name = de->d_name;
+            pos += de->d_reclen;
+
+            /* always skip "." and ".." */
+            if (name[0] == '.') {
+                if (name[1] == 0)
+                    continue;
+                if ((name[1] == '.') && (name[2] == 0))
+                    continue;
+            }
+            if (listing_append(listing, de->d_type, name) < 0)
+                goto out;
+        }
+    }
+    if (n == 0)
+        ret = 0;
+out:
+    free(buf);
+    return ret;
+}
+
+static void set_dir_id(struct dir_id *id, const struct statx *stx)
+{
+    id->dev_major = stx->stx_dev_major;
+    id->dev_minor = stx->stx_dev_minor;
+    id->ino = stx->stx_ino;
+    id->ctime_sec = stx->stx_ctime.tv_sec;
+    id->ctime_nsec = stx->stx_ctime.tv_nsec;
+}
+
+static int has_dir_id(const struct statx *stx)
+{
+    return (stx->stx_mask & (STATX_INO | STATX_CTIME)) == (STATX_INO | STATX_CTIME);
+}
+
+/* Queues a directory for any thread to walk, unless the queue is full. */
+static int push_work(struct walk *w, const struct work *work)
+{
+    int pushed = 0;
+
+    pthread_mutex_lock(&w->lock);
+    if (w->queued < MAX_QUEUED_DIRS) {
+        w->queue[w->queued++] = *work;
+        pthread_cond_signal(&w->cond);
+        pushed = 1;
+    }
+    pthread_mutex_unlock(&w->lock);
+    return pushed;
+}
+
+/* Returns the size of the entries of a directory and closes it. */
+static int64_t walk_dir(struct walk *w, struct work *work)
+{
+    struct listing listing = { NULL, 0, 0 };
+    int64_t size = 0;
+    size_t pos;
+
+    if (w->cache == NULL || !work->has_id || !cache_get(w->cache, &work->id, &listing)) {
+        if (read_listing(work->dfd, &listing) < 0) {
+            free(listing.data);
+            close(work->dfd);
+            return 0;
+        }
+        if (w->cache != NULL && work->has_id)
+            cache_put(w->cache, &work->id, &listing);
+    }
+
+    for (pos = 0; pos < listing.len; pos += strlen(&listing.data[pos + 1]) + 2) {
+        unsigned char type = listing.data[pos];
+        const char *name = &listing.data[pos + 1];
+        unsigned int mask = STATX_BLOCKS;
+        struct statx stx;
+        struct work sub;
+
+        if (type == DT_DIR || type == DT_UNKNOWN)
+            mask |= STATX_TYPE | STATX_INO | STATX_CTIME;
+        if (statx(work->dfd, name, AT_SYMLINK_NOFOLLOW, mask, &stx) != 0)
+            continue;
+        if (stx.stx_mask & STATX_BLOCKS)
+            size += stx.stx_blocks * 512;
+        if (!(mask & STATX_TYPE) || !(stx.stx_mask & STATX_TYPE) || !S_ISDIR(stx.stx_mode))
+            continue;
+
+        sub.dfd = openat(work->dfd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (sub.dfd < 0)
+            continue;
+        sub.has_id = has_dir_id(&stx);
+        if (sub.has_id)
+            set_dir_id(&sub.id, &stx);
+        if (!push_work(w, &sub))
+            size += walk_dir(w, &sub);
+    }
+
+    free(listing.data);
+    close(work->dfd);
+    return size;
+}
+
+static void *walk_thread(void *arg)
+{
+    struct walk *w = arg;
+    int64_t size = 0;
+
+    pthread_mutex_lock(&w->lock);
+    for (;;) {
+        struct work work;
+
+        while (w->queued == 0 && w->busy > 0)
+            pthread_cond_wait(&w->cond, &w->lock);
+        if (w->queued == 0)
+            break;
+
+        work = w->queue[--w->queued];
+        w->busy++;
+        pthread_mutex_unlock(&w->lock);
+        size += walk_dir(w, &work);
+        pthread_mutex_lock(&w->lock);
+        if (--w->busy == 0 && w->queued == 0)
+            pthread_cond_broadcast(&w->cond);
+    }
+    w->size += size;
+    pthread_mutex_unlock(&w->lock);
+    return NULL;
+}
+
+int64_t calculate_dir_size_parallel(int dfd, int max_threads,
+                                    struct dir_size_cache *cache)
+{
+    pthread_t threads[MAX_THREADS - 1];
+    struct walk *w;
+    struct statx stx;
+    int nthreads = 0;
+    int64_t size;
+    int i;
+
+    w = calloc(1, sizeof(*w));
+    if (w == NULL) {
+        close(dfd);
+        return 0;
+    }
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->cond, NULL);
+    w->cache = cache;
+
+    w->queue[0].dfd = dfd;
+    w->queue[0].has_id = statx(dfd, "", AT_EMPTY_PATH, STATX_INO | STATX_CTIME, &stx) == 0 &&
+            has_dir_id(&stx);
+    if (w->queue[0].has_id)
+        set_dir_id(&w->queue[0].id, &stx);
+    w->queued = 1;
+
+    if (max_threads <= 0)
+        max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (max_threads > MAX_THREADS)
+        max_threads = MAX_THREADS;
+
+    /* The calling thread walks too. */
+    for (i = 1; i < max_threads; i++) {
+        if (pthread_create(&threads[nthreads], NULL, walk_thread, w) != 0)
+            break;
+        nthreads++;
+    }
+    walk_thread(w);
+    for (i = 0; i < nthreads; i++)
+        pthread_join(threads[i], NULL);
+
+    size = w->size;
+    pthread_cond_destroy(&w->cond);
+    pthread_mutex_destroy(&w->lock);
+    free(w);
+    return size;
+}
@@ -60,12 +60,18 @@ static inline bool hasAdditionOverflow(size_t a, size_t b) {
  *
  * This type is needed because hidl_vec's resize() allocates a new backing array every time.
  * This type does not need an copies and only needs one resize operation.
+ *
+ * An OutputHidlVec can also wrap a caller-provided buffer, which is filled in a single pass and
+ * never resized.
  */
 class OutputHidlVec {
 public:
     OutputHidlVec(hidl_vec<uint8_t>* vec)
         : mVec(vec) {}
 
+    OutputHidlVec(uint8_t* buffer, size_t bufferSize)
+        : mVec(nullptr), mBuffer(buffer), mBufferSize(bufferSize), mResized(true) {}
+
     status_t resize() {
         if (!mVec) {
             return BAD_VALUE;
@@ -77,7 +83,16 @@ public:
 
     status_t encode(const uint8_t* data, size_t size) {
         if (!mVec) {
-            return BAD_VALUE;
+            if (!mBuffer) {
+                return BAD_VALUE;
+            }
+            if (hasAdditionOverflow(mOffset, size) || mBufferSize < size + mOffset) {
+                clear();
+                return NO_MEMORY;
+            }
+            std::copy(data, data + size, mBuffer + mOffset);
+            mOffset += size;
+            return NO_ERROR;
         }
         if (!mResized) {
             if (hasAdditionOverflow(mNeededResize, size)) {
@@ -108,14 +123,20 @@ public:
     void clear() {
         if (mVec) {
             mVec->resize(0);
+            mResized = false;
         }
         mNeededResize = 0;
-        mResized = false;
         mOffset = 0;
     }
 
+    size_t getSize() const {
+        return mOffset;
+    }
+
 private:
     hidl_vec<uint8_t>* mVec;
+    uint8_t* mBuffer = nullptr;
+    size_t mBufferSize = 0;
     size_t mNeededResize = 0;
     size_t mResized = false;
     size_t mOffset = 0;
@@ -124,51 +145,73 @@ private:
 /**
  * InputHidlVec represents the hidl_vec byte stream that is inputed when a type is decoded.
  * This class is used to track the current index of the byte stream of the hidl_vec as it is
- * decoded.
+ * decoded. It only refers to the bytes, so that they can also come from a caller-provided buffer.
  */
 class InputHidlVec {
 public:
     InputHidlVec(const hidl_vec<uint8_t>* vec)
-        : mVec(vec) {}
+        : InputHidlVec(vec ? vec->data() : nullptr, vec ? vec->size() : 0) {
+        mValid = vec != nullptr;
+    }
+
+    InputHidlVec(const uint8_t* data, size_t size)
+        : mData(data), mSize(size), mValid(data != nullptr || size == 0) {}
 
     status_t decode(uint8_t* data, size_t size) {
-        if (!mVec || hasAdditionOverflow(mOffset, size) || mOffset + size > mVec->size()) {
+        if (!mValid || hasAdditionOverflow(mOffset, size) || mOffset + size > mSize) {
             return BAD_VALUE;
         }
 
-        std::copy(mVec->data() + mOffset, mVec->data() + mOffset + size, data);
+        std::copy(mData + mOffset, mData + mOffset + size, data);
 
         mOffset += size;
         return NO_ERROR;
     }
 
     status_t decode(std::string* string, size_t size) {
-        if (!mVec || hasAdditionOverflow(mOffset, size) || mOffset + size > mVec->size()) {
+        if (!mValid || hasAdditionOverflow(mOffset, size) || mOffset + size > mSize) {
             return BAD_VALUE;
         }
 
-        string->assign(mVec->data() + mOffset, mVec->data() + mOffset + size);
+        string->assign(mData + mOffset, mData + mOffset + size);
+
+        mOffset += size;
+        return NO_ERROR;
+    }
+
+    /**
+     * Consumes size bytes, which must be equal to data. Unlike decode(), this does not copy them.
+     */
+    status_t compare(const uint8_t* data, size_t size) {
+        if (!mValid || hasAdditionOverflow(mOffset, size) || mOffset + size > mSize) {
+            return BAD_VALUE;
+        }
+        if (size > 0 && memcmp(mData + mOffset, data, size) != 0) {
+            return BAD_VALUE;
+        }
 
         mOffset += size;
         return NO_ERROR;
     }
 
     bool hasRemainingData() {
-        if (!mVec) {
+        if (!mValid) {
             return false;
         }
-        return mVec->size() > mOffset;
+        return mSize > mOffset;
     }
 
     size_t getRemainingSize() {
-        if (!mVec) {
+        if (!mValid) {
             return 0;
         }
-        return mVec->size() - mOffset;
+        return mSize - mOffset;
     }
 
 private:
-    const hidl_vec<uint8_t>* mVec;
+    const uint8_t* mData;
+    size_t mSize;
+    bool mValid;
     size_t mOffset = 0;
 };
 
@@ -248,6 +291,46 @@ status_t encodeMetadata(const MetadataType& metadataType, const T& input, hidl_v
     return encodeHelper(input, &outputHidlVec);
 }
 
+/**
+ * encodeMetadata into a caller-provided buffer encodes T in a single pass, and fails with
+ * NO_MEMORY if the buffer is too small.
+ */
+template <class T>
+status_t encodeMetadata(const MetadataType& metadataType, const T& input, uint8_t* outBuffer,
+                        size_t bufferSize, size_t* outSize, EncodeHelper<T> encodeHelper) {
+    if (!outSize) {
+        return BAD_VALUE;
+    }
+    OutputHidlVec outputHidlVec{outBuffer, bufferSize};
+
+    status_t err = encodeMetadataType(metadataType, &outputHidlVec);
+    if (err) {
+        return err;
+    }
+
+    err = encodeHelper(input, &outputHidlVec);
+    if (err) {
+        return err;
+    }
+
+    *outSize = outputHidlVec.getSize();
+    return NO_ERROR;
+}
+
+template <class T>
+status_t encodeOptionalMetadata(const MetadataType& metadataType, const std::optional<T>& input,
+                        uint8_t* outBuffer, size_t bufferSize, size_t* outSize,
+                        EncodeHelper<T> encodeHelper) {
+    if (!input) {
+        if (!outSize) {
+            return BAD_VALUE;
+        }
+        *outSize = 0;
+        return NO_ERROR;
+    }
+    return encodeMetadata(metadataType, *input, outBuffer, bufferSize, outSize, encodeHelper);
+}
+
 template <class T>
 status_t encodeOptionalMetadata(const MetadataType& metadataType, const std::optional<T>& input,
                         hidl_vec<uint8_t>* output, EncodeHelper<T> encodeHelper) {
@@ -284,9 +367,9 @@ status_t decode(const hidl_vec<uint8_t>& input, T* output, DecodeHelper<T> decod
 }
 
 template <class T>
-status_t decodeMetadata(const MetadataType& metadataType, const hidl_vec<uint8_t>& input, T* output,
-                DecodeHelper<T> decodeHelper, ErrorHandler<T> errorHandler = nullptr) {
-    InputHidlVec inputHidlVec{&input};
+status_t decodeMetadata(const MetadataType& metadataType, const uint8_t* data, size_t size,
+                T* output, DecodeHelper<T> decodeHelper, ErrorHandler<T> errorHandler = nullptr) {
+    InputHidlVec inputHidlVec{data, size};
 
     status_t err = validateMetadataType(&inputHidlVec, metadataType);
     if (err) {
@@ -310,23 +393,36 @@ status_t decodeMetadata(const MetadataType& metadataType, const hidl_vec<uint8_t
 }
 
 template <class T>
-status_t decodeOptionalMetadata(const MetadataType& metadataType, const hidl_vec<uint8_t>& input,
-                        std::optional<T>* output, DecodeHelper<T> decodeHelper) {
+status_t decodeMetadata(const MetadataType& metadataType, const hidl_vec<uint8_t>& input, T* output,
+                DecodeHelper<T> decodeHelper, ErrorHandler<T> errorHandler = nullptr) {
+    return decodeMetadata(metadataType, input.data(), input.size(), output, decodeHelper,
+                          errorHandler);
+}
+
+template <class T>
+status_t decodeOptionalMetadata(const MetadataType& metadataType, const uint8_t* data,
+                        size_t size, std::optional<T>* output, DecodeHelper<T> decodeHelper) {
     if (!output) {
         return BAD_VALUE;
     }
-    if (input.size() <= 0) {
+    if (size <= 0) {
         output->reset();
         return NO_ERROR;
     }
     T tmp;
-    status_t err = decodeMetadata(metadataType, input, &tmp, decodeHelper);
+    status_t err = decodeMetadata(metadataType, data, size, &tmp, decodeHelper);
     if (!err) {
         *output = tmp;
     }
     return err;
 }
 
+template <class T>
+status_t decodeOptionalMetadata(const MetadataType& metadataType, const hidl_vec<uint8_t>& input,
+                        std::optional<T>* output, DecodeHelper<T> decodeHelper) {
+    return decodeOptionalMetadata(metadataType, input.data(), input.size(), output, decodeHelper);
+}
+
 /**
  * Private helper functions
  */
@@ -485,18 +581,28 @@ status_t decodeMetadataType(InputHidlVec* input, MetadataType* output) {
 }
 
 status_t validateMetadataType(InputHidlVec* input, const MetadataType& expectedMetadataType) {
-    MetadataType receivedMetadataType;
-
-    status_t err = decodeMetadataType(input, &receivedMetadataType);
+    // Compare the name in place rather than decoding it, as decoding allocates a string for every
+    // metadata value that is decoded.
+    int64_t nameSize = 0;
+    status_t err = decodeInteger<int64_t>(input, &nameSize);
     if (err) {
         return err;
     }
-
-    if (expectedMetadataType.name != receivedMetadataType.name) {
+    if (nameSize < 0 || static_cast<size_t>(nameSize) != expectedMetadataType.name.size()) {
         return BAD_VALUE;
     }
+    err = input->compare(reinterpret_cast<const uint8_t*>(expectedMetadataType.name.c_str()),
+                         nameSize);
+    if (err) {
+        return err;
+    }
 
-    if (receivedMetadataType.value != expectedMetadataType.value) {
+    int64_t value = 0;
+    err = decodeInteger<int64_t>(input, &value);
+    if (err) {
+        return err;
+    }
+    if (value != expectedMetadataType.value) {
         return BAD_VALUE;
     }
 
@@ -800,13 +906,15 @@ status_t decodePlaneLayoutsHelper(InputHidlVec* inputHidlVec, std::vector<PlaneL
     if (err) {
         return err;
     }
-    if (size < 0) {
+    if (size < 0 || static_cast<size_t>(size) > inputHidlVec->getRemainingSize()) {
         return BAD_VALUE;
     }
 
-    for (size_t i = 0; i < size; i++) {
-        outPlaneLayouts->emplace_back();
-        err = decodePlaneLayout(inputHidlVec, &outPlaneLayouts->back());
+    // Decode into the existing plane layouts, so that a vector that is reused for every buffer
+    // keeps the storage of its plane layouts and their components.
+    outPlaneLayouts->resize(size);
+    for (auto& planeLayout : *outPlaneLayouts) {
+        err = decodePlaneLayout(inputHidlVec, &planeLayout);
         if (err) {
             return err;
         }
@@ -1134,6 +1242,102 @@ status_t decodeSmpte2094_40(const hidl_vec<uint8_t>& smpte2094_40,
                           decodeByteVector);
 }
 
+status_t encodeBufferId(uint64_t bufferId, uint8_t* outBuffer, size_t bufferSize, size_t* outSize) {
+    return encodeMetadata(MetadataType_BufferId, bufferId, outBuffer, bufferSize, outSize, encodeInteger);
+}
+
+status_t decodeBufferId(const uint8_t* bufferId, size_t size, uint64_t* outBufferId) {
+    return decodeMetadata(MetadataType_BufferId, bufferId, size, outBufferId, decodeInteger);
+}
+
+status_t encodeWidth(uint64_t width, uint8_t* outBuffer, size_t bufferSize, size_t* outSize) {
+    return encodeMetadata(MetadataType_Width, width, outBuffer, bufferSize, outSize, encodeInteger);
+}
+
+status_t decodeWidth(const uint8_t* width, size_t size, uint64_t* outWidth) {
+    return decodeMetadata(MetadataType_Width, width, size, outWidth, decodeInteger);
+}
+
+status_t encodeHeight(uint64_t height, uint8_t* outBuffer, size_t bufferSize, size_t* outSize) {
+    return encodeMetadata(MetadataType_Height, height, outBuffer, bufferSize, outSize, encodeInteger);
+}
+
+status_t decodeHeight(const uint8_t* height, size_t size, uint64_t* outHeight) {
+    return decodeMetadata(MetadataType_Height, height, size, outHeight, decodeInteger);
+}
+
+status_t encodeLayerCount(uint64_t layerCount, uint8_t* outBuffer, size_t bufferSize, size_t* outSize) {
+    return encodeMetadata(MetadataType_LayerCount, layerCount, outBuffer, bufferSize, outSize, encodeInteger);
+}
+
+status_t decodeLayerCount(const uint8_t* layerCount, size_t size, uint64_t* outLayerCount) {
+    return decodeMetadata(MetadataType_LayerCount, layerCount, size, outLayerCount, decodeInteger);
+}
+
+status_t encodePixelFormatFourCC(uint32_t pixelFormatFourCC, uint8_t* outBuffer, size_t bufferSize, size_t* outSize) {
+    return encodeMetadata(MetadataType_PixelFormatFourCC, pixelFormatFourCC, outBuffer, bufferSize, outSize, encodeInteger);
+}
+
+status_t decodePixelFormatFourCC(const uint8_t* pixelFormatFourCC, size_t size, uint32_t* outPixelFormatFourCC) {
+    return decodeMetadata(MetadataType_PixelFormatFourCC, pixelFormatFourCC, size, outPixelFormatFourCC, decodeInteger);
+}
+
+status_t encodePixelFormatModifier(uint64_t pixelFormatModifier, uint8_t* outBuffer, size_t bufferSize, size_t* outSize) {
+    return encodeMetadata(MetadataType_PixelFormatModifier, pixelFormatModifier, outBuffer, bufferSize, outSize, encodeInteger);
+}
+
+status_t decodePixelFormatModifier(const uint8_t* pixelFormatModifier, size_t size, uint64_t* outPixelFormatModifier) {
+    return decodeMetadata(MetadataType_PixelFormatModifier, pixelFormatModifier, size, outPixelFormatModifier, decodeInteger);
+}
+
+status_t encodeUsage(uint64_t usage, uint8_t* outBuffer, size_t bufferSize, size_t* outSize) {
+    return encodeMetadata(MetadataType_Usage, usage, outBuffer, bufferSize, outSize, encodeInteger);
+}
+
+status_t decodeUsage(const uint8_t* usage, size_t size, uint64_t* outUsage) {
+    return decodeMetadata(MetadataType_Usage, usage, size, outUsage, decodeInteger);
+}
+
+status_t encodeDataspace(const Dataspace& dataspace, uint8_t* outBuffer, size_t bufferSize,
+                  size_t* outSize) {
+    return encodeMetadata(MetadataType_Dataspace, static_cast<int32_t>(dataspace), outBuffer, bufferSize,
+                  outSize, encodeInteger);
+}
+
+status_t decodeDataspace(const uint8_t* dataspace, size_t size, Dataspace* outDataspace) {
+    return decodeMetadata(MetadataType_Dataspace, dataspace, size, reinterpret_cast<int32_t*>(outDataspace),
+                  decodeInteger);
+}
+
+status_t encodeBlendMode(const BlendMode& blendMode, uint8_t* outBuffer, size_t bufferSize,
+                  size_t* outSize) {
+    return encodeMetadata(MetadataType_BlendMode, static_cast<int32_t>(blendMode), outBuffer, bufferSize,
+                  outSize, encodeInteger);
+}
+
+status_t decodeBlendMode(const uint8_t* blendMode, size_t size, BlendMode* outBlendMode) {
+    return decodeMetadata(MetadataType_BlendMode, blendMode, size, reinterpret_cast<int32_t*>(outBlendMode),
+                  decodeInteger);
+}
+
+status_t decodePlaneLayouts(const uint8_t* planeLayouts, size_t size,
+                            std::vector<PlaneLayout>* outPlaneLayouts) {
+    return decodeMetadata(MetadataType_PlaneLayouts, planeLayouts, size, outPlaneLayouts,
+                  decodePlaneLayoutsHelper, clearPlaneLayouts);
+}
+
+status_t decodeSmpte2086(const uint8_t* smpte2086, size_t size,
+                         std::optional<Smpte2086>* outSmpte2086) {
+    return decodeOptionalMetadata(MetadataType_Smpte2086, smpte2086, size, outSmpte2086,
+                          decodeSmpte2086Helper);
+}
+
+status_t decodeCta861_3(const uint8_t* cta861_3, size_t size,
+                        std::optional<Cta861_3>* outCta861_3) {
+    return decodeOptionalMetadata(MetadataType_Cta861_3, cta861_3, size, outCta861_3,
+                          decodeCta861_3Helper);
+}
+
 status_t encodeUint32(const MetadataType& metadataType, uint32_t input,
                       hidl_vec<uint8_t>* output) {
     return encodeMetadata(metadataType, input, output, encodeInteger);
@@ -327,6 +327,53 @@ status_t encodeSmpte2094_40(const std::optional<std::vector<uint8_t>>& smpte2094
 status_t decodeSmpte2094_40(const android::hardware::hidl_vec<uint8_t>& smpte2094_40,
                             std::optional<std::vector<uint8_t>>* outSmpte2094_40);
 
+/**
+ * The functions below encode and decode the standard metadata that is read for every buffer
+ * that is composed, without allocating. They encode into a caller-provided buffer, failing with
+ * NO_MEMORY if it is smaller than the encoded metadata, and set outSize to the number of bytes
+ * written. kMaxEncodedIntegerMetadataSize bytes are always enough for the integer metadata types.
+ * They decode directly from the bytes returned by IMapper::get(). decodePlaneLayouts() replaces
+ * the contents of outPlaneLayouts and reuses its storage, so a vector that is kept across calls
+ * is only resized when the number of planes or components grows.
+ */
+static constexpr size_t kMaxEncodedIntegerMetadataSize = 128;
+
+status_t encodeBufferId(uint64_t bufferId, uint8_t* outBuffer, size_t bufferSize, size_t* outSize);
+status_t decodeBufferId(const uint8_t* bufferId, size_t size, uint64_t* outBufferId);
+
+status_t encodeWidth(uint64_t width, uint8_t* outBuffer, size_t bufferSize, size_t* outSize);
+status_t decodeWidth(const uint8_t* width, size_t size, uint64_t* outWidth);
+
+status_t encodeHeight(uint64_t height, uint8_t* outBuffer, size_t bufferSize, size_t* outSize);
+status_t decodeHeight(const uint8_t* height, size_t size, uint64_t* outHeight);
+
+status_t encodeLayerCount(uint64_t layerCount, uint8_t* outBuffer, size_t bufferSize, size_t* outSize);
+status_t decodeLayerCount(const uint8_t* layerCount, size_t size, uint64_t* outLayerCount);
+
+status_t encodePixelFormatFourCC(uint32_t pixelFormatFourCC, uint8_t* outBuffer, size_t bufferSize, size_t* outSize);
+status_t decodePixelFormatFourCC(const uint8_t* pixelFormatFourCC, size_t size, uint32_t* outPixelFormatFourCC);
+
+status_t encodePixelFormatModifier(uint64_t pixelFormatModifier, uint8_t* outBuffer, size_t bufferSize, size_t* outSize);
+status_t decodePixelFormatModifier(const uint8_t* pixelFormatModifier, size_t size, uint64_t* outPixelFormatModifier);
+
+status_t encodeUsage(uint64_t usage, uint8_t* outBuffer, size_t bufferSize, size_t* outSize);
+status_t decodeUsage(const uint8_t* usage, size_t size, uint64_t* outUsage);
+
+status_t encodeDataspace(const aidl::android::hardware::graphics::common::Dataspace& dataspace, uint8_t* outBuffer, size_t bufferSize, size_t* outSize);
+status_t decodeDataspace(const uint8_t* dataspace, size_t size, aidl::android::hardware::graphics::common::Dataspace* outDataspace);
+
+status_t encodeBlendMode(const aidl::android::hardware::graphics::common::BlendMode& blendMode, uint8_t* outBuffer, size_t bufferSize, size_t* outSize);
+status_t decodeBlendMode(const uint8_t* blendMode, size_t size, aidl::android::hardware::graphics::common::BlendMode* outBlendMode);
+
+status_t decodePlaneLayouts(const uint8_t* planeLayouts, size_t size, std::vector<aidl::android::hardware::graphics::common::PlaneLayout>* outPlaneLayouts);
+
+status_t decodeSmpte2086(
+        const uint8_t* smpte2086, size_t size,
+        std::optional<aidl::android::hardware::graphics::common::Smpte2086>* outSmpte2086);
+status_t decodeCta861_3(
+        const uint8_t* cta861_3, size_t size,
+        std::optional<aidl::android::hardware::graphics::common::Cta861_3>* outCta861_3);
+
 /**
  * The functions below can be used to encode and decode vendor metadata types.
  */
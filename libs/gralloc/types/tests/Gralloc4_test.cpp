@@ -16,6 +16,7 @@
 
 #define LOG_TAG "Gralloc4Test"
 
+#include <cstring>
 #include <limits>
 
 #include <gralloctypes/Gralloc4.h>
@@ -194,6 +195,23 @@ TEST_P(Gralloc4TestUint64, Usage) {
     ASSERT_NO_FATAL_FAILURE(testHelper(GetParam(), gralloc4::encodeUsage, gralloc4::decodeUsage));
 }
 
+TEST_P(Gralloc4TestUint64, UsageBuffer) {
+    uint8_t buffer[gralloc4::kMaxEncodedIntegerMetadataSize];
+    size_t size = 0;
+    uint64_t output = 0;
+    ASSERT_EQ(NO_ERROR, gralloc4::encodeUsage(GetParam(), buffer, sizeof(buffer), &size));
+    ASSERT_EQ(NO_ERROR, gralloc4::decodeUsage(buffer, size, &output));
+    ASSERT_EQ(GetParam(), output);
+
+    hidl_vec<uint8_t> vec;
+    ASSERT_EQ(NO_ERROR, gralloc4::encodeUsage(GetParam(), &vec));
+    ASSERT_EQ(vec.size(), size);
+    ASSERT_EQ(0, memcmp(vec.data(), buffer, size));
+
+    ASSERT_EQ(NO_MEMORY, gralloc4::encodeUsage(GetParam(), buffer, size - 1, &size));
+    ASSERT_NE(NO_ERROR, gralloc4::decodeUsage(vec.data(), vec.size() - 1, &output));
+}
+
 TEST_P(Gralloc4TestUint64, AllocationSize) {
     ASSERT_NO_FATAL_FAILURE(testHelper(GetParam(), gralloc4::encodeAllocationSize, gralloc4::decodeAllocationSize));
 }
@@ -349,6 +367,28 @@ TEST_F(Gralloc4TestPlaneLayouts, PlaneLayouts) {
     ASSERT_NO_FATAL_FAILURE(testHelperStableAidlType(planeLayouts, gralloc4::encodePlaneLayouts, gralloc4::decodePlaneLayouts));
 }
 
+TEST_F(Gralloc4TestPlaneLayouts, DecodeReusesPlaneLayouts) {
+    PlaneLayout planeLayout;
+    planeLayout.strideInBytes = 64;
+    PlaneLayoutComponent component;
+    component.type = gralloc4::PlaneLayoutComponentType_Y;
+    component.sizeInBits = 8;
+    planeLayout.components.push_back(component);
+
+    hidl_vec<uint8_t> vec;
+    ASSERT_EQ(NO_ERROR, gralloc4::encodePlaneLayouts({planeLayout}, &vec));
+
+    std::vector<PlaneLayout> output(3);
+    ASSERT_EQ(NO_ERROR, gralloc4::decodePlaneLayouts(vec.data(), vec.size(), &output));
+    ASSERT_EQ(1u, output.size());
+    ASSERT_TRUE(planeLayout == output[0]);
+
+    // Decoding again replaces the plane layouts rather than appending to them
+    ASSERT_EQ(NO_ERROR, gralloc4::decodePlaneLayouts(vec, &output));
+    ASSERT_EQ(1u, output.size());
+    ASSERT_TRUE(planeLayout == output[0]);
+}
+
 class Gralloc4TestCrop : public testing::Test { };
 
 TEST_F(Gralloc4TestCrop, Crop) {
@@ -26,6 +26,7 @@
 
 #include <android-base/file.h>
 #include <android-base/properties.h>
+#include <android-base/stringprintf.h>
 #include <android-base/strings.h>
 #include <android/dlext.h>
 #include <binder/IServiceManager.h>
@@ -38,6 +39,7 @@
 
 #include <memory>
 #include <string>
+#include <string_view>
 #include <thread>
 
 // TODO(b/159240322): Extend this to x86 ABI.
@@ -453,14 +455,30 @@ void GraphicsEnv::updateUseAngle() {
         ALOGV("User set \"Developer Options\" to force the use of Native");
         mUseAngle = NO;
     } else {
-        // The "Developer Options" value wasn't set to force the use of ANGLE.  Need to temporarily
-        // load ANGLE and call the updatable opt-in/out logic:
+        // The "Developer Options" value wasn't set to force the use of ANGLE.  The result of the
+        // opt-in/out logic only depends on the app, the ANGLE package and the rules, so use the
+        // result cached by gpuservice for them on a previous launch of the app, if any.
+        const std::string rulesKey =
+                base::StringPrintf("%s:%s:%zx", mAngleAppName.c_str(), mAnglePath.c_str(),
+                                   std::hash<std::string_view>{}(mRulesBuffer.data()));
+        const sp<IGpuService> gpuService = getGpuService();
+        bool useAngle = false;
+        if (gpuService && gpuService->getAngleRulesResult(rulesKey, &useAngle)) {
+            ALOGV("Using the cached result of ANGLE's opt-in/out logic");
+            mUseAngle = useAngle ? YES : NO;
+            return;
+        }
+
+        // Need to temporarily load ANGLE and call the updatable opt-in/out logic:
         void* featureSo = loadLibrary("feature_support");
         if (featureSo) {
             ALOGV("loaded ANGLE's opt-in/out logic from namespace");
             mUseAngle = checkAngleRules(featureSo) ? YES : NO;
             dlclose(featureSo);
             featureSo = nullptr;
+            if (gpuService) {
+                gpuService->setAngleRulesResult(rulesKey, mUseAngle == YES);
+            }
         } else {
             ALOGV("Could not load the ANGLE opt-in/out logic, cannot use ANGLE.");
         }
@@ -81,6 +81,29 @@ public:
         }
         return driverPath;
     }
+
+    void setAngleRulesResult(const std::string& rulesKey, bool useAngle) override {
+        Parcel data, reply;
+        data.writeInterfaceToken(IGpuService::getInterfaceDescriptor());
+        data.writeUtf8AsUtf16(rulesKey);
+        data.writeBool(useAngle);
+
+        remote()->transact(BnGpuService::SET_ANGLE_RULES_RESULT, data, &reply,
+                           IBinder::FLAG_ONEWAY);
+    }
+
+    bool getAngleRulesResult(const std::string& rulesKey, bool* outUseAngle) override {
+        Parcel data, reply;
+        data.writeInterfaceToken(IGpuService::getInterfaceDescriptor());
+        data.writeUtf8AsUtf16(rulesKey);
+
+        status_t error = remote()->transact(BnGpuService::GET_ANGLE_RULES_RESULT, data, &reply);
+        bool found = false;
+        if (error == OK && reply.readBool(&found) == OK && found) {
+            return reply.readBool(outUseAngle) == OK;
+        }
+        return false;
+    }
 };
 
 IMPLEMENT_META_INTERFACE(GpuService, "android.graphicsenv.IGpuService");
@@ -162,6 +185,29 @@ status_t BnGpuService::onTransact(uint32_t code, const Parcel& data, Parcel* rep
             std::string driverPath = getUpdatableDriverPath();
             return reply->writeUtf8AsUtf16(driverPath);
         }
+        case SET_ANGLE_RULES_RESULT: {
+            CHECK_INTERFACE(IGpuService, data, reply);
+
+            std::string rulesKey;
+            if ((status = data.readUtf8FromUtf16(&rulesKey)) != OK) return status;
+
+            bool useAngle;
+            if ((status = data.readBool(&useAngle)) != OK) return status;
+
+            setAngleRulesResult(rulesKey, useAngle);
+            return OK;
+        }
+        case GET_ANGLE_RULES_RESULT: {
+            CHECK_INTERFACE(IGpuService, data, reply);
+
+            std::string rulesKey;
+            if ((status = data.readUtf8FromUtf16(&rulesKey)) != OK) return status;
+
+            bool useAngle = false;
+            const bool found = getAngleRulesResult(rulesKey, &useAngle);
+            if ((status = reply->writeBool(found)) != OK) return status;
+            return reply->writeBool(useAngle);
+        }
         case SHELL_COMMAND_TRANSACTION: {
             int in = data.readFileDescriptor();
             int out = data.readFileDescriptor();
@@ -46,6 +46,11 @@ public:
     // setter and getter for updatable driver path.
     virtual void setUpdatableDriverPath(const std::string& driverPath) = 0;
     virtual std::string getUpdatableDriverPath() = 0;
+
+    // setter and getter for the cached result of the ANGLE rules of the calling app. The getter
+    // returns false if no result is cached for rulesKey.
+    virtual void setAngleRulesResult(const std::string& rulesKey, bool useAngle) = 0;
+    virtual bool getAngleRulesResult(const std::string& rulesKey, bool* outUseAngle) = 0;
 };
 
 class BnGpuService : public BnInterface<IGpuService> {
@@ -55,6 +60,8 @@ public:
         SET_TARGET_STATS,
         SET_UPDATABLE_DRIVER_PATH,
         GET_UPDATABLE_DRIVER_PATH,
+        SET_ANGLE_RULES_RESULT,
+        GET_ANGLE_RULES_RESULT,
         // Always append new enum to the end.
     };
 
@@ -61,6 +61,11 @@ void BLASTBufferItemConsumer::addAndGetFrameTimestamps(const NewFrameEventsEntry
     }
 }
 
+status_t BLASTBufferItemConsumer::getFrameTimestampsMemory(base::unique_fd* outFd) {
+    Mutex::Autolock lock(mFrameEventHistoryMutex);
+    return mFrameEventHistory.shareTimestamps(outFd);
+}
+
 void BLASTBufferItemConsumer::updateFrameTimestamps(uint64_t frameNumber, nsecs_t refreshStartTime,
                                                     const sp<Fence>& glDoneFence,
                                                     const sp<Fence>& presentFence,
@@ -183,9 +188,11 @@ void BLASTBufferQueue::transactionCallback(nsecs_t /*latchTime*/, const sp<Fence
 
     if (mSubmitted.empty()) {
         ALOGE("ERROR: callback with no corresponding submitted buffer item");
+    } else {
+        mPendingReleaseItem.item = std::move(mSubmitted.front());
+        mSubmitted.pop();
+        mFrameStats.presentedFrames++;
     }
-    mPendingReleaseItem.item = std::move(mSubmitted.front());
-    mSubmitted.pop();
 
     processNextBufferLocked(false);
 
@@ -195,7 +202,7 @@ void BLASTBufferQueue::transactionCallback(nsecs_t /*latchTime*/, const sp<Fence
 
 void BLASTBufferQueue::processNextBufferLocked(bool useNextTransaction) {
     ATRACE_CALL();
-    if (mNumFrameAvailable == 0 || mNumAcquired == MAX_ACQUIRED_BUFFERS + 1) {
+    if (mNumFrameAvailable == 0 || mNumAcquired >= mMaxAcquiredBuffers + 1) {
         return;
     }
 
@@ -227,6 +234,29 @@ void BLASTBufferQueue::processNextBufferLocked(bool useNextTransaction) {
         return;
     }
 
+    // Coalesce the buffers queued behind this one, releasing all but the newest. The consumer
+    // is allowed one extra acquired buffer in this mode so the newer buffer can be acquired
+    // before the older one is released.
+    while (mDropSupersededFrames && mNumFrameAvailable > 0) {
+        BufferItem nextItem;
+        if (mBufferItemConsumer->acquireBuffer(&nextItem, -1, false) != OK) {
+            break;
+        }
+        mNumFrameAvailable--;
+        if (nextItem.mGraphicBuffer == nullptr) {
+            mBufferItemConsumer->releaseBuffer(nextItem, Fence::NO_FENCE);
+            continue;
+        }
+        // The dropped buffer was never read, so the producer only has to wait for its own
+        // rendering to finish before reusing it.
+        mBufferItemConsumer->releaseBuffer(bufferItem,
+                                           bufferItem.mFence ? bufferItem.mFence
+                                                             : Fence::NO_FENCE);
+        mFrameStats.droppedFrames++;
+        bufferItem = std::move(nextItem);
+    }
+    buffer = bufferItem.mGraphicBuffer;
+
     mNumAcquired++;
     mSubmitted.push(bufferItem);
 
@@ -269,7 +299,7 @@ void BLASTBufferQueue::onFrameAvailable(const BufferItem& /*item*/) {
     std::unique_lock _lock{mMutex};
 
     if (mNextTransaction != nullptr) {
-        while (mNumFrameAvailable > 0 || mNumAcquired == MAX_ACQUIRED_BUFFERS + 1) {
+        while (mNumFrameAvailable > 0 || mNumAcquired >= mMaxAcquiredBuffers + 1) {
             mCallbackCV.wait(_lock);
         }
     }
@@ -283,4 +313,31 @@ void BLASTBufferQueue::setNextTransaction(SurfaceComposerClient::Transaction* t)
     mNextTransaction = t;
 }
 
+status_t BLASTBufferQueue::setFrameDropping(bool enabled, int maxTransactionsInFlight) {
+    std::lock_guard _lock{mMutex};
+    const int maxAcquiredBuffers = enabled ? maxTransactionsInFlight : MAX_ACQUIRED_BUFFERS;
+    if (maxAcquiredBuffers < 1) {
+        return BAD_VALUE;
+    }
+
+    // The extra acquired buffer lets a newer buffer be acquired before the one it supersedes
+    // is released.
+    status_t status =
+            mBufferItemConsumer->setMaxAcquiredBufferCount(maxAcquiredBuffers + (enabled ? 1 : 0));
+    if (status != OK) {
+        return status;
+    }
+    mMaxAcquiredBuffers = maxAcquiredBuffers;
+    mDropSupersededFrames = enabled;
+
+    // Raising the limit may allow buffers that were waiting to be sent now.
+    processNextBufferLocked(false);
+    return OK;
+}
+
+BLASTBufferQueue::FrameStats BLASTBufferQueue::getFrameStats() {
+    std::lock_guard _lock{mMutex};
+    return mFrameStats;
+}
+
 } // namespace android
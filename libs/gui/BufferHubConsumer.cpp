@@ -152,6 +152,11 @@ status_t BufferHubConsumer::dumpState(const String8& /*prefix*/, String8* /*outR
     return INVALID_OPERATION;
 }
 
+status_t BufferHubConsumer::setAdaptiveBufferCount(bool /*enabled*/) {
+    ALOGE("BufferHubConsumer::setAdaptiveBufferCount: not implemented.");
+    return INVALID_OPERATION;
+}
+
 IBinder* BufferHubConsumer::onAsBinder() {
     ALOGE("BufferHubConsumer::onAsBinder: BufferHubConsumer should never be used as an Binder "
           "object.");
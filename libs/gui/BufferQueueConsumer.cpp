@@ -393,7 +393,7 @@ status_t BufferQueueConsumer::attachBuffer(int* outSlot,
         mCore->mFreeSlots.erase(slot);
     } else if (!mCore->mFreeBuffers.empty()) {
         found = mCore->mFreeBuffers.front();
-        mCore->mFreeBuffers.remove(found);
+        mCore->mFreeBuffers.pop_front();
     }
     if (found == BufferQueueCore::INVALID_BUFFER_SLOT) {
         BQ_LOGE("attachBuffer: could not find free buffer slot");
@@ -783,6 +783,29 @@ status_t BufferQueueConsumer::discardFreeBuffers() {
     return NO_ERROR;
 }
 
+status_t BufferQueueConsumer::setAdaptiveBufferCount(bool enabled) {
+    ATRACE_CALL();
+    BQ_LOGV("setAdaptiveBufferCount: %d", enabled);
+    std::lock_guard<std::mutex> lock(mCore->mMutex);
+
+    if (mCore->mIsAbandoned) {
+        BQ_LOGE("setAdaptiveBufferCount: BufferQueue has been abandoned");
+        return NO_INIT;
+    }
+
+    mCore->mAdaptiveBufferCount = enabled;
+    mCore->mAdaptiveWindow = BufferQueueCore::AdaptiveWindow();
+    mCore->mIdleAdaptiveWindows = 0;
+    if (!enabled &&
+        !mCore->setAdaptiveMaxDequeuedBufferCountLocked(mCore->mRequestedMaxDequeuedBufferCount)) {
+        // The producer has more buffers dequeued than it requested, so the
+        // count cannot be lowered until it calls setMaxDequeuedBufferCount.
+        BQ_LOGW("setAdaptiveBufferCount: keeping max dequeued buffer count %d",
+                mCore->mMaxDequeuedBufferCount);
+    }
+    return NO_ERROR;
+}
+
 status_t BufferQueueConsumer::dumpState(const String8& prefix, String8* outResult) const {
     struct passwd* pwd = getpwnam("shell");
     uid_t shellUid = pwd ? pwd->pw_uid : 0;
@@ -131,7 +131,12 @@ BufferQueueCore::BufferQueueCore()
         mLastQueuedSlot(INVALID_BUFFER_SLOT),
         mUniqueId(getUniqueId()),
         mAutoPrerotation(false),
-        mTransformHintInUse(0) {
+        mTransformHintInUse(0),
+        mAdaptiveBufferCount(false),
+        mRequestedMaxDequeuedBufferCount(1),
+        mAdaptiveWindow(),
+        mIdleAdaptiveWindows(0),
+        mBufferCountDecisions() {
     int numStartingBuffers = getMaxBufferCountLocked();
     for (int s = 0; s < numStartingBuffers; s++) {
         mFreeSlots.insert(s);
@@ -158,6 +163,20 @@ void BufferQueueCore::dumpState(const String8& prefix, String8* outResult) const
                             mDefaultWidth, mDefaultHeight, mDefaultBufferFormat);
     outResult->appendFormat("%s  transform-hint=%02x frame-counter=%" PRIu64 "\n", prefix.string(),
                             mTransformHint, mFrameCounter);
+    if (mAdaptiveBufferCount || !mBufferCountDecisions.empty()) {
+        outResult->appendFormat("%s  adaptive-buffer-count=%d requested-max-dequeued=%d\n",
+                                prefix.string(), mAdaptiveBufferCount,
+                                mRequestedMaxDequeuedBufferCount);
+        const nsecs_t now = systemTime();
+        for (const BufferCountDecision& decision : mBufferCountDecisions) {
+            outResult->appendFormat("%s   %.3fs ago: max-dequeued %d -> %d (frames=%zu "
+                                    "starved-dequeues=%zu max-dequeued=%d max-occupancy=%zu)\n",
+                                    prefix.string(), ns2ms(now - decision.time) / 1000.0,
+                                    decision.from, decision.to, decision.window.frames,
+                                    decision.window.starvedDequeues, decision.window.maxDequeued,
+                                    decision.window.maxOccupancy);
+        }
+    }
     outResult->appendFormat("%s  mTransformHintInUse=%02x mAutoPrerotation=%d\n", prefix.string(),
                             mTransformHintInUse, mAutoPrerotation);
 
@@ -365,6 +384,96 @@ bool BufferQueueCore::adjustAvailableSlotsLocked(int delta) {
     return true;
 }
 
+bool BufferQueueCore::setAdaptiveMaxDequeuedBufferCountLocked(int maxDequeuedBuffers) {
+    const int delta = maxDequeuedBuffers - mMaxDequeuedBufferCount;
+    if (delta == 0) {
+        return true;
+    }
+
+    int dequeuedCount = 0;
+    for (int s : mActiveBuffers) {
+        if (mSlots[s].mBufferState.isDequeued()) {
+            dequeuedCount++;
+        }
+    }
+    if (dequeuedCount > maxDequeuedBuffers) {
+        return false;
+    }
+
+    const int bufferCount = getMinUndequeuedBufferCountLocked() + maxDequeuedBuffers;
+    if (bufferCount > BufferQueueDefs::NUM_BUFFER_SLOTS || bufferCount > mMaxBufferCount ||
+        bufferCount < getMinMaxBufferCountLocked()) {
+        return false;
+    }
+
+    if (!adjustAvailableSlotsLocked(delta)) {
+        return false;
+    }
+    mMaxDequeuedBufferCount = maxDequeuedBuffers;
+    mDequeueCondition.notify_all();
+    return true;
+}
+
+void BufferQueueCore::registerDequeueLocked(int dequeuedCount, bool starved) {
+    if (!mAdaptiveBufferCount) {
+        return;
+    }
+    mAdaptiveWindow.maxDequeued = std::max(mAdaptiveWindow.maxDequeued, dequeuedCount);
+    if (starved) {
+        mAdaptiveWindow.starvedDequeues++;
+    }
+}
+
+bool BufferQueueCore::updateAdaptiveBufferCountLocked() {
+    if (!mAdaptiveBufferCount) {
+        return false;
+    }
+
+    mAdaptiveWindow.frames++;
+    mAdaptiveWindow.maxOccupancy = std::max(mAdaptiveWindow.maxOccupancy, mQueue.size());
+    if (mAdaptiveWindow.frames < kAdaptiveWindowFrames) {
+        return false;
+    }
+
+    const AdaptiveWindow window = mAdaptiveWindow;
+    mAdaptiveWindow = AdaptiveWindow();
+
+    int maxDequeuedBuffers = mMaxDequeuedBufferCount;
+    if (window.starvedDequeues >= kStarvedDequeuesToGrow) {
+        // The producer had to wait for buffers while the consumer had nothing
+        // queued, so another buffer would have kept the pipeline busy
+        mIdleAdaptiveWindows = 0;
+        maxDequeuedBuffers = std::min(maxDequeuedBuffers + 1,
+                                      mRequestedMaxDequeuedBufferCount + kMaxAdaptiveExtraBuffers);
+    } else if (window.starvedDequeues == 0 && window.maxOccupancy <= 1 &&
+               window.maxDequeued < mMaxDequeuedBufferCount) {
+        // A buffer the producer could have dequeued sat idle the whole window
+        if (++mIdleAdaptiveWindows >= kIdleAdaptiveWindows) {
+            mIdleAdaptiveWindows = 0;
+            maxDequeuedBuffers =
+                    std::max(maxDequeuedBuffers - 1, mRequestedMaxDequeuedBufferCount);
+        }
+    } else {
+        mIdleAdaptiveWindows = 0;
+    }
+
+    const int previous = mMaxDequeuedBufferCount;
+    if (maxDequeuedBuffers == previous ||
+        !setAdaptiveMaxDequeuedBufferCountLocked(maxDequeuedBuffers)) {
+        return false;
+    }
+
+    BQ_LOGV("updateAdaptiveBufferCountLocked: max dequeued %d -> %d (starved %zu, max dequeued "
+            "%d, max occupancy %zu)",
+            previous, maxDequeuedBuffers, window.starvedDequeues, window.maxDequeued,
+            window.maxOccupancy);
+    mBufferCountDecisions.push_front({systemTime(), previous, maxDequeuedBuffers, window});
+    if (mBufferCountDecisions.size() > kMaxBufferCountDecisions) {
+        mBufferCountDecisions.pop_back();
+    }
+    return maxDequeuedBuffers < previous;
+}
+
 void BufferQueueCore::waitWhileAllocatingLocked(std::unique_lock<std::mutex>& lock) const {
     ATRACE_CALL();
     while (mIsAllocating) {
@@ -378,13 +487,9 @@ void BufferQueueCore::validateConsistencyLocked() const {
     int allocatedSlots = 0;
     for (int slot = 0; slot < BufferQueueDefs::NUM_BUFFER_SLOTS; ++slot) {
         bool isInFreeSlots = mFreeSlots.count(slot) != 0;
-        bool isInFreeBuffers =
-                std::find(mFreeBuffers.cbegin(), mFreeBuffers.cend(), slot) !=
-                mFreeBuffers.cend();
+        bool isInFreeBuffers = mFreeBuffers.count(slot) != 0;
         bool isInActiveBuffers = mActiveBuffers.count(slot) != 0;
-        bool isInUnusedSlots =
-                std::find(mUnusedSlots.cbegin(), mUnusedSlots.cend(), slot) !=
-                mUnusedSlots.cend();
+        bool isInUnusedSlots = mUnusedSlots.count(slot) != 0;
 
         if (isInFreeSlots || isInFreeBuffers || isInActiveBuffers) {
             allocatedSlots++;
@@ -15,6 +15,7 @@
  */
 
 #include <inttypes.h>
+#include <unistd.h>
 
 #define LOG_TAG "BufferQueueProducer"
 #define ATRACE_TAG ATRACE_TAG_GRAPHICS
@@ -36,12 +37,15 @@
 #include <gui/IConsumerListener.h>
 #include <gui/IProducerListener.h>
 #include <private/gui/BufferQueueThreadState.h>
+#include <private/gui/GraphicBufferPool.h>
 
 #include <utils/Log.h>
 #include <utils/Trace.h>
 
 #include <system/window.h>
 
+#include <vector>
+
 namespace android {
 
 // Macros for include BufferQueueCore information in log messages
@@ -134,6 +138,7 @@ status_t BufferQueueProducer::setMaxDequeuedBufferCount(
             return NO_INIT;
         }
 
+        mCore->mRequestedMaxDequeuedBufferCount = maxDequeuedBuffers;
         if (maxDequeuedBuffers == mCore->mMaxDequeuedBufferCount) {
             return NO_ERROR;
         }
@@ -270,11 +275,17 @@ int BufferQueueProducer::getFreeSlotLocked() const {
     return slot;
 }
 
+bool BufferQueueProducer::usesBufferPoolLocked() const {
+    // Pooled buffers keep their contents, so they must not move between processes
+    return mCore->mConnectedPid == getpid() && !mCore->mSharedBufferMode;
+}
+
 status_t BufferQueueProducer::waitForFreeSlotThenRelock(FreeSlotCaller caller,
         std::unique_lock<std::mutex>& lock, int* found) const {
     auto callerString = (caller == FreeSlotCaller::Dequeue) ?
             "dequeueBuffer" : "attachBuffer";
     bool tryAgain = true;
+    bool starved = false;
     while (tryAgain) {
         if (mCore->mIsAbandoned) {
             BQ_LOGE("%s: BufferQueue has been abandoned", callerString);
@@ -361,6 +372,9 @@ status_t BufferQueueProducer::waitForFreeSlotThenRelock(FreeSlotCaller caller,
                     (acquiredCount <= mCore->mMaxAcquiredBufferCount)) {
                 return WOULD_BLOCK;
             }
+            // Waiting while nothing is queued means that every buffer is
+            // dequeued or acquired, so the producer is starved of buffers
+            starved = starved || mCore->mQueue.empty();
             if (mDequeueTimeout >= 0) {
                 std::cv_status result = mCore->mDequeueCondition.wait_for(lock,
                         std::chrono::nanoseconds(mDequeueTimeout));
@@ -373,6 +387,16 @@ status_t BufferQueueProducer::waitForFreeSlotThenRelock(FreeSlotCaller caller,
         }
     } // while (tryAgain)
 
+    if (caller == FreeSlotCaller::Dequeue) {
+        int dequeuedCount = 0;
+        for (int s : mCore->mActiveBuffers) {
+            if (mSlots[s].mBufferState.isDequeued()) {
+                ++dequeuedCount;
+            }
+        }
+        mCore->registerDequeueLocked(dequeuedCount + 1, starved);
+    }
+
     return NO_ERROR;
 }
 
@@ -407,6 +431,9 @@ status_t BufferQueueProducer::dequeueBuffer(int* outSlot, sp<android::Fence>* ou
     EGLDisplay eglDisplay = EGL_NO_DISPLAY;
     EGLSyncKHR eglFence = EGL_NO_SYNC_KHR;
     bool attachedByConsumer = false;
+    bool usesBufferPool = false;
+    sp<GraphicBuffer> replacedBuffer;
+    sp<Fence> replacedFence;
 
     { // Autolock scope
         std::unique_lock<std::mutex> lock(mCore->mMutex);
@@ -493,6 +520,14 @@ status_t BufferQueueProducer::dequeueBuffer(int* outSlot, sp<android::Fence>* ou
         if ((buffer == nullptr) ||
                 buffer->needsReallocation(width, height, format, BQ_LAYER_COUNT, usage))
         {
+            usesBufferPool = usesBufferPoolLocked();
+            // Hand the buffer being replaced to the pool, e.g. when the surface is resized,
+            // unless only the EGL fence tells when the consumer is done with it
+            if (usesBufferPool && mSlots[found].mEglFence == EGL_NO_SYNC_KHR) {
+                replacedBuffer = buffer;
+                replacedFence = mSlots[found].mFence;
+            }
+
             mSlots[found].mAcquireCalled = false;
             mSlots[found].mGraphicBuffer = nullptr;
             mSlots[found].mRequestBufferCalled = false;
@@ -544,10 +579,21 @@ status_t BufferQueueProducer::dequeueBuffer(int* outSlot, sp<android::Fence>* ou
     } // Autolock scope
 
     if (returnFlags & BUFFER_NEEDS_REALLOCATION) {
-        BQ_LOGV("dequeueBuffer: allocating a new buffer for slot %d", *outSlot);
-        sp<GraphicBuffer> graphicBuffer = new GraphicBuffer(
-                width, height, format, BQ_LAYER_COUNT, usage,
-                {mConsumerName.string(), mConsumerName.size()});
+        sp<GraphicBuffer> graphicBuffer;
+        if (usesBufferPool) {
+            GraphicBufferPool& pool = GraphicBufferPool::getInstance();
+            pool.put(replacedBuffer, replacedFence);
+            replacedBuffer.clear();
+            graphicBuffer = pool.take(width, height, format, BQ_LAYER_COUNT, usage, outFence);
+        }
+        if (graphicBuffer != nullptr) {
+            BQ_LOGV("dequeueBuffer: reusing pooled buffer %" PRIu64 " for slot %d",
+                    graphicBuffer->getId(), *outSlot);
+        } else {
+            BQ_LOGV("dequeueBuffer: allocating a new buffer for slot %d", *outSlot);
+            graphicBuffer = new GraphicBuffer(width, height, format, BQ_LAYER_COUNT, usage,
+                                              {mConsumerName.string(), mConsumerName.size()});
+        }
 
         status_t error = graphicBuffer->initCheck();
 
@@ -713,7 +759,7 @@ status_t BufferQueueProducer::detachNextBuffer(sp<GraphicBuffer>* outBuffer,
         }
 
         int found = mCore->mFreeBuffers.front();
-        mCore->mFreeBuffers.remove(found);
+        mCore->mFreeBuffers.pop_front();
         mCore->mFreeSlots.insert(found);
 
         BQ_LOGV("detachNextBuffer detached slot %d", found);
@@ -841,6 +887,7 @@ status_t BufferQueueProducer::queueBuffer(int slot,
 
     sp<IConsumerListener> frameAvailableListener;
     sp<IConsumerListener> frameReplacedListener;
+    sp<IConsumerListener> buffersReleasedListener;
     int callbackTicket = 0;
     uint64_t currentFrameNumber = 0;
     BufferItem item;
@@ -1010,6 +1057,9 @@ status_t BufferQueueProducer::queueBuffer(int slot,
 #ifndef NO_BINDER
         mCore->mOccupancyTracker.registerOccupancyChange(mCore->mQueue.size());
 #endif
+        if (mCore->updateAdaptiveBufferCountLocked()) {
+            buffersReleasedListener = mCore->mConsumerListener;
+        }
         // Take a ticket for the callback functions
         callbackTicket = mNextCallbackTicket++;
 
@@ -1063,6 +1113,10 @@ status_t BufferQueueProducer::queueBuffer(int slot,
         mCallbackCondition.notify_all();
     }
 
+    if (buffersReleasedListener != nullptr) {
+        buffersReleasedListener->onBuffersReleased();
+    }
+
     // Wait without lock held
     if (connectedApi == NATIVE_WINDOW_API_EGL) {
         // Waiting here allows for two full buffers to be queued but not a
@@ -1297,6 +1351,7 @@ status_t BufferQueueProducer::disconnect(int api, DisconnectMode mode) {
 
     int status = NO_ERROR;
     sp<IConsumerListener> listener;
+    std::vector<std::pair<sp<GraphicBuffer>, sp<Fence>>> pooledBuffers;
     { // Autolock scope
         std::unique_lock<std::mutex> lock(mCore->mMutex);
 
@@ -1333,6 +1388,16 @@ status_t BufferQueueProducer::disconnect(int api, DisconnectMode mode) {
             case NATIVE_WINDOW_API_MEDIA:
             case NATIVE_WINDOW_API_CAMERA:
                 if (mCore->mConnectedApi == api) {
+                    // Buffers the consumer is done with can be reused by the next surface
+                    // of this process
+                    if (usesBufferPoolLocked()) {
+                        for (int s : mCore->mFreeBuffers) {
+                            if (mSlots[s].mEglFence == EGL_NO_SYNC_KHR) {
+                                pooledBuffers.emplace_back(mSlots[s].mGraphicBuffer,
+                                                           mSlots[s].mFence);
+                            }
+                        }
+                    }
                     mCore->freeAllBuffersLocked();
 
 #ifndef NO_BINDER
@@ -1372,6 +1437,10 @@ status_t BufferQueueProducer::disconnect(int api, DisconnectMode mode) {
         }
     } // Autolock scope
 
+    for (const auto& [buffer, fence] : pooledBuffers) {
+        GraphicBufferPool::getInstance().put(buffer, fence);
+    }
+
     // Call back without lock held
     if (listener != nullptr) {
         listener->onBuffersReleased();
@@ -1407,6 +1476,7 @@ void BufferQueueProducer::allocateBuffers(uint32_t width, uint32_t height,
         PixelFormat allocFormat = PIXEL_FORMAT_UNKNOWN;
         uint64_t allocUsage = 0;
         std::string allocName;
+        bool usesBufferPool = false;
         { // Autolock scope
             std::unique_lock<std::mutex> lock(mCore->mMutex);
             mCore->waitWhileAllocatingLocked(lock);
@@ -1417,9 +1487,9 @@ void BufferQueueProducer::allocateBuffers(uint32_t width, uint32_t height,
                 return;
             }
 
-            // Only allocate one buffer at a time to reduce risks of overlapping an allocation from
-            // both allocateBuffers and dequeueBuffer.
-            newBufferCount = mCore->mFreeSlots.empty() ? 0 : 1;
+            // Allocate a buffer for every free slot at once, as a single allocator call for all
+            // of them is much cheaper than one call per buffer.
+            newBufferCount = mCore->mFreeSlots.size();
             if (newBufferCount == 0) {
                 return;
             }
@@ -1434,27 +1504,45 @@ void BufferQueueProducer::allocateBuffers(uint32_t width, uint32_t height,
             allocFormat = format != 0 ? format : mCore->mDefaultBufferFormat;
             allocUsage = usage | mCore->mConsumerUsageBits;
             allocName.assign(mCore->mConsumerName.string(), mCore->mConsumerName.size());
+            usesBufferPool = usesBufferPoolLocked();
 
             mCore->mIsAllocating = true;
         } // Autolock scope
 
-        Vector<sp<GraphicBuffer>> buffers;
-        for (size_t i = 0; i < newBufferCount; ++i) {
-            sp<GraphicBuffer> graphicBuffer = new GraphicBuffer(
-                    allocWidth, allocHeight, allocFormat, BQ_LAYER_COUNT,
-                    allocUsage, allocName);
-
-            status_t result = graphicBuffer->initCheck();
+        std::vector<sp<GraphicBuffer>> buffers;
+        std::vector<sp<Fence>> fences;
+        while (usesBufferPool && buffers.size() < newBufferCount) {
+            sp<Fence> fence = Fence::NO_FENCE;
+            sp<GraphicBuffer> graphicBuffer =
+                    GraphicBufferPool::getInstance().take(allocWidth, allocHeight, allocFormat,
+                                                          BQ_LAYER_COUNT, allocUsage, &fence);
+            if (graphicBuffer == nullptr) {
+                break;
+            }
+            buffers.push_back(std::move(graphicBuffer));
+            fences.push_back(std::move(fence));
+        }
 
+        const size_t pooledBufferCount = buffers.size();
+        if (pooledBufferCount < newBufferCount) {
+            status_t result =
+                    GraphicBuffer::allocateMultiple(allocWidth, allocHeight, allocFormat,
+                                                    BQ_LAYER_COUNT, allocUsage,
+                                                    newBufferCount - pooledBufferCount, allocName,
+                                                    &buffers);
             if (result != NO_ERROR) {
-                BQ_LOGE("allocateBuffers: failed to allocate buffer (%u x %u, format"
-                        " %u, usage %#" PRIx64 ")", width, height, format, usage);
+                BQ_LOGE("allocateBuffers: failed to allocate %zu buffers (%u x %u, format"
+                        " %u, usage %#" PRIx64 ")", newBufferCount - pooledBufferCount, width,
+                        height, format, usage);
                 std::lock_guard<std::mutex> lock(mCore->mMutex);
                 mCore->mIsAllocating = false;
                 mCore->mIsAllocatingCondition.notify_all();
+                for (size_t i = 0; i < pooledBufferCount; ++i) {
+                    GraphicBufferPool::getInstance().put(buffers[i], fences[i]);
+                }
                 return;
             }
-            buffers.push_back(graphicBuffer);
+            fences.resize(buffers.size(), Fence::NO_FENCE);
         }
 
         { // Autolock scope
@@ -1475,6 +1563,11 @@ void BufferQueueProducer::allocateBuffers(uint32_t width, uint32_t height,
                 BQ_LOGV("allocateBuffers: size/format/usage changed while allocating. Retrying.");
                 mCore->mIsAllocating = false;
                 mCore->mIsAllocatingCondition.notify_all();
+                if (usesBufferPool) {
+                    for (size_t i = 0; i < newBufferCount; ++i) {
+                        GraphicBufferPool::getInstance().put(buffers[i], fences[i]);
+                    }
+                }
                 continue;
             }
 
@@ -1487,7 +1580,7 @@ void BufferQueueProducer::allocateBuffers(uint32_t width, uint32_t height,
                 auto slot = mCore->mFreeSlots.begin();
                 mCore->clearBufferSlotLocked(*slot); // Clean up the slot first
                 mSlots[*slot].mGraphicBuffer = buffers[i];
-                mSlots[*slot].mFence = Fence::NO_FENCE;
+                mSlots[*slot].mFence = fences[i];
 
                 // freeBufferLocked puts this slot on the free slots list. Since
                 // we then attached a buffer, move the slot to free buffer list.
@@ -1625,6 +1718,23 @@ void BufferQueueProducer::getFrameTimestamps(FrameEventHistoryDelta* outDelta) {
     addAndGetFrameTimestamps(nullptr, outDelta);
 }
 
+status_t BufferQueueProducer::getFrameTimestampsMemory(base::unique_fd* outFd) {
+    ATRACE_CALL();
+    sp<IConsumerListener> listener;
+    {
+        std::lock_guard<std::mutex> lock(mCore->mMutex);
+        if (mCore->mIsAbandoned) {
+            BQ_LOGE("getFrameTimestampsMemory: BufferQueue has been abandoned");
+            return NO_INIT;
+        }
+        listener = mCore->mConsumerListener;
+    }
+    if (listener == nullptr) {
+        return NO_INIT;
+    }
+    return listener->getFrameTimestampsMemory(outFd);
+}
+
 void BufferQueueProducer::addAndGetFrameTimestamps(
         const NewFrameEventsEntry* newTimestamps,
         FrameEventHistoryDelta* outDelta) {
@@ -23,6 +23,8 @@
 #include <gui/BufferItem.h>
 #include <utils/Log.h>
 
+#include <unistd.h>
+
 #define CC_LOGV(x, ...) ALOGV("[%s] " x, mName.string(), ##__VA_ARGS__)
 //#define CC_LOGD(x, ...) ALOGD("[%s] " x, mName.string(), ##__VA_ARGS__)
 //#define CC_LOGI(x, ...) ALOGI("[%s] " x, mName.string(), ##__VA_ARGS__)
@@ -35,7 +37,9 @@ CpuConsumer::CpuConsumer(const sp<IGraphicBufferConsumer>& bq,
         size_t maxLockedBuffers, bool controlledByApp) :
     ConsumerBase(bq, controlledByApp),
     mMaxLockedBuffers(maxLockedBuffers),
-    mCurrentLockedBuffers(0)
+    mCurrentLockedBuffers(0),
+    mHasPendingBuffer(false),
+    mPersistentMapping(false)
 {
     // Create tracking entries for locked buffers
     mAcquiredBuffers.insertAt(0, maxLockedBuffers);
@@ -148,32 +152,113 @@ status_t CpuConsumer::lockBufferItem(const BufferItem& item, LockedBuffer* outBu
     return OK;
 }
 
+void CpuConsumer::mapBufferLocked(const BufferItem& item) {
+    if (mMappedBuffers[item.mSlot] == item.mGraphicBuffer) {
+        return;
+    }
+    unmapBufferLocked(item.mSlot);
+
+    // This lock only keeps the buffer mapped, so it does not need to wait for
+    // the producer. Each lockBufferItem still locks the buffer after the
+    // acquire fence, which does the cache maintenance for that frame.
+    const sp<GraphicBuffer>& buffer = item.mGraphicBuffer;
+    void* bufferPointer = nullptr;
+    status_t err = buffer->lockAsync(GraphicBuffer::USAGE_SW_READ_OFTEN, &bufferPointer, -1);
+    if (err != OK) {
+        android_ycbcr ycbcr = android_ycbcr();
+        err = buffer->lockAsyncYCbCr(GraphicBuffer::USAGE_SW_READ_OFTEN,
+                                     Rect(buffer->getWidth(), buffer->getHeight()), &ycbcr, -1);
+    }
+    if (err != OK) {
+        CC_LOGW("Unable to map buffer in slot %d persistently: %s (%d)", item.mSlot,
+                strerror(-err), err);
+        return;
+    }
+    mMappedBuffers[item.mSlot] = buffer;
+}
+
+void CpuConsumer::unmapBufferLocked(int slot) {
+    if (mMappedBuffers[slot] == nullptr) {
+        return;
+    }
+
+    int fenceFd = -1;
+    status_t err = mMappedBuffers[slot]->unlockAsync(&fenceFd);
+    if (err != OK) {
+        CC_LOGE("Unable to unmap buffer in slot %d: %s (%d)", slot, strerror(-err), err);
+    }
+    // Nothing was written through the mapping, so there is nothing to wait for
+    if (fenceFd >= 0) {
+        close(fenceFd);
+    }
+    mMappedBuffers[slot].clear();
+}
+
+void CpuConsumer::setPersistentMapping(bool enabled) {
+    Mutex::Autolock _l(mMutex);
+    mPersistentMapping = enabled;
+    if (!enabled) {
+        for (int slot = 0; slot < BufferQueue::NUM_BUFFER_SLOTS; slot++) {
+            unmapBufferLocked(slot);
+        }
+    }
+}
+
+void CpuConsumer::freeBufferLocked(int slotIndex) {
+    unmapBufferLocked(slotIndex);
+    ConsumerBase::freeBufferLocked(slotIndex);
+}
+
 status_t CpuConsumer::lockNextBuffer(LockedBuffer *nativeBuffer) {
+    return lockNextBuffer(nativeBuffer, nullptr);
+}
+
+status_t CpuConsumer::lockNextBuffer(LockedBuffer *nativeBuffer, sp<Fence>* outFence) {
     status_t err;
 
     if (!nativeBuffer) return BAD_VALUE;
 
     Mutex::Autolock _l(mMutex);
 
-    if (mCurrentLockedBuffers == mMaxLockedBuffers) {
-        CC_LOGW("Max buffers have been locked (%zd), cannot lock anymore.",
-                mMaxLockedBuffers);
-        return NOT_ENOUGH_DATA;
+    BufferItem b;
+    if (mHasPendingBuffer) {
+        b = mPendingBuffer;
+        mPendingBuffer = BufferItem();
+        mHasPendingBuffer = false;
+    } else {
+        if (mCurrentLockedBuffers == mMaxLockedBuffers) {
+            CC_LOGW("Max buffers have been locked (%zd), cannot lock anymore.",
+                    mMaxLockedBuffers);
+            return NOT_ENOUGH_DATA;
+        }
+
+        err = acquireBufferLocked(&b, 0);
+        if (err != OK) {
+            if (err == BufferQueue::NO_BUFFER_AVAILABLE) {
+                return BAD_VALUE;
+            } else {
+                CC_LOGE("Error acquiring buffer: %s (%d)", strerror(err), err);
+                return err;
+            }
+        }
+
+        if (b.mGraphicBuffer == nullptr) {
+            b.mGraphicBuffer = mSlots[b.mSlot].mGraphicBuffer;
+        }
     }
 
-    BufferItem b;
-    err = acquireBufferLocked(&b, 0);
-    if (err != OK) {
-        if (err == BufferQueue::NO_BUFFER_AVAILABLE) {
-            return BAD_VALUE;
-        } else {
-            CC_LOGE("Error acquiring buffer: %s (%d)", strerror(err), err);
-            return err;
+    if (outFence) {
+        if (b.mFence != nullptr && b.mFence->getStatus() == Fence::Status::Unsignaled) {
+            *outFence = b.mFence;
+            mPendingBuffer = b;
+            mHasPendingBuffer = true;
+            return WOULD_BLOCK;
         }
+        *outFence = Fence::NO_FENCE;
     }
 
-    if (b.mGraphicBuffer == nullptr) {
-        b.mGraphicBuffer = mSlots[b.mSlot].mGraphicBuffer;
+    if (mPersistentMapping) {
+        mapBufferLocked(b);
     }
 
     err = lockBufferItem(b, nativeBuffer);
@@ -21,6 +21,7 @@
 
 #include <gui/DisplayEventDispatcher.h>
 #include <gui/DisplayEventReceiver.h>
+#include <private/gui/VsyncTimeline.h>
 #include <utils/Log.h>
 #include <utils/Looper.h>
 
@@ -40,6 +41,8 @@ DisplayEventDispatcher::DisplayEventDispatcher(const sp<Looper>& looper,
     ALOGV("dispatcher %p ~ Initializing display event dispatcher.", this);
 }
 
+DisplayEventDispatcher::~DisplayEventDispatcher() = default;
+
 status_t DisplayEventDispatcher::initialize() {
     status_t result = mReceiver.initCheck();
     if (result) {
@@ -57,11 +60,35 @@ status_t DisplayEventDispatcher::initialize() {
     return OK;
 }
 
+status_t DisplayEventDispatcher::enableVsyncTimeline() {
+    auto timeline = std::make_unique<gui::VsyncTimeline>();
+    status_t result = mReceiver.getVsyncTimeline(timeline.get(), mLooper != nullptr);
+    if (result) {
+        ALOGW("Failed to get the vsync timeline, status=%d", result);
+        return result;
+    }
+
+    if (mLooper != nullptr) {
+        int rc = mLooper->addFd(timeline->getWakeFd(), 0, Looper::EVENT_INPUT, this, NULL);
+        if (rc < 0) {
+            return UNKNOWN_ERROR;
+        }
+    }
+
+    gui::VsyncTimeline::Vsync vsync;
+    mVsyncSequence = timeline->read(&vsync);
+    mVsyncTimeline = std::move(timeline);
+    return OK;
+}
+
 void DisplayEventDispatcher::dispose() {
     ALOGV("dispatcher %p ~ Disposing display event dispatcher.", this);
 
     if (!mReceiver.initCheck() && mLooper != nullptr) {
         mLooper->removeFd(mReceiver.getFd());
+        if (mVsyncTimeline) {
+            mLooper->removeFd(mVsyncTimeline->getWakeFd());
+        }
     }
 }
 
@@ -77,6 +104,9 @@ status_t DisplayEventDispatcher::scheduleVsync() {
             ALOGE("dispatcher %p ~ last event processed while scheduling was for %" PRId64 "", this,
                   ns2ms(static_cast<nsecs_t>(vsyncTimestamp)));
         }
+        if (mVsyncTimeline) {
+            processVsyncTimeline(&vsyncTimestamp, &vsyncDisplayId, &vsyncCount);
+        }
 
         status_t status = mReceiver.requestNextVsync();
         if (status) {
@@ -97,7 +127,7 @@ int DisplayEventDispatcher::getFd() const {
     return mReceiver.getFd();
 }
 
-int DisplayEventDispatcher::handleEvent(int, int events, void*) {
+int DisplayEventDispatcher::handleEvent(int receiveFd, int events, void*) {
     if (events & (Looper::EVENT_ERROR | Looper::EVENT_HANGUP)) {
         ALOGE("Display event receiver pipe was closed or an error occurred.  "
               "events=0x%x",
@@ -112,11 +142,21 @@ int DisplayEventDispatcher::handleEvent(int, int events, void*) {
         return 1; // keep the callback
     }
 
-    // Drain all pending events, keep the last vsync.
+    // Drain all pending events, keep the last vsync. Wakes from the vsync timeline don't need
+    // to read from the receiver.
     nsecs_t vsyncTimestamp;
     PhysicalDisplayId vsyncDisplayId;
     uint32_t vsyncCount;
-    if (processPendingEvents(&vsyncTimestamp, &vsyncDisplayId, &vsyncCount)) {
+    bool gotVsync = false;
+    if (!mVsyncTimeline || receiveFd != mVsyncTimeline->getWakeFd()) {
+        gotVsync = processPendingEvents(&vsyncTimestamp, &vsyncDisplayId, &vsyncCount);
+    }
+    // Vsyncs published for the other receivers of the timeline are skipped until requested.
+    if (mVsyncTimeline && processVsyncTimeline(&vsyncTimestamp, &vsyncDisplayId, &vsyncCount) &&
+        mWaitingForVsync) {
+        gotVsync = true;
+    }
+    if (gotVsync) {
         ALOGV("dispatcher %p ~ Vsync pulse: timestamp=%" PRId64
               ", displayId=%" ANDROID_PHYSICAL_DISPLAY_ID_FORMAT ", count=%d",
               this, ns2ms(vsyncTimestamp), vsyncDisplayId, vsyncCount);
@@ -168,4 +208,23 @@ bool DisplayEventDispatcher::processPendingEvents(nsecs_t* outTimestamp,
     return gotVsync;
 }
 
+bool DisplayEventDispatcher::processVsyncTimeline(nsecs_t* outTimestamp,
+                                                  PhysicalDisplayId* outDisplayId,
+                                                  uint32_t* outCount) {
+    // Reading the wake fd resets it, so the vsyncs published while the app was busy only wake
+    // up the Looper once.
+    mVsyncTimeline->consumeWake();
+
+    gui::VsyncTimeline::Vsync vsync;
+    const uint32_t sequence = mVsyncTimeline->read(&vsync);
+    if (sequence == mVsyncSequence) {
+        return false;
+    }
+    mVsyncSequence = sequence;
+    *outTimestamp = vsync.timestamp;
+    *outDisplayId = vsync.displayId;
+    *outCount = vsync.count;
+    return true;
+}
+
 } // namespace android
@@ -79,6 +79,13 @@ status_t DisplayEventReceiver::requestNextVsync() {
     return NO_INIT;
 }
 
+status_t DisplayEventReceiver::getVsyncTimeline(gui::VsyncTimeline* outTimeline, bool wakeFd) {
+    if (mEventConnection != nullptr) {
+        return mEventConnection->getVsyncTimeline(wakeFd, outTimeline);
+    }
+    return NO_INIT;
+}
+
 ssize_t DisplayEventReceiver::getEvents(DisplayEventReceiver::Event* events,
         size_t count) {
     return DisplayEventReceiver::getEvents(mDataChannel.get(), events, count);
@@ -15,12 +15,14 @@
 */
 
 #include <gui/FrameTimestamps.h>
+#include <private/gui/FrameTimestampsRing.h>
 
 #define LOG_TAG "FrameEvents"
 
 #include <LibGuiProperties.sysprop.h>
 #include <android-base/stringprintf.h>
 #include <cutils/compiler.h>  // For CC_[UN]LIKELY
+#include <errno.h>
 #include <inttypes.h>
 #include <utils/Log.h>
 
@@ -312,6 +314,45 @@ void ProducerFrameEventHistory::applyDelta(
     }
 }
 
+void ProducerFrameEventHistory::applySharedFrame(const gui::FrameTimestampsRing& ring,
+                                                 uint64_t frameNumber) {
+    FrameEvents* frame = getFrame(frameNumber);
+    gui::FrameTimestampsRing::Frame shared;
+    if (frame == nullptr || !ring.read(frameNumber, &shared)) {
+        return;
+    }
+
+    auto applyTimestamp = [](nsecs_t* dst, nsecs_t src) {
+        if (FrameEvents::isValidTimestamp(src)) {
+            *dst = src;
+        }
+    };
+    applyTimestamp(&frame->latchTime, shared.latchTime);
+    applyTimestamp(&frame->firstRefreshStartTime, shared.firstRefreshStartTime);
+    applyTimestamp(&frame->lastRefreshStartTime, shared.lastRefreshStartTime);
+    applyTimestamp(&frame->dequeueReadyTime, shared.dequeueReadyTime);
+
+    // The flags tell the caller that the fences are known, so only set them once the fences'
+    // signal times are known too. Otherwise the fences come with the next delta.
+    if (shared.addPostCompositeCalled && !frame->addPostCompositeCalled &&
+        shared.gpuCompositionDoneTime != Fence::SIGNAL_TIME_PENDING &&
+        shared.displayPresentTime != Fence::SIGNAL_TIME_PENDING) {
+        frame->gpuCompositionDoneFence =
+                std::make_shared<FenceTime>(shared.gpuCompositionDoneTime);
+        frame->displayPresentFence = std::make_shared<FenceTime>(shared.displayPresentTime);
+        frame->addPostCompositeCalled = true;
+    }
+    if (shared.addReleaseCalled && !frame->addReleaseCalled &&
+        shared.releaseTime != Fence::SIGNAL_TIME_PENDING) {
+        frame->releaseFence = std::make_shared<FenceTime>(shared.releaseTime);
+        frame->addReleaseCalled = true;
+    }
+}
+
+void ProducerFrameEventHistory::applySharedCompositorTiming(const gui::FrameTimestampsRing& ring) {
+    ring.readCompositorTiming(&mCompositorTiming);
+}
+
 void ProducerFrameEventHistory::updateSignalTimes() {
     mAcquireTimeline.updateSignalTimes();
     mGpuCompositionDoneTimeline.updateSignalTimes();
@@ -330,6 +371,11 @@ void ProducerFrameEventHistory::applyFenceDelta(FenceTimeline* timeline,
         case FenceTime::Snapshot::State::EMPTY:
             return;
         case FenceTime::Snapshot::State::FENCE:
+            // The signal time may already be known from the shared timestamps
+            if ((*dst)->isValid() &&
+                (*dst)->getCachedSignalTime() != Fence::SIGNAL_TIME_PENDING) {
+                return;
+            }
             ALOGE_IF((*dst)->isValid(), "applyFenceDelta: Unexpected fence.");
             *dst = createFenceTime(src.fence);
             timeline->push(*dst);
@@ -401,6 +447,7 @@ void ConsumerFrameEventHistory::addLatch(
     }
     frame->latchTime = latchTime;
     mFramesDirty[mCompositionOffset].setDirty<FrameEvent::LATCH>();
+    publishShared(*frame);
 }
 
 void ConsumerFrameEventHistory::addPreComposition(
@@ -417,6 +464,7 @@ void ConsumerFrameEventHistory::addPreComposition(
         frame->firstRefreshStartTime = refreshStartTime;
         mFramesDirty[mCompositionOffset].setDirty<FrameEvent::FIRST_REFRESH_START>();
     }
+    publishShared(*frame);
 }
 
 void ConsumerFrameEventHistory::addPostComposition(uint64_t frameNumber,
@@ -441,6 +489,14 @@ void ConsumerFrameEventHistory::addPostComposition(uint64_t frameNumber,
             mFramesDirty[mCompositionOffset].setDirty<FrameEvent::DISPLAY_PRESENT>();
         }
     }
+
+    if (mSharedTimestamps) {
+        mSharedTimestamps->publishCompositorTiming(mCompositorTiming);
+        // Republish all frames, since the fences of earlier ones may have signaled since
+        for (const auto& f : mFrames) {
+            publishShared(f);
+        }
+    }
 }
 
 void ConsumerFrameEventHistory::addRelease(uint64_t frameNumber,
@@ -454,6 +510,7 @@ void ConsumerFrameEventHistory::addRelease(uint64_t frameNumber,
     frame->dequeueReadyTime = dequeueReadyTime;
     frame->releaseFence = std::move(release);
     mFramesDirty[mReleaseOffset].setDirty<FrameEvent::RELEASE>();
+    publishShared(*frame);
 }
 
 void ConsumerFrameEventHistory::getFrameDelta(FrameEventHistoryDelta* delta,
@@ -489,6 +546,28 @@ void ConsumerFrameEventHistory::getAndResetDelta(
     }
 }
 
+status_t ConsumerFrameEventHistory::shareTimestamps(base::unique_fd* outFd) {
+    if (!mSharedTimestamps) {
+        mSharedTimestamps = gui::FrameTimestampsRing::create();
+        if (!mSharedTimestamps) {
+            return NO_MEMORY;
+        }
+        mSharedTimestamps->publishCompositorTiming(mCompositorTiming);
+        for (const auto& frame : mFrames) {
+            publishShared(frame);
+        }
+    }
+
+    *outFd = mSharedTimestamps->dupFd();
+    return *outFd >= 0 ? NO_ERROR : -errno;
+}
+
+void ConsumerFrameEventHistory::publishShared(const FrameEvents& frame) {
+    if (mSharedTimestamps) {
+        mSharedTimestamps->publish(frame);
+    }
+}
+
 
 // ============================================================================
 // FrameEventsDelta
@@ -0,0 +1,247 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "FrameTimestampsRing"
+
+#include <private/gui/FrameTimestampsRing.h>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <new>
+
+#include <cutils/ashmem.h>
+#include <log/log.h>
+
+namespace android {
+namespace gui {
+
+namespace {
+
+constexpr uint32_t kMagic = 0x46545352; // 'FTSR'
+
+// Bits of Slot::flags
+constexpr uint32_t kAddPostCompositeCalled = 1 << 0;
+constexpr uint32_t kAddReleaseCalled = 1 << 1;
+
+// A reader gives up after this many torn reads and falls back to binder instead
+constexpr int kMaxReadAttempts = 4;
+
+} // namespace
+
+struct FrameTimestampsRing::Page {
+    struct Slot {
+        // Odd while the frame is being written
+        std::atomic<uint32_t> sequence;
+        std::atomic<uint32_t> flags;
+        std::atomic<uint64_t> frameNumber;
+        std::atomic<int64_t> latchTime;
+        std::atomic<int64_t> firstRefreshStartTime;
+        std::atomic<int64_t> lastRefreshStartTime;
+        std::atomic<int64_t> dequeueReadyTime;
+        std::atomic<int64_t> gpuCompositionDoneTime;
+        std::atomic<int64_t> displayPresentTime;
+        std::atomic<int64_t> releaseTime;
+    };
+
+    uint32_t magic;
+    // Odd while the compositor timing is being written, and zero until it is first written
+    std::atomic<uint32_t> timingSequence;
+    std::atomic<int64_t> deadline;
+    std::atomic<int64_t> interval;
+    std::atomic<int64_t> presentLatency;
+    Slot slots[kFrameCount];
+};
+
+// The page is shared across processes, so its atomics must not rely on a lock
+static_assert(std::atomic<int64_t>::is_always_lock_free);
+static_assert(std::atomic<uint64_t>::is_always_lock_free);
+
+namespace {
+
+nsecs_t getCachedSignalTime(const std::shared_ptr<FenceTime>& fence) {
+    // Only the cached time is published, so publishing never makes a syscall. The consumer's
+    // fence timelines update it as the fences signal.
+    return fence ? fence->getCachedSignalTime() : Fence::SIGNAL_TIME_INVALID;
+}
+
+} // namespace
+
+FrameTimestampsRing::~FrameTimestampsRing() {
+    munmap(mPage, sizeof(Page));
+}
+
+FrameTimestampsRing::Page* FrameTimestampsRing::mapPage(int fd, bool writable) {
+    void* page = mmap(nullptr, sizeof(Page), writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                      MAP_SHARED, fd, 0);
+    if (page == MAP_FAILED) {
+        ALOGE("Failed to map the frame timestamps: %s", strerror(errno));
+        return nullptr;
+    }
+    return static_cast<Page*>(page);
+}
+
+std::unique_ptr<FrameTimestampsRing> FrameTimestampsRing::create() {
+    base::unique_fd fd(ashmem_create_region("FrameTimestampsRing", sizeof(Page)));
+    if (fd < 0) {
+        ALOGE("Failed to allocate the frame timestamps: %s", strerror(errno));
+        return nullptr;
+    }
+
+    Page* page = mapPage(fd, true);
+    if (!page) {
+        return nullptr;
+    }
+    // The memory is zero-filled when allocated, so the page is only constructed by its writer
+    new (page) Page{};
+    page->magic = kMagic;
+    std::unique_ptr<FrameTimestampsRing> ring(new FrameTimestampsRing(std::move(fd), page, true));
+
+    // Only the pages mapped so far may write to the memory
+    if (ashmem_set_prot_region(ring->mFd, PROT_READ) < 0) {
+        ALOGE("Failed to make the frame timestamps read-only: %s", strerror(errno));
+        return nullptr;
+    }
+    return ring;
+}
+
+std::unique_ptr<FrameTimestampsRing> FrameTimestampsRing::map(base::unique_fd fd) {
+    if (fd < 0 || ashmem_get_size_region(fd) < static_cast<int>(sizeof(Page))) {
+        return nullptr;
+    }
+    Page* page = mapPage(fd, false);
+    if (!page) {
+        return nullptr;
+    }
+    if (page->magic != kMagic) {
+        munmap(page, sizeof(Page));
+        return nullptr;
+    }
+    return std::unique_ptr<FrameTimestampsRing>(
+            new FrameTimestampsRing(std::move(fd), page, false));
+}
+
+base::unique_fd FrameTimestampsRing::dupFd() const {
+    return base::unique_fd(dup(mFd));
+}
+
+void FrameTimestampsRing::publish(const FrameEvents& frame) {
+    LOG_ALWAYS_FATAL_IF(!mWritable, "Publishing to read-only frame timestamps");
+    if (!frame.valid) {
+        return;
+    }
+
+    Page::Slot& slot = mPage->slots[frame.frameNumber % kFrameCount];
+    // The consumer may keep more frames than the ring, so don't let them replace newer ones
+    if (slot.frameNumber.load(std::memory_order_relaxed) > frame.frameNumber) {
+        return;
+    }
+
+    const uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+    slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.flags.store((frame.addPostCompositeCalled ? kAddPostCompositeCalled : 0) |
+                             (frame.addReleaseCalled ? kAddReleaseCalled : 0),
+                     std::memory_order_relaxed);
+    slot.frameNumber.store(frame.frameNumber, std::memory_order_relaxed);
+    slot.latchTime.store(frame.latchTime, std::memory_order_relaxed);
+    slot.firstRefreshStartTime.store(frame.firstRefreshStartTime, std::memory_order_relaxed);
+    slot.lastRefreshStartTime.store(frame.lastRefreshStartTime, std::memory_order_relaxed);
+    slot.dequeueReadyTime.store(frame.dequeueReadyTime, std::memory_order_relaxed);
+    slot.gpuCompositionDoneTime.store(getCachedSignalTime(frame.gpuCompositionDoneFence),
+                                      std::memory_order_relaxed);
+    slot.displayPresentTime.store(getCachedSignalTime(frame.displayPresentFence),
+                                  std::memory_order_relaxed);
+    slot.releaseTime.store(getCachedSignalTime(frame.releaseFence), std::memory_order_relaxed);
+
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+void FrameTimestampsRing::publishCompositorTiming(const CompositorTiming& compositorTiming) {
+    LOG_ALWAYS_FATAL_IF(!mWritable, "Publishing to read-only frame timestamps");
+
+    const uint32_t sequence = mPage->timingSequence.load(std::memory_order_relaxed);
+    mPage->timingSequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    mPage->deadline.store(compositorTiming.deadline, std::memory_order_relaxed);
+    mPage->interval.store(compositorTiming.interval, std::memory_order_relaxed);
+    mPage->presentLatency.store(compositorTiming.presentLatency, std::memory_order_relaxed);
+
+    mPage->timingSequence.store(sequence + 2, std::memory_order_release);
+}
+
+bool FrameTimestampsRing::read(uint64_t frameNumber, Frame* outFrame) const {
+    const Page::Slot& slot = mPage->slots[frameNumber % kFrameCount];
+    for (int attempt = 0; attempt < kMaxReadAttempts; attempt++) {
+        const uint32_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence & 1) {
+            continue;
+        }
+        if (slot.frameNumber.load(std::memory_order_relaxed) != frameNumber) {
+            return false;
+        }
+
+        const uint32_t flags = slot.flags.load(std::memory_order_relaxed);
+        outFrame->frameNumber = frameNumber;
+        outFrame->addPostCompositeCalled = flags & kAddPostCompositeCalled;
+        outFrame->addReleaseCalled = flags & kAddReleaseCalled;
+        outFrame->latchTime = slot.latchTime.load(std::memory_order_relaxed);
+        outFrame->firstRefreshStartTime =
+                slot.firstRefreshStartTime.load(std::memory_order_relaxed);
+        outFrame->lastRefreshStartTime = slot.lastRefreshStartTime.load(std::memory_order_relaxed);
+        outFrame->dequeueReadyTime = slot.dequeueReadyTime.load(std::memory_order_relaxed);
+        outFrame->gpuCompositionDoneTime =
+                slot.gpuCompositionDoneTime.load(std::memory_order_relaxed);
+        outFrame->displayPresentTime = slot.displayPresentTime.load(std::memory_order_relaxed);
+        outFrame->releaseTime = slot.releaseTime.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) == sequence) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool FrameTimestampsRing::readCompositorTiming(CompositorTiming* outCompositorTiming) const {
+    for (int attempt = 0; attempt < kMaxReadAttempts; attempt++) {
+        const uint32_t sequence = mPage->timingSequence.load(std::memory_order_acquire);
+        if (sequence == 0) {
+            return false;
+        }
+        if (sequence & 1) {
+            continue;
+        }
+
+        outCompositorTiming->deadline = mPage->deadline.load(std::memory_order_relaxed);
+        outCompositorTiming->interval = mPage->interval.load(std::memory_order_relaxed);
+        outCompositorTiming->presentLatency =
+                mPage->presentLatency.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (mPage->timingSequence.load(std::memory_order_relaxed) == sequence) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace gui
+} // namespace android
@@ -0,0 +1,119 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "GraphicBufferPool"
+#define ATRACE_TAG ATRACE_TAG_GRAPHICS
+//#define LOG_NDEBUG 0
+
+#include <private/gui/GraphicBufferPool.h>
+
+#include <LibGuiProperties.sysprop.h>
+#include <utils/Log.h>
+#include <utils/Trace.h>
+
+#include <algorithm>
+#include <inttypes.h>
+#include <iterator>
+
+namespace android {
+
+ANDROID_SINGLETON_STATIC_INSTANCE(GraphicBufferPool);
+
+GraphicBufferPool::GraphicBufferPool()
+      : Singleton<GraphicBufferPool>(),
+        mMaxBytes(static_cast<size_t>(
+                std::max(sysprop::LibGuiProperties::buffer_pool_size_kb().value_or(0), 0)) *
+                  1024) {}
+
+size_t GraphicBufferPool::getMaxBytes() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mMaxBytes;
+}
+
+size_t GraphicBufferPool::getPooledBytes() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mPooledBytes;
+}
+
+void GraphicBufferPool::setMaxBytes(size_t maxBytes) {
+    std::list<PooledBuffer> evicted;
+    std::lock_guard<std::mutex> lock(mMutex);
+    mMaxBytes = maxBytes;
+    evictLocked(maxBytes, &evicted);
+}
+
+void GraphicBufferPool::put(const sp<GraphicBuffer>& buffer, const sp<Fence>& fence) {
+    if (buffer == nullptr || buffer->initCheck() != NO_ERROR) {
+        return;
+    }
+
+    // Declared before the lock so that evicted buffers are freed after it is released.
+    std::list<PooledBuffer> evicted;
+    std::lock_guard<std::mutex> lock(mMutex);
+    const size_t size = getBufferSize(buffer);
+    if (size > mMaxBytes) {
+        return;
+    }
+
+    evictLocked(mMaxBytes - size, &evicted);
+    ALOGV("put: buffer %" PRIu64 " (%u x %u, format %d, %zu bytes)", buffer->getId(),
+          buffer->getWidth(), buffer->getHeight(), buffer->getPixelFormat(), size);
+    mBuffers.push_front({buffer, fence != nullptr ? fence : Fence::NO_FENCE, size});
+    mPooledBytes += size;
+}
+
+sp<GraphicBuffer> GraphicBufferPool::take(uint32_t width, uint32_t height, PixelFormat format,
+                                          uint32_t layerCount, uint64_t usage,
+                                          sp<Fence>* outFence) {
+    ATRACE_CALL();
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (auto it = mBuffers.begin(); it != mBuffers.end(); ++it) {
+        if (it->buffer->needsReallocation(width, height, format, layerCount, usage)) {
+            continue;
+        }
+
+        sp<GraphicBuffer> buffer = std::move(it->buffer);
+        *outFence = std::move(it->fence);
+        mPooledBytes -= it->size;
+        mBuffers.erase(it);
+        ALOGV("take: buffer %" PRIu64 " (%u x %u, format %d)", buffer->getId(), width, height,
+              format);
+        return buffer;
+    }
+    return nullptr;
+}
+
+void GraphicBufferPool::clear() {
+    std::list<PooledBuffer> evicted;
+    std::lock_guard<std::mutex> lock(mMutex);
+    evictLocked(0, &evicted);
+}
+
+size_t GraphicBufferPool::getBufferSize(const sp<GraphicBuffer>& buffer) {
+    // Formats without a fixed pixel size, e.g. YUV formats, count 2 bytes per pixel
+    const uint32_t pixelSize = std::max(bytesPerPixel(buffer->getPixelFormat()), 2u);
+    return static_cast<size_t>(buffer->getStride()) * buffer->getHeight() * pixelSize *
+            buffer->getLayerCount();
+}
+
+void GraphicBufferPool::evictLocked(size_t maxBytes, std::list<PooledBuffer>* outEvicted) {
+    while (!mBuffers.empty() && mPooledBytes > maxBytes) {
+        mPooledBytes -= mBuffers.back().size;
+        outEvicted->splice(outEvicted->begin(), mBuffers, std::prev(mBuffers.end()));
+    }
+}
+
+} // namespace android
@@ -17,6 +17,7 @@
 #include <gui/IDisplayEventConnection.h>
 
 #include <private/gui/BitTube.h>
+#include <private/gui/VsyncTimeline.h>
 
 namespace android {
 
@@ -26,7 +27,8 @@ enum class Tag : uint32_t {
     STEAL_RECEIVE_CHANNEL = IBinder::FIRST_CALL_TRANSACTION,
     SET_VSYNC_RATE,
     REQUEST_NEXT_VSYNC,
-    LAST = REQUEST_NEXT_VSYNC,
+    GET_VSYNC_TIMELINE,
+    LAST = GET_VSYNC_TIMELINE,
 };
 
 } // Anonymous namespace
@@ -53,6 +55,11 @@ public:
         callRemoteAsync<decltype(&IDisplayEventConnection::requestNextVsync)>(
                 Tag::REQUEST_NEXT_VSYNC);
     }
+
+    status_t getVsyncTimeline(bool wakeFd, gui::VsyncTimeline* outTimeline) override {
+        return callRemote<decltype(&IDisplayEventConnection::getVsyncTimeline)>(
+                Tag::GET_VSYNC_TIMELINE, wakeFd, outTimeline);
+    }
 };
 
 // Out-of-line virtual method definition to trigger vtable emission in this translation unit (see
@@ -74,6 +81,8 @@ status_t BnDisplayEventConnection::onTransact(uint32_t code, const Parcel& data,
             return callLocal(data, reply, &IDisplayEventConnection::setVsyncRate);
         case Tag::REQUEST_NEXT_VSYNC:
             return callLocalAsync(data, reply, &IDisplayEventConnection::requestNextVsync);
+        case Tag::GET_VSYNC_TIMELINE:
+            return callLocal(data, reply, &IDisplayEventConnection::getVsyncTimeline);
     }
 }
 
@@ -52,7 +52,8 @@ enum class Tag : uint32_t {
     GET_OCCUPANCY_HISTORY,
     DISCARD_FREE_BUFFERS,
     DUMP_STATE,
-    LAST = DUMP_STATE,
+    SET_ADAPTIVE_BUFFER_COUNT,
+    LAST = SET_ADAPTIVE_BUFFER_COUNT,
 };
 
 } // Anonymous namespace
@@ -167,6 +168,11 @@ public:
         using Signature = status_t (IGraphicBufferConsumer::*)(const String8&, String8*) const;
         return callRemote<Signature>(Tag::DUMP_STATE, prefix, outResult);
     }
+
+    status_t setAdaptiveBufferCount(bool enabled) override {
+        return callRemote<decltype(&IGraphicBufferConsumer::setAdaptiveBufferCount)>(
+                Tag::SET_ADAPTIVE_BUFFER_COUNT, enabled);
+    }
 };
 
 // Out-of-line virtual method definition to trigger vtable emission in this translation unit
@@ -177,54 +183,45 @@ IMPLEMENT_META_INTERFACE(GraphicBufferConsumer, "android.gui.IGraphicBufferConsu
 
 status_t BnGraphicBufferConsumer::onTransact(uint32_t code, const Parcel& data, Parcel* reply,
                                              uint32_t flags) {
-    if (code < IBinder::FIRST_CALL_TRANSACTION || code > static_cast<uint32_t>(Tag::LAST)) {
-        return BBinder::onTransact(code, data, reply, flags);
-    }
-    auto tag = static_cast<Tag>(code);
-    switch (tag) {
-        case Tag::ACQUIRE_BUFFER:
-            return callLocal(data, reply, &IGraphicBufferConsumer::acquireBuffer);
-        case Tag::DETACH_BUFFER:
-            return callLocal(data, reply, &IGraphicBufferConsumer::detachBuffer);
-        case Tag::ATTACH_BUFFER:
-            return callLocal(data, reply, &IGraphicBufferConsumer::attachBuffer);
-        case Tag::RELEASE_BUFFER:
-            return callLocal(data, reply, &IGraphicBufferConsumer::releaseHelper);
-        case Tag::CONSUMER_CONNECT:
-            return callLocal(data, reply, &IGraphicBufferConsumer::consumerConnect);
-        case Tag::CONSUMER_DISCONNECT:
-            return callLocal(data, reply, &IGraphicBufferConsumer::consumerDisconnect);
-        case Tag::GET_RELEASED_BUFFERS:
-            return callLocal(data, reply, &IGraphicBufferConsumer::getReleasedBuffers);
-        case Tag::SET_DEFAULT_BUFFER_SIZE:
-            return callLocal(data, reply, &IGraphicBufferConsumer::setDefaultBufferSize);
-        case Tag::SET_MAX_BUFFER_COUNT:
-            return callLocal(data, reply, &IGraphicBufferConsumer::setMaxBufferCount);
-        case Tag::SET_MAX_ACQUIRED_BUFFER_COUNT:
-            return callLocal(data, reply, &IGraphicBufferConsumer::setMaxAcquiredBufferCount);
-        case Tag::SET_CONSUMER_NAME:
-            return callLocal(data, reply, &IGraphicBufferConsumer::setConsumerName);
-        case Tag::SET_DEFAULT_BUFFER_FORMAT:
-            return callLocal(data, reply, &IGraphicBufferConsumer::setDefaultBufferFormat);
-        case Tag::SET_DEFAULT_BUFFER_DATA_SPACE:
-            return callLocal(data, reply, &IGraphicBufferConsumer::setDefaultBufferDataSpace);
-        case Tag::SET_CONSUMER_USAGE_BITS:
-            return callLocal(data, reply, &IGraphicBufferConsumer::setConsumerUsageBits);
-        case Tag::SET_CONSUMER_IS_PROTECTED:
-            return callLocal(data, reply, &IGraphicBufferConsumer::setConsumerIsProtected);
-        case Tag::SET_TRANSFORM_HINT:
-            return callLocal(data, reply, &IGraphicBufferConsumer::setTransformHint);
-        case Tag::GET_SIDEBAND_STREAM:
-            return callLocal(data, reply, &IGraphicBufferConsumer::getSidebandStream);
-        case Tag::GET_OCCUPANCY_HISTORY:
-            return callLocal(data, reply, &IGraphicBufferConsumer::getOccupancyHistory);
-        case Tag::DISCARD_FREE_BUFFERS:
-            return callLocal(data, reply, &IGraphicBufferConsumer::discardFreeBuffers);
-        case Tag::DUMP_STATE: {
-            using Signature = status_t (IGraphicBufferConsumer::*)(const String8&, String8*) const;
-            return callLocal<Signature>(data, reply, &IGraphicBufferConsumer::dumpState);
-        }
-    }
+    using DumpState = status_t (IGraphicBufferConsumer::*)(const String8&, String8*) const;
+    static constexpr auto kDispatchTable = makeDispatchTable<Tag>({
+            {Tag::ACQUIRE_BUFFER, &dispatchLocal<&IGraphicBufferConsumer::acquireBuffer>},
+            {Tag::DETACH_BUFFER, &dispatchLocal<&IGraphicBufferConsumer::detachBuffer>},
+            {Tag::ATTACH_BUFFER, &dispatchLocal<&IGraphicBufferConsumer::attachBuffer>},
+            {Tag::RELEASE_BUFFER, &dispatchLocal<&IGraphicBufferConsumer::releaseHelper>},
+            {Tag::CONSUMER_CONNECT, &dispatchLocal<&IGraphicBufferConsumer::consumerConnect>},
+            {Tag::CONSUMER_DISCONNECT,
+             &dispatchLocal<&IGraphicBufferConsumer::consumerDisconnect>},
+            {Tag::GET_RELEASED_BUFFERS,
+             &dispatchLocal<&IGraphicBufferConsumer::getReleasedBuffers>},
+            {Tag::SET_DEFAULT_BUFFER_SIZE,
+             &dispatchLocal<&IGraphicBufferConsumer::setDefaultBufferSize>},
+            {Tag::SET_MAX_BUFFER_COUNT, &dispatchLocal<&IGraphicBufferConsumer::setMaxBufferCount>},
+            {Tag::SET_MAX_ACQUIRED_BUFFER_COUNT,
+             &dispatchLocal<&IGraphicBufferConsumer::setMaxAcquiredBufferCount>},
+            {Tag::SET_CONSUMER_NAME, &dispatchLocal<&IGraphicBufferConsumer::setConsumerName>},
+            {Tag::SET_DEFAULT_BUFFER_FORMAT,
+             &dispatchLocal<&IGraphicBufferConsumer::setDefaultBufferFormat>},
+            {Tag::SET_DEFAULT_BUFFER_DATA_SPACE,
+             &dispatchLocal<&IGraphicBufferConsumer::setDefaultBufferDataSpace>},
+            {Tag::SET_CONSUMER_USAGE_BITS,
+             &dispatchLocal<&IGraphicBufferConsumer::setConsumerUsageBits>},
+            {Tag::SET_CONSUMER_IS_PROTECTED,
+             &dispatchLocal<&IGraphicBufferConsumer::setConsumerIsProtected>},
+            {Tag::SET_TRANSFORM_HINT, &dispatchLocal<&IGraphicBufferConsumer::setTransformHint>},
+            {Tag::GET_SIDEBAND_STREAM,
+             &dispatchLocal<&IGraphicBufferConsumer::getSidebandStream>},
+            {Tag::GET_OCCUPANCY_HISTORY,
+             &dispatchLocal<&IGraphicBufferConsumer::getOccupancyHistory>},
+            {Tag::DISCARD_FREE_BUFFERS,
+             &dispatchLocal<&IGraphicBufferConsumer::discardFreeBuffers>},
+            {Tag::DUMP_STATE, &dispatchLocal<DumpState, &IGraphicBufferConsumer::dumpState>},
+            {Tag::SET_ADAPTIVE_BUFFER_COUNT,
+             &dispatchLocal<&IGraphicBufferConsumer::setAdaptiveBufferCount>},
+    });
+    static_assert(kDispatchTable.size() ==
+                  static_cast<uint32_t>(Tag::LAST) - IBinder::FIRST_CALL_TRANSACTION + 1);
+    return dispatch(kDispatchTable, code, data, reply, flags);
 }
 
 } // namespace android
@@ -17,6 +17,8 @@
 #include <stdint.h>
 #include <sys/types.h>
 
+#include <algorithm>
+
 #include <utils/Errors.h>
 #include <utils/NativeHandle.h>
 #include <utils/RefBase.h>
@@ -74,6 +76,11 @@ enum {
     GET_CONSUMER_USAGE,
     SET_LEGACY_BUFFER_DROP,
     SET_AUTO_PREROTATION,
+    DEQUEUE_BUFFERS,
+    REQUEST_BUFFERS,
+    QUEUE_BUFFERS,
+    CANCEL_BUFFERS,
+    GET_FRAME_TIMESTAMPS_MEMORY,
 };
 
 class BpGraphicBufferProducer : public BpInterface<IGraphicBufferProducer>
@@ -291,6 +298,152 @@ public:
         return result;
     }
 
+    status_t dequeueBuffers(const std::vector<DequeueBufferInput>& inputs,
+                            std::vector<DequeueBufferOutput>* outputs) override {
+        Parcel data, reply;
+        data.writeInterfaceToken(IGraphicBufferProducer::getInterfaceDescriptor());
+        data.writeUint32(static_cast<uint32_t>(inputs.size()));
+        for (const auto& input : inputs) {
+            data.writeUint32(input.width);
+            data.writeUint32(input.height);
+            data.writeInt32(static_cast<int32_t>(input.format));
+            data.writeUint64(input.usage);
+            data.writeBool(input.getTimestamps);
+        }
+
+        status_t result = remote()->transact(DEQUEUE_BUFFERS, data, &reply);
+        if (result != NO_ERROR) {
+            return result;
+        }
+
+        const uint32_t count = reply.readUint32();
+        if (count > inputs.size()) {
+            ALOGE("IGBP::dequeueBuffers returned %u results for %zu buffers", count,
+                  inputs.size());
+            return FAILED_TRANSACTION;
+        }
+        outputs->clear();
+        outputs->reserve(count);
+        for (uint32_t i = 0; i < count; i++) {
+            DequeueBufferOutput& output = outputs->emplace_back();
+            output.result = reply.readInt32();
+            output.slot = reply.readInt32();
+            output.fence = new Fence();
+            result = reply.read(*output.fence);
+            if (result != NO_ERROR) {
+                return result;
+            }
+            result = reply.readUint64(&output.bufferAge);
+            if (result != NO_ERROR) {
+                ALOGE("IGBP::dequeueBuffers failed to read buffer age: %d", result);
+                return result;
+            }
+            if (inputs[i].getTimestamps) {
+                result = reply.read(output.timestamps.emplace());
+                if (result != NO_ERROR) {
+                    ALOGE("IGBP::dequeueBuffers failed to read timestamps: %d", result);
+                    return result;
+                }
+            }
+        }
+        return reply.readInt32();
+    }
+
+    status_t requestBuffers(const std::vector<int32_t>& slots,
+                            std::vector<RequestBufferOutput>* outputs) override {
+        Parcel data, reply;
+        data.writeInterfaceToken(IGraphicBufferProducer::getInterfaceDescriptor());
+        data.writeInt32Vector(slots);
+
+        status_t result = remote()->transact(REQUEST_BUFFERS, data, &reply);
+        if (result != NO_ERROR) {
+            return result;
+        }
+
+        const uint32_t count = reply.readUint32();
+        if (count != slots.size()) {
+            ALOGE("IGBP::requestBuffers returned %u results for %zu slots", count, slots.size());
+            return FAILED_TRANSACTION;
+        }
+        outputs->clear();
+        outputs->reserve(count);
+        for (uint32_t i = 0; i < count; i++) {
+            RequestBufferOutput& output = outputs->emplace_back();
+            output.result = reply.readInt32();
+            if (reply.readBool()) {
+                output.buffer = new GraphicBuffer();
+                result = reply.read(*output.buffer);
+                if (result != NO_ERROR) {
+                    return result;
+                }
+            }
+        }
+        return reply.readInt32();
+    }
+
+    status_t queueBuffers(const std::vector<QueueBufferSlotInput>& inputs,
+                          std::vector<QueueBufferResult>* outputs) override {
+        Parcel data, reply;
+        data.writeInterfaceToken(IGraphicBufferProducer::getInterfaceDescriptor());
+        data.writeUint32(static_cast<uint32_t>(inputs.size()));
+        for (const auto& [slot, input] : inputs) {
+            data.writeInt32(slot);
+            data.write(input);
+        }
+
+        status_t result = remote()->transact(QUEUE_BUFFERS, data, &reply);
+        if (result != NO_ERROR) {
+            return result;
+        }
+
+        const uint32_t count = reply.readUint32();
+        if (count != inputs.size()) {
+            ALOGE("IGBP::queueBuffers returned %u results for %zu buffers", count,
+                  inputs.size());
+            return FAILED_TRANSACTION;
+        }
+        outputs->clear();
+        outputs->reserve(count);
+        for (uint32_t i = 0; i < count; i++) {
+            QueueBufferResult& output = outputs->emplace_back();
+            output.result = reply.readInt32();
+            result = reply.read(output.output);
+            if (result != NO_ERROR) {
+                return result;
+            }
+        }
+        return reply.readInt32();
+    }
+
+    status_t cancelBuffers(const std::vector<CancelBufferInput>& inputs,
+                           std::vector<status_t>* results) override {
+        Parcel data, reply;
+        data.writeInterfaceToken(IGraphicBufferProducer::getInterfaceDescriptor());
+        data.writeUint32(static_cast<uint32_t>(inputs.size()));
+        for (const auto& input : inputs) {
+            data.writeInt32(input.slot);
+            data.write(*input.fence);
+        }
+
+        status_t result = remote()->transact(CANCEL_BUFFERS, data, &reply);
+        if (result != NO_ERROR) {
+            return result;
+        }
+
+        std::vector<int32_t> cancelResults;
+        result = reply.readInt32Vector(&cancelResults);
+        if (result != NO_ERROR) {
+            return result;
+        }
+        if (cancelResults.size() != inputs.size()) {
+            ALOGE("IGBP::cancelBuffers returned %zu results for %zu buffers",
+                  cancelResults.size(), inputs.size());
+            return FAILED_TRANSACTION;
+        }
+        results->assign(cancelResults.begin(), cancelResults.end());
+        return reply.readInt32();
+    }
+
     virtual int query(int what, int* value) {
         Parcel data, reply;
         data.writeInterfaceToken(IGraphicBufferProducer::getInterfaceDescriptor());
@@ -511,6 +664,20 @@ public:
         }
     }
 
+    status_t getFrameTimestampsMemory(base::unique_fd* outFd) override {
+        Parcel data, reply;
+        data.writeInterfaceToken(IGraphicBufferProducer::getInterfaceDescriptor());
+        status_t result = remote()->transact(GET_FRAME_TIMESTAMPS_MEMORY, data, &reply);
+        if (result != NO_ERROR) {
+            return result;
+        }
+        result = reply.readInt32();
+        if (result != NO_ERROR) {
+            return result;
+        }
+        return reply.readUniqueFileDescriptor(outFd);
+    }
+
     virtual status_t getUniqueId(uint64_t* outId) const {
         Parcel data, reply;
         data.writeInterfaceToken(IGraphicBufferProducer::getInterfaceDescriptor());
@@ -615,6 +782,26 @@ public:
         return mBase->cancelBuffer(slot, fence);
     }
 
+    status_t dequeueBuffers(const std::vector<DequeueBufferInput>& inputs,
+                            std::vector<DequeueBufferOutput>* outputs) override {
+        return mBase->dequeueBuffers(inputs, outputs);
+    }
+
+    status_t requestBuffers(const std::vector<int32_t>& slots,
+                            std::vector<RequestBufferOutput>* outputs) override {
+        return mBase->requestBuffers(slots, outputs);
+    }
+
+    status_t queueBuffers(const std::vector<QueueBufferSlotInput>& inputs,
+                          std::vector<QueueBufferResult>* outputs) override {
+        return mBase->queueBuffers(inputs, outputs);
+    }
+
+    status_t cancelBuffers(const std::vector<CancelBufferInput>& inputs,
+                           std::vector<status_t>* results) override {
+        return mBase->cancelBuffers(inputs, results);
+    }
+
     int query(int what, int* value) override {
         return mBase->query(what, value);
     }
@@ -680,6 +867,10 @@ public:
         return mBase->getFrameTimestamps(outDelta);
     }
 
+    status_t getFrameTimestampsMemory(base::unique_fd* outFd) override {
+        return mBase->getFrameTimestampsMemory(outFd);
+    }
+
     status_t getUniqueId(uint64_t* outId) const override {
         return mBase->getUniqueId(outId);
     }
@@ -710,6 +901,60 @@ status_t IGraphicBufferProducer::setAutoPrerotation(bool autoPrerotation) {
     return INVALID_OPERATION;
 }
 
+status_t IGraphicBufferProducer::getFrameTimestampsMemory(base::unique_fd* /*outFd*/) {
+    // No-op for IGBP other than BufferQueue.
+    return INVALID_OPERATION;
+}
+
+status_t IGraphicBufferProducer::dequeueBuffers(const std::vector<DequeueBufferInput>& inputs,
+                                                std::vector<DequeueBufferOutput>* outputs) {
+    outputs->clear();
+    outputs->reserve(inputs.size());
+    for (const auto& input : inputs) {
+        DequeueBufferOutput& output = outputs->emplace_back();
+        FrameEventHistoryDelta* timestamps =
+                input.getTimestamps ? &output.timestamps.emplace() : nullptr;
+        output.result = dequeueBuffer(&output.slot, &output.fence, input.width, input.height,
+                                      input.format, input.usage, &output.bufferAge, timestamps);
+        if (output.result < 0) {
+            break;
+        }
+    }
+    return NO_ERROR;
+}
+
+status_t IGraphicBufferProducer::requestBuffers(const std::vector<int32_t>& slots,
+                                                std::vector<RequestBufferOutput>* outputs) {
+    outputs->clear();
+    outputs->reserve(slots.size());
+    for (int32_t slot : slots) {
+        RequestBufferOutput& output = outputs->emplace_back();
+        output.result = requestBuffer(slot, &output.buffer);
+    }
+    return NO_ERROR;
+}
+
+status_t IGraphicBufferProducer::queueBuffers(const std::vector<QueueBufferSlotInput>& inputs,
+                                              std::vector<QueueBufferResult>* outputs) {
+    outputs->clear();
+    outputs->reserve(inputs.size());
+    for (const auto& [slot, input] : inputs) {
+        QueueBufferResult& output = outputs->emplace_back();
+        output.result = queueBuffer(slot, input, &output.output);
+    }
+    return NO_ERROR;
+}
+
+status_t IGraphicBufferProducer::cancelBuffers(const std::vector<CancelBufferInput>& inputs,
+                                               std::vector<status_t>* results) {
+    results->clear();
+    results->reserve(inputs.size());
+    for (const auto& input : inputs) {
+        results->push_back(cancelBuffer(input.slot, input.fence));
+    }
+    return NO_ERROR;
+}
+
 status_t IGraphicBufferProducer::exportToParcel(Parcel* parcel) {
     status_t res = OK;
     res = parcel->writeUint32(USE_BUFFER_QUEUE);
@@ -1079,6 +1324,126 @@ status_t BnGraphicBufferProducer::onTransact(
             reply->writeInt32(result);
             return NO_ERROR;
         }
+        case DEQUEUE_BUFFERS: {
+            CHECK_INTERFACE(IGraphicBufferProducer, data, reply);
+            const uint32_t count = data.readUint32();
+            if (count > BufferQueueDefs::NUM_BUFFER_SLOTS) {
+                return BAD_VALUE;
+            }
+            std::vector<DequeueBufferInput> inputs(count);
+            for (auto& input : inputs) {
+                input.width = data.readUint32();
+                input.height = data.readUint32();
+                input.format = static_cast<PixelFormat>(data.readInt32());
+                input.usage = data.readUint64();
+                input.getTimestamps = data.readBool();
+            }
+
+            std::vector<DequeueBufferOutput> outputs;
+            status_t result = dequeueBuffers(inputs, &outputs);
+            outputs.resize(std::min(outputs.size(), inputs.size()));
+            reply->writeUint32(static_cast<uint32_t>(outputs.size()));
+            for (size_t i = 0; i < outputs.size(); i++) {
+                DequeueBufferOutput& output = outputs[i];
+                if (output.fence == nullptr) {
+                    ALOGE("dequeueBuffers returned a NULL fence, setting to Fence::NO_FENCE");
+                    output.fence = Fence::NO_FENCE;
+                }
+                reply->writeInt32(output.result);
+                reply->writeInt32(output.slot);
+                reply->write(*output.fence);
+                reply->writeUint64(output.bufferAge);
+                if (inputs[i].getTimestamps) {
+                    if (!output.timestamps) {
+                        output.timestamps.emplace();
+                    }
+                    reply->write(*output.timestamps);
+                }
+            }
+            reply->writeInt32(result);
+            return NO_ERROR;
+        }
+        case REQUEST_BUFFERS: {
+            CHECK_INTERFACE(IGraphicBufferProducer, data, reply);
+            std::vector<int32_t> slots;
+            status_t result = data.readInt32Vector(&slots);
+            if (result != NO_ERROR) {
+                return result;
+            }
+            if (slots.size() > BufferQueueDefs::NUM_BUFFER_SLOTS) {
+                return BAD_VALUE;
+            }
+
+            std::vector<RequestBufferOutput> outputs;
+            result = requestBuffers(slots, &outputs);
+            reply->writeUint32(static_cast<uint32_t>(outputs.size()));
+            for (const auto& output : outputs) {
+                reply->writeInt32(output.result);
+                reply->writeBool(output.buffer != nullptr);
+                if (output.buffer != nullptr) {
+                    reply->write(*output.buffer);
+                }
+            }
+            reply->writeInt32(result);
+            return NO_ERROR;
+        }
+        case QUEUE_BUFFERS: {
+            CHECK_INTERFACE(IGraphicBufferProducer, data, reply);
+            const uint32_t count = data.readUint32();
+            if (count > BufferQueueDefs::NUM_BUFFER_SLOTS) {
+                return BAD_VALUE;
+            }
+            std::vector<QueueBufferSlotInput> inputs(count);
+            for (auto& [slot, input] : inputs) {
+                slot = data.readInt32();
+                status_t result = data.read(input);
+                if (result != NO_ERROR) {
+                    return result;
+                }
+            }
+
+            std::vector<QueueBufferResult> outputs;
+            status_t result = queueBuffers(inputs, &outputs);
+            reply->writeUint32(static_cast<uint32_t>(outputs.size()));
+            for (const auto& output : outputs) {
+                reply->writeInt32(output.result);
+                reply->write(output.output);
+            }
+            reply->writeInt32(result);
+            return NO_ERROR;
+        }
+        case CANCEL_BUFFERS: {
+            CHECK_INTERFACE(IGraphicBufferProducer, data, reply);
+            const uint32_t count = data.readUint32();
+            if (count > BufferQueueDefs::NUM_BUFFER_SLOTS) {
+                return BAD_VALUE;
+            }
+            std::vector<CancelBufferInput> inputs(count);
+            for (auto& input : inputs) {
+                input.slot = data.readInt32();
+                input.fence = new Fence();
+                status_t result = data.read(*input.fence);
+                if (result != NO_ERROR) {
+                    return result;
+                }
+            }
+
+            std::vector<status_t> results;
+            status_t result = cancelBuffers(inputs, &results);
+            reply->writeInt32Vector(std::vector<int32_t>(results.begin(), results.end()));
+            reply->writeInt32(result);
+            return NO_ERROR;
+        }
+        case GET_FRAME_TIMESTAMPS_MEMORY: {
+            CHECK_INTERFACE(IGraphicBufferProducer, data, reply);
+            base::unique_fd fd;
+            status_t result = getFrameTimestampsMemory(&fd);
+            reply->writeInt32(result);
+            if (result == NO_ERROR) {
+                return reply->writeUniqueFileDescriptor(fd);
+            }
+            return NO_ERROR;
+        }
     }
     return BBinder::onTransact(code, data, reply, flags);
 }
@@ -38,6 +38,7 @@
 #include <ui/DisplayInfo.h>
 #include <ui/DisplayStatInfo.h>
 #include <ui/DisplayState.h>
+#include <ui/Fence.h>
 #include <ui/HdrCapabilities.h>
 
 #include <utils/Log.h>
@@ -202,6 +203,48 @@ public:
         return result;
     }
 
+    virtual status_t captureLayersAsync(
+            const sp<IBinder>& layerHandleBinder, const sp<GraphicBuffer>& buffer,
+            const ui::Dataspace reqDataspace, const ui::PixelFormat reqPixelFormat,
+            const Rect& sourceCrop,
+            const std::unordered_set<sp<IBinder>, SpHash<IBinder>>& excludeLayers, float frameScale,
+            bool childrenOnly, sp<GraphicBuffer>* outBuffer, sp<Fence>* outFence) {
+        Parcel data, reply;
+        data.writeInterfaceToken(ISurfaceComposer::getInterfaceDescriptor());
+        data.writeStrongBinder(layerHandleBinder);
+        data.writeBool(buffer != nullptr);
+        if (buffer) {
+            data.write(*buffer);
+        }
+        data.writeInt32(static_cast<int32_t>(reqDataspace));
+        data.writeInt32(static_cast<int32_t>(reqPixelFormat));
+        data.write(sourceCrop);
+        data.writeInt32(excludeLayers.size());
+        for (auto el : excludeLayers) {
+            data.writeStrongBinder(el);
+        }
+        data.writeFloat(frameScale);
+        data.writeBool(childrenOnly);
+        status_t result =
+                remote()->transact(BnSurfaceComposer::CAPTURE_LAYERS_ASYNC, data, &reply);
+        if (result != NO_ERROR) {
+            ALOGE("captureLayersAsync failed to transact: %d", result);
+            return result;
+        }
+        result = reply.readInt32();
+        if (result != NO_ERROR) {
+            ALOGE("captureLayersAsync failed to readInt32: %d", result);
+            return result;
+        }
+
+        *outBuffer = new GraphicBuffer();
+        reply.read(**outBuffer);
+        *outFence = new Fence();
+        reply.read(**outFence);
+
+        return result;
+    }
+
     virtual bool authenticateSurfaceTexture(
             const sp<IGraphicBufferProducer>& bufferProducer) const
     {
@@ -1366,6 +1409,47 @@ status_t BnSurfaceComposer::onTransact(
             }
             return NO_ERROR;
         }
+        case CAPTURE_LAYERS_ASYNC: {
+            CHECK_INTERFACE(ISurfaceComposer, data, reply);
+            sp<IBinder> layerHandleBinder = data.readStrongBinder();
+            sp<GraphicBuffer> buffer;
+            if (data.readBool()) {
+                buffer = new GraphicBuffer();
+                status_t err = data.read(*buffer);
+                if (err != NO_ERROR) {
+                    return err;
+                }
+            }
+            ui::Dataspace reqDataspace = static_cast<ui::Dataspace>(data.readInt32());
+            ui::PixelFormat reqPixelFormat = static_cast<ui::PixelFormat>(data.readInt32());
+            Rect sourceCrop(Rect::EMPTY_RECT);
+            data.read(sourceCrop);
+
+            std::unordered_set<sp<IBinder>, SpHash<IBinder>> excludeHandles;
+            int numExcludeHandles = data.readInt32();
+            if (numExcludeHandles >= static_cast<int>(MAX_LAYERS)) {
+                return BAD_VALUE;
+            }
+            excludeHandles.reserve(numExcludeHandles);
+            for (int i = 0; i < numExcludeHandles; i++) {
+                excludeHandles.emplace(data.readStrongBinder());
+            }
+
+            float frameScale = data.readFloat();
+            bool childrenOnly = data.readBool();
+
+            sp<GraphicBuffer> outBuffer;
+            sp<Fence> outFence;
+            status_t res = captureLayersAsync(layerHandleBinder, buffer, reqDataspace,
+                                              reqPixelFormat, sourceCrop, excludeHandles,
+                                              frameScale, childrenOnly, &outBuffer, &outFence);
+            reply->writeInt32(res);
+            if (res == NO_ERROR) {
+                reply->write(*outBuffer);
+                reply->write(*outFence);
+            }
+            return NO_ERROR;
+        }
         case AUTHENTICATE_SURFACE: {
             CHECK_INTERFACE(ISurfaceComposer, data, reply);
             sp<IGraphicBufferProducer> bufferProducer =
@@ -19,6 +19,10 @@
 
 #include <gui/ITransactionCompletedListener.h>
 
+#include <algorithm>
+#include <limits>
+#include <vector>
+
 namespace android {
 
 namespace { // Anonymous
@@ -28,6 +32,124 @@ enum class Tag : uint32_t {
     LAST = ON_TRANSACTION_COMPLETED,
 };
 
+// ListenerStats carries the stats of every surface of every transaction completed by a present,
+// and most of their timestamps are within a few frames of each other. They are written as 32-bit
+// offsets from a base time, with these markers for invalid times and for times that need to be
+// written in full.
+constexpr int32_t kInvalidTime = std::numeric_limits<int32_t>::min();
+constexpr int32_t kAbsoluteTime = kInvalidTime + 1;
+
+status_t writeTime(Parcel* output, nsecs_t baseTime, nsecs_t time) {
+    if (time < 0) {
+        return output->writeInt32(kInvalidTime);
+    }
+    const nsecs_t delta = time - baseTime;
+    if (delta > kAbsoluteTime && delta <= std::numeric_limits<int32_t>::max()) {
+        return output->writeInt32(static_cast<int32_t>(delta));
+    }
+    status_t err = output->writeInt32(kAbsoluteTime);
+    if (err != NO_ERROR) {
+        return err;
+    }
+    return output->writeInt64(time);
+}
+
+status_t readTime(const Parcel* input, nsecs_t baseTime, nsecs_t* outTime) {
+    int32_t delta = 0;
+    status_t err = input->readInt32(&delta);
+    if (err != NO_ERROR) {
+        return err;
+    }
+    if (delta == kInvalidTime) {
+        *outTime = -1;
+        return NO_ERROR;
+    }
+    if (delta == kAbsoluteTime) {
+        return input->readInt64(outTime);
+    }
+    *outTime = baseTime + delta;
+    return NO_ERROR;
+}
+
+// The present fence is shared by all transactions of a ListenerStats, and the GPU composition
+// fence by all of its surfaces. Each distinct fence is written once and referred to by index,
+// which saves duplicating and sending its file descriptor again.
+class FenceTable {
+public:
+    int32_t add(const sp<Fence>& fence) {
+        if (fence == nullptr) {
+            return -1;
+        }
+        for (size_t i = 0; i < mFences.size(); i++) {
+            if (mFences[i] == fence) {
+                return static_cast<int32_t>(i);
+            }
+        }
+        mFences.push_back(fence);
+        return static_cast<int32_t>(mFences.size() - 1);
+    }
+
+    int32_t indexOf(const sp<Fence>& fence) const {
+        for (size_t i = 0; i < mFences.size(); i++) {
+            if (mFences[i] == fence) {
+                return static_cast<int32_t>(i);
+            }
+        }
+        return -1;
+    }
+
+    status_t writeToParcel(Parcel* output) const {
+        status_t err = output->writeInt32(static_cast<int32_t>(mFences.size()));
+        if (err != NO_ERROR) {
+            return err;
+        }
+        for (const auto& fence : mFences) {
+            err = output->write(*fence);
+            if (err != NO_ERROR) {
+                return err;
+            }
+        }
+        return NO_ERROR;
+    }
+
+    status_t readFromParcel(const Parcel* input) {
+        int32_t count = 0;
+        status_t err = input->readInt32(&count);
+        if (err != NO_ERROR) {
+            return err;
+        }
+        if (count < 0 || static_cast<size_t>(count) > input->dataAvail()) {
+            return BAD_VALUE;
+        }
+        mFences.clear();
+        for (int32_t i = 0; i < count; i++) {
+            sp<Fence> fence = new Fence();
+            err = input->read(*fence);
+            if (err != NO_ERROR) {
+                return err;
+            }
+            mFences.push_back(fence);
+        }
+        return NO_ERROR;
+    }
+
+    status_t readIndex(const Parcel* input, sp<Fence>* outFence) const {
+        int32_t index = -1;
+        status_t err = input->readInt32(&index);
+        if (err != NO_ERROR) {
+            return err;
+        }
+        if (index < -1 || index >= static_cast<int32_t>(mFences.size())) {
+            return BAD_VALUE;
+        }
+        *outFence = index < 0 ? nullptr : mFences[index];
+        return NO_ERROR;
+    }
+
+private:
+    std::vector<sp<Fence>> mFences;
+};
+
 } // Anonymous namespace
 
 status_t FrameEventHistoryStats::writeToParcel(Parcel* output) const {
@@ -196,29 +318,149 @@ status_t TransactionStats::readFromParcel(const Parcel* input) {
 }
 
 status_t ListenerStats::writeToParcel(Parcel* output) const {
-    status_t err = output->writeInt32(static_cast<int32_t>(transactionStats.size()));
+    FenceTable fences;
+    nsecs_t baseTime = std::numeric_limits<nsecs_t>::max();
+    auto updateBaseTime = [&baseTime](nsecs_t time) {
+        if (time >= 0) {
+            baseTime = std::min(baseTime, time);
+        }
+    };
+    for (const auto& stats : transactionStats) {
+        fences.add(stats.presentFence);
+        updateBaseTime(stats.latchTime);
+        for (const auto& surfaceStats : stats.surfaceStats) {
+            fences.add(surfaceStats.previousReleaseFence);
+            fences.add(surfaceStats.eventStats.gpuCompositionDoneFence);
+            updateBaseTime(surfaceStats.acquireTime);
+            updateBaseTime(surfaceStats.eventStats.refreshStartTime);
+        }
+    }
+    if (baseTime == std::numeric_limits<nsecs_t>::max()) {
+        baseTime = 0;
+    }
+
+    status_t err = fences.writeToParcel(output);
+    if (err != NO_ERROR) {
+        return err;
+    }
+    err = output->writeInt64(baseTime);
+    if (err != NO_ERROR) {
+        return err;
+    }
+    err = output->writeInt32(static_cast<int32_t>(transactionStats.size()));
     if (err != NO_ERROR) {
         return err;
     }
     for (const auto& stats : transactionStats) {
-        err = output->writeParcelable(stats);
+        err = output->writeInt64Vector(stats.callbackIds);
+        if (err != NO_ERROR) {
+            return err;
+        }
+        err = writeTime(output, baseTime, stats.latchTime);
         if (err != NO_ERROR) {
             return err;
         }
+        err = output->writeInt32(fences.indexOf(stats.presentFence));
+        if (err != NO_ERROR) {
+            return err;
+        }
+        err = output->writeInt32(static_cast<int32_t>(stats.surfaceStats.size()));
+        if (err != NO_ERROR) {
+            return err;
+        }
+        for (const auto& surfaceStats : stats.surfaceStats) {
+            const FrameEventHistoryStats& eventStats = surfaceStats.eventStats;
+            err = output->writeStrongBinder(surfaceStats.surfaceControl);
+            if (err != NO_ERROR) return err;
+            err = writeTime(output, baseTime, surfaceStats.acquireTime);
+            if (err != NO_ERROR) return err;
+            err = output->writeInt32(fences.indexOf(surfaceStats.previousReleaseFence));
+            if (err != NO_ERROR) return err;
+            err = output->writeUint32(surfaceStats.transformHint);
+            if (err != NO_ERROR) return err;
+            err = output->writeUint64(eventStats.frameNumber);
+            if (err != NO_ERROR) return err;
+            err = output->writeInt32(fences.indexOf(eventStats.gpuCompositionDoneFence));
+            if (err != NO_ERROR) return err;
+            err = writeTime(output, baseTime, eventStats.compositorTiming.deadline);
+            if (err != NO_ERROR) return err;
+            err = output->writeInt64(eventStats.compositorTiming.interval);
+            if (err != NO_ERROR) return err;
+            err = output->writeInt64(eventStats.compositorTiming.presentLatency);
+            if (err != NO_ERROR) return err;
+            err = writeTime(output, baseTime, eventStats.refreshStartTime);
+            if (err != NO_ERROR) return err;
+            err = writeTime(output, baseTime, eventStats.dequeueReadyTime);
+            if (err != NO_ERROR) return err;
+        }
     }
     return NO_ERROR;
 }
 
 status_t ListenerStats::readFromParcel(const Parcel* input) {
-    int32_t transactionStats_size = input->readInt32();
+    FenceTable fences;
+    status_t err = fences.readFromParcel(input);
+    if (err != NO_ERROR) {
+        return err;
+    }
+    nsecs_t baseTime = 0;
+    err = input->readInt64(&baseTime);
+    if (err != NO_ERROR) {
+        return err;
+    }
+    int32_t transactionStats_size = 0;
+    err = input->readInt32(&transactionStats_size);
+    if (err != NO_ERROR) {
+        return err;
+    }
 
     for (int i = 0; i < transactionStats_size; i++) {
         TransactionStats stats;
-        status_t err = input->readParcelable(&stats);
+        err = input->readInt64Vector(&stats.callbackIds);
         if (err != NO_ERROR) {
             return err;
         }
-        transactionStats.push_back(stats);
+        err = readTime(input, baseTime, &stats.latchTime);
+        if (err != NO_ERROR) {
+            return err;
+        }
+        err = fences.readIndex(input, &stats.presentFence);
+        if (err != NO_ERROR) {
+            return err;
+        }
+        int32_t surfaceStats_size = 0;
+        err = input->readInt32(&surfaceStats_size);
+        if (err != NO_ERROR) {
+            return err;
+        }
+        for (int j = 0; j < surfaceStats_size; j++) {
+            SurfaceStats surfaceStats;
+            FrameEventHistoryStats& eventStats = surfaceStats.eventStats;
+            err = input->readStrongBinder(&surfaceStats.surfaceControl);
+            if (err != NO_ERROR) return err;
+            err = readTime(input, baseTime, &surfaceStats.acquireTime);
+            if (err != NO_ERROR) return err;
+            err = fences.readIndex(input, &surfaceStats.previousReleaseFence);
+            if (err != NO_ERROR) return err;
+            err = input->readUint32(&surfaceStats.transformHint);
+            if (err != NO_ERROR) return err;
+            err = input->readUint64(&eventStats.frameNumber);
+            if (err != NO_ERROR) return err;
+            err = fences.readIndex(input, &eventStats.gpuCompositionDoneFence);
+            if (err != NO_ERROR) return err;
+            err = readTime(input, baseTime, &eventStats.compositorTiming.deadline);
+            if (err != NO_ERROR) return err;
+            err = input->readInt64(&eventStats.compositorTiming.interval);
+            if (err != NO_ERROR) return err;
+            err = input->readInt64(&eventStats.compositorTiming.presentLatency);
+            if (err != NO_ERROR) return err;
+            err = readTime(input, baseTime, &eventStats.refreshStartTime);
+            if (err != NO_ERROR) return err;
+            err = readTime(input, baseTime, &eventStats.dequeueReadyTime);
+            if (err != NO_ERROR) return err;
+            stats.surfaceStats.push_back(std::move(surfaceStats));
+        }
+        transactionStats.push_back(std::move(stats));
     }
     return NO_ERROR;
 }
@@ -33,6 +33,8 @@
 
 #include <system/window.h>
 
+#include <algorithm>
+
 namespace android {
 
 status_t StreamSplitter::createSplitter(
@@ -58,13 +60,13 @@ status_t StreamSplitter::createSplitter(
 
 StreamSplitter::StreamSplitter(const sp<IGraphicBufferConsumer>& inputQueue)
       : mIsAbandoned(false), mMutex(), mReleaseCondition(),
-        mOutstandingBuffers(0), mInput(inputQueue), mOutputs(), mBuffers() {}
+        mInput(inputQueue), mOutputs(), mBuffers() {}
 
 StreamSplitter::~StreamSplitter() {
     mInput->consumerDisconnect();
-    Vector<sp<IGraphicBufferProducer> >::iterator output = mOutputs.begin();
+    Vector<Output>::iterator output = mOutputs.begin();
     for (; output != mOutputs.end(); ++output) {
-        (*output)->disconnect(NATIVE_WINDOW_API_CPU);
+        output->queue->disconnect(NATIVE_WINDOW_API_CPU);
     }
 
     if (mBuffers.size() > 0) {
@@ -74,10 +76,22 @@ StreamSplitter::~StreamSplitter() {
 
 status_t StreamSplitter::addOutput(
         const sp<IGraphicBufferProducer>& outputQueue) {
+    return addOutput(outputQueue, {MAX_OUTSTANDING_BUFFERS, DropPolicy::Block});
+}
+
+status_t StreamSplitter::addOutput(
+        const sp<IGraphicBufferProducer>& outputQueue,
+        const OutputConfig& config) {
     if (outputQueue == nullptr) {
         ALOGE("addOutput: outputQueue must not be NULL");
         return BAD_VALUE;
     }
+    if (config.dropPolicy != DropPolicy::DropOldest &&
+            config.maxOutstandingBuffers < 1) {
+        ALOGE("addOutput: maxOutstandingBuffers must be positive (%d)",
+                config.maxOutstandingBuffers);
+        return BAD_VALUE;
+    }
 
     Mutex::Autolock lock(mMutex);
 
@@ -91,11 +105,45 @@ status_t StreamSplitter::addOutput(
         return status;
     }
 
-    mOutputs.push_back(outputQueue);
+    if (config.dropPolicy == DropPolicy::DropOldest) {
+        status = outputQueue->setAsyncMode(true);
+        if (status != NO_ERROR) {
+            ALOGE("addOutput: failed to set async mode (%d)", status);
+            outputQueue->disconnect(NATIVE_WINDOW_API_CPU);
+            return status;
+        }
+    }
+
+    Output output;
+    output.queue = outputQueue;
+    output.config = config;
+    mOutputs.push_back(output);
 
     return NO_ERROR;
 }
 
+status_t StreamSplitter::getOutputStats(
+        const sp<IGraphicBufferProducer>& output,
+        OutputStats* outStats) const {
+    if (outStats == nullptr) {
+        ALOGE("getOutputStats: outStats must not be NULL");
+        return BAD_VALUE;
+    }
+
+    Mutex::Autolock lock(mMutex);
+    ssize_t index = indexOfOutputLocked(output);
+    if (index < 0) {
+        ALOGE("getOutputStats: unknown output %p", output.get());
+        return BAD_VALUE;
+    }
+
+    const Output& state = mOutputs[static_cast<size_t>(index)];
+    *outStats = state.stats;
+    outStats->averageLatency = state.releasedFrames > 0 ?
+            state.totalLatency / static_cast<nsecs_t>(state.releasedFrames) : 0;
+    return NO_ERROR;
+}
+
 void StreamSplitter::setName(const String8 &name) {
     Mutex::Autolock lock(mMutex);
     mInput->setConsumerName(name);
@@ -105,14 +153,15 @@ void StreamSplitter::onFrameAvailable(const BufferItem& /* item */) {
     ATRACE_CALL();
     Mutex::Autolock lock(mMutex);
 
-    // The current policy is that if any one consumer is consuming buffers too
-    // slowly, the splitter will stall the rest of the outputs by not acquiring
-    // any more buffers from the input. This will cause back pressure on the
-    // input queue, slowing down its producer.
+    // If an output with DropPolicy::Block is consuming buffers too slowly, the
+    // splitter stalls the rest of the outputs by not acquiring any more
+    // buffers from the input. This will cause back pressure on the input
+    // queue, slowing down its producer. Outputs that drop frames instead never
+    // stall the splitter.
 
-    // If there are too many outstanding buffers, we block until a buffer is
-    // released back to the input in onBufferReleased
-    while (mOutstandingBuffers >= MAX_OUTSTANDING_BUFFERS) {
+    // If an output holds too many buffers, we block until it releases a buffer
+    // in onBufferReleasedByOutput
+    while (isBlockedLocked()) {
         mReleaseCondition.wait(mMutex);
 
         // If the splitter is abandoned while we are waiting, the release
@@ -123,7 +172,6 @@ void StreamSplitter::onFrameAvailable(const BufferItem& /* item */) {
             return;
         }
     }
-    ++mOutstandingBuffers;
 
     // Acquire and detach the buffer from the input
     BufferItem bufferItem;
@@ -139,8 +187,8 @@ void StreamSplitter::onFrameAvailable(const BufferItem& /* item */) {
             "detaching buffer from input failed (%d)", status);
 
     // Initialize our reference count for this buffer
-    mBuffers.add(bufferItem.mGraphicBuffer->getId(),
-            new BufferTracker(bufferItem.mGraphicBuffer));
+    sp<BufferTracker> tracker(new BufferTracker(bufferItem.mGraphicBuffer));
+    mBuffers.add(bufferItem.mGraphicBuffer->getId(), tracker);
 
     IGraphicBufferProducer::QueueBufferInput queueInput(
             bufferItem.mTimestamp, bufferItem.mIsAutoTimestamp,
@@ -149,17 +197,27 @@ void StreamSplitter::onFrameAvailable(const BufferItem& /* item */) {
             bufferItem.mTransform, bufferItem.mFence);
 
     // Attach and queue the buffer to each of the outputs
-    Vector<sp<IGraphicBufferProducer> >::iterator output = mOutputs.begin();
-    for (; output != mOutputs.end(); ++output) {
+    for (size_t i = 0; i < mOutputs.size(); ++i) {
+        Output& output = mOutputs.editItemAt(i);
+        if (output.config.dropPolicy == DropPolicy::DropNewest &&
+                output.outstandingBuffers >= output.config.maxOutstandingBuffers) {
+            // This output is falling behind, so it skips this frame, which
+            // counts as released by it
+            ALOGV("output %p dropped buffer %#" PRIx64, output.queue.get(),
+                    bufferItem.mGraphicBuffer->getId());
+            ++output.stats.droppedFrames;
+            releaseBufferLocked(tracker);
+            continue;
+        }
+
         int slot;
-        status = (*output)->attachBuffer(&slot, bufferItem.mGraphicBuffer);
+        status = output.queue->attachBuffer(&slot, bufferItem.mGraphicBuffer);
         if (status == NO_INIT) {
             // If we just discovered that this output has been abandoned, note
-            // that, increment the release count so that we still release this
-            // buffer eventually, and move on to the next output
+            // that, count the output as having released this buffer so that
+            // we still release it eventually, and move on to the next output
             onAbandonedLocked();
-            mBuffers.editValueFor(bufferItem.mGraphicBuffer->getId())->
-                    incrementReleaseCountLocked();
+            releaseBufferLocked(tracker);
             continue;
         } else {
             LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
@@ -167,22 +225,30 @@ void StreamSplitter::onFrameAvailable(const BufferItem& /* item */) {
         }
 
         IGraphicBufferProducer::QueueBufferOutput queueOutput;
-        status = (*output)->queueBuffer(slot, queueInput, &queueOutput);
+        status = output.queue->queueBuffer(slot, queueInput, &queueOutput);
         if (status == NO_INIT) {
             // If we just discovered that this output has been abandoned, note
-            // that, increment the release count so that we still release this
-            // buffer eventually, and move on to the next output
+            // that, count the output as having released this buffer so that
+            // we still release it eventually, and move on to the next output
             onAbandonedLocked();
-            mBuffers.editValueFor(bufferItem.mGraphicBuffer->getId())->
-                    incrementReleaseCountLocked();
+            releaseBufferLocked(tracker);
             continue;
         } else {
             LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
                     "queueing buffer to output failed (%d)", status);
         }
 
+        ++output.outstandingBuffers;
+        ++output.stats.queuedFrames;
         ALOGV("queued buffer %#" PRIx64 " to output %p",
-                bufferItem.mGraphicBuffer->getId(), output->get());
+                bufferItem.mGraphicBuffer->getId(), output.queue.get());
+
+        if (queueOutput.bufferReplaced) {
+            // In async mode, the frame the consumer had not acquired yet was
+            // replaced, which frees its buffer without a release callback
+            ++output.stats.droppedFrames;
+            detachReleasedBufferLocked(i);
+        }
     }
 }
 
@@ -191,9 +257,39 @@ void StreamSplitter::onBufferReleasedByOutput(
     ATRACE_CALL();
     Mutex::Autolock lock(mMutex);
 
+    ssize_t index = indexOfOutputLocked(from);
+    LOG_ALWAYS_FATAL_IF(index < 0, "buffer released by unknown output %p",
+            from.get());
+    detachReleasedBufferLocked(static_cast<size_t>(index));
+}
+
+ssize_t StreamSplitter::indexOfOutputLocked(
+        const sp<IGraphicBufferProducer>& output) const {
+    for (size_t i = 0; i < mOutputs.size(); ++i) {
+        if (IInterface::asBinder(mOutputs[i].queue) ==
+                IInterface::asBinder(output)) {
+            return static_cast<ssize_t>(i);
+        }
+    }
+    return NAME_NOT_FOUND;
+}
+
+bool StreamSplitter::isBlockedLocked() const {
+    for (const Output& output : mOutputs) {
+        if (output.config.dropPolicy == DropPolicy::Block &&
+                output.outstandingBuffers >= output.config.maxOutstandingBuffers) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void StreamSplitter::detachReleasedBufferLocked(size_t outputIndex) {
+    Output& output = mOutputs.editItemAt(outputIndex);
+
     sp<GraphicBuffer> buffer;
     sp<Fence> fence;
-    status_t status = from->detachNextBuffer(&buffer, &fence);
+    status_t status = output.queue->detachNextBuffer(&buffer, &fence);
     if (status == NO_INIT) {
         // If we just discovered that this output has been abandoned, note that,
         // but we can't do anything else, since buffer is invalid
@@ -205,14 +301,29 @@ void StreamSplitter::onBufferReleasedByOutput(
     }
 
     ALOGV("detached buffer %#" PRIx64 " from output %p",
-          buffer->getId(), from.get());
+          buffer->getId(), output.queue.get());
+
+    const sp<BufferTracker> tracker = mBuffers.valueFor(buffer->getId());
 
-    const sp<BufferTracker>& tracker = mBuffers.editValueFor(buffer->getId());
+    const nsecs_t latency = systemTime() - tracker->getAcquireTime();
+    output.totalLatency += latency;
+    output.stats.maxLatency = std::max(output.stats.maxLatency, latency);
+    ++output.releasedFrames;
+    --output.outstandingBuffers;
 
     // Merge the release fence of the incoming buffer so that the fence we send
     // back to the input includes all of the outputs' fences
     tracker->mergeFence(fence);
 
+    releaseBufferLocked(tracker);
+
+    // Notify any waiting onFrameAvailable calls
+    mReleaseCondition.broadcast();
+}
+
+void StreamSplitter::releaseBufferLocked(const sp<BufferTracker>& tracker) {
+    const sp<GraphicBuffer>& buffer = tracker->getBuffer();
+
     // Check to see if this is the last outstanding reference to this buffer
     size_t releaseCount = tracker->incrementReleaseCountLocked();
     ALOGV("buffer %#" PRIx64 " reference count %zu (of %zu)", buffer->getId(),
@@ -230,7 +341,7 @@ void StreamSplitter::onBufferReleasedByOutput(
 
     // Attach and release the buffer back to the input
     int consumerSlot;
-    status = mInput->attachBuffer(&consumerSlot, tracker->getBuffer());
+    status_t status = mInput->attachBuffer(&consumerSlot, buffer);
     LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
             "attaching buffer to input failed (%d)", status);
 
@@ -244,10 +355,6 @@ void StreamSplitter::onBufferReleasedByOutput(
     // We no longer need to track the buffer once it has been returned to the
     // input
     mBuffers.removeItem(buffer->getId());
-
-    // Notify any waiting onFrameAvailable calls
-    --mOutstandingBuffers;
-    mReleaseCondition.signal();
 }
 
 void StreamSplitter::onAbandonedLocked() {
@@ -276,7 +383,8 @@ void StreamSplitter::OutputListener::binderDied(const wp<IBinder>& /* who */) {
 }
 
 StreamSplitter::BufferTracker::BufferTracker(const sp<GraphicBuffer>& buffer)
-      : mBuffer(buffer), mMergedFence(Fence::NO_FENCE), mReleaseCount(0) {}
+      : mBuffer(buffer), mMergedFence(Fence::NO_FENCE), mReleaseCount(0),
+        mAcquireTime(systemTime()) {}
 
 StreamSplitter::BufferTracker::~BufferTracker() {}
 
@@ -45,6 +45,7 @@
 #include <gui/ISurfaceComposer.h>
 #include <gui/LayerState.h>
 #include <private/gui/ComposerService.h>
+#include <private/gui/FrameTimestampsRing.h>
 
 namespace android {
 
@@ -191,6 +192,12 @@ void Surface::enableFrameTimestamps(bool enable) {
         FrameEventHistoryDelta delta;
         mGraphicBufferProducer->getFrameTimestamps(&delta);
         mFrameEventHistory->applyDelta(delta);
+
+        base::unique_fd fd;
+        if (!mFrameTimestampsRing &&
+            mGraphicBufferProducer->getFrameTimestampsMemory(&fd) == NO_ERROR) {
+            mFrameTimestampsRing = gui::FrameTimestampsRing::map(std::move(fd));
+        }
     }
     mEnableFrameTimestamps = enable;
 }
@@ -203,6 +210,10 @@ status_t Surface::getCompositorTiming(
         return INVALID_OPERATION;
     }
 
+    if (mFrameTimestampsRing) {
+        mFrameEventHistory->applySharedCompositorTiming(*mFrameTimestampsRing);
+    }
+
     if (compositeDeadline != nullptr) {
         *compositeDeadline =
                 mFrameEventHistory->getNextCompositeDeadline(now());
@@ -302,11 +313,18 @@ status_t Surface::getFrameTimestamps(uint64_t frameNumber,
         return NAME_NOT_FOUND;
     }
 
-    // Update our cache of events if the requested events are not available.
-    if (checkConsumerForUpdates(events, mLastFrameNumber,
-            outLatchTime, outFirstRefreshStartTime, outLastRefreshStartTime,
-            outGpuCompositionDoneTime, outDisplayPresentTime,
-            outDequeueReadyTime, outReleaseTime)) {
+    // Update our cache of events if the requested events are not available, from shared memory
+    // if the consumer publishes them there, and otherwise from the consumer.
+    auto needsUpdate = [&]() {
+        return checkConsumerForUpdates(events, mLastFrameNumber, outLatchTime,
+                                       outFirstRefreshStartTime, outLastRefreshStartTime,
+                                       outGpuCompositionDoneTime, outDisplayPresentTime,
+                                       outDequeueReadyTime, outReleaseTime);
+    };
+    if (mFrameTimestampsRing && needsUpdate()) {
+        mFrameEventHistory->applySharedFrame(*mFrameTimestampsRing, frameNumber);
+    }
+    if (needsUpdate()) {
         FrameEventHistoryDelta delta;
         mGraphicBufferProducer->getFrameTimestamps(&delta);
         mFrameEventHistory->applyDelta(delta);
@@ -616,29 +634,31 @@ private:
     std::mutex mMutex;
 };
 
+void Surface::getDequeueBufferInputLocked(
+        IGraphicBufferProducer::DequeueBufferInput* dequeueInput) {
+    LOG_ALWAYS_FATAL_IF(dequeueInput == nullptr, "input is null");
+
+    dequeueInput->width = mReqWidth ? mReqWidth : mUserWidth;
+    dequeueInput->height = mReqHeight ? mReqHeight : mUserHeight;
+
+    dequeueInput->format = mReqFormat;
+    dequeueInput->usage = mReqUsage;
+
+    dequeueInput->getTimestamps = mEnableFrameTimestamps;
+}
+
 int Surface::dequeueBuffer(android_native_buffer_t** buffer, int* fenceFd) {
     ATRACE_CALL();
     ALOGV("Surface::dequeueBuffer");
 
-    uint32_t reqWidth;
-    uint32_t reqHeight;
-    PixelFormat reqFormat;
-    uint64_t reqUsage;
-    bool enableFrameTimestamps;
-
+    IGraphicBufferProducer::DequeueBufferInput dqInput;
     {
         Mutex::Autolock lock(mMutex);
         if (mReportRemovedBuffers) {
             mRemovedBuffers.clear();
         }
 
-        reqWidth = mReqWidth ? mReqWidth : mUserWidth;
-        reqHeight = mReqHeight ? mReqHeight : mUserHeight;
-
-        reqFormat = mReqFormat;
-        reqUsage = mReqUsage;
-
-        enableFrameTimestamps = mEnableFrameTimestamps;
+        getDequeueBufferInputLocked(&dqInput);
 
         if (mSharedBufferMode && mAutoRefresh && mSharedBufferSlot !=
                 BufferItem::INVALID_BUFFER_SLOT) {
@@ -656,19 +676,20 @@ int Surface::dequeueBuffer(android_native_buffer_t** buffer, int* fenceFd) {
     nsecs_t startTime = systemTime();
 
     FrameEventHistoryDelta frameTimestamps;
-    status_t result = mGraphicBufferProducer->dequeueBuffer(&buf, &fence, reqWidth, reqHeight,
-                                                            reqFormat, reqUsage, &mBufferAge,
-                                                            enableFrameTimestamps ? &frameTimestamps
-                                                                                  : nullptr);
+    status_t result = mGraphicBufferProducer->dequeueBuffer(&buf, &fence, dqInput.width,
+                                                            dqInput.height, dqInput.format,
+                                                            dqInput.usage, &mBufferAge,
+                                                            dqInput.getTimestamps
+                                                                    ? &frameTimestamps
+                                                                    : nullptr);
     mLastDequeueDuration = systemTime() - startTime;
 
     if (result < 0) {
         ALOGV("dequeueBuffer: IGraphicBufferProducer::dequeueBuffer"
                 "(%d, %d, %d, %#" PRIx64 ") failed: %d",
-                reqWidth, reqHeight, reqFormat, reqUsage, result);
+                dqInput.width, dqInput.height, dqInput.format, dqInput.usage, result);
         return result;
     }
-
     if (buf < 0 || buf >= NUM_BUFFER_SLOTS) {
         ALOGE("dequeueBuffer: IGraphicBufferProducer returned invalid slot number %d", buf);
         android_errorWriteLog(0x534e4554, "36991414"); // SafetyNet logging
@@ -694,7 +715,7 @@ int Surface::dequeueBuffer(android_native_buffer_t** buffer, int* fenceFd) {
         freeAllBuffers();
     }
 
-    if (enableFrameTimestamps) {
+    if (dqInput.getTimestamps) {
          mFrameEventHistory->applyDelta(frameTimestamps);
     }
 
@@ -737,6 +758,160 @@ int Surface::dequeueBuffer(android_native_buffer_t** buffer, int* fenceFd) {
     return OK;
 }
 
+
+int Surface::dequeueBuffers(std::vector<BatchBuffer>* buffers) {
+    using DequeueBufferInput = IGraphicBufferProducer::DequeueBufferInput;
+    using DequeueBufferOutput = IGraphicBufferProducer::DequeueBufferOutput;
+    using CancelBufferInput = IGraphicBufferProducer::CancelBufferInput;
+    using RequestBufferOutput = IGraphicBufferProducer::RequestBufferOutput;
+
+    ATRACE_CALL();
+    ALOGV("Surface::dequeueBuffers");
+
+    if (buffers->empty()) {
+        ALOGE("%s: must dequeue at least 1 buffer!", __FUNCTION__);
+        return BAD_VALUE;
+    }
+
+    DequeueBufferInput input;
+    {
+        Mutex::Autolock lock(mMutex);
+        if (mSharedBufferMode) {
+            ALOGE("%s: batch operation is not supported in shared buffer mode!", __FUNCTION__);
+            return INVALID_OPERATION;
+        }
+
+        if (mReportRemovedBuffers) {
+            mRemovedBuffers.clear();
+        }
+
+        getDequeueBufferInputLocked(&input);
+    } // Drop the lock so that we can still touch the Surface while blocking in IGBP::dequeueBuffers
+
+    const size_t numBuffers = buffers->size();
+    std::vector<DequeueBufferInput> dequeueInputs(numBuffers, input);
+    std::vector<DequeueBufferOutput> dequeueOutputs;
+    nsecs_t startTime = systemTime();
+
+    status_t result = mGraphicBufferProducer->dequeueBuffers(dequeueInputs, &dequeueOutputs);
+    mLastDequeueDuration = systemTime() - startTime;
+
+    if (result < 0) {
+        ALOGV("%s: IGraphicBufferProducer::dequeueBuffers"
+              "(%d, %d, %d, %#" PRIx64 ") failed: %d",
+              __FUNCTION__, input.width, input.height, input.format, input.usage, result);
+        return result;
+    }
+
+    // Hand back whatever was dequeued if any of the buffers could not be.
+    std::vector<CancelBufferInput> cancelInputs;
+    cancelInputs.reserve(dequeueOutputs.size());
+    for (const auto& output : dequeueOutputs) {
+        if (output.result < 0) {
+            result = output.result;
+        } else if (output.slot < 0 || output.slot >= NUM_BUFFER_SLOTS) {
+            ALOGE("%s: IGraphicBufferProducer returned invalid slot number %d", __FUNCTION__,
+                  output.slot);
+            android_errorWriteLog(0x534e4554, "36991414"); // SafetyNet logging
+            result = FAILED_TRANSACTION;
+        } else {
+            cancelInputs.push_back({output.slot, output.fence});
+        }
+    }
+    if (result == NO_ERROR && dequeueOutputs.size() != numBuffers) {
+        result = FAILED_TRANSACTION;
+    }
+    if (result < 0) {
+        ALOGV("%s: dequeued %zu of %zu buffers: %d", __FUNCTION__, cancelInputs.size(),
+              numBuffers, result);
+        std::vector<status_t> cancelResults;
+        mGraphicBufferProducer->cancelBuffers(cancelInputs, &cancelResults);
+        return result;
+    }
+
+    Mutex::Autolock lock(mMutex);
+
+    // Write this while holding the mutex
+    mLastDequeueStartTime = startTime;
+
+    for (const auto& output : dequeueOutputs) {
+        // this should never happen
+        ALOGE_IF(output.fence == nullptr, "%s: received null Fence! slot=%d", __FUNCTION__,
+                 output.slot);
+
+        if (CC_UNLIKELY(atrace_is_tag_enabled(ATRACE_TAG_GRAPHICS))) {
+            static FenceMonitor hwcReleaseThread("HWC release");
+            hwcReleaseThread.queueFence(output.fence);
+        }
+
+        if (output.result & IGraphicBufferProducer::RELEASE_ALL_BUFFERS) {
+            freeAllBuffers();
+        }
+
+        if (input.getTimestamps) {
+            mFrameEventHistory->applyDelta(*output.timestamps);
+        }
+
+        mBufferAge = output.bufferAge;
+    }
+
+    // Only look for buffers to request once all of them have been dequeued, as
+    // RELEASE_ALL_BUFFERS from a later dequeue frees the earlier ones too.
+    std::vector<int32_t> requestSlots;
+    requestSlots.reserve(numBuffers);
+    for (const auto& output : dequeueOutputs) {
+        sp<GraphicBuffer>& gbuf(mSlots[output.slot].buffer);
+        if ((output.result & IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION) ||
+            gbuf == nullptr) {
+            if (mReportRemovedBuffers && (gbuf != nullptr)) {
+                mRemovedBuffers.push_back(gbuf);
+            }
+            requestSlots.push_back(output.slot);
+        }
+    }
+
+    if (!requestSlots.empty()) {
+        std::vector<RequestBufferOutput> requestOutputs;
+        result = mGraphicBufferProducer->requestBuffers(requestSlots, &requestOutputs);
+        for (size_t i = 0; result == NO_ERROR && i < requestOutputs.size(); i++) {
+            result = requestOutputs[i].result;
+            mSlots[requestSlots[i]].buffer = requestOutputs[i].buffer;
+        }
+        if (result != NO_ERROR) {
+            ALOGE("%s: IGraphicBufferProducer::requestBuffers failed: %d", __FUNCTION__, result);
+            std::vector<status_t> cancelResults;
+            mGraphicBufferProducer->cancelBuffers(cancelInputs, &cancelResults);
+            return result;
+        }
+    }
+
+    for (size_t i = 0; i < numBuffers; i++) {
+        const auto& output = dequeueOutputs[i];
+        BatchBuffer& batchBuffer = (*buffers)[i];
+
+        batchBuffer.buffer = mSlots[output.slot].buffer.get();
+        batchBuffer.fenceFd = -1;
+        if (output.fence != nullptr && output.fence->isValid()) {
+            batchBuffer.fenceFd = output.fence->dup();
+            if (batchBuffer.fenceFd == -1) {
+                ALOGE("%s: error duping fence: %d", __FUNCTION__, errno);
+                // dup() should never fail; something is badly wrong. Soldier on
+                // and hope for the best; the worst that should happen is some
+                // visible corruption that lasts until the next frame.
+            }
+        }
+
+        if (mSharedBufferSlot == output.slot) {
+            mSharedBufferSlot = BufferItem::INVALID_BUFFER_SLOT;
+            mSharedBufferHasBeenQueued = false;
+        }
+
+        mDequeuedSlots.insert(output.slot);
+    }
+
+    return OK;
+}
+
 int Surface::cancelBuffer(android_native_buffer_t* buffer,
         int fenceFd) {
     ATRACE_CALL();
@@ -767,6 +942,54 @@ int Surface::cancelBuffer(android_native_buffer_t* buffer,
     return OK;
 }
 
+int Surface::cancelBuffers(const std::vector<BatchBuffer>& buffers) {
+    using CancelBufferInput = IGraphicBufferProducer::CancelBufferInput;
+
+    ATRACE_CALL();
+    ALOGV("Surface::cancelBuffers");
+
+    Mutex::Autolock lock(mMutex);
+    if (mSharedBufferMode) {
+        ALOGE("%s: batch operation is not supported in shared buffer mode!", __FUNCTION__);
+        for (const auto& batchBuffer : buffers) {
+            if (batchBuffer.fenceFd >= 0) {
+                close(batchBuffer.fenceFd);
+            }
+        }
+        return INVALID_OPERATION;
+    }
+
+    int result = OK;
+    std::vector<CancelBufferInput> cancelInputs;
+    cancelInputs.reserve(buffers.size());
+    for (const auto& batchBuffer : buffers) {
+        int slot = getSlotFromBufferLocked(batchBuffer.buffer);
+        if (slot < 0) {
+            if (batchBuffer.fenceFd >= 0) {
+                close(batchBuffer.fenceFd);
+            }
+            result = slot;
+            continue;
+        }
+        sp<Fence> fence(batchBuffer.fenceFd >= 0 ? new Fence(batchBuffer.fenceFd)
+                                                 : Fence::NO_FENCE);
+        cancelInputs.push_back({slot, fence});
+    }
+
+    std::vector<status_t> cancelResults;
+    status_t err = mGraphicBufferProducer->cancelBuffers(cancelInputs, &cancelResults);
+    if (err != OK) {
+        ALOGE("%s: error canceling buffers: %d", __FUNCTION__, err);
+        result = err;
+    }
+
+    for (const auto& input : cancelInputs) {
+        mDequeuedSlots.erase(input.slot);
+    }
+
+    return result;
+}
+
 int Surface::getSlotFromBufferLocked(
         android_native_buffer_t* buffer) const {
     for (int i = 0; i < NUM_BUFFER_SLOTS; i++) {
@@ -785,42 +1008,22 @@ int Surface::lockBuffer_DEPRECATED(android_native_buffer_t* buffer __attribute__
     return OK;
 }
 
-int Surface::queueBuffer(android_native_buffer_t* buffer, int fenceFd) {
-    ATRACE_CALL();
-    ALOGV("Surface::queueBuffer");
-    Mutex::Autolock lock(mMutex);
-    int64_t timestamp;
+void Surface::getQueueBufferInputLocked(android_native_buffer_t* buffer, int fenceFd,
+        nsecs_t timestamp, IGraphicBufferProducer::QueueBufferInput* out) {
     bool isAutoTimestamp = false;
 
-    if (mTimestamp == NATIVE_WINDOW_TIMESTAMP_AUTO) {
+    if (timestamp == NATIVE_WINDOW_TIMESTAMP_AUTO) {
         timestamp = systemTime(SYSTEM_TIME_MONOTONIC);
         isAutoTimestamp = true;
         ALOGV("Surface::queueBuffer making up timestamp: %.2f ms",
             timestamp / 1000000.0);
-    } else {
-        timestamp = mTimestamp;
-    }
-    int i = getSlotFromBufferLocked(buffer);
-    if (i < 0) {
-        if (fenceFd >= 0) {
-            close(fenceFd);
-        }
-        return i;
-    }
-    if (mSharedBufferSlot == i && mSharedBufferHasBeenQueued) {
-        if (fenceFd >= 0) {
-            close(fenceFd);
-        }
-        return OK;
     }
 
-
     // Make sure the crop rectangle is entirely inside the buffer.
     Rect crop(Rect::EMPTY_RECT);
     mCrop.intersect(Rect(buffer->width, buffer->height), &crop);
 
     sp<Fence> fence(fenceFd >= 0 ? new Fence(fenceFd) : Fence::NO_FENCE);
-    IGraphicBufferProducer::QueueBufferOutput output;
     IGraphicBufferProducer::QueueBufferInput input(timestamp, isAutoTimestamp,
             static_cast<android_dataspace>(mDataSpace), crop, mScalingMode,
             mTransform ^ mStickyTransform, fence, mStickyTransform,
@@ -891,15 +1094,12 @@ int Surface::queueBuffer(android_native_buffer_t* buffer, int fenceFd) {
 
         input.setSurfaceDamage(flippedRegion);
     }
+    *out = input;
+}
 
-    nsecs_t now = systemTime();
-    status_t err = mGraphicBufferProducer->queueBuffer(i, input, &output);
-    mLastQueueDuration = systemTime() - now;
-    if (err != OK)  {
-        ALOGE("queueBuffer: error queuing buffer to SurfaceTexture, %d", err);
-    }
-
-    mDequeuedSlots.erase(i);
+void Surface::onBufferQueuedLocked(int slot, sp<Fence> fence,
+        const IGraphicBufferProducer::QueueBufferOutput& output) {
+    mDequeuedSlots.erase(slot);
 
     if (mEnableFrameTimestamps) {
         mFrameEventHistory->applyDelta(output.frameTimestamps);
@@ -933,7 +1133,7 @@ int Surface::queueBuffer(android_native_buffer_t* buffer, int fenceFd) {
         mDirtyRegion = Region::INVALID_REGION;
     }
 
-    if (mSharedBufferMode && mAutoRefresh && mSharedBufferSlot == i) {
+    if (mSharedBufferMode && mAutoRefresh && mSharedBufferSlot == slot) {
         mSharedBufferHasBeenQueued = true;
     }
 
@@ -943,6 +1143,103 @@ int Surface::queueBuffer(android_native_buffer_t* buffer, int fenceFd) {
         static FenceMonitor gpuCompletionThread("GPU completion");
         gpuCompletionThread.queueFence(fence);
     }
+}
+
+int Surface::queueBuffer(android_native_buffer_t* buffer, int fenceFd) {
+    ATRACE_CALL();
+    ALOGV("Surface::queueBuffer");
+    Mutex::Autolock lock(mMutex);
+
+    int i = getSlotFromBufferLocked(buffer);
+    if (i < 0) {
+        if (fenceFd >= 0) {
+            close(fenceFd);
+        }
+        return i;
+    }
+    if (mSharedBufferSlot == i && mSharedBufferHasBeenQueued) {
+        if (fenceFd >= 0) {
+            close(fenceFd);
+        }
+        return OK;
+    }
+
+    IGraphicBufferProducer::QueueBufferOutput output;
+    IGraphicBufferProducer::QueueBufferInput input;
+    getQueueBufferInputLocked(buffer, fenceFd, mTimestamp, &input);
+    sp<Fence> fence = input.fence;
+
+    nsecs_t now = systemTime();
+    status_t err = mGraphicBufferProducer->queueBuffer(i, input, &output);
+    mLastQueueDuration = systemTime() - now;
+    if (err != OK)  {
+        ALOGE("queueBuffer: error queuing buffer to SurfaceTexture, %d", err);
+    }
+
+    onBufferQueuedLocked(i, fence, output);
+    return err;
+}
+
+int Surface::queueBuffers(const std::vector<BatchQueuedBuffer>& buffers) {
+    using QueueBufferSlotInput = IGraphicBufferProducer::QueueBufferSlotInput;
+    using QueueBufferResult = IGraphicBufferProducer::QueueBufferResult;
+
+    ATRACE_CALL();
+    ALOGV("Surface::queueBuffers");
+    Mutex::Autolock lock(mMutex);
+
+    auto closeFences = [&buffers] {
+        for (const auto& batchBuffer : buffers) {
+            if (batchBuffer.fenceFd >= 0) {
+                close(batchBuffer.fenceFd);
+            }
+        }
+    };
+
+    if (mSharedBufferMode) {
+        ALOGE("%s: batch operation is not supported in shared buffer mode!", __FUNCTION__);
+        closeFences();
+        return INVALID_OPERATION;
+    }
+
+    std::vector<int> slots;
+    slots.reserve(buffers.size());
+    for (const auto& batchBuffer : buffers) {
+        int slot = getSlotFromBufferLocked(batchBuffer.buffer);
+        if (slot < 0) {
+            closeFences();
+            return slot;
+        }
+        slots.push_back(slot);
+    }
+
+    std::vector<QueueBufferSlotInput> queueInputs(buffers.size());
+    for (size_t i = 0; i < buffers.size(); i++) {
+        queueInputs[i].slot = slots[i];
+        getQueueBufferInputLocked(buffers[i].buffer, buffers[i].fenceFd, buffers[i].timestamp,
+                                  &queueInputs[i].input);
+    }
+
+    std::vector<QueueBufferResult> queueOutputs;
+    nsecs_t now = systemTime();
+    status_t err = mGraphicBufferProducer->queueBuffers(queueInputs, &queueOutputs);
+    mLastQueueDuration = systemTime() - now;
+    if (err != OK) {
+        ALOGE("%s: error queuing buffers to SurfaceTexture, %d", __FUNCTION__, err);
+        for (int slot : slots) {
+            mDequeuedSlots.erase(slot);
+        }
+        return err;
+    }
+
+    for (size_t i = 0; i < queueOutputs.size(); i++) {
+        const auto& [result, output] = queueOutputs[i];
+        if (result != OK) {
+            ALOGE("%s: error queuing buffer to SurfaceTexture, %d", __FUNCTION__, result);
+            err = result;
+        }
+        onBufferQueuedLocked(slots[i], queueInputs[i].input.fence, output);
+    }
 
     return err;
 }
@@ -1591,6 +1888,7 @@ int Surface::disconnect(int api, IGraphicBufferProducer::DisconnectMode mode) {
         mStickyTransform = 0;
         mAutoPrerotation = false;
         mEnableFrameTimestamps = false;
+        mFrameTimestampsRing.reset();
         mMaxBufferCount = NUM_BUFFER_SLOTS;
 
         if (api == NATIVE_WINDOW_API_CPU) {
@@ -19,6 +19,8 @@
 #include <stdint.h>
 #include <sys/types.h>
 
+#include <list>
+
 #include <utils/Errors.h>
 #include <utils/Log.h>
 #include <utils/SortedVector.h>
@@ -47,8 +49,9 @@
 
 #include <private/gui/ComposerService.h>
 
-// This server size should always be smaller than the server cache size
-#define BUFFER_CACHE_MAX_SIZE 64
+// These sizes should always be smaller than the server cache sizes
+#define BUFFER_CACHE_MAX_SIZE 256
+#define BUFFER_CACHE_MAX_BYTES (256 * 1024 * 1024)
 
 namespace android {
 
@@ -258,9 +261,11 @@ void removeDeadBufferCallback(void* /*context*/, uint64_t graphicBufferId);
  *        along with the Buffer, SurfaceFlinger on it's side creates a new cache
  *        entry, and we use the integer for further communication.
  * A few details about lifetime:
- *     1. The cache evicts by LRU. The server side cache is keyed by BufferCache::getToken
+ *     1. The cache evicts by LRU, once either the count or the memory of its buffers would
+ *        exceed its budget. The server side cache is keyed by BufferCache::getToken
  *        which is per process Unique. The server side cache is larger than the client side
- *        cache so that the server will never evict entries before the client.
+ *        cache so that the server will never evict entries before the client, unless the
+ *        uncacheBuffer transactions lag behind.
  *     2. When the client evicts an entry it notifies the server via an uncacheBuffer
  *        transaction.
  *     3. The client only references the Buffers by ID, and uses buffer->addDeathCallback
@@ -281,7 +286,7 @@ public:
         if (itr == mBuffers.end()) {
             return BAD_VALUE;
         }
-        itr->second = getCounter();
+        mLruBuffers.splice(mLruBuffers.begin(), mLruBuffers, itr->second.lruPosition);
         *cacheId = buffer->getId();
         return NO_ERROR;
     }
@@ -289,13 +294,18 @@ public:
     uint64_t cache(const sp<GraphicBuffer>& buffer) {
         std::lock_guard<std::mutex> lock(mMutex);
 
-        if (mBuffers.size() >= BUFFER_CACHE_MAX_SIZE) {
-            evictLeastRecentlyUsedBuffer();
+        const size_t size = getClientCacheBufferSize(buffer);
+        while (!mLruBuffers.empty() &&
+               (mBuffers.size() >= BUFFER_CACHE_MAX_SIZE ||
+                mCachedBytes + size > BUFFER_CACHE_MAX_BYTES)) {
+            uncacheLocked(mLruBuffers.back());
         }
 
         buffer->addDeathCallback(removeDeadBufferCallback, nullptr);
 
-        mBuffers[buffer->getId()] = getCounter();
+        mLruBuffers.push_front(buffer->getId());
+        mBuffers[buffer->getId()] = {mLruBuffers.begin(), size};
+        mCachedBytes += size;
         return buffer->getId();
     }
 
@@ -305,35 +315,27 @@ public:
     }
 
     void uncacheLocked(uint64_t cacheId) REQUIRES(mMutex) {
-        mBuffers.erase(cacheId);
+        if (auto itr = mBuffers.find(cacheId); itr != mBuffers.end()) {
+            mCachedBytes -= itr->second.size;
+            mLruBuffers.erase(itr->second.lruPosition);
+            mBuffers.erase(itr);
+        }
         SurfaceComposerClient::doUncacheBufferTransaction(cacheId);
     }
 
 private:
-    void evictLeastRecentlyUsedBuffer() REQUIRES(mMutex) {
-        auto itr = mBuffers.begin();
-        uint64_t minCounter = itr->second;
-        auto minBuffer = itr;
-        itr++;
-
-        while (itr != mBuffers.end()) {
-            uint64_t counter = itr->second;
-            if (counter < minCounter) {
-                minCounter = counter;
-                minBuffer = itr;
-            }
-            itr++;
-        }
-        uncacheLocked(minBuffer->first);
-    }
+    using LruList = std::list<uint64_t /*Cache id*/>;
 
-    uint64_t getCounter() REQUIRES(mMutex) {
-        static uint64_t counter = 0;
-        return counter++;
-    }
+    struct CachedBuffer {
+        LruList::iterator lruPosition;
+        size_t size;
+    };
 
     std::mutex mMutex;
-    std::map<uint64_t /*Cache id*/, uint64_t /*counter*/> mBuffers GUARDED_BY(mMutex);
+    std::unordered_map<uint64_t /*Cache id*/, CachedBuffer> mBuffers GUARDED_BY(mMutex);
+    // The cached buffers, from the most to the least recently used
+    LruList mLruBuffers GUARDED_BY(mMutex);
+    size_t mCachedBytes GUARDED_BY(mMutex) = 0;
 
     // Used by ISurfaceComposer to identify which process is sending the cached buffer.
     sp<IBinder> token;
@@ -1962,4 +1964,17 @@ status_t ScreenshotClient::captureChildLayers(
     return ret;
 }
 
+status_t ScreenshotClient::captureLayersAsync(const sp<IBinder>& layerHandle,
+                                              ui::Dataspace reqDataSpace,
+                                              ui::PixelFormat reqPixelFormat,
+                                              const Rect& sourceCrop, float frameScale,
+                                              sp<GraphicBuffer>* inOutBuffer,
+                                              sp<Fence>* outFence) {
+    sp<ISurfaceComposer> s(ComposerService::getComposerService());
+    if (s == nullptr) return NO_INIT;
+    const sp<GraphicBuffer> buffer = *inOutBuffer;
+    return s->captureLayersAsync(layerHandle, buffer, reqDataSpace, reqPixelFormat, sourceCrop, {},
+                                 frameScale, false /* childrenOnly */, inOutBuffer, outFence);
+}
+
 } // namespace android
@@ -0,0 +1,220 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <private/gui/VsyncTimeline.h>
+
+#include <linux/futex.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <climits>
+
+#include <binder/Parcel.h>
+#include <cutils/ashmem.h>
+#include <log/log.h>
+
+namespace android {
+namespace gui {
+
+struct VsyncTimeline::Page {
+    // Odd while a vsync is being written, and incremented by two for each vsync. Receivers
+    // wait on it as a futex.
+    std::atomic<uint32_t> sequence;
+    std::atomic<uint32_t> count;
+    std::atomic<uint64_t> displayId;
+    std::atomic<int64_t> timestamp;
+    std::atomic<int64_t> expectedVSyncTimestamp;
+    std::atomic<int64_t> deadlineTimestamp;
+    std::atomic<int64_t> expectedPresentTime;
+};
+
+// The page is shared across processes, so its atomics must not rely on a lock
+static_assert(std::atomic<int64_t>::is_always_lock_free);
+static_assert(std::atomic<uint64_t>::is_always_lock_free);
+
+namespace {
+
+long futex(const std::atomic<uint32_t>& word, int op, uint32_t value, const timespec* timeout) {
+    return syscall(SYS_futex, reinterpret_cast<const uint32_t*>(&word), op, value, timeout,
+                   nullptr, 0);
+}
+
+} // namespace
+
+VsyncTimeline::~VsyncTimeline() {
+    if (mPage) {
+        munmap(mPage, sizeof(Page));
+    }
+}
+
+std::unique_ptr<VsyncTimeline> VsyncTimeline::create() {
+    base::unique_fd fd(ashmem_create_region("VsyncTimeline", sizeof(Page)));
+    if (fd < 0) {
+        ALOGE("Failed to allocate the vsync timeline: %s", strerror(errno));
+        return nullptr;
+    }
+
+    auto timeline = std::make_unique<VsyncTimeline>();
+    if (timeline->map(std::move(fd), true) != NO_ERROR) {
+        return nullptr;
+    }
+    // Only the pages mapped so far may write to the memory
+    if (ashmem_set_prot_region(timeline->mFd, PROT_READ) < 0) {
+        ALOGE("Failed to make the vsync timeline read-only: %s", strerror(errno));
+        return nullptr;
+    }
+    return timeline;
+}
+
+status_t VsyncTimeline::map(base::unique_fd fd, bool writable) {
+    if (mPage) {
+        munmap(mPage, sizeof(Page));
+        mPage = nullptr;
+    }
+    mFd = std::move(fd);
+    mWritable = writable;
+    if (mFd < 0) {
+        return BAD_VALUE;
+    }
+
+    void* page = mmap(nullptr, sizeof(Page), writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                      MAP_SHARED, mFd, 0);
+    if (page == MAP_FAILED) {
+        ALOGE("Failed to map the vsync timeline: %s", strerror(errno));
+        return -errno;
+    }
+    // The memory is zero-filled when allocated, so the page is only constructed by its writer
+    mPage = writable ? new (page) Page{} : static_cast<Page*>(page);
+    return NO_ERROR;
+}
+
+status_t VsyncTimeline::share(VsyncTimeline* outTimeline, base::unique_fd wakeFd) const {
+    if (mFd < 0) {
+        return NO_INIT;
+    }
+    outTimeline->mWakeFd = std::move(wakeFd);
+    return outTimeline->map(base::unique_fd(dup(mFd)), false);
+}
+
+void VsyncTimeline::publish(const Vsync& vsync) {
+    LOG_ALWAYS_FATAL_IF(!mWritable, "Publishing to a read-only vsync timeline");
+
+    const uint32_t sequence = mPage->sequence.load(std::memory_order_relaxed);
+    mPage->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    mPage->displayId.store(vsync.displayId, std::memory_order_relaxed);
+    mPage->timestamp.store(vsync.timestamp, std::memory_order_relaxed);
+    mPage->count.store(vsync.count, std::memory_order_relaxed);
+    mPage->expectedVSyncTimestamp.store(vsync.expectedVSyncTimestamp, std::memory_order_relaxed);
+    mPage->deadlineTimestamp.store(vsync.deadlineTimestamp, std::memory_order_relaxed);
+    mPage->expectedPresentTime.store(vsync.expectedPresentTime, std::memory_order_relaxed);
+
+    mPage->sequence.store(sequence + 2, std::memory_order_release);
+    futex(mPage->sequence, FUTEX_WAKE, INT_MAX, nullptr);
+}
+
+uint32_t VsyncTimeline::read(Vsync* outVsync) const {
+    if (!mPage) {
+        return 0;
+    }
+
+    while (true) {
+        const uint32_t sequence = mPage->sequence.load(std::memory_order_acquire);
+        if (sequence & 1) {
+            continue;
+        }
+
+        outVsync->displayId = mPage->displayId.load(std::memory_order_relaxed);
+        outVsync->timestamp = mPage->timestamp.load(std::memory_order_relaxed);
+        outVsync->count = mPage->count.load(std::memory_order_relaxed);
+        outVsync->expectedVSyncTimestamp =
+                mPage->expectedVSyncTimestamp.load(std::memory_order_relaxed);
+        outVsync->deadlineTimestamp = mPage->deadlineTimestamp.load(std::memory_order_relaxed);
+        outVsync->expectedPresentTime =
+                mPage->expectedPresentTime.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (mPage->sequence.load(std::memory_order_relaxed) == sequence) {
+            return sequence / 2;
+        }
+    }
+}
+
+bool VsyncTimeline::wait(uint32_t sequence, nsecs_t timeout) const {
+    if (!mPage) {
+        return false;
+    }
+
+    const nsecs_t deadline = systemTime() + timeout;
+    while (true) {
+        const uint32_t current = mPage->sequence.load(std::memory_order_acquire);
+        if (!(current & 1) && current / 2 != sequence) {
+            return true;
+        }
+
+        const nsecs_t remaining = deadline - systemTime();
+        if (remaining <= 0) {
+            return false;
+        }
+        timespec relativeTimeout;
+        relativeTimeout.tv_sec = static_cast<time_t>(remaining / 1'000'000'000);
+        relativeTimeout.tv_nsec = static_cast<long>(remaining % 1'000'000'000);
+        futex(mPage->sequence, FUTEX_WAIT, current, &relativeTimeout);
+    }
+}
+
+bool VsyncTimeline::consumeWake() const {
+    eventfd_t value;
+    return mWakeFd >= 0 && eventfd_read(mWakeFd, &value) == 0;
+}
+
+status_t VsyncTimeline::writeToParcel(Parcel* parcel) const {
+    if (mFd < 0) {
+        return -EINVAL;
+    }
+    status_t result = parcel->writeDupFileDescriptor(mFd);
+    if (result != NO_ERROR) {
+        return result;
+    }
+    result = parcel->writeBool(mWakeFd >= 0);
+    if (result != NO_ERROR || mWakeFd < 0) {
+        return result;
+    }
+    return parcel->writeDupFileDescriptor(mWakeFd);
+}
+
+status_t VsyncTimeline::readFromParcel(const Parcel* parcel) {
+    const int fd = parcel->readFileDescriptor();
+    if (fd < 0) {
+        return BAD_VALUE;
+    }
+    mWakeFd.reset();
+    if (parcel->readBool()) {
+        const int wakeFd = parcel->readFileDescriptor();
+        if (wakeFd < 0) {
+            return BAD_VALUE;
+        }
+        mWakeFd.reset(dup(wakeFd));
+    }
+    return map(base::unique_fd(dup(fd)), false);
+}
+
+} // namespace gui
+} // namespace android
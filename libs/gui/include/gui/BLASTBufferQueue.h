@@ -45,6 +45,7 @@ public:
     void addAndGetFrameTimestamps(const NewFrameEventsEntry* newTimestamps,
                                   FrameEventHistoryDelta* outDelta) override
             REQUIRES(mFrameEventHistoryMutex);
+    status_t getFrameTimestampsMemory(base::unique_fd* outFd) override;
     void updateFrameTimestamps(uint64_t frameNumber, nsecs_t refreshStartTime,
                                const sp<Fence>& gpuCompositionDoneFence,
                                const sp<Fence>& presentFence, const sp<Fence>& prevReleaseFence,
@@ -83,6 +84,21 @@ public:
 
     void update(const sp<SurfaceControl>& surface, int width, int height);
 
+    // By default each buffer is sent to SurfaceFlinger in its own transaction, and a buffer is
+    // only sent once the transaction for the previous one has completed. With frame dropping
+    // enabled, up to maxTransactionsInFlight transactions may be outstanding, and buffers that
+    // queue up behind them are coalesced when the next transaction is sent: only the newest
+    // buffer is sent and the older ones are released unpresented, like BufferQueue's async mode.
+    status_t setFrameDropping(bool enabled, int maxTransactionsInFlight = 2);
+
+    struct FrameStats {
+        // Buffers whose transaction has completed.
+        uint64_t presentedFrames = 0;
+        // Buffers released without being sent because a newer buffer superseded them.
+        uint64_t droppedFrames = 0;
+    };
+    FrameStats getFrameStats();
+
     virtual ~BLASTBufferQueue() = default;
 
 private:
@@ -103,6 +119,9 @@ private:
     // BufferQueue internally allows 1 more than
     // the max to be acquired
     static const int MAX_ACQUIRED_BUFFERS = 1;
+    int32_t mMaxAcquiredBuffers GUARDED_BY(mMutex) = MAX_ACQUIRED_BUFFERS;
+    bool mDropSupersededFrames GUARDED_BY(mMutex) = false;
+    FrameStats mFrameStats GUARDED_BY(mMutex);
 
     int32_t mNumFrameAvailable GUARDED_BY(mMutex);
     int32_t mNumAcquired GUARDED_BY(mMutex);
@@ -96,6 +96,9 @@ public:
     // See |IGraphicBufferConsumer::dumpState|
     status_t dumpState(const String8& prefix, String8* outResult) const override;
 
+    // See |IGraphicBufferConsumer::setAdaptiveBufferCount|
+    status_t setAdaptiveBufferCount(bool enabled) override;
+
     // BufferHubConsumer provides its own logic to cast to a binder object.
     IBinder* onAsBinder() override;
 
@@ -20,6 +20,7 @@
 #include <gui/BufferItem.h>
 #include <gui/BufferQueueDefs.h>
 #include <gui/BufferSlot.h>
+#include <gui/BufferSlotSets.h>
 #include <gui/OccupancyTracker.h>
 
 #include <utils/NativeHandle.h>
@@ -29,10 +30,9 @@
 #include <utils/Trace.h>
 #include <utils/Vector.h>
 
-#include <list>
-#include <set>
 #include <mutex>
 #include <condition_variable>
+#include <deque>
 
 #define ATRACE_BUFFER_INDEX(index)                                                         \
     do {                                                                                   \
@@ -130,6 +130,25 @@ private:
     // waitWhileAllocatingLocked blocks until mIsAllocating is false.
     void waitWhileAllocatingLocked(std::unique_lock<std::mutex>& lock) const;
 
+    // setAdaptiveMaxDequeuedBufferCountLocked changes mMaxDequeuedBufferCount
+    // on behalf of the adaptive buffer count, with the same constraints as
+    // IGraphicBufferProducer::setMaxDequeuedBufferCount. Returns false if the
+    // count can't be changed right now.
+    bool setAdaptiveMaxDequeuedBufferCountLocked(int maxDequeuedBuffers);
+
+    // registerDequeueLocked records, for the adaptive buffer count, that the
+    // producer dequeued a buffer and now has dequeuedCount buffers dequeued,
+    // and whether it had to wait for a buffer while the queue was empty.
+    void registerDequeueLocked(int dequeuedCount, bool starved);
+
+    // updateAdaptiveBufferCountLocked is called after each queued buffer. At
+    // the end of each window of kAdaptiveWindowFrames frames, it raises
+    // mMaxDequeuedBufferCount if the producer was starved of buffers, and
+    // lowers it if a dequeued buffer went unused for kIdleAdaptiveWindows
+    // windows. Returns true if it took away a slot, in which case the
+    // consumer must be notified with onBuffersReleased.
+    bool updateAdaptiveBufferCountLocked();
+
 #if DEBUG_ONLY_CODE
     // validateConsistencyLocked ensures that the free lists are in sync with
     // the information stored in mSlots
@@ -202,18 +221,18 @@ private:
 
     // mFreeSlots contains all of the slots which are FREE and do not currently
     // have a buffer attached.
-    std::set<int> mFreeSlots;
+    SlotSet mFreeSlots;
 
     // mFreeBuffers contains all of the slots which are FREE and currently have
     // a buffer attached.
-    std::list<int> mFreeBuffers;
+    SlotList mFreeBuffers;
 
     // mUnusedSlots contains all slots that are currently unused. They should be
     // free and not have a buffer attached.
-    std::list<int> mUnusedSlots;
+    SlotList mUnusedSlots;
 
     // mActiveBuffers contains all slots which have a non-FREE buffer attached.
-    std::set<int> mActiveBuffers;
+    SlotSet mActiveBuffers;
 
     // mDequeueCondition is a condition variable used for dequeueBuffer in
     // synchronous mode.
@@ -354,6 +373,39 @@ private:
     // mTransformHintInUse is to cache the mTransformHint used by the producer.
     uint32_t mTransformHintInUse;
 
+    static constexpr size_t kAdaptiveWindowFrames = 60;
+    static constexpr size_t kStarvedDequeuesToGrow = 2;
+    static constexpr int kIdleAdaptiveWindows = 3;
+    static constexpr int kMaxAdaptiveExtraBuffers = 2;
+    static constexpr size_t kMaxBufferCountDecisions = 8;
+
+    // mAdaptiveBufferCount indicates whether mMaxDequeuedBufferCount is tuned
+    // from the occupancy of the queue. It can be set by the consumer via
+    // setAdaptiveBufferCount. mMaxDequeuedBufferCount is then kept between
+    // mRequestedMaxDequeuedBufferCount, which is the count last set by the
+    // producer, and kMaxAdaptiveExtraBuffers more.
+    bool mAdaptiveBufferCount;
+    int mRequestedMaxDequeuedBufferCount;
+
+    // What the producer and the queue did during the current adaptive window
+    struct AdaptiveWindow {
+        size_t frames = 0;
+        size_t maxOccupancy = 0;
+        int maxDequeued = 0;
+        size_t starvedDequeues = 0;
+    };
+    AdaptiveWindow mAdaptiveWindow;
+    int mIdleAdaptiveWindows;
+
+    // The most recent changes of the adaptive buffer count, newest first
+    struct BufferCountDecision {
+        nsecs_t time;
+        int from;
+        int to;
+        AdaptiveWindow window;
+    };
+    std::deque<BufferCountDecision> mBufferCountDecisions;
+
 }; // class BufferQueueCore
 
 } // namespace android
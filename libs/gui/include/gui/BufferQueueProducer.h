@@ -189,6 +189,9 @@ public:
     // See IGraphicBufferProducer::getFrameTimestamps
     virtual void getFrameTimestamps(FrameEventHistoryDelta* outDelta) override;
 
+    // See IGraphicBufferProducer::getFrameTimestampsMemory
+    status_t getFrameTimestampsMemory(base::unique_fd* outFd) override;
+
     // See IGraphicBufferProducer::getUniqueId
     virtual status_t getUniqueId(uint64_t* outId) const override;
 
@@ -210,6 +213,10 @@ private:
     // BufferQueueCore::INVALID_BUFFER_SLOT otherwise
     int getFreeSlotLocked() const;
 
+    // Returns whether buffers may be taken from and returned to the process-wide
+    // GraphicBufferPool, which is only the case when the producer is in this process
+    bool usesBufferPoolLocked() const;
+
     void addAndGetFrameTimestamps(const NewFrameEventsEntry* newTimestamps,
             FrameEventHistoryDelta* outDelta);
 
@@ -0,0 +1,229 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_GUI_BUFFERSLOTSETS_H
+#define ANDROID_GUI_BUFFERSLOTSETS_H
+
+#include <gui/BufferQueueDefs.h>
+
+#include <log/log.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+
+namespace android {
+
+// Containers for the slot bookkeeping of BufferQueueCore. There are at most
+// NUM_BUFFER_SLOTS slots, so membership fits in a single 64-bit mask and the
+// containers never allocate.
+static_assert(BufferQueueDefs::NUM_BUFFER_SLOTS <= 64, "Slots must fit in a 64-bit mask");
+
+// An ordered set of slots, iterated in increasing slot order like a
+// std::set<int>. Insertion, removal and lookup are constant time.
+class SlotSet {
+public:
+    class const_iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = int;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const int*;
+        using reference = int;
+
+        int operator*() const { return __builtin_ctzll(mRemaining); }
+        const_iterator& operator++() {
+            mRemaining &= mRemaining - 1;
+            return *this;
+        }
+        const_iterator operator++(int) {
+            const_iterator previous = *this;
+            ++*this;
+            return previous;
+        }
+        bool operator==(const const_iterator& other) const {
+            return mRemaining == other.mRemaining;
+        }
+        bool operator!=(const const_iterator& other) const { return !(*this == other); }
+
+    private:
+        friend class SlotSet;
+        explicit const_iterator(uint64_t remaining) : mRemaining(remaining) {}
+
+        // The slots not iterated over yet. Iterating over a copy of the mask
+        // keeps iterators valid while the set is modified.
+        uint64_t mRemaining;
+    };
+    using iterator = const_iterator;
+
+    bool insert(int slot) {
+        const uint64_t bit = bitFor(slot);
+        const bool inserted = !(mSlots & bit);
+        mSlots |= bit;
+        return inserted;
+    }
+
+    size_t erase(int slot) {
+        const uint64_t bit = bitFor(slot);
+        const size_t erased = (mSlots & bit) ? 1 : 0;
+        mSlots &= ~bit;
+        return erased;
+    }
+    void erase(const_iterator position) { erase(*position); }
+
+    size_t count(int slot) const { return (mSlots & bitFor(slot)) ? 1 : 0; }
+    size_t size() const { return static_cast<size_t>(__builtin_popcountll(mSlots)); }
+    bool empty() const { return mSlots == 0; }
+    void clear() { mSlots = 0; }
+
+    const_iterator begin() const { return const_iterator(mSlots); }
+    const_iterator end() const { return const_iterator(0); }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+
+private:
+    static uint64_t bitFor(int slot) {
+        LOG_FATAL_IF(slot < 0 || slot >= BufferQueueDefs::NUM_BUFFER_SLOTS, "Invalid slot %d",
+                     slot);
+        return uint64_t{1} << slot;
+    }
+
+    uint64_t mSlots = 0;
+};
+
+// A sequence of distinct slots, like a std::list<int> used as a deque. Slots
+// are kept in a fixed ring buffer, so adding and removing at either end is
+// constant time, as is lookup through the membership mask. Removing from the
+// middle shifts at most NUM_BUFFER_SLOTS entries.
+class SlotList {
+public:
+    class const_iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = int;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const int*;
+        using reference = int;
+
+        int operator*() const { return mList->at(mIndex); }
+        const_iterator& operator++() {
+            mIndex++;
+            return *this;
+        }
+        const_iterator operator++(int) {
+            const_iterator previous = *this;
+            ++*this;
+            return previous;
+        }
+        bool operator==(const const_iterator& other) const {
+            return mList == other.mList && mIndex == other.mIndex;
+        }
+        bool operator!=(const const_iterator& other) const { return !(*this == other); }
+
+    private:
+        friend class SlotList;
+        const_iterator(const SlotList* list, size_t index) : mList(list), mIndex(index) {}
+
+        const SlotList* mList;
+        size_t mIndex;
+    };
+    using iterator = const_iterator;
+
+    void push_back(int slot) {
+        add(slot);
+        mSlots[wrap(mHead + mSize)] = static_cast<int8_t>(slot);
+        mSize++;
+    }
+
+    void push_front(int slot) {
+        add(slot);
+        mHead = wrap(mHead + kCapacity - 1);
+        mSlots[mHead] = static_cast<int8_t>(slot);
+        mSize++;
+    }
+
+    int front() const { return at(0); }
+    int back() const { return at(mSize - 1); }
+
+    void pop_front() {
+        mMembers &= ~(uint64_t{1} << front());
+        mHead = wrap(mHead + 1);
+        mSize--;
+    }
+
+    void pop_back() {
+        mMembers &= ~(uint64_t{1} << back());
+        mSize--;
+    }
+
+    // Removes the slot if present, keeping the order of the remaining slots.
+    void remove(int slot) {
+        if (!count(slot)) {
+            return;
+        }
+        mMembers &= ~(uint64_t{1} << slot);
+        size_t index = 0;
+        while (at(index) != slot) {
+            index++;
+        }
+        for (; index + 1 < mSize; index++) {
+            mSlots[wrap(mHead + index)] = mSlots[wrap(mHead + index + 1)];
+        }
+        mSize--;
+    }
+
+    size_t count(int slot) const {
+        if (slot < 0 || slot >= BufferQueueDefs::NUM_BUFFER_SLOTS) {
+            return 0;
+        }
+        return (mMembers & (uint64_t{1} << slot)) ? 1 : 0;
+    }
+    size_t size() const { return mSize; }
+    bool empty() const { return mSize == 0; }
+    void clear() {
+        mMembers = 0;
+        mHead = 0;
+        mSize = 0;
+    }
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, mSize); }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+
+private:
+    static constexpr size_t kCapacity = BufferQueueDefs::NUM_BUFFER_SLOTS;
+
+    static size_t wrap(size_t index) { return index % kCapacity; }
+    int at(size_t index) const { return mSlots[wrap(mHead + index)]; }
+
+    void add(int slot) {
+        LOG_FATAL_IF(slot < 0 || slot >= BufferQueueDefs::NUM_BUFFER_SLOTS, "Invalid slot %d",
+                     slot);
+        LOG_FATAL_IF(count(slot), "Slot %d is already in the list", slot);
+        mMembers |= uint64_t{1} << slot;
+    }
+
+    std::array<int8_t, kCapacity> mSlots{};
+    uint64_t mMembers = 0;
+    size_t mHead = 0;
+    size_t mSize = 0;
+};
+
+} // namespace android
+
+#endif // ANDROID_GUI_BUFFERSLOTSETS_H
@@ -19,6 +19,7 @@
 
 #include <system/window.h>
 
+#include <gui/BufferItem.h>
 #include <gui/ConsumerBase.h>
 #include <gui/BufferQueue.h>
 
@@ -105,12 +106,30 @@ class CpuConsumer : public ConsumerBase
     // by calling unlockBuffer before more buffers can be acquired.
     status_t lockNextBuffer(LockedBuffer *nativeBuffer);
 
+    // Like lockNextBuffer, but does not block on the acquire fence of the
+    // buffer. If the producer has not finished writing the buffer yet, returns
+    // WOULD_BLOCK and the acquire fence in outFence, and keeps the buffer
+    // acquired; the next call locks it, which no longer blocks once the fence
+    // has signaled. Otherwise outFence is set to Fence::NO_FENCE.
+    status_t lockNextBuffer(LockedBuffer *nativeBuffer, sp<Fence>* outFence);
+
     // Returns a locked buffer to the queue, allowing it to be reused. Since
     // only a fixed number of buffers may be locked at a time, old buffers must
     // be released by calling unlockBuffer to ensure new buffers can be acquired by
     // lockNextBuffer.
     status_t unlockBuffer(const LockedBuffer &nativeBuffer);
 
+    // With persistent mapping enabled, each buffer stays mapped for CPU access
+    // for as long as it is in its BufferQueue slot, instead of being mapped
+    // when locked and unmapped when unlocked. Locking a buffer then only has
+    // to do the cache maintenance for reading it. Disabling it unmaps the
+    // buffers that are not locked. Disabled by default.
+    void setPersistentMapping(bool enabled);
+
+  protected:
+    // From ConsumerBase. Unmaps the persistently mapped buffer of the slot.
+    void freeBufferLocked(int slotIndex) override;
+
   private:
     // Maximum number of buffers that can be locked at a time
     const size_t mMaxLockedBuffers;
@@ -142,10 +161,23 @@ class CpuConsumer : public ConsumerBase
 
     status_t lockBufferItem(const BufferItem& item, LockedBuffer* outBuffer) const;
 
+    // Keeps the buffer of the item mapped until its slot is freed, if it is
+    // not mapped yet.
+    void mapBufferLocked(const BufferItem& item);
+    void unmapBufferLocked(int slot);
+
     Vector<AcquiredBuffer> mAcquiredBuffers;
 
     // Count of currently locked buffers
     size_t mCurrentLockedBuffers;
+
+    // A buffer acquired by lockNextBuffer whose acquire fence had not signaled
+    bool mHasPendingBuffer;
+    BufferItem mPendingBuffer;
+
+    bool mPersistentMapping;
+    // The buffers that stay mapped, by slot, each locked once for that
+    sp<GraphicBuffer> mMappedBuffers[BufferQueue::NUM_BUFFER_SLOTS];
 };
 
 } // namespace android
@@ -18,6 +18,8 @@
 #include <utils/Log.h>
 #include <utils/Looper.h>
 
+#include <memory>
+
 namespace android {
 
 class DisplayEventDispatcher : public LooperCallback {
@@ -29,6 +31,12 @@ public:
                     ISurfaceComposer::eConfigChangedSuppress);
 
     status_t initialize();
+    // Switches to reading vsyncs from the EventThread's timeline after initialize(). The Looper
+    // is then woken up once by the timeline's wake fd whatever the number of vsyncs published
+    // while the app was busy, and the latest vsync is read without reading from getFd(), which
+    // still gets hotplug and config change events. Without a Looper, vsyncs are dispatched
+    // from handleEvent().
+    status_t enableVsyncTimeline();
     void dispose();
     status_t scheduleVsync();
     void injectEvent(const DisplayEventReceiver::Event& event);
@@ -36,12 +44,15 @@ public:
     virtual int handleEvent(int receiveFd, int events, void* data);
 
 protected:
-    virtual ~DisplayEventDispatcher() = default;
+    virtual ~DisplayEventDispatcher();
 
 private:
     sp<Looper> mLooper;
     DisplayEventReceiver mReceiver;
     bool mWaitingForVsync;
+    std::unique_ptr<gui::VsyncTimeline> mVsyncTimeline;
+    // Sequence number of the latest vsync read from mVsyncTimeline
+    uint32_t mVsyncSequence = 0;
 
     virtual void dispatchVsync(nsecs_t timestamp, PhysicalDisplayId displayId, uint32_t count) = 0;
     virtual void dispatchHotplug(nsecs_t timestamp, PhysicalDisplayId displayId,
@@ -54,5 +65,7 @@ private:
 
     bool processPendingEvents(nsecs_t* outTimestamp, PhysicalDisplayId* outDisplayId,
                               uint32_t* outCount);
+    bool processVsyncTimeline(nsecs_t* outTimestamp, PhysicalDisplayId* outDisplayId,
+                              uint32_t* outCount);
 };
 } // namespace android
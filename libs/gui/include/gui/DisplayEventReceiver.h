@@ -37,6 +37,7 @@ class IDisplayEventConnection;
 
 namespace gui {
 class BitTube;
+class VsyncTimeline;
 } // namespace gui
 
 static inline constexpr uint32_t fourcc(char c1, char c2, char c3, char c4) {
@@ -67,6 +68,11 @@ public:
         struct VSync {
             uint32_t count;
             nsecs_t expectedVSyncTimestamp;
+            // The time by which a buffer must be queued for SurfaceFlinger to latch it for
+            // the next frame, and when that frame is then expected to be presented. Both are
+            // expectedVSyncTimestamp if SurfaceFlinger's deadline is not known.
+            nsecs_t deadlineTimestamp;
+            nsecs_t expectedPresentTime;
         };
 
         struct Hotplug {
@@ -148,6 +154,15 @@ public:
      */
     status_t requestNextVsync();
 
+    /*
+     * getVsyncTimeline() opts in to reading vsyncs from a shared memory timeline, see
+     * gui::VsyncTimeline, rather than from getEvents(), which then only returns hotplug and
+     * config change events. The receivers using the timeline are all woken up by a single
+     * futex wake per vsync. Receivers polling fds rather than waiting on the timeline set
+     * wakeFd to also get an eventfd signaled for their vsyncs.
+     */
+    status_t getVsyncTimeline(gui::VsyncTimeline* outTimeline, bool wakeFd = false);
+
 private:
     sp<IDisplayEventConnection> mEventConnection;
     std::unique_ptr<gui::BitTube> mDataChannel;
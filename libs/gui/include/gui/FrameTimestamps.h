@@ -17,17 +17,24 @@
 #ifndef ANDROID_GUI_FRAMETIMESTAMPS_H
 #define ANDROID_GUI_FRAMETIMESTAMPS_H
 
+#include <android-base/unique_fd.h>
 #include <ui/FenceTime.h>
+#include <utils/Errors.h>
 #include <utils/Flattenable.h>
 #include <utils/StrongPointer.h>
 #include <utils/Timers.h>
 
 #include <array>
 #include <bitset>
+#include <memory>
 #include <vector>
 
 namespace android {
 
+namespace gui {
+class FrameTimestampsRing;
+} // namespace gui
+
 struct FrameEvents;
 class FrameEventHistoryDelta;
 
@@ -143,6 +150,11 @@ public:
             uint64_t frameNumber, std::shared_ptr<FenceTime>&& acquire);
     void applyDelta(const FrameEventHistoryDelta& delta);
 
+    // Applies the timestamps the consumer published to shared memory, which doesn't need a
+    // binder call. Fences that haven't signaled yet are left for the next delta.
+    void applySharedFrame(const gui::FrameTimestampsRing& ring, uint64_t frameNumber);
+    void applySharedCompositorTiming(const gui::FrameTimestampsRing& ring);
+
     void updateSignalTimes();
 
 protected:
@@ -224,9 +236,14 @@ public:
 
     void getAndResetDelta(FrameEventHistoryDelta* delta);
 
+    // Starts publishing the frame events to shared memory, see gui::FrameTimestampsRing, and
+    // returns a file descriptor of the memory for the producer.
+    status_t shareTimestamps(base::unique_fd* outFd);
+
 private:
     void getFrameDelta(FrameEventHistoryDelta* delta,
                        const std::vector<FrameEvents>::iterator& frame);
+    void publishShared(const FrameEvents& frame);
 
     std::vector<FrameEventDirtyFields> mFramesDirty;
 
@@ -236,6 +253,8 @@ private:
 
     int mCurrentConnectId{0};
     bool mProducerWantsEvents{false};
+
+    std::unique_ptr<gui::FrameTimestampsRing> mSharedTimestamps;
 };
 
 
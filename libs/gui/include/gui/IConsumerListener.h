@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include <android-base/unique_fd.h>
 #include <binder/IInterface.h>
 #include <binder/SafeInterface.h>
 
@@ -90,6 +91,14 @@ public:
     // WARNING: This method can only be called when the BufferQueue is in the consumer's process.
     virtual void addAndGetFrameTimestamps(const NewFrameEventsEntry* /*newTimestamps*/,
                                           FrameEventHistoryDelta* /*outDelta*/) {}
+
+    // Returns a file descriptor of the shared memory that the consumer publishes its frame
+    // timestamps to, see gui::FrameTimestampsRing.
+    //
+    // WARNING: This method can only be called when the BufferQueue is in the consumer's process.
+    virtual status_t getFrameTimestampsMemory(base::unique_fd* /*outFd*/) {
+        return INVALID_OPERATION;
+    }
 };
 
 #ifndef NO_BINDER
@@ -27,6 +27,7 @@ namespace android {
 
 namespace gui {
 class BitTube;
+class VsyncTimeline;
 } // namespace gui
 
 class IDisplayEventConnection : public IInterface {
@@ -51,6 +52,15 @@ public:
      * requestNextVsync() schedules the next vsync event. It has no effect if the vsync rate is > 0.
      */
     virtual void requestNextVsync() = 0; // Asynchronous
+
+    /*
+     * getVsyncTimeline() returns the shared memory timeline of the latest vsync, and stops
+     * sending vsync events through the receive channel. Vsyncs are still only published when
+     * requested through setVsyncRate() or requestNextVsync(), and other events are still sent
+     * through the receive channel. If wakeFd is set, the timeline comes with an eventfd signaled
+     * for each vsync published for this connection, see gui::VsyncTimeline::getWakeFd().
+     */
+    virtual status_t getVsyncTimeline(bool wakeFd, gui::VsyncTimeline* outTimeline) = 0;
 };
 
 class BnDisplayEventConnection : public SafeBnInterface<IDisplayEventConnection> {
@@ -284,6 +284,20 @@ public:
         dumpState(String8(prefix), &returned);
         result.append(returned);
     }
+
+    // setAdaptiveBufferCount enables or disables tuning of the max dequeued buffer count from the
+    // occupancy of the BufferQueue. While enabled, the count is raised by one, up to 2 buffers
+    // above the count requested by the producer, when the producer repeatedly waits for a buffer
+    // while none is queued, and lowered by one, never below the requested count, when a buffer
+    // has been left unused for a while. Decisions are listed by dumpState.
+    // Disabling it restores the count requested by the producer. As with discardFreeBuffers, the
+    // consumer invoking this method is responsible for calling getReleasedBuffers() afterwards;
+    // buffers freed while lowering the count during queueBuffer are reported through
+    // IConsumerListener::onBuffersReleased.
+    //
+    // Return of a value other than NO_ERROR means an error has occurred:
+    // * NO_INIT - the BufferQueue has been abandoned.
+    virtual status_t setAdaptiveBufferCount(bool enabled) = 0;
 };
 
 #ifndef NO_BINDER
@@ -23,6 +23,7 @@
 #include <utils/Errors.h>
 #include <utils/RefBase.h>
 
+#include <android-base/unique_fd.h>
 #include <binder/IInterface.h>
 
 #include <ui/BufferQueueDefs.h>
@@ -38,6 +39,9 @@
 #include <android/hardware/graphics/bufferqueue/1.0/IGraphicBufferProducer.h>
 #include <android/hardware/graphics/bufferqueue/2.0/IGraphicBufferProducer.h>
 
+#include <optional>
+#include <vector>
+
 namespace android {
 // ----------------------------------------------------------------------------
 
@@ -290,6 +294,7 @@ public:
 
     struct QueueBufferInput : public Flattenable<QueueBufferInput> {
         friend class Flattenable<QueueBufferInput>;
+        QueueBufferInput() = default;
         explicit inline QueueBufferInput(const Parcel& parcel);
 
         // timestamp - a monotonically increasing value in nanoseconds
@@ -439,6 +444,67 @@ public:
     //              * the slot was not in the dequeued state
     virtual status_t cancelBuffer(int slot, const sp<Fence>& fence) = 0;
 
+    // Batched variants of dequeueBuffer, requestBuffer, queueBuffer and
+    // cancelBuffer, which perform several operations with a single call into
+    // the server. Each operation reports its own result in the corresponding
+    // output, which are in the same order as the inputs. The returned status
+    // is only an error if the batch itself could not be performed, e.g. on a
+    // binder failure, in which case the outputs are undefined.
+    //
+    // dequeueBuffers stops at the first dequeue which fails, since the ones
+    // after it would block or fail in the same way; its outputs then end with
+    // that failure. The other batches perform every operation.
+    //
+    // The default implementations perform the operations one at a time, so
+    // producers which are not remote do not need to implement them.
+    struct DequeueBufferInput {
+        uint32_t width{0};
+        uint32_t height{0};
+        PixelFormat format{0};
+        uint64_t usage{0};
+        bool getTimestamps{false};
+    };
+
+    struct DequeueBufferOutput {
+        status_t result{NO_ERROR};
+        int slot{-1};
+        sp<Fence> fence{Fence::NO_FENCE};
+        uint64_t bufferAge{0};
+        std::optional<FrameEventHistoryDelta> timestamps;
+    };
+
+    virtual status_t dequeueBuffers(const std::vector<DequeueBufferInput>& inputs,
+                                    std::vector<DequeueBufferOutput>* outputs);
+
+    struct RequestBufferOutput {
+        status_t result{NO_ERROR};
+        sp<GraphicBuffer> buffer;
+    };
+
+    virtual status_t requestBuffers(const std::vector<int32_t>& slots,
+                                    std::vector<RequestBufferOutput>* outputs);
+
+    struct QueueBufferSlotInput {
+        int slot{-1};
+        QueueBufferInput input;
+    };
+
+    struct QueueBufferResult {
+        status_t result{NO_ERROR};
+        QueueBufferOutput output;
+    };
+
+    virtual status_t queueBuffers(const std::vector<QueueBufferSlotInput>& inputs,
+                                  std::vector<QueueBufferResult>* outputs);
+
+    struct CancelBufferInput {
+        int slot{-1};
+        sp<Fence> fence{Fence::NO_FENCE};
+    };
+
+    virtual status_t cancelBuffers(const std::vector<CancelBufferInput>& inputs,
+                                   std::vector<status_t>* results);
+
     // query retrieves some information for this surface
     // 'what' tokens allowed are that of NATIVE_WINDOW_* in <window.h>
     //
@@ -622,6 +688,11 @@ public:
     // Gets the frame events that haven't already been retrieved.
     virtual void getFrameTimestamps(FrameEventHistoryDelta* /*outDelta*/) {}
 
+    // Gets a file descriptor of the shared memory that the consumer publishes its frame
+    // timestamps to, see gui::FrameTimestampsRing, so that most of them can be read without
+    // calling getFrameTimestamps. Returns INVALID_OPERATION if the consumer doesn't publish them.
+    virtual status_t getFrameTimestampsMemory(base::unique_fd* outFd);
+
     // Returns a unique id for this BufferQueue
     virtual status_t getUniqueId(uint64_t* outId) const = 0;
 
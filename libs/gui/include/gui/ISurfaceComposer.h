@@ -53,6 +53,7 @@ struct DisplayInfo;
 struct DisplayStatInfo;
 struct DisplayState;
 struct InputWindowCommands;
+class Fence;
 class LayerDebugInfo;
 class HdrCapabilities;
 class IDisplayEventConnection;
@@ -335,6 +336,24 @@ public:
                              ui::PixelFormat::RGBA_8888, sourceCrop, {}, frameScale, childrenOnly);
     }
 
+    /**
+     * Capture a subtree of the layer hierarchy without waiting for rendering to complete.
+     *
+     * If buffer is not null, the layers are rendered into it, so callers capturing repeatedly can
+     * recycle their buffers instead of having a new one allocated for every capture. The buffer
+     * must match the size of the capture and reqPixelFormat, and must be usable as a render
+     * target. The caller must be done reading the buffer before passing it in.
+     *
+     * On success, outBuffer holds the buffer the layers are rendered into, and outFence signals
+     * once rendering into it has completed.
+     */
+    virtual status_t captureLayersAsync(
+            const sp<IBinder>& layerHandleBinder, const sp<GraphicBuffer>& buffer,
+            ui::Dataspace reqDataspace, ui::PixelFormat reqPixelFormat, const Rect& sourceCrop,
+            const std::unordered_set<sp<IBinder>, SpHash<IBinder>>& excludeHandles,
+            float frameScale, bool childrenOnly, sp<GraphicBuffer>* outBuffer,
+            sp<Fence>* outFence) = 0;
+
     /* Clears the frame statistics for animations.
      *
      * Requires the ACCESS_SURFACE_FLINGER permission.
@@ -599,6 +618,7 @@ public:
         SET_GAME_CONTENT_TYPE,
         SET_FRAME_RATE,
         ACQUIRE_FRAME_RATE_FLEXIBILITY_TOKEN,
+        CAPTURE_LAYERS_ASYNC,
         // Always append new enum to the end.
     };
 
@@ -52,6 +52,10 @@ struct client_cache_t {
     bool isValid() const { return token != nullptr; }
 };
 
+// The memory a buffer is accounted for in the client cache budget of its
+// process. SurfaceComposerClient and SurfaceFlinger must agree on it.
+size_t getClientCacheBufferSize(const sp<GraphicBuffer>& buffer);
+
 /*
  * Used to communicate layer information between SurfaceFlinger and its clients.
  */
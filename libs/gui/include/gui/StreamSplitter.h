@@ -24,6 +24,8 @@
 #include <utils/KeyedVector.h>
 #include <utils/Mutex.h>
 #include <utils/StrongPointer.h>
+#include <utils/Timers.h>
+#include <utils/Vector.h>
 
 namespace android {
 
@@ -37,8 +39,47 @@ class IGraphicBufferProducer;
 // BufferQueue, where each buffer queued to the input is available to be
 // acquired by each of the outputs, and is able to be dequeued by the input
 // again only once all of the outputs have released it.
+//
+// Buffers are shared by the outputs, not copied. By default, an output that
+// consumes buffers too slowly stalls all of the outputs and the input. Each
+// output can instead be configured to drop frames while it falls behind, so
+// that the other outputs keep running at the input rate.
 class StreamSplitter : public BnConsumerListener {
 public:
+    // What happens to a new frame when an output already holds its maximum
+    // number of buffers.
+    enum class DropPolicy {
+        // The splitter stops acquiring buffers from the input until the output
+        // releases a buffer, which slows down every output and the producer
+        // of the input.
+        Block,
+        // The output skips the new frame.
+        DropNewest,
+        // The output is put in async mode, so a frame that its consumer has
+        // not acquired yet is replaced by the next one. The output then holds
+        // at most one buffer more than its consumer acquires, and
+        // maxOutstandingBuffers is not used.
+        DropOldest,
+    };
+
+    struct OutputConfig {
+        // The number of buffers the output may hold at once, queued or
+        // acquired by its consumer
+        int maxOutstandingBuffers;
+        DropPolicy dropPolicy;
+    };
+
+    struct OutputStats {
+        // Frames queued to the output
+        uint64_t queuedFrames;
+        // Frames the output skipped or replaced, see DropPolicy
+        uint64_t droppedFrames;
+        // The time from acquiring a buffer from the input until the output
+        // released it, over the buffers released so far
+        nsecs_t averageLatency;
+        nsecs_t maxLatency;
+    };
+
     // createSplitter creates a new splitter, outSplitter, using inputQueue as
     // the input BufferQueue. Output BufferQueues must be added using addOutput
     // before queueing any buffers to the input.
@@ -61,7 +102,18 @@ public:
     // outputQueue has not been added to the splitter. BAD_VALUE is returned if
     // outputQueue is NULL. See IGraphicBufferProducer::connect for explanations
     // of other error codes.
+    //
+    // The output is paced with DropPolicy::Block and MAX_OUTSTANDING_BUFFERS
+    // outstanding buffers, unless another config is given.
     status_t addOutput(const sp<IGraphicBufferProducer>& outputQueue);
+    status_t addOutput(const sp<IGraphicBufferProducer>& outputQueue,
+            const OutputConfig& config);
+
+    // getOutputStats returns the frame and latency statistics of an output
+    // added with addOutput. BAD_VALUE is returned if output is not one of the
+    // outputs of the splitter.
+    status_t getOutputStats(const sp<IGraphicBufferProducer>& output,
+            OutputStats* outStats) const;
 
     // setName sets the consumer name of the input queue
     void setName(const String8& name);
@@ -93,7 +145,7 @@ private:
     // During this callback, we detach the buffer from the output queue that
     // generated the callback, update our state tracking to see if this is the
     // last output releasing the buffer, and if so, release it to the input.
-    // If we release the buffer to the input, we allow a blocked
+    // Since the output now holds one buffer less, we allow a blocked
     // onFrameAvailable call to proceed.
     void onBufferReleasedByOutput(const sp<IGraphicBufferProducer>& from);
 
@@ -135,6 +187,8 @@ private:
 
         void mergeFence(const sp<Fence>& with);
 
+        nsecs_t getAcquireTime() const { return mAcquireTime; }
+
         // Returns the new value
         // Only called while mMutex is held
         size_t incrementReleaseCountLocked() { return ++mReleaseCount; }
@@ -151,8 +205,36 @@ private:
         sp<GraphicBuffer> mBuffer; // One instance that holds this native handle
         sp<Fence> mMergedFence;
         size_t mReleaseCount;
+        nsecs_t mAcquireTime; // When the buffer was acquired from the input
+    };
+
+    struct Output {
+        sp<IGraphicBufferProducer> queue;
+        OutputConfig config;
+        int outstandingBuffers = 0;
+        OutputStats stats = {};
+        nsecs_t totalLatency = 0;
+        uint64_t releasedFrames = 0;
     };
 
+    // Returns the index of output in mOutputs, or a negative value if it is
+    // not one of the outputs. This must be called with mMutex locked.
+    ssize_t indexOfOutputLocked(const sp<IGraphicBufferProducer>& output) const;
+
+    // Returns whether an output with DropPolicy::Block holds its maximum
+    // number of buffers. This must be called with mMutex locked.
+    bool isBlockedLocked() const;
+
+    // Detaches the next buffer released by the output at outputIndex, as
+    // described for onBufferReleasedByOutput. This must be called with mMutex
+    // locked.
+    void detachReleasedBufferLocked(size_t outputIndex);
+
+    // Counts one more output as done with the buffer, and releases it to the
+    // input once all of the outputs are. This must be called with mMutex
+    // locked.
+    void releaseBufferLocked(const sp<BufferTracker>& tracker);
+
     // Only called from createSplitter
     explicit StreamSplitter(const sp<IGraphicBufferConsumer>& inputQueue);
 
@@ -167,11 +249,10 @@ private:
     // communicate with it further.
     bool mIsAbandoned;
 
-    Mutex mMutex;
+    mutable Mutex mMutex;
     Condition mReleaseCondition;
-    int mOutstandingBuffers;
     sp<IGraphicBufferConsumer> mInput;
-    Vector<sp<IGraphicBufferProducer> > mOutputs;
+    Vector<Output> mOutputs;
 
     // Map of GraphicBuffer IDs (GraphicBuffer::getId()) to buffer tracking
     // objects (which are mostly for counting how many outputs have released the
@@ -31,6 +31,7 @@
 
 #include <shared_mutex>
 #include <unordered_set>
+#include <vector>
 
 namespace android {
 
@@ -335,6 +336,26 @@ public:
     static status_t attachAndQueueBufferWithDataspace(Surface* surface, sp<GraphicBuffer> buffer,
                                                       ui::Dataspace dataspace);
 
+    // Batched versions of dequeueBuffer, cancelBuffer and queueBuffer, for
+    // producers handling several buffers at a time which would otherwise make
+    // a round-trip to the consumer per buffer. dequeueBuffers dequeues as many
+    // buffers as the vector holds, and either dequeues all of them or none.
+    // These bypass the ANativeWindow interceptors, and are not supported in
+    // shared buffer mode.
+    struct BatchBuffer {
+        ANativeWindowBuffer* buffer = nullptr;
+        int fenceFd = -1;
+    };
+    virtual int dequeueBuffers(std::vector<BatchBuffer>* buffers);
+    virtual int cancelBuffers(const std::vector<BatchBuffer>& buffers);
+
+    struct BatchQueuedBuffer {
+        ANativeWindowBuffer* buffer = nullptr;
+        int fenceFd = -1;
+        nsecs_t timestamp = NATIVE_WINDOW_TIMESTAMP_AUTO;
+    };
+    virtual int queueBuffers(const std::vector<BatchQueuedBuffer>& buffers);
+
 protected:
     enum { NUM_BUFFER_SLOTS = BufferQueueDefs::NUM_BUFFER_SLOTS };
     enum { DEFAULT_FORMAT = PIXEL_FORMAT_RGBA_8888 };
@@ -364,6 +385,13 @@ protected:
     void freeAllBuffers();
     int getSlotFromBufferLocked(android_native_buffer_t* buffer) const;
 
+    void getDequeueBufferInputLocked(IGraphicBufferProducer::DequeueBufferInput* dequeueInput);
+    void getQueueBufferInputLocked(android_native_buffer_t* buffer, int fenceFd,
+                                   nsecs_t timestamp,
+                                   IGraphicBufferProducer::QueueBufferInput* out);
+    void onBufferQueuedLocked(int slot, sp<Fence> fence,
+                              const IGraphicBufferProducer::QueueBufferOutput& output);
+
     struct BufferSlot {
         sp<GraphicBuffer> buffer;
         Region dirtyRegion;
@@ -538,6 +566,9 @@ protected:
     // A cached copy of the FrameEventHistory maintained by the consumer.
     bool mEnableFrameTimestamps = false;
     std::unique_ptr<ProducerFrameEventHistory> mFrameEventHistory;
+    // The consumer's frame timestamps in shared memory, which are read before falling back to a
+    // getFrameTimestamps binder call. Null if the consumer doesn't publish them.
+    std::unique_ptr<gui::FrameTimestampsRing> mFrameTimestampsRing;
 
     bool mReportRemovedBuffers = false;
     std::vector<sp<GraphicBuffer>> mRemovedBuffers;
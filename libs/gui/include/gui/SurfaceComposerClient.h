@@ -614,6 +614,12 @@ public:
             const std::unordered_set<sp<IBinder>, ISurfaceComposer::SpHash<IBinder>>&
                     excludeHandles,
             float frameScale, sp<GraphicBuffer>* outBuffer);
+    // Renders into *inOutBuffer when it is set, or a newly allocated buffer otherwise, and
+    // returns without waiting for rendering to complete; outFence signals once it has.
+    static status_t captureLayersAsync(const sp<IBinder>& layerHandle, ui::Dataspace reqDataSpace,
+                                       ui::PixelFormat reqPixelFormat, const Rect& sourceCrop,
+                                       float frameScale, sp<GraphicBuffer>* inOutBuffer,
+                                       sp<Fence>* outFence);
 };
 
 // ---------------------------------------------------------------------------
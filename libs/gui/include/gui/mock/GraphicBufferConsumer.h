@@ -50,6 +50,7 @@ public:
     MOCK_METHOD2(getOccupancyHistory, status_t(bool, std::vector<OccupancyTracker::Segment>*));
     MOCK_METHOD0(discardFreeBuffers, status_t());
     MOCK_CONST_METHOD2(dumpState, status_t(const String8&, String8*));
+    MOCK_METHOD1(setAdaptiveBufferCount, status_t(bool));
 };
 
 } // namespace mock
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android-base/unique_fd.h>
+#include <gui/FrameTimestamps.h>
+#include <utils/Errors.h>
+#include <utils/Timers.h>
+
+#include <cstdint>
+#include <memory>
+
+namespace android {
+namespace gui {
+
+// A ring of the latest frames' consumer-side timestamps in shared memory. The consumer publishes
+// each frame's events as it records them, and the producer reads them without a binder call.
+// Fences cannot be shared this way, so their signal times are published once known, and until
+// then the producer falls back to FrameEventHistoryDelta. Producers map the ring read-only, and
+// read each frame under a seqlock.
+class FrameTimestampsRing {
+public:
+    static constexpr size_t kFrameCount = 8;
+
+    struct Frame {
+        uint64_t frameNumber = 0;
+        bool addPostCompositeCalled = false;
+        bool addReleaseCalled = false;
+        nsecs_t latchTime = FrameEvents::TIMESTAMP_PENDING;
+        nsecs_t firstRefreshStartTime = FrameEvents::TIMESTAMP_PENDING;
+        nsecs_t lastRefreshStartTime = FrameEvents::TIMESTAMP_PENDING;
+        nsecs_t dequeueReadyTime = FrameEvents::TIMESTAMP_PENDING;
+        // Fence::SIGNAL_TIME_PENDING until the fence is known to have signaled
+        nsecs_t gpuCompositionDoneTime = Fence::SIGNAL_TIME_PENDING;
+        nsecs_t displayPresentTime = Fence::SIGNAL_TIME_PENDING;
+        nsecs_t releaseTime = Fence::SIGNAL_TIME_PENDING;
+    };
+
+    ~FrameTimestampsRing();
+
+    FrameTimestampsRing(const FrameTimestampsRing&) = delete;
+    FrameTimestampsRing& operator=(const FrameTimestampsRing&) = delete;
+
+    // Creates the shared memory, which only the returned ring can write to. Returns nullptr if
+    // the memory cannot be allocated.
+    static std::unique_ptr<FrameTimestampsRing> create();
+
+    // Maps a ring shared by its writer read-only. Returns nullptr if fd is not a ring.
+    static std::unique_ptr<FrameTimestampsRing> map(base::unique_fd fd);
+
+    // Duplicates the file descriptor of the memory, e.g. to send it to the producer.
+    base::unique_fd dupFd() const;
+
+    // Publishes the consumer's events for a frame, replacing the oldest frame in the ring. Must
+    // only be called on the ring returned by create().
+    void publish(const FrameEvents& frame);
+    void publishCompositorTiming(const CompositorTiming& compositorTiming);
+
+    // Reads the events of a frame. Returns false if the frame is no longer in the ring, or if
+    // it is being written, in which case the caller should fall back to binder.
+    bool read(uint64_t frameNumber, Frame* outFrame) const;
+    bool readCompositorTiming(CompositorTiming* outCompositorTiming) const;
+
+private:
+    struct Page;
+
+    FrameTimestampsRing(base::unique_fd fd, Page* page, bool writable)
+          : mFd(std::move(fd)), mPage(page), mWritable(writable) {}
+
+    static Page* mapPage(int fd, bool writable);
+
+    const base::unique_fd mFd;
+    Page* const mPage;
+    const bool mWritable;
+};
+
+} // namespace gui
+} // namespace android
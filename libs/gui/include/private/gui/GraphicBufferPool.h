@@ -0,0 +1,87 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_GUI_GRAPHIC_BUFFER_POOL_H
+#define ANDROID_GUI_GRAPHIC_BUFFER_POOL_H
+
+#include <android-base/thread_annotations.h>
+#include <ui/Fence.h>
+#include <ui/GraphicBuffer.h>
+#include <utils/Singleton.h>
+#include <utils/StrongPointer.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+
+namespace android {
+
+// A process-wide pool of graphic buffers that BufferQueues no longer need, e.g. the buffers
+// replaced when a surface is resized, or those of a surface that disconnected. BufferQueues
+// whose producer is in the same process take buffers from the pool before allocating new ones,
+// which avoids gralloc allocations on resize animations and when windows are recreated.
+//
+// Buffers are never shared across processes: a buffer is only put into the pool by the process
+// that produced its contents. The pool holds at most getMaxBytes() bytes, evicting the least
+// recently pooled buffers first, and is disabled when that is 0.
+class GraphicBufferPool : public Singleton<GraphicBufferPool> {
+public:
+    size_t getMaxBytes() const;
+    size_t getPooledBytes() const;
+
+    // Sets the memory bound of the pool, evicting buffers until it is met.
+    void setMaxBytes(size_t maxBytes);
+
+    // Adds a buffer to the pool. Its contents may only be reused once fence has signaled.
+    void put(const sp<GraphicBuffer>& buffer, const sp<Fence>& fence);
+
+    // Removes and returns a buffer that can be used in place of allocating one with the given
+    // attributes, together with the fence to wait on before writing to it. Returns nullptr if
+    // the pool has no such buffer.
+    sp<GraphicBuffer> take(uint32_t width, uint32_t height, PixelFormat format,
+                           uint32_t layerCount, uint64_t usage, sp<Fence>* outFence);
+
+    // Frees all pooled buffers.
+    void clear();
+
+    // The number of bytes accounted for a buffer in the pool.
+    static size_t getBufferSize(const sp<GraphicBuffer>& buffer);
+
+private:
+    friend class Singleton<GraphicBufferPool>;
+    GraphicBufferPool();
+
+    struct PooledBuffer {
+        sp<GraphicBuffer> buffer;
+        sp<Fence> fence;
+        size_t size;
+    };
+
+    // Moves the least recently pooled buffers to outEvicted until the pool holds at most
+    // maxBytes, so that they are freed after the lock is released.
+    void evictLocked(size_t maxBytes, std::list<PooledBuffer>* outEvicted) REQUIRES(mMutex);
+
+    mutable std::mutex mMutex;
+    size_t mMaxBytes GUARDED_BY(mMutex);
+    size_t mPooledBytes GUARDED_BY(mMutex) = 0;
+    // The pooled buffers, from the most to the least recently pooled
+    std::list<PooledBuffer> mBuffers GUARDED_BY(mMutex);
+};
+
+} // namespace android
+
+#endif // ANDROID_GUI_GRAPHIC_BUFFER_POOL_H
@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android-base/unique_fd.h>
+#include <binder/Parcelable.h>
+#include <ui/PhysicalDisplayId.h>
+#include <utils/Errors.h>
+#include <utils/Timers.h>
+
+#include <cstdint>
+#include <memory>
+
+namespace android {
+
+class Parcel;
+
+namespace gui {
+
+// A page of shared memory holding the latest vsync of an EventThread. The EventThread writes it
+// once per vsync and wakes up every waiting receiver with a single futex wake, instead of
+// writing the vsync event to the BitTube of each receiver. Receivers map the page read-only,
+// and read it under a seqlock, so they can also check the latest vsync at any time.
+class VsyncTimeline : public Parcelable {
+public:
+    struct Vsync {
+        PhysicalDisplayId displayId = 0;
+        nsecs_t timestamp = 0;
+        uint32_t count = 0;
+        nsecs_t expectedVSyncTimestamp = 0;
+        nsecs_t deadlineTimestamp = 0;
+        nsecs_t expectedPresentTime = 0;
+    };
+
+    // creates an uninitialized VsyncTimeline (to unparcel into)
+    VsyncTimeline() = default;
+    ~VsyncTimeline() override;
+
+    VsyncTimeline(const VsyncTimeline&) = delete;
+    VsyncTimeline& operator=(const VsyncTimeline&) = delete;
+
+    // Creates the shared memory, which only the returned timeline can write to. Returns
+    // nullptr if the memory cannot be allocated.
+    static std::unique_ptr<VsyncTimeline> create();
+
+    bool isValid() const { return mPage != nullptr; }
+
+    // Maps the timeline read-only into outTimeline, e.g. to send it to a receiver, along with
+    // the receiver's wake fd if it has one.
+    status_t share(VsyncTimeline* outTimeline, base::unique_fd wakeFd = {}) const;
+
+    // Publishes a vsync and wakes up the receivers waiting for it. Must only be called on the
+    // timeline returned by create().
+    void publish(const Vsync& vsync);
+
+    // Reads the latest vsync into outVsync, and returns its sequence number, which increases
+    // with each vsync. Returns 0 if no vsync was published yet.
+    uint32_t read(Vsync* outVsync) const;
+
+    // Waits for a vsync to be published after the one with the given sequence number. Returns
+    // false on timeout.
+    bool wait(uint32_t sequence, nsecs_t timeout) const;
+
+    // Returns the eventfd signaled for each vsync published for this receiver, which can be
+    // polled instead of waiting with wait(), or -1 if the receiver has none. However many
+    // vsyncs were published since the last consumeWake(), the fd only polls readable once.
+    int getWakeFd() const { return mWakeFd.get(); }
+
+    // Resets the wake fd, returning whether a vsync was published since the last call.
+    bool consumeWake() const;
+
+    status_t writeToParcel(Parcel* parcel) const override;
+    status_t readFromParcel(const Parcel* parcel) override;
+
+private:
+    struct Page;
+
+    status_t map(base::unique_fd fd, bool writable);
+
+    base::unique_fd mFd;
+    base::unique_fd mWakeFd;
+    Page* mPage = nullptr;
+    bool mWritable = false;
+};
+
+} // namespace gui
+} // namespace android
@@ -68,6 +68,14 @@ public:
         return mBlastBufferQueueAdapter->mSurfaceControl;
     }
 
+    status_t setFrameDropping(bool enabled, int maxTransactionsInFlight) {
+        return mBlastBufferQueueAdapter->setFrameDropping(enabled, maxTransactionsInFlight);
+    }
+
+    BLASTBufferQueue::FrameStats getFrameStats() {
+        return mBlastBufferQueueAdapter->getFrameStats();
+    }
+
     void waitForCallbacks() {
         std::unique_lock lock{mBlastBufferQueueAdapter->mMutex};
         while (mBlastBufferQueueAdapter->mSubmitted.size() > 0) {
@@ -350,6 +358,41 @@ TEST_F(BLASTBufferQueueTest, TripleBuffering) {
     adapter.waitForCallbacks();
 }
 
+TEST_F(BLASTBufferQueueTest, FrameDropping) {
+    BLASTBufferQueueHelper adapter(mSurfaceControl, mDisplayWidth, mDisplayHeight);
+    sp<IGraphicBufferProducer> igbProducer;
+    setUpProducer(adapter, igbProducer);
+    ASSERT_EQ(NO_ERROR, adapter.setFrameDropping(true, 2));
+
+    constexpr int kFrameCount = 100;
+    for (int i = 0; i < kFrameCount; i++) {
+        int slot;
+        sp<Fence> fence;
+        sp<GraphicBuffer> buf;
+        auto ret = igbProducer->dequeueBuffer(&slot, &fence, mDisplayWidth, mDisplayHeight,
+                                              PIXEL_FORMAT_RGBA_8888, GRALLOC_USAGE_SW_WRITE_OFTEN,
+                                              nullptr, nullptr);
+        if (ret == IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION) {
+            ASSERT_EQ(OK, igbProducer->requestBuffer(slot, &buf));
+        } else {
+            ASSERT_EQ(NO_ERROR, ret);
+        }
+        IGraphicBufferProducer::QueueBufferOutput qbOutput;
+        IGraphicBufferProducer::QueueBufferInput input(systemTime(), false, HAL_DATASPACE_UNKNOWN,
+                                                       Rect(mDisplayWidth, mDisplayHeight),
+                                                       NATIVE_WINDOW_SCALING_MODE_FREEZE, 0,
+                                                       Fence::NO_FENCE);
+        ASSERT_EQ(NO_ERROR, igbProducer->queueBuffer(slot, input, &qbOutput));
+    }
+    adapter.waitForCallbacks();
+
+    // Every frame is either presented or dropped in favor of a newer one, and the last frame is
+    // always presented.
+    const BLASTBufferQueue::FrameStats stats = adapter.getFrameStats();
+    EXPECT_GE(stats.presentedFrames, 1u);
+    EXPECT_EQ(static_cast<uint64_t>(kFrameCount), stats.presentedFrames + stats.droppedFrames);
+}
+
 TEST_F(BLASTBufferQueueTest, SetCrop_Item) {
     uint8_t r = 255;
     uint8_t g = 0;
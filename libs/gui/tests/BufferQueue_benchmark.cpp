@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <gui/BufferItem.h>
+#include <gui/BufferQueue.h>
+#include <gui/IProducerListener.h>
+#include <ui/GraphicBuffer.h>
+
+#include <vector>
+
+#include "MockConsumer.h"
+
+// Usage: atest BufferQueue_benchmark
+
+namespace android {
+namespace {
+
+// Runs frames through a local BufferQueue with 'state.range(0)' buffers in flight, so that the
+// cost measured is that of the slot bookkeeping rather than of binder or buffer allocation.
+void BM_dequeueQueueAcquireRelease(benchmark::State& state) {
+    const int buffersInFlight = static_cast<int>(state.range(0));
+
+    sp<IGraphicBufferProducer> producer;
+    sp<IGraphicBufferConsumer> consumer;
+    BufferQueue::createBufferQueue(&producer, &consumer);
+    consumer->consumerConnect(new MockConsumer, false);
+    consumer->setMaxAcquiredBufferCount(buffersInFlight);
+    IGraphicBufferProducer::QueueBufferOutput output;
+    producer->connect(new StubProducerListener, NATIVE_WINDOW_API_CPU, false, &output);
+    producer->setMaxDequeuedBufferCount(buffersInFlight);
+
+    const IGraphicBufferProducer::QueueBufferInput input(0, false, HAL_DATASPACE_UNKNOWN,
+                                                         Rect(0, 0, 1, 1),
+                                                         NATIVE_WINDOW_SCALING_MODE_FREEZE, 0,
+                                                         Fence::NO_FENCE);
+    std::vector<int> slots(buffersInFlight);
+    BufferItem item;
+    sp<Fence> fence;
+    sp<GraphicBuffer> buffer;
+
+    for (auto _ : state) {
+        for (int& slot : slots) {
+            const status_t result =
+                    producer->dequeueBuffer(&slot, &fence, 1, 1, PIXEL_FORMAT_RGBA_8888,
+                                            GRALLOC_USAGE_SW_READ_OFTEN, nullptr, nullptr);
+            if (result == IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION) {
+                producer->requestBuffer(slot, &buffer);
+            } else if (result != NO_ERROR) {
+                state.SkipWithError("dequeueBuffer failed");
+                return;
+            }
+        }
+        for (int slot : slots) {
+            producer->queueBuffer(slot, input, &output);
+        }
+        for (int i = 0; i < buffersInFlight; i++) {
+            if (consumer->acquireBuffer(&item, 0) != NO_ERROR) {
+                state.SkipWithError("acquireBuffer failed");
+                return;
+            }
+            consumer->releaseHelper(item.mSlot, item.mFrameNumber, Fence::NO_FENCE);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * buffersInFlight);
+
+    producer->disconnect(NATIVE_WINDOW_API_CPU);
+    consumer->consumerDisconnect();
+}
+BENCHMARK(BM_dequeueQueueAcquireRelease)->Arg(1)->Arg(3)->Arg(8);
+
+} // namespace
+} // namespace android
+
+BENCHMARK_MAIN();
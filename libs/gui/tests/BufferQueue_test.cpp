@@ -22,6 +22,7 @@
 #include <gui/BufferItem.h>
 #include <gui/BufferQueue.h>
 #include <gui/IProducerListener.h>
+#include <private/gui/GraphicBufferPool.h>
 
 #include <ui/GraphicBuffer.h>
 
@@ -1110,6 +1111,51 @@ TEST_F(BufferQueueTest, TestDiscardFreeBuffers) {
     }
 }
 
+TEST_F(BufferQueueTest, TestAdaptiveBufferCount) {
+    createBufferQueue();
+    sp<MockConsumer> mc(new MockConsumer);
+    ASSERT_EQ(OK, mConsumer->consumerConnect(mc, false));
+    IGraphicBufferProducer::QueueBufferOutput output;
+    ASSERT_EQ(OK,
+              mProducer->connect(new StubProducerListener, NATIVE_WINDOW_API_CPU, false, &output));
+    ASSERT_EQ(OK, mProducer->setMaxDequeuedBufferCount(2));
+    ASSERT_EQ(OK, mConsumer->setAdaptiveBufferCount(true));
+
+    // A producer that never waits for buffers keeps the count it requested
+    IGraphicBufferProducer::QueueBufferInput input(0ull, true, HAL_DATASPACE_UNKNOWN,
+                                                   Rect(0, 0, 1, 1),
+                                                   NATIVE_WINDOW_SCALING_MODE_FREEZE, 0,
+                                                   Fence::NO_FENCE);
+    for (int i = 0; i < 120; i++) {
+        int slot;
+        sp<Fence> fence;
+        sp<GraphicBuffer> buffer;
+        status_t result = mProducer->dequeueBuffer(&slot, &fence, 0, 0, 0,
+                                                   GRALLOC_USAGE_SW_READ_OFTEN, nullptr, nullptr);
+        ASSERT_EQ(OK, result & ~IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION);
+        ASSERT_EQ(OK, mProducer->requestBuffer(slot, &buffer));
+        ASSERT_EQ(OK, mProducer->queueBuffer(slot, input, &output));
+        BufferItem item;
+        ASSERT_EQ(OK, mConsumer->acquireBuffer(&item, 0));
+        ASSERT_EQ(OK,
+                  mConsumer->releaseBuffer(item.mSlot, item.mFrameNumber, EGL_NO_DISPLAY,
+                                           EGL_NO_SYNC_KHR, Fence::NO_FENCE));
+    }
+
+    String8 dumpString;
+    mConsumer->dumpState(String8{}, &dumpString);
+    EXPECT_NE(-1, dumpString.find("adaptive-buffer-count=1 requested-max-dequeued=2"));
+    EXPECT_EQ(-1, dumpString.find("ago: max-dequeued"));
+
+    ASSERT_EQ(OK, mConsumer->setAdaptiveBufferCount(false));
+    dumpString.clear();
+    mConsumer->dumpState(String8{}, &dumpString);
+    EXPECT_EQ(-1, dumpString.find("adaptive-buffer-count="));
+
+    ASSERT_EQ(OK, mConsumer->consumerDisconnect());
+    EXPECT_EQ(NO_INIT, mConsumer->setAdaptiveBufferCount(true));
+}
+
 TEST_F(BufferQueueTest, TestBufferReplacedInQueueBuffer) {
     createBufferQueue();
     sp<MockConsumer> mc(new MockConsumer);
@@ -1224,4 +1270,65 @@ TEST_F(BufferQueueTest, TestProducerConnectDisconnect) {
     ASSERT_EQ(NO_INIT, mProducer->disconnect(NATIVE_WINDOW_API_CPU));
 }
 
+TEST_F(BufferQueueTest, TestResizeReusesPooledBuffers) {
+    GraphicBufferPool& pool = GraphicBufferPool::getInstance();
+    const size_t maxBytes = pool.getMaxBytes();
+    pool.clear();
+    pool.setMaxBytes(16 * 1024 * 1024);
+
+    createBufferQueue();
+    sp<MockConsumer> mc(new MockConsumer);
+    ASSERT_EQ(OK, mConsumer->consumerConnect(mc, true));
+    IGraphicBufferProducer::QueueBufferOutput output;
+    ASSERT_EQ(OK,
+              mProducer->connect(new StubProducerListener, NATIVE_WINDOW_API_CPU, true, &output));
+
+    static const uint32_t WIDTH = 320;
+    static const uint32_t HEIGHT = 240;
+
+    int slot;
+    sp<Fence> fence;
+    sp<GraphicBuffer> buffer;
+    ASSERT_EQ(IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION,
+              mProducer->dequeueBuffer(&slot, &fence, WIDTH, HEIGHT, 0,
+                                       GRALLOC_USAGE_SW_WRITE_OFTEN, nullptr, nullptr));
+    ASSERT_EQ(OK, mProducer->requestBuffer(slot, &buffer));
+    const uint64_t smallBufferId = buffer->getId();
+    ASSERT_EQ(OK, mProducer->cancelBuffer(slot, fence));
+
+    // Resizing replaces the buffer, which goes to the pool
+    ASSERT_EQ(IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION,
+              mProducer->dequeueBuffer(&slot, &fence, WIDTH * 2, HEIGHT * 2, 0,
+                                       GRALLOC_USAGE_SW_WRITE_OFTEN, nullptr, nullptr));
+    ASSERT_EQ(OK, mProducer->requestBuffer(slot, &buffer));
+    EXPECT_NE(smallBufferId, buffer->getId());
+    const uint64_t largeBufferId = buffer->getId();
+    ASSERT_EQ(OK, mProducer->cancelBuffer(slot, fence));
+
+    // Resizing back reuses the pooled buffer instead of allocating
+    ASSERT_EQ(IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION,
+              mProducer->dequeueBuffer(&slot, &fence, WIDTH, HEIGHT, 0,
+                                       GRALLOC_USAGE_SW_WRITE_OFTEN, nullptr, nullptr));
+    ASSERT_EQ(OK, mProducer->requestBuffer(slot, &buffer));
+    EXPECT_EQ(smallBufferId, buffer->getId());
+    ASSERT_EQ(OK, mProducer->cancelBuffer(slot, fence));
+
+    // Buffers of a disconnected producer are pooled for the next one
+    ASSERT_EQ(OK, mProducer->disconnect(NATIVE_WINDOW_API_CPU));
+    EXPECT_GE(pool.getPooledBytes(), 2 * WIDTH * HEIGHT * 4);
+    ASSERT_EQ(OK,
+              mProducer->connect(new StubProducerListener, NATIVE_WINDOW_API_CPU, true, &output));
+    ASSERT_EQ(IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION,
+              mProducer->dequeueBuffer(&slot, &fence, WIDTH * 2, HEIGHT * 2, 0,
+                                       GRALLOC_USAGE_SW_WRITE_OFTEN, nullptr, nullptr));
+    ASSERT_EQ(OK, mProducer->requestBuffer(slot, &buffer));
+    EXPECT_EQ(largeBufferId, buffer->getId());
+    ASSERT_EQ(OK, mProducer->cancelBuffer(slot, fence));
+
+    // The pool never holds more than its bound
+    pool.setMaxBytes(0);
+    EXPECT_EQ(0u, pool.getPooledBytes());
+    pool.setMaxBytes(maxBytes);
+}
+
 } // namespace android
@@ -565,6 +565,48 @@ TEST_P(CpuConsumerTest, FromCpuSingle) {
     mCC->unlockBuffer(b);
 }
 
+TEST_P(CpuConsumerTest, FromCpuPersistentMapping) {
+    status_t err;
+    CpuConsumerTestParams params = GetParam();
+
+    // Set up
+
+    ASSERT_NO_FATAL_FAILURE(configureANW(mANW, params, 1));
+    mCC->setPersistentMapping(true);
+
+    // Produce and consume more frames than there are buffers, so that the
+    // mapped buffers are reused
+
+    const int numFrames = 8;
+    for (int i = 0; i < numFrames; i++) {
+        const int64_t time = 1000L + i;
+        uint32_t stride;
+        ASSERT_NO_FATAL_FAILURE(produceOneFrame(mANW, params, time, &stride));
+
+        CpuConsumer::LockedBuffer b;
+        sp<Fence> fence;
+        err = mCC->lockNextBuffer(&b, &fence);
+        if (err == WOULD_BLOCK) {
+            ASSERT_EQ(NO_ERROR, fence->wait(Fence::TIMEOUT_NEVER));
+            err = mCC->lockNextBuffer(&b, &fence);
+        }
+        ASSERT_NO_ERROR(err, "getNextBuffer error: ");
+        EXPECT_FALSE(fence->isValid());
+
+        ASSERT_TRUE(b.data != nullptr);
+        EXPECT_EQ(params.width,  b.width);
+        EXPECT_EQ(params.height, b.height);
+        EXPECT_EQ(params.format, b.format);
+        EXPECT_EQ(stride, b.stride);
+        EXPECT_EQ(time, b.timestamp);
+
+        checkAnyBuffer(b, GetParam().format);
+        mCC->unlockBuffer(b);
+    }
+
+    mCC->setPersistentMapping(false);
+}
+
 // This test is disabled because the HAL_PIXEL_FORMAT_RAW16 format is not
 // supported on all devices.
 TEST_P(CpuConsumerTest, FromCpuManyInQueue) {
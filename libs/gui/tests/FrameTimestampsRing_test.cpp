@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "FrameTimestampsRing_test"
+
+#include <private/gui/FrameTimestampsRing.h>
+
+#include <gui/FrameTimestamps.h>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+namespace android {
+
+using gui::FrameTimestampsRing;
+
+class FrameTimestampsRingTest : public ::testing::Test {
+protected:
+    void queueFrame(uint64_t frameNumber) {
+        NewFrameEventsEntry entry;
+        entry.frameNumber = frameNumber;
+        mConsumer.addQueue(entry);
+    }
+
+    std::unique_ptr<FrameTimestampsRing> shareRing() {
+        base::unique_fd fd;
+        EXPECT_EQ(NO_ERROR, mConsumer.shareTimestamps(&fd));
+        return FrameTimestampsRing::map(std::move(fd));
+    }
+
+    ConsumerFrameEventHistory mConsumer;
+};
+
+TEST_F(FrameTimestampsRingTest, PublishesConsumerEvents) {
+    auto ring = shareRing();
+    ASSERT_NE(nullptr, ring);
+
+    queueFrame(1);
+    mConsumer.addLatch(1, 100);
+    mConsumer.addPreComposition(1, 110);
+    CompositorTiming timing{200, 16, 32};
+    mConsumer.addPostComposition(1, FenceTime::NO_FENCE, std::make_shared<FenceTime>(150),
+                                 timing);
+
+    FrameTimestampsRing::Frame frame;
+    ASSERT_TRUE(ring->read(1, &frame));
+    EXPECT_EQ(100, frame.latchTime);
+    EXPECT_EQ(110, frame.firstRefreshStartTime);
+    EXPECT_EQ(110, frame.lastRefreshStartTime);
+    EXPECT_TRUE(frame.addPostCompositeCalled);
+    EXPECT_EQ(Fence::SIGNAL_TIME_INVALID, frame.gpuCompositionDoneTime);
+    EXPECT_EQ(150, frame.displayPresentTime);
+    EXPECT_FALSE(frame.addReleaseCalled);
+
+    CompositorTiming readTiming;
+    ASSERT_TRUE(ring->readCompositorTiming(&readTiming));
+    EXPECT_EQ(timing.deadline, readTiming.deadline);
+    EXPECT_EQ(timing.interval, readTiming.interval);
+    EXPECT_EQ(timing.presentLatency, readTiming.presentLatency);
+}
+
+TEST_F(FrameTimestampsRingTest, PublishesRelease) {
+    auto ring = shareRing();
+    ASSERT_NE(nullptr, ring);
+
+    queueFrame(1);
+    mConsumer.addRelease(1, 120, std::make_shared<FenceTime>(130));
+
+    FrameTimestampsRing::Frame frame;
+    ASSERT_TRUE(ring->read(1, &frame));
+    EXPECT_TRUE(frame.addReleaseCalled);
+    EXPECT_EQ(120, frame.dequeueReadyTime);
+    EXPECT_EQ(130, frame.releaseTime);
+    EXPECT_EQ(FrameEvents::TIMESTAMP_PENDING, frame.latchTime);
+}
+
+TEST_F(FrameTimestampsRingTest, OldFramesAreReplaced) {
+    auto ring = shareRing();
+    ASSERT_NE(nullptr, ring);
+
+    for (uint64_t frameNumber = 1; frameNumber <= FrameTimestampsRing::kFrameCount + 1;
+         frameNumber++) {
+        queueFrame(frameNumber);
+        mConsumer.addLatch(frameNumber, static_cast<nsecs_t>(frameNumber));
+    }
+
+    FrameTimestampsRing::Frame frame;
+    EXPECT_FALSE(ring->read(1, &frame));
+    ASSERT_TRUE(ring->read(FrameTimestampsRing::kFrameCount + 1, &frame));
+    EXPECT_EQ(static_cast<nsecs_t>(FrameTimestampsRing::kFrameCount + 1), frame.latchTime);
+}
+
+TEST_F(FrameTimestampsRingTest, RingIsReadOnlyForTheProducer) {
+    base::unique_fd fd;
+    ASSERT_EQ(NO_ERROR, mConsumer.shareTimestamps(&fd));
+    EXPECT_EQ(MAP_FAILED,
+              mmap(nullptr, getpagesize(), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+}
+
+} // namespace android
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <binder/Parcel.h>
+#include <gui/LayerState.h>
+
+// Usage: atest LayerState_benchmark
+
+namespace android {
+namespace {
+
+ComposerState makePositionAlphaState() {
+    ComposerState state;
+    state.state.what = layer_state_t::ePositionChanged | layer_state_t::eAlphaChanged;
+    state.state.x = 100.0f;
+    state.state.y = 200.0f;
+    state.state.alpha = 0.5f;
+    return state;
+}
+
+ComposerState makeGeometryState() {
+    ComposerState state;
+    state.state.what = layer_state_t::ePositionChanged | layer_state_t::eLayerChanged |
+            layer_state_t::eMatrixChanged | layer_state_t::eCropChanged |
+            layer_state_t::eTransparentRegionChanged | layer_state_t::eCornerRadiusChanged;
+    state.state.x = 100.0f;
+    state.state.y = 200.0f;
+    state.state.z = 3;
+    state.state.matrix = {0.5f, 0.0f, 0.0f, 0.5f};
+    state.state.crop = Rect(0, 0, 640, 480);
+    state.state.transparentRegion = Region(Rect(0, 0, 64, 64));
+    state.state.cornerRadius = 8.0f;
+    return state;
+}
+
+// Writes and reads back a transaction of 'state.range(0)' layer states, as
+// SurfaceComposerClient::Transaction::apply and SurfaceFlinger do.
+void runWriteRead(benchmark::State& state, const ComposerState& layerState) {
+    const int layerCount = static_cast<int>(state.range(0));
+    Parcel parcel;
+    size_t bytes = 0;
+    for (auto _ : state) {
+        parcel.setDataPosition(0);
+        parcel.setDataSize(0);
+        for (int i = 0; i < layerCount; i++) {
+            layerState.write(parcel);
+        }
+        bytes = parcel.dataSize();
+
+        parcel.setDataPosition(0);
+        for (int i = 0; i < layerCount; i++) {
+            ComposerState readState;
+            readState.read(parcel);
+            benchmark::DoNotOptimize(readState);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * layerCount);
+    state.counters["bytes_per_layer"] = static_cast<double>(bytes) / layerCount;
+}
+
+void BM_positionAlphaWriteRead(benchmark::State& state) {
+    runWriteRead(state, makePositionAlphaState());
+}
+BENCHMARK(BM_positionAlphaWriteRead)->Arg(1)->Arg(16)->Arg(64);
+
+void BM_geometryWriteRead(benchmark::State& state) {
+    runWriteRead(state, makeGeometryState());
+}
+BENCHMARK(BM_geometryWriteRead)->Arg(1)->Arg(16)->Arg(64);
+
+} // namespace
+} // namespace android
+
+BENCHMARK_MAIN();
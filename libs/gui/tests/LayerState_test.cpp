@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "LayerState_test"
+
+#include <gtest/gtest.h>
+
+#include <binder/Parcel.h>
+#include <gui/LayerState.h>
+
+namespace android {
+
+TEST(LayerStateTest, WritesOnlyChangedFields) {
+    ComposerState state;
+    state.state.what = layer_state_t::ePositionChanged | layer_state_t::eAlphaChanged;
+    state.state.x = 10.0f;
+    state.state.y = 20.0f;
+    state.state.alpha = 0.5f;
+    state.state.cornerRadius = 4.0f;
+    state.state.crop = Rect(0, 0, 16, 16);
+
+    Parcel parcel;
+    ASSERT_EQ(NO_ERROR, state.write(parcel));
+    // The surface handle and 'what' header, then x, y and alpha.
+    EXPECT_GE(64u, parcel.dataSize());
+
+    parcel.setDataPosition(0);
+    ComposerState readState;
+    ASSERT_EQ(NO_ERROR, readState.read(parcel));
+    EXPECT_EQ(parcel.dataSize(), parcel.dataPosition());
+    EXPECT_EQ(state.state.what, readState.state.what);
+    EXPECT_EQ(10.0f, readState.state.x);
+    EXPECT_EQ(20.0f, readState.state.y);
+    EXPECT_EQ(0.5f, readState.state.alpha);
+    EXPECT_EQ(0.0f, readState.state.cornerRadius);
+    EXPECT_EQ(Rect::INVALID_RECT, readState.state.crop);
+}
+
+TEST(LayerStateTest, RoundTripsChangedFields) {
+    ComposerState state;
+    state.state.what = layer_state_t::eRelativeLayerChanged | layer_state_t::eMatrixChanged |
+            layer_state_t::eFlagsChanged | layer_state_t::eTransparentRegionChanged |
+            layer_state_t::eBackgroundColorChanged | layer_state_t::eColorTransformChanged |
+            layer_state_t::eFrameRateChanged;
+    state.state.z = -2;
+    state.state.matrix = {0.0f, 1.0f, -1.0f, 0.0f};
+    state.state.flags = layer_state_t::eLayerOpaque;
+    state.state.mask = layer_state_t::eLayerOpaque | layer_state_t::eLayerHidden;
+    state.state.transparentRegion = Region(Rect(0, 0, 8, 8));
+    state.state.color = half3(0.25f, 0.5f, 0.75f);
+    state.state.bgColorAlpha = 0.5f;
+    state.state.bgColorDataspace = ui::Dataspace::SRGB;
+    state.state.colorTransform = mat4::scale(vec4(0.5f, 0.5f, 0.5f, 1.0f));
+    state.state.frameRate = 60.0f;
+    state.state.frameRateCompatibility = ANATIVEWINDOW_FRAME_RATE_COMPATIBILITY_FIXED_SOURCE;
+
+    Parcel parcel;
+    ASSERT_EQ(NO_ERROR, state.write(parcel));
+    parcel.setDataPosition(0);
+    ComposerState readState;
+    ASSERT_EQ(NO_ERROR, readState.read(parcel));
+    EXPECT_EQ(parcel.dataSize(), parcel.dataPosition());
+
+    const layer_state_t& s = readState.state;
+    EXPECT_EQ(state.state.what, s.what);
+    EXPECT_EQ(-2, s.z);
+    EXPECT_EQ(1.0f, s.matrix.dtdx);
+    EXPECT_EQ(-1.0f, s.matrix.dtdy);
+    EXPECT_EQ(state.state.flags, s.flags);
+    EXPECT_EQ(state.state.mask, s.mask);
+    EXPECT_EQ(Rect(0, 0, 8, 8), s.transparentRegion.getBounds());
+    EXPECT_EQ(state.state.color, s.color);
+    EXPECT_EQ(0.5f, s.bgColorAlpha);
+    EXPECT_EQ(ui::Dataspace::SRGB, s.bgColorDataspace);
+    EXPECT_EQ(state.state.colorTransform, s.colorTransform);
+    EXPECT_EQ(60.0f, s.frameRate);
+    EXPECT_EQ(ANATIVEWINDOW_FRAME_RATE_COMPATIBILITY_FIXED_SOURCE, s.frameRateCompatibility);
+}
+
+} // namespace android
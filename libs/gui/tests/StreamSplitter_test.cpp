@@ -196,6 +196,75 @@ TEST_F(StreamSplitterTest, OneInputMultipleOutputs) {
                                            nullptr, nullptr));
 }
 
+TEST_F(StreamSplitterTest, SlowOutputDropsFrames) {
+    sp<IGraphicBufferProducer> inputProducer;
+    sp<IGraphicBufferConsumer> inputConsumer;
+    BufferQueue::createBufferQueue(&inputProducer, &inputConsumer);
+
+    sp<IGraphicBufferProducer> fastProducer;
+    sp<IGraphicBufferConsumer> fastConsumer;
+    BufferQueue::createBufferQueue(&fastProducer, &fastConsumer);
+    ASSERT_EQ(OK, fastConsumer->consumerConnect(new FakeListener, false));
+
+    sp<IGraphicBufferProducer> slowProducer;
+    sp<IGraphicBufferConsumer> slowConsumer;
+    BufferQueue::createBufferQueue(&slowProducer, &slowConsumer);
+    ASSERT_EQ(OK, slowConsumer->consumerConnect(new FakeListener, false));
+
+    sp<StreamSplitter> splitter;
+    status_t status = StreamSplitter::createSplitter(inputConsumer, &splitter);
+    ASSERT_EQ(OK, status);
+    ASSERT_EQ(OK, splitter->addOutput(fastProducer));
+    ASSERT_EQ(OK, splitter->addOutput(slowProducer,
+            {1, StreamSplitter::DropPolicy::DropNewest}));
+
+    IGraphicBufferProducer::QueueBufferOutput qbOutput;
+    ASSERT_EQ(OK,
+              inputProducer->connect(new StubProducerListener, NATIVE_WINDOW_API_CPU, false,
+                                     &qbOutput));
+
+    IGraphicBufferProducer::QueueBufferInput qbInput(0, false,
+            HAL_DATASPACE_UNKNOWN, Rect(0, 0, 1, 1),
+            NATIVE_WINDOW_SCALING_MODE_FREEZE, 0, Fence::NO_FENCE);
+
+    // The slow output never releases its buffer, but the fast output still
+    // receives every frame
+    const int NUM_FRAMES = 3;
+    for (int frame = 0; frame < NUM_FRAMES; ++frame) {
+        int slot;
+        sp<Fence> fence;
+        sp<GraphicBuffer> buffer;
+        ASSERT_LE(0, inputProducer->dequeueBuffer(&slot, &fence, 0, 0, 0,
+                GRALLOC_USAGE_SW_WRITE_OFTEN, nullptr, nullptr));
+        ASSERT_EQ(OK, inputProducer->requestBuffer(slot, &buffer));
+        ASSERT_EQ(OK, inputProducer->queueBuffer(slot, qbInput, &qbOutput));
+
+        BufferItem item;
+        ASSERT_EQ(OK, fastConsumer->acquireBuffer(&item, 0));
+        ASSERT_EQ(OK, fastConsumer->releaseBuffer(item.mSlot,
+                    item.mFrameNumber, EGL_NO_DISPLAY, EGL_NO_SYNC_KHR,
+                    Fence::NO_FENCE));
+    }
+
+    StreamSplitter::OutputStats stats;
+    ASSERT_EQ(OK, splitter->getOutputStats(fastProducer, &stats));
+    EXPECT_EQ(static_cast<uint64_t>(NUM_FRAMES), stats.queuedFrames);
+    EXPECT_EQ(0u, stats.droppedFrames);
+    EXPECT_LE(0, stats.averageLatency);
+    EXPECT_LE(stats.averageLatency, stats.maxLatency);
+
+    ASSERT_EQ(OK, splitter->getOutputStats(slowProducer, &stats));
+    EXPECT_EQ(1u, stats.queuedFrames);
+    EXPECT_EQ(static_cast<uint64_t>(NUM_FRAMES - 1), stats.droppedFrames);
+
+    BufferItem item;
+    ASSERT_EQ(OK, slowConsumer->acquireBuffer(&item, 0));
+    ASSERT_EQ(OK, slowConsumer->releaseBuffer(item.mSlot, item.mFrameNumber,
+                EGL_NO_DISPLAY, EGL_NO_SYNC_KHR, Fence::NO_FENCE));
+
+    ASSERT_EQ(BAD_VALUE, splitter->getOutputStats(inputProducer, &stats));
+}
+
 TEST_F(StreamSplitterTest, OutputAbandonment) {
     sp<IGraphicBufferProducer> inputProducer;
     sp<IGraphicBufferConsumer> inputConsumer;
@@ -34,6 +34,7 @@
 #include <ui/Rect.h>
 #include <utils/String8.h>
 
+#include <algorithm>
 #include <limits>
 #include <thread>
 
@@ -773,6 +774,16 @@ public:
             float /*frameScale*/, bool /*childrenOnly*/) override {
         return NO_ERROR;
     }
+    status_t captureLayersAsync(
+            const sp<IBinder>& /*parentHandle*/, const sp<GraphicBuffer>& /*buffer*/,
+            ui::Dataspace /*reqDataspace*/, ui::PixelFormat /*reqPixelFormat*/,
+            const Rect& /*sourceCrop*/,
+            const std::unordered_set<sp<IBinder>,
+                                     ISurfaceComposer::SpHash<IBinder>>& /*excludeHandles*/,
+            float /*frameScale*/, bool /*childrenOnly*/, sp<GraphicBuffer>* /*outBuffer*/,
+            sp<Fence>* /*outFence*/) override {
+        return NO_ERROR;
+    }
     status_t clearAnimationFrameStats() override { return NO_ERROR; }
     status_t getAnimationFrameStats(FrameStats* /*outStats*/) const override {
         return NO_ERROR;
@@ -1999,4 +2010,48 @@ TEST_F(SurfaceTest, DefaultMaxBufferCountSetAndUpdated) {
     EXPECT_EQ(BufferQueueDefs::NUM_BUFFER_SLOTS, count);
 }
 
+TEST_F(SurfaceTest, BatchOperations) {
+    const int BUFFER_COUNT = 3;
+    sp<IGraphicBufferProducer> producer;
+    sp<IGraphicBufferConsumer> consumer;
+    BufferQueue::createBufferQueue(&producer, &consumer);
+
+    sp<MockConsumer> mockConsumer(new MockConsumer);
+    consumer->consumerConnect(mockConsumer, false);
+
+    sp<Surface> surface = new Surface(producer);
+    sp<ANativeWindow> window(surface);
+
+    ASSERT_EQ(NO_ERROR, native_window_api_connect(window.get(), NATIVE_WINDOW_API_CPU));
+    ASSERT_EQ(NO_ERROR, surface->setMaxDequeuedBufferCount(BUFFER_COUNT));
+
+    std::vector<Surface::BatchBuffer> buffers(BUFFER_COUNT);
+    ASSERT_EQ(NO_ERROR, surface->dequeueBuffers(&buffers));
+    for (const auto& buffer : buffers) {
+        EXPECT_NE(nullptr, buffer.buffer);
+    }
+    ASSERT_EQ(NO_ERROR, surface->cancelBuffers(buffers));
+
+    // The canceled buffers are dequeued again, without being reallocated.
+    std::vector<Surface::BatchBuffer> dequeued(BUFFER_COUNT);
+    ASSERT_EQ(NO_ERROR, surface->dequeueBuffers(&dequeued));
+    std::vector<Surface::BatchQueuedBuffer> queued(BUFFER_COUNT);
+    for (int i = 0; i < BUFFER_COUNT; i++) {
+        queued[i].buffer = dequeued[i].buffer;
+        queued[i].fenceFd = dequeued[i].fenceFd;
+        EXPECT_NE(buffers.end(),
+                  std::find_if(buffers.begin(), buffers.end(), [&](const auto& buffer) {
+                      return buffer.buffer == dequeued[i].buffer;
+                  }));
+    }
+    ASSERT_EQ(NO_ERROR, surface->queueBuffers(queued));
+
+    // Buffers which are not dequeued cannot be queued again.
+    queued.resize(1);
+    queued[0].fenceFd = -1;
+    EXPECT_NE(NO_ERROR, surface->queueBuffers(queued));
+
+    ASSERT_EQ(NO_ERROR, native_window_api_disconnect(window.get(), NATIVE_WINDOW_API_CPU));
+}
+
 } // namespace android
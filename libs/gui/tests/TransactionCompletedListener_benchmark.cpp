@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <binder/Binder.h>
+#include <binder/Parcel.h>
+#include <gui/ITransactionCompletedListener.h>
+
+#include <fcntl.h>
+
+// Usage: atest TransactionCompletedListener_benchmark
+
+namespace android {
+namespace {
+
+sp<Fence> makeFence() {
+    return new Fence(open("/dev/null", O_RDONLY | O_CLOEXEC));
+}
+
+// The callbacks of one present for a client with 'surfaceCount' BLAST surfaces, each of which
+// applied its own transaction. The present and GPU composition fences are shared, as they are
+// when SurfaceFlinger sends them.
+ListenerStats makeListenerStats(int surfaceCount) {
+    const nsecs_t latchTime = systemTime();
+    const sp<Fence> presentFence = makeFence();
+    const sp<Fence> gpuCompositionDoneFence = makeFence();
+    CompositorTiming compositorTiming;
+    compositorTiming.deadline = latchTime + 8000000;
+
+    ListenerStats listenerStats;
+    for (int i = 0; i < surfaceCount; i++) {
+        FrameEventHistoryStats eventStats(100 + i, gpuCompositionDoneFence, compositorTiming,
+                                          latchTime + 1000000, latchTime - 4000000);
+        std::vector<SurfaceStats> surfaceStats;
+        surfaceStats.emplace_back(new BBinder(), latchTime - 2000000, makeFence(), 0,
+                                  eventStats);
+        listenerStats.transactionStats.emplace_back(std::vector<CallbackId>{i + 1}, latchTime,
+                                                    presentFence, surfaceStats);
+    }
+    return listenerStats;
+}
+
+void setCounters(benchmark::State& state, const Parcel& parcel) {
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.counters["bytes"] = parcel.dataSize();
+    state.counters["objects"] = parcel.objectsCount();
+}
+
+// How ListenerStats used to be written: each TransactionStats parcelable in full, with a file
+// descriptor for every fence it refers to.
+void BM_listenerStatsPerTransaction(benchmark::State& state) {
+    const ListenerStats listenerStats = makeListenerStats(static_cast<int>(state.range(0)));
+    Parcel parcel;
+    for (auto _ : state) {
+        parcel.freeData();
+        parcel.writeInt32(static_cast<int32_t>(listenerStats.transactionStats.size()));
+        for (const auto& stats : listenerStats.transactionStats) {
+            parcel.writeParcelable(stats);
+        }
+
+        parcel.setDataPosition(0);
+        const int32_t count = parcel.readInt32();
+        for (int32_t i = 0; i < count; i++) {
+            TransactionStats stats;
+            parcel.readParcelable(&stats);
+            benchmark::DoNotOptimize(stats);
+        }
+    }
+    setCounters(state, parcel);
+}
+BENCHMARK(BM_listenerStatsPerTransaction)->Arg(1)->Arg(8)->Arg(32);
+
+void BM_listenerStatsShared(benchmark::State& state) {
+    const ListenerStats listenerStats = makeListenerStats(static_cast<int>(state.range(0)));
+    Parcel parcel;
+    for (auto _ : state) {
+        parcel.freeData();
+        parcel.writeParcelable(listenerStats);
+
+        parcel.setDataPosition(0);
+        ListenerStats readStats;
+        parcel.readParcelable(&readStats);
+        benchmark::DoNotOptimize(readStats);
+    }
+    setCounters(state, parcel);
+}
+BENCHMARK(BM_listenerStatsShared)->Arg(1)->Arg(8)->Arg(32);
+
+} // namespace
+} // namespace android
+
+BENCHMARK_MAIN();
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "TransactionCompletedListener_test"
+
+#include <gtest/gtest.h>
+
+#include <binder/Binder.h>
+#include <binder/Parcel.h>
+#include <gui/ITransactionCompletedListener.h>
+
+#include <fcntl.h>
+
+namespace android {
+
+static sp<Fence> makeFence() {
+    return new Fence(open("/dev/null", O_RDONLY | O_CLOEXEC));
+}
+
+TEST(TransactionCompletedListenerTest, ListenerStatsRoundTrip) {
+    const nsecs_t latchTime = systemTime();
+    const sp<Fence> presentFence = makeFence();
+    const sp<Fence> gpuCompositionDoneFence = makeFence();
+    CompositorTiming compositorTiming;
+    compositorTiming.deadline = latchTime + 8000000;
+    const sp<IBinder> surfaceControl = new BBinder();
+
+    ListenerStats listenerStats;
+    for (int i = 0; i < 3; i++) {
+        FrameEventHistoryStats eventStats(10 + i, gpuCompositionDoneFence, compositorTiming,
+                                          latchTime + 1000, -1);
+        std::vector<SurfaceStats> surfaceStats;
+        // A time too far from the others to be written as an offset.
+        surfaceStats.emplace_back(surfaceControl, i == 2 ? 5 : latchTime - 2000,
+                                  i == 1 ? nullptr : makeFence(), i, eventStats);
+        listenerStats.transactionStats.emplace_back(std::vector<CallbackId>{i + 1}, latchTime,
+                                                    presentFence, surfaceStats);
+    }
+
+    Parcel parcel;
+    ASSERT_EQ(NO_ERROR, listenerStats.writeToParcel(&parcel));
+    // One object per surface control and per distinct fence: the shared present and GPU
+    // composition fences are only sent once.
+    EXPECT_EQ(3u + 4u, parcel.objectsCount());
+
+    parcel.setDataPosition(0);
+    ListenerStats readStats;
+    ASSERT_EQ(NO_ERROR, readStats.readFromParcel(&parcel));
+    ASSERT_EQ(3u, readStats.transactionStats.size());
+    for (int i = 0; i < 3; i++) {
+        const TransactionStats& stats = readStats.transactionStats[i];
+        EXPECT_EQ(std::vector<CallbackId>{i + 1}, stats.callbackIds);
+        EXPECT_EQ(latchTime, stats.latchTime);
+        ASSERT_NE(nullptr, stats.presentFence);
+        EXPECT_EQ(readStats.transactionStats[0].presentFence, stats.presentFence);
+
+        ASSERT_EQ(1u, stats.surfaceStats.size());
+        const SurfaceStats& surfaceStats = stats.surfaceStats[0];
+        EXPECT_EQ(surfaceControl, surfaceStats.surfaceControl);
+        EXPECT_EQ(i == 2 ? 5 : latchTime - 2000, surfaceStats.acquireTime);
+        EXPECT_EQ(i == 1, surfaceStats.previousReleaseFence == nullptr);
+        EXPECT_EQ(static_cast<uint32_t>(i), surfaceStats.transformHint);
+        EXPECT_EQ(static_cast<uint64_t>(10 + i), surfaceStats.eventStats.frameNumber);
+        EXPECT_NE(nullptr, surfaceStats.eventStats.gpuCompositionDoneFence);
+        EXPECT_EQ(compositorTiming.deadline, surfaceStats.eventStats.compositorTiming.deadline);
+        EXPECT_EQ(compositorTiming.interval, surfaceStats.eventStats.compositorTiming.interval);
+        EXPECT_EQ(latchTime + 1000, surfaceStats.eventStats.refreshStartTime);
+        EXPECT_EQ(-1, surfaceStats.eventStats.dequeueReadyTime);
+    }
+}
+
+} // namespace android
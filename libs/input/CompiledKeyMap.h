@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LIBINPUT_COMPILED_KEY_MAP_H
+#define _LIBINPUT_COMPILED_KEY_MAP_H
+
+#include <android-base/file.h>
+#include <android-base/unique_fd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <utils/Errors.h>
+#include <utils/FileMap.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace android {
+
+/*
+ * Reads the compiled binary form of a key layout or key character map.
+ *
+ * The compiled form is a sequence of native-endian records made of 32-bit fields, which are
+ * read in place from a read-only mapping of the file. The mapped pages are backed by the page
+ * cache, so they are shared by all the processes that load the same file.
+ */
+class CompiledKeyMapReader {
+public:
+    static status_t open(const std::string& filename, std::unique_ptr<CompiledKeyMapReader>* out) {
+        base::unique_fd fd(::open(filename.c_str(), O_RDONLY | O_CLOEXEC));
+        if (fd.get() < 0) {
+            return -errno;
+        }
+
+        struct stat st;
+        if (fstat(fd.get(), &st)) {
+            return -errno;
+        }
+        if (st.st_size <= 0) {
+            return BAD_VALUE;
+        }
+
+        std::unique_ptr<FileMap> fileMap = std::make_unique<FileMap>();
+        if (!fileMap->create(nullptr, fd.get(), 0, st.st_size, true)) {
+            return NO_MEMORY;
+        }
+        out->reset(new CompiledKeyMapReader(std::move(fileMap)));
+        return OK;
+    }
+
+    // Returns the next count records of type T, or nullptr if the file is too short.
+    template <typename T>
+    const T* read(size_t count = 1) {
+        static_assert(sizeof(T) % sizeof(int32_t) == 0, "Records are made of 32-bit fields");
+        const size_t size = mFileMap->getDataLength();
+        if (count > (size - mOffset) / sizeof(T)) {
+            return nullptr;
+        }
+        const T* records = reinterpret_cast<const T*>(
+                static_cast<const uint8_t*>(mFileMap->getDataPtr()) + mOffset);
+        mOffset += count * sizeof(T);
+        return records;
+    }
+
+    bool isAtEnd() const { return mOffset == mFileMap->getDataLength(); }
+
+private:
+    explicit CompiledKeyMapReader(std::unique_ptr<FileMap> fileMap)
+          : mFileMap(std::move(fileMap)) {}
+
+    std::unique_ptr<FileMap> mFileMap;
+    size_t mOffset = 0;
+};
+
+/*
+ * Writes the compiled binary form of a key layout or key character map.
+ */
+class CompiledKeyMapWriter {
+public:
+    template <typename T>
+    void write(const T& record) {
+        static_assert(sizeof(T) % sizeof(int32_t) == 0, "Records are made of 32-bit fields");
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&record);
+        mData.insert(mData.end(), bytes, bytes + sizeof(T));
+    }
+
+    status_t writeTo(int fd) const {
+        return base::WriteFully(fd, mData.data(), mData.size()) ? OK : -errno;
+    }
+
+private:
+    std::vector<uint8_t> mData;
+};
+
+} // namespace android
+
+#endif // _LIBINPUT_COMPILED_KEY_MAP_H
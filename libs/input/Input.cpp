@@ -20,6 +20,7 @@
 #include <cutils/compiler.h>
 #include <limits.h>
 #include <string.h>
+#include <algorithm>
 
 #include <input/Input.h>
 #include <input/InputDevice.h>
@@ -601,6 +602,29 @@ status_t MotionEvent::readFromParcel(Parcel* parcel) {
         properties.toolType = parcel->readInt32();
     }
 
+    const bool hasSharedBits = parcel->readBool();
+    if (hasSharedBits) {
+        const uint64_t sharedBits = parcel->readInt64();
+        const uint32_t axisCount = BitSet64::count(sharedBits);
+        if (axisCount > PointerCoords::MAX_AXES) {
+            return BAD_VALUE;
+        }
+        while (sampleCount > 0) {
+            sampleCount--;
+            mSampleEventTimes.push(parcel->readInt64());
+            for (size_t i = 0; i < pointerCount; i++) {
+                mSamplePointerCoords.push();
+                PointerCoords& coords = mSamplePointerCoords.editTop();
+                coords.bits = sharedBits;
+                status_t status = parcel->read(coords.values, axisCount * sizeof(float));
+                if (status) {
+                    return status;
+                }
+            }
+        }
+        return OK;
+    }
+
     while (sampleCount > 0) {
         sampleCount--;
         mSampleEventTimes.push(parcel->readInt64());
@@ -651,7 +675,30 @@ status_t MotionEvent::writeToParcel(Parcel* parcel) const {
         parcel->writeInt32(properties.toolType);
     }
 
+    // The pointers almost always report the same axes in every sample, in which case the axis
+    // mask is written once and each pointer's values are written as a single block.
     const PointerCoords* pc = mSamplePointerCoords.array();
+    const uint64_t sharedBits = pc[0].bits;
+    const bool hasSharedBits = std::all_of(pc, pc + sampleCount * pointerCount,
+                                           [sharedBits](const PointerCoords& coords) {
+                                               return coords.bits == sharedBits;
+                                           });
+    parcel->writeBool(hasSharedBits);
+    if (hasSharedBits) {
+        parcel->writeInt64(sharedBits);
+        const size_t valuesSize = BitSet64::count(sharedBits) * sizeof(float);
+        for (size_t h = 0; h < sampleCount; h++) {
+            parcel->writeInt64(mSampleEventTimes.itemAt(h));
+            for (size_t i = 0; i < pointerCount; i++) {
+                status_t status = parcel->write((pc++)->values, valuesSize);
+                if (status) {
+                    return status;
+                }
+            }
+        }
+        return OK;
+    }
+
     for (size_t h = 0; h < sampleCount; h++) {
         parcel->writeInt64(mSampleEventTimes.itemAt(h));
         for (size_t i = 0; i < pointerCount; i++) {
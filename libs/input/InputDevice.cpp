@@ -19,10 +19,12 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <ctype.h>
+#include <sys/stat.h>
 
 #include <android-base/stringprintf.h>
 #include <input/InputDevice.h>
 #include <input/InputEventLabels.h>
+#include <log/log.h>
 
 using android::base::StringPrintf;
 
@@ -40,6 +42,8 @@ static const char* CONFIGURATION_FILE_EXTENSION[] = {
         ".kcm",
 };
 
+static const char* COMPILED_CONFIGURATION_FILE_EXTENSION = ".bin";
+
 static bool isValidNameChar(char ch) {
     return isascii(ch) && (isdigit(ch) || isalpha(ch) || ch == '-' || ch == '_');
 }
@@ -134,6 +138,23 @@ std::string getInputDeviceConfigurationFilePathByName(
     return "";
 }
 
+std::string getCompiledInputDeviceConfigurationFilePath(const std::string& path) {
+    std::string compiledPath = path + COMPILED_CONFIGURATION_FILE_EXTENSION;
+    struct stat compiledStat;
+    if (stat(compiledPath.c_str(), &compiledStat) || access(compiledPath.c_str(), R_OK)) {
+        return "";
+    }
+
+    // A text file that was edited after the compiled one was generated takes precedence.
+    struct stat textStat;
+    if (!stat(path.c_str(), &textStat) && textStat.st_mtime > compiledStat.st_mtime) {
+        ALOGW("Ignoring compiled input device configuration file '%s', which is older than '%s'.",
+              compiledPath.c_str(), path.c_str());
+        return "";
+    }
+    return compiledPath;
+}
+
 // --- InputDeviceIdentifier
 
 std::string InputDeviceIdentifier::getCanonicalName() const {
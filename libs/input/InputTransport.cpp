@@ -23,12 +23,17 @@ static constexpr bool DEBUG_TRANSPORT_ACTIONS = false;
 #include <fcntl.h>
 #include <inttypes.h>
 #include <math.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
+
 #include <android-base/stringprintf.h>
 #include <binder/Parcel.h>
+#include <cutils/ashmem.h>
 #include <cutils/properties.h>
 #include <log/log.h>
 #include <utils/Trace.h>
@@ -75,6 +80,14 @@ static const nsecs_t RESAMPLE_MAX_PREDICTION = 8 * NANOS_PER_MS;
  */
 static const char* PROPERTY_RESAMPLING_ENABLED = "ro.input.resampling";
 
+/**
+ * System property for making input channels exchange messages through shared memory instead of
+ * their socket, see InputChannel::openInputChannelPair.
+ * Set to "1" to enable shared memory channels.
+ * Set to "0" to disable shared memory channels (default).
+ */
+static const char* PROPERTY_SHARED_MEMORY_CHANNELS_ENABLED = "ro.input.shared_memory_channels";
+
 template<typename T>
 inline static T min(const T& a, const T& b) {
     return a < b ? a : b;
@@ -105,6 +118,9 @@ bool InputMessage::isValid(size_t actualSize) const {
                 return true;
             case Type::FOCUS:
                 return true;
+            case Type::FINISHED_BATCH:
+                return body.finishedBatch.count > 0 &&
+                        body.finishedBatch.count <= MAX_FINISHED_BATCH_SIZE;
         }
     }
     return false;
@@ -120,6 +136,8 @@ size_t InputMessage::size() const {
             return sizeof(Header) + body.finished.size();
         case Type::FOCUS:
             return sizeof(Header) + body.focus.size();
+        case Type::FINISHED_BATCH:
+            return sizeof(Header) + body.finishedBatch.size();
     }
     return sizeof(Header);
 }
@@ -234,6 +252,7 @@ void InputMessage::getSanitizedCopy(InputMessage* msg) const {
         case InputMessage::Type::FINISHED: {
             msg->body.finished.seq = body.finished.seq;
             msg->body.finished.handled = body.finished.handled;
+            msg->body.finished.consumeTime = body.finished.consumeTime;
             break;
         }
         case InputMessage::Type::FOCUS: {
@@ -243,24 +262,202 @@ void InputMessage::getSanitizedCopy(InputMessage* msg) const {
             msg->body.focus.inTouchMode = body.focus.inTouchMode;
             break;
         }
+        case InputMessage::Type::FINISHED_BATCH: {
+            msg->body.finishedBatch.count = body.finishedBatch.count;
+            for (uint32_t i = 0; i < body.finishedBatch.count; i++) {
+                msg->body.finishedBatch.entries[i].seq = body.finishedBatch.entries[i].seq;
+                msg->body.finishedBatch.entries[i].handled =
+                        body.finishedBatch.entries[i].handled;
+                msg->body.finishedBatch.entries[i].consumeTime =
+                        body.finishedBatch.entries[i].consumeTime;
+            }
+            break;
+        }
+    }
+}
+
+// --- InputChannel::SharedMemory ---
+
+/**
+ * A pair of single producer, single consumer rings in shared memory, one for each direction of
+ * a channel. Each ring holds a sequence of entries made of the size of a message followed by
+ * the message itself.
+ *
+ * The other end of the channel may live in an untrusted process, so everything read from the
+ * rings is validated before it is used.
+ */
+struct InputChannel::SharedMemory {
+    // Size of the data of each ring, which must be a power of 2.
+    static constexpr uint32_t RING_SIZE = SOCKET_BUFFER_SIZE;
+    static_assert((RING_SIZE & (RING_SIZE - 1)) == 0, "RING_SIZE must be a power of 2");
+    static_assert(std::atomic<uint32_t>::is_always_lock_free);
+
+    // Positions in a ring wrap around at twice its size, so that a full ring can be told apart
+    // from an empty one.
+    static constexpr uint32_t POSITION_MASK = 2 * RING_SIZE - 1;
+
+    struct Ring {
+        // The positions at which the next entry is written and read. The head is only written by
+        // the producer and the tail only by the consumer, so they are kept on separate cache
+        // lines.
+        alignas(64) std::atomic<uint32_t> head;
+        alignas(64) std::atomic<uint32_t> tail;
+        alignas(64) uint8_t data[RING_SIZE];
+    };
+
+    static constexpr size_t SIZE = sizeof(Ring) * 2;
+
+    SharedMemory(android::base::unique_fd fd, Ring* rings) : fd(std::move(fd)), rings(rings) {}
+    ~SharedMemory() { munmap(rings, SIZE); }
+
+    static std::shared_ptr<SharedMemory> create(const std::string& name);
+    static std::shared_ptr<SharedMemory> map(android::base::unique_fd fd);
+
+    /* Appends a message to the ring.
+     *
+     * Return OK on success, and whether the ring was empty before the message was appended.
+     * Return WOULD_BLOCK if the ring is full.
+     * Return BAD_VALUE if the ring has been corrupted.
+     */
+    static status_t write(Ring& ring, const InputMessage* msg, uint32_t msgLength,
+                          bool* outWasEmpty);
+
+    /* Removes the next message from the ring.
+     *
+     * Return OK on success.
+     * Return WOULD_BLOCK if the ring is empty.
+     * Return BAD_VALUE if the ring has been corrupted or the message is invalid.
+     */
+    static status_t read(Ring& ring, InputMessage* msg);
+
+    const android::base::unique_fd fd;
+    Ring* const rings;
+
+private:
+    // The number of bytes from position from to position to, as long as both are valid.
+    static uint32_t distance(uint32_t from, uint32_t to) {
+        return (to + 2 * RING_SIZE - from) & POSITION_MASK;
+    }
+    static void copyToRing(Ring& ring, uint32_t offset, const void* src, uint32_t size);
+    static void copyFromRing(const Ring& ring, uint32_t offset, void* dst, uint32_t size);
+};
+
+std::shared_ptr<InputChannel::SharedMemory> InputChannel::SharedMemory::create(
+        const std::string& name) {
+    android::base::unique_fd fd(ashmem_create_region(name.c_str(), SIZE));
+    if (!fd.ok()) {
+        ALOGE("channel '%s' ~ Could not create shared memory: %s", name.c_str(), strerror(errno));
+        return nullptr;
+    }
+    return map(std::move(fd));
+}
+
+std::shared_ptr<InputChannel::SharedMemory> InputChannel::SharedMemory::map(
+        android::base::unique_fd fd) {
+    // The size of an ashmem region cannot change once it has been mapped, so checking it here
+    // guarantees that the mapping stays valid.
+    const int size = ashmem_get_size_region(fd.get());
+    if (size < 0 || static_cast<size_t>(size) < SIZE) {
+        ALOGE("Shared memory of input channel has invalid size %d", size);
+        return nullptr;
+    }
+    void* data = mmap(nullptr, SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd.get(), 0);
+    if (data == MAP_FAILED) {
+        ALOGE("Could not map shared memory of input channel: %s", strerror(errno));
+        return nullptr;
+    }
+    return std::make_shared<SharedMemory>(std::move(fd), static_cast<Ring*>(data));
+}
+
+void InputChannel::SharedMemory::copyToRing(Ring& ring, uint32_t offset, const void* src,
+                                            uint32_t size) {
+    const uint32_t start = offset & (RING_SIZE - 1);
+    const uint32_t firstSize = min(size, RING_SIZE - start);
+    memcpy(ring.data + start, src, firstSize);
+    memcpy(ring.data, static_cast<const uint8_t*>(src) + firstSize, size - firstSize);
+}
+
+void InputChannel::SharedMemory::copyFromRing(const Ring& ring, uint32_t offset, void* dst,
+                                              uint32_t size) {
+    const uint32_t start = offset & (RING_SIZE - 1);
+    const uint32_t firstSize = min(size, RING_SIZE - start);
+    memcpy(dst, ring.data + start, firstSize);
+    memcpy(static_cast<uint8_t*>(dst) + firstSize, ring.data, size - firstSize);
+}
+
+status_t InputChannel::SharedMemory::write(Ring& ring, const InputMessage* msg,
+                                           uint32_t msgLength, bool* outWasEmpty) {
+    const uint32_t head = ring.head.load(std::memory_order_relaxed) & POSITION_MASK;
+    const uint32_t used =
+            distance(ring.tail.load(std::memory_order_acquire) & POSITION_MASK, head);
+    if (used > RING_SIZE) {
+        return BAD_VALUE;
+    }
+    const uint32_t entrySize = sizeof(msgLength) + msgLength;
+    if (RING_SIZE - used < entrySize) {
+        return WOULD_BLOCK;
     }
+
+    copyToRing(ring, head, &msgLength, sizeof(msgLength));
+    copyToRing(ring, head + sizeof(msgLength), msg, msgLength);
+    // Publishing the entry and then checking whether the consumer had read everything before it
+    // pairs with the consumer updating the tail and then checking the head in read(). With
+    // sequentially consistent ordering, either the consumer sees the new entry, or this sees that
+    // the ring was empty and the consumer is woken up.
+    ring.head.store((head + entrySize) & POSITION_MASK, std::memory_order_seq_cst);
+    *outWasEmpty = (ring.tail.load(std::memory_order_seq_cst) & POSITION_MASK) == head;
+    return OK;
+}
+
+status_t InputChannel::SharedMemory::read(Ring& ring, InputMessage* msg) {
+    const uint32_t tail = ring.tail.load(std::memory_order_relaxed) & POSITION_MASK;
+    const uint32_t available =
+            distance(tail, ring.head.load(std::memory_order_seq_cst) & POSITION_MASK);
+    if (available == 0) {
+        return WOULD_BLOCK;
+    }
+
+    uint32_t msgLength;
+    if (available < sizeof(msgLength) || available > RING_SIZE) {
+        return BAD_VALUE;
+    }
+    copyFromRing(ring, tail, &msgLength, sizeof(msgLength));
+    if (msgLength > sizeof(InputMessage) || msgLength > available - sizeof(msgLength)) {
+        return BAD_VALUE;
+    }
+    copyFromRing(ring, tail + sizeof(msgLength), msg, msgLength);
+    ring.tail.store((tail + sizeof(msgLength) + msgLength) & POSITION_MASK,
+                    std::memory_order_seq_cst);
+
+    return msg->isValid(msgLength) ? OK : BAD_VALUE;
 }
 
 // --- InputChannel ---
 
 sp<InputChannel> InputChannel::create(const std::string& name, android::base::unique_fd fd,
                                       sp<IBinder> token) {
+    return create(name, std::move(fd), token, nullptr, false /*isServer*/);
+}
+
+sp<InputChannel> InputChannel::create(const std::string& name, android::base::unique_fd fd,
+                                      sp<IBinder> token,
+                                      std::shared_ptr<SharedMemory> sharedMemory, bool isServer) {
     const int result = fcntl(fd, F_SETFL, O_NONBLOCK);
     if (result != 0) {
         LOG_ALWAYS_FATAL("channel '%s' ~ Could not make socket non-blocking: %s", name.c_str(),
                          strerror(errno));
         return nullptr;
     }
-    return new InputChannel(name, std::move(fd), token);
+    return new InputChannel(name, std::move(fd), token, std::move(sharedMemory), isServer);
 }
 
-InputChannel::InputChannel(const std::string& name, android::base::unique_fd fd, sp<IBinder> token)
-      : mName(name), mFd(std::move(fd)), mToken(token) {
+InputChannel::InputChannel(const std::string& name, android::base::unique_fd fd, sp<IBinder> token,
+                           std::shared_ptr<SharedMemory> sharedMemory, bool isServer)
+      : mName(name),
+        mFd(std::move(fd)),
+        mToken(token),
+        mSharedMemory(std::move(sharedMemory)),
+        mIsServer(isServer) {
     if (DEBUG_CHANNEL_LIFECYCLE) {
         ALOGD("Input channel constructed: name='%s', fd=%d", mName.c_str(), mFd.get());
     }
@@ -274,6 +471,14 @@ InputChannel::~InputChannel() {
 
 status_t InputChannel::openInputChannelPair(const std::string& name,
         sp<InputChannel>& outServerChannel, sp<InputChannel>& outClientChannel) {
+    return openInputChannelPair(name, outServerChannel, outClientChannel,
+                                property_get_bool(PROPERTY_SHARED_MEMORY_CHANNELS_ENABLED, false));
+}
+
+status_t InputChannel::openInputChannelPair(const std::string& name,
+                                            sp<InputChannel>& outServerChannel,
+                                            sp<InputChannel>& outClientChannel,
+                                            bool useSharedMemory) {
     int sockets[2];
     if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sockets)) {
         status_t result = -errno;
@@ -290,15 +495,28 @@ status_t InputChannel::openInputChannelPair(const std::string& name,
     setsockopt(sockets[1], SOL_SOCKET, SO_SNDBUF, &bufferSize, sizeof(bufferSize));
     setsockopt(sockets[1], SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
 
+    android::base::unique_fd serverFd(sockets[0]);
+    android::base::unique_fd clientFd(sockets[1]);
+
+    std::shared_ptr<SharedMemory> sharedMemory;
+    if (useSharedMemory) {
+        sharedMemory = SharedMemory::create(name);
+        if (sharedMemory == nullptr) {
+            outServerChannel.clear();
+            outClientChannel.clear();
+            return NO_MEMORY;
+        }
+    }
+
     sp<IBinder> token = new BBinder();
 
     std::string serverChannelName = name + " (server)";
-    android::base::unique_fd serverFd(sockets[0]);
-    outServerChannel = InputChannel::create(serverChannelName, std::move(serverFd), token);
+    outServerChannel = InputChannel::create(serverChannelName, std::move(serverFd), token,
+                                            sharedMemory, true /*isServer*/);
 
     std::string clientChannelName = name + " (client)";
-    android::base::unique_fd clientFd(sockets[1]);
-    outClientChannel = InputChannel::create(clientChannelName, std::move(clientFd), token);
+    outClientChannel = InputChannel::create(clientChannelName, std::move(clientFd), token,
+                                            sharedMemory, false /*isServer*/);
     return OK;
 }
 
@@ -306,6 +524,10 @@ status_t InputChannel::sendMessage(const InputMessage* msg) {
     const size_t msgLength = msg->size();
     InputMessage cleanMsg;
     msg->getSanitizedCopy(&cleanMsg);
+    if (mSharedMemory != nullptr) {
+        return sendSharedMessage(&cleanMsg, msgLength);
+    }
+
     ssize_t nWrite;
     do {
         nWrite = ::send(mFd.get(), &cleanMsg, msgLength, MSG_DONTWAIT | MSG_NOSIGNAL);
@@ -341,6 +563,10 @@ status_t InputChannel::sendMessage(const InputMessage* msg) {
 }
 
 status_t InputChannel::receiveMessage(InputMessage* msg) {
+    if (mSharedMemory != nullptr) {
+        return receiveSharedMessage(msg);
+    }
+
     ssize_t nRead;
     do {
         nRead = ::recv(mFd.get(), msg, sizeof(InputMessage), MSG_DONTWAIT);
@@ -380,6 +606,96 @@ status_t InputChannel::receiveMessage(InputMessage* msg) {
     return OK;
 }
 
+status_t InputChannel::sendSharedMessage(const InputMessage* msg, size_t msgLength) {
+    bool wasEmpty;
+    status_t result =
+            SharedMemory::write(mSharedMemory->rings[mIsServer ? 0 : 1], msg, msgLength, &wasEmpty);
+    if (result != OK) {
+#if DEBUG_CHANNEL_MESSAGES
+        ALOGD("channel '%s' ~ error writing message of type %d to shared memory, status=%d",
+              mName.c_str(), msg->header.type, result);
+#endif
+        return result;
+    }
+
+    // Only ring the doorbell when the receiver may be waiting for the fd to become readable.
+    // Otherwise it will read the message before it next waits.
+    if (wasEmpty) {
+        const uint8_t doorbell = 0;
+        ssize_t nWrite;
+        do {
+            nWrite = ::send(mFd.get(), &doorbell, sizeof(doorbell), MSG_DONTWAIT | MSG_NOSIGNAL);
+        } while (nWrite == -1 && errno == EINTR);
+
+        // If the socket is full, the receiver has doorbells pending anyway.
+        if (nWrite < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            int error = errno;
+#if DEBUG_CHANNEL_MESSAGES
+            ALOGD("channel '%s' ~ error sending doorbell, %s", mName.c_str(), strerror(error));
+#endif
+            if (error == EPIPE || error == ENOTCONN || error == ECONNREFUSED ||
+                error == ECONNRESET) {
+                return DEAD_OBJECT;
+            }
+            return -error;
+        }
+    }
+
+#if DEBUG_CHANNEL_MESSAGES
+    ALOGD("channel '%s' ~ sent message of type %d", mName.c_str(), msg->header.type);
+#endif
+    return OK;
+}
+
+status_t InputChannel::receiveSharedMessage(InputMessage* msg) {
+    SharedMemory::Ring& ring = mSharedMemory->rings[mIsServer ? 1 : 0];
+    status_t result = SharedMemory::read(ring, msg);
+    if (result == WOULD_BLOCK) {
+        // The ring is empty, so consume the doorbells of the messages read so far. Check the
+        // ring again afterwards, since a message may have been written before the doorbell for
+        // it was consumed.
+        const status_t doorbellResult = receiveDoorbells();
+        result = SharedMemory::read(ring, msg);
+        if (result == WOULD_BLOCK && doorbellResult != OK) {
+            return doorbellResult;
+        }
+    }
+
+#if DEBUG_CHANNEL_MESSAGES
+    if (result == OK) {
+        ALOGD("channel '%s' ~ received message of type %d", mName.c_str(), msg->header.type);
+    } else if (result == BAD_VALUE) {
+        ALOGD("channel '%s' ~ received invalid message", mName.c_str());
+    }
+#endif
+    return result;
+}
+
+status_t InputChannel::receiveDoorbells() {
+    for (;;) {
+        uint8_t doorbell;
+        ssize_t nRead = ::recv(mFd.get(), &doorbell, sizeof(doorbell), MSG_DONTWAIT);
+        if (nRead > 0) {
+            continue;
+        }
+        if (nRead == 0) { // check for EOF
+            return DEAD_OBJECT;
+        }
+
+        int error = errno;
+        if (error == EINTR) {
+            continue;
+        }
+        if (error == EAGAIN || error == EWOULDBLOCK) {
+            return OK;
+        }
+        if (error == EPIPE || error == ENOTCONN || error == ECONNREFUSED) {
+            return DEAD_OBJECT;
+        }
+        return -error;
+    }
+}
+
 sp<InputChannel> InputChannel::dup() const {
     android::base::unique_fd newFd(::dup(getFd()));
     if (!newFd.ok()) {
@@ -394,7 +710,7 @@ sp<InputChannel> InputChannel::dup() const {
                             getName().c_str());
         return nullptr;
     }
-    return InputChannel::create(mName, std::move(newFd), mToken);
+    return InputChannel::create(mName, std::move(newFd), mToken, mSharedMemory, mIsServer);
 }
 
 status_t InputChannel::write(Parcel& out) const {
@@ -409,6 +725,21 @@ status_t InputChannel::write(Parcel& out) const {
     }
 
     s = out.writeUniqueFileDescriptor(mFd);
+    if (s != OK) {
+        return s;
+    }
+
+    s = out.writeBool(mSharedMemory != nullptr);
+    if (s != OK || mSharedMemory == nullptr) {
+        return s;
+    }
+
+    s = out.writeBool(mIsServer);
+    if (s != OK) {
+        return s;
+    }
+
+    s = out.writeDupFileDescriptor(mSharedMemory->fd.get());
     return s;
 }
 
@@ -421,7 +752,22 @@ sp<InputChannel> InputChannel::read(const Parcel& from) {
         return nullptr;
     }
 
-    return InputChannel::create(name, std::move(rawFd), token);
+    std::shared_ptr<SharedMemory> sharedMemory;
+    bool isServer = false;
+    if (from.readBool()) {
+        isServer = from.readBool();
+        android::base::unique_fd sharedMemoryFd;
+        fdResult = from.readUniqueFileDescriptor(&sharedMemoryFd);
+        if (fdResult != OK) {
+            return nullptr;
+        }
+        sharedMemory = SharedMemory::map(std::move(sharedMemoryFd));
+        if (sharedMemory == nullptr) {
+            return nullptr;
+        }
+    }
+
+    return InputChannel::create(name, std::move(rawFd), token, std::move(sharedMemory), isServer);
 }
 
 sp<IBinder> InputChannel::getConnectionToken() const {
@@ -577,21 +923,61 @@ status_t InputPublisher::receiveFinishedSignal(uint32_t* outSeq, bool* outHandle
         ALOGD("channel '%s' publisher ~ receiveFinishedSignal", mChannel->getName().c_str());
     }
 
+    if (mPendingFinishedSignals.empty()) {
+        std::vector<InputFinishedSignal> signals;
+        status_t result = receiveFinishedSignals(&signals);
+        if (result) {
+            *outSeq = 0;
+            *outHandled = false;
+            return result;
+        }
+        mPendingFinishedSignals.insert(mPendingFinishedSignals.end(), signals.begin(),
+                                       signals.end());
+    }
+
+    const InputFinishedSignal& signal = mPendingFinishedSignals.front();
+    *outSeq = signal.seq;
+    *outHandled = signal.handled;
+    mPendingFinishedSignals.pop_front();
+    return OK;
+}
+
+status_t InputPublisher::receiveFinishedSignals(std::vector<InputFinishedSignal>* outSignals) {
+    if (DEBUG_TRANSPORT_ACTIONS) {
+        ALOGD("channel '%s' publisher ~ receiveFinishedSignals", mChannel->getName().c_str());
+    }
+
+    if (!mPendingFinishedSignals.empty()) {
+        outSignals->insert(outSignals->end(), mPendingFinishedSignals.begin(),
+                           mPendingFinishedSignals.end());
+        mPendingFinishedSignals.clear();
+        return OK;
+    }
+
     InputMessage msg;
     status_t result = mChannel->receiveMessage(&msg);
     if (result) {
-        *outSeq = 0;
-        *outHandled = false;
         return result;
     }
-    if (msg.header.type != InputMessage::Type::FINISHED) {
-        ALOGE("channel '%s' publisher ~ Received unexpected message of type %d from consumer",
-                mChannel->getName().c_str(), msg.header.type);
-        return UNKNOWN_ERROR;
+    switch (msg.header.type) {
+        case InputMessage::Type::FINISHED: {
+            outSignals->push_back({msg.body.finished.seq, msg.body.finished.handled == 1,
+                                   msg.body.finished.consumeTime});
+            return OK;
+        }
+        case InputMessage::Type::FINISHED_BATCH: {
+            for (uint32_t i = 0; i < msg.body.finishedBatch.count; i++) {
+                const InputMessage::Body::Finished& entry = msg.body.finishedBatch.entries[i];
+                outSignals->push_back({entry.seq, entry.handled == 1, entry.consumeTime});
+            }
+            return OK;
+        }
+        default: {
+            ALOGE("channel '%s' publisher ~ Received unexpected message of type %d from consumer",
+                  mChannel->getName().c_str(), msg.header.type);
+            return UNKNOWN_ERROR;
+        }
     }
-    *outSeq = msg.body.finished.seq;
-    *outHandled = msg.body.finished.handled == 1;
-    return OK;
 }
 
 // --- InputConsumer ---
@@ -628,7 +1014,12 @@ status_t InputConsumer::consume(InputEventFactoryInterface* factory, bool consum
         } else {
             // Receive a fresh message.
             status_t result = mChannel->receiveMessage(&mMsg);
-            if (result) {
+            if (result == OK) {
+                const uint32_t seq = getEventSeq(mMsg);
+                if (seq != 0) {
+                    mConsumeTimes.emplace(seq, systemTime(SYSTEM_TIME_MONOTONIC));
+                }
+            } else {
                 // Consume the next batched event unless batches are being held for later.
                 if (consumeBatches || result != WOULD_BLOCK) {
                     result = consumeBatch(factory, frameTime, outSeq, outEvent);
@@ -727,7 +1118,8 @@ status_t InputConsumer::consume(InputEventFactoryInterface* factory, bool consum
                 break;
             }
 
-            case InputMessage::Type::FINISHED: {
+            case InputMessage::Type::FINISHED:
+            case InputMessage::Type::FINISHED_BATCH: {
                 LOG_ALWAYS_FATAL("Consumed a FINISHED message, which should never be seen by "
                                  "InputConsumer!");
                 break;
@@ -960,15 +1352,20 @@ void InputConsumer::resampleTouchState(nsecs_t sampleTime, MotionEvent* event,
     }
 
     // Find the data to use for resampling.
-    const History* other;
-    History future;
+    // The coordinates of the other sample are looked up by pointer id, and point into either
+    // the next message or the touch history.
+    const PointerCoords* otherCoordsById[MAX_POINTER_ID + 1];
+    BitSet32 otherIdBits;
     float alpha;
     if (next) {
         // Interpolate between current sample and future sample.
-        // So current->eventTime <= sampleTime <= future.eventTime.
-        future.initializeFrom(*next);
-        other = &future;
-        nsecs_t delta = future.eventTime - current->eventTime;
+        // So current->eventTime <= sampleTime <= next->body.motion.eventTime.
+        for (uint32_t i = 0; i < next->body.motion.pointerCount; i++) {
+            uint32_t id = next->body.motion.pointers[i].properties.id;
+            otherIdBits.markBit(id);
+            otherCoordsById[id] = &next->body.motion.pointers[i].coords;
+        }
+        nsecs_t delta = next->body.motion.eventTime - current->eventTime;
         if (delta < RESAMPLE_MIN_DELTA) {
 #if DEBUG_RESAMPLING
             ALOGD("Not resampled, delta time is too small: %" PRId64 " ns.", delta);
@@ -979,7 +1376,12 @@ void InputConsumer::resampleTouchState(nsecs_t sampleTime, MotionEvent* event,
     } else if (touchState.historySize >= 2) {
         // Extrapolate future sample using current sample and past sample.
         // So other->eventTime <= current->eventTime <= sampleTime.
-        other = touchState.getHistory(1);
+        const History* other = touchState.getHistory(1);
+        for (BitSet32 idBits(other->idBits); !idBits.isEmpty();) {
+            uint32_t id = idBits.clearFirstMarkedBit();
+            otherIdBits.markBit(id);
+            otherCoordsById[id] = &other->getPointerById(id);
+        }
         nsecs_t delta = current->eventTime - other->eventTime;
         if (delta < RESAMPLE_MIN_DELTA) {
 #if DEBUG_RESAMPLING
@@ -1010,54 +1412,72 @@ void InputConsumer::resampleTouchState(nsecs_t sampleTime, MotionEvent* event,
     }
 
     // Resample touch coordinates.
-    History oldLastResample;
-    oldLastResample.initializeFrom(touchState.lastResample);
-    touchState.lastResample.eventTime = sampleTime;
-    touchState.lastResample.idBits.clear();
+    // We maintain the previously resampled value for a pointer when its coordinates haven't
+    // changed since then. This way we don't introduce artificial jitter when pointers haven't
+    // actually moved. We know here that the coordinates for the pointer haven't changed because
+    // we would've cleared the resampled bit in rewriteMessage if they had. We can't modify
+    // lastResample in place because the mapping from pointer ID to index may have changed, so
+    // the pointers to keep are copied aside first.
+    History& lastResample = touchState.lastResample;
+    PointerCoords keptCoords[MAX_POINTERS];
+    BitSet32 keptIndices;
+    for (size_t i = 0; i < pointerCount; i++) {
+        uint32_t id = event->getPointerId(i);
+        if (lastResample.hasPointerId(id) && touchState.recentCoordinatesAreIdentical(id)) {
+            keptCoords[i].copyFrom(lastResample.getPointerById(id));
+            keptIndices.markBit(i);
+        }
+    }
+
+    // The X and Y coordinates of the pointers to interpolate are packed into arrays, so that
+    // they are all interpolated in a single pass.
+    uint32_t resampledIndices[MAX_POINTERS];
+    float currentX[MAX_POINTERS], currentY[MAX_POINTERS];
+    float otherX[MAX_POINTERS], otherY[MAX_POINTERS];
+    size_t resampledCount = 0;
+    lastResample.eventTime = sampleTime;
+    lastResample.idBits.clear();
     for (size_t i = 0; i < pointerCount; i++) {
         uint32_t id = event->getPointerId(i);
-        touchState.lastResample.idToIndex[id] = i;
-        touchState.lastResample.idBits.markBit(id);
-        if (oldLastResample.hasPointerId(id) && touchState.recentCoordinatesAreIdentical(id)) {
-            // We maintain the previously resampled value for this pointer (stored in
-            // oldLastResample) when the coordinates for this pointer haven't changed since then.
-            // This way we don't introduce artificial jitter when pointers haven't actually moved.
-
-            // We know here that the coordinates for the pointer haven't changed because we
-            // would've cleared the resampled bit in rewriteMessage if they had. We can't modify
-            // lastResample in place becasue the mapping from pointer ID to index may have changed.
-            touchState.lastResample.pointers[i].copyFrom(oldLastResample.getPointerById(id));
+        lastResample.idToIndex[id] = i;
+        lastResample.idBits.markBit(id);
+        if (keptIndices.hasBit(i)) {
+            lastResample.pointers[i].copyFrom(keptCoords[i]);
             continue;
         }
 
-        PointerCoords& resampledCoords = touchState.lastResample.pointers[i];
         const PointerCoords& currentCoords = current->getPointerById(id);
-        resampledCoords.copyFrom(currentCoords);
-        if (other->idBits.hasBit(id)
-                && shouldResampleTool(event->getToolType(i))) {
-            const PointerCoords& otherCoords = other->getPointerById(id);
-            resampledCoords.setAxisValue(AMOTION_EVENT_AXIS_X,
-                    lerp(currentCoords.getX(), otherCoords.getX(), alpha));
-            resampledCoords.setAxisValue(AMOTION_EVENT_AXIS_Y,
-                    lerp(currentCoords.getY(), otherCoords.getY(), alpha));
-#if DEBUG_RESAMPLING
-            ALOGD("[%d] - out (%0.3f, %0.3f), cur (%0.3f, %0.3f), "
-                    "other (%0.3f, %0.3f), alpha %0.3f",
-                    id, resampledCoords.getX(), resampledCoords.getY(),
-                    currentCoords.getX(), currentCoords.getY(),
-                    otherCoords.getX(), otherCoords.getY(),
-                    alpha);
-#endif
-        } else {
+        lastResample.pointers[i].copyFrom(currentCoords);
+        if (otherIdBits.hasBit(id) && shouldResampleTool(event->getToolType(i))) {
+            const PointerCoords& otherCoords = *otherCoordsById[id];
+            resampledIndices[resampledCount] = i;
+            currentX[resampledCount] = currentCoords.getX();
+            currentY[resampledCount] = currentCoords.getY();
+            otherX[resampledCount] = otherCoords.getX();
+            otherY[resampledCount] = otherCoords.getY();
+            resampledCount++;
+        }
+    }
+
+    float resampledX[MAX_POINTERS], resampledY[MAX_POINTERS];
+    for (size_t j = 0; j < resampledCount; j++) {
+        resampledX[j] = lerp(currentX[j], otherX[j], alpha);
+        resampledY[j] = lerp(currentY[j], otherY[j], alpha);
+    }
+
+    for (size_t j = 0; j < resampledCount; j++) {
+        PointerCoords& resampledCoords = lastResample.pointers[resampledIndices[j]];
+        resampledCoords.setAxisValue(AMOTION_EVENT_AXIS_X, resampledX[j]);
+        resampledCoords.setAxisValue(AMOTION_EVENT_AXIS_Y, resampledY[j]);
 #if DEBUG_RESAMPLING
-            ALOGD("[%d] - out (%0.3f, %0.3f), cur (%0.3f, %0.3f)",
-                    id, resampledCoords.getX(), resampledCoords.getY(),
-                    currentCoords.getX(), currentCoords.getY());
+        ALOGD("[%d] - out (%0.3f, %0.3f), cur (%0.3f, %0.3f), "
+                "other (%0.3f, %0.3f), alpha %0.3f",
+                event->getPointerId(resampledIndices[j]), resampledX[j], resampledY[j],
+                currentX[j], currentY[j], otherX[j], otherY[j], alpha);
 #endif
-        }
     }
 
-    event->addSample(sampleTime, touchState.lastResample.pointers);
+    event->addSample(sampleTime, lastResample.pointers);
 }
 
 bool InputConsumer::shouldResampleTool(int32_t toolType) {
@@ -1071,55 +1491,117 @@ status_t InputConsumer::sendFinishedSignal(uint32_t seq, bool handled) {
               mChannel->getName().c_str(), seq, toString(handled));
     }
 
-    if (!seq) {
-        ALOGE("Attempted to send a finished signal with sequence number 0.");
-        return BAD_VALUE;
+    return sendFinishedSignals({{seq, handled}});
+}
+
+status_t InputConsumer::sendFinishedSignals(const std::vector<InputFinishedSignal>& signals) {
+    if (DEBUG_TRANSPORT_ACTIONS) {
+        ALOGD("channel '%s' consumer ~ sendFinishedSignals: count=%zu",
+              mChannel->getName().c_str(), signals.size());
     }
 
-    // Send finished signals for the batch sequence chain first.
-    size_t seqChainCount = mSeqChains.size();
-    if (seqChainCount) {
-        uint32_t currentSeq = seq;
-        uint32_t chainSeqs[seqChainCount];
-        size_t chainIndex = 0;
-        for (size_t i = seqChainCount; i > 0; ) {
-             i--;
-             const SeqChain& seqChain = mSeqChains.itemAt(i);
-             if (seqChain.seq == currentSeq) {
-                 currentSeq = seqChain.chain;
-                 chainSeqs[chainIndex++] = currentSeq;
-                 mSeqChains.removeAt(i);
-             }
+    for (const InputFinishedSignal& signal : signals) {
+        if (!signal.seq) {
+            ALOGE("Attempted to send a finished signal with sequence number 0.");
+            return BAD_VALUE;
         }
-        status_t status = OK;
-        while (!status && chainIndex > 0) {
-            chainIndex--;
-            status = sendUnchainedFinishedSignal(chainSeqs[chainIndex], handled);
-        }
-        if (status) {
-            // An error occurred so at least one signal was not sent, reconstruct the chain.
-            for (;;) {
+    }
+
+    // Finish the messages of the batch sequence chain of each signal first.
+    std::vector<InputFinishedSignal> unchainedSignals;
+    std::vector<size_t> signalEnds;
+    for (const InputFinishedSignal& signal : signals) {
+        popSeqChain(signal.seq, signal.handled, &unchainedSignals);
+        unchainedSignals.push_back(signal);
+        signalEnds.push_back(unchainedSignals.size());
+    }
+
+    size_t sentCount;
+    status_t status = sendUnchainedFinishedSignals(unchainedSignals, &sentCount);
+    if (status) {
+        // An error occurred so at least one signal was not sent, reconstruct the chains of the
+        // signals that were not sent completely.
+        size_t begin = 0;
+        for (size_t end : signalEnds) {
+            for (size_t i = std::max(begin, sentCount); i + 1 < end; i++) {
                 SeqChain seqChain;
-                seqChain.seq = chainIndex != 0 ? chainSeqs[chainIndex - 1] : seq;
-                seqChain.chain = chainSeqs[chainIndex];
+                seqChain.seq = unchainedSignals[i + 1].seq;
+                seqChain.chain = unchainedSignals[i].seq;
                 mSeqChains.push(seqChain);
-                if (!chainIndex) break;
-                chainIndex--;
             }
+            begin = end;
+        }
+    }
+    return status;
+}
+
+void InputConsumer::popSeqChain(uint32_t seq, bool handled,
+                                std::vector<InputFinishedSignal>* outSignals) {
+    const size_t chainBegin = outSignals->size();
+    uint32_t currentSeq = seq;
+    for (size_t i = mSeqChains.size(); i > 0;) {
+        i--;
+        const SeqChain& seqChain = mSeqChains.itemAt(i);
+        if (seqChain.seq == currentSeq) {
+            currentSeq = seqChain.chain;
+            outSignals->push_back({currentSeq, handled});
+            mSeqChains.removeAt(i);
+        }
+    }
+    // The chain was walked from the newest message to the oldest, finish them in order.
+    std::reverse(outSignals->begin() + chainBegin, outSignals->end());
+}
+
+status_t InputConsumer::sendUnchainedFinishedSignals(
+        const std::vector<InputFinishedSignal>& signals, size_t* outSentCount) {
+    *outSentCount = 0;
+    while (*outSentCount < signals.size()) {
+        const size_t count = std::min(signals.size() - *outSentCount,
+                                      size_t(InputMessage::MAX_FINISHED_BATCH_SIZE));
+        const InputFinishedSignal* batch = &signals[*outSentCount];
+        InputMessage msg;
+        if (count == 1) {
+            msg.header.type = InputMessage::Type::FINISHED;
+            msg.body.finished.seq = batch[0].seq;
+            msg.body.finished.handled = batch[0].handled ? 1 : 0;
+            msg.body.finished.consumeTime = getConsumeTime(batch[0].seq);
+        } else {
+            msg.header.type = InputMessage::Type::FINISHED_BATCH;
+            msg.body.finishedBatch.count = count;
+            for (size_t i = 0; i < count; i++) {
+                msg.body.finishedBatch.entries[i].seq = batch[i].seq;
+                msg.body.finishedBatch.entries[i].handled = batch[i].handled ? 1 : 0;
+                msg.body.finishedBatch.entries[i].consumeTime = getConsumeTime(batch[i].seq);
+            }
+        }
+        status_t status = mChannel->sendMessage(&msg);
+        if (status) {
             return status;
         }
+        for (size_t i = 0; i < count; i++) {
+            mConsumeTimes.erase(batch[i].seq);
+        }
+        *outSentCount += count;
     }
+    return OK;
+}
 
-    // Send finished signal for the last message in the batch.
-    return sendUnchainedFinishedSignal(seq, handled);
+nsecs_t InputConsumer::getConsumeTime(uint32_t seq) const {
+    auto it = mConsumeTimes.find(seq);
+    return it != mConsumeTimes.end() ? it->second : 0;
 }
 
-status_t InputConsumer::sendUnchainedFinishedSignal(uint32_t seq, bool handled) {
-    InputMessage msg;
-    msg.header.type = InputMessage::Type::FINISHED;
-    msg.body.finished.seq = seq;
-    msg.body.finished.handled = handled ? 1 : 0;
-    return mChannel->sendMessage(&msg);
+uint32_t InputConsumer::getEventSeq(const InputMessage& msg) {
+    switch (msg.header.type) {
+        case InputMessage::Type::KEY:
+            return msg.body.key.seq;
+        case InputMessage::Type::MOTION:
+            return msg.body.motion.seq;
+        case InputMessage::Type::FOCUS:
+            return msg.body.focus.seq;
+        default:
+            return 0;
+    }
 }
 
 bool InputConsumer::hasDeferredEvent() const {
@@ -24,6 +24,7 @@
 #endif
 
 #include <android/keycodes.h>
+#include <input/InputDevice.h>
 #include <input/InputEventLabels.h>
 #include <input/Keyboard.h>
 #include <input/KeyCharacterMap.h>
@@ -33,6 +34,8 @@
 #include <utils/Tokenizer.h>
 #include <utils/Timers.h>
 
+#include "CompiledKeyMap.h"
+
 // Enables debug output for the parser.
 #define DEBUG_PARSER 0
 
@@ -72,6 +75,41 @@ static const Modifier modifiers[] = {
         { "scrolllock", AMETA_SCROLL_LOCK_ON },
 };
 
+// The compiled form of a key character map is a header followed by the keys, the behaviors of
+// all keys in the same order, the key codes by scan code and the key codes by usage code.
+static constexpr int32_t COMPILED_MAGIC = 0x4b434d31; // 'KCM1'
+static constexpr int32_t COMPILED_VERSION = 1;
+
+struct CompiledHeader {
+    int32_t magic;
+    int32_t version;
+    int32_t type;
+    int32_t keyCount;
+    int32_t behaviorCount;
+    int32_t keysByScanCodeCount;
+    int32_t keysByUsageCodeCount;
+};
+
+struct CompiledKey {
+    int32_t keyCode;
+    int32_t label;
+    int32_t number;
+    // The number of behaviors of the key, which follow those of the previous keys.
+    int32_t behaviorCount;
+};
+
+struct CompiledBehavior {
+    int32_t metaState;
+    int32_t character;
+    int32_t fallbackKeyCode;
+    int32_t replacementKeyCode;
+};
+
+struct CompiledKeyCode {
+    int32_t code;
+    int32_t keyCode;
+};
+
 #if DEBUG_MAPPING
 static String8 toString(const char16_t* chars, size_t numChars) {
     String8 result;
@@ -110,6 +148,11 @@ status_t KeyCharacterMap::load(const std::string& filename,
         Format format, sp<KeyCharacterMap>* outMap) {
     outMap->clear();
 
+    std::string compiledFilename = getCompiledInputDeviceConfigurationFilePath(filename);
+    if (!compiledFilename.empty() && loadCompiled(compiledFilename, format, outMap) == OK) {
+        return OK;
+    }
+
     Tokenizer* tokenizer;
     status_t status = Tokenizer::open(String8(filename.c_str()), &tokenizer);
     if (status) {
@@ -121,6 +164,95 @@ status_t KeyCharacterMap::load(const std::string& filename,
     return status;
 }
 
+status_t KeyCharacterMap::loadCompiled(const std::string& filename, Format format,
+        sp<KeyCharacterMap>* outMap) {
+    outMap->clear();
+
+    std::unique_ptr<CompiledKeyMapReader> reader;
+    status_t status = CompiledKeyMapReader::open(filename, &reader);
+    if (status) {
+        ALOGE("Error %d opening compiled key character map file %s.", status, filename.c_str());
+        return status;
+    }
+
+    const CompiledHeader* header = reader->read<CompiledHeader>();
+    if (!header || header->magic != COMPILED_MAGIC || header->version != COMPILED_VERSION) {
+        ALOGE("Compiled key character map file %s has an unsupported format.", filename.c_str());
+        return BAD_VALUE;
+    }
+    if (header->keyCount > MAX_KEYS) {
+        ALOGE("Too many keys in compiled key character map file %s (%d > %d)", filename.c_str(),
+                header->keyCount, MAX_KEYS);
+        return BAD_VALUE;
+    }
+    if ((format == FORMAT_BASE && header->type == KEYBOARD_TYPE_OVERLAY)
+            || (format == FORMAT_OVERLAY && header->type != KEYBOARD_TYPE_OVERLAY)) {
+        ALOGE("Compiled key character map file %s has keyboard type %d, which does not match "
+                "the requested format.", filename.c_str(), header->type);
+        return BAD_VALUE;
+    }
+
+    // Negative counts wrap around to sizes that no file can hold, so reading fails.
+    const CompiledKey* keys = reader->read<CompiledKey>(header->keyCount);
+    const CompiledBehavior* behaviors = reader->read<CompiledBehavior>(header->behaviorCount);
+    const CompiledKeyCode* keysByScanCode =
+            reader->read<CompiledKeyCode>(header->keysByScanCodeCount);
+    const CompiledKeyCode* keysByUsageCode =
+            reader->read<CompiledKeyCode>(header->keysByUsageCodeCount);
+    if (!keys || !behaviors || !keysByScanCode || !keysByUsageCode || !reader->isAtEnd()) {
+        ALOGE("Compiled key character map file %s is truncated or corrupt.", filename.c_str());
+        return BAD_VALUE;
+    }
+
+    sp<KeyCharacterMap> map = new KeyCharacterMap();
+    map->mType = header->type;
+    map->mKeys.setCapacity(header->keyCount);
+    int32_t remainingBehaviors = header->behaviorCount;
+    const CompiledBehavior* nextBehavior = behaviors;
+    for (int32_t i = 0; i < header->keyCount; i++) {
+        const CompiledKey& compiledKey = keys[i];
+        if (compiledKey.behaviorCount < 0 || compiledKey.behaviorCount > remainingBehaviors) {
+            ALOGE("Compiled key character map file %s has an invalid behavior count.",
+                    filename.c_str());
+            return BAD_VALUE;
+        }
+        remainingBehaviors -= compiledKey.behaviorCount;
+
+        Key* key = new Key();
+        key->label = compiledKey.label;
+        key->number = compiledKey.number;
+        map->mKeys.add(compiledKey.keyCode, key);
+
+        Behavior** link = &key->firstBehavior;
+        for (int32_t j = 0; j < compiledKey.behaviorCount; j++, nextBehavior++) {
+            Behavior* behavior = new Behavior();
+            behavior->metaState = nextBehavior->metaState;
+            behavior->character = nextBehavior->character;
+            behavior->fallbackKeyCode = nextBehavior->fallbackKeyCode;
+            behavior->replacementKeyCode = nextBehavior->replacementKeyCode;
+            *link = behavior;
+            link = &behavior->next;
+        }
+    }
+    if (remainingBehaviors != 0) {
+        ALOGE("Compiled key character map file %s has an invalid behavior count.",
+                filename.c_str());
+        return BAD_VALUE;
+    }
+
+    map->mKeysByScanCode.setCapacity(header->keysByScanCodeCount);
+    for (int32_t i = 0; i < header->keysByScanCodeCount; i++) {
+        map->mKeysByScanCode.add(keysByScanCode[i].code, keysByScanCode[i].keyCode);
+    }
+    map->mKeysByUsageCode.setCapacity(header->keysByUsageCodeCount);
+    for (int32_t i = 0; i < header->keysByUsageCodeCount; i++) {
+        map->mKeysByUsageCode.add(keysByUsageCode[i].code, keysByUsageCode[i].keyCode);
+    }
+
+    *outMap = map;
+    return OK;
+}
+
 status_t KeyCharacterMap::loadContents(const std::string& filename, const char* contents,
         Format format, sp<KeyCharacterMap>* outMap) {
     outMap->clear();
@@ -599,6 +731,45 @@ void KeyCharacterMap::addLockedMetaKey(Vector<KeyEvent>& outEvents,
     }
 }
 
+status_t KeyCharacterMap::writeCompiled(int fd) const {
+    int32_t behaviorCount = 0;
+    for (size_t i = 0; i < mKeys.size(); i++) {
+        for (const Behavior* behavior = mKeys.valueAt(i)->firstBehavior; behavior != nullptr;
+                behavior = behavior->next) {
+            behaviorCount++;
+        }
+    }
+
+    CompiledKeyMapWriter writer;
+    writer.write(CompiledHeader{COMPILED_MAGIC, COMPILED_VERSION, mType,
+            static_cast<int32_t>(mKeys.size()), behaviorCount,
+            static_cast<int32_t>(mKeysByScanCode.size()),
+            static_cast<int32_t>(mKeysByUsageCode.size())});
+    for (size_t i = 0; i < mKeys.size(); i++) {
+        const Key* key = mKeys.valueAt(i);
+        int32_t keyBehaviorCount = 0;
+        for (const Behavior* behavior = key->firstBehavior; behavior != nullptr;
+                behavior = behavior->next) {
+            keyBehaviorCount++;
+        }
+        writer.write(CompiledKey{mKeys.keyAt(i), key->label, key->number, keyBehaviorCount});
+    }
+    for (size_t i = 0; i < mKeys.size(); i++) {
+        for (const Behavior* behavior = mKeys.valueAt(i)->firstBehavior; behavior != nullptr;
+                behavior = behavior->next) {
+            writer.write(CompiledBehavior{behavior->metaState, behavior->character,
+                    behavior->fallbackKeyCode, behavior->replacementKeyCode});
+        }
+    }
+    for (size_t i = 0; i < mKeysByScanCode.size(); i++) {
+        writer.write(CompiledKeyCode{mKeysByScanCode.keyAt(i), mKeysByScanCode.valueAt(i)});
+    }
+    for (size_t i = 0; i < mKeysByUsageCode.size(); i++) {
+        writer.write(CompiledKeyCode{mKeysByUsageCode.keyAt(i), mKeysByUsageCode.valueAt(i)});
+    }
+    return writer.writeTo(fd);
+}
+
 #ifdef __ANDROID__
 sp<KeyCharacterMap> KeyCharacterMap::readFromParcel(Parcel* parcel) {
     sp<KeyCharacterMap> map = new KeyCharacterMap();
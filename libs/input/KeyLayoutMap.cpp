@@ -19,6 +19,7 @@
 #include <stdlib.h>
 
 #include <android/keycodes.h>
+#include <input/InputDevice.h>
 #include <input/InputEventLabels.h>
 #include <input/Keyboard.h>
 #include <input/KeyLayoutMap.h>
@@ -27,6 +28,8 @@
 #include <utils/Tokenizer.h>
 #include <utils/Timers.h>
 
+#include "CompiledKeyMap.h"
+
 // Enables debug output for the parser.
 #define DEBUG_PARSER 0
 
@@ -41,6 +44,41 @@ namespace android {
 
 static const char* WHITESPACE = " \t\r";
 
+// The compiled form of a key layout map is a header followed by the keys by scan code, the keys
+// by usage code, the axes, the leds by scan code and the leds by usage code.
+static constexpr int32_t COMPILED_MAGIC = 0x4b4c4231; // 'KLB1'
+static constexpr int32_t COMPILED_VERSION = 1;
+
+struct CompiledHeader {
+    int32_t magic;
+    int32_t version;
+    int32_t keysByScanCodeCount;
+    int32_t keysByUsageCodeCount;
+    int32_t axesCount;
+    int32_t ledsByScanCodeCount;
+    int32_t ledsByUsageCodeCount;
+};
+
+struct CompiledKey {
+    int32_t code;
+    int32_t keyCode;
+    uint32_t flags;
+};
+
+struct CompiledAxis {
+    int32_t scanCode;
+    int32_t mode;
+    int32_t axis;
+    int32_t highAxis;
+    int32_t splitValue;
+    int32_t flatOverride;
+};
+
+struct CompiledLed {
+    int32_t code;
+    int32_t ledCode;
+};
+
 // --- KeyLayoutMap ---
 
 KeyLayoutMap::KeyLayoutMap() {
@@ -52,6 +90,11 @@ KeyLayoutMap::~KeyLayoutMap() {
 status_t KeyLayoutMap::load(const std::string& filename, sp<KeyLayoutMap>* outMap) {
     outMap->clear();
 
+    std::string compiledFilename = getCompiledInputDeviceConfigurationFilePath(filename);
+    if (!compiledFilename.empty() && loadCompiled(compiledFilename, outMap) == OK) {
+        return OK;
+    }
+
     Tokenizer* tokenizer;
     status_t status = Tokenizer::open(String8(filename.c_str()), &tokenizer);
     if (status) {
@@ -82,6 +125,104 @@ status_t KeyLayoutMap::load(const std::string& filename, sp<KeyLayoutMap>* outMa
     return status;
 }
 
+status_t KeyLayoutMap::loadCompiled(const std::string& filename, sp<KeyLayoutMap>* outMap) {
+    outMap->clear();
+
+    std::unique_ptr<CompiledKeyMapReader> reader;
+    status_t status = CompiledKeyMapReader::open(filename, &reader);
+    if (status) {
+        ALOGE("Error %d opening compiled key layout map file %s.", status, filename.c_str());
+        return status;
+    }
+
+    const CompiledHeader* header = reader->read<CompiledHeader>();
+    if (!header || header->magic != COMPILED_MAGIC || header->version != COMPILED_VERSION) {
+        ALOGE("Compiled key layout map file %s has an unsupported format.", filename.c_str());
+        return BAD_VALUE;
+    }
+
+    // Negative counts wrap around to sizes that no file can hold, so reading fails.
+    const CompiledKey* keysByScanCode = reader->read<CompiledKey>(header->keysByScanCodeCount);
+    const CompiledKey* keysByUsageCode = reader->read<CompiledKey>(header->keysByUsageCodeCount);
+    const CompiledAxis* axes = reader->read<CompiledAxis>(header->axesCount);
+    const CompiledLed* ledsByScanCode = reader->read<CompiledLed>(header->ledsByScanCodeCount);
+    const CompiledLed* ledsByUsageCode = reader->read<CompiledLed>(header->ledsByUsageCodeCount);
+    if (!keysByScanCode || !keysByUsageCode || !axes || !ledsByScanCode || !ledsByUsageCode ||
+        !reader->isAtEnd()) {
+        ALOGE("Compiled key layout map file %s is truncated or corrupt.", filename.c_str());
+        return BAD_VALUE;
+    }
+
+    sp<KeyLayoutMap> map = new KeyLayoutMap();
+    map->mKeysByScanCode.setCapacity(header->keysByScanCodeCount);
+    for (int32_t i = 0; i < header->keysByScanCodeCount; i++) {
+        const CompiledKey& key = keysByScanCode[i];
+        map->mKeysByScanCode.add(key.code, Key{key.keyCode, key.flags});
+    }
+    map->mKeysByUsageCode.setCapacity(header->keysByUsageCodeCount);
+    for (int32_t i = 0; i < header->keysByUsageCodeCount; i++) {
+        const CompiledKey& key = keysByUsageCode[i];
+        map->mKeysByUsageCode.add(key.code, Key{key.keyCode, key.flags});
+    }
+    map->mAxes.setCapacity(header->axesCount);
+    for (int32_t i = 0; i < header->axesCount; i++) {
+        const CompiledAxis& axis = axes[i];
+        if (axis.mode < AxisInfo::MODE_NORMAL || axis.mode > AxisInfo::MODE_SPLIT) {
+            ALOGE("Compiled key layout map file %s has an invalid axis mode %d.",
+                  filename.c_str(), axis.mode);
+            return BAD_VALUE;
+        }
+        AxisInfo axisInfo;
+        axisInfo.mode = static_cast<AxisInfo::Mode>(axis.mode);
+        axisInfo.axis = axis.axis;
+        axisInfo.highAxis = axis.highAxis;
+        axisInfo.splitValue = axis.splitValue;
+        axisInfo.flatOverride = axis.flatOverride;
+        map->mAxes.add(axis.scanCode, axisInfo);
+    }
+    map->mLedsByScanCode.setCapacity(header->ledsByScanCodeCount);
+    for (int32_t i = 0; i < header->ledsByScanCodeCount; i++) {
+        map->mLedsByScanCode.add(ledsByScanCode[i].code, Led{ledsByScanCode[i].ledCode});
+    }
+    map->mLedsByUsageCode.setCapacity(header->ledsByUsageCodeCount);
+    for (int32_t i = 0; i < header->ledsByUsageCodeCount; i++) {
+        map->mLedsByUsageCode.add(ledsByUsageCode[i].code, Led{ledsByUsageCode[i].ledCode});
+    }
+
+    *outMap = map;
+    return OK;
+}
+
+status_t KeyLayoutMap::writeCompiled(int fd) const {
+    CompiledKeyMapWriter writer;
+    writer.write(CompiledHeader{COMPILED_MAGIC, COMPILED_VERSION,
+                                static_cast<int32_t>(mKeysByScanCode.size()),
+                                static_cast<int32_t>(mKeysByUsageCode.size()),
+                                static_cast<int32_t>(mAxes.size()),
+                                static_cast<int32_t>(mLedsByScanCode.size()),
+                                static_cast<int32_t>(mLedsByUsageCode.size())});
+    for (size_t i = 0; i < mKeysByScanCode.size(); i++) {
+        const Key& key = mKeysByScanCode.valueAt(i);
+        writer.write(CompiledKey{mKeysByScanCode.keyAt(i), key.keyCode, key.flags});
+    }
+    for (size_t i = 0; i < mKeysByUsageCode.size(); i++) {
+        const Key& key = mKeysByUsageCode.valueAt(i);
+        writer.write(CompiledKey{mKeysByUsageCode.keyAt(i), key.keyCode, key.flags});
+    }
+    for (size_t i = 0; i < mAxes.size(); i++) {
+        const AxisInfo& axis = mAxes.valueAt(i);
+        writer.write(CompiledAxis{mAxes.keyAt(i), static_cast<int32_t>(axis.mode), axis.axis,
+                                  axis.highAxis, axis.splitValue, axis.flatOverride});
+    }
+    for (size_t i = 0; i < mLedsByScanCode.size(); i++) {
+        writer.write(CompiledLed{mLedsByScanCode.keyAt(i), mLedsByScanCode.valueAt(i).ledCode});
+    }
+    for (size_t i = 0; i < mLedsByUsageCode.size(); i++) {
+        writer.write(CompiledLed{mLedsByUsageCode.keyAt(i), mLedsByUsageCode.valueAt(i).ledCode});
+    }
+    return writer.writeTo(fd);
+}
+
 status_t KeyLayoutMap::mapKey(int32_t scanCode, int32_t usageCode,
         int32_t* outKeyCode, uint32_t* outFlags) const {
     const Key* key = getKey(scanCode, usageCode);
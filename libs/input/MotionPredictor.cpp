@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "MotionPredictor"
+
+#include <input/MotionPredictor.h>
+
+#include <math.h>
+#include <algorithm>
+
+namespace android {
+
+// Samples closer together than this are too noisy to estimate a velocity from.
+static const nsecs_t MIN_SAMPLE_DELTA = 2 * 1000000LL;
+
+// Samples further apart than this no longer describe the current movement.
+static const nsecs_t MAX_SAMPLE_DELTA = 50 * 1000000LL;
+
+// --- MotionPredictor::PointerHistory ---
+
+void MotionPredictor::PointerHistory::add(const Sample& sample) {
+    if (count > 0 && sample.time <= samples[count - 1].time) {
+        // Already seen, e.g. the last sample of the previous event repeated as history.
+        return;
+    }
+    if (count == HISTORY_SIZE) {
+        std::move(samples.begin() + 1, samples.end(), samples.begin());
+        count--;
+    }
+    samples[count++] = sample;
+}
+
+// --- MotionPredictor ---
+
+MotionPredictor::MotionPredictor() {
+    clear();
+}
+
+void MotionPredictor::clear() {
+    for (PointerHistory& pointer : mPointers) {
+        pointer.clear();
+    }
+}
+
+size_t MotionPredictor::predict(const MotionEvent& event, nsecs_t targetTime,
+                                Prediction* outPredictions) {
+    const int32_t actionMasked = event.getActionMasked();
+    if (actionMasked == AMOTION_EVENT_ACTION_UP || actionMasked == AMOTION_EVENT_ACTION_CANCEL) {
+        clear();
+        return 0;
+    }
+    if (actionMasked == AMOTION_EVENT_ACTION_DOWN) {
+        clear();
+    }
+
+    const bool isPointerChange = actionMasked == AMOTION_EVENT_ACTION_POINTER_DOWN ||
+            actionMasked == AMOTION_EVENT_ACTION_POINTER_UP;
+    const size_t actionIndex = event.getActionIndex();
+    const nsecs_t eventTime = event.getEventTime();
+    const nsecs_t predictionTime =
+            std::clamp(targetTime, eventTime, eventTime + MAX_PREDICTION_TIME);
+
+    size_t predictionCount = 0;
+    for (size_t i = 0; i < event.getPointerCount(); i++) {
+        const int32_t id = event.getPointerId(i);
+        if (isPointerChange && i == actionIndex) {
+            // A new pointer has no past movement, and a lifted one has no future.
+            mPointers[id].clear();
+            if (actionMasked == AMOTION_EVENT_ACTION_POINTER_UP) {
+                continue;
+            }
+        }
+        addSamples(event, i);
+        outPredictions[predictionCount++] = predictPointer(id, eventTime, predictionTime);
+    }
+    return predictionCount;
+}
+
+void MotionPredictor::addSamples(const MotionEvent& event, size_t pointerIndex) {
+    PointerHistory& pointer = mPointers[event.getPointerId(pointerIndex)];
+    // Only the last samples can be kept, so skip the older historical ones.
+    const size_t historySize = event.getHistorySize();
+    const size_t firstSample = historySize >= HISTORY_SIZE ? historySize + 1 - HISTORY_SIZE : 0;
+    for (size_t h = firstSample; h < historySize; h++) {
+        pointer.add({event.getHistoricalEventTime(h), event.getHistoricalX(pointerIndex, h),
+                     event.getHistoricalY(pointerIndex, h)});
+    }
+    pointer.add({event.getEventTime(), event.getX(pointerIndex), event.getY(pointerIndex)});
+}
+
+MotionPredictor::Prediction MotionPredictor::predictPointer(int32_t id, nsecs_t eventTime,
+                                                            nsecs_t targetTime) const {
+    const PointerHistory& pointer = mPointers[id];
+    const Sample& last = pointer.samples[pointer.count - 1];
+    Prediction prediction{id, last.x, last.y, 0};
+    if (pointer.count < 2) {
+        return prediction;
+    }
+
+    // Extrapolate linearly from the velocity between the last two samples.
+    const Sample& previous = pointer.samples[pointer.count - 2];
+    const nsecs_t delta = last.time - previous.time;
+    if (delta < MIN_SAMPLE_DELTA || delta > MAX_SAMPLE_DELTA) {
+        return prediction;
+    }
+    const float vx = (last.x - previous.x) / delta;
+    const float vy = (last.y - previous.y) / delta;
+    const nsecs_t horizon = targetTime - last.time;
+    prediction.x = last.x + vx * horizon;
+    prediction.y = last.y + vy * horizon;
+
+    // The confidence falls as the horizon grows, and as the velocity changes between samples.
+    // With only two samples, there is no way to tell a steady movement from a turn.
+    float consistency = 0.5f;
+    if (pointer.count > 2) {
+        const Sample& oldest = pointer.samples[pointer.count - 3];
+        const nsecs_t oldDelta = previous.time - oldest.time;
+        if (oldDelta >= MIN_SAMPLE_DELTA && oldDelta <= MAX_SAMPLE_DELTA) {
+            const float oldVx = (previous.x - oldest.x) / oldDelta;
+            const float oldVy = (previous.y - oldest.y) / oldDelta;
+            const float change = hypotf(vx - oldVx, vy - oldVy);
+            const float magnitude = hypotf(vx, vy) + hypotf(oldVx, oldVy);
+            consistency = magnitude > 0 ? std::max(0.f, 1 - change / magnitude) : 1;
+        }
+    }
+    const float horizonFactor =
+            1 - float(std::max(targetTime - eventTime, nsecs_t(0))) / MAX_PREDICTION_TIME;
+    prediction.confidence = consistency * horizonFactor;
+    return prediction;
+}
+
+} // namespace android
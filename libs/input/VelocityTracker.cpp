@@ -23,8 +23,10 @@
 // Log debug messages about the progress of the algorithm itself.
 #define DEBUG_STRATEGY 0
 
+#include <algorithm>
 #include <array>
 #include <inttypes.h>
+#include <iterator>
 #include <limits.h>
 #include <math.h>
 #include <optional>
@@ -170,6 +172,11 @@ VelocityTrackerStrategy* VelocityTracker::createStrategy(const char* strategy) {
         // of the velocity when the finger is released.
         return new LeastSquaresVelocityTrackerStrategy(3);
     }
+    if (!strcmp("lsq2-incremental", strategy)) {
+        // 2nd order least squares with running sums.  Quality: VERY GOOD.
+        // Same estimates as 'lsq2', but each one is computed in constant time.
+        return new IncrementalLeastSquaresVelocityTrackerStrategy();
+    }
     if (!strcmp("wlsq2-delta", strategy)) {
         // 2nd order weighted least squares, delta weighting.  Quality: EXPERIMENTAL
         return new LeastSquaresVelocityTrackerStrategy(2,
@@ -775,6 +782,175 @@ float LeastSquaresVelocityTrackerStrategy::chooseWeight(uint32_t index) const {
 }
 
 
+// --- IncrementalLeastSquaresVelocityTrackerStrategy ---
+
+IncrementalLeastSquaresVelocityTrackerStrategy::IncrementalLeastSquaresVelocityTrackerStrategy() {
+    clear();
+}
+
+IncrementalLeastSquaresVelocityTrackerStrategy::~IncrementalLeastSquaresVelocityTrackerStrategy() {
+}
+
+void IncrementalLeastSquaresVelocityTrackerStrategy::clear() {
+    mPointerIdBits.clear();
+}
+
+void IncrementalLeastSquaresVelocityTrackerStrategy::clearPointers(BitSet32 idBits) {
+    mPointerIdBits.value &= ~idBits.value;
+}
+
+void IncrementalLeastSquaresVelocityTrackerStrategy::addMovement(nsecs_t eventTime,
+        BitSet32 idBits, const VelocityTracker::Position* positions) {
+    // Like in LeastSquaresVelocityTrackerStrategy, a pointer that is missing from a movement
+    // starts a new history when it comes back.
+    BitSet32 previousIdBits = mPointerIdBits;
+    mPointerIdBits = idBits;
+
+    uint32_t index = 0;
+    for (BitSet32 iterBits(idBits); !iterBits.isEmpty();) {
+        uint32_t id = iterBits.clearFirstMarkedBit();
+        State& state = mPointerState[id];
+        const VelocityTracker::Position& position = positions[index++];
+        const Sample sample = {eventTime, position.x, position.y};
+
+        if (!previousIdBits.hasBit(id)) {
+            state.oldest = 0;
+            state.count = 0;
+        } else if (state.getNewest().eventTime == eventTime) {
+            // Movements with the same time replace each other, see
+            // LeastSquaresVelocityTrackerStrategy::addMovement.
+            Sample& newest = state.samples[(state.oldest + state.count - 1) % HISTORY_SIZE];
+            accumulate(state, newest, -1);
+            newest = sample;
+            accumulate(state, newest, 1);
+            continue;
+        } else if (state.count == HISTORY_SIZE) {
+            accumulate(state, state.samples[state.oldest], -1);
+            state.oldest = (state.oldest + 1) % HISTORY_SIZE;
+            state.count -= 1;
+        }
+
+        state.samples[(state.oldest + state.count) % HISTORY_SIZE] = sample;
+        state.count += 1;
+        while (eventTime - state.samples[state.oldest].eventTime > HORIZON) {
+            accumulate(state, state.samples[state.oldest], -1);
+            state.oldest = (state.oldest + 1) % HISTORY_SIZE;
+            state.count -= 1;
+        }
+
+        // Removing old samples from the sums loses precision, and the sums of the powers of
+        // the times grow with the age of the time base, so the sums are recomputed once the
+        // time base is out of the horizon. This happens at most once per HORIZON.
+        if (state.count == 1 || eventTime - state.timeBase > HORIZON) {
+            rebase(state);
+        } else {
+            accumulate(state, sample, 1);
+        }
+    }
+}
+
+void IncrementalLeastSquaresVelocityTrackerStrategy::accumulate(State& state,
+        const Sample& sample, double sign) {
+    const double t = (sample.eventTime - state.timeBase) * 0.000000001;
+    double tk = sign;
+    for (size_t k = 0; k < 5; k++) {
+        state.sumT[k] += tk;
+        if (k < 3) {
+            state.sumX[k] += tk * sample.x;
+            state.sumY[k] += tk * sample.y;
+        }
+        tk *= t;
+    }
+}
+
+void IncrementalLeastSquaresVelocityTrackerStrategy::rebase(State& state) {
+    state.timeBase = state.getNewest().eventTime;
+    std::fill(std::begin(state.sumT), std::end(state.sumT), 0);
+    std::fill(std::begin(state.sumX), std::end(state.sumX), 0);
+    std::fill(std::begin(state.sumY), std::end(state.sumY), 0);
+    for (size_t i = 0; i < state.count; i++) {
+        accumulate(state, state.samples[(state.oldest + i) % HISTORY_SIZE], 1);
+    }
+}
+
+/**
+ * Solves the least squares fit of y = c + b*t + a*t^2, or of y = c + b*t if degree is 1, from
+ * the sums of t^k and y*t^k over the samples.
+ * Returns the coefficients {c, b, a}, or nullopt if the times of the samples cannot determine
+ * the fit.
+ */
+static std::optional<std::array<double, 3>> solveLeastSquaresFromSums(const double* sumT,
+        const double* sumY, uint32_t degree) {
+    const double n = sumT[0];
+    const double Sxx = sumT[2] - sumT[1] * sumT[1] / n;
+    const double Sxy = sumY[1] - sumT[1] * sumY[0] / n;
+    if (degree == 1) {
+        // Same threshold as the QR decomposition of solveLeastSquares.
+        if (Sxx < 0.000001 * 0.000001) {
+            return std::nullopt;
+        }
+        const double b = Sxy / Sxx;
+        return std::make_optional(std::array<double, 3>({(sumY[0] - b * sumT[1]) / n, b, 0}));
+    }
+
+    const double Sxx2 = sumT[3] - sumT[1] * sumT[2] / n;
+    const double Sx2y = sumY[2] - sumT[2] * sumY[0] / n;
+    const double Sx2x2 = sumT[4] - sumT[2] * sumT[2] / n;
+    // The denominator is 0 in exact arithmetic when the samples have fewer than 3 distinct
+    // times, which rounding errors turn into a tiny value rather than exactly 0.
+    const double denominator = Sxx * Sx2x2 - Sxx2 * Sxx2;
+    if (denominator <= Sxx * Sx2x2 * 0.000000001) {
+        return std::nullopt;
+    }
+    const double a = (Sx2y * Sxx - Sxy * Sxx2) / denominator;
+    const double b = (Sxy * Sx2x2 - Sx2y * Sxx2) / denominator;
+    const double c = (sumY[0] - b * sumT[1] - a * sumT[2]) / n;
+    return std::make_optional(std::array<double, 3>({c, b, a}));
+}
+
+bool IncrementalLeastSquaresVelocityTrackerStrategy::getEstimator(uint32_t id,
+        VelocityTracker::Estimator* outEstimator) const {
+    outEstimator->clear();
+    if (!mPointerIdBits.hasBit(id)) {
+        return false; // no data
+    }
+
+    const State& state = mPointerState[id];
+    const Sample& newest = state.getNewest();
+    outEstimator->time = newest.eventTime;
+    outEstimator->confidence = 1;
+    const uint32_t degree = std::min(state.count - 1, size_t(2));
+    if (degree >= 1) {
+        std::optional<std::array<double, 3>> xCoeff =
+                solveLeastSquaresFromSums(state.sumT, state.sumX, degree);
+        std::optional<std::array<double, 3>> yCoeff =
+                solveLeastSquaresFromSums(state.sumT, state.sumY, degree);
+        if (xCoeff && yCoeff) {
+            // Shift the polynomials from the time base to the time of the newest sample, like
+            // LeastSquaresVelocityTrackerStrategy: p(t + T) = (c + bT + aT^2) + (b + 2aT)t + at^2
+            const double T = (newest.eventTime - state.timeBase) * 0.000000001;
+            const std::array<double, 3>& x = *xCoeff;
+            const std::array<double, 3>& y = *yCoeff;
+            outEstimator->degree = degree;
+            outEstimator->xCoeff[0] = x[0] + x[1] * T + x[2] * T * T;
+            outEstimator->yCoeff[0] = y[0] + y[1] * T + y[2] * T * T;
+            outEstimator->xCoeff[1] = x[1] + 2 * x[2] * T;
+            outEstimator->yCoeff[1] = y[1] + 2 * y[2] * T;
+            if (degree == 2) {
+                outEstimator->xCoeff[2] = x[2];
+                outEstimator->yCoeff[2] = y[2];
+            }
+            return true;
+        }
+    }
+
+    // No velocity data available for this pointer, but we do have its current position.
+    outEstimator->xCoeff[0] = newest.x;
+    outEstimator->yCoeff[0] = newest.y;
+    outEstimator->degree = 0;
+    return true;
+}
+
 // --- IntegratingVelocityTrackerStrategy ---
 
 IntegratingVelocityTrackerStrategy::IntegratingVelocityTrackerStrategy(uint32_t degree) :
@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <android-base/file.h>
+#include <android-base/unique_fd.h>
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <input/KeyCharacterMap.h>
+#include <input/KeyLayoutMap.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace android {
+
+static const char* KEY_LAYOUT_CONTENTS =
+        "key 30 A\n"
+        "key 48 B VIRTUAL\n"
+        "key usage 0x0c0067 EQUALS\n"
+        "axis 0x00 X\n"
+        "axis 0x01 invert Y\n"
+        "axis 0x02 split 0x7f GAS BRAKE flat 4\n"
+        "led 0x01 CAPS_LOCK\n"
+        "led usage 0x080002 NUM_LOCK\n";
+
+static const char* KEY_CHARACTER_MAP_CONTENTS =
+        "type FULL\n"
+        "map key 30 B\n"
+        "key A {\n"
+        "    label: 'A'\n"
+        "    number: '2'\n"
+        "    base: 'a'\n"
+        "    shift, capslock: 'A'\n"
+        "    ctrl: fallback MOVE_HOME\n"
+        "}\n"
+        "key B {\n"
+        "    label: 'B'\n"
+        "    base: 'b'\n"
+        "}\n";
+
+// --- CompiledKeyLayoutMapTest ---
+
+static sp<KeyLayoutMap> loadKeyLayoutMap(const std::string& path, const char* contents) {
+    sp<KeyLayoutMap> map;
+    EXPECT_TRUE(base::WriteStringToFile(contents, path));
+    EXPECT_EQ(OK, KeyLayoutMap::load(path, &map));
+    return map;
+}
+
+static void assertKeyLayoutMapsEqual(const sp<KeyLayoutMap>& expected,
+                                     const sp<KeyLayoutMap>& actual) {
+    for (int32_t usageCode : {0, 0x0c0067}) {
+        for (int32_t scanCode : {0, 30, 48, 100}) {
+            int32_t expectedKeyCode, actualKeyCode;
+            uint32_t expectedFlags, actualFlags;
+            ASSERT_EQ(expected->mapKey(scanCode, usageCode, &expectedKeyCode, &expectedFlags),
+                      actual->mapKey(scanCode, usageCode, &actualKeyCode, &actualFlags));
+            ASSERT_EQ(expectedKeyCode, actualKeyCode);
+            ASSERT_EQ(expectedFlags, actualFlags);
+        }
+    }
+
+    for (int32_t scanCode : {0x00, 0x01, 0x02, 0x03}) {
+        AxisInfo expectedAxis, actualAxis;
+        ASSERT_EQ(expected->mapAxis(scanCode, &expectedAxis),
+                  actual->mapAxis(scanCode, &actualAxis));
+        ASSERT_EQ(expectedAxis.mode, actualAxis.mode);
+        ASSERT_EQ(expectedAxis.axis, actualAxis.axis);
+        ASSERT_EQ(expectedAxis.highAxis, actualAxis.highAxis);
+        ASSERT_EQ(expectedAxis.splitValue, actualAxis.splitValue);
+        ASSERT_EQ(expectedAxis.flatOverride, actualAxis.flatOverride);
+    }
+
+    for (int32_t ledCode : {ALED_CAPS_LOCK, ALED_NUM_LOCK}) {
+        int32_t expectedCode = 0, actualCode = 0;
+        ASSERT_EQ(expected->findScanCodeForLed(ledCode, &expectedCode),
+                  actual->findScanCodeForLed(ledCode, &actualCode));
+        ASSERT_EQ(expectedCode, actualCode);
+        ASSERT_EQ(expected->findUsageCodeForLed(ledCode, &expectedCode),
+                  actual->findUsageCodeForLed(ledCode, &actualCode));
+        ASSERT_EQ(expectedCode, actualCode);
+    }
+}
+
+TEST(CompiledKeyLayoutMapTest, LoadCompiled_MatchesTextFile) {
+    TemporaryFile textFile;
+    sp<KeyLayoutMap> map = loadKeyLayoutMap(textFile.path, KEY_LAYOUT_CONTENTS);
+    ASSERT_NE(nullptr, map);
+
+    TemporaryFile compiledFile;
+    ASSERT_EQ(OK, map->writeCompiled(compiledFile.fd));
+    sp<KeyLayoutMap> compiledMap;
+    ASSERT_EQ(OK, KeyLayoutMap::loadCompiled(compiledFile.path, &compiledMap));
+    ASSERT_NO_FATAL_FAILURE(assertKeyLayoutMapsEqual(map, compiledMap));
+}
+
+TEST(CompiledKeyLayoutMapTest, Load_PrefersCompiledFile) {
+    TemporaryFile textFile;
+    sp<KeyLayoutMap> map = loadKeyLayoutMap(textFile.path, KEY_LAYOUT_CONTENTS);
+    ASSERT_NE(nullptr, map);
+
+    std::string compiledPath = std::string(textFile.path) + ".bin";
+    base::unique_fd compiledFd(open(compiledPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600));
+    ASSERT_GE(compiledFd.get(), 0);
+    ASSERT_EQ(OK, map->writeCompiled(compiledFd.get()));
+
+    // The text file no longer maps scan code 30, but the compiled file does.
+    ASSERT_TRUE(base::WriteStringToFile("key 48 B\n", textFile.path));
+    struct timespec past[2] = {{0, 0}, {0, 0}};
+    ASSERT_EQ(0, utimensat(AT_FDCWD, textFile.path, past, 0));
+
+    sp<KeyLayoutMap> loadedMap;
+    ASSERT_EQ(OK, KeyLayoutMap::load(textFile.path, &loadedMap));
+    int32_t keyCode;
+    uint32_t flags;
+    ASSERT_EQ(OK, loadedMap->mapKey(30, 0, &keyCode, &flags));
+    ASSERT_EQ(AKEYCODE_A, keyCode);
+    unlink(compiledPath.c_str());
+}
+
+TEST(CompiledKeyLayoutMapTest, LoadCompiled_RejectsTruncatedFile) {
+    TemporaryFile textFile;
+    sp<KeyLayoutMap> map = loadKeyLayoutMap(textFile.path, KEY_LAYOUT_CONTENTS);
+    ASSERT_NE(nullptr, map);
+
+    TemporaryFile compiledFile;
+    ASSERT_EQ(OK, map->writeCompiled(compiledFile.fd));
+    struct stat st;
+    ASSERT_EQ(0, fstat(compiledFile.fd, &st));
+    ASSERT_EQ(0, ftruncate(compiledFile.fd, st.st_size - sizeof(int32_t)));
+
+    sp<KeyLayoutMap> compiledMap;
+    ASSERT_EQ(BAD_VALUE, KeyLayoutMap::loadCompiled(compiledFile.path, &compiledMap));
+    ASSERT_EQ(nullptr, compiledMap);
+}
+
+// --- CompiledKeyCharacterMapTest ---
+
+TEST(CompiledKeyCharacterMapTest, LoadCompiled_MatchesTextContents) {
+    sp<KeyCharacterMap> map;
+    ASSERT_EQ(OK,
+              KeyCharacterMap::loadContents("test.kcm", KEY_CHARACTER_MAP_CONTENTS,
+                                            KeyCharacterMap::FORMAT_BASE, &map));
+
+    TemporaryFile compiledFile;
+    ASSERT_EQ(OK, map->writeCompiled(compiledFile.fd));
+    sp<KeyCharacterMap> compiledMap;
+    ASSERT_EQ(OK,
+              KeyCharacterMap::loadCompiled(compiledFile.path, KeyCharacterMap::FORMAT_BASE,
+                                            &compiledMap));
+
+    ASSERT_EQ(map->getKeyboardType(), compiledMap->getKeyboardType());
+    for (int32_t keyCode : {AKEYCODE_A, AKEYCODE_B, AKEYCODE_C}) {
+        ASSERT_EQ(map->getDisplayLabel(keyCode), compiledMap->getDisplayLabel(keyCode));
+        ASSERT_EQ(map->getNumber(keyCode), compiledMap->getNumber(keyCode));
+        for (int32_t metaState : {0, AMETA_SHIFT_ON, AMETA_CAPS_LOCK_ON, AMETA_CTRL_ON}) {
+            ASSERT_EQ(map->getCharacter(keyCode, metaState),
+                      compiledMap->getCharacter(keyCode, metaState));
+
+            KeyCharacterMap::FallbackAction expected, actual;
+            ASSERT_EQ(map->getFallbackAction(keyCode, metaState, &expected),
+                      compiledMap->getFallbackAction(keyCode, metaState, &actual));
+            ASSERT_EQ(expected.keyCode, actual.keyCode);
+            ASSERT_EQ(expected.metaState, actual.metaState);
+        }
+    }
+
+    int32_t expectedKeyCode, actualKeyCode;
+    ASSERT_EQ(map->mapKey(30, 0, &expectedKeyCode), compiledMap->mapKey(30, 0, &actualKeyCode));
+    ASSERT_EQ(expectedKeyCode, actualKeyCode);
+}
+
+TEST(CompiledKeyCharacterMapTest, LoadCompiled_RejectsMismatchedFormat) {
+    sp<KeyCharacterMap> map;
+    ASSERT_EQ(OK,
+              KeyCharacterMap::loadContents("test.kcm", KEY_CHARACTER_MAP_CONTENTS,
+                                            KeyCharacterMap::FORMAT_BASE, &map));
+
+    TemporaryFile compiledFile;
+    ASSERT_EQ(OK, map->writeCompiled(compiledFile.fd));
+    sp<KeyCharacterMap> compiledMap;
+    ASSERT_EQ(BAD_VALUE,
+              KeyCharacterMap::loadCompiled(compiledFile.path, KeyCharacterMap::FORMAT_OVERLAY,
+                                            &compiledMap));
+    ASSERT_EQ(nullptr, compiledMap);
+}
+
+} // namespace android
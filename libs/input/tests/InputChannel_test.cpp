@@ -21,8 +21,10 @@
 #include <unistd.h>
 #include <time.h>
 #include <errno.h>
+#include <poll.h>
 
 #include <binder/Binder.h>
+#include <binder/Parcel.h>
 #include <gtest/gtest.h>
 #include <input/InputTransport.h>
 #include <utils/StopWatch.h>
@@ -197,5 +199,131 @@ TEST_F(InputChannelTest, SendAndReceive_MotionClassification) {
     }
 }
 
+static bool isReadable(const sp<InputChannel>& channel) {
+    struct pollfd pfd = {.fd = channel->getFd(), .events = POLLIN};
+    return poll(&pfd, 1, 0 /*timeout*/) == 1;
+}
+
+TEST_F(InputChannelTest, SharedMemory_SendAndReceive) {
+    sp<InputChannel> serverChannel, clientChannel;
+    ASSERT_EQ(OK,
+              InputChannel::openInputChannelPair("channel name", serverChannel, clientChannel,
+                                                 true /*useSharedMemory*/));
+    EXPECT_TRUE(serverChannel->usesSharedMemory());
+    EXPECT_TRUE(clientChannel->usesSharedMemory());
+
+    InputMessage serverMsg = {}, clientMsg;
+    serverMsg.header.type = InputMessage::Type::KEY;
+    serverMsg.body.key.action = AKEY_EVENT_ACTION_DOWN;
+    EXPECT_EQ(OK, serverChannel->sendMessage(&serverMsg));
+    EXPECT_EQ(OK, clientChannel->receiveMessage(&clientMsg));
+    EXPECT_EQ(serverMsg.header.type, clientMsg.header.type);
+    EXPECT_EQ(serverMsg.body.key.action, clientMsg.body.key.action);
+
+    InputMessage clientReply = {}, serverReply;
+    clientReply.header.type = InputMessage::Type::FINISHED;
+    clientReply.body.finished.seq = 0x11223344;
+    clientReply.body.finished.handled = true;
+    EXPECT_EQ(OK, clientChannel->sendMessage(&clientReply));
+    EXPECT_EQ(OK, serverChannel->receiveMessage(&serverReply));
+    EXPECT_EQ(clientReply.header.type, serverReply.header.type);
+    EXPECT_EQ(clientReply.body.finished.seq, serverReply.body.finished.seq);
+    EXPECT_EQ(clientReply.body.finished.handled, serverReply.body.finished.handled);
+
+    EXPECT_EQ(WOULD_BLOCK, clientChannel->receiveMessage(&clientMsg));
+    EXPECT_EQ(WOULD_BLOCK, serverChannel->receiveMessage(&serverReply));
+}
+
+TEST_F(InputChannelTest, SharedMemory_FdIsReadableWhileMessagesArePending) {
+    sp<InputChannel> serverChannel, clientChannel;
+    ASSERT_EQ(OK,
+              InputChannel::openInputChannelPair("channel name", serverChannel, clientChannel,
+                                                 true /*useSharedMemory*/));
+    EXPECT_FALSE(isReadable(clientChannel));
+
+    InputMessage serverMsg = {}, clientMsg;
+    serverMsg.header.type = InputMessage::Type::KEY;
+    for (int32_t i = 0; i < 3; i++) {
+        serverMsg.body.key.seq = i + 1;
+        ASSERT_EQ(OK, serverChannel->sendMessage(&serverMsg));
+    }
+
+    for (int32_t i = 0; i < 3; i++) {
+        EXPECT_TRUE(isReadable(clientChannel));
+        ASSERT_EQ(OK, clientChannel->receiveMessage(&clientMsg));
+        EXPECT_EQ(uint32_t(i + 1), clientMsg.body.key.seq);
+    }
+    EXPECT_EQ(WOULD_BLOCK, clientChannel->receiveMessage(&clientMsg));
+    EXPECT_FALSE(isReadable(clientChannel));
+
+    ASSERT_EQ(OK, serverChannel->sendMessage(&serverMsg));
+    EXPECT_TRUE(isReadable(clientChannel));
+}
+
+TEST_F(InputChannelTest, SharedMemory_WhenFull_ReturnsWouldBlock) {
+    sp<InputChannel> serverChannel, clientChannel;
+    ASSERT_EQ(OK,
+              InputChannel::openInputChannelPair("channel name", serverChannel, clientChannel,
+                                                 true /*useSharedMemory*/));
+
+    InputMessage serverMsg = {}, clientMsg;
+    serverMsg.header.type = InputMessage::Type::MOTION;
+    serverMsg.body.motion.pointerCount = MAX_POINTERS;
+    status_t result;
+    size_t sentCount = 0;
+    while ((result = serverChannel->sendMessage(&serverMsg)) == OK) {
+        sentCount++;
+    }
+    ASSERT_EQ(WOULD_BLOCK, result);
+    ASSERT_GT(sentCount, 0u);
+
+    ASSERT_EQ(OK, clientChannel->receiveMessage(&clientMsg));
+    EXPECT_EQ(OK, serverChannel->sendMessage(&serverMsg));
+    for (size_t i = 0; i < sentCount; i++) {
+        ASSERT_EQ(OK, clientChannel->receiveMessage(&clientMsg));
+        EXPECT_EQ(uint32_t(MAX_POINTERS), clientMsg.body.motion.pointerCount);
+    }
+    EXPECT_EQ(WOULD_BLOCK, clientChannel->receiveMessage(&clientMsg));
+}
+
+TEST_F(InputChannelTest, SharedMemory_WhenPeerClosed_ReturnsAnError) {
+    sp<InputChannel> serverChannel, clientChannel;
+    ASSERT_EQ(OK,
+              InputChannel::openInputChannelPair("channel name", serverChannel, clientChannel,
+                                                 true /*useSharedMemory*/));
+
+    InputMessage serverMsg = {}, clientMsg;
+    serverMsg.header.type = InputMessage::Type::KEY;
+    ASSERT_EQ(OK, serverChannel->sendMessage(&serverMsg));
+    serverChannel.clear(); // close server channel
+
+    // Messages sent before the peer was closed are still received.
+    EXPECT_EQ(OK, clientChannel->receiveMessage(&clientMsg));
+    EXPECT_EQ(DEAD_OBJECT, clientChannel->receiveMessage(&clientMsg));
+    clientMsg.header.type = InputMessage::Type::FINISHED;
+    EXPECT_EQ(DEAD_OBJECT, clientChannel->sendMessage(&clientMsg));
+}
+
+TEST_F(InputChannelTest, SharedMemory_WriteAndRead) {
+    sp<InputChannel> serverChannel, clientChannel;
+    ASSERT_EQ(OK,
+              InputChannel::openInputChannelPair("channel name", serverChannel, clientChannel,
+                                                 true /*useSharedMemory*/));
+
+    Parcel parcel;
+    ASSERT_EQ(OK, clientChannel->write(parcel));
+    parcel.setDataPosition(0);
+    sp<InputChannel> readChannel = InputChannel::read(parcel);
+    ASSERT_NE(nullptr, readChannel);
+    EXPECT_TRUE(readChannel->usesSharedMemory());
+    EXPECT_EQ(clientChannel->getConnectionToken(), readChannel->getConnectionToken());
+
+    InputMessage serverMsg = {}, clientMsg;
+    serverMsg.header.type = InputMessage::Type::KEY;
+    serverMsg.body.key.seq = 7;
+    ASSERT_EQ(OK, serverChannel->sendMessage(&serverMsg));
+    ASSERT_EQ(OK, readChannel->receiveMessage(&clientMsg));
+    EXPECT_EQ(7u, clientMsg.body.key.seq);
+}
 
 } // namespace android
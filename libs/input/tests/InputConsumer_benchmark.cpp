@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <input/InputTransport.h>
+
+// Usage: atest libinput_benchmarks
+
+namespace android {
+namespace {
+
+constexpr nsecs_t kSampleInterval = 4 * 1000000; // 240 Hz
+constexpr size_t kSamplesPerFrame = 2;
+
+status_t publishMotion(InputPublisher& publisher, uint32_t seq, int32_t action, nsecs_t eventTime,
+                       uint32_t pointerCount) {
+    PointerProperties properties[MAX_POINTERS];
+    PointerCoords coords[MAX_POINTERS];
+    for (uint32_t i = 0; i < pointerCount; i++) {
+        properties[i].clear();
+        properties[i].id = i;
+        properties[i].toolType = AMOTION_EVENT_TOOL_TYPE_FINGER;
+        coords[i].clear();
+        const float t = eventTime * 1E-9f;
+        coords[i].setAxisValue(AMOTION_EVENT_AXIS_X, 100 * i + 1000 * t);
+        coords[i].setAxisValue(AMOTION_EVENT_AXIS_Y, 50 * i + 2000 * t);
+        coords[i].setAxisValue(AMOTION_EVENT_AXIS_PRESSURE, 0.5);
+        coords[i].setAxisValue(AMOTION_EVENT_AXIS_SIZE, 0.1);
+    }
+    return publisher.publishMotionEvent(seq, InputEvent::nextId(), 1 /*deviceId*/,
+                                        AINPUT_SOURCE_TOUCHSCREEN, ADISPLAY_ID_DEFAULT,
+                                        INVALID_HMAC, action, 0 /*actionButton*/, 0 /*flags*/,
+                                        AMOTION_EVENT_EDGE_FLAG_NONE, AMETA_NONE,
+                                        0 /*buttonState*/, MotionClassification::NONE,
+                                        1 /*xScale*/, 1 /*yScale*/, 0 /*xOffset*/, 0 /*yOffset*/,
+                                        0 /*xPrecision*/, 0 /*yPrecision*/,
+                                        AMOTION_EVENT_INVALID_CURSOR_POSITION,
+                                        AMOTION_EVENT_INVALID_CURSOR_POSITION, 0 /*downTime*/,
+                                        eventTime, pointerCount, properties, coords);
+}
+
+// Publishes the moves of 'pointerCount' pointers of one frame, and consumes them as a single
+// batch with resampling, like an application's choreographer callback.
+void BM_consumeBatchedMoves(benchmark::State& state) {
+    const uint32_t pointerCount = static_cast<uint32_t>(state.range(0));
+    sp<InputChannel> serverChannel, clientChannel;
+    if (InputChannel::openInputChannelPair("benchmark", serverChannel, clientChannel) != OK) {
+        state.SkipWithError("Could not open the input channels");
+        return;
+    }
+    InputPublisher publisher(serverChannel);
+    InputConsumer consumer(clientChannel);
+    PreallocatedInputEventFactory factory;
+    std::vector<InputFinishedSignal> finishedSignals;
+
+    uint32_t seq = 1;
+    nsecs_t eventTime = kSampleInterval;
+    publishMotion(publisher, seq++, AMOTION_EVENT_ACTION_DOWN, eventTime, pointerCount);
+    for (auto _ : state) {
+        for (size_t i = 0; i < kSamplesPerFrame; i++) {
+            eventTime += kSampleInterval;
+            publishMotion(publisher, seq++, AMOTION_EVENT_ACTION_MOVE, eventTime, pointerCount);
+        }
+
+        uint32_t consumeSeq;
+        InputEvent* event;
+        while (consumer.consume(&factory, true /*consumeBatches*/, eventTime + kSampleInterval,
+                                &consumeSeq, &event) == OK) {
+            benchmark::DoNotOptimize(event);
+            consumer.sendFinishedSignal(consumeSeq, true /*handled*/);
+        }
+
+        finishedSignals.clear();
+        while (publisher.receiveFinishedSignals(&finishedSignals) == OK) {
+        }
+    }
+}
+BENCHMARK(BM_consumeBatchedMoves)->Arg(1)->Arg(2)->Arg(5)->Arg(10);
+
+} // namespace
+} // namespace android
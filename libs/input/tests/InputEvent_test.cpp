@@ -545,6 +545,38 @@ TEST_F(MotionEventTest, Parcel) {
     ASSERT_NO_FATAL_FAILURE(assertEqualsEventWithHistory(&outEvent));
 }
 
+TEST_F(MotionEventTest, Parcel_WithDifferentAxesPerSample) {
+    Parcel parcel;
+
+    MotionEvent inEvent;
+    initializeEventWithHistory(&inEvent);
+    PointerCoords coords[2];
+    for (size_t i = 0; i < 2; i++) {
+        coords[i].copyFrom(*inEvent.getRawPointerCoords(i));
+        coords[i].setAxisValue(AMOTION_EVENT_AXIS_SCROLL, 300 + i);
+    }
+    inEvent.addSample(ARBITRARY_EVENT_TIME + 3, coords);
+    MotionEvent outEvent;
+
+    // Round trip.
+    inEvent.writeToParcel(&parcel);
+    parcel.setDataPosition(0);
+    outEvent.readFromParcel(&parcel);
+
+    ASSERT_EQ(inEvent.getHistorySize(), outEvent.getHistorySize());
+    for (size_t h = 0; h < inEvent.getHistorySize(); h++) {
+        ASSERT_EQ(inEvent.getHistoricalEventTime(h), outEvent.getHistoricalEventTime(h));
+        for (size_t i = 0; i < 2; i++) {
+            ASSERT_EQ(*inEvent.getHistoricalRawPointerCoords(i, h),
+                      *outEvent.getHistoricalRawPointerCoords(i, h));
+        }
+    }
+    for (size_t i = 0; i < 2; i++) {
+        ASSERT_EQ(*inEvent.getRawPointerCoords(i), *outEvent.getRawPointerCoords(i));
+        ASSERT_EQ(300 + i, outEvent.getAxisValue(AMOTION_EVENT_AXIS_SCROLL, i));
+    }
+}
+
 static void setRotationMatrix(float matrix[9], float angle) {
     float sin = sinf(angle);
     float cos = cosf(angle);
@@ -394,4 +394,106 @@ TEST_F(InputPublisherAndConsumerTest, PublishMultipleEvents_EndToEnd) {
     ASSERT_NO_FATAL_FAILURE(PublishAndConsumeKeyEvent());
 }
 
+TEST_F(InputPublisherAndConsumerTest, SendFinishedSignals_SendsOneMessage) {
+    ASSERT_EQ(OK, mConsumer->sendFinishedSignals({{1, true}, {2, false}, {3, true}}));
+
+    std::vector<InputFinishedSignal> signals;
+    ASSERT_EQ(OK, mPublisher->receiveFinishedSignals(&signals));
+    ASSERT_EQ(3u, signals.size());
+    EXPECT_EQ(1u, signals[0].seq);
+    EXPECT_TRUE(signals[0].handled);
+    EXPECT_EQ(2u, signals[1].seq);
+    EXPECT_FALSE(signals[1].handled);
+    EXPECT_EQ(3u, signals[2].seq);
+    EXPECT_TRUE(signals[2].handled);
+
+    EXPECT_EQ(WOULD_BLOCK, mPublisher->receiveFinishedSignals(&signals));
+}
+
+TEST_F(InputPublisherAndConsumerTest, SendFinishedSignals_SplitsLargeBatches) {
+    std::vector<InputFinishedSignal> sentSignals;
+    for (uint32_t seq = 1; seq <= InputMessage::MAX_FINISHED_BATCH_SIZE + 1; seq++) {
+        sentSignals.push_back({seq, true});
+    }
+    ASSERT_EQ(OK, mConsumer->sendFinishedSignals(sentSignals));
+
+    std::vector<InputFinishedSignal> signals;
+    ASSERT_EQ(OK, mPublisher->receiveFinishedSignals(&signals));
+    EXPECT_EQ(InputMessage::MAX_FINISHED_BATCH_SIZE, signals.size());
+    ASSERT_EQ(OK, mPublisher->receiveFinishedSignals(&signals));
+    ASSERT_EQ(sentSignals.size(), signals.size());
+    for (size_t i = 0; i < signals.size(); i++) {
+        EXPECT_EQ(sentSignals[i].seq, signals[i].seq);
+    }
+}
+
+TEST_F(InputPublisherAndConsumerTest, ReceiveFinishedSignal_ReturnsBatchedSignalsOneByOne) {
+    ASSERT_EQ(OK, mConsumer->sendFinishedSignals({{1, true}, {2, false}}));
+
+    uint32_t finishedSeq = 0;
+    bool handled = false;
+    ASSERT_EQ(OK, mPublisher->receiveFinishedSignal(&finishedSeq, &handled));
+    EXPECT_EQ(1u, finishedSeq);
+    EXPECT_TRUE(handled);
+    ASSERT_EQ(OK, mPublisher->receiveFinishedSignal(&finishedSeq, &handled));
+    EXPECT_EQ(2u, finishedSeq);
+    EXPECT_FALSE(handled);
+    EXPECT_EQ(WOULD_BLOCK, mPublisher->receiveFinishedSignal(&finishedSeq, &handled));
+}
+
+TEST_F(InputPublisherAndConsumerTest, SendFinishedSignals_ReportsConsumeTime) {
+    constexpr uint32_t seq = 15;
+    ASSERT_EQ(OK,
+              mPublisher->publishKeyEvent(seq, InputEvent::nextId(), 1 /*deviceId*/,
+                                          AINPUT_SOURCE_KEYBOARD, ADISPLAY_ID_DEFAULT, {},
+                                          AKEY_EVENT_ACTION_DOWN, 0 /*flags*/, AKEYCODE_ENTER,
+                                          13 /*scanCode*/, 0 /*metaState*/, 0 /*repeatCount*/,
+                                          3 /*downTime*/, 4 /*eventTime*/));
+
+    const nsecs_t timeBeforeConsume = systemTime(SYSTEM_TIME_MONOTONIC);
+    uint32_t consumeSeq;
+    InputEvent* event;
+    ASSERT_EQ(OK,
+              mConsumer->consume(&mEventFactory, true /*consumeBatches*/, -1, &consumeSeq, &event));
+    const nsecs_t timeAfterConsume = systemTime(SYSTEM_TIME_MONOTONIC);
+    ASSERT_EQ(OK, mConsumer->sendFinishedSignals({{seq, true}, {seq + 1, true}}));
+
+    std::vector<InputFinishedSignal> signals;
+    ASSERT_EQ(OK, mPublisher->receiveFinishedSignals(&signals));
+    ASSERT_EQ(2u, signals.size());
+    EXPECT_GE(signals[0].consumeTime, timeBeforeConsume);
+    EXPECT_LE(signals[0].consumeTime, timeAfterConsume);
+    // The consumer never read an event with the second sequence number.
+    EXPECT_EQ(0, signals[1].consumeTime);
+}
+
+TEST_F(InputPublisherAndConsumerTest, SendFinishedSignals_WhenSequenceNumberIsZero_ReturnsError) {
+    EXPECT_EQ(BAD_VALUE, mConsumer->sendFinishedSignals({{1, true}, {0, true}}));
+
+    std::vector<InputFinishedSignal> signals;
+    EXPECT_EQ(WOULD_BLOCK, mPublisher->receiveFinishedSignals(&signals));
+}
+
+class InputPublisherAndConsumerSharedMemoryTest : public InputPublisherAndConsumerTest {
+protected:
+    void SetUp() override {
+        status_t result = InputChannel::openInputChannelPair("channel name", serverChannel,
+                                                             clientChannel,
+                                                             true /*useSharedMemory*/);
+        ASSERT_EQ(OK, result);
+
+        mPublisher = new InputPublisher(serverChannel);
+        mConsumer = new InputConsumer(clientChannel);
+    }
+};
+
+TEST_F(InputPublisherAndConsumerSharedMemoryTest, PublishMultipleEvents_EndToEnd) {
+    ASSERT_NO_FATAL_FAILURE(PublishAndConsumeMotionEvent());
+    ASSERT_NO_FATAL_FAILURE(PublishAndConsumeKeyEvent());
+    ASSERT_NO_FATAL_FAILURE(PublishAndConsumeMotionEvent());
+    ASSERT_NO_FATAL_FAILURE(PublishAndConsumeFocusEvent());
+    ASSERT_NO_FATAL_FAILURE(PublishAndConsumeMotionEvent());
+    ASSERT_NO_FATAL_FAILURE(PublishAndConsumeKeyEvent());
+}
+
 } // namespace android
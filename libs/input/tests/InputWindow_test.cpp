@@ -99,5 +99,44 @@ TEST(InputWindowInfo, Parcelling) {
     ASSERT_EQ(i.touchableRegionCropHandle, i2.touchableRegionCropHandle);
 }
 
+TEST(InputWindowInfo, Equality) {
+    sp<IBinder> touchableRegionCropHandle = new BBinder();
+    InputWindowInfo i;
+    i.token = new BBinder();
+    i.id = 1;
+    i.name = "Foobar";
+    i.frameRight = 16;
+    i.frameBottom = 19;
+    i.addTouchableRegion(Rect(0, 0, 16, 19));
+    i.applicationInfo.name = "Application";
+    i.applicationInfo.dispatchingTimeout = 12;
+    i.touchableRegionCropHandle = touchableRegionCropHandle;
+
+    InputWindowInfo i2 = i;
+    ASSERT_TRUE(i == i2);
+
+    i2.frameRight = 17;
+    ASSERT_FALSE(i == i2);
+
+    i2 = i;
+    i2.hasFocus = true;
+    ASSERT_TRUE(i != i2);
+
+    // The touchable region is compared by its rects
+    i2 = i;
+    i2.touchableRegion = Region(Rect(0, 0, 16, 19));
+    ASSERT_TRUE(i == i2);
+    i2.addTouchableRegion(Rect(0, 0, 20, 20));
+    ASSERT_FALSE(i == i2);
+
+    i2 = i;
+    i2.applicationInfo.name = "Other application";
+    ASSERT_FALSE(i == i2);
+
+    i2 = i;
+    i2.touchableRegionCropHandle = nullptr;
+    ASSERT_FALSE(i == i2);
+}
+
 } // namespace test
 } // namespace android
@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <input/MotionPredictor.h>
+
+namespace android {
+
+static constexpr nsecs_t MS = 1000000;
+
+/**
+ * Creates an event with a single pointer at (x, y) for each of the given times, the last one
+ * being the current sample and the others historical samples.
+ */
+static MotionEvent createMotionEvent(int32_t action, const std::vector<nsecs_t>& times,
+                                     float x0, float vx, float y0 = 0, float vy = 0) {
+    PointerProperties properties;
+    properties.clear();
+    properties.id = 0;
+    properties.toolType = AMOTION_EVENT_TOOL_TYPE_FINGER;
+
+    auto coordsAt = [&](nsecs_t time) {
+        PointerCoords coords;
+        coords.clear();
+        coords.setAxisValue(AMOTION_EVENT_AXIS_X, x0 + vx * time / MS);
+        coords.setAxisValue(AMOTION_EVENT_AXIS_Y, y0 + vy * time / MS);
+        return coords;
+    };
+
+    PointerCoords coords = coordsAt(times[0]);
+    MotionEvent event;
+    event.initialize(InputEvent::nextId(), 0 /*deviceId*/, AINPUT_SOURCE_TOUCHSCREEN,
+                     ADISPLAY_ID_DEFAULT, INVALID_HMAC, action, 0 /*actionButton*/, 0 /*flags*/,
+                     AMOTION_EVENT_EDGE_FLAG_NONE, AMETA_NONE, 0 /*buttonState*/,
+                     MotionClassification::NONE, 1 /*xScale*/, 1 /*yScale*/, 0 /*xOffset*/,
+                     0 /*yOffset*/, 0 /*xPrecision*/, 0 /*yPrecision*/,
+                     AMOTION_EVENT_INVALID_CURSOR_POSITION, AMOTION_EVENT_INVALID_CURSOR_POSITION,
+                     0 /*downTime*/, times[0], 1 /*pointerCount*/, &properties, &coords);
+    for (size_t i = 1; i < times.size(); i++) {
+        coords = coordsAt(times[i]);
+        event.addSample(times[i], &coords);
+    }
+    return event;
+}
+
+TEST(MotionPredictorTest, SteadyMovement_IsExtrapolated) {
+    MotionPredictor predictor;
+    MotionPredictor::Prediction predictions[MAX_POINTERS];
+    MotionEvent down = createMotionEvent(AMOTION_EVENT_ACTION_DOWN, {0}, 100, 1, 200, -2);
+    ASSERT_EQ(1u, predictor.predict(down, 8 * MS, predictions));
+    // Nothing is known about the movement yet.
+    EXPECT_EQ(100, predictions[0].x);
+    EXPECT_EQ(0, predictions[0].confidence);
+
+    MotionEvent move = createMotionEvent(AMOTION_EVENT_ACTION_MOVE, {8 * MS, 16 * MS}, 100, 1,
+                                         200, -2);
+    ASSERT_EQ(1u, predictor.predict(move, 24 * MS, predictions));
+    EXPECT_EQ(0, predictions[0].id);
+    EXPECT_NEAR(124, predictions[0].x, 0.01);
+    EXPECT_NEAR(152, predictions[0].y, 0.01);
+    EXPECT_GT(predictions[0].confidence, 0.5);
+    EXPECT_LE(predictions[0].confidence, 1);
+}
+
+TEST(MotionPredictorTest, ConfidenceDecreasesWithHorizon) {
+    MotionPredictor predictor;
+    MotionPredictor::Prediction near[MAX_POINTERS], far[MAX_POINTERS];
+    MotionEvent move = createMotionEvent(AMOTION_EVENT_ACTION_MOVE, {0, 8 * MS, 16 * MS}, 0, 1);
+    ASSERT_EQ(1u, predictor.predict(move, 20 * MS, near));
+    ASSERT_EQ(1u, predictor.predict(move, 40 * MS, far));
+    EXPECT_GT(near[0].confidence, far[0].confidence);
+}
+
+TEST(MotionPredictorTest, TargetTime_IsClampedToMaxPrediction) {
+    MotionPredictor predictor;
+    MotionPredictor::Prediction predictions[MAX_POINTERS];
+    MotionEvent move = createMotionEvent(AMOTION_EVENT_ACTION_MOVE, {0, 8 * MS, 16 * MS}, 0, 1);
+    ASSERT_EQ(1u, predictor.predict(move, 1000 * MS, predictions));
+    EXPECT_NEAR(16 + MotionPredictor::MAX_PREDICTION_TIME / MS, predictions[0].x, 0.01);
+    EXPECT_EQ(0, predictions[0].confidence);
+}
+
+TEST(MotionPredictorTest, Turn_HasLowerConfidenceThanSteadyMovement) {
+    MotionPredictor steadyPredictor, turnPredictor;
+    MotionPredictor::Prediction steady[MAX_POINTERS], turn[MAX_POINTERS];
+    MotionEvent steadyMove =
+            createMotionEvent(AMOTION_EVENT_ACTION_MOVE, {0, 8 * MS, 16 * MS}, 0, 1);
+    ASSERT_EQ(1u, steadyPredictor.predict(steadyMove, 24 * MS, steady));
+
+    // Move right, then down.
+    turnPredictor.predict(createMotionEvent(AMOTION_EVENT_ACTION_MOVE, {0, 8 * MS}, 0, 1),
+                          8 * MS, turn);
+    ASSERT_EQ(1u,
+              turnPredictor.predict(createMotionEvent(AMOTION_EVENT_ACTION_MOVE, {16 * MS}, 8, 0,
+                                                      -8, 1),
+                                    24 * MS, turn));
+    EXPECT_LT(turn[0].confidence, steady[0].confidence);
+}
+
+TEST(MotionPredictorTest, Up_ReturnsNoPredictions) {
+    MotionPredictor predictor;
+    MotionPredictor::Prediction predictions[MAX_POINTERS];
+    MotionEvent up = createMotionEvent(AMOTION_EVENT_ACTION_UP, {0, 8 * MS}, 0, 1);
+    ASSERT_EQ(0u, predictor.predict(up, 16 * MS, predictions));
+}
+
+} // namespace android
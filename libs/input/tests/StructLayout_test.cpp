@@ -82,6 +82,10 @@ void TestInputMessageAlignment() {
 
   CHECK_OFFSET(InputMessage::Body::Finished, seq, 0);
   CHECK_OFFSET(InputMessage::Body::Finished, handled, 4);
+  CHECK_OFFSET(InputMessage::Body::Finished, consumeTime, 8);
+
+  CHECK_OFFSET(InputMessage::Body::FinishedBatch, count, 0);
+  CHECK_OFFSET(InputMessage::Body::FinishedBatch, entries, 8);
 }
 
 void TestHeaderSize() {
@@ -97,8 +101,10 @@ void TestBodySize() {
     static_assert(sizeof(InputMessage::Body::Motion) ==
                   offsetof(InputMessage::Body::Motion, pointers) +
                           sizeof(InputMessage::Body::Motion::Pointer) * MAX_POINTERS);
-    static_assert(sizeof(InputMessage::Body::Finished) == 8);
+    static_assert(sizeof(InputMessage::Body::Finished) == 16);
     static_assert(sizeof(InputMessage::Body::Focus) == 16);
+    static_assert(sizeof(InputMessage::Body::FinishedBatch) ==
+                  8 + sizeof(InputMessage::Body::Finished) * InputMessage::MAX_FINISHED_BATCH_SIZE);
 }
 
 // --- VerifiedInputEvent ---
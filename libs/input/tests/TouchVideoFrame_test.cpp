@@ -68,6 +68,16 @@ TEST(TouchVideoFrame, Equality) {
     ASSERT_FALSE(frame == changedTimestampFrame);
 }
 
+TEST(TouchVideoFrame, Copy_SharesDataUntilRotated) {
+    TouchVideoFrame frame(2, 2, {1, 2, 3, 4}, TIMESTAMP);
+    TouchVideoFrame copy = frame;
+    ASSERT_EQ(frame.getData().data(), copy.getData().data());
+
+    copy.rotate(DISPLAY_ORIENTATION_180);
+    ASSERT_EQ(std::vector<int16_t>({1, 2, 3, 4}), frame.getData());
+    ASSERT_EQ(std::vector<int16_t>({4, 3, 2, 1}), copy.getData());
+}
+
 // --- Rotate 90 degrees ---
 
 TEST(TouchVideoFrame, Rotate90_0x0) {
@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <input/VelocityTracker.h>
+
+// Usage: atest libinput_benchmarks
+
+namespace android {
+namespace {
+
+constexpr nsecs_t kSampleInterval = 8 * 1000000; // 8 ms
+
+// Adds a move of 'pointerCount' pointers and computes the velocity of each of them, like an
+// application calling computeCurrentVelocity on every move of a fling.
+void BM_addMovementAndGetVelocity(benchmark::State& state, const char* strategy) {
+    const uint32_t pointerCount = static_cast<uint32_t>(state.range(0));
+    VelocityTracker tracker(strategy);
+    BitSet32 idBits;
+    for (uint32_t id = 0; id < pointerCount; id++) {
+        idBits.markBit(id);
+    }
+    VelocityTracker::Position positions[MAX_POINTERS];
+    nsecs_t eventTime = 0;
+    for (auto _ : state) {
+        eventTime += kSampleInterval;
+        const float t = eventTime * 1E-9f;
+        for (uint32_t i = 0; i < pointerCount; i++) {
+            positions[i] = {100 * i + 1000 * t, 50 * i + 2000 * t};
+        }
+        tracker.addMovement(eventTime, idBits, positions);
+        for (uint32_t id = 0; id < pointerCount; id++) {
+            float vx, vy;
+            benchmark::DoNotOptimize(tracker.getVelocity(id, &vx, &vy));
+        }
+    }
+}
+BENCHMARK_CAPTURE(BM_addMovementAndGetVelocity, lsq2, "lsq2")->Arg(1)->Arg(2)->Arg(5);
+BENCHMARK_CAPTURE(BM_addMovementAndGetVelocity, lsq2_incremental, "lsq2-incremental")
+        ->Arg(1)
+        ->Arg(2)
+        ->Arg(5);
+
+} // namespace
+} // namespace android
+
+BENCHMARK_MAIN();
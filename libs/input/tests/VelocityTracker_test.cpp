@@ -217,16 +217,19 @@ static void computeAndCheckVelocity(const char* strategy,
 
 static void computeAndCheckQuadraticEstimate(const std::vector<MotionEventEntry>& motions,
         const std::array<float, 3>& coefficients) {
-    VelocityTracker vt("lsq2");
-    std::vector<MotionEvent> events = createMotionEventStream(motions);
-    for (MotionEvent event : events) {
-        vt.addMovement(&event);
-    }
-    VelocityTracker::Estimator estimator;
-    EXPECT_TRUE(vt.getEstimator(0, &estimator));
-    for (size_t i = 0; i< coefficients.size(); i++) {
-        checkCoefficient(estimator.xCoeff[i], coefficients[i]);
-        checkCoefficient(estimator.yCoeff[i], coefficients[i]);
+    for (const char* strategy : {"lsq2", "lsq2-incremental"}) {
+        SCOPED_TRACE(strategy);
+        VelocityTracker vt(strategy);
+        std::vector<MotionEvent> events = createMotionEventStream(motions);
+        for (MotionEvent event : events) {
+            vt.addMovement(&event);
+        }
+        VelocityTracker::Estimator estimator;
+        EXPECT_TRUE(vt.getEstimator(0, &estimator));
+        for (size_t i = 0; i< coefficients.size(); i++) {
+            checkCoefficient(estimator.xCoeff[i], coefficients[i]);
+            checkCoefficient(estimator.yCoeff[i], coefficients[i]);
+        }
     }
 }
 
@@ -907,4 +910,51 @@ TEST_F(VelocityTrackerTest, LeastSquaresVelocityTrackerStrategyEstimator_Parabol
     computeAndCheckQuadraticEstimate(motions, std::array<float, 3>({0, 0E3, 1E6}));
 }
 
+/**
+ * The incremental strategy must agree with lsq2 on a long, accelerating stream of two pointers,
+ * including irregular sample intervals, samples with identical times, a pointer going down in the
+ * middle of the stream and pauses longer than the horizon.
+ */
+TEST_F(VelocityTrackerTest, IncrementalLeastSquaresVelocityTrackerStrategy_MatchesLsq2) {
+    VelocityTracker lsq2("lsq2");
+    VelocityTracker incremental("lsq2-incremental");
+    BitSet32 idBits;
+    idBits.markBit(0);
+    nsecs_t eventTime = 0;
+    for (int i = 0; i < 200; i++) {
+        if (i == 50) {
+            BitSet32 downIdBits;
+            downIdBits.markBit(1);
+            idBits.markBit(1);
+            lsq2.clearPointers(downIdBits);
+            incremental.clearPointers(downIdBits);
+        }
+        eventTime += i % 7 == 0 ? 0 : (4 + i % 5) * 1000000;
+        if (i % 60 == 59) {
+            eventTime += 150 * 1000000;
+        }
+        const float t = eventTime * 1E-9;
+        const VelocityTracker::Position positions[] = {
+                {100 + 2000 * t - 3000 * t * t, 300 - 500 * t + (i % 3)},
+                {700 - 1000 * t + 5000 * t * t, 900 + 800 * t - (i % 2)},
+        };
+        lsq2.addMovement(eventTime, idBits, positions);
+        incremental.addMovement(eventTime, idBits, positions);
+
+        for (BitSet32 iterBits(idBits); !iterBits.isEmpty();) {
+            const uint32_t id = iterBits.clearFirstMarkedBit();
+            float expectedVx, expectedVy, vx, vy;
+            const bool hasVelocity = lsq2.getVelocity(id, &expectedVx, &expectedVy);
+            ASSERT_EQ(hasVelocity, incremental.getVelocity(id, &vx, &vy))
+                    << "i=" << i << " id=" << id;
+            if (!hasVelocity) {
+                continue;
+            }
+            // lsq2 fits in single precision, so allow for its rounding errors.
+            EXPECT_NEAR(expectedVx, vx, 1 + fabsf(expectedVx) * 0.001) << "i=" << i << " id=" << id;
+            EXPECT_NEAR(expectedVy, vy, 1 + fabsf(expectedVy) * 0.001) << "i=" << i << " id=" << id;
+        }
+    }
+}
+
 } // namespace android
@@ -16,11 +16,21 @@
 
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 #include <iosfwd>
 #include <limits>
 #include <type_traits>
 
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define MATH_HALF_NEON
+#elif defined(__F16C__)
+#include <immintrin.h>
+#define MATH_HALF_F16C
+#endif
+
 #ifndef LIKELY
 #define LIKELY_DEFINED_LOCAL
 #ifdef __cplusplus
@@ -154,6 +164,73 @@ inline CONSTEXPR android::half operator"" _hf(long double v) {
     return android::half(android::half::binary, android::half::ftoh(static_cast<float>(v)).bits);
 }
 
+/*
+ * Bulk conversions between float and half arrays.
+ *
+ * When the target has hardware conversion instructions (NEON on arm64, F16C on x86) these
+ * are used for all values, which are then rounded to nearest-even and keep their denormals.
+ * Otherwise each value is converted like half(float) and float(half) do.
+ */
+static_assert(sizeof(half) == sizeof(uint16_t), "half must be stored as its bits");
+
+inline void floatToHalf(half* dst, const float* src, size_t count) noexcept {
+#if defined(MATH_HALF_NEON) || defined(MATH_HALF_F16C)
+    uint16_t* out = reinterpret_cast<uint16_t*>(dst);
+    auto convert4 = [](uint16_t* out, const float* in) {
+#if defined(MATH_HALF_NEON)
+        vst1_u16(out, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(in))));
+#else
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out),
+                         _mm_cvtps_ph(_mm_loadu_ps(in), _MM_FROUND_TO_NEAREST_INT));
+#endif
+    };
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        convert4(out + i, src + i);
+    }
+    if (i < count) {
+        // Convert the remaining values the same way as the others
+        float in[4] = {};
+        uint16_t tail[4];
+        memcpy(in, src + i, (count - i) * sizeof(float));
+        convert4(tail, in);
+        memcpy(out + i, tail, (count - i) * sizeof(uint16_t));
+    }
+#else
+    for (size_t i = 0; i < count; i++) {
+        dst[i] = half(src[i]);
+    }
+#endif
+}
+
+inline void halfToFloat(float* dst, const half* src, size_t count) noexcept {
+#if defined(MATH_HALF_NEON) || defined(MATH_HALF_F16C)
+    const uint16_t* in = reinterpret_cast<const uint16_t*>(src);
+    auto convert4 = [](float* out, const uint16_t* in) {
+#if defined(MATH_HALF_NEON)
+        vst1q_f32(out, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(in))));
+#else
+        _mm_storeu_ps(out, _mm_cvtph_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(in))));
+#endif
+    };
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        convert4(dst + i, in + i);
+    }
+    if (i < count) {
+        uint16_t tail[4] = {};
+        float out[4];
+        memcpy(tail, in + i, (count - i) * sizeof(uint16_t));
+        convert4(out, tail);
+        memcpy(dst + i, out, (count - i) * sizeof(float));
+    }
+#else
+    for (size_t i = 0; i < count; i++) {
+        dst[i] = src[i];
+    }
+#endif
+}
+
 } // namespace android
 
 namespace std {
@@ -210,3 +287,5 @@ public:
 #endif // LIKELY_DEFINED_LOCAL
 
 #undef CONSTEXPR
+#undef MATH_HALF_NEON
+#undef MATH_HALF_F16C
@@ -26,6 +26,14 @@
 #include <sys/types.h>
 #include <limits>
 
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define MATH_MAT4_NEON
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#define MATH_MAT4_SSE
+#endif
+
 #define PURE __attribute__((pure))
 
 #if __cplusplus >= 201402L
@@ -571,6 +579,153 @@ typename TMat44<T>::col_type PURE diag(const TMat44<T>& m) {
     return matrix::diag(m);
 }
 
+// ----------------------------------------------------------------------------------------
+// SIMD specializations for float matrices
+// ----------------------------------------------------------------------------------------
+
+/*
+ * mat4 * mat4, mat4 * vec4, transpose() and inverse() of float matrices use 4-wide vector
+ * instructions when they are available. The operations are performed in the same order as
+ * the generic versions above, without fused multiply-adds, so the results are the same up to
+ * the rounding of any multiply-adds the compiler fuses in the generic code.
+ *
+ * These functions are not constexpr: calling them from a constant expression is an error.
+ */
+
+#if defined(MATH_MAT4_NEON) || defined(MATH_MAT4_SSE)
+
+namespace simd {
+
+#if defined(MATH_MAT4_NEON)
+typedef float32x4_t float4_t;
+
+inline float4_t load(const TVec4<float>& v) { return vld1q_f32(&v.x); }
+inline void store(TVec4<float>& v, float4_t x) { vst1q_f32(&v.x, x); }
+inline float4_t splat(float s) { return vdupq_n_f32(s); }
+inline float4_t add(float4_t a, float4_t b) { return vaddq_f32(a, b); }
+inline float4_t sub(float4_t a, float4_t b) { return vsubq_f32(a, b); }
+inline float4_t mul(float4_t a, float4_t b) { return vmulq_f32(a, b); }
+inline float4_t div(float4_t a, float4_t b) { return vdivq_f32(a, b); }
+#else
+typedef __m128 float4_t;
+
+inline float4_t load(const TVec4<float>& v) { return _mm_loadu_ps(&v.x); }
+inline void store(TVec4<float>& v, float4_t x) { _mm_storeu_ps(&v.x, x); }
+inline float4_t splat(float s) { return _mm_set1_ps(s); }
+inline float4_t add(float4_t a, float4_t b) { return _mm_add_ps(a, b); }
+inline float4_t sub(float4_t a, float4_t b) { return _mm_sub_ps(a, b); }
+inline float4_t mul(float4_t a, float4_t b) { return _mm_mul_ps(a, b); }
+inline float4_t div(float4_t a, float4_t b) { return _mm_div_ps(a, b); }
+#endif
+
+// Returns c0 * v.x + c1 * v.y + c2 * v.z + c3 * v.w, accumulated in that order.
+inline float4_t combine(float4_t c0, float4_t c1, float4_t c2, float4_t c3,
+                        const TVec4<float>& v) {
+    float4_t r = mul(c0, splat(v.x));
+    r = add(r, mul(c1, splat(v.y)));
+    r = add(r, mul(c2, splat(v.z)));
+    return add(r, mul(c3, splat(v.w)));
+}
+
+}  // namespace simd
+
+template <>
+inline TMat44<float>::col_type PURE operator*(const TMat44<float>& lhs, const TVec4<float>& rhs) {
+    TVec4<float> result(TVec4<float>::NO_INIT);
+    simd::store(result,
+                simd::combine(simd::load(lhs[0]), simd::load(lhs[1]), simd::load(lhs[2]),
+                              simd::load(lhs[3]), rhs));
+    return result;
+}
+
+namespace matrix {
+
+template <>
+inline TMat44<float> PURE multiply<TMat44<float>>(const TMat44<float>& lhs,
+                                                  const TMat44<float>& rhs) {
+    const simd::float4_t c0 = simd::load(lhs[0]);
+    const simd::float4_t c1 = simd::load(lhs[1]);
+    const simd::float4_t c2 = simd::load(lhs[2]);
+    const simd::float4_t c3 = simd::load(lhs[3]);
+    TMat44<float> res(TMat44<float>::NO_INIT);
+    for (size_t col = 0; col < TMat44<float>::NUM_COLS; ++col) {
+        simd::store(res[col], simd::combine(c0, c1, c2, c3, rhs[col]));
+    }
+    return res;
+}
+
+template <>
+inline TMat44<float> PURE transpose<TMat44<float>>(const TMat44<float>& m) {
+    TMat44<float> result(TMat44<float>::NO_INIT);
+#if defined(MATH_MAT4_NEON)
+    // De-interleaving load: lane i of val[row] is element row of column i.
+    const float32x4x4_t rows = vld4q_f32(m.asArray());
+    for (size_t row = 0; row < TMat44<float>::NUM_ROWS; ++row) {
+        simd::store(result[row], rows.val[row]);
+    }
+#else
+    __m128 c0 = simd::load(m[0]);
+    __m128 c1 = simd::load(m[1]);
+    __m128 c2 = simd::load(m[2]);
+    __m128 c3 = simd::load(m[3]);
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+    simd::store(result[0], c0);
+    simd::store(result[1], c1);
+    simd::store(result[2], c2);
+    simd::store(result[3], c3);
+#endif
+    return result;
+}
+
+// Same elimination as the generic gaussJordanInverse(), operating on whole columns.
+template <>
+inline TMat44<float> PURE gaussJordanInverse<TMat44<float>>(const TMat44<float>& src) {
+    static constexpr size_t N = TMat44<float>::NUM_ROWS;
+    TMat44<float> tmp(src);
+    TMat44<float> inverted(1);
+
+    for (size_t i = 0; i < N; ++i) {
+        // look for largest element in i'th column
+        size_t swap = i;
+        float t = std::abs(tmp[i][i]);
+        for (size_t j = i + 1; j < N; ++j) {
+            const float t2 = std::abs(tmp[j][i]);
+            if (t2 > t) {
+                swap = j;
+                t = t2;
+            }
+        }
+
+        if (swap != i) {
+            // swap columns.
+            std::swap(tmp[i], tmp[swap]);
+            std::swap(inverted[i], inverted[swap]);
+        }
+
+        const simd::float4_t denom = simd::splat(tmp[i][i]);
+        const simd::float4_t tmpI = simd::div(simd::load(tmp[i]), denom);
+        const simd::float4_t invertedI = simd::div(simd::load(inverted[i]), denom);
+        simd::store(tmp[i], tmpI);
+        simd::store(inverted[i], invertedI);
+
+        // Factor out the lower triangle
+        for (size_t j = 0; j < N; ++j) {
+            if (j != i) {
+                const simd::float4_t d = simd::splat(tmp[j][i]);
+                simd::store(tmp[j], simd::sub(simd::load(tmp[j]), simd::mul(tmpI, d)));
+                simd::store(inverted[j],
+                            simd::sub(simd::load(inverted[j]), simd::mul(invertedI, d)));
+            }
+        }
+    }
+
+    return inverted;
+}
+
+}  // namespace matrix
+
+#endif  // MATH_MAT4_NEON || MATH_MAT4_SSE
+
 } // namespace details
 
 // ----------------------------------------------------------------------------------------
@@ -584,3 +739,5 @@ typedef details::TMat44<float> mat4f;
 
 #undef PURE
 #undef CONSTEXPR
+#undef MATH_MAT4_NEON
+#undef MATH_MAT4_SSE
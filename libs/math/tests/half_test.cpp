@@ -18,6 +18,9 @@
 
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
+
+#include <vector>
 
 #include <math/half.h>
 #include <math/vec4.h>
@@ -93,4 +96,34 @@ TEST_F(HalfTest, Vec) {
     EXPECT_EQ(f4.xy, h2);
 }
 
+TEST_F(HalfTest, Bulk) {
+    // Values that every conversion path represents exactly
+    const float values[] = {0.0f, -0.0f, 1.0f, -2.0f, 0.5f, 0.25f, 1024.0f, -2048.0f,
+                            65504.0f, 6.103515625e-5f, std::numeric_limits<float>::infinity()};
+    constexpr size_t count = sizeof(values) / sizeof(values[0]);
+
+    // One extra element checks that the conversions don't write past the end
+    std::vector<half> halves(count + 1, half(42.0f));
+    floatToHalf(halves.data(), values, count);
+    for (size_t i = 0; i < count; i++) {
+        EXPECT_EQ(half(values[i]).getBits(), halves[i].getBits()) << "at index " << i;
+    }
+    EXPECT_EQ(half(42.0f).getBits(), halves[count].getBits());
+
+    std::vector<float> floats(count + 1, 42.0f);
+    halfToFloat(floats.data(), halves.data(), count);
+    for (size_t i = 0; i < count; i++) {
+        EXPECT_EQ(0, memcmp(&values[i], &floats[i], sizeof(float))) << "at index " << i;
+    }
+    EXPECT_EQ(42.0f, floats[count]);
+
+    // Values that only need rounding
+    const float pi[] = {3.14159265f, 3.14159265f, 3.14159265f, 3.14159265f, 3.14159265f};
+    std::vector<half> pis(5, half(0.0f));
+    floatToHalf(pis.data(), pi, pis.size());
+    for (const half& h : pis) {
+        EXPECT_EQ(half(3.14159265f).getBits(), h.getBits());
+    }
+}
+
 }; // namespace android
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <math/mat4.h>
+
+// Usage: atest mat_benchmark
+
+namespace android {
+namespace {
+
+// The same matrices in float, which may use SIMD specializations, and in double, which
+// always use the generic implementation.
+template <typename T>
+details::TMat44<T> makeMatrix() {
+    return details::TMat44<T>(4.683281e-01, 1.251189e-02, -8.834660e-01, -4.726541e+00,
+                              -8.749647e-01, 1.456563e-01, -4.617587e-01, 3.044795e+00,
+                              1.229049e-01, 9.892561e-01, 7.916244e-02, -6.737138e+00,
+                              1.000000e+00, 2.000000e+00, 3.000000e+00, 4.000000e+00);
+}
+
+template <typename T>
+void BM_multiply(benchmark::State& state) {
+    details::TMat44<T> m = makeMatrix<T>();
+    const details::TMat44<T> rhs = makeMatrix<T>();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(m = m * rhs);
+    }
+}
+BENCHMARK_TEMPLATE(BM_multiply, float);
+BENCHMARK_TEMPLATE(BM_multiply, double);
+
+template <typename T>
+void BM_multiplyVector(benchmark::State& state) {
+    const details::TMat44<T> m = makeMatrix<T>();
+    details::TVec4<T> v(1, 2, 3, 4);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(v = m * v);
+    }
+}
+BENCHMARK_TEMPLATE(BM_multiplyVector, float);
+BENCHMARK_TEMPLATE(BM_multiplyVector, double);
+
+template <typename T>
+void BM_transpose(benchmark::State& state) {
+    details::TMat44<T> m = makeMatrix<T>();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(m = transpose(m));
+    }
+}
+BENCHMARK_TEMPLATE(BM_transpose, float);
+BENCHMARK_TEMPLATE(BM_transpose, double);
+
+template <typename T>
+void BM_inverse(benchmark::State& state) {
+    const details::TMat44<T> m = makeMatrix<T>();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(inverse(m));
+    }
+}
+BENCHMARK_TEMPLATE(BM_inverse, float);
+BENCHMARK_TEMPLATE(BM_inverse, double);
+
+} // namespace
+} // namespace android
+
+BENCHMARK_MAIN();
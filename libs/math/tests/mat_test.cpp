@@ -690,4 +690,45 @@ TYPED_TEST(MatTestT, ToQuaternionPointTransformation44) {
 
 #undef TEST_MATRIX_INVERSE
 
+//------------------------------------------------------------------------------
+// float mat4 operations may use SIMD specializations, which must match the generic
+// implementation used for double matrices.
+TEST_F(MatTest, SimdMatchesGeneric) {
+    std::default_random_engine generator(171717);
+    std::uniform_real_distribution<float> distribution(-10.0f, 10.0f);
+    auto rand_gen = std::bind(distribution, generator);
+
+    for (size_t i = 0; i < 100; ++i) {
+        mat4 a;
+        mat4 b;
+        vec4 v(rand_gen(), rand_gen(), rand_gen(), rand_gen());
+        for (size_t col = 0; col < 4; ++col) {
+            for (size_t row = 0; row < 4; ++row) {
+                a[col][row] = rand_gen();
+                b[col][row] = rand_gen();
+            }
+        }
+        const mat4d ad(a);
+        const mat4d bd(b);
+        const double4 vd(v);
+
+        const mat4 product = a * b;
+        const mat4d productd = ad * bd;
+        const mat4 transposed = transpose(a);
+        const mat4 inverted = inverse(a);
+        const mat4d invertedd = inverse(ad);
+        const vec4 av = a * v;
+        const double4 avd = ad * vd;
+        for (size_t col = 0; col < 4; ++col) {
+            for (size_t row = 0; row < 4; ++row) {
+                EXPECT_NEAR(product[col][row], productd[col][row], 1e-3);
+                EXPECT_EQ(transposed[col][row], a[row][col]);
+                EXPECT_NEAR(inverted[col][row], invertedd[col][row],
+                            1e-4 * std::max(1.0, std::abs(invertedd[col][row])));
+            }
+            EXPECT_NEAR(av[col], avd[col], 1e-3);
+        }
+    }
+}
+
 }; // namespace android
@@ -150,9 +150,6 @@ int AHardwareBuffer_lockAndGetInfo(AHardwareBuffer* buffer, uint64_t usage,
 
 int AHardwareBuffer_lock(AHardwareBuffer* buffer, uint64_t usage,
                          int32_t fence, const ARect* rect, void** outVirtualAddress) {
-    int32_t bytesPerPixel;
-    int32_t bytesPerStride;
-
     if (!buffer) return BAD_VALUE;
 
     if (usage & ~(AHARDWAREBUFFER_USAGE_CPU_READ_MASK |
@@ -177,28 +174,13 @@ int AHardwareBuffer_lock(AHardwareBuffer* buffer, uint64_t usage,
     } else {
         bounds.set(Rect(rect->left, rect->top, rect->right, rect->bottom));
     }
-    return gbuffer->lockAsync(usage, usage, bounds, outVirtualAddress, fence, &bytesPerPixel, &bytesPerStride);
+    return gbuffer->lockAsync(usage, usage, bounds, outVirtualAddress, fence);
 }
 
-int AHardwareBuffer_lockPlanes(AHardwareBuffer* buffer, uint64_t usage,
-        int32_t fence, const ARect* rect, AHardwareBuffer_Planes* outPlanes) {
-    if (!buffer || !outPlanes) return BAD_VALUE;
-
-    if (usage & ~(AHARDWAREBUFFER_USAGE_CPU_READ_MASK |
-                  AHARDWAREBUFFER_USAGE_CPU_WRITE_MASK)) {
-        ALOGE("Invalid usage flags passed to AHardwareBuffer_lock; only "
-                " AHARDWAREBUFFER_USAGE_CPU_* flags are allowed");
-        return BAD_VALUE;
-    }
-
+// Locks the planes of gBuffer for the validated CPU usage flags
+static int lockPlanes(GraphicBuffer* gBuffer, uint64_t usage, int32_t fence, const Rect& bounds,
+        AHardwareBuffer_Planes* outPlanes) {
     usage = AHardwareBuffer_convertToGrallocUsageBits(usage);
-    GraphicBuffer* gBuffer = AHardwareBuffer_to_GraphicBuffer(buffer);
-    Rect bounds;
-    if (!rect) {
-        bounds.set(Rect(gBuffer->getWidth(), gBuffer->getHeight()));
-    } else {
-        bounds.set(Rect(rect->left, rect->top, rect->right, rect->bottom));
-    }
     int format = AHardwareBuffer_convertFromPixelFormat(uint32_t(gBuffer->getPixelFormat()));
     memset(outPlanes->planes, 0, sizeof(outPlanes->planes));
     if (AHardwareBuffer_formatIsYuv(format)) {
@@ -228,6 +210,69 @@ int AHardwareBuffer_lockPlanes(AHardwareBuffer* buffer, uint64_t usage,
     }
 }
 
+int AHardwareBuffer_lockPlanes(AHardwareBuffer* buffer, uint64_t usage,
+        int32_t fence, const ARect* rect, AHardwareBuffer_Planes* outPlanes) {
+    if (!buffer || !outPlanes) return BAD_VALUE;
+
+    if (usage & ~(AHARDWAREBUFFER_USAGE_CPU_READ_MASK |
+                  AHARDWAREBUFFER_USAGE_CPU_WRITE_MASK)) {
+        ALOGE("Invalid usage flags passed to AHardwareBuffer_lock; only "
+                " AHARDWAREBUFFER_USAGE_CPU_* flags are allowed");
+        return BAD_VALUE;
+    }
+
+    GraphicBuffer* gBuffer = AHardwareBuffer_to_GraphicBuffer(buffer);
+    Rect bounds;
+    if (!rect) {
+        bounds.set(Rect(gBuffer->getWidth(), gBuffer->getHeight()));
+    } else {
+        bounds.set(Rect(rect->left, rect->top, rect->right, rect->bottom));
+    }
+    return lockPlanes(gBuffer, usage, fence, bounds, outPlanes);
+}
+
+int AHardwareBuffer_lockPlanesWithHints(AHardwareBuffer* buffer, uint64_t usage,
+        uint32_t hints, int32_t fence, const ARect* rect, AHardwareBuffer_Planes* outPlanes) {
+    if (!buffer || !rect || !outPlanes) return BAD_VALUE;
+
+    if (usage & ~(AHARDWAREBUFFER_USAGE_CPU_READ_MASK |
+                  AHARDWAREBUFFER_USAGE_CPU_WRITE_MASK)) {
+        ALOGE("Invalid usage flags passed to AHardwareBuffer_lock; only "
+                " AHARDWAREBUFFER_USAGE_CPU_* flags are allowed");
+        return BAD_VALUE;
+    }
+
+    if (hints & ~(AHARDWAREBUFFER_LOCK_HINT_OVERWRITE | AHARDWAREBUFFER_LOCK_HINT_NO_WRITE)) {
+        ALOGE("Invalid hints passed to AHardwareBuffer_lockPlanesWithHints: %#x", hints);
+        return BAD_VALUE;
+    }
+
+    // gralloc only makes the contents of the locked region visible to the CPU on lock for read
+    // usages, and only flushes them on unlock for write usages.
+    if (hints & AHARDWAREBUFFER_LOCK_HINT_OVERWRITE) {
+        usage &= ~AHARDWAREBUFFER_USAGE_CPU_READ_MASK;
+    }
+    if (hints & AHARDWAREBUFFER_LOCK_HINT_NO_WRITE) {
+        usage &= ~AHARDWAREBUFFER_USAGE_CPU_WRITE_MASK;
+    }
+    if (usage == 0) {
+        ALOGE("Hints passed to AHardwareBuffer_lockPlanesWithHints leave no CPU access");
+        return BAD_VALUE;
+    }
+
+    GraphicBuffer* gBuffer = AHardwareBuffer_to_GraphicBuffer(buffer);
+    const Rect bounds(rect->left, rect->top, rect->right, rect->bottom);
+    if (bounds.isEmpty() || bounds.left < 0 || bounds.top < 0 ||
+        bounds.right > static_cast<int32_t>(gBuffer->getWidth()) ||
+        bounds.bottom > static_cast<int32_t>(gBuffer->getHeight())) {
+        ALOGE("Invalid rect passed to AHardwareBuffer_lockPlanesWithHints: "
+                "[%d, %d, %d, %d] in a %ux%u buffer", bounds.left, bounds.top, bounds.right,
+                bounds.bottom, gBuffer->getWidth(), gBuffer->getHeight());
+        return BAD_VALUE;
+    }
+    return lockPlanes(gBuffer, usage, fence, bounds, outPlanes);
+}
+
 int AHardwareBuffer_unlock(AHardwareBuffer* buffer, int32_t* fence) {
     if (!buffer) return BAD_VALUE;
 
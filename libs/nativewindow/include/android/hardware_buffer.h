@@ -309,6 +309,29 @@ typedef struct AHardwareBuffer_Desc {
     uint64_t    rfu1;       ///< Initialize to zero, reserved for future use.
 } AHardwareBuffer_Desc;
 
+/**
+ * Hints about how the CPU accesses a locked region, passed to
+ * AHardwareBuffer_lockPlanesWithHints().
+ *
+ * They allow the implementation to skip the CPU cache maintenance that the
+ * usage flags alone would require for the locked region.
+ */
+enum AHardwareBuffer_LockHints {
+    /**
+     * The CPU overwrites the whole locked region before reading from it, so
+     * its current contents do not need to be made visible to the CPU, even if
+     * the usage includes AHARDWAREBUFFER_USAGE_CPU_READ_*.
+     */
+    AHARDWAREBUFFER_LOCK_HINT_OVERWRITE = 1 << 0,
+
+    /**
+     * The CPU does not write to the locked region, so it does not need to be
+     * flushed when the buffer is unlocked, even if the usage includes
+     * AHARDWAREBUFFER_USAGE_CPU_WRITE_*.
+     */
+    AHARDWAREBUFFER_LOCK_HINT_NO_WRITE = 1 << 1,
+};
+
 /**
  * Holds data for a single image plane.
  */
@@ -535,6 +558,32 @@ int AHardwareBuffer_lockAndGetInfo(AHardwareBuffer* buffer, uint64_t usage,
         int32_t fence, const ARect* rect, void** outVirtualAddress,
         int32_t* outBytesPerPixel, int32_t* outBytesPerStride) __INTRODUCED_IN(29);
 
+/**
+ * Lock a sub-rectangle of a potentially multi-planar AHardwareBuffer for
+ * direct CPU access, with hints about how it is accessed.
+ *
+ * This function is the same as AHardwareBuffer_lockPlanes, except that \a rect
+ * is required and \a hints, a combination of AHardwareBuffer_LockHints,
+ * describes how the CPU accesses it. Only the contents of \a rect are
+ * defined while the buffer is locked, and cache maintenance is limited to
+ * \a rect and to the accesses left after applying \a hints.
+ *
+ * The plane data pointers are the same as those returned by
+ * AHardwareBuffer_lockPlanes, i.e. they point to the start of each plane, not
+ * to the start of \a rect.
+ *
+ * Available since API level 31.
+ *
+ * \return 0 on success. -EINVAL if \a buffer, \a rect or \a outPlanes is
+ * NULL, \a rect is empty or not within the buffer, the usage flags are not a
+ * combination of AHARDWAREBUFFER_USAGE_CPU_*, \a hints is not a combination
+ * of AHardwareBuffer_LockHints or leaves no CPU access. Error number if the
+ * lock fails for any other reason.
+ */
+int AHardwareBuffer_lockPlanesWithHints(AHardwareBuffer* buffer, uint64_t usage,
+        uint32_t hints, int32_t fence, const ARect* rect,
+        AHardwareBuffer_Planes* outPlanes) __INTRODUCED_IN(31);
+
 __END_DECLS
 
 #endif // ANDROID_HARDWARE_BUFFER_H
@@ -131,3 +131,60 @@ TEST(AHardwareBufferTest, GetCreateHandleTest) {
     AHardwareBuffer_release(buffer);
     AHardwareBuffer_release(otherBuffer);
 }
+
+TEST(AHardwareBufferTest, LockPlanesWithHintsTest) {
+    AHardwareBuffer_Desc desc{
+            .width = 64,
+            .height = 64,
+            .layers = 1,
+            .format = AHARDWAREBUFFER_FORMAT_R8G8B8A8_UNORM,
+            .usage = AHARDWAREBUFFER_USAGE_CPU_READ_OFTEN | AHARDWAREBUFFER_USAGE_CPU_WRITE_OFTEN,
+    };
+
+    AHardwareBuffer* buffer = nullptr;
+    ASSERT_EQ(0, AHardwareBuffer_allocate(&desc, &buffer));
+
+    const uint64_t usage =
+            AHARDWAREBUFFER_USAGE_CPU_READ_OFTEN | AHARDWAREBUFFER_USAGE_CPU_WRITE_OFTEN;
+    const ARect rect{.left = 8, .top = 8, .right = 24, .bottom = 16};
+    AHardwareBuffer_Planes planes;
+
+    // A rect is required and must be within the buffer
+    EXPECT_EQ(BAD_VALUE,
+              AHardwareBuffer_lockPlanesWithHints(buffer, usage, 0, -1, nullptr, &planes));
+    const ARect outside{.left = 32, .top = 32, .right = 65, .bottom = 40};
+    EXPECT_EQ(BAD_VALUE,
+              AHardwareBuffer_lockPlanesWithHints(buffer, usage, 0, -1, &outside, &planes));
+
+    // Hints must leave some CPU access
+    EXPECT_EQ(BAD_VALUE,
+              AHardwareBuffer_lockPlanesWithHints(buffer, usage,
+                                                  AHARDWAREBUFFER_LOCK_HINT_OVERWRITE |
+                                                          AHARDWAREBUFFER_LOCK_HINT_NO_WRITE,
+                                                  -1, &rect, &planes));
+    EXPECT_EQ(BAD_VALUE,
+              AHardwareBuffer_lockPlanesWithHints(buffer, usage, 1u << 31, -1, &rect, &planes));
+
+    // Write the region without reading it back, then read it without flushing it
+    ASSERT_EQ(0,
+              AHardwareBuffer_lockPlanesWithHints(buffer, usage,
+                                                  AHARDWAREBUFFER_LOCK_HINT_OVERWRITE, -1, &rect,
+                                                  &planes));
+    ASSERT_EQ(1u, planes.planeCount);
+    uint8_t* data = static_cast<uint8_t*>(planes.planes[0].data);
+    for (int32_t y = rect.top; y < rect.bottom; y++) {
+        memset(data + y * planes.planes[0].rowStride + rect.left * 4, 0xab,
+               (rect.right - rect.left) * 4);
+    }
+    EXPECT_EQ(0, AHardwareBuffer_unlock(buffer, nullptr));
+
+    ASSERT_EQ(0,
+              AHardwareBuffer_lockPlanesWithHints(buffer, usage, AHARDWAREBUFFER_LOCK_HINT_NO_WRITE,
+                                                  -1, &rect, &planes));
+    data = static_cast<uint8_t*>(planes.planes[0].data);
+    EXPECT_EQ(0xab, data[rect.top * planes.planes[0].rowStride + rect.left * 4]);
+    EXPECT_EQ(0xab, data[(rect.bottom - 1) * planes.planes[0].rowStride + rect.right * 4 - 1]);
+    EXPECT_EQ(0, AHardwareBuffer_unlock(buffer, nullptr));
+
+    AHardwareBuffer_release(buffer);
+}
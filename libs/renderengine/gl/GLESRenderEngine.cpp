@@ -20,10 +20,13 @@
 #define ATRACE_TAG ATRACE_TAG_GRAPHICS
 
 #include <sched.h>
+#include <sys/resource.h>
+#include <algorithm>
 #include <cmath>
 #include <fstream>
 #include <sstream>
 #include <unordered_set>
+#include <utility>
 
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
@@ -31,13 +34,16 @@
 #include <cutils/compiler.h>
 #include <cutils/properties.h>
 #include <gui/DebugEGLImageTracker.h>
+#include <private/EGL/cache.h>
 #include <renderengine/Mesh.h>
 #include <renderengine/Texture.h>
 #include <renderengine/private/Description.h>
 #include <sync/sync.h>
+#include <system/thread_defs.h>
 #include <ui/ColorSpace.h>
 #include <ui/DebugUtils.h>
 #include <ui/GraphicBuffer.h>
+#include <ui/PixelFormat.h>
 #include <ui/Rect.h>
 #include <ui/Region.h>
 #include <utils/KeyedVector.h>
@@ -119,6 +125,22 @@ namespace gl {
 using base::StringAppendF;
 using ui::Dataspace;
 
+// Programs are recorded and linked programs are cached across boots, unless this is unset
+static constexpr char PROPERTY_WARM_UP_RECORDED_SHADERS[] =
+        "debug.renderengine.warm_up_recorded_shaders";
+static constexpr char USED_SHADER_KEYS_PATH[] = "/data/misc/surfaceflinger/shader_keys";
+static constexpr char EGL_BLOB_CACHE_PATH[] = "/data/misc/surfaceflinger/egl_cache";
+// Cached images keep their buffers alive, so the least recently bound ones are destroyed once
+// the buffers add up to more than this many megabytes. 0 leaves the cache unbounded.
+static constexpr char PROPERTY_IMAGE_CACHE_BUDGET_MB[] = "debug.renderengine.image_cache_budget_mb";
+static constexpr int32_t DEFAULT_IMAGE_CACHE_BUDGET_MB = 256;
+
+static size_t getImageSize(const sp<GraphicBuffer>& buffer) {
+    // bytesPerPixel() does not know about YUV formats, which use at most 2 bytes per pixel
+    const uint32_t bpp = bytesPerPixel(buffer->getPixelFormat());
+    return static_cast<size_t>(buffer->getStride()) * buffer->getHeight() * (bpp ? bpp : 2);
+}
+
 static status_t selectConfigForAttribute(EGLDisplay dpy, EGLint const* attrs, EGLint attribute,
                                          EGLint wanted, EGLConfig* outConfig) {
     EGLint numConfigs = -1, n = 0;
@@ -202,6 +224,11 @@ static status_t selectEGLConfig(EGLDisplay display, EGLint format, EGLint render
 }
 
 std::unique_ptr<GLESRenderEngine> GLESRenderEngine::create(const RenderEngineCreationArgs& args) {
+    // Keep the linked programs across boots, unless they are generated from scratch anyway
+    if (property_get_bool(PROPERTY_WARM_UP_RECORDED_SHADERS, true)) {
+        egl_set_cache_filename(EGL_BLOB_CACHE_PATH);
+    }
+
     // initialize EGL for the default display
     EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
     if (!eglInitialize(display, nullptr, nullptr)) {
@@ -394,6 +421,13 @@ GLESRenderEngine::GLESRenderEngine(const RenderEngineCreationArgs& args, EGLDisp
         mBt2020ToDisplayP3 = mXyzToDisplayP3 * mBt2020ToXyz;
     }
 
+    mWarmUpRecordedShaders = property_get_bool(PROPERTY_WARM_UP_RECORDED_SHADERS, true);
+    mImageCacheBudget = static_cast<size_t>(std::max(
+                                property_get_int32(PROPERTY_IMAGE_CACHE_BUDGET_MB,
+                                                   DEFAULT_IMAGE_CACHE_BUDGET_MB),
+                                0)) *
+            1024 * 1024;
+
     char value[PROPERTY_VALUE_MAX];
     property_get("debug.egl.traceGpuCompletion", value, "0");
     if (atoi(value)) {
@@ -429,19 +463,26 @@ GLESRenderEngine::GLESRenderEngine(const RenderEngineCreationArgs& args, EGLDisp
 }
 
 GLESRenderEngine::~GLESRenderEngine() {
+    mStopProgramCacheWarmup = true;
+    if (mProgramCacheWarmupThread.joinable()) {
+        mProgramCacheWarmupThread.join();
+    }
     // Destroy the image manager first.
     mImageManager = nullptr;
     std::lock_guard<std::mutex> lock(mRenderingMutex);
     unbindFrameBuffer(mDrawingBuffer.get());
     mDrawingBuffer = nullptr;
     while (!mFramebufferImageCache.empty()) {
-        EGLImageKHR expired = mFramebufferImageCache.front().second;
+        EGLImageKHR expired = mFramebufferImageCache.front().image;
         mFramebufferImageCache.pop_front();
         eglDestroyImageKHR(mEGLDisplay, expired);
         DEBUG_EGL_IMAGE_TRACKER_DESTROY();
     }
     eglDestroyImageKHR(mEGLDisplay, mPlaceholderImage);
-    mImageCache.clear();
+    {
+        std::lock_guard<std::mutex> lock(mRenderingMutex);
+        clearImageCacheLocked();
+    }
     eglMakeCurrent(mEGLDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
     eglTerminate(mEGLDisplay);
 }
@@ -459,9 +500,61 @@ Framebuffer* GLESRenderEngine::getFramebufferForDrawing() {
 }
 
 void GLESRenderEngine::primeCache() const {
-    ProgramCache::getInstance().primeCache(mInProtectedContext ? mProtectedEGLContext : mEGLContext,
-                                           mArgs.useColorManagement,
-                                           mArgs.precacheToneMapperShaderOnly);
+    ProgramCache& cache = ProgramCache::getInstance();
+    const EGLContext context = mInProtectedContext ? mProtectedEGLContext : mEGLContext;
+    std::vector<ProgramCache::Key> keys;
+    if (mWarmUpRecordedShaders) {
+        keys = cache.loadUsedKeys(USED_SHADER_KEYS_PATH);
+    }
+
+    // Until programs were recorded, e.g. on the first boot, generate a fixed set of them
+    if (keys.empty()) {
+        cache.primeCache(context, mArgs.useColorManagement, mArgs.precacheToneMapperShaderOnly);
+        return;
+    }
+
+    // Otherwise generate the programs drawn with on previous boots, most used first, without
+    // delaying the boot. Programs needed before they are generated are generated while drawing.
+    mProgramCacheWarmupThread =
+            std::thread(&GLESRenderEngine::warmProgramCache, this, context, std::move(keys));
+    pthread_setname_np(mProgramCacheWarmupThread.native_handle(), "ShaderWarmup");
+}
+
+void GLESRenderEngine::warmProgramCache(EGLContext context,
+                                        std::vector<ProgramCache::Key> keys) const {
+    ATRACE_CALL();
+    setpriority(PRIO_PROCESS, 0, ANDROID_PRIORITY_BACKGROUND);
+
+    // Programs are shared with all the contexts sharing them with 'context'
+    const Protection protection =
+            context == mProtectedEGLContext ? Protection::PROTECTED : Protection::UNPROTECTED;
+    const EGLContext warmupContext = createEglContext(mEGLDisplay, mEGLConfig, context,
+                                                      /*useContextPriority*/ false, protection);
+    if (warmupContext == EGL_NO_CONTEXT) {
+        ALOGE("Can't create the context to warm up the shader cache with");
+        return;
+    }
+    EGLSurface stub = EGL_NO_SURFACE;
+    if (!GLExtensions::getInstance().hasSurfacelessContext()) {
+        stub = createStubEglPbufferSurface(mEGLDisplay, mEGLConfig, mArgs.pixelFormat, protection);
+    }
+
+    if (eglMakeCurrent(mEGLDisplay, stub, stub, warmupContext)) {
+        const nsecs_t timeBefore = systemTime();
+        const size_t shaderCount =
+                ProgramCache::getInstance().warmCache(context, keys, mStopProgramCacheWarmup);
+        const float compileTimeMs = static_cast<float>(systemTime() - timeBefore) / 1.0E6;
+        ALOGD("shader cache warmed up - %zu of %zu recorded shaders in %f ms", shaderCount,
+              keys.size(), compileTimeMs);
+        eglMakeCurrent(mEGLDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    } else {
+        ALOGE("Can't make the context to warm up the shader cache with current");
+    }
+
+    if (stub != EGL_NO_SURFACE) {
+        eglDestroySurface(mEGLDisplay, stub);
+    }
+    eglDestroyContext(mEGLDisplay, warmupContext);
 }
 
 base::unique_fd GLESRenderEngine::flush() {
@@ -642,9 +735,18 @@ status_t GLESRenderEngine::bindExternalTextureBuffer(uint32_t texName,
 
     // If we couldn't find the image in the cache at this time, then either
     // SurfaceFlinger messed up registering the buffer ahead of time or we got
-    // backed up creating other EGLImages.
+    // backed up creating other EGLImages. Create it right here rather than
+    // through mImageManager, so that rendering does not wait for the images
+    // queued before it.
     if (!found) {
-        status_t cacheResult = mImageManager->cache(buffer);
+        ATRACE_NAME("ImageCacheMiss");
+        const nsecs_t start = systemTime();
+        status_t cacheResult = cacheExternalTextureBufferInternal(buffer);
+        {
+            std::lock_guard<std::mutex> lock(mRenderingMutex);
+            mImageCacheStats.misses++;
+            mImageCacheStats.missDuration += systemTime() - start;
+        }
         if (cacheResult != NO_ERROR) {
             return cacheResult;
         }
@@ -666,8 +768,13 @@ status_t GLESRenderEngine::bindExternalTextureBuffer(uint32_t texName,
             return NO_INIT;
         }
 
-        bindExternalTextureImage(texName, *cachedImage->second);
+        bindExternalTextureImage(texName, *cachedImage->second.image);
         mTextureView.insert_or_assign(texName, buffer->getId());
+        mImageCacheLru.splice(mImageCacheLru.begin(), mImageCacheLru,
+                              cachedImage->second.lruEntry);
+        if (found) {
+            mImageCacheStats.hits++;
+        }
     }
 
     // Wait for the new buffer to be ready.
@@ -731,6 +838,7 @@ status_t GLESRenderEngine::cacheExternalTextureBufferInternal(const sp<GraphicBu
         return NO_INIT;
     }
 
+    std::vector<std::unique_ptr<Image>> evicted;
     {
         std::lock_guard<std::mutex> lock(mRenderingMutex);
         if (mImageCache.count(buffer->getId()) > 0) {
@@ -738,7 +846,8 @@ status_t GLESRenderEngine::cacheExternalTextureBufferInternal(const sp<GraphicBu
             // so bail out if another thread won.
             return NO_ERROR;
         }
-        mImageCache.insert(std::make_pair(buffer->getId(), std::move(newImage)));
+        insertCachedImageLocked(buffer->getId(), std::move(newImage), getImageSize(buffer),
+                                evicted);
     }
 
     return NO_ERROR;
@@ -759,20 +868,52 @@ void GLESRenderEngine::unbindExternalTextureBufferInternal(uint64_t bufferId) {
     std::unique_ptr<Image> image;
     {
         std::lock_guard<std::mutex> lock(mRenderingMutex);
-        const auto& cachedImage = mImageCache.find(bufferId);
-
-        if (cachedImage != mImageCache.end()) {
+        // Move the buffer out of cache first, so that we can destroy
+        // without holding the cache's lock.
+        image = eraseCachedImageLocked(bufferId);
+        if (image) {
             ALOGV("Destroying image for buffer: %" PRIu64, bufferId);
-            // Move the buffer out of cache first, so that we can destroy
-            // without holding the cache's lock.
-            image = std::move(cachedImage->second);
-            mImageCache.erase(bufferId);
             return;
         }
     }
     ALOGV("Failed to find image for buffer: %" PRIu64, bufferId);
 }
 
+void GLESRenderEngine::insertCachedImageLocked(uint64_t bufferId, std::unique_ptr<Image> image,
+                                               size_t size,
+                                               std::vector<std::unique_ptr<Image>>& evicted) {
+    mImageCacheLru.push_front(bufferId);
+    mImageCache.emplace(bufferId, CachedImage{std::move(image), size, mImageCacheLru.begin()});
+    mImageCacheSize += size;
+
+    // Never evict the image just added, which is about to be bound
+    while (mImageCacheBudget > 0 && mImageCacheSize > mImageCacheBudget &&
+           mImageCacheLru.size() > 1) {
+        const uint64_t lruId = mImageCacheLru.back();
+        ALOGV("Evicting image for buffer: %" PRIu64, lruId);
+        evicted.push_back(eraseCachedImageLocked(lruId));
+        mImageCacheStats.evictions++;
+    }
+}
+
+std::unique_ptr<Image> GLESRenderEngine::eraseCachedImageLocked(uint64_t bufferId) {
+    const auto cachedImage = mImageCache.find(bufferId);
+    if (cachedImage == mImageCache.end()) {
+        return nullptr;
+    }
+    std::unique_ptr<Image> image = std::move(cachedImage->second.image);
+    mImageCacheSize -= cachedImage->second.size;
+    mImageCacheLru.erase(cachedImage->second.lruEntry);
+    mImageCache.erase(cachedImage);
+    return image;
+}
+
+void GLESRenderEngine::clearImageCacheLocked() {
+    mImageCache.clear();
+    mImageCacheLru.clear();
+    mImageCacheSize = 0;
+}
+
 FloatRect GLESRenderEngine::setupLayerCropping(const LayerSettings& layer, Mesh& mesh) {
     // Translate win by the rounded corners rect coordinates, to have all values in
     // layer coordinate space.
@@ -938,7 +1079,7 @@ bool GLESRenderEngine::cleanupPostRender(CleanupMode mode) {
         }
         {
             std::lock_guard<std::mutex> lock(mRenderingMutex);
-            mImageCache.clear();
+            clearImageCacheLocked();
         }
     }
 
@@ -994,9 +1135,9 @@ EGLImageKHR GLESRenderEngine::createFramebufferImageIfNeeded(ANativeWindowBuffer
     sp<GraphicBuffer> graphicBuffer = GraphicBuffer::from(nativeBuffer);
     if (useFramebufferCache) {
         std::lock_guard<std::mutex> lock(mFramebufferImageCacheMutex);
-        for (const auto& image : mFramebufferImageCache) {
-            if (image.first == graphicBuffer->getId()) {
-                return image.second;
+        for (const auto& cached : mFramebufferImageCache) {
+            if (cached.bufferId == graphicBuffer->getId()) {
+                return cached.image;
             }
         }
     }
@@ -1011,12 +1152,13 @@ EGLImageKHR GLESRenderEngine::createFramebufferImageIfNeeded(ANativeWindowBuffer
         if (image != EGL_NO_IMAGE_KHR) {
             std::lock_guard<std::mutex> lock(mFramebufferImageCacheMutex);
             if (mFramebufferImageCache.size() >= mFramebufferImageCacheSize) {
-                EGLImageKHR expired = mFramebufferImageCache.front().second;
+                EGLImageKHR expired = mFramebufferImageCache.front().image;
                 mFramebufferImageCache.pop_front();
                 eglDestroyImageKHR(mEGLDisplay, expired);
                 DEBUG_EGL_IMAGE_TRACKER_DESTROY();
             }
-            mFramebufferImageCache.push_back({graphicBuffer->getId(), image});
+            mFramebufferImageCache.push_back(
+                    {graphicBuffer->getId(), image, getImageSize(graphicBuffer)});
         }
     }
 
@@ -1529,9 +1671,18 @@ void GLESRenderEngine::dump(std::string& result) {
     {
         std::lock_guard<std::mutex> lock(mRenderingMutex);
         StringAppendF(&result, "RenderEngine image cache size: %zu\n", mImageCache.size());
-        StringAppendF(&result, "Dumping buffer ids...\n");
-        for (const auto& [id, unused] : mImageCache) {
-            StringAppendF(&result, "0x%" PRIx64 "\n", id);
+        StringAppendF(&result, "RenderEngine image cache memory: %zu KiB (budget %zu KiB)\n",
+                      mImageCacheSize / 1024, mImageCacheBudget / 1024);
+        const auto& stats = mImageCacheStats;
+        StringAppendF(&result,
+                      "RenderEngine image cache hits: %" PRIu64 " misses: %" PRIu64
+                      " (%.3f ms creating images while rendering) evictions: %" PRIu64 "\n",
+                      stats.hits, stats.misses, ns2us(stats.missDuration) / 1000.0,
+                      stats.evictions);
+        StringAppendF(&result, "Dumping buffer ids, most recently bound first...\n");
+        for (const uint64_t id : mImageCacheLru) {
+            StringAppendF(&result, "0x%" PRIx64 " (%zu KiB)\n", id,
+                          mImageCache.at(id).size / 1024);
         }
     }
     {
@@ -1539,10 +1690,32 @@ void GLESRenderEngine::dump(std::string& result) {
         StringAppendF(&result, "RenderEngine framebuffer image cache size: %zu\n",
                       mFramebufferImageCache.size());
         StringAppendF(&result, "Dumping buffer ids...\n");
-        for (const auto& [id, unused] : mFramebufferImageCache) {
-            StringAppendF(&result, "0x%" PRIx64 "\n", id);
+        for (const auto& cached : mFramebufferImageCache) {
+            StringAppendF(&result, "0x%" PRIx64 " (%zu KiB)\n", cached.bufferId,
+                          cached.size / 1024);
+        }
+    }
+}
+
+RenderEngine::MemoryUsage GLESRenderEngine::getMemoryUsage() {
+    MemoryUsage usage;
+    {
+        std::lock_guard<std::mutex> lock(mRenderingMutex);
+        usage.imageCacheBytes.reserve(mImageCache.size());
+        for (const auto& [id, cached] : mImageCache) {
+            usage.imageCacheBytes.emplace(id, cached.size);
         }
     }
+    {
+        std::lock_guard<std::mutex> lock(mFramebufferImageCacheMutex);
+        for (const auto& cached : mFramebufferImageCache) {
+            usage.framebufferImageCacheBytes += cached.size;
+        }
+    }
+    if (mBlurFilter != nullptr) {
+        usage.blurBytes = mBlurFilter->getMemoryBytes();
+    }
+    return usage;
 }
 
 GLESRenderEngine::GlesVersion GLESRenderEngine::parseGlesVersion(const char* str) {
@@ -1668,6 +1841,10 @@ bool GLESRenderEngine::isImageCachedForTesting(uint64_t bufferId) {
     return cachedImage != mImageCache.end();
 }
 
+size_t GLESRenderEngine::setImageCacheBudgetForTesting(size_t budget) {
+    return std::exchange(mImageCacheBudget, budget);
+}
+
 bool GLESRenderEngine::isTextureNameKnownForTesting(uint32_t texName) {
     const auto& entry = mTextureView.find(texName);
     return entry != mTextureView.end();
@@ -1681,8 +1858,8 @@ std::optional<uint64_t> GLESRenderEngine::getBufferIdForTextureNameForTesting(ui
 bool GLESRenderEngine::isFramebufferImageCachedForTesting(uint64_t bufferId) {
     std::lock_guard<std::mutex> lock(mFramebufferImageCacheMutex);
     return std::any_of(mFramebufferImageCache.cbegin(), mFramebufferImageCache.cend(),
-                       [=](std::pair<uint64_t, EGLImageKHR> image) {
-                           return image.first == bufferId;
+                       [=](const CachedFramebufferImage& cached) {
+                           return cached.bufferId == bufferId;
                        });
 }
 
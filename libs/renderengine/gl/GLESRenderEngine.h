@@ -17,12 +17,15 @@
 #ifndef SF_GLESRENDERENGINE_H_
 #define SF_GLESRENDERENGINE_H_
 
+#include <atomic>
 #include <condition_variable>
 #include <deque>
+#include <list>
 #include <mutex>
 #include <queue>
 #include <thread>
 #include <unordered_map>
+#include <vector>
 
 #include <EGL/egl.h>
 #include <EGL/eglext.h>
@@ -31,8 +34,10 @@
 #include <renderengine/RenderEngine.h>
 #include <renderengine/private/Description.h>
 #include <sys/types.h>
+#include <utils/Timers.h>
 #include "GLShadowTexture.h"
 #include "ImageManager.h"
+#include "ProgramCache.h"
 
 #define EGL_NO_CONFIG ((EGLConfig)0)
 
@@ -76,6 +81,8 @@ public:
                         ANativeWindowBuffer* buffer, const bool useFramebufferCache,
                         base::unique_fd&& bufferFence, base::unique_fd* drawFence) override;
     bool cleanupPostRender(CleanupMode mode) override;
+    MemoryUsage getMemoryUsage() override EXCLUDES(mRenderingMutex)
+            EXCLUDES(mFramebufferImageCacheMutex);
 
     EGLDisplay getEGLDisplay() const { return mEGLDisplay; }
     // Creates an output image for rendering to
@@ -100,6 +107,8 @@ public:
     std::shared_ptr<ImageManager::Barrier> cacheExternalTextureBufferForTesting(
             const sp<GraphicBuffer>& buffer);
     std::shared_ptr<ImageManager::Barrier> unbindExternalTextureBufferForTesting(uint64_t bufferId);
+    // Sets how many bytes of buffers mImageCache may keep alive, returning the previous budget
+    size_t setImageCacheBudgetForTesting(size_t budget);
 
 protected:
     Framebuffer* getFramebufferForDrawing() override;
@@ -123,6 +132,8 @@ private:
                                        Protection protection);
     static EGLSurface createStubEglPbufferSurface(EGLDisplay display, EGLConfig config,
                                                   int hwcFormat, Protection protection);
+    // Generates the programs for 'keys' on a context of its own which shares them with 'context'
+    void warmProgramCache(EGLContext context, std::vector<ProgramCache::Key> keys) const;
     std::unique_ptr<Framebuffer> createFramebuffer();
     std::unique_ptr<Image> createImage();
     void checkErrors() const;
@@ -208,12 +219,25 @@ private:
     bool mInProtectedContext = false;
     // If set to true, then enables tracing flush() and finish() to systrace.
     bool mTraceGpuCompletion = false;
+    // If set to true, the keys of the programs used for drawing are recorded, and primeCache()
+    // generates the recorded programs in the background instead of a fixed set of programs.
+    bool mWarmUpRecordedShaders = false;
+    // Thread generating the recorded programs, started by primeCache()
+    mutable std::thread mProgramCacheWarmupThread;
+    std::atomic<bool> mStopProgramCacheWarmup = false;
     // Maximum size of mFramebufferImageCache. If more images would be cached, then (approximately)
     // the last recently used buffer should be kicked out.
     uint32_t mFramebufferImageCacheSize = 0;
 
+    struct CachedFramebufferImage {
+        uint64_t bufferId;
+        EGLImageKHR image;
+        // Approximate size of the buffer memory the image keeps alive
+        size_t size;
+    };
+
     // Cache of output images, keyed by corresponding GraphicBuffer ID.
-    std::deque<std::pair<uint64_t, EGLImageKHR>> mFramebufferImageCache
+    std::deque<CachedFramebufferImage> mFramebufferImageCache
             GUARDED_BY(mFramebufferImageCacheMutex);
     // The only reason why we have this mutex is so that we don't segfault when
     // dumping info.
@@ -229,8 +253,36 @@ private:
     // supports sRGB, DisplayP3 color spaces.
     const bool mUseColorManagement = false;
 
+    struct CachedImage {
+        std::unique_ptr<Image> image;
+        // Approximate size of the buffer memory the image keeps alive
+        size_t size;
+        std::list<uint64_t>::iterator lruEntry;
+    };
+
+    // Adds an image to mImageCache, and moves the least recently bound images out of it into
+    // 'evicted' until the cache fits its budget again, so that they are destroyed without
+    // holding mRenderingMutex.
+    void insertCachedImageLocked(uint64_t bufferId, std::unique_ptr<Image> image, size_t size,
+                                 std::vector<std::unique_ptr<Image>>& evicted)
+            REQUIRES(mRenderingMutex);
+    std::unique_ptr<Image> eraseCachedImageLocked(uint64_t bufferId) REQUIRES(mRenderingMutex);
+    void clearImageCacheLocked() REQUIRES(mRenderingMutex);
+
     // Cache of GL images that we'll store per GraphicBuffer ID
-    std::unordered_map<uint64_t, std::unique_ptr<Image>> mImageCache GUARDED_BY(mRenderingMutex);
+    std::unordered_map<uint64_t, CachedImage> mImageCache GUARDED_BY(mRenderingMutex);
+    // Buffer IDs of mImageCache, most recently bound first
+    std::list<uint64_t> mImageCacheLru GUARDED_BY(mRenderingMutex);
+    // Total size of the images in mImageCache, and how large it may grow, or 0 if unbounded
+    size_t mImageCacheSize GUARDED_BY(mRenderingMutex) = 0;
+    size_t mImageCacheBudget = 0;
+    struct ImageCacheStats {
+        uint64_t hits = 0;
+        // Images which were not cached ahead of time, and had to be created while rendering
+        uint64_t misses = 0;
+        nsecs_t missDuration = 0;
+        uint64_t evictions = 0;
+    } mImageCacheStats GUARDED_BY(mRenderingMutex);
     std::unordered_map<uint32_t, std::optional<uint64_t>> mTextureView;
 
     // Mutex guarding rendering operations, so that:
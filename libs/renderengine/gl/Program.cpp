@@ -17,6 +17,7 @@
 #include "Program.h"
 
 #include <stdint.h>
+#include <algorithm>
 
 #include <log/log.h>
 #include <math/mat4.h>
@@ -75,9 +76,13 @@ Program::Program(const ProgramCache::Key& /*needs*/, const char* vertex, const c
         mCornerRadiusLoc = glGetUniformLocation(programId, "cornerRadius");
         mCropCenterLoc = glGetUniformLocation(programId, "cropCenter");
 
-        // set-up the default values for our uniforms
+        // set-up the default values for our uniforms, the others are 0 once linked
         glUseProgram(programId);
         glUniformMatrix4fv(mProjectionMatrixLoc, 1, GL_FALSE, mat4().asArray());
+        std::copy_n(mat4().asArray(), 16, mUniformValues.projectionMatrix.begin());
+        if (mSamplerLoc >= 0) {
+            glUniform1i(mSamplerLoc, 0);
+        }
         glEnableVertexAttribArray(0);
     }
 }
@@ -100,6 +105,16 @@ GLint Program::getUniform(const char* name) const {
     return glGetUniformLocation(mProgram, name);
 }
 
+// Returns whether 'values' differ from those last uploaded to a uniform, and records them if so
+template <size_t N>
+static bool updateUniformValues(std::array<float, N>& uploaded, const float* values) {
+    if (std::equal(uploaded.begin(), uploaded.end(), values)) {
+        return false;
+    }
+    std::copy_n(values, N, uploaded.begin());
+    return true;
+}
+
 GLuint Program::buildShader(const char* source, GLenum type) {
     GLuint shader = glCreateShader(type);
     glShaderSource(shader, 1, &source, 0);
@@ -119,47 +134,63 @@ GLuint Program::buildShader(const char* source, GLenum type) {
 }
 
 void Program::setUniforms(const Description& desc) {
-    // TODO: we should have a mechanism here to not always reset uniforms that
-    // didn't change for this program.
+    // Consecutive layers share most uniform values, so only upload those which changed
+    // since this program was last used.
+    UniformValues& values = mUniformValues;
 
-    if (mSamplerLoc >= 0) {
-        glUniform1i(mSamplerLoc, 0);
-        glUniformMatrix4fv(mTextureMatrixLoc, 1, GL_FALSE, desc.texture.getMatrix().asArray());
+    if (mSamplerLoc >= 0 &&
+        updateUniformValues(values.textureMatrix, desc.texture.getMatrix().asArray())) {
+        glUniformMatrix4fv(mTextureMatrixLoc, 1, GL_FALSE, values.textureMatrix.data());
     }
     if (mColorLoc >= 0) {
         const float color[4] = {desc.color.r, desc.color.g, desc.color.b, desc.color.a};
-        glUniform4fv(mColorLoc, 1, color);
+        if (updateUniformValues(values.color, color)) {
+            glUniform4fv(mColorLoc, 1, values.color.data());
+        }
     }
-    if (mDisplayColorMatrixLoc >= 0) {
-        glUniformMatrix4fv(mDisplayColorMatrixLoc, 1, GL_FALSE, desc.displayColorMatrix.asArray());
+    if (mDisplayColorMatrixLoc >= 0 &&
+        updateUniformValues(values.displayColorMatrix, desc.displayColorMatrix.asArray())) {
+        glUniformMatrix4fv(mDisplayColorMatrixLoc, 1, GL_FALSE, values.displayColorMatrix.data());
     }
-    if (mInputTransformMatrixLoc >= 0) {
-        mat4 inputTransformMatrix = desc.inputTransformMatrix;
-        glUniformMatrix4fv(mInputTransformMatrixLoc, 1, GL_FALSE, inputTransformMatrix.asArray());
+    if (mInputTransformMatrixLoc >= 0 &&
+        updateUniformValues(values.inputTransformMatrix, desc.inputTransformMatrix.asArray())) {
+        glUniformMatrix4fv(mInputTransformMatrixLoc, 1, GL_FALSE,
+                           values.inputTransformMatrix.data());
     }
     if (mOutputTransformMatrixLoc >= 0) {
         // The output transform matrix and color matrix can be combined as one matrix
         // that is applied right before applying OETF.
         mat4 outputTransformMatrix = desc.colorMatrix * desc.outputTransformMatrix;
-        glUniformMatrix4fv(mOutputTransformMatrixLoc, 1, GL_FALSE, outputTransformMatrix.asArray());
+        if (updateUniformValues(values.outputTransformMatrix, outputTransformMatrix.asArray())) {
+            glUniformMatrix4fv(mOutputTransformMatrixLoc, 1, GL_FALSE,
+                               values.outputTransformMatrix.data());
+        }
     }
-    if (mDisplayMaxLuminanceLoc >= 0) {
+    if (mDisplayMaxLuminanceLoc >= 0 &&
+        updateUniformValues(values.displayMaxLuminance, &desc.displayMaxLuminance)) {
         glUniform1f(mDisplayMaxLuminanceLoc, desc.displayMaxLuminance);
     }
-    if (mMaxMasteringLuminanceLoc >= 0) {
+    if (mMaxMasteringLuminanceLoc >= 0 &&
+        updateUniformValues(values.maxMasteringLuminance, &desc.maxMasteringLuminance)) {
         glUniform1f(mMaxMasteringLuminanceLoc, desc.maxMasteringLuminance);
     }
-    if (mMaxContentLuminanceLoc >= 0) {
+    if (mMaxContentLuminanceLoc >= 0 &&
+        updateUniformValues(values.maxContentLuminance, &desc.maxContentLuminance)) {
         glUniform1f(mMaxContentLuminanceLoc, desc.maxContentLuminance);
     }
-    if (mCornerRadiusLoc >= 0) {
+    if (mCornerRadiusLoc >= 0 && updateUniformValues(values.cornerRadius, &desc.cornerRadius)) {
         glUniform1f(mCornerRadiusLoc, desc.cornerRadius);
     }
     if (mCropCenterLoc >= 0) {
-        glUniform2f(mCropCenterLoc, desc.cropSize.x / 2.0f, desc.cropSize.y / 2.0f);
+        const float cropCenter[2] = {desc.cropSize.x / 2.0f, desc.cropSize.y / 2.0f};
+        if (updateUniformValues(values.cropCenter, cropCenter)) {
+            glUniform2f(mCropCenterLoc, cropCenter[0], cropCenter[1]);
+        }
     }
     // these uniforms are always present
-    glUniformMatrix4fv(mProjectionMatrixLoc, 1, GL_FALSE, desc.projectionMatrix.asArray());
+    if (updateUniformValues(values.projectionMatrix, desc.projectionMatrix.asArray())) {
+        glUniformMatrix4fv(mProjectionMatrixLoc, 1, GL_FALSE, values.projectionMatrix.data());
+    }
 }
 
 } // namespace gl
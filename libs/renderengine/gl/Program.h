@@ -18,6 +18,7 @@
 #define SF_RENDER_ENGINE_PROGRAM_H
 
 #include <stdint.h>
+#include <array>
 
 #include <GLES2/gl2.h>
 #include <renderengine/private/Description.h>
@@ -111,6 +112,21 @@ private:
 
     /* location of surface crop origin uniform, for rounded corner clipping */
     GLint mCropCenterLoc;
+
+    /* values last uploaded to the uniforms, which the program keeps across uses */
+    struct UniformValues {
+        std::array<float, 16> projectionMatrix;
+        std::array<float, 16> textureMatrix;
+        std::array<float, 4> color;
+        std::array<float, 16> displayColorMatrix;
+        std::array<float, 16> inputTransformMatrix;
+        std::array<float, 16> outputTransformMatrix;
+        std::array<float, 1> displayMaxLuminance;
+        std::array<float, 1> maxMasteringLuminance;
+        std::array<float, 1> maxContentLuminance;
+        std::array<float, 1> cornerRadius;
+        std::array<float, 2> cropCenter;
+    } mUniformValues{};
 };
 
 } // namespace gl
@@ -18,8 +18,16 @@
 
 #include "ProgramCache.h"
 
+#include <stdio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <iterator>
+#include <sstream>
+
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
+#include <android-base/file.h>
+#include <android-base/stringprintf.h>
 #include <log/log.h>
 #include <renderengine/private/Description.h>
 #include <utils/String8.h>
@@ -79,6 +87,7 @@ Formatter& dedent(Formatter& f) {
 
 void ProgramCache::primeCache(
         EGLContext context, bool useColorManagement, bool toneMapperShaderOnly) {
+    std::lock_guard<std::mutex> lock(mMutex);
     auto& cache = mCaches[context];
     uint32_t shaderCount = 0;
 
@@ -158,6 +167,89 @@ void ProgramCache::primeCache(
     ALOGD("shader cache generated - %u shaders in %f ms\n", shaderCount, compileTimeMs);
 }
 
+std::vector<ProgramCache::Key> ProgramCache::loadUsedKeys(const std::string& path) {
+    std::string content;
+    if (!base::ReadFileToString(path, &content)) {
+        ALOGI("No recorded shader keys in %s", path.c_str());
+    }
+
+    // Each line holds a key and how often it was used, most used first
+    std::vector<Key> keys;
+    std::istringstream stream(content);
+    std::string line;
+    std::lock_guard<std::mutex> lock(mMutex);
+    while (std::getline(stream, line)) {
+        Key key;
+        uint32_t count = 0;
+        if (sscanf(line.c_str(), "%x %u", &key.mKey, &count) != 2) {
+            ALOGW("Ignoring malformed shader key record '%s' in %s", line.c_str(), path.c_str());
+            continue;
+        }
+        if (mUseCounts.emplace(key, count / 2).second) {
+            keys.push_back(key);
+        }
+    }
+    mUsedKeysPath = path;
+    return keys;
+}
+
+void ProgramCache::saveUsedKeys() {
+    std::vector<std::pair<Key, uint32_t>> counts;
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mUsedKeysPath.empty()) {
+            return;
+        }
+        path = mUsedKeysPath;
+        std::copy_if(mUseCounts.begin(), mUseCounts.end(), std::back_inserter(counts),
+                     [](const auto& count) { return count.second > 0; });
+    }
+    std::sort(counts.begin(), counts.end(),
+              [](const auto& lhs, const auto& rhs) { return lhs.second > rhs.second; });
+
+    std::string content;
+    for (const auto& [key, count] : counts) {
+        base::StringAppendF(&content, "%08x %u\n", key.mKey, count);
+    }
+
+    // Write a temporary file first, so that a crash cannot leave a partial record behind
+    const std::string tempPath = path + ".tmp";
+    if (!base::WriteStringToFile(content, tempPath) || rename(tempPath.c_str(), path.c_str())) {
+        ALOGW("Failed to record the used shader keys into %s", path.c_str());
+        unlink(tempPath.c_str());
+    }
+}
+
+size_t ProgramCache::warmCache(EGLContext context, const std::vector<Key>& keys,
+                               const std::atomic<bool>& stop) {
+    ATRACE_CALL();
+    size_t count = 0;
+    for (const Key& key : keys) {
+        if (stop) {
+            break;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (mCaches[context].count(key) != 0) {
+                continue;
+            }
+        }
+
+        // Generate the program without holding the lock, so that drawing is not blocked. The
+        // program must be complete before it becomes visible to the context drawing with it.
+        std::unique_ptr<Program> program = generateProgram(key);
+        glFinish();
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        // The program may have been generated for drawing meanwhile
+        if (mCaches[context].emplace(key, std::move(program)).second) {
+            count++;
+        }
+    }
+    return count;
+}
+
 ProgramCache::Key ProgramCache::computeKey(const Description& description) {
     Key needs;
     needs.set(Key::TEXTURE_MASK,
@@ -807,6 +899,12 @@ void ProgramCache::useProgram(EGLContext context, const Description& description
     Key needs(computeKey(description));
 
     // look-up the program in the cache
+    std::unique_lock<std::mutex> lock(mMutex);
+    uint32_t& useCount = mUseCounts[needs];
+    const bool isNewKey = useCount == 0;
+    if (useCount < UINT32_MAX) {
+        useCount++;
+    }
     auto& cache = mCaches[context];
     auto it = cache.find(needs);
     if (it == cache.end()) {
@@ -819,8 +917,15 @@ void ProgramCache::useProgram(EGLContext context, const Description& description
               context, needs.mKey, uint32_t(ns2ms(time)), cache.size());
     }
 
+    // Programs are only ever added to the cache, so the program outlives the lock. Record new
+    // keys right away, so that the next boot warms them up even if this one does not end cleanly.
+    Program* const program = it->second.get();
+    lock.unlock();
+    if (isNewKey) {
+        saveUsedKeys();
+    }
+
     // here we have a suitable program for this description
-    std::unique_ptr<Program>& program = it->second;
     if (program->isValid()) {
         program->use();
         program->setUniforms(description);
@@ -17,12 +17,17 @@
 #ifndef SF_RENDER_ENGINE_PROGRAMCACHE_H
 #define SF_RENDER_ENGINE_PROGRAMCACHE_H
 
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include <string>
 #include <unordered_map>
+#include <vector>
 
 #include <EGL/egl.h>
 #include <GLES2/gl2.h>
 #include <renderengine/private/Description.h>
+#include <android-base/thread_annotations.h>
 #include <utils/Singleton.h>
 #include <utils/TypeHelpers.h>
 
@@ -194,15 +199,32 @@ public:
     ~ProgramCache() = default;
 
     // Generate shaders to populate the cache
-    void primeCache(const EGLContext context, bool useColorManagement, bool toneMapperShaderOnly);
+    void primeCache(const EGLContext context, bool useColorManagement, bool toneMapperShaderOnly)
+            EXCLUDES(mMutex);
 
-    size_t getSize(const EGLContext context) { return mCaches[context].size(); }
+    // Reads the keys recorded into 'path' by previous boots, and records the keys used from now on
+    // into it whenever a program has to be generated while drawing. Returns the recorded keys,
+    // most used first.
+    std::vector<Key> loadUsedKeys(const std::string& path) EXCLUDES(mMutex);
+
+    // Generates the programs for 'keys' which are not cached for 'context' yet, in order, until
+    // 'stop' is set. The programs are generated with the calling thread's current context, which
+    // must share them with 'context'. Returns the number of generated programs.
+    size_t warmCache(const EGLContext context, const std::vector<Key>& keys,
+                     const std::atomic<bool>& stop) EXCLUDES(mMutex);
+
+    size_t getSize(const EGLContext context) EXCLUDES(mMutex) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mCaches[context].size();
+    }
 
     // useProgram lookup a suitable program in the cache or generates one
     // if none can be found.
-    void useProgram(const EGLContext context, const Description& description);
+    void useProgram(const EGLContext context, const Description& description) EXCLUDES(mMutex);
 
 private:
+    // Writes the used keys into mUsedKeysPath, most used first
+    void saveUsedKeys() EXCLUDES(mMutex);
     // compute a cache Key from a Description
     static Key computeKey(const Description& description);
     // Generate EOTF based from Key.
@@ -220,10 +242,19 @@ private:
     // generates the fragment shader from the Key
     static String8 generateFragmentShader(const Key& needs);
 
+    // Guards the cache, which is warmed up by a background thread while drawing
+    std::mutex mMutex;
+
     // Key/Value map used for caching Programs. Currently the cache
     // is never shrunk (and the GL program objects are never deleted).
     std::unordered_map<EGLContext, std::unordered_map<Key, std::unique_ptr<Program>, Key::Hash>>
-            mCaches;
+            mCaches GUARDED_BY(mMutex);
+
+    // How often each key was used, for the keys to generate first when warming the cache on the
+    // next boot. The counts read from a previous boot are halved, so that they fade out once the
+    // keys are no longer used.
+    std::unordered_map<Key, uint32_t, Key::Hash> mUseCounts GUARDED_BY(mMutex);
+    std::string mUsedKeysPath GUARDED_BY(mMutex);
 };
 
 } // namespace gl
@@ -21,8 +21,12 @@
 #include <EGL/eglext.h>
 #include <GLES3/gl3.h>
 #include <GLES3/gl3ext.h>
+#include <cutils/properties.h>
 #include <ui/GraphicTypes.h>
+#include <algorithm>
+#include <cmath>
 #include <cstdint>
+#include <cstring>
 
 #include <utils/Trace.h>
 
@@ -30,13 +34,26 @@ namespace android {
 namespace renderengine {
 namespace gl {
 
+static BlurFilter::Algorithm getAlgorithmProperty() {
+    char value[PROPERTY_VALUE_MAX];
+    property_get("ro.sf.blur_algorithm", value, "kawase");
+    if (strcmp(value, "dual_kawase") == 0) {
+        return BlurFilter::Algorithm::DUAL_KAWASE;
+    }
+    ALOGE_IF(strcmp(value, "kawase") != 0, "Unknown blur algorithm %s, using kawase", value);
+    return BlurFilter::Algorithm::KAWASE;
+}
+
 BlurFilter::BlurFilter(GLESRenderEngine& engine)
-      : mEngine(engine),
+      : mAlgorithm(getAlgorithmProperty()),
+        mEngine(engine),
         mCompositionFbo(engine),
         mPingFbo(engine),
         mPongFbo(engine),
         mMixProgram(engine),
-        mBlurProgram(engine) {
+        mBlurProgram(engine),
+        mDownsampleProgram(engine),
+        mUpsampleProgram(engine) {
     mMixProgram.compile(getVertexShader(), getMixFragShader());
     mMPosLoc = mMixProgram.getAttributeLocation("aPosition");
     mMUvLoc = mMixProgram.getAttributeLocation("aUV");
@@ -44,11 +61,29 @@ BlurFilter::BlurFilter(GLESRenderEngine& engine)
     mMCompositionTextureLoc = mMixProgram.getUniformLocation("uCompositionTexture");
     mMMixLoc = mMixProgram.getUniformLocation("uMix");
 
-    mBlurProgram.compile(getVertexShader(), getFragmentShader());
-    mBPosLoc = mBlurProgram.getAttributeLocation("aPosition");
-    mBUvLoc = mBlurProgram.getAttributeLocation("aUV");
-    mBTextureLoc = mBlurProgram.getUniformLocation("uTexture");
-    mBOffsetLoc = mBlurProgram.getUniformLocation("uOffset");
+    if (mAlgorithm == Algorithm::DUAL_KAWASE) {
+        mDownsampleProgram.compile(getVertexShader(), getDownsampleFragShader());
+        mDPosLoc = mDownsampleProgram.getAttributeLocation("aPosition");
+        mDUvLoc = mDownsampleProgram.getAttributeLocation("aUV");
+        mDTextureLoc = mDownsampleProgram.getUniformLocation("uTexture");
+        mDOffsetLoc = mDownsampleProgram.getUniformLocation("uOffset");
+
+        mUpsampleProgram.compile(getVertexShader(), getUpsampleFragShader());
+        mUPosLoc = mUpsampleProgram.getAttributeLocation("aPosition");
+        mUUvLoc = mUpsampleProgram.getAttributeLocation("aUV");
+        mUTextureLoc = mUpsampleProgram.getUniformLocation("uTexture");
+        mUOffsetLoc = mUpsampleProgram.getUniformLocation("uOffset");
+
+        for (uint32_t i = 0; i < kMaxDualKawaseLevels; i++) {
+            mDualKawaseFbos.push_back(std::make_unique<GLFramebuffer>(engine));
+        }
+    } else {
+        mBlurProgram.compile(getVertexShader(), getFragmentShader());
+        mBPosLoc = mBlurProgram.getAttributeLocation("aPosition");
+        mBUvLoc = mBlurProgram.getAttributeLocation("aUV");
+        mBTextureLoc = mBlurProgram.getUniformLocation("uTexture");
+        mBOffsetLoc = mBlurProgram.getUniformLocation("uOffset");
+    }
 
     static constexpr auto size = 2.0f;
     static constexpr auto translation = 1.0f;
@@ -78,27 +113,14 @@ status_t BlurFilter::setAsDrawTarget(const DisplaySettings& display, uint32_t ra
         mDisplayWidth = display.physicalDisplay.width();
         mDisplayHeight = display.physicalDisplay.height();
         mCompositionFbo.allocateBuffers(mDisplayWidth, mDisplayHeight);
-
-        const uint32_t fboWidth = floorf(mDisplayWidth * kFboScale);
-        const uint32_t fboHeight = floorf(mDisplayHeight * kFboScale);
-        mPingFbo.allocateBuffers(fboWidth, fboHeight);
-        mPongFbo.allocateBuffers(fboWidth, fboHeight);
-
-        if (mPingFbo.getStatus() != GL_FRAMEBUFFER_COMPLETE) {
-            ALOGE("Invalid ping buffer");
-            return mPingFbo.getStatus();
-        }
-        if (mPongFbo.getStatus() != GL_FRAMEBUFFER_COMPLETE) {
-            ALOGE("Invalid pong buffer");
-            return mPongFbo.getStatus();
-        }
         if (mCompositionFbo.getStatus() != GL_FRAMEBUFFER_COMPLETE) {
             ALOGE("Invalid composition buffer");
             return mCompositionFbo.getStatus();
         }
-        if (!mBlurProgram.isValid()) {
-            ALOGE("Invalid shader");
-            return GL_INVALID_OPERATION;
+
+        const status_t status = allocateBlurBuffers();
+        if (status != NO_ERROR) {
+            return status;
         }
     }
 
@@ -107,6 +129,58 @@ status_t BlurFilter::setAsDrawTarget(const DisplaySettings& display, uint32_t ra
     return NO_ERROR;
 }
 
+status_t BlurFilter::allocateBlurBuffers() {
+    if (mAlgorithm == Algorithm::DUAL_KAWASE) {
+        uint32_t fboWidth = mDisplayWidth;
+        uint32_t fboHeight = mDisplayHeight;
+        for (const auto& fbo : mDualKawaseFbos) {
+            fboWidth = max(fboWidth / 2, 1u);
+            fboHeight = max(fboHeight / 2, 1u);
+            fbo->allocateBuffers(fboWidth, fboHeight);
+            if (fbo->getStatus() != GL_FRAMEBUFFER_COMPLETE) {
+                ALOGE("Invalid dual filter buffer");
+                return fbo->getStatus();
+            }
+        }
+        if (!mDownsampleProgram.isValid() || !mUpsampleProgram.isValid()) {
+            ALOGE("Invalid shader");
+            return GL_INVALID_OPERATION;
+        }
+        return NO_ERROR;
+    }
+
+    const uint32_t fboWidth = floorf(mDisplayWidth * kFboScale);
+    const uint32_t fboHeight = floorf(mDisplayHeight * kFboScale);
+    mPingFbo.allocateBuffers(fboWidth, fboHeight);
+    mPongFbo.allocateBuffers(fboWidth, fboHeight);
+
+    if (mPingFbo.getStatus() != GL_FRAMEBUFFER_COMPLETE) {
+        ALOGE("Invalid ping buffer");
+        return mPingFbo.getStatus();
+    }
+    if (mPongFbo.getStatus() != GL_FRAMEBUFFER_COMPLETE) {
+        ALOGE("Invalid pong buffer");
+        return mPongFbo.getStatus();
+    }
+    if (!mBlurProgram.isValid()) {
+        ALOGE("Invalid shader");
+        return GL_INVALID_OPERATION;
+    }
+    return NO_ERROR;
+}
+
+size_t BlurFilter::getMemoryBytes() const {
+    // The RGB textures are assumed to be padded to 4 bytes per pixel, as most drivers do.
+    const auto bytes = [](const GLFramebuffer& fbo) {
+        return static_cast<size_t>(fbo.getBufferWidth()) * fbo.getBufferHeight() * 4;
+    };
+    size_t total = bytes(mCompositionFbo) + bytes(mPingFbo) + bytes(mPongFbo);
+    for (const auto& fbo : mDualKawaseFbos) {
+        total += bytes(*fbo);
+    }
+    return total;
+}
+
 void BlurFilter::drawMesh(GLuint uv, GLuint position) {
 
     glEnableVertexAttribArray(uv);
@@ -124,7 +198,10 @@ void BlurFilter::drawMesh(GLuint uv, GLuint position) {
 
 status_t BlurFilter::prepare() {
     ATRACE_NAME("BlurFilter::prepare");
+    return mAlgorithm == Algorithm::DUAL_KAWASE ? prepareDualKawase() : prepareKawase();
+}
 
+status_t BlurFilter::prepareKawase() {
     // Kawase is an approximation of Gaussian, but it behaves differently from it.
     // A radius transformation is required for approximating them, and also to introduce
     // non-integer steps, necessary to smoothly interpolate large radii.
@@ -171,6 +248,49 @@ status_t BlurFilter::prepare() {
     return NO_ERROR;
 }
 
+status_t BlurFilter::prepareDualKawase() {
+    // Each level halves the resolution, which roughly doubles the radius the offsets sample at.
+    // Pick the fewest levels which keep the offset below 2 pixels of the smallest buffer, as
+    // larger offsets show the sampling pattern. Non-integer offsets interpolate between radii.
+    const float radius = max(mRadius / 2.0f, 1.0f);
+    const auto levels = static_cast<uint32_t>(
+            clamp(ceil(log2(radius / 2.0f)), 1.0f, static_cast<float>(kMaxDualKawaseLevels)));
+    const float offset = radius / static_cast<float>(1u << levels);
+
+    // Downsample the composited frame into the smaller and smaller buffers...
+    mDownsampleProgram.useProgram();
+    glActiveTexture(GL_TEXTURE0);
+    glUniform1i(mDTextureLoc, 0);
+    const GLFramebuffer* read = &mCompositionFbo;
+    for (uint32_t i = 0; i < levels; i++) {
+        ATRACE_NAME("BlurFilter::downsamplePass");
+        const GLFramebuffer* draw = mDualKawaseFbos[i].get();
+        draw->bind();
+        glViewport(0, 0, draw->getBufferWidth(), draw->getBufferHeight());
+        glBindTexture(GL_TEXTURE_2D, read->getTextureName());
+        glUniform2f(mDOffsetLoc, offset / read->getBufferWidth(), offset / read->getBufferHeight());
+        drawMesh(mDUvLoc, mDPosLoc);
+        read = draw;
+    }
+
+    // ... and upsample it back to the largest one, which render() scales up to the display.
+    mUpsampleProgram.useProgram();
+    glUniform1i(mUTextureLoc, 0);
+    for (uint32_t i = levels - 1; i > 0; i--) {
+        ATRACE_NAME("BlurFilter::upsamplePass");
+        const GLFramebuffer* draw = mDualKawaseFbos[i - 1].get();
+        draw->bind();
+        glViewport(0, 0, draw->getBufferWidth(), draw->getBufferHeight());
+        glBindTexture(GL_TEXTURE_2D, read->getTextureName());
+        glUniform2f(mUOffsetLoc, offset / draw->getBufferWidth(), offset / draw->getBufferHeight());
+        drawMesh(mUUvLoc, mUPosLoc);
+        read = draw;
+    }
+    mLastDrawTarget = mDualKawaseFbos[0].get();
+
+    return NO_ERROR;
+}
+
 status_t BlurFilter::render(bool multiPass) {
     ATRACE_NAME("BlurFilter::render");
 
@@ -243,6 +363,53 @@ string BlurFilter::getFragmentShader() const {
     )SHADER";
 }
 
+string BlurFilter::getDownsampleFragShader() const {
+    return R"SHADER(#version 310 es
+        precision mediump float;
+
+        uniform sampler2D uTexture;
+        uniform vec2 uOffset;
+
+        in highp vec2 vUV;
+        out vec4 fragColor;
+
+        void main() {
+            fragColor  = texture(uTexture, vUV, 0.0) * 4.0;
+            fragColor += texture(uTexture, vUV + vec2( uOffset.x,  uOffset.y), 0.0);
+            fragColor += texture(uTexture, vUV + vec2( uOffset.x, -uOffset.y), 0.0);
+            fragColor += texture(uTexture, vUV + vec2(-uOffset.x,  uOffset.y), 0.0);
+            fragColor += texture(uTexture, vUV + vec2(-uOffset.x, -uOffset.y), 0.0);
+
+            fragColor = vec4(fragColor.rgb * 0.125, 1.0);
+        }
+    )SHADER";
+}
+
+string BlurFilter::getUpsampleFragShader() const {
+    return R"SHADER(#version 310 es
+        precision mediump float;
+
+        uniform sampler2D uTexture;
+        uniform vec2 uOffset;
+
+        in highp vec2 vUV;
+        out vec4 fragColor;
+
+        void main() {
+            fragColor  = texture(uTexture, vUV + vec2(-uOffset.x * 2.0, 0.0), 0.0);
+            fragColor += texture(uTexture, vUV + vec2( uOffset.x * 2.0, 0.0), 0.0);
+            fragColor += texture(uTexture, vUV + vec2(0.0, -uOffset.y * 2.0), 0.0);
+            fragColor += texture(uTexture, vUV + vec2(0.0,  uOffset.y * 2.0), 0.0);
+            fragColor += texture(uTexture, vUV + vec2( uOffset.x,  uOffset.y), 0.0) * 2.0;
+            fragColor += texture(uTexture, vUV + vec2( uOffset.x, -uOffset.y), 0.0) * 2.0;
+            fragColor += texture(uTexture, vUV + vec2(-uOffset.x,  uOffset.y), 0.0) * 2.0;
+            fragColor += texture(uTexture, vUV + vec2(-uOffset.x, -uOffset.y), 0.0) * 2.0;
+
+            fragColor = vec4(fragColor.rgb / 12.0, 1.0);
+        }
+    )SHADER";
+}
+
 string BlurFilter::getMixFragShader() const {
     string shader = R"SHADER(#version 310 es
         precision mediump float;
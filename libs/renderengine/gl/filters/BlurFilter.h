@@ -16,6 +16,9 @@
 
 #pragma once
 
+#include <memory>
+#include <vector>
+
 #include <ui/GraphicTypes.h>
 #include "../GLESRenderEngine.h"
 #include "../GLFramebuffer.h"
@@ -32,13 +35,25 @@ namespace gl {
  * This is an implementation of a Kawase blur, as described in here:
  * https://community.arm.com/cfs-file/__key/communityserver-blogs-components-weblogfiles/
  * 00-00-00-20-66/siggraph2015_2D00_mmg_2D00_marius_2D00_notes.pdf
+ *
+ * Setting ro.sf.blur_algorithm to dual_kawase selects the dual filter described in the same
+ * notes instead. It downsamples the composited frame by half at each pass, and then upsamples it
+ * back, so that most passes sample small buffers. Large radii need fewer and cheaper passes than
+ * with the Kawase blur, which suits GPUs with little bandwidth.
  */
 class BlurFilter {
 public:
+    enum class Algorithm {
+        KAWASE,
+        DUAL_KAWASE,
+    };
+
     // Downsample FBO to improve performance
     static constexpr float kFboScale = 0.25f;
     // Maximum number of render passes
     static constexpr uint32_t kMaxPasses = 4;
+    // Maximum number of times the dual filter halves the resolution
+    static constexpr uint32_t kMaxDualKawaseLevels = 5;
     // To avoid downscaling artifacts, we interpolate the blurred fbo with the full composited
     // image, up to this radius.
     static constexpr float kMaxCrossFadeRadius = 30.0f;
@@ -53,12 +68,23 @@ public:
     // Render blur to the bound framebuffer (screen).
     status_t render(bool multiPass);
 
+    Algorithm getAlgorithm() const { return mAlgorithm; }
+    // Returns the approximate size of the offscreen buffers allocated so far.
+    size_t getMemoryBytes() const;
+
 private:
     uint32_t mRadius;
     void drawMesh(GLuint uv, GLuint position);
+    status_t allocateBlurBuffers();
+    status_t prepareKawase();
+    status_t prepareDualKawase();
     string getVertexShader() const;
     string getFragmentShader() const;
     string getMixFragShader() const;
+    string getDownsampleFragShader() const;
+    string getUpsampleFragShader() const;
+
+    const Algorithm mAlgorithm;
 
     GLESRenderEngine& mEngine;
     // Frame buffer holding the composited background.
@@ -66,6 +92,8 @@ private:
     // Frame buffers holding the blur passes.
     GLFramebuffer mPingFbo;
     GLFramebuffer mPongFbo;
+    // Frame buffers holding the dual filter passes, each half the size of the previous one.
+    vector<unique_ptr<GLFramebuffer>> mDualKawaseFbos;
     uint32_t mDisplayWidth = 0;
     uint32_t mDisplayHeight = 0;
     uint32_t mDisplayX = 0;
@@ -88,6 +116,18 @@ private:
     GLuint mBUvLoc;
     GLuint mBTextureLoc;
     GLuint mBOffsetLoc;
+
+    GenericProgram mDownsampleProgram;
+    GLuint mDPosLoc;
+    GLuint mDUvLoc;
+    GLuint mDTextureLoc;
+    GLuint mDOffsetLoc;
+
+    GenericProgram mUpsampleProgram;
+    GLuint mUPosLoc;
+    GLuint mUUvLoc;
+    GLuint mUTextureLoc;
+    GLuint mUOffsetLoc;
 };
 
 } // namespace gl
@@ -20,6 +20,7 @@
 #include <stdint.h>
 #include <sys/types.h>
 #include <memory>
+#include <unordered_map>
 
 #include <android-base/unique_fd.h>
 #include <math/mat4.h>
@@ -131,7 +132,19 @@ public:
     // do any work.
     virtual bool cleanupPostRender(CleanupMode mode = CleanupMode::CLEAN_OUTPUT_RESOURCES) = 0;
 
+    struct MemoryUsage {
+        // Approximate size of the buffers kept alive by cached input images, by buffer ID
+        std::unordered_map<uint64_t, size_t> imageCacheBytes;
+        // Approximate size of the buffers kept alive by cached output images
+        size_t framebufferImageCacheBytes = 0;
+        // Size of the offscreen buffers used to blur layers
+        size_t blurBytes = 0;
+    };
+
     // queries
+    // Returns the memory held by RenderEngine. Must be called from the thread calling
+    // drawLayers.
+    virtual MemoryUsage getMemoryUsage() = 0;
     virtual size_t getMaxTextureSize() const = 0;
     virtual size_t getMaxViewportDims() const = 0;
 
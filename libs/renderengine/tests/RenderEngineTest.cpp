@@ -1392,6 +1392,7 @@ TEST_F(RenderEngineTest, cacheExternalBuffer_cachesImages) {
         EXPECT_EQ(NO_ERROR, barrier->result);
     }
     EXPECT_TRUE(sRE->isImageCachedForTesting(bufferId));
+    EXPECT_GT(sRE->getMemoryUsage().imageCacheBytes[bufferId], 0u);
     barrier = sRE->unbindExternalTextureBufferForTesting(bufferId);
     {
         std::lock_guard<std::mutex> lock(barrier->mutex);
@@ -1402,6 +1403,36 @@ TEST_F(RenderEngineTest, cacheExternalBuffer_cachesImages) {
         EXPECT_EQ(NO_ERROR, barrier->result);
     }
     EXPECT_FALSE(sRE->isImageCachedForTesting(bufferId));
+    EXPECT_EQ(0u, sRE->getMemoryUsage().imageCacheBytes.count(bufferId));
+}
+
+TEST_F(RenderEngineTest, cacheExternalBuffer_evictsLeastRecentlyBoundImages) {
+    // Any two buffers exceed the budget, so caching the second one evicts the first one
+    const size_t budget = sRE->setImageCacheBudgetForTesting(1);
+    sp<GraphicBuffer> first = allocateSourceBuffer(1, 1);
+    sp<GraphicBuffer> second = allocateSourceBuffer(1, 1);
+    for (const auto& buf : {first, second}) {
+        std::shared_ptr<renderengine::gl::ImageManager::Barrier> barrier =
+                sRE->cacheExternalTextureBufferForTesting(buf);
+        std::lock_guard<std::mutex> lock(barrier->mutex);
+        ASSERT_TRUE(barrier->condition.wait_for(barrier->mutex, std::chrono::seconds(5),
+                                                [&]() REQUIRES(barrier->mutex) {
+                                                    return barrier->isOpen;
+                                                }));
+        EXPECT_EQ(NO_ERROR, barrier->result);
+    }
+    sRE->setImageCacheBudgetForTesting(budget);
+    EXPECT_FALSE(sRE->isImageCachedForTesting(first->getId()));
+    EXPECT_TRUE(sRE->isImageCachedForTesting(second->getId()));
+
+    std::shared_ptr<renderengine::gl::ImageManager::Barrier> barrier =
+            sRE->unbindExternalTextureBufferForTesting(second->getId());
+    std::lock_guard<std::mutex> lock(barrier->mutex);
+    ASSERT_TRUE(barrier->condition.wait_for(barrier->mutex, std::chrono::seconds(5),
+                                            [&]() REQUIRES(barrier->mutex) {
+                                                return barrier->isOpen;
+                                            }));
+    EXPECT_FALSE(sRE->isImageCachedForTesting(second->getId()));
 }
 
 TEST_F(RenderEngineTest, drawLayers_fillShadow_casterLayerMinSize) {
@@ -16,6 +16,10 @@
 
 #include <ui/ColorSpace.h>
 
+#include <list>
+#include <mutex>
+#include <vector>
+
 using namespace std::placeholders;
 
 namespace android {
@@ -82,6 +86,19 @@ static ColorSpace::transfer_function toEOTF(float gamma) {
     return std::bind(safePow, _1, gamma);
 }
 
+template <typename T>
+static bool isFunction(const std::function<float(float)>& function, T* target) {
+    auto* stored = function.target<T*>();
+    return stored != nullptr && *stored == target;
+}
+
+// saturate() has internal linkage, so this only recognizes clamping functions
+// defaulted in this file, e.g. those of the color spaces defined below. Other
+// color spaces simply do not get the specialized LUT paths.
+static bool isSaturate(const ColorSpace::clamping_function& function) {
+    return isFunction(function, saturate<float>);
+}
+
 static constexpr std::array<float2, 3> computePrimaries(const mat3& rgbToXYZ) {
     float3 r(rgbToXYZ * float3{1, 0, 0});
     float3 g(rgbToXYZ * float3{0, 1, 0});
@@ -110,7 +127,11 @@ ColorSpace::ColorSpace(
         , mEOTF(std::move(EOTF))
         , mClamper(std::move(clamper))
         , mPrimaries(computePrimaries(rgbToXYZ))
-        , mWhitePoint(computeWhitePoint(rgbToXYZ)) {
+        , mWhitePoint(computeWhitePoint(rgbToXYZ))
+        , mTransferType(isFunction(mOETF, linearResponse) && isFunction(mEOTF, linearResponse)
+                                ? TransferType::LINEAR
+                                : TransferType::FUNCTION)
+        , mSaturates(isSaturate(mClamper)) {
 }
 
 ColorSpace::ColorSpace(
@@ -126,7 +147,9 @@ ColorSpace::ColorSpace(
         , mEOTF(toEOTF(mParameters))
         , mClamper(std::move(clamper))
         , mPrimaries(computePrimaries(rgbToXYZ))
-        , mWhitePoint(computeWhitePoint(rgbToXYZ)) {
+        , mWhitePoint(computeWhitePoint(rgbToXYZ))
+        , mTransferType(TransferType::PARAMETRIC)
+        , mSaturates(isSaturate(mClamper)) {
 }
 
 ColorSpace::ColorSpace(
@@ -142,7 +165,9 @@ ColorSpace::ColorSpace(
         , mEOTF(toEOTF(gamma))
         , mClamper(std::move(clamper))
         , mPrimaries(computePrimaries(rgbToXYZ))
-        , mWhitePoint(computeWhitePoint(rgbToXYZ)) {
+        , mWhitePoint(computeWhitePoint(rgbToXYZ))
+        , mTransferType(gamma == 1.0f ? TransferType::LINEAR : TransferType::GAMMA)
+        , mSaturates(isSaturate(mClamper)) {
 }
 
 ColorSpace::ColorSpace(
@@ -159,7 +184,11 @@ ColorSpace::ColorSpace(
         , mEOTF(std::move(EOTF))
         , mClamper(std::move(clamper))
         , mPrimaries(primaries)
-        , mWhitePoint(whitePoint) {
+        , mWhitePoint(whitePoint)
+        , mTransferType(isFunction(mOETF, linearResponse) && isFunction(mEOTF, linearResponse)
+                                ? TransferType::LINEAR
+                                : TransferType::FUNCTION)
+        , mSaturates(isSaturate(mClamper)) {
 }
 
 ColorSpace::ColorSpace(
@@ -176,7 +205,9 @@ ColorSpace::ColorSpace(
         , mEOTF(toEOTF(mParameters))
         , mClamper(std::move(clamper))
         , mPrimaries(primaries)
-        , mWhitePoint(whitePoint) {
+        , mWhitePoint(whitePoint)
+        , mTransferType(TransferType::PARAMETRIC)
+        , mSaturates(isSaturate(mClamper)) {
 }
 
 ColorSpace::ColorSpace(
@@ -193,7 +224,9 @@ ColorSpace::ColorSpace(
         , mEOTF(toEOTF(gamma))
         , mClamper(std::move(clamper))
         , mPrimaries(primaries)
-        , mWhitePoint(whitePoint) {
+        , mWhitePoint(whitePoint)
+        , mTransferType(gamma == 1.0f ? TransferType::LINEAR : TransferType::GAMMA)
+        , mSaturates(isSaturate(mClamper)) {
 }
 
 constexpr mat3 ColorSpace::computeXYZMatrix(
@@ -351,28 +384,189 @@ const ColorSpace ColorSpace::ACEScg() {
     };
 }
 
-std::unique_ptr<float3[]> ColorSpace::createLUT(uint32_t size, const ColorSpace& src,
-                                                const ColorSpace& dst) {
-    size = clamp(size, 2u, 256u);
-    float m = 1.0f / float(size - 1);
+namespace {
 
-    std::unique_ptr<float3[]> lut(new float3[size * size * size]);
-    float3* data = lut.get();
+// Encoding functions used to fill LUTs. They compute the same values as the
+// std::function built for each transfer type, but can be inlined in the loops
+// that fill the LUT.
+struct FunctionEncoder {
+    const ColorSpace::transfer_function& function;
+    float operator()(float v) const { return function(v); }
+};
 
-    ColorSpaceConnector connector(src, dst);
+struct LinearEncoder {
+    float operator()(float v) const { return v; }
+};
+
+struct GammaEncoder {
+    float exponent;
+    float operator()(float v) const { return safePow(v, exponent); }
+};
+
+struct ParametricEncoder {
+    ColorSpace::TransferParameters parameters;
+    float operator()(float v) const { return rcpResponse(v, parameters); }
+};
 
+struct FullParametricEncoder {
+    ColorSpace::TransferParameters parameters;
+    float operator()(float v) const { return rcpFullResponse(v, parameters); }
+};
+
+struct FunctionClamper {
+    const ColorSpace::clamping_function& function;
+    float operator()(float v) const { return function(v); }
+};
+
+struct SaturateClamper {
+    float operator()(float v) const { return saturate(v); }
+};
+
+// Encodes and clamps rows of linear values. The components are stored in
+// separate arrays, so that each loop applies one function to a contiguous
+// lane of samples.
+template <typename Encoder, typename Clamper>
+void encodeRow(size_t count, float* r, float* g, float* b, Encoder encode, Clamper clamp) {
+    for (size_t i = 0; i < count; i++) {
+        r[i] = clamp(encode(r[i]));
+    }
+    for (size_t i = 0; i < count; i++) {
+        g[i] = clamp(encode(g[i]));
+    }
+    for (size_t i = 0; i < count; i++) {
+        b[i] = clamp(encode(b[i]));
+    }
+}
+
+template <typename Encoder, typename Clamper>
+void fillLUTWith(uint32_t size, const std::vector<float>& linear, const mat3& transform,
+                 Encoder encode, Clamper clamp, float3* data) {
+    // The LUT is separable up to the matrix multiply: the decoded value of
+    // each coordinate only depends on its index, and each column of the
+    // matrix only applies to one coordinate.
+    std::vector<float3> red(size), green(size), blue(size);
+    for (uint32_t i = 0; i < size; i++) {
+        red[i] = transform[0] * linear[i];
+        green[i] = transform[1] * linear[i];
+        blue[i] = transform[2] * linear[i];
+    }
+
+    std::vector<float> r(size), g(size), b(size);
     for (uint32_t z = 0; z < size; z++) {
         for (int32_t y = int32_t(size - 1); y >= 0; y--) {
             for (uint32_t x = 0; x < size; x++) {
-                *data++ = connector.transform({
-                    static_cast<float>(x) * m,
-                    static_cast<float>(y) * m,
-                    static_cast<float>(z) * m,
-                });
+                const float3 v = red[x] + green[y] + blue[z];
+                r[x] = v.r;
+                g[x] = v.g;
+                b[x] = v.b;
+            }
+            encodeRow(size, r.data(), g.data(), b.data(), encode, clamp);
+            for (uint32_t x = 0; x < size; x++) {
+                *data++ = float3{r[x], g[x], b[x]};
             }
         }
     }
+}
+
+} // namespace
+
+void ColorSpace::fillLUT(uint32_t size, const ColorSpace& src, const ColorSpace& dst,
+                         float3* data) {
+    const float m = 1.0f / float(size - 1);
+    ColorSpaceConnector connector(src, dst);
+
+    // Every coordinate takes the same 'size' values, so the source transfer
+    // function only needs to be evaluated 'size' times.
+    std::vector<float> linear(size);
+    for (uint32_t i = 0; i < size; i++) {
+        linear[i] = src.mEOTF(src.mClamper(static_cast<float>(i) * m));
+    }
+
+    const mat3& transform = connector.getTransform();
+    const TransferParameters& p = dst.mParameters;
+    auto fill = [&](auto clamp) {
+        switch (dst.mTransferType) {
+            case TransferType::LINEAR:
+                fillLUTWith(size, linear, transform, LinearEncoder{}, clamp, data);
+                break;
+            case TransferType::GAMMA:
+                fillLUTWith(size, linear, transform, GammaEncoder{1.0f / p.g}, clamp, data);
+                break;
+            case TransferType::PARAMETRIC:
+                if (p.e == 0.0f && p.f == 0.0f) {
+                    fillLUTWith(size, linear, transform, ParametricEncoder{p}, clamp, data);
+                } else {
+                    fillLUTWith(size, linear, transform, FullParametricEncoder{p}, clamp, data);
+                }
+                break;
+            case TransferType::FUNCTION:
+                fillLUTWith(size, linear, transform, FunctionEncoder{dst.mOETF}, clamp, data);
+                break;
+        }
+    };
+
+    if (dst.mSaturates) {
+        fill(SaturateClamper{});
+    } else {
+        fill(FunctionClamper{dst.mClamper});
+    }
+}
+
+std::unique_ptr<float3[]> ColorSpace::createLUT(uint32_t size, const ColorSpace& src,
+                                                const ColorSpace& dst) {
+    size = clamp(size, 2u, 256u);
+
+    std::unique_ptr<float3[]> lut(new float3[size * size * size]);
+    fillLUT(size, src, dst, lut.get());
+    return lut;
+}
+
+bool ColorSpace::isCacheable(const ColorSpace& colorSpace) {
+    return colorSpace.mTransferType != TransferType::FUNCTION && colorSpace.mSaturates;
+}
+
+bool ColorSpace::isSameColorSpace(const ColorSpace& lhs, const ColorSpace& rhs) {
+    const TransferParameters& l = lhs.mParameters;
+    const TransferParameters& r = rhs.mParameters;
+    return lhs.mTransferType == rhs.mTransferType && lhs.mRGBtoXYZ[0] == rhs.mRGBtoXYZ[0] &&
+            lhs.mRGBtoXYZ[1] == rhs.mRGBtoXYZ[1] && lhs.mRGBtoXYZ[2] == rhs.mRGBtoXYZ[2] &&
+            lhs.mWhitePoint == rhs.mWhitePoint && l.g == r.g && l.a == r.a && l.b == r.b &&
+            l.c == r.c && l.d == r.d && l.e == r.e && l.f == r.f;
+}
+
+std::shared_ptr<const float3[]> ColorSpace::getLUT(uint32_t size, const ColorSpace& src,
+                                                   const ColorSpace& dst) {
+    if (!isCacheable(src) || !isCacheable(dst)) {
+        return createLUT(size, src, dst);
+    }
+    size = clamp(size, 2u, 256u);
+
+    struct CachedLUT {
+        uint32_t size;
+        ColorSpace src;
+        ColorSpace dst;
+        std::shared_ptr<const float3[]> lut;
+    };
+    // LUTs are large (3MB for a 64^3 LUT), so only a few are kept, most
+    // recently used first. Color modes rarely use more than a couple.
+    static constexpr size_t kMaxCachedLUTs = 4;
+    static std::mutex sMutex;
+    static std::list<CachedLUT> sCache;
+
+    std::lock_guard<std::mutex> lock(sMutex);
+    for (auto it = sCache.begin(); it != sCache.end(); ++it) {
+        if (it->size == size && isSameColorSpace(it->src, src) &&
+            isSameColorSpace(it->dst, dst)) {
+            sCache.splice(sCache.begin(), sCache, it);
+            return sCache.front().lut;
+        }
+    }
 
+    std::shared_ptr<const float3[]> lut = createLUT(size, src, dst);
+    sCache.push_front({size, src, dst, lut});
+    if (sCache.size() > kMaxCachedLUTs) {
+        sCache.pop_back();
+    }
     return lut;
 }
 
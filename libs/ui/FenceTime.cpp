@@ -20,8 +20,10 @@
 
 #include <cutils/compiler.h>  // For CC_[UN]LIKELY
 #include <utils/Log.h>
+#include <errno.h>
 #include <inttypes.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <memory>
 
@@ -143,6 +145,14 @@ nsecs_t FenceTime::getSignalTime() {
     return signalTime;
 }
 
+sp<Fence> FenceTime::getPendingFence() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mSignalTime.load(std::memory_order_relaxed) != Fence::SIGNAL_TIME_PENDING) {
+        return nullptr;
+    }
+    return mFence;
+}
+
 nsecs_t FenceTime::getCachedSignalTime() const {
     // memory_order_acquire since we don't have a lock fallback path
     // that will do an acquire.
@@ -273,29 +283,68 @@ void FenceTimeline::push(const std::shared_ptr<FenceTime>& fence) {
             // we are removing it from the timeline.
             front->getSignalTime();
         }
-        mQueue.pop();
+        mQueue.pop_front();
     }
-    mQueue.push(fence);
+    mQueue.push_back(fence);
 }
 
 void FenceTimeline::updateSignalTimes() {
     std::lock_guard<std::mutex> lock(mMutex);
-    while (!mQueue.empty()) {
-        std::shared_ptr<FenceTime> fence = mQueue.front().lock();
-        if (!fence) {
-            // The shared_ptr no longer exists and no one cares about the
-            // timestamp anymore.
-            mQueue.pop();
+
+    // Gather the fences that are still pending. The Fence references keep
+    // their file descriptors open while they are polled, even if another
+    // thread resolves the FenceTime in the meantime.
+    for (const auto& entry : mQueue) {
+        std::shared_ptr<FenceTime> fenceTime = entry.lock();
+        if (!fenceTime) {
             continue;
-        } else if (fence->getSignalTime() != Fence::SIGNAL_TIME_PENDING) {
-            // The fence has signaled and we've removed the sp<Fence> ref.
-            mQueue.pop();
+        }
+        sp<Fence> fence = fenceTime->getPendingFence();
+        if (fence == nullptr) {
             continue;
+        }
+        if (fence->isValid()) {
+            mPollFds.push_back({fence->get(), POLLIN, 0});
         } else {
-            // The fence didn't signal yet. Break since the later ones
-            // shouldn't have signaled either.
+            // Without a file descriptor there is nothing to poll, and
+            // getSignalTime() does not make a syscall.
+            fenceTime->getSignalTime();
+        }
+        mPendingFences.push_back(std::move(fenceTime));
+        mPendingFenceRefs.push_back(std::move(fence));
+    }
+
+    if (!mPollFds.empty()) {
+        int ready = poll(mPollFds.data(), mPollFds.size(), 0);
+        if (ready < 0) {
+            ALOGE("FenceTimeline::updateSignalTimes: poll failed: %s (%d)", strerror(errno),
+                  errno);
+        }
+        size_t pollIndex = 0;
+        for (size_t i = 0; i < mPendingFences.size() && ready > 0; i++) {
+            if (!mPendingFenceRefs[i]->isValid()) {
+                continue;
+            }
+            if (mPollFds[pollIndex++].revents != 0) {
+                // Signaled, or an error that getSignalTime() will report.
+                mPendingFences[i]->getSignalTime();
+                ready--;
+            }
+        }
+    }
+
+    mPendingFences.clear();
+    mPendingFenceRefs.clear();
+    mPollFds.clear();
+
+    // Drop the entries that have signaled or that no one cares about anymore,
+    // up to the first one that is still pending.
+    while (!mQueue.empty()) {
+        std::shared_ptr<FenceTime> fence = mQueue.front().lock();
+        if (fence && fence->getCachedSignalTime() == Fence::SIGNAL_TIME_PENDING) {
             break;
         }
+        mQueue.pop_front();
     }
 }
 
@@ -60,6 +60,34 @@ uint64_t getValidUsageBits() {
     return validUsageBits;
 }
 
+// Whether the value of a metadata type is fixed when the buffer is allocated, so that it can be
+// cached for as long as the buffer is imported.
+bool isImmutableMetadataType(const MetadataType& metadataType) {
+    if (!gralloc4::isStandardMetadataType(metadataType)) {
+        return false;
+    }
+    switch (gralloc4::getStandardMetadataTypeValue(metadataType)) {
+        case StandardMetadataType::BUFFER_ID:
+        case StandardMetadataType::NAME:
+        case StandardMetadataType::WIDTH:
+        case StandardMetadataType::HEIGHT:
+        case StandardMetadataType::LAYER_COUNT:
+        case StandardMetadataType::PIXEL_FORMAT_REQUESTED:
+        case StandardMetadataType::PIXEL_FORMAT_FOURCC:
+        case StandardMetadataType::PIXEL_FORMAT_MODIFIER:
+        case StandardMetadataType::USAGE:
+        case StandardMetadataType::ALLOCATION_SIZE:
+        case StandardMetadataType::PROTECTED_CONTENT:
+        case StandardMetadataType::COMPRESSION:
+        case StandardMetadataType::INTERLACED:
+        case StandardMetadataType::CHROMA_SITING:
+        case StandardMetadataType::PLANE_LAYOUTS:
+            return true;
+        default:
+            return false;
+    }
+}
+
 static inline IMapper::Rect sGralloc4Rect(const Rect& rect) {
     IMapper::Rect outRect{};
     outRect.left = rect.left;
@@ -149,10 +177,22 @@ status_t Gralloc4Mapper::importBuffer(const hardware::hidl_handle& rawHandle,
         *outBufferHandle = static_cast<buffer_handle_t>(tmpBuffer);
     });
 
+    if (ret.isOk() && error == Error::NONE) {
+        std::lock_guard<std::mutex> lock(mMetadataCacheMutex);
+        mMetadataCache[*outBufferHandle].clear();
+        mLockLayoutCache.erase(*outBufferHandle);
+    }
+
     return static_cast<status_t>((ret.isOk()) ? error : kTransactionError);
 }
 
 void Gralloc4Mapper::freeBuffer(buffer_handle_t bufferHandle) const {
+    {
+        std::lock_guard<std::mutex> lock(mMetadataCacheMutex);
+        mMetadataCache.erase(bufferHandle);
+        mLockLayoutCache.erase(bufferHandle);
+    }
+
     auto buffer = const_cast<native_handle_t*>(bufferHandle);
     auto ret = mMapper->freeBuffer(buffer);
 
@@ -200,34 +240,15 @@ void Gralloc4Mapper::getTransportSize(buffer_handle_t bufferHandle, uint32_t* ou
 status_t Gralloc4Mapper::lock(buffer_handle_t bufferHandle, uint64_t usage, const Rect& bounds,
                               int acquireFence, void** outData, int32_t* outBytesPerPixel,
                               int32_t* outBytesPerStride) const {
-    std::vector<ui::PlaneLayout> planeLayouts;
-    status_t err = getPlaneLayouts(bufferHandle, &planeLayouts);
-
-    if (err == NO_ERROR && !planeLayouts.empty()) {
-        if (outBytesPerPixel) {
-            int32_t bitsPerPixel = planeLayouts.front().sampleIncrementInBits;
-            for (const auto& planeLayout : planeLayouts) {
-                if (bitsPerPixel != planeLayout.sampleIncrementInBits) {
-                    bitsPerPixel = -1;
-                }
+    if (outBytesPerPixel || outBytesPerStride) {
+        LockLayout layout;
+        status_t err = getLockLayout(bufferHandle, &layout);
+        if (err == NO_ERROR && layout.hasPlaneLayouts) {
+            if (outBytesPerPixel) {
+                *outBytesPerPixel = layout.bytesPerPixel;
             }
-            if (bitsPerPixel >= 0 && bitsPerPixel % 8 == 0) {
-                *outBytesPerPixel = bitsPerPixel / 8;
-            } else {
-                *outBytesPerPixel = -1;
-            }
-        }
-        if (outBytesPerStride) {
-            int32_t bytesPerStride = planeLayouts.front().strideInBytes;
-            for (const auto& planeLayout : planeLayouts) {
-                if (bytesPerStride != planeLayout.strideInBytes) {
-                    bytesPerStride = -1;
-                }
-            }
-            if (bytesPerStride >= 0) {
-                *outBytesPerStride = bytesPerStride;
-            } else {
-                *outBytesPerStride = -1;
+            if (outBytesPerStride) {
+                *outBytesPerStride = layout.bytesPerStride;
             }
         }
     }
@@ -273,9 +294,16 @@ status_t Gralloc4Mapper::lock(buffer_handle_t bufferHandle, uint64_t usage, cons
         return BAD_VALUE;
     }
 
-    std::vector<ui::PlaneLayout> planeLayouts;
-    status_t error = getPlaneLayouts(bufferHandle, &planeLayouts);
+    LockLayout layout;
+    status_t error = getLockLayout(bufferHandle, &layout);
+    if (error == NO_ERROR) {
+        error = layout.ycbcrError;
+    }
     if (error != NO_ERROR) {
+        // we own acquireFence even on errors
+        if (acquireFence >= 0) {
+            close(acquireFence);
+        }
         return error;
     }
 
@@ -285,14 +313,69 @@ status_t Gralloc4Mapper::lock(buffer_handle_t bufferHandle, uint64_t usage, cons
         return error;
     }
 
+    auto planeData = [data](int64_t offset) -> void* {
+        return offset >= 0 ? static_cast<uint8_t*>(data) + offset : nullptr;
+    };
+
     android_ycbcr ycbcr;
+    ycbcr.y = planeData(layout.yOffset);
+    ycbcr.cb = planeData(layout.cbOffset);
+    ycbcr.cr = planeData(layout.crOffset);
+    ycbcr.ystride = layout.ystride;
+    ycbcr.cstride = layout.cstride;
+    ycbcr.chroma_step = layout.chromaStep;
 
-    ycbcr.y = nullptr;
-    ycbcr.cb = nullptr;
-    ycbcr.cr = nullptr;
-    ycbcr.ystride = 0;
-    ycbcr.cstride = 0;
-    ycbcr.chroma_step = 0;
+    *outYcbcr = ycbcr;
+    return static_cast<status_t>(Error::NONE);
+}
+
+status_t Gralloc4Mapper::getLockLayout(buffer_handle_t bufferHandle,
+                                       LockLayout* outLayout) const {
+    {
+        std::lock_guard<std::mutex> lock(mMetadataCacheMutex);
+        auto entry = mLockLayoutCache.find(bufferHandle);
+        if (entry != mLockLayoutCache.end()) {
+            *outLayout = entry->second;
+            return NO_ERROR;
+        }
+    }
+
+    std::vector<ui::PlaneLayout> planeLayouts;
+    status_t error = getPlaneLayouts(bufferHandle, &planeLayouts);
+    if (error != NO_ERROR) {
+        return error;
+    }
+    *outLayout = computeLockLayout(planeLayouts);
+
+    std::lock_guard<std::mutex> lock(mMetadataCacheMutex);
+    // Plane layouts are immutable, but only the handles of buffers imported by this mapper are
+    // known to refer to the same buffer until they are freed.
+    if (mMetadataCache.count(bufferHandle)) {
+        mLockLayoutCache[bufferHandle] = *outLayout;
+    }
+    return NO_ERROR;
+}
+
+Gralloc4Mapper::LockLayout Gralloc4Mapper::computeLockLayout(
+        const std::vector<ui::PlaneLayout>& planeLayouts) {
+    LockLayout layout;
+    if (planeLayouts.empty()) {
+        return layout;
+    }
+    layout.hasPlaneLayouts = true;
+
+    int32_t bitsPerPixel = planeLayouts.front().sampleIncrementInBits;
+    int32_t bytesPerStride = planeLayouts.front().strideInBytes;
+    for (const auto& planeLayout : planeLayouts) {
+        if (bitsPerPixel != planeLayout.sampleIncrementInBits) {
+            bitsPerPixel = -1;
+        }
+        if (bytesPerStride != planeLayout.strideInBytes) {
+            bytesPerStride = -1;
+        }
+    }
+    layout.bytesPerPixel = (bitsPerPixel >= 0 && bitsPerPixel % 8 == 0) ? bitsPerPixel / 8 : -1;
+    layout.bytesPerStride = bytesPerStride >= 0 ? bytesPerStride : -1;
 
     for (const auto& planeLayout : planeLayouts) {
         for (const auto& planeLayoutComponent : planeLayout.components) {
@@ -300,62 +383,62 @@ status_t Gralloc4Mapper::lock(buffer_handle_t bufferHandle, uint64_t usage, cons
                 continue;
             }
             if (0 != planeLayoutComponent.offsetInBits % 8) {
-                unlock(bufferHandle);
-                return BAD_VALUE;
+                layout.ycbcrError = BAD_VALUE;
+                return layout;
             }
 
-            uint8_t* tmpData = static_cast<uint8_t*>(data) + planeLayout.offsetInBytes +
-                    (planeLayoutComponent.offsetInBits / 8);
+            const int64_t offset =
+                    planeLayout.offsetInBytes + (planeLayoutComponent.offsetInBits / 8);
             uint64_t sampleIncrementInBytes;
 
             auto type = static_cast<PlaneLayoutComponentType>(planeLayoutComponent.type.value);
             switch (type) {
                 case PlaneLayoutComponentType::Y:
-                    if ((ycbcr.y != nullptr) || (planeLayoutComponent.sizeInBits != 8) ||
+                    if ((layout.yOffset >= 0) || (planeLayoutComponent.sizeInBits != 8) ||
                         (planeLayout.sampleIncrementInBits != 8)) {
-                        unlock(bufferHandle);
-                        return BAD_VALUE;
+                        layout.ycbcrError = BAD_VALUE;
+                        return layout;
                     }
-                    ycbcr.y = tmpData;
-                    ycbcr.ystride = planeLayout.strideInBytes;
+                    layout.yOffset = offset;
+                    layout.ystride = planeLayout.strideInBytes;
                     break;
 
                 case PlaneLayoutComponentType::CB:
                 case PlaneLayoutComponentType::CR:
                     if (planeLayout.sampleIncrementInBits % 8 != 0) {
-                        unlock(bufferHandle);
-                        return BAD_VALUE;
+                        layout.ycbcrError = BAD_VALUE;
+                        return layout;
                     }
 
                     sampleIncrementInBytes = planeLayout.sampleIncrementInBits / 8;
                     if ((sampleIncrementInBytes != 1) && (sampleIncrementInBytes != 2)) {
-                        unlock(bufferHandle);
-                        return BAD_VALUE;
+                        layout.ycbcrError = BAD_VALUE;
+                        return layout;
                     }
 
-                    if (ycbcr.cstride == 0 && ycbcr.chroma_step == 0) {
-                        ycbcr.cstride = planeLayout.strideInBytes;
-                        ycbcr.chroma_step = sampleIncrementInBytes;
+                    if (layout.cstride == 0 && layout.chromaStep == 0) {
+                        layout.cstride = planeLayout.strideInBytes;
+                        layout.chromaStep = sampleIncrementInBytes;
                     } else {
-                        if ((static_cast<int64_t>(ycbcr.cstride) != planeLayout.strideInBytes) ||
-                            (ycbcr.chroma_step != sampleIncrementInBytes)) {
-                            unlock(bufferHandle);
-                            return BAD_VALUE;
+                        if ((static_cast<int64_t>(layout.cstride) != planeLayout.strideInBytes) ||
+                            (layout.chromaStep != sampleIncrementInBytes)) {
+                            layout.ycbcrError = BAD_VALUE;
+                            return layout;
                         }
                     }
 
                     if (type == PlaneLayoutComponentType::CB) {
-                        if (ycbcr.cb != nullptr) {
-                            unlock(bufferHandle);
-                            return BAD_VALUE;
+                        if (layout.cbOffset >= 0) {
+                            layout.ycbcrError = BAD_VALUE;
+                            return layout;
                         }
-                        ycbcr.cb = tmpData;
+                        layout.cbOffset = offset;
                     } else {
-                        if (ycbcr.cr != nullptr) {
-                            unlock(bufferHandle);
-                            return BAD_VALUE;
+                        if (layout.crOffset >= 0) {
+                            layout.ycbcrError = BAD_VALUE;
+                            return layout;
                         }
-                        ycbcr.cr = tmpData;
+                        layout.crOffset = offset;
                     }
                     break;
                 default:
@@ -363,9 +446,7 @@ status_t Gralloc4Mapper::lock(buffer_handle_t bufferHandle, uint64_t usage, cons
             };
         }
     }
-
-    *outYcbcr = ycbcr;
-    return static_cast<status_t>(Error::NONE);
+    return layout;
 }
 
 int Gralloc4Mapper::unlock(buffer_handle_t bufferHandle) const {
@@ -439,12 +520,38 @@ status_t Gralloc4Mapper::get(buffer_handle_t bufferHandle, const MetadataType& m
         return BAD_VALUE;
     }
 
+    {
+        // Decode cached values in place rather than copying them
+        std::lock_guard<std::mutex> lock(mMetadataCacheMutex);
+        if (const hidl_vec<uint8_t>* vec = findCachedMetadataLocked(bufferHandle, metadataType)) {
+            return decodeFunction(*vec, outMetadata);
+        }
+    }
+
     hidl_vec<uint8_t> vec;
+    status_t error = getEncoded(bufferHandle, metadataType, &vec);
+    if (error) {
+        return error;
+    }
+    return decodeFunction(vec, outMetadata);
+}
+
+status_t Gralloc4Mapper::getEncoded(buffer_handle_t bufferHandle,
+                                    const MetadataType& metadataType,
+                                    hidl_vec<uint8_t>* outVec) const {
+    {
+        std::lock_guard<std::mutex> lock(mMetadataCacheMutex);
+        if (const hidl_vec<uint8_t>* vec = findCachedMetadataLocked(bufferHandle, metadataType)) {
+            *outVec = *vec;
+            return NO_ERROR;
+        }
+    }
+
     Error error;
     auto ret = mMapper->get(const_cast<native_handle_t*>(bufferHandle), metadataType,
                             [&](const auto& tmpError, const hidl_vec<uint8_t>& tmpVec) {
                                 error = tmpError;
-                                vec = tmpVec;
+                                *outVec = tmpVec;
                             });
 
     if (!ret.isOk()) {
@@ -457,7 +564,46 @@ status_t Gralloc4Mapper::get(buffer_handle_t bufferHandle, const MetadataType& m
         return static_cast<status_t>(error);
     }
 
-    return decodeFunction(vec, outMetadata);
+    if (isImmutableMetadataType(metadataType)) {
+        std::lock_guard<std::mutex> lock(mMetadataCacheMutex);
+        // Only buffers imported by this mapper are cached, as only their handles are known to
+        // refer to the same buffer until they are freed.
+        auto entry = mMetadataCache.find(bufferHandle);
+        if (entry != mMetadataCache.end()) {
+            entry->second[metadataType.value] = *outVec;
+        }
+    }
+    return NO_ERROR;
+}
+
+const hidl_vec<uint8_t>* Gralloc4Mapper::findCachedMetadataLocked(
+        buffer_handle_t bufferHandle, const MetadataType& metadataType) const {
+    if (!isImmutableMetadataType(metadataType)) {
+        return nullptr;
+    }
+    auto entry = mMetadataCache.find(bufferHandle);
+    if (entry == mMetadataCache.end()) {
+        return nullptr;
+    }
+    auto vec = entry->second.find(metadataType.value);
+    return vec != entry->second.end() ? &vec->second : nullptr;
+}
+
+status_t Gralloc4Mapper::getMultiple(buffer_handle_t bufferHandle,
+                                     const std::vector<MetadataType>& metadataTypes,
+                                     std::vector<hidl_vec<uint8_t>>* outMetadata) const {
+    if (!outMetadata) {
+        return BAD_VALUE;
+    }
+
+    outMetadata->resize(metadataTypes.size());
+    for (size_t i = 0; i < metadataTypes.size(); i++) {
+        status_t error = getEncoded(bufferHandle, metadataTypes[i], &(*outMetadata)[i]);
+        if (error) {
+            return error;
+        }
+    }
+    return NO_ERROR;
 }
 
 status_t Gralloc4Mapper::getBufferId(buffer_handle_t bufferHandle, uint64_t* outBufferId) const {
@@ -113,8 +113,9 @@ void GraphicBufferAllocator::dumpToSystemLog(bool less) {
 
 status_t GraphicBufferAllocator::allocateHelper(uint32_t width, uint32_t height, PixelFormat format,
                                                 uint32_t layerCount, uint64_t usage,
-                                                buffer_handle_t* handle, uint32_t* stride,
-                                                std::string requestorName, bool importBuffer) {
+                                                uint32_t bufferCount, buffer_handle_t* handles,
+                                                uint32_t* stride, std::string requestorName,
+                                                bool importBuffer) {
     ATRACE_CALL();
 
     // make sure to not allocate a N x 0 or 0 x N buffer, since this is
@@ -137,12 +138,16 @@ status_t GraphicBufferAllocator::allocateHelper(uint32_t width, uint32_t height,
     // TODO(b/72323293, b/72703005): Remove these invalid bits from callers
     usage &= ~static_cast<uint64_t>((1 << 10) | (1 << 13));
 
+    if (bufferCount < 1) {
+        return BAD_VALUE;
+    }
+
     status_t error = mAllocator->allocate(requestorName, width, height, format, layerCount, usage,
-                                          1, stride, handle, importBuffer);
+                                          bufferCount, stride, handles, importBuffer);
     if (error != NO_ERROR) {
-        ALOGE("Failed to allocate (%u x %u) layerCount %u format %d "
+        ALOGE("Failed to allocate %u x (%u x %u) layerCount %u format %d "
               "usage %" PRIx64 ": %d",
-              width, height, layerCount, format, usage, error);
+              bufferCount, width, height, layerCount, format, usage, error);
         return NO_MEMORY;
     }
 
@@ -171,7 +176,9 @@ status_t GraphicBufferAllocator::allocateHelper(uint32_t width, uint32_t height,
     rec.usage = usage;
     rec.size = bufSize;
     rec.requestorName = std::move(requestorName);
-    list.add(*handle, rec);
+    for (uint32_t i = 0; i < bufferCount; i++) {
+        list.add(handles[i], rec);
+    }
 
     return NO_ERROR;
 }
@@ -179,16 +186,42 @@ status_t GraphicBufferAllocator::allocate(uint32_t width, uint32_t height, Pixel
                                           uint32_t layerCount, uint64_t usage,
                                           buffer_handle_t* handle, uint32_t* stride,
                                           std::string requestorName) {
-    return allocateHelper(width, height, format, layerCount, usage, handle, stride, requestorName,
-                          true);
+    return allocateHelper(width, height, format, layerCount, usage, 1, handle, stride,
+                          requestorName, true);
+}
+
+status_t GraphicBufferAllocator::allocate(uint32_t width, uint32_t height, PixelFormat format,
+                                          uint32_t layerCount, uint64_t usage,
+                                          uint32_t bufferCount, buffer_handle_t* outHandles,
+                                          uint32_t* stride, std::string requestorName) {
+    return allocateHelper(width, height, format, layerCount, usage, bufferCount, outHandles,
+                          stride, requestorName, true);
+}
+
+std::future<GraphicBufferAllocator::AllocationResult> GraphicBufferAllocator::allocateAsync(
+        uint32_t width, uint32_t height, PixelFormat format, uint32_t layerCount, uint64_t usage,
+        uint32_t bufferCount, std::string requestorName) {
+    return std::async(std::launch::async,
+                      [this, width, height, format, layerCount, usage, bufferCount,
+                       requestorName = std::move(requestorName)]() mutable {
+                          AllocationResult result;
+                          std::vector<buffer_handle_t> handles(bufferCount);
+                          result.status = allocate(width, height, format, layerCount, usage,
+                                                   bufferCount, handles.data(), &result.stride,
+                                                   std::move(requestorName));
+                          if (result.status == NO_ERROR) {
+                              result.handles = std::move(handles);
+                          }
+                          return result;
+                      });
 }
 
 status_t GraphicBufferAllocator::allocateRawHandle(uint32_t width, uint32_t height,
                                                    PixelFormat format, uint32_t layerCount,
                                                    uint64_t usage, buffer_handle_t* handle,
                                                    uint32_t* stride, std::string requestorName) {
-    return allocateHelper(width, height, format, layerCount, usage, handle, stride, requestorName,
-                          false);
+    return allocateHelper(width, height, format, layerCount, usage, 1, handle, stride,
+                          requestorName, false);
 }
 
 // DEPRECATED
@@ -196,8 +229,8 @@ status_t GraphicBufferAllocator::allocate(uint32_t width, uint32_t height, Pixel
                                           uint32_t layerCount, uint64_t usage,
                                           buffer_handle_t* handle, uint32_t* stride,
                                           uint64_t /*graphicBufferId*/, std::string requestorName) {
-    return allocateHelper(width, height, format, layerCount, usage, handle, stride, requestorName,
-                          true);
+    return allocateHelper(width, height, format, layerCount, usage, 1, handle, stride,
+                          requestorName, true);
 }
 
 status_t GraphicBufferAllocator::free(buffer_handle_t handle)
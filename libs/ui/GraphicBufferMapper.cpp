@@ -40,6 +40,8 @@
 
 #include <system/graphics.h>
 
+#include <algorithm>
+
 namespace android {
 // ---------------------------------------------------------------------------
 
@@ -109,6 +111,74 @@ status_t GraphicBufferMapper::importBuffer(buffer_handle_t rawHandle,
     return NO_ERROR;
 }
 
+status_t GraphicBufferMapper::importBuffer(uint64_t bufferId, buffer_handle_t rawHandle,
+        uint32_t width, uint32_t height, uint32_t layerCount,
+        PixelFormat format, uint64_t usage, uint32_t stride,
+        buffer_handle_t* outHandle)
+{
+    if (!mImportCacheEnabled) {
+        return importBuffer(rawHandle, width, height, layerCount, format, usage, stride,
+                            outHandle);
+    }
+
+    const int* rawInts = rawHandle->data + rawHandle->numFds;
+    auto matches = [&](const SharedImport& import) {
+        return import.width == width && import.height == height &&
+                import.layerCount == layerCount && import.format == format &&
+                import.usage == usage && import.stride == stride &&
+                import.rawInts.size() == static_cast<size_t>(rawHandle->numInts) &&
+                std::equal(import.rawInts.begin(), import.rawInts.end(), rawInts);
+    };
+
+    {
+        std::lock_guard<std::mutex> lock(mImportCacheMutex);
+        auto entry = mSharedImports.find(bufferId);
+        if (entry != mSharedImports.end() && matches(entry->second)) {
+            entry->second.refCount++;
+            *outHandle = entry->second.handle;
+            return NO_ERROR;
+        }
+    }
+
+    buffer_handle_t bufferHandle;
+    status_t error = importBuffer(rawHandle, width, height, layerCount, format, usage, stride,
+                                  &bufferHandle);
+    if (error != NO_ERROR) {
+        return error;
+    }
+
+    buffer_handle_t duplicateHandle = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mImportCacheMutex);
+        auto entry = mSharedImports.find(bufferId);
+        if (entry == mSharedImports.end()) {
+            mSharedImports.emplace(bufferId,
+                                   SharedImport{bufferHandle, 1, width, height, layerCount,
+                                                format, usage, stride,
+                                                std::vector<int>(rawInts,
+                                                                 rawInts + rawHandle->numInts)});
+            mSharedImportIds.emplace(bufferHandle, bufferId);
+        } else if (matches(entry->second)) {
+            // Imported concurrently by another thread: share its handle instead.
+            entry->second.refCount++;
+            duplicateHandle = bufferHandle;
+            bufferHandle = entry->second.handle;
+        }
+        // Otherwise the id refers to a different buffer than the shared one, and the import
+        // keeps its own handle.
+    }
+    if (duplicateHandle) {
+        mMapper->freeBuffer(duplicateHandle);
+    }
+
+    *outHandle = bufferHandle;
+    return NO_ERROR;
+}
+
+void GraphicBufferMapper::setImportCacheEnabled(bool enabled) {
+    mImportCacheEnabled = enabled;
+}
+
 void GraphicBufferMapper::getTransportSize(buffer_handle_t handle,
             uint32_t* outTransportNumFds, uint32_t* outTransportNumInts)
 {
@@ -119,6 +189,19 @@ status_t GraphicBufferMapper::freeBuffer(buffer_handle_t handle)
 {
     ATRACE_CALL();
 
+    {
+        std::lock_guard<std::mutex> lock(mImportCacheMutex);
+        auto id = mSharedImportIds.find(handle);
+        if (id != mSharedImportIds.end()) {
+            auto entry = mSharedImports.find(id->second);
+            if (--entry->second.refCount > 0) {
+                return NO_ERROR;
+            }
+            mSharedImports.erase(entry);
+            mSharedImportIds.erase(id);
+        }
+    }
+
     mMapper->freeBuffer(handle);
 
     return NO_ERROR;
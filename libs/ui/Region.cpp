@@ -19,6 +19,14 @@
 #include <inttypes.h>
 #include <limits.h>
 
+#include <algorithm>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include <android-base/stringprintf.h>
 
 #include <utils/Log.h>
@@ -104,6 +112,8 @@ Region::~Region()
 static void reverseRectsResolvingJunctions(const Rect* begin, const Rect* end, FatVector<Rect>& dst,
                                            int spanDirection) {
     dst.clear();
+    // rects are only ever split, so dst holds at least as many rects as src
+    dst.reserve(static_cast<size_t>(end - begin));
 
     const Rect* current = end - 1;
     int lastTop = current->top;
@@ -206,6 +216,8 @@ Region Region::createTJunctionFreeRegion(const Region& r) {
     reverseRectsResolvingJunctions(r.begin(), r.end(), reversed, direction_RTL);
 
     Region outputRegion;
+    // leave room for the bounds
+    outputRegion.mStorage.reserve(reversed.size() + 1);
     reverseRectsResolvingJunctions(reversed.data(), reversed.data() + reversed.size(),
                                    outputRegion.mStorage, direction_LTR);
     outputRegion.mStorage.push_back(
@@ -249,15 +261,24 @@ bool Region::contains(const Point& point) const {
 }
 
 bool Region::contains(int x, int y) const {
-    const_iterator cur = begin();
+    const_iterator const head = begin();
     const_iterator const tail = end();
-    while (cur != tail) {
-        if (y >= cur->top && y < cur->bottom && x >= cur->left && x < cur->right) {
-            return true;
-        }
-        cur++;
+
+    // The spans are sorted and do not overlap, so the first rect ending below
+    // y starts the only span which may contain it.
+    const_iterator const span = std::upper_bound(head, tail, y,
+            [](int y, const Rect& rect) { return y < rect.bottom; });
+    if (span == tail || y < span->top) {
+        return false;
     }
-    return false;
+
+    // The rects of a span are sorted and do not overlap either
+    const int top = span->top;
+    const_iterator const spanTail = std::upper_bound(span, tail, top,
+            [](int top, const Rect& rect) { return top < rect.top; });
+    const_iterator const rect = std::upper_bound(span, spanTail, x,
+            [](int x, const Rect& rect) { return x < rect.right; });
+    return rect != spanTail && x >= rect->left;
 }
 
 void Region::clear()
@@ -467,17 +488,19 @@ const Region Region::operation(const Region& rhs, int dx, int dy, uint32_t op) c
 
 // This is our region rasterizer, which merges rects and spans together
 // to obtain an optimal region.
+//
+// The span being built is kept at the end of the storage, after the previous
+// span [head, tail), so merging spans needs no intermediate buffer.
 class Region::rasterizer : public region_operator<Rect>::region_rasterizer
 {
     Rect bounds;
     FatVector<Rect>& storage;
-    Rect* head;
-    Rect* tail;
-    FatVector<Rect> span;
-    Rect* cur;
+    // indices, since the storage may be reallocated as it grows
+    size_t head;
+    size_t tail;
 public:
     explicit rasterizer(Region& reg)
-        : bounds(INT_MAX, 0, INT_MIN, 0), storage(reg.mStorage), head(), tail(), cur() {
+        : bounds(INT_MAX, 0, INT_MIN, 0), storage(reg.mStorage), head(), tail() {
         storage.clear();
     }
 
@@ -496,7 +519,7 @@ private:
 
 Region::rasterizer::~rasterizer()
 {
-    if (span.size()) {
+    if (storage.size() > tail) {
         flushSpan();
     }
     if (storage.size()) {
@@ -516,51 +539,77 @@ void Region::rasterizer::operator()(const Rect& rect)
 {
     //ALOGD(">>> %3d, %3d, %3d, %3d",
     //        rect.left, rect.top, rect.right, rect.bottom);
-    if (span.size()) {
-        if (cur->top != rect.top) {
+    if (storage.size() > tail) {
+        Rect& cur = storage.back();
+        if (cur.top != rect.top) {
             flushSpan();
-        } else if (cur->right == rect.left) {
-            cur->right = rect.right;
+        } else if (cur.right == rect.left) {
+            cur.right = rect.right;
             return;
         }
     }
-    span.push_back(rect);
-    cur = span.data() + (span.size() - 1);
+    storage.push_back(rect);
+}
+
+// Whether the rects of both spans have the same left and right edges
+static bool haveSameHorizontalEdges(const Rect* p, const Rect* q, size_t count) {
+#if defined(__ARM_NEON) || defined(__SSE2__)
+    static_assert(sizeof(Rect) == 4 * sizeof(int32_t), "Rect must be left, top, right, bottom");
+#endif
+#if defined(__ARM_NEON)
+    static const uint32_t kEdges[4] = {~0u, 0, ~0u, 0};
+    uint32x4_t diff = vdupq_n_u32(0);
+    for (size_t i = 0; i < count; i++) {
+        const uint32x4_t a = vld1q_u32(reinterpret_cast<const uint32_t*>(p + i));
+        const uint32x4_t b = vld1q_u32(reinterpret_cast<const uint32_t*>(q + i));
+        diff = vorrq_u32(diff, veorq_u32(a, b));
+    }
+    diff = vandq_u32(diff, vld1q_u32(kEdges));
+    const uint32x2_t folded = vorr_u32(vget_low_u32(diff), vget_high_u32(diff));
+    return (vget_lane_u32(folded, 0) | vget_lane_u32(folded, 1)) == 0;
+#elif defined(__SSE2__)
+    const __m128i edges = _mm_set_epi32(0, -1, 0, -1);
+    __m128i diff = _mm_setzero_si128();
+    for (size_t i = 0; i < count; i++) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(q + i));
+        diff = _mm_or_si128(diff, _mm_xor_si128(a, b));
+    }
+    diff = _mm_and_si128(diff, edges);
+    return _mm_movemask_epi8(_mm_cmpeq_epi32(diff, _mm_setzero_si128())) == 0xFFFF;
+#else
+    for (size_t i = 0; i < count; i++) {
+        if ((p[i].left != q[i].left) || (p[i].right != q[i].right)) {
+            return false;
+        }
+    }
+    return true;
+#endif
 }
 
 void Region::rasterizer::flushSpan()
 {
+    const size_t spanSize = storage.size() - tail;
+    Rect* const span = storage.data() + tail;
+    Rect* const prev = storage.data() + head;
     bool merge = false;
-    if (tail-head == ssize_t(span.size())) {
-        Rect const* p = span.data();
-        Rect const* q = head;
-        if (p->top == q->bottom) {
-            merge = true;
-            while (q != tail) {
-                if ((p->left != q->left) || (p->right != q->right)) {
-                    merge = false;
-                    break;
-                }
-                p++;
-                q++;
-            }
+    if (tail - head == spanSize) {
+        if (span->top == prev->bottom) {
+            merge = haveSameHorizontalEdges(span, prev, spanSize);
         }
     }
     if (merge) {
-        const int bottom = span.front().bottom;
-        Rect* r = head;
-        while (r != tail) {
+        const int bottom = span->bottom;
+        for (Rect* r = prev; r != span; r++) {
             r->bottom = bottom;
-            r++;
         }
+        storage.resize(tail);
     } else {
-        bounds.left = min(span.front().left, bounds.left);
-        bounds.right = max(span.back().right, bounds.right);
-        storage.insert(storage.end(), span.begin(), span.end());
-        tail = storage.data() + storage.size();
-        head = tail - span.size();
+        bounds.left = min(span->left, bounds.left);
+        bounds.right = max(span[spanSize - 1].right, bounds.right);
+        head = tail;
+        tail = storage.size();
     }
-    span.clear();
 }
 
 bool Region::validate(const Region& reg, const char* name, bool silent)
@@ -767,6 +816,10 @@ void Region::boolean_operation(uint32_t op, Region& dst,
 #if VALIDATE_WITH_CORECG || defined(VALIDATE_REGIONS)
     boolean_operation(op, dst, lhs, Region(rhs), dx, dy);
 #else
+    if (boolean_operation_with_rect(op, dst, lhs, Rect(rhs).offsetBy(dx, dy))) {
+        return;
+    }
+
     size_t lhs_count;
     Rect const * const lhs_rects = lhs.getArray(&lhs_count);
 
@@ -784,9 +837,85 @@ void Region::boolean_operation(uint32_t op, Region& dst,
 void Region::boolean_operation(uint32_t op, Region& dst,
         const Region& lhs, const Region& rhs)
 {
+    // Operations with simple rects are common (e.g. Region(rect))
+    if (rhs.isRect()) {
+        boolean_operation(op, dst, lhs, rhs.getBounds(), 0, 0);
+        return;
+    }
+    if (op == op_and && lhs.isRect() && &rhs != &dst) {
+        boolean_operation(op, dst, rhs, lhs.getBounds(), 0, 0);
+        return;
+    }
     boolean_operation(op, dst, lhs, rhs, 0, 0);
 }
 
+bool Region::boolean_operation_with_rect(uint32_t op, Region& dst,
+        const Region& lhs, const Rect& rhs)
+{
+    if (op != op_and && op != op_nand) {
+        return false;
+    }
+
+    const_iterator cur = lhs.begin();
+    const_iterator const tail = lhs.end();
+    rasterizer r(dst);
+    // lhs may be a single empty rect, and some of the parts below are empty
+    auto add = [&r](const Rect& rect) {
+        if (!rect.isEmpty()) {
+            r(rect);
+        }
+    };
+
+    if (op == op_and) {
+        if (rhs.isEmpty()) {
+            return true;
+        }
+        // Skip the spans above rhs, then clip those overlapping it
+        cur = std::upper_bound(cur, tail, rhs.top,
+                [](int top, const Rect& rect) { return top < rect.bottom; });
+        for (; cur != tail && cur->top < rhs.bottom; cur++) {
+            Rect clipped;
+            if (cur->intersect(rhs, &clipped)) {
+                add(clipped);
+            }
+        }
+        return true;
+    }
+
+    // op_nand: copy the spans not overlapping rhs vertically, and split those
+    // which do in the parts above, beside and below rhs.
+    while (cur != tail) {
+        const int top = cur->top;
+        const int bottom = cur->bottom;
+        const_iterator spanTail = cur;
+        while (spanTail != tail && spanTail->top == top) {
+            spanTail++;
+        }
+
+        if (rhs.isEmpty() || bottom <= rhs.top || top >= rhs.bottom) {
+            for (; cur != spanTail; cur++) {
+                add(*cur);
+            }
+            continue;
+        }
+
+        const int midTop = std::max(top, rhs.top);
+        const int midBottom = std::min(bottom, rhs.bottom);
+        for (const_iterator it = cur; it != spanTail; it++) {
+            add(Rect(it->left, top, it->right, midTop));
+        }
+        for (const_iterator it = cur; it != spanTail; it++) {
+            add(Rect(it->left, midTop, std::min(it->right, rhs.left), midBottom));
+            add(Rect(std::max(it->left, rhs.right), midTop, it->right, midBottom));
+        }
+        for (const_iterator it = cur; it != spanTail; it++) {
+            add(Rect(it->left, midBottom, it->right, bottom));
+        }
+        cur = spanTail;
+    }
+    return true;
+}
+
 void Region::boolean_operation(uint32_t op, Region& dst,
         const Region& lhs, const Rect& rhs)
 {
@@ -16,6 +16,8 @@
 
 #include <math.h>
 
+#include <vector>
+
 #include <android-base/stringprintf.h>
 #include <cutils/compiler.h>
 #include <ui/Region.h>
@@ -30,7 +32,11 @@ Transform::Transform() {
 }
 
 Transform::Transform(const Transform&  other)
-    : mMatrix(other.mMatrix), mType(other.mType) {
+    : mMatrix(other.mMatrix),
+      mType(other.mType),
+      mInverse(other.mInverse),
+      mInverseType(other.mInverseType),
+      mInverseValid(other.mInverseValid) {
 }
 
 Transform::Transform(uint32_t orientation, int w, int h) {
@@ -67,6 +73,8 @@ Transform Transform::operator * (const Transform& rhs) const
     if (rhs.mType == IDENTITY)
         return r;
 
+    r.mInverseValid = false;
+
     // TODO: we could use mType to optimize the matrix multiply
     const mat33& A(mMatrix);
     const mat33& B(rhs.mMatrix);
@@ -90,6 +98,9 @@ Transform Transform::operator * (const Transform& rhs) const
 Transform& Transform::operator=(const Transform& other) {
     mMatrix = other.mMatrix;
     mType = other.mType;
+    mInverse = other.mInverse;
+    mInverseType = other.mInverseType;
+    mInverseValid = other.mInverseValid;
     return *this;
 }
 
@@ -115,6 +126,7 @@ float Transform::sy() const {
 
 void Transform::reset() {
     mType = IDENTITY;
+    mInverseValid = false;
     for(size_t i = 0; i < 3; i++) {
         vec3& v(mMatrix[i]);
         for (size_t j = 0; j < 3; j++)
@@ -127,6 +139,7 @@ void Transform::set(float tx, float ty)
     mMatrix[2][0] = tx;
     mMatrix[2][1] = ty;
     mMatrix[2][2] = 1.0f;
+    mInverseValid = false;
 
     if (isZero(tx) && isZero(ty)) {
         mType &= ~TRANSLATE;
@@ -142,6 +155,7 @@ void Transform::set(float a, float b, float c, float d)
     M[0][1] = c;    M[1][1] = d;
     M[0][2] = 0;    M[1][2] = 0;
     mType = UNKNOWN_TYPE;
+    mInverseValid = false;
 }
 
 status_t Transform::set(uint32_t flags, float w, float h)
@@ -263,16 +277,70 @@ FloatRect Transform::transform(const FloatRect& bounds) const
     return r;
 }
 
+void Transform::transformRects(const Rect* rects, size_t count, Rect* outRects) const {
+    if (type() <= TRANSLATE) {
+        // Rects have integer coordinates, so rounding the translation once is the same as
+        // rounding each translated coordinate.
+        const int32_t dx = static_cast<int32_t>(floorf(tx() + 0.5f));
+        const int32_t dy = static_cast<int32_t>(floorf(ty() + 0.5f));
+        for (size_t i = 0; i < count; i++) {
+            outRects[i] = Rect(rects[i].left + dx, rects[i].top + dy, rects[i].right + dx,
+                               rects[i].bottom + dy);
+        }
+    } else if (preserveRects()) {
+        // Without skew, each output coordinate only depends on one input coordinate, so two
+        // opposite corners are enough to find the bounds of the transformed rect.
+        const mat33& M(mMatrix);
+        const float a = M[0][0], b = M[1][0], x = M[2][0];
+        const float c = M[0][1], d = M[1][1], y = M[2][1];
+        for (size_t i = 0; i < count; i++) {
+            const float l = static_cast<float>(rects[i].left);
+            const float t = static_cast<float>(rects[i].top);
+            const float r = static_cast<float>(rects[i].right);
+            const float btm = static_cast<float>(rects[i].bottom);
+            const float x0 = a * l + b * t + x;
+            const float y0 = c * l + d * t + y;
+            const float x1 = a * r + b * btm + x;
+            const float y1 = c * r + d * btm + y;
+            outRects[i] = Rect(static_cast<int32_t>(floorf(std::min(x0, x1) + 0.5f)),
+                               static_cast<int32_t>(floorf(std::min(y0, y1) + 0.5f)),
+                               static_cast<int32_t>(floorf(std::max(x0, x1) + 0.5f)),
+                               static_cast<int32_t>(floorf(std::max(y0, y1) + 0.5f)));
+        }
+    } else {
+        for (size_t i = 0; i < count; i++) {
+            outRects[i] = transform(rects[i]);
+        }
+    }
+}
+
+// Returns the union of count rects. Large unions are split in halves, as merging two regions
+// of similar size is much cheaper than adding the rects to a growing region one by one.
+static Region unionOfRects(const Rect* rects, size_t count) {
+    constexpr size_t kMaxRectsToAddDirectly = 8;
+    Region out;
+    if (count <= kMaxRectsToAddDirectly) {
+        for (size_t i = 0; i < count; i++) {
+            out.orSelf(rects[i]);
+        }
+        return out;
+    }
+    const size_t half = count / 2;
+    out = unionOfRects(rects, half);
+    out.orSelf(unionOfRects(rects + half, count - half));
+    return out;
+}
+
 Region Transform::transform(const Region& reg) const
 {
     Region out;
     if (CC_UNLIKELY(type() > TRANSLATE)) {
         if (CC_LIKELY(preserveRects())) {
-            Region::const_iterator it = reg.begin();
-            Region::const_iterator const end = reg.end();
-            while (it != end) {
-                out.orSelf(transform(*it++));
-            }
+            size_t count = 0;
+            const Rect* rects = reg.getArray(&count);
+            std::vector<Rect> transformed(count);
+            transformRects(rects, count, transformed.data());
+            out = unionOfRects(transformed.data(), count);
         } else {
             out.set(transform(reg.bounds()));
         }
@@ -338,6 +406,24 @@ uint32_t Transform::type() const
 }
 
 Transform Transform::inverse() const {
+    Transform result;
+    if (mInverseValid) {
+        result.mMatrix = mInverse;
+        result.mType = mInverseType;
+    } else {
+        result = computeInverse();
+        mInverse = result.mMatrix;
+        mInverseType = result.mType;
+        mInverseValid = true;
+    }
+    // The inverse of the inverse is this transform.
+    result.mInverse = mMatrix;
+    result.mInverseType = mType;
+    result.mInverseValid = true;
+    return result;
+}
+
+Transform Transform::computeInverse() const {
     // our 3x3 matrix is always of the form of a 2x2 transformation
     // followed by a translation: T*M, therefore:
     // (T*M)^-1 = M^-1 * T^-1
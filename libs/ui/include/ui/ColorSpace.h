@@ -253,7 +253,29 @@ public:
     static std::unique_ptr<float3[]> createLUT(uint32_t size, const ColorSpace& src,
                                                const ColorSpace& dst);
 
+    // Returns the same 3D LUT as createLUT(), from a small process-wide cache
+    // when possible. Only LUTs between color spaces whose transfer functions
+    // are defined by transfer parameters or a gamma value, and that use the
+    // default clamping function, are cached; LUTs between other color spaces
+    // are always created.
+    static std::shared_ptr<const float3[]> getLUT(uint32_t size, const ColorSpace& src,
+                                                  const ColorSpace& dst);
+
 private:
+    // How the transfer functions were defined. Functions defined by transfer
+    // parameters or a gamma value can be evaluated inline and compared,
+    // instead of being called through std::function.
+    enum class TransferType {
+        FUNCTION,
+        LINEAR,
+        GAMMA,
+        PARAMETRIC,
+    };
+
+    static void fillLUT(uint32_t size, const ColorSpace& src, const ColorSpace& dst, float3* data);
+    static bool isCacheable(const ColorSpace& colorSpace);
+    static bool isSameColorSpace(const ColorSpace& lhs, const ColorSpace& rhs);
+
     static constexpr mat3 computeXYZMatrix(
             const std::array<float2, 3>& primaries, const float2& whitePoint);
 
@@ -273,6 +295,9 @@ private:
 
     std::array<float2, 3> mPrimaries;
     float2 mWhitePoint;
+    TransferType mTransferType;
+    // Whether mClamper is the default saturate
+    bool mSaturates;
 };
 
 class ColorSpaceConnector {
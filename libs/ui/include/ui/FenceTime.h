@@ -23,9 +23,12 @@
 #include <utils/Timers.h>
 
 #include <atomic>
+#include <deque>
 #include <mutex>
-#include <queue>
 #include <unordered_map>
+#include <vector>
+
+#include <poll.h>
 
 namespace android {
 
@@ -36,6 +39,7 @@ class FenceToFenceTimeMap;
 // time is known.
 class FenceTime {
 friend class FenceToFenceTimeMap;
+friend class FenceTimeline;
 public:
     // An atomic snapshot of the FenceTime that is flattenable.
     //
@@ -119,6 +123,9 @@ private:
     // never return SIGNAL_TIME_INVALID and isValid will always return true.
     FenceTime(const sp<Fence>& fence, bool forceValidForTest);
 
+    // Returns the fence if the signal time is still pending, or nullptr otherwise.
+    sp<Fence> getPendingFence() const;
+
     enum class State {
         VALID,
         INVALID,
@@ -149,6 +156,11 @@ private:
 // if FenceTimeline did nothing. i.e. they should eventually call
 // Fence::getSignalTime(), not only Fence::getCachedSignalTime().
 //
+// updateSignalTimes() checks all the pending fences with a single poll() of
+// their file descriptors, and only queries the signal time of those that
+// became readable, i.e. have signaled. Fences that signal out of order are
+// therefore resolved too, without a syscall per pending fence.
+//
 // push() and updateSignalTimes() are safe to call simultaneously from
 // different threads.
 class FenceTimeline {
@@ -160,7 +172,12 @@ public:
 
 private:
     mutable std::mutex mMutex;
-    std::queue<std::weak_ptr<FenceTime>> mQueue GUARDED_BY(mMutex);
+    std::deque<std::weak_ptr<FenceTime>> mQueue GUARDED_BY(mMutex);
+
+    // Scratch space for updateSignalTimes(), kept to avoid reallocating it every time.
+    std::vector<std::shared_ptr<FenceTime>> mPendingFences GUARDED_BY(mMutex);
+    std::vector<sp<Fence>> mPendingFenceRefs GUARDED_BY(mMutex);
+    std::vector<pollfd> mPollFds GUARDED_BY(mMutex);
 };
 
 // Used by test code to create or get FenceTimes for a given Fence.
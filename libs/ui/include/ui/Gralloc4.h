@@ -26,7 +26,10 @@
 #include <ui/Rect.h>
 #include <utils/StrongPointer.h>
 
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace android {
 
@@ -149,6 +152,14 @@ public:
     std::vector<android::hardware::graphics::mapper::V4_0::IMapper::MetadataTypeDescription>
     listSupportedMetadataTypes() const;
 
+    // Retrieves the encoded value of each of metadataTypes for a buffer, in the same order, to be
+    // decoded with the gralloc4::decode* functions. Fails if any of them cannot be retrieved.
+    status_t getMultiple(
+            buffer_handle_t bufferHandle,
+            const std::vector<android::hardware::graphics::mapper::V4_0::IMapper::MetadataType>&
+                    metadataTypes,
+            std::vector<hardware::hidl_vec<uint8_t>>* outMetadata) const;
+
 private:
     friend class GraphicBufferAllocator;
 
@@ -165,6 +176,40 @@ private:
             const android::hardware::graphics::mapper::V4_0::IMapper::MetadataType& metadataType,
             DecodeFunction<T> decodeFunction, T* outMetadata) const;
 
+    // Retrieves the encoded value of a metadata type, from the metadata cache if possible.
+    status_t getEncoded(
+            buffer_handle_t bufferHandle,
+            const android::hardware::graphics::mapper::V4_0::IMapper::MetadataType& metadataType,
+            hardware::hidl_vec<uint8_t>* outVec) const;
+
+    // Returns the cached encoded value of a metadata type, or nullptr if it is not cached.
+    const hardware::hidl_vec<uint8_t>* findCachedMetadataLocked(
+            buffer_handle_t bufferHandle,
+            const android::hardware::graphics::mapper::V4_0::IMapper::MetadataType& metadataType)
+            const;
+
+    // Where the planes of a buffer are in its locked memory, derived from its plane layouts.
+    struct LockLayout {
+        // Whether the buffer has any plane layouts. If not, the fields below are meaningless.
+        bool hasPlaneLayouts = false;
+        // -1 if the planes have different sample increments or strides.
+        int32_t bytesPerPixel = -1;
+        int32_t bytesPerStride = -1;
+        // The error returned by YCbCr locks if the planes cannot be described by android_ycbcr.
+        status_t ycbcrError = NO_ERROR;
+        // Offsets of the Y, Cb and Cr samples from the locked address, or -1 if absent.
+        int64_t yOffset = -1;
+        int64_t cbOffset = -1;
+        int64_t crOffset = -1;
+        size_t ystride = 0;
+        size_t cstride = 0;
+        size_t chromaStep = 0;
+    };
+
+    // Retrieves the lock layout of a buffer, from the lock layout cache if possible.
+    status_t getLockLayout(buffer_handle_t bufferHandle, LockLayout* outLayout) const;
+    static LockLayout computeLockLayout(const std::vector<ui::PlaneLayout>& planeLayouts);
+
     template <class T>
     status_t getDefault(
             uint32_t width, uint32_t height, PixelFormat format, uint32_t layerCount,
@@ -182,6 +227,18 @@ private:
             std::ostringstream* outDump, uint64_t* outAllocationSize, bool less) const;
 
     sp<hardware::graphics::mapper::V4_0::IMapper> mMapper;
+
+    // The encoded values of the standard metadata types that cannot change over the lifetime of a
+    // buffer, e.g. its id, size, format and plane layouts, for each buffer imported by this
+    // mapper. An entry is added when a buffer is imported and removed when it is freed, so that
+    // it always refers to the same buffer id. Mutable types, e.g. the dataspace, blend mode, crop
+    // and HDR metadata, can be set by other processes and are always queried.
+    using EncodedMetadata = std::unordered_map<int64_t, hardware::hidl_vec<uint8_t>>;
+    mutable std::mutex mMetadataCacheMutex;
+    mutable std::unordered_map<buffer_handle_t, EncodedMetadata> mMetadataCache;
+    // The lock layouts of the buffers in mMetadataCache, so that locks don't decode the plane
+    // layouts again. Also guarded by mMetadataCacheMutex.
+    mutable std::unordered_map<buffer_handle_t, LockLayout> mLockLayoutCache;
 };
 
 class Gralloc4Allocator : public GrallocAllocator {
@@ -143,6 +143,13 @@ public:
     GraphicBuffer(uint32_t inWidth, uint32_t inHeight, PixelFormat inFormat,
             uint32_t inUsage, std::string requestorName = "<Unknown>");
 
+    // Allocates bufferCount identical buffers with a single allocator call, which is cheaper than
+    // constructing them one at a time. Either all the buffers are allocated, or none are.
+    static status_t allocateMultiple(uint32_t inWidth, uint32_t inHeight, PixelFormat inFormat,
+                                     uint32_t inLayerCount, uint64_t inUsage,
+                                     uint32_t bufferCount, std::string requestorName,
+                                     std::vector<sp<GraphicBuffer>>* outBuffers);
+
     // return status
     status_t initCheck() const;
 
@@ -245,6 +252,11 @@ private:
             PixelFormat inFormat, uint32_t inLayerCount,
             uint64_t inUsage, std::string requestorName);
 
+    // Takes ownership of a handle that was allocated by GraphicBufferAllocator.
+    void initWithAllocatedHandle(buffer_handle_t inHandle, uint32_t inWidth, uint32_t inHeight,
+                                 PixelFormat inFormat, uint32_t inLayerCount, uint64_t inUsage,
+                                 uint32_t inStride);
+
     status_t initWithHandle(const native_handle_t* inHandle, HandleWrapMethod method,
                             uint32_t inWidth, uint32_t inHeight, PixelFormat inFormat,
                             uint32_t inLayerCount, uint64_t inUsage, uint32_t inStride);
@@ -20,8 +20,10 @@
 
 #include <stdint.h>
 
+#include <future>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <cutils/native_handle.h>
 
@@ -51,6 +53,33 @@ public:
                       uint64_t usage, buffer_handle_t* handle, uint32_t* stride,
                       std::string requestorName);
 
+    /**
+     * Allocates and imports bufferCount identical gralloc buffers with a single allocator call,
+     * which is cheaper than allocating them one at a time. outHandles must point to space for
+     * bufferCount handles. Either all the buffers are allocated, or none are.
+     *
+     * Each handle must be freed with GraphicBufferAllocator::free() when no longer needed.
+     */
+    status_t allocate(uint32_t w, uint32_t h, PixelFormat format, uint32_t layerCount,
+                      uint64_t usage, uint32_t bufferCount, buffer_handle_t* outHandles,
+                      uint32_t* stride, std::string requestorName);
+
+    struct AllocationResult {
+        status_t status = NO_INIT;
+        uint32_t stride = 0;
+        // Empty unless status is NO_ERROR
+        std::vector<buffer_handle_t> handles;
+    };
+
+    /**
+     * Like the batched allocate(), but allocates on another thread so that the caller can do
+     * other work in the meantime. The handles in the result are owned by the caller, so the
+     * future must be waited on, and the handles freed, even if they are no longer needed.
+     */
+    std::future<AllocationResult> allocateAsync(uint32_t w, uint32_t h, PixelFormat format,
+                                                uint32_t layerCount, uint64_t usage,
+                                                uint32_t bufferCount, std::string requestorName);
+
     /**
      * Allocates and does NOT import a gralloc buffer. Buffers cannot be used until they have
      * been imported. This function is for advanced use cases only.
@@ -90,8 +119,8 @@ protected:
     };
 
     status_t allocateHelper(uint32_t w, uint32_t h, PixelFormat format, uint32_t layerCount,
-                            uint64_t usage, buffer_handle_t* handle, uint32_t* stride,
-                            std::string requestorName, bool importBuffer);
+                            uint64_t usage, uint32_t bufferCount, buffer_handle_t* handles,
+                            uint32_t* stride, std::string requestorName, bool importBuffer);
 
     static Mutex sLock;
     static KeyedVector<buffer_handle_t, alloc_rec_t> sAllocList;
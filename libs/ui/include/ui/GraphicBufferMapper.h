@@ -20,7 +20,11 @@
 #include <stdint.h>
 #include <sys/types.h>
 
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 
 #include <ui/GraphicTypes.h>
 #include <ui/PixelFormat.h>
@@ -59,6 +63,20 @@ public:
             PixelFormat format, uint64_t usage, uint32_t stride,
             buffer_handle_t* outHandle);
 
+    // Like importBuffer(), but while the import cache is enabled, all the imports of the buffer
+    // of the GraphicBuffer with the given id share the same outHandle. It is imported from the
+    // HAL once, and freed when every import of it has been passed to freeBuffer. Since shared
+    // handles also share their lock state, the buffer must not be locked through more than one
+    // import at a time.
+    status_t importBuffer(uint64_t bufferId, buffer_handle_t rawHandle,
+            uint32_t width, uint32_t height, uint32_t layerCount,
+            PixelFormat format, uint64_t usage, uint32_t stride,
+            buffer_handle_t* outHandle);
+
+    // Enables or disables the import cache of this process. It is disabled by default. Disabling
+    // it does not affect the handles it already shares.
+    void setImportCacheEnabled(bool enabled);
+
     status_t freeBuffer(buffer_handle_t handle);
 
     void getTransportSize(buffer_handle_t handle,
@@ -183,6 +201,27 @@ private:
     std::unique_ptr<const GrallocMapper> mMapper;
 
     Version mMapperVersion;
+
+    // An imported handle shared by the imports of a buffer
+    struct SharedImport {
+        buffer_handle_t handle;
+        size_t refCount;
+        // What each import must match to share the handle: the attributes of the buffer and the
+        // ints of its raw handle, which identify the buffer to the HAL.
+        uint32_t width;
+        uint32_t height;
+        uint32_t layerCount;
+        PixelFormat format;
+        uint64_t usage;
+        uint32_t stride;
+        std::vector<int> rawInts;
+    };
+
+    std::atomic<bool> mImportCacheEnabled{false};
+    std::mutex mImportCacheMutex;
+    // The shared imports, by buffer id, and the ids of the shared handles
+    std::unordered_map<uint64_t, SharedImport> mSharedImports;
+    std::unordered_map<buffer_handle_t, uint64_t> mSharedImportIds;
 };
 
 // ---------------------------------------------------------------------------
@@ -169,6 +169,12 @@ private:
             const Region& lhs, const Region& rhs);
     static void boolean_operation(uint32_t op, Region& dst,
             const Region& lhs, const Rect& rhs);
+    // Intersects lhs with or subtracts from it a single rect, in time linear
+    // in the number of rects of lhs, or logarithmic for intersecting with a
+    // rect which only overlaps a few bands of lhs. Returns false, without
+    // changing dst, for the other operations.
+    static bool boolean_operation_with_rect(uint32_t op, Region& dst,
+            const Region& lhs, const Rect& rhs);
 
     static void translate(Region& reg, int dx, int dy);
     static void translate(Region& dst, const Region& reg, int dx, int dy);
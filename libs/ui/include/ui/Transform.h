@@ -85,6 +85,10 @@ public:
     Rect    transform(const Rect& bounds,
                       bool roundOutwards = false) const;
     FloatRect transform(const FloatRect& bounds) const;
+    // Transforms count rects into outRects, which may be the same array. The result is the same
+    // as transforming each rect with transform(rect), but rects are transformed in a tight loop
+    // specialized for the type of the transform.
+    void    transformRects(const Rect* rects, size_t count, Rect* outRects) const;
     Transform& operator = (const Transform& other);
     Transform operator * (const Transform& rhs) const;
     // assumes the last row is < 0 , 0 , 1 >
@@ -94,6 +98,7 @@ public:
     // Expands from the internal 3x3 matrix to an equivalent 4x4 matrix
     mat4 asMatrix4() const;
 
+    // The inverse is computed on first use and cached until the transform is modified.
     Transform inverse() const;
 
     // for debugging
@@ -112,11 +117,17 @@ private:
     enum { UNKNOWN_TYPE = 0x80000000 };
 
     uint32_t type() const;
+    Transform computeInverse() const;
     static bool absIsOne(float f);
     static bool isZero(float f);
 
     mat33               mMatrix;
     mutable uint32_t    mType;
+
+    // The cached inverse, valid if mInverseValid is set
+    mutable mat33       mInverse;
+    mutable uint32_t    mInverseType = UNKNOWN_TYPE;
+    mutable bool        mInverseValid = false;
 };
 
 inline void PrintTo(const Transform& t, ::std::ostream* os) {
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <ui/Gralloc4.h>
+#include <ui/GraphicBuffer.h>
+#include <ui/GraphicBufferMapper.h>
+
+#include <vector>
+
+// Usage: atest Gralloc4Mapper_benchmark
+
+namespace android {
+namespace {
+
+const Gralloc4Mapper* getGralloc4Mapper(benchmark::State& state) {
+    const GraphicBufferMapper& mapper = GraphicBufferMapper::get();
+    if (mapper.getMapperVersion() != GraphicBufferMapper::GRALLOC_4) {
+        state.SkipWithError("gralloc 4 is not supported");
+        return nullptr;
+    }
+    return &reinterpret_cast<const Gralloc4Mapper&>(mapper.getGrallocMapper());
+}
+
+sp<GraphicBuffer> allocateBuffer() {
+    return new GraphicBuffer(256, 256, PIXEL_FORMAT_RGBA_8888, 1,
+                             GraphicBuffer::USAGE_HW_TEXTURE | GraphicBuffer::USAGE_SW_READ_OFTEN,
+                             "Gralloc4Mapper_benchmark");
+}
+
+// The metadata queried when a buffer is set up for composition. Apart from the first iteration,
+// these are served from the metadata cache.
+void BM_getImmutableMetadata(benchmark::State& state) {
+    const Gralloc4Mapper* mapper = getGralloc4Mapper(state);
+    if (!mapper) {
+        return;
+    }
+    const sp<GraphicBuffer> buffer = allocateBuffer();
+    const buffer_handle_t handle = buffer->getNativeBuffer()->handle;
+    uint64_t width;
+    uint64_t height;
+    uint32_t fourCC;
+    std::vector<ui::PlaneLayout> planeLayouts;
+    for (auto _ : state) {
+        mapper->getWidth(handle, &width);
+        mapper->getHeight(handle, &height);
+        mapper->getPixelFormatFourCC(handle, &fourCC);
+        mapper->getPlaneLayouts(handle, &planeLayouts);
+    }
+    state.SetItemsProcessed(state.iterations() * 4);
+}
+BENCHMARK(BM_getImmutableMetadata);
+
+// Mutable metadata is never cached, so this measures the cost of an IMapper::get.
+void BM_getMutableMetadata(benchmark::State& state) {
+    const Gralloc4Mapper* mapper = getGralloc4Mapper(state);
+    if (!mapper) {
+        return;
+    }
+    const sp<GraphicBuffer> buffer = allocateBuffer();
+    const buffer_handle_t handle = buffer->getNativeBuffer()->handle;
+    ui::Dataspace dataspace;
+    ui::BlendMode blendMode;
+    for (auto _ : state) {
+        mapper->getDataspace(handle, &dataspace);
+        mapper->getBlendMode(handle, &blendMode);
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+}
+BENCHMARK(BM_getMutableMetadata);
+
+void BM_getMultiple(benchmark::State& state) {
+    const Gralloc4Mapper* mapper = getGralloc4Mapper(state);
+    if (!mapper) {
+        return;
+    }
+    const sp<GraphicBuffer> buffer = allocateBuffer();
+    const buffer_handle_t handle = buffer->getNativeBuffer()->handle;
+    const std::vector<hardware::graphics::mapper::V4_0::IMapper::MetadataType> types = {
+            gralloc4::MetadataType_Width, gralloc4::MetadataType_Height,
+            gralloc4::MetadataType_PixelFormatFourCC, gralloc4::MetadataType_PlaneLayouts,
+            gralloc4::MetadataType_Dataspace,
+    };
+    std::vector<hardware::hidl_vec<uint8_t>> metadata;
+    for (auto _ : state) {
+        mapper->getMultiple(handle, types, &metadata);
+    }
+    state.SetItemsProcessed(state.iterations() * types.size());
+}
+BENCHMARK(BM_getMultiple);
+
+} // namespace
+} // namespace android
+
+BENCHMARK_MAIN();
@@ -38,6 +38,7 @@ constexpr uint64_t kTestUsage = GraphicBuffer::USAGE_SW_WRITE_OFTEN;
 
 } // namespace
 
+using ::testing::_;
 using ::testing::DoAll;
 using ::testing::Return;
 using ::testing::SetArgPointee;
@@ -53,6 +54,11 @@ public:
                     allocate)
                 .WillOnce(DoAll(SetArgPointee<7>(stride), Return(err)));
     }
+    void setUpAllocateMultipleExpectations(status_t err, uint32_t stride, uint32_t bufferCount) {
+        EXPECT_CALL(*(reinterpret_cast<const mock::MockGrallocAllocator*>(mAllocator.get())),
+                    allocate(_, _, _, _, _, _, bufferCount, _, _, _))
+                .WillOnce(DoAll(SetArgPointee<7>(stride), Return(err)));
+    }
     std::unique_ptr<const GrallocAllocator>& getAllocator() { return mAllocator; }
 };
 
@@ -113,4 +119,41 @@ TEST_F(GraphicBufferAllocatorTest, AllocateLargeStride) {
     ASSERT_EQ(NO_ERROR, err);
     ASSERT_EQ(expectedStride, stride);
 }
+
+TEST_F(GraphicBufferAllocatorTest, AllocateMultipleUsesOneAllocation) {
+    constexpr uint32_t kBufferCount = 4;
+    mAllocator.setUpAllocateMultipleExpectations(NO_ERROR, kTestWidth, kBufferCount);
+    uint32_t stride = 0;
+    buffer_handle_t handles[kBufferCount] = {};
+    status_t err = mAllocator.allocate(kTestWidth, kTestHeight, PIXEL_FORMAT_RGBA_8888,
+                                       kTestLayerCount, kTestUsage, kBufferCount, handles,
+                                       &stride, "GraphicBufferAllocatorTest");
+    ASSERT_EQ(NO_ERROR, err);
+    ASSERT_EQ(kTestWidth, stride);
+}
+
+TEST_F(GraphicBufferAllocatorTest, AllocateAsync) {
+    constexpr uint32_t kBufferCount = 2;
+    mAllocator.setUpAllocateMultipleExpectations(NO_ERROR, kTestWidth, kBufferCount);
+    auto result = mAllocator
+                          .allocateAsync(kTestWidth, kTestHeight, PIXEL_FORMAT_RGBA_8888,
+                                         kTestLayerCount, kTestUsage, kBufferCount,
+                                         "GraphicBufferAllocatorTest")
+                          .get();
+    ASSERT_EQ(NO_ERROR, result.status);
+    ASSERT_EQ(kTestWidth, result.stride);
+    ASSERT_EQ(kBufferCount, result.handles.size());
+}
+
+TEST_F(GraphicBufferAllocatorTest, AllocateAsyncError) {
+    constexpr uint32_t kBufferCount = 2;
+    mAllocator.setUpAllocateMultipleExpectations(NO_MEMORY, 0, kBufferCount);
+    auto result = mAllocator
+                          .allocateAsync(kTestWidth, kTestHeight, PIXEL_FORMAT_RGBA_8888,
+                                         kTestLayerCount, kTestUsage, kBufferCount,
+                                         "GraphicBufferAllocatorTest")
+                          .get();
+    ASSERT_EQ(NO_MEMORY, result.status);
+    ASSERT_TRUE(result.handles.empty());
+}
 } // namespace android
@@ -17,8 +17,12 @@
 #define LOG_TAG "GraphicBufferTest"
 
 #include <ui/GraphicBuffer.h>
+#include <ui/GraphicBufferMapper.h>
 
 #include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <vector>
 
 namespace android {
 
@@ -66,4 +70,53 @@ TEST_F(GraphicBufferTest, AllocateBadDimensions) {
     ASSERT_EQ(BAD_VALUE, gb2->initCheck());
 }
 
+TEST_F(GraphicBufferTest, ImportCacheSharesHandles) {
+    sp<GraphicBuffer> gb(new GraphicBuffer(kTestWidth, kTestHeight, PIXEL_FORMAT_RGBA_8888,
+                                           kTestLayerCount, kTestUsage, std::string("test")));
+    ASSERT_EQ(NO_ERROR, gb->initCheck());
+
+    std::vector<uint8_t> flattened(gb->getFlattenedSize());
+    std::vector<int> fds(gb->getFdCount());
+    {
+        void* buffer = flattened.data();
+        size_t size = flattened.size();
+        int* fdData = fds.data();
+        size_t fdCount = fds.size();
+        ASSERT_EQ(NO_ERROR, gb->flatten(buffer, size, fdData, fdCount));
+    }
+
+    // Unflattening takes ownership of the fds, so each import gets its own copies.
+    auto unflatten = [&]() {
+        std::vector<int> dupFds;
+        for (int fd : fds) {
+            dupFds.push_back(dup(fd));
+        }
+        sp<GraphicBuffer> imported(new GraphicBuffer());
+        const void* buffer = flattened.data();
+        size_t size = flattened.size();
+        const int* fdData = dupFds.data();
+        size_t fdCount = dupFds.size();
+        EXPECT_EQ(NO_ERROR, imported->unflatten(buffer, size, fdData, fdCount));
+        return imported;
+    };
+
+    GraphicBufferMapper& mapper = GraphicBufferMapper::get();
+    mapper.setImportCacheEnabled(true);
+    sp<GraphicBuffer> first = unflatten();
+    sp<GraphicBuffer> second = unflatten();
+    mapper.setImportCacheEnabled(false);
+    sp<GraphicBuffer> uncached = unflatten();
+
+    EXPECT_EQ(gb->getId(), first->getId());
+    EXPECT_EQ(first->handle, second->handle);
+    EXPECT_NE(first->handle, uncached->handle);
+
+    // The shared handle stays valid until its last import is freed.
+    first.clear();
+    void* data = nullptr;
+    ASSERT_EQ(NO_ERROR, second->lock(GraphicBuffer::USAGE_SW_WRITE_OFTEN, &data));
+    EXPECT_NE(nullptr, data);
+    EXPECT_EQ(NO_ERROR, second->unlock());
+}
+
 } // namespace android
@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <ui/Region.h>
+
+// Usage: atest Region_benchmark
+
+namespace android {
+namespace {
+
+constexpr int kCellSize = 10;
+
+// A checkerboard of 'size' x 'size' cells, which has size * size / 2 rects.
+Region makeCheckerboard(int size) {
+    Region region;
+    for (int y = 0; y < size; y++) {
+        for (int x = y % 2; x < size; x += 2) {
+            region.orSelf(Rect(x * kCellSize, y * kCellSize, (x + 1) * kCellSize,
+                               (y + 1) * kCellSize));
+        }
+    }
+    return region;
+}
+
+// A rect covering the middle quarter of the checkerboard
+Rect makeCenterRect(int size) {
+    const int extent = size * kCellSize;
+    return Rect(extent / 4 + 1, extent / 4 + 1, extent * 3 / 4 - 1, extent * 3 / 4 - 1);
+}
+
+void BM_contains(benchmark::State& state) {
+    const int size = static_cast<int>(state.range(0));
+    const Region region = makeCheckerboard(size);
+    const int extent = size * kCellSize;
+    int x = 0;
+    int y = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(region.contains(x, y));
+        x = (x + 7) % extent;
+        y = (y + 13) % extent;
+    }
+}
+BENCHMARK(BM_contains)->Arg(4)->Arg(16)->Arg(64);
+
+void BM_intersectRect(benchmark::State& state) {
+    const int size = static_cast<int>(state.range(0));
+    const Region region = makeCheckerboard(size);
+    const Rect rect = makeCenterRect(size);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(region.intersect(rect));
+    }
+}
+BENCHMARK(BM_intersectRect)->Arg(4)->Arg(16)->Arg(64);
+
+void BM_subtractRect(benchmark::State& state) {
+    const int size = static_cast<int>(state.range(0));
+    const Region region = makeCheckerboard(size);
+    const Rect rect = makeCenterRect(size);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(region.subtract(rect));
+    }
+}
+BENCHMARK(BM_subtractRect)->Arg(4)->Arg(16)->Arg(64);
+
+// The offset variants always use the general operation on two regions, for
+// comparison with the rect operations above.
+void BM_intersectRegion(benchmark::State& state) {
+    const int size = static_cast<int>(state.range(0));
+    const Region region = makeCheckerboard(size);
+    const Region rect(makeCenterRect(size));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(region.intersect(rect, 0, 0));
+    }
+}
+BENCHMARK(BM_intersectRegion)->Arg(4)->Arg(16)->Arg(64);
+
+void BM_subtractRegion(benchmark::State& state) {
+    const int size = static_cast<int>(state.range(0));
+    const Region region = makeCheckerboard(size);
+    const Region rect(makeCenterRect(size));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(region.subtract(rect, 0, 0));
+    }
+}
+BENCHMARK(BM_subtractRegion)->Arg(4)->Arg(16)->Arg(64);
+
+void BM_mergeRegion(benchmark::State& state) {
+    const int size = static_cast<int>(state.range(0));
+    const Region region = makeCheckerboard(size);
+    const Region shifted = region.translate(kCellSize, 0);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(region.merge(shifted));
+    }
+}
+BENCHMARK(BM_mergeRegion)->Arg(4)->Arg(16)->Arg(64);
+
+void BM_createTJunctionFreeRegion(benchmark::State& state) {
+    const int size = static_cast<int>(state.range(0));
+    const Region region = makeCheckerboard(size).merge(makeCenterRect(size));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(Region::createTJunctionFreeRegion(region));
+    }
+}
+BENCHMARK(BM_createTJunctionFreeRegion)->Arg(4)->Arg(16)->Arg(64);
+
+} // namespace
+} // namespace android
+
+BENCHMARK_MAIN();
@@ -19,8 +19,11 @@
 #include <stdlib.h>
 #include <ui/Region.h>
 #include <ui/Rect.h>
+#include <ui/Transform.h>
 #include <gtest/gtest.h>
 
+#include <vector>
+
 namespace android {
 
 class RegionTest : public testing::Test {
@@ -152,6 +155,119 @@ TEST_F(RegionTest, Random_TJunction) {
     }
 }
 
+// Fills r with random 1x1 cells of the grid, which are set in cells
+static void randomCells(Region& r, bool cells[X_MAX][Y_MAX]) {
+    r.clear();
+    for (int i = 0; i < X_MAX; i++) {
+        for (int j = 0; j < Y_MAX; j++) {
+            cells[i][j] = random() % 2;
+            if (cells[i][j]) {
+                r.orSelf(Rect(i, j, i + 1, j + 1));
+            }
+        }
+    }
+}
+
+static bool isCellSet(const bool cells[X_MAX][Y_MAX], int x, int y) {
+    return x >= 0 && x < X_MAX && y >= 0 && y < Y_MAX && cells[x][y];
+}
+
+static bool rectContains(const Rect& rect, int x, int y) {
+    return x >= rect.left && x < rect.right && y >= rect.top && y < rect.bottom;
+}
+
+TEST_F(RegionTest, Random_Contains) {
+    Region r;
+    bool cells[X_MAX][Y_MAX];
+    srandom(12345);
+
+    for (int iter = 0; iter < ITER_MAX; iter++) {
+        randomCells(r, cells);
+        for (int x = -1; x <= X_MAX; x++) {
+            for (int y = -1; y <= Y_MAX; y++) {
+                EXPECT_EQ(isCellSet(cells, x, y), r.contains(x, y)) << x << "," << y;
+            }
+        }
+    }
+}
+
+TEST_F(RegionTest, Random_RectOperations) {
+    Region r;
+    bool cells[X_MAX][Y_MAX];
+    srandom(12345);
+
+    for (int iter = 0; iter < ITER_MAX; iter++) {
+        randomCells(r, cells);
+        const int left = static_cast<int>(random() % (X_MAX + 2)) - 1;
+        const int top = static_cast<int>(random() % (Y_MAX + 2)) - 1;
+        const Rect rect(left, top, left + 1 + static_cast<int>(random() % X_MAX),
+                        top + 1 + static_cast<int>(random() % Y_MAX));
+
+        const Region intersected = r.intersect(rect);
+        const Region subtracted = r.subtract(rect);
+        for (int x = -1; x <= X_MAX; x++) {
+            for (int y = -1; y <= Y_MAX; y++) {
+                const bool set = isCellSet(cells, x, y);
+                EXPECT_EQ(set && rectContains(rect, x, y), intersected.contains(x, y));
+                EXPECT_EQ(set && !rectContains(rect, x, y), subtracted.contains(x, y));
+            }
+        }
+
+        // The rects are the same as those of the general operation on regions,
+        // which the offset variants always use.
+        EXPECT_TRUE(intersected.hasSameRects(r.intersect(Region(rect), 0, 0)));
+        EXPECT_TRUE(subtracted.hasSameRects(r.subtract(Region(rect), 0, 0)));
+        EXPECT_TRUE(intersected.hasSameRects(r.intersect(Region(rect))));
+        EXPECT_TRUE(intersected.hasSameRects(Region(rect).intersect(r)));
+        EXPECT_TRUE(subtracted.hasSameRects(r.subtract(Region(rect))));
+        EXPECT_EQ(intersected.getBounds(), r.intersect(Region(rect), 0, 0).getBounds());
+        EXPECT_EQ(subtracted.getBounds(), r.subtract(Region(rect), 0, 0).getBounds());
+    }
+}
+
+TEST_F(RegionTest, Random_Transform) {
+    Region r;
+    bool cells[X_MAX][Y_MAX];
+    srandom(12345);
+
+    ui::Transform scale;
+    scale.set(1.5f, 0.f, 0.f, 2.f);
+    scale.set(3.f, 7.f);
+    const ui::Transform transforms[] = {
+            ui::Transform(ui::Transform::ROT_90, X_MAX, Y_MAX),
+            ui::Transform(ui::Transform::ROT_180, X_MAX, Y_MAX),
+            ui::Transform(ui::Transform::FLIP_H, X_MAX, Y_MAX),
+            scale,
+    };
+
+    for (int iter = 0; iter < ITER_MAX; iter++) {
+        randomCells(r, cells);
+        for (const auto& transform : transforms) {
+            size_t count = 0;
+            const Rect* rects = r.getArray(&count);
+            std::vector<Rect> transformed(count);
+            transform.transformRects(rects, count, transformed.data());
+
+            Region expected;
+            for (size_t i = 0; i < count; i++) {
+                EXPECT_EQ(transform.transform(rects[i]), transformed[i]);
+                expected.orSelf(transform.transform(rects[i]));
+            }
+            EXPECT_TRUE(expected.hasSameRects(transform.transform(r)));
+        }
+    }
+}
+
+TEST_F(RegionTest, SubtractEmptyRect) {
+    Region r;
+    r.orSelf(Rect(0, 0, 10, 10));
+    r.orSelf(Rect(20, 5, 30, 15));
+
+    EXPECT_TRUE(r.subtract(Rect(5, 5, 5, 5)).hasSameRects(r));
+    EXPECT_TRUE(r.subtract(Rect::INVALID_RECT).hasSameRects(r));
+    EXPECT_TRUE(r.intersect(Rect::INVALID_RECT).isEmpty());
+}
+
 TEST_F(RegionTest, EqualsToSelf) {
     Region touchableRegion;
     touchableRegion.orSelf(Rect(0, 0, 100, 100));
@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <ui/Region.h>
+#include <ui/Transform.h>
+
+#include <vector>
+
+// Usage: atest Transform_benchmark
+
+namespace android {
+namespace {
+
+constexpr int kCellSize = 10;
+
+// A checkerboard of 'size' x 'size' cells, which has size * size / 2 rects.
+Region makeCheckerboard(int size) {
+    Region region;
+    for (int y = 0; y < size; y++) {
+        for (int x = y % 2; x < size; x += 2) {
+            region.orSelf(Rect(x * kCellSize, y * kCellSize, (x + 1) * kCellSize,
+                               (y + 1) * kCellSize));
+        }
+    }
+    return region;
+}
+
+ui::Transform makeRotation(int size) {
+    return ui::Transform(ui::Transform::ROT_90, size * kCellSize, size * kCellSize);
+}
+
+ui::Transform makeScale() {
+    ui::Transform transform;
+    transform.set(1.5f, 0.f, 0.f, 1.5f);
+    transform.set(20.f, 40.f);
+    return transform;
+}
+
+void BM_inverse(benchmark::State& state) {
+    const ui::Transform transform = makeScale();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(transform.inverse());
+    }
+}
+BENCHMARK(BM_inverse);
+
+void BM_transformRegionTranslate(benchmark::State& state) {
+    const int size = static_cast<int>(state.range(0));
+    const Region region = makeCheckerboard(size);
+    ui::Transform transform;
+    transform.set(15.f, 25.f);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(transform.transform(region));
+    }
+}
+BENCHMARK(BM_transformRegionTranslate)->Arg(4)->Arg(16)->Arg(64);
+
+void BM_transformRegionScale(benchmark::State& state) {
+    const int size = static_cast<int>(state.range(0));
+    const Region region = makeCheckerboard(size);
+    const ui::Transform transform = makeScale();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(transform.transform(region));
+    }
+}
+BENCHMARK(BM_transformRegionScale)->Arg(4)->Arg(16)->Arg(64);
+
+void BM_transformRegionRotate(benchmark::State& state) {
+    const int size = static_cast<int>(state.range(0));
+    const Region region = makeCheckerboard(size);
+    const ui::Transform transform = makeRotation(size);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(transform.transform(region));
+    }
+}
+BENCHMARK(BM_transformRegionRotate)->Arg(4)->Arg(16)->Arg(64);
+
+void BM_transformRects(benchmark::State& state) {
+    const int size = static_cast<int>(state.range(0));
+    const Region region = makeCheckerboard(size);
+    const ui::Transform transform = makeRotation(size);
+    size_t count = 0;
+    const Rect* rects = region.getArray(&count);
+    std::vector<Rect> out(count);
+    for (auto _ : state) {
+        transform.transformRects(rects, count, out.data());
+        benchmark::DoNotOptimize(out.data());
+    }
+}
+BENCHMARK(BM_transformRects)->Arg(4)->Arg(16)->Arg(64);
+
+void BM_transformRectsOneByOne(benchmark::State& state) {
+    const int size = static_cast<int>(state.range(0));
+    const Region region = makeCheckerboard(size);
+    const ui::Transform transform = makeRotation(size);
+    size_t count = 0;
+    const Rect* rects = region.getArray(&count);
+    std::vector<Rect> out(count);
+    for (auto _ : state) {
+        for (size_t i = 0; i < count; i++) {
+            out[i] = transform.transform(rects[i]);
+        }
+        benchmark::DoNotOptimize(out.data());
+    }
+}
+BENCHMARK(BM_transformRectsOneByOne)->Arg(4)->Arg(16)->Arg(64);
+
+} // namespace
+} // namespace android
+
+BENCHMARK_MAIN();
@@ -180,4 +180,45 @@ TEST_F(ColorSpaceTest, LUT) {
 
 }
 
+TEST_F(ColorSpaceTest, LUTMatchesConnector) {
+    const ColorSpace spaces[] = {ColorSpace::sRGB(), ColorSpace::AdobeRGB(),
+                                 ColorSpace::ProPhotoRGB(), ColorSpace::linearSRGB(),
+                                 ColorSpace::extendedSRGB()};
+    constexpr uint32_t size = 9;
+    const float m = 1.0f / float(size - 1);
+    for (const auto& src : spaces) {
+        for (const auto& dst : spaces) {
+            auto lut = ColorSpace::createLUT(size, src, dst);
+            ColorSpaceConnector connector(src, dst);
+            const float3* data = lut.get();
+            for (uint32_t z = 0; z < size; z++) {
+                for (int32_t y = int32_t(size - 1); y >= 0; y--) {
+                    for (uint32_t x = 0; x < size; x++) {
+                        const float3 expected = connector.transform(
+                                {static_cast<float>(x) * m, static_cast<float>(y) * m,
+                                 static_cast<float>(z) * m});
+                        EXPECT_TRUE(all(lessThan(abs(*data++ - expected), float3{1e-5f})))
+                                << src.getName() << " -> " << dst.getName();
+                    }
+                }
+            }
+        }
+    }
+}
+
+TEST_F(ColorSpaceTest, CachedLUT) {
+    auto lut = ColorSpace::getLUT(17, ColorSpace::sRGB(), ColorSpace::AdobeRGB());
+    ASSERT_TRUE(lut != nullptr);
+    EXPECT_EQ(lut, ColorSpace::getLUT(17, ColorSpace::sRGB(), ColorSpace::AdobeRGB()));
+    EXPECT_NE(lut, ColorSpace::getLUT(9, ColorSpace::sRGB(), ColorSpace::AdobeRGB()));
+
+    // {1.0f, 0.5f, 0.0f}
+    auto r = lut.get()[0 * 17 * 17 + 8 * 17 + 16];
+    EXPECT_TRUE(all(lessThan(abs(r - float3{0.8912f, 0.4962f, 0.1164f}), float3{1e-4f})));
+
+    // Color spaces with custom transfer functions are not cached
+    EXPECT_NE(ColorSpace::getLUT(17, ColorSpace::extendedSRGB(), ColorSpace::sRGB()),
+              ColorSpace::getLUT(17, ColorSpace::extendedSRGB(), ColorSpace::sRGB()));
+}
+
 }; // namespace android
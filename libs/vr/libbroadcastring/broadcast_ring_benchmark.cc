@@ -0,0 +1,101 @@
+#include "libbroadcastring/broadcast_ring.h"
+
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <memory>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+namespace android {
+namespace dvr {
+namespace {
+
+struct alignas(8) Record {
+  char v[64];
+};
+
+struct BenchmarkTraits : public DefaultRingTraits {
+  static constexpr uint32_t kMaxReservedRecords = 16;
+};
+
+using Ring = BroadcastRing<Record, BenchmarkTraits>;
+
+constexpr uint32_t kRecordCount = 1024;
+
+// Period between the runs of records written by the concurrent writer.
+constexpr std::chrono::microseconds kWritePeriod(100);
+
+// Owns a ring and a thread writing runs of |range_size| records to it.
+class RingWithWriter {
+ public:
+  explicit RingWithWriter(uint32_t range_size)
+      : data_(new char[Ring::MemorySize(kRecordCount)]),
+        ring_(Ring::Create(data_.get(), Ring::MemorySize(kRecordCount),
+                           kRecordCount)) {
+    for (uint32_t i = 0; i < kRecordCount; ++i)
+      ring_.Put(Record());
+    writer_ = std::thread([this, range_size]() {
+      std::vector<Record> records(range_size);
+      while (!quit_.load(std::memory_order_relaxed)) {
+        ring_.PutRange(records.data(), records.size());
+        std::this_thread::sleep_for(kWritePeriod);
+      }
+    });
+  }
+
+  ~RingWithWriter() {
+    quit_.store(true, std::memory_order_relaxed);
+    writer_.join();
+  }
+
+  const Ring& ring() const { return ring_; }
+
+ private:
+  std::unique_ptr<char[]> data_;
+  Ring ring_;
+  std::atomic<bool> quit_{false};
+  std::thread writer_;
+};
+
+// Reads the newest |state.range(0)| records one at a time with Get().
+void BM_Get(benchmark::State& state) {
+  const uint32_t batch_size = state.range(0);
+  RingWithWriter ring_with_writer(BenchmarkTraits::kMaxReservedRecords);
+  const Ring& ring = ring_with_writer.ring();
+  Record record;
+  int64_t records_read = 0;
+  for (auto _ : state) {
+    uint32_t sequence = ring.GetNextSequence() - batch_size;
+    for (uint32_t i = 0; i < batch_size && ring.Get(&sequence, &record); ++i) {
+      benchmark::DoNotOptimize(record);
+      sequence++;
+      records_read++;
+    }
+  }
+  state.SetItemsProcessed(records_read);
+}
+BENCHMARK(BM_Get)->Arg(1)->Arg(16)->Arg(256);
+
+// Reads the newest |state.range(0)| records at once with GetRange().
+void BM_GetRange(benchmark::State& state) {
+  const uint32_t batch_size = state.range(0);
+  RingWithWriter ring_with_writer(BenchmarkTraits::kMaxReservedRecords);
+  const Ring& ring = ring_with_writer.ring();
+  std::vector<Record> records(batch_size);
+  int64_t records_read = 0;
+  for (auto _ : state) {
+    uint32_t sequence = ring.GetNextSequence() - batch_size;
+    records_read += ring.GetRange(&sequence, records.data(), records.size());
+    benchmark::DoNotOptimize(records.data());
+  }
+  state.SetItemsProcessed(records_read);
+}
+BENCHMARK(BM_GetRange)->Arg(1)->Arg(16)->Arg(256);
+
+}  // namespace
+}  // namespace dvr
+}  // namespace android
+
+BENCHMARK_MAIN();
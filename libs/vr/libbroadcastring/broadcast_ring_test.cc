@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <memory>
 #include <thread>  // NOLINT
+#include <vector>
 #include <sys/mman.h>
 
 #include <gtest/gtest.h>
@@ -286,6 +287,42 @@ TYPED_TEST(BroadcastRingTest, FillTwice) {
   }
 }
 
+TYPED_TEST(BroadcastRingTest, GetRange) {
+  using Record = typename TypeParam::Record;
+  using Ring = typename TypeParam::Ring;
+  Ring ring;
+  auto mmap = CreateRing(&ring, Ring::Traits::MinCount());
+  const uint32_t next_sequence_at_start = ring.GetNextSequence();
+  std::vector<Record> records(ring.record_count() + 1);
+  {
+    uint32_t sequence = next_sequence_at_start;
+    EXPECT_EQ(0U, ring.GetRange(&sequence, records.data(), records.size()));
+    EXPECT_EQ(next_sequence_at_start, sequence);
+  }
+  for (uint32_t i = 0; i < 2 * ring.record_count(); ++i)
+    ring.Put(Record(FillChar(i)));
+  {
+    uint32_t sequence = next_sequence_at_start;
+    EXPECT_EQ(ring.record_count(),
+              ring.GetRange(&sequence, records.data(), records.size()));
+    EXPECT_EQ(ring.GetOldestSequence(), sequence);
+    for (uint32_t i = 0; i < ring.record_count(); ++i) {
+      EXPECT_EQ(Record(FillChar(sequence - next_sequence_at_start + i)),
+                records[i]);
+    }
+  }
+  {
+    uint32_t sequence = ring.GetNewestSequence();
+    EXPECT_EQ(1U, ring.GetRange(&sequence, records.data(), records.size()));
+    EXPECT_EQ(ring.GetNewestSequence(), sequence);
+    EXPECT_EQ(Record(FillChar(2 * ring.record_count() - 1)), records[0]);
+  }
+  {
+    uint32_t sequence = ring.GetOldestSequence();
+    EXPECT_EQ(0U, ring.GetRange(&sequence, records.data(), 0));
+  }
+}
+
 TYPED_TEST(BroadcastRingTest, Import) {
   using Record = typename TypeParam::Record;
   using Ring = typename TypeParam::Ring;
@@ -325,6 +362,32 @@ TYPED_TEST(BroadcastRingTest, Import) {
   }
 }
 
+TEST(BroadcastRingTest, PutRange) {
+  using Ring = Dynamic_16_NxM_5plus11::Ring;
+  using Record = Ring::Record;
+  constexpr uint32_t kRangeSize = Ring::Traits::kMaxReservedRecords;
+  Ring ring;
+  auto mmap = CreateRing(&ring, Ring::Traits::MinCount());
+
+  std::vector<Record> out_records;
+  for (uint32_t i = 0; i < kRangeSize; ++i)
+    out_records.push_back(Record(FillChar(i)));
+  for (uint32_t i = 0; i < ring.record_count(); ++i)
+    ring.Put(Record(0x7f));
+
+  // The range overwrites the oldest records, and is readable in one call.
+  const uint32_t range_sequence = ring.GetNextSequence();
+  ring.PutRange(out_records.data(), out_records.size());
+  EXPECT_EQ(range_sequence + kRangeSize, ring.GetNextSequence());
+
+  uint32_t sequence = range_sequence;
+  std::vector<Record> in_records(kRangeSize);
+  EXPECT_EQ(kRangeSize,
+            ring.GetRange(&sequence, in_records.data(), in_records.size()));
+  EXPECT_EQ(range_sequence, sequence);
+  EXPECT_EQ(out_records, in_records);
+}
+
 TEST(BroadcastRingTest, ShouldFailImportIfStaticSizeMismatch) {
   using OriginalRing = typename Static_16_16x16::Ring;
   using RecordSizeMismatchRing = typename Static_8_8x16::Ring;
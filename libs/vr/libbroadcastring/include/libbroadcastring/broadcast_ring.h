@@ -4,6 +4,7 @@
 #include <inttypes.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <algorithm>
 #include <atomic>
 #include <limits>
 #include <tuple>
@@ -257,12 +258,23 @@ class BroadcastRing {
   // Writes a record to the ring.
   //
   // The oldest record is overwritten unless the ring is not already full.
-  void Put(const Record& record) {
-    const int kRecordCount = 1;
-    Reserve(kRecordCount);
+  void Put(const Record& record) { PutRange(&record, 1); }
+
+  // Writes |count| consecutive records to the ring, and makes them visible to
+  // readers at once.
+  //
+  // This allows writing variable length data as a run of records, which can
+  // be read back with GetRange(). |count| must not exceed
+  // Traits::kMaxReservedRecords.
+  void PutRange(const Record* records, uint32_t count) {
+    Reserve(count);
     Geometry geometry = GetGeometry();
-    PutRecordInternal(&record, record_mmap_writer(geometry.tail_index));
-    Publish(kRecordCount);
+    for (uint32_t i = 0; i < count; ++i) {
+      PutRecordInternal(&records[i],
+                        record_mmap_writer(SequenceToIndex(
+                            geometry.tail + i, geometry.record_count)));
+    }
+    Publish(count);
   }
 
   // Gets sequence number of the oldest currently available record.
@@ -355,6 +367,54 @@ class BroadcastRing {
     }
   }
 
+  // Copies up to |max_count| consecutive records, starting from the oldest
+  // available record with sequence at least |*sequence|, to |records|.
+  //
+  // Returns the number of records copied, which is zero if there is no recent
+  // enough record available.
+  //
+  // Updates |*sequence| with the sequence number of the first record returned.
+  // To get the records following the range, increment this number by the
+  // returned count.
+  //
+  // This synchronizes like Get(), but validates the whole range once, after
+  // copying all of its records.
+  uint32_t GetRange(uint32_t* sequence /*inout*/, Record* records /*out*/,
+                    uint32_t max_count) const {
+    for (;;) {
+      uint32_t tail = std::atomic_load_explicit(&header_mmap()->tail,
+                                                std::memory_order_acquire);
+      uint32_t head = std::atomic_load_explicit(&header_mmap()->head,
+                                                std::memory_order_relaxed);
+
+      if (tail - head > record_count())
+        continue;  // Concurrent modification; re-try.
+
+      if (*sequence - head > tail - head)
+        *sequence = head;  // Out of window, skip forward to first available.
+
+      const uint32_t count = std::min(tail - *sequence, max_count);
+      if (count == 0) return 0;  // No new records available.
+
+      for (uint32_t i = 0; i < count; ++i) {
+        GetRecordInternal(
+            record_mmap_reader(SequenceToIndex(*sequence + i, record_count())),
+            &records[i]);
+      }
+
+      // NB: It is not sufficient to change this to a load-acquire of |head|.
+      std::atomic_thread_fence(std::memory_order_acquire);
+
+      uint32_t final_head = std::atomic_load_explicit(
+          &header_mmap()->head, std::memory_order_relaxed);
+
+      if (final_head - head > *sequence - head)
+        continue;  // Concurrent modification; re-try.
+
+      return count;
+    }
+  }
+
   // Copies the newest available record with sequence at least |*sequence| to
   // |record|.
   //
@@ -229,6 +229,14 @@ Status<void> BufferHubQueue::HandleBufferEvent(size_t slot, int event_fd,
       id(), buffers_[slot]->id(), slot, event_fd, poll_events, events);
 
   if (events & EPOLLIN) {
+    // The buffer may have been dequeued through EnqueueReadyBuffer() before
+    // its event was handled.
+    if (!IsBufferReady(slot)) {
+      ALOGD_IF(TRACE,
+               "BufferHubQueue::HandleBufferEvent: Buffer not ready: slot=%zu",
+               slot);
+      return {};
+    }
     return Enqueue({buffers_[slot], slot, buffers_[slot]->GetQueueIndex()});
   } else if (events & EPOLLHUP) {
     ALOGW(
@@ -359,13 +367,32 @@ Status<void> BufferHubQueue::Enqueue(Entry entry) {
   }
 }
 
+bool BufferHubQueue::EnqueueReadyBuffer() {
+  ATRACE_NAME("BufferHubQueue::EnqueueReadyBuffer");
+  const size_t* ready_slot = nullptr;
+  for (const size_t& slot : unavailable_buffers_slot_) {
+    if (buffers_[slot] && IsBufferReady(slot) &&
+        (!ready_slot || buffers_[slot]->GetQueueIndex() <
+                            buffers_[*ready_slot]->GetQueueIndex())) {
+      ready_slot = &slot;
+    }
+  }
+  if (!ready_slot)
+    return false;
+
+  const size_t slot = *ready_slot;
+  return Enqueue({buffers_[slot], slot, buffers_[slot]->GetQueueIndex()}).ok();
+}
+
 Status<std::shared_ptr<BufferHubBase>> BufferHubQueue::Dequeue(int timeout,
                                                                size_t* slot) {
   ALOGD_IF(TRACE, "%s: count=%zu, timeout=%d", __FUNCTION__, count(), timeout);
 
   PDX_TRACE_FORMAT("%s|count=%zu|", __FUNCTION__, count());
 
-  if (count() == 0) {
+  // Buffers released or posted since they were dequeued are found through
+  // their shared state, without waiting for their events.
+  if (count() == 0 && !EnqueueReadyBuffer()) {
     if (!WaitForBuffers(timeout))
       return ErrorStatus(ETIMEDOUT);
   }
@@ -576,6 +603,10 @@ Status<void> ProducerQueue::RemoveBuffer(size_t slot) {
   return BufferHubQueue::RemoveBuffer(slot);
 }
 
+bool ProducerQueue::IsBufferReady(size_t slot) {
+  return GetBuffer(slot)->is_released();
+}
+
 Status<std::shared_ptr<ProducerBuffer>> ProducerQueue::Dequeue(
     int timeout, size_t* slot, LocalHandle* release_fence) {
   DvrNativeBufferMetadata canonical_meta;
@@ -801,6 +832,12 @@ Status<std::shared_ptr<ConsumerBuffer>> ConsumerQueue::Dequeue(
   return {std::move(buffer)};
 }
 
+bool ConsumerQueue::IsBufferReady(size_t slot) {
+  auto buffer = GetBuffer(slot);
+  return BufferHubDefs::isClientPosted(buffer->buffer_state(),
+                                       buffer->client_state_mask());
+}
+
 Status<void> ConsumerQueue::OnBufferAllocated() {
   ALOGD_IF(TRACE, "%s: queue_id=%d", __FUNCTION__, id());
 
@@ -206,6 +206,11 @@ class BufferHubQueue : public pdx::Client {
   // Called when a buffer is allocated remotely.
   virtual pdx::Status<void> OnBufferAllocated() { return {}; }
 
+  // Returns whether the buffer in |slot| is ready to be dequeued according to
+  // the buffer state in shared memory, i.e. released for a producer and posted
+  // for a consumer.
+  virtual bool IsBufferReady(size_t slot) = 0;
+
   // Size of the metadata that buffers in this queue cary.
   size_t user_metadata_size_{0};
 
@@ -220,6 +225,11 @@ class BufferHubQueue : public pdx::Client {
  private:
   void Initialize();
 
+  // Enqueues the unavailable buffer that became ready first, by checking the
+  // buffer states in shared memory instead of waiting for buffer events.
+  // Returns whether a buffer was enqueued.
+  bool EnqueueReadyBuffer();
+
   // Special epoll data field indicating that the epoll event refers to the
   // queue.
   static constexpr int64_t kEpollQueueEventIndex = -1;
@@ -346,6 +356,9 @@ class ProducerQueue : public pdx::ClientBase<ProducerQueue, BufferHubQueue> {
   // Remove producer buffer from the queue.
   pdx::Status<void> RemoveBuffer(size_t slot) override;
 
+  // Producer buffers are ready once released by all their consumers.
+  bool IsBufferReady(size_t slot) override;
+
   // Free all buffers on this producer queue.
   pdx::Status<void> FreeAllBuffers() override {
     return BufferHubQueue::FreeAllBuffers();
@@ -468,6 +481,9 @@ class ConsumerQueue : public BufferHubQueue {
                               size_t slot);
 
   pdx::Status<void> OnBufferAllocated() override;
+
+  // Consumer buffers are ready once posted to this consumer.
+  bool IsBufferReady(size_t slot) override;
 };
 
 }  // namespace dvr
@@ -124,6 +124,43 @@ TEST_F(BufferHubQueueTest, TestDequeue) {
   }
 }
 
+TEST_F(BufferHubQueueTest, TestDequeueReadyBufferWithoutEvents) {
+  ASSERT_TRUE(CreateQueues(config_builder_.Build(), UsagePolicy{}));
+  AllocateBuffer();
+
+  size_t slot;
+  LocalHandle fence;
+  DvrNativeBufferMetadata mi, mo;
+
+  // Cycle the buffer once, so that both queues have dequeued it before.
+  auto p1_status = producer_queue_->Dequeue(kTimeoutMs, &slot, &mo, &fence);
+  ASSERT_TRUE(p1_status.ok());
+  auto p1 = p1_status.take();
+  EXPECT_EQ(0, p1->PostAsync(&mi, LocalHandle()));
+  auto c1_status = consumer_queue_->Dequeue(kTimeoutMs, &slot, &mo, &fence);
+  ASSERT_TRUE(c1_status.ok());
+  auto c1 = c1_status.take();
+  EXPECT_EQ(0, c1->ReleaseAsync(&mi, LocalHandle()));
+
+  // The released buffer is dequeued from its shared state, even with no
+  // timeout.
+  p1_status = producer_queue_->Dequeue(kNoTimeout, &slot, &mo, &fence);
+  ASSERT_TRUE(p1_status.ok());
+  EXPECT_EQ(p1, p1_status.take());
+  EXPECT_EQ(0, p1->PostAsync(&mi, LocalHandle()));
+
+  c1_status = consumer_queue_->Dequeue(kNoTimeout, &slot, &mo, &fence);
+  ASSERT_TRUE(c1_status.ok());
+  EXPECT_EQ(c1, c1_status.take());
+
+  // The events signaled for the buffer meanwhile don't make it available
+  // again while it is in use.
+  WaitAndHandleOnce(producer_queue_.get(), kTimeoutMs);
+  WaitAndHandleOnce(consumer_queue_.get(), kTimeoutMs);
+  EXPECT_EQ(0u, producer_queue_->count());
+  EXPECT_EQ(0u, consumer_queue_->count());
+}
+
 TEST_F(BufferHubQueueTest,
        TestDequeuePostedBufferIfNoAvailableReleasedBuffer_withConsumerBuffer) {
   ASSERT_TRUE(CreateQueues(config_builder_.Build(), UsagePolicy{}));
@@ -0,0 +1,153 @@
+#ifndef ANDROID_PDX_RPC_ARENA_ALLOCATOR_H_
+#define ANDROID_PDX_RPC_ARENA_ALLOCATOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <vector>
+
+#include <pdx/rpc/default_initialization_allocator.h>
+
+namespace android {
+namespace pdx {
+namespace rpc {
+
+// Thread local arena for the containers deserialized from a message. Memory is
+// handed out from blocks owned by the calling thread, and is reclaimed all at
+// once when the outermost ArenaScope of the thread ends, instead of container
+// by container. The first block is kept for the next message, so that
+// dispatching messages whose arguments fit in it doesn't allocate.
+//
+// Containers allocated from the arena must not outlive the ArenaScope they are
+// created in. Allocations made outside of any ArenaScope come from the heap.
+class MessageArena {
+ public:
+  // Size of the blocks of the arena, unless an allocation needs a larger one.
+  static constexpr std::size_t kBlockSize = 4096;
+
+  static void* Allocate(std::size_t size, std::size_t alignment) {
+    State* state = GetState();
+    if (state->depth == 0)
+      return ::operator new(size);
+
+    std::size_t offset = (state->used + alignment - 1) & ~(alignment - 1);
+    if (state->blocks.empty() ||
+        offset + size > state->blocks.back().size) {
+      const std::size_t block_size = size > kBlockSize ? size : kBlockSize;
+      state->blocks.push_back(
+          {std::unique_ptr<std::uint8_t[]>(new std::uint8_t[block_size]),
+           block_size});
+      offset = 0;
+    }
+    state->used = offset + size;
+    return state->blocks.back().data.get() + offset;
+  }
+
+  static void Deallocate(void* pointer) {
+    State* state = GetState();
+    for (const Block& block : state->blocks) {
+      const std::uint8_t* data = block.data.get();
+      if (pointer >= data && pointer < data + block.size)
+        return;
+    }
+    ::operator delete(pointer);
+  }
+
+ private:
+  friend class ArenaScope;
+
+  struct Block {
+    std::unique_ptr<std::uint8_t[]> data;
+    std::size_t size;
+  };
+
+  struct State {
+    std::vector<Block> blocks;
+    std::size_t used = 0;
+    std::size_t depth = 0;
+  };
+
+  static void Enter() { GetState()->depth++; }
+
+  static void Exit() {
+    State* state = GetState();
+    if (--state->depth == 0) {
+      if (state->blocks.size() > 1)
+        state->blocks.erase(state->blocks.begin() + 1, state->blocks.end());
+      state->used = 0;
+    }
+  }
+
+  // Uses a normal pointer in parallel with a std::unique_ptr, like
+  // ThreadLocalBuffer, to avoid the cost of thread local dynamic
+  // initialization checks on every access.
+  static State* GetState() {
+    if (!state_)
+      GetStateGuard().reset(state_ = new State);
+    return state_;
+  }
+
+  static std::unique_ptr<State>& GetStateGuard() {
+    static thread_local std::unique_ptr<State> state_guard;
+    return state_guard;
+  }
+
+  static inline thread_local State* state_ = nullptr;
+};
+
+// Marks the span during which the containers allocated from the MessageArena
+// of the thread are in use. The arena is reclaimed when the outermost scope of
+// the thread ends.
+class ArenaScope {
+ public:
+  ArenaScope() { MessageArena::Enter(); }
+  ~ArenaScope() { MessageArena::Exit(); }
+
+  ArenaScope(const ArenaScope&) = delete;
+  void operator=(const ArenaScope&) = delete;
+};
+
+// Allocator drawing from the MessageArena of the thread. Deallocation of arena
+// memory is a no-op.
+template <typename T>
+class ArenaAllocator {
+ public:
+  static_assert(alignof(T) <= alignof(std::max_align_t),
+                "Over-aligned types are not supported by ArenaAllocator.");
+
+  using value_type = T;
+
+  ArenaAllocator() = default;
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>&) {}
+
+  T* allocate(std::size_t n) {
+    return static_cast<T*>(MessageArena::Allocate(n * sizeof(T), alignof(T)));
+  }
+  void deallocate(T* pointer, std::size_t) {
+    MessageArena::Deallocate(pointer);
+  }
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T>&, const ArenaAllocator<U>&) {
+  return true;
+}
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T>&, const ArenaAllocator<U>&) {
+  return false;
+}
+
+// Vector deserializing into the MessageArena. Remote method handlers may take
+// ArenaVector arguments in place of std::vector, as they serialize to the same
+// format, but must copy them to keep them past the call.
+template <typename T>
+using ArenaVector =
+    std::vector<T, DefaultInitializationAllocator<T, ArenaAllocator<T>>>;
+
+}  // namespace rpc
+}  // namespace pdx
+}  // namespace android
+
+#endif  // ANDROID_PDX_RPC_ARENA_ALLOCATOR_H_
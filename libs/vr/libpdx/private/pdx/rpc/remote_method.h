@@ -5,6 +5,7 @@
 #include <type_traits>
 
 #include <pdx/client.h>
+#include <pdx/rpc/arena_allocator.h>
 #include <pdx/rpc/argument_encoder.h>
 #include <pdx/rpc/message_buffer.h>
 #include <pdx/rpc/payload.h>
@@ -182,6 +183,9 @@ void DispatchRemoteMethod(Class& instance,
                           Message& message,
                           std::size_t max_capacity = InitialBufferCapacity) {
   using Signature = typename RemoteMethodType::template RewriteArgs<Args...>;
+  // Arguments deserialized into the MessageArena are reclaimed when the scope
+  // ends, after the reply is sent.
+  ArenaScope arena_scope;
   rpc::ServicePayload<ReceiveBuffer> payload(message);
   payload.Resize(max_capacity);
 
@@ -218,6 +222,7 @@ void DispatchRemoteMethod(Class& instance,
                           std::size_t max_capacity = InitialBufferCapacity) {
   using Signature =
       typename RemoteMethodType::template RewriteSignature<Return, Args...>;
+  ArenaScope arena_scope;
   rpc::ServicePayload<ReceiveBuffer> payload(message);
   payload.Resize(max_capacity);
 
@@ -258,6 +263,7 @@ void DispatchRemoteMethod(Class& instance,
   using InvokeSignature =
       typename RemoteMethodType::template RewriteSignatureWrapReturn<
           Status, Return, Args...>;
+  ArenaScope arena_scope;
   rpc::ServicePayload<ReceiveBuffer> payload(message);
   payload.Resize(max_capacity);
 
@@ -58,6 +58,8 @@ namespace rpc {
 //   * ArrayWrapper of any supported basic type.
 //   * BufferWrapper of any POD type.
 //   * StringWrapper of any supported char type.
+//   * StringWrapper and BufferWrapper of const single byte types, deserialized
+//     as views of the read buffer without copying.
 //   * User types with correctly defined SerializableMembers member type.
 //
 // Planned support for:
@@ -1125,6 +1127,21 @@ inline ErrorType ReadRawData(void* dest, MessageReader* /*reader*/,
   return ErrorCode::NO_ERROR;
 }
 
+// Points |data| at |size| bytes of the read buffer instead of copying them.
+// The data remains valid as long as the read buffer does.
+template <typename T>
+inline ErrorType BorrowRawData(const T** data, MessageReader* /*reader*/,
+                               const void*& start, const void*& end,
+                               size_t size) {
+  static_assert(alignof(T) == 1,
+                "Data borrowed from the read buffer may be unaligned.");
+  if (PDX_UNLIKELY(AdvancePointer(start, size) > end))
+    return ErrorCode::INSUFFICIENT_BUFFER;
+  *data = static_cast<const T*>(start);
+  start = AdvancePointer(start, size);
+  return ErrorCode::NO_ERROR;
+}
+
 // Deserializes a primitive object from raw bytes.
 template <typename T,
           typename = typename std::enable_if<std::is_pod<T>::value>::type>
@@ -1397,11 +1414,17 @@ inline ErrorType DeserializeObject(BufferWrapper<std::vector<T, Allocator>>*,
 template <typename T>
 inline ErrorType DeserializeObject(BufferWrapper<T*>*, MessageReader*,
                                    const void*&, const void*&);
+template <typename T>
+inline ErrorType DeserializeObject(BufferWrapper<const T*>*, MessageReader*,
+                                   const void*&, const void*&);
 inline ErrorType DeserializeObject(std::string*, MessageReader*, const void*&,
                                    const void*&);
 template <typename T>
 inline ErrorType DeserializeObject(StringWrapper<T>*, MessageReader*,
                                    const void*&, const void*&);
+template <typename T>
+inline ErrorType DeserializeObject(StringWrapper<const T>*, MessageReader*,
+                                   const void*&, const void*&);
 template <typename T, typename U>
 inline ErrorType DeserializeObject(std::pair<T, U>*, MessageReader*,
                                    const void*&, const void*&);
@@ -1609,6 +1632,31 @@ inline ErrorType DeserializeObject(BufferWrapper<T*>* value,
   }
 }
 
+// Overload of DeserializeObject() for BufferWrapper types of const pointers.
+// The wrapper is pointed at the payload in the read buffer rather than copying
+// it, and remains valid as long as the read buffer does.
+template <typename T>
+inline ErrorType DeserializeObject(BufferWrapper<const T*>* value,
+                                   MessageReader* reader, const void*& start,
+                                   const void*& end) {
+  EncodingType encoding;
+  std::size_t size;
+
+  if (const auto error =
+          DeserializeBinType(&encoding, &size, reader, start, end))
+    return error;
+
+  if (size % sizeof(T) != 0)
+    return ErrorCode::INSUFFICIENT_DESTINATION_SIZE;
+
+  const T* data = nullptr;
+  if (const auto error = BorrowRawData(&data, reader, start, end, size))
+    return error;
+
+  *value = BufferWrapper<const T*>(data, size / sizeof(T));
+  return ErrorCode::NO_ERROR;
+}
+
 // Deserializes the type code and size for string types.
 inline ErrorType DeserializeStringType(EncodingType* encoding,
                                        std::size_t* size, MessageReader* reader,
@@ -1674,6 +1722,33 @@ inline ErrorType DeserializeObject(StringWrapper<T>* value,
   }
 }
 
+// Overload of DeserializeObject() for StringWrapper types of const characters.
+// The wrapper is pointed at the string in the read buffer rather than copying
+// it, and remains valid as long as the read buffer does. Remote method
+// handlers taking read-only strings may use this in place of std::string to
+// avoid allocating.
+template <typename T>
+inline ErrorType DeserializeObject(StringWrapper<const T>* value,
+                                   MessageReader* reader, const void*& start,
+                                   const void*& end) {
+  EncodingType encoding;
+  std::size_t size;
+
+  if (const auto error =
+          DeserializeStringType(&encoding, &size, reader, start, end))
+    return error;
+
+  if (size % sizeof(T) != 0)
+    return ErrorCode::INSUFFICIENT_DESTINATION_SIZE;
+
+  const T* data = nullptr;
+  if (const auto error = BorrowRawData(&data, reader, start, end, size))
+    return error;
+
+  *value = StringWrapper<const T>(data, size / sizeof(T));
+  return ErrorCode::NO_ERROR;
+}
+
 // Deserializes the type code and size of array types.
 inline ErrorType DeserializeArrayType(EncodingType* encoding, std::size_t* size,
                                       MessageReader* reader, const void*& start,
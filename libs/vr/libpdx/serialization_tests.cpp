@@ -8,8 +8,10 @@
 #include <utility>
 
 #include <gtest/gtest.h>
+#include <pdx/rpc/arena_allocator.h>
 #include <pdx/rpc/argument_encoder.h>
 #include <pdx/rpc/array_wrapper.h>
+#include <pdx/rpc/buffer_wrapper.h>
 #include <pdx/rpc/default_initialization_allocator.h>
 #include <pdx/rpc/payload.h>
 #include <pdx/rpc/serializable.h>
@@ -2413,6 +2415,71 @@ TEST(DeserializationTest, Variant) {
   // TODO(eieio): Add more deserialization tests for Variant.
 }
 
+TEST(DeserializationTest, ConstStringWrapper) {
+  Payload buffer;
+  StringWrapper<const char> result;
+  ErrorType error;
+
+  // Empty FIXSTR.
+  buffer = {ENCODING_TYPE_FIXSTR_MIN};
+  error = Deserialize(&result, &buffer);
+  EXPECT_EQ(ErrorCode::NO_ERROR, error);
+  EXPECT_EQ(0u, result.size());
+
+  // The wrapper points into the buffer instead of copying the string.
+  buffer = {ENCODING_TYPE_STR8, 0x03, 'a', 'b', 'c'};
+  error = Deserialize(&result, &buffer);
+  EXPECT_EQ(ErrorCode::NO_ERROR, error);
+  EXPECT_EQ(std::string("abc"), std::string(result.begin(), result.end()));
+  EXPECT_EQ(reinterpret_cast<const char*>(buffer.Data() + 2), result.data());
+
+  // Truncated STR8.
+  buffer = {ENCODING_TYPE_STR8, 0x03, 'a', 'b'};
+  error = Deserialize(&result, &buffer);
+  EXPECT_EQ(ErrorCode::INSUFFICIENT_BUFFER, error);
+}
+
+TEST(DeserializationTest, ConstBufferWrapper) {
+  Payload buffer;
+  BufferWrapper<const std::uint8_t*> result;
+  ErrorType error;
+
+  // The wrapper points into the buffer instead of copying the data.
+  buffer = {ENCODING_TYPE_BIN8, 0x02, 0x12, 0x34};
+  error = Deserialize(&result, &buffer);
+  EXPECT_EQ(ErrorCode::NO_ERROR, error);
+  ASSERT_EQ(2u, result.size());
+  EXPECT_EQ(0x12, result[0]);
+  EXPECT_EQ(0x34, result[1]);
+  EXPECT_EQ(buffer.Data() + 2, result.data());
+
+  // Truncated BIN8.
+  buffer = {ENCODING_TYPE_BIN8, 0x02, 0x12};
+  error = Deserialize(&result, &buffer);
+  EXPECT_EQ(ErrorCode::INSUFFICIENT_BUFFER, error);
+}
+
+TEST(DeserializationTest, ArenaVector) {
+  Payload buffer;
+  ErrorType error;
+
+  ArenaScope scope;
+  ArenaVector<std::uint32_t> first;
+  buffer = {ENCODING_TYPE_FIXARRAY_MIN + 2, 1, 2};
+  error = Deserialize(&first, &buffer);
+  EXPECT_EQ(ErrorCode::NO_ERROR, error);
+  EXPECT_EQ((ArenaVector<std::uint32_t>{1, 2}), first);
+
+  // Vectors larger than the blocks of the arena get a block of their own.
+  ArenaVector<std::uint8_t> second;
+  buffer = {ENCODING_TYPE_ARRAY16, 0x00, 0x20};
+  buffer.Append(0x2000, 1);
+  error = Deserialize(&second, &buffer);
+  EXPECT_EQ(ErrorCode::NO_ERROR, error);
+  EXPECT_EQ(ArenaVector<std::uint8_t>(0x2000, 1), second);
+  EXPECT_EQ((ArenaVector<std::uint32_t>{1, 2}), first);
+}
+
 TEST(DeserializationTest, ErrorType) {
   Payload buffer;
   ErrorType error;
@@ -145,6 +145,7 @@ struct BenchmarkOps {
     Stats,
     WriteVector,
     EchoVector,
+    EchoVectorBatch,
     Quit,
   };
 };
@@ -157,6 +158,12 @@ struct BenchmarkRPC {
   PDX_REMOTE_METHOD(EchoVector, BenchmarkOps::EchoVector,
                     BufferWrapper<std::vector<uint8_t>>(
                         const BufferWrapper<std::vector<uint8_t>> data));
+  // Echoes several buffers in one message, to measure the per message cost
+  // amortized over a batch of calls.
+  PDX_REMOTE_METHOD(EchoVectorBatch, BenchmarkOps::EchoVectorBatch,
+                    std::vector<BufferWrapper<std::vector<uint8_t>>>(
+                        const std::vector<BufferWrapper<std::vector<uint8_t>>>
+                            data));
 };
 
 struct BenchmarkResult {
@@ -174,6 +181,7 @@ struct Options {
   int opcode = BenchmarkOps::Read;
   int blocksize = 1;
   int count = 1;
+  int batch = 1;
   int instances = 1;
   int timeout = 1;
   int warmup = 0;
@@ -186,6 +194,7 @@ const char kOptionVerbose[] = "verbose";
 const char kOptionOpcode[] = "op";
 const char kOptionBlocksize[] = "bs";
 const char kOptionCount[] = "count";
+const char kOptionBatch[] = "batch";
 const char kOptionThreads[] = "threads";
 const char kOptionInstances[] = "instances";
 const char kOptionTimeout[] = "timeout";
@@ -200,6 +209,7 @@ static option long_options[] = {
     {kOptionOpcode, required_argument, 0, 0},
     {kOptionBlocksize, required_argument, 0, 0},
     {kOptionCount, required_argument, 0, 0},
+    {kOptionBatch, required_argument, 0, 0},
     {kOptionThreads, required_argument, 0, 0},
     {kOptionInstances, required_argument, 0, 0},
     {kOptionTimeout, required_argument, 0, 0},
@@ -221,6 +231,8 @@ void ParseOpcodeOption(const std::string& argument) {
     ProgramOptions.opcode = BenchmarkOps::WriteVector;
   } else if (argument == "echovec") {
     ProgramOptions.opcode = BenchmarkOps::EchoVector;
+  } else if (argument == "echovecbatch") {
+    ProgramOptions.opcode = BenchmarkOps::EchoVectorBatch;
   } else if (argument == "quit") {
     ProgramOptions.opcode = BenchmarkOps::Quit;
   } else if (argument == "nop") {
@@ -362,6 +374,17 @@ class BenchmarkService : public ServiceBase<BenchmarkService> {
             *this, &BenchmarkService::OnEchoVector, message, kMaxMessageSize);
         return {};
 
+      case BenchmarkOps::EchoVectorBatch:
+        VLOG(1) << "BenchmarkService::HandleMessage: op=echovecbatch "
+                   "send_length="
+                << message.GetSendLength()
+                << " receive_length=" << message.GetReceiveLength();
+
+        DispatchRemoteMethod<BenchmarkRPC::EchoVectorBatch>(
+            *this, &BenchmarkService::OnEchoVectorBatch, message,
+            kMaxMessageSize);
+        return {};
+
       case BenchmarkOps::Quit:
         Cancel();
         return ErrorStatus{ESHUTDOWN};
@@ -397,6 +420,10 @@ class BenchmarkService : public ServiceBase<BenchmarkService> {
   BufferType OnEchoVector(Message&, BufferType&& data) {
     return std::move(data);
   }
+  std::vector<BufferType> OnEchoVectorBatch(Message&,
+                                            std::vector<BufferType>&& data) {
+    return std::move(data);
+  }
 
   BenchmarkService(const BenchmarkService&) = delete;
   void operator=(const BenchmarkService&) = delete;
@@ -483,6 +510,18 @@ class BenchmarkClient : public ClientBase<BenchmarkClient> {
     return status ? 0 : -status.error();
   }
 
+  template <typename T, typename U>
+  int EchoVectorBatch(const std::vector<BufferWrapper<T>>& data,
+                      std::vector<BufferWrapper<U>>* data_out) {
+    ATRACE_NAME("BenchmarkClient::EchoVectorBatch");
+    VLOG(1) << "BenchmarkClient::EchoVectorBatch";
+
+    MessageBuffer<ReplyBuffer>::Reserve(kMaxMessageSize - 1);
+    auto status = InvokeRemoteMethodInPlace<BenchmarkRPC::EchoVectorBatch>(
+        data_out, data);
+    return status ? 0 : -status.error();
+  }
+
   int Quit() {
     VLOG(1) << "BenchmarkClient::Quit";
     Transaction transaction{*this};
@@ -772,6 +811,27 @@ int ClientCommand(const std::string& path) {
                   break;
                 }
 
+                case BenchmarkOps::EchoVectorBatch: {
+                  thread_local std::vector<BufferWrapper<std::vector<
+                      uint8_t, DefaultInitializationAllocator<uint8_t>>>>
+                      response_buffers;
+                  const std::vector<BufferWrapper<uint8_t*>> request_buffers(
+                      ProgramOptions.batch,
+                      WrapBuffer(send_buffer.data(), ProgramOptions.blocksize));
+                  const int ret =
+                      client->EchoVectorBatch(request_buffers, &response_buffers);
+                  if (ret < 0) {
+                    std::cerr << "Failed to echo vector batch: "
+                              << strerror(-ret) << std::endl;
+                    return ret;
+                  } else {
+                    VLOG(1) << "Success";
+                    for (const auto& response_buffer : response_buffers)
+                      bytes_sent += send_buffer.size() + response_buffer.size();
+                  }
+                  break;
+                }
+
                 case BenchmarkOps::Quit: {
                   const int ret = client->Quit();
                   if (ret < 0 && ret != -ESHUTDOWN) {
@@ -994,6 +1054,7 @@ int Usage(const std::string& command_name) {
   std::cout << "\t--op <read | write | echo>  : Sepcify client operation mode." << std::endl;
   std::cout << "\t--bs <block size bytes>     : Sepcify block size to use." << std::endl;
   std::cout << "\t--count <count>             : Sepcify number of transactions to make." << std::endl;
+  std::cout << "\t--batch <count>             : Specify number of calls per echovecbatch transaction." << std::endl;
   std::cout << "\t--instances <count>         : Specify number of service instances." << std::endl;
   std::cout << "\t--threads <count>           : Sepcify number of threads per instance." << std::endl;
   std::cout << "\t--timeout <timeout ms | -1> : Timeout to wait for services." << std::endl;
@@ -1043,6 +1104,13 @@ int main(int argc, char** argv) {
                       << std::endl;
             return -EINVAL;
           }
+        } else if (option == kOptionBatch) {
+          ProgramOptions.batch = std::stoi(optarg);
+          if (ProgramOptions.batch < 1) {
+            std::cerr << "Invalid batch argument: " << ProgramOptions.batch
+                      << std::endl;
+            return -EINVAL;
+          }
         } else if (option == kOptionThreads) {
           ProgramOptions.threads = std::stoi(optarg);
           if (ProgramOptions.threads < 1) {
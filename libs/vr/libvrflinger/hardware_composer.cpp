@@ -466,6 +466,7 @@ std::string HardwareComposer::Dump() {
 
   stream << "Post thread resumed: " << post_thread_resumed_ << std::endl;
   stream << "Active layers:       " << layers_.size() << std::endl;
+  stream << frame_timing_.Dump();
   stream << std::endl;
 
   for (size_t i = 0; i < layers_.size(); i++) {
@@ -485,7 +486,7 @@ std::string HardwareComposer::Dump() {
   return stream.str();
 }
 
-void HardwareComposer::PostLayers(hwc2_display_t display) {
+bool HardwareComposer::PostLayers(hwc2_display_t display) {
   ATRACE_NAME("HardwareComposer::PostLayers");
 
   // Setup the hardware composer layers with current buffers.
@@ -518,7 +519,7 @@ void HardwareComposer::PostLayers(hwc2_display_t display) {
     for (auto& layer : layers_) {
       layer.Drop();
     }
-    return;
+    return false;
   } else {
     // Make the transition more obvious in systrace when the frame skip happens
     // above.
@@ -537,14 +538,14 @@ void HardwareComposer::PostLayers(hwc2_display_t display) {
   if (error != HWC::Error::None) {
     ALOGE("HardwareComposer::PostLayers: Validate failed: %s display=%" PRIu64,
           error.to_string().c_str(), display);
-    return;
+    return false;
   }
 
   error = Present(display);
   if (error != HWC::Error::None) {
     ALOGE("HardwareComposer::PostLayers: Present failed: %s",
           error.to_string().c_str());
-    return;
+    return false;
   }
 
   std::vector<Hwc2::Layer> out_layers;
@@ -564,6 +565,8 @@ void HardwareComposer::PostLayers(hwc2_display_t display) {
       }
     }
   }
+
+  return true;
 }
 
 void HardwareComposer::SetDisplaySurfaces(
@@ -825,6 +828,7 @@ void HardwareComposer::PostThread() {
       last_vsync_timestamp_ = GetSystemClockNs();
       vsync_prediction_interval_ = 1;
       retire_fence_fds_.clear();
+      frame_timing_.ResetDurations();
     }
 
     int64_t vsync_timestamp = 0;
@@ -872,18 +876,20 @@ void HardwareComposer::PostThread() {
       vsync_ring_->Publish(vsync);
     }
 
+    const int64_t display_time_est_ns =
+        vsync_timestamp + target_display_->vsync_period_ns;
     {
       // Sleep until shortly before vsync.
       ATRACE_NAME("sleep");
 
-      const int64_t display_time_est_ns =
-          vsync_timestamp + target_display_->vsync_period_ns;
+      const int64_t post_offset_ns = frame_timing_.GetPostOffsetNs(
+          post_thread_config_.frame_post_offset_ns);
       const int64_t now_ns = GetSystemClockNs();
-      const int64_t sleep_time_ns = display_time_est_ns - now_ns -
-                                    post_thread_config_.frame_post_offset_ns;
-      const int64_t wakeup_time_ns =
-          display_time_est_ns - post_thread_config_.frame_post_offset_ns;
+      const int64_t sleep_time_ns =
+          display_time_est_ns - now_ns - post_offset_ns;
+      const int64_t wakeup_time_ns = display_time_est_ns - post_offset_ns;
 
+      ATRACE_INT64("post_offset_ns", post_offset_ns);
       ATRACE_INT64("sleep_time_ns", sleep_time_ns);
       if (sleep_time_ns > 0) {
         int error = SleepUntil(wakeup_time_ns);
@@ -925,7 +931,14 @@ void HardwareComposer::PostThread() {
       }
     }
 
-    PostLayers(target_display_->id);
+    const int64_t post_start_ns = GetSystemClockNs();
+    const int frame_skip_count = frame_skip_count_;
+    if (PostLayers(target_display_->id)) {
+      frame_timing_.OnFramePresented(post_start_ns, GetSystemClockNs(),
+                                     display_time_est_ns);
+    } else if (frame_skip_count_ != frame_skip_count) {
+      frame_timing_.OnFrameDropped();
+    }
   }
 }
 
@@ -1280,6 +1293,83 @@ HardwareComposer::ComposerCallback::GetDisplayInfo(hwc2_display_t display) {
   return nullptr;
 }
 
+int64_t FrameTiming::GetPostOffsetNs(int64_t max_post_offset_ns) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (duration_count_ < kHistorySize) {
+    post_offset_ns_ = max_post_offset_ns;
+  } else {
+    const int64_t longest_duration_ns =
+        *std::max_element(durations_ns_.begin(), durations_ns_.end());
+    post_offset_ns_ = std::min(max_post_offset_ns,
+                               longest_duration_ns + kPostOffsetMarginNs);
+  }
+  return post_offset_ns_;
+}
+
+void FrameTiming::OnFramePresented(int64_t start_ns, int64_t end_ns,
+                                   int64_t target_vsync_ns) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const int64_t duration_ns = end_ns - start_ns;
+  const int64_t slack_ns = target_vsync_ns - end_ns;
+  max_duration_ns_ = std::max(max_duration_ns_, duration_ns);
+
+  size_t bucket = 0;
+  while (bucket < kSlackBucketBoundsMs.size() &&
+         slack_ns >= kSlackBucketBoundsMs[bucket] * 1000000)
+    bucket++;
+  slack_histogram_[bucket]++;
+
+  // Fall back to the configured offset after a late frame until the durations
+  // have been measured again.
+  if (slack_ns < 0) {
+    duration_count_ = 0;
+    next_duration_ = 0;
+    return;
+  }
+
+  durations_ns_[next_duration_] = duration_ns;
+  next_duration_ = (next_duration_ + 1) % kHistorySize;
+  duration_count_ = std::min(duration_count_ + 1, kHistorySize);
+}
+
+void FrameTiming::OnFrameDropped() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  dropped_frames_++;
+  duration_count_ = 0;
+  next_duration_ = 0;
+}
+
+void FrameTiming::ResetDurations() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  duration_count_ = 0;
+  next_duration_ = 0;
+}
+
+std::string FrameTiming::Dump() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::ostringstream stream;
+
+  stream << "Post offset:          " << (post_offset_ns_ / 1000000.0) << " ms"
+         << std::endl;
+  stream << "Max composition time: " << (max_duration_ns_ / 1000000.0)
+         << " ms" << std::endl;
+  stream << "Dropped frames:       " << dropped_frames_ << std::endl;
+  stream << "Presented frames by slack before vsync:" << std::endl;
+  for (size_t i = 0; i < slack_histogram_.size(); i++) {
+    if (i == 0) {
+      stream << "  late:     ";
+    } else if (i < kSlackBucketBoundsMs.size()) {
+      stream << "  " << kSlackBucketBoundsMs[i - 1] << "-"
+             << kSlackBucketBoundsMs[i] << " ms:   ";
+    } else {
+      stream << "  >=" << kSlackBucketBoundsMs[i - 1] << " ms:   ";
+    }
+    stream << slack_histogram_[i] << std::endl;
+  }
+
+  return stream.str();
+}
+
 void Layer::Reset() {
   if (hardware_composer_layer_) {
     HWC::Error error =
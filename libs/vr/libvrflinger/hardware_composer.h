@@ -14,6 +14,7 @@
 #include <memory>
 #include <mutex>
 #include <optional>
+#include <string>
 #include <thread>
 #include <tuple>
 #include <vector>
@@ -291,6 +292,54 @@ class Layer {
   void operator=(const Layer&) = delete;
 };
 
+// FrameTiming tracks how long the post thread takes to compose frames and how
+// early or late they are presented relative to their target vsync. The post
+// offset, which is how long before vsync the post thread wakes up, follows the
+// longest recent composition so that frames are latched as late as possible.
+// Written by the post thread and read by the dispatch thread.
+class FrameTiming {
+ public:
+  // Number of recent compositions the post offset is derived from.
+  static constexpr size_t kHistorySize = 32;
+  // Headroom added to the longest recent composition duration.
+  static constexpr int64_t kPostOffsetMarginNs = 1000000;
+  // Upper bounds of the slack histogram buckets, in milliseconds before vsync.
+  // Frames presented after vsync fall into the first bucket, frames with more
+  // slack than the last bound into an extra bucket.
+  static constexpr std::array<int64_t, 5> kSlackBucketBoundsMs = {0, 1, 2, 4,
+                                                                  8};
+
+  // Returns the post offset to use for the next frame, which is never larger
+  // than |max_post_offset_ns|. Until enough frames have been measured, or after
+  // a frame missed its vsync, this is |max_post_offset_ns|.
+  int64_t GetPostOffsetNs(int64_t max_post_offset_ns);
+
+  // Records a frame composed from |start_ns| and presented at |end_ns|, for
+  // display at |target_vsync_ns|.
+  void OnFramePresented(int64_t start_ns, int64_t end_ns,
+                        int64_t target_vsync_ns);
+  // Records a frame dropped to let HWC catch up.
+  void OnFrameDropped();
+
+  // Forgets the measured durations, e.g. when the target display changes. The
+  // histogram is kept.
+  void ResetDurations();
+
+  std::string Dump() const;
+
+ private:
+  mutable std::mutex mutex_;
+
+  std::array<int64_t, kHistorySize> durations_ns_{};
+  size_t duration_count_ = 0;
+  size_t next_duration_ = 0;
+
+  std::array<uint64_t, kSlackBucketBoundsMs.size() + 1> slack_histogram_{};
+  uint64_t dropped_frames_ = 0;
+  int64_t max_duration_ns_ = 0;
+  int64_t post_offset_ns_ = 0;
+};
+
 // HardwareComposer encapsulates the hardware composer HAL, exposing a
 // simplified API to post buffers to the display.
 //
@@ -416,7 +465,8 @@ class HardwareComposer {
   HWC::Error Validate(hwc2_display_t display);
   HWC::Error Present(hwc2_display_t display);
 
-  void PostLayers(hwc2_display_t display);
+  // Returns true if a frame was presented, false if it was dropped or failed.
+  bool PostLayers(hwc2_display_t display);
   void PostThread();
 
   // The post thread has two controlling states:
@@ -543,6 +593,10 @@ class HardwareComposer {
   // Counter tracking the number of skipped frames.
   int frame_skip_count_ = 0;
 
+  // Composition durations and frame lateness, used to place the post thread
+  // wakeup and reported by Dump().
+  FrameTiming frame_timing_;
+
   // Fd array for tracking retire fences that are returned by hwc. This allows
   // us to detect when the display driver begins queuing frames.
   std::vector<pdx::LocalHandle> retire_fence_fds_;
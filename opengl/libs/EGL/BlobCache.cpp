@@ -20,10 +20,10 @@
 
 #include <errno.h>
 #include <inttypes.h>
+#include <string.h>
 
 #include <android-base/properties.h>
 #include <log/log.h>
-#include <chrono>
 
 namespace android {
 
@@ -40,16 +40,10 @@ BlobCache::BlobCache(size_t maxKeySize, size_t maxValueSize, size_t maxTotalSize
         mMaxTotalSize(maxTotalSize),
         mMaxKeySize(maxKeySize),
         mMaxValueSize(maxValueSize),
-        mTotalSize(0) {
-    int64_t now = std::chrono::steady_clock::now().time_since_epoch().count();
-#ifdef _WIN32
-    srand(now);
-#else
-    mRandState[0] = (now >> 0) & 0xFFFF;
-    mRandState[1] = (now >> 16) & 0xFFFF;
-    mRandState[2] = (now >> 32) & 0xFFFF;
-#endif
-    ALOGV("initializing random seed using %lld", (unsigned long long)now);
+        mTotalSize(0),
+        mHits(0),
+        mMisses(0),
+        mEvictions(0) {
 }
 
 void BlobCache::set(const void* key, size_t keySize, const void* value,
@@ -78,55 +72,43 @@ void BlobCache::set(const void* key, size_t keySize, const void* value,
         return;
     }
 
-    std::shared_ptr<Blob> cacheKey(new Blob(key, keySize, false));
-    CacheEntry cacheEntry(cacheKey, nullptr);
+    std::string_view cacheKey(static_cast<const char*>(key), keySize);
 
     while (true) {
-        auto index = std::lower_bound(mCacheEntries.begin(), mCacheEntries.end(), cacheEntry);
-        if (index == mCacheEntries.end() || cacheEntry < *index) {
-            // Create a new cache entry.
-            std::shared_ptr<Blob> keyBlob(new Blob(key, keySize, true));
-            std::shared_ptr<Blob> valueBlob(new Blob(value, valueSize, true));
-            size_t newTotalSize = mTotalSize + keySize + valueSize;
-            if (mMaxTotalSize < newTotalSize) {
-                if (isCleanable()) {
-                    // Clean the cache and try again.
-                    clean();
-                    continue;
-                } else {
-                    ALOGV("set: not caching new key/value pair because the "
-                            "total cache size limit would be exceeded: %zu "
-                            "(limit: %zu)",
-                            keySize + valueSize, mMaxTotalSize);
-                    break;
-                }
-            }
-            mCacheEntries.insert(index, CacheEntry(keyBlob, valueBlob));
-            mTotalSize = newTotalSize;
-            ALOGV("set: created new cache entry with %zu byte key and %zu byte value",
-                    keySize, valueSize);
-        } else {
-            // Update the existing cache entry.
-            std::shared_ptr<Blob> valueBlob(new Blob(value, valueSize, true));
-            std::shared_ptr<Blob> oldValueBlob(index->getValue());
-            size_t newTotalSize = mTotalSize + valueSize - oldValueBlob->getSize();
-            if (mMaxTotalSize < newTotalSize) {
-                if (isCleanable()) {
-                    // Clean the cache and try again.
-                    clean();
-                    continue;
-                } else {
-                    ALOGV("set: not caching new value because the total cache "
-                            "size limit would be exceeded: %zu (limit: %zu)",
-                            keySize + valueSize, mMaxTotalSize);
-                    break;
-                }
+        auto index = mCacheIndex.find(cacheKey);
+        size_t oldEntrySize = 0;
+        if (index != mCacheIndex.end()) {
+            oldEntrySize = keySize + index->second->getValueSize();
+        }
+        size_t newTotalSize = mTotalSize - oldEntrySize + keySize + valueSize;
+        if (mMaxTotalSize < newTotalSize) {
+            if (isCleanable()) {
+                // Clean the cache and try again.
+                clean();
+                continue;
+            } else {
+                ALOGV("set: not caching new key/value pair because the "
+                        "total cache size limit would be exceeded: %zu "
+                        "(limit: %zu)",
+                        keySize + valueSize, mMaxTotalSize);
+                break;
             }
-            index->setValue(valueBlob);
-            mTotalSize = newTotalSize;
+        }
+        if (index != mCacheIndex.end()) {
+            // Replace the existing cache entry, whose key would point to the
+            // old value's allocation.
+            auto entry = index->second;
+            mCacheIndex.erase(index);
+            mCacheEntries.erase(entry);
             ALOGV("set: updated existing cache entry with %zu byte key and %zu byte "
                     "value", keySize, valueSize);
+        } else {
+            ALOGV("set: created new cache entry with %zu byte key and %zu byte value",
+                    keySize, valueSize);
         }
+        mCacheEntries.emplace_front(key, keySize, value, valueSize);
+        mCacheIndex.emplace(mCacheEntries.front().getKey(), mCacheEntries.begin());
+        mTotalSize = newTotalSize;
         break;
     }
 }
@@ -136,23 +118,25 @@ size_t BlobCache::get(const void* key, size_t keySize, void* value,
     if (mMaxKeySize < keySize) {
         ALOGV("get: not searching because the key is too large: %zu (limit %zu)",
                 keySize, mMaxKeySize);
+        mMisses++;
         return 0;
     }
-    std::shared_ptr<Blob> cacheKey(new Blob(key, keySize, false));
-    CacheEntry cacheEntry(cacheKey, nullptr);
-    auto index = std::lower_bound(mCacheEntries.begin(), mCacheEntries.end(), cacheEntry);
-    if (index == mCacheEntries.end() || cacheEntry < *index) {
+    auto index = mCacheIndex.find(std::string_view(static_cast<const char*>(key), keySize));
+    if (index == mCacheIndex.end()) {
         ALOGV("get: no cache entry found for key of size %zu", keySize);
+        mMisses++;
         return 0;
     }
+    mHits++;
 
-    // The key was found. Return the value if the caller's buffer is large
-    // enough.
-    std::shared_ptr<Blob> valueBlob(index->getValue());
-    size_t valueBlobSize = valueBlob->getSize();
+    // The key was found. Make it the most recently used entry, and return the
+    // value if the caller's buffer is large enough.
+    mCacheEntries.splice(mCacheEntries.begin(), mCacheEntries, index->second);
+    const CacheEntry& entry = *index->second;
+    size_t valueBlobSize = entry.getValueSize();
     if (valueBlobSize <= valueSize) {
         ALOGV("get: copying %zu bytes to caller's buffer", valueBlobSize);
-        memcpy(value, valueBlob->getData(), valueBlobSize);
+        memcpy(value, entry.getValue(), valueBlobSize);
     } else {
         ALOGV("get: caller's buffer is too small for value: %zu (needs %zu)",
                 valueSize, valueBlobSize);
@@ -160,6 +144,28 @@ size_t BlobCache::get(const void* key, size_t keySize, void* value,
     return valueBlobSize;
 }
 
+bool BlobCache::contains(const void* key, size_t keySize) const {
+    return mCacheIndex.count(std::string_view(static_cast<const char*>(key), keySize)) > 0;
+}
+
+void BlobCache::remove(const void* key, size_t keySize) {
+    auto index = mCacheIndex.find(std::string_view(static_cast<const char*>(key), keySize));
+    if (index != mCacheIndex.end()) {
+        auto entry = index->second;
+        mTotalSize -= entry->getKey().size() + entry->getValueSize();
+        mCacheIndex.erase(index);
+        mCacheEntries.erase(entry);
+    }
+}
+
+void BlobCache::forEachEntry(const std::function<void(const void* key, size_t keySize,
+        const void* value, size_t valueSize)>& func) const {
+    for (auto it = mCacheEntries.rbegin(); it != mCacheEntries.rend(); ++it) {
+        std::string_view key = it->getKey();
+        func(key.data(), key.size(), it->getValue(), it->getValueSize());
+    }
+}
+
 static inline size_t align4(size_t size) {
     return (size + 3) & ~3;
 }
@@ -168,9 +174,7 @@ size_t BlobCache::getFlattenedSize() const {
     auto buildId = base::GetProperty("ro.build.id", "");
     size_t size = align4(sizeof(Header) + buildId.size());
     for (const CacheEntry& e :  mCacheEntries) {
-        std::shared_ptr<Blob> const& keyBlob = e.getKey();
-        std::shared_ptr<Blob> const& valueBlob = e.getValue();
-        size += align4(sizeof(EntryHeader) + keyBlob->getSize() + valueBlob->getSize());
+        size += align4(sizeof(EntryHeader) + e.getKey().size() + e.getValueSize());
     }
     return size;
 }
@@ -190,14 +194,14 @@ int BlobCache::flatten(void* buffer, size_t size) const {
     header->mBuildIdLength = buildId.size();
     memcpy(header->mBuildId, buildId.c_str(), header->mBuildIdLength);
 
-    // Write cache entries
+    // Write cache entries, from the least recently used to the most recently
+    // used, so that unflatten restores the same eviction order.
     uint8_t* byteBuffer = reinterpret_cast<uint8_t*>(buffer);
     off_t byteOffset = align4(sizeof(Header) + header->mBuildIdLength);
-    for (const CacheEntry& e :  mCacheEntries) {
-        std::shared_ptr<Blob> const& keyBlob = e.getKey();
-        std::shared_ptr<Blob> const& valueBlob = e.getValue();
-        size_t keySize = keyBlob->getSize();
-        size_t valueSize = valueBlob->getSize();
+    for (auto it = mCacheEntries.rbegin(); it != mCacheEntries.rend(); ++it) {
+        const CacheEntry& e = *it;
+        size_t keySize = e.getKey().size();
+        size_t valueSize = e.getValueSize();
 
         size_t entrySize = sizeof(EntryHeader) + keySize + valueSize;
         size_t totalSize = align4(entrySize);
@@ -210,8 +214,8 @@ int BlobCache::flatten(void* buffer, size_t size) const {
         eheader->mKeySize = keySize;
         eheader->mValueSize = valueSize;
 
-        memcpy(eheader->mData, keyBlob->getData(), keySize);
-        memcpy(eheader->mData + keySize, valueBlob->getData(), valueSize);
+        memcpy(eheader->mData, e.getKey().data(), keySize);
+        memcpy(eheader->mData + keySize, e.getValue(), valueSize);
 
         if (totalSize > entrySize) {
             // We have padding bytes. Those will get written to storage, and contribute to the CRC,
@@ -227,7 +231,7 @@ int BlobCache::flatten(void* buffer, size_t size) const {
 
 int BlobCache::unflatten(void const* buffer, size_t size) {
     // All errors should result in the BlobCache being in an empty state.
-    mCacheEntries.clear();
+    clear();
 
     // Read the cache header
     if (size < sizeof(Header)) {
@@ -254,7 +258,7 @@ int BlobCache::unflatten(void const* buffer, size_t size) {
     size_t numEntries = header->mNumEntries;
     for (size_t i = 0; i < numEntries; i++) {
         if (byteOffset + sizeof(EntryHeader) > size) {
-            mCacheEntries.clear();
+            clear();
             ALOGE("unflatten: not enough room for cache entry headers");
             return -EINVAL;
         }
@@ -267,7 +271,7 @@ int BlobCache::unflatten(void const* buffer, size_t size) {
 
         size_t totalSize = align4(entrySize);
         if (byteOffset + totalSize > size) {
-            mCacheEntries.clear();
+            clear();
             ALOGE("unflatten: not enough room for cache entry headers");
             return -EINVAL;
         }
@@ -281,22 +285,15 @@ int BlobCache::unflatten(void const* buffer, size_t size) {
     return 0;
 }
 
-long int BlobCache::blob_random() {
-#ifdef _WIN32
-    return rand();
-#else
-    return nrand48(mRandState);
-#endif
-}
-
 void BlobCache::clean() {
-    // Remove a random cache entry until the total cache size gets below half
-    // the maximum total cache size.
+    // Remove the least recently used cache entry until the total cache size
+    // gets below half the maximum total cache size.
     while (mTotalSize > mMaxTotalSize / 2) {
-        size_t i = size_t(blob_random() % (mCacheEntries.size()));
-        const CacheEntry& entry(mCacheEntries[i]);
-        mTotalSize -= entry.getKey()->getSize() + entry.getValue()->getSize();
-        mCacheEntries.erase(mCacheEntries.begin() + i);
+        const CacheEntry& entry(mCacheEntries.back());
+        mTotalSize -= entry.getKey().size() + entry.getValueSize();
+        mCacheIndex.erase(entry.getKey());
+        mCacheEntries.pop_back();
+        mEvictions++;
     }
 }
 
@@ -304,71 +301,25 @@ bool BlobCache::isCleanable() const {
     return mTotalSize > mMaxTotalSize / 2;
 }
 
-BlobCache::Blob::Blob(const void* data, size_t size, bool copyData) :
-        mData(copyData ? malloc(size) : data),
-        mSize(size),
-        mOwnsData(copyData) {
-    if (data != nullptr && copyData) {
-        memcpy(const_cast<void*>(mData), data, size);
-    }
-}
-
-BlobCache::Blob::~Blob() {
-    if (mOwnsData) {
-        free(const_cast<void*>(mData));
-    }
-}
-
-bool BlobCache::Blob::operator<(const Blob& rhs) const {
-    if (mSize == rhs.mSize) {
-        return memcmp(mData, rhs.mData, mSize) < 0;
-    } else {
-        return mSize < rhs.mSize;
-    }
-}
-
-const void* BlobCache::Blob::getData() const {
-    return mData;
-}
-
-size_t BlobCache::Blob::getSize() const {
-    return mSize;
-}
-
-BlobCache::CacheEntry::CacheEntry() {
-}
-
-BlobCache::CacheEntry::CacheEntry(
-        const std::shared_ptr<Blob>& key, const std::shared_ptr<Blob>& value):
-        mKey(key),
-        mValue(value) {
-}
-
-BlobCache::CacheEntry::CacheEntry(const CacheEntry& ce):
-        mKey(ce.mKey),
-        mValue(ce.mValue) {
-}
-
-bool BlobCache::CacheEntry::operator<(const CacheEntry& rhs) const {
-    return *mKey < *rhs.mKey;
-}
-
-const BlobCache::CacheEntry& BlobCache::CacheEntry::operator=(const CacheEntry& rhs) {
-    mKey = rhs.mKey;
-    mValue = rhs.mValue;
-    return *this;
+BlobCache::CacheEntry::CacheEntry(const void* key, size_t keySize, const void* value,
+        size_t valueSize):
+        mData(new uint8_t[keySize + valueSize]),
+        mKeySize(keySize),
+        mValueSize(valueSize) {
+    memcpy(mData.get(), key, keySize);
+    memcpy(mData.get() + keySize, value, valueSize);
 }
 
-std::shared_ptr<BlobCache::Blob> BlobCache::CacheEntry::getKey() const {
-    return mKey;
+std::string_view BlobCache::CacheEntry::getKey() const {
+    return std::string_view(reinterpret_cast<const char*>(mData.get()), mKeySize);
 }
 
-std::shared_ptr<BlobCache::Blob> BlobCache::CacheEntry::getValue() const {
-    return mValue;
+const void* BlobCache::CacheEntry::getValue() const {
+    return mData.get() + mKeySize;
 }
 
-void BlobCache::CacheEntry::setValue(const std::shared_ptr<Blob>& value) {
-    mValue = value;
+size_t BlobCache::CacheEntry::getValueSize() const {
+    return mValueSize;
 }
 
 } // namespace android
@@ -18,9 +18,13 @@
 #define ANDROID_BLOB_CACHE_H
 
 #include <stddef.h>
+#include <stdint.h>
 
+#include <functional>
+#include <list>
 #include <memory>
-#include <vector>
+#include <string_view>
+#include <unordered_map>
 
 namespace android {
 
@@ -39,6 +43,8 @@ public:
     // (key sizes plus value sizes) will not exceed maxTotalSize.
     BlobCache(size_t maxKeySize, size_t maxValueSize, size_t maxTotalSize);
 
+    virtual ~BlobCache() {}
+
     // set inserts a new binary value into the cache and associates it with the
     // given binary key.  If the key or value are too large for the cache then
     // the cache remains unchanged.  This includes the case where a different
@@ -54,7 +60,7 @@ public:
     //   0 < keySize
     //   value != NULL
     //   0 < valueSize
-    void set(const void* key, size_t keySize, const void* value,
+    virtual void set(const void* key, size_t keySize, const void* value,
             size_t valueSize);
 
     // get retrieves from the cache the binary value associated with a given
@@ -73,7 +79,7 @@ public:
     //   key != NULL
     //   0 < keySize
     //   0 <= valueSize
-    size_t get(const void* key, size_t keySize, void* value, size_t valueSize);
+    virtual size_t get(const void* key, size_t keySize, void* value, size_t valueSize);
 
 
     // getFlattenedSize returns the number of bytes needed to store the entire
@@ -99,7 +105,27 @@ public:
 
     // clear flushes out all contents of the cache then the BlobCache, leaving
     // it in an empty state.
-    void clear() { mCacheEntries.clear(); }
+    void clear() {
+        mCacheIndex.clear();
+        mCacheEntries.clear();
+        mTotalSize = 0;
+    }
+
+    // Statistics counts the lookups and evictions done since the BlobCache was
+    // created.
+    struct Statistics {
+        // hits is the number of calls to get that found their key.
+        size_t hits;
+
+        // misses is the number of calls to get that didn't find their key.
+        size_t misses;
+
+        // evictions is the number of entries evicted to make room for others.
+        size_t evictions;
+    };
+
+    // getStatistics returns the lookup and eviction counts of the cache.
+    Statistics getStatistics() const { return {mHits, mMisses, mEvictions}; }
 
 protected:
     // mMaxTotalSize is the maximum size that all cache entries can occupy. This
@@ -109,15 +135,24 @@ protected:
     // will be evicted from the cache to make room for the new entry.
     const size_t mMaxTotalSize;
 
+    // contains returns true if the given key is in the cache. Unlike get, it
+    // doesn't count as a use of the entry.
+    bool contains(const void* key, size_t keySize) const;
+
+    // remove evicts the entry of the given key from the cache, if any.
+    void remove(const void* key, size_t keySize);
+
+    // forEachEntry calls func with the key and value of each entry of the
+    // cache, from the least recently used to the most recently used.
+    void forEachEntry(const std::function<void(const void* key, size_t keySize,
+            const void* value, size_t valueSize)>& func) const;
+
 private:
     // Copying is disallowed.
     BlobCache(const BlobCache&);
     void operator=(const BlobCache&);
 
-    // A random function helper to get around MinGW not having nrand48()
-    long int blob_random();
-
-    // clean evicts a randomly chosen set of entries from the cache such that
+    // clean evicts the least recently used entries from the cache such that
     // the total size of all remaining entries is less than mMaxTotalSize/2.
     void clean();
 
@@ -125,55 +160,25 @@ private:
     // to have some effect, and false otherwise.
     bool isCleanable() const;
 
-    // A Blob is an immutable sized unstructured data blob.
-    class Blob {
-    public:
-        Blob(const void* data, size_t size, bool copyData);
-        ~Blob();
-
-        bool operator<(const Blob& rhs) const;
-
-        const void* getData() const;
-        size_t getSize() const;
-
-    private:
-        // Copying is not allowed.
-        Blob(const Blob&);
-        void operator=(const Blob&);
-
-        // mData points to the buffer containing the blob data.
-        const void* mData;
-
-        // mSize is the size of the blob data in bytes.
-        size_t mSize;
-
-        // mOwnsData indicates whether or not this Blob object should free the
-        // memory pointed to by mData when the Blob gets destructed.
-        bool mOwnsData;
-    };
-
-    // A CacheEntry is a single key/value pair in the cache.
+    // A CacheEntry is a single key/value pair in the cache. The key and the
+    // value are stored one after the other in a single allocation.
     class CacheEntry {
     public:
-        CacheEntry();
-        CacheEntry(const std::shared_ptr<Blob>& key, const std::shared_ptr<Blob>& value);
-        CacheEntry(const CacheEntry& ce);
+        CacheEntry(const void* key, size_t keySize, const void* value, size_t valueSize);
 
-        bool operator<(const CacheEntry& rhs) const;
-        const CacheEntry& operator=(const CacheEntry&);
-
-        std::shared_ptr<Blob> getKey() const;
-        std::shared_ptr<Blob> getValue() const;
-
-        void setValue(const std::shared_ptr<Blob>& value);
+        std::string_view getKey() const;
+        const void* getValue() const;
+        size_t getValueSize() const;
 
     private:
+        // mData points to the key data followed by the value data.
+        std::unique_ptr<uint8_t[]> mData;
 
-        // mKey is the key that identifies the cache entry.
-        std::shared_ptr<Blob> mKey;
+        // mKeySize is the size of the key in bytes.
+        size_t mKeySize;
 
-        // mValue is the cached data associated with the key.
-        std::shared_ptr<Blob> mValue;
+        // mValueSize is the size of the value in bytes.
+        size_t mValueSize;
     };
 
     // A Header is the header for the entire BlobCache serialization format. No
@@ -236,13 +241,19 @@ private:
     // the cache.
     size_t mTotalSize;
 
-    // mRandState is the pseudo-random number generator state. It is passed to
-    // nrand48 to generate random numbers when needed.
-    unsigned short mRandState[3];
+    // mCacheEntries stores all the cache entries that are resident in memory,
+    // from the most recently used to the least recently used. Cache entries are
+    // added to it by the 'set' method, and moved to its front by 'get'.
+    std::list<CacheEntry> mCacheEntries;
+
+    // mCacheIndex maps the key of each entry of mCacheEntries to the entry. The
+    // keys point to the data of the entries.
+    std::unordered_map<std::string_view, std::list<CacheEntry>::iterator> mCacheIndex;
 
-    // mCacheEntries stores all the cache entries that are resident in memory.
-    // Cache entries are added to it by the 'set' method.
-    std::vector<CacheEntry> mCacheEntries;
+    // mHits, mMisses and mEvictions are the counts returned by getStatistics.
+    size_t mHits;
+    size_t mMisses;
+    size_t mEvictions;
 };
 
 }
@@ -267,6 +267,48 @@ TEST_F(BlobCacheTest, ExceedingTotalLimitHalvesCacheSize) {
     ASSERT_EQ(maxEntries/2 + 1, numCached);
 }
 
+TEST_F(BlobCacheTest, ExceedingTotalLimitEvictsLeastRecentlyUsed) {
+    // Fill up the entire cache with 1 char key/value pairs.
+    const int maxEntries = MAX_TOTAL_SIZE / 2;
+    for (int i = 0; i < maxEntries; i++) {
+        uint8_t k = i;
+        mBC->set(&k, 1, "x", 1);
+    }
+    // Use the first entry, making the second one the least recently used.
+    {
+        uint8_t k = 0;
+        ASSERT_EQ(size_t(1), mBC->get(&k, 1, nullptr, 0));
+    }
+    // Insert one more entry, causing a cache overflow.
+    {
+        uint8_t k = maxEntries;
+        mBC->set(&k, 1, "x", 1);
+    }
+    uint8_t k = 0;
+    ASSERT_EQ(size_t(1), mBC->get(&k, 1, nullptr, 0));
+    k = 1;
+    ASSERT_EQ(size_t(0), mBC->get(&k, 1, nullptr, 0));
+    k = maxEntries;
+    ASSERT_EQ(size_t(1), mBC->get(&k, 1, nullptr, 0));
+}
+
+TEST_F(BlobCacheTest, StatisticsCountHitsMissesAndEvictions) {
+    const int maxEntries = MAX_TOTAL_SIZE / 2;
+    for (int i = 0; i < maxEntries + 1; i++) {
+        uint8_t k = i;
+        mBC->set(&k, 1, "x", 1);
+    }
+    uint8_t k = maxEntries;
+    ASSERT_EQ(size_t(1), mBC->get(&k, 1, nullptr, 0));
+    k = 0;
+    ASSERT_EQ(size_t(0), mBC->get(&k, 1, nullptr, 0));
+
+    BlobCache::Statistics stats = mBC->getStatistics();
+    ASSERT_EQ(size_t(1), stats.hits);
+    ASSERT_EQ(size_t(1), stats.misses);
+    ASSERT_EQ(size_t(maxEntries - maxEntries / 2), stats.evictions);
+}
+
 class BlobCacheFlattenTest : public BlobCacheTest {
 protected:
     virtual void SetUp() {
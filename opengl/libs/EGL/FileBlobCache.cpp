@@ -14,26 +14,37 @@
  ** limitations under the License.
  */
 
+#define ATRACE_TAG ATRACE_TAG_GRAPHICS
+
 #include "FileBlobCache.h"
 
 #include <errno.h>
 #include <fcntl.h>
 #include <inttypes.h>
+#include <string.h>
+#include <sys/file.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <algorithm>
+
+#include <android-base/properties.h>
 #include <log/log.h>
 
+#include "egl_trace.h"
+
 // Cache file header
-static const char* cacheFileMagic = "EGL$";
-static const size_t cacheFileHeaderSize = 8;
+static const char* cacheFileMagic = "EGL#";
+static const uint32_t cacheFileVersion = 1;
+
+// Cache file trailer
+static const char* cacheFileIndexMagic = "EGLi";
 
 namespace android {
 
-static uint32_t crc32c(const uint8_t* buf, size_t len) {
+static uint32_t crc32c(const uint8_t* buf, size_t len, uint32_t r = 0) {
     const uint32_t polyBits = 0x82F63B78;
-    uint32_t r = 0;
     for (size_t i = 0; i < len; i++) {
         r ^= buf[i];
         for (int j = 0; j < 8; j++) {
@@ -47,141 +58,496 @@ static uint32_t crc32c(const uint8_t* buf, size_t len) {
     return r;
 }
 
+// hashKey returns the FNV-1a hash of a key, which the index of the cache file
+// stores so that looking a key up doesn't read the keys of other entries.
+static uint32_t hashKey(const void* key, size_t keySize) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(key);
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < keySize; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static inline size_t align4(size_t size) {
+    return (size + 3) & ~3;
+}
+
 FileBlobCache::FileBlobCache(size_t maxKeySize, size_t maxValueSize, size_t maxTotalSize,
         const std::string& filename)
         : BlobCache(maxKeySize, maxValueSize, maxTotalSize)
-        , mFilename(filename) {
+        , mFilename(filename)
+        , mFileTotalSize(0) {
     if (mFilename.length() > 0) {
-        size_t headerSize = cacheFileHeaderSize;
+        loadFile();
+    }
+}
 
-        int fd = open(mFilename.c_str(), O_RDONLY, 0);
-        if (fd == -1) {
-            if (errno != ENOENT) {
-                ALOGE("error opening cache file %s: %s (%d)", mFilename.c_str(),
-                        strerror(errno), errno);
-            }
-            return;
-        }
+FileBlobCache::~FileBlobCache() {
+}
 
-        struct stat statBuf;
-        if (fstat(fd, &statBuf) == -1) {
-            ALOGE("error stat'ing cache file: %s (%d)", strerror(errno), errno);
-            close(fd);
-            return;
-        }
+FileBlobCache::FileMapping::~FileMapping() {
+    munmap(data, size);
+}
 
-        // Check the size before trying to mmap it.
-        size_t fileSize = statBuf.st_size;
-        if (fileSize > mMaxTotalSize * 2) {
-            ALOGE("cache file is too large: %#" PRIx64,
-                  static_cast<off64_t>(statBuf.st_size));
-            close(fd);
-            return;
+std::unique_ptr<FileBlobCache::FileMapping> FileBlobCache::mapFile(const std::string& filename,
+        size_t maxTotalSize) {
+    ATRACE_CALL();
+    int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC, 0);
+    if (fd == -1) {
+        if (errno != ENOENT) {
+            ALOGE("error opening cache file %s: %s (%d)", filename.c_str(),
+                    strerror(errno), errno);
         }
+        return nullptr;
+    }
 
-        uint8_t* buf = reinterpret_cast<uint8_t*>(mmap(nullptr, fileSize,
-                PROT_READ, MAP_PRIVATE, fd, 0));
-        if (buf == MAP_FAILED) {
-            ALOGE("error mmaping cache file: %s (%d)", strerror(errno),
-                    errno);
-            close(fd);
-            return;
+    struct stat statBuf;
+    if (fstat(fd, &statBuf) == -1) {
+        ALOGE("error stat'ing cache file: %s (%d)", strerror(errno), errno);
+        close(fd);
+        return nullptr;
+    }
+
+    // Check the size before trying to mmap it.
+    size_t fileSize = statBuf.st_size;
+    if (fileSize > maxTotalSize * 2) {
+        ALOGE("cache file is too large: %#" PRIx64,
+              static_cast<off64_t>(statBuf.st_size));
+        close(fd);
+        return nullptr;
+    }
+    if (fileSize < sizeof(FileHeader) + sizeof(FileTrailer) || fileSize % 4 != 0) {
+        ALOGE_IF(fileSize > 0, "cache file has a bad size: %zu", fileSize);
+        close(fd);
+        return nullptr;
+    }
+
+    uint8_t* buf = reinterpret_cast<uint8_t*>(mmap(nullptr, fileSize,
+            PROT_READ, MAP_PRIVATE, fd, 0));
+    close(fd);
+    if (buf == MAP_FAILED) {
+        ALOGE("error mmaping cache file: %s (%d)", strerror(errno),
+                errno);
+        return nullptr;
+    }
+    // Only the pages of the entries looked up are needed, so don't read ahead.
+    madvise(buf, fileSize, MADV_RANDOM);
+    std::unique_ptr<FileMapping> file(new FileMapping{buf, fileSize, {}});
+
+    // Check the file header
+    const FileHeader* header = reinterpret_cast<const FileHeader*>(buf);
+    if (memcmp(header->mMagic, cacheFileMagic, 4) != 0) {
+        ALOGE("cache file has bad mojo");
+        return nullptr;
+    }
+    auto buildId = base::GetProperty("ro.build.id", "");
+    size_t entriesOffset = align4(sizeof(FileHeader) + buildId.size());
+    if (header->mVersion != cacheFileVersion ||
+        header->mBuildIdLength != buildId.size() ||
+        entriesOffset + sizeof(FileTrailer) > fileSize ||
+        memcmp(header->mBuildId, buildId.c_str(), buildId.size()) != 0) {
+        // We treat version mismatches as an empty cache.
+        return nullptr;
+    }
+
+    // Check the trailer and the index block it locates
+    const FileTrailer* trailer = reinterpret_cast<const FileTrailer*>(
+            buf + fileSize - sizeof(FileTrailer));
+    size_t indexEnd = fileSize - sizeof(FileTrailer);
+    if (memcmp(trailer->mMagic, cacheFileIndexMagic, 4) != 0 ||
+        trailer->mIndexOffset < entriesOffset ||
+        trailer->mIndexOffset > indexEnd ||
+        trailer->mNumEntries != (indexEnd - trailer->mIndexOffset) / sizeof(FileIndexEntry) ||
+        (indexEnd - trailer->mIndexOffset) % sizeof(FileIndexEntry) != 0 ||
+        crc32c(buf + trailer->mIndexOffset, indexEnd - trailer->mIndexOffset) !=
+                trailer->mIndexCrc) {
+        ALOGE("cache file has a bad index");
+        return nullptr;
+    }
+
+    // Read the index
+    const FileIndexEntry* index = reinterpret_cast<const FileIndexEntry*>(
+            buf + trailer->mIndexOffset);
+    file->index.assign(index, index + trailer->mNumEntries);
+    for (const FileIndexEntry& e : file->index) {
+        uint64_t entryEnd = uint64_t(e.mOffset) + sizeof(FileEntryHeader) + e.mKeySize +
+                e.mValueSize;
+        if (e.mOffset < entriesOffset || e.mOffset % 4 != 0 ||
+            entryEnd > trailer->mIndexOffset) {
+            ALOGE("cache file has a bad index entry");
+            return nullptr;
         }
+    }
+    return file;
+}
 
-        // Check the file magic and CRC
-        size_t cacheSize = fileSize - headerSize;
-        if (memcmp(buf, cacheFileMagic, 4) != 0) {
-            ALOGE("cache file has bad mojo");
-            close(fd);
-            return;
+bool FileBlobCache::loadFile() {
+    mFile = mapFile(mFilename, mMaxTotalSize);
+    if (mFile == nullptr) {
+        return false;
+    }
+    for (const FileIndexEntry& e : mFile->index) {
+        mFileIndex.emplace(e.mKeyHash, IndexedEntry{e.mOffset, e.mKeySize, e.mValueSize, false});
+        mFileTotalSize += e.mKeySize + e.mValueSize;
+    }
+    // The file index replaces the copy of the index block.
+    std::vector<FileIndexEntry>().swap(mFile->index);
+    return true;
+}
+
+void FileBlobCache::unloadFile() {
+    mFile.reset();
+    mFileIndex.clear();
+    mFileTotalSize = 0;
+}
+
+FileBlobCache::FileIndex::iterator FileBlobCache::findFileEntry(const void* key,
+        size_t keySize) {
+    auto range = mFileIndex.equal_range(hashKey(key, keySize));
+    for (auto it = range.first; it != range.second; ++it) {
+        const IndexedEntry& entry = it->second;
+        const FileEntryHeader* eheader = reinterpret_cast<const FileEntryHeader*>(
+                mFile->data + entry.offset);
+        if (entry.keySize == keySize && memcmp(eheader->mData, key, keySize) == 0) {
+            return it;
         }
-        uint32_t* crc = reinterpret_cast<uint32_t*>(buf + 4);
-        if (crc32c(buf + headerSize, cacheSize) != *crc) {
-            ALOGE("cache file failed CRC check");
-            close(fd);
-            return;
+    }
+    return mFileIndex.end();
+}
+
+void FileBlobCache::dropFileEntry(FileIndex::iterator entry) {
+    mFileTotalSize -= entry->second.keySize + entry->second.valueSize;
+    mFileIndex.erase(entry);
+}
+
+void FileBlobCache::set(const void* key, size_t keySize, const void* value,
+        size_t valueSize) {
+    BlobCache::set(key, keySize, value, valueSize);
+
+    // The new value is written with the next writeToFile, which leaves out the
+    // old one.
+    if (contains(key, keySize)) {
+        auto entry = findFileEntry(key, keySize);
+        if (entry != mFileIndex.end()) {
+            dropFileEntry(entry);
         }
+    }
+}
 
-        int err = unflatten(buf + headerSize, cacheSize);
-        if (err < 0) {
-            ALOGE("error reading cache contents: %s (%d)", strerror(-err),
-                    -err);
-            munmap(buf, fileSize);
-            close(fd);
-            return;
+size_t FileBlobCache::get(const void* key, size_t keySize, void* value,
+        size_t valueSize) {
+    size_t valueBlobSize = BlobCache::get(key, keySize, value, valueSize);
+    if (valueBlobSize > 0) {
+        return valueBlobSize;
+    }
+
+    auto it = findFileEntry(key, keySize);
+    if (it == mFileIndex.end()) {
+        return 0;
+    }
+    IndexedEntry& entry = it->second;
+    const FileEntryHeader* eheader = reinterpret_cast<const FileEntryHeader*>(
+            mFile->data + entry.offset);
+    if (!entry.verified) {
+        if (eheader->mKeySize != entry.keySize || eheader->mValueSize != entry.valueSize ||
+            crc32c(eheader->mData, entry.keySize + entry.valueSize) != eheader->mCrc) {
+            ALOGE("cache file entry failed CRC check");
+            dropFileEntry(it);
+            return 0;
         }
+        entry.verified = true;
+    }
 
-        munmap(buf, fileSize);
+    valueBlobSize = entry.valueSize;
+    if (valueBlobSize <= valueSize) {
+        memcpy(value, eheader->mData + entry.keySize, valueBlobSize);
+    }
+    return valueBlobSize;
+}
+
+std::unique_ptr<FileBlobCache::WriteSnapshot> FileBlobCache::takeWriteSnapshot() const {
+    ATRACE_CALL();
+    if (mFilename.length() == 0) {
+        return nullptr;
+    }
+    std::unique_ptr<WriteSnapshot> snapshot(new WriteSnapshot{mFilename, mMaxTotalSize, {}});
+    forEachEntry([&](const void* key, size_t keySize, const void* value, size_t valueSize) {
+        const uint8_t* keyBytes = static_cast<const uint8_t*>(key);
+        const uint8_t* valueBytes = static_cast<const uint8_t*>(value);
+        WriteSnapshot::Entry entry{hashKey(key, keySize), static_cast<uint32_t>(keySize),
+                std::vector<uint8_t>(keyBytes, keyBytes + keySize)};
+        entry.data.insert(entry.data.end(), valueBytes, valueBytes + valueSize);
+        snapshot->entries.push_back(std::move(entry));
+    });
+    if (snapshot->entries.empty() && mFile != nullptr) {
+        // The file is up to date.
+        return nullptr;
+    }
+    return snapshot;
+}
+
+bool FileBlobCache::writeEntries(FILE* file, uint32_t offset, const FileMapping* baseFile,
+        const std::vector<FileIndexEntry>& copiedEntries, const WriteSnapshot& snapshot,
+        std::vector<FileIndexEntry> index) {
+    static const uint8_t padding[3] = {};
+
+    for (const FileIndexEntry& e : copiedEntries) {
+        // The entry is copied as is, CRC and padding included.
+        size_t entrySize = align4(sizeof(FileEntryHeader) + e.mKeySize + e.mValueSize);
+        fwrite(baseFile->data + e.mOffset, 1, entrySize, file);
+        index.push_back({e.mKeyHash, offset, e.mKeySize, e.mValueSize});
+        offset += entrySize;
+    }
+
+    for (const WriteSnapshot::Entry& e : snapshot.entries) {
+        FileEntryHeader eheader;
+        eheader.mKeySize = e.keySize;
+        eheader.mValueSize = e.data.size() - e.keySize;
+        eheader.mCrc = crc32c(e.data.data(), e.data.size());
+        size_t entrySize = sizeof(FileEntryHeader) + e.data.size();
+        fwrite(&eheader, 1, sizeof(FileEntryHeader), file);
+        fwrite(e.data.data(), 1, e.data.size(), file);
+        fwrite(padding, 1, align4(entrySize) - entrySize, file);
+        index.push_back({e.keyHash, offset, eheader.mKeySize, eheader.mValueSize});
+        offset += align4(entrySize);
+    }
+
+    // Write the index block and the trailer
+    FileTrailer trailer;
+    trailer.mIndexOffset = offset;
+    trailer.mNumEntries = index.size();
+    trailer.mIndexCrc = crc32c(reinterpret_cast<const uint8_t*>(index.data()),
+            index.size() * sizeof(FileIndexEntry));
+    memcpy(trailer.mMagic, cacheFileIndexMagic, 4);
+    fwrite(index.data(), sizeof(FileIndexEntry), index.size(), file);
+    fwrite(&trailer, 1, sizeof(FileTrailer), file);
+
+    if (fflush(file) != 0 || ferror(file)) {
+        ALOGE("error writing cache file: %s (%d)", strerror(errno), errno);
+        return false;
+    }
+    return true;
+}
+
+bool FileBlobCache::appendToFile(const WriteSnapshot& snapshot, const FileMapping& baseFile,
+        std::vector<FileIndexEntry> baseEntries) {
+    ATRACE_CALL();
+    int fd = open(snapshot.filename.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC, 0);
+    if (fd == -1) {
+        ALOGE("error opening cache file %s: %s (%d)", snapshot.filename.c_str(),
+                strerror(errno), errno);
+        return false;
+    }
+
+    // The new index locates the entries already in the file where they are.
+    struct stat statBuf;
+    if (fstat(fd, &statBuf) == -1 || size_t(statBuf.st_size) != baseFile.size) {
+        ALOGE("cache file changed since it was mapped");
+        close(fd);
+        return false;
+    }
+    FILE* file = fdopen(fd, "a");
+    if (file == nullptr) {
+        ALOGE("error opening cache file: %s (%d)", strerror(errno), errno);
         close(fd);
+        return false;
     }
+
+    bool success = writeEntries(file, baseFile.size, &baseFile, {}, snapshot,
+            std::move(baseEntries));
+    fclose(file);
+    return success;
 }
 
-void FileBlobCache::writeToFile() {
-    if (mFilename.length() > 0) {
-        size_t cacheSize = getFlattenedSize();
-        size_t headerSize = cacheFileHeaderSize;
-        const char* fname = mFilename.c_str();
+bool FileBlobCache::rewriteFile(const WriteSnapshot& snapshot, const FileMapping* baseFile,
+        std::vector<FileIndexEntry> baseEntries) {
+    ATRACE_CALL();
+    const char* fname = snapshot.filename.c_str();
 
-        // Try to create the file with no permissions so we can write it
-        // without anyone trying to read it.
-        int fd = open(fname, O_CREAT | O_EXCL | O_RDWR, 0);
-        if (fd == -1) {
-            if (errno == EEXIST) {
-                // The file exists, delete it and try again.
-                if (unlink(fname) == -1) {
-                    // No point in retrying if the unlink failed.
-                    ALOGE("error unlinking cache file %s: %s (%d)", fname,
-                            strerror(errno), errno);
-                    return;
-                }
-                // Retry now that we've unlinked the file.
-                fd = open(fname, O_CREAT | O_EXCL | O_RDWR, 0);
-            }
-            if (fd == -1) {
-                ALOGE("error creating cache file %s: %s (%d)", fname,
+    // Try to create the file with no permissions so we can write it
+    // without anyone trying to read it.
+    int fd = open(fname, O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0);
+    if (fd == -1) {
+        if (errno == EEXIST) {
+            // The file exists, delete it and try again. The entries copied
+            // from it are still mapped.
+            if (unlink(fname) == -1) {
+                // No point in retrying if the unlink failed.
+                ALOGE("error unlinking cache file %s: %s (%d)", fname,
                         strerror(errno), errno);
-                return;
+                return false;
             }
+            // Retry now that we've unlinked the file.
+            fd = open(fname, O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0);
         }
+        if (fd == -1) {
+            ALOGE("error creating cache file %s: %s (%d)", fname,
+                    strerror(errno), errno);
+            return false;
+        }
+    }
+    FILE* file = fdopen(fd, "w");
+    if (file == nullptr) {
+        ALOGE("error opening cache file: %s (%d)", strerror(errno), errno);
+        close(fd);
+        unlink(fname);
+        return false;
+    }
 
-        size_t fileSize = headerSize + cacheSize;
+    auto buildId = base::GetProperty("ro.build.id", "");
+    size_t headerSize = align4(sizeof(FileHeader) + buildId.size());
 
-        uint8_t* buf = new uint8_t [fileSize];
-        if (!buf) {
-            ALOGE("error allocating buffer for cache contents: %s (%d)",
-                    strerror(errno), errno);
-            close(fd);
-            unlink(fname);
-            return;
+    // Keep the most recently written entries of the base file that fit next to
+    // the entries of the snapshot, within the size limit of the file.
+    size_t totalSize = 0;
+    size_t fileSize = headerSize + sizeof(FileTrailer);
+    for (const WriteSnapshot::Entry& e : snapshot.entries) {
+        totalSize += e.data.size();
+        fileSize += align4(sizeof(FileEntryHeader) + e.data.size()) + sizeof(FileIndexEntry);
+    }
+    std::sort(baseEntries.begin(), baseEntries.end(),
+            [](const FileIndexEntry& lhs, const FileIndexEntry& rhs) {
+                return lhs.mOffset > rhs.mOffset;
+            });
+    size_t numCopied = 0;
+    for (const FileIndexEntry& e : baseEntries) {
+        size_t entrySize = e.mKeySize + e.mValueSize;
+        size_t entryFileSize = align4(sizeof(FileEntryHeader) + entrySize) +
+                sizeof(FileIndexEntry);
+        if (totalSize + entrySize > snapshot.maxTotalSize ||
+            fileSize + entryFileSize > snapshot.maxTotalSize * 2) {
+            break;
         }
+        totalSize += entrySize;
+        fileSize += entryFileSize;
+        numCopied++;
+    }
+    baseEntries.resize(numCopied);
+    std::reverse(baseEntries.begin(), baseEntries.end());
 
-        int err = flatten(buf + headerSize, cacheSize);
-        if (err < 0) {
-            ALOGE("error writing cache contents: %s (%d)", strerror(-err),
-                    -err);
-            delete [] buf;
-            close(fd);
-            unlink(fname);
-            return;
+    // Write the file header
+    std::vector<uint8_t> headerBuf(headerSize);
+    FileHeader* header = reinterpret_cast<FileHeader*>(headerBuf.data());
+    memcpy(header->mMagic, cacheFileMagic, 4);
+    header->mVersion = cacheFileVersion;
+    header->mBuildIdLength = buildId.size();
+    memcpy(header->mBuildId, buildId.c_str(), buildId.size());
+    fwrite(headerBuf.data(), 1, headerSize, file);
+
+    if (!writeEntries(file, headerSize, baseFile, baseEntries, snapshot, {})) {
+        fclose(file);
+        unlink(fname);
+        return false;
+    }
+
+    // The file is appended to by later writes.
+    fchmod(fd, S_IRUSR | S_IWUSR);
+    fclose(file);
+    return true;
+}
+
+bool FileBlobCache::writeSnapshot(const WriteSnapshot& snapshot) {
+    ATRACE_CALL();
+
+    // Serialize the writes of the processes sharing the file, e.g. the
+    // processes of an app, so that each merges its entries with the file the
+    // previous one wrote.
+    std::string lockFilename = snapshot.filename + ".lock";
+    int lockFd = open(lockFilename.c_str(), O_CREAT | O_RDWR | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    if (lockFd == -1) {
+        ALOGE("error opening cache lock file %s: %s (%d)", lockFilename.c_str(),
+                strerror(errno), errno);
+        return false;
+    }
+    if (TEMP_FAILURE_RETRY(flock(lockFd, LOCK_EX)) == -1) {
+        ALOGE("error locking cache lock file: %s (%d)", strerror(errno), errno);
+        close(lockFd);
+        return false;
+    }
+
+    // The entries of the snapshot replace those of the file with the same key.
+    std::unique_ptr<FileMapping> baseFile = mapFile(snapshot.filename, snapshot.maxTotalSize);
+    std::vector<FileIndexEntry> baseEntries;
+    size_t baseTotalSize = 0;
+    if (baseFile != nullptr) {
+        std::unordered_multimap<uint32_t, const WriteSnapshot::Entry*> keys;
+        for (const WriteSnapshot::Entry& e : snapshot.entries) {
+            keys.emplace(e.keyHash, &e);
+        }
+        for (const FileIndexEntry& e : baseFile->index) {
+            bool replaced = false;
+            auto range = keys.equal_range(e.mKeyHash);
+            for (auto it = range.first; it != range.second && !replaced; ++it) {
+                const FileEntryHeader* eheader = reinterpret_cast<const FileEntryHeader*>(
+                        baseFile->data + e.mOffset);
+                replaced = it->second->keySize == e.mKeySize &&
+                        memcmp(eheader->mData, it->second->data.data(), e.mKeySize) == 0;
+            }
+            if (!replaced) {
+                baseEntries.push_back(e);
+                baseTotalSize += e.mKeySize + e.mValueSize;
+            }
         }
+    }
+
+    size_t totalSize = 0;
+    size_t appendedSize = sizeof(FileTrailer) +
+            (baseEntries.size() + snapshot.entries.size()) * sizeof(FileIndexEntry);
+    for (const WriteSnapshot::Entry& e : snapshot.entries) {
+        totalSize += e.data.size();
+        appendedSize += align4(sizeof(FileEntryHeader) + e.data.size());
+    }
+
+    // Append to the file as long as it stays within the size limits;
+    // otherwise rewrite it, which drops the replaced entries and the old index
+    // blocks.
+    bool written = false;
+    if (baseFile != nullptr && baseTotalSize + totalSize <= snapshot.maxTotalSize &&
+        baseFile->size + appendedSize <= snapshot.maxTotalSize * 2) {
+        written = appendToFile(snapshot, *baseFile, baseEntries);
+    }
+    if (!written) {
+        written = rewriteFile(snapshot, baseFile.get(), std::move(baseEntries));
+    }
+
+    close(lockFd);
+    return written;
+}
 
-        // Write the file magic and CRC
-        memcpy(buf, cacheFileMagic, 4);
-        uint32_t* crc = reinterpret_cast<uint32_t*>(buf + 4);
-        *crc = crc32c(buf + headerSize, cacheSize);
-
-        if (write(fd, buf, fileSize) == -1) {
-            ALOGE("error writing cache file: %s (%d)", strerror(errno),
-                    errno);
-            delete [] buf;
-            close(fd);
-            unlink(fname);
+void FileBlobCache::reloadFile() {
+    ATRACE_CALL();
+    unloadFile();
+    if (!loadFile()) {
+        return;
+    }
+
+    // Evict the entries the file now contains. The others were set since the
+    // snapshot was taken, and replace those of the file.
+    std::vector<std::string> written;
+    forEachEntry([&](const void* key, size_t keySize, const void* value, size_t valueSize) {
+        auto entry = findFileEntry(key, keySize);
+        if (entry == mFileIndex.end()) {
             return;
         }
+        const FileEntryHeader* eheader = reinterpret_cast<const FileEntryHeader*>(
+                mFile->data + entry->second.offset);
+        if (entry->second.valueSize == valueSize &&
+            memcmp(eheader->mData + keySize, value, valueSize) == 0) {
+            written.emplace_back(static_cast<const char*>(key), keySize);
+        } else {
+            dropFileEntry(entry);
+        }
+    });
+    for (const std::string& key : written) {
+        remove(key.data(), key.size());
+    }
+}
 
-        delete [] buf;
-        fchmod(fd, S_IRUSR);
-        close(fd);
+void FileBlobCache::writeToFile() {
+    std::unique_ptr<WriteSnapshot> snapshot = takeWriteSnapshot();
+    if (snapshot != nullptr && writeSnapshot(*snapshot)) {
+        reloadFile();
     }
 }
 
@@ -18,24 +18,203 @@
 #define ANDROID_FILE_BLOB_CACHE_H
 
 #include "BlobCache.h"
+#include <stdio.h>
+#include <memory>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace android {
 
+// A FileBlobCache is a BlobCache backed by a file. The file is mmap'd rather
+// than read, and its entries are looked up through the index block at its end,
+// so that only the entries actually used are paged in. The entries set since
+// the file was last written are kept in the BlobCache, and appended to the
+// file by writeToFile.
 class FileBlobCache : public BlobCache {
 public:
-    // FileBlobCache attempts to load the saved cache contents from disk into
-    // BlobCache.
+    // FileBlobCache maps the saved cache contents from disk.
     FileBlobCache(size_t maxKeySize, size_t maxValueSize, size_t maxTotalSize,
             const std::string& filename);
 
-    // writeToFile attempts to save the current contents of BlobCache to
-    // disk.
+    ~FileBlobCache();
+
+    // set adds the key/value pair to the entries to write to the file. The
+    // new value replaces any value of the key in the file.
+    void set(const void* key, size_t keySize, const void* value,
+            size_t valueSize) override;
+
+    // get looks the key up in the entries set since the file was last written,
+    // and then in the file.
+    size_t get(const void* key, size_t keySize, void* value, size_t valueSize) override;
+
+    // A WriteSnapshot holds copies of the entries set since the file was last
+    // written, so that they can be written without holding the lock that
+    // guards the cache.
+    struct WriteSnapshot {
+        // An Entry is a copy of a key/value pair.
+        struct Entry {
+            uint32_t keyHash;
+            uint32_t keySize;
+
+            // data contains the key followed by the value.
+            std::vector<uint8_t> data;
+        };
+
+        std::string filename;
+        size_t maxTotalSize;
+        std::vector<Entry> entries;
+    };
+
+    // takeWriteSnapshot copies the entries to write to the file. It returns
+    // null if the file is up to date.
+    std::unique_ptr<WriteSnapshot> takeWriteSnapshot() const;
+
+    // writeSnapshot writes the entries of a snapshot to its file. It doesn't
+    // access the cache, so the cache can be used, or even destroyed, while it
+    // runs. The writes of all the processes sharing the file are serialized,
+    // and each appends to the file as the previous one left it, so that their
+    // entries are merged. The entries are appended to the file, unless the
+    // file needs to be compacted or created, in which case it is rewritten.
+    static bool writeSnapshot(const WriteSnapshot& snapshot);
+
+    // reloadFile maps the file last written, and evicts the entries it now
+    // contains from memory.
+    void reloadFile();
+
+    // writeToFile attempts to save the current contents of the cache to disk,
+    // by writing a snapshot and reloading the file.
     void writeToFile();
 
 private:
+    // A FileHeader is the header of the cache file. It is followed by the
+    // build id, and then by the entries, aligned to 4 bytes.
+    struct FileHeader {
+        // mMagic identifies the file as a cache file. It must always contain
+        // 'EGL#'.
+        char mMagic[4];
+
+        // mVersion is the file format version.
+        uint32_t mVersion;
+
+        // mBuildIdLength is the length of the build id of the device when the
+        // file was created. An update of the build invalidates the file.
+        uint32_t mBuildIdLength;
+        char mBuildId[];
+    };
+
+    // A FileEntryHeader is the header of an entry of the file. It is followed
+    // immediately by the key data, and then by the value data, padded to 4
+    // bytes.
+    struct FileEntryHeader {
+        uint32_t mKeySize;
+        uint32_t mValueSize;
+
+        // mCrc is the CRC of the key and value data. It is checked the first
+        // time the entry is read.
+        uint32_t mCrc;
+        uint8_t mData[];
+    };
+
+    // A FileIndexEntry locates an entry of the file. Each write to the file
+    // appends an index block of FileIndexEntry for all the entries of the file
+    // after the entries it writes.
+    struct FileIndexEntry {
+        uint32_t mKeyHash;
+        uint32_t mOffset;
+        uint32_t mKeySize;
+        uint32_t mValueSize;
+    };
+
+    // A FileTrailer ends the cache file, and locates its last index block. A
+    // file that doesn't end with a valid trailer, e.g. because of an
+    // interrupted write, is ignored.
+    struct FileTrailer {
+        uint32_t mIndexOffset;
+        uint32_t mNumEntries;
+
+        // mIndexCrc is the CRC of the index block.
+        uint32_t mIndexCrc;
+
+        // mMagic must always contain 'EGLi'.
+        char mMagic[4];
+    };
+
+    // An IndexedEntry is an entry of the file, as found in its index.
+    struct IndexedEntry {
+        uint32_t offset;
+        uint32_t keySize;
+        uint32_t valueSize;
+
+        // verified is true once the CRC of the entry was checked.
+        bool verified;
+    };
+
+    typedef std::unordered_multimap<uint32_t, IndexedEntry> FileIndex;
+
+    // A FileMapping is a mapped cache file.
+    struct FileMapping {
+        ~FileMapping();
+
+        uint8_t* data;
+        size_t size;
+
+        // index contains the entries of the last index block of the file.
+        std::vector<FileIndexEntry> index;
+    };
+
+    // mapFile maps the given cache file and reads its index. It returns null
+    // if the file doesn't exist or isn't valid.
+    static std::unique_ptr<FileMapping> mapFile(const std::string& filename,
+            size_t maxTotalSize);
+
+    // loadFile maps the cache file and builds the file index. It returns
+    // false if the file doesn't exist or isn't valid, leaving the file index
+    // empty.
+    bool loadFile();
+
+    // unloadFile unmaps the cache file and clears the file index.
+    void unloadFile();
+
+    // findFileEntry returns the file index entry of the given key, or the end
+    // of the file index if the key isn't in the file.
+    FileIndex::iterator findFileEntry(const void* key, size_t keySize);
+
+    // dropFileEntry removes the given entry from the file index.
+    void dropFileEntry(FileIndex::iterator entry);
+
+    // appendToFile writes the entries of the snapshot at the end of the base
+    // file, followed by a new index block of them and of the given entries of
+    // the base file.
+    static bool appendToFile(const WriteSnapshot& snapshot, const FileMapping& baseFile,
+            std::vector<FileIndexEntry> baseEntries);
+
+    // rewriteFile writes a new file with the entries of the snapshot, and the
+    // most recently written of the given entries of the base file that fit.
+    static bool rewriteFile(const WriteSnapshot& snapshot, const FileMapping* baseFile,
+            std::vector<FileIndexEntry> baseEntries);
+
+    // writeEntries writes copies of the given entries of the base file, then
+    // the entries of the snapshot, starting at the given offset of the file.
+    // It then writes an index block of the entries in index and of all the
+    // entries it wrote, and the trailer.
+    static bool writeEntries(FILE* file, uint32_t offset, const FileMapping* baseFile,
+            const std::vector<FileIndexEntry>& copiedEntries, const WriteSnapshot& snapshot,
+            std::vector<FileIndexEntry> index);
+
     // mFilename is the name of the file for storing cache contents.
     std::string mFilename;
+
+    // mFile is the mapping of the cache file, or is null if there is no valid
+    // cache file.
+    std::unique_ptr<FileMapping> mFile;
+
+    // mFileIndex maps the hash of each key of the file to its entry.
+    FileIndex mFileIndex;
+
+    // mFileTotalSize is the total combined size of the keys and values of the
+    // entries of mFileIndex.
+    size_t mFileTotalSize;
 };
 
 } // namespace android
@@ -0,0 +1,185 @@
+/*
+ ** Copyright 2021, The Android Open Source Project
+ **
+ ** Licensed under the Apache License, Version 2.0 (the "License");
+ ** you may not use this file except in compliance with the License.
+ ** You may obtain a copy of the License at
+ **
+ **     http://www.apache.org/licenses/LICENSE-2.0
+ **
+ ** Unless required by applicable law or agreed to in writing, software
+ ** distributed under the License is distributed on an "AS IS" BASIS,
+ ** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ ** See the License for the specific language governing permissions and
+ ** limitations under the License.
+ */
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+
+#include <android-base/test_utils.h>
+#include <gtest/gtest.h>
+
+#include "FileBlobCache.h"
+
+namespace android {
+
+class FileBlobCacheTest : public ::testing::Test {
+protected:
+
+    enum {
+        MAX_KEY_SIZE = 64,
+        MAX_VALUE_SIZE = 256,
+        MAX_TOTAL_SIZE = 1024,
+    };
+
+    virtual void SetUp() {
+        mTempFile.reset(new TemporaryFile());
+        mBC.reset(newCache());
+    }
+
+    virtual void TearDown() {
+        mBC.reset();
+        unlink((std::string(mTempFile->path) + ".lock").c_str());
+        mTempFile.reset();
+    }
+
+    FileBlobCache* newCache() {
+        return new FileBlobCache(MAX_KEY_SIZE, MAX_VALUE_SIZE, MAX_TOTAL_SIZE, mTempFile->path);
+    }
+
+    // reload writes the cache to the file, and replaces it with a cache
+    // loaded from the file.
+    void reload() {
+        mBC->writeToFile();
+        mBC.reset(newCache());
+    }
+
+    off_t fileSize() {
+        struct stat st;
+        EXPECT_EQ(0, stat(mTempFile->path, &st));
+        return st.st_size;
+    }
+
+    std::unique_ptr<TemporaryFile> mTempFile;
+    std::unique_ptr<FileBlobCache> mBC;
+};
+
+TEST_F(FileBlobCacheTest, ReloadedCacheContainsValues) {
+    unsigned char buf[4] = { 0xee, 0xee, 0xee, 0xee };
+    mBC->set("abcd", 4, "efgh", 4);
+    mBC->set("ijkl", 4, "mnop", 4);
+    reload();
+    ASSERT_EQ(size_t(4), mBC->get("abcd", 4, buf, 4));
+    ASSERT_EQ(0, memcmp(buf, "efgh", 4));
+    ASSERT_EQ(size_t(4), mBC->get("ijkl", 4, buf, 4));
+    ASSERT_EQ(0, memcmp(buf, "mnop", 4));
+    ASSERT_EQ(size_t(0), mBC->get("qrst", 4, buf, 4));
+}
+
+TEST_F(FileBlobCacheTest, NewEntriesAreAppended) {
+    unsigned char buf[4] = { 0xee, 0xee, 0xee, 0xee };
+    mBC->set("abcd", 4, "efgh", 4);
+    reload();
+    off_t firstSize = fileSize();
+
+    mBC->set("ijkl", 4, "mnop", 4);
+    reload();
+    ASSERT_LT(firstSize, fileSize());
+
+    // The first write is still at the start of the file.
+    ASSERT_EQ(size_t(4), mBC->get("abcd", 4, buf, 4));
+    ASSERT_EQ(0, memcmp(buf, "efgh", 4));
+    ASSERT_EQ(size_t(4), mBC->get("ijkl", 4, buf, 4));
+    ASSERT_EQ(0, memcmp(buf, "mnop", 4));
+}
+
+TEST_F(FileBlobCacheTest, NewValueReplacesValueOfFile) {
+    unsigned char buf[4] = { 0xee, 0xee, 0xee, 0xee };
+    mBC->set("abcd", 4, "efgh", 4);
+    reload();
+    mBC->set("abcd", 4, "ijkl", 4);
+    ASSERT_EQ(size_t(4), mBC->get("abcd", 4, buf, 4));
+    ASSERT_EQ(0, memcmp(buf, "ijkl", 4));
+    reload();
+    ASSERT_EQ(size_t(4), mBC->get("abcd", 4, buf, 4));
+    ASSERT_EQ(0, memcmp(buf, "ijkl", 4));
+}
+
+TEST_F(FileBlobCacheTest, FileSizeStaysWithinLimit) {
+    uint8_t value[MAX_VALUE_SIZE] = {};
+    for (int i = 0; i < 64; i++) {
+        uint8_t k = i;
+        mBC->set(&k, 1, value, sizeof(value));
+        reload();
+        ASSERT_GE(off_t(MAX_TOTAL_SIZE * 2), fileSize());
+    }
+    // The most recent entry survived the compactions.
+    uint8_t k = 63;
+    ASSERT_EQ(size_t(MAX_VALUE_SIZE), mBC->get(&k, 1, nullptr, 0));
+}
+
+TEST_F(FileBlobCacheTest, WritesOfCachesSharingTheFileAreMerged) {
+    unsigned char buf[4] = { 0xee, 0xee, 0xee, 0xee };
+    std::unique_ptr<FileBlobCache> otherCache(newCache());
+    mBC->set("abcd", 4, "efgh", 4);
+    otherCache->set("ijkl", 4, "mnop", 4);
+    mBC->writeToFile();
+    otherCache->writeToFile();
+
+    // The second write appended to the file the first one wrote.
+    ASSERT_EQ(size_t(4), otherCache->get("abcd", 4, buf, 4));
+    ASSERT_EQ(0, memcmp(buf, "efgh", 4));
+    mBC.reset(newCache());
+    ASSERT_EQ(size_t(4), mBC->get("abcd", 4, buf, 4));
+    ASSERT_EQ(0, memcmp(buf, "efgh", 4));
+    ASSERT_EQ(size_t(4), mBC->get("ijkl", 4, buf, 4));
+    ASSERT_EQ(0, memcmp(buf, "mnop", 4));
+}
+
+TEST_F(FileBlobCacheTest, EntriesSetWhileWritingAreKept) {
+    unsigned char buf[4] = { 0xee, 0xee, 0xee, 0xee };
+    mBC->set("abcd", 4, "efgh", 4);
+    std::unique_ptr<FileBlobCache::WriteSnapshot> snapshot = mBC->takeWriteSnapshot();
+    ASSERT_NE(nullptr, snapshot);
+    mBC->set("abcd", 4, "ijkl", 4);
+    mBC->set("mnop", 4, "qrst", 4);
+    ASSERT_TRUE(FileBlobCache::writeSnapshot(*snapshot));
+    mBC->reloadFile();
+
+    ASSERT_EQ(size_t(4), mBC->get("abcd", 4, buf, 4));
+    ASSERT_EQ(0, memcmp(buf, "ijkl", 4));
+    reload();
+    ASSERT_EQ(size_t(4), mBC->get("abcd", 4, buf, 4));
+    ASSERT_EQ(0, memcmp(buf, "ijkl", 4));
+    ASSERT_EQ(size_t(4), mBC->get("mnop", 4, buf, 4));
+    ASSERT_EQ(0, memcmp(buf, "qrst", 4));
+}
+
+TEST_F(FileBlobCacheTest, CorruptedEntryIsNotReturned) {
+    unsigned char buf[4] = { 0xee, 0xee, 0xee, 0xee };
+    mBC->set("abcd", 4, "efgh", 4);
+    mBC->writeToFile();
+    mBC.reset();
+
+    // Flip a byte of the value, which comes last in the only entry before
+    // the index block (16 bytes) and the trailer (16 bytes).
+    int fd = open(mTempFile->path, O_RDWR);
+    ASSERT_NE(-1, fd);
+    off_t offset = lseek(fd, 0, SEEK_END) - 32 - 1;
+    char c;
+    ASSERT_EQ(1, pread(fd, &c, 1, offset));
+    c = ~c;
+    ASSERT_EQ(1, pwrite(fd, &c, 1, offset));
+    close(fd);
+
+    mBC.reset(newCache());
+    ASSERT_EQ(size_t(0), mBC->get("abcd", 4, buf, 4));
+    ASSERT_EQ(0xee, buf[0]);
+}
+
+} // namespace android
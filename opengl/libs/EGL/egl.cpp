@@ -29,6 +29,7 @@
 #include "egl_display.h"
 #include "egl_object.h"
 #include "egl_layers.h"
+#include "egl_platform_entries.h"
 #include "CallStack.h"
 #include "Loader.h"
 
@@ -189,6 +190,8 @@ static EGLBoolean egl_init_drivers_locked() {
         // They will only be initialized once.
         LayerLoader& layer_loader(LayerLoader::getInstance());
         layer_loader.InitLayers(cnx);
+
+        PreloadBuiltinWrappers();
     }
 
     return cnx->dso ? EGL_TRUE : EGL_FALSE;
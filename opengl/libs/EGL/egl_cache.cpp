@@ -26,6 +26,7 @@
 
 #include <thread>
 
+#include <android-base/properties.h>
 #include <log/log.h>
 
 // Cache size limits.
@@ -33,6 +34,17 @@ static const size_t maxKeySize = 12 * 1024;
 static const size_t maxValueSize = 64 * 1024;
 static const size_t maxTotalSize = 2 * 1024 * 1024;
 
+// Size limit of the system cache, which is only read.
+static const size_t maxSystemTotalSize = 16 * 1024 * 1024;
+
+// The property naming the system cache file. The system cache holds entries
+// shared by all applications, e.g. the shaders of the UI toolkit, and is
+// consulted before the cache file of the application. It has the format of
+// the cache files of the applications, and is typically made by exercising the
+// shared code on a device running the same build, and installing the resulting
+// cache file on the system image.
+static const char* const systemCacheFileProperty = "ro.egl.blob_cache.system_file";
+
 // The time in seconds to wait before saving newly inserted cache entries.
 static const unsigned int deferredSaveDelay = 4;
 
@@ -64,7 +76,7 @@ static EGLsizeiANDROID getBlob(const void* key, EGLsizeiANDROID keySize,
 // egl_cache_t definition
 //
 egl_cache_t::egl_cache_t() :
-        mInitialized(false) {
+        mInitialized(false), mSystemBlobCacheLoaded(false) {
 }
 
 egl_cache_t::~egl_cache_t() {
@@ -120,6 +132,8 @@ void egl_cache_t::terminate() {
         mBlobCache->writeToFile();
     }
     mBlobCache = nullptr;
+    mSystemBlobCache = nullptr;
+    mSystemBlobCacheLoaded = false;
 }
 
 void egl_cache_t::setBlob(const void* key, EGLsizeiANDROID keySize,
@@ -139,11 +153,24 @@ void egl_cache_t::setBlob(const void* key, EGLsizeiANDROID keySize,
             mSavePending = true;
             std::thread deferredSaveThread([this]() {
                 sleep(deferredSaveDelay);
-                std::lock_guard<std::mutex> lock(mMutex);
-                if (mInitialized && mBlobCache) {
-                    mBlobCache->writeToFile();
+                std::unique_ptr<FileBlobCache::WriteSnapshot> snapshot;
+                {
+                    std::lock_guard<std::mutex> lock(mMutex);
+                    // Entries set from now on are saved by the next deferred
+                    // save.
+                    mSavePending = false;
+                    if (mInitialized && mBlobCache) {
+                        snapshot = mBlobCache->takeWriteSnapshot();
+                    }
+                }
+                // Write the snapshot without the lock, so that the threads
+                // compiling shaders can keep using the cache meanwhile.
+                if (snapshot && FileBlobCache::writeSnapshot(*snapshot)) {
+                    std::lock_guard<std::mutex> lock(mMutex);
+                    if (mInitialized && mBlobCache) {
+                        mBlobCache->reloadFile();
+                    }
                 }
-                mSavePending = false;
             });
             deferredSaveThread.detach();
         }
@@ -160,6 +187,13 @@ EGLsizeiANDROID egl_cache_t::getBlob(const void* key, EGLsizeiANDROID keySize,
     }
 
     if (mInitialized) {
+        BlobCache* systemCache = getSystemBlobCacheLocked();
+        if (systemCache) {
+            size_t size = systemCache->get(key, keySize, value, valueSize);
+            if (size > 0) {
+                return size;
+            }
+        }
         BlobCache* bc = getBlobCacheLocked();
         return bc->get(key, keySize, value, valueSize);
     }
@@ -178,6 +212,18 @@ BlobCache* egl_cache_t::getBlobCacheLocked() {
     return mBlobCache.get();
 }
 
+BlobCache* egl_cache_t::getSystemBlobCacheLocked() {
+    if (!mSystemBlobCacheLoaded) {
+        mSystemBlobCacheLoaded = true;
+        std::string filename = base::GetProperty(systemCacheFileProperty, "");
+        if (!filename.empty()) {
+            mSystemBlobCache.reset(new FileBlobCache(maxKeySize, maxValueSize,
+                    maxSystemTotalSize, filename));
+        }
+    }
+    return mSystemBlobCache.get();
+}
+
 // ----------------------------------------------------------------------------
 }; // namespace android
 // ----------------------------------------------------------------------------
@@ -82,6 +82,11 @@ private:
     // possible.
     BlobCache* getBlobCacheLocked();
 
+    // getSystemBlobCacheLocked returns the BlobCache object of the read-only
+    // system cache, mapping the system cache file the first time it's called.
+    // It returns null if there is no system cache file.
+    BlobCache* getSystemBlobCacheLocked();
+
     // mInitialized indicates whether the egl_cache_t is in the initialized
     // state.  It is initialized to false at construction time, and gets set to
     // true when initialize is called.  It is set back to false when terminate
@@ -95,6 +100,13 @@ private:
     // first time it's needed.
     std::unique_ptr<FileBlobCache> mBlobCache;
 
+    // mSystemBlobCache is the read-only cache shared by all applications. It
+    // is consulted before mBlobCache, and is never written to. It is null if
+    // the system cache file isn't set, or hasn't been loaded yet, as indicated
+    // by mSystemBlobCacheLoaded.
+    std::unique_ptr<FileBlobCache> mSystemBlobCache;
+    bool mSystemBlobCacheLoaded;
+
     // mFilename is the name of the file for storing cache contents in between
     // program invocations.  It is initialized to an empty string at
     // construction time, and can be set with the setCacheFilename method.  An
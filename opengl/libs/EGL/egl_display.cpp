@@ -36,6 +36,8 @@
 #include <dlfcn.h>
 #include <graphicsenv/GraphicsEnv.h>
 
+#include <memory>
+
 #include <android/hardware/configstore/1.0/ISurfaceFlingerConfigs.h>
 #include <configstore/Utils.h>
 
@@ -84,13 +86,43 @@ int egl_get_init_count(EGLDisplay dpy) {
 
 egl_display_t egl_display_t::sDisplay[NUM_DISPLAYS];
 
+// The slots of an ObjectTable are null until an object is stored in them, and
+// are set to kRemovedObject once it is removed, so that the searches for the
+// objects stored further in the probe sequence go on.
+static egl_object_t* const kRemovedObject = reinterpret_cast<egl_object_t*>(uintptr_t(1));
+static constexpr size_t kMinObjectTableCapacity = 16;
+
+struct egl_display_t::ObjectTable {
+    explicit ObjectTable(size_t capacity)
+          : mask(capacity - 1), slots(new std::atomic<egl_object_t*>[capacity]) {
+        for (size_t i = 0; i < capacity; i++) {
+            slots[i].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    // first returns the first slot of the probe sequence of object.
+    size_t first(const egl_object_t* object) const {
+        return size_t((uint64_t(uintptr_t(object)) * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+    }
+
+    // mask is the capacity, a power of 2, minus one.
+    size_t mask;
+    std::unique_ptr<std::atomic<egl_object_t*>[]> slots;
+};
+
+void egl_display_t::deleteObjectTable(void* table) {
+    delete static_cast<ObjectTable*>(table);
+}
+
 egl_display_t::egl_display_t() :
-    magic('_dpy'), finishOnSwap(false), traceGpuCompletion(false), refs(0), eglIsInitialized(false) {
+    magic('_dpy'), finishOnSwap(false), traceGpuCompletion(false), refs(0), eglIsInitialized(false),
+    objects(new ObjectTable(kMinObjectTableCapacity)), numObjects(0), numRemovedObjects(0) {
 }
 
 egl_display_t::~egl_display_t() {
     magic = 0;
     egl_cache_t::get()->terminate();
+    delete objects.load();
 }
 
 egl_display_t* egl_display_t::get(EGLDisplay dpy) {
@@ -105,25 +137,83 @@ egl_display_t* egl_display_t::get(EGLDisplay dpy) {
     return &sDisplay[index];
 }
 
+void egl_display_t::rebuildObjectTable(size_t capacity) {
+    ObjectTable* table = objects.load(std::memory_order_relaxed);
+    ObjectTable* newTable = new ObjectTable(capacity);
+    for (size_t i = 0; i <= table->mask; i++) {
+        egl_object_t* object = table->slots[i].load(std::memory_order_relaxed);
+        if (object == nullptr || object == kRemovedObject) {
+            continue;
+        }
+        size_t slot = newTable->first(object);
+        while (newTable->slots[slot].load(std::memory_order_relaxed) != nullptr) {
+            slot = (slot + 1) & newTable->mask;
+        }
+        newTable->slots[slot].store(object, std::memory_order_relaxed);
+    }
+    objects.store(newTable);
+    numRemovedObjects = 0;
+    egl_defer_free(table, deleteObjectTable);
+}
+
 void egl_display_t::addObject(egl_object_t* object) {
     std::lock_guard<std::mutex> _l(lock);
-    objects.insert(object);
+    // Keep at least half of the slots null, so that the searches end quickly.
+    ObjectTable* table = objects.load(std::memory_order_relaxed);
+    if ((numObjects + numRemovedObjects + 1) * 2 > table->mask + 1) {
+        size_t capacity = kMinObjectTableCapacity;
+        while (capacity < (numObjects + 1) * 4) {
+            capacity *= 2;
+        }
+        rebuildObjectTable(capacity);
+        table = objects.load(std::memory_order_relaxed);
+    }
+    size_t slot = table->first(object);
+    for (;; slot = (slot + 1) & table->mask) {
+        egl_object_t* current = table->slots[slot].load(std::memory_order_relaxed);
+        if (current == nullptr) {
+            break;
+        }
+        if (current == kRemovedObject) {
+            numRemovedObjects--;
+            break;
+        }
+    }
+    table->slots[slot].store(object, std::memory_order_release);
+    numObjects++;
 }
 
 void egl_display_t::removeObject(egl_object_t* object) {
     std::lock_guard<std::mutex> _l(lock);
-    objects.erase(object);
+    ObjectTable* table = objects.load(std::memory_order_relaxed);
+    for (size_t slot = table->first(object);; slot = (slot + 1) & table->mask) {
+        egl_object_t* current = table->slots[slot].load(std::memory_order_relaxed);
+        if (current == nullptr) {
+            return;
+        }
+        if (current == object) {
+            table->slots[slot].store(kRemovedObject, std::memory_order_release);
+            numObjects--;
+            numRemovedObjects++;
+            return;
+        }
+    }
 }
 
 bool egl_display_t::getObject(egl_object_t* object) const {
-    std::lock_guard<std::mutex> _l(lock);
-    if (objects.find(object) != objects.end()) {
-        if (object->getDisplay() == this) {
-            object->incRef();
-            return true;
+    // The table, and the objects found in it, remain accessible until the end
+    // of the read section even if they are concurrently replaced or deleted.
+    egl_read_section_t section;
+    const ObjectTable* table = objects.load();
+    for (size_t slot = table->first(object);; slot = (slot + 1) & table->mask) {
+        egl_object_t* current = table->slots[slot].load(std::memory_order_acquire);
+        if (current == nullptr) {
+            return false;
+        }
+        if (current == object) {
+            return object->getDisplay() == this && object->tryIncRef();
         }
     }
-    return false;
 }
 
 EGLDisplay egl_display_t::getFromNativeDisplay(EGLNativeDisplayType disp,
@@ -438,14 +528,20 @@ EGLBoolean egl_display_t::terminate() {
         // Mark all objects remaining in the list as terminated, unless
         // there are no reference to them, it which case, we're free to
         // delete them.
-        size_t count = objects.size();
-        ALOGW_IF(count, "eglTerminate() called w/ %zu objects remaining", count);
-        for (auto o : objects) {
-            o->destroy();
+        ALOGW_IF(numObjects, "eglTerminate() called w/ %zu objects remaining", numObjects);
+        ObjectTable* table = objects.load(std::memory_order_relaxed);
+        for (size_t i = 0; i <= table->mask; i++) {
+            egl_object_t* o = table->slots[i].load(std::memory_order_relaxed);
+            if (o != nullptr && o != kRemovedObject) {
+                o->destroy();
+            }
         }
 
         // this marks all object handles are "terminated"
-        objects.clear();
+        objects.store(new ObjectTable(kMinObjectTableCapacity));
+        numObjects = 0;
+        numRemovedObjects = 0;
+        egl_defer_free(table, deleteObjectTable);
     }
 
     { // scope for refLock
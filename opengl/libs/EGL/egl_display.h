@@ -21,10 +21,10 @@
 #include <stdint.h>
 #include <stddef.h>
 
+#include <atomic>
 #include <condition_variable>
 #include <mutex>
 #include <string>
-#include <unordered_set>
 
 #include <EGL/egl.h>
 #include <EGL/eglext.h>
@@ -71,6 +71,7 @@ public:
     // remove object from this display's list
     void removeObject(egl_object_t* object);
     // add reference to this object. returns true if this is a valid object.
+    // this doesn't take the display lock.
     bool getObject(egl_object_t* object) const;
 
     static egl_display_t* get(EGLDisplay dpy);
@@ -120,12 +121,22 @@ public:
 private:
     friend class egl_display_ptr;
 
+    // An ObjectTable is an open addressing hash set of the objects of the
+    // display. It is only modified with the display lock held, and is replaced
+    // rather than resized, so that getObject can search it without the lock.
+    struct ObjectTable;
+    static void deleteObjectTable(void* table);
+    void rebuildObjectTable(size_t capacity);
+
             uint32_t                    refs;
             bool                        eglIsInitialized;
     mutable std::mutex                  lock;
     mutable std::mutex                  refLock;
     mutable std::condition_variable     refCond;
-            std::unordered_set<egl_object_t*> objects;
+            std::atomic<ObjectTable*>   objects;
+            // number of objects, and of slots of removed objects, of the table
+            size_t                      numObjects;
+            size_t                      numRemovedObjects;
             std::string mVendorString;
             std::string mVersionString;
             std::string mClientApiString;
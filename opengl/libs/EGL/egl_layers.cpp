@@ -253,6 +253,10 @@ bool LayerLoader::Initialized() {
     return initialized_;
 }
 
+bool LayerLoader::HasLayers() const {
+    return layers_loaded_ && !layer_setup_.empty();
+}
+
 void LayerLoader::InitLayers(egl_connection_t* cnx) {
     if (!layers_loaded_) return;
 
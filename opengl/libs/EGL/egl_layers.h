@@ -49,6 +49,9 @@ public:
     void LayerPlatformEntries(layer_setup_func layer_setup, EGLFuncPointer*, char const* const*);
     void LayerDriverEntries(layer_setup_func layer_setup, EGLFuncPointer*, char const* const*);
     bool Initialized();
+    // HasLayers returns true if GLES layers were loaded, which then intercept
+    // the entry points.
+    bool HasLayers() const;
     std::string GetDebugLayers();
 
     EGLFuncPointer GetGpaNext(unsigned i);
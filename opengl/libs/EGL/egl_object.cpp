@@ -16,6 +16,11 @@
 
 #include "egl_object.h"
 
+#include <pthread.h>
+
+#include <algorithm>
+#include <limits>
+#include <mutex>
 #include <sstream>
 
 
@@ -23,6 +28,105 @@
 namespace android {
 // ----------------------------------------------------------------------------
 
+// A thread_record_t publishes the epoch at which its thread entered its current
+// read section, or 0 if the thread isn't in a read section. The records are
+// never freed: the record of a thread that exited is reused by the next thread
+// that enters a read section.
+struct egl_read_section_t::thread_record_t {
+    std::atomic<uint64_t> epoch{0};
+    std::atomic<bool> inUse{true};
+    thread_record_t* next = nullptr;
+};
+
+// A deferred_free_t is memory released while read sections that may have seen
+// it were running. epoch is the epoch at which it was released: it can be freed
+// once all the read sections running entered at a later epoch.
+struct deferred_free_t {
+    void* memory;
+    void (*free)(void*);
+    uint64_t epoch;
+};
+
+static std::atomic<uint64_t> sEpoch{1};
+static std::atomic<egl_read_section_t::thread_record_t*> sThreadRecords{nullptr};
+static pthread_key_t sThreadRecordKey;
+static pthread_once_t sThreadRecordKeyOnce = PTHREAD_ONCE_INIT;
+
+static std::mutex sDeferredFreesLock;
+// accesses protected by sDeferredFreesLock
+static std::vector<deferred_free_t>* sDeferredFrees = new std::vector<deferred_free_t>();
+
+static egl_read_section_t::thread_record_t* getThreadRecord() {
+    pthread_once(&sThreadRecordKeyOnce, [] {
+        pthread_key_create(&sThreadRecordKey, [](void* record) {
+            static_cast<egl_read_section_t::thread_record_t*>(record)->inUse.store(
+                    false, std::memory_order_release);
+        });
+    });
+    auto* record =
+            static_cast<egl_read_section_t::thread_record_t*>(pthread_getspecific(sThreadRecordKey));
+    if (record) {
+        return record;
+    }
+
+    for (record = sThreadRecords.load(std::memory_order_acquire); record; record = record->next) {
+        bool inUse = false;
+        if (record->inUse.compare_exchange_strong(inUse, true, std::memory_order_acquire)) {
+            break;
+        }
+    }
+    if (!record) {
+        record = new egl_read_section_t::thread_record_t();
+        record->next = sThreadRecords.load(std::memory_order_relaxed);
+        while (!sThreadRecords.compare_exchange_weak(record->next, record,
+                                                     std::memory_order_release)) {
+        }
+    }
+    pthread_setspecific(sThreadRecordKey, record);
+    return record;
+}
+
+egl_read_section_t::egl_read_section_t() : record(getThreadRecord()) {
+    // The loads of the read section must not happen before the epoch is
+    // published, hence the sequentially consistent store.
+    record->epoch.store(sEpoch.load());
+}
+
+egl_read_section_t::~egl_read_section_t() {
+    record->epoch.store(0, std::memory_order_release);
+}
+
+void egl_defer_free(void* memory, void (*free)(void*)) {
+    // The read sections that entered at a later epoch than the current one
+    // can't see memory, which is no longer reachable.
+    const uint64_t epoch = sEpoch.fetch_add(1);
+
+    std::vector<deferred_free_t> freeable;
+    {
+        std::lock_guard<std::mutex> _l(sDeferredFreesLock);
+        sDeferredFrees->push_back({memory, free, epoch});
+
+        uint64_t oldestEpoch = std::numeric_limits<uint64_t>::max();
+        for (auto* record = sThreadRecords.load(); record; record = record->next) {
+            const uint64_t recordEpoch = record->epoch.load();
+            if (recordEpoch != 0) {
+                oldestEpoch = std::min(oldestEpoch, recordEpoch);
+            }
+        }
+        auto end = std::partition(sDeferredFrees->begin(), sDeferredFrees->end(),
+                                  [oldestEpoch](const deferred_free_t& deferred) {
+                                      return deferred.epoch >= oldestEpoch;
+                                  });
+        freeable.assign(end, sDeferredFrees->end());
+        sDeferredFrees->erase(end, sDeferredFrees->end());
+    }
+    for (const deferred_free_t& deferred : freeable) {
+        deferred.free(deferred.memory);
+    }
+}
+
+// ----------------------------------------------------------------------------
+
 egl_object_t::egl_object_t(egl_display_t* disp) :
     display(disp), count(1) {
     // NOTE: this does an implicit incRef
@@ -47,6 +151,20 @@ void egl_object_t::destroy() {
     }
 }
 
+void egl_object_t::operator delete(void* memory) {
+    egl_defer_free(memory, [](void* object) { ::operator delete(object); });
+}
+
+bool egl_object_t::tryIncRef() {
+    size_t current = count.load(std::memory_order_relaxed);
+    while (current != 0) {
+        if (count.compare_exchange_weak(current, current + 1, std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+    return false;
+}
+
 bool egl_object_t::get(egl_display_t const* display, egl_object_t* object) {
     // used by LocalRef, this does an incRef() atomically with
     // checking that the object is valid.
@@ -39,6 +39,29 @@ namespace android {
 
 class egl_display_t;
 
+// An egl_read_section_t is a section of a thread that looks objects up without
+// holding the display lock. Memory released with egl_defer_free isn't freed
+// until the read sections that may still be accessing it have ended, so a
+// read section can dereference the objects it finds even if they are
+// concurrently destroyed. Read sections must be short, and mustn't be nested.
+class egl_read_section_t {
+public:
+    egl_read_section_t();
+    ~egl_read_section_t();
+
+    struct thread_record_t;
+
+private:
+    egl_read_section_t(const egl_read_section_t&) = delete;
+    egl_read_section_t& operator=(const egl_read_section_t&) = delete;
+
+    thread_record_t* record;
+};
+
+// egl_defer_free calls free(memory) once no read section that may have seen
+// memory is running.
+void egl_defer_free(void* memory, void (*free)(void*));
+
 class egl_object_t {
     egl_display_t *display;
     mutable std::atomic_size_t count;
@@ -51,8 +74,15 @@ public:
     explicit egl_object_t(egl_display_t* display);
     void destroy();
 
+    // The memory of deleted objects is released with egl_defer_free, since
+    // egl_display_t::getObject may still be accessing them.
+    static void operator delete(void* memory);
+
     inline void incRef() { count.fetch_add(1, std::memory_order_relaxed); }
     inline size_t decRef() { return count.fetch_sub(1, std::memory_order_acq_rel); }
+    // tryIncRef adds a reference unless the last one was already removed, i.e.
+    // the object is deleted. It returns true if it added a reference.
+    bool tryIncRef();
     inline egl_display_t* getDisplay() const { return display; }
 
 private:
@@ -41,6 +41,7 @@
 #include <mutex>
 #include <unordered_map>
 #include <string>
+#include <string_view>
 #include <thread>
 
 #include "../egl_impl.h"
@@ -261,14 +262,25 @@ static std::unordered_map<std::string, int> sGLExtensionSlotMap;
 static int sGLExtensionSlot = 0;
 static pthread_mutex_t sExtensionMapMutex = PTHREAD_MUTEX_INITIALIZER;
 
-static void(*findProcAddress(const char* name,
-        const extension_map_t* map, size_t n))() {
-    for (uint32_t i=0 ; i<n ; i++) {
-        if (!strcmp(name, map[i].name)) {
-            return map[i].address;
-        }
-    }
-    return nullptr;
+// sBuiltinWrapperMap caches the wrappers of the builtin entry points found by
+// findBuiltinWrapper, so that each name is only looked up with dlsym once.
+// accesses protected by sExtensionMapMutex
+static std::unordered_map<std::string, __eglMustCastToProperFunctionPointerType> sBuiltinWrapperMap;
+
+static void(*findProcAddress(const char* name))() {
+    // The index is built by the first lookup, and shared with the processes
+    // forked after it.
+    static const std::unordered_map<std::string_view, __eglMustCastToProperFunctionPointerType>
+            sExtensionIndex = [] {
+                std::unordered_map<std::string_view, __eglMustCastToProperFunctionPointerType>
+                        index;
+                for (const extension_map_t& entry : sExtensionMap) {
+                    index.emplace(entry.name, entry.address);
+                }
+                return index;
+            }();
+    auto pos = sExtensionIndex.find(name);
+    return (pos != sExtensionIndex.end()) ? pos->second : nullptr;
 }
 
 // ----------------------------------------------------------------------------
@@ -1205,6 +1217,45 @@ static __eglMustCastToProperFunctionPointerType findBuiltinWrapper(
     return nullptr;
 }
 
+// useDirectDispatch returns true if eglGetProcAddress returns the driver's entry
+// points of the extensions that have no builtin wrapper, rather than forwarders.
+// The calls to these extensions then go straight to the driver instead of
+// through a forwarder, but they are not intercepted by the layers enabled
+// later, and their calls without a current context are left to the driver.
+// Direct dispatch is enabled by debug.egl.direct_dispatch, while no GLES layer
+// is active.
+static bool useDirectDispatch(const LayerLoader& layer_loader) {
+    static const bool enabled = base::GetBoolProperty("debug.egl.direct_dispatch", false);
+    return enabled && !layer_loader.HasLayers();
+}
+
+// findCachedBuiltinWrapperLocked looks the wrapper of a builtin entry point up
+// in sBuiltinWrapperMap, and falls back to findBuiltinWrapper for the names it
+// hasn't seen yet. Must be called with sExtensionMapMutex held.
+static __eglMustCastToProperFunctionPointerType findCachedBuiltinWrapperLocked(
+        const std::string& name) {
+    auto pos = sBuiltinWrapperMap.find(name);
+    if (pos != sBuiltinWrapperMap.end()) return pos->second;
+
+    __eglMustCastToProperFunctionPointerType addr = findBuiltinWrapper(name.c_str());
+    if (addr) sBuiltinWrapperMap[name] = addr;
+    return addr;
+}
+
+void PreloadBuiltinWrappers()
+{
+    ATRACE_CALL();
+    pthread_mutex_lock(&sExtensionMapMutex);
+    if (sBuiltinWrapperMap.empty()) {
+        for (char const* const* names : {egl_names, gl_names, gl_names_1}) {
+            for (; *names; names++) {
+                findCachedBuiltinWrapperLocked(*names);
+            }
+        }
+    }
+    pthread_mutex_unlock(&sExtensionMapMutex);
+}
+
 __eglMustCastToProperFunctionPointerType eglGetProcAddressImpl(const char *procname)
 {
     if (FILTER_EXTENSIONS(procname)) {
@@ -1212,15 +1263,20 @@ __eglMustCastToProperFunctionPointerType eglGetProcAddressImpl(const char *procn
     }
 
     __eglMustCastToProperFunctionPointerType addr;
-    addr = findProcAddress(procname, sExtensionMap, NELEM(sExtensionMap));
+    addr = findProcAddress(procname);
     if (addr) return addr;
 
-    addr = findBuiltinWrapper(procname);
-    if (addr) return addr;
-
-    // this protects accesses to sGLExtensionMap, sGLExtensionSlot, and sGLExtensionSlotMap
+    // this protects accesses to sBuiltinWrapperMap, sGLExtensionMap, sGLExtensionSlot, and
+    // sGLExtensionSlotMap
     pthread_mutex_lock(&sExtensionMapMutex);
 
+    const std::string name(procname);
+    addr = findCachedBuiltinWrapperLocked(name);
+    if (addr) {
+        pthread_mutex_unlock(&sExtensionMapMutex);
+        return addr;
+    }
+
     /*
      * Since eglGetProcAddress() is not associated to anything, it needs
      * to return a function pointer that "works" regardless of what
@@ -1238,7 +1294,6 @@ __eglMustCastToProperFunctionPointerType eglGetProcAddressImpl(const char *procn
      *
      */
 
-    const std::string name(procname);
     auto& extensionMap = sGLExtensionMap;
     auto& extensionSlotMap = sGLExtensionSlotMap;
     egl_connection_t* const cnx = &gEGLImpl;
@@ -1248,7 +1303,16 @@ __eglMustCastToProperFunctionPointerType eglGetProcAddressImpl(const char *procn
     auto pos = extensionMap.find(name);
     addr = (pos != extensionMap.end()) ? pos->second : nullptr;
 
-    if (!addr) {
+    if (!addr && useDirectDispatch(layer_loader)) {
+        // No layer is active, so return the driver's entry point, which is
+        // tracked without a slot.
+        if (cnx->dso && cnx->egl.eglGetProcAddress) {
+            addr = cnx->egl.eglGetProcAddress(procname);
+            if (addr) {
+                extensionMap[name] = addr;
+            }
+        }
+    } else if (!addr) {
         // This is the first time we've looked this function up
         // Ensure we have room to track it
         const int slot = sGLExtensionSlot;
@@ -1288,20 +1352,18 @@ __eglMustCastToProperFunctionPointerType eglGetProcAddressImpl(const char *procn
         // Look up the slot for this extension
         auto slot_pos = extensionSlotMap.find(name);
         int ext_slot = (slot_pos != extensionSlotMap.end()) ? slot_pos->second : -1;
-        if (ext_slot < 0) {
-            // Something has gone wrong, this should not happen
-            ALOGE("No extension slot found for %s", procname);
-            return nullptr;
+        if (ext_slot >= 0) {
+            // We tracked the bottom of the stack, so re-apply layers since
+            // more layers might have been enabled
+            addr = layer_loader.ApplyLayers(procname, addr);
+
+            // Track the top most entry point and return the extension forwarder
+            cnx->hooks[egl_connection_t::GLESv1_INDEX]->ext.extensions[ext_slot] =
+            cnx->hooks[egl_connection_t::GLESv2_INDEX]->ext.extensions[ext_slot] = addr;
+            addr = gExtensionForwarders[ext_slot];
         }
-
-        // We tracked the bottom of the stack, so re-apply layers since
-        // more layers might have been enabled
-        addr = layer_loader.ApplyLayers(procname, addr);
-
-        // Track the top most entry point and return the extension forwarder
-        cnx->hooks[egl_connection_t::GLESv1_INDEX]->ext.extensions[ext_slot] =
-        cnx->hooks[egl_connection_t::GLESv2_INDEX]->ext.extensions[ext_slot] = addr;
-        addr = gExtensionForwarders[ext_slot];
+        // Otherwise the driver's entry point was returned directly, and keeps
+        // being returned even if layers were enabled since.
     }
 
     pthread_mutex_unlock(&sExtensionMapMutex);
@@ -2735,18 +2797,27 @@ EGLFuncPointer FindPlatformImplAddr(const char* name)
         return nullptr;
     }
 
-    for (int i = 0; i < NELEM(sPlatformImplMap); i++) {
-        if (sPlatformImplMap[i].name == nullptr) {
-            ALOGV("FindPlatformImplAddr found nullptr for sPlatformImplMap[%i].name (%s)", i, name);
-            return nullptr;
-        }
-        if (!strcmp(name, sPlatformImplMap[i].name)) {
-            ALOGV("FindPlatformImplAddr found %llu for sPlatformImplMap[%i].address (%s)", (unsigned long long)sPlatformImplMap[i].address, i, name);
-            return sPlatformImplMap[i].address;
+    // The index is built by the first lookup, when gEGLImpl is constructed as
+    // libEGL is loaded. The zygote loads libEGL, so the applications inherit the
+    // index rather than each build it.
+    static const std::unordered_map<std::string_view, EGLFuncPointer> sPlatformImplIndex = [] {
+        std::unordered_map<std::string_view, EGLFuncPointer> index;
+        for (const implementation_map_t& entry : sPlatformImplMap) {
+            if (entry.name == nullptr) {
+                break;
+            }
+            // emplace keeps the first entry of a name, as the linear search did.
+            index.emplace(entry.name, entry.address);
         }
-    }
+        return index;
+    }();
 
-    ALOGV("FindPlatformImplAddr did not find an entry for %s", name);
-    return nullptr;
+    auto pos = sPlatformImplIndex.find(name);
+    if (pos == sPlatformImplIndex.end()) {
+        ALOGV("FindPlatformImplAddr did not find an entry for %s", name);
+        return nullptr;
+    }
+    ALOGV("FindPlatformImplAddr found %llu for %s", (unsigned long long)pos->second, name);
+    return pos->second;
 }
 } // namespace android
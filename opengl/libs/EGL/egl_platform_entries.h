@@ -26,6 +26,11 @@ namespace android {
 EGLint eglGetErrorImpl();
 EGLFuncPointer FindPlatformImplAddr(const char* name);
 
+// PreloadBuiltinWrappers looks the wrappers of all the builtin entry points up
+// once the drivers are loaded, so that eglGetProcAddress finds them in a hash
+// table. In the zygote, this happens before the applications are forked.
+void PreloadBuiltinWrappers();
+
 }; // namespace android
 
 #endif // ANDROID_EGLAPI_H
@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+
+#include <iterator>
+
+// Usage: atest EGL_benchmark
+
+namespace android {
+namespace {
+
+// Entry points an application typically looks up at startup: builtin EGL and
+// GLES functions, an extension implemented by libEGL, and an extension of the
+// driver.
+constexpr const char* kProcNames[] = {
+        "eglCreateContext",
+        "glDrawArrays",
+        "glDrawElementsInstanced",
+        "eglPresentationTimeANDROID",
+        "glEGLImageTargetTexture2DOES",
+};
+
+EGLDisplay initializeDisplay(benchmark::State& state) {
+    EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr)) {
+        state.SkipWithError("unable to initialize the default display");
+        return EGL_NO_DISPLAY;
+    }
+    return display;
+}
+
+// Initializing the display loads the drivers on the first iteration only, as
+// they stay loaded once the display is terminated.
+void BM_eglInitialize(benchmark::State& state) {
+    for (auto _ : state) {
+        EGLDisplay display = initializeDisplay(state);
+        if (display == EGL_NO_DISPLAY) {
+            return;
+        }
+        eglTerminate(display);
+    }
+}
+BENCHMARK(BM_eglInitialize);
+
+void BM_eglGetProcAddress(benchmark::State& state) {
+    EGLDisplay display = initializeDisplay(state);
+    if (display == EGL_NO_DISPLAY) {
+        return;
+    }
+    const char* procName = kProcNames[state.range(0)];
+    state.SetLabel(procName);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(eglGetProcAddress(procName));
+    }
+    eglTerminate(display);
+}
+BENCHMARK(BM_eglGetProcAddress)->DenseRange(0, std::size(kProcNames) - 1);
+
+// A CurrentContext makes an OpenGL ES 2 context current on a pbuffer surface
+// for the lifetime of a GL call benchmark.
+class CurrentContext {
+public:
+    explicit CurrentContext(benchmark::State& state) : mDisplay(initializeDisplay(state)) {
+        if (mDisplay == EGL_NO_DISPLAY) {
+            return;
+        }
+        const EGLint configAttribs[] = {EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE,
+                                        EGL_OPENGL_ES2_BIT, EGL_NONE};
+        EGLConfig config;
+        EGLint numConfigs = 0;
+        const EGLint surfaceAttribs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+        const EGLint contextAttribs[] = {EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE};
+        if (!eglChooseConfig(mDisplay, configAttribs, &config, 1, &numConfigs) ||
+            numConfigs == 0 ||
+            (mSurface = eglCreatePbufferSurface(mDisplay, config, surfaceAttribs)) ==
+                    EGL_NO_SURFACE ||
+            (mContext = eglCreateContext(mDisplay, config, EGL_NO_CONTEXT, contextAttribs)) ==
+                    EGL_NO_CONTEXT ||
+            !eglMakeCurrent(mDisplay, mSurface, mSurface, mContext)) {
+            state.SkipWithError("unable to make a context current");
+            return;
+        }
+        mMadeCurrent = true;
+    }
+
+    ~CurrentContext() {
+        if (mDisplay == EGL_NO_DISPLAY) {
+            return;
+        }
+        eglMakeCurrent(mDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (mContext != EGL_NO_CONTEXT) {
+            eglDestroyContext(mDisplay, mContext);
+        }
+        if (mSurface != EGL_NO_SURFACE) {
+            eglDestroySurface(mDisplay, mSurface);
+        }
+        eglTerminate(mDisplay);
+    }
+
+    bool isCurrent() const { return mMadeCurrent; }
+
+private:
+    EGLDisplay mDisplay;
+    EGLSurface mSurface = EGL_NO_SURFACE;
+    EGLContext mContext = EGL_NO_CONTEXT;
+    bool mMadeCurrent = false;
+};
+
+__attribute__((noinline)) GLenum baselineGetError() {
+    benchmark::ClobberMemory();
+    return GL_NO_ERROR;
+}
+
+// The per-call overhead of the GLES dispatch is the difference between
+// BM_glGetError, which goes through the libGLESv2 entry point and the hooks of
+// the current context, and BM_baselineCall, a plain call of a function doing
+// no work. Extensions that have no entry point in libGLESv2 go through a
+// forwarder of the same cost, unless debug.egl.direct_dispatch is set and no
+// GLES layer is active, in which case eglGetProcAddress returns the driver's
+// entry point and the overhead is that of BM_baselineCall.
+void BM_glGetError(benchmark::State& state) {
+    CurrentContext context(state);
+    if (!context.isCurrent()) {
+        return;
+    }
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(glGetError());
+    }
+}
+BENCHMARK(BM_glGetError);
+
+void BM_baselineCall(benchmark::State& state) {
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(baselineGetError());
+    }
+}
+BENCHMARK(BM_baselineCall);
+
+} // namespace
+} // namespace android
+
+BENCHMARK_MAIN();
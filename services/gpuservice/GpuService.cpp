@@ -94,6 +94,33 @@ std::string GpuService::getUpdatableDriverPath() {
     return mDeveloperDriverPath;
 }
 
+// The key of the result is prefixed with the uid of the app setting or getting it.
+static std::string angleRulesResultKey(const std::string& rulesKey) {
+    return std::to_string(IPCThreadState::self()->getCallingUid()) + ":" + rulesKey;
+}
+
+void GpuService::setAngleRulesResult(const std::string& rulesKey, bool useAngle) {
+    const std::string key = angleRulesResultKey(rulesKey);
+
+    std::lock_guard<std::mutex> lock(mLock);
+    if (mAngleRulesResults.size() >= MAX_NUM_ANGLE_RULES_RESULTS) {
+        mAngleRulesResults.clear();
+    }
+    mAngleRulesResults[key] = useAngle;
+}
+
+bool GpuService::getAngleRulesResult(const std::string& rulesKey, bool* outUseAngle) {
+    const std::string key = angleRulesResultKey(rulesKey);
+
+    std::lock_guard<std::mutex> lock(mLock);
+    auto it = mAngleRulesResults.find(key);
+    if (it == mAngleRulesResults.end()) {
+        return false;
+    }
+    *outUseAngle = it->second;
+    return true;
+}
+
 status_t GpuService::shellCommand(int /*in*/, int out, int err, std::vector<String16>& args) {
     ATRACE_CALL();
 
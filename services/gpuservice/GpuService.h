@@ -24,6 +24,7 @@
 #include <serviceutils/PriorityDumper.h>
 
 #include <mutex>
+#include <unordered_map>
 #include <vector>
 
 namespace android {
@@ -54,6 +55,8 @@ private:
                         const GpuStatsInfo::Stats stats, const uint64_t value) override;
     void setUpdatableDriverPath(const std::string& driverPath) override;
     std::string getUpdatableDriverPath() override;
+    void setAngleRulesResult(const std::string& rulesKey, bool useAngle) override;
+    bool getAngleRulesResult(const std::string& rulesKey, bool* outUseAngle) override;
 
     /*
      * IBinder interface
@@ -81,6 +84,10 @@ private:
     std::unique_ptr<GpuMemTracer> mGpuMemTracer;
     std::mutex mLock;
     std::string mDeveloperDriverPath;
+    // Results of the ANGLE rules, keyed by the uid of the app and its rules key, so that apps
+    // can't set the results of other apps. Cleared once it reaches MAX_NUM_ANGLE_RULES_RESULTS.
+    static constexpr size_t MAX_NUM_ANGLE_RULES_RESULTS = 1000;
+    std::unordered_map<std::string, bool> mAngleRulesResults;
 };
 
 } // namespace android
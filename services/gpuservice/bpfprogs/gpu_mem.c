@@ -32,6 +32,16 @@
 DEFINE_BPF_MAP_GRO(gpu_mem_total_map, HASH, uint64_t, uint64_t, GPU_MEM_TOTAL_MAP_SIZE,
                    AID_GRAPHICS);
 
+/*
+ * This map holds the keys of gpu_mem_total_map updated since gpuservice last read them, so that
+ * gpuservice only needs to read the changed entries. It shares the keys of gpu_mem_total_map and
+ * thus its size. The values are unused.
+ *
+ * Pass AID_GRAPHICS as gid since gpuservice removes the keys it has read.
+ */
+DEFINE_BPF_MAP_GRW(gpu_mem_dirty_map, HASH, uint64_t, uint8_t, GPU_MEM_TOTAL_MAP_SIZE,
+                   AID_GRAPHICS);
+
 /* This struct aligns with the fields offsets of the raw tracepoint format */
 struct gpu_mem_total_args {
     uint64_t ignore;
@@ -46,13 +56,15 @@ struct gpu_mem_total_args {
  * {KEY, VAL} pair used to update the corresponding bpf map.
  *
  * Pass AID_GRAPHICS as gid since gpuservice is in the graphics group.
- * Upon seeing size 0, the corresponding KEY needs to be cleaned up.
+ * Upon seeing size 0, the corresponding KEY needs to be cleaned up. Either way the KEY is marked
+ * dirty after gpu_mem_total_map is updated.
  */
 DEFINE_BPF_PROG("tracepoint/gpu_mem/gpu_mem_total", AID_ROOT, AID_GRAPHICS, tp_gpu_mem_total)
 (struct gpu_mem_total_args* args) {
     uint64_t key = 0;
     uint64_t cur_val = 0;
     uint64_t* prev_val = NULL;
+    uint8_t dirty = 1;
 
     /* The upper 32 bits are for gpu_id while the lower is the pid */
     key = ((uint64_t)args->gpu_id << 32) | args->pid;
@@ -60,6 +72,7 @@ DEFINE_BPF_PROG("tracepoint/gpu_mem/gpu_mem_total", AID_ROOT, AID_GRAPHICS, tp_g
 
     if (!cur_val) {
         bpf_gpu_mem_total_map_delete_elem(&key);
+        bpf_gpu_mem_dirty_map_update_elem(&key, &dirty, BPF_ANY);
         return 0;
     }
 
@@ -69,6 +82,7 @@ DEFINE_BPF_PROG("tracepoint/gpu_mem/gpu_mem_total", AID_ROOT, AID_GRAPHICS, tp_g
     } else {
         bpf_gpu_mem_total_map_update_elem(&key, &cur_val, BPF_NOEXIST);
     }
+    bpf_gpu_mem_dirty_map_update_elem(&key, &dirty, BPF_ANY);
     return 0;
 }
 
@@ -74,43 +74,99 @@ void GpuMem::initialize() {
     }
     setGpuMemTotalMap(map);
 
+    // Without the dirty map, e.g. with an older bpf program, the whole total map is read on every
+    // access instead.
+    errno = 0;
+    auto dirtyMap = bpf::BpfMap<uint64_t, uint8_t>(kGpuMemDirtyMapPath);
+    if (dirtyMap.isValid()) {
+        setGpuMemDirtyMap(dirtyMap);
+    } else {
+        ALOGW("Failed to create bpf map from %s [%d(%s)]", kGpuMemDirtyMapPath, errno,
+              strerror(errno));
+    }
+
     mInitialized.store(true);
 }
 
 void GpuMem::setGpuMemTotalMap(bpf::BpfMap<uint64_t, uint64_t>& map) {
+    std::lock_guard<std::mutex> lock(mLock);
     mGpuMemTotalMap = std::move(map);
+    mGpuMemTotalsSynced = false;
 }
 
-// Dump the snapshots of global and per process memory usage on all gpus
-void GpuMem::dump(const Vector<String16>& /* args */, std::string* result) {
+void GpuMem::setGpuMemDirtyMap(bpf::BpfMap<uint64_t, uint8_t>& map) {
+    std::lock_guard<std::mutex> lock(mLock);
+    mGpuMemDirtyMap = std::move(map);
+    mGpuMemTotalsSynced = false;
+}
+
+void GpuMem::updateGpuMemTotalsLocked() {
     ATRACE_CALL();
 
-    if (!mInitialized.load() || !mGpuMemTotalMap.isValid()) {
-        result->append("Failed to initialize GPU memory eBPF\n");
-        return;
+    // Collect the dirty keys before removing them, as removing the current key would restart the
+    // traversal. The keys are removed before their values are read, so an update racing with the
+    // read marks its key dirty again for the next call.
+    std::vector<uint64_t> dirtyKeys;
+    if (mGpuMemDirtyMap.isValid()) {
+        auto res = mGpuMemDirtyMap.getFirstKey();
+        while (res.ok()) {
+            dirtyKeys.push_back(res.value());
+            res = mGpuMemDirtyMap.getNextKey(res.value());
+        }
+        for (uint64_t key : dirtyKeys) {
+            auto deleted = mGpuMemDirtyMap.deleteValue(key);
+            ALOGW_IF(!deleted.ok(), "Failed to delete key %" PRIu64 " from %s: %s", key,
+                     kGpuMemDirtyMapPath, deleted.error().message().c_str());
+        }
     }
 
-    auto res = mGpuMemTotalMap.getFirstKey();
-    if (!res.ok()) {
-        result->append("GPU memory total usage map is empty\n");
+    if (mGpuMemTotalsSynced) {
+        for (uint64_t key : dirtyKeys) {
+            auto res = mGpuMemTotalMap.readValue(key);
+            if (res.ok()) {
+                mGpuMemTotals[key] = res.value();
+            } else {
+                mGpuMemTotals.erase(key);
+            }
+        }
         return;
     }
-    uint64_t key = res.value();
-    // unordered_map<gpu_id, vector<pair<pid, size>>>
-    std::unordered_map<uint32_t, std::vector<std::pair<uint32_t, uint64_t>>> dumpMap;
-    while (true) {
-        uint32_t gpu_id = key >> 32;
-        uint32_t pid = key;
 
+    mGpuMemTotals.clear();
+    auto res = mGpuMemTotalMap.getFirstKey();
+    while (res.ok()) {
+        const uint64_t key = res.value();
         res = mGpuMemTotalMap.readValue(key);
         if (!res.ok()) break;
-        uint64_t size = res.value();
+        mGpuMemTotals[key] = res.value();
+        res = mGpuMemTotalMap.getNextKey(key);
+    }
+    mGpuMemTotalsSynced = mGpuMemDirtyMap.isValid();
+}
 
-        dumpMap[gpu_id].emplace_back(pid, size);
+// Dump the snapshots of global and per process memory usage on all gpus
+void GpuMem::dump(const Vector<String16>& /* args */, std::string* result) {
+    ATRACE_CALL();
 
-        res = mGpuMemTotalMap.getNextKey(key);
-        if (!res.ok()) break;
-        key = res.value();
+    if (!mInitialized.load() || !mGpuMemTotalMap.isValid()) {
+        result->append("Failed to initialize GPU memory eBPF\n");
+        return;
+    }
+
+    // unordered_map<gpu_id, vector<pair<pid, size>>>
+    std::unordered_map<uint32_t, std::vector<std::pair<uint32_t, uint64_t>>> dumpMap;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        updateGpuMemTotalsLocked();
+        if (mGpuMemTotals.empty()) {
+            result->append("GPU memory total usage map is empty\n");
+            return;
+        }
+        for (const auto& [key, size] : mGpuMemTotals) {
+            uint32_t gpu_id = key >> 32;
+            uint32_t pid = key;
+            dumpMap[gpu_id].emplace_back(pid, size);
+        }
     }
 
     for (auto& gpu : dumpMap) {
@@ -136,22 +192,30 @@ void GpuMem::dump(const Vector<String16>& /* args */, std::string* result) {
 
 void GpuMem::traverseGpuMemTotals(const std::function<void(int64_t ts, uint32_t gpuId, uint32_t pid,
                                                            uint64_t size)>& callback) {
-    auto res = mGpuMemTotalMap.getFirstKey();
-    if (!res.ok()) return;
-    uint64_t key = res.value();
-    while (true) {
+    // Run the callback on a copy, so that it can't block the other readers.
+    std::unordered_map<uint64_t, uint64_t> gpuMemTotals;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        updateGpuMemTotalsLocked();
+        gpuMemTotals = mGpuMemTotals;
+    }
+
+    for (const auto& [key, size] : gpuMemTotals) {
         uint32_t gpu_id = key >> 32;
         uint32_t pid = key;
+        callback(systemTime(), gpu_id, pid, size);
+    }
+}
 
-        res = mGpuMemTotalMap.readValue(key);
-        if (!res.ok()) break;
-        uint64_t size = res.value();
+uint64_t GpuMem::getProcessGpuMemTotal(uint32_t pid) {
+    std::lock_guard<std::mutex> lock(mLock);
+    updateGpuMemTotalsLocked();
 
-        callback(systemTime(), gpu_id, pid, size);
-        res = mGpuMemTotalMap.getNextKey(key);
-        if (!res.ok()) break;
-        key = res.value();
+    uint64_t total = 0;
+    for (const auto& [key, size] : mGpuMemTotals) {
+        if (static_cast<uint32_t>(key) == pid) total += size;
     }
+    return total;
 }
 
 } // namespace android
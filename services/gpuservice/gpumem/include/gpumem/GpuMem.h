@@ -21,6 +21,8 @@
 #include <utils/Vector.h>
 
 #include <functional>
+#include <mutex>
+#include <unordered_map>
 
 namespace android {
 
@@ -38,6 +40,8 @@ public:
     // Traverse the gpu memory total map to feed the callback function.
     void traverseGpuMemTotals(const std::function<void(int64_t ts, uint32_t gpuId, uint32_t pid,
                                                        uint64_t size)>& callback);
+    // Get the gpu memory total of a process summed over all gpus, 0 if it has none.
+    uint64_t getProcessGpuMemTotal(uint32_t pid);
 
 private:
     // Friend class for testing.
@@ -45,11 +49,26 @@ private:
 
     // set gpu memory total map
     void setGpuMemTotalMap(bpf::BpfMap<uint64_t, uint64_t>& map);
+    // set gpu memory dirty map
+    void setGpuMemDirtyMap(bpf::BpfMap<uint64_t, uint8_t>& map);
+
+    // Bring mGpuMemTotals up to date with the gpu memory total map. Only the keys in the dirty
+    // map are read once the mirror is in sync, the whole map otherwise. Requires mLock.
+    void updateGpuMemTotalsLocked();
 
     // indicate whether ebpf has been initialized
     std::atomic<bool> mInitialized = false;
     // bpf map for GPU memory total data
     android::bpf::BpfMap<uint64_t, uint64_t> mGpuMemTotalMap;
+    // bpf map for the keys of the GPU memory total data updated since last read
+    android::bpf::BpfMap<uint64_t, uint8_t> mGpuMemDirtyMap;
+
+    // Protect the userspace mirror of the gpu memory total map below.
+    std::mutex mLock;
+    // gpu memory total map contents, with the same keys
+    std::unordered_map<uint64_t, uint64_t> mGpuMemTotals;
+    // indicate whether mGpuMemTotals has been fully read from the map
+    bool mGpuMemTotalsSynced = false;
 
     // gpu memory tracepoint event category
     static constexpr char kGpuMemTraceGroup[] = "gpu_mem";
@@ -60,6 +79,8 @@ private:
             "/sys/fs/bpf/prog_gpu_mem_tracepoint_gpu_mem_gpu_mem_total";
     // pinned gpu memory total bpf map path in bpf sysfs
     static constexpr char kGpuMemTotalMapPath[] = "/sys/fs/bpf/map_gpu_mem_gpu_mem_total_map";
+    // pinned gpu memory dirty bpf map path in bpf sysfs
+    static constexpr char kGpuMemDirtyMapPath[] = "/sys/fs/bpf/map_gpu_mem_gpu_mem_dirty_map";
     // 30 seconds timeout for trying to attach bpf program to tracepoint
     static constexpr int kGpuWaitTimeout = 30;
 };
@@ -37,22 +37,21 @@ GpuStats::~GpuStats() {
     }
 }
 
-static void addLoadingCount(GpuStatsInfo::Driver driver, bool isDriverLoaded,
-                            GpuStatsGlobalInfo* const outGlobalInfo) {
+void GpuStats::GlobalStats::addLoadingCount(GpuStatsInfo::Driver driver, bool isDriverLoaded) {
     switch (driver) {
         case GpuStatsInfo::Driver::GL:
         case GpuStatsInfo::Driver::GL_UPDATED:
-            outGlobalInfo->glLoadingCount++;
-            if (!isDriverLoaded) outGlobalInfo->glLoadingFailureCount++;
+            glLoadingCount++;
+            if (!isDriverLoaded) glLoadingFailureCount++;
             break;
         case GpuStatsInfo::Driver::VULKAN:
         case GpuStatsInfo::Driver::VULKAN_UPDATED:
-            outGlobalInfo->vkLoadingCount++;
-            if (!isDriverLoaded) outGlobalInfo->vkLoadingFailureCount++;
+            vkLoadingCount++;
+            if (!isDriverLoaded) vkLoadingFailureCount++;
             break;
         case GpuStatsInfo::Driver::ANGLE:
-            outGlobalInfo->angleLoadingCount++;
-            if (!isDriverLoaded) outGlobalInfo->angleLoadingFailureCount++;
+            angleLoadingCount++;
+            if (!isDriverLoaded) angleLoadingFailureCount++;
             break;
         default:
             break;
@@ -84,6 +83,36 @@ static void addLoadingTime(GpuStatsInfo::Driver driver, int64_t driverLoadingTim
     }
 }
 
+GpuStatsGlobalInfo GpuStats::GlobalStats::toInfo() const {
+    GpuStatsGlobalInfo globalInfo = info;
+    globalInfo.glLoadingCount = glLoadingCount;
+    globalInfo.glLoadingFailureCount = glLoadingFailureCount;
+    globalInfo.vkLoadingCount = vkLoadingCount;
+    globalInfo.vkLoadingFailureCount = vkLoadingFailureCount;
+    globalInfo.angleLoadingCount = angleLoadingCount;
+    globalInfo.angleLoadingFailureCount = angleLoadingFailureCount;
+    return globalInfo;
+}
+
+size_t GpuStats::appStatsHash(const std::string& appPackageName, uint64_t driverVersionCode) {
+    const size_t hash = std::hash<std::string>{}(appPackageName);
+    return hash ^ (std::hash<uint64_t>{}(driverVersionCode) + 0x9e3779b9 + (hash << 6) +
+                   (hash >> 2));
+}
+
+GpuStatsAppInfo* GpuStats::findAppStatsLocked(AppStatsShard& shard, size_t hash,
+                                              const std::string& appPackageName,
+                                              uint64_t driverVersionCode) {
+    const auto range = shard.stats.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second.driverVersionCode == driverVersionCode &&
+            it->second.appPackageName == appPackageName) {
+            return &it->second;
+        }
+    }
+    return nullptr;
+}
+
 void GpuStats::insertDriverStats(const std::string& driverPackageName,
                                  const std::string& driverVersionName, uint64_t driverVersionCode,
                                  int64_t driverBuildTime, const std::string& appPackageName,
@@ -91,7 +120,6 @@ void GpuStats::insertDriverStats(const std::string& driverPackageName,
                                  bool isDriverLoaded, int64_t driverLoadingTime) {
     ATRACE_CALL();
 
-    std::lock_guard<std::mutex> lock(mLock);
     registerStatsdCallbacksIfNeeded();
     ALOGV("Received:\n"
           "\tdriverPackageName[%s]\n"
@@ -107,35 +135,44 @@ void GpuStats::insertDriverStats(const std::string& driverPackageName,
           appPackageName.c_str(), vulkanVersion, static_cast<int32_t>(driver), isDriverLoaded,
           driverLoadingTime);
 
-    if (!mGlobalStats.count(driverVersionCode)) {
-        GpuStatsGlobalInfo globalInfo;
-        addLoadingCount(driver, isDriverLoaded, &globalInfo);
-        globalInfo.driverPackageName = driverPackageName;
-        globalInfo.driverVersionName = driverVersionName;
-        globalInfo.driverVersionCode = driverVersionCode;
-        globalInfo.driverBuildTime = driverBuildTime;
-        globalInfo.vulkanVersion = vulkanVersion;
-        mGlobalStats.insert({driverVersionCode, globalInfo});
-    } else {
-        addLoadingCount(driver, isDriverLoaded, &mGlobalStats[driverVersionCode]);
+    {
+        std::shared_lock<std::shared_mutex> sharedLock(mGlobalLock);
+        auto it = mGlobalStats.find(driverVersionCode);
+        if (it != mGlobalStats.end()) {
+            it->second.addLoadingCount(driver, isDriverLoaded);
+        } else {
+            sharedLock.unlock();
+            std::lock_guard<std::shared_mutex> lock(mGlobalLock);
+            auto [inserted, isNew] = mGlobalStats.try_emplace(driverVersionCode);
+            if (isNew) {
+                GpuStatsGlobalInfo& globalInfo = inserted->second.info;
+                globalInfo.driverPackageName = driverPackageName;
+                globalInfo.driverVersionName = driverVersionName;
+                globalInfo.driverVersionCode = driverVersionCode;
+                globalInfo.driverBuildTime = driverBuildTime;
+                globalInfo.vulkanVersion = vulkanVersion;
+            }
+            inserted->second.addLoadingCount(driver, isDriverLoaded);
+        }
     }
 
-    const std::string appStatsKey = appPackageName + std::to_string(driverVersionCode);
-    if (!mAppStats.count(appStatsKey)) {
-        if (mAppStats.size() >= MAX_NUM_APP_RECORDS) {
+    const size_t hash = appStatsHash(appPackageName, driverVersionCode);
+    AppStatsShard& shard = appStatsShard(hash);
+    std::lock_guard<std::mutex> lock(shard.lock);
+    GpuStatsAppInfo* appInfo = findAppStatsLocked(shard, hash, appPackageName, driverVersionCode);
+    if (!appInfo) {
+        if (mNumAppStats.fetch_add(1) >= MAX_NUM_APP_RECORDS) {
+            mNumAppStats--;
             ALOGV("GpuStatsAppInfo has reached maximum size. Ignore new stats.");
             return;
         }
 
-        GpuStatsAppInfo appInfo;
-        addLoadingTime(driver, driverLoadingTime, &appInfo);
-        appInfo.appPackageName = appPackageName;
-        appInfo.driverVersionCode = driverVersionCode;
-        mAppStats.insert({appStatsKey, appInfo});
-        return;
+        appInfo = &shard.stats.emplace(hash, GpuStatsAppInfo())->second;
+        appInfo->appPackageName = appPackageName;
+        appInfo->driverVersionCode = driverVersionCode;
     }
 
-    addLoadingTime(driver, driverLoadingTime, &mAppStats[appStatsKey]);
+    addLoadingTime(driver, driverLoadingTime, appInfo);
 }
 
 void GpuStats::insertTargetStats(const std::string& appPackageName,
@@ -143,23 +180,25 @@ void GpuStats::insertTargetStats(const std::string& appPackageName,
                                  const uint64_t /*value*/) {
     ATRACE_CALL();
 
-    const std::string appStatsKey = appPackageName + std::to_string(driverVersionCode);
-
-    std::lock_guard<std::mutex> lock(mLock);
     registerStatsdCallbacksIfNeeded();
-    if (!mAppStats.count(appStatsKey)) {
+
+    const size_t hash = appStatsHash(appPackageName, driverVersionCode);
+    AppStatsShard& shard = appStatsShard(hash);
+    std::lock_guard<std::mutex> lock(shard.lock);
+    GpuStatsAppInfo* appInfo = findAppStatsLocked(shard, hash, appPackageName, driverVersionCode);
+    if (!appInfo) {
         return;
     }
 
     switch (stats) {
         case GpuStatsInfo::Stats::CPU_VULKAN_IN_USE:
-            mAppStats[appStatsKey].cpuVulkanInUse = true;
+            appInfo->cpuVulkanInUse = true;
             break;
         case GpuStatsInfo::Stats::FALSE_PREROTATION:
-            mAppStats[appStatsKey].falsePrerotation = true;
+            appInfo->falsePrerotation = true;
             break;
         case GpuStatsInfo::Stats::GLES_1_IN_USE:
-            mAppStats[appStatsKey].gles1InUse = true;
+            appInfo->gles1InUse = true;
             break;
         default:
             break;
@@ -168,22 +207,23 @@ void GpuStats::insertTargetStats(const std::string& appPackageName,
 
 void GpuStats::interceptSystemDriverStatsLocked() {
     // Append cpuVulkanVersion and glesVersion to system driver stats
-    if (!mGlobalStats.count(0) || mGlobalStats[0].glesVersion) {
+    auto it = mGlobalStats.find(0);
+    if (it == mGlobalStats.end() || it->second.info.glesVersion) {
         return;
     }
 
-    mGlobalStats[0].cpuVulkanVersion = property_get_int32("ro.cpuvulkan.version", 0);
-    mGlobalStats[0].glesVersion = property_get_int32("ro.opengles.version", 0);
+    it->second.info.cpuVulkanVersion = property_get_int32("ro.cpuvulkan.version", 0);
+    it->second.info.glesVersion = property_get_int32("ro.opengles.version", 0);
 }
 
 void GpuStats::registerStatsdCallbacksIfNeeded() {
-    if (!mStatsdRegistered) {
+    std::call_once(mStatsdRegisterOnce, [this] {
         AStatsManager_setPullAtomCallback(android::util::GPU_STATS_GLOBAL_INFO, nullptr,
                                          GpuStats::pullAtomCallback, this);
         AStatsManager_setPullAtomCallback(android::util::GPU_STATS_APP_INFO, nullptr,
                                          GpuStats::pullAtomCallback, this);
         mStatsdRegistered = true;
-    }
+    });
 }
 
 void GpuStats::dump(const Vector<String16>& args, std::string* result) {
@@ -194,64 +234,51 @@ void GpuStats::dump(const Vector<String16>& args, std::string* result) {
         return;
     }
 
-    std::lock_guard<std::mutex> lock(mLock);
-    bool dumpAll = true;
-
     std::unordered_set<std::string> argsSet;
     for (size_t i = 0; i < args.size(); i++) {
         argsSet.insert(String8(args[i]).c_str());
     }
 
-    const bool dumpGlobal = argsSet.count("--global") != 0;
-    if (dumpGlobal) {
-        dumpGlobalLocked(result);
-        dumpAll = false;
-    }
+    // Both global and app stats are dumped, and cleared if requested, unless
+    // only one of them is asked for.
+    const bool dumpAll = !argsSet.count("--global") && !argsSet.count("--app");
+    const bool clear = argsSet.count("--clear") != 0;
 
-    const bool dumpApp = argsSet.count("--app") != 0;
-    if (dumpApp) {
-        dumpAppLocked(result);
-        dumpAll = false;
+    if (dumpAll || argsSet.count("--global")) {
+        dumpGlobal(result, clear);
     }
 
-    if (dumpAll) {
-        dumpGlobalLocked(result);
-        dumpAppLocked(result);
-    }
-
-    if (argsSet.count("--clear")) {
-        bool clearAll = true;
-
-        if (dumpGlobal) {
-            mGlobalStats.clear();
-            clearAll = false;
-        }
-
-        if (dumpApp) {
-            mAppStats.clear();
-            clearAll = false;
-        }
-
-        if (clearAll) {
-            mGlobalStats.clear();
-            mAppStats.clear();
-        }
+    if (dumpAll || argsSet.count("--app")) {
+        dumpApp(result, clear);
     }
 }
 
-void GpuStats::dumpGlobalLocked(std::string* result) {
+void GpuStats::dumpGlobal(std::string* result, bool clear) {
+    std::lock_guard<std::shared_mutex> lock(mGlobalLock);
     interceptSystemDriverStatsLocked();
 
     for (const auto& ele : mGlobalStats) {
-        result->append(ele.second.toString());
+        result->append(ele.second.toInfo().toString());
         result->append("\n");
     }
+
+    if (clear) {
+        mGlobalStats.clear();
+    }
 }
 
-void GpuStats::dumpAppLocked(std::string* result) {
-    for (const auto& ele : mAppStats) {
-        result->append(ele.second.toString());
-        result->append("\n");
+void GpuStats::dumpApp(std::string* result, bool clear) {
+    for (auto& shard : mAppStats) {
+        std::lock_guard<std::mutex> lock(shard.lock);
+        for (const auto& ele : shard.stats) {
+            result->append(ele.second.toString());
+            result->append("\n");
+        }
+
+        if (clear) {
+            mNumAppStats -= shard.stats.size();
+            shard.stats.clear();
+        }
     }
 }
 
@@ -287,32 +314,34 @@ static std::string int64VectorToProtoByteString(const std::vector<int64_t>& valu
 AStatsManager_PullAtomCallbackReturn GpuStats::pullAppInfoAtom(AStatsEventList* data) {
     ATRACE_CALL();
 
-    std::lock_guard<std::mutex> lock(mLock);
-
-    if (data) {
-        for (const auto& ele : mAppStats) {
-            AStatsEvent* event = AStatsEventList_addStatsEvent(data);
-            AStatsEvent_setAtomId(event, android::util::GPU_STATS_APP_INFO);
-            AStatsEvent_writeString(event, ele.second.appPackageName.c_str());
-            AStatsEvent_writeInt64(event, ele.second.driverVersionCode);
+    for (auto& shard : mAppStats) {
+        std::lock_guard<std::mutex> lock(shard.lock);
+        if (data) {
+            for (const auto& ele : shard.stats) {
+                AStatsEvent* event = AStatsEventList_addStatsEvent(data);
+                AStatsEvent_setAtomId(event, android::util::GPU_STATS_APP_INFO);
+                AStatsEvent_writeString(event, ele.second.appPackageName.c_str());
+                AStatsEvent_writeInt64(event, ele.second.driverVersionCode);
 
-            std::string bytes = int64VectorToProtoByteString(ele.second.glDriverLoadingTime);
-            AStatsEvent_writeByteArray(event, (const uint8_t*)bytes.c_str(), bytes.length());
+                std::string bytes = int64VectorToProtoByteString(ele.second.glDriverLoadingTime);
+                AStatsEvent_writeByteArray(event, (const uint8_t*)bytes.c_str(), bytes.length());
 
-            bytes = int64VectorToProtoByteString(ele.second.vkDriverLoadingTime);
-            AStatsEvent_writeByteArray(event, (const uint8_t*)bytes.c_str(), bytes.length());
+                bytes = int64VectorToProtoByteString(ele.second.vkDriverLoadingTime);
+                AStatsEvent_writeByteArray(event, (const uint8_t*)bytes.c_str(), bytes.length());
 
-            bytes = int64VectorToProtoByteString(ele.second.angleDriverLoadingTime);
-            AStatsEvent_writeByteArray(event, (const uint8_t*)bytes.c_str(), bytes.length());
+                bytes = int64VectorToProtoByteString(ele.second.angleDriverLoadingTime);
+                AStatsEvent_writeByteArray(event, (const uint8_t*)bytes.c_str(), bytes.length());
 
-            AStatsEvent_writeBool(event, ele.second.cpuVulkanInUse);
-            AStatsEvent_writeBool(event, ele.second.falsePrerotation);
-            AStatsEvent_writeBool(event, ele.second.gles1InUse);
-            AStatsEvent_build(event);
+                AStatsEvent_writeBool(event, ele.second.cpuVulkanInUse);
+                AStatsEvent_writeBool(event, ele.second.falsePrerotation);
+                AStatsEvent_writeBool(event, ele.second.gles1InUse);
+                AStatsEvent_build(event);
+            }
         }
-    }
 
-    mAppStats.clear();
+        mNumAppStats -= shard.stats.size();
+        shard.stats.clear();
+    }
 
     return AStatsManager_PULL_SUCCESS;
 }
@@ -320,27 +349,28 @@ AStatsManager_PullAtomCallbackReturn GpuStats::pullAppInfoAtom(AStatsEventList*
 AStatsManager_PullAtomCallbackReturn GpuStats::pullGlobalInfoAtom(AStatsEventList* data) {
     ATRACE_CALL();
 
-    std::lock_guard<std::mutex> lock(mLock);
+    std::lock_guard<std::shared_mutex> lock(mGlobalLock);
     // flush cpuVulkanVersion and glesVersion to builtin driver stats
     interceptSystemDriverStatsLocked();
 
     if (data) {
-        for (const auto& ele : mGlobalStats) {
+        for (const auto& stats : mGlobalStats) {
+            const GpuStatsGlobalInfo ele = stats.second.toInfo();
             AStatsEvent* event = AStatsEventList_addStatsEvent(data);
             AStatsEvent_setAtomId(event, android::util::GPU_STATS_GLOBAL_INFO);
-            AStatsEvent_writeString(event, ele.second.driverPackageName.c_str());
-            AStatsEvent_writeString(event, ele.second.driverVersionName.c_str());
-            AStatsEvent_writeInt64(event, ele.second.driverVersionCode);
-            AStatsEvent_writeInt64(event, ele.second.driverBuildTime);
-            AStatsEvent_writeInt64(event, ele.second.glLoadingCount);
-            AStatsEvent_writeInt64(event, ele.second.glLoadingFailureCount);
-            AStatsEvent_writeInt64(event, ele.second.vkLoadingCount);
-            AStatsEvent_writeInt64(event, ele.second.vkLoadingFailureCount);
-            AStatsEvent_writeInt32(event, ele.second.vulkanVersion);
-            AStatsEvent_writeInt32(event, ele.second.cpuVulkanVersion);
-            AStatsEvent_writeInt32(event, ele.second.glesVersion);
-            AStatsEvent_writeInt64(event, ele.second.angleLoadingCount);
-            AStatsEvent_writeInt64(event, ele.second.angleLoadingFailureCount);
+            AStatsEvent_writeString(event, ele.driverPackageName.c_str());
+            AStatsEvent_writeString(event, ele.driverVersionName.c_str());
+            AStatsEvent_writeInt64(event, ele.driverVersionCode);
+            AStatsEvent_writeInt64(event, ele.driverBuildTime);
+            AStatsEvent_writeInt64(event, ele.glLoadingCount);
+            AStatsEvent_writeInt64(event, ele.glLoadingFailureCount);
+            AStatsEvent_writeInt64(event, ele.vkLoadingCount);
+            AStatsEvent_writeInt64(event, ele.vkLoadingFailureCount);
+            AStatsEvent_writeInt32(event, ele.vulkanVersion);
+            AStatsEvent_writeInt32(event, ele.cpuVulkanVersion);
+            AStatsEvent_writeInt32(event, ele.glesVersion);
+            AStatsEvent_writeInt64(event, ele.angleLoadingCount);
+            AStatsEvent_writeInt64(event, ele.angleLoadingFailureCount);
             AStatsEvent_build(event);
         }
     }
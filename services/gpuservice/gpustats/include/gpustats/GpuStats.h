@@ -22,7 +22,10 @@
 #include <utils/String16.h>
 #include <utils/Vector.h>
 
+#include <array>
+#include <atomic>
 #include <mutex>
+#include <shared_mutex>
 #include <unordered_map>
 #include <vector>
 
@@ -59,26 +62,60 @@ private:
     AStatsManager_PullAtomCallbackReturn pullGlobalInfoAtom(AStatsEventList* data);
     // Pull app into into app atom.
     AStatsManager_PullAtomCallbackReturn pullAppInfoAtom(AStatsEventList* data);
-    // Dump global stats
-    void dumpGlobalLocked(std::string* result);
-    // Dump app stats
-    void dumpAppLocked(std::string* result);
+    // Dump global stats, then clear them if requested
+    void dumpGlobal(std::string* result, bool clear);
+    // Dump app stats, then clear them if requested
+    void dumpApp(std::string* result, bool clear);
     // Append cpuVulkanVersion and glesVersion to system driver stats
     void interceptSystemDriverStatsLocked();
     // Registers statsd callbacks if they have not already been registered
     void registerStatsdCallbacksIfNeeded();
 
+    // Global stats of a driver. The loading counts are updated concurrently
+    // under a shared lock of mGlobalLock, the other fields never change.
+    struct GlobalStats {
+        GpuStatsGlobalInfo info;
+        std::atomic<int32_t> glLoadingCount{0};
+        std::atomic<int32_t> glLoadingFailureCount{0};
+        std::atomic<int32_t> vkLoadingCount{0};
+        std::atomic<int32_t> vkLoadingFailureCount{0};
+        std::atomic<int32_t> angleLoadingCount{0};
+        std::atomic<int32_t> angleLoadingFailureCount{0};
+
+        void addLoadingCount(GpuStatsInfo::Driver driver, bool isDriverLoaded);
+        // Returns info along with the current loading counts.
+        GpuStatsGlobalInfo toInfo() const;
+    };
+
+    // App stats are split into shards by the hash of their key, so that
+    // apps reporting stats at the same time rarely contend for a lock.
+    struct AppStatsShard {
+        std::mutex lock;
+        // Key is the hash of <app package name>+<driver version code>.
+        std::unordered_multimap<size_t, GpuStatsAppInfo> stats;
+    };
+    static constexpr size_t NUM_APP_STATS_SHARDS = 16;
+
+    static size_t appStatsHash(const std::string& appPackageName, uint64_t driverVersionCode);
+    AppStatsShard& appStatsShard(size_t hash) { return mAppStats[hash % NUM_APP_STATS_SHARDS]; }
+    static GpuStatsAppInfo* findAppStatsLocked(AppStatsShard& shard, size_t hash,
+                                               const std::string& appPackageName,
+                                               uint64_t driverVersionCode);
+
     // Below limits the memory usage of GpuStats to be less than 10KB. This is
     // the preferred number for statsd while maintaining nice data quality.
     static const size_t MAX_NUM_APP_RECORDS = 100;
-    // GpuStats access should be guarded by mLock.
-    std::mutex mLock;
     // True if statsd callbacks have been registered.
-    bool mStatsdRegistered = false;
+    std::once_flag mStatsdRegisterOnce;
+    std::atomic<bool> mStatsdRegistered = false;
+    // Guards the keys of mGlobalStats. Only inserting and clearing them needs
+    // an exclusive lock.
+    std::shared_mutex mGlobalLock;
     // Key is driver version code.
-    std::unordered_map<uint64_t, GpuStatsGlobalInfo> mGlobalStats;
-    // Key is <app package name>+<driver version code>.
-    std::unordered_map<std::string, GpuStatsAppInfo> mAppStats;
+    std::unordered_map<uint64_t, GlobalStats> mGlobalStats;
+    std::array<AppStatsShard, NUM_APP_STATS_SHARDS> mAppStats;
+    // Number of app stats across all the shards.
+    std::atomic<size_t> mNumAppStats = 0;
 };
 
 } // namespace android
@@ -91,6 +91,7 @@ TEST_F(GpuMemTest, validGpuMemTotalBpfPaths) {
     EXPECT_EQ(mTestableGpuMem.getGpuMemTotalProgPath(),
               "/sys/fs/bpf/prog_gpu_mem_tracepoint_gpu_mem_gpu_mem_total");
     EXPECT_EQ(mTestableGpuMem.getGpuMemTotalMapPath(), "/sys/fs/bpf/map_gpu_mem_gpu_mem_total_map");
+    EXPECT_EQ(mTestableGpuMem.getGpuMemDirtyMapPath(), "/sys/fs/bpf/map_gpu_mem_gpu_mem_dirty_map");
 }
 
 TEST_F(GpuMemTest, bpfInitializationFailed) {
@@ -167,5 +168,47 @@ TEST_F(GpuMemTest, traverseGpuMemTotals) {
     EXPECT_EQ(sCount, TEST_KEY_COUNT);
 }
 
+TEST_F(GpuMemTest, processMemTotal) {
+    ASSERT_RESULT_OK(mTestMap.writeValue(TEST_GLOBAL_KEY, TEST_GLOBAL_VAL, BPF_ANY));
+    ASSERT_RESULT_OK(mTestMap.writeValue(TEST_PROC_KEY_1, TEST_PROC_VAL_1, BPF_ANY));
+    ASSERT_RESULT_OK(mTestMap.writeValue(TEST_PROC_KEY_1 | (1ULL << 32), TEST_PROC_VAL_2, BPF_ANY));
+    mTestableGpuMem.setGpuMemTotalMap(mTestMap);
+
+    EXPECT_EQ(mGpuMem->getProcessGpuMemTotal((uint32_t)TEST_PROC_KEY_1),
+              TEST_PROC_VAL_1 + TEST_PROC_VAL_2);
+    EXPECT_EQ(mGpuMem->getProcessGpuMemTotal((uint32_t)TEST_PROC_KEY_2), 0u);
+}
+
+TEST_F(GpuMemTest, dirtyKeysUpdateMirror) {
+    errno = 0;
+    auto testDirtyMap = bpf::BpfMap<uint64_t, uint8_t>(BPF_MAP_TYPE_HASH, TEST_MAP_SIZE,
+                                                       BPF_F_NO_PREALLOC);
+    EXPECT_EQ(0, errno);
+    ASSERT_TRUE(testDirtyMap.isValid());
+
+    ASSERT_RESULT_OK(mTestMap.writeValue(TEST_PROC_KEY_1, TEST_PROC_VAL_1, BPF_ANY));
+    ASSERT_RESULT_OK(testDirtyMap.writeValue(TEST_PROC_KEY_1, 1, BPF_ANY));
+    mTestableGpuMem.setGpuMemTotalMap(mTestMap);
+    mTestableGpuMem.setGpuMemDirtyMap(testDirtyMap);
+    auto& totalMap = mTestableGpuMem.getGpuMemTotalMap();
+    auto& dirtyMap = mTestableGpuMem.getGpuMemDirtyMap();
+
+    // The first read takes the whole map and consumes the dirty keys.
+    EXPECT_EQ(mGpuMem->getProcessGpuMemTotal((uint32_t)TEST_PROC_KEY_1), TEST_PROC_VAL_1);
+    EXPECT_FALSE(dirtyMap.getFirstKey().ok());
+
+    // Updates are only read once their keys are marked dirty.
+    ASSERT_RESULT_OK(totalMap.writeValue(TEST_PROC_KEY_1, TEST_PROC_VAL_2, BPF_ANY));
+    EXPECT_EQ(mGpuMem->getProcessGpuMemTotal((uint32_t)TEST_PROC_KEY_1), TEST_PROC_VAL_1);
+    ASSERT_RESULT_OK(dirtyMap.writeValue(TEST_PROC_KEY_1, 1, BPF_ANY));
+    EXPECT_EQ(mGpuMem->getProcessGpuMemTotal((uint32_t)TEST_PROC_KEY_1), TEST_PROC_VAL_2);
+
+    // Removed keys are dropped from the mirror.
+    ASSERT_RESULT_OK(totalMap.deleteValue(TEST_PROC_KEY_1));
+    ASSERT_RESULT_OK(dirtyMap.writeValue(TEST_PROC_KEY_1, 1, BPF_ANY));
+    EXPECT_EQ(mGpuMem->getProcessGpuMemTotal((uint32_t)TEST_PROC_KEY_1), 0u);
+    EXPECT_EQ(dumpsys(), "GPU memory total usage map is empty\n");
+}
+
 } // namespace
 } // namespace android
@@ -26,6 +26,9 @@
 #include <utils/String16.h>
 #include <utils/Vector.h>
 
+#include <thread>
+#include <vector>
+
 #include "TestableGpuStats.h"
 
 namespace android {
@@ -167,6 +170,36 @@ TEST_F(GpuStatsTest, canInsertUpdatedDriverStats) {
     EXPECT_THAT(inputCommand(InputCommand::DUMP_APP), HasSubstr(expectedResult));
 }
 
+TEST_F(GpuStatsTest, canInsertDriverStatsConcurrently) {
+    constexpr int kNumThreads = 4;
+    constexpr int kNumInserts = 100;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kNumThreads; i++) {
+        threads.emplace_back([this, i] {
+            const std::string appPackageName = APP_PKG_NAME_1 + std::to_string(i);
+            for (int j = 0; j < kNumInserts; j++) {
+                mGpuStats->insertDriverStats(BUILTIN_DRIVER_PKG_NAME, BUILTIN_DRIVER_VER_NAME,
+                                             BUILTIN_DRIVER_VER_CODE, BUILTIN_DRIVER_BUILD_TIME,
+                                             appPackageName, VULKAN_VERSION,
+                                             GpuStatsInfo::Driver::GL, true,
+                                             DRIVER_LOADING_TIME_1);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    const std::string expectedResult =
+            "glLoadingCount = " + std::to_string(kNumThreads * kNumInserts);
+    EXPECT_THAT(inputCommand(InputCommand::DUMP_GLOBAL), HasSubstr(expectedResult));
+    for (int i = 0; i < kNumThreads; i++) {
+        EXPECT_THAT(inputCommand(InputCommand::DUMP_APP),
+                    HasSubstr("appPackageName = " + std::string(APP_PKG_NAME_1) +
+                              std::to_string(i) + "\n"));
+    }
+}
+
 TEST_F(GpuStatsTest, canInsertAngleDriverStats) {
     mGpuStats->insertDriverStats(UPDATED_DRIVER_PKG_NAME, UPDATED_DRIVER_VER_NAME,
                                  UPDATED_DRIVER_VER_CODE, UPDATED_DRIVER_BUILD_TIME, APP_PKG_NAME_2,
@@ -32,6 +32,14 @@ public:
         mGpuMem->setGpuMemTotalMap(map);
     }
 
+    void setGpuMemDirtyMap(bpf::BpfMap<uint64_t, uint8_t>& map) {
+        mGpuMem->setGpuMemDirtyMap(map);
+    }
+
+    bpf::BpfMap<uint64_t, uint64_t>& getGpuMemTotalMap() { return mGpuMem->mGpuMemTotalMap; }
+
+    bpf::BpfMap<uint64_t, uint8_t>& getGpuMemDirtyMap() { return mGpuMem->mGpuMemDirtyMap; }
+
     std::string getGpuMemTraceGroup() { return mGpuMem->kGpuMemTraceGroup; }
 
     std::string getGpuMemTotalTracepoint() { return mGpuMem->kGpuMemTotalTracepoint; }
@@ -40,6 +48,8 @@ public:
 
     std::string getGpuMemTotalMapPath() { return mGpuMem->kGpuMemTotalMapPath; }
 
+    std::string getGpuMemDirtyMapPath() { return mGpuMem->kGpuMemDirtyMapPath; }
+
 private:
     GpuMem *mGpuMem;
 };
@@ -19,7 +19,9 @@
 
 #include "android-base/thread_annotations.h"
 #include <condition_variable>
+#include <functional>
 #include <mutex>
+#include <optional>
 #include <vector>
 
 namespace android {
@@ -30,13 +32,14 @@ namespace android {
  * If the queue is full, new objects cannot be added.
  *
  * The action of retrieving an object will block until an element is available.
+ *
+ * The objects are stored in a ring buffer that is allocated up front, so adding and retrieving
+ * objects takes constant time and does not allocate.
  */
 template <class T>
 class BlockingQueue {
 public:
-    BlockingQueue(size_t capacity) : mCapacity(capacity) {
-        mQueue.reserve(mCapacity);
-    };
+    BlockingQueue(size_t capacity) : mCapacity(capacity), mQueue(capacity) {};
 
     /**
      * Retrieve and remove the oldest object.
@@ -45,9 +48,11 @@ public:
     T pop() {
         std::unique_lock lock(mLock);
         android::base::ScopedLockAssertion assumeLock(mLock);
-        mHasElements.wait(lock, [this]() REQUIRES(mLock) { return !this->mQueue.empty(); });
-        T t = std::move(mQueue.front());
-        mQueue.erase(mQueue.begin());
+        mHasElements.wait(lock, [this]() REQUIRES(mLock) { return this->mSize != 0; });
+        T t = std::move(*mQueue[mHead]);
+        mQueue[mHead].reset();
+        mHead = (mHead + 1) % mCapacity;
+        mSize--;
         return t;
     };
 
@@ -60,10 +65,11 @@ public:
     bool push(T&& t) {
         {
             std::scoped_lock lock(mLock);
-            if (mQueue.size() == mCapacity) {
+            if (mSize == mCapacity) {
                 return false;
             }
-            mQueue.push_back(std::move(t));
+            mQueue[(mHead + mSize) % mCapacity].emplace(std::move(t));
+            mSize++;
         }
         mHasElements.notify_one();
         return true;
@@ -71,8 +77,22 @@ public:
 
     void erase(const std::function<bool(const T&)>& lambda) {
         std::scoped_lock lock(mLock);
-        mQueue.erase(std::remove_if(mQueue.begin(), mQueue.end(),
-                [&lambda](const T& t) { return lambda(t); }), mQueue.end());
+        // Move the elements to keep towards the head, preserving their order.
+        size_t keptCount = 0;
+        for (size_t i = 0; i < mSize; i++) {
+            std::optional<T>& element = mQueue[(mHead + i) % mCapacity];
+            if (lambda(*element)) {
+                continue;
+            }
+            if (keptCount != i) {
+                mQueue[(mHead + keptCount) % mCapacity] = std::move(element);
+            }
+            keptCount++;
+        }
+        for (size_t i = keptCount; i < mSize; i++) {
+            mQueue[(mHead + i) % mCapacity].reset();
+        }
+        mSize = keptCount;
     }
 
     /**
@@ -81,7 +101,11 @@ public:
      */
     void clear() {
         std::scoped_lock lock(mLock);
-        mQueue.clear();
+        for (std::optional<T>& element : mQueue) {
+            element.reset();
+        }
+        mHead = 0;
+        mSize = 0;
     };
 
     /**
@@ -91,7 +115,7 @@ public:
      */
     size_t size() {
         std::scoped_lock lock(mLock);
-        return mQueue.size();
+        return mSize;
     }
 
 private:
@@ -104,7 +128,11 @@ private:
      * Lock for accessing and waiting on elements.
      */
     std::mutex mLock;
-    std::vector<T> mQueue GUARDED_BY(mLock);
+    // The ring buffer of mCapacity slots. The mSize elements start at index mHead and wrap
+    // around, the other slots are empty.
+    std::vector<std::optional<T>> mQueue GUARDED_BY(mLock);
+    size_t mHead GUARDED_BY(mLock) = 0;
+    size_t mSize GUARDED_BY(mLock) = 0;
 };
 
 
@@ -25,6 +25,7 @@ namespace android {
 
 /**
  * Convert from framework's NotifyMotionArgs to hidl's common::V1_0::MotionEvent
+ * The video frames of the returned event point to those of args, so it must not outlive args.
  */
 ::android::hardware::input::common::V1_0::MotionEvent notifyMotionArgsToHalMotionEvent(
         const NotifyMotionArgs& args);
@@ -24,8 +24,8 @@
 
 #include <binder/IPCThreadState.h>
 
+#include <inttypes.h>
 #include <log/log.h>
-#include <unordered_map>
 
 #include <private/android_filesystem_config.h>
 
@@ -105,13 +105,76 @@ public:
 void InputManager::setInputWindows(const std::vector<InputWindowInfo>& infos,
         const sp<ISetInputWindowsListener>& setInputWindowsListener) {
     std::unordered_map<int32_t, std::vector<sp<InputWindowHandle>>> handlesPerDisplay;
+    std::unordered_map<int32_t, sp<InputWindowHandle>> handlesById;
 
-    std::vector<sp<InputWindowHandle>> handles;
     for (const auto& info : infos) {
-        handlesPerDisplay.emplace(info.displayId, std::vector<sp<InputWindowHandle>>());
-        handlesPerDisplay[info.displayId].push_back(new BinderWindowHandle(info));
+        sp<InputWindowHandle> handle = new BinderWindowHandle(info);
+        handlesPerDisplay[info.displayId].push_back(handle);
+        handlesById[info.id] = handle;
+    }
+
+    {
+        std::scoped_lock lock(mInputWindowsLock);
+        mDispatcher->setInputWindows(handlesPerDisplay);
+        mInputWindowsGeneration = 0;
+        mInputWindowHandlesById = std::move(handlesById);
+        mInputWindowHandlesPerDisplay = std::move(handlesPerDisplay);
+    }
+
+    if (setInputWindowsListener) {
+        setInputWindowsListener->onSetInputWindowsFinished();
+    }
+}
+
+void InputManager::updateInputWindows(uint64_t generation, const std::vector<int32_t>& windowIds,
+        const std::vector<InputWindowInfo>& changedWindows,
+        const sp<ISetInputWindowsListener>& setInputWindowsListener) {
+    {
+        std::scoped_lock lock(mInputWindowsLock);
+        if (generation != mInputWindowsGeneration + 1) {
+            ALOGW("Input windows update %" PRIu64 " does not follow update %" PRIu64
+                  ", windows may be missing",
+                  generation, mInputWindowsGeneration);
+        }
+        mInputWindowsGeneration = generation;
+
+        for (const auto& info : changedWindows) {
+            mInputWindowHandlesById[info.id] = new BinderWindowHandle(info);
+        }
+
+        // The windows which did not change keep their handles, so that a display only needs to
+        // be updated in the dispatcher if its list of handles differs.
+        std::unordered_map<int32_t, std::vector<sp<InputWindowHandle>>> handlesPerDisplay;
+        std::unordered_map<int32_t, sp<InputWindowHandle>> handlesById;
+        for (int32_t id : windowIds) {
+            auto it = mInputWindowHandlesById.find(id);
+            if (it == mInputWindowHandlesById.end()) {
+                ALOGE("Ignoring unknown input window %" PRId32, id);
+                continue;
+            }
+            handlesPerDisplay[it->second->getInfo()->displayId].push_back(it->second);
+            handlesById.insert(*it);
+        }
+
+        std::unordered_map<int32_t, std::vector<sp<InputWindowHandle>>> changedDisplays;
+        for (const auto& [displayId, handles] : handlesPerDisplay) {
+            auto it = mInputWindowHandlesPerDisplay.find(displayId);
+            if (it == mInputWindowHandlesPerDisplay.end() || it->second != handles) {
+                changedDisplays.emplace(displayId, handles);
+            }
+        }
+        for (const auto& [displayId, _] : mInputWindowHandlesPerDisplay) {
+            if (handlesPerDisplay.find(displayId) == handlesPerDisplay.end()) {
+                changedDisplays.emplace(displayId, std::vector<sp<InputWindowHandle>>());
+            }
+        }
+
+        if (!changedDisplays.empty()) {
+            mDispatcher->setInputWindows(changedDisplays);
+        }
+        mInputWindowHandlesById = std::move(handlesById);
+        mInputWindowHandlesPerDisplay = std::move(handlesPerDisplay);
     }
-    mDispatcher->setInputWindows(handlesPerDisplay);
 
     if (setInputWindowsListener) {
         setInputWindowsListener->onSetInputWindowsFinished();
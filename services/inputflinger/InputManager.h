@@ -36,6 +36,9 @@
 #include <utils/Timers.h>
 #include <utils/RefBase.h>
 
+#include <mutex>
+#include <unordered_map>
+
 namespace android {
 class InputChannel;
 class InputDispatcherThread;
@@ -96,6 +99,9 @@ public:
 
     virtual void setInputWindows(const std::vector<InputWindowInfo>& handles,
             const sp<ISetInputWindowsListener>& setInputWindowsListener);
+    virtual void updateInputWindows(uint64_t generation, const std::vector<int32_t>& windowIds,
+            const std::vector<InputWindowInfo>& changedWindows,
+            const sp<ISetInputWindowsListener>& setInputWindowsListener);
 
     virtual void registerInputChannel(const sp<InputChannel>& channel);
     virtual void unregisterInputChannel(const sp<InputChannel>& channel);
@@ -108,6 +114,13 @@ private:
     sp<InputClassifierInterface> mClassifier;
 
     sp<InputDispatcherInterface> mDispatcher;
+
+    // The input windows last sent to the dispatcher, which updateInputWindows applies the
+    // changes to.
+    std::mutex mInputWindowsLock;
+    uint64_t mInputWindowsGeneration = 0;
+    std::unordered_map<int32_t, sp<InputWindowHandle>> mInputWindowHandlesById;
+    std::unordered_map<int32_t, std::vector<sp<InputWindowHandle>>> mInputWindowHandlesPerDisplay;
 };
 
 } // namespace android
@@ -17,6 +17,7 @@
 #include <benchmark/benchmark.h>
 
 #include <binder/Binder.h>
+#include <algorithm>
 #include "../dispatcher/InputDispatcher.h"
 
 namespace android::inputdispatcher {
@@ -105,9 +106,9 @@ public:
 
 class FakeInputReceiver {
 public:
-    void consumeEvent() {
+    InputEvent* consumeEvent() {
         uint32_t consumeSeq;
-        InputEvent* event;
+        InputEvent* event = nullptr;
 
         std::chrono::time_point start = std::chrono::steady_clock::now();
         status_t result = WOULD_BLOCK;
@@ -122,13 +123,32 @@ public:
         }
         if (result != OK) {
             ALOGE("Received result = %d from consume()", result);
+            return nullptr;
+        }
+        if (event->getType() == AINPUT_EVENT_TYPE_MOTION) {
+            mLatencies.push_back(now() - static_cast<MotionEvent*>(event)->getEventTime());
         }
         result = mConsumer->sendFinishedSignal(consumeSeq, true);
         if (result != OK) {
             ALOGE("Received result = %d from sendFinishedSignal", result);
         }
+        return event;
+    }
+
+    // Consumes events until a motion event with the given masked action, e.g. the end of a
+    // gesture whose events may have been split, batched or coalesced along the way.
+    void consumeUntil(int32_t actionMasked) {
+        while (InputEvent* event = consumeEvent()) {
+            if (event->getType() == AINPUT_EVENT_TYPE_MOTION &&
+                static_cast<MotionEvent*>(event)->getActionMasked() == actionMasked) {
+                return;
+            }
+        }
     }
 
+    // The time from notifying the dispatcher of each consumed motion event until it was consumed.
+    const std::vector<nsecs_t>& getLatencies() const { return mLatencies; }
+
 protected:
     explicit FakeInputReceiver(const sp<InputDispatcher>& dispatcher, const std::string name)
           : mDispatcher(dispatcher) {
@@ -142,6 +162,16 @@ protected:
     sp<InputChannel> mServerChannel, mClientChannel;
     std::unique_ptr<InputConsumer> mConsumer;
     PreallocatedInputEventFactory mEventFactory;
+    std::vector<nsecs_t> mLatencies;
+};
+
+class FakeMonitorReceiver : public FakeInputReceiver {
+public:
+    FakeMonitorReceiver(const sp<InputDispatcher>& dispatcher, const std::string name)
+          : FakeInputReceiver(dispatcher, name) {
+        mDispatcher->registerInputMonitor(mServerChannel, ADISPLAY_ID_DEFAULT,
+                                          false /*isGestureMonitor*/);
+    }
 };
 
 class FakeWindowHandle : public InputWindowHandle, public FakeInputReceiver {
@@ -150,8 +180,11 @@ public:
     static const int32_t HEIGHT = 200;
 
     FakeWindowHandle(const sp<InputApplicationHandle>& inputApplicationHandle,
-                     const sp<InputDispatcher>& dispatcher, const std::string name)
-          : FakeInputReceiver(dispatcher, name), mFrame(Rect(0, 0, WIDTH, HEIGHT)) {
+                     const sp<InputDispatcher>& dispatcher, const std::string name,
+                     const Rect& frame = Rect(0, 0, WIDTH, HEIGHT), int32_t layoutParamsFlags = 0)
+          : FakeInputReceiver(dispatcher, name),
+            mFrame(frame),
+            mLayoutParamsFlags(layoutParamsFlags) {
         mDispatcher->registerInputChannel(mServerChannel);
 
         inputApplicationHandle->updateInfo();
@@ -161,7 +194,7 @@ public:
     virtual bool updateInfo() override {
         mInfo.token = mServerChannel->getConnectionToken();
         mInfo.name = "FakeWindowHandle";
-        mInfo.layoutParamsFlags = 0;
+        mInfo.layoutParamsFlags = mLayoutParamsFlags;
         mInfo.layoutParamsType = InputWindowInfo::TYPE_APPLICATION;
         mInfo.dispatchingTimeout = DISPATCHING_TIMEOUT.count();
         mInfo.frameLeft = mFrame.left;
@@ -186,6 +219,7 @@ public:
 
 protected:
     Rect mFrame;
+    int32_t mLayoutParamsFlags;
 };
 
 static MotionEvent generateMotionEvent() {
@@ -215,7 +249,7 @@ static MotionEvent generateMotionEvent() {
     return event;
 }
 
-static NotifyMotionArgs generateMotionArgs() {
+static NotifyMotionArgs generateMotionArgs(float x = 100, float y = 100) {
     PointerProperties pointerProperties[1];
     PointerCoords pointerCoords[1];
 
@@ -224,8 +258,8 @@ static NotifyMotionArgs generateMotionArgs() {
     pointerProperties[0].toolType = AMOTION_EVENT_TOOL_TYPE_FINGER;
 
     pointerCoords[0].clear();
-    pointerCoords[0].setAxisValue(AMOTION_EVENT_AXIS_X, 100);
-    pointerCoords[0].setAxisValue(AMOTION_EVENT_AXIS_Y, 100);
+    pointerCoords[0].setAxisValue(AMOTION_EVENT_AXIS_X, x);
+    pointerCoords[0].setAxisValue(AMOTION_EVENT_AXIS_Y, y);
 
     const nsecs_t currentTime = now();
     // Define a valid motion event.
@@ -241,6 +275,59 @@ static NotifyMotionArgs generateMotionArgs() {
     return args;
 }
 
+/**
+ * Generates a motion with pointerCount pointers, pointer i being at the center of the i-th
+ * window of a row of windows of size FakeWindowHandle::WIDTH x FakeWindowHandle::HEIGHT.
+ */
+static NotifyMotionArgs generateMultiPointerMotionArgs(int32_t action, size_t pointerCount,
+                                                       nsecs_t downTime) {
+    PointerProperties pointerProperties[MAX_POINTERS];
+    PointerCoords pointerCoords[MAX_POINTERS];
+    for (size_t i = 0; i < pointerCount; i++) {
+        pointerProperties[i].clear();
+        pointerProperties[i].id = i;
+        pointerProperties[i].toolType = AMOTION_EVENT_TOOL_TYPE_FINGER;
+
+        pointerCoords[i].clear();
+        pointerCoords[i].setAxisValue(AMOTION_EVENT_AXIS_X,
+                                      i * FakeWindowHandle::WIDTH + FakeWindowHandle::WIDTH / 2);
+        pointerCoords[i].setAxisValue(AMOTION_EVENT_AXIS_Y, FakeWindowHandle::HEIGHT / 2);
+    }
+
+    const nsecs_t currentTime = now();
+    return NotifyMotionArgs(/* id */ 0, currentTime, DEVICE_ID, AINPUT_SOURCE_TOUCHSCREEN,
+                            ADISPLAY_ID_DEFAULT, POLICY_FLAG_PASS_TO_USER, action,
+                            /* actionButton */ 0, /* flags */ 0, AMETA_NONE, /* buttonState */ 0,
+                            MotionClassification::NONE, AMOTION_EVENT_EDGE_FLAG_NONE, pointerCount,
+                            pointerProperties, pointerCoords,
+                            /* xPrecision */ 0, /* yPrecision */ 0,
+                            AMOTION_EVENT_INVALID_CURSOR_POSITION,
+                            AMOTION_EVENT_INVALID_CURSOR_POSITION, downTime, /* videoFrames */ {});
+}
+
+/**
+ * Reports the throughput of the benchmark, and the percentiles of the time from notifying the
+ * dispatcher of an event until a receiver consumed it.
+ */
+static void reportDispatchStatistics(benchmark::State& state, int64_t eventsPerIteration,
+                                     const std::vector<const FakeInputReceiver*>& receivers) {
+    state.SetItemsProcessed(state.iterations() * eventsPerIteration);
+
+    std::vector<nsecs_t> latencies;
+    for (const FakeInputReceiver* receiver : receivers) {
+        const std::vector<nsecs_t>& receiverLatencies = receiver->getLatencies();
+        latencies.insert(latencies.end(), receiverLatencies.begin(), receiverLatencies.end());
+    }
+    if (latencies.empty()) {
+        return;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    for (int percentile : {50, 90, 99}) {
+        const nsecs_t latency = latencies[(latencies.size() - 1) * percentile / 100];
+        state.counters["latency_p" + std::to_string(percentile) + "_us"] = latency / 1000.0;
+    }
+}
+
 static void benchmarkNotifyMotion(benchmark::State& state) {
     // Create dispatcher
     sp<FakeInputDispatcherPolicy> fakePolicy = new FakeInputDispatcherPolicy();
@@ -274,6 +361,7 @@ static void benchmarkNotifyMotion(benchmark::State& state) {
         window->consumeEvent();
     }
 
+    reportDispatchStatistics(state, 2, {window.get()});
     dispatcher->stop();
 }
 
@@ -310,8 +398,226 @@ static void benchmarkInjectMotion(benchmark::State& state) {
     dispatcher->stop();
 }
 
+/**
+ * Like benchmarkNotifyMotion, but with state.range(0) non-modal windows tiled across the display
+ * and the touch landing on the bottom-most one, like in freeform and multi-window layouts.
+ */
+static void benchmarkNotifyMotionManyWindows(benchmark::State& state) {
+    // Create dispatcher
+    sp<FakeInputDispatcherPolicy> fakePolicy = new FakeInputDispatcherPolicy();
+    sp<InputDispatcher> dispatcher = new InputDispatcher(fakePolicy);
+    dispatcher->setInputDispatchMode(/*enabled*/ true, /*frozen*/ false);
+    dispatcher->start();
+
+    // Create the windows, front to back, in rows of 8
+    const int32_t windowCount = state.range(0);
+    sp<FakeApplicationHandle> application = new FakeApplicationHandle();
+    std::vector<sp<InputWindowHandle>> windows;
+    sp<FakeWindowHandle> touchedWindow;
+    for (int32_t i = 0; i < windowCount; i++) {
+        const int32_t left = (i % 8) * FakeWindowHandle::WIDTH;
+        const int32_t top = (i / 8) * FakeWindowHandle::HEIGHT;
+        touchedWindow = new FakeWindowHandle(application, dispatcher,
+                                             "Fake Window " + std::to_string(i),
+                                             Rect(left, top, left + FakeWindowHandle::WIDTH,
+                                                  top + FakeWindowHandle::HEIGHT),
+                                             InputWindowInfo::FLAG_NOT_TOUCH_MODAL);
+        windows.push_back(touchedWindow);
+    }
+
+    dispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, windows}});
+
+    const Rect& frame = touchedWindow->getInfo()->touchableRegion.getBounds();
+    NotifyMotionArgs motionArgs =
+            generateMotionArgs(frame.left + FakeWindowHandle::WIDTH / 2,
+                               frame.top + FakeWindowHandle::HEIGHT / 2);
+
+    for (auto _ : state) {
+        // Send ACTION_DOWN
+        motionArgs.action = AMOTION_EVENT_ACTION_DOWN;
+        motionArgs.id = 0;
+        motionArgs.downTime = now();
+        motionArgs.eventTime = motionArgs.downTime;
+        dispatcher->notifyMotion(&motionArgs);
+
+        // Send ACTION_UP
+        motionArgs.action = AMOTION_EVENT_ACTION_UP;
+        motionArgs.id = 1;
+        motionArgs.eventTime = now();
+        dispatcher->notifyMotion(&motionArgs);
+
+        touchedWindow->consumeEvent();
+        touchedWindow->consumeEvent();
+    }
+
+    reportDispatchStatistics(state, 2, {touchedWindow.get()});
+    dispatcher->stop();
+}
+
+/**
+ * Like benchmarkNotifyMotion, but with state.range(0) global monitors on the display, like the
+ * gesture navigation, accessibility and debugging overlays, each receiving every event.
+ */
+static void benchmarkNotifyMotionMonitors(benchmark::State& state) {
+    // Create dispatcher
+    sp<FakeInputDispatcherPolicy> fakePolicy = new FakeInputDispatcherPolicy();
+    sp<InputDispatcher> dispatcher = new InputDispatcher(fakePolicy);
+    dispatcher->setInputDispatchMode(/*enabled*/ true, /*frozen*/ false);
+    dispatcher->start();
+
+    sp<FakeApplicationHandle> application = new FakeApplicationHandle();
+    sp<FakeWindowHandle> window = new FakeWindowHandle(application, dispatcher, "Fake Window");
+    dispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, {window}}});
+
+    std::vector<std::unique_ptr<FakeMonitorReceiver>> monitors;
+    std::vector<const FakeInputReceiver*> receivers = {window.get()};
+    for (int64_t i = 0; i < state.range(0); i++) {
+        monitors.push_back(
+                std::make_unique<FakeMonitorReceiver>(dispatcher,
+                                                      "Fake Monitor " + std::to_string(i)));
+        receivers.push_back(monitors.back().get());
+    }
+
+    NotifyMotionArgs motionArgs = generateMotionArgs();
+
+    for (auto _ : state) {
+        // Send ACTION_DOWN
+        motionArgs.action = AMOTION_EVENT_ACTION_DOWN;
+        motionArgs.id = 0;
+        motionArgs.downTime = now();
+        motionArgs.eventTime = motionArgs.downTime;
+        dispatcher->notifyMotion(&motionArgs);
+
+        // Send ACTION_UP
+        motionArgs.action = AMOTION_EVENT_ACTION_UP;
+        motionArgs.id = 1;
+        motionArgs.eventTime = now();
+        dispatcher->notifyMotion(&motionArgs);
+
+        window->consumeEvent();
+        window->consumeEvent();
+        for (const std::unique_ptr<FakeMonitorReceiver>& monitor : monitors) {
+            monitor->consumeEvent();
+            monitor->consumeEvent();
+        }
+    }
+
+    reportDispatchStatistics(state, 2, receivers);
+    dispatcher->stop();
+}
+
+/**
+ * A gesture of state.range(0) pointers, each in its own split-touch window of a row of windows:
+ * the pointers go down one by one, move together and go up one by one.
+ */
+static void benchmarkNotifyMotionSplitTouch(benchmark::State& state) {
+    // Create dispatcher
+    sp<FakeInputDispatcherPolicy> fakePolicy = new FakeInputDispatcherPolicy();
+    sp<InputDispatcher> dispatcher = new InputDispatcher(fakePolicy);
+    dispatcher->setInputDispatchMode(/*enabled*/ true, /*frozen*/ false);
+    dispatcher->start();
+
+    const size_t pointerCount = state.range(0);
+    sp<FakeApplicationHandle> application = new FakeApplicationHandle();
+    std::vector<sp<InputWindowHandle>> windows;
+    std::vector<sp<FakeWindowHandle>> fakeWindows;
+    std::vector<const FakeInputReceiver*> receivers;
+    for (size_t i = 0; i < pointerCount; i++) {
+        const int32_t left = i * FakeWindowHandle::WIDTH;
+        sp<FakeWindowHandle> window =
+                new FakeWindowHandle(application, dispatcher, "Fake Window " + std::to_string(i),
+                                     Rect(left, 0, left + FakeWindowHandle::WIDTH,
+                                          FakeWindowHandle::HEIGHT),
+                                     InputWindowInfo::FLAG_NOT_TOUCH_MODAL |
+                                             InputWindowInfo::FLAG_SPLIT_TOUCH);
+        windows.push_back(window);
+        fakeWindows.push_back(window);
+        receivers.push_back(window.get());
+    }
+
+    dispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, windows}});
+
+    for (auto _ : state) {
+        const nsecs_t downTime = now();
+        NotifyMotionArgs motionArgs =
+                generateMultiPointerMotionArgs(AMOTION_EVENT_ACTION_DOWN, 1, downTime);
+        dispatcher->notifyMotion(&motionArgs);
+        for (size_t i = 1; i < pointerCount; i++) {
+            const int32_t action = AMOTION_EVENT_ACTION_POINTER_DOWN |
+                    (i << AMOTION_EVENT_ACTION_POINTER_INDEX_SHIFT);
+            motionArgs = generateMultiPointerMotionArgs(action, i + 1, downTime);
+            dispatcher->notifyMotion(&motionArgs);
+        }
+
+        motionArgs =
+                generateMultiPointerMotionArgs(AMOTION_EVENT_ACTION_MOVE, pointerCount, downTime);
+        dispatcher->notifyMotion(&motionArgs);
+
+        for (size_t i = pointerCount - 1; i > 0; i--) {
+            const int32_t action = AMOTION_EVENT_ACTION_POINTER_UP |
+                    (i << AMOTION_EVENT_ACTION_POINTER_INDEX_SHIFT);
+            motionArgs = generateMultiPointerMotionArgs(action, i + 1, downTime);
+            dispatcher->notifyMotion(&motionArgs);
+        }
+        motionArgs = generateMultiPointerMotionArgs(AMOTION_EVENT_ACTION_UP, 1, downTime);
+        dispatcher->notifyMotion(&motionArgs);
+
+        for (const sp<FakeWindowHandle>& window : fakeWindows) {
+            window->consumeUntil(AMOTION_EVENT_ACTION_UP);
+        }
+    }
+
+    reportDispatchStatistics(state, 2 * pointerCount + 1, receivers);
+    dispatcher->stop();
+}
+
+/**
+ * A gesture with state.range(0) moves that are all sent before the window consumes any of them,
+ * like a window that falls behind: the moves pile up in its channel and outbound queue.
+ */
+static void benchmarkNotifyMotionSlowConsumer(benchmark::State& state) {
+    // Create dispatcher
+    sp<FakeInputDispatcherPolicy> fakePolicy = new FakeInputDispatcherPolicy();
+    sp<InputDispatcher> dispatcher = new InputDispatcher(fakePolicy);
+    dispatcher->setInputDispatchMode(/*enabled*/ true, /*frozen*/ false);
+    dispatcher->start();
+
+    sp<FakeApplicationHandle> application = new FakeApplicationHandle();
+    sp<FakeWindowHandle> window = new FakeWindowHandle(application, dispatcher, "Fake Window");
+    dispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, {window}}});
+
+    const int64_t moveCount = state.range(0);
+
+    for (auto _ : state) {
+        NotifyMotionArgs motionArgs = generateMotionArgs();
+        motionArgs.downTime = now();
+        motionArgs.eventTime = motionArgs.downTime;
+        dispatcher->notifyMotion(&motionArgs);
+
+        motionArgs.action = AMOTION_EVENT_ACTION_MOVE;
+        for (int64_t i = 0; i < moveCount; i++) {
+            motionArgs.eventTime = now();
+            motionArgs.pointerCoords[0].setAxisValue(AMOTION_EVENT_AXIS_X, 100 + i % 50);
+            dispatcher->notifyMotion(&motionArgs);
+        }
+
+        motionArgs.action = AMOTION_EVENT_ACTION_UP;
+        motionArgs.eventTime = now();
+        dispatcher->notifyMotion(&motionArgs);
+
+        window->consumeUntil(AMOTION_EVENT_ACTION_UP);
+    }
+
+    reportDispatchStatistics(state, moveCount + 2, {window.get()});
+    dispatcher->stop();
+}
+
 BENCHMARK(benchmarkNotifyMotion);
 BENCHMARK(benchmarkInjectMotion);
+BENCHMARK(benchmarkNotifyMotionManyWindows)->Arg(8)->Arg(32)->Arg(64);
+BENCHMARK(benchmarkNotifyMotionMonitors)->Arg(1)->Arg(4)->Arg(8);
+BENCHMARK(benchmarkNotifyMotionSplitTouch)->Arg(1)->Arg(2)->Arg(5)->Arg(10);
+BENCHMARK(benchmarkNotifyMotionSlowConsumer)->Arg(10)->Arg(100)->Arg(500);
 
 } // namespace android::inputdispatcher
 
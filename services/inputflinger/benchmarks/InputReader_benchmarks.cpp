@@ -0,0 +1,268 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <InputReader.h>
+#include <linux/input.h>
+
+namespace android {
+
+// An arbitrary device id.
+static const int32_t DEVICE_ID = 1;
+
+static const int32_t DISPLAY_WIDTH = 1080;
+static const int32_t DISPLAY_HEIGHT = 1920;
+static const int32_t SLOT_COUNT = 10;
+
+static nsecs_t now() {
+    return systemTime(SYSTEM_TIME_MONOTONIC);
+}
+
+// --- FakeEventHub ---
+
+/**
+ * An event hub with a single multi-touch screen, whose raw events are queued by the benchmark.
+ */
+class FakeEventHub : public EventHubInterface {
+public:
+    FakeEventHub() {
+        mIdentifier.name = "Fake Touchscreen";
+        mConfiguration.addProperty(String8("touch.deviceType"), String8("touchScreen"));
+        enqueueEvent(0, DEVICE_ID, DEVICE_ADDED, 0, 0);
+        enqueueEvent(0, 0, FINISHED_DEVICE_SCAN, 0, 0);
+    }
+
+    void enqueueEvent(nsecs_t when, int32_t deviceId, int32_t type, int32_t code, int32_t value) {
+        RawEvent event;
+        event.when = when;
+        event.deviceId = deviceId;
+        event.type = type;
+        event.code = code;
+        event.value = value;
+        mEvents.push_back(event);
+    }
+
+    uint32_t getDeviceClasses(int32_t) const override {
+        return INPUT_DEVICE_CLASS_TOUCH | INPUT_DEVICE_CLASS_TOUCH_MT;
+    }
+    InputDeviceIdentifier getDeviceIdentifier(int32_t) const override { return mIdentifier; }
+    int32_t getDeviceControllerNumber(int32_t) const override { return 0; }
+    void getConfiguration(int32_t, PropertyMap* outConfiguration) const override {
+        *outConfiguration = mConfiguration;
+    }
+    status_t getAbsoluteAxisInfo(int32_t, int axis,
+                                 RawAbsoluteAxisInfo* outAxisInfo) const override {
+        outAxisInfo->clear();
+        switch (axis) {
+            case ABS_MT_SLOT:
+                outAxisInfo->maxValue = SLOT_COUNT - 1;
+                break;
+            case ABS_MT_TRACKING_ID:
+                outAxisInfo->maxValue = 0xffff;
+                break;
+            case ABS_MT_POSITION_X:
+                outAxisInfo->maxValue = DISPLAY_WIDTH - 1;
+                break;
+            case ABS_MT_POSITION_Y:
+                outAxisInfo->maxValue = DISPLAY_HEIGHT - 1;
+                break;
+            default:
+                return -1;
+        }
+        outAxisInfo->valid = true;
+        return OK;
+    }
+    bool hasRelativeAxis(int32_t, int) const override { return false; }
+    bool hasInputProperty(int32_t, int property) const override {
+        return property == INPUT_PROP_DIRECT;
+    }
+    status_t mapKey(int32_t, int32_t, int32_t, int32_t, int32_t*, int32_t*,
+                    uint32_t*) const override {
+        return NAME_NOT_FOUND;
+    }
+    status_t mapAxis(int32_t, int32_t, AxisInfo*) const override { return NAME_NOT_FOUND; }
+    void setExcludedDevices(const std::vector<std::string>&) override {}
+    size_t getEvents(int, RawEvent* buffer, size_t bufferSize) override {
+        const size_t count = std::min(bufferSize, mEvents.size());
+        std::copy(mEvents.begin(), mEvents.begin() + count, buffer);
+        mEvents.erase(mEvents.begin(), mEvents.begin() + count);
+        return count;
+    }
+    std::vector<TouchVideoFrame> getVideoFrames(int32_t) override { return {}; }
+    int32_t getScanCodeState(int32_t, int32_t) const override { return AKEY_STATE_UNKNOWN; }
+    int32_t getKeyCodeState(int32_t, int32_t) const override { return AKEY_STATE_UNKNOWN; }
+    int32_t getSwitchState(int32_t, int32_t) const override { return AKEY_STATE_UNKNOWN; }
+    status_t getAbsoluteAxisValue(int32_t, int32_t, int32_t* outValue) const override {
+        *outValue = 0;
+        return OK;
+    }
+    status_t getMtSlotValues(int32_t, int32_t axis, size_t slotCount,
+                             std::vector<int32_t>* outValues) const override {
+        outValues->assign(slotCount, axis == ABS_MT_TRACKING_ID ? -1 : 0);
+        return OK;
+    }
+    bool markSupportedKeyCodes(int32_t, size_t, const int32_t*, uint8_t*) const override {
+        return false;
+    }
+    bool hasScanCode(int32_t, int32_t) const override { return false; }
+    bool hasLed(int32_t, int32_t) const override { return false; }
+    void setLedState(int32_t, int32_t, bool) override {}
+    void getVirtualKeyDefinitions(int32_t, std::vector<VirtualKeyDefinition>&) const override {}
+    sp<KeyCharacterMap> getKeyCharacterMap(int32_t) const override { return nullptr; }
+    bool setKeyboardLayoutOverlay(int32_t, const sp<KeyCharacterMap>&) override { return false; }
+    void vibrate(int32_t, nsecs_t) override {}
+    void cancelVibrate(int32_t) override {}
+    void requestReopenDevices() override {}
+    void wake() override {}
+    void dump(std::string&) override {}
+    void monitor() override {}
+    bool isDeviceEnabled(int32_t) override { return true; }
+    status_t enableDevice(int32_t) override { return OK; }
+    status_t disableDevice(int32_t) override { return OK; }
+
+private:
+    InputDeviceIdentifier mIdentifier;
+    PropertyMap mConfiguration;
+    std::vector<RawEvent> mEvents;
+};
+
+// --- FakeInputReaderPolicy ---
+
+class FakeInputReaderPolicy : public InputReaderPolicyInterface {
+public:
+    FakeInputReaderPolicy() {
+        DisplayViewport viewport;
+        viewport.displayId = ADISPLAY_ID_DEFAULT;
+        viewport.logicalRight = viewport.physicalRight = viewport.deviceWidth = DISPLAY_WIDTH;
+        viewport.logicalBottom = viewport.physicalBottom = viewport.deviceHeight = DISPLAY_HEIGHT;
+        viewport.isActive = true;
+        viewport.uniqueId = "local:0";
+        viewport.type = ViewportType::VIEWPORT_INTERNAL;
+        mConfig.setDisplayViewports({viewport});
+    }
+
+protected:
+    virtual ~FakeInputReaderPolicy() {}
+
+private:
+    void getReaderConfiguration(InputReaderConfiguration* outConfig) override {
+        *outConfig = mConfig;
+    }
+    std::shared_ptr<PointerControllerInterface> obtainPointerController(int32_t) override {
+        return nullptr;
+    }
+    void notifyInputDevicesChanged(const std::vector<InputDeviceInfo>&) override {}
+    sp<KeyCharacterMap> getKeyboardLayoutOverlay(const InputDeviceIdentifier&) override {
+        return nullptr;
+    }
+    std::string getDeviceAlias(const InputDeviceIdentifier&) override { return ""; }
+    TouchAffineTransformation getTouchAffineTransformation(const std::string&, int32_t) override {
+        return TouchAffineTransformation();
+    }
+
+    InputReaderConfiguration mConfig;
+};
+
+// --- FakeInputListener ---
+
+class FakeInputListener : public InputListenerInterface {
+public:
+    size_t getMotionCount() const { return mMotionCount; }
+
+protected:
+    virtual ~FakeInputListener() {}
+
+private:
+    void notifyConfigurationChanged(const NotifyConfigurationChangedArgs*) override {}
+    void notifyKey(const NotifyKeyArgs*) override {}
+    void notifyMotion(const NotifyMotionArgs*) override { mMotionCount++; }
+    void notifySwitch(const NotifySwitchArgs*) override {}
+    void notifyDeviceReset(const NotifyDeviceResetArgs*) override {}
+
+    size_t mMotionCount = 0;
+};
+
+class BenchmarkInputReader : public InputReader {
+public:
+    BenchmarkInputReader(std::shared_ptr<EventHubInterface> eventHub,
+                         const sp<InputReaderPolicyInterface>& policy,
+                         const sp<InputListenerInterface>& listener)
+          : InputReader(eventHub, policy, listener) {}
+
+    // Make the protected loopOnce method accessible to the benchmarks.
+    using InputReader::loopOnce;
+};
+
+/**
+ * Queues a multi-touch frame in which each of pointerCount pointers reports its position.
+ */
+static void enqueueTouchFrame(FakeEventHub& eventHub, size_t pointerCount, int32_t offset,
+                              bool down) {
+    const nsecs_t when = now();
+    for (size_t i = 0; i < pointerCount; i++) {
+        eventHub.enqueueEvent(when, DEVICE_ID, EV_ABS, ABS_MT_SLOT, i);
+        if (down) {
+            eventHub.enqueueEvent(when, DEVICE_ID, EV_ABS, ABS_MT_TRACKING_ID, i);
+        }
+        eventHub.enqueueEvent(when, DEVICE_ID, EV_ABS, ABS_MT_POSITION_X, 100 * i + offset);
+        eventHub.enqueueEvent(when, DEVICE_ID, EV_ABS, ABS_MT_POSITION_Y, 500 + offset);
+    }
+    eventHub.enqueueEvent(when, DEVICE_ID, EV_SYN, SYN_REPORT, 0);
+}
+
+static void enqueueTouchUp(FakeEventHub& eventHub, size_t pointerCount) {
+    const nsecs_t when = now();
+    for (size_t i = 0; i < pointerCount; i++) {
+        eventHub.enqueueEvent(when, DEVICE_ID, EV_ABS, ABS_MT_SLOT, i);
+        eventHub.enqueueEvent(when, DEVICE_ID, EV_ABS, ABS_MT_TRACKING_ID, -1);
+    }
+    eventHub.enqueueEvent(when, DEVICE_ID, EV_SYN, SYN_REPORT, 0);
+}
+
+/**
+ * Processes a gesture of state.range(0) pointers on a multi-touch screen: the pointers go down
+ * together, move in 10 frames and go up together.
+ */
+static void benchmarkTouchGesture(benchmark::State& state) {
+    static constexpr int32_t MOVE_FRAMES = 10;
+
+    std::shared_ptr<FakeEventHub> eventHub = std::make_shared<FakeEventHub>();
+    sp<FakeInputReaderPolicy> policy = new FakeInputReaderPolicy();
+    sp<FakeInputListener> listener = new FakeInputListener();
+    BenchmarkInputReader reader(eventHub, policy, listener);
+
+    // Add the device
+    reader.loopOnce();
+
+    const size_t pointerCount = state.range(0);
+    for (auto _ : state) {
+        enqueueTouchFrame(*eventHub, pointerCount, 0, true /*down*/);
+        reader.loopOnce();
+        for (int32_t i = 1; i <= MOVE_FRAMES; i++) {
+            enqueueTouchFrame(*eventHub, pointerCount, i, false /*down*/);
+            reader.loopOnce();
+        }
+        enqueueTouchUp(*eventHub, pointerCount);
+        reader.loopOnce();
+    }
+
+    state.SetItemsProcessed(listener->getMotionCount());
+}
+
+BENCHMARK(benchmarkTouchGesture)->Arg(1)->Arg(2)->Arg(5)->Arg(10);
+
+} // namespace android
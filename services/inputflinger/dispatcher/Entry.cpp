@@ -22,12 +22,77 @@
 #include <android-base/stringprintf.h>
 #include <cutils/atomic.h>
 #include <inttypes.h>
+#include <mutex>
+#include <vector>
 
 using android::base::GetBoolProperty;
 using android::base::StringPrintf;
 
 namespace android::inputdispatcher {
 
+namespace {
+
+// The maximum number of released entries whose memory a pool keeps. This covers the entries
+// that are alive at once while a stream of motion events is dispatched to a few windows.
+constexpr size_t MAX_POOLED_ENTRIES = 64;
+
+// Recycles the memory of the released objects of type T. Objects of a derived type, whose size
+// differs, are allocated on the heap.
+//
+// Entries are created and released on different threads, e.g. the reader thread creates the
+// MotionEntry that the dispatcher thread releases, so the pool has its own lock.
+template <typename T>
+class EntryPool {
+public:
+    EntryPool() { mFreeEntries.reserve(MAX_POOLED_ENTRIES); }
+
+    void* allocate(size_t size) {
+        if (size == sizeof(T)) {
+            std::scoped_lock _l(mLock);
+            mStats.allocations += 1;
+            if (!mFreeEntries.empty()) {
+                void* ptr = mFreeEntries.back();
+                mFreeEntries.pop_back();
+                return ptr;
+            }
+            mStats.heapAllocations += 1;
+        }
+        return ::operator new(size);
+    }
+
+    void deallocate(void* ptr, size_t size) {
+        if (size == sizeof(T)) {
+            std::scoped_lock _l(mLock);
+            if (mFreeEntries.size() < MAX_POOLED_ENTRIES) {
+                mFreeEntries.push_back(ptr);
+                return;
+            }
+        }
+        ::operator delete(ptr);
+    }
+
+    EntryAllocationStats getStats() {
+        std::scoped_lock _l(mLock);
+        EntryAllocationStats stats = mStats;
+        stats.pooledEntries = mFreeEntries.size();
+        return stats;
+    }
+
+private:
+    std::mutex mLock;
+    EntryAllocationStats mStats;
+    std::vector<void*> mFreeEntries;
+};
+
+// The pools are never destroyed, because entries may still be released while the process exits.
+template <typename T>
+EntryPool<T>& getEntryPool() {
+    static EntryPool<T>& pool = *new EntryPool<T>();
+    return pool;
+}
+
+} // namespace
+
 VerifiedKeyEvent verifiedKeyEventFromKeyEntry(const KeyEntry& entry) {
     return {{VerifiedInputEvent::Type::KEY, entry.deviceId, entry.eventTime, entry.source,
              entry.displayId},
@@ -64,6 +129,7 @@ EventEntry::EventEntry(int32_t id, Type type, nsecs_t eventTime, uint32_t policy
         eventTime(eventTime),
         policyFlags(policyFlags),
         injectionState(nullptr),
+        enqueueTime(0),
         dispatchInProgress(false) {}
 
 EventEntry::~EventEntry() {
@@ -151,6 +217,18 @@ KeyEntry::KeyEntry(int32_t id, nsecs_t eventTime, int32_t deviceId, uint32_t sou
 
 KeyEntry::~KeyEntry() {}
 
+void* KeyEntry::operator new(size_t size) {
+    return getEntryPool<KeyEntry>().allocate(size);
+}
+
+void KeyEntry::operator delete(void* ptr, size_t size) {
+    getEntryPool<KeyEntry>().deallocate(ptr, size);
+}
+
+EntryAllocationStats KeyEntry::getAllocationStats() {
+    return getEntryPool<KeyEntry>().getStats();
+}
+
 void KeyEntry::appendDescription(std::string& msg) const {
     msg += StringPrintf("KeyEvent");
     if (!GetBoolProperty("ro.debuggable", false)) {
@@ -211,6 +289,18 @@ MotionEntry::MotionEntry(int32_t id, nsecs_t eventTime, int32_t deviceId, uint32
 
 MotionEntry::~MotionEntry() {}
 
+void* MotionEntry::operator new(size_t size) {
+    return getEntryPool<MotionEntry>().allocate(size);
+}
+
+void MotionEntry::operator delete(void* ptr, size_t size) {
+    getEntryPool<MotionEntry>().deallocate(ptr, size);
+}
+
+EntryAllocationStats MotionEntry::getAllocationStats() {
+    return getEntryPool<MotionEntry>().getStats();
+}
+
 void MotionEntry::appendDescription(std::string& msg) const {
     msg += StringPrintf("MotionEvent");
     if (!GetBoolProperty("ro.debuggable", false)) {
@@ -261,6 +351,18 @@ DispatchEntry::~DispatchEntry() {
     eventEntry->release();
 }
 
+void* DispatchEntry::operator new(size_t size) {
+    return getEntryPool<DispatchEntry>().allocate(size);
+}
+
+void DispatchEntry::operator delete(void* ptr, size_t size) {
+    getEntryPool<DispatchEntry>().deallocate(ptr, size);
+}
+
+EntryAllocationStats DispatchEntry::getAllocationStats() {
+    return getEntryPool<DispatchEntry>().getStats();
+}
+
 uint32_t DispatchEntry::nextSeq() {
     // Sequence number 0 is reserved and will never be returned.
     uint32_t seq;
@@ -278,7 +380,8 @@ CommandEntry::CommandEntry(Command command)
         keyEntry(nullptr),
         userActivityEventType(0),
         seq(0),
-        handled(false) {}
+        handled(false),
+        consumeTime(0) {}
 
 CommandEntry::~CommandEntry() {}
 
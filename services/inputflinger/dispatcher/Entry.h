@@ -29,6 +29,17 @@
 
 namespace android::inputdispatcher {
 
+/**
+ * The memory of KeyEntry, MotionEntry and DispatchEntry objects is recycled by a pool per type,
+ * so that dispatching events does not allocate once the pools are warm. These are the allocation
+ * counters of a pool.
+ */
+struct EntryAllocationStats {
+    size_t allocations = 0;     // entries allocated in total
+    size_t heapAllocations = 0; // allocations that were not served from the pool
+    size_t pooledEntries = 0;   // released entries whose memory is kept for reuse
+};
+
 struct EventEntry {
     enum class Type {
         CONFIGURATION_CHANGED,
@@ -59,6 +70,9 @@ struct EventEntry {
     nsecs_t eventTime;
     uint32_t policyFlags;
     InjectionState* injectionState;
+    // The time when the dispatcher was notified of the event by the input reader, or 0 if the
+    // dispatcher generated the event.
+    nsecs_t enqueueTime;
 
     bool dispatchInProgress; // initially false, set to true while dispatching
 
@@ -149,6 +163,10 @@ struct KeyEntry : EventEntry {
     virtual void appendDescription(std::string& msg) const;
     void recycle();
 
+    static void* operator new(size_t size);
+    static void operator delete(void* ptr, size_t size);
+    static EntryAllocationStats getAllocationStats();
+
 protected:
     virtual ~KeyEntry();
 };
@@ -183,6 +201,10 @@ struct MotionEntry : EventEntry {
                 float xOffset, float yOffset);
     virtual void appendDescription(std::string& msg) const;
 
+    static void* operator new(size_t size);
+    static void operator delete(void* ptr, size_t size);
+    static EntryAllocationStats getAllocationStats();
+
 protected:
     virtual ~MotionEntry();
 };
@@ -217,6 +239,10 @@ struct DispatchEntry {
 
     inline bool isSplit() const { return targetFlags & InputTarget::FLAG_SPLIT; }
 
+    static void* operator new(size_t size);
+    static void operator delete(void* ptr, size_t size);
+    static EntryAllocationStats getAllocationStats();
+
 private:
     static volatile int32_t sNextSeqAtomic;
 
@@ -262,6 +288,7 @@ struct CommandEntry {
     int32_t userActivityEventType;
     uint32_t seq;
     bool handled;
+    nsecs_t consumeTime;
     sp<InputChannel> inputChannel;
     sp<IBinder> oldToken;
     sp<IBinder> newToken;
@@ -260,6 +260,45 @@ static bool isStaleEvent(nsecs_t currentTime, const EventEntry& entry) {
     return currentTime - entry.eventTime >= STALE_EVENT_TIMEOUT;
 }
 
+/**
+ * Returns true if next is a move of the same pointers as pending, with the same dispatch
+ * parameters, so that it can replace pending in the outbound queue without the application
+ * seeing anything other than a lost intermediate sample.
+ */
+static bool canCoalesceMotionDispatchEntries(const DispatchEntry& pending,
+                                             const DispatchEntry& next) {
+    if (pending.eventEntry->type != EventEntry::Type::MOTION ||
+        next.eventEntry->type != EventEntry::Type::MOTION ||
+        pending.resolvedAction != AMOTION_EVENT_ACTION_MOVE ||
+        next.resolvedAction != AMOTION_EVENT_ACTION_MOVE ||
+        pending.resolvedFlags != next.resolvedFlags || pending.targetFlags != next.targetFlags ||
+        pending.xOffset != next.xOffset || pending.yOffset != next.yOffset ||
+        pending.globalScaleFactor != next.globalScaleFactor ||
+        pending.windowXScale != next.windowXScale || pending.windowYScale != next.windowYScale) {
+        return false;
+    }
+
+    const MotionEntry& pendingEntry = static_cast<const MotionEntry&>(*pending.eventEntry);
+    const MotionEntry& nextEntry = static_cast<const MotionEntry&>(*next.eventEntry);
+    // Injected events are never dropped, so that their injector is told how they were handled.
+    if (pendingEntry.injectionState || nextEntry.injectionState ||
+        pendingEntry.deviceId != nextEntry.deviceId || pendingEntry.source != nextEntry.source ||
+        pendingEntry.displayId != nextEntry.displayId ||
+        pendingEntry.downTime != nextEntry.downTime ||
+        pendingEntry.metaState != nextEntry.metaState ||
+        pendingEntry.buttonState != nextEntry.buttonState ||
+        pendingEntry.classification != nextEntry.classification ||
+        pendingEntry.pointerCount != nextEntry.pointerCount) {
+        return false;
+    }
+    for (uint32_t i = 0; i < pendingEntry.pointerCount; i++) {
+        if (pendingEntry.pointerProperties[i] != nextEntry.pointerProperties[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
 static std::unique_ptr<DispatchEntry> createDispatchEntry(const InputTarget& inputTarget,
                                                           EventEntry* eventEntry,
                                                           int32_t inputTargetFlags) {
@@ -314,6 +353,8 @@ static std::unique_ptr<DispatchEntry> createDispatchEntry(const InputTarget& inp
                             motionEntry.pointerProperties, pointerCoords, 0 /* xOffset */,
                             0 /* yOffset */);
 
+    combinedMotionEntry->enqueueTime = motionEntry.enqueueTime;
+
     if (motionEntry.injectionState) {
         combinedMotionEntry->injectionState = motionEntry.injectionState;
         combinedMotionEntry->injectionState->refCount += 1;
@@ -351,22 +392,22 @@ static std::array<uint8_t, 128> getRandomKey() {
 
 // --- HmacKeyManager ---
 
-HmacKeyManager::HmacKeyManager() : mHmacKey(getRandomKey()) {}
-
-std::array<uint8_t, 32> HmacKeyManager::sign(const VerifiedInputEvent& event) const {
-    size_t size;
+static size_t getVerifiedInputEventSize(const VerifiedInputEvent& event) {
     switch (event.type) {
         case VerifiedInputEvent::Type::KEY: {
-            size = sizeof(VerifiedKeyEvent);
-            break;
+            return sizeof(VerifiedKeyEvent);
         }
         case VerifiedInputEvent::Type::MOTION: {
-            size = sizeof(VerifiedMotionEvent);
-            break;
+            return sizeof(VerifiedMotionEvent);
         }
     }
+}
+
+HmacKeyManager::HmacKeyManager() : mHmacKey(getRandomKey()) {}
+
+std::array<uint8_t, 32> HmacKeyManager::sign(const VerifiedInputEvent& event) const {
     const uint8_t* start = reinterpret_cast<const uint8_t*>(&event);
-    return sign(start, size);
+    return sign(start, getVerifiedInputEventSize(event));
 }
 
 std::array<uint8_t, 32> HmacKeyManager::sign(const uint8_t* data, size_t size) const {
@@ -388,6 +429,46 @@ std::array<uint8_t, 32> HmacKeyManager::sign(const uint8_t* data, size_t size) c
     return hash;
 }
 
+// --- RecentEventTokens ---
+
+RecentEventTokens::RecentEventTokens(size_t capacity) : mCapacity(capacity) {
+    mEntries.reserve(capacity);
+}
+
+std::array<uint8_t, 32> RecentEventTokens::add(const VerifiedInputEvent& event) {
+    Entry entry;
+    if (RAND_bytes(entry.token.data(), entry.token.size()) != 1) {
+        ALOGE("Could not generate a token for the event");
+        return INVALID_HMAC;
+    }
+    entry.size = getVerifiedInputEventSize(event);
+    memcpy(entry.data.data(), &event, entry.size);
+
+    std::scoped_lock _l(mLock);
+    if (mEntries.size() < mCapacity) {
+        mEntries.push_back(entry);
+    } else {
+        mEntries[mNextIndex] = entry;
+        mNextIndex = (mNextIndex + 1) % mCapacity;
+    }
+    return entry.token;
+}
+
+bool RecentEventTokens::contains(const VerifiedInputEvent& event,
+                                 const std::array<uint8_t, 32>& token) const {
+    if (token == INVALID_HMAC) {
+        return false;
+    }
+    const size_t size = getVerifiedInputEventSize(event);
+    std::scoped_lock _l(mLock);
+    for (const Entry& entry : mEntries) {
+        if (entry.token == token) {
+            return entry.size == size && memcmp(entry.data.data(), &event, size) == 0;
+        }
+    }
+    return false;
+}
+
 // --- InputDispatcher ---
 
 InputDispatcher::InputDispatcher(const sp<InputDispatcherPolicyInterface>& policy)
@@ -412,6 +493,9 @@ InputDispatcher::InputDispatcher(const sp<InputDispatcherPolicyInterface>& polic
     mKeyRepeatState.lastKeyEntry = nullptr;
 
     policy->getDispatcherConfiguration(&mConfig);
+    if (mConfig.verifiedEventHistorySize > 0) {
+        mRecentEventTokens = std::make_unique<RecentEventTokens>(mConfig.verifiedEventHistorySize);
+    }
 }
 
 InputDispatcher::~InputDispatcher() {
@@ -453,6 +537,9 @@ void InputDispatcher::dispatchOnce() {
         std::scoped_lock _l(mLock);
         mDispatcherIsAlive.notify_all();
 
+        // Move the events queued by notifyKey and notifyMotion to the inbound queue.
+        enqueueNewInboundEventsLocked();
+
         // Run a dispatch loop if there are no pending commands.
         // The dispatch loop might enqueue commands to run afterwards.
         if (!haveCommandsLocked()) {
@@ -470,6 +557,12 @@ void InputDispatcher::dispatchOnce() {
         const nsecs_t nextAnrCheck = processAnrsLocked();
         nextWakeupTime = std::min(nextWakeupTime, nextAnrCheck);
 
+        // Events queued since the start of this iteration are not dispatched yet, so we are not
+        // idle.
+        if (!mNewInboundQueue.empty()) {
+            nextWakeupTime = LONG_LONG_MIN;
+        }
+
         // We are about to enter an infinitely long sleep, because we have no commands or
         // pending or queued events
         if (nextWakeupTime == LONG_LONG_MAX) {
@@ -772,6 +865,20 @@ bool InputDispatcher::shouldPruneInboundQueueLocked(const MotionEntry& motionEnt
 }
 
 bool InputDispatcher::enqueueInboundEventLocked(EventEntry* entry) {
+    // Keep the events in the order they were reported.
+    bool needWake = enqueueNewInboundEventsLocked();
+    return appendInboundEventLocked(entry) || needWake;
+}
+
+bool InputDispatcher::enqueueNewInboundEventsLocked() {
+    bool needWake = false;
+    for (EventEntry* entry : mNewInboundQueue.popAll()) {
+        needWake |= appendInboundEventLocked(entry);
+    }
+    return needWake;
+}
+
+bool InputDispatcher::appendInboundEventLocked(EventEntry* entry) {
     bool needWake = mInboundQueue.empty();
     mInboundQueue.push_back(entry);
     traceInboundQueueLengthLocked();
@@ -837,9 +944,15 @@ sp<InputWindowHandle> InputDispatcher::findTouchedWindowAtLocked(int32_t display
         LOG_ALWAYS_FATAL(
                 "Must provide a valid touch state if adding portal windows or outside targets");
     }
-    // Traverse windows from front to back to find touched window.
-    const std::vector<sp<InputWindowHandle>> windowHandles = getWindowHandlesLocked(displayId);
-    for (const sp<InputWindowHandle>& windowHandle : windowHandles) {
+    auto indexIt = mTouchableWindowIndexByDisplay.find(displayId);
+    if (indexIt == mTouchableWindowIndexByDisplay.end()) {
+        return nullptr;
+    }
+    // Traverse the windows that may be touched at the point from front to back to find the
+    // touched window.
+    const std::vector<sp<InputWindowHandle>>& windowHandles = getWindowHandlesLocked(displayId);
+    for (uint32_t index : indexIt->second.getCandidates(x, y)) {
+        const sp<InputWindowHandle>& windowHandle = windowHandles[index];
         const InputWindowInfo* windowInfo = windowHandle->getInfo();
         if (windowInfo->displayId == displayId) {
             int32_t flags = windowInfo->layoutParamsFlags;
@@ -880,13 +993,17 @@ std::vector<TouchedMonitor> InputDispatcher::findTouchedGestureMonitorsLocked(
         int32_t displayId, const std::vector<sp<InputWindowHandle>>& portalWindows) const {
     std::vector<TouchedMonitor> touchedMonitors;
 
-    std::vector<Monitor> monitors = getValueByKey(mGestureMonitorsByDisplay, displayId);
-    addGestureMonitors(monitors, touchedMonitors);
+    auto it = mGestureMonitorsByDisplay.find(displayId);
+    if (it != mGestureMonitorsByDisplay.end()) {
+        addGestureMonitors(it->second, touchedMonitors);
+    }
     for (const sp<InputWindowHandle>& portalWindow : portalWindows) {
         const InputWindowInfo* windowInfo = portalWindow->getInfo();
-        monitors = getValueByKey(mGestureMonitorsByDisplay, windowInfo->portalToDisplayId);
-        addGestureMonitors(monitors, touchedMonitors, -windowInfo->frameLeft,
-                           -windowInfo->frameTop);
+        it = mGestureMonitorsByDisplay.find(windowInfo->portalToDisplayId);
+        if (it != mGestureMonitorsByDisplay.end()) {
+            addGestureMonitors(it->second, touchedMonitors, -windowInfo->frameLeft,
+                               -windowInfo->frameTop);
+        }
     }
     return touchedMonitors;
 }
@@ -1004,6 +1121,9 @@ void InputDispatcher::postCommandLocked(std::unique_ptr<CommandEntry> commandEnt
 }
 
 void InputDispatcher::drainInboundQueueLocked() {
+    for (EventEntry* entry : mNewInboundQueue.popAll()) {
+        releaseInboundEventLocked(entry);
+    }
     while (!mInboundQueue.empty()) {
         EventEntry* entry = mInboundQueue.front();
         mInboundQueue.pop_front();
@@ -1110,6 +1230,10 @@ bool InputDispatcher::dispatchDeviceResetLocked(nsecs_t currentTime, DeviceReset
 }
 
 void InputDispatcher::enqueueFocusEventLocked(const InputWindowHandle& window, bool hasFocus) {
+    // Focus events go in front of all the queued events, including those not moved to the
+    // inbound queue yet.
+    enqueueNewInboundEventsLocked();
+
     if (mPendingEvent != nullptr) {
         // Move the pending event to the front of the queue. This will give the chance
         // for the pending event to get dispatched to the newly focused window
@@ -1613,6 +1737,21 @@ int32_t InputDispatcher::findTouchedWindowTargetsLocked(nsecs_t currentTime,
     int32_t action = entry.action;
     int32_t maskedAction = action & AMOTION_EVENT_ACTION_MASK;
 
+    // Moves in the middle of a gesture go to the same targets as the previous move, unless
+    // something invalidated them since.
+    if (maskedAction == AMOTION_EVENT_ACTION_MOVE && !entry.injectionState &&
+        mLastHoverWindowHandle == nullptr) {
+        auto cacheIt = mCachedTouchTargetsByDisplay.find(displayId);
+        if (cacheIt != mCachedTouchTargetsByDisplay.end() &&
+            cacheIt->second.deviceId == entry.deviceId && cacheIt->second.source == entry.source) {
+            const std::vector<InputTarget>& cachedTargets = cacheIt->second.inputTargets;
+            inputTargets.insert(inputTargets.end(), cachedTargets.begin(), cachedTargets.end());
+            return INPUT_EVENT_INJECTION_SUCCEEDED;
+        }
+    }
+    mCachedTouchTargetsByDisplay.erase(displayId);
+    const size_t firstInputTargetIndex = inputTargets.size();
+
     // Update the touch state as needed based on the properties of the touch event.
     int32_t injectionResult = INPUT_EVENT_INJECTION_PENDING;
     InjectionPermission injectionPermission = INJECTION_PERMISSION_UNKNOWN;
@@ -2027,6 +2166,19 @@ Failed:
 
         // Update hover state.
         mLastHoverWindowHandle = newHoverWindowHandle;
+
+        // Only moves that can neither slip into another window nor end a hover sequence
+        // leave the touch state as it was, so that the next moves can reuse their targets.
+        if (maskedAction == AMOTION_EVENT_ACTION_MOVE &&
+            injectionResult == INPUT_EVENT_INJECTION_SUCCEEDED && !switchedDevice &&
+            !entry.injectionState && !tempTouchState.isSlippery() &&
+            mLastHoverWindowHandle == nullptr) {
+            mCachedTouchTargetsByDisplay[displayId] =
+                    CachedTouchTargets{entry.deviceId, entry.source,
+                                       std::vector<InputTarget>(inputTargets.begin() +
+                                                                        firstInputTargetIndex,
+                                                                inputTargets.end())};
+        }
     }
 
     return injectionResult;
@@ -2073,6 +2225,7 @@ void InputDispatcher::addGlobalMonitoringTargetsLocked(std::vector<InputTarget>&
 
     if (it != mGlobalMonitorsByDisplay.end()) {
         const std::vector<Monitor>& monitors = it->second;
+        inputTargets.reserve(inputTargets.size() + monitors.size());
         for (const Monitor& monitor : monitors) {
             addMonitoringTargetLocked(monitor, xOffset, yOffset, inputTargets);
         }
@@ -2139,7 +2292,7 @@ static bool canBeObscuredBy(const sp<InputWindowHandle>& windowHandle,
 bool InputDispatcher::isWindowObscuredAtPointLocked(const sp<InputWindowHandle>& windowHandle,
                                                     int32_t x, int32_t y) const {
     int32_t displayId = windowHandle->getInfo()->displayId;
-    const std::vector<sp<InputWindowHandle>> windowHandles = getWindowHandlesLocked(displayId);
+    const std::vector<sp<InputWindowHandle>>& windowHandles = getWindowHandlesLocked(displayId);
     for (const sp<InputWindowHandle>& otherHandle : windowHandles) {
         if (windowHandle == otherHandle) {
             break; // All future windows are below us. Exit early.
@@ -2155,7 +2308,7 @@ bool InputDispatcher::isWindowObscuredAtPointLocked(const sp<InputWindowHandle>&
 
 bool InputDispatcher::isWindowObscuredLocked(const sp<InputWindowHandle>& windowHandle) const {
     int32_t displayId = windowHandle->getInfo()->displayId;
-    const std::vector<sp<InputWindowHandle>> windowHandles = getWindowHandlesLocked(displayId);
+    const std::vector<sp<InputWindowHandle>>& windowHandles = getWindowHandlesLocked(displayId);
     const InputWindowInfo* windowInfo = windowHandle->getInfo();
     for (const sp<InputWindowHandle>& otherHandle : windowHandles) {
         if (windowHandle == otherHandle) {
@@ -2451,6 +2604,20 @@ void InputDispatcher::enqueueDispatchEntryLocked(const sp<Connection>& connectio
         }
     }
 
+    // Entries are only left in the outbound queue when the application is not keeping up and
+    // its channel is full. Replace a pending move with the newer one rather than queueing both,
+    // so that the application catches up with the current pointer positions after a stall
+    // instead of working through every sample it missed.
+    if (!connection->outboundQueue.empty() &&
+        canCoalesceMotionDispatchEntries(*connection->outboundQueue.back(), *dispatchEntry)) {
+#if DEBUG_DISPATCH_CYCLE
+        ALOGD("channel '%s' ~ enqueueDispatchEntryLocked: coalescing pending move event",
+              connection->getInputChannelName().c_str());
+#endif
+        releaseDispatchEntry(connection->outboundQueue.back());
+        connection->outboundQueue.pop_back();
+    }
+
     // Remember that we are waiting for this dispatch to complete.
     if (dispatchEntry->hasForegroundTarget()) {
         incrementPendingForegroundDispatches(newEntry);
@@ -2658,6 +2825,9 @@ const std::array<uint8_t, 32> InputDispatcher::getSignature(
         VerifiedMotionEvent verifiedEvent = verifiedMotionEventFromMotionEntry(motionEntry);
         verifiedEvent.actionMasked = actionMasked;
         verifiedEvent.flags = dispatchEntry.resolvedFlags & VERIFIED_MOTION_EVENT_FLAGS;
+        if (mRecentEventTokens) {
+            return mRecentEventTokens->add(verifiedEvent);
+        }
         return mHmacKeyManager.sign(verifiedEvent);
     }
     return INVALID_HMAC;
@@ -2668,12 +2838,15 @@ const std::array<uint8_t, 32> InputDispatcher::getSignature(
     VerifiedKeyEvent verifiedEvent = verifiedKeyEventFromKeyEntry(keyEntry);
     verifiedEvent.flags = dispatchEntry.resolvedFlags & VERIFIED_KEY_EVENT_FLAGS;
     verifiedEvent.action = dispatchEntry.resolvedAction;
+    if (mRecentEventTokens) {
+        return mRecentEventTokens->add(verifiedEvent);
+    }
     return mHmacKeyManager.sign(verifiedEvent);
 }
 
 void InputDispatcher::finishDispatchCycleLocked(nsecs_t currentTime,
                                                 const sp<Connection>& connection, uint32_t seq,
-                                                bool handled) {
+                                                bool handled, nsecs_t consumeTime) {
 #if DEBUG_DISPATCH_CYCLE
     ALOGD("channel '%s' ~ finishDispatchCycle - seq=%u, handled=%s",
           connection->getInputChannelName().c_str(), seq, toString(handled));
@@ -2685,7 +2858,7 @@ void InputDispatcher::finishDispatchCycleLocked(nsecs_t currentTime,
     }
 
     // Notify other system components and prepare to start the next dispatch cycle.
-    onDispatchCycleFinishedLocked(currentTime, connection, seq, handled);
+    onDispatchCycleFinishedLocked(currentTime, connection, seq, handled, consumeTime);
 }
 
 void InputDispatcher::abortBrokenDispatchCycleLocked(nsecs_t currentTime,
@@ -2753,19 +2926,18 @@ int InputDispatcher::handleReceiveCallback(int fd, int events, void* data) {
             }
 
             nsecs_t currentTime = now();
-            bool gotOne = false;
+            // A single message may carry the finished signals of several events, so receive
+            // everything that is pending before finishing the dispatch cycles.
+            std::vector<InputFinishedSignal> signals;
             status_t status;
-            for (;;) {
-                uint32_t seq;
-                bool handled;
-                status = connection->inputPublisher.receiveFinishedSignal(&seq, &handled);
-                if (status) {
-                    break;
-                }
-                d->finishDispatchCycleLocked(currentTime, connection, seq, handled);
-                gotOne = true;
+            do {
+                status = connection->inputPublisher.receiveFinishedSignals(&signals);
+            } while (!status);
+            for (const InputFinishedSignal& signal : signals) {
+                d->finishDispatchCycleLocked(currentTime, connection, signal.seq, signal.handled,
+                                             signal.consumeTime);
             }
-            if (gotOne) {
+            if (!signals.empty()) {
                 d->runCommandsLockedInterruptible();
                 if (status == WOULD_BLOCK) {
                     return 1;
@@ -3044,6 +3216,8 @@ MotionEntry* InputDispatcher::splitMotionEvent(const MotionEntry& originalMotion
                             originalMotionEntry.yCursorPosition, originalMotionEntry.downTime,
                             splitPointerCount, splitPointerProperties, splitPointerCoords, 0, 0);
 
+    splitMotionEntry->enqueueTime = originalMotionEntry.enqueueTime;
+
     if (originalMotionEntry.injectionState) {
         splitMotionEntry->injectionState = originalMotionEntry.injectionState;
         splitMotionEntry->injectionState->refCount += 1;
@@ -3152,36 +3326,26 @@ void InputDispatcher::notifyKey(const NotifyKeyArgs* args) {
               std::to_string(t.duration().count()).c_str());
     }
 
-    bool needWake;
-    { // acquire lock
-        mLock.lock();
-
-        if (shouldSendKeyToInputFilterLocked(args)) {
-            mLock.unlock();
-
-            policyFlags |= POLICY_FLAG_FILTERED;
-            if (!mPolicy->filterInputEvent(&event, policyFlags)) {
-                return; // event was consumed by the filter
-            }
-
-            mLock.lock();
+    if (shouldSendKeyToInputFilter(args)) {
+        policyFlags |= POLICY_FLAG_FILTERED;
+        if (!mPolicy->filterInputEvent(&event, policyFlags)) {
+            return; // event was consumed by the filter
         }
+    }
 
-        KeyEntry* newEntry =
-                new KeyEntry(args->id, args->eventTime, args->deviceId, args->source,
-                             args->displayId, policyFlags, args->action, flags, keyCode,
-                             args->scanCode, metaState, repeatCount, args->downTime);
+    KeyEntry* newEntry = new KeyEntry(args->id, args->eventTime, args->deviceId, args->source,
+                                      args->displayId, policyFlags, args->action, flags, keyCode,
+                                      args->scanCode, metaState, repeatCount, args->downTime);
+    newEntry->enqueueTime = now();
 
-        needWake = enqueueInboundEventLocked(newEntry);
-        mLock.unlock();
-    } // release lock
-
-    if (needWake) {
+    // The event is queued without taking mLock, so that the reader thread does not wait while
+    // the dispatcher thread is dispatching.
+    if (mNewInboundQueue.push(newEntry)) {
         mLooper->wake();
     }
 }
 
-bool InputDispatcher::shouldSendKeyToInputFilterLocked(const NotifyKeyArgs* args) {
+bool InputDispatcher::shouldSendKeyToInputFilter(const NotifyKeyArgs* args) {
     return mInputFilterEnabled;
 }
 
@@ -3228,50 +3392,38 @@ void InputDispatcher::notifyMotion(const NotifyMotionArgs* args) {
               std::to_string(t.duration().count()).c_str());
     }
 
-    bool needWake;
-    { // acquire lock
-        mLock.lock();
+    if (shouldSendMotionToInputFilter(args)) {
+        MotionEvent event;
+        event.initialize(args->id, args->deviceId, args->source, args->displayId, INVALID_HMAC,
+                         args->action, args->actionButton, args->flags, args->edgeFlags,
+                         args->metaState, args->buttonState, args->classification, 1 /*xScale*/,
+                         1 /*yScale*/, 0 /* xOffset */, 0 /* yOffset */, args->xPrecision,
+                         args->yPrecision, args->xCursorPosition, args->yCursorPosition,
+                         args->downTime, args->eventTime, args->pointerCount,
+                         args->pointerProperties, args->pointerCoords);
 
-        if (shouldSendMotionToInputFilterLocked(args)) {
-            mLock.unlock();
-
-            MotionEvent event;
-            event.initialize(args->id, args->deviceId, args->source, args->displayId, INVALID_HMAC,
-                             args->action, args->actionButton, args->flags, args->edgeFlags,
-                             args->metaState, args->buttonState, args->classification, 1 /*xScale*/,
-                             1 /*yScale*/, 0 /* xOffset */, 0 /* yOffset */, args->xPrecision,
-                             args->yPrecision, args->xCursorPosition, args->yCursorPosition,
-                             args->downTime, args->eventTime, args->pointerCount,
-                             args->pointerProperties, args->pointerCoords);
-
-            policyFlags |= POLICY_FLAG_FILTERED;
-            if (!mPolicy->filterInputEvent(&event, policyFlags)) {
-                return; // event was consumed by the filter
-            }
-
-            mLock.lock();
+        policyFlags |= POLICY_FLAG_FILTERED;
+        if (!mPolicy->filterInputEvent(&event, policyFlags)) {
+            return; // event was consumed by the filter
         }
+    }
 
-        // Just enqueue a new motion event.
-        MotionEntry* newEntry =
-                new MotionEntry(args->id, args->eventTime, args->deviceId, args->source,
-                                args->displayId, policyFlags, args->action, args->actionButton,
-                                args->flags, args->metaState, args->buttonState,
-                                args->classification, args->edgeFlags, args->xPrecision,
-                                args->yPrecision, args->xCursorPosition, args->yCursorPosition,
-                                args->downTime, args->pointerCount, args->pointerProperties,
-                                args->pointerCoords, 0, 0);
+    // Just enqueue a new motion event.
+    MotionEntry* newEntry =
+            new MotionEntry(args->id, args->eventTime, args->deviceId, args->source,
+                            args->displayId, policyFlags, args->action, args->actionButton,
+                            args->flags, args->metaState, args->buttonState, args->classification,
+                            args->edgeFlags, args->xPrecision, args->yPrecision,
+                            args->xCursorPosition, args->yCursorPosition, args->downTime,
+                            args->pointerCount, args->pointerProperties, args->pointerCoords, 0, 0);
+    newEntry->enqueueTime = now();
 
-        needWake = enqueueInboundEventLocked(newEntry);
-        mLock.unlock();
-    } // release lock
-
-    if (needWake) {
+    if (mNewInboundQueue.push(newEntry)) {
         mLooper->wake();
     }
 }
 
-bool InputDispatcher::shouldSendMotionToInputFilterLocked(const NotifyMotionArgs* args) {
+bool InputDispatcher::shouldSendMotionToInputFilter(const NotifyMotionArgs* args) {
     return mInputFilterEnabled;
 }
 
@@ -3511,14 +3663,12 @@ int32_t InputDispatcher::injectInputEvent(const InputEvent* event, int32_t injec
 }
 
 std::unique_ptr<VerifiedInputEvent> InputDispatcher::verifyInputEvent(const InputEvent& event) {
-    std::array<uint8_t, 32> calculatedHmac;
     std::unique_ptr<VerifiedInputEvent> result;
     switch (event.getType()) {
         case AINPUT_EVENT_TYPE_KEY: {
             const KeyEvent& keyEvent = static_cast<const KeyEvent&>(event);
             VerifiedKeyEvent verifiedKeyEvent = verifiedKeyEventFromKeyEvent(keyEvent);
             result = std::make_unique<VerifiedKeyEvent>(verifiedKeyEvent);
-            calculatedHmac = mHmacKeyManager.sign(verifiedKeyEvent);
             break;
         }
         case AINPUT_EVENT_TYPE_MOTION: {
@@ -3526,7 +3676,6 @@ std::unique_ptr<VerifiedInputEvent> InputDispatcher::verifyInputEvent(const Inpu
             VerifiedMotionEvent verifiedMotionEvent =
                     verifiedMotionEventFromMotionEvent(motionEvent);
             result = std::make_unique<VerifiedMotionEvent>(verifiedMotionEvent);
-            calculatedHmac = mHmacKeyManager.sign(verifiedMotionEvent);
             break;
         }
         default: {
@@ -3534,6 +3683,11 @@ std::unique_ptr<VerifiedInputEvent> InputDispatcher::verifyInputEvent(const Inpu
             return nullptr;
         }
     }
+    if (mRecentEventTokens) {
+        // The event carries the token it was dispatched with rather than an HMAC.
+        return mRecentEventTokens->contains(*result, event.getHmac()) ? std::move(result) : nullptr;
+    }
+    const std::array<uint8_t, 32> calculatedHmac = mHmacKeyManager.sign(*result);
     if (calculatedHmac == INVALID_HMAC) {
         return nullptr;
     }
@@ -3598,9 +3752,11 @@ void InputDispatcher::decrementPendingForegroundDispatches(EventEntry* entry) {
     }
 }
 
-std::vector<sp<InputWindowHandle>> InputDispatcher::getWindowHandlesLocked(
+const std::vector<sp<InputWindowHandle>>& InputDispatcher::getWindowHandlesLocked(
         int32_t displayId) const {
-    return getValueByKey(mWindowHandlesByDisplay, displayId);
+    static const std::vector<sp<InputWindowHandle>> EMPTY_WINDOW_HANDLES;
+    auto it = mWindowHandlesByDisplay.find(displayId);
+    return it != mWindowHandlesByDisplay.end() ? it->second : EMPTY_WINDOW_HANDLES;
 }
 
 sp<InputWindowHandle> InputDispatcher::getFocusedWindowHandleLocked(int displayId) const {
@@ -3656,6 +3812,7 @@ void InputDispatcher::updateWindowHandlesForDisplayLocked(
     if (inputWindowHandles.empty()) {
         // Remove all handles on a display if there are no windows left.
         mWindowHandlesByDisplay.erase(displayId);
+        mTouchableWindowIndexByDisplay.erase(displayId);
         return;
     }
 
@@ -3707,6 +3864,7 @@ void InputDispatcher::updateWindowHandlesForDisplayLocked(
 
     // Insert or replace
     mWindowHandlesByDisplay[displayId] = newHandles;
+    mTouchableWindowIndexByDisplay[displayId].build(mWindowHandlesByDisplay[displayId]);
 }
 
 void InputDispatcher::setInputWindows(
@@ -3740,6 +3898,7 @@ void InputDispatcher::setInputWindowsLocked(
 
     // Copy old handles for release if they are no longer present.
     const std::vector<sp<InputWindowHandle>> oldWindowHandles = getWindowHandlesLocked(displayId);
+    mCachedTouchTargetsByDisplay.clear();
 
     updateWindowHandlesForDisplayLocked(inputWindowHandles, displayId);
 
@@ -4012,6 +4171,7 @@ bool InputDispatcher::transferTouchFocus(const sp<IBinder>& fromToken, const sp<
             return false;
         }
 
+        mCachedTouchTargetsByDisplay.clear();
         bool found = false;
         for (std::pair<const int32_t, TouchState>& pair : mTouchStatesByDisplay) {
             TouchState& state = pair.second;
@@ -4078,6 +4238,7 @@ void InputDispatcher::resetAndDropEverythingLocked(const char* reason) {
 
     mAnrTracker.clear();
     mTouchStatesByDisplay.clear();
+    mCachedTouchTargetsByDisplay.clear();
     mLastHoverWindowHandle.clear();
     mReplacedKeys.clear();
 }
@@ -4256,6 +4417,19 @@ void InputDispatcher::dumpDispatchStateLocked(std::string& dump) {
         dump += INDENT "InboundQueue: <empty>\n";
     }
 
+    dump += INDENT "EntryAllocations:\n";
+    const auto dumpAllocationStats = [&dump](const char* name, const EntryAllocationStats& stats) {
+        dump += StringPrintf(INDENT2 "%s: allocations=%zu, heapAllocations=%zu, pooled=%zu\n",
+                             name, stats.allocations, stats.heapAllocations,
+                             stats.pooledEntries);
+    };
+    dumpAllocationStats("KeyEntry", KeyEntry::getAllocationStats());
+    dumpAllocationStats("MotionEntry", MotionEntry::getAllocationStats());
+    dumpAllocationStats("DispatchEntry", DispatchEntry::getAllocationStats());
+
+    dump += INDENT "Latency:\n";
+    dump += mLatencyTracker.dump(INDENT2);
+
     if (!mReplacedKeys.empty()) {
         dump += INDENT "ReplacedKeys:\n";
         for (const std::pair<KeyReplacement, int32_t>& pair : mReplacedKeys) {
@@ -4354,6 +4528,7 @@ status_t InputDispatcher::registerInputChannel(const sp<InputChannel>& inputChan
 
         int fd = inputChannel->getFd();
         mConnectionsByFd[fd] = connection;
+        mConnectionsByToken[inputChannel->getConnectionToken()] = connection;
         mInputChannelsByToken[inputChannel->getConnectionToken()] = inputChannel;
 
         mLooper->addFd(fd, 0, ALOOPER_EVENT_INPUT, handleReceiveCallback, this);
@@ -4383,6 +4558,7 @@ status_t InputDispatcher::registerInputMonitor(const sp<InputChannel>& inputChan
 
         const int fd = inputChannel->getFd();
         mConnectionsByFd[fd] = connection;
+        mConnectionsByToken[inputChannel->getConnectionToken()] = connection;
         mInputChannelsByToken[inputChannel->getConnectionToken()] = inputChannel;
 
         auto& monitorsByDisplay =
@@ -4427,6 +4603,7 @@ status_t InputDispatcher::unregisterInputChannelLocked(const sp<InputChannel>& i
 
     removeConnectionLocked(connection);
     mInputChannelsByToken.erase(inputChannel->getConnectionToken());
+    mCachedTouchTargetsByDisplay.clear();
 
     if (connection->monitor) {
         removeMonitorChannelLocked(inputChannel);
@@ -4511,6 +4688,7 @@ status_t InputDispatcher::pilferPointers(const sp<IBinder>& token) {
         }
         // Then clear the current touch state so we stop dispatching to them as well.
         state.filterNonMonitors();
+        mCachedTouchTargetsByDisplay.erase(displayId);
     }
     return OK;
 }
@@ -4532,31 +4710,27 @@ sp<Connection> InputDispatcher::getConnectionLocked(const sp<IBinder>& inputConn
     if (inputConnectionToken == nullptr) {
         return nullptr;
     }
-
-    for (const auto& pair : mConnectionsByFd) {
-        const sp<Connection>& connection = pair.second;
-        if (connection->inputChannel->getConnectionToken() == inputConnectionToken) {
-            return connection;
-        }
-    }
-
-    return nullptr;
+    auto it = mConnectionsByToken.find(inputConnectionToken);
+    return it != mConnectionsByToken.end() ? it->second : nullptr;
 }
 
 void InputDispatcher::removeConnectionLocked(const sp<Connection>& connection) {
     mAnrTracker.eraseToken(connection->inputChannel->getConnectionToken());
+    mLatencyTracker.eraseToken(connection->inputChannel->getConnectionToken());
     removeByValue(mConnectionsByFd, connection);
+    mConnectionsByToken.erase(connection->inputChannel->getConnectionToken());
 }
 
 void InputDispatcher::onDispatchCycleFinishedLocked(nsecs_t currentTime,
                                                     const sp<Connection>& connection, uint32_t seq,
-                                                    bool handled) {
+                                                    bool handled, nsecs_t consumeTime) {
     std::unique_ptr<CommandEntry> commandEntry = std::make_unique<CommandEntry>(
             &InputDispatcher::doDispatchCycleFinishedLockedInterruptible);
     commandEntry->connection = connection;
     commandEntry->eventTime = currentTime;
     commandEntry->seq = seq;
     commandEntry->handled = handled;
+    commandEntry->consumeTime = consumeTime;
     postCommandLocked(std::move(commandEntry));
 }
 
@@ -4806,6 +4980,14 @@ void InputDispatcher::doDispatchCycleFinishedLockedInterruptible(CommandEntry* c
               ns2ms(eventDuration), dispatchEntry->eventEntry->getDescription().c_str());
     }
     reportDispatchStatistics(std::chrono::nanoseconds(eventDuration), *connection, handled);
+    const EventEntry& eventEntry = *dispatchEntry->eventEntry;
+    if (eventEntry.enqueueTime != 0 && !eventEntry.isInjected()) {
+        mLatencyTracker.trackFinishedEvent(connection->inputChannel->getConnectionToken(),
+                                           connection->getWindowName(),
+                                           {eventEntry.eventTime, eventEntry.enqueueTime,
+                                            dispatchEntry->deliveryTime, commandEntry->consumeTime,
+                                            finishTime});
+    }
 
     bool restartEvent;
     if (dispatchEntry->eventEntry->type == EventEntry::Type::KEY) {
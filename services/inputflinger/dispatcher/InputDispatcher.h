@@ -27,8 +27,11 @@
 #include "InputState.h"
 #include "InputTarget.h"
 #include "InputThread.h"
+#include "LatencyTracker.h"
+#include "LockFreeQueue.h"
 #include "Monitor.h"
 #include "TouchState.h"
+#include "TouchableWindowIndex.h"
 #include "TouchedWindow.h"
 
 #include <input/Input.h>
@@ -45,8 +48,10 @@
 #include <utils/RefBase.h>
 #include <utils/Timers.h>
 #include <utils/threads.h>
+#include <atomic>
 #include <condition_variable>
 #include <deque>
+#include <mutex>
 #include <optional>
 #include <unordered_map>
 
@@ -67,6 +72,30 @@ private:
     const std::array<uint8_t, 128> mHmacKey;
 };
 
+/**
+ * Remembers the last events dispatched to applications, each with a random token that is sent in
+ * place of its HMAC. An event is verified by finding its token and contents among them.
+ */
+class RecentEventTokens {
+public:
+    explicit RecentEventTokens(size_t capacity);
+    std::array<uint8_t, 32> add(const VerifiedInputEvent& event);
+    bool contains(const VerifiedInputEvent& event, const std::array<uint8_t, 32>& token) const;
+
+private:
+    struct Entry {
+        std::array<uint8_t, 32> token;
+        std::array<uint8_t, std::max(sizeof(VerifiedKeyEvent), sizeof(VerifiedMotionEvent))> data;
+        size_t size;
+    };
+
+    mutable std::mutex mLock;
+    // A ring buffer of the entries, where mNextIndex is the oldest once it is full.
+    std::vector<Entry> mEntries GUARDED_BY(mLock);
+    size_t mNextIndex GUARDED_BY(mLock) = 0;
+    const size_t mCapacity;
+};
+
 /* Dispatches events to input targets.  Some functions of the input dispatcher, such as
  * identifying input targets, are controlled by a separate policy object.
  *
@@ -153,6 +182,9 @@ private:
 
     EventEntry* mPendingEvent GUARDED_BY(mLock);
     std::deque<EventEntry*> mInboundQueue GUARDED_BY(mLock);
+    // Events reported by notifyKey and notifyMotion, which are queued without holding mLock.
+    // The dispatcher thread moves them to mInboundQueue.
+    LockFreeQueue<EventEntry*> mNewInboundQueue;
     std::deque<EventEntry*> mRecentQueue GUARDED_BY(mLock);
     std::deque<std::unique_ptr<CommandEntry>> mCommandQueue GUARDED_BY(mLock);
 
@@ -167,8 +199,14 @@ private:
 
     void dispatchOnceInnerLocked(nsecs_t* nextWakeupTime) REQUIRES(mLock);
 
-    // Enqueues an inbound event.  Returns true if mLooper->wake() should be called.
+    // Enqueues an inbound event after the pending events of mNewInboundQueue.  Returns true if
+    // mLooper->wake() should be called.
     bool enqueueInboundEventLocked(EventEntry* entry) REQUIRES(mLock);
+    bool appendInboundEventLocked(EventEntry* entry) REQUIRES(mLock);
+
+    // Moves the events of mNewInboundQueue to mInboundQueue.  Returns true if mLooper->wake()
+    // should be called.
+    bool enqueueNewInboundEventsLocked() REQUIRES(mLock);
 
     // Cleans up input state when dropping an inbound event.
     void dropInboundEventLocked(const EventEntry& entry, DropReason dropReason) REQUIRES(mLock);
@@ -209,6 +247,10 @@ private:
             return std::hash<IBinder*>{}(b.get());
         }
     };
+    // The registered connections mapped by connection token, so that dispatching to every
+    // window and monitor target does not scan all of the connections.
+    std::unordered_map<sp<IBinder>, sp<Connection>, IBinderHash> mConnectionsByToken
+            GUARDED_BY(mLock);
     std::unordered_map<sp<IBinder>, sp<InputChannel>, IBinderHash> mInputChannelsByToken
             GUARDED_BY(mLock);
 
@@ -226,6 +268,8 @@ private:
     std::unordered_map<int32_t, std::vector<Monitor>> mGestureMonitorsByDisplay GUARDED_BY(mLock);
 
     const HmacKeyManager mHmacKeyManager;
+    // Set when only recent events can be verified, see verifiedEventHistorySize.
+    std::unique_ptr<RecentEventTokens> mRecentEventTokens;
     const std::array<uint8_t, 32> getSignature(const MotionEntry& motionEntry,
                                                const DispatchEntry& dispatchEntry) const;
     const std::array<uint8_t, 32> getSignature(const KeyEntry& keyEntry,
@@ -277,8 +321,8 @@ private:
     nsecs_t getDispatchingTimeoutLocked(const sp<IBinder>& token) REQUIRES(mLock);
 
     // Input filter processing.
-    bool shouldSendKeyToInputFilterLocked(const NotifyKeyArgs* args) REQUIRES(mLock);
-    bool shouldSendMotionToInputFilterLocked(const NotifyMotionArgs* args) REQUIRES(mLock);
+    bool shouldSendKeyToInputFilter(const NotifyKeyArgs* args);
+    bool shouldSendMotionToInputFilter(const NotifyMotionArgs* args);
 
     // Inbound event processing.
     void drainInboundQueueLocked() REQUIRES(mLock);
@@ -288,15 +332,20 @@ private:
     // Dispatch state.
     bool mDispatchEnabled GUARDED_BY(mLock);
     bool mDispatchFrozen GUARDED_BY(mLock);
-    bool mInputFilterEnabled GUARDED_BY(mLock);
+    // Written with mLock held, read without it by notifyKey and notifyMotion.
+    std::atomic<bool> mInputFilterEnabled;
     bool mInTouchMode GUARDED_BY(mLock);
 
     std::unordered_map<int32_t, std::vector<sp<InputWindowHandle>>> mWindowHandlesByDisplay
             GUARDED_BY(mLock);
+    // Spatial index of mWindowHandlesByDisplay used to find touched windows, rebuilt whenever the
+    // windows of a display are updated.
+    std::unordered_map<int32_t, TouchableWindowIndex> mTouchableWindowIndexByDisplay
+            GUARDED_BY(mLock);
     void setInputWindowsLocked(const std::vector<sp<InputWindowHandle>>& inputWindowHandles,
                                int32_t displayId) REQUIRES(mLock);
     // Get window handles by display, return an empty vector if not found.
-    std::vector<sp<InputWindowHandle>> getWindowHandlesLocked(int32_t displayId) const
+    const std::vector<sp<InputWindowHandle>>& getWindowHandlesLocked(int32_t displayId) const
             REQUIRES(mLock);
     sp<InputWindowHandle> getWindowHandleLocked(const sp<IBinder>& windowHandleToken) const
             REQUIRES(mLock);
@@ -317,6 +366,17 @@ private:
 
     std::unordered_map<int32_t, TouchState> mTouchStatesByDisplay GUARDED_BY(mLock);
 
+    // The targets of the last move of the ongoing gesture on each display. They are reused for
+    // the following moves of the same device, which cannot change the targets, until the touch
+    // state or the windows change.
+    struct CachedTouchTargets {
+        int32_t deviceId;
+        uint32_t source;
+        std::vector<InputTarget> inputTargets;
+    };
+    std::unordered_map<int32_t, CachedTouchTargets> mCachedTouchTargetsByDisplay
+            GUARDED_BY(mLock);
+
     // Focused applications.
     std::unordered_map<int32_t, sp<InputApplicationHandle>> mFocusedApplicationHandlesByDisplay
             GUARDED_BY(mLock);
@@ -379,6 +439,7 @@ private:
     // Once a connection becomes unresponsive, its entries are removed from AnrTracker to
     // prevent unneeded wakeups.
     AnrTracker mAnrTracker GUARDED_BY(mLock);
+    LatencyTracker mLatencyTracker GUARDED_BY(mLock);
     void extendAnrTimeoutsLocked(const sp<InputApplicationHandle>& application,
                                  const sp<IBinder>& connectionToken, nsecs_t timeoutExtension)
             REQUIRES(mLock);
@@ -442,7 +503,8 @@ private:
     void startDispatchCycleLocked(nsecs_t currentTime, const sp<Connection>& connection)
             REQUIRES(mLock);
     void finishDispatchCycleLocked(nsecs_t currentTime, const sp<Connection>& connection,
-                                   uint32_t seq, bool handled) REQUIRES(mLock);
+                                   uint32_t seq, bool handled, nsecs_t consumeTime)
+            REQUIRES(mLock);
     void abortBrokenDispatchCycleLocked(nsecs_t currentTime, const sp<Connection>& connection,
                                         bool notify) REQUIRES(mLock);
     void drainDispatchQueue(std::deque<DispatchEntry*>& queue);
@@ -490,7 +552,8 @@ private:
 
     // Interesting events that we might like to log or tell the framework about.
     void onDispatchCycleFinishedLocked(nsecs_t currentTime, const sp<Connection>& connection,
-                                       uint32_t seq, bool handled) REQUIRES(mLock);
+                                       uint32_t seq, bool handled, nsecs_t consumeTime)
+            REQUIRES(mLock);
     void onDispatchCycleBrokenLocked(nsecs_t currentTime, const sp<Connection>& connection)
             REQUIRES(mLock);
     void onFocusChangedLocked(const sp<InputWindowHandle>& oldFocus,
@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "LatencyTracker.h"
+
+#include <android-base/stringprintf.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <algorithm>
+
+using android::base::StringPrintf;
+
+namespace android::inputdispatcher {
+
+// --- LatencyHistogram ---
+
+void LatencyHistogram::addValue(nsecs_t duration) {
+    // Durations between timestamps of different sources may be slightly negative.
+    duration = std::max(duration, nsecs_t(0));
+
+    size_t bucket = 0;
+    nsecs_t bound = FIRST_BUCKET_BOUND;
+    while (bucket + 1 < BUCKET_COUNT && duration >= bound) {
+        bucket++;
+        bound *= 2;
+    }
+    mBuckets[bucket]++;
+    mCount++;
+    mSum += duration;
+    mMax = std::max(mMax, duration);
+}
+
+nsecs_t LatencyHistogram::getMean() const {
+    return mCount != 0 ? mSum / static_cast<nsecs_t>(mCount) : 0;
+}
+
+nsecs_t LatencyHistogram::getPercentileBound(int percentile) const {
+    // The number of values at or below the percentile, rounded up.
+    const size_t rank = (mCount * percentile + 99) / 100;
+    size_t count = 0;
+    nsecs_t bound = FIRST_BUCKET_BOUND;
+    for (size_t bucket = 0; bucket + 1 < BUCKET_COUNT; bucket++) {
+        count += mBuckets[bucket];
+        if (count >= rank) {
+            return bound;
+        }
+        bound *= 2;
+    }
+    return LLONG_MAX;
+}
+
+static std::string boundToString(nsecs_t bound) {
+    if (bound == LLONG_MAX) {
+        return "inf";
+    }
+    return StringPrintf("%.3fms", bound / 1000000.0);
+}
+
+std::string LatencyHistogram::dump() const {
+    if (mCount == 0) {
+        return "count=0";
+    }
+    std::string dump = StringPrintf("count=%zu, mean=%.3fms, max=%.3fms, p50<=%s, p90<=%s, "
+                                    "p99<=%s, buckets=[",
+                                    mCount, getMean() / 1000000.0, mMax / 1000000.0,
+                                    boundToString(getPercentileBound(50)).c_str(),
+                                    boundToString(getPercentileBound(90)).c_str(),
+                                    boundToString(getPercentileBound(99)).c_str());
+    for (size_t bucket = 0; bucket < BUCKET_COUNT; bucket++) {
+        dump += StringPrintf(bucket == 0 ? "%zu" : ", %zu", mBuckets[bucket]);
+    }
+    dump += "]";
+    return dump;
+}
+
+// --- LatencyTracker ---
+
+void LatencyTracker::trackFinishedEvent(const sp<IBinder>& connectionToken,
+                                        const std::string& name, const Timeline& timeline) {
+    ConnectionLatency& latency = mConnectionLatencies[connectionToken];
+    latency.name = name;
+    latency.input.addValue(timeline.enqueueTime - timeline.eventTime);
+    latency.dispatch.addValue(timeline.deliveryTime - timeline.enqueueTime);
+    if (timeline.consumeTime != 0) {
+        latency.transport.addValue(timeline.consumeTime - timeline.deliveryTime);
+        latency.app.addValue(timeline.finishTime - timeline.consumeTime);
+        latency.endToEnd.addValue(timeline.consumeTime - timeline.eventTime);
+    }
+}
+
+void LatencyTracker::eraseToken(const sp<IBinder>& connectionToken) {
+    mConnectionLatencies.erase(connectionToken);
+}
+
+std::string LatencyTracker::dump(const char* prefix) const {
+    if (mConnectionLatencies.empty()) {
+        return StringPrintf("%s<none>\n", prefix);
+    }
+    std::string dump;
+    for (const auto& [token, latency] : mConnectionLatencies) {
+        dump += StringPrintf("%s%s:\n", prefix, latency.name.c_str());
+        dump += StringPrintf("%s  input: %s\n", prefix, latency.input.dump().c_str());
+        dump += StringPrintf("%s  dispatch: %s\n", prefix, latency.dispatch.dump().c_str());
+        dump += StringPrintf("%s  transport: %s\n", prefix, latency.transport.dump().c_str());
+        dump += StringPrintf("%s  app: %s\n", prefix, latency.app.dump().c_str());
+        dump += StringPrintf("%s  endToEnd: %s\n", prefix, latency.endToEnd.dump().c_str());
+    }
+    return dump;
+}
+
+} // namespace android::inputdispatcher
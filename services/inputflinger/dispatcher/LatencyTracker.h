@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef _UI_INPUT_INPUTDISPATCHER_LATENCYTRACKER_H
+#define _UI_INPUT_INPUTDISPATCHER_LATENCYTRACKER_H
+
+#include <binder/IBinder.h>
+#include <utils/Timers.h>
+#include <array>
+#include <map>
+#include <string>
+
+namespace android::inputdispatcher {
+
+/**
+ * A distribution of durations, in buckets whose bounds grow exponentially from 125us to 2s.
+ */
+class LatencyHistogram {
+public:
+    static constexpr size_t BUCKET_COUNT = 16;
+    // The upper bound of the first bucket. Each following bucket covers twice the duration, and
+    // the last one is unbounded.
+    static constexpr nsecs_t FIRST_BUCKET_BOUND = 125000; // 125us
+
+    void addValue(nsecs_t duration);
+
+    size_t getCount() const { return mCount; }
+    nsecs_t getMax() const { return mMax; }
+    nsecs_t getMean() const;
+    // Returns the upper bound of the bucket that holds the given percentile, or LLONG_MAX if
+    // that is the last bucket.
+    nsecs_t getPercentileBound(int percentile) const;
+    const std::array<size_t, BUCKET_COUNT>& getBuckets() const { return mBuckets; }
+
+    std::string dump() const;
+
+private:
+    std::array<size_t, BUCKET_COUNT> mBuckets{};
+    size_t mCount = 0;
+    nsecs_t mSum = 0;
+    nsecs_t mMax = 0;
+};
+
+/**
+ * Aggregates, per connection, the time that the events from the input devices spend in each
+ * stage of their delivery:
+ * - input: from the kernel timestamp to the enqueueing in the dispatcher, which covers the
+ *   processing of the input reader and classifier,
+ * - dispatch: from the enqueueing to the publishing on the input channel,
+ * - transport: from the publishing to the consumer reading the event,
+ * - app: from the consumer reading the event to the dispatcher receiving its finished signal,
+ * - endToEnd: from the kernel timestamp to the consumer reading the event.
+ * The stages that depend on the consume time are only tracked when the consumer reports it.
+ */
+class LatencyTracker {
+public:
+    struct Timeline {
+        nsecs_t eventTime;    // the kernel timestamp of the event
+        nsecs_t enqueueTime;  // when the dispatcher was notified of the event
+        nsecs_t deliveryTime; // when the event was published to the connection
+        nsecs_t consumeTime;  // when the consumer read the event, or 0 if unknown
+        nsecs_t finishTime;   // when the dispatcher received the finished signal
+    };
+
+    struct ConnectionLatency {
+        std::string name;
+        LatencyHistogram input;
+        LatencyHistogram dispatch;
+        LatencyHistogram transport;
+        LatencyHistogram app;
+        LatencyHistogram endToEnd;
+    };
+
+    void trackFinishedEvent(const sp<IBinder>& connectionToken, const std::string& name,
+                            const Timeline& timeline);
+    void eraseToken(const sp<IBinder>& connectionToken);
+
+    const std::map<sp<IBinder>, ConnectionLatency>& getConnectionLatencies() const {
+        return mConnectionLatencies;
+    }
+
+    std::string dump(const char* prefix) const;
+
+private:
+    std::map<sp<IBinder>, ConnectionLatency> mConnectionLatencies;
+};
+
+} // namespace android::inputdispatcher
+
+#endif // _UI_INPUT_INPUTDISPATCHER_LATENCYTRACKER_H
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _UI_INPUT_INPUTDISPATCHER_LOCKFREEQUEUE_H
+#define _UI_INPUT_INPUTDISPATCHER_LOCKFREEQUEUE_H
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+namespace android::inputdispatcher {
+
+/**
+ * An unbounded queue with multiple producers and a single consumer, which producers push to
+ * without taking a lock. The consumer takes all the queued elements at once.
+ *
+ * The elements are kept in a lock-free stack. Pushing links a node at the top with a
+ * compare-and-swap, which only has to be retried when another producer pushed at the same time,
+ * and popping detaches the whole stack with a single exchange.
+ */
+template <typename T>
+class LockFreeQueue {
+public:
+    LockFreeQueue() = default;
+    LockFreeQueue(const LockFreeQueue&) = delete;
+    LockFreeQueue& operator=(const LockFreeQueue&) = delete;
+
+    ~LockFreeQueue() { popAll(); }
+
+    // Push an element. Return true if the queue was empty, in which case the consumer may have
+    // to be woken up.
+    bool push(T value) {
+        Node* node = new Node{std::move(value), mTop.load(std::memory_order_relaxed)};
+        while (!mTop.compare_exchange_weak(node->next, node, std::memory_order_release,
+                                           std::memory_order_relaxed)) {
+        }
+        return node->next == nullptr;
+    }
+
+    // Return whether the queue is empty. Producers may push at any time, so unless they have
+    // been stopped, the result is only a hint.
+    bool empty() const { return mTop.load(std::memory_order_relaxed) == nullptr; }
+
+    // Remove all the elements, and return them in the order they were pushed. Only the
+    // consumer may call this.
+    std::vector<T> popAll() {
+        std::vector<T> values;
+        Node* node = mTop.exchange(nullptr, std::memory_order_acquire);
+        while (node != nullptr) {
+            values.push_back(std::move(node->value));
+            Node* next = node->next;
+            delete node;
+            node = next;
+        }
+        std::reverse(values.begin(), values.end());
+        return values;
+    }
+
+private:
+    struct Node {
+        T value;
+        Node* next;
+    };
+
+    std::atomic<Node*> mTop{nullptr};
+};
+
+} // namespace android::inputdispatcher
+
+#endif // _UI_INPUT_INPUTDISPATCHER_LOCKFREEQUEUE_H
@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "TouchableWindowIndex.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace android::inputdispatcher {
+
+void TouchableWindowIndex::build(const std::vector<sp<InputWindowHandle>>& windowHandles) {
+    clear();
+
+    // Classify the windows the same way findTouchedWindowAtLocked checks them.
+    std::vector<std::pair<uint32_t /*index*/, Rect /*bounds*/>> boundedCandidates;
+    std::vector<bool> unbounded(windowHandles.size(), false);
+    for (uint32_t i = 0; i < windowHandles.size(); i++) {
+        const InputWindowInfo* info = windowHandles[i]->getInfo();
+        if (!info->visible) {
+            continue;
+        }
+        const int32_t flags = info->layoutParamsFlags;
+        const bool touchable = !(flags & InputWindowInfo::FLAG_NOT_TOUCHABLE);
+        const bool isTouchModal = (flags &
+                                   (InputWindowInfo::FLAG_NOT_FOCUSABLE |
+                                    InputWindowInfo::FLAG_NOT_TOUCH_MODAL)) == 0;
+        if ((touchable && isTouchModal) || (flags & InputWindowInfo::FLAG_WATCH_OUTSIDE_TOUCH)) {
+            unbounded[i] = true;
+            mUnboundedCandidates.push_back(i);
+        } else if (touchable && !info->touchableRegion.isEmpty()) {
+            const Rect bounds = info->touchableRegion.getBounds();
+            boundedCandidates.emplace_back(i, bounds);
+            if (boundedCandidates.size() == 1) {
+                mBounds = bounds;
+            } else {
+                mBounds.left = std::min(mBounds.left, bounds.left);
+                mBounds.top = std::min(mBounds.top, bounds.top);
+                mBounds.right = std::max(mBounds.right, bounds.right);
+                mBounds.bottom = std::max(mBounds.bottom, bounds.bottom);
+            }
+        }
+    }
+
+    if (boundedCandidates.empty()) {
+        return;
+    }
+
+    const int32_t gridSize =
+            std::clamp(static_cast<int32_t>(std::ceil(std::sqrt(boundedCandidates.size()))), 1,
+                       MAX_GRID_SIZE);
+    mCellWidth = std::max((mBounds.getWidth() + gridSize - 1) / gridSize, 1);
+    mCellHeight = std::max((mBounds.getHeight() + gridSize - 1) / gridSize, 1);
+    mColumns = (mBounds.getWidth() + mCellWidth - 1) / mCellWidth;
+    mRows = (mBounds.getHeight() + mCellHeight - 1) / mCellHeight;
+    mCells.resize(mColumns * mRows);
+
+    // Walk the windows front to back so that every cell lists its windows in z-order.
+    auto bounded = boundedCandidates.begin();
+    for (uint32_t i = 0; i < windowHandles.size(); i++) {
+        if (unbounded[i]) {
+            for (std::vector<uint32_t>& cell : mCells) {
+                cell.push_back(i);
+            }
+        } else if (bounded != boundedCandidates.end() && bounded->first == i) {
+            const Rect& bounds = bounded->second;
+            const int32_t left = (bounds.left - mBounds.left) / mCellWidth;
+            const int32_t right = (bounds.right - 1 - mBounds.left) / mCellWidth;
+            const int32_t top = (bounds.top - mBounds.top) / mCellHeight;
+            const int32_t bottom = (bounds.bottom - 1 - mBounds.top) / mCellHeight;
+            for (int32_t row = top; row <= bottom; row++) {
+                for (int32_t column = left; column <= right; column++) {
+                    mCells[row * mColumns + column].push_back(i);
+                }
+            }
+            bounded++;
+        }
+    }
+}
+
+void TouchableWindowIndex::clear() {
+    mBounds.clear();
+    mColumns = 0;
+    mRows = 0;
+    mCellWidth = 0;
+    mCellHeight = 0;
+    mCells.clear();
+    mUnboundedCandidates.clear();
+}
+
+const std::vector<uint32_t>& TouchableWindowIndex::getCandidates(int32_t x, int32_t y) const {
+    if (mCells.empty() || x < mBounds.left || x >= mBounds.right || y < mBounds.top ||
+        y >= mBounds.bottom) {
+        return mUnboundedCandidates;
+    }
+    return getCell((x - mBounds.left) / mCellWidth, (y - mBounds.top) / mCellHeight);
+}
+
+} // namespace android::inputdispatcher
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _UI_INPUT_INPUTDISPATCHER_TOUCHABLEWINDOWINDEX_H
+#define _UI_INPUT_INPUTDISPATCHER_TOUCHABLEWINDOWINDEX_H
+
+#include <input/InputWindow.h>
+#include <ui/Rect.h>
+#include <utils/StrongPointer.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace android::inputdispatcher {
+
+/**
+ * A spatial index over the windows of a display, used to find the windows that a touch at a
+ * given point may be dispatched to without walking every window on the display.
+ *
+ * The bounds of the touchable regions are bucketed into a uniform grid. Windows that can be
+ * targeted regardless of where the touch is, i.e. touch modal windows and windows watching
+ * outside touches, are added to every cell. Each cell lists its windows front to back, so the
+ * candidates for a point can be checked in the same order as the full window list.
+ *
+ * The index does not keep references to the windows; it must be rebuilt whenever the window
+ * list or the info of one of its windows changes.
+ */
+class TouchableWindowIndex {
+public:
+    void build(const std::vector<sp<InputWindowHandle>>& windowHandles);
+    void clear();
+
+    // Return the indices into the window list the index was built from of the windows that may
+    // be touched at, or may watch touches outside of, the given point, front to back. Windows
+    // that are not returned are neither touched at the point nor watching outside touches.
+    const std::vector<uint32_t>& getCandidates(int32_t x, int32_t y) const;
+
+private:
+    // Upper bound of the number of rows and columns of the grid.
+    static constexpr int32_t MAX_GRID_SIZE = 16;
+
+    const std::vector<uint32_t>& getCell(int32_t column, int32_t row) const {
+        return mCells[row * mColumns + column];
+    }
+
+    // The union of the bounds of the touchable regions, covered by the grid.
+    Rect mBounds;
+    int32_t mColumns = 0;
+    int32_t mRows = 0;
+    int32_t mCellWidth = 0;
+    int32_t mCellHeight = 0;
+    std::vector<std::vector<uint32_t>> mCells;
+    // The windows that are candidates at every point, used for points outside of the grid.
+    std::vector<uint32_t> mUnboundedCandidates;
+};
+
+} // namespace android::inputdispatcher
+
+#endif // _UI_INPUT_INPUTDISPATCHER_TOUCHABLEWINDOWINDEX_H
@@ -35,8 +35,16 @@ struct InputDispatcherConfiguration {
     // The key repeat inter-key delay.
     nsecs_t keyRepeatDelay;
 
+    // The number of recently dispatched events that applications can verify, or 0 to sign every
+    // event with an HMAC as it is dispatched so that any event can be verified.
+    // When set, events are sent with a random token instead of an HMAC, and verifying an event
+    // looks up its token among the recent events, which is much cheaper than signing each one.
+    size_t verifiedEventHistorySize;
+
     InputDispatcherConfiguration()
-          : keyRepeatTimeout(500 * 1000000LL), keyRepeatDelay(50 * 1000000LL) {}
+          : keyRepeatTimeout(500 * 1000000LL),
+            keyRepeatDelay(50 * 1000000LL),
+            verifiedEventHistorySize(0) {}
 };
 
 } // namespace android
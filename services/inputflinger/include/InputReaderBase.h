@@ -249,6 +249,12 @@ struct InputReaderConfiguration {
     // True if pointer capture is enabled.
     bool pointerCapture;
 
+    // True to process the events of keyboard devices before those of other devices that were
+    // read at the same time, and to send them to the listener first, so that devices with a
+    // high event rate, such as touch screens and styluses, do not delay key events. The order of
+    // the events of each device is kept.
+    bool prioritizeKeyboardDevices;
+
     // The set of currently disabled input devices.
     std::set<int32_t> disabledDevices;
 
@@ -268,7 +274,7 @@ struct InputReaderConfiguration {
             pointerGestureSwipeMaxWidthRatio(0.25f),
             pointerGestureMovementSpeedRatio(0.8f),
             pointerGestureZoomSpeedRatio(0.3f),
-            showTouches(false), pointerCapture(false) { }
+            showTouches(false), pointerCapture(false), prioritizeKeyboardDevices(false) { }
 
     static std::string changesToString(uint32_t changes);
 
@@ -515,6 +515,33 @@ status_t EventHub::getAbsoluteAxisValue(int32_t deviceId, int32_t axis, int32_t*
     return -1;
 }
 
+status_t EventHub::getMtSlotValues(int32_t deviceId, int32_t axis, size_t slotCount,
+                                   std::vector<int32_t>* outValues) const {
+    outValues->clear();
+
+    if (axis >= 0 && axis <= ABS_MAX) {
+        AutoMutex _l(mLock);
+
+        Device* device = getDeviceLocked(deviceId);
+        if (device && device->hasValidFd() && test_bit(axis, device->absBitmask)) {
+            // EVIOCGMTSLOTS takes the axis code followed by room for the value of each slot.
+            std::vector<int32_t> request(slotCount + 1, 0);
+            request[0] = axis;
+            if (ioctl(device->fd, EVIOCGMTSLOTS(sizeof(int32_t) * request.size()),
+                      request.data())) {
+                ALOGW("Error reading multi-touch slot values of axis %d for device %s fd %d, "
+                      "errno=%d",
+                      axis, device->identifier.name.c_str(), device->fd, errno);
+                return -errno;
+            }
+
+            outValues->assign(request.begin() + 1, request.end());
+            return OK;
+        }
+    }
+    return -1;
+}
+
 bool EventHub::markSupportedKeyCodes(int32_t deviceId, size_t numCodes, const int32_t* keyCodes,
                                      uint8_t* outFlags) const {
     AutoMutex _l(mLock);
@@ -31,6 +31,7 @@
 #include <unistd.h>
 #include <utils/Errors.h>
 #include <utils/Thread.h>
+#include <algorithm>
 
 #include "InputDevice.h"
 
@@ -85,6 +86,7 @@ status_t InputReader::stop() {
 void InputReader::loopOnce() {
     int32_t oldGeneration;
     int32_t timeoutMillis;
+    bool prioritizeKeyboardDevices;
     bool inputDevicesChanged = false;
     std::vector<InputDeviceInfo> inputDevices;
     { // acquire lock
@@ -102,10 +104,25 @@ void InputReader::loopOnce() {
             nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
             timeoutMillis = toMillisecondTimeoutDelay(now, mNextTimeout);
         }
+        prioritizeKeyboardDevices = mConfig.prioritizeKeyboardDevices;
     } // release lock
 
     size_t count = mEventHub->getEvents(timeoutMillis, mEventBuffer, EVENT_BUFFER_SIZE);
 
+    if (count && prioritizeKeyboardDevices) {
+        size_t remainingCount;
+        { // acquire lock
+            AutoMutex _l(mLock);
+            remainingCount = processKeyboardEventsLocked(mEventBuffer, count);
+        } // release lock
+
+        if (remainingCount != count) {
+            // Send the key events out before processing the events of the other devices.
+            mQueuedListener->flush();
+        }
+        count = remainingCount;
+    }
+
     { // acquire lock
         AutoMutex _l(mLock);
         mReaderIsAliveCondition.broadcast();
@@ -184,6 +201,44 @@ void InputReader::processEventsLocked(const RawEvent* rawEvents, size_t count) {
     }
 }
 
+size_t InputReader::processKeyboardEventsLocked(RawEvent* rawEvents, size_t count) {
+    size_t remainingCount = 0;
+    size_t index = 0;
+    // Devices may be added or removed by the synthetic events, stop at the first one.
+    while (index < count && rawEvents[index].type < EventHubInterface::FIRST_SYNTHETIC_EVENT) {
+        const int32_t eventHubId = rawEvents[index].deviceId;
+        size_t batchSize = 1;
+        while (index + batchSize < count &&
+               rawEvents[index + batchSize].type < EventHubInterface::FIRST_SYNTHETIC_EVENT &&
+               rawEvents[index + batchSize].deviceId == eventHubId) {
+            batchSize += 1;
+        }
+
+        if (isKeyboardOnlyDeviceLocked(eventHubId)) {
+            processEventsForDeviceLocked(eventHubId, &rawEvents[index], batchSize);
+        } else {
+            // Keep the events for later, in order.
+            std::copy(&rawEvents[index], &rawEvents[index + batchSize], &rawEvents[remainingCount]);
+            remainingCount += batchSize;
+        }
+        index += batchSize;
+    }
+    std::copy(&rawEvents[index], &rawEvents[count], &rawEvents[remainingCount]);
+    return remainingCount + (count - index);
+}
+
+bool InputReader::isKeyboardOnlyDeviceLocked(int32_t eventHubId) {
+    auto deviceIt = mDevices.find(eventHubId);
+    if (deviceIt == mDevices.end()) {
+        return false;
+    }
+    const uint32_t classes = deviceIt->second->getClasses();
+    return (classes & INPUT_DEVICE_CLASS_KEYBOARD) &&
+            !(classes &
+              (INPUT_DEVICE_CLASS_TOUCH | INPUT_DEVICE_CLASS_CURSOR | INPUT_DEVICE_CLASS_JOYSTICK |
+               INPUT_DEVICE_CLASS_EXTERNAL_STYLUS | INPUT_DEVICE_CLASS_ROTARY_ENCODER));
+}
+
 void InputReader::addDeviceLocked(nsecs_t when, int32_t eventHubId) {
     if (mDevices.find(eventHubId) != mDevices.end()) {
         ALOGW("Ignoring spurious device added event for eventHubId %d.", eventHubId);
@@ -681,6 +736,9 @@ void InputReader::dump(std::string& dump) {
                          mConfig.wheelVelocityControlParameters.highThreshold,
                          mConfig.wheelVelocityControlParameters.acceleration);
 
+    dump += StringPrintf(INDENT2 "PrioritizeKeyboardDevices: %s\n",
+                         toString(mConfig.prioritizeKeyboardDevices));
+
     dump += StringPrintf(INDENT2 "PointerGesture:\n");
     dump += StringPrintf(INDENT3 "Enabled: %s\n", toString(mConfig.pointerGesturesEnabled));
     dump += StringPrintf(INDENT3 "QuietInterval: %0.1fms\n",
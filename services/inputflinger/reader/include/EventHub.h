@@ -211,6 +211,9 @@ public:
     virtual int32_t getSwitchState(int32_t deviceId, int32_t sw) const = 0;
     virtual status_t getAbsoluteAxisValue(int32_t deviceId, int32_t axis,
                                           int32_t* outValue) const = 0;
+    /* Reads the current value of a multi-touch axis in each of the first slotCount slots. */
+    virtual status_t getMtSlotValues(int32_t deviceId, int32_t axis, size_t slotCount,
+                                     std::vector<int32_t>* outValues) const = 0;
 
     /*
      * Examine key input devices for specific framework keycode support
@@ -289,6 +292,8 @@ public:
     virtual int32_t getSwitchState(int32_t deviceId, int32_t sw) const override;
     virtual status_t getAbsoluteAxisValue(int32_t deviceId, int32_t axis,
                                           int32_t* outValue) const override;
+    virtual status_t getMtSlotValues(int32_t deviceId, int32_t axis, size_t slotCount,
+                                     std::vector<int32_t>* outValues) const override;
 
     virtual bool markSupportedKeyCodes(int32_t deviceId, size_t numCodes, const int32_t* keyCodes,
                                        uint8_t* outFlags) const override;
@@ -244,6 +244,10 @@ public:
     inline status_t getAbsoluteAxisValue(int32_t code, int32_t* outValue) const {
         return mEventHub->getAbsoluteAxisValue(mId, code, outValue);
     }
+    inline status_t getMtSlotValues(int32_t code, size_t slotCount,
+                                    std::vector<int32_t>* outValues) const {
+        return mEventHub->getMtSlotValues(mId, code, slotCount, outValues);
+    }
     inline bool markSupportedKeyCodes(size_t numCodes, const int32_t* keyCodes,
                                       uint8_t* outFlags) const {
         return mEventHub->markSupportedKeyCodes(mId, numCodes, keyCodes, outFlags);
@@ -150,6 +150,10 @@ private:
 
     // low-level input event decoding and device management
     void processEventsLocked(const RawEvent* rawEvents, size_t count);
+    // Processes the events of keyboard devices up to the first device change, and removes them
+    // from rawEvents. Returns the number of events left.
+    size_t processKeyboardEventsLocked(RawEvent* rawEvents, size_t count);
+    bool isKeyboardOnlyDeviceLocked(int32_t eventHubId);
 
     void addDeviceLocked(nsecs_t when, int32_t eventHubId);
     void removeDeviceLocked(nsecs_t when, int32_t eventHubId);
@@ -49,8 +49,6 @@ void MultiTouchMotionAccumulator::configure(InputDeviceContext& deviceContext, s
 }
 
 void MultiTouchMotionAccumulator::reset(InputDeviceContext& deviceContext) {
-    // Unfortunately there is no way to read the initial contents of the slots.
-    // So when we reset the accumulator, we must assume they are all zeroes.
     if (mUsingSlotsProtocol) {
         // Query the driver for the current slot index and use it as the initial slot
         // before we start reading events from the device.  It is possible that the
@@ -68,11 +66,36 @@ void MultiTouchMotionAccumulator::reset(InputDeviceContext& deviceContext) {
             initialSlot = -1;
         }
         clearSlots(initialSlot);
+        // The slots are reset after the device is opened or an event buffer overrun, when
+        // touches may already be down. Read their current contents rather than assuming
+        // they are all zeroes, so that those touches are not lost until they next move.
+        readSlots(deviceContext);
     } else {
         clearSlots(-1);
     }
 }
 
+void MultiTouchMotionAccumulator::readSlots(InputDeviceContext& deviceContext) {
+    // The tracking id is last so that it decides whether each slot is in use.
+    static constexpr int32_t AXES[] = {ABS_MT_POSITION_X,  ABS_MT_POSITION_Y,
+                                       ABS_MT_TOUCH_MAJOR, ABS_MT_TOUCH_MINOR,
+                                       ABS_MT_WIDTH_MAJOR, ABS_MT_WIDTH_MINOR,
+                                       ABS_MT_ORIENTATION, ABS_MT_PRESSURE,
+                                       ABS_MT_DISTANCE,    ABS_MT_TOOL_TYPE,
+                                       ABS_MT_TRACKING_ID};
+    std::vector<int32_t> values;
+    for (int32_t axis : AXES) {
+        if (!deviceContext.hasAbsoluteAxis(axis) ||
+            deviceContext.getMtSlotValues(axis, mSlotCount, &values) != OK ||
+            values.size() != mSlotCount) {
+            continue;
+        }
+        for (size_t i = 0; i < mSlotCount; i++) {
+            processSlotAxis(&mSlots[i], axis, values[i]);
+        }
+    }
+}
+
 void MultiTouchMotionAccumulator::clearSlots(int32_t initialSlot) {
     if (mSlots) {
         for (size_t i = 0; i < mSlotCount; i++) {
@@ -103,63 +126,7 @@ void MultiTouchMotionAccumulator::process(const RawEvent* rawEvent) {
             }
 #endif
         } else {
-            Slot* slot = &mSlots[mCurrentSlot];
-
-            switch (rawEvent->code) {
-                case ABS_MT_POSITION_X:
-                    slot->mInUse = true;
-                    slot->mAbsMTPositionX = rawEvent->value;
-                    break;
-                case ABS_MT_POSITION_Y:
-                    slot->mInUse = true;
-                    slot->mAbsMTPositionY = rawEvent->value;
-                    break;
-                case ABS_MT_TOUCH_MAJOR:
-                    slot->mInUse = true;
-                    slot->mAbsMTTouchMajor = rawEvent->value;
-                    break;
-                case ABS_MT_TOUCH_MINOR:
-                    slot->mInUse = true;
-                    slot->mAbsMTTouchMinor = rawEvent->value;
-                    slot->mHaveAbsMTTouchMinor = true;
-                    break;
-                case ABS_MT_WIDTH_MAJOR:
-                    slot->mInUse = true;
-                    slot->mAbsMTWidthMajor = rawEvent->value;
-                    break;
-                case ABS_MT_WIDTH_MINOR:
-                    slot->mInUse = true;
-                    slot->mAbsMTWidthMinor = rawEvent->value;
-                    slot->mHaveAbsMTWidthMinor = true;
-                    break;
-                case ABS_MT_ORIENTATION:
-                    slot->mInUse = true;
-                    slot->mAbsMTOrientation = rawEvent->value;
-                    break;
-                case ABS_MT_TRACKING_ID:
-                    if (mUsingSlotsProtocol && rawEvent->value < 0) {
-                        // The slot is no longer in use but it retains its previous contents,
-                        // which may be reused for subsequent touches.
-                        slot->mInUse = false;
-                    } else {
-                        slot->mInUse = true;
-                        slot->mAbsMTTrackingId = rawEvent->value;
-                    }
-                    break;
-                case ABS_MT_PRESSURE:
-                    slot->mInUse = true;
-                    slot->mAbsMTPressure = rawEvent->value;
-                    break;
-                case ABS_MT_DISTANCE:
-                    slot->mInUse = true;
-                    slot->mAbsMTDistance = rawEvent->value;
-                    break;
-                case ABS_MT_TOOL_TYPE:
-                    slot->mInUse = true;
-                    slot->mAbsMTToolType = rawEvent->value;
-                    slot->mHaveAbsMTToolType = true;
-                    break;
-            }
+            processSlotAxis(&mSlots[mCurrentSlot], rawEvent->code, rawEvent->value);
         }
     } else if (rawEvent->type == EV_SYN && rawEvent->code == SYN_MT_REPORT) {
         // MultiTouch Sync: The driver has returned all data for *one* of the pointers.
@@ -167,6 +134,64 @@ void MultiTouchMotionAccumulator::process(const RawEvent* rawEvent) {
     }
 }
 
+void MultiTouchMotionAccumulator::processSlotAxis(Slot* slot, int32_t axis, int32_t value) {
+    switch (axis) {
+        case ABS_MT_POSITION_X:
+            slot->mInUse = true;
+            slot->mAbsMTPositionX = value;
+            break;
+        case ABS_MT_POSITION_Y:
+            slot->mInUse = true;
+            slot->mAbsMTPositionY = value;
+            break;
+        case ABS_MT_TOUCH_MAJOR:
+            slot->mInUse = true;
+            slot->mAbsMTTouchMajor = value;
+            break;
+        case ABS_MT_TOUCH_MINOR:
+            slot->mInUse = true;
+            slot->mAbsMTTouchMinor = value;
+            slot->mHaveAbsMTTouchMinor = true;
+            break;
+        case ABS_MT_WIDTH_MAJOR:
+            slot->mInUse = true;
+            slot->mAbsMTWidthMajor = value;
+            break;
+        case ABS_MT_WIDTH_MINOR:
+            slot->mInUse = true;
+            slot->mAbsMTWidthMinor = value;
+            slot->mHaveAbsMTWidthMinor = true;
+            break;
+        case ABS_MT_ORIENTATION:
+            slot->mInUse = true;
+            slot->mAbsMTOrientation = value;
+            break;
+        case ABS_MT_TRACKING_ID:
+            if (mUsingSlotsProtocol && value < 0) {
+                // The slot is no longer in use but it retains its previous contents,
+                // which may be reused for subsequent touches.
+                slot->mInUse = false;
+            } else {
+                slot->mInUse = true;
+                slot->mAbsMTTrackingId = value;
+            }
+            break;
+        case ABS_MT_PRESSURE:
+            slot->mInUse = true;
+            slot->mAbsMTPressure = value;
+            break;
+        case ABS_MT_DISTANCE:
+            slot->mInUse = true;
+            slot->mAbsMTDistance = value;
+            break;
+        case ABS_MT_TOOL_TYPE:
+            slot->mInUse = true;
+            slot->mAbsMTToolType = value;
+            slot->mHaveAbsMTToolType = true;
+            break;
+    }
+}
+
 void MultiTouchMotionAccumulator::finishSync() {
     if (!mUsingSlotsProtocol) {
         clearSlots(-1);
@@ -87,6 +87,9 @@ private:
     bool mHaveStylus;
 
     void clearSlots(int32_t initialSlot);
+    // Reads the current contents of the slots from the device.
+    void readSlots(InputDeviceContext& deviceContext);
+    void processSlotAxis(Slot* slot, int32_t axis, int32_t value);
 };
 
 class MultiTouchInputMapper : public TouchInputMapper {
@@ -93,6 +93,42 @@ TEST(BlockingQueueTest, Queue_Erases) {
     ASSERT_EQ(3, queue.pop());
 }
 
+TEST(BlockingQueueTest, Queue_WrapsAround) {
+    constexpr size_t capacity = 3;
+    BlockingQueue<int> queue(capacity);
+
+    for (int i = 0; i < 10; i++) {
+        ASSERT_TRUE(queue.push(2 * i));
+        ASSERT_TRUE(queue.push(2 * i + 1));
+        ASSERT_EQ(2 * i, queue.pop());
+        ASSERT_EQ(2 * i + 1, queue.pop());
+    }
+    ASSERT_EQ(0u, queue.size());
+}
+
+TEST(BlockingQueueTest, Queue_ErasesAcrossWrapAround) {
+    constexpr size_t capacity = 4;
+    BlockingQueue<int> queue(capacity);
+
+    // Move the head to the middle of the buffer, so that the elements wrap around
+    queue.push(0);
+    queue.push(0);
+    queue.pop();
+    queue.pop();
+    for (size_t i = 1; i <= capacity; i++) {
+        ASSERT_TRUE(queue.push(static_cast<int>(i)));
+    }
+    queue.erase([](int element) { return element == 1 || element == 3; });
+    ASSERT_EQ(2u, queue.size());
+    ASSERT_TRUE(queue.push(5));
+    ASSERT_TRUE(queue.push(6));
+    ASSERT_FALSE(queue.push(7));
+    ASSERT_EQ(2, queue.pop());
+    ASSERT_EQ(4, queue.pop());
+    ASSERT_EQ(5, queue.pop());
+    ASSERT_EQ(6, queue.pop());
+}
+
 // --- BlockingQueueTest - Multiple threads ---
 
 TEST(BlockingQueueTest, Queue_AllowsMultipleThreads) {
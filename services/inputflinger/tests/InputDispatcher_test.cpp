@@ -179,6 +179,8 @@ public:
         mConfig.keyRepeatDelay = delay;
     }
 
+    void setVerifiedEventHistorySize(size_t size) { mConfig.verifiedEventHistorySize = size; }
+
     void setAnrTimeout(std::chrono::nanoseconds timeout) { mAnrTimeout = timeout; }
 
 private:
@@ -1606,6 +1608,88 @@ TEST_F(InputDispatcherTest, TestMoveEvent) {
                          0 /*expectedFlags*/);
 }
 
+/**
+ * When a window does not consume its events, the moves that cannot be published because its
+ * channel is full are coalesced, so that it gets the latest pointer position once it catches up
+ * rather than every sample it missed.
+ */
+TEST_F(InputDispatcherTest, MoveEvents_AreCoalescedWhenChannelIsFull) {
+    sp<FakeApplicationHandle> application = new FakeApplicationHandle();
+    sp<FakeWindowHandle> window =
+            new FakeWindowHandle(application, mDispatcher, "Fake Window", ADISPLAY_ID_DEFAULT);
+
+    mDispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, {window}}});
+
+    NotifyMotionArgs motionArgs =
+            generateMotionArgs(AMOTION_EVENT_ACTION_DOWN, AINPUT_SOURCE_TOUCHSCREEN,
+                               ADISPLAY_ID_DEFAULT);
+    mDispatcher->notifyMotion(&motionArgs);
+    window->consumeMotionDown(ADISPLAY_ID_DEFAULT);
+
+    // Far more moves than the channel can hold.
+    constexpr size_t moveCount = 1000;
+    motionArgs.action = AMOTION_EVENT_ACTION_MOVE;
+    for (size_t i = 1; i <= moveCount; i++) {
+        motionArgs.id += 1;
+        motionArgs.eventTime = systemTime(SYSTEM_TIME_MONOTONIC);
+        motionArgs.pointerCoords[0].setAxisValue(AMOTION_EVENT_AXIS_X, i % 400);
+        mDispatcher->notifyMotion(&motionArgs);
+    }
+    mDispatcher->waitForIdle();
+
+    size_t sampleCount = 0;
+    float lastX = 0;
+    while (InputEvent* event = window->consume()) {
+        ASSERT_EQ(AINPUT_EVENT_TYPE_MOTION, event->getType());
+        const MotionEvent& motionEvent = static_cast<const MotionEvent&>(*event);
+        ASSERT_EQ(AMOTION_EVENT_ACTION_MOVE, motionEvent.getAction());
+        sampleCount += motionEvent.getHistorySize() + 1;
+        lastX = motionEvent.getX(0);
+    }
+    ASSERT_LT(sampleCount, moveCount);
+    ASSERT_EQ(moveCount % 400, lastX);
+}
+
+/**
+ * The targets of moves are reused for the rest of the gesture, but not once the windows change.
+ */
+TEST_F(InputDispatcherTest, MoveEvent_AfterWindowMoved_UsesNewWindowFrame) {
+    sp<FakeApplicationHandle> application = new FakeApplicationHandle();
+    sp<FakeWindowHandle> window =
+            new FakeWindowHandle(application, mDispatcher, "Fake Window", ADISPLAY_ID_DEFAULT);
+
+    mDispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, {window}}});
+
+    NotifyMotionArgs motionArgs = generateMotionArgs(AMOTION_EVENT_ACTION_DOWN,
+                                                     AINPUT_SOURCE_TOUCHSCREEN,
+                                                     ADISPLAY_ID_DEFAULT, {PointF{100, 200}});
+    mDispatcher->notifyMotion(&motionArgs);
+    window->consumeMotionDown(ADISPLAY_ID_DEFAULT);
+
+    for (int32_t i = 0; i < 2; i++) {
+        motionArgs = generateMotionArgs(AMOTION_EVENT_ACTION_MOVE, AINPUT_SOURCE_TOUCHSCREEN,
+                                        ADISPLAY_ID_DEFAULT, {PointF{100, 200}});
+        mDispatcher->notifyMotion(&motionArgs);
+        InputEvent* event = window->consume();
+        ASSERT_NE(nullptr, event);
+        ASSERT_EQ(AINPUT_EVENT_TYPE_MOTION, event->getType());
+        EXPECT_EQ(100, static_cast<const MotionEvent&>(*event).getX(0));
+    }
+
+    window->setFrame(Rect(10, 20, 300, 400));
+    mDispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, {window}}});
+
+    motionArgs = generateMotionArgs(AMOTION_EVENT_ACTION_MOVE, AINPUT_SOURCE_TOUCHSCREEN,
+                                    ADISPLAY_ID_DEFAULT, {PointF{100, 200}});
+    mDispatcher->notifyMotion(&motionArgs);
+    InputEvent* event = window->consume();
+    ASSERT_NE(nullptr, event);
+    ASSERT_EQ(AINPUT_EVENT_TYPE_MOTION, event->getType());
+    const MotionEvent& motionEvent = static_cast<const MotionEvent&>(*event);
+    EXPECT_EQ(90, motionEvent.getX(0));
+    EXPECT_EQ(180, motionEvent.getY(0));
+}
+
 /**
  * Dispatcher has touch mode enabled by default. Typically, the policy overrides that value to
  * the device default right away. In the test scenario, we check both the default value,
@@ -1723,6 +1807,65 @@ TEST_F(InputDispatcherTest, VerifyInputEvent_MotionEvent) {
     EXPECT_EQ(motionArgs.buttonState, verifiedMotion.buttonState);
 }
 
+class InputDispatcherVerifiedEventHistoryTest : public InputDispatcherTest {
+protected:
+    static constexpr size_t VERIFIED_EVENT_HISTORY_SIZE = 2;
+
+    sp<FakeApplicationHandle> mApp;
+    sp<FakeWindowHandle> mWindow;
+
+    virtual void SetUp() override {
+        mFakePolicy = new FakeInputDispatcherPolicy();
+        mFakePolicy->setVerifiedEventHistorySize(VERIFIED_EVENT_HISTORY_SIZE);
+        mDispatcher = new InputDispatcher(mFakePolicy);
+        mDispatcher->setInputDispatchMode(/*enabled*/ true, /*frozen*/ false);
+        ASSERT_EQ(OK, mDispatcher->start());
+
+        mApp = new FakeApplicationHandle();
+        mWindow = new FakeWindowHandle(mApp, mDispatcher, "Fake Window", ADISPLAY_ID_DEFAULT);
+        mWindow->setFocus(true);
+        mDispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, {mWindow}}});
+        mWindow->consumeFocusEvent(true);
+    }
+
+    KeyEvent sendAndConsumeKey(int32_t action) {
+        NotifyKeyArgs keyArgs = generateKeyArgs(action, ADISPLAY_ID_DEFAULT);
+        mDispatcher->notifyKey(&keyArgs);
+        InputEvent* event = mWindow->consume();
+        EXPECT_NE(nullptr, event);
+        EXPECT_EQ(AINPUT_EVENT_TYPE_KEY, event->getType());
+        // The consumer reuses its event, so keep a copy.
+        KeyEvent keyEvent;
+        keyEvent.initialize(static_cast<const KeyEvent&>(*event));
+        return keyEvent;
+    }
+};
+
+TEST_F(InputDispatcherVerifiedEventHistoryTest, RecentEvent_IsVerified) {
+    KeyEvent keyEvent = sendAndConsumeKey(AKEY_EVENT_ACTION_DOWN);
+
+    std::unique_ptr<VerifiedInputEvent> verified = mDispatcher->verifyInputEvent(keyEvent);
+    ASSERT_NE(nullptr, verified);
+    ASSERT_EQ(VerifiedInputEvent::Type::KEY, verified->type);
+    ASSERT_EQ(AKEY_EVENT_ACTION_DOWN, static_cast<const VerifiedKeyEvent&>(*verified).action);
+}
+
+TEST_F(InputDispatcherVerifiedEventHistoryTest, ModifiedEvent_IsNotVerified) {
+    KeyEvent keyEvent = sendAndConsumeKey(AKEY_EVENT_ACTION_DOWN);
+    keyEvent.setDisplayId(ADISPLAY_ID_DEFAULT + 1);
+
+    ASSERT_EQ(nullptr, mDispatcher->verifyInputEvent(keyEvent));
+}
+
+TEST_F(InputDispatcherVerifiedEventHistoryTest, EvictedEvent_IsNotVerified) {
+    KeyEvent firstEvent = sendAndConsumeKey(AKEY_EVENT_ACTION_DOWN);
+    for (size_t i = 0; i < VERIFIED_EVENT_HISTORY_SIZE; i++) {
+        sendAndConsumeKey(i % 2 == 0 ? AKEY_EVENT_ACTION_UP : AKEY_EVENT_ACTION_DOWN);
+    }
+
+    ASSERT_EQ(nullptr, mDispatcher->verifyInputEvent(firstEvent));
+}
+
 class InputDispatcherKeyRepeatTest : public InputDispatcherTest {
 protected:
     static constexpr nsecs_t KEY_REPEAT_TIMEOUT = 40 * 1000000; // 40 ms
@@ -262,6 +262,10 @@ public:
 
     void addDisabledDevice(int32_t deviceId) { mConfig.disabledDevices.insert(deviceId); }
 
+    void setPrioritizeKeyboardDevices(bool enabled) {
+        mConfig.prioritizeKeyboardDevices = enabled;
+    }
+
     void removeDisabledDevice(int32_t deviceId) { mConfig.disabledDevices.erase(deviceId); }
 
     void setPointerController(int32_t deviceId, std::shared_ptr<FakePointerController> controller) {
@@ -378,6 +382,7 @@ class FakeEventHub : public EventHubInterface {
         KeyedVector<int32_t, int32_t> scanCodeStates;
         KeyedVector<int32_t, int32_t> switchStates;
         KeyedVector<int32_t, int32_t> absoluteAxisValue;
+        std::unordered_map<int32_t, std::vector<int32_t>> mtSlotValues;
         KeyedVector<int32_t, KeyInfo> keysByScanCode;
         KeyedVector<int32_t, KeyInfo> keysByUsageCode;
         KeyedVector<int32_t, bool> leds;
@@ -405,6 +410,7 @@ class FakeEventHub : public EventHubInterface {
     KeyedVector<int32_t, Device*> mDevices;
     std::vector<std::string> mExcludedDevices;
     List<RawEvent> mEvents GUARDED_BY(mLock);
+    size_t mMaxEventsPerRead GUARDED_BY(mLock) = 1;
     std::unordered_map<int32_t /*deviceId*/, std::vector<TouchVideoFrame>> mVideoFrames;
 
 public:
@@ -521,6 +527,15 @@ public:
         device->absoluteAxisValue.replaceValueFor(axis, value);
     }
 
+    void setMtSlotValue(int32_t deviceId, int32_t axis, size_t slot, int32_t value) {
+        Device* device = getDevice(deviceId);
+        std::vector<int32_t>& values = device->mtSlotValues[axis];
+        if (values.size() <= slot) {
+            values.resize(slot + 1);
+        }
+        values[slot] = value;
+    }
+
     void addKey(int32_t deviceId, int32_t scanCode, int32_t usageCode,
             int32_t keyCode, uint32_t flags) {
         Device* device = getDevice(deviceId);
@@ -685,16 +700,23 @@ private:
         mExcludedDevices = devices;
     }
 
-    virtual size_t getEvents(int, RawEvent* buffer, size_t) {
+    // By default, getEvents returns one event at a time.
+    void setMaxEventsPerRead(size_t maxEventsPerRead) {
         std::scoped_lock<std::mutex> lock(mLock);
-        if (mEvents.empty()) {
-            return 0;
-        }
+        mMaxEventsPerRead = maxEventsPerRead;
+    }
 
-        *buffer = *mEvents.begin();
-        mEvents.erase(mEvents.begin());
-        mEventsCondition.notify_all();
-        return 1;
+    virtual size_t getEvents(int, RawEvent* buffer, size_t bufferSize) {
+        std::scoped_lock<std::mutex> lock(mLock);
+        size_t count = 0;
+        while (!mEvents.empty() && count < std::min(bufferSize, mMaxEventsPerRead)) {
+            buffer[count++] = *mEvents.begin();
+            mEvents.erase(mEvents.begin());
+        }
+        if (count) {
+            mEventsCondition.notify_all();
+        }
+        return count;
     }
 
     virtual std::vector<TouchVideoFrame> getVideoFrames(int32_t deviceId) {
@@ -754,6 +776,21 @@ private:
         return -1;
     }
 
+    virtual status_t getMtSlotValues(int32_t deviceId, int32_t axis, size_t slotCount,
+                                     std::vector<int32_t>* outValues) const {
+        outValues->clear();
+        Device* device = getDevice(deviceId);
+        if (device) {
+            auto it = device->mtSlotValues.find(axis);
+            if (it != device->mtSlotValues.end()) {
+                *outValues = it->second;
+                outValues->resize(slotCount);
+                return OK;
+            }
+        }
+        return -1;
+    }
+
     virtual bool markSupportedKeyCodes(int32_t deviceId, size_t numCodes, const int32_t* keyCodes,
             uint8_t* outFlags) const {
         bool result = false;
@@ -1652,6 +1689,61 @@ TEST_F(InputReaderTest, LoopOnce_ForwardsRawEventsToMappers) {
     ASSERT_EQ(1, event.value);
 }
 
+/**
+ * Records the ids of the devices whose events it processes, in the order it processes them.
+ */
+class ProcessOrderInputMapper : public FakeInputMapper {
+    std::vector<int32_t>* mProcessedDeviceIds;
+
+public:
+    ProcessOrderInputMapper(InputDeviceContext& deviceContext, uint32_t sources,
+                            std::vector<int32_t>* processedDeviceIds)
+          : FakeInputMapper(deviceContext, sources), mProcessedDeviceIds(processedDeviceIds) {}
+
+    virtual void process(const RawEvent* rawEvent) override {
+        FakeInputMapper::process(rawEvent);
+        mProcessedDeviceIds->push_back(getDeviceId());
+    }
+};
+
+TEST_F(InputReaderTest, LoopOnce_WhenKeyboardDevicesArePrioritized_ProcessesThemFirst) {
+    mFakePolicy->setPrioritizeKeyboardDevices(true);
+    mReader = std::make_unique<InstrumentedInputReader>(mFakeEventHub, mFakePolicy,
+                                                        mFakeListener);
+    std::vector<int32_t> processedDeviceIds;
+    constexpr int32_t touchDeviceId = END_RESERVED_ID + 1000;
+    constexpr int32_t keyboardDeviceId = END_RESERVED_ID + 1001;
+    constexpr int32_t touchEventHubId = 1;
+    constexpr int32_t keyboardEventHubId = 2;
+
+    std::shared_ptr<InputDevice> touchDevice = mReader->newDevice(touchDeviceId, "touch");
+    touchDevice->addMapper<ProcessOrderInputMapper>(touchEventHubId, AINPUT_SOURCE_TOUCHSCREEN,
+                                                    &processedDeviceIds);
+    mReader->setNextDevice(touchDevice);
+    ASSERT_NO_FATAL_FAILURE(addDevice(touchEventHubId, "touch", INPUT_DEVICE_CLASS_TOUCH, nullptr));
+    std::shared_ptr<InputDevice> keyboardDevice = mReader->newDevice(keyboardDeviceId, "keyboard");
+    keyboardDevice->addMapper<ProcessOrderInputMapper>(keyboardEventHubId, AINPUT_SOURCE_KEYBOARD,
+                                                       &processedDeviceIds);
+    mReader->setNextDevice(keyboardDevice);
+    ASSERT_NO_FATAL_FAILURE(
+            addDevice(keyboardEventHubId, "keyboard", INPUT_DEVICE_CLASS_KEYBOARD, nullptr));
+
+    mFakeEventHub->setMaxEventsPerRead(16);
+    mFakeEventHub->enqueueEvent(0, touchEventHubId, EV_ABS, ABS_X, 100);
+    mFakeEventHub->enqueueEvent(0, touchEventHubId, EV_SYN, SYN_REPORT, 0);
+    mFakeEventHub->enqueueEvent(1, keyboardEventHubId, EV_KEY, KEY_A, 1);
+    mFakeEventHub->enqueueEvent(2, touchEventHubId, EV_ABS, ABS_X, 200);
+    mFakeEventHub->enqueueEvent(2, touchEventHubId, EV_SYN, SYN_REPORT, 0);
+    mFakeEventHub->enqueueEvent(3, keyboardEventHubId, EV_KEY, KEY_A, 0);
+    mReader->loopOnce();
+    ASSERT_NO_FATAL_FAILURE(mFakeEventHub->assertQueueIsEmpty());
+
+    // The events of each device stay in order, but those of the keyboard are processed first.
+    ASSERT_EQ(std::vector<int32_t>({keyboardDeviceId, keyboardDeviceId, touchDeviceId,
+                                    touchDeviceId, touchDeviceId, touchDeviceId}),
+              processedDeviceIds);
+}
+
 TEST_F(InputReaderTest, DeviceReset_RandomId) {
     constexpr int32_t deviceId = END_RESERVED_ID + 1000;
     constexpr uint32_t deviceClass = INPUT_DEVICE_CLASS_KEYBOARD;
@@ -7071,6 +7163,31 @@ TEST_F(MultiTouchInputMapperTest, Process_ShouldHandleSingleTouch) {
     ASSERT_EQ(AMOTION_EVENT_TOOL_TYPE_FINGER, motionArgs.pointerProperties[0].toolType);
 }
 
+TEST_F(MultiTouchInputMapperTest, Reset_ReadsTouchesAlreadyDownFromSlots) {
+    addConfigurationProperty("touch.deviceType", "touchScreen");
+    prepareDisplay(DISPLAY_ORIENTATION_0);
+    prepareAxes(POSITION | ID | SLOT);
+    constexpr int32_t x1 = 100, y1 = 200;
+    mFakeEventHub->setMtSlotValue(EVENTHUB_ID, ABS_MT_TRACKING_ID, 0, 1);
+    mFakeEventHub->setMtSlotValue(EVENTHUB_ID, ABS_MT_POSITION_X, 0, x1);
+    mFakeEventHub->setMtSlotValue(EVENTHUB_ID, ABS_MT_POSITION_Y, 0, y1);
+    mFakeEventHub->setMtSlotValue(EVENTHUB_ID, ABS_MT_TRACKING_ID, 1, -1);
+    mFakeEventHub->setMtSlotValue(EVENTHUB_ID, ABS_MT_POSITION_X, 1, x1);
+    mFakeEventHub->setMtSlotValue(EVENTHUB_ID, ABS_MT_POSITION_Y, 1, y1);
+    MultiTouchInputMapper& mapper = addMapperAndConfigure<MultiTouchInputMapper>();
+
+    // The finger that was down in slot 0 when the device was reset is reported on the next sync,
+    // without waiting for it to move. Slot 1 is not in use.
+    NotifyMotionArgs motionArgs;
+    processSync(mapper);
+    ASSERT_NO_FATAL_FAILURE(mFakeListener->assertNotifyMotionWasCalled(&motionArgs));
+    ASSERT_EQ(AMOTION_EVENT_ACTION_DOWN, motionArgs.action);
+    ASSERT_EQ(size_t(1), motionArgs.pointerCount);
+    ASSERT_NO_FATAL_FAILURE(
+            assertPointerCoords(motionArgs.pointerCoords[0], toDisplayX(x1), toDisplayY(y1), 1, 0,
+                                0, 0, 0, 0, 0, 0));
+}
+
 /**
  * Test single touch should be canceled when received the MT_TOOL_PALM event, and the following
  * MOVE and UP events should be ignored.
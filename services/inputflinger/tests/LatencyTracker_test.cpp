@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "../dispatcher/LatencyTracker.h"
+
+#include <binder/Binder.h>
+#include <gtest/gtest.h>
+#include <limits.h>
+
+namespace android {
+
+namespace inputdispatcher {
+
+// --- LatencyHistogramTest ---
+
+TEST(LatencyHistogramTest, AddValue_FillsExponentialBuckets) {
+    LatencyHistogram histogram;
+
+    histogram.addValue(0);
+    histogram.addValue(LatencyHistogram::FIRST_BUCKET_BOUND - 1);
+    histogram.addValue(LatencyHistogram::FIRST_BUCKET_BOUND);
+    histogram.addValue(LatencyHistogram::FIRST_BUCKET_BOUND * 3);
+    histogram.addValue(LLONG_MAX / 2);
+
+    const auto& buckets = histogram.getBuckets();
+    ASSERT_EQ(2u, buckets[0]);
+    ASSERT_EQ(1u, buckets[1]);
+    ASSERT_EQ(1u, buckets[2]);
+    ASSERT_EQ(1u, buckets[LatencyHistogram::BUCKET_COUNT - 1]);
+    ASSERT_EQ(5u, histogram.getCount());
+}
+
+TEST(LatencyHistogramTest, NegativeDuration_CountsAsZero) {
+    LatencyHistogram histogram;
+
+    histogram.addValue(-5);
+
+    ASSERT_EQ(1u, histogram.getBuckets()[0]);
+    ASSERT_EQ(0, histogram.getMax());
+}
+
+TEST(LatencyHistogramTest, GetPercentileBound) {
+    LatencyHistogram histogram;
+    constexpr nsecs_t bound = LatencyHistogram::FIRST_BUCKET_BOUND;
+
+    for (int i = 0; i < 90; i++) {
+        histogram.addValue(bound / 2);
+    }
+    for (int i = 0; i < 10; i++) {
+        histogram.addValue(bound * 3);
+    }
+
+    ASSERT_EQ(bound, histogram.getPercentileBound(50));
+    ASSERT_EQ(bound, histogram.getPercentileBound(90));
+    ASSERT_EQ(bound * 4, histogram.getPercentileBound(99));
+    ASSERT_EQ((bound / 2 * 90 + bound * 3 * 10) / 100, histogram.getMean());
+    ASSERT_EQ(bound * 3, histogram.getMax());
+}
+
+// --- LatencyTrackerTest ---
+
+TEST(LatencyTrackerTest, TrackFinishedEvent_RecordsEachStage) {
+    LatencyTracker tracker;
+    sp<IBinder> token = new BBinder();
+
+    tracker.trackFinishedEvent(token, "window",
+                               {.eventTime = 1000,
+                                .enqueueTime = 2000,
+                                .deliveryTime = 4000,
+                                .consumeTime = 8000,
+                                .finishTime = 16000});
+
+    const auto& latencies = tracker.getConnectionLatencies();
+    ASSERT_EQ(1u, latencies.size());
+    const LatencyTracker::ConnectionLatency& latency = latencies.at(token);
+    ASSERT_EQ("window", latency.name);
+    ASSERT_EQ(1000, latency.input.getMax());
+    ASSERT_EQ(2000, latency.dispatch.getMax());
+    ASSERT_EQ(4000, latency.transport.getMax());
+    ASSERT_EQ(8000, latency.app.getMax());
+    ASSERT_EQ(7000, latency.endToEnd.getMax());
+}
+
+TEST(LatencyTrackerTest, UnknownConsumeTime_SkipsConsumerStages) {
+    LatencyTracker tracker;
+    sp<IBinder> token = new BBinder();
+
+    tracker.trackFinishedEvent(token, "window",
+                               {.eventTime = 1000,
+                                .enqueueTime = 2000,
+                                .deliveryTime = 4000,
+                                .consumeTime = 0,
+                                .finishTime = 16000});
+
+    const LatencyTracker::ConnectionLatency& latency = tracker.getConnectionLatencies().at(token);
+    ASSERT_EQ(1u, latency.input.getCount());
+    ASSERT_EQ(1u, latency.dispatch.getCount());
+    ASSERT_EQ(0u, latency.transport.getCount());
+    ASSERT_EQ(0u, latency.app.getCount());
+    ASSERT_EQ(0u, latency.endToEnd.getCount());
+}
+
+TEST(LatencyTrackerTest, EraseToken_RemovesConnection) {
+    LatencyTracker tracker;
+    sp<IBinder> token1 = new BBinder();
+    sp<IBinder> token2 = new BBinder();
+
+    tracker.trackFinishedEvent(token1, "window1", {1, 2, 3, 4, 5});
+    tracker.trackFinishedEvent(token2, "window2", {1, 2, 3, 4, 5});
+    tracker.eraseToken(token1);
+
+    ASSERT_EQ(1u, tracker.getConnectionLatencies().size());
+    ASSERT_EQ(1u, tracker.getConnectionLatencies().count(token2));
+}
+
+} // namespace inputdispatcher
+
+} // namespace android
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../dispatcher/LockFreeQueue.h"
+
+#include <gtest/gtest.h>
+#include <memory>
+#include <thread>
+
+namespace android {
+
+namespace inputdispatcher {
+
+// --- LockFreeQueueTest ---
+
+TEST(LockFreeQueueTest, PopAll_ReturnsElementsInPushOrder) {
+    LockFreeQueue<int> queue;
+    ASSERT_TRUE(queue.empty());
+
+    ASSERT_TRUE(queue.push(1));
+    ASSERT_FALSE(queue.push(2));
+    ASSERT_FALSE(queue.push(3));
+    ASSERT_FALSE(queue.empty());
+
+    ASSERT_EQ(std::vector<int>({1, 2, 3}), queue.popAll());
+    ASSERT_TRUE(queue.empty());
+    ASSERT_TRUE(queue.popAll().empty());
+
+    ASSERT_TRUE(queue.push(4));
+    ASSERT_EQ(std::vector<int>({4}), queue.popAll());
+}
+
+TEST(LockFreeQueueTest, Destructor_ReleasesElements) {
+    std::shared_ptr<int> value = std::make_shared<int>(1);
+    {
+        LockFreeQueue<std::shared_ptr<int>> queue;
+        queue.push(value);
+        ASSERT_EQ(2, value.use_count());
+    }
+    ASSERT_EQ(1, value.use_count());
+}
+
+TEST(LockFreeQueueTest, ConcurrentProducers_KeepPerProducerOrder) {
+    constexpr int PRODUCER_COUNT = 4;
+    constexpr int VALUE_COUNT = 10000;
+    LockFreeQueue<std::pair<int /*producer*/, int /*value*/>> queue;
+
+    std::vector<std::thread> producers;
+    for (int producer = 0; producer < PRODUCER_COUNT; producer++) {
+        producers.emplace_back([&queue, producer]() {
+            for (int value = 0; value < VALUE_COUNT; value++) {
+                queue.push({producer, value});
+            }
+        });
+    }
+
+    std::vector<int> nextValues(PRODUCER_COUNT, 0);
+    int poppedCount = 0;
+    while (poppedCount < PRODUCER_COUNT * VALUE_COUNT) {
+        for (const auto& [producer, value] : queue.popAll()) {
+            ASSERT_EQ(nextValues[producer], value);
+            nextValues[producer]++;
+            poppedCount++;
+        }
+    }
+    for (std::thread& producer : producers) {
+        producer.join();
+    }
+    ASSERT_TRUE(queue.empty());
+}
+
+} // namespace inputdispatcher
+
+} // namespace android
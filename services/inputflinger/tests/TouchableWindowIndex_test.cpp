@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../dispatcher/TouchableWindowIndex.h"
+
+#include <gtest/gtest.h>
+
+namespace android {
+
+namespace inputdispatcher {
+
+class FakeWindowHandle : public InputWindowHandle {
+public:
+    FakeWindowHandle(const Rect& touchableRegion, int32_t flags, bool visible = true) {
+        mInfo.addTouchableRegion(touchableRegion);
+        mInfo.layoutParamsFlags = flags;
+        mInfo.visible = visible;
+    }
+
+    bool updateInfo() override { return true; }
+};
+
+static constexpr int32_t NOT_TOUCH_MODAL = InputWindowInfo::FLAG_NOT_TOUCH_MODAL;
+
+// --- TouchableWindowIndexTest ---
+
+TEST(TouchableWindowIndexTest, Empty) {
+    TouchableWindowIndex index;
+    index.build({});
+
+    ASSERT_TRUE(index.getCandidates(0, 0).empty());
+}
+
+TEST(TouchableWindowIndexTest, ReturnsWindowsContainingPoint) {
+    TouchableWindowIndex index;
+    index.build({new FakeWindowHandle(Rect(0, 0, 100, 100), NOT_TOUCH_MODAL),
+                 new FakeWindowHandle(Rect(500, 500, 600, 600), NOT_TOUCH_MODAL)});
+
+    ASSERT_EQ(std::vector<uint32_t>({0}), index.getCandidates(50, 50));
+    ASSERT_EQ(std::vector<uint32_t>({1}), index.getCandidates(550, 550));
+    ASSERT_TRUE(index.getCandidates(1000, 1000).empty());
+}
+
+TEST(TouchableWindowIndexTest, PreservesZOrder) {
+    TouchableWindowIndex index;
+    index.build({new FakeWindowHandle(Rect(0, 0, 100, 100), NOT_TOUCH_MODAL),
+                 new FakeWindowHandle(Rect(0, 0, 1000, 1000), NOT_TOUCH_MODAL),
+                 new FakeWindowHandle(Rect(50, 50, 150, 150), NOT_TOUCH_MODAL)});
+
+    ASSERT_EQ(std::vector<uint32_t>({0, 1, 2}), index.getCandidates(75, 75));
+    ASSERT_EQ(std::vector<uint32_t>({1}), index.getCandidates(900, 900));
+}
+
+TEST(TouchableWindowIndexTest, TouchModalAndWatchOutsideWindowsAreAlwaysCandidates) {
+    TouchableWindowIndex index;
+    index.build({new FakeWindowHandle(Rect(0, 0, 10, 10),
+                                      NOT_TOUCH_MODAL | InputWindowInfo::FLAG_WATCH_OUTSIDE_TOUCH),
+                 new FakeWindowHandle(Rect(500, 500, 600, 600), NOT_TOUCH_MODAL),
+                 new FakeWindowHandle(Rect(0, 0, 10, 10), 0 /*flags*/)});
+
+    ASSERT_EQ(std::vector<uint32_t>({0, 1, 2}), index.getCandidates(550, 550));
+    ASSERT_EQ(std::vector<uint32_t>({0, 2}), index.getCandidates(-100, 2000));
+}
+
+TEST(TouchableWindowIndexTest, SkipsWindowsThatCannotBeTouched) {
+    TouchableWindowIndex index;
+    index.build({new FakeWindowHandle(Rect(0, 0, 100, 100), NOT_TOUCH_MODAL, false /*visible*/),
+                 new FakeWindowHandle(Rect(0, 0, 100, 100),
+                                      NOT_TOUCH_MODAL | InputWindowInfo::FLAG_NOT_TOUCHABLE),
+                 new FakeWindowHandle(Rect(0, 0, 100, 100), NOT_TOUCH_MODAL)});
+
+    ASSERT_EQ(std::vector<uint32_t>({2}), index.getCandidates(50, 50));
+}
+
+TEST(TouchableWindowIndexTest, ExcludesRightAndBottomEdges) {
+    TouchableWindowIndex index;
+    index.build({new FakeWindowHandle(Rect(0, 0, 100, 100), NOT_TOUCH_MODAL),
+                 new FakeWindowHandle(Rect(100, 100, 200, 200), NOT_TOUCH_MODAL)});
+
+    ASSERT_EQ(std::vector<uint32_t>({0}), index.getCandidates(99, 99));
+    ASSERT_EQ(std::vector<uint32_t>({1}), index.getCandidates(100, 100));
+    ASSERT_TRUE(index.getCandidates(200, 200).empty());
+}
+
+} // namespace inputdispatcher
+
+} // namespace android
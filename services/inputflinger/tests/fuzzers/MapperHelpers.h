@@ -95,6 +95,14 @@ public:
                                   int32_t* outValue) const override {
         return fdp->ConsumeIntegral<status_t>();
     }
+    status_t getMtSlotValues(int32_t deviceId, int32_t axis, size_t slotCount,
+                             std::vector<int32_t>* outValues) const override {
+        outValues->resize(slotCount);
+        for (int32_t& value : *outValues) {
+            value = fdp->ConsumeIntegral<int32_t>();
+        }
+        return fdp->ConsumeIntegral<status_t>();
+    }
     bool markSupportedKeyCodes(int32_t deviceId, size_t numCodes, const int32_t* keyCodes,
                                uint8_t* outFlags) const override {
         return fdp->ConsumeBool();
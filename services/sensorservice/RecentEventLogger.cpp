@@ -35,14 +35,19 @@ namespace {
 RecentEventLogger::RecentEventLogger(int sensorType) :
         mSensorType(sensorType), mEventSize(eventSizeBySensorType(mSensorType)),
         mRecentEvents(logSizeBySensorType(sensorType)), mMaskData(false),
-        mIsLastEventCurrent(false) {
+        mIsLastEventCurrent(false), mEventCount(0), mPollCount(0), mLastPoll(-1) {
     // blank
 }
 
-void RecentEventLogger::addEvent(const sensors_event_t& event) {
-    std::lock_guard<std::mutex> lk(mLock);
-    mRecentEvents.emplace(event);
+void RecentEventLogger::addEvent(const sensors_event_t& event, const Reception& reception) {
+    mRecentEvents.emplace(event, reception.wallTime);
     mIsLastEventCurrent = true;
+    mEventCount++;
+    if (reception.poll != mLastPoll) {
+        mPollCount++;
+        mLastPoll = reception.poll;
+    }
+    mReceptionLatency.add(reception.time - event.timestamp);
 }
 
 bool RecentEventLogger::isEmpty() const {
@@ -50,17 +55,17 @@ bool RecentEventLogger::isEmpty() const {
 }
 
 void RecentEventLogger::setLastEventStale() {
-    std::lock_guard<std::mutex> lk(mLock);
     mIsLastEventCurrent = false;
 }
 
 std::string RecentEventLogger::dump() const {
-    std::lock_guard<std::mutex> lk(mLock);
-
     //TODO: replace String8 with std::string completely in this function
     String8 buffer;
 
-    buffer.appendFormat("last %zu events\n", mRecentEvents.size());
+    buffer.appendFormat("%" PRId64 " events in %" PRId64 " polls, last %zu events\n",
+            mEventCount, mPollCount, mRecentEvents.size());
+    buffer.appendFormat("\tlatency from timestamp to reception: %s\n",
+            mReceptionLatency.dump().c_str());
     int j = 0;
     for (int i = mRecentEvents.size() - 1; i >= 0; --i) {
         const auto& ev = mRecentEvents[i];
@@ -95,7 +100,6 @@ std::string RecentEventLogger::dump() const {
  */
 void RecentEventLogger::dump(util::ProtoOutputStream* proto) const {
     using namespace service::SensorEventsProto;
-    std::lock_guard<std::mutex> lk(mLock);
 
     proto->write(RecentEventsLog::RECENT_EVENTS_COUNT, int(mRecentEvents.size()));
     for (int i = mRecentEvents.size() - 1; i >= 0; --i) {
@@ -129,8 +133,6 @@ void RecentEventLogger::setFormat(std::string format) {
 }
 
 bool RecentEventLogger::populateLastEventIfCurrent(sensors_event_t *event) const {
-    std::lock_guard<std::mutex> lk(mLock);
-
     if (mIsLastEventCurrent && mRecentEvents.size()) {
         // Index 0 contains the latest event emplace()'ed
         *event = mRecentEvents[0].mEvent;
@@ -154,8 +156,8 @@ size_t RecentEventLogger::logSizeBySensorType(int sensorType) {
     return LOG_SIZE;
 }
 
-RecentEventLogger::SensorEventLog::SensorEventLog(const sensors_event_t& e) : mEvent(e) {
-    clock_gettime(CLOCK_REALTIME, &mWallTime);
+RecentEventLogger::SensorEventLog::SensorEventLog(const sensors_event_t& e,
+        const timespec& wallTime) : mWallTime(wallTime), mEvent(e) {
 }
 
 } // namespace SensorServiceUtil
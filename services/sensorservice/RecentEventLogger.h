@@ -23,7 +23,7 @@
 #include <hardware/sensors.h>
 #include <utils/String8.h>
 
-#include <mutex>
+#include <time.h>
 
 namespace android {
 namespace SensorServiceUtil {
@@ -33,10 +33,20 @@ namespace SensorServiceUtil {
 // generated from the sensor are stored in this buffer.  The buffer is NOT cleared when the sensor
 // unregisters and as a result very old data in the dumpsys output can be seen, which is an intended
 // behavior.
+//
+// The logger is not thread safe. SensorService only uses it with its own lock held, so logging
+// does not take a second lock for every event on the sensor thread.
 class RecentEventLogger : public Dumpable {
 public:
     explicit RecentEventLogger(int sensorType);
-    void addEvent(const sensors_event_t& event);
+    // When, and in which poll of the HAL, events were received. The events of a poll share it.
+    struct Reception {
+        int64_t poll;
+        timespec wallTime;
+        // In the clock of the event timestamps.
+        nsecs_t time;
+    };
+    void addEvent(const sensors_event_t& event, const Reception& reception);
 
     // Populate event with the last recorded sensor event if it is not stale. An event is
     // considered stale if the sensor has become deactivated since the event was recorded.
@@ -53,7 +63,7 @@ public:
 
 protected:
     struct SensorEventLog {
-        explicit SensorEventLog(const sensors_event_t& e);
+        SensorEventLog(const sensors_event_t& e, const timespec& wallTime);
         timespec mWallTime;
         sensors_event_t mEvent;
     };
@@ -61,12 +71,19 @@ protected:
     const int mSensorType;
     const size_t mEventSize;
 
-    mutable std::mutex mLock;
     RingBuffer<SensorEventLog> mRecentEvents;
 
     bool mMaskData;
     bool mIsLastEventCurrent;
 
+    // The number of events received and of the polls they were received in, which tell how
+    // well the events of the sensor are batched.
+    int64_t mEventCount;
+    int64_t mPollCount;
+    int64_t mLastPoll;
+    // The time from the timestamp of the events to their reception from the HAL.
+    LatencyHistogram mReceptionLatency;
+
 private:
     static size_t logSizeBySensorType(int sensorType);
 };
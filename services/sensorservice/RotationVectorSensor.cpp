@@ -39,8 +39,12 @@ RotationVectorSensor::RotationVectorSensor(int mode) :
         .resolution = 1.0f / (1<<24),
         .power      = mSensorFusion.getPowerUsage(),
         .minDelay   = mSensorFusion.getMinDelay(),
+        // SensorService writes the fused orientation to ashmem direct channels itself.
+        .flags      = SENSOR_FLAG_CONTINUOUS_MODE | SENSOR_FLAG_DIRECT_CHANNEL_ASHMEM |
+                      (SENSOR_DIRECT_RATE_FAST << SENSOR_FLAG_SHIFT_DIRECT_REPORT),
     };
-    mSensor = Sensor(&sensor);
+    // The direct report flags are only taken from HAL 1.3 sensors.
+    mSensor = Sensor(&sensor, SENSORS_DEVICE_API_VERSION_1_3);
 }
 
 bool RotationVectorSensor::process(sensors_event_t* outEvent,
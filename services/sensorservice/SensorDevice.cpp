@@ -26,6 +26,7 @@
 #include <frameworks/base/core/proto/android/service/sensor_service.proto.h>
 #include <sensors/convert.h>
 #include <cutils/atomic.h>
+#include <cutils/properties.h>
 #include <utils/Errors.h>
 #include <utils/Singleton.h>
 
@@ -116,7 +117,9 @@ struct SensorsCallback : public ISensorsCallback {
 };
 
 SensorDevice::SensorDevice()
-        : mHidlTransportErrors(20),
+        : mMinReportLatencyNs(ms2ns(std::max(0,
+                  property_get_int32("sensors.min_report_latency_ms", 0)))),
+          mHidlTransportErrors(20),
           mRestartWaiter(new HidlServiceRegistrationWaiter()),
           mEventQueueFlag(nullptr),
           mWakeLockQueueFlag(nullptr),
@@ -176,6 +179,7 @@ void SensorDevice::initializeSensorList() {
                     }
                     mSensorList.push_back(sensor);
 
+                    model.fifoMaxEventCount = sensor.fifoMaxEventCount;
                     mActivationCount.add(list[i].sensorHandle, model);
 
                     // Only disable all sensors on HAL 1.0 since HAL 2.0
@@ -455,7 +459,12 @@ std::string SensorDevice::dump() const {
                     isClientDisabledLocked(info.batchParams.keyAt(j)) ? "(disabled)" : "",
                     (j < info.batchParams.size() - 1) ? ", " : "");
         }
-        result.appendFormat("}, selected = %.2f ms\n", info.bestBatchParams.mTBatch / 1e6f);
+        result.appendFormat("}, selected = %.2f ms; ", info.bestBatchParams.mTBatch / 1e6f);
+        result.appendFormat("batch updates = %" PRId64 "\n", info.halBatchCount);
+    }
+    if (mMinReportLatencyNs > 0) {
+        result.appendFormat("Minimum report latency: %" PRId64 " ms\n",
+                ns2ms(mMinReportLatencyNs));
     }
 
     return result.string();
@@ -831,6 +840,7 @@ status_t SensorDevice::updateBatchParamsLocked(int handle, Info &info) {
                  info.bestBatchParams.mTSample, info.bestBatchParams.mTBatch);
         err = checkReturnAndGetStatus(mSensors->batch(
                 handle, info.bestBatchParams.mTSample, info.bestBatchParams.mTBatch));
+        info.halBatchCount++;
     }
 
     return err;
@@ -1124,6 +1134,14 @@ void SensorDevice::Info::selectBatchParams() {
         }
         bestParams.merge(batchParams[i]);
     }
+    // Let the HAL batch for at least the minimum report latency, as far as half of the FIFO can
+    // hold the events, so that they are not dropped if the AP is slow to read them.
+    if (device.mMinReportLatencyNs > 0 && fifoMaxEventCount > 0 &&
+            bestParams.mTSample != INT64_MAX) {
+        const nsecs_t maxLatencyNs = bestParams.mTSample * (fifoMaxEventCount / 2);
+        bestParams.mTBatch = std::max(bestParams.mTBatch,
+                std::min(device.mMinReportLatencyNs, maxLatencyNs));
+    }
     // if mTBatch <= mTSample, it is in streaming mode. set mTbatch to 0 to demand this explicitly.
     if (bestParams.mTBatch <= bestParams.mTSample) {
         bestParams.mTBatch = 0;
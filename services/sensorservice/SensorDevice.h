@@ -137,6 +137,9 @@ private:
 
     static const nsecs_t MINIMUM_EVENTS_PERIOD =   1000000; // 1000 Hz
     mutable Mutex mLock; // protect mActivationCount[].batchParams
+    // The latency the HAL is allowed to batch the events of sensors with a FIFO for, even for
+    // streaming clients, trading their latency for fewer wake ups of the AP. 0 if disabled.
+    nsecs_t mMinReportLatencyNs;
     // fixed-size array after construction
 
     // Struct to store all the parameters(samplingPeriod, maxBatchReportLatency and flags) from
@@ -172,6 +175,11 @@ private:
         // Flag to track if the sensor is active
         bool isActive = false;
 
+        // The size of the FIFO of the sensor, which bounds how long its events can be batched.
+        uint32_t fifoMaxEventCount = 0;
+        // The number of times the batch parameters of the HAL were changed.
+        int64_t halBatchCount = 0;
+
         // Sets batch parameters for this ident. Returns error if this ident is not already present
         // in the KeyedVector above.
         status_t setBatchParamsForIdent(void* ident, int flags, int64_t samplingPeriodNs,
@@ -19,6 +19,9 @@
 #include <android/util/ProtoOutputStream.h>
 #include <frameworks/base/core/proto/android/service/sensor_service.proto.h>
 #include <hardware/sensors.h>
+#include <sys/mman.h>
+
+#include <algorithm>
 
 #define UNUSED(x) (void)(x)
 
@@ -26,12 +29,27 @@ namespace android {
 
 using util::ProtoOutputStream;
 
+// The sampling period of a virtual sensor reported at the given rate level, which is the nominal
+// rate of the level: 50Hz for normal, 200Hz for fast and 800Hz for very fast.
+static nsecs_t getDirectReportSamplingPeriodNs(int rateLevel) {
+    switch (rateLevel) {
+        case SENSOR_DIRECT_RATE_NORMAL:
+            return ms2ns(20);
+        case SENSOR_DIRECT_RATE_FAST:
+            return ms2ns(5);
+        default:
+            return us2ns(1250);
+    }
+}
+
 SensorService::SensorDirectConnection::SensorDirectConnection(const sp<SensorService>& service,
         uid_t uid, const sensors_direct_mem_t *mem, int32_t halChannelHandle,
         const String16& opPackageName)
         : mService(service), mUid(uid), mMem(*mem),
         mHalChannelHandle(halChannelHandle),
-        mOpPackageName(opPackageName), mDestroyed(false) {
+        mOpPackageName(opPackageName), mReportSource(ReportSource::NONE),
+        mSharedEvents(nullptr), mSharedEventCount(0), mNextSharedEvent(0),
+        mSharedEventCounter(0), mDestroyed(false) {
     ALOGD_IF(DEBUG_CONNECTIONS, "Created SensorDirectConnection");
 }
 
@@ -49,6 +67,7 @@ void SensorService::SensorDirectConnection::destroy() {
 
     stopAll();
     mService->cleanupConnection(this);
+    unmapSharedMemory();
     if (mMem.handle != nullptr) {
         native_handle_close(mMem.handle);
         native_handle_delete(const_cast<struct native_handle*>(mMem.handle));
@@ -66,6 +85,9 @@ void SensorService::SensorDirectConnection::dump(String8& result) const {
     for (auto &i : mActivated) {
         result.appendFormat("\t\tSensor %#08x, rate %d\n", i.first, i.second);
     }
+    for (auto &i : mActivatedVirtual) {
+        result.appendFormat("\t\tVirtual sensor %#08x, rate %d\n", i.first, i.second);
+    }
 }
 
 /**
@@ -96,8 +118,10 @@ sp<BitTube> SensorService::SensorDirectConnection::getSensorChannel() const {
 void SensorService::SensorDirectConnection::onSensorAccessChanged(bool hasAccess) {
     if (!hasAccess) {
         stopAll(true /* backupRecord */);
+        stopAllVirtualLocked(true /* backupRecord */);
     } else {
         recoverAll();
+        recoverAllVirtualLocked();
     }
 }
 
@@ -134,6 +158,7 @@ int32_t SensorService::SensorDirectConnection::configureChannel(int handle, int
 
     if (handle == -1 && rateLevel == SENSOR_DIRECT_RATE_STOP) {
         stopAll();
+        mService->stopVirtualDirectReports(this);
         return NO_ERROR;
     }
 
@@ -157,6 +182,14 @@ int32_t SensorService::SensorDirectConnection::configureChannel(int handle, int
         return INVALID_OPERATION;
     }
 
+    if (si->isVirtual()) {
+        return mService->configureVirtualDirectReport(this, handle, rateLevel);
+    }
+    if (rateLevel != SENSOR_DIRECT_RATE_STOP &&
+            (getHalChannelHandle() <= 0 || !bindReportSource(ReportSource::HAL))) {
+        return INVALID_OPERATION;
+    }
+
     struct sensors_direct_cfg_t config = {
         .rate_level = rateLevel
     };
@@ -224,6 +257,140 @@ void SensorService::SensorDirectConnection::recoverAll() {
     }
 }
 
+int32_t SensorService::SensorDirectConnection::configureVirtualSensorLocked(
+        int handle, int rateLevel) {
+    sp<SensorInterface> si = mService->getSensorInterfaceFromHandle(handle);
+    if (si == nullptr) {
+        return NAME_NOT_FOUND;
+    }
+
+    const bool wasActivated = mActivatedVirtual.count(handle) != 0;
+    if (rateLevel == SENSOR_DIRECT_RATE_STOP) {
+        if (wasActivated) {
+            si->activate(this, false);
+            mService->setVirtualSensorDirectReportLocked(handle, false);
+            mActivatedVirtual.erase(handle);
+        }
+        return NO_ERROR;
+    }
+
+    if (!bindReportSource(ReportSource::SERVICE) || !mapSharedMemoryLocked()) {
+        return INVALID_OPERATION;
+    }
+
+    const nsecs_t samplingPeriodNs = std::max(getDirectReportSamplingPeriodNs(rateLevel),
+            nsecs_t(si->getSensor().getMinDelayNs()));
+    status_t err = si->batch(this, handle, 0, samplingPeriodNs, 0);
+    if (err == NO_ERROR && !wasActivated) {
+        err = si->activate(this, true);
+    }
+    if (err != NO_ERROR) {
+        return err;
+    }
+
+    if (!wasActivated) {
+        mService->setVirtualSensorDirectReportLocked(handle, true);
+    }
+    mActivatedVirtual[handle] = rateLevel;
+    // The handle doubles as the token identifying the events of the sensor in the channel.
+    return handle;
+}
+
+void SensorService::SensorDirectConnection::stopAllVirtualLocked(bool backupRecord) {
+    for (auto &i : mActivatedVirtual) {
+        sp<SensorInterface> si = mService->getSensorInterfaceFromHandle(i.first);
+        if (si != nullptr) {
+            si->activate(this, false);
+        }
+        mService->setVirtualSensorDirectReportLocked(i.first, false);
+    }
+
+    if (backupRecord && mActivatedVirtualBackup.empty()) {
+        mActivatedVirtualBackup = mActivatedVirtual;
+    }
+    mActivatedVirtual.clear();
+}
+
+void SensorService::SensorDirectConnection::recoverAllVirtualLocked() {
+    if (!mActivatedVirtualBackup.empty()) {
+        stopAllVirtualLocked(false);
+
+        std::unordered_map<int, int> backup;
+        backup.swap(mActivatedVirtualBackup);
+        for (auto &i : backup) {
+            configureVirtualSensorLocked(i.first, i.second);
+        }
+    }
+}
+
+void SensorService::SensorDirectConnection::writeVirtualSensorEventsLocked(
+        const sensors_event_t* events, size_t count) {
+    if (mActivatedVirtual.empty()) {
+        return;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        const sensors_event_t& event = events[i];
+        if (event.type == SENSOR_TYPE_META_DATA || mActivatedVirtual.count(event.sensor) == 0) {
+            continue;
+        }
+
+        // Readers poll the atomic counter of the next event, so clear it first and set it last
+        // for them to never see a partially written event. 0 is never a valid counter.
+        sensors_event_t* out = &mSharedEvents[mNextSharedEvent];
+        out->reserved0 = 0;
+        std::atomic_thread_fence(std::memory_order_release);
+        out->version = sizeof(sensors_event_t);
+        out->sensor = event.sensor;
+        out->type = event.type;
+        out->timestamp = event.timestamp;
+        memcpy(out->data, event.data, sizeof(out->data));
+        std::atomic_thread_fence(std::memory_order_release);
+        if (++mSharedEventCounter == 0) {
+            mSharedEventCounter = 1;
+        }
+        out->reserved0 = static_cast<int32_t>(mSharedEventCounter);
+
+        mNextSharedEvent = (mNextSharedEvent + 1) % mSharedEventCount;
+    }
+}
+
+bool SensorService::SensorDirectConnection::mapSharedMemoryLocked() {
+    if (mSharedEvents != nullptr) {
+        return true;
+    }
+    if (mMem.type != SENSOR_DIRECT_MEM_TYPE_ASHMEM) {
+        // Writing to gralloc buffers would require mapping them through the allocator HAL.
+        return false;
+    }
+
+    const size_t eventCount = mMem.size / sizeof(sensors_event_t);
+    if (eventCount == 0) {
+        return false;
+    }
+    void* addr = mmap(nullptr, eventCount * sizeof(sensors_event_t), PROT_READ | PROT_WRITE,
+            MAP_SHARED, mMem.handle->data[0], 0);
+    if (addr == MAP_FAILED) {
+        ALOGE("Failed to map direct channel memory: %s", strerror(errno));
+        return false;
+    }
+    mSharedEvents = static_cast<sensors_event_t*>(addr);
+    mSharedEventCount = eventCount;
+    return true;
+}
+
+void SensorService::SensorDirectConnection::unmapSharedMemory() {
+    if (mSharedEvents != nullptr) {
+        munmap(mSharedEvents, mSharedEventCount * sizeof(sensors_event_t));
+        mSharedEvents = nullptr;
+    }
+}
+
+bool SensorService::SensorDirectConnection::bindReportSource(ReportSource source) {
+    ReportSource current = ReportSource::NONE;
+    return mReportSource.compare_exchange_strong(current, source) || current == source;
+}
+
 int32_t SensorService::SensorDirectConnection::getHalChannelHandle() const {
     return mHalChannelHandle;
 }
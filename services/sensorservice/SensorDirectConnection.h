@@ -20,6 +20,8 @@
 #include <stdint.h>
 #include <sys/types.h>
 
+#include <atomic>
+
 #include <binder/BinderService.h>
 
 #include <sensor/Sensor.h>
@@ -48,9 +50,15 @@ public:
 
     // Invoked when access to sensors for this connection has changed, e.g. lost or
     // regained due to changes in the sensor restricted/privacy mode or the
-    // app changed to idle/active status.
+    // app changed to idle/active status. SensorService::mLock must be held.
     void onSensorAccessChanged(bool hasAccess);
 
+    // The HAL does not know about virtual sensors, so SensorService writes their events to the
+    // shared memory itself. These methods require SensorService::mLock to be held.
+    int32_t configureVirtualSensorLocked(int handle, int rateLevel);
+    void stopAllVirtualLocked(bool backupRecord);
+    void writeVirtualSensorEventsLocked(const sensors_event_t* events, size_t count);
+
 protected:
     virtual ~SensorDirectConnection();
     // ISensorEventConnection functions
@@ -81,6 +89,17 @@ private:
     //
     // If no requests are backed up by stopAll(), this method is no-op.
     void recoverAll();
+    void recoverAllVirtualLocked();
+
+    // Maps the ashmem region on the first virtual sensor report. Returns false if it can't be.
+    bool mapSharedMemoryLocked();
+    void unmapSharedMemory();
+
+    // A channel is written to either by the HAL, for hardware sensors, or by SensorService, for
+    // virtual sensors, as they can't share its write position. It is bound to the first kind of
+    // sensor configured on it.
+    enum class ReportSource { NONE, HAL, SERVICE };
+    bool bindReportSource(ReportSource source);
 
     const sp<SensorService> mService;
     const uid_t mUid;
@@ -92,6 +111,17 @@ private:
     std::unordered_map<int, int> mActivated;
     std::unordered_map<int, int> mActivatedBackup;
 
+    std::atomic<ReportSource> mReportSource;
+
+    // Rate levels of the virtual sensors reported to this channel, and the ring of events they
+    // are written to. Protected by SensorService::mLock.
+    std::unordered_map<int, int> mActivatedVirtual;
+    std::unordered_map<int, int> mActivatedVirtualBackup;
+    sensors_event_t* mSharedEvents;
+    size_t mSharedEventCount;
+    size_t mNextSharedEvent;
+    uint32_t mSharedEventCounter;
+
     mutable Mutex mDestroyLock;
     bool mDestroyed;
 };
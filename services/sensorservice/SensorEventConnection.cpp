@@ -196,6 +196,22 @@ bool SensorService::SensorEventConnection::hasAnySensor() const {
     return mSensorInfo.size() ? true : false;
 }
 
+bool SensorService::SensorEventConnection::isInterestedInEvents(
+        const std::vector<int32_t>& handles) const {
+    Mutex::Autolock _l(mConnectionLock);
+    for (int32_t handle : handles) {
+        if (mSensorInfo.count(handle) > 0) {
+            return true;
+        }
+    }
+    for (auto& it : mSensorInfo) {
+        if (it.second.mPendingFlushEventsToSend > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
 bool SensorService::SensorEventConnection::hasOneShotSensors() const {
     Mutex::Autolock _l(mConnectionLock);
     for (auto &it : mSensorInfo) {
@@ -296,6 +312,25 @@ status_t SensorService::SensorEventConnection::sendEvents(
     int count = 0;
     Mutex::Autolock _l(mConnectionLock);
     if (scratch) {
+        // The events for this connection are copied to scratch a run of consecutive events at a
+        // time. [runStart, runEnd) is the run that has not been copied yet.
+        size_t runStart = 0;
+        size_t runEnd = 0;
+        auto copyRun = [&]() {
+            if (runEnd > runStart) {
+                memcpy(&scratch[count], &buffer[runStart],
+                       (runEnd - runStart) * sizeof(sensors_event_t));
+                count += runEnd - runStart;
+            }
+        };
+        auto keepEvent = [&](size_t index) {
+            if (index != runEnd) {
+                copyRun();
+                runStart = index;
+            }
+            runEnd = index + 1;
+        };
+
         size_t i=0;
         while (i<numEvents) {
             int32_t sensor_handle = buffer[i].sensor;
@@ -340,13 +375,13 @@ status_t SensorService::SensorEventConnection::sendEvents(
                 // corresponding flush_complete_event.
                 if (buffer[i].type == SENSOR_TYPE_META_DATA) {
                     if (mapFlushEventsToConnections[i] == this) {
-                        scratch[count++] = buffer[i];
+                        keepEvent(i);
                     }
                 } else {
                     // Regular sensor event, just copy it to the scratch buffer after checking
                     // the AppOp.
                     if (hasSensorAccess() && noteOpIfRequired(buffer[i])) {
-                        scratch[count++] = buffer[i];
+                        keepEvent(i);
                     }
                 }
                 i++;
@@ -355,6 +390,16 @@ status_t SensorService::SensorEventConnection::sendEvents(
                                        (buffer[i].type == SENSOR_TYPE_META_DATA  &&
                                         buffer[i].meta_data.sensor == sensor_handle)));
         }
+
+        if (count == 0 && runStart == 0 && runEnd == numEvents &&
+                findWakeUpSensorEventLocked(buffer, numEvents) < 0) {
+            // All the events are for this connection, and none of them needs its flags set for
+            // an ack, so write them from the shared buffer instead of copying them.
+            scratch = const_cast<sensors_event_t *>(buffer);
+            count = numEvents;
+        } else {
+            copyRun();
+        }
     } else {
         if (hasSensorAccess()) {
             scratch = const_cast<sensors_event_t *>(buffer);
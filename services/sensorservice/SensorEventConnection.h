@@ -56,6 +56,10 @@ public:
                         wp<const SensorEventConnection> const * mapFlushEventsToConnections = nullptr);
     bool hasSensor(int32_t handle) const;
     bool hasAnySensor() const;
+    // Returns whether sendEvents has anything to send for a buffer holding events of the given
+    // sensors: the connection registered for one of them, or it has pending flush complete
+    // events.
+    bool isInterestedInEvents(const std::vector<int32_t>& handles) const;
     bool hasOneShotSensors() const;
     bool addSensor(int32_t handle);
     bool removeSensor(int32_t handle);
@@ -39,6 +39,10 @@ SensorFusion::SensorFusion()
     mEnabled[FUSION_NOMAG] = false;
     mEnabled[FUSION_NOGYRO] = false;
 
+    for (int i = 0; i<NUM_FUSION_MODE; ++i) {
+        mRotationMatrixValid[i] = false;
+    }
+
     if (count > 0) {
         for (size_t i=0 ; i<size_t(count) ; i++) {
             if (list[i].type == SENSOR_TYPE_ACCELEROMETER) {
@@ -72,6 +76,9 @@ SensorFusion::SensorFusion()
 }
 
 void SensorFusion::process(const sensors_event_t& event) {
+    for (int i = 0; i<NUM_FUSION_MODE; ++i) {
+        mRotationMatrixValid[i] = false;
+    }
 
     if (event.type == mGyro.getType()) {
         float dT;
@@ -145,6 +152,7 @@ status_t SensorFusion::activate(int mode, void* ident, bool enabled) {
         mEnabled[mode] = newState;
         if (newState) {
             mFusions[mode].init(mode);
+            mRotationMatrixValid[mode] = false;
         }
     }
 
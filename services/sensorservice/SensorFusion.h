@@ -50,6 +50,11 @@ class SensorFusion : public Singleton<SensorFusion> {
     vec4_t &mAttitude;
     vec4_t mAttitudes[NUM_FUSION_MODE];
 
+    // The rotation matrix of each mode, computed once per state update, as every virtual sensor
+    // output of a poll needs one.
+    mutable mat33_t mRotationMatrices[NUM_FUSION_MODE];
+    mutable bool mRotationMatrixValid[NUM_FUSION_MODE];
+
     SortedVector<void*> mClients[3];
 
     float mEstimatedGyroRate;
@@ -74,7 +79,11 @@ public:
     }
 
     mat33_t getRotationMatrix(int mode = FUSION_9AXIS) const {
-        return mFusions[mode].getRotationMatrix();
+        if (!mRotationMatrixValid[mode]) {
+            mRotationMatrices[mode] = mFusions[mode].getRotationMatrix();
+            mRotationMatrixValid[mode] = true;
+        }
+        return mRotationMatrices[mode];
     }
 
     vec4_t getAttitude(int mode = FUSION_9AXIS) const {
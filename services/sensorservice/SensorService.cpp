@@ -50,6 +50,7 @@
 #include "SensorRecord.h"
 #include "SensorRegistrationInfo.h"
 
+#include <algorithm>
 #include <ctime>
 #include <inttypes.h>
 #include <math.h>
@@ -87,6 +88,10 @@ AppOpsManager SensorService::sAppOpsManager;
 #define SENSOR_SERVICE_HMAC_KEY_FILE  SENSOR_SERVICE_DIR "/hmac_key"
 #define SENSOR_SERVICE_SCHED_FIFO_PRIORITY 10
 
+// How long to keep the wake lock after the last wake up event has been acknowledged, so that
+// bursts of wake up events don't acquire and release it for each batch. 0 releases immediately.
+#define SENSOR_SERVICE_WAKE_LOCK_RELEASE_DELAY_PROPERTY "sensors.wake_lock_release_delay_ms"
+
 // Permissions.
 static const String16 sDumpPermission("android.permission.DUMP");
 static const String16 sLocationHardwarePermission("android.permission.LOCATION_HARDWARE");
@@ -94,7 +99,8 @@ static const String16 sManageSensorsPermission("android.permission.MANAGE_SENSOR
 
 SensorService::SensorService()
     : mInitCheck(NO_INIT), mSocketBufferSize(SOCKET_BUFFER_SIZE_NON_BATCHED),
-      mWakeLockAcquired(false) {
+      mWakeLockAcquired(false), mWakeLockReleaseDelay(0), mWakeLockReleaseTime(0),
+      mEventDispatchCount(0), mEventDispatchTimeNs(0), mLastPollTime(0) {
     mUidPolicy = new UidPolicy(this);
     mSensorPrivacyPolicy = new SensorPrivacyPolicy(this);
 }
@@ -272,6 +278,9 @@ void SensorService::onFirstRef() {
             }
 
             mWakeLockAcquired = false;
+            mWakeLockReleaseDelay = ms2ns(std::max(0,
+                    property_get_int32(SENSOR_SERVICE_WAKE_LOCK_RELEASE_DELAY_PROPERTY, 0)));
+            mWakeLockReleaseTime = 0;
             mLooper = new Looper(false);
             const size_t minBufferSize = SensorEventQueue::MAX_RECEIVE_BUFFER_EVENT_COUNT;
             mSensorEventBuffer = new sensors_event_t[minBufferSize];
@@ -478,8 +487,17 @@ status_t SensorService::dump(int fd, const Vector<String16>& args) {
 
             result.appendFormat("Socket Buffer size = %zd events\n",
                                 mSocketBufferSize/sizeof(sensors_event_t));
-            result.appendFormat("WakeLock Status: %s \n", mWakeLockAcquired ? "acquired" :
+            result.appendFormat("WakeLock Status: %s \n", mWakeLockAcquired ?
+                    (mWakeLockReleaseTime != 0 ? "acquired, release pending" : "acquired") :
                     "not held");
+            result.appendFormat("WakeLock release delay: %" PRId64 " ms\n",
+                    ns2ms(mWakeLockReleaseDelay));
+            result.appendFormat("Event dispatch: %" PRId64 " polls, %.1f us per poll\n",
+                    mEventDispatchCount,
+                    mEventDispatchCount > 0
+                            ? mEventDispatchTimeNs / 1000.0 / mEventDispatchCount : 0.0);
+            result.appendFormat("Event dispatch latency from reception to sockets: %s\n",
+                    mEventDispatchLatency.dump().c_str());
             result.appendFormat("Mode :");
             switch(mCurrentOperatingMode) {
                case NORMAL:
@@ -866,6 +884,9 @@ bool SensorService::threadLoop() {
             }
         }
 
+        // Sensor timestamps are in the boot time base.
+        mLastPollTime = systemTime(SYSTEM_TIME_BOOTTIME);
+
         // Reset sensors_event_t.flags to zero for all events in the buffer.
         for (int i = 0; i < count; i++) {
              mSensorEventBuffer[i].flags = 0;
@@ -903,8 +924,19 @@ bool SensorService::threadLoop() {
                         fusion.process(event[i]);
                     }
                 }
+                // Look up the active virtual sensors once for the whole poll rather than for
+                // every event.
+                mActiveVirtualSensorInterfaces.clear();
+                for (int handle : mActiveVirtualSensors) {
+                    sp<SensorInterface> si = mSensors.getInterface(handle);
+                    if (si == nullptr) {
+                        ALOGE("handle %d is not an valid virtual sensor", handle);
+                        continue;
+                    }
+                    mActiveVirtualSensorInterfaces.push_back(si);
+                }
                 for (size_t i=0 ; i<size_t(count) && k<minBufferSize ; i++) {
-                    for (int handle : mActiveVirtualSensors) {
+                    for (const sp<SensorInterface>& si : mActiveVirtualSensorInterfaces) {
                         if (count + k >= minBufferSize) {
                             ALOGE("buffer too small to hold all events: "
                                     "count=%zd, k=%zu, size=%zu",
@@ -912,12 +944,6 @@ bool SensorService::threadLoop() {
                             break;
                         }
                         sensors_event_t out;
-                        sp<SensorInterface> si = mSensors.getInterface(handle);
-                        if (si == nullptr) {
-                            ALOGE("handle %d is not an valid virtual sensor", handle);
-                            continue;
-                        }
-
                         if (si->process(&out, event[i])) {
                             mSensorEventBuffer[count + k] = out;
                             k++;
@@ -945,6 +971,13 @@ bool SensorService::threadLoop() {
             }
         }
 
+        // Write the virtual sensor events to the direct channels reporting them.
+        if (!mDirectReportVirtualSensors.empty()) {
+            for (const sp<SensorDirectConnection>& conn : connLock.getDirectConnections()) {
+                conn->writeVirtualSensorEventsLocked(mSensorEventBuffer, count);
+            }
+        }
+
         // Cache the list of active connections, since we use it in multiple places below but won't
         // modify it here
         const std::vector<sp<SensorEventConnection>> activeConnections = connLock.getActiveConnections();
@@ -1009,16 +1042,36 @@ bool SensorService::threadLoop() {
 
         // Send our events to clients. Check the state of wake lock for each client and release the
         // lock if none of the clients need it.
+        // Most connections only registered for a few sensors, so rather than having each of them
+        // filter the whole buffer, the events are only offered to the connections that registered
+        // for one of the sensors in it.
+        const nsecs_t dispatchStartTime = systemTime(SYSTEM_TIME_MONOTONIC);
+        mSensorEventHandles.clear();
+        for (int i = 0; i < count; i++) {
+            const int32_t handle = mSensorEventBuffer[i].type == SENSOR_TYPE_META_DATA
+                    ? mSensorEventBuffer[i].meta_data.sensor : mSensorEventBuffer[i].sensor;
+            if (std::find(mSensorEventHandles.begin(), mSensorEventHandles.end(), handle) ==
+                    mSensorEventHandles.end()) {
+                mSensorEventHandles.push_back(handle);
+            }
+        }
         bool needsWakeLock = false;
         for (const sp<SensorEventConnection>& connection : activeConnections) {
-            connection->sendEvents(mSensorEventBuffer, count, mSensorEventScratch,
-                    mMapFlushEventsToConnections);
-            needsWakeLock |= connection->needsWakeLock();
-            // If the connection has one-shot sensors, it may be cleaned up after first trigger.
-            // Early check for one-shot sensors.
-            if (connection->hasOneShotSensors()) {
-                cleanupAutoDisabledSensorLocked(connection, mSensorEventBuffer, count);
+            if (connection->isInterestedInEvents(mSensorEventHandles)) {
+                connection->sendEvents(mSensorEventBuffer, count, mSensorEventScratch,
+                        mMapFlushEventsToConnections);
+                // If the connection has one-shot sensors, it may be cleaned up after first
+                // trigger. Early check for one-shot sensors.
+                if (connection->hasOneShotSensors()) {
+                    cleanupAutoDisabledSensorLocked(connection, mSensorEventBuffer, count);
+                }
             }
+            needsWakeLock |= connection->needsWakeLock();
+        }
+        mEventDispatchCount++;
+        mEventDispatchTimeNs += systemTime(SYSTEM_TIME_MONOTONIC) - dispatchStartTime;
+        if (count > 0) {
+            mEventDispatchLatency.add(systemTime(SYSTEM_TIME_BOOTTIME) - mLastPollTime);
         }
 
         if (mWakeLockAcquired && !needsWakeLock) {
@@ -1040,39 +1093,77 @@ void SensorService::resetAllWakeLockRefCounts() {
     for (const sp<SensorEventConnection>& connection : connLock.getActiveConnections()) {
         connection->resetWakeLockRefCount();
     }
-    setWakeLockAcquiredLocked(false);
+    releaseWakeLockLocked();
 }
 
 void SensorService::setWakeLockAcquiredLocked(bool acquire) {
     if (acquire) {
+        mWakeLockReleaseTime = 0;
         if (!mWakeLockAcquired) {
             acquire_wake_lock(PARTIAL_WAKE_LOCK, WAKE_LOCK_NAME);
             mWakeLockAcquired = true;
         }
         mLooper->wake();
-    } else {
-        if (mWakeLockAcquired) {
-            release_wake_lock(WAKE_LOCK_NAME);
-            mWakeLockAcquired = false;
+    } else if (mWakeLockAcquired) {
+        if (mWakeLockReleaseDelay == 0) {
+            releaseWakeLockLocked();
+        } else if (mWakeLockReleaseTime == 0) {
+            // Keep the wake lock a little longer in case more wake up events follow, and let
+            // SensorEventAckReceiver release it once the delay has passed.
+            mWakeLockReleaseTime = systemTime(SYSTEM_TIME_MONOTONIC) + mWakeLockReleaseDelay;
+            mLooper->wake();
+        }
+    }
+}
+
+void SensorService::releaseWakeLockLocked() {
+    mWakeLockReleaseTime = 0;
+    if (mWakeLockAcquired) {
+        release_wake_lock(WAKE_LOCK_NAME);
+        mWakeLockAcquired = false;
+    }
+}
+
+void SensorService::releaseDeferredWakeLock() {
+    ConnectionSafeAutolock connLock = mConnectionHolder.lock(mLock);
+    if (mWakeLockReleaseTime == 0 ||
+            systemTime(SYSTEM_TIME_MONOTONIC) < mWakeLockReleaseTime) {
+        return;
+    }
+    // Wake up events may have been sent while the release was pending without the wake lock
+    // being acquired again, as it was still held. Keep it until those are acknowledged too.
+    for (const sp<SensorEventConnection>& connection : connLock.getActiveConnections()) {
+        if (connection->needsWakeLock()) {
+            mWakeLockReleaseTime = 0;
+            return;
         }
     }
+    releaseWakeLockLocked();
 }
 
-bool SensorService::isWakeLockAcquired() {
+int SensorService::getWakeLockTimeoutMillis(bool* outReleasePending) {
     Mutex::Autolock _l(mLock);
-    return mWakeLockAcquired;
+    *outReleasePending = mWakeLockReleaseTime != 0;
+    if (*outReleasePending) {
+        return toMillisecondTimeoutDelay(systemTime(SYSTEM_TIME_MONOTONIC),
+                mWakeLockReleaseTime);
+    }
+    return mWakeLockAcquired ? 5000 : -1;
 }
 
 bool SensorService::SensorEventAckReceiver::threadLoop() {
     ALOGD("new thread SensorEventAckReceiver");
     sp<Looper> looper = mService->getLooper();
     do {
-        bool wakeLockAcquired = mService->isWakeLockAcquired();
-        int timeout = -1;
-        if (wakeLockAcquired) timeout = 5000;
+        bool releasePending;
+        int timeout = mService->getWakeLockTimeoutMillis(&releasePending);
         int ret = looper->pollOnce(timeout);
         if (ret == ALOOPER_POLL_TIMEOUT) {
-           mService->resetAllWakeLockRefCounts();
+            if (releasePending) {
+                mService->releaseDeferredWakeLock();
+            } else {
+                mService->resetAllWakeLockRefCounts();
+            }
         }
     } while(!Thread::exitPending());
     return false;
@@ -1080,6 +1171,11 @@ bool SensorService::SensorEventAckReceiver::threadLoop() {
 
 void SensorService::recordLastValueLocked(
         const sensors_event_t* buffer, size_t count) {
+    // The events of a poll are received together, so they share the time they are logged at.
+    SensorServiceUtil::RecentEventLogger::Reception reception;
+    reception.poll = mEventDispatchCount;
+    reception.time = mLastPollTime;
+    clock_gettime(CLOCK_REALTIME, &reception.wallTime);
     for (size_t i = 0; i < count; i++) {
         if (buffer[i].type == SENSOR_TYPE_META_DATA ||
             buffer[i].type == SENSOR_TYPE_DYNAMIC_SENSOR_META ||
@@ -1089,7 +1185,7 @@ void SensorService::recordLastValueLocked(
 
         auto logger = mRecentEvent.find(buffer[i].sensor);
         if (logger != mRecentEvent.end()) {
-            logger->second->addEvent(buffer[i]);
+            logger->second->addEvent(buffer[i], reception);
         }
     }
 }
@@ -1351,8 +1447,13 @@ sp<ISensorEventConnection> SensorService::createSensorDirectConnection(
     sp<SensorDirectConnection> conn;
     SensorDevice& dev(SensorDevice::getInstance());
     int channelHandle = dev.registerDirectChannel(&mem);
+    if (channelHandle <= 0 && type == SENSOR_DIRECT_MEM_TYPE_ASHMEM) {
+        // The channel can still report virtual sensors, whose events SensorService writes itself.
+        ALOGD_IF(DEBUG_CONNECTIONS, "Creating direct channel without HAL support");
+        channelHandle = 0;
+    }
 
-    if (channelHandle <= 0) {
+    if (channelHandle < 0) {
         ALOGE("SensorDevice::registerDirectChannel returns %d", channelHandle);
     } else {
         mem.handle = clone;
@@ -1502,7 +1603,9 @@ void SensorService::cleanupConnection(SensorEventConnection* c) {
         if (rec && rec->removeConnection(connection)) {
             ALOGD_IF(DEBUG_CONNECTIONS, "... and it was the last connection");
             mActiveSensors.removeItemsAt(i, 1);
-            mActiveVirtualSensors.erase(handle);
+            if (mDirectReportVirtualSensors.count(handle) == 0) {
+                mActiveVirtualSensors.erase(handle);
+            }
             delete rec;
             size--;
         } else {
@@ -1531,11 +1634,42 @@ void SensorService::cleanupConnection(SensorEventConnection* c) {
 void SensorService::cleanupConnection(SensorDirectConnection* c) {
     Mutex::Autolock _l(mLock);
 
-    SensorDevice& dev(SensorDevice::getInstance());
-    dev.unregisterDirectChannel(c->getHalChannelHandle());
+    c->stopAllVirtualLocked(false);
+    if (c->getHalChannelHandle() > 0) {
+        SensorDevice& dev(SensorDevice::getInstance());
+        dev.unregisterDirectChannel(c->getHalChannelHandle());
+    }
     mConnectionHolder.removeDirectConnection(c);
 }
 
+status_t SensorService::configureVirtualDirectReport(SensorDirectConnection* c, int handle,
+        int rateLevel) {
+    Mutex::Autolock _l(mLock);
+    return c->configureVirtualSensorLocked(handle, rateLevel);
+}
+
+void SensorService::stopVirtualDirectReports(SensorDirectConnection* c) {
+    Mutex::Autolock _l(mLock);
+    c->stopAllVirtualLocked(false);
+}
+
+void SensorService::setVirtualSensorDirectReportLocked(int handle, bool enabled) {
+    if (enabled) {
+        if (mDirectReportVirtualSensors[handle]++ == 0) {
+            mActiveVirtualSensors.emplace(handle);
+        }
+        return;
+    }
+
+    auto it = mDirectReportVirtualSensors.find(handle);
+    if (it != mDirectReportVirtualSensors.end() && --it->second == 0) {
+        mDirectReportVirtualSensors.erase(it);
+        if (mActiveSensors.indexOfKey(handle) < 0) {
+            mActiveVirtualSensors.erase(handle);
+        }
+    }
+}
+
 sp<SensorInterface> SensorService::getSensorInterfaceFromHandle(int handle) const {
     return mSensors.getInterface(handle);
 }
@@ -1725,7 +1859,9 @@ status_t SensorService::cleanupWithoutDisableLocked(
         // see if this sensor becomes inactive
         if (rec->removeConnection(connection)) {
             mActiveSensors.removeItem(handle);
-            mActiveVirtualSensors.erase(handle);
+            if (mDirectReportVirtualSensors.count(handle) == 0) {
+                mActiveVirtualSensors.erase(handle);
+            }
             delete rec;
         }
         return NO_ERROR;
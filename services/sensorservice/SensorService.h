@@ -297,6 +297,11 @@ private:
     String8 getSensorName(int handle) const;
     bool isVirtualSensor(int handle) const;
     sp<SensorInterface> getSensorInterfaceFromHandle(int handle) const;
+    // Starts, changes the rate of, or stops the report of a virtual sensor to a direct channel.
+    status_t configureVirtualDirectReport(SensorDirectConnection* c, int handle, int rateLevel);
+    void stopVirtualDirectReports(SensorDirectConnection* c);
+    // Keeps a virtual sensor active while a direct channel reports it. mLock must be held.
+    void setVirtualSensorDirectReportLocked(int handle, bool enabled);
     bool isWakeUpSensor(int type) const;
     void recordLastValueLocked(sensors_event_t const* buffer, size_t count);
     static void sortEventBuffer(sensors_event_t* buffer, size_t count);
@@ -318,7 +323,6 @@ private:
     // corresponding applications, if yes the wakelock is released.
     void checkWakeLockState();
     void checkWakeLockStateLocked(ConnectionSafeAutolock* connLock);
-    bool isWakeLockAcquired();
     bool isWakeUpSensorEvent(const sensors_event_t& event) const;
 
     sp<Looper> getLooper() const;
@@ -329,8 +333,15 @@ private:
     void resetAllWakeLockRefCounts();
 
     // Acquire or release wake_lock. If wake_lock is acquired, set the timeout in the looper to 5
-    // seconds and wake the looper.
+    // seconds and wake the looper. If a release delay is configured, the release is deferred by
+    // that delay and cancelled if wake_lock is acquired again in the meantime.
     void setWakeLockAcquiredLocked(bool acquire);
+    void releaseWakeLockLocked();
+    // Release wake_lock if its deferred release is due and no connection needs it anymore.
+    void releaseDeferredWakeLock();
+    // Returns how long SensorEventAckReceiver should wait: until the deferred release of
+    // wake_lock if one is pending, 5 seconds while it is held, or forever otherwise.
+    int getWakeLockTimeoutMillis(bool* outReleasePending);
 
     // Send events from the event cache for this particular connection.
     void sendEventsFromCache(const sp<SensorEventConnection>& connection);
@@ -400,12 +411,30 @@ private:
     mutable Mutex mLock;
     DefaultKeyedVector<int, SensorRecord*> mActiveSensors;
     std::unordered_set<int> mActiveVirtualSensors;
+    // The interfaces of mActiveVirtualSensors, looked up by threadLoop for each poll.
+    std::vector<sp<SensorInterface>> mActiveVirtualSensorInterfaces;
+    // The number of direct channels reporting each virtual sensor.
+    std::unordered_map<int, size_t> mDirectReportVirtualSensors;
     SensorConnectionHolder mConnectionHolder;
     bool mWakeLockAcquired;
+    // How long wake_lock is kept after it is no longer needed, and when it will be released, or
+    // 0 if no release is pending.
+    nsecs_t mWakeLockReleaseDelay;
+    nsecs_t mWakeLockReleaseTime;
     sensors_event_t *mSensorEventBuffer, *mSensorEventScratch;
     // WARNING: these SensorEventConnection instances must not be promoted to sp, except via
     // modification to add support for them in ConnectionSafeAutolock
     wp<const SensorEventConnection> * mMapFlushEventsToConnections;
+    // The distinct sensors of the events in mSensorEventBuffer, used to only offer the events to
+    // the connections that registered for them.
+    std::vector<int32_t> mSensorEventHandles;
+    // The number of polls whose events were sent to clients, and the time spent sending them.
+    int64_t mEventDispatchCount;
+    nsecs_t mEventDispatchTimeNs;
+    // When the last events were received from the HAL, and how long it took from there until
+    // they were written to the clients.
+    nsecs_t mLastPollTime;
+    SensorServiceUtil::LatencyHistogram mEventDispatchLatency;
     std::unordered_map<int, SensorServiceUtil::RecentEventLogger*> mRecentEvent;
     Mode mCurrentOperatingMode;
 
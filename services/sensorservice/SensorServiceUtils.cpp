@@ -17,6 +17,10 @@
 #include "SensorServiceUtils.h"
 
 #include <hardware/sensors.h>
+#include <utils/String8.h>
+
+#include <algorithm>
+#include <inttypes.h>
 
 namespace android {
 namespace SensorServiceUtil {
@@ -63,5 +67,42 @@ size_t eventSizeBySensorType(int type) {
     }
 }
 
+void LatencyHistogram::add(nsecs_t latency) {
+    // Sensor timestamps may be slightly ahead of the clock they are compared to.
+    latency = std::max(latency, nsecs_t(0));
+    const uint64_t units = latency / BUCKET_UNIT;
+    const size_t bucket = units == 0 ? 0 : std::min(NUM_BUCKETS - 1,
+            size_t(64 - __builtin_clzll(units)));
+    mBuckets[bucket]++;
+    mCount++;
+    mMax = std::max(mMax, latency);
+}
+
+std::string LatencyHistogram::dump() const {
+    String8 result;
+    result.appendFormat("count=%" PRId64, mCount);
+    if (mCount == 0) {
+        return std::string(result.string());
+    }
+
+    static constexpr int PERCENTILES[] = {50, 90, 99};
+    size_t bucket = 0;
+    int64_t cumulativeCount = mBuckets[0];
+    for (int percentile : PERCENTILES) {
+        const int64_t rank = (mCount * percentile + 99) / 100;
+        while (cumulativeCount < rank && bucket < NUM_BUCKETS - 1) {
+            cumulativeCount += mBuckets[++bucket];
+        }
+        if (bucket == NUM_BUCKETS - 1) {
+            result.appendFormat(", p%d>%.2fms", percentile,
+                    (BUCKET_UNIT << (bucket - 1)) / 1e6);
+        } else {
+            result.appendFormat(", p%d<%.2fms", percentile, (BUCKET_UNIT << bucket) / 1e6);
+        }
+    }
+    result.appendFormat(", max=%.2fms", mMax / 1e6);
+    return std::string(result.string());
+}
+
 } // namespace SensorServiceUtil
 } // namespace android;
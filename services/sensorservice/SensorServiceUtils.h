@@ -17,6 +17,9 @@
 #ifndef ANDROID_SENSOR_SERVICE_UTIL
 #define ANDROID_SENSOR_SERVICE_UTIL
 
+#include <utils/Timers.h>
+
+#include <array>
 #include <cstddef>
 #include <string>
 
@@ -38,6 +41,24 @@ public:
 
 size_t eventSizeBySensorType(int type);
 
+// A histogram of latencies, cheap enough to record every sensor event in. The bounds of its
+// buckets double from 0.25 ms up to 512 ms, the last bucket holding all the longer latencies.
+class LatencyHistogram {
+public:
+    void add(nsecs_t latency);
+    // Returns the number of latencies recorded and their percentiles, as the upper bounds of the
+    // buckets they fall in.
+    std::string dump() const;
+
+private:
+    static constexpr nsecs_t BUCKET_UNIT = 250000; // 0.25 ms
+    static constexpr size_t NUM_BUCKETS = 13;
+
+    std::array<int64_t, NUM_BUCKETS> mBuckets{};
+    int64_t mCount = 0;
+    nsecs_t mMax = 0;
+};
+
 } // namespace SensorServiceUtil
 } // namespace android;
 
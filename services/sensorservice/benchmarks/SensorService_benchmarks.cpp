@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <hardware/sensors.h>
+#include <math.h>
+#include <time.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "../Fusion.h"
+#include "../RecentEventLogger.h"
+
+namespace android {
+
+static const nsecs_t TRACE_DURATION = ms2ns(1000);
+
+// Arbitrary sensor handles.
+static const int32_t ACCELEROMETER_HANDLE = 1;
+static const int32_t GYROSCOPE_HANDLE = 2;
+static const int32_t MAGNETOMETER_HANDLE = 3;
+
+static sensors_event_t createEvent(int32_t handle, int32_t type, nsecs_t timestamp, float x,
+                                   float y, float z) {
+    sensors_event_t event = {};
+    event.version = sizeof(sensors_event_t);
+    event.sensor = handle;
+    event.type = type;
+    event.timestamp = timestamp;
+    event.data[0] = x;
+    event.data[1] = y;
+    event.data[2] = z;
+    return event;
+}
+
+/**
+ * Generates the events a device lying flat and turning around its vertical axis at 1 rad/s
+ * would report at the given rates, sorted by timestamp like the events of a HAL poll.
+ */
+static std::vector<sensors_event_t> generateTrace(int32_t gyroRateHz, int32_t accRateHz,
+                                                  int32_t magRateHz) {
+    std::vector<sensors_event_t> trace;
+    const nsecs_t gyroPeriod = s2ns(1) / gyroRateHz;
+    for (nsecs_t t = gyroPeriod; t <= TRACE_DURATION; t += gyroPeriod) {
+        trace.push_back(createEvent(GYROSCOPE_HANDLE, SENSOR_TYPE_GYROSCOPE, t, 0, 0, 1));
+    }
+    const nsecs_t accPeriod = s2ns(1) / accRateHz;
+    for (nsecs_t t = accPeriod; t <= TRACE_DURATION; t += accPeriod) {
+        trace.push_back(createEvent(ACCELEROMETER_HANDLE, SENSOR_TYPE_ACCELEROMETER, t, 0, 0,
+                                    GRAVITY_EARTH));
+    }
+    const nsecs_t magPeriod = s2ns(1) / magRateHz;
+    for (nsecs_t t = magPeriod; t <= TRACE_DURATION; t += magPeriod) {
+        const float angle = t / 1e9f;
+        trace.push_back(createEvent(MAGNETOMETER_HANDLE, SENSOR_TYPE_MAGNETIC_FIELD, t,
+                                    30 * cosf(angle), -30 * sinf(angle), -40));
+    }
+    std::sort(trace.begin(), trace.end(),
+              [](const sensors_event_t& lhs, const sensors_event_t& rhs) {
+                  return lhs.timestamp < rhs.timestamp;
+              });
+    return trace;
+}
+
+// --- TraceFusion ---
+
+/**
+ * Feeds events to a Fusion the way SensorFusion::process does, without the SensorDevice that
+ * SensorFusion needs to enable the sensors.
+ */
+class TraceFusion {
+public:
+    explicit TraceFusion(int mode) : mGyroTime(0), mAccTime(0) { mFusion.init(mode); }
+
+    void process(const sensors_event_t& event) {
+        switch (event.type) {
+            case SENSOR_TYPE_GYROSCOPE:
+                if (mGyroTime > 0) {
+                    mFusion.handleGyro(vec3_t(event.data), (event.timestamp - mGyroTime) / 1e9f);
+                }
+                mGyroTime = event.timestamp;
+                break;
+            case SENSOR_TYPE_MAGNETIC_FIELD:
+                mFusion.handleMag(vec3_t(event.data));
+                break;
+            case SENSOR_TYPE_ACCELEROMETER:
+                if (mAccTime > 0) {
+                    mFusion.handleAcc(vec3_t(event.data), (event.timestamp - mAccTime) / 1e9f);
+                }
+                mAccTime = event.timestamp;
+                break;
+        }
+    }
+
+    const Fusion& getFusion() const { return mFusion; }
+
+private:
+    Fusion mFusion;
+    nsecs_t mGyroTime;
+    nsecs_t mAccTime;
+};
+
+/**
+ * Benchmark the fusion of a second of sensor events, and the computation of the virtual sensor
+ * outputs for each accelerometer event, as the sensor thread does. The arguments are the fusion
+ * mode and the gyroscope rate.
+ */
+static void benchmarkFusion(benchmark::State& state) {
+    const int mode = state.range(0);
+    const std::vector<sensors_event_t> trace = generateTrace(state.range(1), 100, 50);
+
+    for (auto _ : state) {
+        TraceFusion fusion(mode);
+        for (const sensors_event_t& event : trace) {
+            fusion.process(event);
+            if (event.type == SENSOR_TYPE_ACCELEROMETER && fusion.getFusion().hasEstimate()) {
+                benchmark::DoNotOptimize(fusion.getFusion().getAttitude());
+                benchmark::DoNotOptimize(fusion.getFusion().getRotationMatrix());
+            }
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * trace.size());
+}
+
+BENCHMARK(benchmarkFusion)
+        ->Args({FUSION_9AXIS, 200})
+        ->Args({FUSION_9AXIS, 400})
+        ->Args({FUSION_NOMAG, 200})
+        ->Args({FUSION_NOGYRO, 200});
+
+/**
+ * Benchmark the logging of the recent events of each sensor, which the sensor thread does for
+ * every event it receives. The argument is the number of events per poll of the HAL, which is
+ * larger the more the sensors batch.
+ */
+static void benchmarkRecentEventLogging(benchmark::State& state) {
+    const size_t eventsPerPoll = state.range(0);
+    const std::vector<sensors_event_t> trace = generateTrace(400, 400, 100);
+    SensorServiceUtil::RecentEventLogger accLogger(SENSOR_TYPE_ACCELEROMETER);
+    SensorServiceUtil::RecentEventLogger gyroLogger(SENSOR_TYPE_GYROSCOPE);
+    SensorServiceUtil::RecentEventLogger magLogger(SENSOR_TYPE_MAGNETIC_FIELD);
+
+    SensorServiceUtil::RecentEventLogger::Reception reception = {};
+    for (auto _ : state) {
+        for (size_t i = 0; i < trace.size(); i++) {
+            if (i % eventsPerPoll == 0) {
+                reception.poll++;
+                reception.time = trace[std::min(i + eventsPerPoll, trace.size()) - 1].timestamp;
+                clock_gettime(CLOCK_REALTIME, &reception.wallTime);
+            }
+            switch (trace[i].sensor) {
+                case ACCELEROMETER_HANDLE:
+                    accLogger.addEvent(trace[i], reception);
+                    break;
+                case GYROSCOPE_HANDLE:
+                    gyroLogger.addEvent(trace[i], reception);
+                    break;
+                case MAGNETOMETER_HANDLE:
+                    magLogger.addEvent(trace[i], reception);
+                    break;
+            }
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * trace.size());
+}
+
+BENCHMARK(benchmarkRecentEventLogging)->Arg(1)->Arg(16)->Arg(128);
+
+} // namespace android
+
+BENCHMARK_MAIN();
@@ -111,15 +111,15 @@ hardware::Return<void> StatsHal::reportSpeechDspStat(
     return hardware::Void();
 }
 
-hardware::Return<void> StatsHal::reportVendorAtom(const VendorAtom& vendorAtom) {
-    std::string reverseDomainName = (std::string) vendorAtom.reverseDomainName;
+static void writeVendorAtom(const VendorAtom& vendorAtom) {
     if (vendorAtom.atomId < 100000 || vendorAtom.atomId >= 200000) {
         ALOGE("Atom ID %ld is not a valid vendor atom ID", (long) vendorAtom.atomId);
-        return hardware::Void();
+        return;
     }
-    if (reverseDomainName.length() > 50) {
-        ALOGE("Vendor atom reverse domain name %s is too long.", reverseDomainName.c_str());
-        return hardware::Void();
+    if (vendorAtom.reverseDomainName.size() > 50) {
+        ALOGE("Vendor atom reverse domain name %s is too long.",
+                vendorAtom.reverseDomainName.c_str());
+        return;
     }
     AStatsEvent* event = AStatsEvent_obtain();
     AStatsEvent_setAtomId(event, vendorAtom.atomId);
@@ -143,6 +143,19 @@ hardware::Return<void> StatsHal::reportVendorAtom(const VendorAtom& vendorAtom)
     AStatsEvent_build(event);
     AStatsEvent_write(event);
     AStatsEvent_release(event);
+}
+
+hardware::Return<void> StatsHal::reportVendorAtom(const VendorAtom& vendorAtom) {
+    writeVendorAtom(vendorAtom);
+
+    return hardware::Void();
+}
+
+hardware::Return<void> StatsHal::reportVendorAtoms(const hidl_vec<VendorAtom>& vendorAtoms) {
+    // statsd reads one atom per datagram, so each atom is still written on its own.
+    for (const VendorAtom& vendorAtom : vendorAtoms) {
+        writeVendorAtom(vendorAtom);
+    }
 
     return hardware::Void();
 }
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <stats/StatsHal.h>
+
+#include <vector>
+
+namespace android {
+
+using frameworks::stats::V1_0::VendorAtom;
+using frameworks::stats::V1_0::implementation::StatsHal;
+using hardware::hidl_vec;
+
+// An atom like the ones of a thermal daemon: a zone, a temperature and a timestamp.
+static VendorAtom createVendorAtom(int32_t zone) {
+    VendorAtom atom;
+    atom.reverseDomainName = "com.example.thermal";
+    atom.atomId = 100001;
+    atom.values.resize(3);
+    atom.values[0].intValue(zone);
+    atom.values[1].floatValue(42.5f);
+    atom.values[2].longValue(123456789);
+    return atom;
+}
+
+static hidl_vec<VendorAtom> createVendorAtoms(size_t count) {
+    std::vector<VendorAtom> atoms;
+    for (size_t i = 0; i < count; i++) {
+        atoms.push_back(createVendorAtom(static_cast<int32_t>(i)));
+    }
+    return atoms;
+}
+
+static void BM_reportVendorAtom(benchmark::State& state) {
+    sp<StatsHal> statsHal = new StatsHal();
+    const hidl_vec<VendorAtom> atoms = createVendorAtoms(state.range(0));
+    for (auto _ : state) {
+        for (const VendorAtom& atom : atoms) {
+            statsHal->reportVendorAtom(atom);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * atoms.size());
+}
+BENCHMARK(BM_reportVendorAtom)->Arg(1)->Arg(16)->Arg(256);
+
+static void BM_reportVendorAtoms(benchmark::State& state) {
+    sp<StatsHal> statsHal = new StatsHal();
+    const hidl_vec<VendorAtom> atoms = createVendorAtoms(state.range(0));
+    for (auto _ : state) {
+        statsHal->reportVendorAtoms(atoms);
+    }
+    state.SetItemsProcessed(state.iterations() * atoms.size());
+}
+BENCHMARK(BM_reportVendorAtoms)->Arg(1)->Arg(16)->Arg(256);
+
+} // namespace android
+
+BENCHMARK_MAIN();
@@ -27,6 +27,7 @@ namespace stats {
 namespace V1_0 {
 namespace implementation {
 
+using android::hardware::hidl_vec;
 using android::hardware::Return;
 
 /**
@@ -90,6 +91,12 @@ public:
      * Binder call to get vendor atom.
      */
     virtual Return<void> reportVendorAtom(const VendorAtom& vendorAtom) override;
+
+    /**
+     * Reports several vendor atoms at once, for daemons reporting atoms at a high rate. IStats
+     * 1.0 does not have this call, so it is only reachable in process for now.
+     */
+    Return<void> reportVendorAtoms(const hidl_vec<VendorAtom>& vendorAtoms);
 };
 
 }  // namespace implementation
@@ -311,9 +311,8 @@ void BufferLayer::preparePerFrameCompositionState() {
     }
 
     compositionState->buffer = mBufferInfo.mBuffer;
-    compositionState->bufferSlot = (mBufferInfo.mBufferSlot == BufferQueue::INVALID_BUFFER_SLOT)
-            ? 0
-            : mBufferInfo.mBufferSlot;
+    // Buffers without a slot are assigned one by the HWC buffer cache
+    compositionState->bufferSlot = mBufferInfo.mBufferSlot;
     compositionState->acquireFence = mBufferInfo.mFence;
 }
 
@@ -794,6 +793,13 @@ sp<GraphicBuffer> BufferLayer::getBuffer() const {
     return mBufferInfo.mBuffer;
 }
 
+void BufferLayer::getHeldBuffers(
+        std::unordered_map<uint64_t, sp<GraphicBuffer>>& outBuffers) const {
+    if (mBufferInfo.mBuffer != nullptr) {
+        outBuffers.emplace(mBufferInfo.mBuffer->getId(), mBufferInfo.mBuffer);
+    }
+}
+
 void BufferLayer::getDrawingTransformMatrix(bool filteringEnabled, float outMatrix[16]) {
     GLConsumer::computeTransformMatrix(outMatrix, mBufferInfo.mBuffer, mBufferInfo.mCrop,
                                        mBufferInfo.mTransform, filteringEnabled);
@@ -830,7 +836,7 @@ void BufferLayer::updateCloneBufferInfo() {
     wp<Layer> tmpZOrderRelativeOf = mDrawingState.zOrderRelativeOf;
     SortedVector<wp<Layer>> tmpZOrderRelatives = mDrawingState.zOrderRelatives;
     wp<Layer> tmpTouchableRegionCrop = mDrawingState.touchableRegionCrop;
-    InputWindowInfo tmpInputInfo = mDrawingState.inputInfo;
+    CopyOnWrite<InputWindowInfo> tmpInputInfo = mDrawingState.inputInfo;
 
     mDrawingState = clonedFrom->mDrawingState;
 
@@ -115,6 +115,7 @@ public:
     ui::Dataspace getDataSpace() const override;
 
     sp<GraphicBuffer> getBuffer() const override;
+    void getHeldBuffers(std::unordered_map<uint64_t, sp<GraphicBuffer>>& outBuffers) const override;
 
     ui::Transform::RotationFlags getTransformHint() const override { return mTransformHint; }
 
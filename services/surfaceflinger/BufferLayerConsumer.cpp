@@ -401,6 +401,16 @@ sp<GraphicBuffer> BufferLayerConsumer::getCurrentBuffer(int* outSlot, sp<Fence>*
     return mCurrentTextureBuffer == nullptr ? nullptr : mCurrentTextureBuffer->graphicBuffer();
 }
 
+void BufferLayerConsumer::getSlotBuffers(
+        std::unordered_map<uint64_t, sp<GraphicBuffer>>& outBuffers) const {
+    Mutex::Autolock lock(mMutex);
+    for (const auto& slot : mSlots) {
+        if (slot.mGraphicBuffer != nullptr) {
+            outBuffers.emplace(slot.mGraphicBuffer->getId(), slot.mGraphicBuffer);
+        }
+    }
+}
+
 Rect BufferLayerConsumer::getCurrentCrop() const {
     Mutex::Autolock lock(mMutex);
     return getCurrentCropLocked();
@@ -503,6 +513,16 @@ void BufferLayerConsumer::addAndGetFrameTimestamps(const NewFrameEventsEntry* ne
     mLayer->addAndGetFrameTimestamps(newTimestamps, outDelta);
 }
 
+status_t BufferLayerConsumer::getFrameTimestampsMemory(base::unique_fd* outFd) {
+    Mutex::Autolock lock(mMutex);
+
+    if (mAbandoned) {
+        return NO_INIT;
+    }
+
+    return mLayer->getFrameTimestampsMemory(outFd);
+}
+
 void BufferLayerConsumer::abandonLocked() {
     BLC_LOGV("abandonLocked");
     mCurrentTextureBuffer = nullptr;
@@ -31,6 +31,8 @@
 #include <utils/Vector.h>
 #include <utils/threads.h>
 
+#include <unordered_map>
+
 namespace android {
 // ----------------------------------------------------------------------------
 
@@ -159,6 +161,9 @@ public:
     // fence is returned.
     sp<GraphicBuffer> getCurrentBuffer(int* outSlot = nullptr, sp<Fence>* outFence = nullptr) const;
 
+    // getSlotBuffers adds the buffers allocated by the BufferQueue, keyed by buffer ID.
+    void getSlotBuffers(std::unordered_map<uint64_t, sp<GraphicBuffer>>& outBuffers) const;
+
     // getCurrentCrop returns the cropping rectangle of the current buffer.
     Rect getCurrentCrop() const;
 
@@ -247,6 +252,7 @@ private:
     void onSidebandStreamChanged() override;
     void addAndGetFrameTimestamps(const NewFrameEventsEntry* newTimestamps,
                                   FrameEventHistoryDelta* outDelta) override;
+    status_t getFrameTimestampsMemory(base::unique_fd* outFd) override;
 
     // computeCurrentTransformMatrixLocked computes the transform matrix for the
     // current texture.  It uses mCurrentTransform and the current GraphicBuffer
@@ -126,6 +126,12 @@ bool BufferQueueLayer::shouldPresentNow(nsecs_t expectedPresentTime) const {
     return isDue || !isPlausible;
 }
 
+void BufferQueueLayer::getHeldBuffers(
+        std::unordered_map<uint64_t, sp<GraphicBuffer>>& outBuffers) const {
+    BufferLayer::getHeldBuffers(outBuffers);
+    mConsumer->getSlotBuffers(outBuffers);
+}
+
 // -----------------------------------------------------------------------
 // Interface implementation for BufferLayer
 // -----------------------------------------------------------------------
@@ -54,6 +54,8 @@ public:
 
     bool shouldPresentNow(nsecs_t expectedPresentTime) const override;
 
+    void getHeldBuffers(std::unordered_map<uint64_t, sp<GraphicBuffer>>& outBuffers) const override;
+
     // -----------------------------------------------------------------------
 
     // -----------------------------------------------------------------------
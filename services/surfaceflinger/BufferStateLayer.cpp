@@ -204,6 +204,16 @@ bool BufferStateLayer::shouldPresentNow(nsecs_t /*expectedPresentTime*/) const {
     return hasFrameUpdate();
 }
 
+void BufferStateLayer::getHeldBuffers(
+        std::unordered_map<uint64_t, sp<GraphicBuffer>>& outBuffers) const {
+    BufferLayer::getHeldBuffers(outBuffers);
+    // The buffer applied last may not be latched yet
+    const sp<GraphicBuffer>& buffer = getDrawingState().buffer;
+    if (buffer != nullptr) {
+        outBuffers.emplace(buffer->getId(), buffer);
+    }
+}
+
 bool BufferStateLayer::willPresentCurrentTransaction() const {
     // Returns true if the most recent Transaction applied to CurrentState will be presented.
     return (getSidebandStreamChanged() || getAutoRefresh() ||
@@ -337,7 +347,7 @@ bool BufferStateLayer::setBuffer(const sp<GraphicBuffer>& buffer, const sp<Fence
 
     const int32_t layerId = getSequence();
     mFlinger->mTimeStats->setPostTime(layerId, mCurrentState.frameNumber, getName().c_str(),
-                                      postTime);
+                                      mCallingUid, postTime);
     desiredPresentTime = desiredPresentTime <= 0 ? 0 : desiredPresentTime;
     mCurrentState.desiredPresentTime = desiredPresentTime;
 
@@ -691,8 +701,8 @@ uint32_t BufferStateLayer::HwcSlotGenerator::getHwcCacheSlot(const client_cache_
     if (itr == mCachedBuffers.end()) {
         return addCachedBuffer(clientCacheId);
     }
-    auto& [hwcCacheSlot, counter] = itr->second;
-    counter = mCounter++;
+    auto& [hwcCacheSlot, lruPosition] = itr->second;
+    mLruBuffers.splice(mLruBuffers.begin(), mLruBuffers, lruPosition);
     return hwcCacheSlot;
 }
 
@@ -706,7 +716,8 @@ uint32_t BufferStateLayer::HwcSlotGenerator::addCachedBuffer(const client_cache_
     ClientCache::getInstance().registerErasedRecipient(clientCacheId, wp<ErasedRecipient>(this));
 
     uint32_t hwcCacheSlot = getFreeHwcCacheSlot();
-    mCachedBuffers[clientCacheId] = {hwcCacheSlot, mCounter++};
+    mLruBuffers.push_front(clientCacheId);
+    mCachedBuffers[clientCacheId] = {hwcCacheSlot, mLruBuffers.begin()};
     return hwcCacheSlot;
 }
 
@@ -721,18 +732,14 @@ uint32_t BufferStateLayer::HwcSlotGenerator::getFreeHwcCacheSlot() REQUIRES(mMut
 }
 
 void BufferStateLayer::HwcSlotGenerator::evictLeastRecentlyUsed() REQUIRES(mMutex) {
-    uint64_t minCounter = UINT_MAX;
-    client_cache_t minClientCacheId = {};
-    for (const auto& [clientCacheId, slotCounter] : mCachedBuffers) {
-        const auto& [hwcCacheSlot, counter] = slotCounter;
-        if (counter < minCounter) {
-            minCounter = counter;
-            minClientCacheId = clientCacheId;
-        }
+    if (mLruBuffers.empty()) {
+        return;
     }
-    eraseBufferLocked(minClientCacheId);
 
-    ClientCache::getInstance().unregisterErasedRecipient(minClientCacheId, this);
+    const client_cache_t lruClientCacheId = mLruBuffers.back();
+    eraseBufferLocked(lruClientCacheId);
+
+    ClientCache::getInstance().unregisterErasedRecipient(lruClientCacheId, this);
 }
 
 void BufferStateLayer::HwcSlotGenerator::eraseBufferLocked(const client_cache_t& clientCacheId)
@@ -741,12 +748,13 @@ void BufferStateLayer::HwcSlotGenerator::eraseBufferLocked(const client_cache_t&
     if (itr == mCachedBuffers.end()) {
         return;
     }
-    auto& [hwcCacheSlot, counter] = itr->second;
+    auto& [hwcCacheSlot, lruPosition] = itr->second;
 
     // TODO send to hwc cache and resources
 
     mFreeHwcCacheSlots.push(hwcCacheSlot);
-    mCachedBuffers.erase(clientCacheId);
+    mLruBuffers.erase(lruPosition);
+    mCachedBuffers.erase(itr);
 }
 
 void BufferStateLayer::gatherBufferInfo() {
@@ -24,6 +24,7 @@
 #include <system/window.h>
 #include <utils/String8.h>
 
+#include <list>
 #include <stack>
 
 namespace android {
@@ -49,6 +50,8 @@ public:
 
     bool shouldPresentNow(nsecs_t expectedPresentTime) const override;
 
+    void getHeldBuffers(std::unordered_map<uint64_t, sp<GraphicBuffer>>& outBuffers) const override;
+
     uint32_t doTransactionResize(uint32_t flags, Layer::State* /*stateToCommit*/) override {
         return flags;
     }
@@ -193,15 +196,15 @@ private:
 
         std::mutex mMutex;
 
+        // The cached buffers, from the most to the least recently used
+        using LruList = std::list<client_cache_t>;
+        LruList mLruBuffers GUARDED_BY(mMutex);
+
         std::unordered_map<client_cache_t,
-                           std::pair<uint32_t /*HwcCacheSlot*/, uint32_t /*counter*/>,
+                           std::pair<uint32_t /*HwcCacheSlot*/, LruList::iterator>,
                            CachedBufferHash>
                 mCachedBuffers GUARDED_BY(mMutex);
         std::stack<uint32_t /*HwcCacheSlot*/> mFreeHwcCacheSlots GUARDED_BY(mMutex);
-
-        // The cache increments this counter value when a slot is updated or used.
-        // Used to track the least recently-used buffer
-        uint64_t mCounter = 0;
     };
 
     sp<HwcSlotGenerator> mHwcSlotGenerator;
@@ -21,6 +21,8 @@
 
 #include <cinttypes>
 
+#include <android-base/stringprintf.h>
+
 #include "ClientCache.h"
 
 namespace android {
@@ -42,7 +44,7 @@ bool ClientCache::getBuffer(const client_cache_t& cacheId,
         return false;
     }
 
-    auto& processBuffers = it->second.second;
+    auto& processBuffers = it->second.buffers;
 
     auto bufItr = processBuffers.find(id);
     if (bufItr == processBuffers.end()) {
@@ -55,7 +57,29 @@ bool ClientCache::getBuffer(const client_cache_t& cacheId,
     return true;
 }
 
-bool ClientCache::add(const client_cache_t& cacheId, const sp<GraphicBuffer>& buffer) {
+void ClientCache::eraseBufferLocked(const wp<IBinder>& processToken,
+                                    ProcessBuffers& processBuffers, uint64_t id,
+                                    PendingErase& pendingErase) {
+    auto bufItr = processBuffers.buffers.find(id);
+    if (bufItr == processBuffers.buffers.end()) {
+        return;
+    }
+
+    ClientCacheBuffer& buf = bufItr->second;
+    for (auto& recipient : buf.recipients) {
+        sp<ErasedRecipient> erasedRecipient = recipient.promote();
+        if (erasedRecipient) {
+            pendingErase.emplace_back(erasedRecipient, client_cache_t{processToken, id});
+        }
+    }
+
+    processBuffers.bytes -= buf.size;
+    processBuffers.lru.erase(buf.lruPosition);
+    processBuffers.buffers.erase(bufItr);
+}
+
+bool ClientCache::add(const client_cache_t& cacheId, const sp<GraphicBuffer>& buffer,
+                      uid_t ownerUid) {
     auto& [processToken, id] = cacheId;
     if (processToken == nullptr) {
         ALOGE("failed to cache buffer: invalid process token");
@@ -67,46 +91,79 @@ bool ClientCache::add(const client_cache_t& cacheId, const sp<GraphicBuffer>& bu
         return false;
     }
 
-    std::lock_guard lock(mMutex);
-    sp<IBinder> token;
+    const size_t size = getClientCacheBufferSize(buffer);
+    if (size > BUFFER_CACHE_MAX_BYTES) {
+        ALOGE("failed to cache buffer: buffer is larger than the cache");
+        return false;
+    }
 
-    // If this is a new process token, set a death recipient. If the client process dies, we will
-    // get a callback through binderDied.
-    auto it = mBuffers.find(processToken);
-    if (it == mBuffers.end()) {
-        token = processToken.promote();
-        if (!token) {
-            ALOGE("failed to cache buffer: invalid token");
-            return false;
-        }
+    PendingErase pendingErase;
+    {
+        std::lock_guard lock(mMutex);
+        sp<IBinder> token;
+
+        // If this is a new process token, set a death recipient. If the client process dies, we
+        // will get a callback through binderDied.
+        auto it = mBuffers.find(processToken);
+        if (it == mBuffers.end()) {
+            token = processToken.promote();
+            if (!token) {
+                ALOGE("failed to cache buffer: invalid token");
+                return false;
+            }
 
-        status_t err = token->linkToDeath(mDeathRecipient);
-        if (err != NO_ERROR) {
-            ALOGE("failed to cache buffer: could not link to death");
-            return false;
+            status_t err = token->linkToDeath(mDeathRecipient);
+            if (err != NO_ERROR) {
+                ALOGE("failed to cache buffer: could not link to death");
+                return false;
+            }
+            auto [itr, success] = mBuffers.emplace(processToken, ProcessBuffers{token});
+            LOG_ALWAYS_FATAL_IF(!success, "failed to insert new process into client cache");
+            it = itr;
         }
-        auto [itr, success] =
-                mBuffers.emplace(processToken,
-                                 std::make_pair(token,
-                                                std::unordered_map<uint64_t, ClientCacheBuffer>()));
-        LOG_ALWAYS_FATAL_IF(!success, "failed to insert new process into client cache");
-        it = itr;
-    }
 
-    auto& processBuffers = it->second.second;
+        auto& processBuffers = it->second;
+        processBuffers.ownerUid = ownerUid;
 
-    if (processBuffers.size() > BUFFER_CACHE_MAX_SIZE) {
-        ALOGE("failed to cache buffer: cache is full");
-        return false;
+        // Replacing the buffer cached with the same id keeps its recipients
+        auto bufItr = processBuffers.buffers.find(id);
+        if (bufItr != processBuffers.buffers.end()) {
+            processBuffers.bytes -= bufItr->second.size;
+            processBuffers.lru.erase(bufItr->second.lruPosition);
+        }
+
+        // Rather than rejecting the buffer, make room for it by evicting the least recently
+        // used buffers, which the client most likely uncached already.
+        const size_t otherBuffers =
+                processBuffers.buffers.size() - (bufItr != processBuffers.buffers.end() ? 1 : 0);
+        size_t evictions = 0;
+        while (evictions < otherBuffers &&
+               (otherBuffers - evictions >= BUFFER_CACHE_MAX_SIZE ||
+                processBuffers.bytes + size > BUFFER_CACHE_MAX_BYTES)) {
+            ALOGV("evicting buffer %" PRIu64 " from the cache", processBuffers.lru.back());
+            eraseBufferLocked(processToken, processBuffers, processBuffers.lru.back(),
+                              pendingErase);
+            evictions++;
+        }
+        mEvictions += evictions;
+
+        processBuffers.lru.push_front(id);
+        auto& buf = processBuffers.buffers[id];
+        buf.buffer = buffer;
+        buf.size = size;
+        buf.lruPosition = processBuffers.lru.begin();
+        processBuffers.bytes += size;
     }
 
-    processBuffers[id].buffer = buffer;
+    for (auto& [recipient, erasedCacheId] : pendingErase) {
+        recipient->bufferErased(erasedCacheId);
+    }
     return true;
 }
 
 void ClientCache::erase(const client_cache_t& cacheId) {
     auto& [processToken, id] = cacheId;
-    std::vector<sp<ErasedRecipient>> pendingErase;
+    PendingErase pendingErase;
     {
         std::lock_guard lock(mMutex);
         ClientCacheBuffer* buf = nullptr;
@@ -115,18 +172,11 @@ void ClientCache::erase(const client_cache_t& cacheId) {
             return;
         }
 
-        for (auto& recipient : buf->recipients) {
-            sp<ErasedRecipient> erasedRecipient = recipient.promote();
-            if (erasedRecipient) {
-                pendingErase.push_back(erasedRecipient);
-            }
-        }
-
-        mBuffers[processToken].second.erase(id);
+        eraseBufferLocked(processToken, mBuffers[processToken], id, pendingErase);
     }
 
-    for (auto& recipient : pendingErase) {
-        recipient->bufferErased(cacheId);
+    for (auto& [recipient, erasedCacheId] : pendingErase) {
+        recipient->bufferErased(erasedCacheId);
     }
 }
 
@@ -136,9 +186,13 @@ sp<GraphicBuffer> ClientCache::get(const client_cache_t& cacheId) {
     ClientCacheBuffer* buf = nullptr;
     if (!getBuffer(cacheId, &buf)) {
         ALOGE("failed to get buffer, could not retrieve buffer");
+        mMisses++;
         return nullptr;
     }
 
+    auto& lru = mBuffers[cacheId.token].lru;
+    lru.splice(lru.begin(), lru, buf->lruPosition);
+    mHits++;
     return buf->buffer;
 }
 
@@ -169,7 +223,7 @@ void ClientCache::unregisterErasedRecipient(const client_cache_t& cacheId,
 }
 
 void ClientCache::removeProcess(const wp<IBinder>& processToken) {
-    std::vector<std::pair<sp<ErasedRecipient>, client_cache_t>> pendingErase;
+    PendingErase pendingErase;
     {
         if (processToken == nullptr) {
             ALOGE("failed to remove process, invalid (nullptr) process token");
@@ -182,7 +236,7 @@ void ClientCache::removeProcess(const wp<IBinder>& processToken) {
             return;
         }
 
-        for (auto& [id, clientCacheBuffer] : itr->second.second) {
+        for (auto& [id, clientCacheBuffer] : itr->second.buffers) {
             client_cache_t cacheId = {processToken, id};
             for (auto& recipient : clientCacheBuffer.recipients) {
                 sp<ErasedRecipient> erasedRecipient = recipient.promote();
@@ -199,6 +253,33 @@ void ClientCache::removeProcess(const wp<IBinder>& processToken) {
     }
 }
 
+void ClientCache::dump(std::string& result) {
+    std::lock_guard lock(mMutex);
+
+    base::StringAppendF(&result,
+                        "ClientCache: %zu processes, %" PRIu64 " hits, %" PRIu64
+                        " misses, %" PRIu64 " evictions\n",
+                        mBuffers.size(), mHits, mMisses, mEvictions);
+    for (const auto& [processToken, processBuffers] : mBuffers) {
+        base::StringAppendF(&result, "  process %p (uid %d): %zu buffers, %zu of %d KiB\n",
+                            processBuffers.token.get(), processBuffers.ownerUid,
+                            processBuffers.buffers.size(), processBuffers.bytes / 1024,
+                            BUFFER_CACHE_MAX_BYTES / 1024);
+    }
+}
+
+std::unordered_map<uint64_t, ClientCache::BufferUsage> ClientCache::getBufferUsage() {
+    std::lock_guard lock(mMutex);
+
+    std::unordered_map<uint64_t, BufferUsage> usage;
+    for (const auto& [processToken, processBuffers] : mBuffers) {
+        for (const auto& [id, buf] : processBuffers.buffers) {
+            usage.emplace(buf.buffer->getId(), BufferUsage{processBuffers.ownerUid, buf.size});
+        }
+    }
+    return usage;
+}
+
 void ClientCache::CacheDeathRecipient::binderDied(const wp<IBinder>& who) {
     ClientCache::getInstance().removeProcess(who);
 }
@@ -23,12 +23,19 @@
 #include <utils/RefBase.h>
 #include <utils/Singleton.h>
 
+#include <list>
 #include <map>
 #include <mutex>
 #include <set>
+#include <string>
 #include <unordered_map>
+#include <vector>
 
-#define BUFFER_CACHE_MAX_SIZE 64
+// The budget of the cache of each process. It is larger than the budget of the client side cache
+// in SurfaceComposerClient, so the least recently used buffers are only evicted here when the
+// uncache requests of the client lag behind.
+#define BUFFER_CACHE_MAX_SIZE 320
+#define BUFFER_CACHE_MAX_BYTES (320 * 1024 * 1024)
 
 namespace android {
 
@@ -36,7 +43,8 @@ class ClientCache : public Singleton<ClientCache> {
 public:
     ClientCache();
 
-    bool add(const client_cache_t& cacheId, const sp<GraphicBuffer>& buffer);
+    // ownerUid is the uid of the app the caching process works for, used to attribute memory
+    bool add(const client_cache_t& cacheId, const sp<GraphicBuffer>& buffer, uid_t ownerUid);
     void erase(const client_cache_t& cacheId);
 
     sp<GraphicBuffer> get(const client_cache_t& cacheId);
@@ -53,17 +61,43 @@ public:
     void unregisterErasedRecipient(const client_cache_t& cacheId,
                                    const wp<ErasedRecipient>& recipient);
 
+    void dump(std::string& result);
+
+    struct BufferUsage {
+        uid_t ownerUid;
+        size_t size;
+    };
+    // Returns the cached buffers, keyed by buffer ID
+    std::unordered_map<uint64_t, BufferUsage> getBufferUsage();
+
 private:
     std::mutex mMutex;
 
+    using LruList = std::list<uint64_t /*cache id*/>;
+
     struct ClientCacheBuffer {
         sp<GraphicBuffer> buffer;
         std::set<wp<ErasedRecipient>> recipients;
+        size_t size = 0;
+        LruList::iterator lruPosition;
     };
-    std::map<wp<IBinder> /*caching process*/,
-             std::pair<sp<IBinder> /*strong ref to caching process*/,
-                       std::unordered_map<uint64_t /*cache id*/, ClientCacheBuffer>>>
-            mBuffers GUARDED_BY(mMutex);
+
+    struct ProcessBuffers {
+        sp<IBinder> token; // strong ref to caching process
+        std::unordered_map<uint64_t /*cache id*/, ClientCacheBuffer> buffers;
+        // The cache ids, from the most to the least recently used
+        LruList lru;
+        size_t bytes = 0;
+        // The owner uid of the layer the process last cached a buffer for
+        uid_t ownerUid = 0;
+    };
+    std::map<wp<IBinder> /*caching process*/, ProcessBuffers> mBuffers GUARDED_BY(mMutex);
+
+    using PendingErase = std::vector<std::pair<sp<ErasedRecipient>, client_cache_t>>;
+
+    uint64_t mHits GUARDED_BY(mMutex) = 0;
+    uint64_t mMisses GUARDED_BY(mMutex) = 0;
+    uint64_t mEvictions GUARDED_BY(mMutex) = 0;
 
     class CacheDeathRecipient : public IBinder::DeathRecipient {
     public:
@@ -74,6 +108,9 @@ private:
 
     bool getBuffer(const client_cache_t& cacheId, ClientCacheBuffer** outClientCacheBuffer)
             REQUIRES(mMutex);
+    // Removes a buffer, collecting the recipients to notify once the lock is released
+    void eraseBufferLocked(const wp<IBinder>& processToken, ProcessBuffers& processBuffers,
+                           uint64_t id, PendingErase& pendingErase) REQUIRES(mMutex);
 };
 
 }; // namespace android
@@ -0,0 +1,271 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <compositionengine/CompositionRefreshArgs.h>
+#include <compositionengine/DisplayColorProfileCreationArgs.h>
+#include <compositionengine/DisplayCreationArgs.h>
+#include <compositionengine/LayerFECompositionState.h>
+#include <compositionengine/impl/Display.h>
+#include <compositionengine/mock/CompositionEngine.h>
+#include <compositionengine/mock/LayerFE.h>
+#include <compositionengine/mock/RenderSurface.h>
+#include <renderengine/mock/RenderEngine.h>
+#include <ui/Fence.h>
+#include <ui/GraphicBuffer.h>
+
+#include <deque>
+
+#include "MockHWC2.h"
+#include "MockHWComposer.h"
+#include "MockPowerAdvisor.h"
+
+namespace android::compositionengine {
+namespace {
+
+namespace hal = android::hardware::graphics::composer::hal;
+
+using testing::_;
+using testing::Invoke;
+using testing::NiceMock;
+using testing::Return;
+using testing::ReturnRef;
+
+constexpr DisplayId kDisplayId = DisplayId{42};
+constexpr uint32_t kLayerStack = 1u;
+const ui::Size kDisplaySize{1080, 2340};
+const Rect kDisplayBounds{kDisplaySize};
+const ui::Size kLayerSize{360, 640};
+
+// The effects applied to every fourth layer, which SurfaceFlinger composites
+// with the GPU.
+enum Effects : int64_t {
+    kNoEffects = 0,
+    kRoundedCornersAndShadows = 1,
+    kRoundedCornersShadowsAndBlur = 2,
+};
+
+struct Layer {
+    Layer(const Rect& bounds, bool roundedCornersAndShadows, bool blur) {
+        ON_CALL(*layerFE, getCompositionState()).WillByDefault(Return(&layerFEState));
+        ON_CALL(*layerFE, getDebugName()).WillByDefault(Return("layer"));
+        ON_CALL(*layerFE, prepareClientCompositionList(_))
+                .WillByDefault(Invoke(this, &Layer::prepareClientCompositionList));
+
+        layerFEState.layerStackId = kLayerStack;
+        layerFEState.isVisible = true;
+        layerFEState.isOpaque = false;
+        layerFEState.alpha = 1.f;
+        layerFEState.compositionType = hal::Composition::DEVICE;
+        layerFEState.blendMode = hal::BlendMode::PREMULTIPLIED;
+        layerFEState.buffer = new GraphicBuffer();
+        layerFEState.bufferSlot = 0;
+        layerFEState.geomBufferSize = Rect{bounds.getWidth(), bounds.getHeight()};
+        layerFEState.geomContentCrop = layerFEState.geomBufferSize;
+        layerFEState.geomLayerBounds = FloatRect{0, 0, static_cast<float>(bounds.getWidth()),
+                                                 static_cast<float>(bounds.getHeight())};
+        layerFEState.geomLayerTransform = ui::Transform(ui::Transform::ROT_0, bounds.left,
+                                                        bounds.top);
+
+        // Like the front-end, request client composition for the layers
+        // HWC cannot draw
+        if (roundedCornersAndShadows) {
+            cornerRadius = 32.f;
+            layerFEState.shadowRadius = 24.f;
+            layerFEState.forceClientComposition = true;
+        }
+        if (blur) {
+            layerFEState.backgroundBlurRadius = 50;
+        }
+    }
+
+    std::vector<LayerFE::LayerSettings> prepareClientCompositionList(
+            LayerFE::ClientCompositionTargetSettings& targetSettings) {
+        LayerFE::LayerSettings layerSettings;
+        layerSettings.geometry.boundaries =
+                layerFEState.geomLayerTransform.transform(layerFEState.geomLayerBounds);
+        layerSettings.geometry.roundedCornersRadius = cornerRadius;
+        layerSettings.source.solidColor = half3(0.5f, 0.5f, 0.5f);
+        layerSettings.alpha = half(layerFEState.alpha);
+        layerSettings.backgroundBlurRadius = layerFEState.backgroundBlurRadius;
+        layerSettings.disableBlending = targetSettings.clearContent;
+
+        std::vector<LayerFE::LayerSettings> results;
+        if (layerFEState.shadowRadius > 0.f) {
+            LayerFE::LayerSettings shadowSettings = layerSettings;
+            shadowSettings.source.solidColor = half3();
+            shadowSettings.shadow.length = layerFEState.shadowRadius;
+            shadowSettings.shadow.lightRadius = layerFEState.shadowRadius;
+            shadowSettings.shadow.casterIsTranslucent = !layerFEState.isOpaque;
+            results.push_back(shadowSettings);
+        }
+        results.push_back(layerSettings);
+        return results;
+    }
+
+    sp<NiceMock<mock::LayerFE>> layerFE = new NiceMock<mock::LayerFE>();
+    LayerFECompositionState layerFEState;
+    float cornerRadius = 0.f;
+};
+
+// Exposes the steps of Output::present() which are measured on their own.
+class BenchmarkDisplay : public impl::Display {
+public:
+    using impl::Display::generateClientCompositionRequests;
+};
+
+// A physical display composited by a fake HWC, which accepts whatever it is
+// given, and a null RenderEngine, so only the CPU cost of CompositionEngine
+// is measured. The layer stack is built from the benchmark arguments:
+//  - range(0) layers, over an opaque wallpaper
+//  - range(1) percent overlap of each layer with the previous one
+//  - range(2) Effects on every fourth layer
+class DisplayBenchmark {
+public:
+    explicit DisplayBenchmark(const benchmark::State& state) {
+        ON_CALL(mCompositionEngine, getHwComposer()).WillByDefault(ReturnRef(mHwComposer));
+        ON_CALL(mCompositionEngine, getRenderEngine()).WillByDefault(ReturnRef(mRenderEngine));
+        ON_CALL(mHwComposer, createLayer(_)).WillByDefault(Invoke([](DisplayId) {
+            return new NiceMock<HWC2::mock::Layer>();
+        }));
+        ON_CALL(mHwComposer, destroyLayer(_, _))
+                .WillByDefault(Invoke([](DisplayId, HWC2::Layer* layer) { delete layer; }));
+        ON_CALL(mHwComposer, getPresentFence(_)).WillByDefault(Return(Fence::NO_FENCE));
+        ON_CALL(mHwComposer, getLayerReleaseFence(_, _)).WillByDefault(Return(Fence::NO_FENCE));
+        ON_CALL(*mRenderSurface, getSize()).WillByDefault(ReturnRef(kDisplaySize));
+        ON_CALL(*mRenderSurface, getClientTargetAcquireFence())
+                .WillByDefault(ReturnRef(Fence::NO_FENCE));
+        ON_CALL(*mRenderSurface, dequeueBuffer(_)).WillByDefault(Return(mClientTarget));
+
+        mDisplay = impl::createDisplayTemplated<
+                BenchmarkDisplay>(mCompositionEngine,
+                                  DisplayCreationArgsBuilder()
+                                          .setPhysical({kDisplayId,
+                                                        DisplayConnectionType::Internal})
+                                          .setPixels(kDisplaySize)
+                                          .setPixelFormat(static_cast<ui::PixelFormat>(
+                                                  PIXEL_FORMAT_RGBA_8888))
+                                          .setLayerStackId(kLayerStack)
+                                          .setPowerAdvisor(&mPowerAdvisor)
+                                          .setName("benchmark")
+                                          .build());
+        mDisplay->createDisplayColorProfile(DisplayColorProfileCreationArgs{false, {}, 0, {}});
+        mDisplay->setRenderSurfaceForTest(
+                std::unique_ptr<compositionengine::RenderSurface>(mRenderSurface));
+        mDisplay->setBounds(kDisplaySize);
+        mDisplay->setProjection(ui::Transform(), 0, kDisplayBounds, kDisplayBounds,
+                                kDisplayBounds, kDisplayBounds, false);
+        mDisplay->setCompositionEnabled(true);
+
+        const auto layerCount = static_cast<size_t>(state.range(0));
+        const auto overlap = static_cast<int32_t>(state.range(1));
+        const auto effects = static_cast<Effects>(state.range(2));
+
+        mLayers.emplace_back(kDisplayBounds, false, false).layerFEState.isOpaque = true;
+        mRefreshArgs.layers.push_back(mLayers.back().layerFE);
+
+        // Lay the layers out in rows, wrapping around the display
+        const int32_t stepX = kLayerSize.width * (100 - overlap) / 100 + 1;
+        const int32_t stepY = kLayerSize.height * (100 - overlap) / 100 + 1;
+        const int32_t columns = std::max((kDisplaySize.width - kLayerSize.width) / stepX + 1, 1);
+        const int32_t rows = std::max((kDisplaySize.height - kLayerSize.height) / stepY + 1, 1);
+        for (size_t i = 1; i < layerCount; i++) {
+            const auto index = static_cast<int32_t>(i - 1);
+            const int32_t left = (index % columns) * stepX;
+            const int32_t top = (index / columns % rows) * stepY;
+            const bool hasEffects = effects != kNoEffects && i % 4 == 0;
+            // Only the topmost layer with effects blurs what is behind it
+            const bool blur = effects == kRoundedCornersShadowsAndBlur && hasEffects &&
+                    i + 4 >= layerCount;
+            mLayers.emplace_back(Rect(left, top, left + kLayerSize.width,
+                                      top + kLayerSize.height),
+                                 hasEffects, blur);
+            mRefreshArgs.layers.push_back(mLayers.back().layerFE);
+        }
+
+        mRefreshArgs.outputs.push_back(mDisplay);
+        mRefreshArgs.updatingOutputGeometryThisFrame = true;
+        mRefreshArgs.updatingGeometryThisFrame = true;
+    }
+
+    void prepare() {
+        LayerFESet geomSnapshots;
+        mDisplay->prepare(mRefreshArgs, geomSnapshots);
+    }
+
+    NiceMock<android::mock::HWComposer> mHwComposer;
+    NiceMock<Hwc2::mock::PowerAdvisor> mPowerAdvisor;
+    NiceMock<renderengine::mock::RenderEngine> mRenderEngine;
+    NiceMock<mock::CompositionEngine> mCompositionEngine;
+    NiceMock<mock::RenderSurface>* mRenderSurface = new NiceMock<mock::RenderSurface>();
+    sp<GraphicBuffer> mClientTarget = new GraphicBuffer();
+    std::shared_ptr<BenchmarkDisplay> mDisplay;
+    std::deque<Layer> mLayers;
+    CompositionRefreshArgs mRefreshArgs;
+};
+
+void layerArgs(benchmark::internal::Benchmark* b) {
+    for (int64_t layerCount : {10, 50, 100, 200}) {
+        for (int64_t overlap : {0, 75}) {
+            for (int64_t effects :
+                 {kNoEffects, kRoundedCornersAndShadows, kRoundedCornersShadowsAndBlur}) {
+                b->Args({layerCount, overlap, effects});
+            }
+        }
+    }
+}
+
+void BM_DisplayPrepare(benchmark::State& state) {
+    DisplayBenchmark display(state);
+    for (auto _ : state) {
+        display.prepare();
+    }
+}
+BENCHMARK(BM_DisplayPrepare)->Apply(layerArgs);
+
+void BM_DisplayUpdateAndWriteCompositionState(benchmark::State& state) {
+    DisplayBenchmark display(state);
+    display.prepare();
+    for (auto _ : state) {
+        display.mDisplay->updateAndWriteCompositionState(display.mRefreshArgs);
+    }
+}
+BENCHMARK(BM_DisplayUpdateAndWriteCompositionState)->Apply(layerArgs);
+
+void BM_DisplayGenerateClientCompositionRequests(benchmark::State& state) {
+    DisplayBenchmark display(state);
+    display.prepare();
+    display.mDisplay->present(display.mRefreshArgs);
+    for (auto _ : state) {
+        Region clearRegion;
+        benchmark::DoNotOptimize(
+                display.mDisplay->generateClientCompositionRequests(false, clearRegion,
+                                                                    ui::Dataspace::UNKNOWN));
+    }
+}
+BENCHMARK(BM_DisplayGenerateClientCompositionRequests)->Apply(layerArgs);
+
+void BM_DisplayPresent(benchmark::State& state) {
+    DisplayBenchmark display(state);
+    display.prepare();
+    for (auto _ : state) {
+        display.mDisplay->present(display.mRefreshArgs);
+    }
+}
+BENCHMARK(BM_DisplayPresent)->Apply(layerArgs);
+
+} // namespace
+} // namespace android::compositionengine
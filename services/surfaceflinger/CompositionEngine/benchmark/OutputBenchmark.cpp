@@ -0,0 +1,115 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <compositionengine/CompositionRefreshArgs.h>
+#include <compositionengine/LayerFECompositionState.h>
+#include <compositionengine/impl/Output.h>
+#include <compositionengine/mock/CompositionEngine.h>
+#include <compositionengine/mock/LayerFE.h>
+
+#include <deque>
+
+namespace android::compositionengine {
+namespace {
+
+using testing::NiceMock;
+using testing::Return;
+
+constexpr uint32_t kLayerStack = 1u;
+const Rect kDisplayBounds{1080, 2340};
+
+struct Layer {
+    explicit Layer(const Rect& bounds) {
+        ON_CALL(*layerFE, getCompositionState()).WillByDefault(Return(&layerFEState));
+        ON_CALL(*layerFE, getDebugName()).WillByDefault(Return("layer"));
+
+        layerFEState.layerStackId = kLayerStack;
+        layerFEState.isVisible = true;
+        layerFEState.isOpaque = false;
+        moveTo(bounds);
+    }
+
+    void moveTo(const Rect& bounds) {
+        layerFEState.geomLayerBounds = FloatRect{0, 0, static_cast<float>(bounds.getWidth()),
+                                                 static_cast<float>(bounds.getHeight())};
+        layerFEState.geomLayerTransform = ui::Transform(ui::Transform::ROT_0, bounds.left,
+                                                        bounds.top);
+    }
+
+    sp<NiceMock<mock::LayerFE>> layerFE = new NiceMock<mock::LayerFE>();
+    LayerFECompositionState layerFEState;
+};
+
+// Rebuilds the layer stack of an output with range(0) translucent layers,
+// stacked like app windows, over an opaque wallpaper. Every frame, the layer
+// at range(1) layers from the top (e.g. a small PiP window) moves.
+void rebuildLayerStacks(benchmark::State& state, bool incremental) {
+    NiceMock<mock::CompositionEngine> compositionEngine;
+    auto output = impl::createOutput(compositionEngine);
+    output->setLayerStackFilter(kLayerStack, false);
+    output->setIncrementalVisibilityEnabled(incremental);
+    output->editState().isEnabled = true;
+    output->editState().bounds = kDisplayBounds;
+    output->editState().viewport = kDisplayBounds;
+
+    const auto layerCount = static_cast<size_t>(state.range(0));
+    const auto movingIndex = layerCount - 1 - static_cast<size_t>(state.range(1));
+
+    std::deque<Layer> layers;
+    CompositionRefreshArgs refreshArgs;
+    refreshArgs.updatingOutputGeometryThisFrame = true;
+    layers.emplace_back(kDisplayBounds).layerFEState.isOpaque = true;
+    refreshArgs.layers.push_back(layers.back().layerFE);
+    for (size_t i = 1; i < layerCount; i++) {
+        const int32_t offset = static_cast<int32_t>(i % 32) * 16;
+        layers.emplace_back(Rect(offset, offset, offset + 540, offset + 1170));
+        refreshArgs.layers.push_back(layers.back().layerFE);
+    }
+
+    int32_t frame = 0;
+    for (auto _ : state) {
+        const int32_t offset = (frame++ % 64) * 4;
+        layers[movingIndex].moveTo(Rect(offset, offset, offset + 270, offset + 480));
+
+        LayerFESet geomSnapshots;
+        output->rebuildLayerStacks(refreshArgs, geomSnapshots);
+        output->editState().dirtyRegion.clear();
+    }
+}
+
+void layerArgs(benchmark::internal::Benchmark* b) {
+    for (int64_t layerCount : {10, 60, 100}) {
+        for (int64_t movingFromTop : {0, 5}) {
+            b->Args({layerCount, movingFromTop});
+        }
+    }
+}
+
+void BM_rebuildLayerStacks(benchmark::State& state) {
+    rebuildLayerStacks(state, false);
+}
+BENCHMARK(BM_rebuildLayerStacks)->Apply(layerArgs);
+
+void BM_rebuildLayerStacksIncremental(benchmark::State& state) {
+    rebuildLayerStacks(state, true);
+}
+BENCHMARK(BM_rebuildLayerStacksIncremental)->Apply(layerArgs);
+
+} // namespace
+} // namespace android::compositionengine
+
+BENCHMARK_MAIN();
@@ -60,6 +60,11 @@ public:
     virtual TimeStats& getTimeStats() const = 0;
     virtual void setTimeStats(const std::shared_ptr<TimeStats>&) = 0;
 
+    // Sets how many worker threads, in addition to the calling thread, update
+    // the composition state of outputs concurrently during present(). With 0
+    // (the default), outputs are composed one after the other.
+    virtual void setOutputWorkerCount(size_t) = 0;
+
     virtual bool needsAnotherUpdate() const = 0;
     virtual nsecs_t getLastFrameRefreshTimestamp() const = 0;
 
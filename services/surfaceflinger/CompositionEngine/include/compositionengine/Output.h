@@ -147,6 +147,18 @@ public:
         Region aboveOpaqueLayers;
         // The region of the output which should be considered dirty
         Region dirtyRegion;
+
+        // What ensureOutputLayerIfVisible found for the layer it processed
+        // last, so that the result can be reused on later frames.
+        struct LayerResult {
+            // If the layer contributed to dirtyRegion, with these regions
+            bool reachedDirty{false};
+            Region visibleRegion;
+            Region coveredRegion;
+            // If the layer got an output layer
+            bool hasOutputLayer{false};
+        };
+        LayerResult lastLayer;
     };
 
     virtual ~Output();
@@ -176,6 +188,16 @@ public:
     // Sets the output color mode
     virtual void setColorProfile(const ColorProfile&) = 0;
 
+    // If enabled, the visibility and coverage of layers whose geometry and
+    // coverage from the layers above did not change since the last geometry
+    // update are reused instead of recomputed.
+    virtual void setIncrementalVisibilityEnabled(bool) = 0;
+
+    // If enabled, the bottom-most client composition layers which stopped
+    // changing are rendered once into a cached buffer, which is then drawn
+    // in their place.
+    virtual void setLayerGroupCachingEnabled(bool) = 0;
+
     // Outputs a string with a state dump
     virtual void dump(std::string&) const = 0;
 
@@ -248,6 +270,13 @@ public:
     // Presents the output, finalizing all composition details
     virtual void present(const CompositionRefreshArgs&) = 0;
 
+    // Picks the color profile and updates the composition state of each
+    // output layer, which present() otherwise does itself. This does not use
+    // RenderEngine and calls into the HWC only for this output's display, so
+    // it may run concurrently with the same call for other outputs. present()
+    // must follow on the composition thread.
+    virtual void updateCompositionState(const CompositionRefreshArgs&) = 0;
+
     // Latches the front-end layer state for each output layer
     virtual void updateLayerStateFromFE(const CompositionRefreshArgs&) const = 0;
 
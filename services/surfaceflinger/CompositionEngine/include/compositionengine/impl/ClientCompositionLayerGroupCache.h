@@ -0,0 +1,100 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <compositionengine/LayerFE.h>
+#include <renderengine/DisplaySettings.h>
+#include <renderengine/LayerSettings.h>
+#include <ui/Fence.h>
+#include <ui/GraphicBuffer.h>
+#include <ui/PixelFormat.h>
+#include <ui/Size.h>
+
+namespace android {
+
+namespace renderengine {
+class RenderEngine;
+} // namespace renderengine
+
+namespace compositionengine::impl {
+
+// The cache renders the bottom-most client composition layers into a buffer of its own once they
+// stopped changing, and then draws that buffer in their place. When a single layer animates over
+// otherwise static content (e.g. over the wallpaper and widgets), only that layer and the cached
+// buffer are drawn each frame instead of every layer.
+//
+// RenderEngine blends layers with premultiplied alpha, so drawing a group of layers into a
+// transparent buffer and then drawing that buffer is the same as drawing the layers directly.
+// This does not hold for layers which disable blending or blur what is behind them, so such a
+// layer ends the group. Outputs with a rotation or a global color transform, or which do not
+// cover the whole target buffer, are not cached, as the cached buffer could not be drawn back
+// without transforming it again.
+class ClientCompositionLayerGroupCache {
+public:
+    // The number of frames a layer must not change for before it is cached
+    static constexpr uint32_t kMinUnchangedFrames = 2;
+    // Caching fewer layers than this does not save any drawing
+    static constexpr size_t kMinCachedLayers = 2;
+
+    explicit ClientCompositionLayerGroupCache(renderengine::RenderEngine&);
+    ~ClientCompositionLayerGroupCache();
+
+    ClientCompositionLayerGroupCache(const ClientCompositionLayerGroupCache&) = delete;
+    ClientCompositionLayerGroupCache& operator=(const ClientCompositionLayerGroupCache&) = delete;
+
+    // Replaces the layers at the bottom of 'layers' which did not change with a single layer
+    // drawing them from the cache, rendering them into it first if needed. The layers are left
+    // as they are if there is nothing to cache. 'targetSize' and 'targetFormat' describe the
+    // buffer the layers are drawn into.
+    void apply(const renderengine::DisplaySettings&, ui::Size targetSize, PixelFormat targetFormat,
+               std::vector<LayerFE::LayerSettings>& layers);
+
+    // Drops the cached layers, keeping the buffer for reuse
+    void clear();
+
+    // Returns the number of layers drawn from the cache
+    size_t getCachedLayerCount() const { return mCachedLayers.size(); }
+
+private:
+    bool canCache(const renderengine::DisplaySettings&, ui::Size targetSize) const;
+    static bool canCache(const LayerFE::LayerSettings&);
+    bool render(const renderengine::DisplaySettings&, ui::Size targetSize,
+                PixelFormat targetFormat, const std::vector<LayerFE::LayerSettings>& layers,
+                size_t count);
+    void releaseBuffer();
+
+    renderengine::RenderEngine& mRenderEngine;
+
+    // Snapshots of the layers of the previous frame, and for how many frames each of them and
+    // all the layers below it did not change
+    std::vector<LayerFE::LayerSettings> mPreviousLayers;
+    std::vector<uint32_t> mUnchangedFrames;
+
+    // Snapshots of the layers rendered into mBuffer
+    std::vector<LayerFE::LayerSettings> mCachedLayers;
+    sp<GraphicBuffer> mBuffer;
+    sp<Fence> mReadyFence;
+    uint32_t mTextureName = 0;
+    // The frame number of the layer drawing mBuffer, incremented whenever mBuffer is rendered
+    uint64_t mGeneration = 0;
+};
+
+} // namespace compositionengine::impl
+} // namespace android
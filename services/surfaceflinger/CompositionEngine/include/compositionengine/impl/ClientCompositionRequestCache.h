@@ -27,6 +27,14 @@ namespace android {
 
 namespace compositionengine::impl {
 
+// Returns a copy of the settings without the strong references to the client buffer and its
+// fence, so that keeping it does not extend their lifetime.
+LayerFE::LayerSettings getLayerSettingsSnapshot(const LayerFE::LayerSettings&);
+
+// Returns true if both settings render the same, comparing client buffers by their id and frame
+// number. One of the settings may be a snapshot.
+bool layerSettingsAreEqual(const LayerFE::LayerSettings&, const LayerFE::LayerSettings&);
+
 // The cache is used to skip duplicate client composition requests. We do so by keeping track
 // of every composition request and the buffer that the request is rendered into. During the
 // next composition request, if the request matches what was rendered into the buffer, then
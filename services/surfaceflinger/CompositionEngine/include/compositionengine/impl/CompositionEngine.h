@@ -17,6 +17,7 @@
 #pragma once
 
 #include <compositionengine/CompositionEngine.h>
+#include <compositionengine/impl/WorkerPool.h>
 
 namespace android::compositionengine::impl {
 
@@ -39,6 +40,8 @@ public:
     TimeStats& getTimeStats() const override;
     void setTimeStats(const std::shared_ptr<TimeStats>&) override;
 
+    void setOutputWorkerCount(size_t) override;
+
     bool needsAnotherUpdate() const override;
     nsecs_t getLastFrameRefreshTimestamp() const override;
 
@@ -60,6 +63,7 @@ private:
     std::unique_ptr<HWComposer> mHwComposer;
     std::unique_ptr<renderengine::RenderEngine> mRenderEngine;
     std::shared_ptr<TimeStats> mTimeStats;
+    std::unique_ptr<WorkerPool> mWorkerPool;
     bool mNeedsAnotherUpdate = false;
     nsecs_t mRefreshStartTime = 0;
 };
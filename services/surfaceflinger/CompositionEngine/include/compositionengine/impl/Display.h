@@ -77,6 +77,8 @@ public:
     virtual void applyDisplayRequests(const DisplayRequests&);
     virtual void applyLayerRequestsToLayers(const LayerRequests&);
     virtual void applyClientTargetRequests(const ClientTargetProperty&);
+    // Hashes the state HWC bases its composition decision on
+    virtual size_t getCompositionStrategyHash() const;
 
     // Internal
     virtual void setConfiguration(const compositionengine::DisplayCreationArgs&);
@@ -91,6 +93,11 @@ private:
     bool mIsVirtual = false;
     std::optional<DisplayId> mId;
     Hwc2::PowerAdvisor* mPowerAdvisor = nullptr;
+
+    // The composition strategy chosen for the previous frame, which is expected again as long
+    // as the state it was chosen from does not change.
+    std::optional<size_t> mPreviousCompositionStrategyHash;
+    bool mPreviousFrameUsedClientComposition = false;
 };
 
 // This template factory function standardizes the implementation details of the
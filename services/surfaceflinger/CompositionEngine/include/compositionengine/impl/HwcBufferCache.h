@@ -17,7 +17,8 @@
 #pragma once
 
 #include <cstdint>
-#include <vector>
+#include <list>
+#include <unordered_map>
 
 // TODO(b/129481165): remove the #pragma below and fix conversion issues
 #pragma clang diagnostic push
@@ -45,9 +46,18 @@ namespace compositionengine::impl {
 //
 // To be able to find out whether a buffer is already in the HAL's cache, we
 // use HWComposerBufferCache to mirror the cache in SF.
+//
+// Buffers which come with their BufferQueue slot are cached in that slot.
+// Other buffers, e.g. those a BLAST producer did not cache, are assigned a
+// slot by their ID, so a buffer seen before is found in the slot it was sent
+// in. Once as many buffers as the capacity have been seen, the least recently
+// used one is evicted.
 class HwcBufferCache {
 public:
-    HwcBufferCache();
+    // The capacity bounds the slots assigned by buffer ID. It cannot exceed
+    // the slot count the HWC layer or client target was created with.
+    explicit HwcBufferCache(uint32_t capacity = BufferQueue::NUM_BUFFER_SLOTS);
+
     // Given a buffer, return the HWC cache slot and
     // buffer to be sent to HWC.
     //
@@ -57,10 +67,26 @@ public:
                       sp<GraphicBuffer>* outBuffer);
 
 private:
-    // an array where the index corresponds to a slot and the value corresponds to a (counter,
-    // buffer) pair. "counter" is a unique value that indicates the last time this slot was updated
-    // or used and allows us to keep track of the least-recently used buffer.
-    wp<GraphicBuffer> mBuffers[BufferQueue::NUM_BUFFER_SLOTS];
+    using LruList = std::list<uint32_t>;
+
+    struct Slot {
+        // The buffer last sent in the slot
+        wp<GraphicBuffer> buffer;
+        uint64_t bufferId{0};
+
+        // The position of the slot in mLruSlots, if assigned by buffer ID
+        bool assignedById{false};
+        LruList::iterator lruPosition;
+    };
+
+    uint32_t getSlotForBufferId(uint64_t bufferId);
+
+    const uint32_t mCapacity;
+    Slot mSlots[BufferQueue::NUM_BUFFER_SLOTS];
+    std::unordered_map<uint64_t /* bufferId */, uint32_t /* slot */> mSlotsByBufferId;
+
+    // The slots assigned by buffer ID, from the most to the least recently used
+    LruList mLruSlots;
 };
 
 } // namespace compositionengine::impl
@@ -18,11 +18,15 @@
 
 #include <compositionengine/CompositionEngine.h>
 #include <compositionengine/Output.h>
+#include <compositionengine/OutputColorSetting.h>
+#include <compositionengine/impl/ClientCompositionLayerGroupCache.h>
 #include <compositionengine/impl/ClientCompositionRequestCache.h>
 #include <compositionengine/impl/OutputCompositionState.h>
 #include <renderengine/DisplaySettings.h>
 #include <renderengine/LayerSettings.h>
 #include <memory>
+#include <optional>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -46,6 +50,8 @@ public:
 
     void setColorTransform(const compositionengine::CompositionRefreshArgs&) override;
     void setColorProfile(const ColorProfile&) override;
+    void setIncrementalVisibilityEnabled(bool) override;
+    void setLayerGroupCachingEnabled(bool) override;
 
     void dump(std::string&) const override;
 
@@ -68,6 +74,7 @@ public:
 
     void prepare(const CompositionRefreshArgs&, LayerFESet&) override;
     void present(const CompositionRefreshArgs&) override;
+    void updateCompositionState(const CompositionRefreshArgs&) override;
 
     void rebuildLayerStacks(const CompositionRefreshArgs&, LayerFESet&) override;
     void collectVisibleLayers(const CompositionRefreshArgs&,
@@ -116,11 +123,77 @@ protected:
     virtual void dumpState(std::string& out) const = 0;
 
 private:
+    // The inputs and results of ensureOutputLayerIfVisible for a layer on the
+    // last frame which updated the geometry.
+    struct LayerVisibility {
+        wp<LayerFE> layerFE;
+
+        // The front-end state used
+        std::optional<uint32_t> layerStackId;
+        bool internalOnly{false};
+        bool isOpaque{false};
+        ui::Transform geomLayerTransform;
+        FloatRect geomLayerBounds;
+        float shadowRadius{0.f};
+        Region transparentRegionHint;
+
+        // The coverage from the layers above, before and after this layer
+        Region aboveCoveredLayers;
+        Region aboveOpaqueLayers;
+        Region aboveCoveredLayersAfter;
+        Region aboveOpaqueLayersAfter;
+
+        compositionengine::Output::CoverageState::LayerResult result;
+    };
+    // Everything pickColorProfile depends on. The layers only contribute
+    // through the dataspaces getBestDataspace derives from them, so the
+    // decision made from them can be reused until those or the settings change.
+    struct ColorProfileKey {
+        ui::Dataspace bestDataSpace{ui::Dataspace::UNKNOWN};
+        ui::Dataspace hdrDataSpace{ui::Dataspace::UNKNOWN};
+        bool isHdrClientComposition{false};
+        OutputColorSetting outputColorSetting{OutputColorSetting::kEnhanced};
+        ui::ColorMode forceOutputColorMode{ui::ColorMode::NATIVE};
+
+        bool operator==(const ColorProfileKey& other) const {
+            return bestDataSpace == other.bestDataSpace && hdrDataSpace == other.hdrDataSpace &&
+                    isHdrClientComposition == other.isHdrClientComposition &&
+                    outputColorSetting == other.outputColorSetting &&
+                    forceOutputColorMode == other.forceOutputColorMode;
+        }
+    };
+    struct ColorProfileCache {
+        std::optional<ColorProfileKey> key;
+        ColorProfile profile;
+        uint32_t hits{0};
+        uint32_t misses{0};
+    };
+
+    // The output state used, which all entries of mLayerVisibility depend on
+    struct OutputVisibility {
+        uint32_t layerStackId{~0u};
+        bool layerStackInternal{false};
+        Rect bounds;
+        Rect viewport;
+        ui::Transform transform;
+    };
+
+    // Like ensureOutputLayerIfVisible, but reusing the result from the last
+    // frame if the layer and its coverage from the layers above did not
+    // change. Entries for the layers seen are moved to 'visibility'.
+    void ensureOutputLayerIfVisibleIncremental(
+            sp<compositionengine::LayerFE>&, compositionengine::Output::CoverageState&,
+            std::unordered_map<const LayerFE*, LayerVisibility>& visibility);
+    bool reuseLayerVisibility(const sp<compositionengine::LayerFE>&, const LayerVisibility&,
+                              compositionengine::Output::CoverageState&);
+
+    void updateOutputLayers(const compositionengine::CompositionRefreshArgs&, bool update,
+                            bool writeToHWC);
     void dirtyEntireOutput();
     compositionengine::OutputLayer* findLayerRequestingBackgroundComposition() const;
     ui::Dataspace getBestDataspace(ui::Dataspace*, bool*) const;
     compositionengine::Output::ColorProfile pickColorProfile(
-            const compositionengine::CompositionRefreshArgs&) const;
+            const compositionengine::CompositionRefreshArgs&);
 
     std::string mName;
 
@@ -130,6 +203,16 @@ private:
     ReleasedLayers mReleasedLayers;
     OutputLayer* mLayerRequestingBackgroundBlur = nullptr;
     std::unique_ptr<ClientCompositionRequestCache> mClientCompositionRequestCache;
+    std::unique_ptr<ClientCompositionLayerGroupCache> mClientCompositionLayerGroupCache;
+
+    // If updateCompositionState was called since the last present
+    bool mCompositionStateUpdated = false;
+
+    bool mIncrementalVisibility = false;
+    OutputVisibility mOutputVisibility;
+    std::unordered_map<const LayerFE*, LayerVisibility> mLayerVisibility;
+
+    ColorProfileCache mColorProfileCache;
 };
 
 // This template factory function standardizes the implementation details of the
@@ -57,6 +57,10 @@ struct OutputCompositionState {
     // If true, the current frame reused the buffer from a previous client composition
     bool reusedClientComposition{false};
 
+    // If true, the composition strategy of the current frame was the one predicted from the
+    // previous frame
+    bool predictedCompositionStrategy{false};
+
     // If true, this output displays layers that are internal-only
     bool layerStackInternal{false};
 
@@ -0,0 +1,71 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <sched.h>
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace android::compositionengine::impl {
+
+// A fixed set of threads to run independent steps of the composition of
+// several outputs concurrently. The threads run the tasks with the scheduling
+// policy of the thread calling run(), so that they are not delayed more than
+// that thread would be (e.g. SCHED_FIFO while a display is on).
+class WorkerPool {
+public:
+    using Task = std::function<void()>;
+
+    explicit WorkerPool(size_t threadCount);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    size_t getThreadCount() const { return mThreads.size(); }
+
+    // Runs the tasks, on the pool threads and the calling thread, and returns
+    // once all of them are done. Only one thread may call this at a time.
+    void run(const std::vector<Task>& tasks);
+
+private:
+    void threadMain();
+    // Runs the tasks not yet taken by another thread, with mMutex held
+    // except while running each of them.
+    void runTasksLocked(std::unique_lock<std::mutex>& lock);
+
+    std::mutex mMutex;
+    // Signaled when tasks are added or the pool is destroyed
+    std::condition_variable mTasksAdded;
+    // Signaled when the last running task is done
+    std::condition_variable mTasksDone;
+    const std::vector<Task>* mTasks = nullptr;
+    size_t mNextTask = 0;
+    size_t mPendingTasks = 0;
+    bool mExit = false;
+    // The scheduling policy of the thread calling run()
+    int mSchedPolicy = SCHED_OTHER;
+    sched_param mSchedParam{};
+
+    std::vector<std::thread> mThreads;
+};
+
+} // namespace android::compositionengine::impl
@@ -0,0 +1,182 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define ATRACE_TAG ATRACE_TAG_GRAPHICS
+
+#include <algorithm>
+#include <iterator>
+
+#include <android-base/unique_fd.h>
+#include <compositionengine/impl/ClientCompositionLayerGroupCache.h>
+#include <compositionengine/impl/ClientCompositionRequestCache.h>
+#include <log/log.h>
+#include <renderengine/RenderEngine.h>
+#include <utils/Trace.h>
+
+namespace android::compositionengine::impl {
+
+ClientCompositionLayerGroupCache::ClientCompositionLayerGroupCache(
+        renderengine::RenderEngine& renderEngine)
+      : mRenderEngine(renderEngine) {}
+
+ClientCompositionLayerGroupCache::~ClientCompositionLayerGroupCache() {
+    releaseBuffer();
+    if (mTextureName != 0) {
+        mRenderEngine.deleteTextures(1, &mTextureName);
+    }
+}
+
+void ClientCompositionLayerGroupCache::apply(const renderengine::DisplaySettings& display,
+                                             ui::Size targetSize, PixelFormat targetFormat,
+                                             std::vector<LayerFE::LayerSettings>& layers) {
+    if (!canCache(display, targetSize)) {
+        mPreviousLayers.clear();
+        mUnchangedFrames.clear();
+        clear();
+        return;
+    }
+
+    std::vector<uint32_t> unchangedFrames(layers.size(), 0);
+    for (size_t i = 0; i < layers.size() && i < mPreviousLayers.size(); i++) {
+        if (!canCache(layers[i]) || !layerSettingsAreEqual(layers[i], mPreviousLayers[i])) {
+            break;
+        }
+        unchangedFrames[i] = mUnchangedFrames[i] + 1;
+    }
+
+    mPreviousLayers.clear();
+    mPreviousLayers.reserve(layers.size());
+    std::transform(layers.begin(), layers.end(), std::back_inserter(mPreviousLayers),
+                   getLayerSettingsSnapshot);
+    mUnchangedFrames = std::move(unchangedFrames);
+
+    // mUnchangedFrames only decreases from the bottom up
+    const size_t count = static_cast<size_t>(
+            std::find_if(mUnchangedFrames.begin(), mUnchangedFrames.end(),
+                         [](uint32_t frames) { return frames < kMinUnchangedFrames; }) -
+            mUnchangedFrames.begin());
+    if (count < kMinCachedLayers) {
+        clear();
+        return;
+    }
+
+    const bool isCached = std::equal(mCachedLayers.begin(), mCachedLayers.end(), layers.begin(),
+                                     layers.begin() + count, layerSettingsAreEqual);
+    if (!isCached && !render(display, targetSize, targetFormat, layers, count)) {
+        clear();
+        return;
+    }
+
+    LayerFE::LayerSettings cachedLayer;
+    cachedLayer.geometry.boundaries = display.clip.toFloatRect();
+    cachedLayer.source.buffer.buffer = mBuffer;
+    cachedLayer.source.buffer.fence = mReadyFence;
+    cachedLayer.source.buffer.textureName = mTextureName;
+    cachedLayer.source.buffer.usePremultipliedAlpha = true;
+    cachedLayer.alpha = half(1.0f);
+    // The cached buffer is already in the output dataspace
+    cachedLayer.sourceDataspace = display.outputDataspace;
+    cachedLayer.bufferId = mBuffer->getId();
+    cachedLayer.frameNumber = mGeneration;
+
+    layers.erase(layers.begin() + 1, layers.begin() + count);
+    layers.front() = std::move(cachedLayer);
+}
+
+void ClientCompositionLayerGroupCache::clear() {
+    mCachedLayers.clear();
+}
+
+bool ClientCompositionLayerGroupCache::canCache(const renderengine::DisplaySettings& display,
+                                                ui::Size targetSize) const {
+    return display.orientation == ui::Transform::ROT_0 && display.colorTransform == mat4() &&
+            display.physicalDisplay == Rect(targetSize) && !mRenderEngine.isProtected();
+}
+
+bool ClientCompositionLayerGroupCache::canCache(const LayerFE::LayerSettings& layer) {
+    const auto& buffer = layer.source.buffer.buffer;
+    return !layer.disableBlending && layer.backgroundBlurRadius == 0 &&
+            !(buffer && (buffer->getUsage() & GraphicBuffer::USAGE_PROTECTED));
+}
+
+bool ClientCompositionLayerGroupCache::render(const renderengine::DisplaySettings& display,
+                                              ui::Size targetSize, PixelFormat targetFormat,
+                                              const std::vector<LayerFE::LayerSettings>& layers,
+                                              size_t count) {
+    ATRACE_CALL();
+
+    // The cached buffer needs an alpha channel with the precision of the target
+    const PixelFormat format =
+            targetFormat == PIXEL_FORMAT_RGBA_FP16 ? PIXEL_FORMAT_RGBA_FP16 : PIXEL_FORMAT_RGBA_8888;
+    if (!mBuffer || mBuffer->getWidth() != static_cast<uint32_t>(targetSize.width) ||
+        mBuffer->getHeight() != static_cast<uint32_t>(targetSize.height) ||
+        mBuffer->getPixelFormat() != format) {
+        releaseBuffer();
+        mBuffer = new GraphicBuffer(static_cast<uint32_t>(targetSize.width),
+                                    static_cast<uint32_t>(targetSize.height), format, 1,
+                                    GraphicBuffer::USAGE_HW_RENDER |
+                                            GraphicBuffer::USAGE_HW_TEXTURE,
+                                    "ClientCompositionLayerGroupCache");
+        if (mBuffer->initCheck() != NO_ERROR) {
+            ALOGE("Failed to allocate the buffer to cache client composition layers into");
+            mBuffer = nullptr;
+            return false;
+        }
+    }
+    if (mTextureName == 0) {
+        mRenderEngine.genTextures(1, &mTextureName);
+    }
+
+    // The clear region is filled when drawing the target
+    renderengine::DisplaySettings cacheDisplay = display;
+    cacheDisplay.clearRegion.clear();
+
+    std::vector<const renderengine::LayerSettings*> layerPointers;
+    layerPointers.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        layerPointers.push_back(&layers[i]);
+    }
+
+    base::unique_fd drawFence;
+    if (mRenderEngine.drawLayers(cacheDisplay, layerPointers, mBuffer->getNativeBuffer(),
+                                 /*useFramebufferCache=*/false, base::unique_fd(),
+                                 &drawFence) != NO_ERROR) {
+        return false;
+    }
+    if (drawFence.get() >= 0) {
+        mReadyFence = new Fence(drawFence.release());
+    } else {
+        mReadyFence = Fence::NO_FENCE;
+    }
+
+    mCachedLayers.clear();
+    mCachedLayers.reserve(count);
+    std::transform(layers.begin(), layers.begin() + count, std::back_inserter(mCachedLayers),
+                   getLayerSettingsSnapshot);
+    mGeneration++;
+    return true;
+}
+
+void ClientCompositionLayerGroupCache::releaseBuffer() {
+    if (mBuffer) {
+        mRenderEngine.unbindExternalTextureBuffer(mBuffer->getId());
+        mBuffer = nullptr;
+    }
+    mReadyFence = nullptr;
+    mCachedLayers.clear();
+}
+
+} // namespace android::compositionengine::impl
@@ -80,6 +80,10 @@ void CompositionEngine::setTimeStats(const std::shared_ptr<TimeStats>& timeStats
     mTimeStats = timeStats;
 }
 
+void CompositionEngine::setOutputWorkerCount(size_t count) {
+    mWorkerPool = count > 0 ? std::make_unique<WorkerPool>(count) : nullptr;
+}
+
 bool CompositionEngine::needsAnotherUpdate() const {
     return mNeedsAnotherUpdate;
 }
@@ -107,6 +111,19 @@ void CompositionEngine::present(CompositionRefreshArgs& args) {
 
     updateLayerStateFromFE(args);
 
+    // The other steps of presenting share the HWC command buffer and
+    // RenderEngine, so only this one can run concurrently.
+    if (mWorkerPool && args.outputs.size() > 1) {
+        std::vector<WorkerPool::Task> tasks;
+        tasks.reserve(args.outputs.size());
+        for (const auto& output : args.outputs) {
+            tasks.emplace_back([&args, output = output.get()] {
+                output->updateCompositionState(args);
+            });
+        }
+        mWorkerPool->run(tasks);
+    }
+
     for (const auto& output : args.outputs) {
         output->present(args);
     }
@@ -14,6 +14,9 @@
  * limitations under the License.
  */
 
+#include <functional>
+#include <limits>
+
 #include <android-base/stringprintf.h>
 #include <compositionengine/CompositionEngine.h>
 #include <compositionengine/CompositionRefreshArgs.h>
@@ -245,14 +248,26 @@ void Display::chooseCompositionStrategy() {
         return;
     }
 
+    // If the state HWC decides from is the same as on the previous frame, expect the same
+    // decision. presentOrValidate cannot succeed when that was to use client composition, as the
+    // client target is not rendered yet, so validate right away in that case.
+    const size_t strategyHash = getCompositionStrategyHash();
+    const bool strategyPredicted = mPreviousCompositionStrategyHash == strategyHash;
+    const bool predictClientComposition =
+            strategyPredicted && mPreviousFrameUsedClientComposition;
+
     // Get any composition changes requested by the HWC device, and apply them.
     std::optional<android::HWComposer::DeviceRequestedChanges> changes;
     auto& hwc = getCompositionEngine().getHwComposer();
-    if (status_t result = hwc.getDeviceCompositionChanges(*mId, anyLayersRequireClientComposition(),
-                                                          &changes);
+    if (status_t result =
+                hwc.getDeviceCompositionChanges(*mId,
+                                                anyLayersRequireClientComposition() ||
+                                                        predictClientComposition,
+                                                &changes);
         result != NO_ERROR) {
         ALOGE("chooseCompositionStrategy failed for %s: %d (%s)", getName().c_str(), result,
               strerror(-result));
+        mPreviousCompositionStrategyHash.reset();
         return;
     }
     if (changes) {
@@ -266,6 +281,45 @@ void Display::chooseCompositionStrategy() {
     auto& state = editState();
     state.usesClientComposition = anyLayersRequireClientComposition();
     state.usesDeviceComposition = !allLayersRequireClientComposition();
+    state.predictedCompositionStrategy =
+            strategyPredicted && state.usesClientComposition == mPreviousFrameUsedClientComposition;
+
+    mPreviousCompositionStrategyHash = strategyHash;
+    mPreviousFrameUsedClientComposition = state.usesClientComposition;
+}
+
+size_t Display::getCompositionStrategyHash() const {
+    size_t hash = 0;
+    const auto combine = [&hash](size_t value) {
+        hash ^= value + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    };
+
+    const auto& outputState = getState();
+    combine(static_cast<size_t>(outputState.dataspace));
+    const float* colorTransform = outputState.colorTransformMatrix.asArray();
+    for (size_t i = 0; i < 16; i++) {
+        combine(std::hash<float>{}(colorTransform[i]));
+    }
+
+    for (const auto* layer : getOutputLayersOrderedByZ()) {
+        const auto& layerState = layer->getState();
+        combine(std::hash<const HWC2::Layer*>{}(layer->getHwcLayer()));
+        combine(layerState.hwc ? static_cast<size_t>(layerState.hwc->hwcCompositionType)
+                               : std::numeric_limits<size_t>::max());
+        combine(layerState.forceClientComposition);
+        combine(static_cast<size_t>(layerState.displayFrame.left));
+        combine(static_cast<size_t>(layerState.displayFrame.top));
+        combine(static_cast<size_t>(layerState.displayFrame.right));
+        combine(static_cast<size_t>(layerState.displayFrame.bottom));
+        combine(std::hash<float>{}(layerState.sourceCrop.left));
+        combine(std::hash<float>{}(layerState.sourceCrop.top));
+        combine(std::hash<float>{}(layerState.sourceCrop.right));
+        combine(std::hash<float>{}(layerState.sourceCrop.bottom));
+        combine(static_cast<size_t>(layerState.bufferTransform));
+        combine(static_cast<size_t>(layerState.dataspace));
+        combine(layerState.z);
+    }
+    return hash;
 }
 
 bool Display::getSkipColorTransform() const {
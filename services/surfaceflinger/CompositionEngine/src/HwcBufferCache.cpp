@@ -16,6 +16,8 @@
 
 #include <compositionengine/impl/HwcBufferCache.h>
 
+#include <algorithm>
+
 // TODO(b/129481165): remove the #pragma below and fix conversion issues
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wconversion"
@@ -28,31 +30,64 @@
 
 namespace android::compositionengine::impl {
 
-HwcBufferCache::HwcBufferCache() {
-    std::fill(std::begin(mBuffers), std::end(mBuffers), wp<GraphicBuffer>(nullptr));
-}
+HwcBufferCache::HwcBufferCache(uint32_t capacity)
+      : mCapacity(std::clamp(capacity, 1u,
+                             static_cast<uint32_t>(BufferQueue::NUM_BUFFER_SLOTS))) {}
 
 void HwcBufferCache::getHwcBuffer(int slot, const sp<GraphicBuffer>& buffer, uint32_t* outSlot,
                                   sp<GraphicBuffer>* outBuffer) {
-    // default is 0
-    if (slot == BufferQueue::INVALID_BUFFER_SLOT || slot < 0 ||
-        slot >= BufferQueue::NUM_BUFFER_SLOTS) {
-        *outSlot = 0;
-    } else {
+    if (slot >= 0 && slot < BufferQueue::NUM_BUFFER_SLOTS) {
         *outSlot = static_cast<uint32_t>(slot);
+    } else if (buffer) {
+        *outSlot = getSlotForBufferId(buffer->getId());
+    } else {
+        // default is 0
+        *outSlot = 0;
     }
 
-    auto& currentBuffer = mBuffers[*outSlot];
+    auto& currentSlot = mSlots[*outSlot];
     wp<GraphicBuffer> weakCopy(buffer);
-    if (currentBuffer == weakCopy) {
+    if (currentSlot.buffer == weakCopy) {
         // already cached in HWC, skip sending the buffer
         *outBuffer = nullptr;
-    } else {
-        *outBuffer = buffer;
+        return;
+    }
 
-        // update cache
-        currentBuffer = buffer;
+    *outBuffer = buffer;
+
+    // update cache
+    if (const auto it = mSlotsByBufferId.find(currentSlot.bufferId);
+        it != mSlotsByBufferId.end() && it->second == *outSlot) {
+        mSlotsByBufferId.erase(it);
+    }
+    currentSlot.buffer = buffer;
+    currentSlot.bufferId = buffer ? buffer->getId() : 0;
+    if (buffer) {
+        mSlotsByBufferId[currentSlot.bufferId] = *outSlot;
     }
 }
 
+uint32_t HwcBufferCache::getSlotForBufferId(uint64_t bufferId) {
+    uint32_t slot;
+    if (const auto it = mSlotsByBufferId.find(bufferId); it != mSlotsByBufferId.end()) {
+        slot = it->second;
+        if (!mSlots[slot].assignedById) {
+            // Cached in its BufferQueue slot
+            return slot;
+        }
+    } else if (mLruSlots.size() < mCapacity) {
+        slot = static_cast<uint32_t>(mLruSlots.size());
+        mLruSlots.push_front(slot);
+        mSlots[slot].assignedById = true;
+        mSlots[slot].lruPosition = mLruSlots.begin();
+        return slot;
+    } else {
+        // Evict the least recently used buffer. The caller overwrites its slot.
+        slot = mLruSlots.back();
+    }
+
+    mLruSlots.splice(mLruSlots.begin(), mLruSlots, mSlots[slot].lruPosition);
+    return slot;
+}
+
 } // namespace android::compositionengine::impl
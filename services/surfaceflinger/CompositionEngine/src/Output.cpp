@@ -175,6 +175,20 @@ void Output::setColorProfile(const ColorProfile& colorProfile) {
     dirtyEntireOutput();
 }
 
+void Output::setIncrementalVisibilityEnabled(bool enabled) {
+    mIncrementalVisibility = enabled;
+    mLayerVisibility.clear();
+}
+
+void Output::setLayerGroupCachingEnabled(bool enabled) {
+    if (!enabled) {
+        mClientCompositionLayerGroupCache.reset();
+    } else if (!mClientCompositionLayerGroupCache) {
+        mClientCompositionLayerGroupCache = std::make_unique<ClientCompositionLayerGroupCache>(
+                getCompositionEngine().getRenderEngine());
+    }
+}
+
 void Output::dump(std::string& out) const {
     using android::base::StringAppendF;
 
@@ -207,6 +221,9 @@ void Output::dumpBase(std::string& out) const {
         }
         outputLayer->dump(out);
     }
+
+    android::base::StringAppendF(&out, "\n   Color profile cache: %u hits, %u misses\n",
+                                 mColorProfileCache.hits, mColorProfileCache.misses);
 }
 
 compositionengine::DisplayColorProfile* Output::getDisplayColorProfile() const {
@@ -215,6 +232,7 @@ compositionengine::DisplayColorProfile* Output::getDisplayColorProfile() const {
 
 void Output::setDisplayColorProfile(std::unique_ptr<compositionengine::DisplayColorProfile> mode) {
     mDisplayColorProfile = std::move(mode);
+    mColorProfileCache.key.reset();
 }
 
 const Output::ReleasedLayers& Output::getReleasedLayersForTest() const {
@@ -224,6 +242,7 @@ const Output::ReleasedLayers& Output::getReleasedLayersForTest() const {
 void Output::setDisplayColorProfileForTest(
         std::unique_ptr<compositionengine::DisplayColorProfile> mode) {
     mDisplayColorProfile = std::move(mode);
+    mColorProfileCache.key.reset();
 }
 
 compositionengine::RenderSurface* Output::getRenderSurface() const {
@@ -308,7 +327,9 @@ void Output::present(const compositionengine::CompositionRefreshArgs& refreshArg
     ATRACE_CALL();
     ALOGV(__FUNCTION__);
 
-    updateColorProfile(refreshArgs);
+    if (!mCompositionStateUpdated) {
+        updateColorProfile(refreshArgs);
+    }
     updateAndWriteCompositionState(refreshArgs);
     setColorTransform(refreshArgs);
     beginFrame();
@@ -316,6 +337,19 @@ void Output::present(const compositionengine::CompositionRefreshArgs& refreshArg
     devOptRepaintFlash(refreshArgs);
     finishFrame(refreshArgs);
     postFramebuffer();
+
+    mCompositionStateUpdated = false;
+}
+
+void Output::updateCompositionState(const compositionengine::CompositionRefreshArgs& refreshArgs) {
+    ATRACE_CALL();
+    ALOGV(__FUNCTION__);
+
+    updateColorProfile(refreshArgs);
+    if (getState().isEnabled) {
+        updateOutputLayers(refreshArgs, true /* update */, false /* writeToHWC */);
+    }
+    mCompositionStateUpdated = true;
 }
 
 void Output::rebuildLayerStacks(const compositionengine::CompositionRefreshArgs& refreshArgs,
@@ -345,16 +379,42 @@ void Output::rebuildLayerStacks(const compositionengine::CompositionRefreshArgs&
 
 void Output::collectVisibleLayers(const compositionengine::CompositionRefreshArgs& refreshArgs,
                                   compositionengine::Output::CoverageState& coverage) {
+    // The reusable results all depend on this output state
+    std::unordered_map<const LayerFE*, LayerVisibility> visibility;
+    if (mIncrementalVisibility) {
+        const auto& outputState = getState();
+        if (outputState.layerStackId != mOutputVisibility.layerStackId ||
+            outputState.layerStackInternal != mOutputVisibility.layerStackInternal ||
+            outputState.bounds != mOutputVisibility.bounds ||
+            outputState.viewport != mOutputVisibility.viewport ||
+            !(outputState.transform == mOutputVisibility.transform)) {
+            mLayerVisibility.clear();
+            mOutputVisibility = OutputVisibility{outputState.layerStackId,
+                                                 outputState.layerStackInternal,
+                                                 outputState.bounds, outputState.viewport,
+                                                 outputState.transform};
+        }
+        visibility.reserve(mLayerVisibility.size());
+    }
+
     // Evaluate the layers from front to back to determine what is visible. This
     // also incrementally calculates the coverage information for each layer as
     // well as the entire output.
     for (auto layer : reversed(refreshArgs.layers)) {
         // Incrementally process the coverage for each layer
-        ensureOutputLayerIfVisible(layer, coverage);
+        if (mIncrementalVisibility) {
+            ensureOutputLayerIfVisibleIncremental(layer, coverage, visibility);
+        } else {
+            ensureOutputLayerIfVisible(layer, coverage);
+        }
 
         // TODO(b/121291683): Stop early if the output is completely covered and
         // no more layers could even be visible underneath the ones on top.
     }
+    if (mIncrementalVisibility) {
+        // drops the entries of layers which are gone
+        mLayerVisibility = std::move(visibility);
+    }
 
     setReleasedLayers(refreshArgs);
 
@@ -369,6 +429,9 @@ void Output::collectVisibleLayers(const compositionengine::CompositionRefreshArg
 
 void Output::ensureOutputLayerIfVisible(sp<compositionengine::LayerFE>& layerFE,
                                         compositionengine::Output::CoverageState& coverage) {
+    coverage.lastLayer.reachedDirty = false;
+    coverage.lastLayer.hasOutputLayer = false;
+
     // Ensure we have a snapshot of the basic geometry layer state. Limit the
     // snapshots to once per frame for each candidate layer, as layers may
     // appear on multiple outputs.
@@ -529,6 +592,10 @@ void Output::ensureOutputLayerIfVisible(sp<compositionengine::LayerFE>& layerFE,
     // accumulate to the screen dirty region
     coverage.dirtyRegion.orSelf(dirty);
 
+    coverage.lastLayer.reachedDirty = true;
+    coverage.lastLayer.visibleRegion = visibleRegion;
+    coverage.lastLayer.coveredRegion = coveredRegion;
+
     // Update accumAboveOpaqueLayers for next (lower) layer
     coverage.aboveOpaqueLayers.orSelf(opaqueRegion);
 
@@ -549,6 +616,7 @@ void Output::ensureOutputLayerIfVisible(sp<compositionengine::LayerFE>& layerFE,
     // The layer is visible. Either reuse the existing outputLayer if we have
     // one, or create a new one if we do not.
     auto result = ensureOutputLayer(prevOutputLayerIndex, layerFE);
+    coverage.lastLayer.hasOutputLayer = true;
 
     // Store the layer coverage information into the layer state as some of it
     // is useful later.
@@ -561,6 +629,114 @@ void Output::ensureOutputLayerIfVisible(sp<compositionengine::LayerFE>& layerFE,
     outputLayerState.shadowRegion = shadowRegion;
 }
 
+void Output::ensureOutputLayerIfVisibleIncremental(
+        sp<compositionengine::LayerFE>& layerFE, compositionengine::Output::CoverageState& coverage,
+        std::unordered_map<const LayerFE*, LayerVisibility>& visibility) {
+    if (!coverage.latchedLayers.count(layerFE)) {
+        coverage.latchedLayers.insert(layerFE);
+        layerFE->prepareCompositionState(compositionengine::LayerFE::StateSubset::BasicGeometry);
+    }
+
+    // Layers which do not affect the coverage are cheap enough as they are
+    const auto* layerFEState = layerFE->getCompositionState();
+    if (!layerFEState || !layerFEState->isVisible || !belongsInOutput(layerFE)) {
+        ensureOutputLayerIfVisible(layerFE, coverage);
+        return;
+    }
+
+    if (auto it = mLayerVisibility.find(layerFE.get());
+        it != mLayerVisibility.end() && reuseLayerVisibility(layerFE, it->second, coverage)) {
+        visibility.emplace(layerFE.get(), std::move(it->second));
+        return;
+    }
+
+    LayerVisibility entry;
+    entry.layerFE = layerFE;
+    entry.layerStackId = layerFEState->layerStackId;
+    entry.internalOnly = layerFEState->internalOnly;
+    entry.isOpaque = layerFEState->isOpaque;
+    entry.geomLayerTransform = layerFEState->geomLayerTransform;
+    entry.geomLayerBounds = layerFEState->geomLayerBounds;
+    entry.shadowRadius = layerFEState->shadowRadius;
+    entry.transparentRegionHint = layerFEState->transparentRegionHint;
+    entry.aboveCoveredLayers = coverage.aboveCoveredLayers;
+    entry.aboveOpaqueLayers = coverage.aboveOpaqueLayers;
+
+    ensureOutputLayerIfVisible(layerFE, coverage);
+
+    entry.aboveCoveredLayersAfter = coverage.aboveCoveredLayers;
+    entry.aboveOpaqueLayersAfter = coverage.aboveOpaqueLayers;
+    entry.result = coverage.lastLayer;
+    visibility.insert_or_assign(layerFE.get(), std::move(entry));
+}
+
+bool Output::reuseLayerVisibility(const sp<compositionengine::LayerFE>& layerFE,
+                                  const LayerVisibility& entry,
+                                  compositionengine::Output::CoverageState& coverage) {
+    // The address may have been reused by another layer
+    if (entry.layerFE.promote() != layerFE) {
+        return false;
+    }
+
+    const auto* layerFEState = layerFE->getCompositionState();
+    if (entry.layerStackId != layerFEState->layerStackId ||
+        entry.internalOnly != layerFEState->internalOnly ||
+        entry.isOpaque != layerFEState->isOpaque ||
+        !(entry.geomLayerTransform == layerFEState->geomLayerTransform) ||
+        entry.geomLayerBounds != layerFEState->geomLayerBounds ||
+        entry.shadowRadius != layerFEState->shadowRadius ||
+        !entry.transparentRegionHint.hasSameRects(layerFEState->transparentRegionHint) ||
+        !entry.aboveCoveredLayers.hasSameRects(coverage.aboveCoveredLayers) ||
+        !entry.aboveOpaqueLayers.hasSameRects(coverage.aboveOpaqueLayers)) {
+        return false;
+    }
+
+    const auto& result = entry.result;
+    const Region& visibleRegion = result.visibleRegion;
+    const Region& coveredRegion = result.coveredRegion;
+
+    // The dirty region is computed from the coverage as previously displayed,
+    // which must still be the result reused here.
+    auto prevOutputLayerIndex = findCurrentOutputLayerForLayer(layerFE);
+    if (result.hasOutputLayer) {
+        if (!prevOutputLayerIndex) {
+            return false;
+        }
+        const auto& prevState = getOutputLayerOrderedByZByIndex(*prevOutputLayerIndex)->getState();
+        if (!prevState.visibleRegion.hasSameRects(visibleRegion) ||
+            !prevState.coveredRegion.hasSameRects(coveredRegion)) {
+            return false;
+        }
+    } else if (prevOutputLayerIndex) {
+        return false;
+    }
+
+    if (result.reachedDirty) {
+        // Same as ensureOutputLayerIfVisible with the old regions being either
+        // these (with an output layer) or empty (without).
+        Region dirty;
+        if (layerFEState->contentDirty) {
+            dirty = visibleRegion;
+        } else if (result.hasOutputLayer) {
+            dirty = visibleRegion.intersect(coveredRegion);
+        } else {
+            dirty = visibleRegion.subtract(coveredRegion);
+        }
+        dirty.subtractSelf(coverage.aboveOpaqueLayers);
+        coverage.dirtyRegion.orSelf(dirty);
+    }
+
+    coverage.aboveCoveredLayers = entry.aboveCoveredLayersAfter;
+    coverage.aboveOpaqueLayers = entry.aboveOpaqueLayersAfter;
+
+    // The output layer state is still the same as computed then
+    if (result.hasOutputLayer) {
+        ensureOutputLayer(prevOutputLayerIndex, layerFE);
+    }
+    coverage.lastLayer = result;
+    return true;
+}
+
 void Output::setReleasedLayers(const compositionengine::CompositionRefreshArgs&) {
     // The base class does nothing with this call.
 }
@@ -582,21 +758,33 @@ void Output::updateAndWriteCompositionState(
         return;
     }
 
-    mLayerRequestingBackgroundBlur = findLayerRequestingBackgroundComposition();
+    // Only the HWC still needs the state if updateCompositionState was called
+    updateOutputLayers(refreshArgs, !mCompositionStateUpdated, true /* writeToHWC */);
+}
+
+void Output::updateOutputLayers(const compositionengine::CompositionRefreshArgs& refreshArgs,
+                                bool update, bool writeToHWC) {
+    if (update) {
+        mLayerRequestingBackgroundBlur = findLayerRequestingBackgroundComposition();
+    }
     bool forceClientComposition = mLayerRequestingBackgroundBlur != nullptr;
 
     for (auto* layer : getOutputLayersOrderedByZ()) {
-        layer->updateCompositionState(refreshArgs.updatingGeometryThisFrame,
-                                      refreshArgs.devOptForceClientComposition ||
-                                              forceClientComposition,
-                                      refreshArgs.internalDisplayRotationFlags);
-
-        if (mLayerRequestingBackgroundBlur == layer) {
-            forceClientComposition = false;
+        if (update) {
+            layer->updateCompositionState(refreshArgs.updatingGeometryThisFrame,
+                                          refreshArgs.devOptForceClientComposition ||
+                                                  forceClientComposition,
+                                          refreshArgs.internalDisplayRotationFlags);
+
+            if (mLayerRequestingBackgroundBlur == layer) {
+                forceClientComposition = false;
+            }
         }
 
         // Send the updated state to the HWC, if appropriate.
-        layer->writeStateToHWC(refreshArgs.updatingGeometryThisFrame);
+        if (writeToHWC) {
+            layer->writeStateToHWC(refreshArgs.updatingGeometryThisFrame);
+        }
     }
 }
 
@@ -666,7 +854,7 @@ ui::Dataspace Output::getBestDataspace(ui::Dataspace* outHdrDataSpace,
 }
 
 compositionengine::Output::ColorProfile Output::pickColorProfile(
-        const compositionengine::CompositionRefreshArgs& refreshArgs) const {
+        const compositionengine::CompositionRefreshArgs& refreshArgs) {
     if (refreshArgs.outputColorSetting == OutputColorSetting::kUnmanaged) {
         return ColorProfile{ui::ColorMode::NATIVE, ui::Dataspace::UNKNOWN,
                             ui::RenderIntent::COLORIMETRIC,
@@ -677,6 +865,18 @@ compositionengine::Output::ColorProfile Output::pickColorProfile(
     bool isHdrClientComposition = false;
     ui::Dataspace bestDataSpace = getBestDataspace(&hdrDataSpace, &isHdrClientComposition);
 
+    // The layer content rarely changes in a way that affects the decision, so
+    // skip querying the display color profile when nothing it depends on did.
+    const ColorProfileKey key{bestDataSpace, hdrDataSpace, isHdrClientComposition,
+                              refreshArgs.outputColorSetting, refreshArgs.forceOutputColorMode};
+    if (mColorProfileCache.key == key) {
+        mColorProfileCache.hits++;
+        auto profile = mColorProfileCache.profile;
+        profile.colorSpaceAgnosticDataspace = refreshArgs.colorSpaceAgnosticDataspace;
+        return profile;
+    }
+    mColorProfileCache.misses++;
+
     switch (refreshArgs.forceOutputColorMode) {
         case ui::ColorMode::SRGB:
             bestDataSpace = ui::Dataspace::V0_SRGB;
@@ -716,8 +916,10 @@ compositionengine::Output::ColorProfile Output::pickColorProfile(
     mDisplayColorProfile->getBestColorMode(bestDataSpace, intent, &outDataSpace, &outMode,
                                            &outRenderIntent);
 
-    return ColorProfile{outMode, outDataSpace, outRenderIntent,
-                        refreshArgs.colorSpaceAgnosticDataspace};
+    mColorProfileCache.key = key;
+    mColorProfileCache.profile = ColorProfile{outMode, outDataSpace, outRenderIntent,
+                                              refreshArgs.colorSpaceAgnosticDataspace};
+    return mColorProfileCache.profile;
 }
 
 void Output::beginFrame() {
@@ -913,6 +1115,14 @@ std::optional<base::unique_fd> Output::composeSurfaces(
         setExpensiveRenderingExpected(true);
     }
 
+    // Draw the bottom-most layers which did not change from a cached buffer
+    if (mClientCompositionLayerGroupCache) {
+        mClientCompositionLayerGroupCache->apply(clientCompositionDisplay,
+                                                 ui::Size(static_cast<int32_t>(buf->getWidth()),
+                                                          static_cast<int32_t>(buf->getHeight())),
+                                                 buf->getPixelFormat(), clientCompositionLayers);
+    }
+
     std::vector<const renderengine::LayerSettings*> clientCompositionLayerPointers;
     clientCompositionLayerPointers.reserve(clientCompositionLayers.size());
     std::transform(clientCompositionLayers.begin(), clientCompositionLayers.end(),
@@ -1104,6 +1314,7 @@ void Output::chooseCompositionStrategy() {
     outputState.usesClientComposition = true;
     outputState.usesDeviceComposition = false;
     outputState.reusedClientComposition = false;
+    outputState.predictedCompositionStrategy = false;
 }
 
 bool Output::getSkipColorTransform() const {
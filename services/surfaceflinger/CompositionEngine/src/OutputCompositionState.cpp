@@ -28,6 +28,7 @@ void OutputCompositionState::dump(std::string& out) const {
     dumpVal(out, "usesDeviceComposition", usesDeviceComposition);
     dumpVal(out, "flipClientTarget", flipClientTarget);
     dumpVal(out, "reusedClientComposition", reusedClientComposition);
+    dumpVal(out, "predictedCompositionStrategy", predictedCompositionStrategy);
 
     dumpVal(out, "layerStack", layerStackId);
     dumpVal(out, "layerStackInternal", layerStackInternal);
@@ -0,0 +1,108 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <compositionengine/impl/WorkerPool.h>
+
+#include <pthread.h>
+
+#include <cstring>
+
+#include <log/log.h>
+#include <utils/Trace.h>
+
+namespace android::compositionengine::impl {
+
+WorkerPool::WorkerPool(size_t threadCount) {
+    mThreads.reserve(threadCount);
+    for (size_t i = 0; i < threadCount; i++) {
+        mThreads.emplace_back([this] { threadMain(); });
+        pthread_setname_np(mThreads.back().native_handle(), "CEWorker");
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard lock(mMutex);
+        mExit = true;
+    }
+    mTasksAdded.notify_all();
+    for (auto& thread : mThreads) {
+        thread.join();
+    }
+}
+
+void WorkerPool::run(const std::vector<Task>& tasks) {
+    ATRACE_CALL();
+
+    int policy;
+    sched_param param;
+    if (pthread_getschedparam(pthread_self(), &policy, &param) != 0) {
+        policy = SCHED_OTHER;
+        param = {};
+    }
+
+    std::unique_lock lock(mMutex);
+    mSchedPolicy = policy;
+    mSchedParam = param;
+    mTasks = &tasks;
+    mNextTask = 0;
+    mPendingTasks = tasks.size();
+    mTasksAdded.notify_all();
+
+    runTasksLocked(lock);
+    mTasksDone.wait(lock, [this] { return mPendingTasks == 0; });
+    mTasks = nullptr;
+}
+
+void WorkerPool::runTasksLocked(std::unique_lock<std::mutex>& lock) {
+    while (mTasks && mNextTask < mTasks->size()) {
+        const auto& task = (*mTasks)[mNextTask++];
+        lock.unlock();
+        task();
+        lock.lock();
+        if (--mPendingTasks == 0) {
+            mTasksDone.notify_all();
+        }
+    }
+}
+
+void WorkerPool::threadMain() {
+    int policy = SCHED_OTHER;
+    sched_param param{};
+    pthread_getschedparam(pthread_self(), &policy, &param);
+
+    std::unique_lock lock(mMutex);
+    while (true) {
+        mTasksAdded.wait(lock,
+                         [this] { return mExit || (mTasks && mNextTask < mTasks->size()); });
+        if (mExit) {
+            return;
+        }
+
+        if (policy != mSchedPolicy || param.sched_priority != mSchedParam.sched_priority) {
+            policy = mSchedPolicy;
+            param = mSchedParam;
+            if (int error = pthread_setschedparam(pthread_self(), policy, &param); error != 0) {
+                ALOGW("Failed to set scheduling policy %d of worker thread: %s", policy,
+                      strerror(error));
+            }
+        }
+
+        runTasksLocked(lock);
+    }
+}
+
+} // namespace android::compositionengine::impl
@@ -0,0 +1,175 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <compositionengine/impl/ClientCompositionLayerGroupCache.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <renderengine/mock/RenderEngine.h>
+
+namespace android::compositionengine {
+namespace {
+
+using testing::_;
+using testing::NiceMock;
+using testing::Return;
+using testing::SetArgPointee;
+using testing::SizeIs;
+
+constexpr uint32_t kTextureName = 7;
+const ui::Size kTargetSize{100, 200};
+
+struct ClientCompositionLayerGroupCacheTest : public testing::Test {
+    ClientCompositionLayerGroupCacheTest() {
+        ON_CALL(mRenderEngine, isProtected()).WillByDefault(Return(false));
+        ON_CALL(mRenderEngine, genTextures(1, _))
+                .WillByDefault(SetArgPointee<1>(kTextureName));
+        ON_CALL(mRenderEngine, drawLayers(_, _, _, _, _, _)).WillByDefault(Return(NO_ERROR));
+
+        mDisplay.physicalDisplay = Rect(kTargetSize);
+        mDisplay.clip = Rect(kTargetSize);
+        mDisplay.clearRegion = Region(Rect(10, 10));
+
+        for (size_t i = 0; i < mLayers.size(); i++) {
+            mLayers[i].geometry.boundaries = FloatRect(0.f, 0.f, 100.f, 200.f);
+            mLayers[i].source.solidColor = half3(0.1f * static_cast<float>(i), 0.f, 0.f);
+            mLayers[i].alpha = half(0.5f);
+        }
+    }
+
+    // Applies the cache to mLayers, as if drawing a new frame
+    std::vector<LayerFE::LayerSettings> drawFrame() {
+        std::vector<LayerFE::LayerSettings> layers = mLayers;
+        mCache.apply(mDisplay, kTargetSize, PIXEL_FORMAT_RGBA_8888, layers);
+        return layers;
+    }
+
+    // Draws frames where the top layer changes each time
+    void drawFramesAnimatingTopLayer(size_t frames) {
+        for (size_t i = 0; i < frames; i++) {
+            mLayers.back().frameNumber++;
+            drawFrame();
+        }
+    }
+
+    NiceMock<renderengine::mock::RenderEngine> mRenderEngine;
+    impl::ClientCompositionLayerGroupCache mCache{mRenderEngine};
+    renderengine::DisplaySettings mDisplay;
+    std::vector<LayerFE::LayerSettings> mLayers{3};
+};
+
+TEST_F(ClientCompositionLayerGroupCacheTest, cachesLayersOnceTheyStopChanging) {
+    EXPECT_CALL(mRenderEngine, drawLayers(_, _, _, _, _, _)).Times(0);
+    drawFramesAnimatingTopLayer(impl::ClientCompositionLayerGroupCache::kMinUnchangedFrames);
+    EXPECT_EQ(0u, mCache.getCachedLayerCount());
+
+    // The two bottom layers are rendered into the cache, without the clear region
+    EXPECT_CALL(mRenderEngine, drawLayers(_, SizeIs(2), _, _, _, _))
+            .WillOnce([&](const renderengine::DisplaySettings& display,
+                          const std::vector<const renderengine::LayerSettings*>& layers,
+                          ANativeWindowBuffer*, const bool, base::unique_fd&&, base::unique_fd*) {
+                EXPECT_TRUE(display.clearRegion.isEmpty());
+                EXPECT_EQ(mLayers[0], *layers[0]);
+                EXPECT_EQ(mLayers[1], *layers[1]);
+                return NO_ERROR;
+            });
+    mLayers.back().frameNumber++;
+    std::vector<LayerFE::LayerSettings> layers = drawFrame();
+    EXPECT_EQ(2u, mCache.getCachedLayerCount());
+
+    // ... and drawn as a single layer
+    ASSERT_THAT(layers, SizeIs(2));
+    ASSERT_NE(nullptr, layers[0].source.buffer.buffer);
+    EXPECT_EQ(kTextureName, layers[0].source.buffer.textureName);
+    EXPECT_EQ(FloatRect(0.f, 0.f, 100.f, 200.f), layers[0].geometry.boundaries);
+    EXPECT_EQ(half(1.0f), layers[0].alpha);
+    EXPECT_EQ(mLayers[2], layers[1]);
+
+    // The cached layers are not rendered again while they do not change
+    EXPECT_CALL(mRenderEngine, drawLayers(_, _, _, _, _, _)).Times(0);
+    mLayers.back().frameNumber++;
+    std::vector<LayerFE::LayerSettings> nextLayers = drawFrame();
+    ASSERT_THAT(nextLayers, SizeIs(2));
+    EXPECT_EQ(layers[0].source.buffer.buffer, nextLayers[0].source.buffer.buffer);
+    EXPECT_EQ(layers[0].frameNumber, nextLayers[0].frameNumber);
+}
+
+TEST_F(ClientCompositionLayerGroupCacheTest, rendersAgainOnceChangedLayersStopChanging) {
+    drawFramesAnimatingTopLayer(impl::ClientCompositionLayerGroupCache::kMinUnchangedFrames + 1);
+    ASSERT_EQ(2u, mCache.getCachedLayerCount());
+
+    // A change of a cached layer stops caching until it stopped changing again
+    EXPECT_CALL(mRenderEngine, drawLayers(_, _, _, _, _, _)).Times(0);
+    mLayers[1].alpha = half(0.25f);
+    EXPECT_THAT(drawFrame(), SizeIs(3));
+    EXPECT_EQ(0u, mCache.getCachedLayerCount());
+
+    drawFramesAnimatingTopLayer(impl::ClientCompositionLayerGroupCache::kMinUnchangedFrames - 1);
+
+    EXPECT_CALL(mRenderEngine, drawLayers(_, SizeIs(2), _, _, _, _)).WillOnce(Return(NO_ERROR));
+    mLayers.back().frameNumber++;
+    EXPECT_THAT(drawFrame(), SizeIs(2));
+}
+
+TEST_F(ClientCompositionLayerGroupCacheTest, cachesAllLayersIfNoneChange) {
+    EXPECT_CALL(mRenderEngine, drawLayers(_, SizeIs(3), _, _, _, _)).WillOnce(Return(NO_ERROR));
+    for (uint32_t i = 0; i <= impl::ClientCompositionLayerGroupCache::kMinUnchangedFrames; i++) {
+        drawFrame();
+    }
+    EXPECT_THAT(drawFrame(), SizeIs(1));
+}
+
+TEST_F(ClientCompositionLayerGroupCacheTest, layersWhichDisableBlendingEndTheGroup) {
+    mLayers[1].disableBlending = true;
+
+    EXPECT_CALL(mRenderEngine, drawLayers(_, _, _, _, _, _)).Times(0);
+    drawFramesAnimatingTopLayer(impl::ClientCompositionLayerGroupCache::kMinUnchangedFrames + 2);
+    EXPECT_EQ(0u, mCache.getCachedLayerCount());
+}
+
+TEST_F(ClientCompositionLayerGroupCacheTest, layersWhichBlurEndTheGroup) {
+    mLayers[1].backgroundBlurRadius = 10;
+
+    EXPECT_CALL(mRenderEngine, drawLayers(_, _, _, _, _, _)).Times(0);
+    drawFramesAnimatingTopLayer(impl::ClientCompositionLayerGroupCache::kMinUnchangedFrames + 2);
+    EXPECT_EQ(0u, mCache.getCachedLayerCount());
+}
+
+TEST_F(ClientCompositionLayerGroupCacheTest, doesNotCacheRotatedOutputs) {
+    mDisplay.orientation = ui::Transform::ROT_90;
+
+    EXPECT_CALL(mRenderEngine, drawLayers(_, _, _, _, _, _)).Times(0);
+    drawFramesAnimatingTopLayer(impl::ClientCompositionLayerGroupCache::kMinUnchangedFrames + 2);
+    EXPECT_EQ(0u, mCache.getCachedLayerCount());
+}
+
+TEST_F(ClientCompositionLayerGroupCacheTest, doesNotCacheWithAColorTransform) {
+    mDisplay.colorTransform = mat4() * 0.5f;
+
+    EXPECT_CALL(mRenderEngine, drawLayers(_, _, _, _, _, _)).Times(0);
+    drawFramesAnimatingTopLayer(impl::ClientCompositionLayerGroupCache::kMinUnchangedFrames + 2);
+    EXPECT_EQ(0u, mCache.getCachedLayerCount());
+}
+
+TEST_F(ClientCompositionLayerGroupCacheTest, doesNotCacheIfRenderingFails) {
+    EXPECT_CALL(mRenderEngine, drawLayers(_, _, _, _, _, _)).WillOnce(Return(BAD_VALUE));
+    drawFramesAnimatingTopLayer(impl::ClientCompositionLayerGroupCache::kMinUnchangedFrames);
+    mLayers.back().frameNumber++;
+    EXPECT_THAT(drawFrame(), SizeIs(3));
+    EXPECT_EQ(0u, mCache.getCachedLayerCount());
+}
+
+} // namespace
+} // namespace android::compositionengine
@@ -31,11 +31,13 @@ namespace {
 
 using ::testing::_;
 using ::testing::DoAll;
+using ::testing::Expectation;
 using ::testing::InSequence;
 using ::testing::Ref;
 using ::testing::Return;
 using ::testing::ReturnRef;
 using ::testing::SaveArg;
+using ::testing::Sequence;
 using ::testing::StrictMock;
 
 struct CompositionEngineTest : public testing::Test {
@@ -123,6 +125,44 @@ TEST_F(CompositionEnginePresentTest, worksAsExpected) {
     mEngine.present(mRefreshArgs);
 }
 
+TEST_F(CompositionEnginePresentTest, updatesCompositionStateOnWorkersBeforePresenting) {
+    mEngine.setOutputWorkerCount(2);
+
+    Sequence seq;
+    EXPECT_CALL(mEngine, preComposition(Ref(mRefreshArgs))).InSequence(seq);
+    EXPECT_CALL(*mOutput1, prepare(Ref(mRefreshArgs), _)).InSequence(seq);
+    EXPECT_CALL(*mOutput2, prepare(Ref(mRefreshArgs), _)).InSequence(seq);
+    EXPECT_CALL(*mOutput1, updateLayerStateFromFE(Ref(mRefreshArgs))).InSequence(seq);
+    Expectation latched =
+            EXPECT_CALL(*mOutput2, updateLayerStateFromFE(Ref(mRefreshArgs))).InSequence(seq);
+
+    // The composition state of the outputs is updated in any order, possibly
+    // concurrently, before any of them is presented.
+    Expectation updated1 =
+            EXPECT_CALL(*mOutput1, updateCompositionState(Ref(mRefreshArgs))).After(latched);
+    Expectation updated2 =
+            EXPECT_CALL(*mOutput2, updateCompositionState(Ref(mRefreshArgs))).After(latched);
+
+    EXPECT_CALL(*mOutput1, present(Ref(mRefreshArgs))).After(updated1, updated2).InSequence(seq);
+    EXPECT_CALL(*mOutput2, present(Ref(mRefreshArgs))).InSequence(seq);
+
+    mRefreshArgs.outputs = {mOutput1, mOutput2};
+    mEngine.present(mRefreshArgs);
+}
+
+TEST_F(CompositionEnginePresentTest, presentsSingleOutputWithoutWorkers) {
+    mEngine.setOutputWorkerCount(2);
+
+    InSequence seq;
+    EXPECT_CALL(mEngine, preComposition(Ref(mRefreshArgs)));
+    EXPECT_CALL(*mOutput1, prepare(Ref(mRefreshArgs), _));
+    EXPECT_CALL(*mOutput1, updateLayerStateFromFE(Ref(mRefreshArgs)));
+    EXPECT_CALL(*mOutput1, present(Ref(mRefreshArgs)));
+
+    mRefreshArgs.outputs = {mOutput1};
+    mEngine.present(mRefreshArgs);
+}
+
 /*
  * CompositionEngine::updateCursorAsync
  */
@@ -124,6 +124,7 @@ struct DisplayTestCommon : public testing::Test {
         MOCK_METHOD1(applyChangedTypesToLayers, void(const impl::Display::ChangedTypes&));
         MOCK_METHOD1(applyDisplayRequests, void(const impl::Display::DisplayRequests&));
         MOCK_METHOD1(applyLayerRequestsToLayers, void(const impl::Display::LayerRequests&));
+        MOCK_CONST_METHOD0(getCompositionStrategyHash, size_t());
 
         const compositionengine::CompositionEngine& mCompositionEngine;
         impl::OutputCompositionState mState;
@@ -616,6 +617,7 @@ TEST_F(DisplayChooseCompositionStrategyTest, takesEarlyOutIfNotAHwcDisplay) {
 }
 
 TEST_F(DisplayChooseCompositionStrategyTest, takesEarlyOutOnHwcError) {
+    EXPECT_CALL(*mDisplay, getCompositionStrategyHash()).WillOnce(Return(1u));
     EXPECT_CALL(*mDisplay, anyLayersRequireClientComposition()).WillOnce(Return(false));
     EXPECT_CALL(mHwComposer, getDeviceCompositionChanges(DEFAULT_DISPLAY_ID, false, _))
             .WillOnce(Return(INVALID_OPERATION));
@@ -632,6 +634,7 @@ TEST_F(DisplayChooseCompositionStrategyTest, normalOperation) {
     // values, use a Sequence to control the matching so the values are returned in a known
     // order.
     Sequence s;
+    EXPECT_CALL(*mDisplay, getCompositionStrategyHash()).WillOnce(Return(1u));
     EXPECT_CALL(*mDisplay, anyLayersRequireClientComposition())
             .InSequence(s)
             .WillOnce(Return(true));
@@ -662,6 +665,7 @@ TEST_F(DisplayChooseCompositionStrategyTest, normalOperationWithChanges) {
     // values, use a Sequence to control the matching so the values are returned in a known
     // order.
     Sequence s;
+    EXPECT_CALL(*mDisplay, getCompositionStrategyHash()).WillOnce(Return(1u));
     EXPECT_CALL(*mDisplay, anyLayersRequireClientComposition())
             .InSequence(s)
             .WillOnce(Return(true));
@@ -683,6 +687,57 @@ TEST_F(DisplayChooseCompositionStrategyTest, normalOperationWithChanges) {
     EXPECT_TRUE(state.usesDeviceComposition);
 }
 
+TEST_F(DisplayChooseCompositionStrategyTest, predictsClientCompositionIfStateIsUnchanged) {
+    // The first frame ends up using client composition
+    EXPECT_CALL(*mDisplay, getCompositionStrategyHash()).WillRepeatedly(Return(1u));
+    EXPECT_CALL(*mDisplay, anyLayersRequireClientComposition())
+            .WillOnce(Return(false))
+            .WillOnce(Return(true));
+    EXPECT_CALL(mHwComposer, getDeviceCompositionChanges(DEFAULT_DISPLAY_ID, false, _))
+            .WillOnce(Return(NO_ERROR));
+    EXPECT_CALL(*mDisplay, allLayersRequireClientComposition()).WillOnce(Return(false));
+
+    mDisplay->chooseCompositionStrategy();
+
+    EXPECT_TRUE(mDisplay->getState().usesClientComposition);
+    EXPECT_FALSE(mDisplay->getState().predictedCompositionStrategy);
+
+    // The second frame has the same state, so the HWC is asked to validate rather than
+    // attempting to present right away.
+    EXPECT_CALL(*mDisplay, anyLayersRequireClientComposition())
+            .WillOnce(Return(false))
+            .WillOnce(Return(true));
+    EXPECT_CALL(mHwComposer, getDeviceCompositionChanges(DEFAULT_DISPLAY_ID, true, _))
+            .WillOnce(Return(NO_ERROR));
+    EXPECT_CALL(*mDisplay, allLayersRequireClientComposition()).WillOnce(Return(false));
+
+    mDisplay->chooseCompositionStrategy();
+
+    EXPECT_TRUE(mDisplay->getState().usesClientComposition);
+    EXPECT_TRUE(mDisplay->getState().predictedCompositionStrategy);
+}
+
+TEST_F(DisplayChooseCompositionStrategyTest, doesNotPredictIfStateChanged) {
+    EXPECT_CALL(*mDisplay, getCompositionStrategyHash())
+            .WillOnce(Return(1u))
+            .WillOnce(Return(2u));
+    EXPECT_CALL(*mDisplay, anyLayersRequireClientComposition())
+            .WillOnce(Return(false))
+            .WillOnce(Return(true))
+            .WillOnce(Return(false))
+            .WillOnce(Return(false));
+    EXPECT_CALL(mHwComposer, getDeviceCompositionChanges(DEFAULT_DISPLAY_ID, false, _))
+            .Times(2)
+            .WillRepeatedly(Return(NO_ERROR));
+    EXPECT_CALL(*mDisplay, allLayersRequireClientComposition()).WillRepeatedly(Return(false));
+
+    mDisplay->chooseCompositionStrategy();
+    mDisplay->chooseCompositionStrategy();
+
+    EXPECT_FALSE(mDisplay->getState().usesClientComposition);
+    EXPECT_FALSE(mDisplay->getState().predictedCompositionStrategy);
+}
+
 /*
  * Display::getSkipColorTransform()
  */
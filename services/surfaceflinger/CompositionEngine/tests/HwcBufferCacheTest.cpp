@@ -78,8 +78,74 @@ TEST_F(HwcBufferCacheTest, cacheWorksForMaxSlot) {
     testSlot(BufferQueue::NUM_BUFFER_SLOTS - 1, BufferQueue::NUM_BUFFER_SLOTS - 1);
 }
 
-TEST_F(HwcBufferCacheTest, cacheMapsNegativeSlotToZero) {
-    testSlot(-123, 0);
+TEST_F(HwcBufferCacheTest, cacheMapsNegativeSlotToZeroForNullBuffer) {
+    uint32_t outSlot;
+    sp<GraphicBuffer> outBuffer;
+
+    mCache.getHwcBuffer(-123, sp<GraphicBuffer>(), &outSlot, &outBuffer);
+    EXPECT_EQ(0u, outSlot);
+    EXPECT_EQ(nullptr, outBuffer.get());
+}
+
+TEST_F(HwcBufferCacheTest, cacheAssignsSlotsToBuffersWithoutSlot) {
+    uint32_t outSlot;
+    sp<GraphicBuffer> outBuffer;
+
+    mCache.getHwcBuffer(-123, mBuffer1, &outSlot, &outBuffer);
+    EXPECT_EQ(0u, outSlot);
+    EXPECT_EQ(mBuffer1, outBuffer);
+
+    // A new buffer does not replace the first one
+    mCache.getHwcBuffer(BufferQueue::INVALID_BUFFER_SLOT, mBuffer2, &outSlot, &outBuffer);
+    EXPECT_EQ(1u, outSlot);
+    EXPECT_EQ(mBuffer2, outBuffer);
+
+    // Both buffers are found in their slots without being sent again
+    mCache.getHwcBuffer(BufferQueue::INVALID_BUFFER_SLOT, mBuffer1, &outSlot, &outBuffer);
+    EXPECT_EQ(0u, outSlot);
+    EXPECT_EQ(nullptr, outBuffer.get());
+
+    mCache.getHwcBuffer(BufferQueue::INVALID_BUFFER_SLOT, mBuffer2, &outSlot, &outBuffer);
+    EXPECT_EQ(1u, outSlot);
+    EXPECT_EQ(nullptr, outBuffer.get());
+}
+
+TEST_F(HwcBufferCacheTest, cacheFindsBuffersInTheirBufferQueueSlot) {
+    uint32_t outSlot;
+    sp<GraphicBuffer> outBuffer;
+
+    mCache.getHwcBuffer(5, mBuffer1, &outSlot, &outBuffer);
+    EXPECT_EQ(5u, outSlot);
+    EXPECT_EQ(mBuffer1, outBuffer);
+
+    mCache.getHwcBuffer(BufferQueue::INVALID_BUFFER_SLOT, mBuffer1, &outSlot, &outBuffer);
+    EXPECT_EQ(5u, outSlot);
+    EXPECT_EQ(nullptr, outBuffer.get());
+}
+
+TEST_F(HwcBufferCacheTest, cacheEvictsLeastRecentlyUsedBuffer) {
+    impl::HwcBufferCache cache(2);
+    sp<GraphicBuffer> buffer3{new GraphicBuffer(1, 1, HAL_PIXEL_FORMAT_RGBA_8888, 1, 0)};
+    uint32_t outSlot;
+    sp<GraphicBuffer> outBuffer;
+
+    cache.getHwcBuffer(BufferQueue::INVALID_BUFFER_SLOT, mBuffer1, &outSlot, &outBuffer);
+    cache.getHwcBuffer(BufferQueue::INVALID_BUFFER_SLOT, mBuffer2, &outSlot, &outBuffer);
+    cache.getHwcBuffer(BufferQueue::INVALID_BUFFER_SLOT, mBuffer1, &outSlot, &outBuffer);
+
+    // The second buffer is the least recently used
+    cache.getHwcBuffer(BufferQueue::INVALID_BUFFER_SLOT, buffer3, &outSlot, &outBuffer);
+    EXPECT_EQ(1u, outSlot);
+    EXPECT_EQ(buffer3, outBuffer);
+
+    cache.getHwcBuffer(BufferQueue::INVALID_BUFFER_SLOT, mBuffer1, &outSlot, &outBuffer);
+    EXPECT_EQ(0u, outSlot);
+    EXPECT_EQ(nullptr, outBuffer.get());
+
+    // The second buffer is sent again, replacing the least recently used third one
+    cache.getHwcBuffer(BufferQueue::INVALID_BUFFER_SLOT, mBuffer2, &outSlot, &outBuffer);
+    EXPECT_EQ(1u, outSlot);
+    EXPECT_EQ(mBuffer2, outBuffer);
 }
 
 } // namespace
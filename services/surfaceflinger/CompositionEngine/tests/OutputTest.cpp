@@ -49,6 +49,7 @@ using testing::InSequence;
 using testing::Invoke;
 using testing::IsEmpty;
 using testing::Mock;
+using testing::NiceMock;
 using testing::Pointee;
 using testing::Property;
 using testing::Ref;
@@ -764,6 +765,69 @@ TEST_F(OutputUpdateAndWriteCompositionStateTest, forcesClientCompositionForAllLa
     mOutput->updateAndWriteCompositionState(args);
 }
 
+/*
+ * Output::updateCompositionState()
+ */
+
+struct OutputUpdateCompositionStateTest : public testing::Test {
+    struct OutputPartialMock : public OutputPartialMockBase {
+        // Sets up the helper functions called by the function under test to use
+        // mock implementations.
+        MOCK_METHOD1(updateColorProfile, void(const compositionengine::CompositionRefreshArgs&));
+    };
+
+    OutputUpdateCompositionStateTest() {
+        mOutput.mState.isEnabled = true;
+
+        EXPECT_CALL(mOutput, getOutputLayerCount()).WillRepeatedly(Return(2u));
+        EXPECT_CALL(mOutput, getOutputLayerOrderedByZByIndex(0))
+                .WillRepeatedly(Return(&mLayer1.outputLayer));
+        EXPECT_CALL(mOutput, getOutputLayerOrderedByZByIndex(1))
+                .WillRepeatedly(Return(&mLayer2.outputLayer));
+    }
+
+    StrictMock<OutputPartialMock> mOutput;
+    CompositionRefreshArgs mRefreshArgs;
+    NonInjectedLayer mLayer1;
+    NonInjectedLayer mLayer2;
+};
+
+TEST_F(OutputUpdateCompositionStateTest, updatesColorProfileAndLayersWithoutWritingToHWC) {
+    mRefreshArgs.updatingGeometryThisFrame = true;
+
+    InSequence seq;
+    EXPECT_CALL(mOutput, updateColorProfile(Ref(mRefreshArgs)));
+    EXPECT_CALL(mLayer1.outputLayer, updateCompositionState(true, false, ui::Transform::ROT_0));
+    EXPECT_CALL(mLayer2.outputLayer, updateCompositionState(true, false, ui::Transform::ROT_0));
+    EXPECT_CALL(mLayer1.outputLayer, writeStateToHWC(_)).Times(0);
+    EXPECT_CALL(mLayer2.outputLayer, writeStateToHWC(_)).Times(0);
+
+    mOutput.updateCompositionState(mRefreshArgs);
+}
+
+TEST_F(OutputUpdateCompositionStateTest, leavesOnlyWritingToHWCForUpdateAndWrite) {
+    mLayer2.layerFEState.backgroundBlurRadius = 10;
+
+    EXPECT_CALL(mOutput, updateColorProfile(Ref(mRefreshArgs)));
+    EXPECT_CALL(mLayer1.outputLayer, updateCompositionState(false, true, ui::Transform::ROT_0));
+    EXPECT_CALL(mLayer2.outputLayer, updateCompositionState(false, true, ui::Transform::ROT_0));
+    mOutput.updateCompositionState(mRefreshArgs);
+
+    EXPECT_CALL(mLayer1.outputLayer, writeStateToHWC(false));
+    EXPECT_CALL(mLayer2.outputLayer, writeStateToHWC(false));
+    mOutput.updateAndWriteCompositionState(mRefreshArgs);
+}
+
+TEST_F(OutputUpdateCompositionStateTest, doesNotUpdateLayersIfOutputNotEnabled) {
+    mOutput.mState.isEnabled = false;
+
+    EXPECT_CALL(mOutput, updateColorProfile(Ref(mRefreshArgs)));
+    EXPECT_CALL(mLayer1.outputLayer, updateCompositionState(_, _, _)).Times(0);
+    EXPECT_CALL(mLayer2.outputLayer, updateCompositionState(_, _, _)).Times(0);
+
+    mOutput.updateCompositionState(mRefreshArgs);
+}
+
 /*
  * Output::prepareFrame()
  */
@@ -1534,6 +1598,178 @@ TEST_F(OutputEnsureOutputLayerIfVisibleTest, takesNotSoEarlyOutifLayerWithShadow
     ensureOutputLayerIfVisible();
 }
 
+/*
+ * Output::setIncrementalVisibilityEnabled()
+ */
+
+struct OutputIncrementalVisibilityTest : public testing::Test {
+    struct Layer {
+        explicit Layer(const Rect& bounds) {
+            ON_CALL(*layerFE, getCompositionState()).WillByDefault(Return(&layerFEState));
+            ON_CALL(*layerFE, getDebugName()).WillByDefault(Return("layer"));
+
+            layerFEState.layerStackId = kLayerStack;
+            layerFEState.isVisible = true;
+            layerFEState.isOpaque = true;
+            setBounds(bounds);
+        }
+
+        void setBounds(const Rect& bounds) {
+            layerFEState.geomLayerBounds = FloatRect{0, 0, static_cast<float>(bounds.getWidth()),
+                                                     static_cast<float>(bounds.getHeight())};
+            layerFEState.geomLayerTransform = ui::Transform(TR_IDENT, bounds.left, bounds.top);
+        }
+
+        sp<NiceMock<mock::LayerFE>> layerFE = new NiceMock<mock::LayerFE>();
+        LayerFECompositionState layerFEState;
+    };
+
+    OutputIncrementalVisibilityTest() {
+        mIncrementalOutput->setIncrementalVisibilityEnabled(true);
+        for (auto& output : {mOutput, mIncrementalOutput}) {
+            output->setLayerStackFilter(kLayerStack, false);
+            output->editState().isEnabled = true;
+            output->editState().bounds = kDisplayBounds;
+            output->editState().viewport = kDisplayBounds;
+            output->editState().transform = ui::Transform(TR_IDENT, 0, 0);
+        }
+
+        mRefreshArgs.updatingOutputGeometryThisFrame = true;
+        mRefreshArgs.layers.push_back(mBottomLayer.layerFE);
+        mRefreshArgs.layers.push_back(mMiddleLayer.layerFE);
+        mRefreshArgs.layers.push_back(mTopLayer.layerFE);
+    }
+
+    // Rebuilds both outputs, and expects the incremental one to come to the
+    // same result as the one computing everything again.
+    void rebuildAndCompare() {
+        LayerFESet geomSnapshots;
+        mOutput->rebuildLayerStacks(mRefreshArgs, geomSnapshots);
+        LayerFESet incrementalGeomSnapshots;
+        mIncrementalOutput->rebuildLayerStacks(mRefreshArgs, incrementalGeomSnapshots);
+
+        const auto& state = mOutput->getState();
+        const auto& incrementalState = mIncrementalOutput->getState();
+        EXPECT_THAT(incrementalState.dirtyRegion, RegionEq(state.dirtyRegion));
+        EXPECT_THAT(incrementalState.undefinedRegion, RegionEq(state.undefinedRegion));
+
+        ASSERT_EQ(mOutput->getOutputLayerCount(), mIncrementalOutput->getOutputLayerCount());
+        for (size_t i = 0; i < mOutput->getOutputLayerCount(); i++) {
+            const auto* outputLayer = mOutput->getOutputLayerOrderedByZByIndex(i);
+            const auto* incrementalLayer = mIncrementalOutput->getOutputLayerOrderedByZByIndex(i);
+            EXPECT_EQ(&outputLayer->getLayerFE(), &incrementalLayer->getLayerFE());
+
+            const auto& layerState = outputLayer->getState();
+            const auto& incrementalLayerState = incrementalLayer->getState();
+            EXPECT_THAT(incrementalLayerState.visibleRegion, RegionEq(layerState.visibleRegion));
+            EXPECT_THAT(incrementalLayerState.visibleNonTransparentRegion,
+                        RegionEq(layerState.visibleNonTransparentRegion));
+            EXPECT_THAT(incrementalLayerState.coveredRegion, RegionEq(layerState.coveredRegion));
+            EXPECT_THAT(incrementalLayerState.outputSpaceVisibleRegion,
+                        RegionEq(layerState.outputSpaceVisibleRegion));
+        }
+
+        for (auto& output : {mOutput, mIncrementalOutput}) {
+            output->editState().dirtyRegion.clear();
+        }
+    }
+
+    // Sets a shadow region the layers do not have to each output layer of the
+    // incremental output, which is only kept if the layer is not recomputed.
+    void markIncrementalLayers() {
+        for (size_t i = 0; i < mIncrementalOutput->getOutputLayerCount(); i++) {
+            mIncrementalOutput->getOutputLayerOrderedByZByIndex(i)->editState().shadowRegion =
+                    kMarker;
+        }
+    }
+
+    bool isIncrementalLayerMarked(size_t index) const {
+        return mIncrementalOutput->getOutputLayerOrderedByZByIndex(index)
+                ->getState()
+                .shadowRegion.hasSameRects(kMarker);
+    }
+
+    static constexpr uint32_t kLayerStack = 1u;
+    static const Rect kDisplayBounds;
+    static const Region kMarker;
+
+    StrictMock<mock::CompositionEngine> mCompositionEngine;
+    std::shared_ptr<OutputTest::Output> mOutput = OutputTest::createOutput(mCompositionEngine);
+    std::shared_ptr<OutputTest::Output> mIncrementalOutput =
+            OutputTest::createOutput(mCompositionEngine);
+    CompositionRefreshArgs mRefreshArgs;
+
+    Layer mBottomLayer{Rect(0, 0, 100, 200)};
+    Layer mMiddleLayer{Rect(0, 50, 100, 150)};
+    Layer mTopLayer{Rect(50, 0, 100, 100)};
+};
+
+const Rect OutputIncrementalVisibilityTest::kDisplayBounds{100, 200};
+const Region OutputIncrementalVisibilityTest::kMarker{Rect(1, 2, 3, 4)};
+
+TEST_F(OutputIncrementalVisibilityTest, matchesFullComputationAcrossChanges) {
+    rebuildAndCompare();
+
+    // Nothing changed
+    rebuildAndCompare();
+
+    // Only the content of a layer changed
+    mMiddleLayer.layerFEState.contentDirty = true;
+    rebuildAndCompare();
+    mMiddleLayer.layerFEState.contentDirty = false;
+    rebuildAndCompare();
+
+    // A layer on top moved, which changes the layers below it
+    mTopLayer.setBounds(Rect(0, 100, 50, 200));
+    rebuildAndCompare();
+
+    // A layer became translucent
+    mMiddleLayer.layerFEState.isOpaque = false;
+    rebuildAndCompare();
+
+    // A layer is no longer visible, and another one was removed
+    mTopLayer.layerFEState.isVisible = false;
+    rebuildAndCompare();
+    mRefreshArgs.layers.erase(mRefreshArgs.layers.begin() + 1);
+    rebuildAndCompare();
+
+    // The output changed
+    for (auto& output : {mOutput, mIncrementalOutput}) {
+        output->editState().transform = ui::Transform(TR_IDENT, 10, 10);
+    }
+    rebuildAndCompare();
+}
+
+TEST_F(OutputIncrementalVisibilityTest, reusesResultOfUnchangedLayers) {
+    rebuildAndCompare();
+    ASSERT_EQ(3u, mIncrementalOutput->getOutputLayerCount());
+    markIncrementalLayers();
+
+    // Nothing changed
+    rebuildAndCompare();
+    ASSERT_EQ(3u, mIncrementalOutput->getOutputLayerCount());
+    EXPECT_TRUE(isIncrementalLayerMarked(0));
+    EXPECT_TRUE(isIncrementalLayerMarked(1));
+    EXPECT_TRUE(isIncrementalLayerMarked(2));
+
+    // Only the bottom layer is below the one changing
+    mMiddleLayer.setBounds(Rect(0, 60, 100, 160));
+    rebuildAndCompare();
+    ASSERT_EQ(3u, mIncrementalOutput->getOutputLayerCount());
+    EXPECT_FALSE(isIncrementalLayerMarked(0));
+    EXPECT_FALSE(isIncrementalLayerMarked(1));
+    EXPECT_TRUE(isIncrementalLayerMarked(2));
+}
+
+TEST_F(OutputIncrementalVisibilityTest, disablingDropsReusableResults) {
+    rebuildAndCompare();
+    markIncrementalLayers();
+
+    mIncrementalOutput->setIncrementalVisibilityEnabled(false);
+    rebuildAndCompare();
+    EXPECT_FALSE(isIncrementalLayerMarked(2));
+}
+
 /*
  * Output::present()
  */
@@ -1572,6 +1808,34 @@ TEST_F(OutputPresentTest, justInvokesChildFunctionsInSequence) {
     mOutput.present(args);
 }
 
+TEST_F(OutputPresentTest, skipsColorProfileUpdateAfterUpdateCompositionState) {
+    CompositionRefreshArgs args;
+
+    InSequence seq;
+    EXPECT_CALL(mOutput, updateColorProfile(Ref(args)));
+    mOutput.updateCompositionState(args);
+
+    EXPECT_CALL(mOutput, updateAndWriteCompositionState(Ref(args)));
+    EXPECT_CALL(mOutput, setColorTransform(Ref(args)));
+    EXPECT_CALL(mOutput, beginFrame());
+    EXPECT_CALL(mOutput, prepareFrame());
+    EXPECT_CALL(mOutput, devOptRepaintFlash(Ref(args)));
+    EXPECT_CALL(mOutput, finishFrame(Ref(args)));
+    EXPECT_CALL(mOutput, postFramebuffer());
+    mOutput.present(args);
+
+    // The next frame is updated by present() again
+    EXPECT_CALL(mOutput, updateColorProfile(Ref(args)));
+    EXPECT_CALL(mOutput, updateAndWriteCompositionState(Ref(args)));
+    EXPECT_CALL(mOutput, setColorTransform(Ref(args)));
+    EXPECT_CALL(mOutput, beginFrame());
+    EXPECT_CALL(mOutput, prepareFrame());
+    EXPECT_CALL(mOutput, devOptRepaintFlash(Ref(args)));
+    EXPECT_CALL(mOutput, finishFrame(Ref(args)));
+    EXPECT_CALL(mOutput, postFramebuffer());
+    mOutput.present(args);
+}
+
 /*
  * Output::updateColorProfile()
  */
@@ -1691,6 +1955,43 @@ TEST_F(OutputUpdateColorProfileTest_GetBestColorModeResultBecomesSetProfile,
             .execute();
 }
 
+TEST_F(OutputUpdateColorProfileTest, reusesColorProfileUntilLayerDataspacesChange) {
+    EXPECT_CALL(mOutput, getOutputLayerCount()).WillRepeatedly(Return(1u));
+    mLayer1.mLayerFEState.dataspace = ui::Dataspace::V0_SRGB;
+    mRefreshArgs.outputColorSetting = OutputColorSetting::kEnhanced;
+    mRefreshArgs.colorSpaceAgnosticDataspace = ui::Dataspace::UNKNOWN;
+
+    EXPECT_CALL(*mDisplayColorProfile,
+                getBestColorMode(ui::Dataspace::V0_SRGB, ui::RenderIntent::ENHANCE, _, _, _))
+            .WillOnce(DoAll(SetArgPointee<2>(ui::Dataspace::V0_SRGB),
+                            SetArgPointee<3>(ui::ColorMode::SRGB),
+                            SetArgPointee<4>(ui::RenderIntent::ENHANCE)));
+    EXPECT_CALL(mOutput,
+                setColorProfile(ColorProfileEq(ColorProfile{ui::ColorMode::SRGB,
+                                                            ui::Dataspace::V0_SRGB,
+                                                            ui::RenderIntent::ENHANCE,
+                                                            ui::Dataspace::UNKNOWN})))
+            .Times(2);
+
+    mOutput.updateColorProfile(mRefreshArgs);
+    mOutput.updateColorProfile(mRefreshArgs);
+
+    mLayer1.mLayerFEState.dataspace = ui::Dataspace::DISPLAY_P3;
+
+    EXPECT_CALL(*mDisplayColorProfile,
+                getBestColorMode(ui::Dataspace::DISPLAY_P3, ui::RenderIntent::ENHANCE, _, _, _))
+            .WillOnce(DoAll(SetArgPointee<2>(ui::Dataspace::DISPLAY_P3),
+                            SetArgPointee<3>(ui::ColorMode::DISPLAY_P3),
+                            SetArgPointee<4>(ui::RenderIntent::ENHANCE)));
+    EXPECT_CALL(mOutput,
+                setColorProfile(ColorProfileEq(ColorProfile{ui::ColorMode::DISPLAY_P3,
+                                                            ui::Dataspace::DISPLAY_P3,
+                                                            ui::RenderIntent::ENHANCE,
+                                                            ui::Dataspace::UNKNOWN})));
+
+    mOutput.updateColorProfile(mRefreshArgs);
+}
+
 struct OutputUpdateColorProfileTest_ColorSpaceAgnosticeDataspaceAffectsSetColorProfile
       : public OutputUpdateColorProfileTest {
     OutputUpdateColorProfileTest_ColorSpaceAgnosticeDataspaceAffectsSetColorProfile() {
@@ -0,0 +1,65 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#include <compositionengine/impl/WorkerPool.h>
+#include <gtest/gtest.h>
+
+namespace android::compositionengine {
+namespace {
+
+TEST(WorkerPoolTest, runsAllTasksBeforeReturning) {
+    impl::WorkerPool pool(2);
+    EXPECT_EQ(2u, pool.getThreadCount());
+
+    for (int round = 0; round < 100; round++) {
+        std::atomic<int> done = 0;
+        std::vector<impl::WorkerPool::Task> tasks(5, [&] { done++; });
+        pool.run(tasks);
+        EXPECT_EQ(5, done);
+    }
+}
+
+TEST(WorkerPoolTest, runsTasksConcurrently) {
+    impl::WorkerPool pool(2);
+
+    // Each task waits for all of them to start, so this only returns if they
+    // run on three threads at once.
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::set<std::thread::id> threads;
+    auto task = [&] {
+        std::unique_lock lock(mutex);
+        threads.insert(std::this_thread::get_id());
+        cv.notify_all();
+        cv.wait(lock, [&] { return threads.size() == 3; });
+    };
+    pool.run({task, task, task});
+
+    EXPECT_EQ(1u, threads.count(std::this_thread::get_id()));
+}
+
+TEST(WorkerPoolTest, runsNothingWithoutTasks) {
+    impl::WorkerPool pool(1);
+    pool.run({});
+}
+
+} // namespace
+} // namespace android::compositionengine
@@ -0,0 +1,57 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <memory>
+#include <utility>
+
+namespace android {
+
+// Value whose copies share their storage until they are modified through edit(),
+// so that copying a large value that rarely changes costs a reference count
+// increment. Copies sharing storage may be read concurrently, but edit() must
+// not race with copying the value being edited.
+template <typename T>
+class CopyOnWrite {
+public:
+    CopyOnWrite() : mValue(std::make_shared<T>()) {}
+    CopyOnWrite(T value) : mValue(std::make_shared<T>(std::move(value))) {}
+
+    CopyOnWrite& operator=(T value) {
+        mValue = std::make_shared<T>(std::move(value));
+        return *this;
+    }
+
+    const T& get() const { return *mValue; }
+    const T& operator*() const { return *mValue; }
+    const T* operator->() const { return mValue.get(); }
+
+    // Returns the value for modification, copying it first if it is shared.
+    T& edit() {
+        if (mValue.use_count() > 1) {
+            mValue = std::make_shared<T>(*mValue);
+        }
+        return *mValue;
+    }
+
+    bool sharesStorageWith(const CopyOnWrite& other) const { return mValue == other.mValue; }
+
+private:
+    std::shared_ptr<T> mValue;
+};
+
+} // namespace android
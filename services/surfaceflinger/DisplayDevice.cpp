@@ -76,6 +76,9 @@ DisplayDevice::DisplayDevice(DisplayDeviceCreationArgs& args)
                 static_cast<uint32_t>(SurfaceFlinger::maxFrameBufferAcquiredBuffers));
     }
 
+    mCompositionDisplay->setIncrementalVisibilityEnabled(mFlinger->mIncrementalVisibility);
+    mCompositionDisplay->setLayerGroupCachingEnabled(mFlinger->mLayerGroupCaching);
+
     mCompositionDisplay->createDisplayColorProfile(
             compositionengine::DisplayColorProfileCreationArgs{args.hasWideColorGamut,
                                                                std::move(args.hdrCapabilities),
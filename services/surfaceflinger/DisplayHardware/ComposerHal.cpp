@@ -20,6 +20,7 @@
 
 #undef LOG_TAG
 #define LOG_TAG "HwcComposer"
+#define ATRACE_TAG ATRACE_TAG_GRAPHICS
 
 #include <log/log.h>
 
@@ -28,10 +29,13 @@
 
 #include "ComposerHal.h"
 
+#include <android-base/stringprintf.h>
 #include <composer-command-buffer/2.2/ComposerCommandBuffer.h>
 #include <gui/BufferQueue.h>
 #include <hidl/HidlTransportSupport.h>
 #include <hidl/HidlTransportUtils.h>
+#include <utils/Timers.h>
+#include <utils/Trace.h>
 
 namespace android {
 
@@ -180,6 +184,17 @@ std::string Composer::dumpDebugInfo()
         info = tmpInfo.c_str();
     });
 
+    std::lock_guard lock(mExecuteStatsMutex);
+    if (!mExecuteStats.empty()) {
+        info.append("\nexecuteCommands latency (count / mean / max ms):\n");
+        for (const auto& [name, stats] : mExecuteStats) {
+            info.append(base::StringPrintf("  %-24s %8" PRIu64 " / %.3f / %.3f\n", name.c_str(),
+                                           stats.count,
+                                           ns2us(stats.totalDuration / stats.count) / 1000.0,
+                                           ns2us(stats.maxDuration) / 1000.0));
+        }
+    }
+
     return info;
 }
 
@@ -202,7 +217,7 @@ void Composer::resetCommands() {
 }
 
 Error Composer::executeCommands() {
-    return execute();
+    return execute("executeCommands");
 }
 
 uint32_t Composer::getMaxVirtualDisplayCount()
@@ -495,7 +510,7 @@ Error Composer::presentDisplay(Display display, int* outPresentFence)
     mWriter.selectDisplay(display);
     mWriter.presentDisplay();
 
-    Error error = execute();
+    Error error = execute("presentDisplay");
     if (error != Error::NONE) {
         return error;
     }
@@ -589,7 +604,7 @@ Error Composer::validateDisplay(Display display, uint32_t* outNumTypes,
     mWriter.selectDisplay(display);
     mWriter.validateDisplay();
 
-    Error error = execute();
+    Error error = execute("validateDisplay");
     if (error != Error::NONE) {
         return error;
     }
@@ -604,7 +619,7 @@ Error Composer::presentOrValidateDisplay(Display display, uint32_t* outNumTypes,
    mWriter.selectDisplay(display);
    mWriter.presentOrvalidateDisplay();
 
-   Error error = execute();
+   Error error = execute("presentOrValidateDisplay");
    if (error != Error::NONE) {
        return error;
    }
@@ -753,8 +768,9 @@ Error Composer::setLayerZOrder(Display display, Layer layer, uint32_t z)
     return Error::NONE;
 }
 
-Error Composer::execute()
+Error Composer::execute(const char* name)
 {
+    ATRACE_NAME(name);
     // prepare input command queue
     bool queueChanged = false;
     uint32_t commandLength = 0;
@@ -779,6 +795,7 @@ Error Composer::execute()
         return Error::NONE;
     }
 
+    const nsecs_t startTime = systemTime();
     Error error = kDefaultError;
     hardware::Return<void> ret;
     auto hidl_callback = [&](const auto& tmpError, const auto& tmpOutChanged,
@@ -823,6 +840,7 @@ Error Composer::execute()
     if (!ret.isOk()) {
         ALOGE("executeCommands failed because of %s", ret.description().c_str());
     }
+    recordExecuteDuration(name, systemTime() - startTime);
 
     if (error == Error::NONE) {
         std::vector<CommandReader::CommandError> commandErrors =
@@ -848,6 +866,18 @@ Error Composer::execute()
     return error;
 }
 
+void Composer::recordExecuteDuration(std::string_view name, nsecs_t duration) {
+    std::lock_guard lock(mExecuteStatsMutex);
+    auto it = mExecuteStats.find(name);
+    if (it == mExecuteStats.end()) {
+        it = mExecuteStats.emplace(name, ExecuteStats{}).first;
+    }
+    ExecuteStats& stats = it->second;
+    stats.count++;
+    stats.totalDuration += duration;
+    stats.maxDuration = std::max(stats.maxDuration, duration);
+}
+
 // Composer HAL 2.2
 
 Error Composer::setLayerPerFrameMetadata(Display display, Layer layer,
@@ -17,8 +17,11 @@
 #ifndef ANDROID_SF_COMPOSER_HAL_H
 #define ANDROID_SF_COMPOSER_HAL_H
 
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -27,6 +30,7 @@
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wconversion"
 
+#include <android-base/thread_annotations.h>
 #include <android/hardware/graphics/common/1.1/types.h>
 #include <android/hardware/graphics/composer/2.4/IComposer.h>
 #include <android/hardware/graphics/composer/2.4/IComposerClient.h>
@@ -36,6 +40,7 @@
 #include <ui/DisplayedFrameStats.h>
 #include <ui/GraphicBuffer.h>
 #include <utils/StrongPointer.h>
+#include <utils/Timers.h>
 
 // TODO(b/129481165): remove the #pragma below and fix conversion issues
 #pragma clang diagnostic pop // ignored "-Wconversion"
@@ -477,8 +482,11 @@ private:
 
     // Many public functions above simply write a command into the command
     // queue to batch the calls.  validateDisplay and presentDisplay will call
-    // this function to execute the command queue.
-    Error execute();
+    // this function to execute the command queue. 'name' identifies the
+    // caller in traces and in the latency stats.
+    Error execute(const char* name);
+
+    void recordExecuteDuration(std::string_view name, nsecs_t duration);
 
     sp<V2_1::IComposer> mComposer;
 
@@ -492,6 +500,16 @@ private:
         64 * 1024 / sizeof(uint32_t) - 16;
     CommandWriter mWriter;
     CommandReader mReader;
+
+    // Latency of the executeCommands round trips, per caller of execute()
+    struct ExecuteStats {
+        uint64_t count = 0;
+        nsecs_t totalDuration = 0;
+        nsecs_t maxDuration = 0;
+    };
+    std::mutex mExecuteStatsMutex;
+    std::map<std::string, ExecuteStats, std::less<>> mExecuteStats
+            GUARDED_BY(mExecuteStatsMutex);
 };
 
 } // namespace impl
@@ -469,13 +469,13 @@ void Layer::prepareBasicGeometryCompositionState() {
 void Layer::prepareGeometryCompositionState() {
     const auto& drawingState{getDrawingState()};
 
-    int type = drawingState.metadata.getInt32(METADATA_WINDOW_TYPE, 0);
-    int appId = drawingState.metadata.getInt32(METADATA_OWNER_UID, 0);
+    int type = drawingState.metadata->getInt32(METADATA_WINDOW_TYPE, 0);
+    int appId = drawingState.metadata->getInt32(METADATA_OWNER_UID, 0);
     sp<Layer> parent = mDrawingParent.promote();
     if (parent.get()) {
         auto& parentState = parent->getDrawingState();
-        const int parentType = parentState.metadata.getInt32(METADATA_WINDOW_TYPE, 0);
-        const int parentAppId = parentState.metadata.getInt32(METADATA_OWNER_UID, 0);
+        const int parentType = parentState.metadata->getInt32(METADATA_WINDOW_TYPE, 0);
+        const int parentAppId = parentState.metadata->getInt32(METADATA_OWNER_UID, 0);
         if (parentType > 0 && parentAppId > 0) {
             type = parentType;
             appId = parentAppId;
@@ -503,8 +503,8 @@ void Layer::prepareGeometryCompositionState() {
         }
         const uint32_t id = compatIter->second;
 
-        auto it = drawingState.metadata.mMap.find(id);
-        if (it == std::end(drawingState.metadata.mMap)) {
+        auto it = drawingState.metadata->mMap.find(id);
+        if (it == std::end(drawingState.metadata->mMap)) {
             continue;
         }
 
@@ -1275,7 +1275,7 @@ bool Layer::setOverrideScalingMode(int32_t scalingMode) {
 }
 
 bool Layer::setMetadata(const LayerMetadata& data) {
-    if (!mCurrentState.metadata.merge(data, true /* eraseEmpty */)) return false;
+    if (!mCurrentState.metadata.edit().merge(data, true /* eraseEmpty */)) return false;
     mCurrentState.sequence++;
     mCurrentState.modified = true;
     setTransactionFlags(eTransactionNeeded);
@@ -1677,6 +1677,17 @@ void Layer::dumpCallingUidPid(std::string& result) const {
                   mCallingPid, mCallingUid);
 }
 
+uid_t Layer::getOwnerUid() const {
+    const int32_t ownerUid = mDrawingState.metadata->getInt32(METADATA_OWNER_UID, -1);
+    if (ownerUid >= 0) {
+        return static_cast<uid_t>(ownerUid);
+    }
+    if (const sp<Layer> parent = mDrawingParent.promote()) {
+        return parent->getOwnerUid();
+    }
+    return mCallingUid;
+}
+
 void Layer::onDisconnect() {
     Mutex::Autolock lock(mFrameEventHistoryMutex);
     mFrameEventHistory.onDisconnect();
@@ -1689,7 +1700,8 @@ void Layer::addAndGetFrameTimestamps(const NewFrameEventsEntry* newTimestamps,
                                      FrameEventHistoryDelta* outDelta) {
     if (newTimestamps) {
         mFlinger->mTimeStats->setPostTime(getSequence(), newTimestamps->frameNumber,
-                                          getName().c_str(), newTimestamps->postedTime);
+                                          getName().c_str(), mCallingUid,
+                                          newTimestamps->postedTime);
         mFlinger->mTimeStats->setAcquireFence(getSequence(), newTimestamps->frameNumber,
                                               newTimestamps->acquireFence);
     }
@@ -1711,6 +1723,11 @@ void Layer::addAndGetFrameTimestamps(const NewFrameEventsEntry* newTimestamps,
     }
 }
 
+status_t Layer::getFrameTimestampsMemory(base::unique_fd* outFd) {
+    Mutex::Autolock lock(mFrameEventHistoryMutex);
+    return mFrameEventHistory.shareTimestamps(outFd);
+}
+
 size_t Layer::getChildrenCount() const {
     size_t count = 0;
     for (const sp<Layer>& child : mCurrentChildren) {
@@ -2349,13 +2366,13 @@ void Layer::writeToProtoCommonState(LayerProto* layerInfo, LayerVector::StateSet
     }
 
     if (traceFlags & SurfaceTracing::TRACE_INPUT) {
-        LayerProtoHelper::writeToProto(state.inputInfo, state.touchableRegionCrop,
+        LayerProtoHelper::writeToProto(*state.inputInfo, state.touchableRegionCrop,
                                        [&]() { return layerInfo->mutable_input_window_info(); });
     }
 
     if (traceFlags & SurfaceTracing::TRACE_EXTRA) {
         auto protoMap = layerInfo->mutable_metadata();
-        for (const auto& entry : state.metadata.mMap) {
+        for (const auto& entry : state.metadata->mMap) {
             (*protoMap)[entry.first] = std::string(entry.second.cbegin(), entry.second.cend());
         }
     }
@@ -2367,16 +2384,16 @@ bool Layer::isRemovedFromCurrentState() const  {
 
 InputWindowInfo Layer::fillInputInfo() {
     if (!hasInputInfo()) {
-        mDrawingState.inputInfo.name = getName();
-        mDrawingState.inputInfo.ownerUid = mCallingUid;
-        mDrawingState.inputInfo.ownerPid = mCallingPid;
-        mDrawingState.inputInfo.inputFeatures =
-            InputWindowInfo::INPUT_FEATURE_NO_INPUT_CHANNEL;
-        mDrawingState.inputInfo.layoutParamsFlags = InputWindowInfo::FLAG_NOT_TOUCH_MODAL;
-        mDrawingState.inputInfo.displayId = getLayerStack();
+        InputWindowInfo& inputInfo = mDrawingState.inputInfo.edit();
+        inputInfo.name = getName();
+        inputInfo.ownerUid = mCallingUid;
+        inputInfo.ownerPid = mCallingPid;
+        inputInfo.inputFeatures = InputWindowInfo::INPUT_FEATURE_NO_INPUT_CHANNEL;
+        inputInfo.layoutParamsFlags = InputWindowInfo::FLAG_NOT_TOUCH_MODAL;
+        inputInfo.displayId = getLayerStack();
     }
 
-    InputWindowInfo info = mDrawingState.inputInfo;
+    InputWindowInfo info = *mDrawingState.inputInfo;
     info.id = sequence;
 
     if (info.displayId == ADISPLAY_ID_NONE) {
@@ -2474,7 +2491,7 @@ sp<Layer> Layer::getClonedRoot() {
 }
 
 bool Layer::hasInputInfo() const {
-    return mDrawingState.inputInfo.token != nullptr;
+    return mDrawingState.inputInfo->token != nullptr;
 }
 
 bool Layer::canReceiveInput() const {
@@ -2582,7 +2599,7 @@ void Layer::updateClonedInputInfo(const std::map<sp<Layer>, sp<Layer>>& clonedLa
     }
     // Cloned layers shouldn't handle watch outside since their z order is not determined by
     // WM or the client.
-    mDrawingState.inputInfo.layoutParamsFlags &= ~InputWindowInfo::FLAG_WATCH_OUTSIDE_TOUCH;
+    mDrawingState.inputInfo.edit().layoutParamsFlags &= ~InputWindowInfo::FLAG_WATCH_OUTSIDE_TOUCH;
 }
 
 void Layer::updateClonedRelatives(const std::map<sp<Layer>, sp<Layer>>& clonedLayersMap) {
@@ -39,10 +39,12 @@
 #include <cstdint>
 #include <list>
 #include <optional>
+#include <unordered_map>
 #include <vector>
 
 #include "Client.h"
 #include "ClientCache.h"
+#include "CopyOnWrite.h"
 #include "DisplayHardware/ComposerHal.h"
 #include "DisplayHardware/HWComposer.h"
 #include "FrameTracker.h"
@@ -208,7 +210,9 @@ public:
         Region activeTransparentRegion_legacy;
         Region requestedTransparentRegion_legacy;
 
-        LayerMetadata metadata;
+        // Metadata and input info are shared with the copies of the state, such as the
+        // drawing state, until modified.
+        CopyOnWrite<LayerMetadata> metadata;
 
         // If non-null, a Surface this Surface's Z-order is interpreted relative to.
         wp<Layer> zOrderRelativeOf;
@@ -222,7 +226,7 @@ public:
         int backgroundBlurRadius;
 
         bool inputInfoChanged;
-        InputWindowInfo inputInfo;
+        CopyOnWrite<InputWindowInfo> inputInfo;
         wp<Layer> touchableRegionCrop;
 
         // dataspace is only used by BufferStateLayer and EffectLayer
@@ -703,6 +707,18 @@ public:
 
     virtual sp<GraphicBuffer> getBuffer() const { return nullptr; }
 
+    /*
+     * Adds the buffers this layer keeps alive, keyed by buffer ID. Called from the main thread.
+     */
+    virtual void getHeldBuffers(
+            std::unordered_map<uint64_t, sp<GraphicBuffer>>& /*outBuffers*/) const {}
+
+    /*
+     * Returns the uid of the app the layer belongs to, falling back to the nearest ancestor's,
+     * and then to the uid which created the layer.
+     */
+    uid_t getOwnerUid() const;
+
     virtual ui::Transform::RotationFlags getTransformHint() const { return ui::Transform::ROT_0; }
 
     /*
@@ -735,6 +751,7 @@ public:
     void onDisconnect();
     void addAndGetFrameTimestamps(const NewFrameEventsEntry* newEntry,
                                   FrameEventHistoryDelta* outDelta);
+    status_t getFrameTimestampsMemory(base::unique_fd* outFd);
 
     virtual bool getTransformToDisplayInverse() const { return false; }
 
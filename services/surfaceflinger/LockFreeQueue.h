@@ -0,0 +1,81 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <utility>
+#include <vector>
+
+namespace android {
+
+// Queue which any number of threads can push to without taking a lock. The
+// items are consumed all at once, in the order they were pushed, by a single
+// consumer at a time.
+template <typename T>
+class LockFreeQueue {
+public:
+    LockFreeQueue() = default;
+    LockFreeQueue(const LockFreeQueue&) = delete;
+    LockFreeQueue& operator=(const LockFreeQueue&) = delete;
+
+    ~LockFreeQueue() { popAll(); }
+
+    void push(T item) {
+        Node* node = new Node{std::move(item), mHead.load(std::memory_order_relaxed)};
+        while (!mHead.compare_exchange_weak(node->next, node, std::memory_order_release,
+                                            std::memory_order_relaxed)) {
+        }
+    }
+
+    bool empty() const { return mHead.load(std::memory_order_acquire) == nullptr; }
+
+    // Returns the items pushed so far, oldest first. Must not be called
+    // concurrently with itself.
+    std::vector<T> popAll() {
+        // The list is newest first, so reverse it
+        Node* node = mHead.exchange(nullptr, std::memory_order_acquire);
+        Node* oldest = nullptr;
+        size_t count = 0;
+        while (node) {
+            Node* const next = node->next;
+            node->next = oldest;
+            oldest = node;
+            node = next;
+            count++;
+        }
+
+        std::vector<T> items;
+        items.reserve(count);
+        while (oldest) {
+            Node* const next = oldest->next;
+            items.push_back(std::move(oldest->item));
+            delete oldest;
+            oldest = next;
+        }
+        return items;
+    }
+
+private:
+    struct Node {
+        T item;
+        Node* next;
+    };
+
+    std::atomic<Node*> mHead{nullptr};
+};
+
+} // namespace android
@@ -144,6 +144,10 @@ void MonitoredProducer::getFrameTimestamps(FrameEventHistoryDelta* outDelta) {
     mProducer->getFrameTimestamps(outDelta);
 }
 
+status_t MonitoredProducer::getFrameTimestampsMemory(base::unique_fd* outFd) {
+    return mProducer->getFrameTimestampsMemory(outFd);
+}
+
 status_t MonitoredProducer::getUniqueId(uint64_t* outId) const {
     return mProducer->getUniqueId(outId);
 }
@@ -92,6 +92,10 @@ void DispSyncSource::setPhaseOffset(nsecs_t phaseOffset) {
     }
 }
 
+nsecs_t DispSyncSource::getPeriod() const {
+    return mDispSync->getPeriod();
+}
+
 void DispSyncSource::onDispSyncEvent(nsecs_t when, nsecs_t expectedVSyncTimestamp) {
     VSyncSource::Callback* callback;
     {
@@ -22,10 +22,12 @@
 
 #include <pthread.h>
 #include <sched.h>
+#include <sys/eventfd.h>
 #include <sys/types.h>
 
 #include <chrono>
 #include <cstdint>
+#include <cstring>
 #include <optional>
 #include <type_traits>
 
@@ -67,8 +69,9 @@ std::string toString(VSyncRequest request) {
 }
 
 std::string toString(const EventThreadConnection& connection) {
-    return StringPrintf("Connection{%p, %s}", &connection,
-                        toString(connection.vsyncRequest).c_str());
+    return StringPrintf("Connection{%p, %s%s}", &connection,
+                        toString(connection.vsyncRequest).c_str(),
+                        connection.usesVsyncTimeline ? ", timeline" : "");
 }
 
 std::string toString(const DisplayEventReceiver::Event& event) {
@@ -79,9 +82,11 @@ std::string toString(const DisplayEventReceiver::Event& event) {
                                 event.hotplug.connected ? "connected" : "disconnected");
         case DisplayEventReceiver::DISPLAY_EVENT_VSYNC:
             return StringPrintf("VSync{displayId=%" ANDROID_PHYSICAL_DISPLAY_ID_FORMAT
-                                ", count=%u, expectedVSyncTimestamp=%" PRId64 "}",
+                                ", count=%u, expectedVSyncTimestamp=%" PRId64
+                                ", deadlineTimestamp=%" PRId64 ", expectedPresentTime=%" PRId64 "}",
                                 event.header.displayId, event.vsync.count,
-                                event.vsync.expectedVSyncTimestamp);
+                                event.vsync.expectedVSyncTimestamp, event.vsync.deadlineTimestamp,
+                                event.vsync.expectedPresentTime);
         case DisplayEventReceiver::DISPLAY_EVENT_CONFIG_CHANGED:
             return StringPrintf("ConfigChanged{displayId=%" ANDROID_PHYSICAL_DISPLAY_ID_FORMAT
                                 ", configId=%u}",
@@ -100,14 +105,26 @@ DisplayEventReceiver::Event makeHotplug(PhysicalDisplayId displayId, nsecs_t tim
 }
 
 DisplayEventReceiver::Event makeVSync(PhysicalDisplayId displayId, nsecs_t timestamp,
-                                      uint32_t count, nsecs_t expectedVSyncTimestamp) {
+                                      uint32_t count, nsecs_t expectedVSyncTimestamp,
+                                      nsecs_t deadlineTimestamp, nsecs_t expectedPresentTime) {
     DisplayEventReceiver::Event event;
     event.header = {DisplayEventReceiver::DISPLAY_EVENT_VSYNC, displayId, timestamp};
     event.vsync.count = count;
     event.vsync.expectedVSyncTimestamp = expectedVSyncTimestamp;
+    event.vsync.deadlineTimestamp = deadlineTimestamp;
+    event.vsync.expectedPresentTime = expectedPresentTime;
     return event;
 }
 
+// Returns the first time after 'timestamp' which is 'latchTime' plus a multiple of 'period'
+nsecs_t nextLatchTime(nsecs_t timestamp, nsecs_t latchTime, nsecs_t period) {
+    const nsecs_t delta = latchTime - timestamp;
+    if (delta > 0) {
+        return latchTime - (delta - 1) / period * period;
+    }
+    return latchTime + (-delta / period + 1) * period;
+}
+
 DisplayEventReceiver::Event makeConfigChanged(PhysicalDisplayId displayId,
                                               HwcConfigIndexType configId, nsecs_t vsyncPeriod) {
     DisplayEventReceiver::Event event;
@@ -153,6 +170,10 @@ void EventThreadConnection::requestNextVsync() {
     mEventThread->requestNextVsync(this);
 }
 
+status_t EventThreadConnection::getVsyncTimeline(bool wakeFd, gui::VsyncTimeline* outTimeline) {
+    return mEventThread->enableVsyncTimeline(this, wakeFd, outTimeline);
+}
+
 status_t EventThreadConnection::postEvent(const DisplayEventReceiver::Event& event) {
     ssize_t size = DisplayEventReceiver::sendEvents(&mChannel, &event, 1);
     return size < 0 ? status_t(size) : status_t(NO_ERROR);
@@ -207,6 +228,11 @@ void EventThread::setPhaseOffset(nsecs_t phaseOffset) {
     mVSyncSource->setPhaseOffset(phaseOffset);
 }
 
+void EventThread::setLatchOffset(nsecs_t latchOffset) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mLatchOffset = latchOffset;
+}
+
 sp<EventThreadConnection> EventThread::createEventConnection(
         ResyncCallback resyncCallback, ISurfaceComposer::ConfigChanged configChanged) const {
     return new EventThreadConnection(const_cast<EventThread*>(this), std::move(resyncCallback),
@@ -265,6 +291,37 @@ void EventThread::requestNextVsync(const sp<EventThreadConnection>& connection)
     }
 }
 
+status_t EventThread::enableVsyncTimeline(const sp<EventThreadConnection>& connection,
+                                          bool wakeFd, gui::VsyncTimeline* outTimeline) {
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    if (!mVsyncTimeline) {
+        mVsyncTimeline = gui::VsyncTimeline::create();
+        if (!mVsyncTimeline) {
+            return NO_MEMORY;
+        }
+    }
+
+    base::unique_fd vsyncWakeFd;
+    if (wakeFd) {
+        vsyncWakeFd.reset(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK));
+        if (vsyncWakeFd < 0) {
+            const int error = errno;
+            ALOGE("Failed to create the vsync wake fd: %s", strerror(error));
+            return -error;
+        }
+    }
+
+    const status_t result =
+            mVsyncTimeline->share(outTimeline,
+                                  base::unique_fd(wakeFd ? dup(vsyncWakeFd.get()) : -1));
+    if (result == NO_ERROR) {
+        connection->usesVsyncTimeline = true;
+        connection->vsyncWakeFd = std::move(vsyncWakeFd);
+    }
+    return result;
+}
+
 void EventThread::onScreenReleased() {
     std::lock_guard<std::mutex> lock(mMutex);
     if (!mVSyncState || mVSyncState->synthetic) {
@@ -289,8 +346,21 @@ void EventThread::onVSyncEvent(nsecs_t timestamp, nsecs_t expectedVSyncTimestamp
     std::lock_guard<std::mutex> lock(mMutex);
 
     LOG_FATAL_IF(!mVSyncState);
+
+    nsecs_t deadlineTimestamp = expectedVSyncTimestamp;
+    nsecs_t expectedPresentTime = expectedVSyncTimestamp;
+    const nsecs_t period = mVSyncSource->getPeriod();
+    if (mLatchOffset && period > 0) {
+        // SurfaceFlinger latches the buffers queued before it next wakes up, and then composites
+        // them for the vsync a period after the one its wakeup is offset from.
+        deadlineTimestamp =
+                nextLatchTime(timestamp, expectedVSyncTimestamp + *mLatchOffset, period);
+        expectedPresentTime = deadlineTimestamp - *mLatchOffset + period;
+    }
+
     mPendingEvents.push_back(makeVSync(mVSyncState->displayId, timestamp, ++mVSyncState->count,
-                                       expectedVSyncTimestamp));
+                                       expectedVSyncTimestamp, deadlineTimestamp,
+                                       expectedPresentTime));
     mCondition.notify_all();
 }
 
@@ -414,7 +484,8 @@ void EventThread::threadMain(std::unique_lock<std::mutex>& lock) {
                 const auto now = systemTime(SYSTEM_TIME_MONOTONIC);
                 const auto expectedVSyncTime = now + timeout.count();
                 mPendingEvents.push_back(makeVSync(mVSyncState->displayId, now,
-                                                   ++mVSyncState->count, expectedVSyncTime));
+                                                   ++mVSyncState->count, expectedVSyncTime,
+                                                   expectedVSyncTime, expectedVSyncTime));
             }
         }
     }
@@ -450,7 +521,14 @@ bool EventThread::shouldConsumeEvent(const DisplayEventReceiver::Event& event,
 
 void EventThread::dispatchEvent(const DisplayEventReceiver::Event& event,
                                 const DisplayEventConsumers& consumers) {
+    bool publishToTimeline = false;
     for (const auto& consumer : consumers) {
+        if (consumer->usesVsyncTimeline &&
+            event.header.type == DisplayEventReceiver::DISPLAY_EVENT_VSYNC) {
+            publishToTimeline = true;
+            continue;
+        }
+
         switch (consumer->postEvent(event)) {
             case NO_ERROR:
                 break;
@@ -466,6 +544,26 @@ void EventThread::dispatchEvent(const DisplayEventReceiver::Event& event,
                 removeDisplayEventConnectionLocked(consumer);
         }
     }
+
+    // A single write and wake up for all the connections using the timeline
+    if (publishToTimeline) {
+        ATRACE_NAME("publishVsyncTimeline");
+        gui::VsyncTimeline::Vsync vsync;
+        vsync.displayId = event.header.displayId;
+        vsync.timestamp = event.header.timestamp;
+        vsync.count = event.vsync.count;
+        vsync.expectedVSyncTimestamp = event.vsync.expectedVSyncTimestamp;
+        vsync.deadlineTimestamp = event.vsync.deadlineTimestamp;
+        vsync.expectedPresentTime = event.vsync.expectedPresentTime;
+        mVsyncTimeline->publish(vsync);
+
+        // Wake up the connections polling for their vsyncs once they can read them
+        for (const auto& consumer : consumers) {
+            if (consumer->usesVsyncTimeline && consumer->vsyncWakeFd >= 0) {
+                eventfd_write(consumer->vsyncWakeFd, 1);
+            }
+        }
+    }
 }
 
 void EventThread::dump(std::string& result) const {
@@ -480,6 +578,10 @@ void EventThread::dump(std::string& result) const {
         StringAppendF(&result, "none\n");
     }
 
+    if (mLatchOffset) {
+        StringAppendF(&result, "  latch offset: %" PRId64 " ns\n", *mLatchOffset);
+    }
+
     StringAppendF(&result, "  pending events (count=%zu):\n", mPendingEvents.size());
     for (const auto& event : mPendingEvents) {
         StringAppendF(&result, "    %s\n", toString(event).c_str());
@@ -20,12 +20,14 @@
 #include <gui/DisplayEventReceiver.h>
 #include <gui/IDisplayEventConnection.h>
 #include <private/gui/BitTube.h>
+#include <private/gui/VsyncTimeline.h>
 #include <sys/types.h>
 #include <utils/Errors.h>
 
 #include <condition_variable>
 #include <cstdint>
 #include <deque>
+#include <memory>
 #include <mutex>
 #include <optional>
 #include <thread>
@@ -66,6 +68,8 @@ public:
     virtual void setVSyncEnabled(bool enable) = 0;
     virtual void setCallback(Callback* callback) = 0;
     virtual void setPhaseOffset(nsecs_t phaseOffset) = 0;
+    // Returns the vsync period, or 0 if it is not known
+    virtual nsecs_t getPeriod() const = 0;
 
     virtual void dump(std::string& result) const = 0;
 };
@@ -81,11 +85,16 @@ public:
     status_t stealReceiveChannel(gui::BitTube* outChannel) override;
     status_t setVsyncRate(uint32_t rate) override;
     void requestNextVsync() override; // asynchronous
+    status_t getVsyncTimeline(bool wakeFd, gui::VsyncTimeline* outTimeline) override;
 
     // Called in response to requestNextVsync.
     const ResyncCallback resyncCallback;
 
     VSyncRequest vsyncRequest = VSyncRequest::None;
+    // Whether vsync events are published to the EventThread's timeline instead of mChannel
+    bool usesVsyncTimeline = false;
+    // If valid, signaled for each vsync published to the timeline for this connection
+    base::unique_fd vsyncWakeFd;
     const ISurfaceComposer::ConfigChanged mConfigChanged =
             ISurfaceComposer::ConfigChanged::eConfigChangedSuppress;
 
@@ -118,11 +127,19 @@ public:
 
     virtual void setPhaseOffset(nsecs_t phaseOffset) = 0;
 
+    // Sets the phase offset at which SurfaceFlinger wakes up to latch buffers, from which the
+    // deadline and expected present time of vsync events are derived.
+    virtual void setLatchOffset(nsecs_t latchOffset) = 0;
+
     virtual status_t registerDisplayEventConnection(
             const sp<EventThreadConnection>& connection) = 0;
     virtual void setVsyncRate(uint32_t rate, const sp<EventThreadConnection>& connection) = 0;
     // Requests the next vsync. If resetIdleTimer is set to true, it resets the idle timer.
     virtual void requestNextVsync(const sp<EventThreadConnection>& connection) = 0;
+    // Switches the connection to receiving vsyncs from the timeline shared into outTimeline,
+    // along with an eventfd signaled for the vsyncs of the connection if wakeFd is set.
+    virtual status_t enableVsyncTimeline(const sp<EventThreadConnection>& connection, bool wakeFd,
+                                         gui::VsyncTimeline* outTimeline) = 0;
 
     // Retrieves the number of event connections tracked by this EventThread.
     virtual size_t getEventThreadConnectionCount() = 0;
@@ -143,6 +160,8 @@ public:
     status_t registerDisplayEventConnection(const sp<EventThreadConnection>& connection) override;
     void setVsyncRate(uint32_t rate, const sp<EventThreadConnection>& connection) override;
     void requestNextVsync(const sp<EventThreadConnection>& connection) override;
+    status_t enableVsyncTimeline(const sp<EventThreadConnection>& connection, bool wakeFd,
+                                 gui::VsyncTimeline* outTimeline) override;
 
     // called before the screen is turned off from main thread
     void onScreenReleased() override;
@@ -159,6 +178,8 @@ public:
 
     void setPhaseOffset(nsecs_t phaseOffset) override;
 
+    void setLatchOffset(nsecs_t latchOffset) override;
+
     size_t getEventThreadConnectionCount() override;
 
 private:
@@ -190,6 +211,10 @@ private:
 
     std::vector<wp<EventThreadConnection>> mDisplayEventConnections GUARDED_BY(mMutex);
     std::deque<DisplayEventReceiver::Event> mPendingEvents GUARDED_BY(mMutex);
+    // Created once a connection enables it, and then published to for each vsync which any
+    // connection using it consumes.
+    std::unique_ptr<gui::VsyncTimeline> mVsyncTimeline GUARDED_BY(mMutex);
+    std::optional<nsecs_t> mLatchOffset GUARDED_BY(mMutex);
 
     // VSYNC state of connected display.
     struct VSyncState {
@@ -45,6 +45,7 @@ public:
     const char* getName() const override { return "inject"; }
     void setVSyncEnabled(bool) override {}
     void setPhaseOffset(nsecs_t) override {}
+    nsecs_t getPeriod() const override { return 0; }
     void dump(std::string&) const override {}
 
 private:
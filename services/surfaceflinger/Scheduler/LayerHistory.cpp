@@ -97,13 +97,14 @@ void LayerHistory::record(Layer* layer, nsecs_t presentTime, nsecs_t now,
     }
 }
 
-LayerHistory::Summary LayerHistory::summarize(nsecs_t now) {
+const LayerHistory::Summary& LayerHistory::summarize(nsecs_t now) {
     ATRACE_CALL();
     std::lock_guard lock(mLock);
 
     partitionLayers(now);
 
-    LayerHistory::Summary summary;
+    LayerHistory::Summary& summary = mSummary;
+    summary.clear();
     for (const auto& [weakLayer, info] : activeLayers()) {
         const bool recent = info->isRecentlyActive(now);
         auto layer = weakLayer.promote();
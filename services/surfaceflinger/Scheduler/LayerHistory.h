@@ -67,8 +67,9 @@ public:
 
     using Summary = std::vector<RefreshRateConfigs::LayerRequirement>;
 
-    // Rebuilds sets of active/inactive layers, and accumulates stats for active layers.
-    virtual Summary summarize(nsecs_t now) = 0;
+    // Rebuilds sets of active/inactive layers, and accumulates stats for active layers. The
+    // summary is only valid until the next call, which reuses its storage.
+    virtual const Summary& summarize(nsecs_t now) = 0;
 
     virtual void clear() = 0;
 };
@@ -94,7 +95,7 @@ public:
     void record(Layer*, nsecs_t presentTime, nsecs_t now, LayerUpdateType updateType) override;
 
     // Rebuilds sets of active/inactive layers, and accumulates stats for active layers.
-    android::scheduler::LayerHistory::Summary summarize(nsecs_t now) override;
+    const android::scheduler::LayerHistory::Summary& summarize(nsecs_t now) override;
 
     void clear() override;
 
@@ -127,6 +128,9 @@ private:
     LayerInfos mLayerInfos GUARDED_BY(mLock);
     size_t mActiveLayersEnd GUARDED_BY(mLock) = 0;
 
+    // Storage of the last summary
+    Summary mSummary GUARDED_BY(mLock);
+
     // Whether to emit systrace output and debug logs.
     const bool mTraceEnabled;
 
@@ -152,7 +156,7 @@ public:
     void record(Layer*, nsecs_t presentTime, nsecs_t now, LayerUpdateType updateType) override;
 
     // Rebuilds sets of active/inactive layers, and accumulates stats for active layers.
-    android::scheduler::LayerHistory::Summary summarize(nsecs_t /*now*/) override;
+    const android::scheduler::LayerHistory::Summary& summarize(nsecs_t /*now*/) override;
 
     void clear() override;
 
@@ -185,6 +189,10 @@ private:
     LayerInfos mLayerInfos GUARDED_BY(mLock);
     size_t mActiveLayersEnd GUARDED_BY(mLock) = 0;
 
+    // Storage of the last summary, whose requirements are overwritten in place so that their
+    // names keep their buffers
+    Summary mSummary GUARDED_BY(mLock);
+
     uint32_t mDisplayArea = 0;
 
     // Whether to emit systrace output and debug logs.
@@ -112,13 +112,13 @@ void LayerHistoryV2::record(Layer* layer, nsecs_t presentTime, nsecs_t now,
     }
 }
 
-LayerHistoryV2::Summary LayerHistoryV2::summarize(nsecs_t now) {
-    LayerHistory::Summary summary;
-
+const LayerHistoryV2::Summary& LayerHistoryV2::summarize(nsecs_t now) {
     std::lock_guard lock(mLock);
 
     partitionLayers(now);
 
+    size_t count = 0;
+
     for (const auto& [layer, info] : activeLayers()) {
         const auto strong = layer.promote();
         if (!strong) {
@@ -144,14 +144,23 @@ LayerHistoryV2::Summary LayerHistoryV2::summarize(nsecs_t now) {
 
         const float layerArea = transformed.getWidth() * transformed.getHeight();
         float weight = mDisplayArea ? layerArea / mDisplayArea : 0.0f;
-        summary.push_back({strong->getName(), type, refreshRate, weight, layerFocused});
+        if (count == mSummary.size()) {
+            mSummary.emplace_back();
+        }
+        auto& requirement = mSummary[count++];
+        requirement.name = strong->getName();
+        requirement.vote = type;
+        requirement.desiredRefreshRate = refreshRate;
+        requirement.weight = weight;
+        requirement.focused = layerFocused;
 
         if (CC_UNLIKELY(mTraceEnabled)) {
             trace(layer, *info, type, static_cast<int>(std::round(refreshRate)));
         }
     }
 
-    return summary;
+    mSummary.resize(count);
+    return mSummary;
 }
 
 void LayerHistoryV2::partitionLayers(nsecs_t now) {
@@ -52,21 +52,15 @@ void LayerInfoV2::setLastPresentTime(nsecs_t lastPresentTime, nsecs_t now,
             break;
         case LayerUpdateType::SetFrameRate:
         case LayerUpdateType::Buffer:
-            FrameTimeData frameTime = {.presetTime = lastPresentTime,
-                                       .queueTime = mLastUpdatedTime,
-                                       .pendingConfigChange = pendingConfigChange};
-            mFrameTimes.push_back(frameTime);
-            if (mFrameTimes.size() > HISTORY_SIZE) {
-                mFrameTimes.pop_front();
-            }
+            mFrameTimes.push(lastPresentTime, mLastUpdatedTime, pendingConfigChange);
             break;
     }
 }
 
-bool LayerInfoV2::isFrameTimeValid(const FrameTimeData& frameTime) const {
-    return frameTime.queueTime >= std::chrono::duration_cast<std::chrono::nanoseconds>(
-                                          mFrameTimeValidSince.time_since_epoch())
-                                          .count();
+bool LayerInfoV2::isFrameTimeValid(nsecs_t queueTime) const {
+    return queueTime >= std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                mFrameTimeValidSince.time_since_epoch())
+                                .count();
 }
 
 bool LayerInfoV2::isFrequent(nsecs_t now) const {
@@ -77,21 +71,23 @@ bool LayerInfoV2::isFrequent(nsecs_t now) const {
     }
 
     // Find the first active frame
-    auto it = mFrameTimes.begin();
-    for (; it != mFrameTimes.end(); ++it) {
-        if (it->queueTime >= getActiveLayerThreshold(now)) {
+    size_t first = 0;
+    for (; first < mFrameTimes.size(); first++) {
+        if (mFrameTimes.queueTime(first) >= getActiveLayerThreshold(now)) {
             break;
         }
     }
 
-    const auto numFrames = std::distance(it, mFrameTimes.end());
+    const auto numFrames = mFrameTimes.size() - first;
     if (numFrames < FREQUENT_LAYER_WINDOW_SIZE) {
         return false;
     }
 
     // Layer is considered frequent if the average frame rate is higher than the threshold
-    const auto totalTime = mFrameTimes.back().queueTime - it->queueTime;
-    return (1e9f * (numFrames - 1)) / totalTime >= MIN_FPS_FOR_FREQUENT_LAYER;
+    const auto totalTime =
+            mFrameTimes.queueTime(mFrameTimes.size() - 1) - mFrameTimes.queueTime(first);
+    return (1e9f * static_cast<float>(numFrames - 1)) / static_cast<float>(totalTime) >=
+            MIN_FPS_FOR_FREQUENT_LAYER;
 }
 
 bool LayerInfoV2::isAnimating(nsecs_t now) const {
@@ -105,12 +101,13 @@ bool LayerInfoV2::hasEnoughDataForHeuristic() const {
         return false;
     }
 
-    if (!isFrameTimeValid(mFrameTimes.front())) {
+    if (!isFrameTimeValid(mFrameTimes.queueTime(0))) {
         ALOGV("stale frames still captured");
         return false;
     }
 
-    const auto totalDuration = mFrameTimes.back().queueTime - mFrameTimes.front().queueTime;
+    const auto totalDuration =
+            mFrameTimes.queueTime(mFrameTimes.size() - 1) - mFrameTimes.queueTime(0);
     if (mFrameTimes.size() < HISTORY_SIZE && totalDuration < HISTORY_DURATION.count()) {
         ALOGV("not enough frames captured: %zu | %.2f seconds", mFrameTimes.size(),
               totalDuration / 1e9f);
@@ -125,17 +122,19 @@ std::optional<nsecs_t> LayerInfoV2::calculateAverageFrameTime() const {
     nsecs_t totalQueueTimeDeltas = 0;
     bool missingPresentTime = false;
     int numFrames = 0;
-    for (auto it = mFrameTimes.begin(); it != mFrameTimes.end() - 1; ++it) {
+    for (size_t i = 0; i + 1 < mFrameTimes.size(); i++) {
         // Ignore frames captured during a config change
-        if (it->pendingConfigChange || (it + 1)->pendingConfigChange) {
+        if (mFrameTimes.pendingConfigChange(i) || mFrameTimes.pendingConfigChange(i + 1)) {
             return std::nullopt;
         }
 
         totalQueueTimeDeltas +=
-                std::max(((it + 1)->queueTime - it->queueTime), mHighRefreshRatePeriod);
+                std::max(mFrameTimes.queueTime(i + 1) - mFrameTimes.queueTime(i),
+                         mHighRefreshRatePeriod);
         numFrames++;
 
-        if (!missingPresentTime && (it->presetTime == 0 || (it + 1)->presetTime == 0)) {
+        if (!missingPresentTime &&
+            (mFrameTimes.presentTime(i) == 0 || mFrameTimes.presentTime(i + 1) == 0)) {
             missingPresentTime = true;
             // If there are no presentation timestamps and we haven't calculated
             // one in the past then we can't calculate the refresh rate
@@ -146,7 +145,8 @@ std::optional<nsecs_t> LayerInfoV2::calculateAverageFrameTime() const {
         }
 
         totalPresentTimeDeltas +=
-                std::max(((it + 1)->presetTime - it->presetTime), mHighRefreshRatePeriod);
+                std::max(mFrameTimes.presentTime(i + 1) - mFrameTimes.presentTime(i),
+                         mHighRefreshRatePeriod);
     }
 
     // Calculate the average frame time based on presentation timestamps. If those
@@ -253,14 +253,16 @@ LayerInfoV2::RefreshRateHistory::makeHeuristicTraceTagData() const {
 }
 
 void LayerInfoV2::RefreshRateHistory::clear() {
-    mRefreshRates.clear();
+    mRefreshRatesBegin = 0;
+    mRefreshRatesSize = 0;
 }
 
 bool LayerInfoV2::RefreshRateHistory::add(float refreshRate, nsecs_t now) {
-    mRefreshRates.push_back({refreshRate, now});
-    while (mRefreshRates.size() >= HISTORY_SIZE ||
-           now - mRefreshRates.front().timestamp > HISTORY_DURATION.count()) {
-        mRefreshRates.pop_front();
+    mRefreshRates[(mRefreshRatesBegin + mRefreshRatesSize++) % HISTORY_SIZE] = {refreshRate, now};
+    while (mRefreshRatesSize >= HISTORY_SIZE ||
+           now - mRefreshRates[mRefreshRatesBegin].timestamp > HISTORY_DURATION.count()) {
+        mRefreshRatesBegin = (mRefreshRatesBegin + 1) % HISTORY_SIZE;
+        mRefreshRatesSize--;
     }
 
     if (CC_UNLIKELY(sTraceEnabled)) {
@@ -275,10 +277,15 @@ bool LayerInfoV2::RefreshRateHistory::add(float refreshRate, nsecs_t now) {
 }
 
 bool LayerInfoV2::RefreshRateHistory::isConsistent() const {
-    if (mRefreshRates.empty()) return true;
-
-    const auto max = std::max_element(mRefreshRates.begin(), mRefreshRates.end());
-    const auto min = std::min_element(mRefreshRates.begin(), mRefreshRates.end());
+    if (mRefreshRatesSize == 0) return true;
+
+    const RefreshRateData* max = &mRefreshRates[mRefreshRatesBegin];
+    const RefreshRateData* min = max;
+    for (size_t i = 1; i < mRefreshRatesSize; i++) {
+        const auto& data = mRefreshRates[(mRefreshRatesBegin + i) % HISTORY_SIZE];
+        if (*max < data) max = &data;
+        if (data < *min) min = &data;
+    }
     const auto consistent = max->refreshRate - min->refreshRate <= MARGIN_FPS;
 
     if (CC_UNLIKELY(sTraceEnabled)) {
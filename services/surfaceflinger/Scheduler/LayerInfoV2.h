@@ -18,8 +18,9 @@
 
 #include <utils/Timers.h>
 
+#include <array>
+#include <bitset>
 #include <chrono>
-#include <deque>
 
 #include "LayerHistory.h"
 #include "RefreshRateConfigs.h"
@@ -112,11 +113,38 @@ public:
     }
 
 private:
-    // Used to store the layer timestamps
-    struct FrameTimeData {
-        nsecs_t presetTime; // desiredPresentTime, if provided
-        nsecs_t queueTime;  // buffer queue time
-        bool pendingConfigChange;
+    // Holds the timestamps of the most recent frames of the layer, oldest first. Recording a frame
+    // once the history is full replaces the oldest one, so that recording never allocates. Each
+    // field is stored in an array of its own, which the heuristic scans from oldest to newest.
+    template <size_t N>
+    class FrameTimes {
+    public:
+        size_t size() const { return mSize; }
+        void clear() { mSize = 0; }
+
+        void push(nsecs_t presentTime, nsecs_t queueTime, bool pendingConfigChange) {
+            const size_t index = mSize < N ? indexOf(mSize++) : mBegin++;
+            if (mBegin == N) mBegin = 0;
+            mPresentTimes[index] = presentTime;
+            mQueueTimes[index] = queueTime;
+            mPendingConfigChange[index] = pendingConfigChange;
+        }
+
+        // Accessors of the frame at position i, with the oldest frame at position 0
+        nsecs_t presentTime(size_t i) const { return mPresentTimes[indexOf(i)]; }
+        nsecs_t queueTime(size_t i) const { return mQueueTimes[indexOf(i)]; }
+        bool pendingConfigChange(size_t i) const { return mPendingConfigChange[indexOf(i)]; }
+
+    private:
+        size_t indexOf(size_t i) const { return mBegin + i < N ? mBegin + i : mBegin + i - N; }
+
+        // desiredPresentTime, if provided
+        std::array<nsecs_t, N> mPresentTimes;
+        // buffer queue time
+        std::array<nsecs_t, N> mQueueTimes;
+        std::bitset<N> mPendingConfigChange;
+        size_t mBegin = 0;
+        size_t mSize = 0;
     };
 
     // Holds information about the calculated and reported refresh rate
@@ -177,7 +205,11 @@ private:
 
         const std::string mName;
         mutable std::optional<HeuristicTraceTagData> mHeuristicTraceTagData;
-        std::deque<RefreshRateData> mRefreshRates;
+        // Ring buffer of the refresh rates calculated within HISTORY_DURATION, oldest first. It
+        // never holds more than HISTORY_SIZE - 1 of them, so adding one never overwrites another.
+        std::array<RefreshRateData, HISTORY_SIZE> mRefreshRates;
+        size_t mRefreshRatesBegin = 0;
+        size_t mRefreshRatesSize = 0;
         static constexpr float MARGIN_FPS = 1.0;
     };
 
@@ -186,7 +218,7 @@ private:
     bool hasEnoughDataForHeuristic() const;
     std::optional<float> calculateRefreshRateIfPossible(nsecs_t now);
     std::optional<nsecs_t> calculateAverageFrameTime() const;
-    bool isFrameTimeValid(const FrameTimeData&) const;
+    bool isFrameTimeValid(nsecs_t queueTime) const;
 
     const std::string mName;
 
@@ -202,11 +234,11 @@ private:
 
     RefreshRateHeuristicData mLastRefreshRate;
 
-    std::deque<FrameTimeData> mFrameTimes;
-    std::chrono::time_point<std::chrono::steady_clock> mFrameTimeValidSince =
-            std::chrono::steady_clock::now();
     static constexpr size_t HISTORY_SIZE = RefreshRateHistory::HISTORY_SIZE;
     static constexpr std::chrono::nanoseconds HISTORY_DURATION = 1s;
+    FrameTimes<HISTORY_SIZE> mFrameTimes;
+    std::chrono::time_point<std::chrono::steady_clock> mFrameTimeValidSince =
+            std::chrono::steady_clock::now();
 
     RefreshRateHistory mRefreshRateHistory;
 
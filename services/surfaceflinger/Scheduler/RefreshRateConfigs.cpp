@@ -103,7 +103,7 @@ const RefreshRate& RefreshRateConfigs::getRefreshRateForContent(
 }
 
 std::pair<nsecs_t, nsecs_t> RefreshRateConfigs::getDisplayFrames(nsecs_t layerPeriod,
-                                                                 nsecs_t displayPeriod) const {
+                                                                 nsecs_t displayPeriod) {
     auto [displayFramesQuot, displayFramesRem] = std::div(layerPeriod, displayPeriod);
     if (displayFramesRem <= MARGIN_FOR_PERIOD_CALCULATION ||
         std::abs(displayFramesRem - displayPeriod) <= MARGIN_FOR_PERIOD_CALCULATION) {
@@ -114,26 +114,100 @@ std::pair<nsecs_t, nsecs_t> RefreshRateConfigs::getDisplayFrames(nsecs_t layerPe
     return {displayFramesQuot, displayFramesRem};
 }
 
+float RefreshRateConfigs::calculateExplicitDefaultLayerScore(nsecs_t layerPeriod,
+                                                             nsecs_t displayPeriod) {
+    // Find the actual rate the layer will render, assuming
+    // that layerPeriod is the minimal time to render a frame
+    auto actualLayerPeriod = displayPeriod;
+    int multiplier = 1;
+    while (layerPeriod > actualLayerPeriod + MARGIN_FOR_PERIOD_CALCULATION) {
+        multiplier++;
+        actualLayerPeriod = displayPeriod * multiplier;
+    }
+    return std::min(1.0f, static_cast<float>(layerPeriod) / static_cast<float>(actualLayerPeriod));
+}
+
+float RefreshRateConfigs::calculateExactOrMultipleLayerScore(nsecs_t layerPeriod,
+                                                             nsecs_t displayPeriod) {
+    // Calculate how many display vsyncs we need to present a single frame for this
+    // layer
+    const auto [displayFramesQuot, displayFramesRem] = getDisplayFrames(layerPeriod, displayPeriod);
+    static constexpr size_t MAX_FRAMES_TO_FIT = 10; // Stop calculating when score < 0.1
+    if (displayFramesRem == 0) {
+        // Layer desired refresh rate matches the display rate.
+        return 1.0f;
+    }
+
+    if (displayFramesQuot == 0) {
+        // Layer desired refresh rate is higher the display rate.
+        return (static_cast<float>(layerPeriod) / static_cast<float>(displayPeriod)) *
+                (1.0f / (MAX_FRAMES_TO_FIT + 1));
+    }
+
+    // Layer desired refresh rate is lower the display rate. Check how well it fits
+    // the cadence
+    auto diff = std::abs(displayFramesRem - (displayPeriod - displayFramesRem));
+    int iter = 2;
+    while (diff > MARGIN_FOR_PERIOD_CALCULATION && iter < MAX_FRAMES_TO_FIT) {
+        diff = diff - (displayPeriod - diff);
+        iter++;
+    }
+
+    return 1.0f / iter;
+}
+
+float RefreshRateConfigs::getLayerScore(const LayerRequirement& layer, nsecs_t layerPeriod,
+                                        std::optional<size_t> knownFrameRateIndex,
+                                        const RefreshRate& refreshRate) const {
+    const bool isExplicitDefault = layer.vote == LayerVoteType::ExplicitDefault;
+    if (knownFrameRateIndex) {
+        const auto& scores =
+                mKnownFrameRateScores[*knownFrameRateIndex * mRefreshRates.size() +
+                                      static_cast<size_t>(refreshRate.configId.value())];
+        return isExplicitDefault ? scores.explicitDefault : scores.exactOrMultiple;
+    }
+
+    const auto displayPeriod = refreshRate.hwcConfig->getVsyncPeriod();
+    return isExplicitDefault ? calculateExplicitDefaultLayerScore(layerPeriod, displayPeriod)
+                             : calculateExactOrMultipleLayerScore(layerPeriod, displayPeriod);
+}
+
 const RefreshRate& RefreshRateConfigs::getBestRefreshRate(
         const std::vector<LayerRequirement>& layers, const GlobalSignals& globalSignals,
         GlobalSignals* outSignalsConsidered) const {
-    ATRACE_CALL();
-    ALOGV("getRefreshRateForContent %zu layers", layers.size());
+    std::lock_guard lock(mLock);
 
-    if (outSignalsConsidered) *outSignalsConsidered = {};
-    const auto setTouchConsidered = [&] {
+    if (mLastBestRefreshRateInvocation &&
+        mLastBestRefreshRateInvocation->layerRequirements == layers &&
+        mLastBestRefreshRateInvocation->globalSignals == globalSignals) {
         if (outSignalsConsidered) {
-            outSignalsConsidered->touch = true;
+            *outSignalsConsidered = mLastBestRefreshRateInvocation->outSignalsConsidered;
         }
-    };
+        return *mLastBestRefreshRateInvocation->resultingBestRefreshRate;
+    }
 
-    const auto setIdleConsidered = [&] {
-        if (outSignalsConsidered) {
-            outSignalsConsidered->idle = true;
-        }
-    };
+    GlobalSignals signalsConsidered;
+    const RefreshRate& result = getBestRefreshRateLocked(layers, globalSignals, &signalsConsidered);
+    mLastBestRefreshRateInvocation.emplace(
+            GetBestRefreshRateInvocation{.layerRequirements = layers,
+                                         .globalSignals = globalSignals,
+                                         .outSignalsConsidered = signalsConsidered,
+                                         .resultingBestRefreshRate = &result});
+    if (outSignalsConsidered) {
+        *outSignalsConsidered = signalsConsidered;
+    }
+    return result;
+}
 
-    std::lock_guard lock(mLock);
+const RefreshRate& RefreshRateConfigs::getBestRefreshRateLocked(
+        const std::vector<LayerRequirement>& layers, const GlobalSignals& globalSignals,
+        GlobalSignals* outSignalsConsidered) const {
+    ATRACE_CALL();
+    ALOGV("getRefreshRateForContent %zu layers", layers.size());
+
+    *outSignalsConsidered = {};
+    const auto setTouchConsidered = [&] { outSignalsConsidered->touch = true; };
+    const auto setIdleConsidered = [&] { outSignalsConsidered->idle = true; };
 
     int noVoteLayers = 0;
     int minVoteLayers = 0;
@@ -207,6 +281,14 @@ const RefreshRate& RefreshRateConfigs::getBestRefreshRate(
         }
 
         auto weight = layer.weight;
+        const bool scoresFrameRate = layer.vote == LayerVoteType::ExplicitDefault ||
+                layer.vote == LayerVoteType::ExplicitExactOrMultiple ||
+                layer.vote == LayerVoteType::Heuristic;
+        const auto layerPeriod =
+                scoresFrameRate ? round<nsecs_t>(1e9f / layer.desiredRefreshRate) : 0;
+        const auto knownFrameRateIndex = scoresFrameRate
+                ? findKnownFrameRateIndex(layer.desiredRefreshRate)
+                : std::nullopt;
 
         for (auto i = 0u; i < scores.size(); i++) {
             bool inPrimaryRange =
@@ -229,62 +311,9 @@ const RefreshRate& RefreshRateConfigs::getBestRefreshRate(
                 continue;
             }
 
-            const auto displayPeriod = scores[i].first->hwcConfig->getVsyncPeriod();
-            const auto layerPeriod = round<nsecs_t>(1e9f / layer.desiredRefreshRate);
-            if (layer.vote == LayerVoteType::ExplicitDefault) {
-                const auto layerScore = [&]() {
-                    // Find the actual rate the layer will render, assuming
-                    // that layerPeriod is the minimal time to render a frame
-                    auto actualLayerPeriod = displayPeriod;
-                    int multiplier = 1;
-                    while (layerPeriod > actualLayerPeriod + MARGIN_FOR_PERIOD_CALCULATION) {
-                        multiplier++;
-                        actualLayerPeriod = displayPeriod * multiplier;
-                    }
-                    return std::min(1.0f,
-                                    static_cast<float>(layerPeriod) /
-                                            static_cast<float>(actualLayerPeriod));
-                }();
-
-                ALOGV("%s (ExplicitDefault, weight %.2f) %.2fHz gives %s score of %.2f",
-                      layer.name.c_str(), weight, 1e9f / layerPeriod, scores[i].first->name.c_str(),
-                      layerScore);
-                scores[i].second += weight * layerScore;
-                continue;
-            }
-
-            if (layer.vote == LayerVoteType::ExplicitExactOrMultiple ||
-                layer.vote == LayerVoteType::Heuristic) {
-                const auto layerScore = [&] {
-                    // Calculate how many display vsyncs we need to present a single frame for this
-                    // layer
-                    const auto [displayFramesQuot, displayFramesRem] =
-                            getDisplayFrames(layerPeriod, displayPeriod);
-                    static constexpr size_t MAX_FRAMES_TO_FIT =
-                            10; // Stop calculating when score < 0.1
-                    if (displayFramesRem == 0) {
-                        // Layer desired refresh rate matches the display rate.
-                        return 1.0f;
-                    }
-
-                    if (displayFramesQuot == 0) {
-                        // Layer desired refresh rate is higher the display rate.
-                        return (static_cast<float>(layerPeriod) /
-                                static_cast<float>(displayPeriod)) *
-                                (1.0f / (MAX_FRAMES_TO_FIT + 1));
-                    }
-
-                    // Layer desired refresh rate is lower the display rate. Check how well it fits
-                    // the cadence
-                    auto diff = std::abs(displayFramesRem - (displayPeriod - displayFramesRem));
-                    int iter = 2;
-                    while (diff > MARGIN_FOR_PERIOD_CALCULATION && iter < MAX_FRAMES_TO_FIT) {
-                        diff = diff - (displayPeriod - diff);
-                        iter++;
-                    }
-
-                    return 1.0f / iter;
-                }();
+            if (scoresFrameRate) {
+                const auto layerScore =
+                        getLayerScore(layer, layerPeriod, knownFrameRateIndex, *scores[i].first);
                 ALOGV("%s (%s, weight %.2f) %.2fHz gives %s score of %.2f", layer.name.c_str(),
                       layerVoteTypeString(layer.vote).c_str(), weight, 1e9f / layerPeriod,
                       scores[i].first->name.c_str(), layerScore);
@@ -420,6 +449,7 @@ RefreshRateConfigs::RefreshRateConfigs(
     mMinSupportedRefreshRate = sortedConfigs.front();
     mMaxSupportedRefreshRate = sortedConfigs.back();
     constructAvailableRefreshRates();
+    constructKnownFrameRateScores();
 }
 
 bool RefreshRateConfigs::isPolicyValid(const Policy& policy) {
@@ -515,6 +545,9 @@ void RefreshRateConfigs::getSortedRefreshRateList(
 }
 
 void RefreshRateConfigs::constructAvailableRefreshRates() {
+    // The refresh rate chosen for the content depends on the policy
+    mLastBestRefreshRateInvocation.reset();
+
     // Filter configs based on current policy and sort based on vsync period
     const Policy* policy = getCurrentPolicyLocked();
     const auto& defaultConfig = mRefreshRates.at(policy->defaultConfig)->hwcConfig;
@@ -578,6 +611,30 @@ std::vector<float> RefreshRateConfigs::constructKnownFrameRates(
     return knownFrameRates;
 }
 
+void RefreshRateConfigs::constructKnownFrameRateScores() {
+    mKnownFrameRateScores.resize(mKnownFrameRates.size() * mRefreshRates.size());
+    for (size_t i = 0; i < mKnownFrameRates.size(); i++) {
+        const auto layerPeriod = round<nsecs_t>(1e9f / mKnownFrameRates[i]);
+        for (const auto& [configId, refreshRate] : mRefreshRates) {
+            const auto displayPeriod = refreshRate->hwcConfig->getVsyncPeriod();
+            mKnownFrameRateScores[i * mRefreshRates.size() +
+                                  static_cast<size_t>(configId.value())] =
+                    {.explicitDefault =
+                             calculateExplicitDefaultLayerScore(layerPeriod, displayPeriod),
+                     .exactOrMultiple =
+                             calculateExactOrMultipleLayerScore(layerPeriod, displayPeriod)};
+        }
+    }
+}
+
+std::optional<size_t> RefreshRateConfigs::findKnownFrameRateIndex(float frameRate) const {
+    const auto it = std::lower_bound(mKnownFrameRates.begin(), mKnownFrameRates.end(), frameRate);
+    if (it == mKnownFrameRates.end() || *it != frameRate) {
+        return {};
+    }
+    return static_cast<size_t>(std::distance(mKnownFrameRates.begin(), it));
+}
+
 float RefreshRateConfigs::findClosestKnownFrameRate(float frameRate) const {
     if (frameRate <= *mKnownFrameRates.begin()) {
         return *mKnownFrameRates.begin();
@@ -226,6 +226,10 @@ public:
         bool touch = false;
         // True if the system hasn't seen any buffers posted to layers recently.
         bool idle = false;
+
+        bool operator==(const GlobalSignals& other) const {
+            return touch == other.touch && idle == other.idle;
+        }
     };
 
     // Returns the refresh rate that fits best to the given layers.
@@ -308,9 +312,32 @@ private:
     template <typename Iter>
     const RefreshRate* getBestRefreshRate(Iter begin, Iter end) const;
 
+    const RefreshRate& getBestRefreshRateLocked(const std::vector<LayerRequirement>& layers,
+                                                const GlobalSignals& globalSignals,
+                                                GlobalSignals* outSignalsConsidered) const
+            REQUIRES(mLock);
+
     // Returns number of display frames and remainder when dividing the layer refresh period by
     // display refresh period.
-    std::pair<nsecs_t, nsecs_t> getDisplayFrames(nsecs_t layerPeriod, nsecs_t displayPeriod) const;
+    static std::pair<nsecs_t, nsecs_t> getDisplayFrames(nsecs_t layerPeriod,
+                                                        nsecs_t displayPeriod);
+
+    // Returns the score of a display refresh period for a layer which voted ExplicitDefault, or
+    // ExplicitExactOrMultiple or Heuristic, for a frame rate with the given period.
+    static float calculateExplicitDefaultLayerScore(nsecs_t layerPeriod, nsecs_t displayPeriod);
+    static float calculateExactOrMultipleLayerScore(nsecs_t layerPeriod, nsecs_t displayPeriod);
+
+    // Returns the score of refreshRate for a layer which voted ExplicitDefault,
+    // ExplicitExactOrMultiple or Heuristic. The score is looked up from mKnownFrameRateScores if
+    // the layer wants one of the known frame rates, whose index is knownFrameRateIndex.
+    float getLayerScore(const LayerRequirement& layer, nsecs_t layerPeriod,
+                        std::optional<size_t> knownFrameRateIndex,
+                        const RefreshRate& refreshRate) const;
+
+    void constructKnownFrameRateScores();
+
+    // Returns the index of frameRate in mKnownFrameRates, if it is a known frame rate
+    std::optional<size_t> findKnownFrameRateIndex(float frameRate) const;
 
     // Returns the lowest refresh rate according to the current policy. May change at runtime. Only
     // uses the primary range, not the app request range.
@@ -358,6 +385,28 @@ private:
     // A sorted list of known frame rates that a Heuristic layer will choose
     // from based on the closest value.
     const std::vector<float> mKnownFrameRates;
+
+    // The scores of every refresh rate for layers which want one of mKnownFrameRates, indexed by
+    // the index of the frame rate times the number of refresh rates plus the config ID. Heuristic
+    // layers always want a known frame rate, so their scores never need to be calculated while
+    // choosing a refresh rate. This must not change after this object is initialized.
+    struct KnownFrameRateScores {
+        float explicitDefault = 0.0f;
+        float exactOrMultiple = 0.0f;
+    };
+    std::vector<KnownFrameRateScores> mKnownFrameRateScores;
+
+    // The arguments and result of the last getBestRefreshRate() call. The layer requirements
+    // only change when LayerHistory sees different content, so the refresh rate chosen for them is
+    // kept until they or the policy change.
+    struct GetBestRefreshRateInvocation {
+        std::vector<LayerRequirement> layerRequirements;
+        GlobalSignals globalSignals;
+        GlobalSignals outSignalsConsidered;
+        const RefreshRate* resultingBestRefreshRate = nullptr;
+    };
+    mutable std::optional<GetBestRefreshRateInvocation> mLastBestRefreshRateInvocation
+            GUARDED_BY(mLock);
 };
 
 } // namespace android::scheduler
@@ -81,8 +81,10 @@ std::unique_ptr<DispSync> createDispSync(bool supportKernelTimer) {
 
         static constexpr auto vsyncMoveThreshold =
                 std::chrono::duration_cast<std::chrono::nanoseconds>(3ms);
-        static constexpr auto timerSlack =
-                std::chrono::duration_cast<std::chrono::nanoseconds>(500us);
+        // Callbacks due within this window of each other are dispatched in one timer wakeup
+        const auto timerSlack = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::microseconds(
+                        property_get_int32("debug.sf.vsync_dispatch_coalescing_window_us", 500)));
         auto dispatch = std::make_unique<
                 scheduler::VSyncDispatchTimerQueue>(std::make_unique<scheduler::Timer>(), *tracker,
                                                     timerSlack.count(), vsyncMoveThreshold.count());
@@ -277,6 +279,11 @@ void Scheduler::setPhaseOffset(ConnectionHandle handle, nsecs_t phaseOffset) {
     mConnections[handle].thread->setPhaseOffset(phaseOffset);
 }
 
+void Scheduler::setLatchOffset(ConnectionHandle handle, nsecs_t latchOffset) {
+    RETURN_IF_INVALID_HANDLE(handle);
+    mConnections[handle].thread->setLatchOffset(latchOffset);
+}
+
 void Scheduler::getDisplayStatInfo(DisplayStatInfo* stats) {
     stats->vsyncTime = mPrimaryDispSync->computeNextRefresh(0, systemTime());
     stats->vsyncPeriod = mPrimaryDispSync->getPeriod();
@@ -463,7 +470,7 @@ void Scheduler::chooseRefreshRateForContent() {
 
     ATRACE_CALL();
 
-    scheduler::LayerHistory::Summary summary = mLayerHistory->summarize(systemTime());
+    const auto& summary = mLayerHistory->summarize(systemTime());
     HwcConfigIndexType newConfigId;
     {
         std::lock_guard<std::mutex> lock(mFeatureStateLock);
@@ -59,6 +59,7 @@ class IPhaseOffsetControl {
 public:
     virtual ~IPhaseOffsetControl() = default;
     virtual void setPhaseOffset(scheduler::ConnectionHandle, nsecs_t phaseOffset) = 0;
+    virtual void setLatchOffset(scheduler::ConnectionHandle, nsecs_t latchOffset) = 0;
 };
 
 class Scheduler : public IPhaseOffsetControl {
@@ -102,6 +103,7 @@ public:
 
     // Modifies phase offset in the event thread.
     void setPhaseOffset(ConnectionHandle, nsecs_t phaseOffset) override;
+    void setLatchOffset(ConnectionHandle, nsecs_t latchOffset) override;
 
     void getDisplayStatInfo(DisplayStatInfo* stats);
 
@@ -245,6 +245,7 @@ void VSyncDispatchTimerQueue::timerCallback() {
         std::lock_guard<decltype(mMutex)> lk(mMutex);
         auto const now = mTimeKeeper->now();
         mLastTimerCallback = now;
+        auto const lagAllowance = std::max(now - mIntendedWakeupTime, static_cast<nsecs_t>(0));
         for (auto it = mCallbacks.begin(); it != mCallbacks.end(); it++) {
             auto& callback = it->second;
             auto const wakeupTime = callback->wakeupTime();
@@ -252,14 +253,20 @@ void VSyncDispatchTimerQueue::timerCallback() {
                 continue;
             }
 
-            auto const lagAllowance = std::max(now - mIntendedWakeupTime, static_cast<nsecs_t>(0));
             if (*wakeupTime < mIntendedWakeupTime + mTimerSlack + lagAllowance) {
                 callback->executing();
                 invocations.emplace_back(
                         Invocation{callback, *callback->lastExecutedVsyncTarget(), *wakeupTime});
+                mWakeupStats.maxEarliness = std::max(mWakeupStats.maxEarliness, *wakeupTime - now);
             }
         }
 
+        mWakeupStats.wakeups++;
+        mWakeupStats.emptyWakeups += invocations.empty() ? 1 : 0;
+        mWakeupStats.callbacks += invocations.size();
+        mWakeupStats.totalLateness += lagAllowance;
+        mWakeupStats.maxLateness = std::max(mWakeupStats.maxLateness, lagAllowance);
+
         mIntendedWakeupTime = kInvalidTime;
         rearmTimer(mTimeKeeper->now());
     }
@@ -364,6 +371,19 @@ void VSyncDispatchTimerQueue::dump(std::string& result) const {
     StringAppendF(&result, "\tmLastTimerCallback: %.2fms ago mLastTimerSchedule: %.2fms ago\n",
                   (mTimeKeeper->now() - mLastTimerCallback) / 1e6f,
                   (mTimeKeeper->now() - mLastTimerSchedule) / 1e6f);
+    if (mWakeupStats.wakeups > 0) {
+        StringAppendF(&result,
+                      "\tWakeups: %zu (%zu without callbacks), %.2f callbacks per wakeup\n",
+                      mWakeupStats.wakeups, mWakeupStats.emptyWakeups,
+                      static_cast<float>(mWakeupStats.callbacks) /
+                              static_cast<float>(mWakeupStats.wakeups));
+        StringAppendF(&result,
+                      "\tWakeup lateness: mean %.2fms max %.2fms, coalesced callbacks ran up to "
+                      "%.2fms early\n",
+                      static_cast<float>(mWakeupStats.totalLateness) /
+                              static_cast<float>(mWakeupStats.wakeups) / 1e6f,
+                      mWakeupStats.maxLateness / 1e6f, mWakeupStats.maxEarliness / 1e6f);
+    }
     StringAppendF(&result, "\tCallbacks:\n");
     for (const auto& [token, entry] : mCallbacks) {
         entry->dump(result);
@@ -116,7 +116,8 @@ public:
     // \param[in] tk                    A timekeeper.
     // \param[in] tracker               A tracker.
     // \param[in] timerSlack            The threshold at which different similarly timed callbacks
-    //                                  should be grouped into one wakeup.
+    //                                  should be grouped into one wakeup. Callbacks which are due
+    //                                  within it of the earliest one run in the same timer expiry.
     // \param[in] minVsyncDistance      The minimum distance between two vsync estimates before the
     //                                  vsyncs are considered the same vsync event.
     explicit VSyncDispatchTimerQueue(std::unique_ptr<TimeKeeper> tk, VSyncTracker& tracker,
@@ -169,6 +170,18 @@ private:
     // For debugging purposes
     nsecs_t mLastTimerCallback GUARDED_BY(mMutex) = kInvalidTime;
     nsecs_t mLastTimerSchedule GUARDED_BY(mMutex) = kInvalidTime;
+
+    // How well callbacks are coalesced into timer expiries, for dumpsys
+    struct WakeupStats {
+        size_t wakeups = 0;
+        size_t emptyWakeups = 0;
+        size_t callbacks = 0;
+        // How late the timer expired relative to the wakeup it was armed for
+        nsecs_t totalLateness = 0;
+        nsecs_t maxLateness = 0;
+        // How far ahead of its own wakeup time a coalesced callback ran
+        nsecs_t maxEarliness = 0;
+    } mWakeupStats GUARDED_BY(mMutex);
 };
 
 } // namespace android::scheduler
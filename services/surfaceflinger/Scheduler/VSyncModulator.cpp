@@ -22,11 +22,14 @@
 
 #include "VSyncModulator.h"
 
+#include <android-base/stringprintf.h>
 #include <cutils/properties.h>
 #include <utils/Trace.h>
 
+#include <algorithm>
 #include <chrono>
 #include <cinttypes>
+#include <cstdlib>
 #include <mutex>
 
 namespace android::scheduler {
@@ -42,11 +45,15 @@ VSyncModulator::VSyncModulator(IPhaseOffsetControl& phaseOffsetControl,
     char value[PROPERTY_VALUE_MAX];
     property_get("debug.sf.vsync_trace_detailed_info", value, "0");
     mTraceDetailedInfo = atoi(value);
+    mAdaptiveLateOffsetsEnabled = property_get_bool("debug.sf.adaptive_late_offsets", false);
 }
 
 void VSyncModulator::setPhaseOffsets(const OffsetsConfig& config) {
     std::lock_guard<std::mutex> lock(mMutex);
     mOffsetsConfig = config;
+    // The adaptive late offsets are recalculated for the new configuration once the next frame
+    // is composed for its vsync period.
+    mAdaptiveLateOffsets.reset();
     updateOffsetsLocked();
 }
 
@@ -133,11 +140,114 @@ void VSyncModulator::onRefreshed(bool usedRenderEngine) {
     }
 }
 
+void VSyncModulator::onFrameComposed(nsecs_t duration, nsecs_t vsyncPeriod) {
+    if (!mAdaptiveLateOffsetsEnabled) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mFrameDurations[mNextFrameDuration] = duration;
+    mNextFrameDuration = (mNextFrameDuration + 1) % FRAME_DURATION_HISTORY_SIZE;
+    mFrameDurationsSize = std::min(mFrameDurationsSize + 1, FRAME_DURATION_HISTORY_SIZE);
+    mVsyncPeriod = vsyncPeriod;
+
+    if (++mFramesSinceMissedFrame > FRAME_DURATION_HISTORY_SIZE) {
+        mAdaptiveMargin = std::max(mAdaptiveMargin - ADAPTIVE_MARGIN_DECAY.count(),
+                                   MIN_ADAPTIVE_MARGIN.count());
+    }
+
+    if (mFrameDurationsSize < MIN_FRAME_DURATIONS_FOR_PREDICTION) {
+        return;
+    }
+
+    const Offsets offsets = calculateAdaptiveLateOffsets();
+    const nsecs_t threshold = ADAPTIVE_OFFSET_UPDATE_THRESHOLD.count();
+    if (mAdaptiveLateOffsets && std::abs(offsets.sf - mAdaptiveLateOffsets->sf) < threshold) {
+        return;
+    }
+    mAdaptiveLateOffsets = offsets;
+    updateOffsetsLocked();
+}
+
+void VSyncModulator::onFrameMissed() {
+    if (!mAdaptiveLateOffsetsEnabled) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mFramesSinceMissedFrame = 0;
+    mAdaptiveMargin += ADAPTIVE_MARGIN_STEP.count();
+    if (mVsyncPeriod > 0) {
+        mAdaptiveMargin = std::min(mAdaptiveMargin, mVsyncPeriod / 2);
+    }
+
+    // Leave more time to compose right away rather than waiting for the threshold
+    if (mAdaptiveLateOffsets) {
+        mAdaptiveLateOffsets = calculateAdaptiveLateOffsets();
+        updateOffsetsLocked();
+    }
+}
+
+nsecs_t VSyncModulator::predictFrameDuration() const {
+    std::array<nsecs_t, FRAME_DURATION_HISTORY_SIZE> durations;
+    const auto begin = durations.begin();
+    const auto end = std::copy_n(mFrameDurations.begin(), mFrameDurationsSize, begin);
+
+    const size_t index = mFrameDurationsSize * (100 - TARGET_MISSED_FRAME_PERCENT) / 100;
+    std::nth_element(begin, begin + index, end);
+    return durations[index];
+}
+
+VSyncModulator::Offsets VSyncModulator::calculateAdaptiveLateOffsets() const {
+    // SurfaceFlinger wakes up 'sf' after a vsync to present on the next one, or before the vsync
+    // for a negative offset, so the time it has to compose is the vsync period minus the offset.
+    const nsecs_t vsyncPeriod = mVsyncPeriod;
+    const auto durationFor = [vsyncPeriod](const Offsets& offsets) {
+        return vsyncPeriod - offsets.sf;
+    };
+    const nsecs_t maxDuration = std::max({durationFor(mOffsetsConfig.early),
+                                          durationFor(mOffsetsConfig.earlyGl),
+                                          durationFor(mOffsetsConfig.late)});
+    const nsecs_t duration = std::min(predictFrameDuration() + mAdaptiveMargin, maxDuration);
+
+    // The app keeps waking up as long before SurfaceFlinger as with the configured late offsets,
+    // within a single vsync period.
+    const Offsets& late = mOffsetsConfig.late;
+    const nsecs_t delta = vsyncPeriod - duration - late.sf;
+    nsecs_t app = late.app + delta;
+    if (app >= vsyncPeriod) {
+        app -= vsyncPeriod;
+    } else if (app <= -vsyncPeriod) {
+        app += vsyncPeriod;
+    }
+    return {late.sf + delta, app};
+}
+
 VSyncModulator::Offsets VSyncModulator::getOffsets() const {
     std::lock_guard<std::mutex> lock(mMutex);
     return mOffsets;
 }
 
+void VSyncModulator::dump(std::string& result) const {
+    if (!mAdaptiveLateOffsetsEnabled) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    using base::StringAppendF;
+    if (!mAdaptiveLateOffsets) {
+        StringAppendF(&result,
+                      "Adaptive late offsets: waiting for frame durations (%zu of %zu)\n\n",
+                      mFrameDurationsSize, MIN_FRAME_DURATIONS_FOR_PREDICTION);
+        return;
+    }
+    StringAppendF(&result,
+                  "Adaptive late offsets: app %9" PRId64 " ns, SF %9" PRId64
+                  " ns (predicted frame duration %.2fms, margin %.2fms)\n\n",
+                  mAdaptiveLateOffsets->app, mAdaptiveLateOffsets->sf,
+                  predictFrameDuration() / 1e6f, mAdaptiveMargin / 1e6f);
+}
+
 const VSyncModulator::Offsets& VSyncModulator::getNextOffsets() const {
     // Early offsets are used if we're in the middle of a refresh rate
     // change, or if we recently begin a transaction.
@@ -146,6 +256,8 @@ const VSyncModulator::Offsets& VSyncModulator::getNextOffsets() const {
         return mOffsetsConfig.early;
     } else if (mRemainingRenderEngineUsageCount > 0) {
         return mOffsetsConfig.earlyGl;
+    } else if (mAdaptiveLateOffsets) {
+        return *mAdaptiveLateOffsets;
     } else {
         return mOffsetsConfig.late;
     }
@@ -161,6 +273,8 @@ void VSyncModulator::updateOffsetsLocked() {
 
     mPhaseOffsetControl.setPhaseOffset(mSfConnectionHandle, offsets.sf);
     mPhaseOffsetControl.setPhaseOffset(mAppConnectionHandle, offsets.app);
+    // Apps are told when SurfaceFlinger latches their buffers
+    mPhaseOffsetControl.setLatchOffset(mAppConnectionHandle, offsets.sf);
 
     mOffsets = offsets;
 
@@ -171,10 +285,12 @@ void VSyncModulator::updateOffsetsLocked() {
     const bool isEarly = &offsets == &mOffsetsConfig.early;
     const bool isEarlyGl = &offsets == &mOffsetsConfig.earlyGl;
     const bool isLate = &offsets == &mOffsetsConfig.late;
+    const bool isAdaptiveLate = mAdaptiveLateOffsets && &offsets == &*mAdaptiveLateOffsets;
 
     ATRACE_INT("Vsync-EarlyOffsetsOn", isEarly);
     ATRACE_INT("Vsync-EarlyGLOffsetsOn", isEarlyGl);
     ATRACE_INT("Vsync-LateOffsetsOn", isLate);
+    ATRACE_INT("Vsync-AdaptiveLateOffsetsOn", isAdaptiveLate);
 }
 
 } // namespace android::scheduler
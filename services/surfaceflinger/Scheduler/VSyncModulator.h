@@ -16,8 +16,11 @@
 
 #pragma once
 
+#include <array>
 #include <chrono>
 #include <mutex>
+#include <optional>
+#include <string>
 
 #include "Scheduler.h"
 
@@ -41,6 +44,25 @@ private:
     // Margin used to account for potential data races
     static const constexpr std::chrono::nanoseconds MARGIN_FOR_TX_APPLY = 1ms;
 
+    // Number of recent frame durations the adaptive late offsets are predicted from, and how many
+    // of them are needed before the late offsets are adapted at all.
+    static constexpr size_t FRAME_DURATION_HISTORY_SIZE = 120;
+    static constexpr size_t MIN_FRAME_DURATIONS_FOR_PREDICTION = 30;
+
+    // Percentage of frames which may take longer than the predicted frame duration.
+    static constexpr size_t TARGET_MISSED_FRAME_PERCENT = 1;
+
+    // Margin added to the predicted frame duration. It grows by ADAPTIVE_MARGIN_STEP for every
+    // missed frame, and shrinks by ADAPTIVE_MARGIN_DECAY for every frame once no frame was missed
+    // for a whole history.
+    static const constexpr std::chrono::nanoseconds MIN_ADAPTIVE_MARGIN = 500us;
+    static const constexpr std::chrono::nanoseconds ADAPTIVE_MARGIN_STEP = 1ms;
+    static const constexpr std::chrono::nanoseconds ADAPTIVE_MARGIN_DECAY = 50us;
+
+    // The adaptive late offsets are only updated once they moved by this much, so that the
+    // dispatch is not rescheduled for every frame.
+    static const constexpr std::chrono::nanoseconds ADAPTIVE_OFFSET_UPDATE_THRESHOLD = 100us;
+
 public:
     // Wrapper for a collection of surfaceflinger/app offsets for a particular
     // configuration.
@@ -90,9 +112,20 @@ public:
     // frame.
     void onRefreshed(bool usedRenderEngine);
 
+    // Called once a frame was presented, with the time it took from onMessageInvalidate and the
+    // vsync period it was composed for. If debug.sf.adaptive_late_offsets is set, the late offsets
+    // are replaced by the latest wakeup that leaves enough time for the recent frame durations.
+    void onFrameComposed(nsecs_t duration, nsecs_t vsyncPeriod) EXCLUDES(mMutex);
+
+    // Called when the previous frame missed its vsync, so that the adaptive late offsets leave
+    // more time to compose.
+    void onFrameMissed() EXCLUDES(mMutex);
+
     // Returns the offsets that we are currently using
     Offsets getOffsets() const EXCLUDES(mMutex);
 
+    void dump(std::string& result) const EXCLUDES(mMutex);
+
 private:
     friend class VSyncModulatorTest;
     // Returns the next offsets that we should be using
@@ -100,6 +133,11 @@ private:
     // Updates offsets and persists them into the scheduler framework.
     void updateOffsets() EXCLUDES(mMutex);
     void updateOffsetsLocked() REQUIRES(mMutex);
+    // Returns the late offsets moved so that SurfaceFlinger wakes up the predicted frame duration
+    // and margin before the vsync, without waking up earlier than any of the configured offsets.
+    Offsets calculateAdaptiveLateOffsets() const REQUIRES(mMutex);
+    // Returns the frame duration TARGET_MISSED_FRAME_PERCENT of the recent frames took longer than
+    nsecs_t predictFrameDuration() const REQUIRES(mMutex);
 
     IPhaseOffsetControl& mPhaseOffsetControl;
     const ConnectionHandle mAppConnectionHandle;
@@ -110,6 +148,16 @@ private:
 
     Offsets mOffsets GUARDED_BY(mMutex){mOffsetsConfig.late};
 
+    // Ring buffer of the most recent frame durations, overwritten starting with the oldest
+    std::array<nsecs_t, FRAME_DURATION_HISTORY_SIZE> mFrameDurations GUARDED_BY(mMutex){};
+    size_t mNextFrameDuration GUARDED_BY(mMutex) = 0;
+    size_t mFrameDurationsSize GUARDED_BY(mMutex) = 0;
+    size_t mFramesSinceMissedFrame GUARDED_BY(mMutex) = 0;
+    nsecs_t mAdaptiveMargin GUARDED_BY(mMutex) = MIN_ADAPTIVE_MARGIN.count();
+    nsecs_t mVsyncPeriod GUARDED_BY(mMutex) = 0;
+    // Set once enough frame durations are known to replace the late offsets
+    std::optional<Offsets> mAdaptiveLateOffsets GUARDED_BY(mMutex);
+
     std::atomic<Scheduler::TransactionStart> mTransactionStart =
             Scheduler::TransactionStart::Normal;
     std::atomic<bool> mRefreshRateChangePending = false;
@@ -120,6 +168,7 @@ private:
     std::atomic<std::chrono::steady_clock::time_point> mTxnAppliedTime = {};
 
     bool mTraceDetailedInfo = false;
+    bool mAdaptiveLateOffsetsEnabled = false;
 };
 
 } // namespace android::scheduler
@@ -58,6 +58,72 @@ inline size_t VSyncPredictor::next(int i) const {
     return (i + 1) % mTimestamps.size();
 }
 
+inline size_t VSyncPredictor::oldest() const {
+    return mTimestamps.size() == kHistorySize ? next(mLastTimestampIndex) : 0;
+}
+
+size_t VSyncPredictor::minTimestampIndex() const {
+    if (mOutOfOrderCount == 0) {
+        return oldest();
+    }
+    return std::min_element(mTimestamps.begin(), mTimestamps.end()) - mTimestamps.begin();
+}
+
+size_t VSyncPredictor::maxTimestampIndex() const {
+    if (mOutOfOrderCount == 0) {
+        return mLastTimestampIndex;
+    }
+    return std::max_element(mTimestamps.begin(), mTimestamps.end()) - mTimestamps.begin();
+}
+
+void VSyncPredictor::setOutOfOrder(size_t index, bool outOfOrder) {
+    if (mOutOfOrder[index] != outOfOrder) {
+        mOutOfOrder[index] = outOfOrder;
+        mOutOfOrderCount += outOfOrder ? 1 : -1;
+    }
+}
+
+std::pair<int64_t, nsecs_t> VSyncPredictor::snap(nsecs_t timestamp, nsecs_t period) const {
+    auto const delta = timestamp - mBaseTimestamp;
+    // Rounds to the nearest ordinal, also for timestamps before mBaseTimestamp
+    auto ordinal = (delta + (period / 2)) / period;
+    if ((delta + (period / 2)) % period < 0) {
+        ordinal--;
+    }
+    return {ordinal, delta - ordinal * period};
+}
+
+void VSyncPredictor::resnap(nsecs_t period) {
+    mBaseTimestamp = mTimestamps[minTimestampIndex()];
+    mSnapPeriod = period;
+    mMaxSnapError = 0;
+    mSums = {};
+    for (size_t i = 0; i < mTimestamps.size(); i++) {
+        auto const [ordinal, snapError] = snap(mTimestamps[i], period);
+        mOrdinals[i] = ordinal;
+        mMaxSnapError = std::max(mMaxSnapError, std::abs(snapError));
+        addSample(i);
+    }
+}
+
+void VSyncPredictor::addSample(size_t index) {
+    auto const x = mOrdinals[index];
+    auto const y = mTimestamps[index] - mBaseTimestamp;
+    mSums.x += x;
+    mSums.y += y;
+    mSums.xx += x * x;
+    mSums.xy += x * y;
+}
+
+void VSyncPredictor::removeSample(size_t index) {
+    auto const x = mOrdinals[index];
+    auto const y = mTimestamps[index] - mBaseTimestamp;
+    mSums.x -= x;
+    mSums.y -= y;
+    mSums.xx -= x * x;
+    mSums.xy -= x * y;
+}
+
 bool VSyncPredictor::validate(nsecs_t timestamp) const {
     if (mLastTimestampIndex < 0 || mTimestamps.empty()) {
         return true;
@@ -68,14 +134,70 @@ bool VSyncPredictor::validate(nsecs_t timestamp) const {
     return percent < kOutlierTolerancePercent || percent > (kMaxPercent - kOutlierTolerancePercent);
 }
 
+void VSyncPredictor::PublishedModel::store(const Model& model) {
+    auto const sequence = mSequence.load(std::memory_order_relaxed);
+    // An odd sequence number tells the readers that the model is being written
+    mSequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    mIdealPeriod.store(model.idealPeriod, std::memory_order_relaxed);
+    mSlope.store(model.slope, std::memory_order_relaxed);
+    mIntercept.store(model.intercept, std::memory_order_relaxed);
+    mHasOldestTimestamp.store(model.oldestTimestamp.has_value(), std::memory_order_relaxed);
+    mOldestTimestamp.store(model.oldestTimestamp.value_or(0), std::memory_order_relaxed);
+    mHasKnownTimestamp.store(model.knownTimestamp.has_value(), std::memory_order_relaxed);
+    mKnownTimestamp.store(model.knownTimestamp.value_or(0), std::memory_order_relaxed);
+    mNeedsMoreSamples.store(model.needsMoreSamples, std::memory_order_relaxed);
+
+    mSequence.store(sequence + 2, std::memory_order_release);
+}
+
+VSyncPredictor::Model VSyncPredictor::PublishedModel::load() const {
+    Model model;
+    uint32_t sequence;
+    do {
+        sequence = mSequence.load(std::memory_order_acquire);
+
+        model.idealPeriod = mIdealPeriod.load(std::memory_order_relaxed);
+        model.slope = mSlope.load(std::memory_order_relaxed);
+        model.intercept = mIntercept.load(std::memory_order_relaxed);
+        model.oldestTimestamp = mHasOldestTimestamp.load(std::memory_order_relaxed)
+                ? std::make_optional(mOldestTimestamp.load(std::memory_order_relaxed))
+                : std::nullopt;
+        model.knownTimestamp = mHasKnownTimestamp.load(std::memory_order_relaxed)
+                ? std::make_optional(mKnownTimestamp.load(std::memory_order_relaxed))
+                : std::nullopt;
+        model.needsMoreSamples = mNeedsMoreSamples.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((sequence & 1) != 0 || sequence != mSequence.load(std::memory_order_relaxed));
+    return model;
+}
+
+void VSyncPredictor::publishModel() {
+    auto const [slope, intercept] = mRateMap.find(mIdealPeriod)->second;
+    mModel.store({.idealPeriod = mIdealPeriod,
+                  .slope = slope,
+                  .intercept = intercept,
+                  .oldestTimestamp = mTimestamps.empty()
+                          ? std::nullopt
+                          : std::make_optional(mTimestamps[minTimestampIndex()]),
+                  .knownTimestamp = mKnownTimestamp,
+                  .needsMoreSamples = mTimestamps.size() < kMinimumSamplesForPrediction});
+}
+
 nsecs_t VSyncPredictor::currentPeriod() const {
-    std::lock_guard<std::mutex> lk(mMutex);
-    return std::get<0>(mRateMap.find(mIdealPeriod)->second);
+    return mModel.load().slope;
 }
 
 bool VSyncPredictor::addVsyncTimestamp(nsecs_t timestamp) {
     std::lock_guard<std::mutex> lk(mMutex);
+    bool const accepted = addVsyncTimestampLocked(timestamp);
+    publishModel();
+    return accepted;
+}
 
+bool VSyncPredictor::addVsyncTimestampLocked(nsecs_t timestamp) {
     if (!validate(timestamp)) {
         // VSR could elect to ignore the incongruent timestamp or resetModel(). If ts is ignored,
         // don't insert this ts into mTimestamps ringbuffer. If we are still
@@ -84,27 +206,62 @@ bool VSyncPredictor::addVsyncTimestamp(nsecs_t timestamp) {
         if (mTimestamps.size() < kMinimumSamplesForPrediction) {
             clearTimestamps();
         } else if (!mTimestamps.empty()) {
-            mKnownTimestamp =
-                    std::max(timestamp, *std::max_element(mTimestamps.begin(), mTimestamps.end()));
+            mKnownTimestamp = std::max(timestamp, mTimestamps[maxTimestampIndex()]);
         } else {
             mKnownTimestamp = timestamp;
         }
         return false;
     }
 
+    auto it = mRateMap.find(mIdealPeriod);
+    auto const currentPeriod = std::get<0>(it->second);
+
+    bool const inOrder = mTimestamps.empty() || timestamp > mTimestamps[mLastTimestampIndex];
+    if (mTimestamps.empty()) {
+        mBaseTimestamp = timestamp;
+        mSnapPeriod = currentPeriod;
+    }
+    auto const [ordinal, snapError] = snap(timestamp, mSnapPeriod);
+
     if (mTimestamps.size() != kHistorySize) {
         mTimestamps.push_back(timestamp);
+        mOrdinals.push_back(ordinal);
+        mOutOfOrder.push_back(false);
         mLastTimestampIndex = next(mLastTimestampIndex);
     } else {
         mLastTimestampIndex = next(mLastTimestampIndex);
+        removeSample(mLastTimestampIndex);
+        // The timestamp after the replaced one becomes the oldest, with none before it
+        setOutOfOrder(mLastTimestampIndex, false);
+        setOutOfOrder(next(mLastTimestampIndex), false);
         mTimestamps[mLastTimestampIndex] = timestamp;
+        mOrdinals[mLastTimestampIndex] = ordinal;
     }
+    setOutOfOrder(mLastTimestampIndex, !inOrder);
+    addSample(mLastTimestampIndex);
+    mMaxSnapError = std::max(mMaxSnapError, std::abs(snapError));
+
+    traceInt64If("VSP-ts", timestamp);
 
     if (mTimestamps.size() < kMinimumSamplesForPrediction) {
-        mRateMap[mIdealPeriod] = {mIdealPeriod, 0};
+        it->second = {mIdealPeriod, 0};
         return true;
     }
 
+    // The ordinals have to be the ones snapping the timestamps to the current period would
+    // give, relative to the earliest timestamp. That holds as long as the distance between any
+    // two timestamps and their ordinals, which is at most 2 * mMaxSnapError when snapped to
+    // mSnapPeriod and drifts by the period difference for each ordinal apart they are, stays
+    // under half a period. Otherwise, and once per pass over the ring buffer to keep the sums
+    // small, they are all snapped again.
+    auto const ordinalSpan = mOrdinals[mLastTimestampIndex] - mOrdinals[oldest()];
+    if (mOutOfOrderCount > 0 ||
+        2 * mMaxSnapError + ordinalSpan * std::abs(currentPeriod - mSnapPeriod) >=
+                currentPeriod / 2 ||
+        static_cast<size_t>(mLastTimestampIndex) == kHistorySize - 1) {
+        resnap(currentPeriod);
+    }
+
     // This is a 'simple linear regression' calculation of Y over X, with Y being the
     // vsync timestamps, and X being the ordinal of vsync count.
     // The calculated slope is the vsync period.
@@ -120,39 +277,33 @@ bool VSyncPredictor::addVsyncTimestamp(nsecs_t timestamp) {
     //
     // intercept = mean(Y) - slope * mean(X)
     //
-    std::vector<nsecs_t> vsyncTS(mTimestamps.size());
-    std::vector<nsecs_t> ordinals(mTimestamps.size());
-
-    // normalizing to the oldest timestamp cuts down on error in calculating the intercept.
-    auto const oldest_ts = *std::min_element(mTimestamps.begin(), mTimestamps.end());
-    auto it = mRateMap.find(mIdealPeriod);
-    auto const currentPeriod = std::get<0>(it->second);
+    // Both sums are expanded into the running sums of X, Y, X^2 and X * Y, so that they do not
+    // need to go over all the timestamps.
+    //
     // TODO (b/144707443): its important that there's some precision in the mean of the ordinals
     //                     for the intercept calculation, so scale the ordinals by 1000 to continue
     //                     fixed point calculation. Explore expanding
     //                     scheduler::utils::calculate_mean to have a fixed point fractional part.
     static constexpr int64_t kScalingFactor = 1000;
 
-    for (auto i = 0u; i < mTimestamps.size(); i++) {
-        traceInt64If("VSP-ts", mTimestamps[i]);
-
-        vsyncTS[i] = mTimestamps[i] - oldest_ts;
-        ordinals[i] = ((vsyncTS[i] + (currentPeriod / 2)) / currentPeriod) * kScalingFactor;
-    }
-
-    auto meanTS = scheduler::calculate_mean(vsyncTS);
-    auto meanOrdinal = scheduler::calculate_mean(ordinals);
-    for (auto i = 0; i < vsyncTS.size(); i++) {
-        vsyncTS[i] -= meanTS;
-        ordinals[i] -= meanOrdinal;
-    }
-
-    auto top = 0ll;
-    auto bottom = 0ll;
-    for (auto i = 0; i < vsyncTS.size(); i++) {
-        top += vsyncTS[i] * ordinals[i];
-        bottom += ordinals[i] * ordinals[i];
-    }
+    // normalizing to the oldest timestamp cuts down on error in calculating the intercept.
+    auto const n = static_cast<int64_t>(mTimestamps.size());
+    auto const oldestIndex = minTimestampIndex();
+    auto const oldestOrdinal = mOrdinals[oldestIndex];
+    auto const oldestTimestamp = mTimestamps[oldestIndex] - mBaseTimestamp;
+    auto const sumX = mSums.x - n * oldestOrdinal;
+    auto const sumY = mSums.y - n * oldestTimestamp;
+    auto const sumXX =
+            mSums.xx - 2 * oldestOrdinal * mSums.x + n * oldestOrdinal * oldestOrdinal;
+    auto const sumXY = mSums.xy - oldestOrdinal * mSums.y - oldestTimestamp * mSums.x +
+            n * oldestOrdinal * oldestTimestamp;
+
+    auto const meanTS = sumY / n;
+    auto const meanOrdinal = sumX * kScalingFactor / n;
+    auto const top = kScalingFactor * sumXY - meanOrdinal * sumY -
+            meanTS * kScalingFactor * sumX + n * meanTS * meanOrdinal;
+    auto const bottom = kScalingFactor * kScalingFactor * sumXX -
+            2 * meanOrdinal * kScalingFactor * sumX + n * meanOrdinal * meanOrdinal;
 
     if (CC_UNLIKELY(bottom == 0)) {
         it->second = {mIdealPeriod, 0};
@@ -181,18 +332,18 @@ bool VSyncPredictor::addVsyncTimestamp(nsecs_t timestamp) {
 }
 
 nsecs_t VSyncPredictor::nextAnticipatedVSyncTimeFrom(nsecs_t timePoint) const {
-    std::lock_guard<std::mutex> lk(mMutex);
-
-    auto const [slope, intercept] = getVSyncPredictionModel(lk);
+    Model const model = mModel.load();
+    auto const slope = model.slope;
+    auto const intercept = model.intercept;
 
-    if (mTimestamps.empty()) {
+    if (!model.oldestTimestamp) {
         traceInt64If("VSP-mode", 1);
-        auto const knownTimestamp = mKnownTimestamp ? *mKnownTimestamp : timePoint;
-        auto const numPeriodsOut = ((timePoint - knownTimestamp) / mIdealPeriod) + 1;
-        return knownTimestamp + numPeriodsOut * mIdealPeriod;
+        auto const knownTimestamp = model.knownTimestamp.value_or(timePoint);
+        auto const numPeriodsOut = ((timePoint - knownTimestamp) / model.idealPeriod) + 1;
+        return knownTimestamp + numPeriodsOut * model.idealPeriod;
     }
 
-    auto const oldest = *std::min_element(mTimestamps.begin(), mTimestamps.end());
+    auto const oldest = *model.oldestTimestamp;
 
     // See b/145667109, the ordinal calculation must take into account the intercept.
     auto const zeroPoint = oldest + intercept;
@@ -203,7 +354,7 @@ nsecs_t VSyncPredictor::nextAnticipatedVSyncTimeFrom(nsecs_t timePoint) const {
     traceInt64If("VSP-timePoint", timePoint);
     traceInt64If("VSP-prediction", prediction);
 
-    auto const printer = [&, slope = slope, intercept = intercept] {
+    auto const printer = [&] {
         std::stringstream str;
         str << "prediction made from: " << timePoint << "prediction: " << prediction << " (+"
             << prediction - timePoint << ") slope: " << slope << " intercept: " << intercept
@@ -219,13 +370,8 @@ nsecs_t VSyncPredictor::nextAnticipatedVSyncTimeFrom(nsecs_t timePoint) const {
 }
 
 std::tuple<nsecs_t, nsecs_t> VSyncPredictor::getVSyncPredictionModel() const {
-    std::lock_guard<std::mutex> lk(mMutex);
-    return VSyncPredictor::getVSyncPredictionModel(lk);
-}
-
-std::tuple<nsecs_t, nsecs_t> VSyncPredictor::getVSyncPredictionModel(
-        std::lock_guard<std::mutex> const&) const {
-    return mRateMap.find(mIdealPeriod)->second;
+    Model const model = mModel.load();
+    return {model.slope, model.intercept};
 }
 
 void VSyncPredictor::setPeriod(nsecs_t period) {
@@ -243,11 +389,12 @@ void VSyncPredictor::setPeriod(nsecs_t period) {
     }
 
     clearTimestamps();
+    publishModel();
 }
 
 void VSyncPredictor::clearTimestamps() {
     if (!mTimestamps.empty()) {
-        auto const maxRb = *std::max_element(mTimestamps.begin(), mTimestamps.end());
+        auto const maxRb = mTimestamps[maxTimestampIndex()];
         if (mKnownTimestamp) {
             mKnownTimestamp = std::max(*mKnownTimestamp, maxRb);
         } else {
@@ -255,19 +402,24 @@ void VSyncPredictor::clearTimestamps() {
         }
 
         mTimestamps.clear();
+        mOrdinals.clear();
+        mOutOfOrder.clear();
+        mOutOfOrderCount = 0;
+        mMaxSnapError = 0;
+        mSums = {};
         mLastTimestampIndex = 0;
     }
 }
 
 bool VSyncPredictor::needsMoreSamples() const {
-    std::lock_guard<std::mutex> lk(mMutex);
-    return mTimestamps.size() < kMinimumSamplesForPrediction;
+    return mModel.load().needsMoreSamples;
 }
 
 void VSyncPredictor::resetModel() {
     std::lock_guard<std::mutex> lk(mMutex);
     mRateMap[mIdealPeriod] = {mIdealPeriod, 0};
     clearTimestamps();
+    publishModel();
 }
 
 void VSyncPredictor::dump(std::string& result) const {
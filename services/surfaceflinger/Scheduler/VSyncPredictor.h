@@ -17,8 +17,11 @@
 #pragma once
 
 #include <android-base/thread_annotations.h>
+#include <atomic>
 #include <mutex>
+#include <optional>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 #include "SchedulerUtils.h"
 #include "VSyncTracker.h"
@@ -73,11 +76,51 @@ private:
     size_t const kMinimumSamplesForPrediction;
     size_t const kOutlierTolerancePercent;
 
+    // The model which predictions are made from. It is published whenever it changes, so that
+    // predicting, e.g. whenever VSyncDispatchTimerQueue rearms its timer, never waits for
+    // addVsyncTimestamp.
+    struct Model {
+        nsecs_t idealPeriod = 0;
+        nsecs_t slope = 0;
+        nsecs_t intercept = 0;
+        // The earliest timestamp the model was built from, if any
+        std::optional<nsecs_t> oldestTimestamp;
+        std::optional<nsecs_t> knownTimestamp;
+        bool needsMoreSamples = true;
+    };
+
+    // Seqlock for a single writer, which holds mMutex, and any number of readers
+    class PublishedModel {
+    public:
+        void store(const Model&);
+        Model load() const;
+
+    private:
+        std::atomic<uint32_t> mSequence = 0;
+        std::atomic<nsecs_t> mIdealPeriod = 0;
+        std::atomic<nsecs_t> mSlope = 0;
+        std::atomic<nsecs_t> mIntercept = 0;
+        std::atomic<bool> mHasOldestTimestamp = false;
+        std::atomic<nsecs_t> mOldestTimestamp = 0;
+        std::atomic<bool> mHasKnownTimestamp = false;
+        std::atomic<nsecs_t> mKnownTimestamp = 0;
+        std::atomic<bool> mNeedsMoreSamples = true;
+    };
+
+    bool addVsyncTimestampLocked(nsecs_t timestamp) REQUIRES(mMutex);
+    void publishModel() REQUIRES(mMutex);
+
     std::mutex mutable mMutex;
     size_t next(int i) const REQUIRES(mMutex);
+    size_t oldest() const REQUIRES(mMutex);
+    size_t minTimestampIndex() const REQUIRES(mMutex);
+    size_t maxTimestampIndex() const REQUIRES(mMutex);
+    void setOutOfOrder(size_t index, bool outOfOrder) REQUIRES(mMutex);
+    std::pair<int64_t, nsecs_t> snap(nsecs_t timestamp, nsecs_t period) const REQUIRES(mMutex);
+    void resnap(nsecs_t period) REQUIRES(mMutex);
+    void addSample(size_t index) REQUIRES(mMutex);
+    void removeSample(size_t index) REQUIRES(mMutex);
     bool validate(nsecs_t timestamp) const REQUIRES(mMutex);
-    std::tuple<nsecs_t, nsecs_t> getVSyncPredictionModel(std::lock_guard<std::mutex> const&) const
-            REQUIRES(mMutex);
 
     nsecs_t mIdealPeriod GUARDED_BY(mMutex);
     std::optional<nsecs_t> mKnownTimestamp GUARDED_BY(mMutex);
@@ -86,6 +129,32 @@ private:
 
     int mLastTimestampIndex GUARDED_BY(mMutex) = 0;
     std::vector<nsecs_t> mTimestamps GUARDED_BY(mMutex);
+
+    // The ordinal of each timestamp in mTimestamps, i.e. the number of mSnapPeriod since
+    // mBaseTimestamp. They are only snapped again when the period changed too much for them to
+    // stay the same, so that adding a timestamp does not need to go over all of them.
+    std::vector<int64_t> mOrdinals GUARDED_BY(mMutex);
+    nsecs_t mBaseTimestamp GUARDED_BY(mMutex) = 0;
+    nsecs_t mSnapPeriod GUARDED_BY(mMutex) = 0;
+    // The largest distance between a timestamp and its snapped ordinal
+    nsecs_t mMaxSnapError GUARDED_BY(mMutex) = 0;
+
+    // Whether each timestamp in mTimestamps is not later than the one before it. While there are
+    // none, the oldest timestamp is the earliest and the last one the latest.
+    std::vector<bool> mOutOfOrder GUARDED_BY(mMutex);
+    size_t mOutOfOrderCount GUARDED_BY(mMutex) = 0;
+
+    // Running sums of the ordinals and of the timestamps relative to mBaseTimestamp, for the
+    // linear regression
+    struct RegressionSums {
+        int64_t x = 0;
+        int64_t y = 0;
+        int64_t xx = 0;
+        int64_t xy = 0;
+    };
+    RegressionSums mSums GUARDED_BY(mMutex);
+
+    PublishedModel mModel;
 };
 
 } // namespace android::scheduler
@@ -0,0 +1,77 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <utils/Timers.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include "Scheduler/VSyncPredictor.h"
+
+namespace android::scheduler {
+namespace {
+
+constexpr nsecs_t kPeriod = 16'666'666;
+constexpr size_t kHistorySize = 20;
+constexpr size_t kMinimumSamplesForPrediction = 6;
+constexpr uint32_t kOutlierTolerancePercent = 20;
+
+// Measures how long the dispatch thread takes to get the next vsync from the
+// predictor, which directly delays the callbacks it wakes up for. If range(0)
+// is set, another thread keeps adding timestamps to the predictor meanwhile,
+// as HWC vsync callbacks and present fences do during a resync.
+void nextAnticipatedVSyncTime(benchmark::State& state) {
+    VSyncPredictor predictor(kPeriod, kHistorySize, kMinimumSamplesForPrediction,
+                             kOutlierTolerancePercent);
+    nsecs_t timestamp = systemTime();
+    for (size_t i = 0; i < kHistorySize; i++) {
+        predictor.addVsyncTimestamp(timestamp += kPeriod);
+    }
+
+    std::atomic<bool> done = false;
+    std::thread writer;
+    if (state.range(0)) {
+        writer = std::thread([&, timestamp]() mutable {
+            while (!done.load(std::memory_order_relaxed)) {
+                predictor.addVsyncTimestamp(timestamp += kPeriod);
+            }
+        });
+    }
+
+    nsecs_t maxDuration = 0;
+    nsecs_t timePoint = timestamp;
+    for (auto _ : state) {
+        const nsecs_t start = systemTime();
+        benchmark::DoNotOptimize(predictor.nextAnticipatedVSyncTimeFrom(timePoint));
+        maxDuration = std::max(maxDuration, systemTime() - start);
+        timePoint += kPeriod / 4;
+    }
+
+    done = true;
+    if (writer.joinable()) {
+        writer.join();
+    }
+    state.counters["max_ns"] = static_cast<double>(maxDuration);
+}
+
+BENCHMARK(nextAnticipatedVSyncTime)->Arg(0)->Arg(1);
+
+} // namespace
+} // namespace android::scheduler
+
+BENCHMARK_MAIN();
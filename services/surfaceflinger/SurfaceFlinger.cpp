@@ -72,6 +72,7 @@
 #include <ui/DisplayStatInfo.h>
 #include <ui/DisplayState.h>
 #include <ui/GraphicBufferAllocator.h>
+#include <ui/GraphicBufferMapper.h>
 #include <ui/PixelFormat.h>
 #include <ui/UiConfig.h>
 #include <utils/StopWatch.h>
@@ -87,8 +88,10 @@
 #include <cstdint>
 #include <functional>
 #include <mutex>
+#include <map>
 #include <optional>
 #include <unordered_map>
+#include <unordered_set>
 
 #include "BufferLayer.h"
 #include "BufferQueueLayer.h"
@@ -426,6 +429,17 @@ SurfaceFlinger::SurfaceFlinger(Factory& factory) : SurfaceFlinger(factory, SkipI
     property_get("debug.sf.disable_client_composition_cache", value, "0");
     mDisableClientCompositionCache = atoi(value);
 
+    property_get("debug.sf.incremental_visibility", value, "0");
+    mIncrementalVisibility = atoi(value);
+
+    property_get("debug.sf.layer_group_caching", value, "0");
+    mLayerGroupCaching = atoi(value);
+
+    // Clients send the same buffers repeatedly, so share their imported handles rather than
+    // importing them from gralloc every time.
+    GraphicBufferMapper::get().setImportCacheEnabled(
+            property_get_bool("debug.sf.enable_gralloc_import_cache", false));
+
     // We should be reading 'persist.sys.sf.color_saturation' here
     // but since /data may be encrypted, we need to wait until after vold
     // comes online to attempt to read the property. The property is
@@ -682,6 +696,9 @@ void SurfaceFlinger::init() {
     mCompositionEngine->setTimeStats(mTimeStats);
     mCompositionEngine->setHwComposer(getFactory().createHWComposer(getBE().mHwcServiceName));
     mCompositionEngine->getHwComposer().setConfiguration(this, getBE().mComposerSequenceId);
+    // Threads updating the composition state of several displays concurrently
+    const auto outputWorkerCount = property_get_int32("debug.sf.output_worker_count", 0);
+    mCompositionEngine->setOutputWorkerCount(static_cast<size_t>(std::max(outputWorkerCount, 0)));
     // Process any initial hotplug and resulting display changes.
     processDisplayHotplugEventsLocked();
     const auto display = getDefaultDisplayDeviceLocked();
@@ -691,6 +708,7 @@ void SurfaceFlinger::init() {
 
     // initialize our drawing state
     mDrawingState = mCurrentState;
+    rebuildDrawingLayersInZOrder();
 
     // set initial conditions (e.g. unblank default device)
     initializeDisplays();
@@ -1772,6 +1790,7 @@ void SurfaceFlinger::onMessageInvalidate(nsecs_t expectedVSyncTime) {
 
     if (frameMissed) {
         mFrameMissedCount++;
+        mVSyncModulator->onFrameMissed();
         mTimeStats->incrementMissedFrames();
         if (mMissedFrameJankCount == 0) {
             mMissedFrameJankStart = systemTime();
@@ -1925,10 +1944,11 @@ void SurfaceFlinger::onMessageRefresh() {
     for (const auto& [_, display] : displays) {
         refreshArgs.outputs.push_back(display->getCompositionDisplay());
     }
-    mDrawingState.traverseInZOrder([&refreshArgs](Layer* layer) {
+    refreshArgs.layers.reserve(mDrawingLayersInZOrder.size());
+    for (Layer* layer : mDrawingLayersInZOrder) {
         if (auto layerFE = layer->getCompositionEngineLayerFE())
             refreshArgs.layers.push_back(layerFE);
-    });
+    }
     refreshArgs.layersWithQueuedFrames.reserve(mLayersWithQueuedFrames.size());
     for (sp<Layer> layer : mLayersWithQueuedFrames) {
         if (auto layerFE = layer->getCompositionEngineLayerFE())
@@ -1966,7 +1986,13 @@ void SurfaceFlinger::onMessageRefresh() {
     const auto presentTime = systemTime();
 
     mCompositionEngine->present(refreshArgs);
-    mTimeStats->recordFrameDuration(mFrameStartTime, systemTime());
+    const nsecs_t frameEndTime = systemTime();
+    mTimeStats->recordFrameDuration(mFrameStartTime, frameEndTime);
+    if (mFrameStartTime > 0) {
+        mVSyncModulator->onFrameComposed(frameEndTime - mFrameStartTime,
+                                         mRefreshRateConfigs->getCurrentRefreshRate()
+                                                 .getVsyncPeriod());
+    }
     // Reset the frame start time now that we've recorded this frame.
     mFrameStartTime = 0;
 
@@ -1996,6 +2022,12 @@ void SurfaceFlinger::onMessageRefresh() {
         mTimeStats->incrementCompositionStrategyChanges();
     }
 
+    if (std::any_of(displays.cbegin(), displays.cend(), [](const auto& pair) {
+            return pair.second->getCompositionDisplay()->getState().predictedCompositionStrategy;
+        })) {
+        mTimeStats->incrementCompositionStrategyPredictedFrames();
+    }
+
     // TODO: b/160583065 Enable skip validation when SF caches all client composition layers
     mVSyncModulator->onRefreshed(mHadClientComposition || mReusedClientComposition);
 
@@ -2787,19 +2819,33 @@ void SurfaceFlinger::updateInputFlinger() {
 }
 
 void SurfaceFlinger::updateInputWindowInfo() {
-    std::vector<InputWindowInfo> inputHandles;
-
-    mDrawingState.traverseInReverseZOrder([&](Layer* layer) {
+    std::vector<int32_t> windowIds;
+    std::vector<InputWindowInfo> changedWindows;
+    std::unordered_map<int32_t, InputWindowInfo> inputWindowInfos;
+    windowIds.reserve(mInputWindowInfos.size());
+    inputWindowInfos.reserve(mInputWindowInfos.size());
+
+    // traverseInReverseZOrder visits the layers in exactly the reverse order of traverseInZOrder
+    for (auto it = mDrawingLayersInZOrder.rbegin(); it != mDrawingLayersInZOrder.rend(); ++it) {
+        Layer* const layer = *it;
         if (layer->needsInputInfo()) {
             // When calculating the screen bounds we ignore the transparent region since it may
             // result in an unwanted offset.
-            inputHandles.push_back(layer->fillInputInfo());
+            InputWindowInfo info = layer->fillInputInfo();
+            const auto previous = mInputWindowInfos.find(info.id);
+            if (previous == mInputWindowInfos.end() || previous->second != info) {
+                changedWindows.push_back(info);
+            }
+            windowIds.push_back(info.id);
+            inputWindowInfos.emplace(info.id, std::move(info));
         }
-    });
+    }
+    mInputWindowInfos = std::move(inputWindowInfos);
 
-    mInputFlinger->setInputWindows(inputHandles,
-                                   mInputWindowCommands.syncInputWindows ? mSetInputWindowsListener
-                                                                         : nullptr);
+    mInputFlinger->updateInputWindows(++mInputWindowsGeneration, windowIds, changedWindows,
+                                      mInputWindowCommands.syncInputWindows
+                                              ? mSetInputWindowsListener
+                                              : nullptr);
 }
 
 void SurfaceFlinger::commitInputWindowCommands() {
@@ -2930,6 +2976,14 @@ void SurfaceFlinger::commitTransactionLocked() {
 
     commitOffscreenLayers();
     mDrawingState.traverse([&](Layer* layer) { layer->updateMirrorInfo(); });
+    rebuildDrawingLayersInZOrder();
+}
+
+void SurfaceFlinger::rebuildDrawingLayersInZOrder() {
+    mDrawingLayersInZOrder.clear();
+    mDrawingLayersInZOrder.reserve(mNumLayers.load());
+    mDrawingState.traverseInZOrder(
+            [&](Layer* layer) { mDrawingLayersInZOrder.push_back(layer); });
 }
 
 void SurfaceFlinger::commitOffscreenLayers() {
@@ -3143,6 +3197,9 @@ bool SurfaceFlinger::flushTransactionQueues() {
     {
         Mutex::Autolock _l(mStateLock);
 
+        flushInboundTransactionsLocked(transactions, /*isMainThread*/ true);
+        flushedATransaction = !transactions.empty();
+
         auto it = mTransactionQueues.begin();
         while (it != mTransactionQueues.end()) {
             auto& [applyToken, transactionQueue] = *it;
@@ -3176,7 +3233,27 @@ bool SurfaceFlinger::flushTransactionQueues() {
 }
 
 bool SurfaceFlinger::transactionFlushNeeded() {
-    return !mTransactionQueues.empty();
+    // Inbound transactions are pushed before eTransactionFlushNeeded is set, so one which arrived
+    // after the flush is seen here even if its flag was cleared since.
+    return !mTransactionQueues.empty() || !mInboundTransactions.empty();
+}
+
+void SurfaceFlinger::flushInboundTransactionsLocked(std::vector<const TransactionState>& applied,
+                                                    bool isMainThread) {
+    for (auto& [applyToken, transaction] : mInboundTransactions.popAll()) {
+        if (mTransactionQueues.find(applyToken) != mTransactionQueues.end() ||
+            !transactionIsReadyToBeApplied(transaction.desiredPresentTime, transaction.states)) {
+            mTransactionQueues[applyToken].push(std::move(transaction));
+            setTransactionFlags(eTransactionFlushNeeded);
+            continue;
+        }
+        applyTransactionState(transaction.states, transaction.displays, transaction.flags,
+                              mPendingInputWindowCommands, transaction.desiredPresentTime,
+                              transaction.buffer, transaction.postTime, transaction.privileged,
+                              transaction.hasListenerCallbacks, transaction.listenerCallbacks,
+                              isMainThread);
+        applied.push_back(std::move(transaction));
+    }
 }
 
 
@@ -3214,8 +3291,43 @@ void SurfaceFlinger::setTransactionState(
 
     bool privileged = callingThreadHasUnscopedSurfaceFlingerAccess();
 
+    // Transactions which block the caller or change the vsync offsets need mStateLock. The others
+    // only need to be applied before the next frame, so the main thread picks them up without
+    // this thread taking the lock.
+    constexpr uint32_t kLockedFlags = eSynchronous | eAnimation | eEarlyWakeup |
+            eExplicitEarlyWakeupStart | eExplicitEarlyWakeupEnd;
+    if (!(flags & kLockedFlags) && !inputWindowCommands.syncInputWindows) {
+        // Expected present time is computed and cached on invalidate, so it may be stale.
+        mExpectedPresentTime = calculateExpectedPresentTime(systemTime());
+        mInboundTransactions.push({applyToken,
+                                   TransactionState(states, displays, flags, desiredPresentTime,
+                                                    uncacheBuffer, postTime, privileged,
+                                                    hasListenerCallbacks, listenerCallbacks)});
+        // Like setTransactionFlags, without touching the VSyncModulator, which needs mStateLock
+        if ((mTransactionFlags.fetch_or(eTransactionFlushNeeded) & eTransactionFlushNeeded) == 0) {
+            signalTransaction();
+        }
+        return;
+    }
+
+    queueOrApplyTransactionState(states, displays, flags, applyToken, inputWindowCommands,
+                                 desiredPresentTime, uncacheBuffer, postTime, privileged,
+                                 hasListenerCallbacks, listenerCallbacks);
+}
+
+void SurfaceFlinger::queueOrApplyTransactionState(
+        const Vector<ComposerState>& states, const Vector<DisplayState>& displays, uint32_t flags,
+        const sp<IBinder>& applyToken, const InputWindowCommands& inputWindowCommands,
+        int64_t desiredPresentTime, const client_cache_t& uncacheBuffer, int64_t postTime,
+        bool privileged, bool hasListenerCallbacks,
+        const std::vector<ListenerCallbacks>& listenerCallbacks) {
+    // destroyed after the lock is released, see flushTransactionQueues
+    std::vector<const TransactionState> inboundTransactions;
     Mutex::Autolock _l(mStateLock);
 
+    // Transactions sent earlier without mStateLock go first
+    flushInboundTransactionsLocked(inboundTransactions, /*isMainThread*/ false);
+
     // If its TransactionQueue already has a pending TransactionState or if it is pending
     auto itr = mTransactionQueues.find(applyToken);
     // if this is an animation frame, wait until prior animation frame has
@@ -3757,7 +3869,8 @@ uint32_t SurfaceFlinger::setClientStateLocked(
     sp<GraphicBuffer> buffer;
     if (bufferChanged && cacheIdChanged && s.buffer != nullptr) {
         buffer = s.buffer;
-        bool success = ClientCache::getInstance().add(s.cachedBuffer, s.buffer);
+        bool success =
+                ClientCache::getInstance().add(s.cachedBuffer, s.buffer, layer->getOwnerUid());
         if (success) {
             getRenderEngine().cacheExternalTextureBuffer(s.buffer);
             success = ClientCache::getInstance()
@@ -3771,6 +3884,12 @@ uint32_t SurfaceFlinger::setClientStateLocked(
         buffer = ClientCache::getInstance().get(s.cachedBuffer);
     } else if (bufferChanged) {
         buffer = s.buffer;
+        // Create the image ahead of time rather than when the layer is first
+        // drawn. Images of buffers which are not in the client cache are evicted
+        // from RenderEngine once they stopped being drawn.
+        if (buffer) {
+            getRenderEngine().cacheExternalTextureBuffer(buffer);
+        }
     }
     if (buffer) {
         if (layer->setBuffer(buffer, s.acquireFence, postTime, desiredPresentTime,
@@ -4063,8 +4182,9 @@ void SurfaceFlinger::onInitializeDisplays() {
     d.width = 0;
     d.height = 0;
     displays.add(d);
-    setTransactionState(state, displays, 0, nullptr, mPendingInputWindowCommands, -1, {}, false,
-                        {});
+    queueOrApplyTransactionState(state, displays, 0, nullptr, mPendingInputWindowCommands, -1, {},
+                                 systemTime(), callingThreadHasUnscopedSurfaceFlingerAccess(),
+                                 false, {});
 
     setPowerModeInternal(display, hal::PowerMode::ON);
     const nsecs_t vsyncPeriod = mRefreshRateConfigs->getCurrentRefreshRate().getVsyncPeriod();
@@ -4205,7 +4325,11 @@ status_t SurfaceFlinger::doDump(int fd, const DumpArgs& args, bool asProto) {
         const auto flag = args.empty() ? ""s : std::string(String8(args[0]));
 
         bool dumpLayers = true;
-        {
+        if (flag == "--memory"s) {
+            // Collected on the main thread, which may be waiting for mStateLock
+            dumpMemory(asProto, result);
+            dumpLayers = false;
+        } else {
             TimedLock lock(mStateLock, s2ns(1), __FUNCTION__);
             if (!lock.locked()) {
                 StringAppendF(&result, "Dumping without lock after timeout: %s (%d)\n",
@@ -4317,6 +4441,7 @@ void SurfaceFlinger::dumpVSync(std::string& result) const {
     StringAppendF(&result,
                   "      present offset: %9" PRId64 " ns\t     VSYNC period: %9" PRId64 " ns\n\n",
                   dispSyncPresentTimeOffset, getVsyncPeriodFromHWC());
+    mVSyncModulator->dump(result);
 
     scheduler::RefreshRateConfigs::Policy policy = mRefreshRateConfigs->getDisplayManagerPolicy();
     StringAppendF(&result,
@@ -4543,6 +4668,124 @@ void SurfaceFlinger::dumpOffscreenLayers(std::string& result) {
                   }).get());
 }
 
+MemoryProto SurfaceFlinger::dumpMemoryProto() const {
+    auto renderEngineUsage = getRenderEngine().getMemoryUsage();
+
+    struct UidMemory {
+        // Buffers held by layers, and the ones cached by processes, keyed by buffer ID
+        std::unordered_map<uint64_t, size_t> layerBuffers;
+        std::unordered_set<uint64_t> cachedBuffers;
+        size_t clientCacheBytes = 0;
+    };
+    std::map<uid_t, UidMemory> uids;
+
+    MemoryProto memoryProto;
+    const auto addLayer = [&](Layer* layer) {
+        std::unordered_map<uint64_t, sp<GraphicBuffer>> buffers;
+        layer->getHeldBuffers(buffers);
+        if (buffers.empty()) {
+            return;
+        }
+
+        const uid_t ownerUid = layer->getOwnerUid();
+        auto& uidMemory = uids[ownerUid];
+        size_t bufferBytes = 0;
+        size_t imageBytes = 0;
+        for (const auto& [id, buffer] : buffers) {
+            const size_t size = getClientCacheBufferSize(buffer);
+            bufferBytes += size;
+            uidMemory.layerBuffers.emplace(id, size);
+            if (const auto it = renderEngineUsage.imageCacheBytes.find(id);
+                it != renderEngineUsage.imageCacheBytes.end()) {
+                imageBytes += it->second;
+            }
+        }
+
+        LayerMemoryProto* layerProto = memoryProto.add_layers();
+        layerProto->set_id(layer->getSequence());
+        layerProto->set_name(layer->getName());
+        layerProto->set_owner_uid(static_cast<int32_t>(ownerUid));
+        layerProto->set_buffer_bytes(bufferBytes);
+        layerProto->set_image_bytes(imageBytes);
+    };
+    mDrawingState.traverse(addLayer);
+    for (Layer* offscreenLayer : mOffscreenLayers) {
+        offscreenLayer->traverse(LayerVector::StateSet::Drawing, addLayer);
+    }
+
+    for (const auto& [id, usage] : ClientCache::getInstance().getBufferUsage()) {
+        auto& uidMemory = uids[usage.ownerUid];
+        uidMemory.clientCacheBytes += usage.size;
+        uidMemory.cachedBuffers.insert(id);
+    }
+
+    // Each image is attributed to the first uid holding its buffer, and the images left are
+    // reported as unattributed.
+    auto& images = renderEngineUsage.imageCacheBytes;
+    const auto takeImageBytes = [&images](uint64_t id) -> size_t {
+        const auto it = images.find(id);
+        if (it == images.end()) {
+            return 0;
+        }
+        const size_t size = it->second;
+        images.erase(it);
+        return size;
+    };
+    for (const auto& [uid, uidMemory] : uids) {
+        size_t layerBufferBytes = 0;
+        size_t imageBytes = 0;
+        for (const auto& [id, size] : uidMemory.layerBuffers) {
+            layerBufferBytes += size;
+            imageBytes += takeImageBytes(id);
+        }
+        for (const uint64_t id : uidMemory.cachedBuffers) {
+            imageBytes += takeImageBytes(id);
+        }
+
+        UidMemoryProto* uidProto = memoryProto.add_uids();
+        uidProto->set_uid(static_cast<int32_t>(uid));
+        uidProto->set_layer_buffer_bytes(layerBufferBytes);
+        uidProto->set_client_cache_bytes(uidMemory.clientCacheBytes);
+        uidProto->set_image_bytes(imageBytes);
+    }
+
+    size_t unattributedImageBytes = 0;
+    for (const auto& [id, size] : images) {
+        unattributedImageBytes += size;
+    }
+    memoryProto.set_unattributed_image_bytes(unattributedImageBytes);
+    memoryProto.set_framebuffer_image_bytes(renderEngineUsage.framebufferImageCacheBytes);
+    memoryProto.set_blur_bytes(renderEngineUsage.blurBytes);
+    return memoryProto;
+}
+
+void SurfaceFlinger::dumpMemory(bool asProto, std::string& result) {
+    const MemoryProto memoryProto = schedule([this] { return dumpMemoryProto(); }).get();
+    if (asProto) {
+        result.append(memoryProto.SerializeAsString());
+        return;
+    }
+
+    result.append("Graphics memory by uid (KiB):\n");
+    StringAppendF(&result, "%10s %10s %10s %10s\n", "uid", "layers", "cache", "images");
+    for (const auto& uid : memoryProto.uids()) {
+        StringAppendF(&result, "%10d %10" PRIu64 " %10" PRIu64 " %10" PRIu64 "\n", uid.uid(),
+                      uid.layer_buffer_bytes() / 1024, uid.client_cache_bytes() / 1024,
+                      uid.image_bytes() / 1024);
+    }
+    result.append("\nGraphics memory by layer (KiB):\n");
+    for (const auto& layer : memoryProto.layers()) {
+        StringAppendF(&result, "  %s (uid %d): buffers %" PRIu64 ", images %" PRIu64 "\n",
+                      layer.name().c_str(), layer.owner_uid(),
+                      layer.buffer_bytes() / 1024, layer.image_bytes() / 1024);
+    }
+    StringAppendF(&result, "\nUnattributed images: %" PRIu64 " KiB\n",
+                  memoryProto.unattributed_image_bytes() / 1024);
+    StringAppendF(&result, "Framebuffer images: %" PRIu64 " KiB\n",
+                  memoryProto.framebuffer_image_bytes() / 1024);
+    StringAppendF(&result, "Blur buffers: %" PRIu64 " KiB\n", memoryProto.blur_bytes() / 1024);
+}
+
 void SurfaceFlinger::dumpAllLocked(const DumpArgs& args, std::string& result) const {
     const bool colorize = !args.empty() && args[0] == String16("--color");
     Colorizer colorizer(colorize);
@@ -4643,6 +4886,8 @@ void SurfaceFlinger::dumpAllLocked(const DumpArgs& args, std::string& result) co
 
     DebugEGLImageTracker::getInstance()->dump(result);
 
+    ClientCache::getInstance().dump(result);
+
     if (const auto display = getDefaultDisplayDeviceLocked()) {
         display->getCompositionDisplay()->getState().undefinedRegion.dump(result,
                                                                           "undefinedRegion");
@@ -4816,6 +5061,7 @@ status_t SurfaceFlinger::CheckTransactCodeCredentials(uint32_t code) {
             return OK;
         }
         case CAPTURE_LAYERS:
+        case CAPTURE_LAYERS_ASYNC:
         case CAPTURE_SCREEN:
         case ADD_REGION_SAMPLING_LISTENER:
         case REMOVE_REGION_SAMPLING_LISTENER: {
@@ -5420,6 +5666,24 @@ status_t SurfaceFlinger::captureLayers(
         float frameScale, bool childrenOnly) {
     ATRACE_CALL();
 
+    sp<Fence> fence;
+    const status_t result =
+            captureLayersAsync(layerHandleBinder, nullptr, reqDataspace, reqPixelFormat,
+                               sourceCrop, excludeHandles, frameScale, childrenOnly, outBuffer,
+                               &fence);
+    if (result == NO_ERROR) {
+        fence->waitForever("captureLayers");
+    }
+    return result;
+}
+
+status_t SurfaceFlinger::captureLayersAsync(
+        const sp<IBinder>& layerHandleBinder, const sp<GraphicBuffer>& buffer,
+        const Dataspace reqDataspace, const ui::PixelFormat reqPixelFormat, const Rect& sourceCrop,
+        const std::unordered_set<sp<IBinder>, ISurfaceComposer::SpHash<IBinder>>& excludeHandles,
+        float frameScale, bool childrenOnly, sp<GraphicBuffer>* outBuffer, sp<Fence>* outFence) {
+    ATRACE_CALL();
+
     class LayerRenderArea : public RenderArea {
     public:
         LayerRenderArea(SurfaceFlinger* flinger, const sp<Layer>& layer, const Rect crop,
@@ -5567,6 +5831,15 @@ status_t SurfaceFlinger::captureLayers(
         reqHeight = 1;
     }
 
+    if (buffer &&
+        (buffer->getWidth() != static_cast<uint32_t>(reqWidth) ||
+         buffer->getHeight() != static_cast<uint32_t>(reqHeight) ||
+         buffer->getPixelFormat() != static_cast<PixelFormat>(reqPixelFormat) ||
+         !(buffer->getUsage() & GRALLOC_USAGE_HW_RENDER))) {
+        ALOGE("captureLayers called with a buffer that does not match the capture");
+        return BAD_VALUE;
+    }
+
     LayerRenderArea renderArea(this, parent, crop, reqWidth, reqHeight, reqDataspace, childrenOnly,
                                displayViewport);
     auto traverseLayers = [parent, childrenOnly,
@@ -5591,8 +5864,13 @@ status_t SurfaceFlinger::captureLayers(
     };
 
     bool outCapturedSecureLayers = false;
+    if (buffer) {
+        *outBuffer = buffer;
+        return captureScreenCommon(renderArea, traverseLayers, buffer, false /* identityTransform */,
+                                   false /* regionSampling */, outCapturedSecureLayers, outFence);
+    }
     return captureScreenCommon(renderArea, traverseLayers, outBuffer, reqPixelFormat, false,
-                               outCapturedSecureLayers);
+                               outCapturedSecureLayers, outFence);
 }
 
 status_t SurfaceFlinger::captureScreenCommon(RenderArea& renderArea,
@@ -5600,7 +5878,7 @@ status_t SurfaceFlinger::captureScreenCommon(RenderArea& renderArea,
                                              sp<GraphicBuffer>* outBuffer,
                                              const ui::PixelFormat reqPixelFormat,
                                              bool useIdentityTransform,
-                                             bool& outCapturedSecureLayers) {
+                                             bool& outCapturedSecureLayers, sp<Fence>* outFence) {
     ATRACE_CALL();
 
     // TODO(b/116112787) Make buffer usage a parameter.
@@ -5612,14 +5890,14 @@ status_t SurfaceFlinger::captureScreenCommon(RenderArea& renderArea,
                                              usage, "screenshot");
 
     return captureScreenCommon(renderArea, traverseLayers, *outBuffer, useIdentityTransform,
-                               false /* regionSampling */, outCapturedSecureLayers);
+                               false /* regionSampling */, outCapturedSecureLayers, outFence);
 }
 
 status_t SurfaceFlinger::captureScreenCommon(RenderArea& renderArea,
                                              TraverseLayersFunction traverseLayers,
                                              const sp<GraphicBuffer>& buffer,
                                              bool useIdentityTransform, bool regionSampling,
-                                             bool& outCapturedSecureLayers) {
+                                             bool& outCapturedSecureLayers, sp<Fence>* outFence) {
     const int uid = IPCThreadState::self()->getCallingUid();
     const bool forSystem = uid == AID_GRAPHICS || uid == AID_SYSTEM;
 
@@ -5648,7 +5926,14 @@ status_t SurfaceFlinger::captureScreenCommon(RenderArea& renderArea,
                 }).get();
     } while (result == EAGAIN);
 
-    if (result == NO_ERROR) {
+    if (result != NO_ERROR) {
+        return result;
+    }
+
+    if (outFence) {
+        // Hand the fence to the caller rather than blocking this thread on the GPU.
+        *outFence = syncFd >= 0 ? sp<Fence>(new Fence(syncFd)) : Fence::NO_FENCE;
+    } else {
         sync_wait(syncFd, -1);
         close(syncFd);
     }
@@ -56,6 +56,7 @@
 #include "Effects/Daltonizer.h"
 #include "FrameTracker.h"
 #include "LayerVector.h"
+#include "LockFreeQueue.h"
 #include "Scheduler/RefreshRateConfigs.h"
 #include "Scheduler/RefreshRateStats.h"
 #include "Scheduler/Scheduler.h"
@@ -332,6 +333,16 @@ public:
     // debug.sf.disable_client_composition_cache
     bool mDisableClientCompositionCache = false;
 
+    // If set, reuses the visibility of layers whose geometry did not change
+    // when rebuilding layer stacks. This can be set by
+    // debug.sf.incremental_visibility
+    bool mIncrementalVisibility = false;
+
+    // If set, caches the rendering of the bottom-most client composition
+    // layers which stopped changing. This can be set by
+    // debug.sf.layer_group_caching
+    bool mLayerGroupCaching = false;
+
 private:
     friend class BufferLayer;
     friend class BufferQueueLayer;
@@ -437,6 +448,13 @@ private:
             const Rect& sourceCrop,
             const std::unordered_set<sp<IBinder>, ISurfaceComposer::SpHash<IBinder>>& exclude,
             float frameScale, bool childrenOnly) override;
+    status_t captureLayersAsync(
+            const sp<IBinder>& parentHandle, const sp<GraphicBuffer>& buffer,
+            const ui::Dataspace reqDataspace, const ui::PixelFormat reqPixelFormat,
+            const Rect& sourceCrop,
+            const std::unordered_set<sp<IBinder>, ISurfaceComposer::SpHash<IBinder>>& exclude,
+            float frameScale, bool childrenOnly, sp<GraphicBuffer>* outBuffer,
+            sp<Fence>* outFence) override;
 
     status_t getDisplayStats(const sp<IBinder>& displayToken, DisplayStatInfo* stats) override;
     status_t getDisplayState(const sp<IBinder>& displayToken, ui::DisplayState*) override;
@@ -622,6 +640,23 @@ private:
                                bool privileged, bool hasListenerCallbacks,
                                const std::vector<ListenerCallbacks>& listenerCallbacks,
                                bool isMainThread = false) REQUIRES(mStateLock);
+    // Applies the transaction if it is ready and no earlier transaction with the same apply token
+    // is pending, or adds it to mTransactionQueues otherwise.
+    void queueOrApplyTransactionState(const Vector<ComposerState>& states,
+                                      const Vector<DisplayState>& displays, uint32_t flags,
+                                      const sp<IBinder>& applyToken,
+                                      const InputWindowCommands& inputWindowCommands,
+                                      int64_t desiredPresentTime,
+                                      const client_cache_t& uncacheBuffer, int64_t postTime,
+                                      bool privileged, bool hasListenerCallbacks,
+                                      const std::vector<ListenerCallbacks>& listenerCallbacks)
+            EXCLUDES(mStateLock);
+    struct TransactionState;
+    // Takes the transactions queued without mStateLock, in order, and applies or queues each of
+    // them like queueOrApplyTransactionState. The applied transactions are added to 'applied', so
+    // that they are destroyed after mStateLock is released.
+    void flushInboundTransactionsLocked(std::vector<const TransactionState>& applied,
+                                        bool isMainThread) REQUIRES(mStateLock);
     // Returns true if at least one transaction was flushed
     bool flushTransactionQueues();
     // Returns true if there is at least one transaction that needs to be flushed
@@ -639,6 +674,9 @@ private:
     uint32_t setTransactionFlags(uint32_t flags, Scheduler::TransactionStart transactionStart);
     void commitTransaction() REQUIRES(mStateLock);
     void commitOffscreenLayers();
+    // Flattens the layer tree of mDrawingState into mDrawingLayersInZOrder. Must be called
+    // whenever the drawing state is committed.
+    void rebuildDrawingLayersInZOrder();
     bool transactionIsReadyToBeApplied(int64_t desiredPresentTime,
                                        const Vector<ComposerState>& states);
     uint32_t setDisplayStateLocked(const DisplayState& s) REQUIRES(mStateLock);
@@ -718,12 +756,16 @@ private:
     void renderScreenImplLocked(const RenderArea& renderArea, TraverseLayersFunction traverseLayers,
                                 ANativeWindowBuffer* buffer, bool useIdentityTransform,
                                 bool regionSampling, int* outSyncFd);
+    // If outFence is set, it is set to the fence signaling completion of the rendering instead
+    // of waiting for it.
     status_t captureScreenCommon(RenderArea& renderArea, TraverseLayersFunction traverseLayers,
                                  sp<GraphicBuffer>* outBuffer, const ui::PixelFormat reqPixelFormat,
-                                 bool useIdentityTransform, bool& outCapturedSecureLayers);
+                                 bool useIdentityTransform, bool& outCapturedSecureLayers,
+                                 sp<Fence>* outFence = nullptr);
     status_t captureScreenCommon(RenderArea& renderArea, TraverseLayersFunction traverseLayers,
                                  const sp<GraphicBuffer>& buffer, bool useIdentityTransform,
-                                 bool regionSampling, bool& outCapturedSecureLayers);
+                                 bool regionSampling, bool& outCapturedSecureLayers,
+                                 sp<Fence>* outFence = nullptr);
     sp<DisplayDevice> getDisplayByIdOrLayerStack(uint64_t displayOrLayerStack) REQUIRES(mStateLock);
     sp<DisplayDevice> getDisplayByLayerStack(uint64_t layerStack) REQUIRES(mStateLock);
     status_t captureScreenImplLocked(const RenderArea& renderArea,
@@ -963,6 +1005,9 @@ private:
     LayersProto dumpProtoFromMainThread(uint32_t traceFlags = SurfaceTracing::TRACE_ALL)
             EXCLUDES(mStateLock);
     void dumpOffscreenLayers(std::string& result) EXCLUDES(mStateLock);
+    // Sizes of the buffers held by layers, the client cache and RenderEngine, per layer and uid
+    MemoryProto dumpMemoryProto() const;
+    void dumpMemory(bool asProto, std::string& result) EXCLUDES(mStateLock);
 
     bool isLayerTripleBufferingDisabled() const {
         return this->mLayerTripleBufferingDisabled;
@@ -1021,9 +1066,17 @@ private:
     // Can only accessed from the main thread, these members
     // don't need synchronization
     State mDrawingState{LayerVector::StateSet::Drawing};
+    // The layers of mDrawingState, as visited by traverseInZOrder, so that per-frame passes do
+    // not have to walk the layer tree. Layers in the drawing state are kept alive by it until it
+    // is next committed, which is when this is rebuilt.
+    std::vector<Layer*> mDrawingLayersInZOrder;
     bool mVisibleRegionsDirty = false;
     // Set during transaction commit stage to track if the input info for a layer has changed.
     bool mInputInfoChanged = false;
+    // The input windows last sent to InputFlinger, by id, so that only the ones which changed
+    // are sent with the next update.
+    std::unordered_map<int32_t, InputWindowInfo> mInputWindowInfos;
+    uint64_t mInputWindowsGeneration = 0;
     bool mGeometryInvalid = false;
     bool mAnimCompositionPending = false;
     std::vector<sp<Layer>> mLayersWithQueuedFrames;
@@ -1142,6 +1195,15 @@ private:
     };
     std::unordered_map<sp<IBinder>, std::queue<TransactionState>, IListenerHash> mTransactionQueues;
 
+    // Asynchronous transactions are queued here by setTransactionState without taking
+    // mStateLock, so that binder threads do not contend with the main thread for it. They are
+    // moved to mTransactionQueues whenever mStateLock is next taken to handle transactions.
+    struct InboundTransaction {
+        sp<IBinder> applyToken;
+        TransactionState state;
+    };
+    LockFreeQueue<InboundTransaction> mInboundTransactions;
+
     /* ------------------------------------------------------------------------
      * Feature prototyping
      */
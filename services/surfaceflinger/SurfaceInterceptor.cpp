@@ -28,6 +28,7 @@
 #include <fstream>
 
 #include <android-base/file.h>
+#include <cutils/properties.h>
 #include <log/log.h>
 #include <utils/Trace.h>
 
@@ -45,6 +46,11 @@ SurfaceInterceptor::SurfaceInterceptor(SurfaceFlinger* flinger)
 {
 }
 
+SurfaceInterceptor::~SurfaceInterceptor() {
+    std::lock_guard<std::mutex> protoGuard(mTraceMutex);
+    stopWriterLocked();
+}
+
 void SurfaceInterceptor::enable(const SortedVector<sp<Layer>>& layers,
         const DefaultKeyedVector< wp<IBinder>, DisplayDeviceState>& displays)
 {
@@ -54,8 +60,13 @@ void SurfaceInterceptor::enable(const SortedVector<sp<Layer>>& layers,
     ATRACE_CALL();
     mEnabled = true;
     std::lock_guard<std::mutex> protoGuard(mTraceMutex);
+    mStreaming = property_get_bool("debug.sf.interceptor_streaming", false);
+    if (mStreaming) {
+        startWriterLocked();
+    }
     saveExistingDisplaysLocked(displays);
     saveExistingSurfacesLocked(layers);
+    streamIncrementsLocked();
 }
 
 void SurfaceInterceptor::disable() {
@@ -65,6 +76,10 @@ void SurfaceInterceptor::disable() {
     ATRACE_CALL();
     std::lock_guard<std::mutex> protoGuard(mTraceMutex);
     mEnabled = false;
+    if (mStreaming) {
+        stopWriterLocked();
+        return;
+    }
     status_t err(writeProtoFileLocked());
     ALOGE_IF(err == PERMISSION_DENIED, "Could not save the proto file! Permission denied");
     ALOGE_IF(err == NOT_ENOUGH_DATA, "Could not save the proto file! There are missing fields");
@@ -163,6 +178,94 @@ status_t SurfaceInterceptor::writeProtoFileLocked() {
     return NO_ERROR;
 }
 
+void SurfaceInterceptor::streamIncrementsLocked() {
+    if (!mStreaming) {
+        return;
+    }
+    for (Increment& increment : *mTrace.mutable_increment()) {
+        if (mStreamedIncrementCount.fetch_add(1) >= kMaxStreamedIncrements) {
+            mStreamedIncrementCount--;
+            mDroppedIncrements++;
+            continue;
+        }
+        auto streamed = std::make_unique<Increment>();
+        streamed->Swap(&increment);
+        mStreamedIncrements.push(std::move(streamed));
+    }
+    mTrace.clear_increment();
+    mWriterCondition.notify_one();
+}
+
+void SurfaceInterceptor::startWriterLocked() {
+    {
+        std::lock_guard<std::mutex> lock(mWriterMutex);
+        mStopWriter = false;
+    }
+    mDroppedIncrements = 0;
+    mWriterThread = std::thread(&SurfaceInterceptor::writerLoop, this);
+}
+
+void SurfaceInterceptor::stopWriterLocked() {
+    if (!mWriterThread.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mWriterMutex);
+        mStopWriter = true;
+    }
+    mWriterCondition.notify_one();
+    mWriterThread.join();
+    ALOGW_IF(mDroppedIncrements > 0, "Dropped %u increments which could not be written in time",
+             mDroppedIncrements.load());
+}
+
+void SurfaceInterceptor::writerLoop() {
+    std::ofstream output(mOutputFileName, std::ios::binary | std::ios::trunc);
+    if (!output) {
+        ALOGE("Could not open %s for writing", mOutputFileName.c_str());
+    }
+
+    std::string serialized;
+    bool stop = false;
+    while (!stop) {
+        {
+            // Pushes do not take mWriterMutex, so wake up periodically in case a notification
+            // was missed.
+            std::unique_lock<std::mutex> lock(mWriterMutex);
+            mWriterCondition.wait_for(lock, std::chrono::milliseconds(100), [this]() {
+                return mStopWriter || !mStreamedIncrements.empty();
+            });
+            stop = mStopWriter;
+        }
+
+        // Drained once more after being stopped, as the last increments may have been queued
+        // right before.
+        std::vector<std::unique_ptr<Increment>> increments = mStreamedIncrements.popAll();
+        mStreamedIncrementCount -= increments.size();
+        if (!output) {
+            continue;
+        }
+        ATRACE_NAME("SurfaceInterceptor::write");
+        for (const auto& increment : increments) {
+            if (!increment->SerializeToString(&serialized)) {
+                ALOGE("Could not save an increment! There are missing fields");
+                continue;
+            }
+            // Each increment is a length delimited Trace.increment field, so that the file
+            // parses as a whole Trace.
+            output.put(static_cast<char>(Trace::kIncrementFieldNumber << 3 | 2));
+            size_t length = serialized.size();
+            while (length >= 0x80) {
+                output.put(static_cast<char>(length | 0x80));
+                length >>= 7;
+            }
+            output.put(static_cast<char>(length));
+            output.write(serialized.data(), static_cast<std::streamsize>(serialized.size()));
+        }
+        output.flush();
+    }
+}
+
 const sp<const Layer> SurfaceInterceptor::getLayer(const wp<const IBinder>& weakHandle) const {
     const sp<const IBinder>& handle(weakHandle.promote());
     const auto layerHandle(static_cast<const Layer::Handle*>(handle.get()));
@@ -624,6 +727,7 @@ void SurfaceInterceptor::saveTransaction(const Vector<ComposerState>& stateUpdat
     std::lock_guard<std::mutex> protoGuard(mTraceMutex);
     addTransactionLocked(createTraceIncrementLocked(), stateUpdates, displays, changedDisplays,
             flags);
+    streamIncrementsLocked();
 }
 
 void SurfaceInterceptor::saveSurfaceCreation(const sp<const Layer>& layer) {
@@ -633,6 +737,7 @@ void SurfaceInterceptor::saveSurfaceCreation(const sp<const Layer>& layer) {
     ATRACE_CALL();
     std::lock_guard<std::mutex> protoGuard(mTraceMutex);
     addSurfaceCreationLocked(createTraceIncrementLocked(), layer);
+    streamIncrementsLocked();
 }
 
 void SurfaceInterceptor::saveSurfaceDeletion(const sp<const Layer>& layer) {
@@ -642,6 +747,7 @@ void SurfaceInterceptor::saveSurfaceDeletion(const sp<const Layer>& layer) {
     ATRACE_CALL();
     std::lock_guard<std::mutex> protoGuard(mTraceMutex);
     addSurfaceDeletionLocked(createTraceIncrementLocked(), layer);
+    streamIncrementsLocked();
 }
 
 /**
@@ -660,6 +766,7 @@ void SurfaceInterceptor::saveBufferUpdate(int32_t layerId, uint32_t width,
     ATRACE_CALL();
     std::lock_guard<std::mutex> protoGuard(mTraceMutex);
     addBufferUpdateLocked(createTraceIncrementLocked(), layerId, width, height, frameNumber);
+    streamIncrementsLocked();
 }
 
 void SurfaceInterceptor::saveVSyncEvent(nsecs_t timestamp) {
@@ -668,6 +775,7 @@ void SurfaceInterceptor::saveVSyncEvent(nsecs_t timestamp) {
     }
     std::lock_guard<std::mutex> protoGuard(mTraceMutex);
     addVSyncUpdateLocked(createTraceIncrementLocked(), timestamp);
+    streamIncrementsLocked();
 }
 
 void SurfaceInterceptor::saveDisplayCreation(const DisplayDeviceState& info) {
@@ -677,6 +785,7 @@ void SurfaceInterceptor::saveDisplayCreation(const DisplayDeviceState& info) {
     ATRACE_CALL();
     std::lock_guard<std::mutex> protoGuard(mTraceMutex);
     addDisplayCreationLocked(createTraceIncrementLocked(), info);
+    streamIncrementsLocked();
 }
 
 void SurfaceInterceptor::saveDisplayDeletion(int32_t sequenceId) {
@@ -686,6 +795,7 @@ void SurfaceInterceptor::saveDisplayDeletion(int32_t sequenceId) {
     ATRACE_CALL();
     std::lock_guard<std::mutex> protoGuard(mTraceMutex);
     addDisplayDeletionLocked(createTraceIncrementLocked(), sequenceId);
+    streamIncrementsLocked();
 }
 
 void SurfaceInterceptor::savePowerModeUpdate(int32_t sequenceId, int32_t mode) {
@@ -695,6 +805,7 @@ void SurfaceInterceptor::savePowerModeUpdate(int32_t sequenceId, int32_t mode) {
     ATRACE_CALL();
     std::lock_guard<std::mutex> protoGuard(mTraceMutex);
     addPowerModeUpdateLocked(createTraceIncrementLocked(), sequenceId, mode);
+    streamIncrementsLocked();
 }
 
 } // namespace impl
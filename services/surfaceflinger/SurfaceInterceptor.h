@@ -19,7 +19,11 @@
 
 #include <frameworks/native/cmds/surfacereplayer/proto/src/trace.pb.h>
 
+#include <atomic>
+#include <condition_variable>
+#include <memory>
 #include <mutex>
+#include <thread>
 
 #include <gui/LayerState.h>
 
@@ -29,6 +33,7 @@
 #include <utils/Vector.h>
 
 #include "DisplayDevice.h"
+#include "LockFreeQueue.h"
 
 namespace android {
 
@@ -86,7 +91,7 @@ namespace impl {
 class SurfaceInterceptor final : public android::SurfaceInterceptor {
 public:
     explicit SurfaceInterceptor(SurfaceFlinger* const flinger);
-    ~SurfaceInterceptor() override = default;
+    ~SurfaceInterceptor() override;
 
     // Both vectors are used to capture the current state of SF as the initial snapshot in the trace
     void enable(const SortedVector<sp<Layer>>& layers,
@@ -122,6 +127,13 @@ private:
     void addInitialDisplayStateLocked(Increment* increment, const DisplayDeviceState& display);
 
     status_t writeProtoFileLocked();
+
+    // In streaming mode, increments are moved out of mTrace as soon as they are added, and
+    // appended to the output file by mWriterThread, rather than all written on disable.
+    void streamIncrementsLocked();
+    void startWriterLocked();
+    void stopWriterLocked();
+    void writerLoop();
     const sp<const Layer> getLayer(const wp<const IBinder>& weakHandle) const;
     int32_t getLayerId(const sp<const Layer>& layer) const;
     int32_t getLayerIdFromWeakRef(const wp<const Layer>& layer) const;
@@ -188,6 +200,18 @@ private:
     std::mutex mTraceMutex {};
     Trace mTrace {};
     SurfaceFlinger* const mFlinger;
+
+    // Increments waiting for mWriterThread. Increments are dropped rather than queued once
+    // there are kMaxStreamedIncrements, so that a slow disk does not grow memory.
+    static constexpr size_t kMaxStreamedIncrements = 8192;
+    bool mStreaming {false};
+    LockFreeQueue<std::unique_ptr<Increment>> mStreamedIncrements;
+    std::atomic<size_t> mStreamedIncrementCount {0};
+    std::atomic<uint32_t> mDroppedIncrements {0};
+    std::thread mWriterThread;
+    std::mutex mWriterMutex;
+    std::condition_variable mWriterCondition;
+    bool mStopWriter {false};
 };
 
 } // namespace impl
@@ -29,6 +29,7 @@
 #include <log/log.h>
 #include <utils/SystemClock.h>
 #include <utils/Trace.h>
+#include <zlib.h>
 
 namespace android {
 
@@ -44,6 +45,9 @@ void SurfaceTracing::mainLoop() {
 }
 
 bool SurfaceTracing::addFirstEntry() {
+    mPreviousLayers.clear();
+    mEntriesUntilKeyframe = 0;
+
     LayersTraceProto entry;
     {
         std::scoped_lock lock(mSfLock);
@@ -64,8 +68,14 @@ LayersTraceProto SurfaceTracing::traceWhenNotified() {
 }
 
 bool SurfaceTracing::addTraceToBuffer(LayersTraceProto& entry) {
+    // Done without holding mSfLock, so that the main thread is not held up
+    encodeDelta(entry);
+
     std::scoped_lock lock(mTraceLock);
-    mBuffer.emplace(std::move(entry));
+    if (!mBuffer.emplace(entry)) {
+        // The next entry cannot be a delta to an entry which was not recorded
+        mEntriesUntilKeyframe = 0;
+    }
     if (mWriteToFile) {
         writeProtoFileLocked();
         mWriteToFile = false;
@@ -95,31 +105,89 @@ void SurfaceTracing::writeToFileAsync() {
 
 void SurfaceTracing::LayersTraceBuffer::reset(size_t newSize) {
     // use the swap trick to make sure memory is released
-    std::queue<LayersTraceProto>().swap(mStorage);
+    std::queue<Entry>().swap(mStorage);
     mSizeInBytes = newSize;
     mUsedInBytes = 0U;
+    mUncompressedUsedInBytes = 0U;
 }
 
-void SurfaceTracing::LayersTraceBuffer::emplace(LayersTraceProto&& proto) {
-    auto protoSize = proto.ByteSize();
-    while (mUsedInBytes + protoSize > mSizeInBytes) {
+bool SurfaceTracing::LayersTraceBuffer::emplace(const LayersTraceProto& proto) {
+    ATRACE_CALL();
+
+    Entry entry;
+    std::string serialized = proto.SerializeAsString();
+    entry.uncompressedSize = serialized.size();
+    entry.isKeyframe = !proto.is_delta();
+
+    // Consecutive entries mostly repeat the same strings and values, so they compress well
+    uLongf compressedSize = compressBound(serialized.size());
+    entry.data.resize(compressedSize);
+    entry.isCompressed =
+            compress2(reinterpret_cast<Bytef*>(entry.data.data()), &compressedSize,
+                      reinterpret_cast<const Bytef*>(serialized.data()), serialized.size(),
+                      Z_BEST_SPEED) == Z_OK &&
+            compressedSize < serialized.size();
+    if (entry.isCompressed) {
+        entry.data.resize(compressedSize);
+        entry.data.shrink_to_fit();
+    } else {
+        entry.data = std::move(serialized);
+    }
+
+    const size_t entrySize = entry.data.size();
+    while (mUsedInBytes + entrySize > mSizeInBytes) {
         if (mStorage.empty()) {
-            return;
+            return false;
         }
-        mUsedInBytes -= mStorage.front().ByteSize();
+        mUsedInBytes -= mStorage.front().data.size();
+        mUncompressedUsedInBytes -= mStorage.front().uncompressedSize;
         mStorage.pop();
     }
-    mUsedInBytes += protoSize;
-    mStorage.emplace();
-    mStorage.back().Swap(&proto);
+    mUsedInBytes += entrySize;
+    mUncompressedUsedInBytes += entry.uncompressedSize;
+    mStorage.push(std::move(entry));
+    return true;
 }
 
-void SurfaceTracing::LayersTraceBuffer::flush(LayersTraceFileProto* fileProto) {
-    fileProto->mutable_entry()->Reserve(mStorage.size());
+void SurfaceTracing::LayersTraceBuffer::flush(std::string* output) {
+    ATRACE_CALL();
 
+    output->reserve(output->size() + mUncompressedUsedInBytes + mStorage.size() * 6);
+    std::string uncompressed;
+    bool hasKeyframe = false;
     while (!mStorage.empty()) {
-        auto entry = fileProto->add_entry();
-        entry->Swap(&mStorage.front());
+        Entry& entry = mStorage.front();
+        // Deltas to entries which were dropped from the buffer cannot be read
+        hasKeyframe |= entry.isKeyframe;
+        if (!hasKeyframe) {
+            mStorage.pop();
+            continue;
+        }
+
+        const std::string* data = &entry.data;
+        if (entry.isCompressed) {
+            uncompressed.resize(entry.uncompressedSize);
+            uLongf size = entry.uncompressedSize;
+            if (uncompress(reinterpret_cast<Bytef*>(uncompressed.data()), &size,
+                           reinterpret_cast<const Bytef*>(entry.data.data()),
+                           entry.data.size()) != Z_OK ||
+                size != entry.uncompressedSize) {
+                ALOGE("Could not decompress a trace entry");
+                mStorage.pop();
+                continue;
+            }
+            data = &uncompressed;
+        }
+
+        // Each entry is a length delimited LayersTraceFileProto.entry field
+        output->push_back(static_cast<char>(LayersTraceFileProto::kEntryFieldNumber << 3 | 2));
+        size_t length = data->size();
+        while (length >= 0x80) {
+            output->push_back(static_cast<char>(length | 0x80));
+            length >>= 7;
+        }
+        output->push_back(static_cast<char>(length));
+        output->append(*data);
         mStorage.pop();
     }
 }
@@ -198,10 +266,48 @@ LayersTraceProto SurfaceTracing::traceLayersLocked(const char* where) {
         entry.set_excludes_composition_state(true);
     }
     entry.set_missed_entries(mMissedTraceEntries);
+    mEncodeDelta = flagIsSetLocked(SurfaceTracing::TRACE_DELTA);
 
     return entry;
 }
 
+void SurfaceTracing::encodeDelta(LayersTraceProto& entry) {
+    if (!mEncodeDelta) {
+        mPreviousLayers.clear();
+        mEntriesUntilKeyframe = 0;
+        return;
+    }
+    ATRACE_CALL();
+
+    std::unordered_map<int32_t, std::string> layers;
+    layers.reserve(entry.layers().layers_size());
+    for (const LayerProto& layer : entry.layers().layers()) {
+        layers.emplace(layer.id(), layer.SerializeAsString());
+    }
+
+    if (mEntriesUntilKeyframe == 0) {
+        mEntriesUntilKeyframe = kDeltaKeyframeInterval;
+    } else {
+        mEntriesUntilKeyframe--;
+
+        LayersProto changedLayers;
+        for (LayerProto& layer : *entry.mutable_layers()->mutable_layers()) {
+            const auto previous = mPreviousLayers.find(layer.id());
+            if (previous == mPreviousLayers.end() || previous->second != layers[layer.id()]) {
+                changedLayers.add_layers()->Swap(&layer);
+            }
+        }
+        for (const auto& [id, unused] : mPreviousLayers) {
+            if (layers.count(id) == 0) {
+                entry.add_removed_layers(id);
+            }
+        }
+        entry.mutable_layers()->Swap(&changedLayers);
+        entry.set_is_delta(true);
+    }
+    mPreviousLayers = std::move(layers);
+}
+
 void SurfaceTracing::writeProtoFileLocked() {
     ATRACE_CALL();
 
@@ -210,14 +316,15 @@ void SurfaceTracing::writeProtoFileLocked() {
 
     fileProto.set_magic_number(uint64_t(LayersTraceFileProto_MagicNumber_MAGIC_NUMBER_H) << 32 |
                                LayersTraceFileProto_MagicNumber_MAGIC_NUMBER_L);
-    mBuffer.flush(&fileProto);
-    mBuffer.reset(mBufferSize);
-
     if (!fileProto.SerializeToString(&output)) {
         ALOGE("Could not save the proto file! Permission denied");
         mLastErr = PERMISSION_DENIED;
     }
 
+    // The entries are stored serialized, so append them rather than parsing them back
+    mBuffer.flush(&output);
+    mBuffer.reset(mBufferSize);
+
     // -rw-r--r--
     const mode_t mode = S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH;
     if (!android::base::WriteStringToFile(output, kDefaultFileName, mode, getuid(), getgid(),
@@ -232,9 +339,11 @@ void SurfaceTracing::writeProtoFileLocked() {
 void SurfaceTracing::dump(std::string& result) const {
     std::scoped_lock lock(mTraceLock);
     base::StringAppendF(&result, "Tracing state: %s\n", mEnabled ? "enabled" : "disabled");
-    base::StringAppendF(&result, "  number of entries: %zu (%.2fMB / %.2fMB)\n",
+    base::StringAppendF(&result,
+                        "  number of entries: %zu (%.2fMB / %.2fMB, %.2fMB uncompressed)\n",
                         mBuffer.frameCount(), float(mBuffer.used()) / float(1_MB),
-                        float(mBuffer.size()) / float(1_MB));
+                        float(mBuffer.size()) / float(1_MB),
+                        float(mBuffer.uncompressedUsed()) / float(1_MB));
 }
 
 } // namespace android
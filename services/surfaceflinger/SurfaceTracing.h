@@ -25,7 +25,9 @@
 #include <memory>
 #include <mutex>
 #include <queue>
+#include <string>
 #include <thread>
+#include <unordered_map>
 
 using namespace android::surfaceflinger;
 
@@ -59,6 +61,8 @@ public:
         TRACE_COMPOSITION = 1 << 2,
         TRACE_EXTRA = 1 << 3,
         TRACE_HWC = 1 << 4,
+        // Only record the layers which changed since the previous entry, see kDeltaKeyframeInterval
+        TRACE_DELTA = 1 << 5,
         TRACE_ALL = 0xffffffff
     };
     void setTraceFlags(uint32_t flags);
@@ -69,28 +73,46 @@ public:
 private:
     static constexpr auto kDefaultBufferCapInByte = 5_MB;
     static constexpr auto kDefaultFileName = "/data/misc/wmtrace/layers_trace.pb";
+    // With TRACE_DELTA, every entry holding all layers is followed by as many entries which
+    // only hold the layers which changed, so that traces can be read from any keyframe on.
+    static constexpr uint32_t kDeltaKeyframeInterval = 64;
 
-    class LayersTraceBuffer { // ring buffer
+    class LayersTraceBuffer { // ring buffer of compressed entries
     public:
         size_t size() const { return mSizeInBytes; }
         size_t used() const { return mUsedInBytes; }
+        size_t uncompressedUsed() const { return mUncompressedUsedInBytes; }
         size_t frameCount() const { return mStorage.size(); }
 
         void setSize(size_t newSize) { mSizeInBytes = newSize; }
         void reset(size_t newSize);
-        void emplace(LayersTraceProto&& proto);
-        void flush(LayersTraceFileProto* fileProto);
+        // Returns false if the entry does not fit in the buffer, and was dropped.
+        bool emplace(const LayersTraceProto& proto);
+        // Appends the entries, starting with the oldest keyframe, to output as the entry field
+        // of a serialized LayersTraceFileProto.
+        void flush(std::string* output);
 
     private:
+        struct Entry {
+            std::string data;
+            size_t uncompressedSize;
+            bool isCompressed;
+            bool isKeyframe;
+        };
+
         size_t mUsedInBytes = 0U;
+        size_t mUncompressedUsedInBytes = 0U;
         size_t mSizeInBytes = 0U;
-        std::queue<LayersTraceProto> mStorage;
+        std::queue<Entry> mStorage;
     };
 
     void mainLoop();
     bool addFirstEntry();
     LayersTraceProto traceWhenNotified();
     LayersTraceProto traceLayersLocked(const char* where) REQUIRES(mSfLock);
+    // Replaces the layers of entry by those which changed since the previous entry, unless
+    // entry is due to be a keyframe.
+    void encodeDelta(LayersTraceProto& entry);
 
     // Returns true if trace is enabled.
     bool addTraceToBuffer(LayersTraceProto& entry);
@@ -107,6 +129,12 @@ private:
     uint32_t mMissedTraceEntries GUARDED_BY(mSfLock) = 0;
     bool mTracingInProgress GUARDED_BY(mSfLock) = false;
 
+    // Only accessed by mThread. The serialized layers of the previous entry by id, to compare
+    // the next entry with, and how many more entries are encoded as deltas before a keyframe.
+    bool mEncodeDelta = false;
+    std::unordered_map<int32_t, std::string> mPreviousLayers;
+    uint32_t mEntriesUntilKeyframe = 0;
+
     mutable std::mutex mTraceLock;
     LayersTraceBuffer mBuffer GUARDED_BY(mTraceLock);
     size_t mBufferSize GUARDED_BY(mTraceLock) = kDefaultBufferCapInByte;
@@ -160,6 +160,7 @@ AStatsManager_PullAtomCallbackReturn TimeStats::populateLayerAtom(AStatsEventLis
 
         mStatsDelegate->statsEventWriteInt64(event, layer->lateAcquireFrames);
         mStatsDelegate->statsEventWriteInt64(event, layer->badDesiredPresentFrames);
+        mStatsDelegate->statsEventWriteInt32(event, static_cast<int32_t>(layer->uid));
 
         mStatsDelegate->statsEventBuild(event);
     }
@@ -299,6 +300,15 @@ void TimeStats::incrementCompositionStrategyChanges() {
     mTimeStats.compositionStrategyChanges++;
 }
 
+void TimeStats::incrementCompositionStrategyPredictedFrames() {
+    if (!mEnabled.load()) return;
+
+    ATRACE_CALL();
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mTimeStats.compositionStrategyPredictedFrames++;
+}
+
 void TimeStats::recordDisplayEventConnectionCount(int32_t count) {
     if (!mEnabled.load()) return;
 
@@ -397,11 +407,12 @@ void TimeStats::flushAvailableRecordsToStatsLocked(int32_t layerId) {
               timeRecords[0].frameTime.frameNumber, timeRecords[0].frameTime.presentTime);
 
         if (prevTimeRecord.ready) {
-            const std::string& layerName = layerRecord.layerName;
-            if (!mTimeStats.stats.count(layerName)) {
-                mTimeStats.stats[layerName].layerName = layerName;
+            const TimeStatsHelper::LayerStatsKey key = {layerRecord.uid, layerRecord.layerName};
+            if (!mTimeStats.stats.count(key)) {
+                mTimeStats.stats[key].uid = layerRecord.uid;
+                mTimeStats.stats[key].layerName = layerRecord.layerName;
             }
-            TimeStatsHelper::TimeStatsLayer& timeStatsLayer = mTimeStats.stats[layerName];
+            TimeStatsHelper::TimeStatsLayer& timeStatsLayer = mTimeStats.stats[key];
             timeStatsLayer.totalFrames++;
             timeStatsLayer.droppedFrames += layerRecord.droppedFrames;
             timeStatsLayer.lateAcquireFrames += layerRecord.lateAcquireFrames;
@@ -417,6 +428,12 @@ void TimeStats::flushAvailableRecordsToStatsLocked(int32_t layerId) {
                   timeRecords[0].frameTime.frameNumber, postToAcquireMs);
             timeStatsLayer.deltas["post2acquire"].insert(postToAcquireMs);
 
+            const int32_t postToLatchMs = msBetween(timeRecords[0].frameTime.postTime,
+                                                    timeRecords[0].frameTime.latchTime);
+            ALOGV("[%d]-[%" PRIu64 "]-post2latch[%d]", layerId,
+                  timeRecords[0].frameTime.frameNumber, postToLatchMs);
+            timeStatsLayer.deltas["post2latch"].insert(postToLatchMs);
+
             const int32_t postToPresentMs = msBetween(timeRecords[0].frameTime.postTime,
                                                       timeRecords[0].frameTime.presentTime);
             ALOGV("[%d]-[%" PRIu64 "]-post2present[%d]", layerId,
@@ -463,19 +480,21 @@ static bool layerNameIsValid(const std::string& layerName) {
 }
 
 void TimeStats::setPostTime(int32_t layerId, uint64_t frameNumber, const std::string& layerName,
-                            nsecs_t postTime) {
+                            uid_t uid, nsecs_t postTime) {
     if (!mEnabled.load()) return;
 
     ATRACE_CALL();
-    ALOGV("[%d]-[%" PRIu64 "]-[%s]-PostTime[%" PRId64 "]", layerId, frameNumber, layerName.c_str(),
-          postTime);
+    ALOGV("[%d]-[%" PRIu64 "]-[%s]-[%d]-PostTime[%" PRId64 "]", layerId, frameNumber,
+          layerName.c_str(), uid, postTime);
 
     std::lock_guard<std::mutex> lock(mMutex);
-    if (!mTimeStats.stats.count(layerName) && mTimeStats.stats.size() >= MAX_NUM_LAYER_STATS) {
+    if (!mTimeStats.stats.count({uid, layerName}) &&
+        mTimeStats.stats.size() >= MAX_NUM_LAYER_STATS) {
         return;
     }
     if (!mTimeStatsTracker.count(layerId) && mTimeStatsTracker.size() < MAX_NUM_LAYER_RECORDS &&
         layerNameIsValid(layerName)) {
+        mTimeStatsTracker[layerId].uid = uid;
         mTimeStatsTracker[layerId].layerName = layerName;
     }
     if (!mTimeStatsTracker.count(layerId)) return;
@@ -855,6 +874,7 @@ void TimeStats::clearGlobalLocked() {
     mTimeStats.clientCompositionReusedFrames = 0;
     mTimeStats.refreshRateSwitches = 0;
     mTimeStats.compositionStrategyChanges = 0;
+    mTimeStats.compositionStrategyPredictedFrames = 0;
     mTimeStats.displayEventConnectionsCount = 0;
     mTimeStats.displayOnTime = 0;
     mTimeStats.presentToPresent.hist.clear();
@@ -66,6 +66,9 @@ public:
     // The intention is to reflect the number of changes between hwc and gpu
     // composition, where "gpu composition" may also include mixed composition.
     virtual void incrementCompositionStrategyChanges() = 0;
+    // Increments the number of frames whose composition strategy was correctly predicted from
+    // the previous frame.
+    virtual void incrementCompositionStrategyPredictedFrames() = 0;
     // Records the most up-to-date count of display event connections.
     // The stored count will be the maximum ever recoded.
     virtual void recordDisplayEventConnectionCount(int32_t count) = 0;
@@ -84,8 +87,9 @@ public:
     virtual void recordRenderEngineDuration(nsecs_t startTime,
                                             const std::shared_ptr<FenceTime>& readyFence) = 0;
 
+    // Layers are attributed to the app owning them by 'uid'.
     virtual void setPostTime(int32_t layerId, uint64_t frameNumber, const std::string& layerName,
-                             nsecs_t postTime) = 0;
+                             uid_t uid, nsecs_t postTime) = 0;
     virtual void setLatchTime(int32_t layerId, uint64_t frameNumber, nsecs_t latchTime) = 0;
     // Reasons why latching a particular buffer may be skipped
     enum class LatchSkipReason {
@@ -142,6 +146,7 @@ class TimeStats : public android::TimeStats {
     };
 
     struct LayerRecord {
+        uid_t uid = 0;
         std::string layerName;
         // This is the index in timeRecords, at which the timestamps for that
         // specific frame are still not fully received. This is not waiting for
@@ -234,6 +239,7 @@ public:
     void incrementClientCompositionReusedFrames() override;
     void incrementRefreshRateSwitches() override;
     void incrementCompositionStrategyChanges() override;
+    void incrementCompositionStrategyPredictedFrames() override;
     void recordDisplayEventConnectionCount(int32_t count) override;
 
     void recordFrameDuration(nsecs_t startTime, nsecs_t endTime) override;
@@ -242,7 +248,7 @@ public:
                                     const std::shared_ptr<FenceTime>& readyFence) override;
 
     void setPostTime(int32_t layerId, uint64_t frameNumber, const std::string& layerName,
-                     nsecs_t postTime) override;
+                     uid_t uid, nsecs_t postTime) override;
     void setLatchTime(int32_t layerId, uint64_t frameNumber, nsecs_t latchTime) override;
     void incrementLatchSkipped(int32_t layerId, LatchSkipReason reason) override;
     void incrementBadDesiredPresent(int32_t layerId) override;
@@ -18,9 +18,12 @@
 #include <timestatsproto/TimeStatsProtoHeader.h>
 #include <utils/Timers.h>
 
+#include <sys/types.h>
+
 #include <optional>
 #include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace android {
@@ -42,6 +45,7 @@ public:
 
     class TimeStatsLayer {
     public:
+        uid_t uid = 0;
         std::string layerName;
         std::string packageName;
         int32_t totalFrames = 0;
@@ -54,6 +58,15 @@ public:
         SFTimeStatsLayerProto toProto() const;
     };
 
+    // Layer stats are kept per owning uid and layer name, so that layers of different apps which
+    // happen to share a name are attributed to the right app.
+    using LayerStatsKey = std::pair<uid_t, std::string>;
+    struct LayerStatsKeyHash {
+        size_t operator()(const LayerStatsKey& key) const {
+            return std::hash<std::string>{}(key.second) ^ std::hash<uid_t>{}(key.first);
+        }
+    };
+
     class TimeStatsGlobal {
     public:
         int64_t statsStart = 0;
@@ -64,12 +77,13 @@ public:
         int32_t clientCompositionReusedFrames = 0;
         int32_t refreshRateSwitches = 0;
         int32_t compositionStrategyChanges = 0;
+        int32_t compositionStrategyPredictedFrames = 0;
         int32_t displayEventConnectionsCount = 0;
         int64_t displayOnTime = 0;
         Histogram presentToPresent;
         Histogram frameDuration;
         Histogram renderEngineTiming;
-        std::unordered_map<std::string, TimeStatsLayer> stats;
+        std::unordered_map<LayerStatsKey, TimeStatsLayer, LayerStatsKeyHash> stats;
         std::unordered_map<uint32_t, nsecs_t> refreshRateStats;
 
         std::string toString(std::optional<uint32_t> maxLayers) const;
@@ -22,3 +22,4 @@
 #pragma GCC system_header
 #include <layers.pb.h>
 #include <layerstrace.pb.h>
+#include <memory.pb.h>
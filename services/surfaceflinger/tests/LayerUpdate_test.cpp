@@ -1503,6 +1503,39 @@ TEST_F(ScreenCaptureTest, CaptureBufferLayerWithoutBufferFails) {
     sc.expectColor(Rect(0, 0, 9, 9), Color::RED);
 }
 
+TEST_F(ScreenCaptureTest, CaptureLayersAsyncReusesBuffer) {
+    sp<SurfaceControl> child = createColorLayer("Child layer", Color::RED, mFGSurfaceControl.get());
+    SurfaceComposerClient::Transaction().show(child).apply(true);
+
+    sp<ISurfaceComposer> sf(ComposerService::getComposerService());
+    sp<GraphicBuffer> outBuffer;
+    sp<Fence> fence;
+    Rect sourceCrop(0, 0, 10, 10);
+    ASSERT_EQ(NO_ERROR,
+              sf->captureLayersAsync(child->getHandle(), nullptr, ui::Dataspace::V0_SRGB,
+                                     ui::PixelFormat::RGBA_8888, sourceCrop, {}, 1.0f, false,
+                                     &outBuffer, &fence));
+    ASSERT_EQ(NO_ERROR, fence->waitForever("CaptureLayersAsyncReusesBuffer"));
+    ScreenCapture(outBuffer).expectColor(Rect(0, 0, 9, 9), Color::RED);
+
+    SurfaceComposerClient::Transaction().setColor(child, half3{0, 0, 1}).apply(true);
+
+    const sp<GraphicBuffer> buffer = outBuffer;
+    ASSERT_EQ(NO_ERROR,
+              sf->captureLayersAsync(child->getHandle(), buffer, ui::Dataspace::V0_SRGB,
+                                     ui::PixelFormat::RGBA_8888, sourceCrop, {}, 1.0f, false,
+                                     &outBuffer, &fence));
+    ASSERT_EQ(buffer->getId(), outBuffer->getId());
+    ASSERT_EQ(NO_ERROR, fence->waitForever("CaptureLayersAsyncReusesBuffer"));
+    ScreenCapture(outBuffer).expectColor(Rect(0, 0, 9, 9), Color::BLUE);
+
+    // A buffer that does not match the capture is rejected.
+    ASSERT_EQ(BAD_VALUE,
+              sf->captureLayersAsync(child->getHandle(), buffer, ui::Dataspace::V0_SRGB,
+                                     ui::PixelFormat::RGBA_8888, Rect(0, 0, 20, 20), {}, 1.0f,
+                                     false, &outBuffer, &fence));
+}
+
 // In the following tests we verify successful skipping of a parent layer,
 // so we use the same verification logic and only change how we mutate
 // the parent layer to verify that various properties are ignored.
@@ -866,6 +866,7 @@ struct BaseLayerVariant {
         Mock::VerifyAndClear(test->mComposer);
 
         test->mFlinger.mutableDrawingState().layersSortedByZ.add(layer);
+        test->mFlinger.rebuildDrawingLayersInZOrder();
     }
 
     static void cleanupInjectedLayers(CompositionTest* test) {
@@ -874,6 +875,7 @@ struct BaseLayerVariant {
 
         test->mDisplay->getCompositionDisplay()->clearOutputLayers();
         test->mFlinger.mutableDrawingState().layersSortedByZ.clear();
+        test->mFlinger.rebuildDrawingLayersInZOrder();
 
         // Layer should be unregistered with scheduler.
         test->mFlinger.onMessageReceived(MessageQueue::INVALIDATE);
@@ -0,0 +1,68 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "CopyOnWrite.h"
+
+namespace android {
+namespace {
+
+TEST(CopyOnWriteTest, copiesShareStorage) {
+    CopyOnWrite<std::string> value(std::string("layer"));
+    CopyOnWrite<std::string> copy = value;
+
+    EXPECT_TRUE(copy.sharesStorageWith(value));
+    EXPECT_EQ(&value.get(), &copy.get());
+    EXPECT_EQ("layer", *copy);
+}
+
+TEST(CopyOnWriteTest, editDetachesSharedValue) {
+    CopyOnWrite<std::string> value(std::string("layer"));
+    CopyOnWrite<std::string> copy = value;
+
+    copy.edit().append("#1");
+
+    EXPECT_FALSE(copy.sharesStorageWith(value));
+    EXPECT_EQ("layer", *value);
+    EXPECT_EQ("layer#1", *copy);
+}
+
+TEST(CopyOnWriteTest, editModifiesUnsharedValueInPlace) {
+    CopyOnWrite<std::string> value(std::string("layer"));
+    const std::string* storage = &value.get();
+
+    value.edit().append("#1");
+
+    EXPECT_EQ(storage, &value.get());
+    EXPECT_EQ("layer#1", *value);
+}
+
+TEST(CopyOnWriteTest, assignReplacesOnlyThisCopy) {
+    CopyOnWrite<std::string> value(std::string("layer"));
+    CopyOnWrite<std::string> copy = value;
+
+    copy = std::string("other");
+
+    EXPECT_EQ("layer", *value);
+    EXPECT_EQ("other", *copy);
+    EXPECT_EQ(5u, copy->size());
+}
+
+} // namespace
+} // namespace android
@@ -0,0 +1,181 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "LibSurfaceFlingerUnittests"
+
+#include <algorithm>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <gui/LayerMetadata.h>
+
+// TODO(b/129481165): remove the #pragma below and fix conversion issues
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wconversion"
+#include "EffectLayer.h"
+#include "Layer.h"
+// TODO(b/129481165): remove the #pragma below and fix conversion issues
+#pragma clang diagnostic pop // ignored "-Wconversion"
+#include "TestableSurfaceFlinger.h"
+#include "mock/DisplayHardware/MockComposer.h"
+#include "mock/MockDispSync.h"
+#include "mock/MockEventControlThread.h"
+#include "mock/MockEventThread.h"
+#include "mock/MockMessageQueue.h"
+
+namespace android {
+namespace {
+
+using testing::_;
+using testing::ElementsAreArray;
+using testing::Mock;
+using testing::Return;
+
+using FakeHwcDisplayInjector = TestableSurfaceFlinger::FakeHwcDisplayInjector;
+
+/**
+ * This class tests that SurfaceFlinger's flattened drawing layer list follows the layer tree
+ */
+class DrawingLayersInZOrderTest : public testing::Test {
+protected:
+    DrawingLayersInZOrderTest() {
+        setupScheduler();
+
+        auto composer = new Hwc2::mock::Composer();
+        EXPECT_CALL(*composer, getMaxVirtualDisplayCount()).WillOnce(Return(0));
+        mFlinger.setupComposer(std::unique_ptr<Hwc2::Composer>(composer));
+        Mock::VerifyAndClear(composer);
+
+        mFlinger.mutableEventQueue().reset(mMessageQueue);
+        EXPECT_CALL(*mMessageQueue, invalidate()).Times(testing::AnyNumber());
+    }
+
+    void setupScheduler() {
+        auto eventThread = std::make_unique<mock::EventThread>();
+        auto sfEventThread = std::make_unique<mock::EventThread>();
+
+        EXPECT_CALL(*eventThread, registerDisplayEventConnection(_));
+        EXPECT_CALL(*eventThread, createEventConnection(_, _))
+                .WillOnce(Return(
+                        new EventThreadConnection(eventThread.get(), ResyncCallback(),
+                                                  ISurfaceComposer::eConfigChangedSuppress)));
+
+        EXPECT_CALL(*sfEventThread, registerDisplayEventConnection(_));
+        EXPECT_CALL(*sfEventThread, createEventConnection(_, _))
+                .WillOnce(Return(
+                        new EventThreadConnection(sfEventThread.get(), ResyncCallback(),
+                                                  ISurfaceComposer::eConfigChangedSuppress)));
+
+        auto primaryDispSync = std::make_unique<mock::DispSync>();
+        EXPECT_CALL(*primaryDispSync, computeNextRefresh(0, _)).WillRepeatedly(Return(0));
+        EXPECT_CALL(*primaryDispSync, getPeriod())
+                .WillRepeatedly(Return(FakeHwcDisplayInjector::DEFAULT_REFRESH_RATE));
+        EXPECT_CALL(*primaryDispSync, expectedPresentTime(_)).WillRepeatedly(Return(0));
+        mFlinger.setupScheduler(std::move(primaryDispSync),
+                                std::make_unique<mock::EventControlThread>(),
+                                std::move(eventThread), std::move(sfEventThread));
+    }
+
+    sp<Layer> createLayer(int32_t z) {
+        sp<Client> client;
+        LayerCreationArgs args(mFlinger.flinger(), client, "color-layer", 100, 100, 0,
+                               LayerMetadata());
+        sp<Layer> layer = new EffectLayer(args);
+        layer->setLayer(z);
+        mLayers.push_back(layer);
+        return layer;
+    }
+
+    void commitTransaction() {
+        for (const auto& layer : mLayers) {
+            layer->commitTransaction(layer->getCurrentState());
+        }
+        mFlinger.commitTransactionLocked();
+    }
+
+    std::vector<Layer*> traverseInZOrder() {
+        std::vector<Layer*> layers;
+        mFlinger.mutableDrawingState().traverseInZOrder(
+                [&](Layer* layer) { layers.push_back(layer); });
+        return layers;
+    }
+
+    std::vector<Layer*> traverseInReverseZOrder() {
+        std::vector<Layer*> layers;
+        mFlinger.mutableDrawingState().traverseInReverseZOrder(
+                [&](Layer* layer) { layers.push_back(layer); });
+        return layers;
+    }
+
+    TestableSurfaceFlinger mFlinger;
+    mock::MessageQueue* mMessageQueue = new mock::MessageQueue();
+
+    std::vector<sp<Layer>> mLayers;
+};
+
+TEST_F(DrawingLayersInZOrderTest, followsLayerTree) {
+    const sp<Layer> rootA = createLayer(1);
+    const sp<Layer> rootB = createLayer(2);
+    const sp<Layer> childA1 = createLayer(-1);
+    const sp<Layer> childA2 = createLayer(1);
+    const sp<Layer> childB1 = createLayer(0);
+    rootA->addChild(childA1);
+    rootA->addChild(childA2);
+    rootB->addChild(childB1);
+    mFlinger.mutableCurrentState().layersSortedByZ.add(rootA);
+    mFlinger.mutableCurrentState().layersSortedByZ.add(rootB);
+    commitTransaction();
+
+    EXPECT_THAT(mFlinger.drawingLayersInZOrder(),
+                ElementsAreArray(std::vector<Layer*>{childA1.get(), rootA.get(), childA2.get(),
+                                                     rootB.get(), childB1.get()}));
+    EXPECT_THAT(mFlinger.drawingLayersInZOrder(), ElementsAreArray(traverseInZOrder()));
+
+    std::vector<Layer*> reversed = traverseInReverseZOrder();
+    std::reverse(reversed.begin(), reversed.end());
+    EXPECT_THAT(mFlinger.drawingLayersInZOrder(), ElementsAreArray(reversed));
+}
+
+TEST_F(DrawingLayersInZOrderTest, rebuiltWhenCommitted) {
+    const sp<Layer> rootA = createLayer(1);
+    const sp<Layer> rootB = createLayer(2);
+    const sp<Layer> childA1 = createLayer(1);
+    const sp<Layer> childA2 = createLayer(2);
+    rootA->addChild(childA1);
+    rootA->addChild(childA2);
+    mFlinger.mutableCurrentState().layersSortedByZ.add(rootA);
+    mFlinger.mutableCurrentState().layersSortedByZ.add(rootB);
+    commitTransaction();
+
+    // Move childA2 below rootA, and childA1 to be drawn right below rootB
+    const sp<IBinder> handleB = rootB->getHandle();
+    rootA->setChildRelativeLayer(childA1, handleB, -1);
+    rootA->setChildLayer(childA2, -1);
+    commitTransaction();
+
+    EXPECT_THAT(mFlinger.drawingLayersInZOrder(),
+                ElementsAreArray(std::vector<Layer*>{childA2.get(), rootA.get(), childA1.get(),
+                                                     rootB.get()}));
+    EXPECT_THAT(mFlinger.drawingLayersInZOrder(), ElementsAreArray(traverseInZOrder()));
+
+    std::vector<Layer*> reversed = traverseInReverseZOrder();
+    std::reverse(reversed.begin(), reversed.end());
+    EXPECT_THAT(mFlinger.drawingLayersInZOrder(), ElementsAreArray(reversed));
+}
+
+} // namespace
+} // namespace android
@@ -20,6 +20,7 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include <log/log.h>
+#include <poll.h>
 #include <utils/Errors.h>
 
 #include "AsyncCallRecorder.h"
@@ -31,6 +32,7 @@ using namespace std::placeholders;
 
 using testing::_;
 using testing::Invoke;
+using testing::Return;
 
 namespace android {
 
@@ -39,6 +41,7 @@ namespace {
 constexpr PhysicalDisplayId INTERNAL_DISPLAY_ID = 111;
 constexpr PhysicalDisplayId EXTERNAL_DISPLAY_ID = 222;
 constexpr PhysicalDisplayId DISPLAY_ID_64BIT = 0xabcd12349876fedcULL;
+constexpr nsecs_t VSYNC_PERIOD = 1000;
 
 class MockVSyncSource : public VSyncSource {
 public:
@@ -47,6 +50,7 @@ public:
     MOCK_METHOD1(setVSyncEnabled, void(bool));
     MOCK_METHOD1(setCallback, void(VSyncSource::Callback*));
     MOCK_METHOD1(setPhaseOffset, void(nsecs_t));
+    MOCK_CONST_METHOD0(getPeriod, nsecs_t());
     MOCK_METHOD1(pauseVsyncCallback, void(bool));
     MOCK_CONST_METHOD1(dump, void(std::string&));
 };
@@ -117,6 +121,8 @@ EventThreadTest::EventThreadTest() {
     EXPECT_CALL(*mVSyncSource, setPhaseOffset(_))
             .WillRepeatedly(Invoke(mVSyncSetPhaseOffsetCallRecorder.getInvocable()));
 
+    EXPECT_CALL(*mVSyncSource, getPeriod()).WillRepeatedly(Return(VSYNC_PERIOD));
+
     createThread(std::move(vsyncSource));
     mConnection = createConnection(mConnectionEventCallRecorder,
                                    ISurfaceComposer::eConfigChangedDispatch);
@@ -329,6 +335,66 @@ TEST_F(EventThreadTest, setVsyncRateOnePostsAllEventsToThatConnection) {
     expectVsyncEventReceivedByConnection(789, 3u);
 }
 
+TEST_F(EventThreadTest, vsyncTimelineReplacesVSyncEventsOfConnectionsUsingIt) {
+    gui::VsyncTimeline timeline;
+    ASSERT_EQ(NO_ERROR, mThread->enableVsyncTimeline(mConnection, false, &timeline));
+    ASSERT_TRUE(timeline.isValid());
+    EXPECT_LT(timeline.getWakeFd(), 0);
+    gui::VsyncTimeline::Vsync vsync;
+    EXPECT_EQ(0u, timeline.read(&vsync));
+
+    mThread->setVsyncRate(1, mConnection);
+    expectVSyncSetEnabledCallReceived(true);
+
+    // The vsync is published to the timeline instead of being posted to the connection
+    mCallback->onVSyncEvent(123, 456);
+    expectInterceptCallReceived(123);
+    ASSERT_TRUE(timeline.wait(0, ms2ns(100)));
+    EXPECT_EQ(1u, timeline.read(&vsync));
+    EXPECT_EQ(INTERNAL_DISPLAY_ID, vsync.displayId);
+    EXPECT_EQ(123, vsync.timestamp);
+    EXPECT_EQ(1u, vsync.count);
+    EXPECT_EQ(456, vsync.expectedVSyncTimestamp);
+    EXPECT_FALSE(mConnectionEventCallRecorder.waitForUnexpectedCall().has_value());
+
+    // Other events are still posted to the connection
+    mThread->onHotplugReceived(EXTERNAL_DISPLAY_ID, true);
+    expectHotplugEventReceivedByConnection(EXTERNAL_DISPLAY_ID, true);
+}
+
+TEST_F(EventThreadTest, vsyncTimelineWakeFdIsSignaledOnceForPendingVSyncs) {
+    gui::VsyncTimeline timeline;
+    ASSERT_EQ(NO_ERROR, mThread->enableVsyncTimeline(mConnection, true, &timeline));
+    ASSERT_GE(timeline.getWakeFd(), 0);
+    EXPECT_FALSE(timeline.consumeWake());
+
+    mThread->setVsyncRate(1, mConnection);
+    expectVSyncSetEnabledCallReceived(true);
+
+    pollfd wakeFd = {.fd = timeline.getWakeFd(), .events = POLLIN};
+    mCallback->onVSyncEvent(123, 456);
+    expectInterceptCallReceived(123);
+    ASSERT_EQ(1, poll(&wakeFd, 1, 100));
+    EXPECT_TRUE(timeline.consumeWake());
+    EXPECT_FALSE(timeline.consumeWake());
+
+    // Vsyncs published before the receiver wakes up only wake it up once, for the latest one
+    mCallback->onVSyncEvent(456, 123);
+    expectInterceptCallReceived(456);
+    mCallback->onVSyncEvent(789, 777);
+    expectInterceptCallReceived(789);
+    ASSERT_TRUE(timeline.wait(2, ms2ns(100)));
+    // Locks the EventThread, so that the wake fd was signaled for the latest vsync
+    EXPECT_EQ(1u, mThread->getEventThreadConnectionCount());
+    EXPECT_TRUE(timeline.consumeWake());
+    EXPECT_FALSE(timeline.consumeWake());
+    gui::VsyncTimeline::Vsync vsync;
+    EXPECT_EQ(3u, timeline.read(&vsync));
+    EXPECT_EQ(789, vsync.timestamp);
+    EXPECT_EQ(3u, vsync.count);
+    EXPECT_FALSE(mConnectionEventCallRecorder.waitForUnexpectedCall().has_value());
+}
+
 TEST_F(EventThreadTest, setVsyncRateTwoPostsEveryOtherEventToThatConnection) {
     mThread->setVsyncRate(2, mConnection);
 
@@ -459,6 +525,39 @@ TEST_F(EventThreadTest, setPhaseOffsetForwardsToVSyncSource) {
     expectVSyncSetPhaseOffsetCallReceived(321);
 }
 
+TEST_F(EventThreadTest, vsyncEventsCarryTheDeadlineOfTheLatchOffset) {
+    const auto expectDeadline = [&](nsecs_t deadlineTimestamp, nsecs_t expectedPresentTime) {
+        auto args = mConnectionEventCallRecorder.waitForCall();
+        ASSERT_TRUE(args.has_value());
+        const auto& event = std::get<0>(args.value());
+        EXPECT_EQ(DisplayEventReceiver::DISPLAY_EVENT_VSYNC, event.header.type);
+        EXPECT_EQ(deadlineTimestamp, event.vsync.deadlineTimestamp);
+        EXPECT_EQ(expectedPresentTime, event.vsync.expectedPresentTime);
+    };
+
+    mThread->setVsyncRate(1, mConnection);
+    expectVSyncSetEnabledCallReceived(true);
+
+    // Without a latch offset, the deadline is the expected vsync
+    mCallback->onVSyncEvent(1100, 2000);
+    expectDeadline(2000, 2000);
+
+    // SurfaceFlinger wakes up before the expected vsync, in time to present the frame at it
+    mThread->setLatchOffset(300);
+    mCallback->onVSyncEvent(1100, 2000);
+    expectDeadline(1300, 2000);
+
+    // SurfaceFlinger wakes up with the app, so the frame is latched a period later
+    mThread->setLatchOffset(100);
+    mCallback->onVSyncEvent(1100, 2000);
+    expectDeadline(2100, 3000);
+
+    // SurfaceFlinger wakes up ahead of the vsync it composites for
+    mThread->setLatchOffset(-200);
+    mCallback->onVSyncEvent(1100, 2000);
+    expectDeadline(1800, 3000);
+}
+
 TEST_F(EventThreadTest, postHotplugInternalDisconnect) {
     mThread->onHotplugReceived(INTERNAL_DISPLAY_ID, false);
     expectHotplugEventReceivedByConnection(INTERNAL_DISPLAY_ID, false);
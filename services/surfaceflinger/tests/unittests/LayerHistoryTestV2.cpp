@@ -48,6 +48,9 @@ protected:
     static constexpr float HI_FPS = 90.f;
     static constexpr auto HI_FPS_PERIOD = static_cast<nsecs_t>(1e9f / HI_FPS);
 
+    template <size_t N>
+    using FrameTimes = LayerInfoV2::FrameTimes<N>;
+
     LayerHistoryTestV2() { mFlinger.resetScheduler(mScheduler); }
 
     impl::LayerHistoryV2& history() { return *mScheduler->mutableLayerHistoryV2(); }
@@ -152,6 +155,33 @@ TEST_F(LayerHistoryTestV2, DISABLED_oneLayer) {
     }
 }
 
+TEST_F(LayerHistoryTestV2, frameTimesKeepTheMostRecentFrames) {
+    FrameTimes<3> frameTimes;
+    for (nsecs_t i = 0; i < 2; i++) {
+        frameTimes.push(i, i * 10, false);
+    }
+    ASSERT_EQ(2u, frameTimes.size());
+    EXPECT_EQ(0, frameTimes.presentTime(0));
+    EXPECT_EQ(10, frameTimes.queueTime(1));
+
+    // Once the history is full, the oldest frames are replaced
+    for (nsecs_t i = 2; i < 7; i++) {
+        frameTimes.push(i, i * 10, i == 5);
+    }
+    ASSERT_EQ(3u, frameTimes.size());
+    for (size_t i = 0; i < frameTimes.size(); i++) {
+        EXPECT_EQ(static_cast<nsecs_t>(i + 4), frameTimes.presentTime(i));
+        EXPECT_EQ(static_cast<nsecs_t>(i + 4) * 10, frameTimes.queueTime(i));
+        EXPECT_EQ(i == 1, frameTimes.pendingConfigChange(i));
+    }
+
+    frameTimes.clear();
+    EXPECT_EQ(0u, frameTimes.size());
+    frameTimes.push(7, 70, false);
+    ASSERT_EQ(1u, frameTimes.size());
+    EXPECT_EQ(7, frameTimes.presentTime(0));
+}
+
 TEST_F(LayerHistoryTestV2, oneInvisibleLayer) {
     const auto layer = createLayer();
     EXPECT_CALL(*layer, isVisible()).WillRepeatedly(Return(true));
@@ -0,0 +1,93 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "LockFreeQueue.h"
+
+namespace android {
+namespace {
+
+TEST(LockFreeQueueTest, popsInPushOrder) {
+    LockFreeQueue<int> queue;
+    EXPECT_TRUE(queue.empty());
+    EXPECT_TRUE(queue.popAll().empty());
+
+    queue.push(1);
+    queue.push(2);
+    queue.push(3);
+    EXPECT_FALSE(queue.empty());
+    EXPECT_EQ((std::vector<int>{1, 2, 3}), queue.popAll());
+    EXPECT_TRUE(queue.empty());
+
+    queue.push(4);
+    EXPECT_EQ(std::vector<int>{4}, queue.popAll());
+}
+
+TEST(LockFreeQueueTest, destroysUnpoppedItems) {
+    auto item = std::make_shared<int>(42);
+    {
+        LockFreeQueue<std::shared_ptr<int>> queue;
+        queue.push(item);
+        queue.push(item);
+        EXPECT_EQ(3, item.use_count());
+    }
+    EXPECT_EQ(1, item.use_count());
+}
+
+TEST(LockFreeQueueTest, keepsOrderOfEachProducer) {
+    constexpr int kProducers = 4;
+    constexpr int kItemsPerProducer = 10000;
+
+    LockFreeQueue<std::pair<int, int>> queue;
+    std::vector<std::thread> producers;
+    for (int producer = 0; producer < kProducers; producer++) {
+        producers.emplace_back([&queue, producer] {
+            for (int i = 0; i < kItemsPerProducer; i++) {
+                queue.push({producer, i});
+            }
+        });
+    }
+
+    // Pop concurrently with the producers
+    std::vector<int> next(kProducers, 0);
+    int popped = 0;
+    const auto check = [&] {
+        for (const auto& [producer, i] : queue.popAll()) {
+            EXPECT_EQ(next[producer], i);
+            next[producer] = i + 1;
+            popped++;
+        }
+    };
+    while (popped < kProducers * kItemsPerProducer / 2) {
+        check();
+    }
+
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    check();
+    EXPECT_EQ(kProducers * kItemsPerProducer, popped);
+    EXPECT_TRUE(queue.empty());
+}
+
+} // namespace
+} // namespace android
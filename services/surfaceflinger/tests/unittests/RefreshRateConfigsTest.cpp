@@ -51,6 +51,30 @@ protected:
         return refreshRateConfigs.mKnownFrameRates;
     }
 
+    // Checks that the scores looked up for the known frame rates are the ones calculated for them
+    void expectKnownFrameRateScoresAreCalculated(const RefreshRateConfigs& refreshRateConfigs) {
+        const auto& knownFrameRates = refreshRateConfigs.mKnownFrameRates;
+        const auto& refreshRates = refreshRateConfigs.mRefreshRates;
+        ASSERT_EQ(knownFrameRates.size() * refreshRates.size(),
+                  refreshRateConfigs.mKnownFrameRateScores.size());
+        for (size_t i = 0; i < knownFrameRates.size(); i++) {
+            const auto layerPeriod = round<nsecs_t>(1e9f / knownFrameRates[i]);
+            for (const auto& [configId, refreshRate] : refreshRates) {
+                const auto displayPeriod = refreshRate->getVsyncPeriod();
+                const auto& scores =
+                        refreshRateConfigs.mKnownFrameRateScores[i * refreshRates.size() +
+                                                                 static_cast<size_t>(
+                                                                         configId.value())];
+                EXPECT_EQ(RefreshRateConfigs::calculateExplicitDefaultLayerScore(layerPeriod,
+                                                                                 displayPeriod),
+                          scores.explicitDefault);
+                EXPECT_EQ(RefreshRateConfigs::calculateExactOrMultipleLayerScore(layerPeriod,
+                                                                                 displayPeriod),
+                          scores.exactOrMultiple);
+            }
+        }
+    }
+
     // Test config IDs
     static inline const HwcConfigIndexType HWC_CONFIG_ID_60 = HwcConfigIndexType(0);
     static inline const HwcConfigIndexType HWC_CONFIG_ID_90 = HwcConfigIndexType(1);
@@ -1443,6 +1467,49 @@ TEST_F(RefreshRateConfigsTest, getBestRefreshRate_KnownFrameRate) {
     }
 }
 
+TEST_F(RefreshRateConfigsTest, getBestRefreshRate_knownFrameRateScores) {
+    expectKnownFrameRateScoresAreCalculated(RefreshRateConfigs(m60_90Device, HWC_CONFIG_ID_60));
+    expectKnownFrameRateScoresAreCalculated(
+            RefreshRateConfigs(m30_60_72_90_120Device, HWC_CONFIG_ID_60));
+}
+
+TEST_F(RefreshRateConfigsTest, getBestRefreshRate_cachesUntilInputsOrPolicyChange) {
+    auto refreshRateConfigs =
+            std::make_unique<RefreshRateConfigs>(m60_90Device,
+                                                 /*currentConfigId=*/HWC_CONFIG_ID_60);
+
+    auto layers = std::vector<LayerRequirement>{LayerRequirement{.weight = 1.0f}};
+    auto& layer = layers[0];
+    layer.vote = LayerVoteType::Heuristic;
+    layer.desiredRefreshRate = 60.0f;
+
+    RefreshRateConfigs::GlobalSignals consideredSignals;
+    EXPECT_EQ(mExpected60Config,
+              refreshRateConfigs->getBestRefreshRate(layers, {.touch = false, .idle = false},
+                                                     &consideredSignals));
+    EXPECT_FALSE(consideredSignals.touch);
+
+    EXPECT_EQ(mExpected90Config,
+              refreshRateConfigs->getBestRefreshRate(layers, {.touch = true, .idle = false},
+                                                     &consideredSignals));
+    EXPECT_TRUE(consideredSignals.touch);
+
+    // The signals considered are reported for a cached result too
+    consideredSignals = {};
+    EXPECT_EQ(mExpected90Config,
+              refreshRateConfigs->getBestRefreshRate(layers, {.touch = true, .idle = false},
+                                                     &consideredSignals));
+    EXPECT_TRUE(consideredSignals.touch);
+
+    layer.desiredRefreshRate = 90.0f;
+    EXPECT_EQ(mExpected90Config,
+              refreshRateConfigs->getBestRefreshRate(layers, {.touch = false, .idle = false}));
+
+    ASSERT_GE(refreshRateConfigs->setDisplayManagerPolicy({HWC_CONFIG_ID_60, {60, 60}}), 0);
+    EXPECT_EQ(mExpected60Config,
+              refreshRateConfigs->getBestRefreshRate(layers, {.touch = false, .idle = false}));
+}
+
 TEST_F(RefreshRateConfigsTest, testComparisonOperator) {
     EXPECT_TRUE(mExpected60Config < mExpected90Config);
     EXPECT_FALSE(mExpected60Config < mExpected60Config);
@@ -106,6 +106,31 @@ TEST_F(RegionSamplingTest, bounds_checking) {
                 testing::Eq(0.0));
 }
 
+// regions of all widths, so that vectorized and remaining pixels are covered
+TEST_F(RegionSamplingTest, calculate_mean_matches_per_pixel_luma) {
+    std::generate(buffer.begin(), buffer.end(),
+                  [n = 0u]() mutable { return (n++ * 2654435761u) ^ 0x5bd1e995u; });
+
+    for (int left = 0; left < 9; left++) {
+        for (int right = left + 1; right <= kWidth; right++) {
+            Rect const region{left, 1, right, kHeight - 1};
+            uint32_t accumulated = 0;
+            for (int row = region.top; row < region.bottom; row++) {
+                for (int column = region.left; column < region.right; column++) {
+                    uint32_t const pixel = buffer[row * kStride + column];
+                    accumulated += ((pixel & 0xFF) * 7 + ((pixel >> 8) & 0xFF) * 23 +
+                                    ((pixel >> 16) & 0xFF) * 2) >>
+                            5;
+                }
+            }
+            float const expected = accumulated / (255.0f * region.getWidth() * region.getHeight());
+            EXPECT_THAT(sampleArea(buffer.data(), kWidth, kHeight, kStride, kOrientation, region),
+                        testing::FloatEq(expected))
+                    << left << " " << right;
+        }
+    }
+}
+
 // workaround for b/133849373
 TEST_F(RegionSamplingTest, orientation_90) {
     std::generate(buffer.begin(), buffer.end(),
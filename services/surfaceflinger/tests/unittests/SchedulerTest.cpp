@@ -136,6 +136,9 @@ TEST_F(SchedulerTest, invalidConnectionHandle) {
 
     EXPECT_CALL(*mEventThread, setPhaseOffset(_)).Times(0);
     ASSERT_NO_FATAL_FAILURE(mScheduler->setPhaseOffset(handle, 10));
+
+    EXPECT_CALL(*mEventThread, setLatchOffset(_)).Times(0);
+    ASSERT_NO_FATAL_FAILURE(mScheduler->setLatchOffset(handle, 10));
 }
 
 TEST_F(SchedulerTest, validConnectionHandle) {
@@ -165,6 +168,9 @@ TEST_F(SchedulerTest, validConnectionHandle) {
     EXPECT_CALL(*mEventThread, setPhaseOffset(10)).Times(1);
     ASSERT_NO_FATAL_FAILURE(mScheduler->setPhaseOffset(mConnectionHandle, 10));
 
+    EXPECT_CALL(*mEventThread, setLatchOffset(10)).Times(1);
+    ASSERT_NO_FATAL_FAILURE(mScheduler->setLatchOffset(mConnectionHandle, 10));
+
     static constexpr size_t kEventConnections = 5;
     ON_CALL(*mEventThread, getEventThreadConnectionCount())
             .WillByDefault(Return(kEventConnections));
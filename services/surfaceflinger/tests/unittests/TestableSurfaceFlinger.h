@@ -347,7 +347,15 @@ public:
         return mFlinger->SurfaceFlinger::getDisplayNativePrimaries(displayToken, primaries);
     }
 
-    auto& getTransactionQueue() { return mFlinger->mTransactionQueues; }
+    auto& getTransactionQueue() NO_THREAD_SAFETY_ANALYSIS {
+        // Transactions sent without mStateLock are only queued once it is next taken
+        std::vector<const SurfaceFlinger::TransactionState> applied;
+        {
+            Mutex::Autolock lock(mFlinger->mStateLock);
+            mFlinger->flushInboundTransactionsLocked(applied, /*isMainThread*/ false);
+        }
+        return mFlinger->mTransactionQueues;
+    }
 
     auto setTransactionState(const Vector<ComposerState>& states,
                              const Vector<DisplayState>& displays, uint32_t flags,
@@ -363,6 +371,10 @@ public:
 
     auto flushTransactionQueues() { return mFlinger->flushTransactionQueues(); };
 
+    auto rebuildDrawingLayersInZOrder() { return mFlinger->rebuildDrawingLayersInZOrder(); }
+
+    auto commitTransactionLocked() { return mFlinger->commitTransactionLocked(); }
+
     auto onTransact(uint32_t code, const Parcel& data, Parcel* reply, uint32_t flags) {
         return mFlinger->onTransact(code, data, reply, flags);
     }
@@ -393,6 +405,7 @@ public:
     auto& mutableDisplayColorSetting() { return mFlinger->mDisplayColorSetting; }
     auto& mutableDisplays() { return mFlinger->mDisplays; }
     auto& mutableDrawingState() { return mFlinger->mDrawingState; }
+    const auto& drawingLayersInZOrder() const { return mFlinger->mDrawingLayersInZOrder; }
     auto& mutableEventQueue() { return mFlinger->mEventQueue; }
     auto& mutableGeometryInvalid() { return mFlinger->mGeometryInvalid; }
     auto& mutableInterceptor() { return mFlinger->mInterceptor; }
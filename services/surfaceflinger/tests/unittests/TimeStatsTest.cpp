@@ -224,10 +224,15 @@ static std::string genLayerName(int32_t layerId) {
     return (layerId < 0 ? "PopupWindow:b54fcd1#0" : "com.example.fake#") + std::to_string(layerId);
 }
 
+static uid_t genUid(int32_t layerId) {
+    return static_cast<uid_t>(10000 + layerId);
+}
+
 void TimeStatsTest::setTimeStamp(TimeStamp type, int32_t id, uint64_t frameNumber, nsecs_t ts) {
     switch (type) {
         case TimeStamp::POST:
-            ASSERT_NO_FATAL_FAILURE(mTimeStats->setPostTime(id, frameNumber, genLayerName(id), ts));
+            ASSERT_NO_FATAL_FAILURE(
+                    mTimeStats->setPostTime(id, frameNumber, genLayerName(id), genUid(id), ts));
             break;
         case TimeStamp::ACQUIRE:
             ASSERT_NO_FATAL_FAILURE(mTimeStats->setAcquireTime(id, frameNumber, ts));
@@ -394,6 +399,21 @@ TEST_F(TimeStatsTest, canIncreaseCompositionStrategyChanges) {
     EXPECT_THAT(result, HasSubstr(expectedResult));
 }
 
+TEST_F(TimeStatsTest, canIncreaseCompositionStrategyPredictedFrames) {
+    // this stat is not in the proto so verify by checking the string dump
+    constexpr size_t COMPOSITION_STRATEGY_PREDICTED_FRAMES = 2;
+
+    EXPECT_TRUE(inputCommand(InputCommand::ENABLE, FMT_STRING).empty());
+    for (size_t i = 0; i < COMPOSITION_STRATEGY_PREDICTED_FRAMES; i++) {
+        ASSERT_NO_FATAL_FAILURE(mTimeStats->incrementCompositionStrategyPredictedFrames());
+    }
+
+    const std::string result(inputCommand(InputCommand::DUMP_ALL, FMT_STRING));
+    const std::string expectedResult = "compositionStrategyPredictedFrames = " +
+            std::to_string(COMPOSITION_STRATEGY_PREDICTED_FRAMES);
+    EXPECT_THAT(result, HasSubstr(expectedResult));
+}
+
 TEST_F(TimeStatsTest, canAverageFrameDuration) {
     EXPECT_TRUE(inputCommand(InputCommand::ENABLE, FMT_STRING).empty());
     mTimeStats->setPowerMode(PowerMode::ON);
@@ -536,13 +556,15 @@ TEST_F(TimeStatsTest, canInsertOneLayerTimeStats) {
     EXPECT_EQ(genLayerName(LAYER_ID_0), layerProto.layer_name());
     ASSERT_TRUE(layerProto.has_total_frames());
     EXPECT_EQ(1, layerProto.total_frames());
-    ASSERT_EQ(6, layerProto.deltas_size());
+    ASSERT_EQ(7, layerProto.deltas_size());
     for (const SFTimeStatsDeltaProto& deltaProto : layerProto.deltas()) {
         ASSERT_EQ(1, deltaProto.histograms_size());
         const SFTimeStatsHistogramBucketProto& histogramProto = deltaProto.histograms().Get(0);
         EXPECT_EQ(1, histogramProto.frame_count());
         if ("post2acquire" == deltaProto.delta_name()) {
             EXPECT_EQ(1, histogramProto.time_millis());
+        } else if ("post2latch" == deltaProto.delta_name()) {
+            EXPECT_EQ(2, histogramProto.time_millis());
         } else if ("post2present" == deltaProto.delta_name()) {
             EXPECT_EQ(4, histogramProto.time_millis());
         } else if ("acquire2present" == deltaProto.delta_name()) {
@@ -585,6 +607,33 @@ TEST_F(TimeStatsTest, canInsertMultipleLayersTimeStats) {
     EXPECT_EQ(2, globalProto.stats_size());
 }
 
+TEST_F(TimeStatsTest, keepsLayersOfDifferentUidsWithTheSameNameApart) {
+    EXPECT_TRUE(inputCommand(InputCommand::ENABLE, FMT_STRING).empty());
+
+    const std::string layerName = genLayerName(LAYER_ID_0);
+    for (uint64_t frameNumber = 1; frameNumber <= 2; frameNumber++) {
+        const nsecs_t postTime = static_cast<nsecs_t>(frameNumber) * 1000000;
+        for (int32_t layerId : {LAYER_ID_0, LAYER_ID_1}) {
+            mTimeStats->setPostTime(layerId, frameNumber, layerName, genUid(layerId), postTime);
+            mTimeStats->setPresentTime(layerId, frameNumber, postTime + 1000000);
+        }
+    }
+
+    SFTimeStatsGlobalProto globalProto;
+    ASSERT_TRUE(globalProto.ParseFromString(inputCommand(InputCommand::DUMP_ALL, FMT_PROTO)));
+
+    ASSERT_EQ(2, globalProto.stats_size());
+    std::vector<int32_t> uids;
+    for (const SFTimeStatsLayerProto& layerProto : globalProto.stats()) {
+        EXPECT_EQ(layerName, layerProto.layer_name());
+        EXPECT_EQ(1, layerProto.total_frames());
+        uids.push_back(layerProto.uid());
+    }
+    EXPECT_THAT(uids,
+                UnorderedElementsAre(static_cast<int32_t>(genUid(LAYER_ID_0)),
+                                     static_cast<int32_t>(genUid(LAYER_ID_1))));
+}
+
 TEST_F(TimeStatsTest, canInsertUnorderedLayerTimeStats) {
     EXPECT_TRUE(inputCommand(InputCommand::ENABLE, FMT_STRING).empty());
 
@@ -600,13 +649,15 @@ TEST_F(TimeStatsTest, canInsertUnorderedLayerTimeStats) {
     EXPECT_EQ(genLayerName(LAYER_ID_0), layerProto.layer_name());
     ASSERT_TRUE(layerProto.has_total_frames());
     EXPECT_EQ(1, layerProto.total_frames());
-    ASSERT_EQ(6, layerProto.deltas_size());
+    ASSERT_EQ(7, layerProto.deltas_size());
     for (const SFTimeStatsDeltaProto& deltaProto : layerProto.deltas()) {
         ASSERT_EQ(1, deltaProto.histograms_size());
         const SFTimeStatsHistogramBucketProto& histogramProto = deltaProto.histograms().Get(0);
         EXPECT_EQ(1, histogramProto.frame_count());
         if ("post2acquire" == deltaProto.delta_name()) {
             EXPECT_EQ(0, histogramProto.time_millis());
+        } else if ("post2latch" == deltaProto.delta_name()) {
+            EXPECT_EQ(0, histogramProto.time_millis());
         } else if ("post2present" == deltaProto.delta_name()) {
             EXPECT_EQ(2, histogramProto.time_millis());
         } else if ("acquire2present" == deltaProto.delta_name()) {
@@ -778,6 +829,7 @@ TEST_F(TimeStatsTest, canClearDumpOnlyTimeStats) {
     ASSERT_NO_FATAL_FAILURE(mTimeStats->incrementClientCompositionReusedFrames());
     ASSERT_NO_FATAL_FAILURE(mTimeStats->incrementRefreshRateSwitches());
     ASSERT_NO_FATAL_FAILURE(mTimeStats->incrementCompositionStrategyChanges());
+    ASSERT_NO_FATAL_FAILURE(mTimeStats->incrementCompositionStrategyPredictedFrames());
     mTimeStats->setPowerMode(PowerMode::ON);
     mTimeStats
             ->recordFrameDuration(std::chrono::duration_cast<std::chrono::nanoseconds>(1ms).count(),
@@ -795,6 +847,7 @@ TEST_F(TimeStatsTest, canClearDumpOnlyTimeStats) {
     EXPECT_THAT(result, HasSubstr("clientCompositionReusedFrames = 0"));
     EXPECT_THAT(result, HasSubstr("refreshRateSwitches = 0"));
     EXPECT_THAT(result, HasSubstr("compositionStrategyChanges = 0"));
+    EXPECT_THAT(result, HasSubstr("compositionStrategyPredictedFrames = 0"));
     EXPECT_THAT(result, HasSubstr("averageFrameDuration = 0.000 ms"));
     EXPECT_THAT(result, HasSubstr("averageRenderEngineTiming = 0.000 ms"));
 }
@@ -1033,6 +1086,9 @@ TEST_F(TimeStatsTest, layerStatsCallback_pullsAllAndClears) {
         EXPECT_CALL(*mDelegate, statsEventWriteInt64(mDelegate->mEvent, LATE_ACQUIRE_FRAMES));
         EXPECT_CALL(*mDelegate,
                     statsEventWriteInt64(mDelegate->mEvent, BAD_DESIRED_PRESENT_FRAMES));
+        EXPECT_CALL(*mDelegate,
+                    statsEventWriteInt32(mDelegate->mEvent,
+                                         static_cast<int32_t>(genUid(LAYER_ID_0))));
         EXPECT_CALL(*mDelegate, statsEventBuild(mDelegate->mEvent));
     }
     EXPECT_EQ(AStatsManager_PULL_SUCCESS,
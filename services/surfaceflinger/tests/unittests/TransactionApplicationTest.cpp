@@ -295,6 +295,47 @@ TEST_F(TransactionApplicationTest, NotPlacedOnTransactionQueue_SyncInputWindows)
     NotPlacedOnTransactionQueue(/*flags*/ 0, /*syncInputWindows*/ true);
 }
 
+TEST_F(TransactionApplicationTest, NotPlacedOnTransactionQueue_Async) {
+    NotPlacedOnTransactionQueue(/*flags*/ 0, /*syncInputWindows*/ false);
+}
+
+TEST_F(TransactionApplicationTest, Async_QueuedBehindPriorTransaction) {
+    ASSERT_EQ(0, mFlinger.getTransactionQueue().size());
+    // called in SurfaceFlinger::signalTransaction
+    EXPECT_CALL(*mMessageQueue, invalidate()).Times(1);
+    nsecs_t time = systemTime();
+    EXPECT_CALL(*mPrimaryDispSync, expectedPresentTime(_))
+            .WillRepeatedly(Return(time + nsecs_t(5 * 1e8)));
+
+    // transaction that should go on the pending queue
+    TransactionInfo transactionA;
+    setupSingle(transactionA, /*flags*/ 0, /*syncInputWindows*/ false,
+                /*desiredPresentTime*/ time + s2ns(1));
+    // transaction that is ready, but sent after transactionA
+    TransactionInfo transactionB;
+    setupSingle(transactionB, /*flags*/ 0, /*syncInputWindows*/ false,
+                /*desiredPresentTime*/ -1);
+
+    mFlinger.setTransactionState(transactionA.states, transactionA.displays, transactionA.flags,
+                                 transactionA.applyToken, transactionA.inputWindowCommands,
+                                 transactionA.desiredPresentTime, transactionA.uncacheBuffer,
+                                 mHasListenerCallbacks, mCallbacks);
+    mFlinger.setTransactionState(transactionB.states, transactionB.displays, transactionB.flags,
+                                 transactionB.applyToken, transactionB.inputWindowCommands,
+                                 transactionB.desiredPresentTime, transactionB.uncacheBuffer,
+                                 mHasListenerCallbacks, mCallbacks);
+
+    auto transactionQueue = mFlinger.getTransactionQueue();
+    ASSERT_EQ(1, transactionQueue.size());
+
+    auto& [applyToken, transactionStates] = *(transactionQueue.begin());
+    ASSERT_EQ(2, transactionStates.size());
+
+    checkEqual(transactionA, transactionStates.front());
+    transactionStates.pop();
+    checkEqual(transactionB, transactionStates.front());
+}
+
 TEST_F(TransactionApplicationTest, PlaceOnTransactionQueue_Synchronous) {
     PlaceOnTransactionQueue(ISurfaceComposer::eSynchronous, /*syncInputWindows*/ false);
 }
@@ -778,6 +778,34 @@ TEST_F(VSyncDispatchTimerQueueTest, laggedTimerGroupsCallbacksWithinLag) {
     EXPECT_THAT(cb2.mWakeupTime[0], Eq(610));
 }
 
+TEST_F(VSyncDispatchTimerQueueTest, dumpsCoalescedWakeups) {
+    CountingCallback cb0(mDispatch);
+    CountingCallback cb1(mDispatch);
+    CountingCallback cb2(mDispatch);
+
+    EXPECT_CALL(mMockClock, alarmAt(_, 600));
+    mDispatch.schedule(cb0, 400, 1000);
+    mDispatch.schedule(cb1, 400 - mDispatchGroupThreshold + 1, 1000);
+    advanceToNextCallback();
+
+    // The callback which is due outside of the slack needs a wakeup of its own
+    EXPECT_CALL(mMockClock, alarmAt(_, 1600));
+    EXPECT_CALL(mMockClock, alarmAt(_, 1600 + mDispatchGroupThreshold));
+    mDispatch.schedule(cb0, 400, 2000);
+    mDispatch.schedule(cb2, 400 - mDispatchGroupThreshold, 2000);
+    advanceToNextCallback();
+    advanceToNextCallback();
+
+    EXPECT_THAT(cb0.mCalls.size(), Eq(2));
+    EXPECT_THAT(cb1.mCalls.size(), Eq(1));
+    EXPECT_THAT(cb2.mCalls.size(), Eq(1));
+
+    std::string dump;
+    mDispatch.dump(dump);
+    EXPECT_THAT(dump, HasSubstr("Wakeups: 3 (0 without callbacks), 1.33 callbacks per wakeup"));
+    EXPECT_THAT(dump, HasSubstr("coalesced callbacks ran up to 0.00ms early"));
+}
+
 class VSyncDispatchTimerQueueEntryTest : public testing::Test {
 protected:
     nsecs_t const mPeriod = 1000;
@@ -33,10 +33,16 @@ public:
         mPhaseOffset[handle] = phaseOffset;
     }
 
+    void setLatchOffset(ConnectionHandle handle, nsecs_t latchOffset) {
+        mLatchOffset[handle] = latchOffset;
+    }
+
     nsecs_t getOffset(ConnectionHandle handle) { return mPhaseOffset[handle]; }
+    nsecs_t getLatchOffset(ConnectionHandle handle) { return mLatchOffset[handle]; }
 
 private:
     std::unordered_map<ConnectionHandle, nsecs_t> mPhaseOffset;
+    std::unordered_map<ConnectionHandle, nsecs_t> mLatchOffset;
 };
 
 class VSyncModulatorTest : public testing::Test {
@@ -45,6 +51,11 @@ protected:
             VSyncModulator::MIN_EARLY_FRAME_COUNT_TRANSACTION;
     // Add a 1ms slack to avoid strange timer race conditions.
     static constexpr auto MARGIN_FOR_TX_APPLY = VSyncModulator::MARGIN_FOR_TX_APPLY + 1ms;
+    static constexpr auto FRAME_DURATION_HISTORY_SIZE = VSyncModulator::FRAME_DURATION_HISTORY_SIZE;
+    static constexpr auto MIN_FRAME_DURATIONS_FOR_PREDICTION =
+            VSyncModulator::MIN_FRAME_DURATIONS_FOR_PREDICTION;
+    static constexpr nsecs_t MIN_ADAPTIVE_MARGIN = VSyncModulator::MIN_ADAPTIVE_MARGIN.count();
+    static constexpr nsecs_t ADAPTIVE_MARGIN_STEP = VSyncModulator::ADAPTIVE_MARGIN_STEP.count();
 
     // Used to enumerate the different offsets we have
     enum {
@@ -71,9 +82,12 @@ protected:
 
         EXPECT_EQ(APP_LATE, mMockScheduler.getOffset(mAppConnection));
         EXPECT_EQ(SF_LATE, mMockScheduler.getOffset(mSfConnection));
+        EXPECT_EQ(SF_LATE, mMockScheduler.getLatchOffset(mAppConnection));
     };
 
     void TearDown() override { mVSyncModulator.reset(); }
+
+    void enableAdaptiveLateOffsets() { mVSyncModulator->mAdaptiveLateOffsetsEnabled = true; }
 };
 
 TEST_F(VSyncModulatorTest, Normal) {
@@ -96,6 +110,7 @@ TEST_F(VSyncModulatorTest, EarlyEnd) {
     mVSyncModulator->onTransactionHandled();
     EXPECT_EQ(APP_EARLY, mMockScheduler.getOffset(mAppConnection));
     EXPECT_EQ(SF_EARLY, mMockScheduler.getOffset(mSfConnection));
+    EXPECT_EQ(SF_EARLY, mMockScheduler.getLatchOffset(mAppConnection));
 
     for (int i = 0; i < MIN_EARLY_FRAME_COUNT_TRANSACTION - 1; i++) {
         mVSyncModulator->onRefreshed(false);
@@ -298,4 +313,58 @@ TEST_F(VSyncModulatorTest, EarlyStartAfterEarlyEndWithMoreTransactions) {
     EXPECT_EQ(SF_LATE, mMockScheduler.getOffset(mSfConnection));
 }
 
+TEST_F(VSyncModulatorTest, AdaptiveLateOffsetsFollowFrameDurations) {
+    constexpr nsecs_t kVsyncPeriod = 16'666'666;
+
+    // 10ms for SurfaceFlinger and 10ms for apps, or 13ms for SurfaceFlinger when early
+    const VSyncModulator::OffsetsConfig offsets = {{3'666'666, 10'333'332},
+                                                   {3'666'666, 10'333'332},
+                                                   {6'666'666, 13'333'332}};
+    enableAdaptiveLateOffsets();
+    mVSyncModulator->setPhaseOffsets(offsets);
+
+    // The configured late offsets are kept until enough frames were composed
+    for (size_t i = 0; i < MIN_FRAME_DURATIONS_FOR_PREDICTION - 1; i++) {
+        mVSyncModulator->onFrameComposed(4'000'000, kVsyncPeriod);
+    }
+    EXPECT_EQ(offsets.late.sf, mMockScheduler.getOffset(mSfConnection));
+    EXPECT_EQ(offsets.late.app, mMockScheduler.getOffset(mAppConnection));
+
+    // SurfaceFlinger then wakes up the frame duration and margin before the vsync, and the app
+    // still 10ms before SurfaceFlinger, i.e. after the previous vsync
+    mVSyncModulator->onFrameComposed(4'000'000, kVsyncPeriod);
+    nsecs_t sfOffset = kVsyncPeriod - 4'000'000 - MIN_ADAPTIVE_MARGIN;
+    EXPECT_EQ(sfOffset, mMockScheduler.getOffset(mSfConnection));
+    EXPECT_EQ(sfOffset - 10'000'000, mMockScheduler.getOffset(mAppConnection));
+
+    // A missed frame leaves more time to compose right away
+    mVSyncModulator->onFrameMissed();
+    sfOffset -= ADAPTIVE_MARGIN_STEP;
+    EXPECT_EQ(sfOffset, mMockScheduler.getOffset(mSfConnection));
+    EXPECT_EQ(sfOffset - 10'000'000, mMockScheduler.getOffset(mAppConnection));
+
+    // Early offsets still take precedence
+    mVSyncModulator->setTransactionStart(Scheduler::TransactionStart::EarlyStart);
+    EXPECT_EQ(offsets.early.sf, mMockScheduler.getOffset(mSfConnection));
+    mVSyncModulator->setTransactionStart(Scheduler::TransactionStart::EarlyEnd);
+    std::this_thread::sleep_for(MARGIN_FOR_TX_APPLY);
+    mVSyncModulator->onTransactionHandled();
+    for (int i = 0; i < MIN_EARLY_FRAME_COUNT_TRANSACTION; i++) {
+        mVSyncModulator->onRefreshed(false);
+    }
+    EXPECT_EQ(sfOffset, mMockScheduler.getOffset(mSfConnection));
+
+    // SurfaceFlinger never wakes up earlier than with the configured offsets
+    for (size_t i = 0; i < FRAME_DURATION_HISTORY_SIZE; i++) {
+        mVSyncModulator->onFrameComposed(20'000'000, kVsyncPeriod);
+    }
+    EXPECT_EQ(offsets.early.sf, mMockScheduler.getOffset(mSfConnection));
+    EXPECT_EQ(offsets.early.sf + kVsyncPeriod - 10'000'000,
+              mMockScheduler.getOffset(mAppConnection));
+
+    // A change of offsets falls back to the configured late offsets until the next frame
+    mVSyncModulator->setPhaseOffsets(offsets);
+    EXPECT_EQ(offsets.late.sf, mMockScheduler.getOffset(mSfConnection));
+}
+
 } // namespace android::scheduler
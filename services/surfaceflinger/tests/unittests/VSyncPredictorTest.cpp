@@ -28,6 +28,7 @@
 #include <gtest/gtest.h>
 #include <algorithm>
 #include <chrono>
+#include <thread>
 #include <utility>
 
 using namespace testing;
@@ -450,6 +451,48 @@ TEST_F(VSyncPredictorTest, aPhoneThatHasBeenAroundAWhileCanStillComputePeriod) {
     EXPECT_THAT(intercept, Eq(0));
 }
 
+TEST_F(VSyncPredictorTest, keepsTrackingAPeriodChangeOverManySamples) {
+    auto const idealPeriod = 16666666;
+    auto const realPeriod = 16600000;
+    tracker.setPeriod(idealPeriod);
+
+    // Enough samples for the oldest ones to be replaced many times over
+    nsecs_t timestamp = 840873348817;
+    for (auto i = 0u; i < 50 * kHistorySize; i++) {
+        EXPECT_TRUE(tracker.addVsyncTimestamp(timestamp));
+        timestamp += realPeriod;
+    }
+
+    auto [slope, intercept] = tracker.getVSyncPredictionModel();
+    EXPECT_THAT(slope, Eq(realPeriod));
+    EXPECT_THAT(intercept, Eq(0));
+}
+
+TEST_F(VSyncPredictorTest, readsAConsistentModelWhileTimestampsAreAdded) {
+    for (auto i = 0u; i < kHistorySize; i++) {
+        tracker.addVsyncTimestamp(mNow += mPeriod);
+    }
+
+    // The writer only ever adds timestamps on the ideal period, so every model it publishes
+    // predicts the same vsyncs after its last timestamp
+    constexpr auto writerSamples = 100 * kHistorySize;
+    std::thread writer([this, now = mNow]() mutable {
+        for (auto i = 0u; i < writerSamples; i++) {
+            tracker.addVsyncTimestamp(now += mPeriod);
+        }
+    });
+
+    auto const lastTimestamp = mNow + static_cast<nsecs_t>(writerSamples) * mPeriod;
+    for (auto i = 0u; i < 10000; i++) {
+        auto const timePoint = lastTimestamp + static_cast<nsecs_t>(i) * mPeriod / 3 + 1;
+        EXPECT_THAT(tracker.nextAnticipatedVSyncTimeFrom(timePoint),
+                    Eq((timePoint / mPeriod + 1) * mPeriod));
+        EXPECT_THAT(tracker.currentPeriod(), Eq(mPeriod));
+        EXPECT_FALSE(tracker.needsMoreSamples());
+    }
+    writer.join();
+}
+
 TEST_F(VSyncPredictorTest, InconsistentVsyncValueIsFlushedEventually) {
     EXPECT_TRUE(tracker.addVsyncTimestamp(600));
     EXPECT_TRUE(tracker.needsMoreSamples());
@@ -27,7 +27,8 @@ namespace android {
 namespace dvr {
 
 BufferHubService::BufferHubService()
-    : BASE("BufferHub", Endpoint::Create(BufferHubRPC::kClientPath)) {}
+    : BASE("BufferHub", Endpoint::Create(BufferHubRPC::kClientPath)),
+      buffer_pool_(std::make_shared<IonBufferPool>()) {}
 
 BufferHubService::~BufferHubService() {}
 
@@ -211,6 +212,12 @@ std::string BufferHubService::DumpState(size_t /*max_length*/) {
       stream << std::endl;
     }
   }
+  stream << std::endl;
+
+  stream << "Buffer Pool: " << buffer_pool_->buffer_count() << " buffers, "
+         << buffer_pool_->size_bytes() << "/"
+         << buffer_pool_->capacity_bytes() << " bytes";
+  stream << std::endl;
 
   return stream.str();
 }
@@ -269,9 +276,9 @@ Status<void> BufferHubService::OnCreateBuffer(Message& message, uint32_t width,
     return ErrorStatus(EALREADY);
   }
   const uint32_t kDefaultLayerCount = 1;
-  auto status = ProducerChannel::Create(this, buffer_id, width, height,
-                                        kDefaultLayerCount, format, usage,
-                                        meta_size_bytes);
+  auto status = ProducerChannel::Create(
+      this, buffer_id, message.GetEffectiveUserId(), width, height,
+      kDefaultLayerCount, format, usage, meta_size_bytes);
   if (status) {
     message.SetChannel(status.take());
     return {};
@@ -8,6 +8,7 @@
 #include <hardware/gralloc.h>
 #include <pdx/service.h>
 #include <private/dvr/bufferhub_rpc.h>
+#include <private/dvr/ion_buffer_pool.h>
 
 namespace android {
 namespace dvr {
@@ -138,9 +139,17 @@ class BufferHubService : public pdx::ServiceBase<BufferHubService> {
   bool IsInitialized() const override;
   std::string DumpState(size_t max_length) override;
 
+  // Pool of the buffers of destroyed producers, shared with the producers so
+  // that it outlives them.
+  const std::shared_ptr<IonBufferPool>& buffer_pool() const {
+    return buffer_pool_;
+  }
+
  private:
   friend BASE;
 
+  std::shared_ptr<IonBufferPool> buffer_pool_;
+
   pdx::Status<void> OnCreateBuffer(pdx::Message& message, uint32_t width,
                                    uint32_t height, uint32_t format,
                                    uint64_t usage, size_t meta_size_bytes);
@@ -0,0 +1,76 @@
+#ifndef ANDROID_DVR_BUFFERHUBD_ION_BUFFER_POOL_H_
+#define ANDROID_DVR_BUFFERHUBD_ION_BUFFER_POOL_H_
+
+#include <sys/types.h>
+
+#include <chrono>
+#include <list>
+
+#include <private/dvr/ion_buffer.h>
+
+namespace android {
+namespace dvr {
+
+// IonBufferPool keeps the buffers of destroyed producers for a while, so that
+// an app recreating its queues with the same geometry, format and usage gets
+// them back instead of causing a new gralloc allocation for every buffer.
+// Buffers are only handed back to the user that released them, as clients may
+// still have them mapped.
+//
+// The pool is accessed only from the service dispatch thread.
+class IonBufferPool {
+ public:
+  // Total size of the pooled buffers when not overridden by the
+  // "bufferhubd.pool_size_bytes" property. Zero disables pooling.
+  static constexpr size_t kDefaultCapacityBytes = 64 * 1024 * 1024;
+
+  // Pooled buffers that are not reused within this time are freed.
+  static constexpr std::chrono::seconds kMaxIdleTime{10};
+
+  IonBufferPool();
+  explicit IonBufferPool(size_t capacity_bytes);
+
+  // Like IonBuffer::Alloc, but takes a matching buffer released by |owner|
+  // from the pool when there is one. If gralloc fails to allocate, the pool is
+  // emptied to relieve memory pressure and the allocation is retried.
+  int Alloc(IonBuffer* buffer, uid_t owner, uint32_t width, uint32_t height,
+            uint32_t layer_count, uint32_t format, uint64_t usage);
+
+  // Moves |buffer| into the pool on behalf of |owner|, evicting the oldest
+  // pooled buffers to stay within the capacity. Invalid buffers and buffers
+  // larger than the capacity are freed.
+  void Release(uid_t owner, IonBuffer buffer);
+
+  // Frees pooled buffers, oldest first, until at most |target_bytes| remain.
+  void Trim(size_t target_bytes);
+
+  size_t capacity_bytes() const { return capacity_bytes_; }
+  size_t size_bytes() const { return size_bytes_; }
+  size_t buffer_count() const { return entries_.size(); }
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Entry {
+    uid_t owner;
+    size_t size_bytes;
+    Clock::time_point release_time;
+    IonBuffer buffer;
+  };
+
+  // Frees the buffers that have been idle for longer than kMaxIdleTime.
+  void TrimIdle();
+
+  // Entries in release order, oldest first.
+  std::list<Entry> entries_;
+  size_t capacity_bytes_;
+  size_t size_bytes_ = 0;
+
+  IonBufferPool(const IonBufferPool&) = delete;
+  void operator=(const IonBufferPool&) = delete;
+};
+
+}  // namespace dvr
+}  // namespace android
+
+#endif  // ANDROID_DVR_BUFFERHUBD_ION_BUFFER_POOL_H_
@@ -11,6 +11,7 @@
 #include <private/dvr/buffer_hub.h>
 #include <private/dvr/bufferhub_rpc.h>
 #include <private/dvr/ion_buffer.h>
+#include <private/dvr/ion_buffer_pool.h>
 
 namespace android {
 namespace dvr {
@@ -35,8 +36,10 @@ class ProducerChannel : public BufferHubChannel {
                                                  IonBuffer metadata_buffer,
                                                  size_t user_metadata_size);
 
+  // Allocates the buffer from the service's buffer pool on behalf of |owner|,
+  // and returns it to the pool when the channel is destroyed.
   static pdx::Status<std::shared_ptr<ProducerChannel>> Create(
-      BufferHubService* service, int channel_id, uint32_t width,
+      BufferHubService* service, int channel_id, uid_t owner, uint32_t width,
       uint32_t height, uint32_t layer_count, uint32_t format, uint64_t usage,
       size_t user_metadata_size);
 
@@ -76,6 +79,11 @@ class ProducerChannel : public BufferHubChannel {
 
   IonBuffer buffer_;
 
+  // Pool the buffer was allocated from and the user it was allocated for, if
+  // any.
+  std::shared_ptr<IonBufferPool> buffer_pool_;
+  uid_t owner_ = 0;
+
   // IonBuffer that is shared between bufferhubd, producer, and consumers.
   IonBuffer metadata_buffer_;
   BufferHubDefs::MetadataHeader* metadata_header_ = nullptr;
@@ -99,9 +107,10 @@ class ProducerChannel : public BufferHubChannel {
   ProducerChannel(BufferHubService* service, int buffer_id, int channel_id,
                   IonBuffer buffer, IonBuffer metadata_buffer,
                   size_t user_metadata_size, int* error);
-  ProducerChannel(BufferHubService* service, int channel, uint32_t width,
-                  uint32_t height, uint32_t layer_count, uint32_t format,
-                  uint64_t usage, size_t user_metadata_size, int* error);
+  ProducerChannel(BufferHubService* service, int channel, uid_t owner,
+                  uint32_t width, uint32_t height, uint32_t layer_count,
+                  uint32_t format, uint64_t usage, size_t user_metadata_size,
+                  int* error);
 
   int InitializeBuffer();
   pdx::Status<BufferDescription<BorrowedHandle>> OnGetBuffer(Message& message);
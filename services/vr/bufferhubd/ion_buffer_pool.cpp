@@ -0,0 +1,112 @@
+#include <private/dvr/ion_buffer_pool.h>
+
+#include <inttypes.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include <android-base/properties.h>
+#include <log/log.h>
+#include <ui/PixelFormat.h>
+#include <utils/Trace.h>
+
+namespace android {
+namespace dvr {
+
+namespace {
+
+const char kPoolSizeProperty[] = "bufferhubd.pool_size_bytes";
+
+// Returns the memory held by |buffer|, taken from the size of its dmabuf fds
+// when the allocator exposes them and estimated from its geometry otherwise.
+size_t GetBufferSize(const IonBuffer& buffer) {
+  size_t size_bytes = 0;
+  const native_handle_t* handle = buffer.handle();
+  for (int i = 0; handle && i < handle->numFds; i++) {
+    const off_t fd_size = lseek(handle->data[i], 0, SEEK_END);
+    if (fd_size > 0)
+      size_bytes += fd_size;
+  }
+  if (size_bytes > 0)
+    return size_bytes;
+
+  return static_cast<size_t>(buffer.stride()) * buffer.height() *
+         buffer.layer_count() *
+         std::max<uint32_t>(bytesPerPixel(buffer.format()), 1);
+}
+
+}  // anonymous namespace
+
+IonBufferPool::IonBufferPool()
+    : IonBufferPool(android::base::GetUintProperty<size_t>(
+          kPoolSizeProperty, kDefaultCapacityBytes)) {}
+
+IonBufferPool::IonBufferPool(size_t capacity_bytes)
+    : capacity_bytes_(capacity_bytes) {}
+
+int IonBufferPool::Alloc(IonBuffer* buffer, uid_t owner, uint32_t width,
+                         uint32_t height, uint32_t layer_count,
+                         uint32_t format, uint64_t usage) {
+  ATRACE_NAME("IonBufferPool::Alloc");
+  TrimIdle();
+
+  // Prefer the most recently released match, which is the most likely to
+  // still be resident.
+  for (auto it = entries_.rbegin(); it != entries_.rend(); ++it) {
+    const IonBuffer& pooled = it->buffer;
+    if (it->owner == owner && pooled.width() == width &&
+        pooled.height() == height && pooled.layer_count() == layer_count &&
+        pooled.format() == format && pooled.usage() == usage) {
+      ALOGD_IF(TRACE,
+               "IonBufferPool::Alloc: Reusing buffer: owner=%d width=%u "
+               "height=%u layer_count=%u format=%u usage=%" PRIx64,
+               owner, width, height, layer_count, format, usage);
+      *buffer = std::move(it->buffer);
+      size_bytes_ -= it->size_bytes;
+      entries_.erase(std::next(it).base());
+      return 0;
+    }
+  }
+
+  int ret = buffer->Alloc(width, height, layer_count, format, usage);
+  if (ret < 0 && !entries_.empty()) {
+    ALOGW("IonBufferPool::Alloc: Allocation failed, freeing %zu pooled bytes",
+          size_bytes_);
+    Trim(0);
+    ret = buffer->Alloc(width, height, layer_count, format, usage);
+  }
+  return ret;
+}
+
+void IonBufferPool::Release(uid_t owner, IonBuffer buffer) {
+  if (!buffer.IsValid())
+    return;
+
+  TrimIdle();
+
+  const size_t size_bytes = GetBufferSize(buffer);
+  if (size_bytes > capacity_bytes_)
+    return;
+
+  Trim(capacity_bytes_ - size_bytes);
+  entries_.push_back({owner, size_bytes, Clock::now(), std::move(buffer)});
+  size_bytes_ += size_bytes;
+}
+
+void IonBufferPool::Trim(size_t target_bytes) {
+  while (size_bytes_ > target_bytes && !entries_.empty()) {
+    size_bytes_ -= entries_.front().size_bytes;
+    entries_.pop_front();
+  }
+}
+
+void IonBufferPool::TrimIdle() {
+  const Clock::time_point oldest_kept = Clock::now() - kMaxIdleTime;
+  while (!entries_.empty() && entries_.front().release_time < oldest_kept) {
+    size_bytes_ -= entries_.front().size_bytes;
+    entries_.pop_front();
+  }
+}
+
+}  // namespace dvr
+}  // namespace android
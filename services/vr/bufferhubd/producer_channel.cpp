@@ -50,15 +50,18 @@ ProducerChannel::ProducerChannel(BufferHubService* service, int buffer_id,
 }
 
 ProducerChannel::ProducerChannel(BufferHubService* service, int channel_id,
-                                 uint32_t width, uint32_t height,
+                                 uid_t owner, uint32_t width, uint32_t height,
                                  uint32_t layer_count, uint32_t format,
                                  uint64_t usage, size_t user_metadata_size,
                                  int* error)
     : BufferHubChannel(service, channel_id, channel_id, kProducerType),
+      buffer_pool_(service->buffer_pool()),
+      owner_(owner),
       user_metadata_size_(user_metadata_size),
       metadata_buf_size_(BufferHubDefs::kMetadataHeaderSize +
                          user_metadata_size) {
-  if (int ret = buffer_.Alloc(width, height, layer_count, format, usage)) {
+  if (int ret = buffer_pool_->Alloc(&buffer_, owner_, width, height,
+                                    layer_count, format, usage)) {
     ALOGE("ProducerChannel::ProducerChannel: Failed to allocate buffer: %s",
           strerror(-ret));
     *error = ret;
@@ -146,13 +149,13 @@ std::unique_ptr<ProducerChannel> ProducerChannel::Create(
 }
 
 Status<std::shared_ptr<ProducerChannel>> ProducerChannel::Create(
-    BufferHubService* service, int channel_id, uint32_t width, uint32_t height,
-    uint32_t layer_count, uint32_t format, uint64_t usage,
+    BufferHubService* service, int channel_id, uid_t owner, uint32_t width,
+    uint32_t height, uint32_t layer_count, uint32_t format, uint64_t usage,
     size_t user_metadata_size) {
   int error;
-  std::shared_ptr<ProducerChannel> producer(
-      new ProducerChannel(service, channel_id, width, height, layer_count,
-                          format, usage, user_metadata_size, &error));
+  std::shared_ptr<ProducerChannel> producer(new ProducerChannel(
+      service, channel_id, owner, width, height, layer_count, format, usage,
+      user_metadata_size, &error));
   if (error < 0)
     return ErrorStatus(-error);
   else
@@ -169,6 +172,11 @@ ProducerChannel::~ProducerChannel() {
     consumer->OnProducerClosed();
   }
   Hangup();
+
+  // Consumers that are still around may keep using the buffer, so it can only
+  // be reused once they are all gone.
+  if (buffer_pool_ && consumer_channels_.empty())
+    buffer_pool_->Release(owner_, std::move(buffer_));
 }
 
 BufferHubChannel::BufferInfo ProducerChannel::GetBufferInfo() const {
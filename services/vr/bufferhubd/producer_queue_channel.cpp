@@ -227,8 +227,10 @@ ProducerQueueChannel::AllocateBuffer(Message& message, uint32_t width,
   auto buffer_handle = status.take();
 
   auto producer_channel_status =
-      ProducerChannel::Create(service(), buffer_id, width, height, layer_count,
-                              format, usage, config_.user_metadata_size);
+      ProducerChannel::Create(service(), buffer_id,
+                              message.GetEffectiveUserId(), width, height,
+                              layer_count, format, usage,
+                              config_.user_metadata_size);
   if (!producer_channel_status) {
     ALOGE(
         "ProducerQueueChannel::AllocateBuffer: Failed to create producer "
@@ -0,0 +1,384 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <gui/BufferItemConsumer.h>
+#include <gui/BufferQueue.h>
+#include <gui/Surface.h>
+#include <vulkan/vulkan.h>
+
+#include <iterator>
+
+// Usage: atest vulkan_benchmark
+//
+// The benchmarks measure the loader and the swapchain together with the
+// Vulkan driver of the device. On a device whose driver is the null driver
+// (vulkan.default, loaded when ro.hardware.vulkan is "default"), which does
+// no work, they measure the loader and the swapchain alone.
+
+namespace vulkan {
+namespace {
+
+constexpr uint32_t kWindowSize = 64;
+
+const char* const kInstanceExtensions[] = {
+    VK_KHR_SURFACE_EXTENSION_NAME,
+    VK_KHR_ANDROID_SURFACE_EXTENSION_NAME,
+};
+
+const char* const kDeviceExtensions[] = {
+    VK_KHR_SWAPCHAIN_EXTENSION_NAME,
+};
+
+VkInstance CreateInstance() {
+    const VkApplicationInfo app_info = {
+        .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
+        .apiVersion = VK_API_VERSION_1_0,
+    };
+    const VkInstanceCreateInfo create_info = {
+        .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
+        .pApplicationInfo = &app_info,
+        .enabledExtensionCount = std::size(kInstanceExtensions),
+        .ppEnabledExtensionNames = kInstanceExtensions,
+    };
+    VkInstance instance;
+    if (vkCreateInstance(&create_info, nullptr, &instance) != VK_SUCCESS)
+        return VK_NULL_HANDLE;
+    return instance;
+}
+
+VkPhysicalDevice GetPhysicalDevice(VkInstance instance) {
+    uint32_t count = 1;
+    VkPhysicalDevice physical_dev = VK_NULL_HANDLE;
+    VkResult result =
+        vkEnumeratePhysicalDevices(instance, &count, &physical_dev);
+    if ((result != VK_SUCCESS && result != VK_INCOMPLETE) || count == 0)
+        return VK_NULL_HANDLE;
+    return physical_dev;
+}
+
+VkDevice CreateDevice(VkPhysicalDevice physical_dev) {
+    const float priority = 1.0f;
+    const VkDeviceQueueCreateInfo queue_info = {
+        .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+        .queueFamilyIndex = 0,
+        .queueCount = 1,
+        .pQueuePriorities = &priority,
+    };
+    const VkDeviceCreateInfo create_info = {
+        .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+        .queueCreateInfoCount = 1,
+        .pQueueCreateInfos = &queue_info,
+        .enabledExtensionCount = std::size(kDeviceExtensions),
+        .ppEnabledExtensionNames = kDeviceExtensions,
+    };
+    VkDevice device;
+    if (vkCreateDevice(physical_dev, &create_info, nullptr, &device) !=
+        VK_SUCCESS)
+        return VK_NULL_HANDLE;
+    return device;
+}
+
+// A Device holds an instance and a device of its first physical device for
+// the lifetime of a benchmark.
+class Device {
+   public:
+    explicit Device(benchmark::State& state) {
+        instance_ = CreateInstance();
+        if (instance_ == VK_NULL_HANDLE) {
+            state.SkipWithError("unable to create an instance");
+            return;
+        }
+        physical_dev_ = GetPhysicalDevice(instance_);
+        if (physical_dev_ == VK_NULL_HANDLE) {
+            state.SkipWithError("no physical device");
+            return;
+        }
+        device_ = CreateDevice(physical_dev_);
+        if (device_ == VK_NULL_HANDLE) {
+            state.SkipWithError("unable to create a device");
+            return;
+        }
+        vkGetDeviceQueue(device_, 0, 0, &queue_);
+    }
+
+    ~Device() {
+        if (device_ != VK_NULL_HANDLE)
+            vkDestroyDevice(device_, nullptr);
+        if (instance_ != VK_NULL_HANDLE)
+            vkDestroyInstance(instance_, nullptr);
+    }
+
+    bool IsValid() const { return device_ != VK_NULL_HANDLE; }
+
+    VkInstance instance() const { return instance_; }
+    VkPhysicalDevice physical_device() const { return physical_dev_; }
+    VkDevice device() const { return device_; }
+    VkQueue queue() const { return queue_; }
+
+   private:
+    VkInstance instance_ = VK_NULL_HANDLE;
+    VkPhysicalDevice physical_dev_ = VK_NULL_HANDLE;
+    VkDevice device_ = VK_NULL_HANDLE;
+    VkQueue queue_ = VK_NULL_HANDLE;
+};
+
+// A Window is a Surface whose buffers are released as soon as they are
+// queued, so that presenting never blocks on a display.
+class Window {
+   public:
+    Window() {
+        android::sp<android::IGraphicBufferProducer> producer;
+        android::sp<android::IGraphicBufferConsumer> consumer;
+        android::BufferQueue::createBufferQueue(&producer, &consumer);
+        consumer->setDefaultBufferSize(kWindowSize, kWindowSize);
+        consumer_ = new android::BufferItemConsumer(
+            consumer, android::GraphicBuffer::USAGE_HW_COMPOSER);
+        listener_ = new ReleasingListener(consumer_);
+        consumer_->setFrameAvailableListener(listener_);
+        surface_ = new android::Surface(producer);
+    }
+
+    ANativeWindow* window() const { return surface_.get(); }
+
+   private:
+    class ReleasingListener
+        : public android::ConsumerBase::FrameAvailableListener {
+       public:
+        explicit ReleasingListener(
+            const android::wp<android::BufferItemConsumer>& consumer)
+            : consumer_(consumer) {}
+
+        void onFrameAvailable(const android::BufferItem&) override {
+            android::sp<android::BufferItemConsumer> consumer =
+                consumer_.promote();
+            android::BufferItem item;
+            if (consumer && consumer->acquireBuffer(&item, 0) ==
+                                android::NO_ERROR) {
+                consumer->releaseBuffer(item);
+            }
+        }
+
+       private:
+        android::wp<android::BufferItemConsumer> consumer_;
+    };
+
+    android::sp<android::BufferItemConsumer> consumer_;
+    android::sp<ReleasingListener> listener_;
+    android::sp<android::Surface> surface_;
+};
+
+VkSurfaceKHR CreateSurface(VkInstance instance, ANativeWindow* window) {
+    const VkAndroidSurfaceCreateInfoKHR create_info = {
+        .sType = VK_STRUCTURE_TYPE_ANDROID_SURFACE_CREATE_INFO_KHR,
+        .window = window,
+    };
+    VkSurfaceKHR surface;
+    if (vkCreateAndroidSurfaceKHR(instance, &create_info, nullptr, &surface) !=
+        VK_SUCCESS)
+        return VK_NULL_HANDLE;
+    return surface;
+}
+
+VkSwapchainKHR CreateSwapchain(const Device& device, VkSurfaceKHR surface) {
+    VkSurfaceCapabilitiesKHR caps;
+    if (vkGetPhysicalDeviceSurfaceCapabilitiesKHR(
+            device.physical_device(), surface, &caps) != VK_SUCCESS)
+        return VK_NULL_HANDLE;
+    const VkSwapchainCreateInfoKHR create_info = {
+        .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
+        .surface = surface,
+        .minImageCount = caps.minImageCount,
+        .imageFormat = VK_FORMAT_R8G8B8A8_UNORM,
+        .imageColorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR,
+        .imageExtent = caps.currentExtent,
+        .imageArrayLayers = 1,
+        .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+        .imageSharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR,
+        .compositeAlpha = VK_COMPOSITE_ALPHA_INHERIT_BIT_KHR,
+        .presentMode = VK_PRESENT_MODE_FIFO_KHR,
+        .clipped = VK_TRUE,
+    };
+    VkSwapchainKHR swapchain;
+    if (vkCreateSwapchainKHR(device.device(), &create_info, nullptr,
+                             &swapchain) != VK_SUCCESS)
+        return VK_NULL_HANDLE;
+    return swapchain;
+}
+
+// The first iteration loads the driver, which then stays loaded.
+void BM_vkCreateInstance(benchmark::State& state) {
+    for (auto _ : state) {
+        VkInstance instance = CreateInstance();
+        if (instance == VK_NULL_HANDLE) {
+            state.SkipWithError("unable to create an instance");
+            return;
+        }
+        vkDestroyInstance(instance, nullptr);
+    }
+}
+BENCHMARK(BM_vkCreateInstance);
+
+void BM_vkCreateDevice(benchmark::State& state) {
+    VkInstance instance = CreateInstance();
+    if (instance == VK_NULL_HANDLE) {
+        state.SkipWithError("unable to create an instance");
+        return;
+    }
+    VkPhysicalDevice physical_dev = GetPhysicalDevice(instance);
+    for (auto _ : state) {
+        VkDevice device = CreateDevice(physical_dev);
+        if (device == VK_NULL_HANDLE) {
+            state.SkipWithError("unable to create a device");
+            break;
+        }
+        vkDestroyDevice(device, nullptr);
+    }
+    vkDestroyInstance(instance, nullptr);
+}
+BENCHMARK(BM_vkCreateDevice);
+
+void BM_vkCreateSwapchainKHR(benchmark::State& state) {
+    Device device(state);
+    if (!device.IsValid())
+        return;
+    Window window;
+    VkSurfaceKHR surface = CreateSurface(device.instance(), window.window());
+    if (surface == VK_NULL_HANDLE) {
+        state.SkipWithError("unable to create a surface");
+        return;
+    }
+    for (auto _ : state) {
+        VkSwapchainKHR swapchain = CreateSwapchain(device, surface);
+        if (swapchain == VK_NULL_HANDLE) {
+            state.SkipWithError("unable to create a swapchain");
+            break;
+        }
+        vkDestroySwapchainKHR(device.device(), swapchain, nullptr);
+    }
+    vkDestroySurfaceKHR(device.instance(), surface, nullptr);
+}
+BENCHMARK(BM_vkCreateSwapchainKHR);
+
+// Each iteration acquires an image and presents it.
+void BM_vkQueuePresentKHR(benchmark::State& state) {
+    Device device(state);
+    if (!device.IsValid())
+        return;
+    Window window;
+    VkSurfaceKHR surface = CreateSurface(device.instance(), window.window());
+    VkSwapchainKHR swapchain = surface != VK_NULL_HANDLE
+                                   ? CreateSwapchain(device, surface)
+                                   : VK_NULL_HANDLE;
+    const VkSemaphoreCreateInfo semaphore_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+    };
+    VkSemaphore semaphore = VK_NULL_HANDLE;
+    if (swapchain == VK_NULL_HANDLE ||
+        vkCreateSemaphore(device.device(), &semaphore_info, nullptr,
+                          &semaphore) != VK_SUCCESS) {
+        state.SkipWithError("unable to create a swapchain");
+    } else {
+        for (auto _ : state) {
+            uint32_t index;
+            if (vkAcquireNextImageKHR(device.device(), swapchain, UINT64_MAX,
+                                      semaphore, VK_NULL_HANDLE,
+                                      &index) != VK_SUCCESS) {
+                state.SkipWithError("unable to acquire an image");
+                break;
+            }
+            const VkPresentInfoKHR present_info = {
+                .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+                .waitSemaphoreCount = 1,
+                .pWaitSemaphores = &semaphore,
+                .swapchainCount = 1,
+                .pSwapchains = &swapchain,
+                .pImageIndices = &index,
+            };
+            if (vkQueuePresentKHR(device.queue(), &present_info) !=
+                VK_SUCCESS) {
+                state.SkipWithError("unable to present an image");
+                break;
+            }
+        }
+    }
+    if (semaphore != VK_NULL_HANDLE)
+        vkDestroySemaphore(device.device(), semaphore, nullptr);
+    if (swapchain != VK_NULL_HANDLE)
+        vkDestroySwapchainKHR(device.device(), swapchain, nullptr);
+    if (surface != VK_NULL_HANDLE)
+        vkDestroySurfaceKHR(device.instance(), surface, nullptr);
+}
+BENCHMARK(BM_vkQueuePresentKHR);
+
+// Records draws in a command buffer, through the libvulkan entry point when
+// the argument is 0, and through the pointer returned by vkGetDeviceProcAddr
+// when it is 1. The difference is the cost of the loader trampoline.
+void BM_vkCmdDraw(benchmark::State& state) {
+    Device device(state);
+    if (!device.IsValid())
+        return;
+    const VkCommandPoolCreateInfo pool_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        .queueFamilyIndex = 0,
+    };
+    VkCommandPool pool;
+    if (vkCreateCommandPool(device.device(), &pool_info, nullptr, &pool) !=
+        VK_SUCCESS) {
+        state.SkipWithError("unable to create a command pool");
+        return;
+    }
+    const VkCommandBufferAllocateInfo alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1,
+    };
+    VkCommandBuffer cmd;
+    if (vkAllocateCommandBuffers(device.device(), &alloc_info, &cmd) !=
+        VK_SUCCESS) {
+        state.SkipWithError("unable to allocate a command buffer");
+        vkDestroyCommandPool(device.device(), pool, nullptr);
+        return;
+    }
+    PFN_vkCmdDraw cmd_draw =
+        state.range(0) ? reinterpret_cast<PFN_vkCmdDraw>(
+                             vkGetDeviceProcAddr(device.device(), "vkCmdDraw"))
+                       : vkCmdDraw;
+    state.SetLabel(state.range(0) ? "vkGetDeviceProcAddr" : "libvulkan");
+
+    const VkCommandBufferBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    vkBeginCommandBuffer(cmd, &begin_info);
+    for (auto _ : state) {
+        cmd_draw(cmd, 3, 1, 0, 0);
+    }
+    vkEndCommandBuffer(cmd);
+
+    vkFreeCommandBuffers(device.device(), pool, 1, &cmd);
+    vkDestroyCommandPool(device.device(), pool, nullptr);
+}
+BENCHMARK(BM_vkCmdDraw)->Arg(0)->Arg(1);
+
+}  // namespace
+}  // namespace vulkan
+
+BENCHMARK_MAIN();
@@ -548,6 +548,8 @@ VkResult LayerChain::ActivateLayers(const char* const* layer_names,
                                     uint32_t layer_count,
                                     const char* const* extension_names,
                                     uint32_t extension_count) {
+    ATRACE_CALL();
+
     VkResult result = override_layers_.Parse(layer_names, layer_count);
     if (result != VK_SUCCESS)
         return result;
@@ -592,6 +594,8 @@ VkResult LayerChain::ActivateLayers(VkPhysicalDevice physical_dev,
                                     uint32_t layer_count,
                                     const char* const* extension_names,
                                     uint32_t extension_count) {
+    ATRACE_CALL();
+
     uint32_t instance_layer_count;
     const ActiveLayer* instance_layers =
         GetActiveLayers(physical_dev, instance_layer_count);
@@ -814,6 +818,8 @@ void LayerChain::ModifyCreateInfo(VkDeviceCreateInfo& info) {
 VkResult LayerChain::Create(const VkInstanceCreateInfo* create_info,
                             const VkAllocationCallbacks* allocator,
                             VkInstance* instance_out) {
+    ATRACE_CALL();
+
     VkResult result = ValidateExtensions(create_info->ppEnabledExtensionNames,
                                          create_info->enabledExtensionCount);
     if (result != VK_SUCCESS)
@@ -887,6 +893,8 @@ VkResult LayerChain::Create(VkPhysicalDevice physical_dev,
                             const VkDeviceCreateInfo* create_info,
                             const VkAllocationCallbacks* allocator,
                             VkDevice* dev_out) {
+    ATRACE_CALL();
+
     VkResult result =
         ValidateExtensions(physical_dev, create_info->ppEnabledExtensionNames,
                            create_info->enabledExtensionCount);
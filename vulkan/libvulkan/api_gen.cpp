@@ -643,6 +643,8 @@ VKAPI_ATTR PFN_vkVoidFunction GetDeviceProcAddr(VkDevice device, const char* pNa
     if (strcmp(pName, "vkGetDeviceProcAddr") == 0) return reinterpret_cast<PFN_vkVoidFunction>(GetDeviceProcAddr);
     if (strcmp(pName, "vkDestroyDevice") == 0) return reinterpret_cast<PFN_vkVoidFunction>(DestroyDevice);
 
+    // The other device commands resolve to the entry points of the top layer
+    // or of the driver, so that calls through them bypass the loader.
     return GetData(device).dispatch.GetDeviceProcAddr(device, pName);
 }
 
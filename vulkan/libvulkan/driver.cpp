@@ -76,17 +76,30 @@ class Hal {
 
     int GetDebugReportIndex() const { return debug_report_index_; }
 
+    VkResult EnumerateInstanceExtensionProperties(
+        uint32_t* count,
+        VkExtensionProperties* props) const;
+
    private:
-    Hal() : dev_(nullptr), debug_report_index_(-1) {}
+    Hal()
+        : dev_(nullptr),
+          debug_report_index_(-1),
+          instance_extensions_valid_(false) {}
     Hal(const Hal&) = delete;
     Hal& operator=(const Hal&) = delete;
 
-    bool InitDebugReportIndex();
+    bool InitInstanceExtensions();
 
     static Hal hal_;
 
     const hwvulkan_device_t* dev_;
     int debug_report_index_;
+
+    // The instance extensions of the HAL are enumerated once when it is
+    // opened, which happens in the zygote when it preloads the driver, and
+    // are then shared by the processes forked from it.
+    std::vector<VkExtensionProperties> instance_extensions_;
+    bool instance_extensions_valid_;
 };
 
 class CreateInfoWrapper {
@@ -270,7 +283,7 @@ bool Hal::Open() {
 
     hal_.dev_ = device;
 
-    hal_.InitDebugReportIndex();
+    hal_.InitInstanceExtensions();
 
     android::GraphicsEnv::getInstance().setDriverLoaded(
         android::GpuStatsInfo::Api::API_VK, true, systemTime() - openTime);
@@ -278,7 +291,7 @@ bool Hal::Open() {
     return true;
 }
 
-bool Hal::InitDebugReportIndex() {
+bool Hal::InitInstanceExtensions() {
     ATRACE_CALL();
 
     uint32_t count;
@@ -288,33 +301,47 @@ bool Hal::InitDebugReportIndex() {
         return false;
     }
 
-    VkExtensionProperties* exts = reinterpret_cast<VkExtensionProperties*>(
-        malloc(sizeof(VkExtensionProperties) * count));
-    if (!exts) {
-        ALOGE("failed to allocate HAL instance extension array");
-        return false;
-    }
-
-    if (dev_->EnumerateInstanceExtensionProperties(nullptr, &count, exts) !=
-        VK_SUCCESS) {
+    instance_extensions_.resize(count);
+    if (dev_->EnumerateInstanceExtensionProperties(
+            nullptr, &count, instance_extensions_.data()) != VK_SUCCESS) {
         ALOGE("failed to enumerate HAL instance extensions");
-        free(exts);
+        instance_extensions_.clear();
         return false;
     }
+    instance_extensions_.resize(count);
+    instance_extensions_valid_ = true;
 
     for (uint32_t i = 0; i < count; i++) {
-        if (strcmp(exts[i].extensionName, VK_EXT_DEBUG_REPORT_EXTENSION_NAME) ==
-            0) {
+        if (strcmp(instance_extensions_[i].extensionName,
+                   VK_EXT_DEBUG_REPORT_EXTENSION_NAME) == 0) {
             debug_report_index_ = static_cast<int>(i);
             break;
         }
     }
 
-    free(exts);
-
     return true;
 }
 
+VkResult Hal::EnumerateInstanceExtensionProperties(
+    uint32_t* count,
+    VkExtensionProperties* props) const {
+    if (!instance_extensions_valid_)
+        return dev_->EnumerateInstanceExtensionProperties(nullptr, count,
+                                                          props);
+
+    const uint32_t ext_count =
+        static_cast<uint32_t>(instance_extensions_.size());
+    if (!props) {
+        *count = ext_count;
+        return VK_SUCCESS;
+    }
+
+    *count = std::min(*count, ext_count);
+    std::copy_n(instance_extensions_.data(), *count, props);
+
+    return (*count < ext_count) ? VK_INCOMPLETE : VK_SUCCESS;
+}
+
 CreateInfoWrapper::CreateInfoWrapper(const VkInstanceCreateInfo& create_info,
                                      const VkAllocationCallbacks& allocator)
     : is_instance_(true),
@@ -447,8 +474,8 @@ VkResult CreateInfoWrapper::SanitizeExtensions() {
 
 VkResult CreateInfoWrapper::QueryExtensionCount(uint32_t& count) const {
     if (is_instance_) {
-        return Hal::Device().EnumerateInstanceExtensionProperties(
-            nullptr, &count, nullptr);
+        return Hal::Get().EnumerateInstanceExtensionProperties(&count,
+                                                               nullptr);
     } else {
         const auto& driver = GetData(physical_dev_).driver;
         return driver.EnumerateDeviceExtensionProperties(physical_dev_, nullptr,
@@ -460,8 +487,7 @@ VkResult CreateInfoWrapper::EnumerateExtensions(
     uint32_t& count,
     VkExtensionProperties* props) const {
     if (is_instance_) {
-        return Hal::Device().EnumerateInstanceExtensionProperties(
-            nullptr, &count, props);
+        return Hal::Get().EnumerateInstanceExtensionProperties(&count, props);
     } else {
         const auto& driver = GetData(physical_dev_).driver;
         return driver.EnumerateDeviceExtensionProperties(physical_dev_, nullptr,
@@ -873,10 +899,16 @@ VkResult EnumerateInstanceExtensionProperties(
         }
     }
 
-    ATRACE_BEGIN("driver.EnumerateInstanceExtensionProperties");
-    VkResult result = Hal::Device().EnumerateInstanceExtensionProperties(
-        pLayerName, pPropertyCount, pProperties);
-    ATRACE_END();
+    VkResult result;
+    if (!pLayerName) {
+        result = Hal::Get().EnumerateInstanceExtensionProperties(
+            pPropertyCount, pProperties);
+    } else {
+        ATRACE_BEGIN("driver.EnumerateInstanceExtensionProperties");
+        result = Hal::Device().EnumerateInstanceExtensionProperties(
+            pLayerName, pPropertyCount, pProperties);
+        ATRACE_END();
+    }
 
     if (!pLayerName && (result == VK_SUCCESS || result == VK_INCOMPLETE)) {
         int idx = Hal::Get().GetDebugReportIndex();
@@ -23,12 +23,16 @@
 #include <dlfcn.h>
 #include <string.h>
 #include <sys/prctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <android/dlext.h>
+#include <android-base/file.h>
 #include <android-base/strings.h>
 #include <cutils/properties.h>
 #include <graphicsenv/GraphicsEnv.h>
@@ -324,19 +328,224 @@ void* LayerLibrary::GetGPA(const Layer& layer, const std::string_view gpa_name)
 std::vector<LayerLibrary> g_layer_libraries;
 std::vector<Layer> g_instance_layers;
 
-void AddLayerLibrary(const std::string& path, const std::string& filename) {
-    LayerLibrary library(path + "/" + filename, filename);
-    if (!library.Open())
+// The layer cache of a directory records the layers of its layer libraries, so
+// that discovering them doesn't require loading every library. A library is
+// identified by its file name and the stat of its file, so that a library that
+// changed is enumerated again. The cache is read by every process, but only
+// written by the processes owning the directory, such as the shell that pushed
+// the layers.
+const char kLayerCacheFilename[] = ".vulkan_layer_cache";
+constexpr uint32_t kLayerCacheMagic = 0x4c63564b;  // 'KVcL'
+constexpr uint32_t kLayerCacheVersion = 1;
+
+struct LayerLibraryStat {
+    uint64_t dev;
+    uint64_t ino;
+    uint64_t size;
+    int64_t mtime_ns;
+
+    bool operator==(const LayerLibraryStat& other) const {
+        return dev == other.dev && ino == other.ino && size == other.size &&
+               mtime_ns == other.mtime_ns;
+    }
+};
+
+struct CachedLayerLibrary {
+    LayerLibraryStat stat;
+    // library_idx of the layers is meaningless
+    std::vector<Layer> layers;
+};
+
+// Maps the file name of each layer library to its layers.
+using LayerCache = std::unordered_map<std::string, CachedLayerLibrary>;
+
+bool StatLayerLibrary(const std::string& path, LayerLibraryStat* stat_out) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+        return false;
+    stat_out->dev = st.st_dev;
+    stat_out->ino = st.st_ino;
+    stat_out->size = static_cast<uint64_t>(st.st_size);
+    stat_out->mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 +
+                         st.st_mtim.tv_nsec;
+    return true;
+}
+
+class LayerCacheReader {
+   public:
+    explicit LayerCacheReader(const std::string& data)
+        : data_(data), offset_(0) {}
+
+    template <typename T>
+    bool Read(T* value) {
+        if (data_.size() - offset_ < sizeof(T))
+            return false;
+        memcpy(value, data_.data() + offset_, sizeof(T));
+        offset_ += sizeof(T);
+        return true;
+    }
+
+    template <typename T>
+    bool ReadVector(std::vector<T>* values) {
+        uint32_t count;
+        if (!Read(&count) || (data_.size() - offset_) / sizeof(T) < count)
+            return false;
+        values->resize(count);
+        memcpy(values->data(), data_.data() + offset_, count * sizeof(T));
+        offset_ += count * sizeof(T);
+        return true;
+    }
+
+    bool AtEnd() const { return offset_ == data_.size(); }
+
+   private:
+    const std::string& data_;
+    size_t offset_;
+};
+
+template <typename T>
+void AppendToLayerCache(std::string& data, const T& value) {
+    data.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+void AppendVectorToLayerCache(std::string& data, const std::vector<T>& values) {
+    AppendToLayerCache(data, static_cast<uint32_t>(values.size()));
+    data.append(reinterpret_cast<const char*>(values.data()),
+                values.size() * sizeof(T));
+}
+
+LayerCache ReadLayerCache(const std::string& dirname) {
+    ATRACE_CALL();
+
+    LayerCache cache;
+    std::string data;
+    if (!android::base::ReadFileToString(dirname + "/" + kLayerCacheFilename,
+                                         &data))
+        return cache;
+
+    LayerCacheReader reader(data);
+    uint32_t magic, version, num_libraries;
+    if (!reader.Read(&magic) || magic != kLayerCacheMagic ||
+        !reader.Read(&version) || version != kLayerCacheVersion ||
+        !reader.Read(&num_libraries))
+        return cache;
+    for (uint32_t i = 0; i < num_libraries; i++) {
+        std::vector<char> filename;
+        CachedLayerLibrary library;
+        uint32_t num_layers;
+        if (!reader.ReadVector(&filename) || !reader.Read(&library.stat) ||
+            !reader.Read(&num_layers)) {
+            ALOGW("ignoring truncated layer cache in '%s'", dirname.c_str());
+            return LayerCache();
+        }
+        for (uint32_t j = 0; j < num_layers; j++) {
+            Layer layer = {};
+            uint32_t is_global;
+            if (!reader.Read(&layer.properties) || !reader.Read(&is_global) ||
+                !reader.ReadVector(&layer.instance_extensions) ||
+                !reader.ReadVector(&layer.device_extensions)) {
+                ALOGW("ignoring truncated layer cache in '%s'",
+                      dirname.c_str());
+                return LayerCache();
+            }
+            layer.is_global = is_global != 0;
+            library.layers.push_back(std::move(layer));
+        }
+        cache[std::string(filename.begin(), filename.end())] =
+            std::move(library);
+    }
+    if (!reader.AtEnd())
+        return LayerCache();
+    return cache;
+}
+
+void WriteLayerCache(const std::string& dirname, const LayerCache& cache) {
+    ATRACE_CALL();
+
+    struct stat dir_stat;
+    if (stat(dirname.c_str(), &dir_stat) != 0 || dir_stat.st_uid != geteuid())
         return;
 
+    std::string data;
+    AppendToLayerCache(data, kLayerCacheMagic);
+    AppendToLayerCache(data, kLayerCacheVersion);
+    AppendToLayerCache(data, static_cast<uint32_t>(cache.size()));
+    for (const auto& entry : cache) {
+        AppendVectorToLayerCache(
+            data, std::vector<char>(entry.first.begin(), entry.first.end()));
+        AppendToLayerCache(data, entry.second.stat);
+        AppendToLayerCache(data,
+                           static_cast<uint32_t>(entry.second.layers.size()));
+        for (const Layer& layer : entry.second.layers) {
+            AppendToLayerCache(data, layer.properties);
+            AppendToLayerCache(data, static_cast<uint32_t>(layer.is_global));
+            AppendVectorToLayerCache(data, layer.instance_extensions);
+            AppendVectorToLayerCache(data, layer.device_extensions);
+        }
+    }
+
+    // Write a new file and rename it, so that readers never see a partial
+    // cache.
+    const std::string path = dirname + "/" + kLayerCacheFilename;
+    const std::string tmp_path = path + ".tmp";
+    if (!android::base::WriteStringToFile(data, tmp_path) ||
+        rename(tmp_path.c_str(), path.c_str()) != 0) {
+        ALOGW("failed to write layer cache '%s': %s", path.c_str(),
+              strerror(errno));
+        unlink(tmp_path.c_str());
+    }
+}
+
+// AddLayerLibrary adds the layers of a library, enumerating them unless the
+// cache has them. If new_cache isn't null, the layers of the library are added
+// to it. It returns true if it enumerated layers to add to new_cache.
+bool AddLayerLibrary(const std::string& path,
+                     const std::string& filename,
+                     const LayerCache& cache,
+                     LayerCache* new_cache) {
+    const std::string library_path = path + "/" + filename;
+    LayerLibraryStat library_stat;
+    if (new_cache && !StatLayerLibrary(library_path, &library_stat))
+        new_cache = nullptr;
+
+    if (new_cache) {
+        auto cached = cache.find(filename);
+        if (cached != cache.end() && cached->second.stat == library_stat) {
+            for (Layer layer : cached->second.layers) {
+                layer.library_idx = g_layer_libraries.size();
+                ALOGD("added cached %s layer '%s' from library '%s'",
+                      (layer.is_global) ? "global" : "instance",
+                      layer.properties.layerName, library_path.c_str());
+                g_instance_layers.push_back(std::move(layer));
+            }
+            g_layer_libraries.emplace_back(library_path, filename);
+            new_cache->insert(*cached);
+            return false;
+        }
+    }
+
+    LayerLibrary library(library_path, filename);
+    if (!library.Open())
+        return false;
+
+    const size_t first_layer = g_instance_layers.size();
     if (!library.EnumerateLayers(g_layer_libraries.size(), g_instance_layers)) {
         library.Close();
-        return;
+        return false;
     }
 
     library.Close();
 
+    if (new_cache) {
+        CachedLayerLibrary& cached = (*new_cache)[filename];
+        cached.stat = library_stat;
+        cached.layers.assign(g_instance_layers.begin() + first_layer,
+                             g_instance_layers.end());
+    }
+
     g_layer_libraries.emplace_back(std::move(library));
+    return new_cache != nullptr;
 }
 
 template <typename Functor>
@@ -413,6 +622,13 @@ void DiscoverLayersInPathList(const std::string& pathstr) {
 
     std::vector<std::string> paths = android::base::Split(pathstr, ":");
     for (const auto& path : paths) {
+        // Only directories have a layer cache, the libraries of APKs are
+        // always enumerated.
+        const bool use_cache = path.find("!/") == std::string::npos;
+        const LayerCache cache = use_cache ? ReadLayerCache(path) : LayerCache();
+        LayerCache new_cache;
+        bool cache_changed = false;
+
         ForEachFileInPath(path, [&](const std::string& filename) {
             if (android::base::StartsWith(filename, "libVkLayer") &&
                 android::base::EndsWith(filename, ".so")) {
@@ -433,10 +649,15 @@ void DiscoverLayersInPathList(const std::string& pathstr) {
                     }
                 }
 
-                if (!duplicate)
-                    AddLayerLibrary(path, filename);
+                if (!duplicate) {
+                    cache_changed |= AddLayerLibrary(
+                        path, filename, cache, use_cache ? &new_cache : nullptr);
+                }
             }
         });
+
+        if (use_cache && (cache_changed || new_cache.size() != cache.size()))
+            WriteLayerCache(path, new_cache);
     }
 }
 
@@ -28,6 +28,7 @@
 #include <utils/Trace.h>
 
 #include <algorithm>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
@@ -241,9 +242,21 @@ struct Swapchain {
     uint64_t get_refresh_duration()
     {
         ANativeWindow* window = surface.window.get();
-        native_window_get_refresh_cycle_duration(
-            window,
-            &refresh_duration);
+        // Once frame timestamps are enabled, the compositor timing reported
+        // by SurfaceFlinger along with them carries the current refresh
+        // interval, and is read without a round trip to SurfaceFlinger.
+        int64_t composite_interval = 0;
+        if (frame_timestamps_enabled &&
+            native_window_get_compositor_timing(window, nullptr,
+                                                &composite_interval,
+                                                nullptr) == android::OK &&
+            composite_interval > 0) {
+            refresh_duration = composite_interval;
+        } else {
+            native_window_get_refresh_cycle_duration(
+                window,
+                &refresh_duration);
+        }
         return static_cast<uint64_t>(refresh_duration);
 
     }
@@ -277,6 +290,10 @@ struct Swapchain {
         bool dequeued;
     } images[android::BufferQueueDefs::NUM_BUFFER_SLOTS];
 
+    // Maps the buffer of each image to the index of the image, to find the
+    // image of the buffers returned by dequeueBuffer.
+    std::unordered_map<const ANativeWindowBuffer*, uint32_t> image_indices;
+
     std::vector<TimingInfo> timing;
 };
 
@@ -377,12 +394,21 @@ uint32_t get_num_ready_timings(Swapchain& swapchain) {
 
     uint32_t num_ready = 0;
     const size_t num_timings = swapchain.timing.size() - MIN_NUM_FRAMES_AGO + 1;
-    for (uint32_t i = 0; i < num_timings; i++) {
+    // Walk the frames from the newest. A frame that isn't ready while a newer
+    // one is was dropped, and will be discarded by copy_ready_timings, so its
+    // timestamps aren't queried: each query of a pending frame may go to
+    // SurfaceFlinger.
+    bool newer_ready = false;
+    for (size_t i = num_timings; i-- > 0;) {
         TimingInfo& ti = swapchain.timing[i];
         if (ti.ready()) {
             // This TimingInfo is ready to be reported to the user.  Add it
             // to the num_ready.
             num_ready++;
+            newer_ready = true;
+            continue;
+        }
+        if (newer_ready) {
             continue;
         }
         // This TimingInfo is not yet ready to be reported to the user,
@@ -421,6 +447,7 @@ uint32_t get_num_ready_timings(Swapchain& swapchain) {
             // reported to the user:
             ti.calculate(swapchain.refresh_duration);
             num_ready++;
+            newer_ready = true;
         }
     }
     return num_ready;
@@ -1327,6 +1354,7 @@ VkResult CreateSwapchainKHR(VkDevice device,
         }
         img.buffer = buffer;
         img.dequeued = true;
+        swapchain->image_indices[buffer] = i;
 
         image_create.extent =
             VkExtent3D{static_cast<uint32_t>(img.buffer->width),
@@ -1471,19 +1499,15 @@ VkResult AcquireNextImageKHR(VkDevice device,
         return VK_ERROR_SURFACE_LOST_KHR;
     }
 
-    uint32_t idx;
-    for (idx = 0; idx < swapchain.num_images; idx++) {
-        if (swapchain.images[idx].buffer.get() == buffer) {
-            swapchain.images[idx].dequeued = true;
-            swapchain.images[idx].dequeue_fence = fence_fd;
-            break;
-        }
-    }
-    if (idx == swapchain.num_images) {
+    auto image_index = swapchain.image_indices.find(buffer);
+    if (image_index == swapchain.image_indices.end()) {
         ALOGE("dequeueBuffer returned unrecognized buffer");
         window->cancelBuffer(window, buffer, fence_fd);
         return VK_ERROR_OUT_OF_DATE_KHR;
     }
+    const uint32_t idx = image_index->second;
+    swapchain.images[idx].dequeued = true;
+    swapchain.images[idx].dequeue_fence = fence_fd;
 
     int fence_clone = -1;
     if (fence_fd != -1) {
@@ -1594,6 +1618,10 @@ VkResult QueuePresentKHR(VkQueue queue, const VkPresentInfoKHR* present_info) {
     const VkAllocationCallbacks* allocator = &GetData(device).allocator;
     android_native_rect_t* rects = nullptr;
     uint32_t nrects = 0;
+    // The wait semaphores are only waited by the release of the first image.
+    // Its release fence is merged into the release fences of the other
+    // images, which therefore also wait for the semaphores.
+    int semaphores_fence = -1;
 
     for (uint32_t sc = 0; sc < present_info->swapchainCount; sc++) {
         Swapchain& swapchain =
@@ -1609,12 +1637,35 @@ VkResult QueuePresentKHR(VkQueue queue, const VkPresentInfoKHR* present_info) {
 
         int fence = -1;
         result = dispatch.QueueSignalReleaseImageANDROID(
-            queue, present_info->waitSemaphoreCount,
-            present_info->pWaitSemaphores, img.image, &fence);
+            queue, sc == 0 ? present_info->waitSemaphoreCount : 0,
+            sc == 0 ? present_info->pWaitSemaphores : nullptr, img.image,
+            &fence);
         if (result != VK_SUCCESS) {
             ALOGE("QueueSignalReleaseImageANDROID failed: %d", result);
             swapchain_result = result;
         }
+        if (sc == 0 && present_info->swapchainCount > 1 && fence >= 0) {
+            semaphores_fence = dup(fence);
+            if (semaphores_fence == -1) {
+                ALOGE("dup(fence) failed, stalling until signalled: %s (%d)",
+                      strerror(errno), errno);
+                sync_wait(fence, -1 /* forever */);
+            }
+        } else if (sc > 0 && semaphores_fence >= 0) {
+            int merged_fence = fence < 0 ? dup(semaphores_fence)
+                                         : sync_merge("vkQueuePresentKHR", fence,
+                                                      semaphores_fence);
+            if (merged_fence == -1) {
+                ALOGE("merging release fences failed, stalling until signalled: "
+                      "%s (%d)",
+                      strerror(errno), errno);
+                sync_wait(semaphores_fence, -1 /* forever */);
+            } else {
+                if (fence >= 0)
+                    close(fence);
+                fence = merged_fence;
+            }
+        }
         if (img.release_fence >= 0)
             close(img.release_fence);
         img.release_fence = fence < 0 ? -1 : dup(fence);
@@ -1764,6 +1815,9 @@ VkResult QueuePresentKHR(VkQueue queue, const VkPresentInfoKHR* present_info) {
     if (rects) {
         allocator->pfnFree(allocator->pUserData, rects);
     }
+    if (semaphores_fence >= 0) {
+        close(semaphores_fence);
+    }
 
     return final_result;
 }
@@ -242,7 +242,10 @@ def _intercept_device_proc_addr(f):
         f.write(gencom.indent(1) + 'if (strcmp(pName, "' + cmd +
                 '") == 0) return reinterpret_cast<PFN_vkVoidFunction>(' +
                 gencom.base_name(cmd) + ');\n')
-  f.write('\n')
+  f.write("""
+    // The other device commands resolve to the entry points of the top layer
+    // or of the driver, so that calls through them bypass the loader.
+""")
 
 
 def _api_dispatch(cmd, f):